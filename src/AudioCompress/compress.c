@@ -13,6 +13,12 @@
 #include "config.h"
 #include "compress.h"
 
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 struct Compressor {
         //! The compressor's preferences
         struct CompressorConfig prefs;
@@ -89,36 +95,32 @@ struct CompressorConfig *Compressor_getConfig(struct Compressor *obj)
         return &obj->prefs;
 }
 
-void Compressor_Process_int16(struct Compressor *obj, int16_t *audio,
-                              unsigned int count)
+/**
+ * Record the peak of a new block and calculate its gain (fixed
+ * point, 10 bits fraction).
+ *
+ * @param peakVal the peak of the block on a scale of 0-32767
+ * @param peakPos the position of the peak within the block
+ * @param ramp the number of samples over which the gain shall be
+ * ramped; it is truncated if the peak would clip otherwise
+ * @param curGain_r returns the gain at the start of the block
+ * @return the gain at the end of the ramp
+ */
+static int Compressor_updateGain(struct Compressor *obj,
+				 int peakVal, unsigned int peakPos,
+				 unsigned int *ramp, int *curGain_r)
 {
         struct CompressorConfig *prefs = Compressor_getConfig(obj);
-	int16_t *ap;
-	unsigned int i;
         int *peaks = obj->peaks;
         int curGain = obj->gain[obj->pos];
         int newGain;
-        int peakVal = 1;
-        int peakPos = 0;
-        int slot = (obj->pos + 1) % obj->bufsz;
-        int *clipped = obj->clipped + slot;
-        unsigned int ramp = count;
-        int delta;
+        unsigned int slot = (obj->pos + 1) % obj->bufsz;
+	unsigned int i;
 
-	ap = audio;
-	for (i = 0; i < count; i++)
-	{
-		int val = *ap++;
-                if (val < 0)
-                        val = -val;
-		if (val > peakVal)
-                {
-			peakVal = val;
-                        peakPos = i;
-                }
-	}
-	peaks[slot] = peakVal;
+	if (peakVal < 1)
+		peakVal = 1;
 
+	peaks[slot] = peakVal;
 
 	for (i = 0; i < obj->bufsz; i++)
 	{
@@ -149,16 +151,52 @@ void Compressor_Process_int16(struct Compressor *obj, int16_t *audio,
         {
                 newGain = (32767 << 10)/peakVal;
                 //! Truncate the ramp time
-                ramp = peakPos;
+                *ramp = peakPos;
         }
 
         //! Record the new gain
         obj->gain[slot] = newGain;
+        obj->pos = slot;
 
-        if (!ramp)
-                ramp = 1;
+        if (!*ramp)
+                *ramp = 1;
         if (!curGain)
                 curGain = 1 << 10;
+
+	*curGain_r = curGain;
+	return newGain;
+}
+
+void Compressor_Process_int16(struct Compressor *obj, int16_t *audio,
+                              unsigned int count)
+{
+	int16_t *ap;
+	unsigned int i;
+        int curGain;
+        int newGain;
+        int peakVal = 1;
+        int peakPos = 0;
+        int *clipped;
+        unsigned int ramp = count;
+        int delta;
+
+	ap = audio;
+	for (i = 0; i < count; i++)
+	{
+		int val = *ap++;
+                if (val < 0)
+                        val = -val;
+		if (val > peakVal)
+                {
+			peakVal = val;
+                        peakPos = i;
+                }
+	}
+
+	newGain = Compressor_updateGain(obj, peakVal, peakPos,
+					&ramp, &curGain);
+	clipped = obj->clipped + obj->pos;
+
 	delta = (newGain - curGain) / (int)ramp;
 
 	ap = audio;
@@ -186,7 +224,194 @@ void Compressor_Process_int16(struct Compressor *obj, int16_t *audio,
                 else
                         curGain = newGain;
 	}
+}
 
-        obj->pos = slot;
+void Compressor_Process_int32(struct Compressor *obj, int32_t *audio,
+			      unsigned int count, unsigned int bits)
+{
+	const int shift = bits - 16;
+	const int64_t max = ((int64_t)1 << (bits - 1)) - 1;
+	const int64_t min = -max - 1;
+	unsigned int i;
+	int32_t peak = 0;
+	unsigned int peakPos = 0;
+	unsigned int ramp = count;
+	int curGain, newGain, delta;
+
+	for (i = 0; i < count; i++)
+	{
+		int32_t val = audio[i];
+		if (val < 0)
+			/* avoid overflow on INT32_MIN */
+			val = -(val + 1);
+		if (val > peak)
+		{
+			peak = val;
+			peakPos = i;
+		}
+	}
+
+	newGain = Compressor_updateGain(obj, peak >> shift, peakPos,
+					&ramp, &curGain);
+	obj->clipped[obj->pos] = 0;
+
+	delta = (newGain - curGain) / (int)ramp;
+
+	for (i = 0; i < count; i++)
+	{
+		int64_t sample = (int64_t)audio[i] * curGain >> 10;
+		if (sample < min)
+			sample = min;
+		else if (sample > max)
+			sample = max;
+		audio[i] = (int32_t)sample;
+
+		if (i < ramp)
+			curGain += delta;
+		else
+			curGain = newGain;
+	}
+}
+
+/**
+ * Find the absolute peak in blocks of this many samples; the peak
+ * position is only known with block granularity, which is good
+ * enough for truncating the gain ramp.
+ */
+#define PEAK_BLOCK 64
+
+static float Compressor_peak_float(const float *audio, unsigned int count,
+				   unsigned int *peakPos_r)
+{
+	float peak = 0;
+	unsigned int peakPos = 0;
+	unsigned int i = 0;
+
+#ifdef __ARM_NEON__
+	for (; i + PEAK_BLOCK <= count; i += PEAK_BLOCK)
+	{
+		float32x4_t max = vdupq_n_f32(0);
+		unsigned int j;
+		for (j = 0; j < PEAK_BLOCK; j += 4)
+			max = vmaxq_f32(max, vabsq_f32(vld1q_f32(audio + i + j)));
+
+		float32x2_t max2 = vpmax_f32(vget_low_f32(max),
+					     vget_high_f32(max));
+		max2 = vpmax_f32(max2, max2);
+		const float block_peak = vget_lane_f32(max2, 0);
+		if (block_peak > peak)
+		{
+			peak = block_peak;
+			peakPos = i;
+		}
+	}
+#elif defined(__SSE2__)
+	const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	for (; i + PEAK_BLOCK <= count; i += PEAK_BLOCK)
+	{
+		__m128 max = _mm_setzero_ps();
+		unsigned int j;
+		for (j = 0; j < PEAK_BLOCK; j += 4)
+			max = _mm_max_ps(max,
+					 _mm_and_ps(_mm_loadu_ps(audio + i + j),
+						    abs_mask));
+
+		max = _mm_max_ps(max, _mm_movehl_ps(max, max));
+		max = _mm_max_ss(max, _mm_shuffle_ps(max, max, 1));
+		const float block_peak = _mm_cvtss_f32(max);
+		if (block_peak > peak)
+		{
+			peak = block_peak;
+			peakPos = i;
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		float val = audio[i];
+		if (val < 0)
+			val = -val;
+		if (val > peak)
+		{
+			peak = val;
+			peakPos = i;
+		}
+	}
+
+	*peakPos_r = peakPos;
+	return peak;
+}
+
+/**
+ * Multiply the samples with a linearly changing gain and clip them
+ * to -1..1.
+ */
+static void Compressor_amplify_float(float *audio, unsigned int count,
+				     float gain, float delta)
+{
+	unsigned int i = 0;
+
+#ifdef __ARM_NEON__
+	const float32x4_t one = vdupq_n_f32(1), minus_one = vdupq_n_f32(-1);
+	const float32x4_t delta4 = vdupq_n_f32(4 * delta);
+	float32x4_t g = { gain, gain + delta, gain + 2 * delta,
+			  gain + 3 * delta };
+	for (; i + 4 <= count; i += 4)
+	{
+		float32x4_t x = vmulq_f32(vld1q_f32(audio + i), g);
+		x = vminq_f32(vmaxq_f32(x, minus_one), one);
+		vst1q_f32(audio + i, x);
+		g = vaddq_f32(g, delta4);
+	}
+
+	gain = vgetq_lane_f32(g, 0);
+#elif defined(__SSE2__)
+	const __m128 one = _mm_set1_ps(1), minus_one = _mm_set1_ps(-1);
+	const __m128 delta4 = _mm_set1_ps(4 * delta);
+	__m128 g = _mm_setr_ps(gain, gain + delta, gain + 2 * delta,
+			       gain + 3 * delta);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 x = _mm_mul_ps(_mm_loadu_ps(audio + i), g);
+		x = _mm_min_ps(_mm_max_ps(x, minus_one), one);
+		_mm_storeu_ps(audio + i, x);
+		g = _mm_add_ps(g, delta4);
+	}
+
+	gain = _mm_cvtss_f32(g);
+#endif
+
+	for (; i < count; i++, gain += delta)
+	{
+		float sample = audio[i] * gain;
+		if (sample < -1)
+			sample = -1;
+		else if (sample > 1)
+			sample = 1;
+		audio[i] = sample;
+	}
 }
 
+void Compressor_Process_float(struct Compressor *obj, float *audio,
+			      unsigned int count)
+{
+	unsigned int peakPos;
+	const float peak = Compressor_peak_float(audio, count, &peakPos);
+
+	int peakVal = peak >= 1 ? 32767 : (int)(peak * 32767);
+	unsigned int ramp = count;
+	int curGain;
+	const int newGain = Compressor_updateGain(obj, peakVal, peakPos,
+						  &ramp, &curGain);
+	obj->clipped[obj->pos] = 0;
+
+	if (ramp > count)
+		ramp = count;
+
+	const float cur = curGain / 1024.f, target = newGain / 1024.f;
+
+	/* ramp up (or down) to the new gain, then keep it */
+	Compressor_amplify_float(audio, ramp, cur, (target - cur) / ramp);
+	Compressor_amplify_float(audio + ramp, count - ramp, target, 0);
+}
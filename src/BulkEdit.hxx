@@ -23,18 +23,26 @@
 #include "Partition.hxx"
 
 /**
- * Begin a "bulk edit" and commit it automatically.
+ * Begin a "bulk edit" and commit it automatically.  If a bulk edit
+ * is already in progress (e.g. "add" inside a command list), this
+ * object does nothing, and the outer one commits.
  */
 class ScopeBulkEdit {
 	Partition &partition;
 
+	const bool nested;
+
 public:
-	ScopeBulkEdit(Partition &_partition):partition(_partition) {
-		partition.playlist.BeginBulk();
+	ScopeBulkEdit(Partition &_partition)
+		:partition(_partition),
+		 nested(partition.playlist.IsBulkEdit()) {
+		if (!nested)
+			partition.playlist.BeginBulk();
 	}
 
 	~ScopeBulkEdit() {
-		partition.playlist.CommitBulk(partition.pc);
+		if (!nested)
+			partition.playlist.CommitBulk(partition.pc);
 	}
 };
 
@@ -22,7 +22,10 @@
 
 #include "Compiler.h"
 
+#include <stddef.h>
+
 struct AudioFormat;
+class MixRampEnvelope;
 
 struct CrossFadeSettings {
 	/**
@@ -51,10 +54,11 @@ struct CrossFadeSettings {
 	 * @param total_time total_time the duration of the new song
 	 * @param replay_gain_db the ReplayGain adjustment used for this song
 	 * @param replay_gain_prev_db the ReplayGain adjustment used on the last song
-	 * @param mixramp_start the next songs mixramp_start tag
-	 * @param mixramp_prev_end the last songs mixramp_end setting
+	 * @param mixramp_start the next songs mixramp_start envelope
+	 * @param mixramp_prev_end the last songs mixramp_end envelope
 	 * @param af the audio format of the new song
 	 * @param old_format the audio format of the current song
+	 * @param chunk_size the payload size of each music pipe chunk
 	 * @param max_chunks the maximum number of chunks
 	 * @return the number of chunks for crossfading, or 0 if cross fading
 	 * should be disabled for this song change
@@ -62,9 +66,10 @@ struct CrossFadeSettings {
 	gcc_pure
 	unsigned Calculate(float total_time,
 			   float replay_gain_db, float replay_gain_prev_db,
-			   const char *mixramp_start,
-			   const char *mixramp_prev_end,
+			   const MixRampEnvelope &mixramp_start,
+			   const MixRampEnvelope &mixramp_prev_end,
 			   AudioFormat af, AudioFormat old_format,
+			   size_t chunk_size,
 			   unsigned max_chunks) const;
 };
 
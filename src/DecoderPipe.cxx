@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "DecoderPipe.hxx"
+#include "MusicBuffer.hxx"
+#include "MusicChunk.hxx"
+
+static constexpr unsigned
+RoundUpPowerOfTwo(unsigned n, unsigned result=1)
+{
+	return result >= n ? result : RoundUpPowerOfTwo(n, result << 1);
+}
+
+DecoderPipe::DecoderPipe(unsigned capacity)
+	:mask(RoundUpPowerOfTwo(capacity) - 1),
+	 ring(new MusicChunk *[mask + 1]),
+	 head(0), tail(0)
+{
+	assert(capacity > 0);
+}
+
+DecoderPipe::~DecoderPipe()
+{
+	assert(IsEmpty());
+
+	delete[] ring;
+}
+
+#ifndef NDEBUG
+
+bool
+DecoderPipe::Contains(const MusicChunk *chunk) const
+{
+	const unsigned h = head.load(std::memory_order_relaxed);
+	const unsigned t = tail.load(std::memory_order_acquire);
+
+	for (unsigned i = h; i != t; ++i)
+		if (ring[i & mask] == chunk)
+			return true;
+
+	return false;
+}
+
+#endif
+
+MusicChunk *
+DecoderPipe::Shift()
+{
+	const unsigned h = head.load(std::memory_order_relaxed);
+	if (h == tail.load(std::memory_order_acquire))
+		return nullptr;
+
+	MusicChunk *chunk = ring[h & mask];
+	assert(!chunk->IsEmpty());
+
+	/* publish the free slot to the producer */
+	head.store(h + 1, std::memory_order_release);
+	return chunk;
+}
+
+void
+DecoderPipe::Unshift(MusicChunk *chunk)
+{
+	assert(chunk != nullptr);
+	assert(!chunk->IsEmpty());
+
+	const unsigned h = head.load(std::memory_order_relaxed) - 1;
+	ring[h & mask] = chunk;
+
+	/* the producer cannot be writing to this slot, because the
+	   ring has room for all chunks of the MusicBuffer */
+	head.store(h, std::memory_order_release);
+}
+
+void
+DecoderPipe::Clear(MusicBuffer &buffer)
+{
+	MusicChunk *chunk;
+
+	while ((chunk = Shift()) != nullptr)
+		buffer.Return(chunk);
+}
+
+void
+DecoderPipe::Push(MusicChunk *chunk)
+{
+	assert(!chunk->IsEmpty());
+	assert(chunk->length == 0 || chunk->audio_format.IsValid());
+
+	const unsigned t = tail.load(std::memory_order_relaxed);
+	assert(t - head.load(std::memory_order_acquire) <= mask);
+
+	ring[t & mask] = chunk;
+
+	/* publish the chunk (and its contents) to the consumer */
+	tail.store(t + 1, std::memory_order_release);
+}
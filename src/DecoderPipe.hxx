@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_DECODER_PIPE_HXX
+#define MPD_DECODER_PIPE_HXX
+
+#include "Compiler.h"
+
+#include <atomic>
+
+#include <assert.h>
+
+struct MusicChunk;
+class MusicBuffer;
+
+/**
+ * A queue of #MusicChunk objects which transports decoded chunks
+ * from the decoder thread to the player thread.  Unlike #MusicPipe,
+ * it does not use a mutex: it is a ring buffer with exactly one
+ * producer (the decoder thread calling Push()) and one consumer (the
+ * player thread calling Peek() and Shift()), which synchronize only
+ * with atomic indexes.  This way, the decoder never blocks while the
+ * player thread is busy.
+ *
+ * Clear() may be called by either thread, but only while the other
+ * one is known not to access the pipe (e.g. while the player thread
+ * waits for a #DecoderCommand to finish).
+ */
+class DecoderPipe {
+	/**
+	 * The number of slots in #ring minus one.  The number of
+	 * slots is a power of two, so the (wrapping) counters
+	 * #head and #tail can be masked with this value.  It must be
+	 * at least the size of the #MusicBuffer, which guarantees
+	 * that Push() never finds the ring full.
+	 */
+	const unsigned mask;
+
+	MusicChunk **const ring;
+
+	/**
+	 * The number of chunks which have ever been shifted.
+	 * Modified only by the consumer.
+	 */
+	std::atomic_uint head;
+
+	/**
+	 * The number of chunks which have ever been pushed.
+	 * Modified only by the producer.
+	 */
+	std::atomic_uint tail;
+
+public:
+	/**
+	 * Creates a new #DecoderPipe object.  It is empty.
+	 *
+	 * @param capacity the maximum number of chunks in this pipe
+	 */
+	explicit DecoderPipe(unsigned capacity);
+
+	/**
+	 * Frees the object.  It must be empty now.
+	 */
+	~DecoderPipe();
+
+	DecoderPipe(const DecoderPipe &) = delete;
+	DecoderPipe &operator=(const DecoderPipe &) = delete;
+
+#ifndef NDEBUG
+	/**
+	 * Checks if the specified chunk is enqueued in the music
+	 * pipe.  May only be called by the consumer.
+	 */
+	gcc_pure
+	bool Contains(const MusicChunk *chunk) const;
+#endif
+
+	/**
+	 * Returns the first #MusicChunk from the pipe.  Returns
+	 * nullptr if the pipe is empty.  May only be called by the
+	 * consumer.
+	 */
+	gcc_pure
+	const MusicChunk *Peek() const {
+		const unsigned h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+			return nullptr;
+
+		return ring[h & mask];
+	}
+
+	/**
+	 * Returns the #MusicChunk at the specified position (0 is the
+	 * head).  Returns nullptr if the pipe is not that large.  May
+	 * only be called by the consumer.
+	 */
+	gcc_pure
+	const MusicChunk *PeekAt(unsigned i) const {
+		const unsigned h = head.load(std::memory_order_relaxed);
+		if (i >= tail.load(std::memory_order_acquire) - h)
+			return nullptr;
+
+		return ring[(h + i) & mask];
+	}
+
+	/**
+	 * Removes the first chunk from the head, and returns it.
+	 * May only be called by the consumer.
+	 */
+	MusicChunk *Shift();
+
+	/**
+	 * Inserts a chunk at the head, i.e. undoes Shift().  May only
+	 * be called by the consumer, with a chunk which belongs to
+	 * the same #MusicBuffer, which guarantees that the ring does
+	 * not overflow.
+	 */
+	void Unshift(MusicChunk *chunk);
+
+	/**
+	 * Clears the whole pipe and returns the chunks to the buffer.
+	 *
+	 * @param buffer the buffer object to return the chunks to
+	 */
+	void Clear(MusicBuffer &buffer);
+
+	/**
+	 * Pushes a chunk to the tail of the pipe.  May only be called
+	 * by the producer.
+	 */
+	void Push(MusicChunk *chunk);
+
+	/**
+	 * Returns the number of chunks currently in this pipe.  The
+	 * value may be outdated as soon as this method returns.
+	 */
+	gcc_pure
+	unsigned GetSize() const {
+		const unsigned h = head.load(std::memory_order_acquire);
+		const unsigned t = tail.load(std::memory_order_acquire);
+		return t - h;
+	}
+
+	gcc_pure
+	bool IsEmpty() const {
+		return GetSize() == 0;
+	}
+};
+
+#endif
@@ -27,6 +27,12 @@ DetachedSong::DetachedSong(const LightSong &other)
 	:uri(other.GetURI().c_str()),
 	 real_uri(other.real_uri != nullptr ? other.real_uri : ""),
 	 tag(*other.tag),
+	 replay_gain(other.replay_gain != nullptr
+		     ? *other.replay_gain
+		     : ReplayGainInfo::Undefined()),
+	 mix_ramp(other.mix_ramp != nullptr
+		  ? *other.mix_ramp
+		  : MixRampInfo()),
 	 mtime(other.mtime),
 	 start_ms(other.start_ms), end_ms(other.end_ms) {}
 
@@ -22,6 +22,9 @@
 
 #include "check.h"
 #include "tag/Tag.hxx"
+#include "ReplayGainInfo.hxx"
+#include "MixRampInfo.hxx"
+#include "SongPrintCache.hxx"
 #include "Compiler.h"
 
 #include <string>
@@ -62,6 +65,18 @@ class DetachedSong {
 
 	Tag tag;
 
+	/**
+	 * Replay gain values computed by the database, used when the
+	 * file has no replay gain tags.
+	 */
+	ReplayGainInfo replay_gain;
+
+	/**
+	 * MixRamp envelopes computed by the database, used when the
+	 * file has no MixRamp tags.
+	 */
+	MixRampInfo mix_ramp;
+
 	time_t mtime;
 
 	/**
@@ -75,6 +90,12 @@ class DetachedSong {
 	 */
 	unsigned end_ms;
 
+	/**
+	 * The cached protocol text of this song.  It is cleared by
+	 * all methods which modify a printed attribute.
+	 */
+	mutable SongPrintCache print_cache;
+
 	explicit DetachedSong(const LightSong &other);
 
 public:
@@ -82,20 +103,24 @@ public:
 
 	explicit DetachedSong(const char *_uri)
 		:uri(_uri),
+		 replay_gain(ReplayGainInfo::Undefined()),
 		 mtime(0), start_ms(0), end_ms(0) {}
 
 	explicit DetachedSong(const std::string &_uri)
 		:uri(_uri),
+		 replay_gain(ReplayGainInfo::Undefined()),
 		 mtime(0), start_ms(0), end_ms(0) {}
 
 	explicit DetachedSong(std::string &&_uri)
 		:uri(std::move(_uri)),
+		 replay_gain(ReplayGainInfo::Undefined()),
 		 mtime(0), start_ms(0), end_ms(0) {}
 
 	template<typename U>
 	DetachedSong(U &&_uri, Tag &&_tag)
 		:uri(std::forward<U>(_uri)),
 		 tag(std::move(_tag)),
+		 replay_gain(ReplayGainInfo::Undefined()),
 		 mtime(0), start_ms(0), end_ms(0) {}
 
 	DetachedSong(DetachedSong &&) = default;
@@ -168,26 +193,48 @@ public:
 	}
 
 	Tag &WritableTag() {
+		print_cache.Clear();
 		return tag;
 	}
 
 	void SetTag(const Tag &_tag) {
+		print_cache.Clear();
 		tag = Tag(_tag);
 	}
 
 	void SetTag(Tag &&_tag) {
+		print_cache.Clear();
 		tag = std::move(_tag);
 	}
 
 	void MoveTagFrom(DetachedSong &&other) {
+		print_cache.Clear();
+		other.print_cache.Clear();
 		tag = std::move(other.tag);
 	}
 
+	const ReplayGainInfo &GetReplayGain() const {
+		return replay_gain;
+	}
+
+	void SetReplayGain(const ReplayGainInfo &_value) {
+		replay_gain = _value;
+	}
+
+	const MixRampInfo &GetMixRamp() const {
+		return mix_ramp;
+	}
+
+	void SetMixRamp(const MixRampInfo &_value) {
+		mix_ramp = _value;
+	}
+
 	time_t GetLastModified() const {
 		return mtime;
 	}
 
 	void SetLastModified(time_t _value) {
+		print_cache.Clear();
 		mtime = _value;
 	}
 
@@ -196,6 +243,7 @@ public:
 	}
 
 	void SetStartMS(unsigned _value) {
+		print_cache.Clear();
 		start_ms = _value;
 	}
 
@@ -204,12 +252,21 @@ public:
 	}
 
 	void SetEndMS(unsigned _value) {
+		print_cache.Clear();
 		end_ms = _value;
 	}
 
 	gcc_pure
 	double GetDuration() const;
 
+	/**
+	 * Returns the cached output of song_print_info(); it is
+	 * mutable so the printer can fill it.
+	 */
+	SongPrintCache &GetPrintCache() const {
+		return print_cache;
+	}
+
 	/**
 	 * Update the #tag and #mtime.
 	 *
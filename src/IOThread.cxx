@@ -20,96 +20,173 @@
 #include "config.h"
 #include "IOThread.hxx"
 #include "thread/Mutex.hxx"
-#include "thread/Cond.hxx"
 #include "thread/Thread.hxx"
 #include "thread/Name.hxx"
+#include "thread/Scheduling.hxx"
 #include "event/Loop.hxx"
 #include "system/FatalError.hxx"
 #include "util/Error.hxx"
 
+#include <atomic>
+
 #include <assert.h>
+#include <stdio.h>
+
+/**
+ * The upper limit for "io_threads".
+ */
+static constexpr unsigned MAX_IO_THREADS = 64;
+
+struct IOThread {
+	EventLoop loop;
+	Thread thread;
+};
 
 static struct {
 	Mutex mutex;
-	Cond cond;
 
-	EventLoop *loop;
-	Thread thread;
+	IOThread *threads;
+	unsigned n;
+
+	/**
+	 * The index of the #IOThread which io_thread_next() will
+	 * return next.
+	 */
+	std::atomic<unsigned> next;
 } io;
 
 void
 io_thread_run(void)
 {
 	assert(io_thread_inside());
-	assert(io.loop != nullptr);
+	assert(io.threads != nullptr);
 
-	io.loop->Run();
+	io.threads[0].loop.Run();
 }
 
 static void
-io_thread_func(gcc_unused void *arg)
+io_thread_func(void *arg)
 {
-	SetThreadName("io");
+	IOThread &t = *(IOThread *)arg;
+	const unsigned i = &t - io.threads;
+
+	if (i == 0)
+		SetThreadName("io");
+	else {
+		char name[16];
+		snprintf(name, sizeof(name), "io%u", i);
+		SetThreadName(name);
+	}
+
+	thread_scheduling_apply("io");
 
 	/* lock+unlock to synchronize with io_thread_start(), to be
-	   sure that io.thread is set */
+	   sure that t.thread is set */
 	io.mutex.lock();
 	io.mutex.unlock();
 
-	io_thread_run();
+	t.loop.Run();
 }
 
 void
-io_thread_init(void)
+io_thread_init(unsigned n)
 {
-	assert(io.loop == nullptr);
-	assert(!io.thread.IsDefined());
+	assert(io.threads == nullptr);
+	assert(n > 0);
+
+	if (n > MAX_IO_THREADS)
+		n = MAX_IO_THREADS;
 
-	io.loop = new EventLoop();
+	io.threads = new IOThread[n];
+	io.n = n;
+	io.next = 0;
 }
 
 void
 io_thread_start()
 {
-	assert(io.loop != nullptr);
-	assert(!io.thread.IsDefined());
+	assert(io.threads != nullptr);
 
 	const ScopeLock protect(io.mutex);
 
-	Error error;
-	if (!io.thread.Start(io_thread_func, nullptr, error))
-		FatalError(error);
+	for (unsigned i = 0; i < io.n; ++i) {
+		IOThread &t = io.threads[i];
+		assert(!t.thread.IsDefined());
+
+		Error error;
+		if (!t.thread.Start(io_thread_func, &t, error))
+			FatalError(error);
+	}
 }
 
 void
 io_thread_quit(void)
 {
-	assert(io.loop != nullptr);
+	assert(io.threads != nullptr);
 
-	io.loop->Break();
+	for (unsigned i = 0; i < io.n; ++i)
+		io.threads[i].loop.Break();
 }
 
 void
 io_thread_deinit(void)
 {
-	if (io.thread.IsDefined()) {
-		io_thread_quit();
-		io.thread.Join();
-	}
+	if (io.threads == nullptr)
+		return;
+
+	io_thread_quit();
 
-	delete io.loop;
+	for (unsigned i = 0; i < io.n; ++i)
+		if (io.threads[i].thread.IsDefined())
+			io.threads[i].thread.Join();
+
+	delete[] io.threads;
+	io.threads = nullptr;
+}
+
+unsigned
+io_thread_count()
+{
+	assert(io.threads != nullptr);
+
+	return io.n;
 }
 
 EventLoop &
 io_thread_get()
 {
-	assert(io.loop != nullptr);
+	assert(io.threads != nullptr);
+
+	return io.threads[0].loop;
+}
+
+EventLoop &
+io_thread_get(unsigned i)
+{
+	assert(io.threads != nullptr);
+	assert(i < io.n);
 
-	return *io.loop;
+	return io.threads[i].loop;
+}
+
+EventLoop &
+io_thread_next()
+{
+	assert(io.threads != nullptr);
+
+	return io.threads[io.next.fetch_add(1, std::memory_order_relaxed)
+			  % io.n].loop;
 }
 
 bool
 io_thread_inside(void)
 {
-	return io.thread.IsInside();
+	if (io.threads == nullptr)
+		return false;
+
+	for (unsigned i = 0; i < io.n; ++i)
+		if (io.threads[i].thread.IsInside())
+			return true;
+
+	return false;
 }
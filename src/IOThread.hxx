@@ -24,14 +24,20 @@
 
 class EventLoop;
 
+/**
+ * Create the I/O event loops.  Each one gets its own thread in
+ * io_thread_start().
+ *
+ * @param n the number of I/O threads (configured with "io_threads")
+ */
 void
-io_thread_init(void);
+io_thread_init(unsigned n=1);
 
 void
 io_thread_start();
 
 /**
- * Run the I/O event loop synchronously in the current thread.  This
+ * Run the first I/O event loop synchronously in the current thread.  This
  * can be called instead of io_thread_start().  For testing purposes
  * only.
  */
@@ -39,7 +45,7 @@ void
 io_thread_run(void);
 
 /**
- * Ask the I/O thread to quit, but does not wait for it.  Usually, you
+ * Ask the I/O threads to quit, but does not wait for it.  Usually, you
  * don't need to call this function, because io_thread_deinit()
  * includes this.
  */
@@ -49,12 +55,36 @@ io_thread_quit(void);
 void
 io_thread_deinit(void);
 
-gcc_const
+gcc_pure
+unsigned
+io_thread_count();
+
+/**
+ * Returns the first I/O event loop.  It hosts the singletons which
+ * are shared by all streams (NFS, UPnP, neighbor plugins).
+ */
+gcc_pure
 EventLoop &
 io_thread_get();
 
 /**
- * Is the current thread the I/O thread?
+ * Returns the I/O event loop with the given index (less than
+ * io_thread_count()).
+ */
+gcc_pure
+EventLoop &
+io_thread_get(unsigned i);
+
+/**
+ * Returns one of the I/O event loops, round-robin.  Use this for
+ * objects which do not depend on others, to spread the load over
+ * all I/O threads.  This function is thread-safe.
+ */
+EventLoop &
+io_thread_next();
+
+/**
+ * Is the current thread one of the I/O threads?
  */
 gcc_pure
 bool
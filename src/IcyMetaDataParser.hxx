@@ -68,6 +68,31 @@ public:
 	 */
 	size_t Data(size_t length);
 
+	/**
+	 * Returns the number of bytes of normal data which may be
+	 * read before the next metadata block, but not more than
+	 * "length".  Unlike Data(), this does not consume anything.
+	 * Returns 0 if the caller shall invoke Meta() now.
+	 */
+	size_t GetDataAvailable(size_t length) const {
+		if (!IsDefined() || length < data_rest)
+			return length;
+
+		return data_rest;
+	}
+
+	/**
+	 * Returns the number of bytes which Meta() will consume in
+	 * the current metadata block.  Only valid if
+	 * GetDataAvailable() has returned 0.
+	 */
+	size_t GetMetaRest() const {
+		return meta_size == 0
+			/* the length byte */
+			? 1
+			: meta_size - meta_position;
+	}
+
 	/**
 	 * Reads metadata from the stream.  Returns the number of bytes
 	 * consumed.  If the return value is smaller than "length", the caller
@@ -75,13 +100,6 @@ public:
 	 */
 	size_t Meta(const void *data, size_t length);
 
-	/**
-	 * Parse data and eliminate metadata.
-	 *
-	 * @return the number of data bytes remaining in the buffer
-	 */
-	size_t ParseInPlace(void *data, size_t length);
-
 	Tag *ReadTag() {
 		Tag *result = tag;
 		tag = nullptr;
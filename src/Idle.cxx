@@ -47,6 +47,7 @@ static const char *const idle_names[] = {
 	"message",
 	"neighbor",
 	"mount",
+	"level",
 	nullptr
 };
 
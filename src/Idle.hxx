@@ -67,6 +67,10 @@ static constexpr unsigned IDLE_NEIGHBOR = 0x800;
 /** the mount list has changed */
 static constexpr unsigned IDLE_MOUNT = 0x1000;
 
+/** new peak/RMS levels of the audio outputs are available; this
+    event is only sent to clients which subscribe to it explicitly */
+static constexpr unsigned IDLE_LEVEL = 0x2000;
+
 /**
  * Adds idle flag (with bitwise "or") and queues notifications to all
  * clients.
@@ -23,9 +23,13 @@
 #include "Idle.hxx"
 #include "Stats.hxx"
 
+#include <assert.h>
+#include <string.h>
+
 #ifdef ENABLE_DATABASE
 #include "db/DatabaseError.hxx"
 #include "db/LightSong.hxx"
+#include "db/QueryCache.hxx"
 
 #ifdef ENABLE_SQLITE
 #include "sticker/StickerDatabase.hxx"
@@ -42,16 +46,46 @@ Instance::GetDatabase(Error &error)
 
 #endif
 
+Partition *
+Instance::FindPartition(const char *name) const
+{
+	for (auto *p : partitions)
+		if (p->name == name)
+			return p;
+
+	return nullptr;
+}
+
+Partition &
+Instance::CreatePartition(const char *name)
+{
+	assert(partition != nullptr);
+	assert(FindPartition(name) == nullptr);
+
+	const PlayerControl &pc = partition->pc;
+	Partition *p = new Partition(*this, name,
+				     partition->playlist.queue.max_length,
+				     pc.buffer_chunks,
+				     pc.buffer_chunk_size,
+				     pc.buffered_before_play,
+				     pc.buffer_adaptive);
+	p->outputs.Configure(*event_loop, p->pc, name);
+	partitions.push_back(p);
+	return *p;
+}
+
 void
 Instance::TagModified()
 {
-	partition->TagModified();
+	for (auto *p : partitions)
+		p->TagModified();
 }
 
 void
 Instance::SyncWithPlayer()
 {
-	partition->SyncWithPlayer();
+	for (auto *p : partitions)
+		p->SyncWithPlayer();
 }
 
 #ifdef ENABLE_DATABASE
@@ -64,7 +98,10 @@ Instance::OnDatabaseModified()
 	/* propagate the change to all subsystems */
 
 	stats_invalidate();
-	partition->DatabaseModified(*database);
+	if (query_cache != nullptr)
+		query_cache->Clear();
+	for (auto *p : partitions)
+		p->DatabaseModified(*database);
 	idle_add(IDLE_DATABASE);
 }
 
@@ -80,7 +117,21 @@ Instance::OnDatabaseSongRemoved(const LightSong &song)
 #endif
 
 	const auto uri = song.GetURI();
-	partition->DeleteSong(uri.c_str());
+	for (auto *p : partitions)
+		p->DeleteSong(uri.c_str());
+}
+
+void
+Instance::OnDatabaseSongMoved(gcc_unused const char *old_uri,
+			      gcc_unused const char *new_uri)
+{
+	assert(database != nullptr);
+
+#ifdef ENABLE_SQLITE
+	/* keep ratings and play counts */
+	if (sticker_enabled())
+		sticker_song_move(old_uri, new_uri);
+#endif
 }
 
 #endif
@@ -23,6 +23,8 @@
 #include "check.h"
 #include "Compiler.h"
 
+#include <list>
+
 #ifdef ENABLE_NEIGHBOR_PLUGINS
 #include "neighbor/Listener.hxx"
 class NeighborGlue;
@@ -33,6 +35,7 @@ class NeighborGlue;
 class Database;
 class Storage;
 class UpdateService;
+class QueryCache;
 #endif
 
 class EventLoop;
@@ -70,16 +73,34 @@ struct Instance final
 	Storage *storage;
 
 	UpdateService *update;
+
+	/**
+	 * Responses of recent database commands; nullptr if
+	 * disabled.
+	 */
+	QueryCache *query_cache;
 #endif
 
 	ClientList *client_list;
 
+	/**
+	 * The default partition.  It is also the first element of
+	 * #partitions.
+	 */
 	Partition *partition;
 
+	/**
+	 * All partitions.  They share the database, the storage and
+	 * the #EventLoop, but each one has its own queue, player
+	 * thread and audio outputs.
+	 */
+	std::list<Partition *> partitions;
+
 	Instance() {
 #ifdef ENABLE_DATABASE
 		storage = nullptr;
 		update = nullptr;
+		query_cache = nullptr;
 #endif
 	}
 
@@ -92,6 +113,21 @@ struct Instance final
 	Database *GetDatabase(Error &error);
 #endif
 
+	/**
+	 * Find a partition by its name.  Returns nullptr if there is
+	 * no such partition.
+	 */
+	gcc_pure
+	Partition *FindPartition(const char *name) const;
+
+	/**
+	 * Create a new partition with the same settings as the
+	 * default partition, and assign all audio outputs which are
+	 * configured for it.  The caller is responsible for starting
+	 * its player thread.
+	 */
+	Partition &CreatePartition(const char *name);
+
 	/**
 	 * A tag in the play queue has been modified by the player
 	 * thread.  Propagate the change to all subsystems.
@@ -107,6 +143,8 @@ private:
 #ifdef ENABLE_DATABASE
 	virtual void OnDatabaseModified() override;
 	virtual void OnDatabaseSongRemoved(const LightSong &song) override;
+	virtual void OnDatabaseSongMoved(const char *old_uri,
+					 const char *new_uri) override;
 #endif
 
 #ifdef ENABLE_NEIGHBOR_PLUGINS
@@ -29,6 +29,9 @@
 void
 LogFormatV(const Domain &domain, LogLevel level, const char *fmt, va_list ap)
 {
+	if (!IsLogEnabled(level))
+		return;
+
 	char msg[1024];
 	vsnprintf(msg, sizeof(msg), fmt, ap);
 	Log(domain, level, msg);
@@ -26,6 +26,15 @@
 class Error;
 class Domain;
 
+/**
+ * Would a message with the specified level be logged?  The Format*()
+ * functions check this before formatting, so debug messages cost
+ * little when they are disabled.
+ */
+gcc_pure
+bool
+IsLogEnabled(LogLevel level);
+
 void
 Log(const Domain &domain, LogLevel level, const char *msg);
 
@@ -22,11 +22,15 @@
 #include "Log.hxx"
 #include "util/Domain.hxx"
 #include "util/StringUtil.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
 
 #ifdef HAVE_GLIB
 #include <glib.h>
 #endif
 
+#include <atomic>
+
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
@@ -61,10 +65,22 @@ ToAndroidLogLevel(LogLevel log_level)
 	gcc_unreachable();
 }
 
+bool
+IsLogEnabled(gcc_unused LogLevel level)
+{
+	return true;
+}
+
 #else
 
 static LogLevel log_threshold = LogLevel::INFO;
 
+bool
+IsLogEnabled(LogLevel level)
+{
+	return level >= log_threshold;
+}
+
 #ifdef HAVE_GLIB
 static const char *log_charset;
 #endif
@@ -102,12 +118,14 @@ EnableLogTimestamp()
 	enable_timestamp = true;
 }
 
-static const char *log_date(void)
+static constexpr size_t LOG_DATE_BUF_SIZE = 16;
+
+static const char *
+log_date(char *buf, time_t t)
 {
-	static constexpr size_t LOG_DATE_BUF_SIZE = 16;
-	static char buf[LOG_DATE_BUF_SIZE];
-	time_t t = time(nullptr);
-	strftime(buf, LOG_DATE_BUF_SIZE, "%b %d %H:%M : ", localtime(&t));
+	struct tm tm;
+	strftime(buf, LOG_DATE_BUF_SIZE, "%b %d %H:%M : ",
+		 localtime_r(&t, &tm));
 	return buf;
 }
 
@@ -173,7 +191,7 @@ LogFinishSysLog()
 #endif
 
 static void
-FileLog(const Domain &domain, const char *message)
+FileLog(const Domain &domain, const char *message, time_t t)
 {
 #ifdef HAVE_GLIB
 	char *converted;
@@ -189,8 +207,9 @@ FileLog(const Domain &domain, const char *message)
 		converted = nullptr;
 #endif
 
+	char date_buf[LOG_DATE_BUF_SIZE];
 	fprintf(stderr, "%s%s: %.*s\n",
-		enable_timestamp ? log_date() : "",
+		enable_timestamp ? log_date(date_buf, t) : "",
 		domain.GetName(),
 		chomp_length(message), message);
 
@@ -199,6 +218,273 @@ FileLog(const Domain &domain, const char *message)
 #endif
 }
 
+static void
+WriteLog(const Domain &domain, LogLevel level, const char *msg, time_t t)
+{
+#ifdef HAVE_SYSLOG
+	if (enable_syslog) {
+		(void)t;
+		SysLog(domain, level, msg);
+		return;
+	}
+#else
+	(void)level;
+#endif
+
+	FileLog(domain, msg, t);
+}
+
+/*
+ * The asynchronous mode: Log() copies the message into a slot of a
+ * lock-free ring buffer, and the log writer thread (see
+ * LogRunWriter()) writes it.  This way, a slow log file or syslog
+ * socket never blocks the calling thread.  The ring is a bounded
+ * multi-producer queue; each slot has a sequence number which tells
+ * whether it is free (equal to the position) or filled (position + 1).
+ * Messages which do not fit into a slot are written synchronously.
+ */
+
+static constexpr Domain log_backend_domain("log");
+
+static constexpr unsigned LOG_RING_SIZE = 256;
+
+struct LogSlot {
+	std::atomic_uint sequence;
+
+	const Domain *domain;
+	LogLevel level;
+	time_t time;
+
+	char message[1024];
+};
+
+static LogSlot log_ring[LOG_RING_SIZE];
+
+static struct {
+	/**
+	 * Protects only the sleeps of the writer thread.
+	 */
+	Mutex mutex;
+	Cond cond;
+
+	/**
+	 * Does Log() enqueue messages?
+	 */
+	std::atomic_bool enabled;
+
+	bool quit;
+
+	/**
+	 * Set by the writer thread before it waits for #cond.  A
+	 * producer which clears it must signal #cond.
+	 */
+	std::atomic_bool sleeping;
+
+	/**
+	 * The number of producers inside EnqueueLog() which have
+	 * seen #enabled set.  The writer thread waits for it to drop
+	 * to zero before the final flush, or else a slot claimed
+	 * after the flush would never be written.  The last producer
+	 * signals #cond if #enabled has been cleared.
+	 */
+	std::atomic_uint producers;
+
+	/**
+	 * The next position to be filled by a producer.
+	 */
+	std::atomic_uint enqueue_position;
+
+	/**
+	 * The next position to be written by the writer thread.
+	 */
+	unsigned dequeue_position;
+
+	/**
+	 * The number of messages which were discarded because the
+	 * ring was full.
+	 */
+	std::atomic_uint dropped;
+} log_queue;
+
+void
+LogEnableAsync()
+{
+	assert(!log_queue.enabled);
+
+	for (unsigned i = 0; i < LOG_RING_SIZE; ++i)
+		log_ring[i].sequence.store(i, std::memory_order_relaxed);
+
+	log_queue.enqueue_position.store(0, std::memory_order_relaxed);
+	log_queue.dequeue_position = 0;
+	log_queue.dropped.store(0, std::memory_order_relaxed);
+	log_queue.producers = 0;
+	log_queue.sleeping = false;
+	log_queue.quit = false;
+	log_queue.enabled = true;
+}
+
+void
+LogDisableAsync()
+{
+	const ScopeLock protect(log_queue.mutex);
+	log_queue.quit = true;
+	log_queue.cond.signal();
+}
+
+static void
+LeaveLogProducer()
+{
+	if (log_queue.producers.fetch_sub(1) == 1 && !log_queue.enabled) {
+		/* wake up LogRunWriter() waiting for the final
+		   flush */
+		const ScopeLock protect(log_queue.mutex);
+		log_queue.cond.signal();
+	}
+}
+
+/**
+ * Copy a message into the ring.
+ *
+ * @return false if the caller must write the message synchronously
+ * (asynchronous mode is disabled or the message does not fit into a
+ * slot), true if it was enqueued or dropped because the ring is full
+ */
+static bool
+EnqueueLog(const Domain &domain, LogLevel level, const char *msg)
+{
+	if (!log_queue.enabled)
+		return false;
+
+	const size_t length = strlen(msg);
+	if (length >= sizeof(LogSlot::message))
+		return false;
+
+	/* register as producer first, then check again: either
+	   LogRunWriter() waits for us, or we see that it has already
+	   disabled the queue */
+	log_queue.producers.fetch_add(1);
+	if (!log_queue.enabled) {
+		LeaveLogProducer();
+		return false;
+	}
+
+	unsigned position =
+		log_queue.enqueue_position.load(std::memory_order_relaxed);
+	LogSlot *slot;
+
+	while (true) {
+		slot = &log_ring[position % LOG_RING_SIZE];
+		const unsigned sequence =
+			slot->sequence.load(std::memory_order_acquire);
+		const int diff = int(sequence - position);
+
+		if (diff == 0) {
+			if (log_queue.enqueue_position
+			    .compare_exchange_weak(position, position + 1,
+						   std::memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			/* the ring is full */
+			log_queue.dropped.fetch_add(1,
+						    std::memory_order_relaxed);
+			LeaveLogProducer();
+			return true;
+		} else
+			position = log_queue.enqueue_position
+				.load(std::memory_order_relaxed);
+	}
+
+	slot->domain = &domain;
+	slot->level = level;
+	slot->time = enable_timestamp ? time(nullptr) : 0;
+	memcpy(slot->message, msg, length + 1);
+
+	/* publish the slot to the writer thread */
+	slot->sequence.store(position + 1);
+
+	if (log_queue.sleeping.exchange(false)) {
+		const ScopeLock protect(log_queue.mutex);
+		log_queue.cond.signal();
+	}
+
+	LeaveLogProducer();
+	return true;
+}
+
+/**
+ * Write the oldest message in the ring.  Called only by the writer
+ * thread.
+ *
+ * @return false if the ring is empty
+ */
+static bool
+DequeueLog()
+{
+	const unsigned position = log_queue.dequeue_position;
+	LogSlot &slot = log_ring[position % LOG_RING_SIZE];
+	if (slot.sequence.load() != position + 1)
+		return false;
+
+	WriteLog(*slot.domain, slot.level, slot.message, slot.time);
+
+	/* hand the slot back to the producers */
+	slot.sequence.store(position + LOG_RING_SIZE,
+			    std::memory_order_release);
+	++log_queue.dequeue_position;
+
+	const unsigned dropped =
+		log_queue.dropped.exchange(0, std::memory_order_relaxed);
+	if (dropped > 0) {
+		char buffer[64];
+		snprintf(buffer, sizeof(buffer),
+			 "%u log messages dropped", dropped);
+		WriteLog(log_backend_domain, LogLevel::WARNING, buffer,
+			 enable_timestamp ? time(nullptr) : 0);
+	}
+
+	return true;
+}
+
+void
+LogRunWriter()
+{
+	assert(log_queue.enabled);
+
+	while (true) {
+		while (DequeueLog()) {}
+
+		log_queue.sleeping = true;
+
+		/* check again, a producer may have missed the flag */
+		if (DequeueLog()) {
+			log_queue.sleeping = false;
+			continue;
+		}
+
+		const ScopeLock protect(log_queue.mutex);
+		while (log_queue.sleeping && !log_queue.quit)
+			log_queue.cond.wait(log_queue.mutex);
+
+		if (log_queue.quit)
+			break;
+	}
+
+	/* from now on, Log() writes synchronously; wait for the
+	   producers which have already claimed a slot, and flush the
+	   remaining messages */
+	log_queue.enabled = false;
+
+	{
+		const ScopeLock protect(log_queue.mutex);
+		while (log_queue.producers > 0)
+			log_queue.cond.wait(log_queue.mutex);
+	}
+
+	while (DequeueLog()) {}
+
+	log_queue.sleeping = false;
+}
+
 #endif /* !ANDROID */
 
 void
@@ -212,13 +498,13 @@ Log(const Domain &domain, LogLevel level, const char *msg)
 	if (level < log_threshold)
 		return;
 
-#ifdef HAVE_SYSLOG
-	if (enable_syslog) {
-		SysLog(domain, level, msg);
+	/* errors are written right away, because they may be
+	   followed by exit(); if the ring is full, the message is
+	   dropped (and counted) instead of blocking the caller */
+	if (level < LogLevel::ERROR && EnqueueLog(domain, level, msg))
 		return;
-	}
-#endif
 
-	FileLog(domain, msg);
+	WriteLog(domain, level, msg,
+		 enable_timestamp ? time(nullptr) : 0);
 #endif /* !ANDROID */
 }
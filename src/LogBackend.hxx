@@ -42,4 +42,29 @@ LogInitSysLog();
 void
 LogFinishSysLog();
 
+/**
+ * Switch to the asynchronous mode: Log() copies messages into a
+ * lock-free ring buffer instead of writing them, and a dedicated
+ * thread must call LogRunWriter().  Errors are still written
+ * synchronously.  Messages which do not fit into the ring are
+ * dropped and counted; messages which are too long for one of its
+ * slots (1 kB) are written synchronously.
+ */
+void
+LogEnableAsync();
+
+/**
+ * The body of the log writer thread.  It returns after
+ * LogDisableAsync() has been called, when all pending messages have
+ * been written; after that, Log() is synchronous again.
+ */
+void
+LogRunWriter();
+
+/**
+ * Ask LogRunWriter() to return.
+ */
+void
+LogDisableAsync();
+
 #endif /* LOG_H */
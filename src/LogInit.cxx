@@ -29,6 +29,8 @@
 #include "fs/FileSystem.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
 #include "system/FatalError.hxx"
 
 #ifdef HAVE_GLIB
@@ -249,3 +251,45 @@ int cycle_log_files(void)
 	return 0;
 #endif
 }
+
+#ifndef ANDROID
+static Thread log_thread;
+
+static void
+log_thread_func(gcc_unused void *ctx)
+{
+	SetThreadName("log");
+
+	LogRunWriter();
+}
+#endif
+
+void
+log_thread_start()
+{
+#ifndef ANDROID
+	assert(!log_thread.IsDefined());
+
+	LogEnableAsync();
+
+	Error error;
+	if (!log_thread.Start(log_thread_func, nullptr, error)) {
+		/* not fatal: keep logging synchronously */
+		LogDisableAsync();
+		LogRunWriter();
+		LogError(error);
+	}
+#endif
+}
+
+void
+log_thread_stop()
+{
+#ifndef ANDROID
+	if (!log_thread.IsDefined())
+		return;
+
+	LogDisableAsync();
+	log_thread.Join();
+#endif
+}
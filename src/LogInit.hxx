@@ -41,6 +41,17 @@ log_deinit(void);
 
 void setup_log_output(bool use_stdout);
 
+/**
+ * Start the thread which writes log messages, so other threads never
+ * block on the log file or the syslog socket.  Must be called after
+ * setup_log_output() (i.e. after daemonizing).
+ */
+void
+log_thread_start();
+
+void
+log_thread_stop();
+
 int cycle_log_files(void);
 
 #endif /* LOG_H */
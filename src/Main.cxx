@@ -31,6 +31,7 @@
 #include "Listen.hxx"
 #include "client/Client.hxx"
 #include "client/ClientList.hxx"
+#include "client/ClientWorker.hxx"
 #include "command/AllCommands.hxx"
 #include "Partition.hxx"
 #include "tag/TagConfig.hxx"
@@ -44,9 +45,11 @@
 #include "IOThread.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "fs/Config.hxx"
+#include "fs/io/BackgroundWriter.hxx"
 #include "playlist/PlaylistRegistry.hxx"
 #include "zeroconf/ZeroconfGlue.hxx"
 #include "decoder/DecoderList.hxx"
+#include "decoder/SeekIndex.hxx"
 #include "AudioConfig.hxx"
 #include "pcm/PcmConvert.hxx"
 #include "unix/SignalHandlers.hxx"
@@ -57,6 +60,7 @@
 #include "util/Domain.hxx"
 #include "thread/Id.hxx"
 #include "thread/Slack.hxx"
+#include "thread/Scheduling.hxx"
 #include "lib/icu/Init.hxx"
 #include "config/ConfigGlobal.hxx"
 #include "config/ConfigData.hxx"
@@ -64,9 +68,12 @@
 #include "config/ConfigOption.hxx"
 #include "config/ConfigError.hxx"
 #include "Stats.hxx"
+#include "SongPrintCache.hxx"
+#include "art/ArtCache.hxx"
 
 #ifdef ENABLE_DATABASE
 #include "db/update/Service.hxx"
+#include "db/QueryCache.hxx"
 #include "db/Configured.hxx"
 #include "db/DatabasePlugin.hxx"
 #include "db/plugins/simple/SimpleDatabasePlugin.hxx"
@@ -75,6 +82,9 @@
 #ifdef ENABLE_INOTIFY
 #include "db/update/InotifyUpdate.hxx"
 #endif
+#ifdef ENABLE_FANOTIFY
+#include "db/update/FanotifyUpdate.hxx"
+#endif
 #endif
 
 #ifdef ENABLE_NEIGHBOR_PLUGINS
@@ -219,6 +229,11 @@ glue_db_init_and_load(void)
 	if (!instance->database->Open(error))
 		FatalError(error);
 
+	const unsigned query_cache_size =
+		config_get_unsigned(CONF_QUERY_CACHE_SIZE, 0);
+	if (query_cache_size > 0)
+		instance->query_cache = new QueryCache(query_cache_size * 1024);
+
 	if (!instance->database->IsPlugin(simple_db_plugin))
 		return true;
 
@@ -255,11 +270,29 @@ glue_sticker_init(void)
 		return;
 	}
 
-	if (!sticker_global_init(std::move(sticker_file), error))
+	if (!sticker_global_init(*instance->event_loop,
+				 std::move(sticker_file), error))
 		FatalError(error);
 #endif
 }
 
+/**
+ * Load the seek index, if a file has been configured.
+ */
+static void
+glue_seek_index_init()
+{
+	Error error;
+	auto path = config_get_path(CONF_SEEK_INDEX_FILE, error);
+	if (path.IsNull()) {
+		if (error.IsDefined())
+			FatalError(error);
+		return;
+	}
+
+	seek_index_global_init(std::move(path));
+}
+
 static bool
 glue_state_file_init(Error &error)
 {
@@ -331,7 +364,19 @@ initialize_decoder_and_player(void)
 
 	buffer_size *= 1024;
 
-	const unsigned buffered_chunks = buffer_size / CHUNK_SIZE;
+	const size_t chunk_size =
+		config_get_positive(CONF_AUDIO_BUFFER_CHUNK_SIZE, CHUNK_SIZE);
+	if (chunk_size < MIN_CHUNK_SIZE || chunk_size > MAX_CHUNK_SIZE)
+		FormatFatalError("audio_buffer_chunk_size must be between "
+				 "%lu and %lu bytes",
+				 (unsigned long)MIN_CHUNK_SIZE,
+				 (unsigned long)MAX_CHUNK_SIZE);
+
+	const unsigned buffered_chunks = buffer_size / chunk_size;
+	if (buffered_chunks == 0)
+		FormatFatalError("buffer size \"%lu\" is smaller than "
+				 "one chunk",
+				 (unsigned long)buffer_size);
 
 	if (buffered_chunks >= 1 << 15)
 		FormatFatalError("buffer size \"%lu\" is too big",
@@ -359,10 +404,35 @@ initialize_decoder_and_player(void)
 		config_get_positive(CONF_MAX_PLAYLIST_LENGTH,
 				    DEFAULT_PLAYLIST_MAX_LENGTH);
 
-	instance->partition = new Partition(*instance,
+	instance->partition = new Partition(*instance, "default",
 					    max_length,
 					    buffered_chunks,
-					    buffered_before_play);
+					    chunk_size,
+					    buffered_before_play,
+					    config_get_bool(CONF_AUDIO_BUFFER_ADAPTIVE,
+							    false));
+	instance->partitions.push_back(instance->partition);
+}
+
+/**
+ * Configure the audio outputs of the default partition, and create
+ * all other partitions which are referenced by an "audio_output"
+ * block.
+ */
+static void
+initPartitionOutputs()
+{
+	instance->partition->outputs.Configure(*instance->event_loop,
+					       instance->partition->pc,
+					       "default");
+
+	for (const config_param *param = config_get_param(CONF_AUDIO_OUTPUT);
+	     param != nullptr; param = param->next) {
+		const char *name = param->GetBlockValue("partition",
+							"default");
+		if (instance->FindPartition(name) == nullptr)
+			instance->CreatePartition(name);
+	}
 }
 
 /**
@@ -440,7 +510,6 @@ int mpd_main(int argc, char *argv[])
 	}
 
 	winsock_init();
-	io_thread_init();
 	config_global_init();
 
 #ifdef ANDROID
@@ -479,6 +548,13 @@ int mpd_main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
+	if (!thread_scheduling_global_init(error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+	io_thread_init(config_get_positive(CONF_IO_THREADS, 1));
+
 	instance = new Instance();
 	instance->event_loop = new EventLoop();
 
@@ -543,12 +619,14 @@ int mpd_main(int argc, char *argv[])
 #endif
 
 	glue_sticker_init();
+	glue_seek_index_init();
 
 	command_init();
 	initAudioConfig();
-	instance->partition->outputs.Configure(*instance->event_loop,
-					       instance->partition->pc);
+	initPartitionOutputs();
 	client_manager_init();
+	SongPrintCache::SetMaxSize(config_get_unsigned(CONF_SONG_PRINT_CACHE_SIZE,
+						       0) * 1024);
 	replay_gain_global_init();
 
 	if (!input_stream_global_init(error)) {
@@ -558,6 +636,11 @@ int mpd_main(int argc, char *argv[])
 
 	playlist_list_global_init();
 
+	if (!art_cache_init(error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
 #ifndef ANDROID
 	daemonize_commit();
 
@@ -566,7 +649,14 @@ int mpd_main(int argc, char *argv[])
 	SignalHandlersInit(*instance->event_loop);
 #endif
 
+	log_thread_start();
 	io_thread_start();
+	background_writer_init();
+
+	if (!client_worker_init(*instance->event_loop, error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
 
 #ifdef ENABLE_NEIGHBOR_PLUGINS
 	if (instance->neighbors != nullptr &&
@@ -574,9 +664,10 @@ int mpd_main(int argc, char *argv[])
 		FatalError(error);
 #endif
 
-	ZeroconfInit(*instance->event_loop);
+	ZeroconfInit();
 
-	StartPlayerThread(instance->partition->pc);
+	for (auto *partition : instance->partitions)
+		StartPlayerThread(partition->pc);
 
 #ifdef ENABLE_DATABASE
 	if (create_db) {
@@ -593,18 +684,31 @@ int mpd_main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
-	instance->partition->outputs.SetReplayGainMode(replay_gain_get_real_mode(instance->partition->playlist.queue.random));
+	for (auto *partition : instance->partitions)
+		partition->outputs.SetReplayGainMode(replay_gain_get_real_mode(partition->playlist.queue.random));
 
 #ifdef ENABLE_DATABASE
 	if (config_get_bool(CONF_AUTO_UPDATE, false)) {
 #ifdef ENABLE_INOTIFY
 		if (instance->storage != nullptr &&
-		    instance->update != nullptr)
-			mpd_inotify_init(*instance->event_loop,
-					 *instance->storage,
-					 *instance->update,
-					 config_get_unsigned(CONF_AUTO_UPDATE_DEPTH,
-							     INT_MAX));
+		    instance->update != nullptr) {
+			const unsigned max_depth =
+				config_get_unsigned(CONF_AUTO_UPDATE_DEPTH,
+						    INT_MAX);
+
+#ifdef ENABLE_FANOTIFY
+			if (!config_get_bool(CONF_AUTO_UPDATE_FANOTIFY,
+					     false) ||
+			    !mpd_fanotify_init(*instance->event_loop,
+					       *instance->storage,
+					       *instance->update,
+					       max_depth))
+#endif
+				mpd_inotify_init(*instance->event_loop,
+						 *instance->storage,
+						 *instance->update,
+						 max_depth);
+		}
 #else
 		FormatWarning(main_domain,
 			      "inotify: auto_update was disabled. enable during compilation phase");
@@ -616,7 +720,8 @@ int mpd_main(int argc, char *argv[])
 
 	/* enable all audio outputs (if not already done by
 	   playlist_state_restore() */
-	instance->partition->pc.UpdateAudio();
+	for (auto *partition : instance->partitions)
+		partition->pc.UpdateAudio();
 
 #ifdef WIN32
 	win32_app_started();
@@ -636,6 +741,9 @@ int mpd_main(int argc, char *argv[])
 	/* cleanup */
 
 #if defined(ENABLE_DATABASE) && defined(ENABLE_INOTIFY)
+#ifdef ENABLE_FANOTIFY
+	mpd_fanotify_finish();
+#endif
 	mpd_inotify_finish();
 
 	if (instance->update != nullptr)
@@ -647,9 +755,14 @@ int mpd_main(int argc, char *argv[])
 		delete state_file;
 	}
 
-	instance->partition->pc.Kill();
+	background_writer_finish();
+
+	for (auto *partition : instance->partitions)
+		partition->pc.Kill();
+	seek_index_global_finish();
 	ZeroconfDeinit();
 	listen_global_finish();
+	client_worker_finish();
 	delete instance->client_list;
 
 #ifdef ENABLE_NEIGHBOR_PLUGINS
@@ -660,6 +773,7 @@ int mpd_main(int argc, char *argv[])
 #endif
 
 #ifdef ENABLE_DATABASE
+	delete instance->query_cache;
 	delete instance->update;
 
 	if (instance->database != nullptr) {
@@ -676,6 +790,7 @@ int mpd_main(int argc, char *argv[])
 
 	GlobalEvents::Deinitialize();
 
+	art_cache_finish();
 	playlist_list_global_finish();
 	input_stream_global_finish();
 
@@ -683,7 +798,9 @@ int mpd_main(int argc, char *argv[])
 	mapper_finish();
 #endif
 
-	delete instance->partition;
+	for (auto *partition : instance->partitions)
+		delete partition;
+	pcm_convert_global_finish();
 	command_finish();
 	decoder_plugin_deinit_all();
 #ifdef ENABLE_ARCHIVE
@@ -705,6 +822,7 @@ int mpd_main(int argc, char *argv[])
 
 	IcuFinish();
 
+	log_thread_stop();
 	log_deinit();
 	return EXIT_SUCCESS;
 }
@@ -30,11 +30,15 @@
 
 #ifdef ENABLE_DATABASE
 #include "storage/StorageInterface.hxx"
+#include "thread/Mutex.hxx"
 #include "Instance.hxx"
 #include "Main.hxx"
+
+#include <unordered_map>
 #endif
 
 #include <assert.h>
+#include <string.h>
 
 /**
  * The absolute path of the playlist directory encoded in the
@@ -59,8 +63,48 @@ mapper_init(AllocatedPath &&_playlist_dir)
 		mapper_set_playlist_dir(std::move(_playlist_dir));
 }
 
+#ifdef ENABLE_DATABASE
+
+/**
+ * The upper limit for #map_dir_cache.  When it is reached, the cache
+ * is cleared.
+ */
+static constexpr size_t MAX_MAP_DIR_CACHE = 1024;
+
+/**
+ * Maps URI directories (UTF-8) to absolute paths in the file system
+ * character set.  Songs in the same directory are usually looked up
+ * one after another, and this saves the storage lookup and the
+ * charset conversion of the directory part.
+ */
+static struct {
+	Mutex mutex;
+
+	std::unordered_map<std::string, AllocatedPath> map;
+} map_dir_cache;
+
+static AllocatedPath
+map_dir_fs(const std::string &directory)
+{
+	const auto music_dir_fs = instance->storage->MapFS("");
+	if (music_dir_fs.IsNull() || directory.empty())
+		return music_dir_fs;
+
+	const auto directory_fs = AllocatedPath::FromUTF8(directory.c_str());
+	if (directory_fs.IsNull())
+		return AllocatedPath::Null();
+
+	return AllocatedPath::Build(music_dir_fs, directory_fs);
+}
+
+#endif
+
 void mapper_finish(void)
 {
+#ifdef ENABLE_DATABASE
+	const ScopeLock protect(map_dir_cache.mutex);
+	map_dir_cache.map.clear();
+#endif
 }
 
 #ifdef ENABLE_DATABASE
@@ -74,15 +118,39 @@ map_uri_fs(const char *uri)
 	if (instance->storage == nullptr)
 		return AllocatedPath::Null();
 
-	const auto music_dir_fs = instance->storage->MapFS("");
-	if (music_dir_fs.IsNull())
-		return AllocatedPath::Null();
+	const char *slash = strrchr(uri, '/');
+	const char *name = slash != nullptr ? slash + 1 : uri;
+	std::string directory(uri, name - uri - (slash != nullptr));
+
+	AllocatedPath directory_fs = AllocatedPath::Null();
+
+	{
+		const ScopeLock protect(map_dir_cache.mutex);
+		auto i = map_dir_cache.map.find(directory);
+		if (i != map_dir_cache.map.end())
+			directory_fs = i->second;
+	}
+
+	if (directory_fs.IsNull()) {
+		directory_fs = map_dir_fs(directory);
+		if (directory_fs.IsNull())
+			return AllocatedPath::Null();
+
+		const ScopeLock protect(map_dir_cache.mutex);
+		if (map_dir_cache.map.size() >= MAX_MAP_DIR_CACHE)
+			map_dir_cache.map.clear();
+		map_dir_cache.map.insert(std::make_pair(std::move(directory),
+							directory_fs));
+	}
+
+	if (*name == 0)
+		return directory_fs;
 
-	const auto uri_fs = AllocatedPath::FromUTF8(uri);
-	if (uri_fs.IsNull())
+	const auto name_fs = AllocatedPath::FromUTF8(name);
+	if (name_fs.IsNull())
 		return AllocatedPath::Null();
 
-	return AllocatedPath::Build(music_dir_fs, uri_fs);
+	return AllocatedPath::Build(directory_fs, name_fs);
 }
 
 std::string
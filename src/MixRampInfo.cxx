@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "MixRampInfo.hxx"
+#include "util/NumberParser.hxx"
+
+#include <algorithm>
+
+#include <stdio.h>
+
+template<typename T>
+static constexpr T
+Clamp(T value, T min, T max)
+{
+	return value < min ? min : (value > max ? max : value);
+}
+
+void
+MixRampEnvelope::Append(float db, float seconds)
+{
+	if (n_points >= MAX_POINTS)
+		return;
+
+	Point &p = points[n_points++];
+	p.centi_db = Clamp<float>(db * 100 + (db < 0 ? -0.5f : 0.5f),
+				    INT16_MIN, INT16_MAX);
+	p.centi_seconds = Clamp<float>(seconds * 100 + 0.5f, 0, UINT16_MAX);
+}
+
+void
+MixRampEnvelope::Assign(const Point *src, unsigned n)
+{
+	if (n > MAX_POINTS)
+		n = MAX_POINTS;
+
+	std::copy(src, src + n, points);
+	n_points = n;
+}
+
+void
+MixRampEnvelope::Parse(const char *s)
+{
+	while (true) {
+		/* parse the dB value */
+		char *endptr;
+		const float db = ParseFloat(s, &endptr);
+		if (endptr == s || *endptr != ' ')
+			break;
+
+		s = endptr + 1;
+
+		/* parse the time */
+		const float seconds = ParseFloat(s, &endptr);
+		if (endptr == s || (*endptr != ';' && *endptr != 0))
+			break;
+
+		Append(db, seconds);
+
+		s = endptr;
+		if (*s == ';')
+			++s;
+	}
+}
+
+std::string
+MixRampEnvelope::Format() const
+{
+	std::string result;
+
+	for (unsigned i = 0; i < n_points; ++i) {
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%.2f %.2f;",
+			 points[i].centi_db / 100.,
+			 points[i].centi_seconds / 100.);
+		result.append(buffer);
+	}
+
+	return result;
+}
+
+float
+MixRampEnvelope::Interpolate(float required_db) const
+{
+	float last_db = 0, last_seconds = 0;
+	bool have_last = false;
+
+	/* the dB values must be monotonically increasing for this to
+	   work */
+
+	for (unsigned i = 0; i < n_points; ++i) {
+		const float db = points[i].centi_db / 100.f;
+		const float seconds = points[i].centi_seconds / 100.f;
+
+		/* check for exact match */
+		if (db == required_db)
+			return seconds;
+
+		/* save if too quiet */
+		if (db < required_db) {
+			last_db = db;
+			last_seconds = seconds;
+			have_last = true;
+			continue;
+		}
+
+		/* if required db < any stored value, use the least */
+		if (!have_last)
+			return seconds;
+
+		/* finally, interpolate linearly */
+		return last_seconds + (required_db - last_db) *
+			(seconds - last_seconds) / (db - last_db);
+	}
+
+	return -1;
+}
@@ -25,52 +25,135 @@
 
 #include <string>
 
-class MixRampInfo {
-	std::string start, end;
+#include <stdint.h>
 
+/**
+ * A MixRamp volume profile: a list of points which describe when a
+ * song reaches (or leaves) a certain level.  It is stored in a
+ * compact binary form, so the player does not need to parse the
+ * "mixramp_start"/"mixramp_end" strings at each song change.
+ */
+class MixRampEnvelope {
 public:
-	MixRampInfo() = default;
+	static constexpr unsigned MAX_POINTS = 16;
+
+	struct Point {
+		/**
+		 * The level in 1/100 dB.
+		 */
+		int16_t centi_db;
+
+		/**
+		 * The time in 1/100 seconds.
+		 */
+		uint16_t centi_seconds;
+	};
+
+private:
+	Point points[MAX_POINTS];
+
+	uint8_t n_points;
+
+public:
+	MixRampEnvelope():n_points(0) {}
 
 	void Clear() {
-		start.clear();
-		end.clear();
+		n_points = 0;
 	}
 
 	gcc_pure
 	bool IsDefined() const {
-		return !start.empty() || !end.empty();
+		return n_points > 0;
 	}
 
+	unsigned GetSize() const {
+		return n_points;
+	}
+
+	const Point *GetPoints() const {
+		return points;
+	}
+
+	/**
+	 * Replace all points with a copy of the given array (which
+	 * was obtained from GetPoints()).  Excess points are ignored.
+	 */
+	void Assign(const Point *src, unsigned n);
+
+	/**
+	 * Append a point.  The levels should be monotonically
+	 * increasing.  Excess points are ignored.
+	 */
+	void Append(float db, float seconds);
+
+	/**
+	 * Parse a string of pairs of dBs and seconds, as found in the
+	 * "mixramp_start" and "mixramp_end" tags.  Delimiters are
+	 * semicolons between pairs and spaces between the dB and
+	 * seconds of a pair.  Parsing stops at the first syntax
+	 * error.
+	 */
+	void Parse(const char *s);
+
+	/**
+	 * Format the envelope in the syntax understood by Parse().
+	 */
+	gcc_pure
+	std::string Format() const;
+
+	/**
+	 * Determine the time at which the specified level is
+	 * reached, interpolating linearly between two points.
+	 *
+	 * @return the time in seconds, or a negative value if the
+	 * level is never reached
+	 */
 	gcc_pure
-	const char *GetStart() const {
-		return start.empty() ? nullptr : start.c_str();
+	float Interpolate(float required_db) const;
+};
+
+class MixRampInfo {
+	MixRampEnvelope start, end;
+
+public:
+	MixRampInfo() = default;
+
+	void Clear() {
+		start.Clear();
+		end.Clear();
 	}
 
 	gcc_pure
-	const char *GetEnd() const {
-		return end.empty() ? nullptr : end.c_str();
+	bool IsDefined() const {
+		return start.IsDefined() || end.IsDefined();
 	}
 
-	void SetStart(const char *new_value) {
-		if (new_value == nullptr)
-			start.clear();
-		else
-			start = new_value;
+	const MixRampEnvelope &GetStart() const {
+		return start;
 	}
 
-	void SetStart(std::string &&new_value) {
-		start = std::move(new_value);
+	const MixRampEnvelope &GetEnd() const {
+		return end;
 	}
 
-	void SetEnd(const char *new_value) {
-		if (new_value == nullptr)
-			end.clear();
-		else
-			end = new_value;
+	MixRampEnvelope &GetStart() {
+		return start;
+	}
+
+	MixRampEnvelope &GetEnd() {
+		return end;
 	}
 
-	void SetEnd(std::string &&new_value) {
-		end = std::move(new_value);
+	void SetStart(const char *new_value) {
+		start.Clear();
+		if (new_value != nullptr)
+			start.Parse(new_value);
+	}
+
+	void SetEnd(const char *new_value) {
+		end.Clear();
+		if (new_value != nullptr)
+			end.Parse(new_value);
 	}
 };
 
@@ -21,20 +21,70 @@
 #include "MusicBuffer.hxx"
 #include "MusicChunk.hxx"
 #include "system/FatalError.hxx"
+#include "util/HugeAllocator.hxx"
+#include "util/MemoryStats.hxx"
+
+#include <algorithm>
+#include <new>
 
 #include <assert.h>
 
-MusicBuffer::MusicBuffer(unsigned num_chunks)
-	:buffer(num_chunks) {
-	if (buffer.IsOOM())
+MusicBuffer::MusicBuffer(unsigned num_chunks, size_t _chunk_size)
+	:mutex("MusicBuffer"),
+	 buffer(num_chunks), chunk_size(_chunk_size),
+	 storage((uint8_t *)HugeAllocate(num_chunks * _chunk_size)),
+	 limit(num_chunks) {
+	assert(chunk_size >= MIN_CHUNK_SIZE);
+	assert(chunk_size <= MAX_CHUNK_SIZE);
+
+	if (buffer.IsOOM() || storage == nullptr)
 		FatalError("Failed to allocate buffer");
+
+	MemoryStatsAdd(MemoryCategory::MUSIC_BUFFER,
+		       num_chunks * chunk_size);
+}
+
+MusicBuffer::~MusicBuffer()
+{
+	MemoryStatsSub(MemoryCategory::MUSIC_BUFFER,
+		       buffer.GetCapacity() * chunk_size);
+	HugeFree(storage, buffer.GetCapacity() * chunk_size);
+}
+
+void
+MusicBuffer::SetLimit(unsigned _limit)
+{
+	assert(_limit > 0);
+
+	const ScopeLock protect(mutex);
+	limit = std::min(_limit, buffer.GetCapacity());
 }
 
 MusicChunk *
 MusicBuffer::Allocate()
 {
 	const ScopeLock protect(mutex);
-	return buffer.Allocate();
+	if (buffer.GetNumAllocated() >= limit)
+		return nullptr;
+
+	MusicChunk *chunk = buffer.Allocate();
+	if (chunk != nullptr) {
+		chunk->data = storage + buffer.IndexOf(chunk) * chunk_size;
+		chunk->capacity = chunk_size;
+	}
+
+	return chunk;
+}
+
+inline void
+MusicBuffer::FreeLocked(MusicChunk *chunk)
+{
+	buffer.Free(chunk);
+
+	/* like SliceBuffer, give the payload memory back to the
+	   kernel when the last chunk was freed */
+	if (buffer.IsEmpty())
+		HugeDiscard(storage, buffer.GetCapacity() * chunk_size);
 }
 
 void
@@ -46,8 +96,140 @@ MusicBuffer::Return(MusicChunk *chunk)
 
 	if (chunk->other != nullptr) {
 		assert(chunk->other->other == nullptr);
-		buffer.Free(chunk->other);
+		FreeLocked(chunk->other);
 	}
 
-	buffer.Free(chunk);
+	FreeLocked(chunk);
+}
+
+unsigned
+MusicBuffer::AllocateBatch(MusicChunk **dest, unsigned n)
+{
+	const ScopeLock protect(mutex);
+
+	if (buffer.GetNumAllocated() >= limit)
+		return 0;
+
+	n = std::min(n, limit - buffer.GetNumAllocated());
+
+	unsigned i = 0;
+	for (; i < n; ++i) {
+		MusicChunk *chunk = buffer.Allocate();
+		if (chunk == nullptr)
+			break;
+
+		chunk->data = storage + buffer.IndexOf(chunk) * chunk_size;
+		chunk->capacity = chunk_size;
+		dest[i] = chunk;
+	}
+
+	return i;
+}
+
+void
+MusicBuffer::ReturnBatch(MusicChunk *const*src, unsigned n)
+{
+	const ScopeLock protect(mutex);
+
+	for (unsigned i = 0; i < n; ++i) {
+		assert(src[i]->other == nullptr);
+		FreeLocked(src[i]);
+	}
+}
+
+/**
+ * Determine the size of a #MusicBuffer::Cache: at most one eighth of
+ * the #MusicBuffer, and caching is disabled for small buffers.
+ */
+static constexpr unsigned
+CalcCacheSize(unsigned buffer_size, unsigned max_size)
+{
+	return buffer_size / 8 < 2
+		? 0
+		: (buffer_size / 8 < max_size ? buffer_size / 8 : max_size);
+}
+
+MusicBuffer::Cache::Cache(MusicBuffer &_buffer)
+	:buffer(_buffer),
+	 max(CalcCacheSize(_buffer.GetSize(), MAX_SIZE)),
+	 n(0) {}
+
+MusicChunk *
+MusicBuffer::Cache::Allocate()
+{
+	if (max == 0)
+		return buffer.Allocate();
+
+	if (n == 0) {
+		/* refill only half of the cache, to leave room for
+		   chunks returned later */
+		n = buffer.AllocateBatch(chunks, (max + 1) / 2);
+		if (n == 0)
+			return nullptr;
+	}
+
+	return chunks[--n];
+}
+
+/**
+ * Destructs and reconstructs the #MusicChunk, which makes it an
+ * empty chunk again without giving it back to the #MusicBuffer.
+ */
+static void
+RecycleChunk(MusicChunk *chunk)
+{
+	uint8_t *const data = chunk->data;
+	const size_t capacity = chunk->capacity;
+
+	chunk->~MusicChunk();
+	::new((void *)chunk) MusicChunk();
+
+	chunk->data = data;
+	chunk->capacity = capacity;
+}
+
+void
+MusicBuffer::Cache::Put(MusicChunk *chunk)
+{
+	assert(chunk->other == nullptr);
+
+	if (n == max) {
+		/* the cache is full: give half of it back */
+		const unsigned half = max / 2;
+		n -= half;
+		buffer.ReturnBatch(chunks + n, half);
+	}
+
+	RecycleChunk(chunk);
+	chunks[n++] = chunk;
+}
+
+void
+MusicBuffer::Cache::Return(MusicChunk *chunk)
+{
+	assert(chunk != nullptr);
+
+	if (max == 0) {
+		buffer.Return(chunk);
+		return;
+	}
+
+	if (chunk->other != nullptr) {
+		assert(chunk->other->other == nullptr);
+
+		MusicChunk *other = chunk->other;
+		chunk->other = nullptr;
+		Put(other);
+	}
+
+	Put(chunk);
+}
+
+void
+MusicBuffer::Cache::Flush()
+{
+	if (n > 0) {
+		buffer.ReturnBatch(chunks, n);
+		n = 0;
+	}
 }
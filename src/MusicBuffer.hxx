@@ -23,6 +23,9 @@
 #include "util/SliceBuffer.hxx"
 #include "thread/Mutex.hxx"
 
+#include <stdint.h>
+#include <stddef.h>
+
 struct MusicChunk;
 
 /**
@@ -34,14 +37,115 @@ class MusicBuffer {
 
 	SliceBuffer<MusicChunk> buffer;
 
+	/**
+	 * The payload size of each #MusicChunk.
+	 */
+	const size_t chunk_size;
+
+	/**
+	 * The payload memory of all chunks; each #MusicChunk owns
+	 * #chunk_size bytes of it, indexed by its position in
+	 * #buffer.
+	 */
+	uint8_t *const storage;
+
+	/**
+	 * The maximum number of chunks which may be allocated at a
+	 * time; Allocate() fails when it is reached.  This is usually
+	 * the capacity of #buffer, but may be lowered with
+	 * SetLimit().
+	 */
+	unsigned limit;
+
+	/**
+	 * Allocates up to #n chunks while holding the mutex only
+	 * once.
+	 *
+	 * @return the number of chunks stored in #dest
+	 */
+	unsigned AllocateBatch(MusicChunk **dest, unsigned n);
+
+	/**
+	 * Frees #n chunks while holding the mutex only once.  The
+	 * chunks must not have an #MusicChunk::other chunk.
+	 */
+	void ReturnBatch(MusicChunk *const*src, unsigned n);
+
+	/**
+	 * Frees one chunk.  Caller must hold the mutex.
+	 */
+	void FreeLocked(MusicChunk *chunk);
+
 public:
+	/**
+	 * A small cache of free chunks in front of a #MusicBuffer.
+	 * It is owned by one thread, and lets it allocate and return
+	 * most chunks without locking the #MusicBuffer mutex: the
+	 * cache is refilled and flushed in batches.
+	 *
+	 * Chunks in the cache count as allocated in the
+	 * #MusicBuffer, therefore the owner should call Flush() when
+	 * it becomes idle.
+	 */
+	class Cache {
+		static constexpr unsigned MAX_SIZE = 32;
+
+		MusicBuffer &buffer;
+
+		/**
+		 * The maximum number of chunks in this cache.  It is
+		 * limited by the size of the #MusicBuffer, to make
+		 * sure that other threads are not starved by chunks
+		 * held here.  0 disables caching.
+		 */
+		const unsigned max;
+
+		unsigned n;
+
+		MusicChunk *chunks[MAX_SIZE];
+
+	public:
+		explicit Cache(MusicBuffer &_buffer);
+
+		~Cache() {
+			Flush();
+		}
+
+		Cache(const Cache &) = delete;
+		Cache &operator=(const Cache &) = delete;
+
+		/**
+		 * Like MusicBuffer::Allocate().
+		 */
+		MusicChunk *Allocate();
+
+		/**
+		 * Like MusicBuffer::Return().
+		 */
+		void Return(MusicChunk *chunk);
+
+		/**
+		 * Returns all cached chunks to the #MusicBuffer.
+		 */
+		void Flush();
+
+	private:
+		void Put(MusicChunk *chunk);
+	};
+
+
 	/**
 	 * Creates a new #MusicBuffer object.
 	 *
 	 * @param num_chunks the number of #MusicChunk reserved in
 	 * this buffer
+	 * @param chunk_size the payload size of each #MusicChunk
 	 */
-	MusicBuffer(unsigned num_chunks);
+	MusicBuffer(unsigned num_chunks, size_t chunk_size);
+	~MusicBuffer();
+
+	MusicBuffer(const MusicBuffer &) = delete;
+	MusicBuffer &operator=(const MusicBuffer &) = delete;
 
 #ifndef NDEBUG
 	/**
@@ -64,6 +168,35 @@ public:
 		return buffer.GetCapacity();
 	}
 
+	/**
+	 * Returns the payload size of each #MusicChunk allocated by
+	 * this buffer.
+	 */
+	size_t GetChunkSize() const {
+		return chunk_size;
+	}
+
+	/**
+	 * Returns the number of chunks which may be allocated, see
+	 * SetLimit().  This call is not protected with the mutex; it
+	 * may only be used by the thread which calls SetLimit().
+	 */
+	unsigned GetLimit() const {
+		return limit;
+	}
+
+	/**
+	 * Limit the number of chunks which may be allocated at a
+	 * time.  Chunks which are already allocated above the new
+	 * limit are not affected.  This allows the player to keep
+	 * the resident memory of the buffer low when the decoder is
+	 * fast enough.
+	 *
+	 * @param _limit the new limit; it must not be zero and is
+	 * clipped to the capacity
+	 */
+	void SetLimit(unsigned _limit);
+
 	/**
 	 * Allocates a chunk from the buffer.  When it is not used anymore,
 	 * call Return().
@@ -30,8 +30,22 @@
 #include <stdint.h>
 #include <stddef.h>
 
+/**
+ * The default payload size of a #MusicChunk.  It can be changed with
+ * the "audio_buffer_chunk_size" setting.
+ */
 static constexpr size_t CHUNK_SIZE = 4096;
 
+/**
+ * The smallest allowed payload size of a #MusicChunk.
+ */
+static constexpr size_t MIN_CHUNK_SIZE = 1024;
+
+/**
+ * The largest allowed payload size of a #MusicChunk.
+ */
+static constexpr size_t MAX_CHUNK_SIZE = 1024 * 1024;
+
 struct AudioFormat;
 struct Tag;
 
@@ -56,7 +70,10 @@ struct MusicChunk {
 	float mix_ratio;
 
 	/** number of bytes stored in this chunk */
-	uint16_t length;
+	uint32_t length;
+
+	/** the size of the #data buffer */
+	uint32_t capacity;
 
 	/** current bit rate of the source file */
 	uint16_t bit_rate;
@@ -85,8 +102,26 @@ struct MusicChunk {
 	 */
 	unsigned replay_gain_serial;
 
-	/** the data (probably PCM) */
-	uint8_t data[CHUNK_SIZE];
+	/**
+	 * The position of this chunk in the output pipe; assigned by
+	 * MultipleOutputs::Play().  Chunks are numbered in ascending
+	 * order, which allows each output to announce how far it has
+	 * consumed the pipe with a single integer.
+	 */
+	uint64_t output_serial;
+
+	/**
+	 * When the decoder pushed this chunk into the pipe
+	 * (MonotonicClockUS()); 0 if the chunk was not created by
+	 * the decoder.  Used for #PipelineStats.
+	 */
+	uint64_t push_us;
+
+	/**
+	 * The data (probably PCM).  This buffer is owned by the
+	 * #MusicBuffer which has allocated this chunk.
+	 */
+	uint8_t *data;
 
 #ifndef NDEBUG
 	AudioFormat audio_format;
@@ -94,9 +129,12 @@ struct MusicChunk {
 
 	MusicChunk()
 		:other(nullptr),
-		 length(0),
+		 length(0), capacity(0),
 		 tag(nullptr),
-		 replay_gain_serial(0) {}
+		 replay_gain_serial(0),
+		 output_serial(0),
+		 push_us(0),
+		 data(nullptr) {}
 
 	~MusicChunk();
 
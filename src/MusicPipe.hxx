@@ -58,7 +58,8 @@ public:
 	 * Creates a new #MusicPipe object.  It is empty.
 	 */
 	MusicPipe()
-		:head(nullptr), tail_r(&head), size(0) {
+		:head(nullptr), tail_r(&head), size(0),
+		 mutex("MusicPipe") {
 #ifndef NDEBUG
 		audio_format.Clear();
 #endif
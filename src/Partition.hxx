@@ -26,6 +26,8 @@
 #include "PlayerControl.hxx"
 #include "PlayerListener.hxx"
 
+#include <string>
+
 struct Instance;
 class MultipleOutputs;
 class SongLoader;
@@ -37,6 +39,12 @@ class SongLoader;
 struct Partition final : private PlayerListener, private MixerListener {
 	Instance &instance;
 
+	/**
+	 * The name of this partition, used by the "partition"
+	 * command.  The first partition is called "default".
+	 */
+	const std::string name;
+
 	struct playlist playlist;
 
 	MultipleOutputs outputs;
@@ -44,12 +52,16 @@ struct Partition final : private PlayerListener, private MixerListener {
 	PlayerControl pc;
 
 	Partition(Instance &_instance,
+		  const char *_name,
 		  unsigned max_length,
 		  unsigned buffer_chunks,
-		  unsigned buffered_before_play)
-		:instance(_instance), playlist(max_length),
+		  size_t buffer_chunk_size,
+		  unsigned buffered_before_play,
+		  bool buffer_adaptive)
+		:instance(_instance), name(_name), playlist(max_length),
 		 outputs(*this),
-		 pc(*this, outputs, buffer_chunks, buffered_before_play) {}
+		 pc(*this, outputs, buffer_chunks, buffer_chunk_size,
+		    buffered_before_play, buffer_adaptive) {}
 
 	void ClearQueue() {
 		playlist.Clear(pc);
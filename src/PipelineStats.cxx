@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "PipelineStats.hxx"
+#include "thread/Mutex.hxx"
+
+#include <boost/intrusive/list.hpp>
+
+#include <stdarg.h>
+#include <stdio.h>
+
+PipelineStats pipeline_stats;
+
+/**
+ * Protects #output_stats.
+ */
+static Mutex output_stats_mutex;
+
+static boost::intrusive::list<OutputStats,
+			      boost::intrusive::constant_time_size<false>> output_stats;
+
+void
+pipeline_stats_add_output(OutputStats &stats, const char *name)
+{
+	stats.name = name;
+
+	const ScopeLock protect(output_stats_mutex);
+	output_stats.push_back(stats);
+}
+
+void
+pipeline_stats_remove_output(OutputStats &stats)
+{
+	const ScopeLock protect(output_stats_mutex);
+	output_stats.erase(output_stats.iterator_to(stats));
+}
+
+gcc_printf(2, 3)
+static void
+AppendFormat(std::string &dest, const char *fmt, ...)
+{
+	char buffer[256];
+
+	va_list ap;
+	va_start(ap, fmt);
+	vsnprintf(buffer, sizeof(buffer), fmt, ap);
+	va_end(ap);
+
+	dest.append(buffer);
+}
+
+static void
+AppendLatency(std::string &dest, const char *count_name, const char *prefix,
+	      const LatencyStats &s)
+{
+	AppendFormat(dest, "%s: %llu\n"
+		     "%s_avg_us: %llu\n"
+		     "%s_max_us: %llu\n",
+		     count_name, (unsigned long long)s.count.load(),
+		     prefix, (unsigned long long)s.GetAverage(),
+		     prefix, (unsigned long long)s.max_us.load());
+}
+
+std::string
+pipeline_stats_format()
+{
+	const PipelineStats &p = pipeline_stats;
+
+	std::string result;
+	AppendLatency(result, "decoder_chunks", "decoder_chunk",
+		      p.decoder_chunk);
+
+	const uint64_t samples = p.pipe_samples.load();
+	AppendFormat(result, "pipe_chunks: %u\n"
+		     "pipe_chunks_avg: %llu\n"
+		     "player_underruns: %llu\n",
+		     p.pipe_chunks.load(),
+		     samples > 0
+		     ? (unsigned long long)(p.pipe_chunks_sum.load() / samples)
+		     : 0ULL,
+		     (unsigned long long)p.underruns.load());
+
+	const ScopeLock protect(output_stats_mutex);
+	for (const auto &o : output_stats) {
+		AppendFormat(result, "output: %s\n", o.name);
+		AppendLatency(result, "output_chunks", "output_chunk_wait",
+			      o.chunk_wait);
+		AppendLatency(result, "output_play_calls", "output_play",
+			      o.play);
+		AppendFormat(result, "output_underruns: %llu\n",
+			     (unsigned long long)o.underruns.load());
+	}
+
+	return result;
+}
+
+/**
+ * Append a Prometheus label value, escaping backslash, double quote
+ * and newline.
+ */
+static void
+AppendLabelValue(std::string &dest, const char *value)
+{
+	for (const char *p = value; *p != 0; ++p) {
+		switch (*p) {
+		case '\\':
+		case '"':
+			dest.push_back('\\');
+			dest.push_back(*p);
+			break;
+
+		case '\n':
+			dest.append("\\n");
+			break;
+
+		default:
+			dest.push_back(*p);
+		}
+	}
+}
+
+static void
+AppendType(std::string &dest, const char *name, const char *type)
+{
+	AppendFormat(dest, "# TYPE %s %s\n", name, type);
+}
+
+static void
+AppendSample(std::string &dest, const char *name, const char *label,
+	     double value)
+{
+	dest.append(name);
+
+	if (label != nullptr) {
+		dest.append("{output=\"");
+		AppendLabelValue(dest, label);
+		dest.append("\"}");
+	}
+
+	AppendFormat(dest, " %.9g\n", value);
+}
+
+static void
+AppendMetric(std::string &dest, const char *name, const char *type,
+	     double value)
+{
+	AppendType(dest, name, type);
+	AppendSample(dest, name, nullptr, value);
+}
+
+/**
+ * Append one metric family with one sample for each output.  The
+ * caller must hold #output_stats_mutex.
+ */
+static void
+AppendOutputMetric(std::string &dest, const char *name, const char *type,
+		   double (*get)(const OutputStats &))
+{
+	AppendType(dest, name, type);
+
+	for (const auto &o : output_stats)
+		AppendSample(dest, name, o.name, get(o));
+}
+
+std::string
+pipeline_stats_format_prometheus()
+{
+	const PipelineStats &p = pipeline_stats;
+
+	std::string result;
+	AppendMetric(result, "mpd_decoder_chunks_total", "counter",
+		     p.decoder_chunk.count.load());
+	AppendMetric(result, "mpd_decoder_chunk_seconds_total", "counter",
+		     p.decoder_chunk.total_us.load() / 1e6);
+	AppendMetric(result, "mpd_decoder_chunk_seconds_max", "gauge",
+		     p.decoder_chunk.max_us.load() / 1e6);
+	AppendMetric(result, "mpd_pipe_chunks", "gauge",
+		     p.pipe_chunks.load());
+	AppendMetric(result, "mpd_pipe_samples_total", "counter",
+		     p.pipe_samples.load());
+	AppendMetric(result, "mpd_pipe_chunks_sum_total", "counter",
+		     p.pipe_chunks_sum.load());
+	AppendMetric(result, "mpd_player_underruns_total", "counter",
+		     p.underruns.load());
+
+	const ScopeLock protect(output_stats_mutex);
+
+	AppendOutputMetric(result, "mpd_output_chunks_total", "counter",
+			   [](const OutputStats &o) -> double {
+				   return o.chunk_wait.count.load();
+			   });
+	AppendOutputMetric(result, "mpd_output_chunk_wait_seconds_total",
+			   "counter",
+			   [](const OutputStats &o) -> double {
+				   return o.chunk_wait.total_us.load() / 1e6;
+			   });
+	AppendOutputMetric(result, "mpd_output_chunk_wait_seconds_max",
+			   "gauge",
+			   [](const OutputStats &o) -> double {
+				   return o.chunk_wait.max_us.load() / 1e6;
+			   });
+	AppendOutputMetric(result, "mpd_output_play_calls_total", "counter",
+			   [](const OutputStats &o) -> double {
+				   return o.play.count.load();
+			   });
+	AppendOutputMetric(result, "mpd_output_play_seconds_total",
+			   "counter",
+			   [](const OutputStats &o) -> double {
+				   return o.play.total_us.load() / 1e6;
+			   });
+	AppendOutputMetric(result, "mpd_output_play_seconds_max", "gauge",
+			   [](const OutputStats &o) -> double {
+				   return o.play.max_us.load() / 1e6;
+			   });
+	AppendOutputMetric(result, "mpd_output_underruns_total", "counter",
+			   [](const OutputStats &o) -> double {
+				   return o.underruns.load();
+			   });
+
+	return result;
+}
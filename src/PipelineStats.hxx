@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PIPELINE_STATS_HXX
+#define MPD_PIPELINE_STATS_HXX
+
+#include "check.h"
+#include "Compiler.h"
+
+#include <boost/intrusive/list_hook.hpp>
+
+#include <atomic>
+#include <string>
+
+#include <stdint.h>
+
+/**
+ * Count, sum and maximum of a duration.  It is lock-free: one thread
+ * may update it while others read it.
+ */
+struct LatencyStats {
+	std::atomic<uint64_t> count, total_us, max_us;
+
+	LatencyStats():count(0), total_us(0), max_us(0) {}
+
+	void Add(uint64_t us) {
+		count.fetch_add(1, std::memory_order_relaxed);
+		total_us.fetch_add(us, std::memory_order_relaxed);
+
+		uint64_t old = max_us.load(std::memory_order_relaxed);
+		while (us > old &&
+		       !max_us.compare_exchange_weak(old, us,
+						     std::memory_order_relaxed)) {}
+	}
+
+	gcc_pure
+	uint64_t GetAverage() const {
+		const uint64_t n = count.load(std::memory_order_relaxed);
+		return n > 0
+			? total_us.load(std::memory_order_relaxed) / n
+			: 0;
+	}
+};
+
+/**
+ * Telemetry of one #AudioOutput.  It is registered with
+ * pipeline_stats_add_output() while the output exists.
+ */
+struct OutputStats : boost::intrusive::list_base_hook<> {
+	const char *name;
+
+	/**
+	 * How long each #MusicChunk waited between being pushed into
+	 * the #MusicPipe by the decoder and being played by this
+	 * output.
+	 */
+	LatencyStats chunk_wait;
+
+	/**
+	 * The duration of each AudioOutputPlugin::play() call.
+	 */
+	LatencyStats play;
+
+	/**
+	 * The number of underruns reported by the plugin.
+	 */
+	std::atomic<uint64_t> underruns;
+
+	OutputStats():name(nullptr), underruns(0) {}
+
+	OutputStats(const OutputStats &) = delete;
+	OutputStats &operator=(const OutputStats &) = delete;
+};
+
+/**
+ * Telemetry of the decoder and the player thread.
+ */
+struct PipelineStats {
+	/**
+	 * The time between the decoder's first write into a
+	 * #MusicChunk and pushing it into the #MusicPipe.
+	 */
+	LatencyStats decoder_chunk;
+
+	/**
+	 * The number of chunks in the #MusicPipe, sampled by the
+	 * player thread before it sends a chunk to the outputs.
+	 */
+	std::atomic<unsigned> pipe_chunks;
+
+	/**
+	 * The number of samples of #pipe_chunks and their sum (for
+	 * the average).
+	 */
+	std::atomic<uint64_t> pipe_samples, pipe_chunks_sum;
+
+	/**
+	 * The number of silence chunks the player thread inserted
+	 * because the decoder was too slow.
+	 */
+	std::atomic<uint64_t> underruns;
+
+	PipelineStats()
+		:pipe_chunks(0), pipe_samples(0), pipe_chunks_sum(0),
+		 underruns(0) {}
+
+	void SamplePipe(unsigned n) {
+		pipe_chunks.store(n, std::memory_order_relaxed);
+		pipe_samples.fetch_add(1, std::memory_order_relaxed);
+		pipe_chunks_sum.fetch_add(n, std::memory_order_relaxed);
+	}
+};
+
+extern PipelineStats pipeline_stats;
+
+void
+pipeline_stats_add_output(OutputStats &stats, const char *name);
+
+void
+pipeline_stats_remove_output(OutputStats &stats);
+
+/**
+ * Format all statistics as "name: value" lines for the MPD protocol.
+ */
+gcc_pure
+std::string
+pipeline_stats_format();
+
+/**
+ * Format all statistics in the Prometheus text exposition format.
+ */
+gcc_pure
+std::string
+pipeline_stats_format_prometheus();
+
+#endif
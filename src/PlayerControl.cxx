@@ -29,10 +29,15 @@
 PlayerControl::PlayerControl(PlayerListener &_listener,
 			     MultipleOutputs &_outputs,
 			     unsigned _buffer_chunks,
-			     unsigned _buffered_before_play)
+			     size_t _buffer_chunk_size,
+			     unsigned _buffered_before_play,
+			     bool _buffer_adaptive)
 	:listener(_listener), outputs(_outputs),
 	 buffer_chunks(_buffer_chunks),
+	 buffer_chunk_size(_buffer_chunk_size),
 	 buffered_before_play(_buffered_before_play),
+	 buffer_adaptive(_buffer_adaptive),
+	 mutex("PlayerControl"), cond("PlayerControl::cond"),
 	 command(PlayerCommand::NONE),
 	 state(PlayerState::STOP),
 	 error_type(PlayerError::NONE),
@@ -28,6 +28,7 @@
 #include "CrossFade.hxx"
 
 #include <stdint.h>
+#include <stddef.h>
 
 class PlayerListener;
 class MultipleOutputs;
@@ -99,8 +100,20 @@ struct PlayerControl {
 
 	unsigned buffer_chunks;
 
+	/**
+	 * The payload size of each #MusicChunk.
+	 */
+	size_t buffer_chunk_size;
+
 	unsigned int buffered_before_play;
 
+	/**
+	 * Shall the player adjust the number of chunks the decoder
+	 * may fill at runtime, instead of always filling the whole
+	 * #MusicBuffer?  See "audio_buffer_adaptive".
+	 */
+	bool buffer_adaptive;
+
 	/**
 	 * The handle of the player thread.
 	 */
@@ -179,7 +192,9 @@ struct PlayerControl {
 	PlayerControl(PlayerListener &_listener,
 		      MultipleOutputs &_outputs,
 		      unsigned buffer_chunks,
-		      unsigned buffered_before_play);
+		      size_t buffer_chunk_size,
+		      unsigned buffered_before_play,
+		      bool buffer_adaptive);
 	~PlayerControl();
 
 	/**
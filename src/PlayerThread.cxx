@@ -22,7 +22,7 @@
 #include "PlayerListener.hxx"
 #include "decoder/DecoderThread.hxx"
 #include "decoder/DecoderControl.hxx"
-#include "MusicPipe.hxx"
+#include "DecoderPipe.hxx"
 #include "MusicBuffer.hxx"
 #include "MusicChunk.hxx"
 #include "DetachedSong.hxx"
@@ -31,15 +31,42 @@
 #include "PlayerControl.hxx"
 #include "output/MultipleOutputs.hxx"
 #include "tag/Tag.hxx"
+#include "tag/TagBuilder.hxx"
 #include "Idle.hxx"
 #include "util/Domain.hxx"
 #include "thread/Name.hxx"
+#include "thread/Scheduling.hxx"
+#include "system/Clock.hxx"
+#include "PipelineStats.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+#include <vector>
+
+#include <stdlib.h>
 #include <string.h>
 
 static constexpr Domain player_domain("player");
 
+/**
+ * The number of chunks which are always allowed on top of
+ * "buffered_before_play" with "audio_buffer_adaptive": enough for
+ * the output pipe and the chunk caches.
+ */
+static constexpr unsigned ADAPTIVE_BUFFER_RESERVE = 128;
+
+/**
+ * The duration of one measurement period of the adaptive buffer
+ * logic [ms].
+ */
+static constexpr unsigned ADAPTIVE_BUFFER_PERIOD_MS = 1000;
+
+/**
+ * The number of consecutive periods with a fast decoder after which
+ * the buffer limit is lowered.
+ */
+static constexpr unsigned ADAPTIVE_BUFFER_SHRINK_PERIODS = 10;
+
 enum class CrossFadeState : int8_t {
 	DISABLED = -1,
 	UNKNOWN = 0,
@@ -53,7 +80,7 @@ class Player {
 
 	MusicBuffer &buffer;
 
-	MusicPipe *pipe;
+	DecoderPipe *pipe;
 
 	/**
 	 * are we waiting for buffered_before_play?
@@ -131,6 +158,24 @@ class Player {
 	 */
 	float elapsed_time;
 
+	/**
+	 * The start of the current measurement period of
+	 * AdaptBufferLimit() [MonotonicClockMS()].
+	 */
+	unsigned buffer_period_start;
+
+	/**
+	 * The lowest #pipe size observed in the current measurement
+	 * period while the decoder was busy with the current song.
+	 */
+	unsigned buffer_low_water;
+
+	/**
+	 * The number of consecutive measurement periods during which
+	 * the decoder kept #pipe well filled.
+	 */
+	unsigned buffer_fast_periods;
+
 public:
 	Player(PlayerControl &_pc, DecoderControl &_dc,
 	       MusicBuffer &_buffer)
@@ -146,7 +191,10 @@ public:
 		 cross_fading(false),
 		 cross_fade_chunks(0),
 		 cross_fade_tag(nullptr),
-		 elapsed_time(0.0) {}
+		 elapsed_time(0.0),
+		 buffer_period_start(MonotonicClockMS()),
+		 buffer_low_water(~0u),
+		 buffer_fast_periods(0) {}
 
 private:
 	void ClearAndDeletePipe() {
@@ -154,12 +202,12 @@ private:
 		delete pipe;
 	}
 
-	void ClearAndReplacePipe(MusicPipe *_pipe) {
+	void ClearAndReplacePipe(DecoderPipe *_pipe) {
 		ClearAndDeletePipe();
 		pipe = _pipe;
 	}
 
-	void ReplacePipe(MusicPipe *_pipe) {
+	void ReplacePipe(DecoderPipe *_pipe) {
 		delete pipe;
 		pipe = _pipe;
 	}
@@ -169,7 +217,7 @@ private:
 	 *
 	 * Player lock is not held.
 	 */
-	void StartDecoder(MusicPipe &pipe);
+	void StartDecoder(DecoderPipe &pipe);
 
 	/**
 	 * The decoder has acknowledged the "START" command (see
@@ -180,6 +228,17 @@ private:
 	 */
 	bool CheckDecoderStartup();
 
+	/**
+	 * If the queued song is the next range of the file being
+	 * decoded (e.g. the next track of a CUE sheet), let the
+	 * decoder continue into it, instead of stopping at the
+	 * border and starting the decoder again with a seek.  This
+	 * keeps the transition gapless.
+	 *
+	 * Player lock must be held before calling.
+	 */
+	void ChainDecoder();
+
 	/**
 	 * Stop the decoder and clears (and frees) its music pipe.
 	 *
@@ -210,6 +269,20 @@ private:
 		return dc.pipe != nullptr && !IsDecoderAtCurrentSong();
 	}
 
+	/**
+	 * Attempt to serve a seek within the current song from
+	 * chunks which have already been decoded: forward into
+	 * #pipe, or backward into the chunks recently played by the
+	 * outputs (see MultipleOutputs::Rewind()).  The decoder is
+	 * not involved.
+	 *
+	 * The player lock is not held.
+	 *
+	 * @param where the position within the song [s]
+	 * @return true on success, false if the decoder must seek
+	 */
+	bool SeekBuffered(float where);
+
 	/**
 	 * This is the handler for the #PlayerCommand::SEEK command.
 	 *
@@ -252,6 +325,54 @@ private:
 	 */
 	bool SendSilence();
 
+	/**
+	 * Returns the lowest buffer limit for "audio_buffer_adaptive".
+	 */
+	gcc_pure
+	unsigned GetMinBufferLimit(unsigned extra_chunks=0) const {
+		return std::min(pc.buffered_before_play +
+				ADAPTIVE_BUFFER_RESERVE + extra_chunks,
+				buffer.GetSize());
+	}
+
+	/**
+	 * Returns the number of chunks the decoder can fill into its
+	 * pipe before MusicBuffer::Allocate() fails.  With
+	 * "audio_buffer_adaptive", the chunks held by the outputs and
+	 * by the chunk caches are subtracted from the limit.
+	 */
+	gcc_pure
+	unsigned GetDecoderCapacity() const {
+		const unsigned limit = buffer.GetLimit();
+		if (!pc.buffer_adaptive)
+			return limit;
+
+		return limit > ADAPTIVE_BUFFER_RESERVE
+			? limit - ADAPTIVE_BUFFER_RESERVE
+			: limit / 2;
+	}
+
+	/**
+	 * Implementation of "audio_buffer_adaptive": observe how well
+	 * the decoder keeps up with playback, and adjust the number
+	 * of chunks it may fill (MusicBuffer::SetLimit()).  If #pipe
+	 * runs low while the decoder is busy, the limit is doubled;
+	 * if the decoder has refilled it quickly for a while, the
+	 * limit is lowered again.
+	 *
+	 * Player lock must be held before calling.
+	 */
+	void AdaptBufferLimit();
+
+	/**
+	 * Start a new measurement period for AdaptBufferLimit(),
+	 * e.g. after #pipe has been cleared.
+	 */
+	void ResetBufferPeriod() {
+		buffer_period_start = MonotonicClockMS();
+		buffer_low_water = ~0u;
+	}
+
 	/**
 	 * Player lock must be held before calling.
 	 */
@@ -286,7 +407,7 @@ player_command_finished(PlayerControl &pc)
 }
 
 void
-Player::StartDecoder(MusicPipe &_pipe)
+Player::StartDecoder(DecoderPipe &_pipe)
 {
 	assert(queued || pc.command == PlayerCommand::SEEK);
 	assert(pc.next_song != nullptr);
@@ -300,11 +421,34 @@ Player::StartDecoder(MusicPipe &_pipe)
 		 buffer, _pipe);
 }
 
+void
+Player::ChainDecoder()
+{
+	assert(queued);
+	assert(pc.next_song != nullptr);
+
+	if (!dc.CanChain(*pc.next_song))
+		return;
+
+	FormatDebug(player_domain, "chaining \"%s\"",
+		    pc.next_song->GetURI());
+
+	dc.Chain(new DetachedSong(*pc.next_song),
+		 pc.next_song->GetEndMS(),
+		 *new DecoderPipe(buffer.GetSize()));
+}
+
 void
 Player::StopDecoder()
 {
 	dc.Stop();
 
+	/* discard the chained song, unless the decoder has switched
+	   to it already */
+	dc.Lock();
+	delete dc.CancelChain();
+	dc.Unlock();
+
 	if (dc.pipe != nullptr) {
 		/* clear and free the decoder pipe */
 
@@ -385,6 +529,38 @@ real_song_duration(const DetachedSong &song, double decoder_duration)
 	return decoder_duration - start_ms / 1000.0;
 }
 
+/**
+ * The decoder has determined the duration of the song.  If the tag
+ * says something else (e.g. an estimate from the database update),
+ * fix the tag, and let the main thread copy it to the queue.
+ *
+ * Player lock is not held.
+ */
+static void
+refine_song_duration(PlayerControl &pc, DetachedSong &song,
+		     double decoder_duration)
+{
+	if (decoder_duration <= 0.0 ||
+	    song.GetStartMS() > 0 || song.GetEndMS() > 0)
+		/* unknown, or the tag describes only a range of the
+		   file */
+		return;
+
+	const int seconds = int(decoder_duration + 0.5);
+	const Tag &old_tag = song.GetTag();
+	if (old_tag.time >= 0 && abs(old_tag.time - seconds) <= 1)
+		/* close enough; this is just a rounding difference
+		   and not worth a new playlist version */
+		return;
+
+	TagBuilder tag(old_tag);
+	tag.SetTime(seconds);
+	song.SetTag(tag.Commit());
+
+	pc.LockSetTaggedSong(song);
+	pc.listener.OnPlayerTagModified();
+}
+
 bool
 Player::OpenOutput()
 {
@@ -450,10 +626,13 @@ Player::CheckDecoderStartup()
 			return true;
 
 		pc.Lock();
-		pc.total_time = real_song_duration(*dc.song, dc.total_time);
+		const double decoder_duration = dc.total_time;
+		pc.total_time = real_song_duration(*dc.song, decoder_duration);
 		pc.audio_format = dc.in_audio_format;
 		pc.Unlock();
 
+		refine_song_duration(pc, *song, decoder_duration);
+
 		idle_add(IDLE_PLAYER);
 
 		play_audio_format = dc.out_audio_format;
@@ -497,7 +676,7 @@ Player::SendSilence()
 	const size_t frame_size = play_audio_format.GetFrameSize();
 	/* this formula ensures that we don't send
 	   partial frames */
-	unsigned num_frames = sizeof(chunk->data) / frame_size;
+	unsigned num_frames = chunk->capacity / frame_size;
 
 	chunk->times = -1.0; /* undefined time stamp */
 	chunk->length = num_frames * frame_size;
@@ -514,12 +693,79 @@ Player::SendSilence()
 }
 
 inline bool
+Player::SeekBuffered(float where)
+{
+	assert(pc.next_song != nullptr);
+
+	if (decoder_starting || cross_fading || !IsDecoderAtCurrentSong() ||
+	    !pc.next_song->IsSame(*song) ||
+	    pc.next_song->GetStartMS() != song->GetStartMS() ||
+	    pc.next_song->GetEndMS() != song->GetEndMS())
+		return false;
+
+	const unsigned size = pipe->GetSize();
+	const MusicChunk *first = pipe->Peek();
+	const MusicChunk *last = size > 0 ? pipe->PeekAt(size - 1) : nullptr;
+
+	if (first != nullptr && first->length > 0 && first->times <= where) {
+		/* forward: skip the decoded chunks before the
+		   position */
+		if (last->length == 0 || last->times < where)
+			/* not decoded yet */
+			return false;
+
+		const MusicChunk *next;
+		while ((next = pipe->PeekAt(1)) != nullptr &&
+		       (next->length == 0 || next->times <= where))
+			buffer.Return(pipe->Shift());
+
+		pc.outputs.Cancel();
+	} else {
+		/* backward: play the recent chunks again, in front of
+		   the decoded ones */
+		std::vector<MusicChunk *> chunks;
+		if (!pc.outputs.Rewind(where, chunks))
+			return false;
+
+		for (auto i = chunks.rbegin(); i != chunks.rend(); ++i)
+			pipe->Unshift(*i);
+	}
+
+	FormatDebug(player_domain, "seeking to %f in the buffer", where);
+
+	delete pc.next_song;
+	pc.next_song = nullptr;
+	queued = false;
+
+	elapsed_time = where;
+
+	player_command_finished(pc);
+
+	xfade_state = CrossFadeState::UNKNOWN;
+
+	/* the chunks are ready, no need to wait for the decoder */
+	buffering = false;
+	ResetBufferPeriod();
+
+	return true;
+}
+
+bool
 Player::SeekDecoder()
 {
 	assert(pc.next_song != nullptr);
 
 	const unsigned start_ms = pc.next_song->GetStartMS();
 
+	double where = pc.seek_where;
+	if (where > pc.total_time)
+		where = pc.total_time - 0.1;
+	if (where < 0.0)
+		where = 0.0;
+
+	if (SeekBuffered(where))
+		return true;
+
 	if (!dc.LockIsCurrentSong(*pc.next_song)) {
 		/* the decoder is already decoding the "next" song -
 		   stop it and start the previous song again */
@@ -561,12 +807,6 @@ Player::SeekDecoder()
 
 	/* send the SEEK command */
 
-	double where = pc.seek_where;
-	if (where > pc.total_time)
-		where = pc.total_time - 0.1;
-	if (where < 0.0)
-		where = 0.0;
-
 	if (!dc.Seek(where + start_ms / 1000.0)) {
 		/* decoder failure */
 		player_command_finished(pc);
@@ -581,6 +821,7 @@ Player::SeekDecoder()
 
 	/* re-fill the buffer after seeking */
 	buffering = true;
+	ResetBufferPeriod();
 
 	pc.outputs.Cancel();
 
@@ -610,6 +851,12 @@ Player::ProcessCommand()
 		assert(!IsDecoderAtNextSong());
 
 		queued = true;
+
+		if (!dc.IsIdle())
+			/* the decoder is still busy with the current
+			   song; let it open the next one meanwhile */
+			dc.Prefetch(*pc.next_song);
+
 		pc.CommandFinished();
 		break;
 
@@ -663,6 +910,8 @@ Player::ProcessCommand()
 		delete pc.next_song;
 		pc.next_song = nullptr;
 		queued = false;
+		dc.CancelPrefetch();
+		delete dc.CancelChain();
 		pc.CommandFinished();
 		break;
 
@@ -749,6 +998,8 @@ Player::PlayNextChunk()
 		   another chunk */
 		return true;
 
+	pipeline_stats.SamplePipe(pipe->GetSize());
+
 	unsigned cross_fade_position;
 	MusicChunk *chunk = nullptr;
 	if (xfade_state == CrossFadeState::ENABLED && IsDecoderAtNextSong() &&
@@ -860,9 +1111,12 @@ Player::PlayNextChunk()
 	   with each chunk; it is more efficient to make it decode a
 	   larger block at a time */
 	pc.Lock();
+	if (pc.buffer_adaptive)
+		AdaptBufferLimit();
+
 	if (!dc.IsIdle() &&
 	    dc.pipe->GetSize() <= (pc.buffered_before_play +
-				   buffer.GetSize() * 3) / 4) {
+				   GetDecoderCapacity() * 3) / 4) {
 		if (!decoder_woken) {
 			decoder_woken = true;
 			dc.Signal();
@@ -874,6 +1128,57 @@ Player::PlayNextChunk()
 	return true;
 }
 
+void
+Player::AdaptBufferLimit()
+{
+	if (dc.state == DecoderState::DECODE && IsDecoderAtCurrentSong())
+		buffer_low_water = std::min(buffer_low_water,
+					    pipe->GetSize());
+
+	const unsigned now = MonotonicClockMS();
+	if (now - buffer_period_start < ADAPTIVE_BUFFER_PERIOD_MS)
+		return;
+
+	if (buffer_low_water == ~0u) {
+		/* the decoder was not busy with this song; nothing
+		   was measured */
+	} else if (buffer_low_water < pc.buffered_before_play / 4) {
+		/* the pipe has almost run empty: the decoder is
+		   jittery (or slower than real time); allow it to
+		   buffer more */
+		const unsigned limit = buffer.GetLimit();
+		if (limit < buffer.GetSize()) {
+			buffer.SetLimit(limit * 2);
+			FormatDebug(player_domain, "buffer limit %u -> %u",
+				    limit, buffer.GetLimit());
+		}
+
+		buffer_fast_periods = 0;
+	} else if (buffer_low_water >= buffer.GetLimit() / 2) {
+		/* the decoder refills the pipe quickly; don't
+		   shrink during cross-fade, because the chunks may
+		   be above the limit */
+		if (++buffer_fast_periods >= ADAPTIVE_BUFFER_SHRINK_PERIODS &&
+		    xfade_state != CrossFadeState::ENABLED) {
+			const unsigned limit = buffer.GetLimit();
+			const unsigned new_limit =
+				std::max(limit - limit / 4,
+					 GetMinBufferLimit());
+			if (new_limit < limit) {
+				buffer.SetLimit(new_limit);
+				FormatDebug(player_domain,
+					    "buffer limit %u -> %u",
+					    limit, new_limit);
+			}
+
+			buffer_fast_periods = 0;
+		}
+	} else
+		buffer_fast_periods = 0;
+
+	ResetBufferPeriod();
+}
+
 inline bool
 Player::SongBorder()
 {
@@ -882,6 +1187,11 @@ Player::SongBorder()
 	FormatDefault(player_domain, "played \"%s\"", song->GetURI());
 
 	ReplacePipe(dc.pipe);
+	ResetBufferPeriod();
+
+	/* the decoder may be waiting for chunks which were held by
+	   the previous song's pipe; make sure it gets woken up */
+	decoder_woken = false;
 
 	pc.outputs.SongBorder();
 
@@ -907,7 +1217,7 @@ Player::SongBorder()
 inline void
 Player::Run()
 {
-	pipe = new MusicPipe();
+	pipe = new DecoderPipe(buffer.GetSize());
 
 	StartDecoder(*pipe);
 	if (!WaitForDecoder()) {
@@ -981,13 +1291,29 @@ Player::Run()
 		*/
 #endif
 
-		if (dc.LockIsIdle() && queued && dc.pipe == pipe) {
-			/* the decoder has finished the current song;
-			   make it decode the next song */
+		if (queued && dc.pipe == pipe) {
+			pc.Lock();
 
-			assert(dc.pipe == nullptr || dc.pipe == pipe);
+			/* check again, the decoder may have switched
+			   to the chained song meanwhile */
+			const bool idle = dc.pipe == pipe && dc.IsIdle();
+			DecoderPipe *chain_pipe = nullptr;
+			if (idle)
+				/* the decoder has ended before it could
+				   switch to the chained song */
+				chain_pipe = dc.CancelChain();
+			else if (dc.pipe == pipe)
+				ChainDecoder();
+
+			pc.Unlock();
 
-			StartDecoder(*new MusicPipe());
+			if (idle) {
+				/* the decoder has finished the current
+				   song; make it decode the next song */
+
+				delete chain_pipe;
+				StartDecoder(*new DecoderPipe(buffer.GetSize()));
+			}
 		}
 
 		if (/* no cross-fading if MPD is going to pause at the
@@ -1007,8 +1333,18 @@ Player::Run()
 							dc.GetMixRampPreviousEnd(),
 							dc.out_audio_format,
 							play_audio_format,
+							buffer.GetChunkSize(),
 							buffer.GetSize() -
 							pc.buffered_before_play);
+			if (cross_fade_chunks > 0 && pc.buffer_adaptive) {
+				/* make room for the cross-fade
+				   chunks */
+				const unsigned min_limit =
+					GetMinBufferLimit(cross_fade_chunks);
+				if (buffer.GetLimit() < min_limit)
+					buffer.SetLimit(min_limit);
+			}
+
 			if (cross_fade_chunks > 0) {
 				xfade_state = CrossFadeState::ENABLED;
 				cross_fading = false;
@@ -1061,6 +1397,7 @@ Player::Run()
 			/* the decoder is too busy and hasn't provided
 			   new PCM data in time: send silence (if the
 			   output pipe is empty) */
+			pipeline_stats.underruns.fetch_add(1, std::memory_order_relaxed);
 			if (!SendSilence())
 				break;
 		}
@@ -1108,11 +1445,18 @@ player_task(void *arg)
 	PlayerControl &pc = *(PlayerControl *)arg;
 
 	SetThreadName("player");
+	thread_scheduling_apply("player");
 
 	DecoderControl dc(pc.mutex, pc.cond);
 	decoder_thread_start(dc);
 
-	MusicBuffer buffer(pc.buffer_chunks);
+	MusicBuffer buffer(pc.buffer_chunks, pc.buffer_chunk_size);
+	if (pc.buffer_adaptive)
+		/* start small; Player::AdaptBufferLimit() will grow
+		   the limit if the decoder is too slow */
+		buffer.SetLimit(std::min(pc.buffered_before_play +
+					 ADAPTIVE_BUFFER_RESERVE,
+					 buffer.GetSize()));
 
 	pc.Lock();
 
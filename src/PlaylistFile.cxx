@@ -40,6 +40,8 @@
 #include "util/UriUtil.hxx"
 #include "util/Error.hxx"
 
+#include <map>
+
 #include <assert.h>
 #include <sys/stat.h>
 #include <string.h>
@@ -50,6 +52,105 @@ static const char PLAYLIST_COMMENT = '#';
 static unsigned playlist_max_length;
 bool playlist_saveAbsolutePaths = DEFAULT_PLAYLIST_SAVE_ABSOLUTE_PATHS;
 
+/**
+ * Caches the parsed contents of stored playlists, so repeated
+ * "listplaylist" calls and edits don't parse the file again.  An
+ * entry is valid as long as the file's inode, size and modification
+ * time are unchanged.  Only used by the main thread.
+ */
+class PlaylistFileCache {
+	struct Item {
+		dev_t device;
+		ino_t inode;
+		off_t size;
+		time_t mtime;
+
+		/** for evicting the least recently used item */
+		unsigned long last_used;
+
+		PlaylistFileContents contents;
+
+		bool Matches(const struct stat &st) const {
+			return device == st.st_dev && inode == st.st_ino &&
+				size == st.st_size && mtime == st.st_mtime;
+		}
+	};
+
+	std::map<std::string, Item> map;
+
+	/**
+	 * The total number of URIs in all items.
+	 */
+	size_t n_uris;
+
+	unsigned long clock;
+
+public:
+	PlaylistFileCache():n_uris(0), clock(0) {}
+
+	const PlaylistFileContents *Get(const std::string &name,
+					const struct stat &st) {
+		auto i = map.find(name);
+		if (i == map.end())
+			return nullptr;
+
+		if (!i->second.Matches(st)) {
+			Erase(i);
+			return nullptr;
+		}
+
+		i->second.last_used = ++clock;
+		return &i->second.contents;
+	}
+
+	void Put(const std::string &name, const struct stat &st,
+		 PlaylistFileContents &&contents) {
+		Erase(name);
+
+		/* allow as many URIs as four maximum size playlists */
+		const size_t max_uris = size_t(playlist_max_length) * 4;
+		if (contents.size() > max_uris)
+			return;
+
+		while (n_uris + contents.size() > max_uris)
+			EvictOldest();
+
+		Item &item = map[name];
+		item.device = st.st_dev;
+		item.inode = st.st_ino;
+		item.size = st.st_size;
+		item.mtime = st.st_mtime;
+		item.last_used = ++clock;
+		item.contents = std::move(contents);
+		n_uris += item.contents.size();
+	}
+
+	void Erase(const std::string &name) {
+		auto i = map.find(name);
+		if (i != map.end())
+			Erase(i);
+	}
+
+private:
+	void Erase(std::map<std::string, Item>::iterator i) {
+		n_uris -= i->second.contents.size();
+		map.erase(i);
+	}
+
+	void EvictOldest() {
+		assert(!map.empty());
+
+		auto oldest = map.begin();
+		for (auto i = map.begin(); i != map.end(); ++i)
+			if (i->second.last_used < oldest->second.last_used)
+				oldest = i;
+
+		Erase(oldest);
+	}
+};
+
+static PlaylistFileCache playlist_file_cache;
+
 void
 spl_global_init(void)
 {
@@ -213,8 +314,13 @@ ListPlaylistFiles(Error &error)
 	return list;
 }
 
+/**
+ * Write the new contents to a temporary file and replace the old
+ * file with it, so a crash never leaves a truncated playlist.  The
+ * contents are then moved to the cache.
+ */
 static bool
-SavePlaylistFile(const PlaylistFileContents &contents, const char *utf8path,
+SavePlaylistFile(PlaylistFileContents &&contents, const char *utf8path,
 		 Error &error)
 {
 	assert(utf8path != nullptr);
@@ -226,7 +332,12 @@ SavePlaylistFile(const PlaylistFileContents &contents, const char *utf8path,
 	if (path_fs.IsNull())
 		return false;
 
-	FILE *file = FOpen(path_fs, FOpenMode::WriteText);
+	playlist_file_cache.Erase(utf8path);
+
+	const auto tmp_path_fs =
+		AllocatedPath::FromFS(path_fs.c_str() + std::string(".tmp"));
+
+	FILE *file = FOpen(tmp_path_fs, FOpenMode::WriteText);
 	if (file == nullptr) {
 		playlist_errno(error);
 		return false;
@@ -235,7 +346,22 @@ SavePlaylistFile(const PlaylistFileContents &contents, const char *utf8path,
 	for (const auto &uri_utf8 : contents)
 		playlist_print_uri(file, uri_utf8.c_str());
 
-	fclose(file);
+	if (ferror(file) || fclose(file) != 0) {
+		error.SetErrno();
+		RemoveFile(tmp_path_fs);
+		return false;
+	}
+
+	if (!RenameFile(tmp_path_fs, path_fs)) {
+		playlist_errno(error);
+		RemoveFile(tmp_path_fs);
+		return false;
+	}
+
+	struct stat st;
+	if (StatFile(path_fs, st))
+		playlist_file_cache.Put(utf8path, st, std::move(contents));
+
 	return true;
 }
 
@@ -251,8 +377,20 @@ LoadPlaylistFile(const char *utf8path, Error &error)
 	if (path_fs.IsNull())
 		return contents;
 
+	struct stat st;
+	const bool have_stat = StatFile(path_fs, st);
+	if (have_stat) {
+		const auto *cached = playlist_file_cache.Get(utf8path, st);
+		if (cached != nullptr)
+			return *cached;
+	}
+
+	/* stat before reading: if the file is modified meanwhile,
+	   the cache entry will not match next time */
+
 	TextFile file(path_fs, error);
 	if (file.HasFailed()) {
+		playlist_file_cache.Erase(utf8path);
 		TranslatePlaylistError(error);
 		return contents;
 	}
@@ -291,6 +429,10 @@ LoadPlaylistFile(const char *utf8path, Error &error)
 			break;
 	}
 
+	if (have_stat && S_ISREG(st.st_mode))
+		playlist_file_cache.Put(utf8path, st,
+					PlaylistFileContents(contents));
+
 	return contents;
 }
 
@@ -320,7 +462,7 @@ spl_move_index(const char *utf8path, unsigned src, unsigned dest,
 	const auto dest_i = std::next(contents.begin(), dest);
 	contents.insert(dest_i, std::move(value));
 
-	bool result = SavePlaylistFile(contents, utf8path, error);
+	bool result = SavePlaylistFile(std::move(contents), utf8path, error);
 
 	idle_add(IDLE_STORED_PLAYLIST);
 	return result;
@@ -336,6 +478,8 @@ spl_clear(const char *utf8path, Error &error)
 	if (path_fs.IsNull())
 		return false;
 
+	playlist_file_cache.Erase(utf8path);
+
 	FILE *file = FOpen(path_fs, FOpenMode::WriteText);
 	if (file == nullptr) {
 		playlist_errno(error);
@@ -355,6 +499,8 @@ spl_delete(const char *name_utf8, Error &error)
 	if (path_fs.IsNull())
 		return false;
 
+	playlist_file_cache.Erase(name_utf8);
+
 	if (!RemoveFile(path_fs)) {
 		playlist_errno(error);
 		return false;
@@ -379,7 +525,7 @@ spl_remove_index(const char *utf8path, unsigned pos, Error &error)
 
 	contents.erase(std::next(contents.begin(), pos));
 
-	bool result = SavePlaylistFile(contents, utf8path, error);
+	bool result = SavePlaylistFile(std::move(contents), utf8path, error);
 
 	idle_add(IDLE_STORED_PLAYLIST);
 	return result;
@@ -395,6 +541,8 @@ spl_append_song(const char *utf8path, const DetachedSong &song, Error &error)
 	if (path_fs.IsNull())
 		return false;
 
+	playlist_file_cache.Erase(utf8path);
+
 	FILE *file = FOpen(path_fs, FOpenMode::AppendText);
 	if (file == nullptr) {
 		playlist_errno(error);
@@ -476,5 +624,8 @@ spl_rename(const char *utf8from, const char *utf8to, Error &error)
 	if (to_path_fs.IsNull())
 		return false;
 
+	playlist_file_cache.Erase(utf8from);
+	playlist_file_cache.Erase(utf8to);
+
 	return spl_rename_internal(from_path_fs, to_path_fs, error);
 }
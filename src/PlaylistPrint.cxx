@@ -116,7 +116,7 @@ playlist_print_changes_position(Client &client,
 static bool
 PrintSongDetails(Client &client, const char *uri_utf8)
 {
-	const Database *db = client.partition.instance.database;
+	const Database *db = client.GetInstance().database;
 	if (db == nullptr)
 		return false;
 
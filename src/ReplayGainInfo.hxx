@@ -34,6 +34,10 @@ struct ReplayGainTuple {
 	float gain;
 	float peak;
 
+	static constexpr ReplayGainTuple Undefined() {
+		return {-200.0f, 0.0f};
+	}
+
 	void Clear() {
 		gain = -200;
 		peak = 0.0;
@@ -52,6 +56,21 @@ struct ReplayGainTuple {
 struct ReplayGainInfo {
 	ReplayGainTuple tuples[2];
 
+	static constexpr ReplayGainInfo Undefined() {
+		return {
+			{
+				ReplayGainTuple::Undefined(),
+				ReplayGainTuple::Undefined(),
+			}
+		};
+	}
+
+	gcc_pure
+	bool IsDefined() const {
+		return tuples[REPLAY_GAIN_ALBUM].IsDefined() ||
+			tuples[REPLAY_GAIN_TRACK].IsDefined();
+	}
+
 	void Clear() {
 		tuples[REPLAY_GAIN_ALBUM].Clear();
 		tuples[REPLAY_GAIN_TRACK].Clear();
@@ -22,11 +22,20 @@
 #include "db/LightSong.hxx"
 #include "DetachedSong.hxx"
 #include "tag/Tag.hxx"
+#include "tag/TagPool.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/ASCII.hxx"
 #include "util/UriUtil.hxx"
+#include "util/StringUtil.hxx"
+#include "util/CharUtil.hxx"
 #include "lib/icu/Collate.hxx"
 
+#ifdef ENABLE_SQLITE
+#include "sticker/StickerCache.hxx"
+#endif
+
+#include <algorithm>
+
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
@@ -34,6 +43,75 @@
 #define LOCATE_TAG_FILE_KEY     "file"
 #define LOCATE_TAG_FILE_KEY_OLD "filename"
 #define LOCATE_TAG_ANY_KEY      "any"
+#define LOCATE_TAG_STICKER_PREFIX "sticker:"
+
+enum StickerOperator : uint8_t {
+	STICKER_OP_EQUAL,
+	STICKER_OP_NOT_EQUAL,
+	STICKER_OP_LESS,
+	STICKER_OP_LESS_EQUAL,
+	STICKER_OP_GREATER,
+	STICKER_OP_GREATER_EQUAL,
+};
+
+/**
+ * Parse the comparison operator at the beginning of a
+ * #LOCATE_TAG_STICKER value and skip it.
+ */
+static StickerOperator
+ParseStickerOperator(const char *&p)
+{
+	StickerOperator op;
+
+	if (p[0] == '!' && p[1] == '=') {
+		op = STICKER_OP_NOT_EQUAL;
+		p += 2;
+	} else if (p[0] == '<' && p[1] == '=') {
+		op = STICKER_OP_LESS_EQUAL;
+		p += 2;
+	} else if (p[0] == '>' && p[1] == '=') {
+		op = STICKER_OP_GREATER_EQUAL;
+		p += 2;
+	} else if (p[0] == '<') {
+		op = STICKER_OP_LESS;
+		++p;
+	} else if (p[0] == '>') {
+		op = STICKER_OP_GREATER;
+		++p;
+	} else {
+		op = STICKER_OP_EQUAL;
+		if (p[0] == '=')
+			++p;
+	}
+
+	while (*p == ' ')
+		++p;
+
+	return op;
+}
+
+#ifdef ENABLE_SQLITE
+
+/**
+ * Compare two sticker values numerically if both are numbers, or
+ * else as strings.
+ */
+gcc_pure
+static int
+CompareStickerValues(const char *a, const char *b)
+{
+	char *a_end, *b_end;
+	const double a_number = strtod(a, &a_end);
+	const double b_number = strtod(b, &b_end);
+	if (a_end > a && *a_end == 0 && b_end > b && *b_end == 0)
+		return a_number < b_number
+			? -1
+			: (a_number > b_number ? 1 : 0);
+
+	return strcmp(a, b);
+}
+
+#endif
 
 unsigned
 locate_parse_type(const char *str)
@@ -65,15 +143,66 @@ ImportString(const char *p, bool fold_case)
 
 SongFilter::Item::Item(unsigned _tag, const char *_value, bool _fold_case)
 	:tag(_tag), fold_case(_fold_case),
-	 value(ImportString(_value, _fold_case))
+	 value(ImportString(_value, _fold_case)),
+	 time(0)
 {
 }
 
 SongFilter::Item::Item(unsigned _tag, time_t _time)
-	:tag(_tag), time(_time)
+	:tag(_tag), fold_case(false), time(_time)
+{
+}
+
+SongFilter::Item::Item(TagType _type, const char *_value,
+		       unsigned _min, unsigned _max)
+	:tag(LOCATE_TAG_NUMBER_RANGE), fold_case(false),
+	 value(_value), time(0),
+	 number_type(_type), number_min(_min), number_max(_max)
 {
 }
 
+SongFilter::Item::Item(const char *_sticker_name, const char *_value)
+	:tag(LOCATE_TAG_STICKER), fold_case(false),
+	 value(_value), time(0),
+	 sticker_name(_sticker_name)
+{
+	const char *p = _value;
+	sticker_op = ParseStickerOperator(p);
+	sticker_operand = p;
+}
+
+unsigned
+SongFilter::Item::GetCost() const
+{
+	switch (tag) {
+	case LOCATE_TAG_MODIFIED_SINCE:
+	case LOCATE_TAG_NUMBER_RANGE:
+		/* compares integers which are already parsed */
+		return 0;
+
+	case LOCATE_TAG_BASE_TYPE:
+		/* needs the full URI, which is built from the
+		   directory and the file name */
+		return 2;
+
+	case LOCATE_TAG_STICKER:
+		/* needs the URI and a hash table lookup with a
+		   lock */
+		return 3;
+
+	case LOCATE_TAG_FILE_TYPE:
+		/* the URI is not in the tag pool, so it must be case
+		   folded for each song */
+		return fold_case ? 6 : 2;
+
+	case LOCATE_TAG_ANY_TYPE:
+		return fold_case ? 5 : 4;
+
+	default:
+		return fold_case ? 3 : 1;
+	}
+}
+
 bool
 SongFilter::Item::StringMatch(const char *s) const
 {
@@ -87,49 +216,129 @@ SongFilter::Item::StringMatch(const char *s) const
 	}
 }
 
+bool
+SongFilter::Item::StringMatch(const TagItem &item) const
+{
+	if (fold_case) {
+		const char *folded = tag_pool_get_folded(&item, IcuCaseFold);
+		return strstr(folded, value.c_str()) != nullptr;
+	} else {
+		return item.value == value;
+	}
+}
+
+bool
+SongFilter::Item::MatchNumber(const Tag &_tag) const
+{
+	assert(tag == LOCATE_TAG_NUMBER_RANGE);
+
+	const unsigned n = _tag.GetNumber(TagType(number_type));
+	return n > 0 && n >= number_min && n <= number_max;
+}
+
+bool
+SongFilter::Item::MatchSticker(const char *uri) const
+{
+	assert(tag == LOCATE_TAG_STICKER);
+
+#ifdef ENABLE_SQLITE
+	std::string sticker_value;
+	if (!sticker_cache_get(uri, sticker_name.c_str(), sticker_value))
+		/* songs without this sticker never match */
+		return false;
+
+	const int cmp = CompareStickerValues(sticker_value.c_str(),
+					     sticker_operand.c_str());
+	switch (StickerOperator(sticker_op)) {
+	case STICKER_OP_EQUAL:
+		return cmp == 0;
+
+	case STICKER_OP_NOT_EQUAL:
+		return cmp != 0;
+
+	case STICKER_OP_LESS:
+		return cmp < 0;
+
+	case STICKER_OP_LESS_EQUAL:
+		return cmp <= 0;
+
+	case STICKER_OP_GREATER:
+		return cmp > 0;
+
+	case STICKER_OP_GREATER_EQUAL:
+		return cmp >= 0;
+	}
+#else
+	(void)uri;
+#endif
+
+	return false;
+}
+
 bool
 SongFilter::Item::Match(const TagItem &item) const
 {
 	return (tag == LOCATE_TAG_ANY_TYPE || (unsigned)item.type == tag) &&
-		StringMatch(item.value);
+		StringMatch(item);
 }
 
 bool
 SongFilter::Item::Match(const Tag &_tag) const
 {
-	bool visited_types[TAG_NUM_OF_ITEM_TYPES];
-	std::fill_n(visited_types, size_t(TAG_NUM_OF_ITEM_TYPES), false);
+	if (tag < TAG_NUM_OF_ITEM_TYPES)
+		return Match(_tag, GetTagTypeMask(_tag));
 
-	for (const auto &i : _tag) {
-		visited_types[i.type] = true;
+	if (tag == LOCATE_TAG_NUMBER_RANGE)
+		return MatchNumber(_tag);
 
+	for (const auto &i : _tag)
 		if (Match(i))
 			return true;
+
+	return false;
+}
+
+bool
+SongFilter::Item::Match(const Tag &_tag, uint32_t present) const
+{
+	assert(tag < TAG_NUM_OF_ITEM_TYPES);
+
+	if (present & (uint32_t(1) << tag)) {
+		for (const auto &i : _tag)
+			if (i.type == tag && StringMatch(i))
+				return true;
+
+		return false;
 	}
 
-	if (tag < TAG_NUM_OF_ITEM_TYPES && !visited_types[tag]) {
-		/* If the search critieron was not visited during the
-		   sweep through the song's tag, it means this field
-		   is absent from the tag or empty. Thus, if the
-		   searched string is also empty
-		   then it's a match as well and we should return
-		   true. */
-		if (value.empty())
-			return true;
+	/* If the search critieron is absent from the tag, and the
+	   searched string is also empty then it's a match as well
+	   and we should return true. */
+	if (value.empty())
+		return true;
 
-		if (tag == TAG_ALBUM_ARTIST && visited_types[TAG_ARTIST]) {
-			/* if we're looking for "album artist", but
-			   only "artist" exists, use that */
-			for (const auto &item : _tag)
-				if (item.type == TAG_ARTIST &&
-				    StringMatch(item.value))
-					return true;
-		}
+	if (tag == TAG_ALBUM_ARTIST &&
+	    (present & (uint32_t(1) << TAG_ARTIST))) {
+		/* if we're looking for "album artist", but only
+		   "artist" exists, use that */
+		for (const auto &item : _tag)
+			if (item.type == TAG_ARTIST && StringMatch(item))
+				return true;
 	}
 
 	return false;
 }
 
+bool
+SongFilter::Item::MatchURI(const char *uri) const
+{
+	assert(tag == LOCATE_TAG_BASE_TYPE || tag == LOCATE_TAG_FILE_TYPE);
+
+	return tag == LOCATE_TAG_BASE_TYPE
+		? uri_is_child_or_same(value.c_str(), uri)
+		: StringMatch(uri);
+}
+
 bool
 SongFilter::Item::Match(const DetachedSong &song) const
 {
@@ -139,9 +348,15 @@ SongFilter::Item::Match(const DetachedSong &song) const
 	if (tag == LOCATE_TAG_MODIFIED_SINCE)
 		return song.GetLastModified() >= time;
 
+	if (tag == LOCATE_TAG_NUMBER_RANGE)
+		return MatchNumber(song.GetTag());
+
 	if (tag == LOCATE_TAG_FILE_TYPE)
 		return StringMatch(song.GetURI());
 
+	if (tag == LOCATE_TAG_STICKER)
+		return MatchSticker(song.GetURI());
+
 	return Match(song.GetTag());
 }
 
@@ -156,11 +371,19 @@ SongFilter::Item::Match(const LightSong &song) const
 	if (tag == LOCATE_TAG_MODIFIED_SINCE)
 		return song.mtime >= time;
 
+	if (tag == LOCATE_TAG_NUMBER_RANGE)
+		return MatchNumber(*song.tag);
+
 	if (tag == LOCATE_TAG_FILE_TYPE) {
 		const auto uri = song.GetURI();
 		return StringMatch(uri.c_str());
 	}
 
+	if (tag == LOCATE_TAG_STICKER) {
+		const auto uri = song.GetURI();
+		return MatchSticker(uri.c_str());
+	}
+
 	return Match(*song.tag);
 }
 
@@ -169,6 +392,29 @@ SongFilter::SongFilter(unsigned tag, const char *value, bool fold_case)
 	items.push_back(Item(tag, value, fold_case));
 }
 
+uint32_t
+SongFilter::GetTagTypeMask(const Tag &tag)
+{
+	static_assert(TAG_NUM_OF_ITEM_TYPES <= 32, "too many tag types");
+
+	uint32_t mask = 0;
+	for (const auto &i : tag)
+		mask |= uint32_t(1) << i.type;
+
+	return mask;
+}
+
+void
+SongFilter::Add(Item &&item)
+{
+	const unsigned cost = item.GetCost();
+	const auto i = std::upper_bound(items.begin(), items.end(), cost,
+					[](unsigned c, const Item &other){
+						return c < other.GetCost();
+					});
+	items.insert(i, std::move(item));
+}
+
 SongFilter::~SongFilter()
 {
 	/* this destructor exists here just so it won't get inlined */
@@ -226,9 +472,93 @@ ParseTimeStamp(const char *s)
 #endif /* !WIN32 */
 }
 
+/**
+ * Parse a decimal number at the beginning of the string.
+ *
+ * @return false if there is no number
+ */
+static bool
+ParseRangeNumber(const char *&p, unsigned &value_r)
+{
+	if (!IsDigitASCII(*p))
+		return false;
+
+	char *endptr;
+	unsigned long value = strtoul(p, &endptr, 10);
+	if (value > 0xffff)
+		return false;
+
+	p = endptr;
+	value_r = value;
+	return true;
+}
+
+/**
+ * Parse a numeric range: "MIN-MAX", "MIN-", "-MAX" or a single
+ * number.
+ */
+static bool
+ParseNumberRange(const char *p, unsigned &min_r, unsigned &max_r)
+{
+	min_r = 0;
+	max_r = 0xffff;
+
+	if (*p != '-' && !ParseRangeNumber(p, min_r))
+		return false;
+
+	if (*p == 0) {
+		/* a single number */
+		max_r = min_r;
+		return true;
+	}
+
+	if (*p != '-')
+		return false;
+
+	++p;
+	if (*p != 0 && !ParseRangeNumber(p, max_r))
+		return false;
+
+	return *p == 0 && min_r <= max_r;
+}
+
+bool
+SongFilter::ParseRange(const char *tag_string, const char *value)
+{
+	assert(StringEndsWith(tag_string, "-range"));
+
+	const std::string name(tag_string,
+			       strlen(tag_string) - sizeof("-range") + 1);
+	const TagType type = tag_name_parse_i(name.c_str());
+	if (!Tag::IsNumberType(type))
+		return false;
+
+	unsigned min, max;
+	if (!ParseNumberRange(value, min, max))
+		return false;
+
+	Add(Item(type, value, min, max));
+	return true;
+}
+
 bool
 SongFilter::Parse(const char *tag_string, const char *value, bool fold_case)
 {
+	if (StringEndsWith(tag_string, "-range"))
+		return ParseRange(tag_string, value);
+
+#ifdef ENABLE_SQLITE
+	if (StringStartsWith(tag_string, LOCATE_TAG_STICKER_PREFIX)) {
+		const char *sticker_name = tag_string +
+			sizeof(LOCATE_TAG_STICKER_PREFIX) - 1;
+		if (*sticker_name == 0)
+			return false;
+
+		Add(Item(sticker_name, value));
+		return true;
+	}
+#endif
+
 	unsigned tag = locate_parse_type(tag_string);
 	if (tag == TAG_NUM_OF_ITEM_TYPES)
 		return false;
@@ -246,11 +576,11 @@ SongFilter::Parse(const char *tag_string, const char *value, bool fold_case)
 		if (t == 0)
 			return false;
 
-		items.push_back(Item(tag, t));
+		Add(Item(tag, t));
 		return true;
 	}
 
-	items.push_back(Item(tag, value, fold_case));
+	Add(Item(tag, value, fold_case));
 	return true;
 }
 
@@ -270,9 +600,24 @@ SongFilter::Parse(ConstBuffer<const char *> args, bool fold_case)
 bool
 SongFilter::Match(const DetachedSong &song) const
 {
-	for (const auto &i : items)
-		if (!i.Match(song))
+	/* the tag type mask is calculated only once, when the first
+	   item needs it */
+	uint32_t present = 0;
+	bool have_present = false;
+
+	for (const auto &i : items) {
+		const unsigned tag = i.GetTag();
+		if (tag < TAG_NUM_OF_ITEM_TYPES) {
+			if (!have_present) {
+				present = GetTagTypeMask(song.GetTag());
+				have_present = true;
+			}
+
+			if (!i.Match(song.GetTag(), present))
+				return false;
+		} else if (!i.Match(song))
 			return false;
+	}
 
 	return true;
 }
@@ -280,9 +625,46 @@ SongFilter::Match(const DetachedSong &song) const
 bool
 SongFilter::Match(const LightSong &song) const
 {
-	for (const auto &i : items)
-		if (!i.Match(song))
+	/* the URI and the tag type mask are calculated only once,
+	   when the first item needs them */
+	std::string uri;
+	uint32_t present = 0;
+	bool have_present = false;
+
+	for (const auto &i : items) {
+		bool match;
+
+		switch (const unsigned tag = i.GetTag()) {
+		case LOCATE_TAG_BASE_TYPE:
+		case LOCATE_TAG_FILE_TYPE:
+			if (uri.empty())
+				uri = song.GetURI();
+
+			match = i.MatchURI(uri.c_str());
+			break;
+
+		case LOCATE_TAG_STICKER:
+			if (uri.empty())
+				uri = song.GetURI();
+
+			match = i.MatchSticker(uri.c_str());
+			break;
+
+		default:
+			if (tag < TAG_NUM_OF_ITEM_TYPES) {
+				if (!have_present) {
+					present = GetTagTypeMask(*song.tag);
+					have_present = true;
+				}
+
+				match = i.Match(*song.tag, present);
+			} else
+				match = i.Match(song);
+		}
+
+		if (!match)
 			return false;
+	}
 
 	return true;
 }
@@ -20,10 +20,11 @@
 #ifndef MPD_SONG_FILTER_HXX
 #define MPD_SONG_FILTER_HXX
 
+#include "tag/TagType.h"
 #include "Compiler.h"
 
-#include <list>
 #include <string>
+#include <vector>
 
 #include <stdint.h>
 #include <time.h>
@@ -34,6 +35,18 @@
 #define LOCATE_TAG_BASE_TYPE (TAG_NUM_OF_ITEM_TYPES + 1)
 #define LOCATE_TAG_MODIFIED_SINCE (TAG_NUM_OF_ITEM_TYPES + 2)
 
+/**
+ * Compare the numeric value of a tag (see Tag::GetNumber()) with a
+ * range, e.g. "date-range" "1990-1999".
+ */
+#define LOCATE_TAG_NUMBER_RANGE (TAG_NUM_OF_ITEM_TYPES + 3)
+
+/**
+ * Compare the value of a song sticker, e.g. "sticker:rating" ">=4".
+ * The values are looked up in the #StickerCache.
+ */
+#define LOCATE_TAG_STICKER (TAG_NUM_OF_ITEM_TYPES + 4)
+
 #define LOCATE_TAG_FILE_TYPE	TAG_NUM_OF_ITEM_TYPES+10
 #define LOCATE_TAG_ANY_TYPE     TAG_NUM_OF_ITEM_TYPES+20
 
@@ -58,15 +71,52 @@ public:
 		 */
 		time_t time;
 
+		/**
+		 * For #LOCATE_TAG_NUMBER_RANGE: the tag type and the
+		 * inclusive range of its numeric value.
+		 */
+		uint8_t number_type;
+		unsigned number_min, number_max;
+
+		/**
+		 * For #LOCATE_TAG_STICKER: the sticker name, the
+		 * comparison operator and its operand (#value is the
+		 * unparsed operator and operand).
+		 */
+		std::string sticker_name, sticker_operand;
+		uint8_t sticker_op;
+
 	public:
 		gcc_nonnull(3)
 		Item(unsigned tag, const char *value, bool fold_case=false);
 		Item(unsigned tag, time_t time);
 
+		/**
+		 * Construct a #LOCATE_TAG_NUMBER_RANGE item.
+		 *
+		 * @param value the range specification, used only for
+		 * GetValue()
+		 */
+		gcc_nonnull(3)
+		Item(TagType type, const char *value,
+		     unsigned min, unsigned max);
+
+		/**
+		 * Construct a #LOCATE_TAG_STICKER item.
+		 *
+		 * @param value an optional comparison operator ("=",
+		 * "!=", "<", "<=", ">", ">=") followed by the operand;
+		 * numbers are compared numerically, everything else
+		 * as a string
+		 */
+		gcc_nonnull_all
+		Item(const char *sticker_name, const char *value);
+
 		Item(const Item &other) = delete;
 		Item(Item &&) = default;
 
 		Item &operator=(const Item &other) = delete;
+		Item &operator=(Item &&) = default;
 
 		unsigned GetTag() const {
 			return tag;
@@ -80,15 +130,69 @@ public:
 			return value;
 		}
 
+		time_t GetTime() const {
+			return time;
+		}
+
+		const std::string &GetStickerName() const {
+			return sticker_name;
+		}
+
+		/**
+		 * A rough estimate of how expensive Match() is.
+		 * #SongFilter evaluates the cheap items first, so the
+		 * expensive ones run only on songs which passed all
+		 * others.
+		 */
+		gcc_pure
+		unsigned GetCost() const;
+
 		gcc_pure gcc_nonnull(2)
 		bool StringMatch(const char *s) const;
 
+		/**
+		 * Like StringMatch(const char *), but uses the case
+		 * folded value which is cached in the tag pool.
+		 */
+		gcc_pure
+		bool StringMatch(const TagItem &item) const;
+
+		/**
+		 * Match a #LOCATE_TAG_NUMBER_RANGE item.
+		 */
+		gcc_pure
+		bool MatchNumber(const Tag &tag) const;
+
+		/**
+		 * Match a #LOCATE_TAG_STICKER item against the
+		 * sticker of the song with the given URI.
+		 */
+		gcc_pure gcc_nonnull_all
+		bool MatchSticker(const char *uri) const;
+
 		gcc_pure
 		bool Match(const TagItem &tag_item) const;
 
 		gcc_pure
 		bool Match(const Tag &tag) const;
 
+		/**
+		 * Like Match(const Tag &), but for an item with a
+		 * specific tag type, with a precalculated bit mask of
+		 * the item types present in the tag (see
+		 * GetTagTypeMask()); a tag without the type is
+		 * rejected without looking at its items.
+		 */
+		gcc_pure
+		bool Match(const Tag &tag, uint32_t present) const;
+
+		/**
+		 * Match an item of type #LOCATE_TAG_BASE_TYPE or
+		 * #LOCATE_TAG_FILE_TYPE against the song URI.
+		 */
+		gcc_pure gcc_nonnull_all
+		bool MatchURI(const char *uri) const;
+
 		gcc_pure
 		bool Match(const DetachedSong &song) const;
 
@@ -97,7 +201,12 @@ public:
 	};
 
 private:
-	std::list<Item> items;
+	/**
+	 * The items, sorted by Item::GetCost().  The order in which
+	 * they were parsed is irrelevant, because all of them must
+	 * match.
+	 */
+	std::vector<Item> items;
 
 public:
 	SongFilter() = default;
@@ -121,7 +230,7 @@ public:
 	gcc_pure
 	bool Match(const LightSong &song) const;
 
-	const std::list<Item> &GetItems() const {
+	const std::vector<Item> &GetItems() const {
 		return items;
 	}
 
@@ -154,6 +263,26 @@ public:
 	 */
 	gcc_pure
 	std::string GetBase() const;
+
+	/**
+	 * Returns a bit mask of the item types present in the tag;
+	 * bit n stands for #TagType n.
+	 */
+	gcc_pure
+	static uint32_t GetTagTypeMask(const Tag &tag);
+
+private:
+	/**
+	 * Parse a "TAG-range" filter (e.g. "date-range" "1990-1999")
+	 * for a tag type which has a numeric value.
+	 */
+	gcc_nonnull_all
+	bool ParseRange(const char *tag_string, const char *value);
+
+	/**
+	 * Insert the item before all items which are more expensive.
+	 */
+	void Add(Item &&item);
 };
 
 /**
@@ -27,6 +27,8 @@
 #include "client/Client.hxx"
 #include "util/UriUtil.hxx"
 
+#include <string.h>
+
 #define SONG_FILE "file: "
 
 static void
@@ -51,15 +53,22 @@ song_print_uri(Client &client, const char *uri, bool base)
 			uri = allocated.c_str();
 	}
 
-	client_printf(client, "%s%s\n", SONG_FILE, uri);
+	client_write_pair(client, SONG_FILE, uri);
 }
 
 void
 song_print_uri(Client &client, const LightSong &song, bool base)
 {
 	if (!base && song.directory != nullptr) {
-		client_printf(client, "%s%s/%s\n", SONG_FILE,
-			      song.directory, song.uri);
+		const ConstBuffer<void> parts[] = {
+			{ SONG_FILE, sizeof(SONG_FILE) - 1 },
+			{ song.directory, strlen(song.directory) },
+			{ "/", 1 },
+			{ song.uri, strlen(song.uri) },
+			{ "\n", 1 },
+		};
+
+		client_writev(client, parts, 5);
 	} else
 		song_print_uri(client, song.uri, base);
 }
@@ -92,11 +101,9 @@ song_print_info(Client &client, const LightSong &song, bool base)
 	tag_print(client, *song.tag);
 }
 
-void
-song_print_info(Client &client, const DetachedSong &song, bool base)
+static void
+song_print_attributes(Client &client, const DetachedSong &song)
 {
-	song_print_uri(client, song, base);
-
 	const unsigned start_ms = song.GetStartMS();
 	const unsigned end_ms = song.GetEndMS();
 
@@ -118,5 +125,51 @@ song_print_info(Client &client, const DetachedSong &song, bool base)
 
 	double duration = song.GetDuration();
 	if (duration >= 0)
-		client_printf(client, "Time: %u\n", unsigned(duration + 0.5));
+		client_write_pair(client, "Time: ",
+				  unsigned(duration + 0.5));
+}
+
+void
+song_print_info(Client &client, const DetachedSong &song, bool base)
+{
+	song_print_uri(client, song, base);
+
+	SongPrintCache &cache = song.GetPrintCache();
+	if (cache.IsDefined()) {
+		const std::string &text = cache.Get();
+		client_write(client, text.data(), text.length());
+		return;
+	}
+
+	if (!SongPrintCache::IsEnabled() || client.IsExpired()) {
+		song_print_attributes(client, song);
+		return;
+	}
+
+	/* capture the text while sending it; an outer capture (the
+	   query cache) gets a copy afterwards */
+	std::string *const outer = client.capture;
+	const size_t outer_limit = client.capture_limit;
+
+	std::string text;
+	client.capture = &text;
+	client.capture_limit = SongPrintCache::MAX_ENTRY_SIZE;
+
+	song_print_attributes(client, song);
+
+	const bool complete = client.capture == &text;
+	client.capture = outer;
+	client.capture_limit = outer_limit;
+
+	if (outer != nullptr) {
+		if (complete &&
+		    outer->length() + text.length() <= outer_limit)
+			outer->append(text);
+		else
+			/* too large for the outer cache */
+			client.capture = nullptr;
+	}
+
+	if (complete && !client.IsExpired())
+		cache.Set(std::move(text));
 }
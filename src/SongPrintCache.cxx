@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "SongPrintCache.hxx"
+
+#include <atomic>
+
+#include <assert.h>
+
+static size_t song_print_cache_max_size;
+
+/**
+ * The total size of all cached texts [bytes].  Songs may be
+ * destroyed in other threads, therefore this is atomic.
+ */
+static std::atomic<size_t> song_print_cache_size;
+
+void
+SongPrintCache::SetMaxSize(size_t max_size)
+{
+	song_print_cache_max_size = max_size;
+}
+
+bool
+SongPrintCache::IsEnabled()
+{
+	return song_print_cache_max_size > 0;
+}
+
+void
+SongPrintCache::Set(std::string &&_text)
+{
+	Clear();
+
+	if (_text.empty() || _text.length() > MAX_ENTRY_SIZE)
+		return;
+
+	const size_t length = _text.length();
+	if (song_print_cache_size.fetch_add(length) + length >
+	    song_print_cache_max_size) {
+		/* budget exhausted */
+		song_print_cache_size -= length;
+		return;
+	}
+
+	text = std::move(_text);
+}
+
+void
+SongPrintCache::Release()
+{
+	assert(song_print_cache_size >= text.length());
+
+	song_print_cache_size -= text.length();
+	std::string().swap(text);
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SONG_PRINT_CACHE_HXX
+#define MPD_SONG_PRINT_CACHE_HXX
+
+#include "check.h"
+
+#include <string>
+
+#include <stddef.h>
+
+/**
+ * The protocol representation of a song's attributes, as generated
+ * by song_print_info() (all lines after the "file" line), so
+ * repeated listings of the same song are a simple copy.  It is
+ * cleared by #DetachedSong whenever one of the printed attributes
+ * is modified.
+ *
+ * All instances share one global memory budget; when it is
+ * exhausted, no more text is cached.  A copy of a song starts with
+ * an empty cache.
+ */
+class SongPrintCache {
+	std::string text;
+
+public:
+	SongPrintCache() = default;
+
+	SongPrintCache(const SongPrintCache &) {}
+
+	SongPrintCache(SongPrintCache &&other) {
+		text.swap(other.text);
+	}
+
+	~SongPrintCache() {
+		Clear();
+	}
+
+	SongPrintCache &operator=(const SongPrintCache &) {
+		Clear();
+		return *this;
+	}
+
+	SongPrintCache &operator=(SongPrintCache &&other) {
+		Clear();
+		text.swap(other.text);
+		return *this;
+	}
+
+	/**
+	 * Set the global memory budget [bytes].  0 (the default)
+	 * disables the cache.
+	 */
+	static void SetMaxSize(size_t max_size);
+
+	/**
+	 * Is the cache enabled at all?
+	 */
+	static bool IsEnabled();
+
+	/**
+	 * The maximum size of one entry; larger texts are not
+	 * cached.
+	 */
+	static constexpr size_t MAX_ENTRY_SIZE = 4096;
+
+	bool IsDefined() const {
+		return !text.empty();
+	}
+
+	const std::string &Get() const {
+		return text;
+	}
+
+	/**
+	 * Store a new text, if the global budget permits it.
+	 */
+	void Set(std::string &&_text);
+
+	void Clear() {
+		if (!text.empty())
+			Release();
+	}
+
+private:
+	void Release();
+};
+
+#endif
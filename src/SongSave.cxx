@@ -21,6 +21,8 @@
 #include "SongSave.hxx"
 #include "db/plugins/simple/Song.hxx"
 #include "DetachedSong.hxx"
+#include "ReplayGainInfo.hxx"
+#include "MixRampInfo.hxx"
 #include "TagSave.hxx"
 #include "fs/io/TextFile.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
@@ -35,6 +37,10 @@
 
 #define SONG_MTIME "mtime"
 #define SONG_END "song_end"
+#define SONG_REPLAY_GAIN_TRACK "replay_gain_track"
+#define SONG_REPLAY_GAIN_ALBUM "replay_gain_album"
+#define SONG_MIXRAMP_START "mixramp_start"
+#define SONG_MIXRAMP_END "mixramp_end"
 
 static constexpr Domain song_save_domain("song_save");
 
@@ -47,6 +53,53 @@ range_save(BufferedOutputStream &os, unsigned start_ms, unsigned end_ms)
 		os.Format("Range: %u-\n", start_ms);
 }
 
+static void
+replay_gain_save(BufferedOutputStream &os, const ReplayGainInfo &info)
+{
+	const auto &track = info.tuples[REPLAY_GAIN_TRACK];
+	if (track.IsDefined())
+		os.Format(SONG_REPLAY_GAIN_TRACK ": %.2f %f\n",
+			  track.gain, track.peak);
+
+	const auto &album = info.tuples[REPLAY_GAIN_ALBUM];
+	if (album.IsDefined())
+		os.Format(SONG_REPLAY_GAIN_ALBUM ": %.2f %f\n",
+			  album.gain, album.peak);
+}
+
+static void
+mix_ramp_save(BufferedOutputStream &os, const MixRampInfo &info)
+{
+	if (info.GetStart().IsDefined())
+		os.Format(SONG_MIXRAMP_START ": %s\n",
+			  info.GetStart().Format().c_str());
+
+	if (info.GetEnd().IsDefined())
+		os.Format(SONG_MIXRAMP_END ": %s\n",
+			  info.GetEnd().Format().c_str());
+}
+
+/**
+ * Parse a "gain peak" pair.  The tuple remains undefined if the
+ * value is malformed.
+ */
+static void
+replay_gain_load(ReplayGainTuple &tuple, const char *value)
+{
+	char *endptr;
+	const float gain = strtod(value, &endptr);
+	if (endptr == value)
+		return;
+
+	value = endptr;
+	const float peak = strtod(value, &endptr);
+	if (endptr == value)
+		return;
+
+	tuple.gain = gain;
+	tuple.peak = peak;
+}
+
 void
 song_save(BufferedOutputStream &os, const Song &song)
 {
@@ -55,6 +108,9 @@ song_save(BufferedOutputStream &os, const Song &song)
 	range_save(os, song.start_ms, song.end_ms);
 
 	tag_save(os, song.tag);
+	replay_gain_save(os, song.replay_gain);
+	if (song.mix_ramp != nullptr)
+		mix_ramp_save(os, *song.mix_ramp);
 
 	os.Format(SONG_MTIME ": %li\n", (long)song.mtime);
 	os.Format(SONG_END "\n");
@@ -68,6 +124,8 @@ song_save(BufferedOutputStream &os, const DetachedSong &song)
 	range_save(os, song.GetStartMS(), song.GetEndMS());
 
 	tag_save(os, song.GetTag());
+	replay_gain_save(os, song.GetReplayGain());
+	mix_ramp_save(os, song.GetMixRamp());
 
 	os.Format(SONG_MTIME ": %li\n", (long)song.GetLastModified());
 	os.Format(SONG_END "\n");
@@ -80,6 +138,8 @@ song_load(TextFile &file, const char *uri,
 	DetachedSong *song = new DetachedSong(uri);
 
 	TagBuilder tag;
+	ReplayGainInfo replay_gain = ReplayGainInfo::Undefined();
+	MixRampInfo mix_ramp;
 
 	char *line;
 	while ((line = file.ReadLine()) != nullptr &&
@@ -115,6 +175,16 @@ song_load(TextFile &file, const char *uri,
 
 			song->SetStartMS(start_ms);
 			song->SetEndMS(end_ms);
+		} else if (strcmp(line, SONG_REPLAY_GAIN_TRACK) == 0) {
+			replay_gain_load(replay_gain.tuples[REPLAY_GAIN_TRACK],
+					 value);
+		} else if (strcmp(line, SONG_REPLAY_GAIN_ALBUM) == 0) {
+			replay_gain_load(replay_gain.tuples[REPLAY_GAIN_ALBUM],
+					 value);
+		} else if (strcmp(line, SONG_MIXRAMP_START) == 0) {
+			mix_ramp.SetStart(value);
+		} else if (strcmp(line, SONG_MIXRAMP_END) == 0) {
+			mix_ramp.SetEnd(value);
 		} else {
 			delete song;
 
@@ -125,5 +195,7 @@ song_load(TextFile &file, const char *uri,
 	}
 
 	song->SetTag(tag.Commit());
+	song->SetReplayGain(replay_gain);
+	song->SetMixRamp(mix_ramp);
 	return song;
 }
@@ -34,6 +34,7 @@
 #include "tag/TagHandler.hxx"
 #include "tag/TagId3.hxx"
 #include "tag/ApeTag.hxx"
+#include "tag/TagFileReader.hxx"
 #include "TagFile.hxx"
 #include "TagStream.hxx"
 
@@ -72,8 +73,13 @@ static bool
 tag_scan_fallback(Path path,
 		  const struct tag_handler *handler, void *handler_ctx)
 {
-	return tag_ape_scan2(path, handler, handler_ctx) ||
-		tag_id3_scan(path, handler, handler_ctx);
+	/* open the file only once for both tag formats */
+	TagFileReader reader;
+	if (!reader.Open(path, IgnoreError()))
+		return false;
+
+	return tag_ape_scan2(reader, handler, handler_ctx) ||
+		tag_id3_scan(reader, handler, handler_ctx);
 }
 
 #ifdef ENABLE_DATABASE
@@ -110,6 +116,10 @@ Song::UpdateFile(Storage &storage)
 
 	mtime = info.mtime;
 	tag_builder.Commit(tag);
+
+	/* the file has changed: the analysis must be repeated */
+	replay_gain.Clear();
+	ClearMixRamp();
 	return true;
 }
 
@@ -160,6 +170,7 @@ DetachedSong::Update()
 			tag_scan_fallback(path_fs, &full_tag_handler,
 					  &tag_builder);
 
+		print_cache.Clear();
 		mtime = st.st_mtime;
 		tag_builder.Commit(tag);
 		return true;
@@ -169,6 +180,7 @@ DetachedSong::Update()
 				     &tag_builder))
 			return false;
 
+		print_cache.Clear();
 		mtime = 0;
 		tag_builder.Commit(tag);
 		return true;
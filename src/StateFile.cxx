@@ -22,8 +22,9 @@
 #include "output/OutputState.hxx"
 #include "queue/PlaylistState.hxx"
 #include "fs/io/TextFile.hxx"
-#include "fs/io/FileOutputStream.hxx"
+#include "fs/io/StringOutputStream.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
+#include "fs/io/BackgroundWriter.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "mixer/Volume.hxx"
@@ -40,10 +41,13 @@ StateFile::StateFile(AllocatedPath &&_path, unsigned _interval,
 		     Partition &_partition, EventLoop &_loop)
 	:TimeoutMonitor(_loop),
 	 path(std::move(_path)), path_utf8(path.ToUTF8()),
+	 queue_path(AllocatedPath::FromFS(path.c_str() + std::string(".queue"))),
+	 queue_path_utf8(queue_path.ToUTF8()),
 	 interval(_interval),
 	 partition(_partition),
 	 prev_volume_version(0), prev_output_version(0),
-	 prev_playlist_version(0)
+	 prev_playlist_version(0), prev_queue_version(0),
+	 prev_write_failures(background_writer_get_failures())
 {
 }
 
@@ -65,6 +69,34 @@ StateFile::IsModified() const
 								 partition.pc);
 }
 
+bool
+StateFile::IsQueueModified() const
+{
+	return prev_queue_version != partition.playlist.queue.version;
+}
+
+bool
+StateFile::HasWriteFailed() const
+{
+	return prev_write_failures != background_writer_get_failures();
+}
+
+void
+StateFile::CheckWriteFailures()
+{
+	const unsigned failures = background_writer_get_failures();
+	if (failures == prev_write_failures)
+		return;
+
+	prev_write_failures = failures;
+
+	/* the state file refers to a position in the queue, so
+	   rewrite both */
+	prev_queue_version = ~partition.playlist.queue.version;
+	prev_playlist_version = ~playlist_state_get_hash(partition.playlist,
+							 partition.pc);
+}
+
 inline void
 StateFile::Write(BufferedOutputStream &os)
 {
@@ -81,20 +113,95 @@ StateFile::Write(OutputStream &os, Error &error)
 	return bos.Flush(error);
 }
 
+void
+StateFile::WriteQueue()
+{
+	FormatDebug(state_file_domain,
+		    "Saving queue file %s", queue_path_utf8.c_str());
+
+	StringOutputStream sos;
+	BufferedOutputStream bos(sos);
+	playlist_state_save_queue(bos, partition.playlist);
+
+	Error error;
+	if (!bos.Flush(error)) {
+		LogError(error);
+		return;
+	}
+
+	background_writer_submit(AllocatedPath(queue_path),
+				 std::move(sos.value));
+	prev_queue_version = partition.playlist.queue.version;
+}
+
 void
 StateFile::Write()
 {
+	CheckWriteFailures();
+
+	const bool queue_modified = IsQueueModified();
+
+	/* the queue goes first: the state file refers to a position
+	   in it */
+	if (queue_modified)
+		WriteQueue();
+
+	if (!IsModified()) {
+		if (queue_modified)
+			/* check the result of the background write
+			   later */
+			ScheduleSeconds(interval);
+		return;
+	}
+
 	FormatDebug(state_file_domain,
 		    "Saving state file %s", path_utf8.c_str());
 
+	StringOutputStream sos;
 	Error error;
-	FileOutputStream fos(path, error);
-	if (!fos.IsDefined() || !Write(fos, error) || !fos.Commit(error)) {
+	if (!Write(sos, error)) {
 		LogError(error);
 		return;
 	}
 
+	/* the file is written (and synced) by a separate thread, so
+	   the main thread does not block on the storage device */
+	background_writer_submit(AllocatedPath(path), std::move(sos.value));
 	RememberVersions();
+
+	/* check the result of the background write later; if it has
+	   failed, the next Write() call submits both files again */
+	ScheduleSeconds(interval);
+}
+
+void
+StateFile::ReadQueue()
+{
+	if (!FileExists(queue_path))
+		/* no queue file: either the queue was empty, or the
+		   state file was written by an older MPD version,
+		   which embedded the queue */
+		return;
+
+	FormatDebug(state_file_domain, "Loading queue file %s",
+		    queue_path_utf8.c_str());
+
+	Error error;
+	TextFile file(queue_path, error);
+	if (file.HasFailed()) {
+		LogError(error);
+		return;
+	}
+
+#ifdef ENABLE_DATABASE
+	const SongLoader song_loader(partition.instance.database,
+				     partition.instance.storage);
+#else
+	const SongLoader song_loader(nullptr, nullptr);
+#endif
+
+	playlist_state_load_queue(file, song_loader, partition.playlist);
+	prev_queue_version = partition.playlist.queue.version;
 }
 
 void
@@ -102,6 +209,8 @@ StateFile::Read()
 {
 	bool success;
 
+	ReadQueue();
+
 	FormatDebug(state_file_domain, "Loading state file %s", path_utf8.c_str());
 
 	Error error;
@@ -132,12 +241,21 @@ StateFile::Read()
 	}
 
 	RememberVersions();
+
+	if (!FileExists(queue_path)) {
+		/* the queue was embedded in the state file (older
+		   MPD versions): move it to the queue file, and
+		   rewrite the state file without it */
+		prev_queue_version = 0;
+		prev_playlist_version = ~prev_playlist_version;
+	}
 }
 
 void
 StateFile::CheckModified()
 {
-	if (!IsActive() && IsModified())
+	if (!IsActive() &&
+	    (IsModified() || IsQueueModified() || HasWriteFailed()))
 		ScheduleSeconds(interval);
 }
 
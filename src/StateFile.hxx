@@ -34,6 +34,14 @@ class StateFile final : private TimeoutMonitor {
 	const AllocatedPath path;
 	const std::string path_utf8;
 
+	/**
+	 * The queue is saved in this file (the state file path plus
+	 * ".queue"), so it does not need to be rewritten each time
+	 * the playback position changes.
+	 */
+	const AllocatedPath queue_path;
+	const std::string queue_path_utf8;
+
 	const unsigned interval;
 
 	Partition &partition;
@@ -45,6 +53,20 @@ class StateFile final : private TimeoutMonitor {
 	unsigned prev_volume_version, prev_output_version,
 		prev_playlist_version;
 
+	/**
+	 * The Queue::version which was saved in the queue file.
+	 */
+	unsigned prev_queue_version;
+
+	/**
+	 * The background_writer_get_failures() value when the files
+	 * were last submitted.  The versions above are remembered
+	 * when the files are submitted, and if this number has
+	 * changed since, they are discarded and both files are
+	 * written again.
+	 */
+	unsigned prev_write_failures;
+
 public:
 	static constexpr unsigned DEFAULT_INTERVAL = 2 * 60;
 
@@ -63,11 +85,26 @@ private:
 	bool Write(OutputStream &os, Error &error);
 	void Write(BufferedOutputStream &os);
 
+	void WriteQueue();
+	void ReadQueue();
+
 	/**
 	 * Save the current state versions for use with IsModified().
 	 */
 	void RememberVersions();
 
+	/**
+	 * Has a background write failed since the files were last
+	 * submitted?
+	 */
+	bool HasWriteFailed() const;
+
+	/**
+	 * If a background write has failed, discard the saved
+	 * versions, so both files are written again.
+	 */
+	void CheckWriteFailures();
+
 	/**
 	 * Check if MPD's state was modified since the last
 	 * RememberVersions() call.
@@ -75,6 +112,12 @@ private:
 	gcc_pure
 	bool IsModified() const;
 
+	/**
+	 * Was the queue modified since it was last saved?
+	 */
+	gcc_pure
+	bool IsQueueModified() const;
+
 	/* virtual methods from TimeoutMonitor */
 	virtual void OnTimeout() override;
 };
@@ -28,6 +28,7 @@
 #include "db/Stats.hxx"
 #include "util/Error.hxx"
 #include "system/Clock.hxx"
+#include "util/MemoryStats.hxx"
 #include "Log.hxx"
 
 #ifndef WIN32
@@ -123,16 +124,18 @@ stats_print(Client &client)
 {
 	client_printf(client,
 		      "uptime: %u\n"
-		      "playtime: %lu\n",
+		      "playtime: %lu\n"
+		      "memory: %llu\n",
 #ifdef WIN32
 		      GetProcessUptimeS(),
 #else
 		      MonotonicClockS() - start_time,
 #endif
-		      (unsigned long)(client.player_control.GetTotalPlayTime() + 0.5));
+		      (unsigned long)(client.GetPlayerControl().GetTotalPlayTime() + 0.5),
+		      (unsigned long long)MemoryStatsGetTotal());
 
 #ifdef ENABLE_DATABASE
-	const Database *db = client.partition.instance.database;
+	const Database *db = client.GetInstance().database;
 	if (db != nullptr)
 		db_stats_print(client, *db);
 #endif
@@ -26,12 +26,12 @@
 #include "decoder/DecoderPlugin.hxx"
 #include "input/InputStream.hxx"
 #include "thread/Cond.hxx"
+#include "system/Clock.hxx"
 
 #include <assert.h>
 
 class TagFileScan {
 	const Path path_fs;
-	const char *const suffix;
 
 	const tag_handler &handler;
 	void *handler_ctx;
@@ -41,9 +41,9 @@ class TagFileScan {
 	InputStream *is;
 
 public:
-	TagFileScan(Path _path_fs, const char *_suffix,
+	TagFileScan(Path _path_fs,
 		    const tag_handler &_handler, void *_handler_ctx)
-		:path_fs(_path_fs), suffix(_suffix),
+		:path_fs(_path_fs),
 		 handler(_handler), handler_ctx(_handler_ctx) ,
 		 is(nullptr) {}
 
@@ -74,8 +74,11 @@ public:
 	}
 
 	bool Scan(const DecoderPlugin &plugin) {
-		return plugin.SupportsSuffix(suffix) &&
-			(ScanFile(plugin) || ScanStream(plugin));
+		const uint64_t start = MonotonicClockUS();
+		const bool success = ScanFile(plugin) || ScanStream(plugin);
+		decoder_plugin_count_scan(plugin, success,
+					  MonotonicClockUS() - start);
+		return success;
 	}
 };
 
@@ -90,8 +93,9 @@ tag_file_scan(Path path_fs, const tag_handler &handler, void *handler_ctx)
 	if (suffix == nullptr)
 		return false;
 
-	TagFileScan tfs(path_fs, suffix, handler, handler_ctx);
-	return decoder_plugins_try([&](const DecoderPlugin &plugin){
-			return tfs.Scan(plugin);
-		});
+	TagFileScan tfs(path_fs, handler, handler_ctx);
+	return decoder_plugins_try_candidates(path_fs.c_str(), suffix, nullptr,
+					      [&](const DecoderPlugin &plugin){
+						      return tfs.Scan(plugin);
+					      });
 }
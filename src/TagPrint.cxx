@@ -23,8 +23,53 @@
 #include "tag/TagSettings.h"
 #include "client/Client.hxx"
 
+#include <assert.h>
+#include <string.h>
+
 #define SONG_TIME "Time: "
 
+namespace {
+
+/**
+ * The "NAME: " prefixes of all tag types, rendered once, so tag
+ * lines can be sent without a printf() call.
+ */
+class TagPrefixTable {
+	struct Prefix {
+		char value[40];
+		size_t length;
+	};
+
+	Prefix items[TAG_NUM_OF_ITEM_TYPES];
+
+public:
+	TagPrefixTable() {
+		for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i) {
+			const char *name = tag_item_names[i];
+			const size_t length = strlen(name);
+			assert(length + 2 < sizeof(items[i].value));
+
+			memcpy(items[i].value, name, length);
+			memcpy(items[i].value + length, ": ", 3);
+			items[i].length = length + 2;
+		}
+	}
+
+	void Print(Client &client, TagType type, const char *value) const {
+		const Prefix &p = items[type];
+		client_write_pair(client, p.value, p.length, value);
+	}
+};
+
+}
+
+static const TagPrefixTable &
+GetTagPrefixTable()
+{
+	static const TagPrefixTable table;
+	return table;
+}
+
 void tag_print_types(Client &client)
 {
 	int i;
@@ -39,21 +84,21 @@ void tag_print_types(Client &client)
 void
 tag_print(Client &client, TagType type, const char *value)
 {
-	client_printf(client, "%s: %s\n", tag_item_names[type], value);
+	GetTagPrefixTable().Print(client, type, value);
 }
 
 void
 tag_print_values(Client &client, const Tag &tag)
 {
+	const TagPrefixTable &table = GetTagPrefixTable();
 	for (const auto &i : tag)
-		client_printf(client, "%s: %s\n",
-			      tag_item_names[i.type], i.value);
+		table.Print(client, i.type, i.value);
 }
 
 void tag_print(Client &client, const Tag &tag)
 {
 	if (tag.time >= 0)
-		client_printf(client, SONG_TIME "%i\n", tag.time);
+		client_write_pair(client, SONG_TIME, unsigned(tag.time));
 
 	tag_print_values(client, tag);
 }
@@ -26,21 +26,10 @@
 #include "input/InputStream.hxx"
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
+#include "system/Clock.hxx"
 
 #include <assert.h>
 
-/**
- * Does the #DecoderPlugin support either the suffix or the MIME type?
- */
-gcc_pure
-static bool
-CheckDecoderPlugin(const DecoderPlugin &plugin,
-		   const char *suffix, const char *mime)
-{
-	return (mime != nullptr && plugin.SupportsMimeType(mime)) ||
-		(suffix != nullptr && plugin.SupportsSuffix(suffix));
-}
-
 bool
 tag_stream_scan(InputStream &is, const tag_handler &handler, void *ctx)
 {
@@ -52,12 +41,16 @@ tag_stream_scan(InputStream &is, const tag_handler &handler, void *ctx)
 	if (suffix == nullptr && mime == nullptr)
 		return false;
 
-	return decoder_plugins_try([suffix, mime, &is,
-				    &handler, ctx](const DecoderPlugin &plugin){
+	return decoder_plugins_try_candidates(is.GetURI(), suffix, mime,
+					      [&is, &handler, ctx](const DecoderPlugin &plugin){
 			is.LockRewind(IgnoreError());
 
-			return CheckDecoderPlugin(plugin, suffix, mime) &&
+			const uint64_t start = MonotonicClockUS();
+			const bool success =
 				plugin.ScanStream(is, handler, ctx);
+			decoder_plugin_count_scan(plugin, success,
+						  MonotonicClockUS() - start);
+			return success;
 		});
 }
 
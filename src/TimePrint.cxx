@@ -20,10 +20,26 @@
 #include "config.h"
 #include "TimePrint.hxx"
 #include "client/Client.hxx"
+#include "util/NumberFormat.hxx"
 
-void
-time_print(Client &client, const char *name, time_t t)
+#include <string.h>
+
+/**
+ * The day of the most recently printed time stamp, and its rendered
+ * "YYYY-MM-DDT" prefix.  Song modification times in a listing are
+ * usually clustered, so gmtime() and strftime() are needed only when
+ * the day changes; the time of day is computed arithmetically.
+ */
+static __thread time_t time_print_day = -1;
+static __thread char time_print_date[16];
+
+static bool
+UpdateDate(time_t t)
 {
+	const time_t day = t / 86400;
+	if (day == time_print_day)
+		return true;
+
 #ifdef WIN32
 	const struct tm *tm2 = gmtime(&t);
 #else
@@ -31,15 +47,42 @@ time_print(Client &client, const char *name, time_t t)
 	const struct tm *tm2 = gmtime_r(&t, &tm);
 #endif
 	if (tm2 == nullptr)
+		return false;
+
+	if (strftime(time_print_date, sizeof(time_print_date),
+		     "%Y-%m-%dT", tm2) == 0)
+		return false;
+
+	time_print_day = day;
+	return true;
+}
+
+void
+time_print(Client &client, const char *name, time_t t)
+{
+	if (t < 0 || !UpdateDate(t))
 		return;
 
+	const unsigned seconds = t % 86400;
+
 	char buffer[32];
-	strftime(buffer, sizeof(buffer),
-#ifdef WIN32
-		 "%Y-%m-%dT%H:%M:%SZ",
-#else
-		 "%FT%TZ",
-#endif
-		 tm2);
-	client_printf(client, "%s: %s\n", name, buffer);
+	char *p = buffer;
+	const size_t date_length = strlen(time_print_date);
+	memcpy(p, time_print_date, date_length);
+	p += date_length;
+	p = FormatTwoDigits(p, seconds / 3600);
+	*p++ = ':';
+	p = FormatTwoDigits(p, seconds / 60 % 60);
+	*p++ = ':';
+	p = FormatTwoDigits(p, seconds % 60);
+	*p++ = 'Z';
+	*p++ = '\n';
+
+	const ConstBuffer<void> parts[] = {
+		{ name, strlen(name) },
+		{ ": ", 2 },
+		{ buffer, size_t(p - buffer) },
+	};
+
+	client_writev(client, parts, 3);
 }
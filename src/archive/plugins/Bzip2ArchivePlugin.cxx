@@ -36,6 +36,8 @@
 
 #include <bzlib.h>
 
+#include <vector>
+
 #include <stddef.h>
 
 #ifdef HAVE_OLDER_BZIP2
@@ -89,12 +91,37 @@ public:
 };
 
 struct Bzip2InputStream final : public InputStream {
+	/**
+	 * A position where decompression can be restarted: the
+	 * beginning of a bzip2 stream.  Files compressed by parallel
+	 * implementations such as pbzip2 and lbzip2 consist of many
+	 * concatenated streams, which makes seeking cheap.
+	 */
+	struct Checkpoint {
+		/**
+		 * The offset in the compressed file.
+		 */
+		offset_type compressed;
+
+		/**
+		 * The offset in the decompressed data.
+		 */
+		offset_type decompressed;
+	};
+
 	Bzip2ArchiveFile *archive;
 
 	bool eof;
 
 	bz_stream bzstream;
 
+	/**
+	 * All stream beginnings which have been seen so far, sorted
+	 * by offset.  The first element always describes the
+	 * beginning of the file.
+	 */
+	std::vector<Checkpoint> checkpoints;
+
 	char buffer[5000];
 
 	Bzip2InputStream(Bzip2ArchiveFile &context, const char *uri,
@@ -106,12 +133,45 @@ struct Bzip2InputStream final : public InputStream {
 	/* virtual methods from InputStream */
 	bool IsEOF() override;
 	size_t Read(void *ptr, size_t size, Error &error) override;
+	bool Seek(offset_type offset, Error &error) override;
+
+private:
+	bool Restart(const Checkpoint &checkpoint, Error &error);
+
+	/**
+	 * The current stream has ended; start decompressing the next
+	 * one, if there is one.
+	 *
+	 * @param decompressed the current offset in the decompressed
+	 * data
+	 * @return false on end of file or on error
+	 */
+	bool NextStream(offset_type decompressed, Error &error);
+
+	/**
+	 * Decompress and discard data until the specified offset is
+	 * reached.
+	 */
+	bool Skip(offset_type new_offset, Error &error);
 };
 
 static constexpr Domain bz2_domain("bz2");
 
 /* single archive handling allocation helpers */
 
+static bool
+bz2_init(bz_stream &bzstream, Error &error)
+{
+	int ret = BZ2_bzDecompressInit(&bzstream, 0, 0);
+	if (ret != BZ_OK) {
+		error.Set(bz2_domain, ret,
+			  "BZ2_bzDecompressInit() has failed");
+		return false;
+	}
+
+	return true;
+}
+
 inline bool
 Bzip2InputStream::Open(Error &error)
 {
@@ -122,17 +182,36 @@ Bzip2InputStream::Open(Error &error)
 	bzstream.next_in = (char *)buffer;
 	bzstream.avail_in = 0;
 
-	int ret = BZ2_bzDecompressInit(&bzstream, 0, 0);
-	if (ret != BZ_OK) {
-		error.Set(bz2_domain, ret,
-			  "BZ2_bzDecompressInit() has failed");
+	if (!bz2_init(bzstream, error))
 		return false;
-	}
+
+	checkpoints.push_back({archive->istream->GetOffset(), 0});
+
+	seekable = archive->istream->IsSeekable();
 
 	SetReady();
 	return true;
 }
 
+bool
+Bzip2InputStream::Restart(const Checkpoint &checkpoint, Error &error)
+{
+	if (!archive->istream->LockSeek(checkpoint.compressed, error))
+		return false;
+
+	BZ2_bzDecompressEnd(&bzstream);
+
+	bzstream.next_in = (char *)buffer;
+	bzstream.avail_in = 0;
+
+	if (!bz2_init(bzstream, error))
+		return false;
+
+	offset = checkpoint.decompressed;
+	eof = false;
+	return true;
+}
+
 /* archive open && listing routine */
 
 static ArchiveFile *
@@ -200,6 +279,24 @@ bz2_fillbuffer(Bzip2InputStream *bis, Error &error)
 	return true;
 }
 
+inline bool
+Bzip2InputStream::NextStream(offset_type decompressed, Error &error)
+{
+	if (!bz2_fillbuffer(this, error))
+		/* no more data */
+		return false;
+
+	const offset_type compressed =
+		archive->istream->GetOffset() - bzstream.avail_in;
+	if (compressed > checkpoints.back().compressed)
+		checkpoints.push_back({compressed, decompressed});
+
+	/* BZ2_bzDecompressInit() leaves the input pointer alone, so
+	   the rest of the buffer is passed to the new stream */
+	BZ2_bzDecompressEnd(&bzstream);
+	return bz2_init(bzstream, error);
+}
+
 size_t
 Bzip2InputStream::Read(void *ptr, size_t length, Error &error)
 {
@@ -219,6 +316,24 @@ Bzip2InputStream::Read(void *ptr, size_t length, Error &error)
 		bz_result = BZ2_bzDecompress(&bzstream);
 
 		if (bz_result == BZ_STREAM_END) {
+			/* another stream may follow */
+			const offset_type decompressed =
+				offset + length - bzstream.avail_out;
+			if (!NextStream(decompressed, error)) {
+				if (error.IsDefined())
+					return 0;
+
+				eof = true;
+				break;
+			}
+
+			continue;
+		}
+
+		if (bz_result == BZ_DATA_ERROR_MAGIC &&
+		    offset + length - bzstream.avail_out > 0) {
+			/* not a bzip2 stream header, but there was a
+			   stream before: ignore trailing garbage */
 			eof = true;
 			break;
 		}
@@ -236,6 +351,46 @@ Bzip2InputStream::Read(void *ptr, size_t length, Error &error)
 	return nbytes;
 }
 
+inline bool
+Bzip2InputStream::Skip(offset_type new_offset, Error &error)
+{
+	char discard[4096];
+
+	while (offset < new_offset) {
+		size_t length = sizeof(discard);
+		if (offset_type(length) > new_offset - offset)
+			length = new_offset - offset;
+
+		if (Read(discard, length, error) == 0) {
+			if (!error.IsDefined())
+				error.Set(bz2_domain,
+					  "Seek beyond end of file");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool
+Bzip2InputStream::Seek(offset_type new_offset, Error &error)
+{
+	/* find the last known stream beginning at or before the new
+	   offset */
+	auto i = checkpoints.end();
+	do {
+		--i;
+	} while (i->decompressed > new_offset);
+
+	/* restart there if the new offset is behind the current
+	   position, or if it saves decompressing a stream */
+	if ((new_offset < offset || i->decompressed > offset) &&
+	    !Restart(*i, error))
+		return false;
+
+	return Skip(new_offset, error);
+}
+
 bool
 Bzip2InputStream::IsEOF()
 {
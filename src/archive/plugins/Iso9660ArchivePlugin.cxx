@@ -35,6 +35,9 @@
 
 #include <cdio/iso9660.h>
 
+#include <algorithm>
+
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -138,18 +141,41 @@ Iso9660ArchiveFile::Visit(ArchiveVisitor &visitor)
 
 /* single archive handling */
 
+/**
+ * The number of blocks read from the ISO file at a time.
+ */
+static constexpr size_t ISO9660_BUFFER_BLOCKS = 32;
+
 class Iso9660InputStream final : public InputStream {
 	Iso9660ArchiveFile &archive;
 
 	iso9660_stat_t *statbuf;
 
+	/**
+	 * The number of the first block in #buffer, relative to the
+	 * beginning of the file.
+	 */
+	lsn_t buffer_block;
+
+	/**
+	 * The number of valid bytes in #buffer.
+	 */
+	size_t buffer_fill;
+
+	/**
+	 * Small and unaligned reads are served from this buffer.
+	 */
+	uint8_t buffer[ISO9660_BUFFER_BLOCKS * ISO_BLOCKSIZE];
+
 public:
 	Iso9660InputStream(Iso9660ArchiveFile &_archive, const char *_uri,
 			   Mutex &_mutex, Cond &_cond,
 			   iso9660_stat_t *_statbuf)
 		:InputStream(_uri, _mutex, _cond),
-		 archive(_archive), statbuf(_statbuf) {
+		 archive(_archive), statbuf(_statbuf),
+		 buffer_block(0), buffer_fill(0) {
 		size = statbuf->size;
+		seekable = true;
 		SetReady();
 
 		archive.Ref();
@@ -163,6 +189,19 @@ public:
 	/* virtual methods from InputStream */
 	bool IsEOF() override;
 	size_t Read(void *ptr, size_t size, Error &error) override;
+	bool Seek(offset_type offset, Error &error) override;
+
+private:
+	/**
+	 * Read whole blocks from the file.
+	 *
+	 * @param block the first block number, relative to the
+	 * beginning of the file
+	 * @return the number of valid bytes (may be less than the
+	 * number of blocks at the end of the file) or 0 on error
+	 */
+	size_t ReadBlocks(void *dest, lsn_t block, size_t n_blocks,
+			  Error &error);
 };
 
 InputStream *
@@ -182,38 +221,71 @@ Iso9660ArchiveFile::OpenStream(const char *pathname,
 }
 
 size_t
-Iso9660InputStream::Read(void *ptr, size_t read_size, Error &error)
+Iso9660InputStream::ReadBlocks(void *dest, lsn_t block, size_t n_blocks,
+			       Error &error)
 {
-	int readed = 0;
-	int no_blocks, cur_block;
-	size_t left_bytes = statbuf->size - offset;
-
-	if (left_bytes < read_size) {
-		no_blocks = CEILING(left_bytes, ISO_BLOCKSIZE);
-	} else {
-		no_blocks = read_size / ISO_BLOCKSIZE;
+	long readed = archive.SeekRead(dest, statbuf->lsn + block,
+				       n_blocks);
+	if (readed != long(n_blocks * ISO_BLOCKSIZE)) {
+		error.Format(iso9660_domain,
+			     "error reading ISO file at lsn %lu",
+			     (unsigned long)block);
+		return 0;
 	}
 
-	if (no_blocks == 0)
+	const offset_type left = size - offset_type(block) * ISO_BLOCKSIZE;
+	return std::min<offset_type>(readed, left);
+}
+
+size_t
+Iso9660InputStream::Read(void *ptr, size_t read_size, Error &error)
+{
+	if (offset >= size)
 		return 0;
 
-	cur_block = offset / ISO_BLOCKSIZE;
+	const lsn_t block = offset / ISO_BLOCKSIZE;
+	const size_t left_blocks = CEILING(size - offset, ISO_BLOCKSIZE);
 
-	readed = archive.SeekRead(ptr, statbuf->lsn + cur_block,
-				  no_blocks);
+	if (offset % ISO_BLOCKSIZE == 0 && read_size >= sizeof(buffer)) {
+		/* large aligned read: bypass the buffer */
+		const size_t n_blocks =
+			std::min(read_size / ISO_BLOCKSIZE, left_blocks);
+		size_t nbytes = ReadBlocks(ptr, block, n_blocks, error);
+		offset += nbytes;
+		return nbytes;
+	}
 
-	if (readed != no_blocks * ISO_BLOCKSIZE) {
-		error.Format(iso9660_domain,
-			     "error reading ISO file at lsn %lu",
-			     (unsigned long)cur_block);
-		return 0;
+	const offset_type buffer_offset =
+		offset_type(buffer_block) * ISO_BLOCKSIZE;
+	if (offset < buffer_offset ||
+	    offset >= buffer_offset + buffer_fill) {
+		const size_t n_blocks =
+			std::min(ISO9660_BUFFER_BLOCKS, left_blocks);
+		buffer_fill = ReadBlocks(buffer, block, n_blocks, error);
+		if (buffer_fill == 0)
+			return 0;
+
+		buffer_block = block;
 	}
-	if (left_bytes < read_size) {
-		readed = left_bytes;
+
+	const size_t position =
+		offset - offset_type(buffer_block) * ISO_BLOCKSIZE;
+	const size_t nbytes = std::min(read_size, buffer_fill - position);
+	memcpy(ptr, buffer + position, nbytes);
+	offset += nbytes;
+	return nbytes;
+}
+
+bool
+Iso9660InputStream::Seek(offset_type new_offset, Error &error)
+{
+	if (new_offset > size) {
+		error.Set(iso9660_domain, "Seek beyond end of file");
+		return false;
 	}
 
-	offset += readed;
-	return readed;
+	offset = new_offset;
+	return true;
 }
 
 bool
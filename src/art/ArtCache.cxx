@@ -0,0 +1,337 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "ArtCache.hxx"
+#include "ArtExtract.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/DirectoryReader.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <utime.h>
+
+static constexpr Domain art_cache_domain("art_cache");
+
+static constexpr unsigned DEFAULT_CACHE_SIZE = 64 * 1024;
+
+static AllocatedPath cache_path = AllocatedPath::Null();
+static uint64_t cache_size;
+
+/**
+ * The estimated total size of all files in the cache; when it
+ * exceeds #cache_size, art_cache_evict() rescans the directory.
+ */
+static uint64_t cache_used;
+
+/**
+ * Makes the names of temporary files unique.
+ */
+static unsigned cache_serial;
+
+class Fnv1a64 {
+	uint64_t hash;
+
+public:
+	Fnv1a64():hash(14695981039346656037ull) {}
+
+	void Feed(const void *_p, size_t size) {
+		const uint8_t *p = (const uint8_t *)_p;
+		for (size_t i = 0; i < size; ++i) {
+			hash ^= p[i];
+			hash *= 1099511628211ull;
+		}
+	}
+
+	void Feed(const char *s) {
+		Feed(s, strlen(s) + 1);
+	}
+
+	std::string ToString(const char *suffix="") const {
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%016llx%s",
+			 (unsigned long long)hash, suffix);
+		return buffer;
+	}
+};
+
+/**
+ * The name of the reference file of a specific version of a song.
+ */
+static std::string
+RefName(const char *uri, time_t mtime)
+{
+	Fnv1a64 hash;
+	hash.Feed(uri);
+	const uint64_t t = mtime;
+	hash.Feed(&t, sizeof(t));
+	return hash.ToString(".ref");
+}
+
+/**
+ * The name of a picture file, derived from its contents.
+ */
+static std::string
+ContentName(const std::string &data)
+{
+	Fnv1a64 hash;
+	hash.Feed(data.data(), data.size());
+	const uint64_t size = data.size();
+	hash.Feed(&size, sizeof(size));
+	return hash.ToString(".img");
+}
+
+static bool
+IsTemporaryName(const char *name)
+{
+	const size_t length = strlen(name);
+	return length > 4 && strcmp(name + length - 4, ".tmp") == 0;
+}
+
+/**
+ * Delete the least recently used files until the cache fits into
+ * #cache_size again.  Reference files whose picture was deleted
+ * are harmless: art_cache_lookup() treats them as a miss.
+ *
+ * @param remove_temporary delete temporary files left over from a
+ * previous MPD process?
+ */
+static void
+art_cache_evict(bool remove_temporary)
+{
+	struct Entry {
+		AllocatedPath path;
+		uint64_t size;
+		time_t mtime;
+	};
+
+	std::vector<Entry> entries;
+	uint64_t total = 0;
+
+	DirectoryReader reader(cache_path);
+	if (reader.HasFailed())
+		return;
+
+	while (reader.ReadEntry()) {
+		const Path name = reader.GetEntry();
+		if (name.c_str()[0] == '.')
+			continue;
+
+		auto path = AllocatedPath::Build(cache_path, name);
+		if (IsTemporaryName(name.c_str())) {
+			if (remove_temporary)
+				RemoveFile(path);
+			continue;
+		}
+
+		struct stat st;
+		if (!StatFile(path, st, false) || !S_ISREG(st.st_mode))
+			continue;
+
+		total += st.st_size;
+		entries.push_back({std::move(path), uint64_t(st.st_size),
+				   st.st_mtime});
+	}
+
+	if (total > cache_size) {
+		std::sort(entries.begin(), entries.end(),
+			  [](const Entry &a, const Entry &b){
+				  return a.mtime < b.mtime;
+			  });
+
+		/* shrink to 3/4 so the next eviction doesn't follow
+		   immediately */
+		const uint64_t goal = cache_size / 4 * 3;
+		for (const auto &i : entries) {
+			if (total <= goal)
+				break;
+
+			if (RemoveFile(i.path))
+				total -= i.size;
+		}
+	}
+
+	cache_used = total;
+}
+
+bool
+art_cache_init(Error &error)
+{
+	cache_path = config_get_path(CONF_ART_CACHE_DIR, error);
+	if (cache_path.IsNull())
+		return !error.IsDefined();
+
+	if (!DirectoryExists(cache_path)) {
+		error.Format(art_cache_domain, "Not a directory: %s",
+			     cache_path.c_str());
+		cache_path = AllocatedPath::Null();
+		return false;
+	}
+
+	cache_size = uint64_t(config_get_positive(CONF_ART_CACHE_SIZE,
+						  DEFAULT_CACHE_SIZE)) * 1024;
+
+	art_cache_evict(true);
+	return true;
+}
+
+void
+art_cache_finish()
+{
+	cache_path = AllocatedPath::Null();
+}
+
+static bool
+LoadFile(Path path, std::string &data)
+{
+	FILE *file = FOpen(path, FOpenMode::ReadBinary);
+	if (file == nullptr)
+		return false;
+
+	struct stat st;
+	if (fstat(fileno(file), &st) < 0 || !S_ISREG(st.st_mode)) {
+		fclose(file);
+		return false;
+	}
+
+	data.resize(st.st_size);
+	const bool success = data.empty() ||
+		fread(&data.front(), 1, data.size(), file) == data.size();
+	fclose(file);
+	return success;
+}
+
+/**
+ * Write a file atomically (via a temporary file).
+ */
+static bool
+StoreFile(const std::string &name, const void *data, size_t size)
+{
+	char suffix[32];
+	snprintf(suffix, sizeof(suffix), ".%u.tmp", ++cache_serial);
+
+	const auto path = AllocatedPath::Build(cache_path, name.c_str());
+	const auto tmp_path = AllocatedPath::Build(cache_path,
+						   (name + suffix).c_str());
+
+	Error error;
+	FileOutputStream output(tmp_path, error,
+			       FileOutputStream::Mode::CREATE_VISIBLE);
+	if (!output.IsDefined() ||
+	    !output.Write(data, size, error) ||
+	    !output.Commit(error)) {
+		LogError(error);
+		return false;
+	}
+
+	if (!RenameFile(tmp_path, path)) {
+		FormatErrno(art_cache_domain, "Failed to rename %s",
+			    tmp_path.c_str());
+		RemoveFile(tmp_path);
+		return false;
+	}
+
+	cache_used += size;
+	return true;
+}
+
+ArtCacheResult
+art_cache_lookup(const char *uri, time_t mtime, AlbumArt &art)
+{
+	if (cache_path.IsNull())
+		return ArtCacheResult::MISS;
+
+	const auto ref_path =
+		AllocatedPath::Build(cache_path, RefName(uri, mtime).c_str());
+
+	/* the reference file contains the name of the picture file
+	   and the MIME type, separated by a newline; an empty file
+	   means there is no picture */
+	std::string ref;
+	if (!LoadFile(ref_path, ref))
+		return ArtCacheResult::MISS;
+
+	utime(ref_path.c_str(), nullptr);
+
+	if (ref.empty())
+		return ArtCacheResult::NONE;
+
+	const auto newline = ref.find('\n');
+	if (newline == ref.npos)
+		return ArtCacheResult::MISS;
+
+	const auto content_path =
+		AllocatedPath::Build(cache_path,
+				     ref.substr(0, newline).c_str());
+	if (!LoadFile(content_path, art.data)) {
+		/* the picture has been evicted */
+		RemoveFile(ref_path);
+		return ArtCacheResult::MISS;
+	}
+
+	/* mark the picture as recently used */
+	utime(content_path.c_str(), nullptr);
+
+	art.mime_type = ref.substr(newline + 1);
+	return ArtCacheResult::FOUND;
+}
+
+void
+art_cache_store(const char *uri, time_t mtime, const AlbumArt &art)
+{
+	if (cache_path.IsNull())
+		return;
+
+	std::string ref;
+	if (!art.IsEmpty()) {
+		const std::string content_name = ContentName(art.data);
+		const auto content_path =
+			AllocatedPath::Build(cache_path,
+					     content_name.c_str());
+
+		/* identical pictures (e.g. of all songs of an
+		   album) are stored only once */
+		if (!FileExists(content_path, false) &&
+		    !StoreFile(content_name, art.data.data(),
+			       art.data.size()))
+			return;
+
+		ref = content_name;
+		ref.push_back('\n');
+		ref.append(art.mime_type);
+	}
+
+	StoreFile(RefName(uri, mtime), ref.data(), ref.size());
+
+	if (cache_used > cache_size)
+		art_cache_evict(false);
+}
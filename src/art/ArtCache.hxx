@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/** \file
+ *
+ * An on-disk cache of pictures extracted by art_extract().  The
+ * pictures are stored under the hash of their contents, so songs of
+ * the same album share one copy; a small reference file per song
+ * (keyed by URI and modification time) points to it.  Songs without
+ * a picture are remembered, too.
+ */
+
+#ifndef MPD_ART_CACHE_HXX
+#define MPD_ART_CACHE_HXX
+
+#include "check.h"
+
+#include <time.h>
+
+class Error;
+struct AlbumArt;
+
+/**
+ * Load the "art_cache_directory" and "art_cache_size" settings.
+ * Without "art_cache_directory", the cache is disabled.
+ */
+bool
+art_cache_init(Error &error);
+
+void
+art_cache_finish();
+
+enum class ArtCacheResult {
+	/**
+	 * The song is not in the cache.
+	 */
+	MISS,
+
+	/**
+	 * The picture was loaded from the cache.
+	 */
+	FOUND,
+
+	/**
+	 * The song is known to have no picture.
+	 */
+	NONE,
+};
+
+/**
+ * Look up the picture of a song.
+ *
+ * @param mtime the modification time of the song file; a
+ * different value is a cache miss
+ */
+ArtCacheResult
+art_cache_lookup(const char *uri, time_t mtime, AlbumArt &art);
+
+/**
+ * Add the picture of a song to the cache.  An empty #AlbumArt
+ * records that the song has no picture.
+ */
+void
+art_cache_store(const char *uri, time_t mtime, const AlbumArt &art);
+
+#endif
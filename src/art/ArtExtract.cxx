@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "ArtExtract.hxx"
+#include "tag/TagFileReader.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileSystem.hxx"
+#include "util/Error.hxx"
+
+#ifdef HAVE_ID3TAG
+#include "tag/Id3Scan.hxx"
+#include "tag/Riff.hxx"
+#include "tag/Aiff.hxx"
+#endif
+
+#include <memory>
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/**
+ * Larger pictures are ignored.
+ */
+static constexpr size_t MAX_ART_SIZE = 16 * 1024 * 1024;
+
+/**
+ * Names of image files in the song's directory which are used if
+ * there is no embedded picture, in the order of preference.
+ */
+static const char *const folder_art_names[] = {
+	"cover.jpg", "cover.png",
+	"folder.jpg", "folder.png",
+	"front.jpg", "front.png",
+	"AlbumArt.jpg",
+};
+
+static constexpr uint32_t
+ReadBE32(const uint8_t *p)
+{
+	return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
+		(uint32_t(p[2]) << 8) | p[3];
+}
+
+/**
+ * Determine where a FLAC stream begins, skipping an ID3v2 tag some
+ * taggers put in front of it.
+ *
+ * @return false if this is not a FLAC file
+ */
+static bool
+flac_find_stream(TagFileReader &reader, uint64_t &offset_r)
+{
+	uint8_t header[10];
+	if (!reader.ReadFullAt(header, sizeof(header), 0))
+		return false;
+
+	uint64_t offset = 0;
+	if (memcmp(header, "ID3", 3) == 0) {
+		offset = 10 + ((uint32_t(header[6] & 0x7f) << 21) |
+			       (uint32_t(header[7] & 0x7f) << 14) |
+			       (uint32_t(header[8] & 0x7f) << 7) |
+			       (header[9] & 0x7f));
+		if (header[5] & 0x10)
+			/* footer present */
+			offset += 10;
+	}
+
+	char magic[4];
+	if (!reader.ReadFullAt(magic, sizeof(magic), offset) ||
+	    memcmp(magic, "fLaC", 4) != 0)
+		return false;
+
+	offset_r = offset + sizeof(magic);
+	return true;
+}
+
+/**
+ * Parse a FLAC METADATA_BLOCK_PICTURE.
+ */
+static bool
+flac_parse_picture(const uint8_t *p, const uint8_t *end,
+		   uint32_t &type_r, AlbumArt &art)
+{
+	if (end - p < 8)
+		return false;
+
+	type_r = ReadBE32(p);
+	const uint32_t mime_length = ReadBE32(p + 4);
+	p += 8;
+	if (uint32_t(end - p) < mime_length + 4)
+		return false;
+
+	art.mime_type.assign((const char *)p, mime_length);
+	p += mime_length;
+
+	const uint32_t description_length = ReadBE32(p);
+	p += 4;
+
+	/* skip the description, width, height, depth and number of
+	   colors */
+	if (uint32_t(end - p) < description_length + 20)
+		return false;
+
+	p += description_length + 16;
+
+	const uint32_t data_length = ReadBE32(p);
+	p += 4;
+	if (uint32_t(end - p) < data_length)
+		return false;
+
+	art.data.assign((const char *)p, data_length);
+	return true;
+}
+
+/**
+ * Find a PICTURE block in the FLAC metadata.  Only the headers of
+ * the other blocks are read.
+ */
+static bool
+flac_find_picture(TagFileReader &reader, AlbumArt &art)
+{
+	uint64_t offset;
+	if (!flac_find_stream(reader, offset))
+		return false;
+
+	bool found = false;
+
+	while (true) {
+		uint8_t header[4];
+		if (!reader.ReadFullAt(header, sizeof(header), offset))
+			break;
+
+		offset += sizeof(header);
+
+		const bool last = (header[0] & 0x80) != 0;
+		const unsigned type = header[0] & 0x7f;
+		const uint32_t length = ReadBE32(header) & 0xffffff;
+
+		static constexpr unsigned PICTURE = 6;
+		if (type == PICTURE && length <= MAX_ART_SIZE) {
+			std::unique_ptr<uint8_t[]> block(new uint8_t[length]);
+			AlbumArt tmp;
+			uint32_t picture_type;
+			if (reader.ReadFullAt(block.get(), length, offset) &&
+			    flac_parse_picture(block.get(),
+					       block.get() + length,
+					       picture_type, tmp) &&
+			    (!found || picture_type == 3)) {
+				art = std::move(tmp);
+				found = true;
+
+				if (picture_type == 3)
+					/* front cover */
+					break;
+			}
+		}
+
+		if (last)
+			break;
+
+		offset += length;
+	}
+
+	return found;
+}
+
+#ifdef HAVE_ID3TAG
+
+static bool
+id3_find_picture(TagFileReader &reader, AlbumArt &art)
+{
+	if (id3v2_find_picture(reader, 0, art.mime_type, art.data))
+		return true;
+
+	uint64_t offset;
+	return (riff_find_id3(reader, offset) > 0 ||
+		aiff_find_id3(reader, offset) > 0) &&
+		id3v2_find_picture(reader, offset, art.mime_type, art.data);
+}
+
+#endif
+
+static bool
+art_extract_embedded(Path path_fs, AlbumArt &art)
+{
+	TagFileReader reader;
+	if (!reader.Open(path_fs, IgnoreError()))
+		return false;
+
+	if (flac_find_picture(reader, art))
+		return true;
+
+#ifdef HAVE_ID3TAG
+	if (id3_find_picture(reader, art))
+		return true;
+#endif
+
+	return false;
+}
+
+gcc_pure
+static const char *
+GuessMimeType(const char *name)
+{
+	const char *dot = strrchr(name, '.');
+	if (dot == nullptr)
+		return "";
+
+	return strcmp(dot, ".png") == 0
+		? "image/png"
+		: "image/jpeg";
+}
+
+static bool
+art_load_file(Path path_fs, std::string &data)
+{
+	FILE *file = FOpen(path_fs, FOpenMode::ReadBinary);
+	if (file == nullptr)
+		return false;
+
+	struct stat st;
+	if (fstat(fileno(file), &st) < 0 || !S_ISREG(st.st_mode) ||
+	    st.st_size == 0 || uint64_t(st.st_size) > MAX_ART_SIZE) {
+		fclose(file);
+		return false;
+	}
+
+	data.resize(st.st_size);
+	const bool success = fread(&data.front(), 1, data.size(), file) ==
+		data.size();
+	fclose(file);
+	return success;
+}
+
+static bool
+art_extract_folder(Path path_fs, AlbumArt &art)
+{
+	const AllocatedPath directory_fs =
+		AllocatedPath::FromFS(path_fs.c_str()).GetDirectoryName();
+	if (directory_fs.IsNull())
+		return false;
+
+	for (const char *name : folder_art_names) {
+		const auto art_fs = AllocatedPath::Build(directory_fs, name);
+		if (art_load_file(art_fs, art.data)) {
+			art.mime_type = GuessMimeType(name);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool
+art_extract(Path path_fs, AlbumArt &art)
+{
+	return art_extract_embedded(path_fs, art) ||
+		art_extract_folder(path_fs, art);
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_ART_EXTRACT_HXX
+#define MPD_ART_EXTRACT_HXX
+
+#include "check.h"
+
+#include <string>
+
+class Path;
+
+/**
+ * An image file (e.g. a cover) in its original encoding.
+ */
+struct AlbumArt {
+	/**
+	 * The MIME type, or an empty string if unknown.
+	 */
+	std::string mime_type;
+
+	std::string data;
+
+	bool IsEmpty() const {
+		return data.empty();
+	}
+};
+
+/**
+ * Find the picture which belongs to the given song file: a picture
+ * embedded in the file (ID3v2 APIC or FLAC PICTURE; the front cover
+ * is preferred) or an image file in the same directory (e.g.
+ * "cover.jpg").
+ *
+ * @param path_fs the song file
+ * @return false if no picture was found
+ */
+bool
+art_extract(Path path_fs, AlbumArt &art);
+
+#endif
@@ -25,18 +25,36 @@
 
 const Domain client_domain("client");
 
+Instance &
+Client::GetInstance() const
+{
+	return partition->instance;
+}
+
+playlist &
+Client::GetPlaylist()
+{
+	return partition->playlist;
+}
+
+PlayerControl &
+Client::GetPlayerControl()
+{
+	return partition->pc;
+}
+
 #ifdef ENABLE_DATABASE
 
 const Database *
 Client::GetDatabase(Error &error) const
 {
-	return partition.instance.GetDatabase(error);
+	return GetInstance().GetDatabase(error);
 }
 
 const Storage *
 Client::GetStorage() const
 {
-	return partition.instance.storage;
+	return GetInstance().storage;
 }
 
 #endif
@@ -23,6 +23,7 @@
 #include "check.h"
 #include "ClientMessage.hxx"
 #include "command/CommandListBuilder.hxx"
+#include "command/CommandResult.hxx"
 #include "event/FullyBufferedSocket.hxx"
 #include "event/TimeoutMonitor.hxx"
 #include "Compiler.h"
@@ -34,23 +35,29 @@
 #include <list>
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdarg.h>
 
 struct sockaddr;
 class EventLoop;
 class Path;
 struct Partition;
+struct Instance;
+struct playlist;
+struct PlayerControl;
 class Database;
 class Storage;
 
 class Client final
 	: FullyBufferedSocket, TimeoutMonitor,
 	  public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> {
-public:
-	Partition &partition;
-	struct playlist &playlist;
-	struct PlayerControl &player_control;
+	/**
+	 * The partition this client is attached to.  It can be
+	 * switched with the "partition" command.
+	 */
+	Partition *partition;
 
+public:
 	struct Disposer {
 		void operator()(Client *client) const {
 			delete client;
@@ -70,12 +77,28 @@ public:
 	bool idle_waiting;
 
 	/** idle flags pending on this client, to be sent as soon as
-	    the client enters "idle" */
+	    the client enters "idle"; this contains only events sent
+	    to this client alone (see IdleAdd()), global events are
+	    tracked by #idle_serial */
 	unsigned idle_flags;
 
+	/**
+	 * The ClientList::GetIdleSerial() value when this client
+	 * last received its idle events.
+	 */
+	uint64_t idle_serial;
+
 	/** idle flags that the client wants to receive */
 	unsigned idle_subscriptions;
 
+	typedef boost::intrusive::list_member_hook<boost::intrusive::link_mode<boost::intrusive::auto_unlink>> IdleHook;
+
+	/**
+	 * Links this client into ClientList::idle_waiters while
+	 * #idle_waiting is set.
+	 */
+	IdleHook idle_hook;
+
 	/**
 	 * A list of channel names this client is subscribed to.
 	 */
@@ -92,6 +115,23 @@ public:
 	 */
 	std::list<ClientMessage> messages;
 
+	/**
+	 * If not nullptr, client_write() appends a copy of all
+	 * output to this string, to be stored in the #QueryCache.
+	 * It is reset to nullptr when the output grows beyond
+	 * #capture_limit.
+	 */
+	std::string *capture;
+
+	size_t capture_limit;
+
+	/**
+	 * Is a worker thread executing a command for this client
+	 * right now (see ClientWorker.hxx)?  Meanwhile, no more input
+	 * is processed, and the object must not be deleted.
+	 */
+	bool worker_busy;
+
 	Client(EventLoop &loop, Partition &partition,
 	       int fd, int uid, int num);
 
@@ -113,6 +153,9 @@ public:
 	void SetExpired();
 
 	using FullyBufferedSocket::Write;
+	using FullyBufferedSocket::WriteV;
+	using FullyBufferedSocket::PrepareWrite;
+	using FullyBufferedSocket::CommitWrite;
 
 	/**
 	 * returns the uid of the client process, or a negative value
@@ -138,6 +181,23 @@ public:
 		permission = _permission;
 	}
 
+	Partition &GetPartition() {
+		return *partition;
+	}
+
+	void SetPartition(Partition &_partition) {
+		partition = &_partition;
+	}
+
+	gcc_pure
+	Instance &GetInstance() const;
+
+	gcc_pure
+	struct playlist &GetPlaylist();
+
+	gcc_pure
+	PlayerControl &GetPlayerControl();
+
 	/**
 	 * Send "idle" response to this client.
 	 */
@@ -145,6 +205,12 @@ public:
 	void IdleAdd(unsigned flags);
 	bool IdleWait(unsigned flags);
 
+	/**
+	 * Leave "idle" mode without a notification ("noidle").
+	 * Pending events are kept for the next "idle" command.
+	 */
+	void IdleCancel();
+
 	enum class SubscribeResult {
 		/** success */
 		OK,
@@ -190,7 +256,21 @@ public:
 	gcc_pure
 	const Storage *GetStorage() const;
 
+	/**
+	 * A worker thread has finished executing a command: send its
+	 * response and resume processing input.  This may delete
+	 * the object.
+	 */
+	void OnWorkerFinished(std::string &&response, CommandResult result);
+
 private:
+	/**
+	 * Handle the result of a command.
+	 *
+	 * @return false if the client has been closed
+	 */
+	bool ApplyCommandResult(CommandResult result);
+
 	/* virtual methods from class BufferedSocket */
 	virtual InputResult OnSocketInput(void *data, size_t length) override;
 	virtual void OnSocketError(Error &&error) override;
@@ -206,6 +286,56 @@ void
 client_new(EventLoop &loop, Partition &partition,
 	   int fd, const sockaddr *sa, size_t sa_length, int uid);
 
+/**
+ * Write a block of data to the client.
+ */
+void
+client_write(Client &client, const char *data, size_t length);
+
+/**
+ * Write a binary blob to the client: a "binary: LENGTH" line, the
+ * raw data and a terminating newline.  The payload is passed to the
+ * socket without being copied to the output buffer first, unless
+ * the socket is congested.
+ */
+void
+client_write_binary(Client &client, const void *data, size_t length);
+
+/**
+ * Write the concatenation of several buffers to the client.  If
+ * there is enough room, they are copied directly into the output
+ * buffer, without any intermediate formatting step.
+ */
+void
+client_writev(Client &client, const ConstBuffer<void> *parts, unsigned n);
+
+/**
+ * Write a "NAME: VALUE" line to the client.
+ *
+ * @param prefix the name including the colon and the space
+ */
+void
+client_write_pair(Client &client, const char *prefix, size_t prefix_length,
+		  const char *value);
+
+void
+client_write_pair(Client &client, const char *prefix, size_t prefix_length,
+		  uint64_t value);
+
+template<size_t n>
+static inline void
+client_write_pair(Client &client, const char (&prefix)[n], const char *value)
+{
+	client_write_pair(client, prefix, n - 1, value);
+}
+
+template<size_t n>
+static inline void
+client_write_pair(Client &client, const char (&prefix)[n], uint64_t value)
+{
+	client_write_pair(client, prefix, n - 1, value);
+}
+
 /**
  * Write a C string to the client.
  */
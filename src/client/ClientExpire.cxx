@@ -27,6 +27,7 @@ Client::SetExpired()
 	if (IsExpired())
 		return;
 
+	idle_hook.unlink();
 	FullyBufferedSocket::Close();
 	TimeoutMonitor::Schedule(0);
 }
@@ -19,19 +19,37 @@
 
 #include "config.h"
 #include "ClientInternal.hxx"
+#include "ClientList.hxx"
+#include "Partition.hxx"
+#include "Instance.hxx"
 #include "Idle.hxx"
 
 #include <assert.h>
 
+/**
+ * Returns all idle events which were emitted since the client
+ * received its last notification.
+ */
+gcc_pure
+static unsigned
+GetPendingIdleFlags(const Client &client)
+{
+	const ClientList &list = *client.GetInstance().client_list;
+	return client.idle_flags | list.GetIdleFlagsSince(client.idle_serial);
+}
+
 void
 Client::IdleNotify()
 {
 	assert(idle_waiting);
-	assert(idle_flags != 0);
 
-	unsigned flags = idle_flags;
+	unsigned flags = GetPendingIdleFlags(*this);
+	assert(flags != 0);
+
 	idle_flags = 0;
+	idle_serial = GetInstance().client_list->GetIdleSerial();
 	idle_waiting = false;
+	idle_hook.unlink();
 
 	const char *const*idle_names = idle_get_names();
 	for (unsigned i = 0; idle_names[i]; ++i) {
@@ -64,12 +82,23 @@ Client::IdleWait(unsigned flags)
 	idle_waiting = true;
 	idle_subscriptions = flags;
 
-	if (idle_flags & idle_subscriptions) {
+	if (GetPendingIdleFlags(*this) & idle_subscriptions) {
 		IdleNotify();
 		return true;
 	} else {
+		GetInstance().client_list->AddIdleWaiter(*this);
+
 		/* disable timeouts while in "idle" */
 		TimeoutMonitor::Cancel();
 		return false;
 	}
 }
+
+void
+Client::IdleCancel()
+{
+	assert(idle_waiting);
+
+	idle_waiting = false;
+	idle_hook.unlink();
+}
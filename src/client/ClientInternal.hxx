@@ -33,6 +33,21 @@ extern int client_timeout;
 extern size_t client_max_command_list_size;
 extern size_t client_max_output_buffer_size;
 
+/**
+ * If not nullptr, all client_write() calls of the current thread
+ * append to this string instead of sending to the socket.  This is
+ * used by worker threads (see ClientWorker.hxx), which must not
+ * touch the socket.
+ */
+extern __thread std::string *client_redirect;
+
+/**
+ * Set when the #client_redirect string would grow beyond
+ * #client_max_output_buffer_size; the rest of the response has been
+ * discarded.
+ */
+extern __thread bool client_redirect_overflow;
+
 CommandResult
 client_process_line(Client &client, char *line);
 
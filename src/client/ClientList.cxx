@@ -30,12 +30,16 @@ ClientList::Remove(Client &client)
 {
 	assert(!list.empty());
 
+	client.UnsubscribeAll();
+	client.idle_hook.unlink();
 	list.erase(list.iterator_to(client));
 }
 
 void
 ClientList::CloseAll()
 {
+	idle_waiters.clear();
+	channels.clear();
 	list.clear_and_dispose(Client::Disposer());
 }
 
@@ -44,6 +48,86 @@ ClientList::IdleAdd(unsigned flags)
 {
 	assert(flags != 0);
 
-	for (auto &client : list)
-		client.IdleAdd(flags);
+	++idle_serial;
+	for (unsigned i = 0; i < 32; ++i)
+		if (flags & (1u << i))
+			idle_event_serials[i] = idle_serial;
+
+	for (auto i = idle_waiters.begin(); i != idle_waiters.end();) {
+		IdleList &waiters = i->second;
+
+		if (i->first & flags)
+			/* IdleNotify() removes the client from the
+			   list */
+			while (!waiters.empty())
+				waiters.front().IdleNotify();
+
+		if (waiters.empty())
+			i = idle_waiters.erase(i);
+		else
+			++i;
+	}
+}
+
+unsigned
+ClientList::GetIdleFlagsSince(uint64_t serial) const
+{
+	unsigned flags = 0;
+	for (unsigned i = 0; i < 32; ++i)
+		if (idle_event_serials[i] > serial)
+			flags |= 1u << i;
+
+	return flags;
+}
+
+void
+ClientList::AddIdleWaiter(Client &client)
+{
+	assert(client.idle_waiting);
+	assert(!client.idle_hook.is_linked());
+
+	idle_waiters[client.idle_subscriptions].push_back(client);
+}
+
+void
+ClientList::Subscribe(Client &client, const std::string &channel)
+{
+	auto &subscribers = channels[channel];
+	assert(std::find(subscribers.begin(), subscribers.end(),
+			 &client) == subscribers.end());
+
+	subscribers.push_back(&client);
+}
+
+void
+ClientList::Unsubscribe(Client &client, const std::string &channel)
+{
+	auto i = channels.find(channel);
+	assert(i != channels.end());
+
+	auto &subscribers = i->second;
+	auto j = std::find(subscribers.begin(), subscribers.end(), &client);
+	assert(j != subscribers.end());
+
+	/* the order of subscribers doesn't matter */
+	*j = subscribers.back();
+	subscribers.pop_back();
+
+	if (subscribers.empty())
+		channels.erase(i);
+}
+
+bool
+ClientList::SendMessage(const ClientMessage &msg)
+{
+	auto i = channels.find(msg.GetChannel());
+	if (i == channels.end())
+		return false;
+
+	bool sent = false;
+	for (Client *client : i->second)
+		if (client->PushMessage(msg))
+			sent = true;
+
+	return sent;
 }
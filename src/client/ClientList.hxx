@@ -22,19 +22,60 @@
 
 #include "Client.hxx"
 
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
 class Client;
+class ClientMessage;
 
 class ClientList {
 	typedef boost::intrusive::list<Client,
 				       boost::intrusive::constant_time_size<true>> List;
 
+	typedef boost::intrusive::list<Client,
+				       boost::intrusive::member_hook<Client,
+								     Client::IdleHook,
+								     &Client::idle_hook>,
+				       boost::intrusive::constant_time_size<false>> IdleList;
+
 	const unsigned max_size;
 
 	List list;
 
+	/**
+	 * Incremented by each IdleAdd() call.  Clients remember the
+	 * value when they have consumed their events, so events
+	 * need not be stored in every client.
+	 */
+	uint64_t idle_serial;
+
+	/**
+	 * The #idle_serial of the most recent event of each type
+	 * (indexed by the bit number of the IDLE_* flag).
+	 */
+	uint64_t idle_event_serials[32];
+
+	/**
+	 * The clients which are waiting in "idle", grouped by their
+	 * subscription mask.  Usually there are only a few distinct
+	 * masks, so an event touches only the clients which are
+	 * interested in it.
+	 */
+	std::map<unsigned, IdleList> idle_waiters;
+
+	/**
+	 * The subscribers of each channel.  Channels without
+	 * subscribers are removed.
+	 */
+	std::map<std::string, std::vector<Client *>> channels;
+
 public:
 	ClientList(unsigned _max_size)
-		:max_size(_max_size) {}
+		:max_size(_max_size), idle_serial(0),
+		 idle_event_serials() {}
 	~ClientList() {
 		CloseAll();
 	}
@@ -59,7 +100,49 @@ public:
 
 	void CloseAll();
 
+	/**
+	 * Emit idle events: notify all waiting clients which are
+	 * subscribed to one of them; the others will see them when
+	 * they enter "idle" next time.
+	 */
 	void IdleAdd(unsigned flags);
+
+	uint64_t GetIdleSerial() const {
+		return idle_serial;
+	}
+
+	/**
+	 * Returns the idle events which have been emitted after the
+	 * given #idle_serial.
+	 */
+	gcc_pure
+	unsigned GetIdleFlagsSince(uint64_t serial) const;
+
+	void AddIdleWaiter(Client &client);
+
+	/**
+	 * Register a new subscription of the client.  Called by
+	 * Client::Subscribe().
+	 */
+	void Subscribe(Client &client, const std::string &channel);
+
+	/**
+	 * Remove a subscription of the client.  Called by
+	 * Client::Unsubscribe().
+	 */
+	void Unsubscribe(Client &client, const std::string &channel);
+
+	const std::map<std::string, std::vector<Client *>> &GetChannels() const {
+		return channels;
+	}
+
+	/**
+	 * Deliver a message to all subscribers of its channel.
+	 *
+	 * @return true if at least one client has received the
+	 * message
+	 */
+	bool SendMessage(const ClientMessage &msg);
 };
 
 #endif
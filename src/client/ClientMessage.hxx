@@ -22,6 +22,7 @@
 
 #include "Compiler.h"
 
+#include <memory>
 #include <string>
 
 #ifdef WIN32
@@ -33,21 +34,35 @@
 /**
  * A client-to-client message.
  */
+/**
+ * A message sent to a channel.  The payload is reference counted
+ * and shared by all copies, so delivering it to many subscribers
+ * does not copy the strings.
+ */
 class ClientMessage {
-	std::string channel, message;
+	struct Data {
+		std::string channel, message;
+
+		template<typename T, typename U>
+		Data(T &&_channel, U &&_message)
+			:channel(std::forward<T>(_channel)),
+			 message(std::forward<U>(_message)) {}
+	};
+
+	std::shared_ptr<const Data> data;
 
 public:
 	template<typename T, typename U>
 	ClientMessage(T &&_channel, U &&_message)
-		:channel(std::forward<T>(_channel)),
-		 message(std::forward<U>(_message)) {}
+		:data(std::make_shared<Data>(std::forward<T>(_channel),
+					     std::forward<U>(_message))) {}
 
 	const char *GetChannel() const {
-		return channel.c_str();
+		return data->channel.c_str();
 	}
 
 	const char *GetMessage() const {
-		return message.c_str();
+		return data->message.c_str();
 	}
 };
 
@@ -43,15 +43,18 @@ static const char GREETING[] = "OK MPD " PROTOCOL_VERSION "\n";
 
 Client::Client(EventLoop &_loop, Partition &_partition,
 	       int _fd, int _uid, int _num)
-	:FullyBufferedSocket(_fd, _loop, 16384, client_max_output_buffer_size),
+	:FullyBufferedSocket(_fd, _loop, MemoryCategory::CLIENT,
+			     16384, client_max_output_buffer_size),
 	 TimeoutMonitor(_loop),
-	 partition(_partition),
-	 playlist(partition.playlist), player_control(partition.pc),
+	 partition(&_partition),
 	 permission(getDefaultPermissions()),
 	 uid(_uid),
 	 num(_num),
 	 idle_waiting(false), idle_flags(0),
-	 num_subscriptions(0)
+	 idle_serial(_partition.instance.client_list->GetIdleSerial()),
+	 num_subscriptions(0),
+	 capture(nullptr),
+	 worker_busy(false)
 {
 	TimeoutMonitor::ScheduleSeconds(client_timeout);
 }
@@ -108,7 +111,14 @@ client_new(EventLoop &loop, Partition &partition,
 void
 Client::Close()
 {
-	partition.instance.client_list->Remove(*this);
+	if (worker_busy) {
+		/* a worker thread is still using this object;
+		   OnWorkerFinished() will close it */
+		SetExpired();
+		return;
+	}
+
+	GetInstance().client_list->Remove(*this);
 
 	SetExpired();
 
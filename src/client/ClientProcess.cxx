@@ -19,8 +19,13 @@
 
 #include "config.h"
 #include "ClientInternal.hxx"
+#include "ClientWorker.hxx"
 #include "protocol/Result.hxx"
 #include "command/AllCommands.hxx"
+#include "BulkEdit.hxx"
+#ifdef ENABLE_SQLITE
+#include "sticker/StickerDatabase.hxx"
+#endif
 #include "Log.hxx"
 
 #include <string.h>
@@ -36,6 +41,17 @@ client_process_command_list(Client &client, bool list_ok,
 	CommandResult ret = CommandResult::OK;
 	unsigned num = 0;
 
+	/* treat the whole list as one queue edit: one version bump
+	   and one "playlist" idle event instead of one per
+	   "add"/"addid" */
+	const ScopeBulkEdit bulk_edit(client.GetPartition());
+
+#ifdef ENABLE_SQLITE
+	/* commit all sticker writes of the list in one
+	   transaction */
+	const ScopeStickerBatch sticker_batch;
+#endif
+
 	for (auto &&i : list) {
 		char *cmd = &*i.begin();
 
@@ -59,7 +75,7 @@ client_process_line(Client &client, char *line)
 	if (strcmp(line, "noidle") == 0) {
 		if (client.idle_waiting) {
 			/* send empty idle response and leave idle mode */
-			client.idle_waiting = false;
+			client.IdleCancel();
 			command_success(client);
 		}
 
@@ -120,6 +136,11 @@ client_process_line(Client &client, char *line)
 			client.cmd_list.Begin(true);
 			ret = CommandResult::OK;
 		} else {
+			if (client_worker_submit(client, line))
+				/* the response will be sent by
+				   Client::OnWorkerFinished() */
+				return CommandResult::OK;
+
 			FormatDebug(client_domain,
 				    "[%u] process command \"%s\"",
 				    client.num, line);
@@ -24,11 +24,50 @@
 #include "event/Loop.hxx"
 #include "util/StringUtil.hxx"
 
+#include <assert.h>
 #include <string.h>
 
+bool
+Client::ApplyCommandResult(CommandResult result)
+{
+	switch (result) {
+	case CommandResult::OK:
+	case CommandResult::IDLE:
+	case CommandResult::ERROR:
+		break;
+
+	case CommandResult::KILL: {
+		EventLoop &loop = *GetInstance().event_loop;
+		Close();
+		loop.Break();
+		return false;
+	}
+
+	case CommandResult::FINISH:
+		if (Flush())
+			Close();
+		return false;
+
+	case CommandResult::CLOSE:
+		Close();
+		return false;
+	}
+
+	if (IsExpired()) {
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
 BufferedSocket::InputResult
 Client::OnSocketInput(void *data, size_t length)
 {
+	if (worker_busy)
+		/* wait for OnWorkerFinished() */
+		return InputResult::PAUSE;
+
 	char *p = (char *)data;
 	char *newline = (char *)memchr(p, '\n', length);
 	if (newline == nullptr)
@@ -45,31 +84,37 @@ Client::OnSocketInput(void *data, size_t length)
 	*end = 0;
 
 	CommandResult result = client_process_line(*this, p);
-	switch (result) {
-	case CommandResult::OK:
-	case CommandResult::IDLE:
-	case CommandResult::ERROR:
-		break;
-
-	case CommandResult::KILL:
-		Close();
-		partition.instance.event_loop->Break();
+	if (!ApplyCommandResult(result))
 		return InputResult::CLOSED;
 
-	case CommandResult::FINISH:
-		if (Flush())
-			Close();
-		return InputResult::CLOSED;
-
-	case CommandResult::CLOSE:
-		Close();
-		return InputResult::CLOSED;
+	if (worker_busy) {
+		/* the command is being executed by a worker thread;
+		   a slow query must not trigger the timeout */
+		TimeoutMonitor::Cancel();
+		return InputResult::PAUSE;
 	}
 
+	return InputResult::AGAIN;
+}
+
+void
+Client::OnWorkerFinished(std::string &&response, CommandResult result)
+{
+	assert(worker_busy);
+
+	worker_busy = false;
+
 	if (IsExpired()) {
 		Close();
-		return InputResult::CLOSED;
+		return;
 	}
 
-	return InputResult::AGAIN;
+	client_write(*this, response.data(), response.length());
+	TimeoutMonitor::ScheduleSeconds(client_timeout);
+
+	if (!ApplyCommandResult(result))
+		return;
+
+	/* process the lines which have been received meanwhile */
+	ResumeInput();
 }
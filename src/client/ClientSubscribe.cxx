@@ -19,6 +19,8 @@
 
 #include "config.h"
 #include "ClientInternal.hxx"
+#include "ClientList.hxx"
+#include "Instance.hxx"
 #include "Idle.hxx"
 
 #include <assert.h>
@@ -38,6 +40,7 @@ Client::Subscribe(const char *channel)
 	if (!r.second)
 		return Client::SubscribeResult::ALREADY;
 
+	GetInstance().client_list->Subscribe(*this, *r.first);
 	++num_subscriptions;
 
 	idle_add(IDLE_SUBSCRIPTION);
@@ -54,6 +57,7 @@ Client::Unsubscribe(const char *channel)
 
 	assert(num_subscriptions > 0);
 
+	GetInstance().client_list->Unsubscribe(*this, *i);
 	subscriptions.erase(i);
 	--num_subscriptions;
 
@@ -68,6 +72,10 @@ Client::Unsubscribe(const char *channel)
 void
 Client::UnsubscribeAll()
 {
+	ClientList &client_list = *GetInstance().client_list;
+	for (const auto &channel : subscriptions)
+		client_list.Unsubscribe(*this, channel);
+
 	subscriptions.clear();
 	num_subscriptions = 0;
 }
@@ -75,8 +83,9 @@ Client::UnsubscribeAll()
 bool
 Client::PushMessage(const ClientMessage &msg)
 {
-	if (messages.size() >= CLIENT_MAX_MESSAGES ||
-	    !IsSubscribed(msg.GetChannel()))
+	assert(IsSubscribed(msg.GetChannel()));
+
+	if (messages.size() >= CLIENT_MAX_MESSAGES)
 		return false;
 
 	if (messages.empty())
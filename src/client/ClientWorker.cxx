@@ -0,0 +1,312 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "ClientWorker.hxx"
+#include "ClientInternal.hxx"
+#include "protocol/Result.hxx"
+#include "command/AllCommands.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "event/DeferredMonitor.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
+#include "Partition.hxx"
+#include "Instance.hxx"
+#include "Log.hxx"
+
+#ifdef ENABLE_DATABASE
+#include "db/plugins/simple/SimpleDatabasePlugin.hxx"
+#endif
+
+#include <list>
+#include <string>
+
+#include <assert.h>
+#include <string.h>
+
+/**
+ * The commands which may be executed in a worker thread.  They only
+ * read the database, whose queries are serialized by the
+ * #SimpleDatabase; they don't touch the queue or the player.
+ */
+static const char *const worker_commands[] = {
+	"count",
+	"find",
+	"list",
+	"listall",
+	"listallinfo",
+	"search",
+};
+
+struct ClientJob {
+	Client &client;
+
+	std::string line;
+
+	std::string response;
+
+	CommandResult result;
+
+	ClientJob(Client &_client, const char *_line)
+		:client(_client), line(_line),
+		 result(CommandResult::ERROR) {}
+
+	/**
+	 * Execute the command.  Called in a worker thread.
+	 */
+	void Run();
+};
+
+void
+ClientJob::Run()
+{
+	assert(client_redirect == nullptr);
+
+	client_redirect = &response;
+	client_redirect_overflow = false;
+
+	FormatDebug(client_domain, "[%u] process command \"%s\" in worker",
+		    client.num, line.c_str());
+	result = command_process(client, 0, &line[0]);
+	FormatDebug(client_domain, "[%u] command returned %i",
+		    client.num, int(result));
+
+	if (result == CommandResult::OK)
+		command_success(client);
+
+	client_redirect = nullptr;
+
+	if (client_redirect_overflow) {
+		FormatError(client_domain,
+			    "[%u] response too large for the output buffer",
+			    client.num);
+		response.clear();
+		result = CommandResult::CLOSE;
+	}
+}
+
+class ClientWorkerPool final : DeferredMonitor {
+	Mutex mutex;
+	Cond cond;
+
+	/**
+	 * Jobs waiting for a worker thread.  Protected by #mutex.
+	 */
+	std::list<ClientJob *> pending;
+
+	/**
+	 * Jobs which have been executed, to be delivered by
+	 * RunDeferred().  Protected by #mutex.
+	 */
+	std::list<ClientJob *> finished;
+
+	std::list<Thread> threads;
+
+	/**
+	 * Shall the worker threads exit?  Protected by #mutex.
+	 */
+	bool quit;
+
+public:
+	explicit ClientWorkerPool(EventLoop &_loop)
+		:DeferredMonitor(_loop), quit(false) {}
+
+	~ClientWorkerPool() {
+		assert(threads.empty());
+		assert(pending.empty());
+		assert(finished.empty());
+	}
+
+	bool Start(unsigned n, Error &error);
+	void Stop();
+
+	void Submit(ClientJob *job) {
+		const ScopeLock protect(mutex);
+		pending.push_back(job);
+		cond.signal();
+	}
+
+private:
+	void Run();
+
+	static void Run(void *ctx) {
+		SetThreadName("client");
+
+		ClientWorkerPool &pool = *(ClientWorkerPool *)ctx;
+		pool.Run();
+	}
+
+	/* virtual methods from class DeferredMonitor */
+	virtual void RunDeferred() override;
+};
+
+bool
+ClientWorkerPool::Start(unsigned n, Error &error)
+{
+	for (unsigned i = 0; i < n; ++i) {
+		threads.emplace_back();
+		if (!threads.back().Start(Run, this, error)) {
+			threads.pop_back();
+			Stop();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void
+ClientWorkerPool::Stop()
+{
+	mutex.lock();
+	quit = true;
+	cond.broadcast();
+	mutex.unlock();
+
+	for (auto &thread : threads)
+		thread.Join();
+	threads.clear();
+
+	DeferredMonitor::Cancel();
+
+	/* the clients are about to be destroyed; discard all
+	   responses */
+	pending.splice(pending.end(), finished);
+	for (ClientJob *job : pending) {
+		job->client.worker_busy = false;
+		delete job;
+	}
+
+	pending.clear();
+}
+
+void
+ClientWorkerPool::Run()
+{
+	const ScopeLock protect(mutex);
+
+	while (true) {
+		if (quit)
+			break;
+
+		if (pending.empty()) {
+			cond.wait(mutex);
+			continue;
+		}
+
+		ClientJob *job = pending.front();
+		pending.pop_front();
+
+		mutex.unlock();
+		job->Run();
+		mutex.lock();
+
+		finished.push_back(job);
+		DeferredMonitor::Schedule();
+	}
+}
+
+void
+ClientWorkerPool::RunDeferred()
+{
+	std::list<ClientJob *> jobs;
+
+	mutex.lock();
+	jobs.swap(finished);
+	mutex.unlock();
+
+	for (ClientJob *job : jobs) {
+		/* this may delete the client */
+		job->client.OnWorkerFinished(std::move(job->response),
+					     job->result);
+		delete job;
+	}
+}
+
+static ClientWorkerPool *client_worker_pool;
+
+bool
+client_worker_init(EventLoop &loop, Error &error)
+{
+	assert(client_worker_pool == nullptr);
+
+	const unsigned n = config_get_unsigned(CONF_CLIENT_WORKER_THREADS, 0);
+	if (n == 0)
+		return true;
+
+	client_worker_pool = new ClientWorkerPool(loop);
+	if (!client_worker_pool->Start(n, error)) {
+		delete client_worker_pool;
+		client_worker_pool = nullptr;
+		return false;
+	}
+
+	return true;
+}
+
+void
+client_worker_finish()
+{
+	if (client_worker_pool == nullptr)
+		return;
+
+	client_worker_pool->Stop();
+	delete client_worker_pool;
+	client_worker_pool = nullptr;
+}
+
+gcc_pure
+static bool
+IsWorkerCommand(const char *line)
+{
+	const size_t length = strcspn(line, " \t");
+
+	for (const char *name : worker_commands)
+		if (strlen(name) == length &&
+		    memcmp(name, line, length) == 0)
+			return true;
+
+	return false;
+}
+
+bool
+client_worker_submit(Client &client, const char *line)
+{
+	assert(!client.worker_busy);
+
+	if (client_worker_pool == nullptr || !IsWorkerCommand(line))
+		return false;
+
+#ifdef ENABLE_DATABASE
+	/* only the simple database plugin serializes its queries;
+	   the others must be used in the main thread */
+	const Database *db = client.GetInstance().database;
+	if (db == nullptr || !db->IsPlugin(simple_db_plugin))
+		return false;
+#else
+	return false;
+#endif
+
+	client.worker_busy = true;
+	client_worker_pool->Submit(new ClientJob(client, line));
+	return true;
+}
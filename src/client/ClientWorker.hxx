@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_CLIENT_WORKER_HXX
+#define MPD_CLIENT_WORKER_HXX
+
+#include "check.h"
+
+class EventLoop;
+class Client;
+class Error;
+
+/**
+ * Start the worker threads which execute read-only database
+ * commands ("find", "search", "list", ...) on behalf of clients, so
+ * slow queries do not delay the main thread.  The number of threads
+ * is configured with "client_worker_threads"; without it (the
+ * default), all commands run in the main thread.
+ *
+ * Must be called after daemonization.
+ */
+bool
+client_worker_init(EventLoop &loop, Error &error);
+
+/**
+ * Stop the worker threads, waiting for running commands to finish.
+ * Must be called before the clients are destroyed.
+ */
+void
+client_worker_finish();
+
+/**
+ * Pass the command line to a worker thread if this command is
+ * eligible.  The response is sent by Client::OnWorkerFinished(); the
+ * client must not process more input meanwhile.
+ *
+ * @return true if the command has been submitted, false if it must
+ * be executed by the caller
+ */
+bool
+client_worker_submit(Client &client, const char *line);
+
+#endif
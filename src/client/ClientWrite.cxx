@@ -20,22 +20,145 @@
 #include "config.h"
 #include "ClientInternal.hxx"
 #include "util/FormatString.hxx"
+#include "util/NumberFormat.hxx"
 
 #include <string.h>
+#include <stdio.h>
+
+__thread std::string *client_redirect;
+__thread bool client_redirect_overflow;
 
 /**
- * Write a block of data to the client.
+ * Append a copy of the response data to Client::capture, if enabled.
  */
 static void
+client_capture(Client &client, const char *data, size_t length)
+{
+	if (client.capture == nullptr)
+		return;
+
+	if (client.capture->length() + length <= client.capture_limit)
+		client.capture->append(data, length);
+	else
+		/* too large for the cache */
+		client.capture = nullptr;
+}
+
+void
 client_write(Client &client, const char *data, size_t length)
 {
+	if (client_redirect != nullptr) {
+		if (client_redirect->length() + length >
+		    client_max_output_buffer_size) {
+			client_redirect_overflow = true;
+			return;
+		}
+
+		client_capture(client, data, length);
+		client_redirect->append(data, length);
+		return;
+	}
+
 	/* if the client is going to be closed, do nothing */
 	if (client.IsExpired() || length == 0)
 		return;
 
+	client_capture(client, data, length);
 	client.Write(data, length);
 }
 
+void
+client_write_binary(Client &client, const void *data, size_t length)
+{
+	if (client_redirect == nullptr && client.IsExpired())
+		return;
+
+	char header[64];
+	const size_t header_length =
+		snprintf(header, sizeof(header), "binary: %lu\n",
+			 (unsigned long)length);
+
+	if (client_redirect != nullptr) {
+		client_write(client, header, header_length);
+		client_write(client, (const char *)data, length);
+		client_write(client, "\n", 1);
+		return;
+	}
+
+	client_capture(client, header, header_length);
+	client_capture(client, (const char *)data, length);
+	client_capture(client, "\n", 1);
+
+	const ConstBuffer<void> buffers[] = {
+		{ header, header_length },
+		{ data, length },
+		{ "\n", 1 },
+	};
+
+	client.WriteV(buffers, 3);
+}
+
+void
+client_writev(Client &client, const ConstBuffer<void> *parts, unsigned n)
+{
+	if (client_redirect == nullptr && client.IsExpired())
+		return;
+
+	size_t total = 0;
+	for (unsigned i = 0; i < n; ++i)
+		total += parts[i].size;
+
+	const auto w = client_redirect == nullptr
+		? client.PrepareWrite()
+		: WritableBuffer<void>(nullptr);
+	if (client_redirect != nullptr || w.size < total) {
+		/* not enough room: copy piece by piece, which may
+		   allocate the peak buffer */
+		for (unsigned i = 0; i < n; ++i)
+			client_write(client, (const char *)parts[i].data,
+				     parts[i].size);
+		return;
+	}
+
+	char *p = (char *)w.data;
+	for (unsigned i = 0; i < n; ++i) {
+		memcpy(p, parts[i].data, parts[i].size);
+		p += parts[i].size;
+	}
+
+	client_capture(client, (const char *)w.data, total);
+	client.CommitWrite(total);
+}
+
+void
+client_write_pair(Client &client, const char *prefix, size_t prefix_length,
+		  const char *value)
+{
+	const ConstBuffer<void> parts[] = {
+		{ prefix, prefix_length },
+		{ value, strlen(value) },
+		{ "\n", 1 },
+	};
+
+	client_writev(client, parts, 3);
+}
+
+void
+client_write_pair(Client &client, const char *prefix, size_t prefix_length,
+		  uint64_t value)
+{
+	char buffer[24];
+	char *end = FormatUint64(buffer, value);
+	*end++ = '\n';
+
+	const ConstBuffer<void> parts[] = {
+		{ prefix, prefix_length },
+		{ buffer, size_t(end - buffer) },
+	};
+
+	client_writev(client, parts, 2);
+}
+
 void
 client_puts(Client &client, const char *s)
 {
@@ -45,6 +168,33 @@ client_puts(Client &client, const char *s)
 void
 client_vprintf(Client &client, const char *fmt, va_list args)
 {
+	if (client_redirect != nullptr) {
+		char *p = FormatNewV(fmt, args);
+		client_write(client, p, strlen(p));
+		delete[] p;
+		return;
+	}
+
+	if (client.IsExpired())
+		return;
+
+	/* try to format directly into the output buffer, saving a
+	   heap allocation and a copy */
+	const auto w = client.PrepareWrite();
+	if (w.size > 1) {
+		va_list tmp;
+		va_copy(tmp, args);
+		const int length = vsnprintf((char *)w.data, w.size,
+					     fmt, tmp);
+		va_end(tmp);
+
+		if (length >= 0 && size_t(length) < w.size) {
+			client_capture(client, (const char *)w.data, length);
+			client.CommitWrite(length);
+			return;
+		}
+	}
+
 	char *p = FormatNewV(fmt, args);
 	client_write(client, p, strlen(p));
 	delete[] p;
@@ -28,6 +28,7 @@
 #include "FileCommands.hxx"
 #include "OutputCommands.hxx"
 #include "MessageCommands.hxx"
+#include "PartitionCommands.hxx"
 #include "NeighborCommands.hxx"
 #include "OtherCommands.hxx"
 #include "Permission.hxx"
@@ -37,13 +38,18 @@
 #include "client/Client.hxx"
 #include "util/Tokenizer.hxx"
 #include "util/Error.hxx"
+#include "util/Macros.hxx"
+#include "system/FatalError.hxx"
 
 #ifdef ENABLE_SQLITE
 #include "StickerCommands.hxx"
 #include "sticker/StickerDatabase.hxx"
 #endif
 
+#include <algorithm>
+
 #include <assert.h>
+#include <stdint.h>
 #include <string.h>
 
 /*
@@ -76,9 +82,10 @@ handle_not_commands(Client &client, unsigned argc, char *argv[]);
  * This array must be sorted!
  */
 static const struct command commands[] = {
-	{ "add", PERMISSION_ADD, 1, 1, handle_add },
+	{ "add", PERMISSION_ADD, 1, -1, handle_add },
 	{ "addid", PERMISSION_ADD, 1, 2, handle_addid },
 	{ "addtagid", PERMISSION_ADD, 3, 3, handle_addtagid },
+	{ "albumart", PERMISSION_READ, 2, 2, handle_albumart },
 	{ "channels", PERMISSION_READ, 0, 0, handle_channels },
 	{ "clear", PERMISSION_CONTROL, 0, 0, handle_clear },
 	{ "clearerror", PERMISSION_CONTROL, 0, 0, handle_clearerror },
@@ -103,10 +110,11 @@ static const struct command commands[] = {
 #endif
 	{ "idle", PERMISSION_READ, 0, -1, handle_idle },
 	{ "kill", PERMISSION_ADMIN, -1, -1, handle_kill },
+	{ "level", PERMISSION_READ, 0, 0, handle_level },
 #ifdef ENABLE_DATABASE
 	{ "list", PERMISSION_READ, 1, -1, handle_list },
-	{ "listall", PERMISSION_READ, 0, 1, handle_listall },
-	{ "listallinfo", PERMISSION_READ, 0, 1, handle_listallinfo },
+	{ "listall", PERMISSION_READ, 0, 3, handle_listall },
+	{ "listallinfo", PERMISSION_READ, 0, 3, handle_listallinfo },
 #endif
 	{ "listfiles", PERMISSION_READ, 0, 1, handle_listfiles },
 #ifdef ENABLE_DATABASE
@@ -115,11 +123,16 @@ static const struct command commands[] = {
 #ifdef ENABLE_NEIGHBOR_PLUGINS
 	{ "listneighbors", PERMISSION_READ, 0, 0, handle_listneighbors },
 #endif
+	{ "listpartitions", PERMISSION_READ, 0, 0, handle_listpartitions },
 	{ "listplaylist", PERMISSION_READ, 1, 1, handle_listplaylist },
 	{ "listplaylistinfo", PERMISSION_READ, 1, 1, handle_listplaylistinfo },
 	{ "listplaylists", PERMISSION_READ, 0, 0, handle_listplaylists },
 	{ "load", PERMISSION_ADD, 1, 2, handle_load },
+#ifdef ENABLE_LOCK_STATS
+	{ "lockstats", PERMISSION_ADMIN, 0, 0, handle_lockstats },
+#endif
 	{ "lsinfo", PERMISSION_READ, 0, 1, handle_lsinfo },
+	{ "memorystats", PERMISSION_READ, 0, 0, handle_memorystats },
 	{ "mixrampdb", PERMISSION_CONTROL, 1, 1, handle_mixrampdb },
 	{ "mixrampdelay", PERMISSION_CONTROL, 1, 1, handle_mixrampdelay },
 #ifdef ENABLE_DATABASE
@@ -127,12 +140,15 @@ static const struct command commands[] = {
 #endif
 	{ "move", PERMISSION_CONTROL, 2, 2, handle_move },
 	{ "moveid", PERMISSION_CONTROL, 2, 2, handle_moveid },
+	{ "newpartition", PERMISSION_ADMIN, 1, 1, handle_newpartition },
 	{ "next", PERMISSION_CONTROL, 0, 0, handle_next },
 	{ "notcommands", PERMISSION_NONE, 0, 0, handle_not_commands },
 	{ "outputs", PERMISSION_READ, 0, 0, handle_devices },
+	{ "partition", PERMISSION_READ, 1, 1, handle_partition },
 	{ "password", PERMISSION_NONE, 1, 1, handle_password },
 	{ "pause", PERMISSION_CONTROL, 0, 1, handle_pause },
 	{ "ping", PERMISSION_NONE, 0, 0, handle_ping },
+	{ "pipelinestats", PERMISSION_READ, 0, 0, handle_pipelinestats },
 	{ "play", PERMISSION_CONTROL, 0, 1, handle_play },
 	{ "playid", PERMISSION_CONTROL, 0, 1, handle_playid },
 	{ "playlist", PERMISSION_READ, 0, 0, handle_playlist },
@@ -190,6 +206,9 @@ static const struct command commands[] = {
 #endif
 	{ "unsubscribe", PERMISSION_READ, 1, 1, handle_unsubscribe },
 	{ "update", PERMISSION_CONTROL, 0, 1, handle_update },
+#ifdef ENABLE_DATABASE
+	{ "updatestats", PERMISSION_READ, 0, 0, handle_updatestats },
+#endif
 	{ "urlhandlers", PERMISSION_READ, 0, 0, handle_urlhandlers },
 	{ "volume", PERMISSION_CONTROL, 1, 1, handle_volume },
 };
@@ -225,7 +244,7 @@ handle_commands(Client &client,
 		cmd = &commands[i];
 
 		if (cmd->permission == (permission & cmd->permission) &&
-		    command_available(client.partition, cmd))
+		    command_available(client.GetPartition(), cmd))
 			client_printf(client, "command: %s\n", cmd->cmd);
 	}
 
@@ -249,6 +268,68 @@ handle_not_commands(Client &client,
 	return CommandResult::OK;
 }
 
+/**
+ * A collision-free hash table mapping command names to indexes in
+ * #commands.  It is built by command_init() with a seed chosen so
+ * no two command names share a slot; a lookup is one hash and one
+ * strcmp().
+ */
+static struct {
+	uint32_t seed;
+	unsigned mask;
+
+	/** index into #commands plus one; 0 means empty */
+	uint8_t slots[4096];
+} command_hash;
+
+static_assert(sizeof(commands) / sizeof(commands[0]) < 256,
+	      "too many commands for the hash table");
+
+gcc_pure
+static uint32_t
+command_hash_name(const char *name, uint32_t seed)
+{
+	/* FNV-1a */
+	uint32_t h = 2166136261u ^ seed;
+	while (*name != 0) {
+		h ^= (unsigned char)*name++;
+		h *= 16777619u;
+	}
+
+	return h ^ (h >> 15);
+}
+
+static bool
+command_hash_try(unsigned size, uint32_t seed)
+{
+	std::fill_n(command_hash.slots, size, 0);
+
+	for (unsigned i = 0; i < num_commands; ++i) {
+		uint8_t &slot = command_hash.slots[command_hash_name(commands[i].cmd,
+								      seed) & (size - 1)];
+		if (slot != 0)
+			return false;
+
+		slot = i + 1;
+	}
+
+	command_hash.seed = seed;
+	command_hash.mask = size - 1;
+	return true;
+}
+
+static void
+command_hash_build()
+{
+	for (unsigned size = 512; size <= ARRAY_SIZE(command_hash.slots);
+	     size *= 2)
+		for (uint32_t seed = 0; seed < 1024; ++seed)
+			if (command_hash_try(size, seed))
+				return;
+
+	FatalError("Failed to build the command hash table");
+}
+
 void command_init(void)
 {
 #ifndef NDEBUG
@@ -256,32 +337,27 @@ void command_init(void)
 	for (unsigned i = 0; i < num_commands - 1; ++i)
 		assert(strcmp(commands[i].cmd, commands[i + 1].cmd) < 0);
 #endif
+
+	command_hash_build();
 }
 
 void command_finish(void)
 {
 }
 
+gcc_pure
 static const struct command *
 command_lookup(const char *name)
 {
-	unsigned a = 0, b = num_commands, i;
-	int cmp;
-
-	/* binary search */
-	do {
-		i = (a + b) / 2;
-
-		cmp = strcmp(name, commands[i].cmd);
-		if (cmp == 0)
-			return &commands[i];
-		else if (cmp < 0)
-			b = i;
-		else if (cmp > 0)
-			a = i + 1;
-	} while (a < b);
-
-	return nullptr;
+	const unsigned i = command_hash.slots[command_hash_name(name, command_hash.seed)
+					      & command_hash.mask];
+	if (i == 0)
+		return nullptr;
+
+	const struct command *cmd = &commands[i - 1];
+	return strcmp(name, cmd->cmd) == 0
+		? cmd
+		: nullptr;
 }
 
 static bool
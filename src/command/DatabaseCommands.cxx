@@ -25,16 +25,24 @@
 #include "db/DatabasePrint.hxx"
 #include "db/Count.hxx"
 #include "db/Selection.hxx"
+#include "db/QueryCache.hxx"
+#include "db/Interface.hxx"
 #include "CommandError.hxx"
 #include "client/Client.hxx"
+#include "Partition.hxx"
+#include "Instance.hxx"
 #include "tag/Tag.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/Error.hxx"
 #include "SongFilter.hxx"
 #include "protocol/Result.hxx"
+#include "protocol/ArgParser.hxx"
 #include "BulkEdit.hxx"
 
+#include <limits>
+
 #include <string.h>
+#include <stdio.h>
 
 CommandResult
 handle_listfiles_db(Client &client, const char *uri)
@@ -65,23 +73,102 @@ handle_lsinfo2(Client &client, unsigned argc, char *argv[])
 	return CommandResult::OK;
 }
 
+/**
+ * Parse and remove the optional "window START:END" at the end of
+ * the arguments.  Without it, the window covers the whole result.
+ */
+static bool
+parse_window(Client &client, ConstBuffer<const char *> &args,
+	     unsigned &start, unsigned &end)
+{
+	start = 0;
+	end = std::numeric_limits<unsigned>::max();
+
+	if (args.size < 2 || strcmp(args[args.size - 2], "window") != 0)
+		return true;
+
+	if (!check_range(client, &start, &end, args.back()))
+		return false;
+
+	args.pop_back();
+	args.pop_back();
+	return true;
+}
+
+/**
+ * Send the response for the given key from the #QueryCache, or run
+ * the query and store its response there.
+ */
+template<typename F>
+static CommandResult
+run_cached_query(Client &client, std::string &&key, F query)
+{
+	QueryCache *const cache = client.GetInstance().query_cache;
+	if (cache == nullptr)
+		return query();
+
+	Error error;
+	const Database *db = client.GetDatabase(error);
+	if (db == nullptr)
+		return query();
+
+	/* without an update stamp, modifications can't be
+	   detected */
+	const time_t stamp = db->GetUpdateStamp();
+	if (stamp == 0)
+		return query();
+
+	std::string response;
+	if (cache->Get(key, stamp, response)) {
+		client_write(client, response.data(), response.length());
+		return CommandResult::OK;
+	}
+
+	client.capture = &response;
+	client.capture_limit = cache->GetMaxResponseSize();
+
+	const CommandResult result = query();
+
+	const bool complete = client.capture == &response;
+	client.capture = nullptr;
+
+	if (result == CommandResult::OK && complete && !client.IsExpired())
+		cache->Put(std::move(key), stamp, std::move(response));
+
+	return result;
+}
+
 static CommandResult
 handle_match(Client &client, unsigned argc, char *argv[], bool fold_case)
 {
 	ConstBuffer<const char *> args(argv + 1, argc - 1);
 
+	unsigned window_start, window_end;
+	if (!parse_window(client, args, window_start, window_end))
+		return CommandResult::ERROR;
+
 	SongFilter filter;
 	if (!filter.Parse(args, fold_case)) {
 		command_error(client, ACK_ERROR_ARG, "incorrect arguments");
 		return CommandResult::ERROR;
 	}
 
-	const DatabaseSelection selection("", true, &filter);
+	const auto query = [&](){
+		const DatabaseSelection selection("", true, &filter);
 
-	Error error;
-	return db_selection_print(client, selection, true, false, error)
-		? CommandResult::OK
-		: print_error(client, error);
+		Error error;
+		return db_selection_print(client, selection, true, false,
+					  window_start, window_end, error)
+			? CommandResult::OK
+			: print_error(client, error);
+	};
+
+	char window[32];
+	snprintf(window, sizeof(window), "%u:%u", window_start, window_end);
+
+	return run_cached_query(client,
+				QueryCacheKey(argv[0], window, &filter),
+				query);
 }
 
 CommandResult
@@ -107,11 +194,11 @@ handle_match_add(Client &client, unsigned argc, char *argv[], bool fold_case)
 		return CommandResult::ERROR;
 	}
 
-	const ScopeBulkEdit bulk_edit(client.partition);
+	const ScopeBulkEdit bulk_edit(client.GetPartition());
 
 	const DatabaseSelection selection("", true, &filter);
 	Error error;
-	return AddFromDatabase(client.partition, selection, error)
+	return AddFromDatabase(client.GetPartition(), selection, error)
 		? CommandResult::OK
 		: print_error(client, error);
 }
@@ -176,27 +263,51 @@ handle_count(Client &client, unsigned argc, char *argv[])
 		return CommandResult::ERROR;
 	}
 
-	Error error;
-	return PrintSongCount(client, "", &filter, group, error)
-		? CommandResult::OK
-		: print_error(client, error);
+	const auto query = [&](){
+		Error error;
+		return PrintSongCount(client, "", &filter, group, error)
+			? CommandResult::OK
+			: print_error(client, error);
+	};
+
+	char parameters[16];
+	snprintf(parameters, sizeof(parameters), "%u", unsigned(group));
+
+	return run_cached_query(client,
+				QueryCacheKey("count", parameters, &filter),
+				query);
 }
 
-CommandResult
-handle_listall(Client &client, gcc_unused unsigned argc, char *argv[])
+static CommandResult
+handle_listall2(Client &client, unsigned argc, char *argv[], bool full)
 {
-	const char *directory = "";
+	ConstBuffer<const char *> args(argv + 1, argc - 1);
+
+	unsigned window_start, window_end;
+	if (!parse_window(client, args, window_start, window_end))
+		return CommandResult::ERROR;
+
+	if (args.size > 1) {
+		command_error(client, ACK_ERROR_ARG, "incorrect arguments");
+		return CommandResult::ERROR;
+	}
 
-	if (argc == 2)
-		directory = argv[1];
+	const char *directory = args.IsEmpty() ? "" : args.front();
 
 	Error error;
 	return db_selection_print(client, DatabaseSelection(directory, true),
-				  false, false, error)
+				  full, false, window_start, window_end,
+				  error)
 		? CommandResult::OK
 		: print_error(client, error);
 }
 
+CommandResult
+handle_listall(Client &client, unsigned argc, char *argv[])
+{
+	return handle_listall2(client, argc, argv, false);
+}
+
 CommandResult
 handle_list(Client &client, unsigned argc, char *argv[])
 {
@@ -259,11 +370,22 @@ handle_list(Client &client, unsigned argc, char *argv[])
 		return CommandResult::ERROR;
 	}
 
-	Error error;
+	const auto query = [&](){
+		Error error;
+		return PrintUniqueTags(client, tagType, group_mask, filter,
+				       error)
+			? CommandResult::OK
+			: print_error(client, error);
+	};
+
+	char parameters[32];
+	snprintf(parameters, sizeof(parameters), "%u:%x",
+		 tagType, (unsigned)group_mask);
+
 	CommandResult ret =
-		PrintUniqueTags(client, tagType, group_mask, filter, error)
-		? CommandResult::OK
-		: print_error(client, error);
+		run_cached_query(client,
+				 QueryCacheKey("list", parameters, filter),
+				 query);
 
 	delete filter;
 
@@ -271,16 +393,7 @@ handle_list(Client &client, unsigned argc, char *argv[])
 }
 
 CommandResult
-handle_listallinfo(Client &client, gcc_unused unsigned argc, char *argv[])
+handle_listallinfo(Client &client, unsigned argc, char *argv[])
 {
-	const char *directory = "";
-
-	if (argc == 2)
-		directory = argv[1];
-
-	Error error;
-	return db_selection_print(client, DatabaseSelection(directory, true),
-				  true, false, error)
-		? CommandResult::OK
-		: print_error(client, error);
+	return handle_listall2(client, argc, argv, true);
 }
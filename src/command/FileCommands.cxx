@@ -30,6 +30,7 @@
 #include "util/Error.hxx"
 #include "tag/TagHandler.hxx"
 #include "tag/ApeTag.hxx"
+#include "tag/TagFileReader.hxx"
 #include "tag/TagId3.hxx"
 #include "TagStream.hxx"
 #include "TagFile.hxx"
@@ -38,6 +39,12 @@
 #include "fs/FileSystem.hxx"
 #include "TimePrint.hxx"
 #include "ls.hxx"
+#include "art/ArtExtract.hxx"
+#include "art/ArtCache.hxx"
+#include "protocol/ArgParser.hxx"
+
+#include <algorithm>
+#include <string>
 
 #include <assert.h>
 #include <sys/stat.h>
@@ -163,6 +170,7 @@ static constexpr tag_handler print_comment_handler = {
 	nullptr,
 	nullptr,
 	print_pair,
+	nullptr,
 };
 
 static CommandResult
@@ -193,8 +201,11 @@ read_file_comments(Client &client, const Path path_fs)
 		return CommandResult::ERROR;
 	}
 
-	tag_ape_scan2(path_fs, &print_comment_handler, &client);
-	tag_id3_scan(path_fs, &print_comment_handler, &client);
+	TagFileReader reader;
+	if (reader.Open(path_fs, IgnoreError())) {
+		tag_ape_scan2(reader, &print_comment_handler, &client);
+		tag_id3_scan(reader, &print_comment_handler, &client);
+	}
 
 	return CommandResult::OK;
 
@@ -256,3 +267,126 @@ handle_read_comments(Client &client, gcc_unused unsigned argc, char *argv[])
 		return CommandResult::ERROR;
 	}
 }
+
+/**
+ * The picture which was sent most recently.  Clients fetch a picture
+ * in several chunks, and this avoids loading it for each chunk.
+ */
+static struct {
+	std::string path;
+	time_t mtime;
+	AlbumArt art;
+} last_art;
+
+/**
+ * Find the picture of a local song file, using the art cache and
+ * #last_art.
+ */
+static bool
+load_album_art(Path path_fs, AlbumArt &art)
+{
+	struct stat st;
+	if (!StatFile(path_fs, st) || !S_ISREG(st.st_mode))
+		return false;
+
+	if (last_art.path == path_fs.c_str() &&
+	    last_art.mtime == st.st_mtime) {
+		art = last_art.art;
+		return !art.IsEmpty();
+	}
+
+	switch (art_cache_lookup(path_fs.c_str(), st.st_mtime, art)) {
+	case ArtCacheResult::FOUND:
+		break;
+
+	case ArtCacheResult::NONE:
+		art = AlbumArt();
+		break;
+
+	case ArtCacheResult::MISS:
+		if (!art_extract(path_fs, art))
+			art = AlbumArt();
+
+		art_cache_store(path_fs.c_str(), st.st_mtime, art);
+		break;
+	}
+
+	last_art.path = path_fs.c_str();
+	last_art.mtime = st.st_mtime;
+	last_art.art = art;
+	return !art.IsEmpty();
+}
+
+static CommandResult
+send_album_art(Client &client, Path path_fs, unsigned offset)
+{
+	AlbumArt art;
+	if (!load_album_art(path_fs, art)) {
+		command_error(client, ACK_ERROR_NO_EXIST, "No album art");
+		return CommandResult::ERROR;
+	}
+
+	if (offset > art.data.size()) {
+		command_error(client, ACK_ERROR_ARG, "Bad offset");
+		return CommandResult::ERROR;
+	}
+
+	static constexpr size_t CHUNK_SIZE = 8192;
+	const size_t length = std::min(art.data.size() - offset,
+				       CHUNK_SIZE);
+
+	client_printf(client, "size: %lu\n",
+		      (unsigned long)art.data.size());
+	if (!art.mime_type.empty())
+		client_printf(client, "type: %s\n", art.mime_type.c_str());
+	client_write_binary(client, art.data.data() + offset, length);
+	return CommandResult::OK;
+}
+
+CommandResult
+handle_albumart(Client &client, gcc_unused unsigned argc, char *argv[])
+{
+	assert(argc == 3);
+
+	const char *const uri = argv[1];
+
+	unsigned offset;
+	if (!check_unsigned(client, &offset, argv[2]))
+		return CommandResult::ERROR;
+
+	if (memcmp(uri, "file:///", 8) == 0) {
+		/* a picture of an arbitrary local file */
+		AllocatedPath path_fs = AllocatedPath::FromUTF8(uri + 7);
+		if (path_fs.IsNull()) {
+			command_error(client, ACK_ERROR_NO_EXIST,
+				      "unsupported file name");
+			return CommandResult::ERROR;
+		}
+
+		Error error;
+		if (!client.AllowFile(path_fs, error))
+			return print_error(client, error);
+
+		return send_album_art(client, path_fs, offset);
+	} else if (!uri_has_scheme(uri) && !PathTraitsUTF8::IsAbsolute(uri)) {
+#ifdef ENABLE_DATABASE
+		const Storage *storage = client.GetStorage();
+		if (storage == nullptr) {
+#endif
+			command_error(client, ACK_ERROR_NO_EXIST,
+				      "No database");
+			return CommandResult::ERROR;
+#ifdef ENABLE_DATABASE
+		}
+
+		/* only songs in a local music directory are
+		   supported */
+		const AllocatedPath path_fs = storage->MapFS(uri);
+		if (!path_fs.IsNull())
+			return send_album_art(client, path_fs, offset);
+#endif
+	}
+
+	command_error(client, ACK_ERROR_NO_EXIST, "No such file");
+	return CommandResult::ERROR;
+}
@@ -30,4 +30,7 @@ handle_listfiles_local(Client &client, const char *path_utf8);
 CommandResult
 handle_read_comments(Client &client, unsigned argc, char *argv[]);
 
+CommandResult
+handle_albumart(Client &client, unsigned argc, char *argv[]);
+
 #endif
@@ -25,9 +25,6 @@
 #include "Partition.hxx"
 #include "protocol/Result.hxx"
 
-#include <set>
-#include <string>
-
 #include <assert.h>
 
 CommandResult
@@ -80,13 +77,8 @@ handle_channels(Client &client,
 {
 	assert(argc == 1);
 
-	std::set<std::string> channels;
-	for (const auto &c : *client.partition.instance.client_list)
-		channels.insert(c.subscriptions.begin(),
-				c.subscriptions.end());
-
-	for (const auto &channel : channels)
-		client_printf(client, "channel: %s\n", channel.c_str());
+	for (const auto &i : client.GetInstance().client_list->GetChannels())
+		client_printf(client, "channel: %s\n", i.first.c_str());
 
 	return CommandResult::OK;
 }
@@ -120,13 +112,8 @@ handle_send_message(Client &client,
 		return CommandResult::ERROR;
 	}
 
-	bool sent = false;
 	const ClientMessage msg(argv[1], argv[2]);
-	for (auto &c : *client.partition.instance.client_list)
-		if (c.PushMessage(msg))
-			sent = true;
-
-	if (sent)
+	if (client.GetInstance().client_list->SendMessage(msg))
 		return CommandResult::OK;
 	else {
 		command_error(client, ACK_ERROR_NO_EXIST,
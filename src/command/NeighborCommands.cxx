@@ -42,7 +42,7 @@ handle_listneighbors(Client &client,
 		     gcc_unused unsigned argc, gcc_unused char *argv[])
 {
 	const NeighborGlue *const neighbors =
-		client.partition.instance.neighbors;
+		client.GetInstance().neighbors;
 	if (neighbors == nullptr) {
 		command_error(client, ACK_ERROR_UNKNOWN,
 			      "No neighbor plugin configured");
@@ -37,8 +37,10 @@
 #include "mixer/Volume.hxx"
 #include "util/UriUtil.hxx"
 #include "util/Error.hxx"
+#include "util/MemoryStats.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "Stats.hxx"
+#include "PipelineStats.hxx"
 #include "Permission.hxx"
 #include "PlaylistFile.hxx"
 #include "db/PlaylistVector.hxx"
@@ -53,6 +55,10 @@
 #include "db/update/Service.hxx"
 #endif
 
+#ifdef ENABLE_LOCK_STATS
+#include "thread/LockStats.hxx"
+#endif
+
 #include <assert.h>
 #include <string.h>
 
@@ -135,11 +141,11 @@ handle_listfiles(Client &client, unsigned argc, char *argv[])
 	/* must be a path relative to the configured
 	   music_directory */
 
-	if (client.partition.instance.storage != nullptr)
+	if (client.GetInstance().storage != nullptr)
 		/* if we have a storage instance, obtain a list of
 		   files from it */
 		return handle_listfiles_storage(client,
-						*client.partition.instance.storage,
+						*client.GetInstance().storage,
 						uri);
 
 	/* fall back to entries from database if we have no storage */
@@ -154,6 +160,7 @@ static constexpr tag_handler print_tag_handler = {
 	nullptr,
 	print_tag,
 	nullptr,
+	nullptr,
 };
 
 CommandResult
@@ -284,11 +291,11 @@ handle_update(Client &client, unsigned argc, char *argv[], bool discard)
 		}
 	}
 
-	UpdateService *update = client.partition.instance.update;
+	UpdateService *update = client.GetInstance().update;
 	if (update != nullptr)
 		return handle_update(client, *update, path, discard);
 
-	Database *db = client.partition.instance.database;
+	Database *db = client.GetInstance().database;
 	if (db != nullptr)
 		return handle_update(client, *db, path, discard);
 #else
@@ -313,6 +320,50 @@ handle_rescan(Client &client, gcc_unused unsigned argc, char *argv[])
 	return handle_update(client, argc, argv, true);
 }
 
+#ifdef ENABLE_DATABASE
+
+CommandResult
+handle_updatestats(Client &client,
+		   gcc_unused unsigned argc, gcc_unused char *argv[])
+{
+	const UpdateService *update = client.GetInstance().update;
+	if (update == nullptr) {
+		command_error(client, ACK_ERROR_NO_EXIST, "No database");
+		return CommandResult::ERROR;
+	}
+
+	const UpdateStats &stats = update->GetStats();
+	const unsigned duration_ms = update->GetStatsDuration();
+	const unsigned files = stats.files;
+
+	client_printf(client,
+		      "updating_db: %u\n"
+		      "directories: %u\n"
+		      "files: %u\n"
+		      "songs: %u\n"
+		      "song_bytes: %llu\n"
+		      "elapsed: %.3f\n"
+		      "files_per_second: %u\n"
+		      "storage_time: %.3f\n"
+		      "scan_time: %.3f\n",
+		      update->GetId(),
+		      unsigned(stats.directories),
+		      files,
+		      unsigned(stats.songs),
+		      (unsigned long long)stats.song_bytes,
+		      duration_ms / 1000.,
+		      duration_ms > 0
+		      ? unsigned(uint64_t(files) * 1000 / duration_ms)
+		      : 0,
+		      stats.storage_us / 1000000.,
+		      stats.scan_us / 1000000.);
+
+	decoder_scan_stats_print(client);
+	return CommandResult::OK;
+}
+
+#endif
+
 CommandResult
 handle_setvol(Client &client, gcc_unused unsigned argc, char *argv[])
 {
@@ -327,7 +378,7 @@ handle_setvol(Client &client, gcc_unused unsigned argc, char *argv[])
 		return CommandResult::ERROR;
 	}
 
-	success = volume_level_change(client.partition.outputs, level);
+	success = volume_level_change(client.GetPartition().outputs, level);
 	if (!success) {
 		command_error(client, ACK_ERROR_SYSTEM,
 			      "problems setting volume");
@@ -349,7 +400,7 @@ handle_volume(Client &client, gcc_unused unsigned argc, char *argv[])
 		return CommandResult::ERROR;
 	}
 
-	const int old_volume = volume_level_get(client.partition.outputs);
+	const int old_volume = volume_level_get(client.GetPartition().outputs);
 	if (old_volume < 0) {
 		command_error(client, ACK_ERROR_SYSTEM, "No mixer");
 		return CommandResult::ERROR;
@@ -362,7 +413,7 @@ handle_volume(Client &client, gcc_unused unsigned argc, char *argv[])
 		new_volume = 100;
 
 	if (new_volume != old_volume &&
-	    !volume_level_change(client.partition.outputs, new_volume)) {
+	    !volume_level_change(client.GetPartition().outputs, new_volume)) {
 		command_error(client, ACK_ERROR_SYSTEM,
 			      "problems setting volume");
 		return CommandResult::ERROR;
@@ -440,12 +491,73 @@ handle_idle(Client &client,
 		flags |= event;
 	}
 
-	/* No argument means that the client wants to receive everything */
+	/* No argument means that the client wants to receive
+	   everything, except for the frequent "level" events */
 	if (flags == 0)
-		flags = ~0;
+		flags = ~IDLE_LEVEL;
 
 	/* enable "idle" mode on this client */
 	client.IdleWait(flags);
 
 	return CommandResult::IDLE;
 }
+
+CommandResult
+handle_pipelinestats(Client &client,
+		     gcc_unused unsigned argc, gcc_unused char *argv[])
+{
+	client_puts(client, pipeline_stats_format().c_str());
+	return CommandResult::OK;
+}
+
+CommandResult
+handle_memorystats(Client &client,
+		   gcc_unused unsigned argc, gcc_unused char *argv[])
+{
+	for (unsigned i = 0; i < unsigned(MemoryCategory::MAX); ++i) {
+		const MemoryCategory category = MemoryCategory(i);
+		const MemoryCounter &c = MemoryStatsGet(category);
+		client_printf(client,
+			      "memory: %s\n"
+			      "bytes: %llu\n"
+			      "peak: %llu\n"
+			      "allocations: %llu\n",
+			      MemoryCategoryName(category),
+			      (unsigned long long)c.bytes.load(),
+			      (unsigned long long)c.peak.load(),
+			      (unsigned long long)c.allocations.load());
+	}
+
+	return CommandResult::OK;
+}
+
+#ifdef ENABLE_LOCK_STATS
+
+CommandResult
+handle_lockstats(Client &client,
+		 gcc_unused unsigned argc, gcc_unused char *argv[])
+{
+	for (const LockStats *s = LockStats::GetFirst(); s != nullptr;
+	     s = s->next) {
+		client_printf(client,
+			      "lock: %s\n"
+			      "acquisitions: %llu\n"
+			      "contentions: %llu\n"
+			      "wait_us: %llu\n"
+			      "histogram:",
+			      s->name,
+			      (unsigned long long)s->acquisitions.load(),
+			      (unsigned long long)s->contentions.load(),
+			      (unsigned long long)s->wait_us.load());
+
+		for (const auto &i : s->histogram)
+			client_printf(client, " %llu",
+				      (unsigned long long)i.load());
+
+		client_puts(client, "\n");
+	}
+
+	return CommandResult::OK;
+}
+
+#endif
@@ -51,6 +51,13 @@ handle_update(Client &client, unsigned argc, char *argv[]);
 CommandResult
 handle_rescan(Client &client, unsigned argc, char *argv[]);
 
+#ifdef ENABLE_DATABASE
+
+CommandResult
+handle_updatestats(Client &client, unsigned argc, char *argv[]);
+
+#endif
+
 CommandResult
 handle_setvol(Client &client, unsigned argc, char *argv[]);
 
@@ -72,4 +79,15 @@ handle_config(Client &client, unsigned argc, char *argv[]);
 CommandResult
 handle_idle(Client &client, unsigned argc, char *argv[]);
 
+CommandResult
+handle_pipelinestats(Client &client, unsigned argc, char *argv[]);
+
+CommandResult
+handle_memorystats(Client &client, unsigned argc, char *argv[]);
+
+#ifdef ENABLE_LOCK_STATS
+CommandResult
+handle_lockstats(Client &client, unsigned argc, char *argv[]);
+#endif
+
 #endif
@@ -33,7 +33,7 @@ handle_enableoutput(Client &client, gcc_unused unsigned argc, char *argv[])
 	if (!check_unsigned(client, &device, argv[1]))
 		return CommandResult::ERROR;
 
-	if (!audio_output_enable_index(client.partition.outputs, device)) {
+	if (!audio_output_enable_index(client.GetPartition().outputs, device)) {
 		command_error(client, ACK_ERROR_NO_EXIST,
 			      "No such audio output");
 		return CommandResult::ERROR;
@@ -49,7 +49,7 @@ handle_disableoutput(Client &client, gcc_unused unsigned argc, char *argv[])
 	if (!check_unsigned(client, &device, argv[1]))
 		return CommandResult::ERROR;
 
-	if (!audio_output_disable_index(client.partition.outputs, device)) {
+	if (!audio_output_disable_index(client.GetPartition().outputs, device)) {
 		command_error(client, ACK_ERROR_NO_EXIST,
 			      "No such audio output");
 		return CommandResult::ERROR;
@@ -65,7 +65,7 @@ handle_toggleoutput(Client &client, gcc_unused unsigned argc, char *argv[])
 	if (!check_unsigned(client, &device, argv[1]))
 		return CommandResult::ERROR;
 
-	if (!audio_output_toggle_index(client.partition.outputs, device)) {
+	if (!audio_output_toggle_index(client.GetPartition().outputs, device)) {
 		command_error(client, ACK_ERROR_NO_EXIST,
 			      "No such audio output");
 		return CommandResult::ERROR;
@@ -78,7 +78,16 @@ CommandResult
 handle_devices(Client &client,
 	       gcc_unused unsigned argc, gcc_unused char *argv[])
 {
-	printAudioDevices(client, client.partition.outputs);
+	printAudioDevices(client, client.GetPartition().outputs);
+
+	return CommandResult::OK;
+}
+
+CommandResult
+handle_level(Client &client,
+	     gcc_unused unsigned argc, gcc_unused char *argv[])
+{
+	printAudioLevels(client, client.GetPartition().outputs);
 
 	return CommandResult::OK;
 }
@@ -36,4 +36,7 @@ handle_toggleoutput(Client &client, unsigned argc, char *argv[]);
 CommandResult
 handle_devices(Client &client, unsigned argc, char *argv[]);
 
+CommandResult
+handle_level(Client &client, unsigned argc, char *argv[]);
+
 #endif
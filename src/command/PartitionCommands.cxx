@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "PartitionCommands.hxx"
+#include "client/Client.hxx"
+#include "Instance.hxx"
+#include "Partition.hxx"
+#include "PlayerThread.hxx"
+#include "Idle.hxx"
+#include "protocol/Result.hxx"
+#include "util/CharUtil.hxx"
+
+#include <assert.h>
+
+CommandResult
+handle_partition(Client &client, gcc_unused unsigned argc, char *argv[])
+{
+	assert(argc == 2);
+
+	Partition *partition = client.GetInstance().FindPartition(argv[1]);
+	if (partition == nullptr) {
+		command_error(client, ACK_ERROR_NO_EXIST,
+			      "partition does not exist");
+		return CommandResult::ERROR;
+	}
+
+	client.SetPartition(*partition);
+
+	/* the client is now looking at a different queue and
+	   player */
+	client.IdleAdd(IDLE_PLAYLIST|IDLE_PLAYER|IDLE_MIXER|IDLE_OPTIONS|
+		       IDLE_OUTPUT);
+
+	return CommandResult::OK;
+}
+
+CommandResult
+handle_listpartitions(Client &client,
+		      gcc_unused unsigned argc, gcc_unused char *argv[])
+{
+	for (const auto *partition : client.GetInstance().partitions)
+		client_printf(client, "partition: %s\n",
+			      partition->name.c_str());
+
+	return CommandResult::OK;
+}
+
+gcc_pure
+static bool
+IsValidPartitionChar(char ch)
+{
+	return IsAlphaNumericASCII(ch) || ch == '-' || ch == '_';
+}
+
+gcc_pure
+static bool
+IsValidPartitionName(const char *name)
+{
+	do {
+		if (!IsValidPartitionChar(*name))
+			return false;
+	} while (*++name != 0);
+
+	return true;
+}
+
+CommandResult
+handle_newpartition(Client &client, gcc_unused unsigned argc, char *argv[])
+{
+	assert(argc == 2);
+
+	const char *name = argv[1];
+	if (!IsValidPartitionName(name)) {
+		command_error(client, ACK_ERROR_ARG,
+			      "bad partition name");
+		return CommandResult::ERROR;
+	}
+
+	Instance &instance = client.GetInstance();
+	if (instance.FindPartition(name) != nullptr) {
+		command_error(client, ACK_ERROR_EXIST,
+			      "name already exists");
+		return CommandResult::ERROR;
+	}
+
+	Partition &partition = instance.CreatePartition(name);
+	StartPlayerThread(partition.pc);
+	partition.pc.UpdateAudio();
+
+	return CommandResult::OK;
+}
@@ -35,6 +35,7 @@
 #include "db/update/Service.hxx"
 #endif
 
+#define COMMAND_STATUS_PARTITION        "partition"
 #define COMMAND_STATUS_STATE            "state"
 #define COMMAND_STATUS_REPEAT           "repeat"
 #define COMMAND_STATUS_SINGLE           "single"
@@ -54,6 +55,8 @@
 #define COMMAND_STATUS_MIXRAMPDELAY	"mixrampdelay"
 #define COMMAND_STATUS_AUDIO		"audio"
 #define COMMAND_STATUS_UPDATING_DB	"updating_db"
+#define COMMAND_STATUS_UPDATE_QUEUE	"update_queue"
+#define COMMAND_STATUS_UPDATE_ETA	"update_eta"
 
 CommandResult
 handle_play(Client &client, unsigned argc, char *argv[])
@@ -62,7 +65,7 @@ handle_play(Client &client, unsigned argc, char *argv[])
 
 	if (argc == 2 && !check_int(client, &song, argv[1]))
 		return CommandResult::ERROR;
-	PlaylistResult result = client.partition.PlayPosition(song);
+	PlaylistResult result = client.GetPartition().PlayPosition(song);
 	return print_playlist_result(client, result);
 }
 
@@ -74,7 +77,7 @@ handle_playid(Client &client, unsigned argc, char *argv[])
 	if (argc == 2 && !check_int(client, &id, argv[1]))
 		return CommandResult::ERROR;
 
-	PlaylistResult result = client.partition.PlayId(id);
+	PlaylistResult result = client.GetPartition().PlayId(id);
 	return print_playlist_result(client, result);
 }
 
@@ -82,7 +85,7 @@ CommandResult
 handle_stop(Client &client,
 	    gcc_unused unsigned argc, gcc_unused char *argv[])
 {
-	client.partition.Stop();
+	client.GetPartition().Stop();
 	return CommandResult::OK;
 }
 
@@ -90,7 +93,7 @@ CommandResult
 handle_currentsong(Client &client,
 		   gcc_unused unsigned argc, gcc_unused char *argv[])
 {
-	playlist_print_current(client, client.playlist);
+	playlist_print_current(client, client.GetPlaylist());
 	return CommandResult::OK;
 }
 
@@ -103,9 +106,9 @@ handle_pause(Client &client,
 		if (!check_bool(client, &pause_flag, argv[1]))
 			return CommandResult::ERROR;
 
-		client.player_control.SetPause(pause_flag);
+		client.GetPlayerControl().SetPause(pause_flag);
 	} else
-		client.player_control.Pause();
+		client.GetPlayerControl().Pause();
 
 	return CommandResult::OK;
 }
@@ -117,7 +120,7 @@ handle_status(Client &client,
 	const char *state = nullptr;
 	int song;
 
-	const auto player_status = client.player_control.GetStatus();
+	const auto player_status = client.GetPlayerControl().GetStatus();
 
 	switch (player_status.state) {
 	case PlayerState::STOP:
@@ -131,8 +134,9 @@ handle_status(Client &client,
 		break;
 	}
 
-	const playlist &playlist = client.playlist;
+	const playlist &playlist = client.GetPlaylist();
 	client_printf(client,
+		      COMMAND_STATUS_PARTITION ": %s\n"
 		      "volume: %i\n"
 		      COMMAND_STATUS_REPEAT ": %i\n"
 		      COMMAND_STATUS_RANDOM ": %i\n"
@@ -142,25 +146,26 @@ handle_status(Client &client,
 		      COMMAND_STATUS_PLAYLIST_LENGTH ": %i\n"
 		      COMMAND_STATUS_MIXRAMPDB ": %f\n"
 		      COMMAND_STATUS_STATE ": %s\n",
-		      volume_level_get(client.partition.outputs),
+		      client.GetPartition().name.c_str(),
+		      volume_level_get(client.GetPartition().outputs),
 		      playlist.GetRepeat(),
 		      playlist.GetRandom(),
 		      playlist.GetSingle(),
 		      playlist.GetConsume(),
 		      (unsigned long)playlist.GetVersion(),
 		      playlist.GetLength(),
-		      client.player_control.GetMixRampDb(),
+		      client.GetPlayerControl().GetMixRampDb(),
 		      state);
 
-	if (client.player_control.GetCrossFade() > 0)
+	if (client.GetPlayerControl().GetCrossFade() > 0)
 		client_printf(client,
 			      COMMAND_STATUS_CROSSFADE ": %i\n",
-			      int(client.player_control.GetCrossFade() + 0.5));
+			      int(client.GetPlayerControl().GetCrossFade() + 0.5));
 
-	if (client.player_control.GetMixRampDelay() > 0)
+	if (client.GetPlayerControl().GetMixRampDelay() > 0)
 		client_printf(client,
 			      COMMAND_STATUS_MIXRAMPDELAY ": %f\n",
-			      client.player_control.GetMixRampDelay());
+			      client.GetPlayerControl().GetMixRampDelay());
 
 	song = playlist.GetCurrentPosition();
 	if (song >= 0) {
@@ -191,7 +196,7 @@ handle_status(Client &client,
 	}
 
 #ifdef ENABLE_DATABASE
-	const UpdateService *update_service = client.partition.instance.update;
+	const UpdateService *update_service = client.GetInstance().update;
 	unsigned updateJobId = update_service != nullptr
 		? update_service->GetId()
 		: 0;
@@ -199,10 +204,22 @@ handle_status(Client &client,
 		client_printf(client,
 			      COMMAND_STATUS_UPDATING_DB ": %i\n",
 			      updateJobId);
+
+		const unsigned queue_size = update_service->GetQueueSize();
+		if (queue_size > 0)
+			client_printf(client,
+				      COMMAND_STATUS_UPDATE_QUEUE ": %u\n",
+				      queue_size);
+
+		const unsigned eta = update_service->GetEta();
+		if (eta > 0)
+			client_printf(client,
+				      COMMAND_STATUS_UPDATE_ETA ": %u\n",
+				      eta);
 	}
 #endif
 
-	Error error = client.player_control.LockGetError();
+	Error error = client.GetPlayerControl().LockGetError();
 	if (error.IsDefined())
 		client_printf(client,
 			      COMMAND_STATUS_ERROR ": %s\n",
@@ -223,14 +240,14 @@ CommandResult
 handle_next(Client &client,
 	    gcc_unused unsigned argc, gcc_unused char *argv[])
 {
-	playlist &playlist = client.playlist;
+	playlist &playlist = client.GetPlaylist();
 
 	/* single mode is not considered when this is user who
 	 * wants to change song. */
 	const bool single = playlist.queue.single;
 	playlist.queue.single = false;
 
-	client.partition.PlayNext();
+	client.GetPartition().PlayNext();
 
 	playlist.queue.single = single;
 	return CommandResult::OK;
@@ -240,7 +257,7 @@ CommandResult
 handle_previous(Client &client,
 		gcc_unused unsigned argc, gcc_unused char *argv[])
 {
-	client.partition.PlayPrevious();
+	client.GetPartition().PlayPrevious();
 	return CommandResult::OK;
 }
 
@@ -251,7 +268,7 @@ handle_repeat(Client &client, gcc_unused unsigned argc, char *argv[])
 	if (!check_bool(client, &status, argv[1]))
 		return CommandResult::ERROR;
 
-	client.partition.SetRepeat(status);
+	client.GetPartition().SetRepeat(status);
 	return CommandResult::OK;
 }
 
@@ -262,7 +279,7 @@ handle_single(Client &client, gcc_unused unsigned argc, char *argv[])
 	if (!check_bool(client, &status, argv[1]))
 		return CommandResult::ERROR;
 
-	client.partition.SetSingle(status);
+	client.GetPartition().SetSingle(status);
 	return CommandResult::OK;
 }
 
@@ -273,7 +290,7 @@ handle_consume(Client &client, gcc_unused unsigned argc, char *argv[])
 	if (!check_bool(client, &status, argv[1]))
 		return CommandResult::ERROR;
 
-	client.partition.SetConsume(status);
+	client.GetPartition().SetConsume(status);
 	return CommandResult::OK;
 }
 
@@ -284,8 +301,8 @@ handle_random(Client &client, gcc_unused unsigned argc, char *argv[])
 	if (!check_bool(client, &status, argv[1]))
 		return CommandResult::ERROR;
 
-	client.partition.SetRandom(status);
-	client.partition.outputs.SetReplayGainMode(replay_gain_get_real_mode(client.partition.GetRandom()));
+	client.GetPartition().SetRandom(status);
+	client.GetPartition().outputs.SetReplayGainMode(replay_gain_get_real_mode(client.GetPartition().GetRandom()));
 	return CommandResult::OK;
 }
 
@@ -293,7 +310,7 @@ CommandResult
 handle_clearerror(gcc_unused Client &client,
 		  gcc_unused unsigned argc, gcc_unused char *argv[])
 {
-	client.player_control.ClearError();
+	client.GetPlayerControl().ClearError();
 	return CommandResult::OK;
 }
 
@@ -308,7 +325,7 @@ handle_seek(Client &client, gcc_unused unsigned argc, char *argv[])
 		return CommandResult::ERROR;
 
 	PlaylistResult result =
-		client.partition.SeekSongPosition(song, seek_time);
+		client.GetPartition().SeekSongPosition(song, seek_time);
 	return print_playlist_result(client, result);
 }
 
@@ -323,7 +340,7 @@ handle_seekid(Client &client, gcc_unused unsigned argc, char *argv[])
 		return CommandResult::ERROR;
 
 	PlaylistResult result =
-		client.partition.SeekSongId(id, seek_time);
+		client.GetPartition().SeekSongId(id, seek_time);
 	return print_playlist_result(client, result);
 }
 
@@ -337,7 +354,7 @@ handle_seekcur(Client &client, gcc_unused unsigned argc, char *argv[])
 		return CommandResult::ERROR;
 
 	PlaylistResult result =
-		client.partition.SeekCurrent(seek_time, relative);
+		client.GetPartition().SeekCurrent(seek_time, relative);
 	return print_playlist_result(client, result);
 }
 
@@ -348,7 +365,7 @@ handle_crossfade(Client &client, gcc_unused unsigned argc, char *argv[])
 
 	if (!check_unsigned(client, &xfade_time, argv[1]))
 		return CommandResult::ERROR;
-	client.player_control.SetCrossFade(xfade_time);
+	client.GetPlayerControl().SetCrossFade(xfade_time);
 
 	return CommandResult::OK;
 }
@@ -360,7 +377,7 @@ handle_mixrampdb(Client &client, gcc_unused unsigned argc, char *argv[])
 
 	if (!check_float(client, &db, argv[1]))
 		return CommandResult::ERROR;
-	client.player_control.SetMixRampDb(db);
+	client.GetPlayerControl().SetMixRampDb(db);
 
 	return CommandResult::OK;
 }
@@ -372,7 +389,7 @@ handle_mixrampdelay(Client &client, gcc_unused unsigned argc, char *argv[])
 
 	if (!check_float(client, &delay_secs, argv[1]))
 		return CommandResult::ERROR;
-	client.player_control.SetMixRampDelay(delay_secs);
+	client.GetPlayerControl().SetMixRampDelay(delay_secs);
 
 	return CommandResult::OK;
 }
@@ -387,7 +404,7 @@ handle_replay_gain_mode(Client &client,
 		return CommandResult::ERROR;
 	}
 
-	client.partition.outputs.SetReplayGainMode(replay_gain_get_real_mode(client.playlist.queue.random));
+	client.GetPartition().outputs.SetReplayGainMode(replay_gain_get_real_mode(client.GetPlaylist().queue.random));
 	return CommandResult::OK;
 }
 
@@ -52,7 +52,7 @@ print_spl_list(Client &client, const PlaylistVector &list)
 CommandResult
 handle_save(Client &client, gcc_unused unsigned argc, char *argv[])
 {
-	PlaylistResult result = spl_save_playlist(argv[1], client.playlist);
+	PlaylistResult result = spl_save_playlist(argv[1], client.GetPlaylist());
 	return print_playlist_result(client, result);
 }
 
@@ -67,14 +67,14 @@ handle_load(Client &client, unsigned argc, char *argv[])
 	} else if (!check_range(client, &start_index, &end_index, argv[2]))
 		return CommandResult::ERROR;
 
-	const ScopeBulkEdit bulk_edit(client.partition);
+	const ScopeBulkEdit bulk_edit(client.GetPartition());
 
 	Error error;
 	const SongLoader loader(client);
 	if (!playlist_open_into_queue(argv[1],
 				      start_index, end_index,
-				      client.playlist,
-				      client.player_control, loader, error))
+				      client.GetPlaylist(),
+				      client.GetPlayerControl(), loader, error))
 		return print_error(client, error);
 
 	return CommandResult::OK;
@@ -58,17 +58,17 @@ translate_uri(Client &client, const char *uri)
 	return uri;
 }
 
-CommandResult
-handle_add(Client &client, gcc_unused unsigned argc, char *argv[])
+static CommandResult
+AddURI(Client &client, const char *uri)
 {
-	const char *const uri = translate_uri(client, argv[1]);
+	uri = translate_uri(client, uri);
 	if (uri == nullptr)
 		return CommandResult::ERROR;
 
 	if (uri_has_scheme(uri) || PathTraitsUTF8::IsAbsolute(uri)) {
 		const SongLoader loader(client);
 		Error error;
-		unsigned id = client.partition.AppendURI(loader, uri, error);
+		unsigned id = client.GetPartition().AppendURI(loader, uri, error);
 		if (id == 0)
 			return print_error(client, error);
 
@@ -76,11 +76,9 @@ handle_add(Client &client, gcc_unused unsigned argc, char *argv[])
 	}
 
 #ifdef ENABLE_DATABASE
-	const ScopeBulkEdit bulk_edit(client.partition);
-
 	const DatabaseSelection selection(uri, true);
 	Error error;
-	return AddFromDatabase(client.partition, selection, error)
+	return AddFromDatabase(client.GetPartition(), selection, error)
 		? CommandResult::OK
 		: print_error(client, error);
 #else
@@ -89,6 +87,22 @@ handle_add(Client &client, gcc_unused unsigned argc, char *argv[])
 #endif
 }
 
+CommandResult
+handle_add(Client &client, unsigned argc, char *argv[])
+{
+	const ScopeBulkEdit bulk_edit(client.GetPartition());
+
+	/* stop at the first error; the songs added so far remain in
+	   the queue, just like with a command list */
+	for (unsigned i = 1; i < argc; ++i) {
+		CommandResult result = AddURI(client, argv[i]);
+		if (result != CommandResult::OK)
+			return result;
+	}
+
+	return CommandResult::OK;
+}
+
 CommandResult
 handle_addid(Client &client, unsigned argc, char *argv[])
 {
@@ -98,7 +112,7 @@ handle_addid(Client &client, unsigned argc, char *argv[])
 
 	const SongLoader loader(client);
 	Error error;
-	unsigned added_id = client.partition.AppendURI(loader, uri, error);
+	unsigned added_id = client.GetPartition().AppendURI(loader, uri, error);
 	if (added_id == 0)
 		return print_error(client, error);
 
@@ -106,11 +120,11 @@ handle_addid(Client &client, unsigned argc, char *argv[])
 		unsigned to;
 		if (!check_unsigned(client, &to, argv[2]))
 			return CommandResult::ERROR;
-		PlaylistResult result = client.partition.MoveId(added_id, to);
+		PlaylistResult result = client.GetPartition().MoveId(added_id, to);
 		if (result != PlaylistResult::SUCCESS) {
 			CommandResult ret =
 				print_playlist_result(client, result);
-			client.partition.DeleteId(added_id);
+			client.GetPartition().DeleteId(added_id);
 			return ret;
 		}
 	}
@@ -164,7 +178,7 @@ handle_rangeid(Client &client, gcc_unused unsigned argc, char *argv[])
 	}
 
 	Error error;
-	if (!client.partition.playlist.SetSongIdRange(client.partition.pc,
+	if (!client.GetPartition().playlist.SetSongIdRange(client.GetPartition().pc,
 						      id, start_ms, end_ms,
 						      error))
 		return print_error(client, error);
@@ -180,7 +194,7 @@ handle_delete(Client &client, gcc_unused unsigned argc, char *argv[])
 	if (!check_range(client, &start, &end, argv[1]))
 		return CommandResult::ERROR;
 
-	PlaylistResult result = client.partition.DeleteRange(start, end);
+	PlaylistResult result = client.GetPartition().DeleteRange(start, end);
 	return print_playlist_result(client, result);
 }
 
@@ -192,7 +206,7 @@ handle_deleteid(Client &client, gcc_unused unsigned argc, char *argv[])
 	if (!check_unsigned(client, &id, argv[1]))
 		return CommandResult::ERROR;
 
-	PlaylistResult result = client.partition.DeleteId(id);
+	PlaylistResult result = client.GetPartition().DeleteId(id);
 	return print_playlist_result(client, result);
 }
 
@@ -200,7 +214,7 @@ CommandResult
 handle_playlist(Client &client,
 		gcc_unused unsigned argc, gcc_unused char *argv[])
 {
-	playlist_print_uris(client, client.playlist);
+	playlist_print_uris(client, client.GetPlaylist());
 	return CommandResult::OK;
 }
 
@@ -208,11 +222,11 @@ CommandResult
 handle_shuffle(gcc_unused Client &client,
 	       gcc_unused unsigned argc, gcc_unused char *argv[])
 {
-	unsigned start = 0, end = client.playlist.queue.GetLength();
+	unsigned start = 0, end = client.GetPlaylist().queue.GetLength();
 	if (argc == 2 && !check_range(client, &start, &end, argv[1]))
 		return CommandResult::ERROR;
 
-	client.partition.Shuffle(start, end);
+	client.GetPartition().Shuffle(start, end);
 	return CommandResult::OK;
 }
 
@@ -220,7 +234,7 @@ CommandResult
 handle_clear(gcc_unused Client &client,
 	     gcc_unused unsigned argc, gcc_unused char *argv[])
 {
-	client.partition.ClearQueue();
+	client.GetPartition().ClearQueue();
 	return CommandResult::OK;
 }
 
@@ -232,7 +246,7 @@ handle_plchanges(Client &client, gcc_unused unsigned argc, char *argv[])
 	if (!check_uint32(client, &version, argv[1]))
 		return CommandResult::ERROR;
 
-	playlist_print_changes_info(client, client.playlist, version);
+	playlist_print_changes_info(client, client.GetPlaylist(), version);
 	return CommandResult::OK;
 }
 
@@ -244,7 +258,7 @@ handle_plchangesposid(Client &client, gcc_unused unsigned argc, char *argv[])
 	if (!check_uint32(client, &version, argv[1]))
 		return CommandResult::ERROR;
 
-	playlist_print_changes_position(client, client.playlist, version);
+	playlist_print_changes_position(client, client.GetPlaylist(), version);
 	return CommandResult::OK;
 }
 
@@ -257,7 +271,7 @@ handle_playlistinfo(Client &client, unsigned argc, char *argv[])
 	if (argc == 2 && !check_range(client, &start, &end, argv[1]))
 		return CommandResult::ERROR;
 
-	ret = playlist_print_info(client, client.playlist, start, end);
+	ret = playlist_print_info(client, client.GetPlaylist(), start, end);
 	if (!ret)
 		return print_playlist_result(client,
 					     PlaylistResult::BAD_RANGE);
@@ -273,12 +287,12 @@ handle_playlistid(Client &client, unsigned argc, char *argv[])
 		if (!check_unsigned(client, &id, argv[1]))
 			return CommandResult::ERROR;
 
-		bool ret = playlist_print_id(client, client.playlist, id);
+		bool ret = playlist_print_id(client, client.GetPlaylist(), id);
 		if (!ret)
 			return print_playlist_result(client,
 						     PlaylistResult::NO_SUCH_SONG);
 	} else {
-		playlist_print_info(client, client.playlist,
+		playlist_print_info(client, client.GetPlaylist(),
 				    0, std::numeric_limits<unsigned>::max());
 	}
 
@@ -297,7 +311,7 @@ handle_playlist_match(Client &client, unsigned argc, char *argv[],
 		return CommandResult::ERROR;
 	}
 
-	playlist_print_find(client, client.playlist, filter);
+	playlist_print_find(client, client.GetPlaylist(), filter);
 	return CommandResult::OK;
 }
 
@@ -334,7 +348,7 @@ handle_prio(Client &client, unsigned argc, char *argv[])
 			return CommandResult::ERROR;
 
 		PlaylistResult result =
-			client.partition.SetPriorityRange(start_position,
+			client.GetPartition().SetPriorityRange(start_position,
 							   end_position,
 							   priority);
 		if (result != PlaylistResult::SUCCESS)
@@ -364,7 +378,7 @@ handle_prioid(Client &client, unsigned argc, char *argv[])
 			return CommandResult::ERROR;
 
 		PlaylistResult result =
-			client.partition.SetPriorityId(song_id, priority);
+			client.GetPartition().SetPriorityId(song_id, priority);
 		if (result != PlaylistResult::SUCCESS)
 			return print_playlist_result(client, result);
 	}
@@ -384,7 +398,7 @@ handle_move(Client &client, gcc_unused unsigned argc, char *argv[])
 		return CommandResult::ERROR;
 
 	PlaylistResult result =
-		client.partition.MoveRange(start, end, to);
+		client.GetPartition().MoveRange(start, end, to);
 	return print_playlist_result(client, result);
 }
 
@@ -398,7 +412,7 @@ handle_moveid(Client &client, gcc_unused unsigned argc, char *argv[])
 		return CommandResult::ERROR;
 	if (!check_int(client, &to, argv[2]))
 		return CommandResult::ERROR;
-	PlaylistResult result = client.partition.MoveId(id, to);
+	PlaylistResult result = client.GetPartition().MoveId(id, to);
 	return print_playlist_result(client, result);
 }
 
@@ -413,7 +427,7 @@ handle_swap(Client &client, gcc_unused unsigned argc, char *argv[])
 		return CommandResult::ERROR;
 
 	PlaylistResult result =
-		client.partition.SwapPositions(song1, song2);
+		client.GetPartition().SwapPositions(song1, song2);
 	return print_playlist_result(client, result);
 }
 
@@ -427,6 +441,6 @@ handle_swapid(Client &client, gcc_unused unsigned argc, char *argv[])
 	if (!check_unsigned(client, &id2, argv[2]))
 		return CommandResult::ERROR;
 
-	PlaylistResult result = client.partition.SwapIds(id1, id2);
+	PlaylistResult result = client.GetPartition().SwapIds(id1, id2);
 	return print_playlist_result(client, result);
 }
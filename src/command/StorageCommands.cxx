@@ -34,6 +34,7 @@
 #include "storage/FileInfo.hxx"
 #include "db/plugins/simple/SimpleDatabasePlugin.hxx"
 #include "db/update/Service.hxx"
+#include "db/QueryCache.hxx"
 #include "TimePrint.hxx"
 #include "Idle.hxx"
 
@@ -168,7 +169,7 @@ print_storage_uri(Client &client, const Storage &storage)
 CommandResult
 handle_listmounts(Client &client, gcc_unused unsigned argc, gcc_unused char *argv[])
 {
-	Storage *_composite = client.partition.instance.storage;
+	Storage *_composite = client.GetInstance().storage;
 	if (_composite == nullptr) {
 		command_error(client, ACK_ERROR_NO_EXIST, "No database");
 		return CommandResult::ERROR;
@@ -190,7 +191,7 @@ handle_listmounts(Client &client, gcc_unused unsigned argc, gcc_unused char *arg
 CommandResult
 handle_mount(Client &client, gcc_unused unsigned argc, char *argv[])
 {
-	Storage *_composite = client.partition.instance.storage;
+	Storage *_composite = client.GetInstance().storage;
 	if (_composite == nullptr) {
 		command_error(client, ACK_ERROR_NO_EXIST, "No database");
 		return CommandResult::ERROR;
@@ -231,7 +232,7 @@ handle_mount(Client &client, gcc_unused unsigned argc, char *argv[])
 	idle_add(IDLE_MOUNT);
 
 #ifdef ENABLE_DATABASE
-	Database *_db = client.partition.instance.database;
+	Database *_db = client.GetInstance().database;
 	if (_db != nullptr && _db->IsPlugin(simple_db_plugin)) {
 		SimpleDatabase &db = *(SimpleDatabase *)_db;
 
@@ -242,6 +243,8 @@ handle_mount(Client &client, gcc_unused unsigned argc, char *argv[])
 
 		// TODO: call Instance::OnDatabaseModified()?
 		// TODO: trigger database update?
+		if (client.GetInstance().query_cache != nullptr)
+			client.GetInstance().query_cache->Clear();
 		idle_add(IDLE_DATABASE);
 	}
 #endif
@@ -252,7 +255,7 @@ handle_mount(Client &client, gcc_unused unsigned argc, char *argv[])
 CommandResult
 handle_unmount(Client &client, gcc_unused unsigned argc, char *argv[])
 {
-	Storage *_composite = client.partition.instance.storage;
+	Storage *_composite = client.GetInstance().storage;
 	if (_composite == nullptr) {
 		command_error(client, ACK_ERROR_NO_EXIST, "No database");
 		return CommandResult::ERROR;
@@ -268,19 +271,22 @@ handle_unmount(Client &client, gcc_unused unsigned argc, char *argv[])
 	}
 
 #ifdef ENABLE_DATABASE
-	if (client.partition.instance.update != nullptr)
+	if (client.GetInstance().update != nullptr)
 		/* ensure that no database update will attempt to work
 		   with the database/storage instances we're about to
 		   destroy here */
-		client.partition.instance.update->CancelMount(local_uri);
+		client.GetInstance().update->CancelMount(local_uri);
 
-	Database *_db = client.partition.instance.database;
+	Database *_db = client.GetInstance().database;
 	if (_db != nullptr && _db->IsPlugin(simple_db_plugin)) {
 		SimpleDatabase &db = *(SimpleDatabase *)_db;
 
-		if (db.Unmount(local_uri))
+		if (db.Unmount(local_uri)) {
 			// TODO: call Instance::OnDatabaseModified()?
+			if (client.GetInstance().query_cache != nullptr)
+				client.GetInstance().query_cache->Clear();
 			idle_add(IDLE_DATABASE);
+		}
 	}
 #endif
 
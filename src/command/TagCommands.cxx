@@ -44,7 +44,7 @@ handle_addtagid(Client &client, gcc_unused unsigned argc, char *argv[])
 	const char *const value = argv[3];
 
 	Error error;
-	if (!client.partition.playlist.AddSongIdTag(song_id, tag_type, value,
+	if (!client.GetPartition().playlist.AddSongIdTag(song_id, tag_type, value,
 						    error))
 		return print_error(client, error);
 
@@ -70,7 +70,7 @@ handle_cleartagid(Client &client, unsigned argc, char *argv[])
 	}
 
 	Error error;
-	if (!client.partition.playlist.ClearSongIdTag(song_id, tag_type,
+	if (!client.GetPartition().playlist.ClearSongIdTag(song_id, tag_type,
 						      error))
 		return print_error(client, error);
 
@@ -30,14 +30,24 @@
 #include "system/FatalError.hxx"
 #include "Log.hxx"
 
+#include <set>
+
 #include <stdlib.h>
 
 static ConfigData config_data;
 
+/**
+ * Blocks which are excluded from config_global_check(), see
+ * config_defer_block().
+ */
+static std::set<const config_param *> deferred_blocks;
+
 void config_global_finish(void)
 {
 	for (auto i : config_data.params)
 		delete i;
+
+	deferred_blocks.clear();
 }
 
 void config_global_init(void)
@@ -50,6 +60,17 @@ ReadConfigFile(Path path, Error &error)
 	return ReadConfigFile(config_data, path, error);
 }
 
+void
+config_check_block(const config_param &param)
+{
+	for (const auto &i : param.block_params) {
+		if (!i.used)
+			FormatWarning(config_domain,
+				      "option '%s' on line %i was not recognized",
+				      i.name.c_str(), i.line);
+	}
+}
+
 static void
 Check(const config_param *param)
 {
@@ -59,12 +80,17 @@ Check(const config_param *param)
 		   Silently ignore it here. */
 		return;
 
-	for (const auto &i : param->block_params) {
-		if (!i.used)
-			FormatWarning(config_domain,
-				      "option '%s' on line %i was not recognized",
-				      i.name.c_str(), i.line);
-	}
+	if (deferred_blocks.find(param) != deferred_blocks.end())
+		/* will be checked by config_check_block() later */
+		return;
+
+	config_check_block(*param);
+}
+
+void
+config_defer_block(const config_param &param)
+{
+	deferred_blocks.insert(&param);
 }
 
 void config_global_check(void)
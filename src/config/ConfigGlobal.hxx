@@ -37,6 +37,22 @@ void config_global_finish(void);
  */
 void config_global_check(void);
 
+/**
+ * Exclude the specified block from config_global_check(), because it
+ * will be evaluated later.  The caller shall invoke
+ * config_check_block() after that.  Must be called before
+ * config_global_check().
+ */
+void
+config_defer_block(const config_param &param);
+
+/**
+ * Log warnings about options in the specified block which have not
+ * been queried.
+ */
+void
+config_check_block(const config_param &param);
+
 bool
 ReadConfigFile(Path path, Error &error);
 
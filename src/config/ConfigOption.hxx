@@ -29,6 +29,7 @@ enum ConfigOption {
 	CONF_FOLLOW_OUTSIDE_SYMLINKS,
 	CONF_DB_FILE,
 	CONF_STICKER_FILE,
+	CONF_SEEK_INDEX_FILE,
 	CONF_LOG_FILE,
 	CONF_PID_FILE,
 	CONF_STATE_FILE,
@@ -50,9 +51,14 @@ enum ConfigOption {
 	CONF_REPLAYGAIN_PREAMP,
 	CONF_REPLAYGAIN_MISSING_PREAMP,
 	CONF_REPLAYGAIN_LIMIT,
+	CONF_REPLAYGAIN_ANALYSIS,
+	CONF_UPDATE_THREADS,
+	CONF_UPDATE_TRUST_MTIME,
 	CONF_VOLUME_NORMALIZATION,
 	CONF_SAMPLERATE_CONVERTER,
 	CONF_AUDIO_BUFFER_SIZE,
+	CONF_AUDIO_BUFFER_CHUNK_SIZE,
+	CONF_AUDIO_BUFFER_ADAPTIVE,
 	CONF_BUFFER_BEFORE_PLAY,
 	CONF_HTTP_PROXY_HOST,
 	CONF_HTTP_PROXY_PORT,
@@ -63,22 +69,34 @@ enum ConfigOption {
 	CONF_MAX_PLAYLIST_LENGTH,
 	CONF_MAX_COMMAND_LIST_SIZE,
 	CONF_MAX_OUTPUT_BUFFER_SIZE,
+	CONF_CLIENT_WORKER_THREADS,
+	CONF_IO_THREADS,
 	CONF_FS_CHARSET,
 	CONF_ID3V1_ENCODING,
 	CONF_METADATA_TO_USE,
 	CONF_SAVE_ABSOLUTE_PATHS,
 	CONF_DECODER,
 	CONF_INPUT,
+	CONF_INPUT_CACHE_DIR,
+	CONF_INPUT_CACHE_SIZE,
+	CONF_ART_CACHE_DIR,
+	CONF_ART_CACHE_SIZE,
 	CONF_GAPLESS_MP3_PLAYBACK,
+	CONF_DECODER_PREFETCH,
 	CONF_PLAYLIST_PLUGIN,
 	CONF_AUTO_UPDATE,
 	CONF_AUTO_UPDATE_DEPTH,
+	CONF_AUTO_UPDATE_FANOTIFY,
 	CONF_DESPOTIFY_USER,
 	CONF_DESPOTIFY_PASSWORD,
 	CONF_DESPOTIFY_HIGH_BITRATE,
 	CONF_AUDIO_FILTER,
 	CONF_DATABASE,
+	CONF_QUERY_CACHE_SIZE,
+	CONF_SONG_PRINT_CACHE_SIZE,
 	CONF_NEIGHBORS,
+	CONF_THREAD,
+	CONF_SEEK_BUFFER_TIME,
 	CONF_MAX
 };
 
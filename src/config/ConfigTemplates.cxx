@@ -29,6 +29,7 @@ const ConfigTemplate config_templates[] = {
 	{ "follow_outside_symlinks", false, false },
 	{ "db_file", false, false },
 	{ "sticker_file", false, false },
+	{ "seek_index_file", false, false },
 	{ "log_file", false, false },
 	{ "pid_file", false, false },
 	{ "state_file", false, false },
@@ -50,9 +51,14 @@ const ConfigTemplate config_templates[] = {
 	{ "replaygain_preamp", false, false },
 	{ "replaygain_missing_preamp", false, false },
 	{ "replaygain_limit", false, false },
+	{ "replaygain_analysis", false, false },
+	{ "update_threads", false, false },
+	{ "update_trust_mtime", false, false },
 	{ "volume_normalization", false, false },
 	{ "samplerate_converter", false, false },
 	{ "audio_buffer_size", false, false },
+	{ "audio_buffer_chunk_size", false, false },
+	{ "audio_buffer_adaptive", false, false },
 	{ "buffer_before_play", false, false },
 	{ "http_proxy_host", false, false },
 	{ "http_proxy_port", false, false },
@@ -63,22 +69,34 @@ const ConfigTemplate config_templates[] = {
 	{ "max_playlist_length", false, false },
 	{ "max_command_list_size", false, false },
 	{ "max_output_buffer_size", false, false },
+	{ "client_worker_threads", false, false },
+	{ "io_threads", false, false },
 	{ "filesystem_charset", false, false },
 	{ "id3v1_encoding", false, false },
 	{ "metadata_to_use", false, false },
 	{ "save_absolute_paths_in_playlists", false, false },
 	{ "decoder", true, true },
 	{ "input", true, true },
+	{ "input_cache_directory", false, false },
+	{ "input_cache_size", false, false },
+	{ "art_cache_directory", false, false },
+	{ "art_cache_size", false, false },
 	{ "gapless_mp3_playback", false, false },
+	{ "decoder_prefetch", false, false },
 	{ "playlist_plugin", true, true },
 	{ "auto_update", false, false },
 	{ "auto_update_depth", false, false },
+	{ "auto_update_fanotify", false, false },
 	{ "despotify_user", false, false },
 	{ "despotify_password", false, false},
 	{ "despotify_high_bitrate", false, false },
 	{ "filter", true, true },
 	{ "database", false, true },
+	{ "query_cache_size", false, false },
+	{ "song_print_cache_size", false, false },
 	{ "neighbors", true, true },
+	{ "thread", true, true },
+	{ "seek_buffer_time", false, false },
 };
 
 static constexpr unsigned n_config_templates =
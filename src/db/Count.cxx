@@ -21,6 +21,8 @@
 #include "Count.hxx"
 #include "Selection.hxx"
 #include "Interface.hxx"
+#include "Stats.hxx"
+#include "plugins/simple/SimpleDatabasePlugin.hxx"
 #include "client/Client.hxx"
 #include "LightSong.hxx"
 #include "tag/Set.hxx"
@@ -114,7 +116,22 @@ PrintSongCount(Client &client, const char *name,
 
 	const DatabaseSelection selection(name, true, filter);
 
-	if (group == TAG_NUM_OF_ITEM_TYPES) {
+	if (group == TAG_NUM_OF_ITEM_TYPES &&
+	    !selection.HasOtherThanBase() &&
+	    db->IsPlugin(simple_db_plugin)) {
+		/* the whole directory: the simple database caches
+		   this; other plugins ignore the selection in
+		   GetStats() */
+
+		DatabaseStats stats;
+		if (!db->GetStats(selection, stats, error))
+			return false;
+
+		client_printf(client,
+			      "songs: %u\n"
+			      "playtime: %lu\n",
+			      stats.song_count, stats.total_duration);
+	} else if (group == TAG_NUM_OF_ITEM_TYPES) {
 		/* no grouping */
 
 		SearchStats stats;
@@ -41,6 +41,15 @@ public:
 	 * the database because the file has disappeared.
 	 */
 	virtual void OnDatabaseSongRemoved(const LightSong &song) = 0;
+
+	/**
+	 * During database update, a song file has been found at a
+	 * new location (e.g. because its directory was renamed).
+	 * This is called before the old song is removed with
+	 * OnDatabaseSongRemoved().
+	 */
+	virtual void OnDatabaseSongMoved(const char *old_uri,
+					 const char *new_uri) = 0;
 };
 
 #endif
@@ -20,8 +20,10 @@
 #include "config.h"
 #include "DatabaseLock.hxx"
 
-Mutex db_mutex;
+SharedMutex db_mutex("db");
 
 #ifndef NDEBUG
 ThreadId db_mutex_holder;
+__thread bool db_mutex_reader;
+__thread bool db_mutex_delegate;
 #endif
@@ -27,12 +27,19 @@
 #define MPD_DB_LOCK_HXX
 
 #include "check.h"
-#include "thread/Mutex.hxx"
+#include "thread/SharedMutex.hxx"
 #include "Compiler.h"
 
 #include <assert.h>
 
-extern Mutex db_mutex;
+/**
+ * The global database lock.  Threads which only read the
+ * #Directory tree lock it in shared mode (db_lock_shared()), so
+ * client requests and the lookups of the update thread do not
+ * block each other; modifications need exclusive access
+ * (db_lock()).
+ */
+extern SharedMutex db_mutex;
 
 #ifndef NDEBUG
 
@@ -41,20 +48,44 @@ extern Mutex db_mutex;
 extern ThreadId db_mutex_holder;
 
 /**
- * Does the current thread hold the database lock?
+ * Set while the current thread holds the lock in shared mode.
+ */
+extern __thread bool db_mutex_reader;
+
+/**
+ * Set in a thread which builds a private #Directory tree on behalf
+ * of the #db_mutex holder, while that one waits for it (see
+ * db_load_internal()).
+ */
+extern __thread bool db_mutex_delegate;
+
+/**
+ * Does the current thread hold the database lock (in any mode)?
  */
 gcc_pure
 static inline bool
 holding_db_lock(void)
 {
-	return db_mutex_holder.IsInside();
+	return db_mutex_holder.IsInside() || db_mutex_reader ||
+		db_mutex_delegate;
+}
+
+/**
+ * Does the current thread hold the database lock in exclusive
+ * mode, i.e. may it modify the #Directory tree?
+ */
+gcc_pure
+static inline bool
+holding_db_write_lock(void)
+{
+	return db_mutex_holder.IsInside() || db_mutex_delegate;
 }
 
 #endif
 
 /**
- * Obtain the global database lock.  This is needed before
- * dereferencing a #song or #directory.  It is not recursive.
+ * Obtain the global database lock in exclusive mode.  This is needed
+ * before modifying a #song or #directory.  It is not recursive.
  */
 static inline void
 db_lock(void)
@@ -70,12 +101,12 @@ db_lock(void)
 }
 
 /**
- * Release the global database lock.
+ * Release the global database lock obtained with db_lock().
  */
 static inline void
 db_unlock(void)
 {
-	assert(holding_db_lock());
+	assert(db_mutex_holder.IsInside());
 #ifndef NDEBUG
 	db_mutex_holder = ThreadId::Null();
 #endif
@@ -83,6 +114,38 @@ db_unlock(void)
 	db_mutex.unlock();
 }
 
+/**
+ * Obtain the global database lock in shared mode.  This is enough
+ * for dereferencing a #song or #directory without modifying it.  It
+ * is not recursive.
+ */
+static inline void
+db_lock_shared(void)
+{
+	assert(!holding_db_lock());
+
+	db_mutex.lock_shared();
+
+	assert(db_mutex_holder.IsNull());
+#ifndef NDEBUG
+	db_mutex_reader = true;
+#endif
+}
+
+/**
+ * Release the global database lock obtained with db_lock_shared().
+ */
+static inline void
+db_unlock_shared(void)
+{
+	assert(db_mutex_reader);
+#ifndef NDEBUG
+	db_mutex_reader = false;
+#endif
+
+	db_mutex.unlock_shared();
+}
+
 class ScopeDatabaseLock {
 public:
 	ScopeDatabaseLock() {
@@ -94,4 +157,15 @@ public:
 	}
 };
 
+class ScopeDatabaseSharedLock {
+public:
+	ScopeDatabaseSharedLock() {
+		db_lock_shared();
+	}
+
+	~ScopeDatabaseSharedLock() {
+		db_unlock_shared();
+	}
+};
+
 #endif
@@ -30,8 +30,10 @@
 #include "PlaylistInfo.hxx"
 #include "Interface.hxx"
 #include "fs/Traits.hxx"
+#include "util/Error.hxx"
 
 #include <functional>
+#include <limits>
 
 static const char *
 ApplyBaseFlag(const char *uri, bool base)
@@ -145,27 +147,94 @@ PrintPlaylistFull(Client &client, bool base,
 	return true;
 }
 
+/**
+ * Counts the entries visited by db_selection_print() and decides
+ * which of them are inside the requested window.
+ */
+class PrintWindow {
+	unsigned position;
+	const unsigned start, end;
+
+public:
+	PrintWindow(unsigned _start, unsigned _end)
+		:position(0), start(_start), end(_end) {}
+
+	/**
+	 * Has the end of the window been reached?  The visit is
+	 * stopped then.
+	 */
+	bool IsDone() const {
+		return position >= end;
+	}
+
+	/**
+	 * Account for one entry.
+	 *
+	 * @return true if the entry is inside the window
+	 */
+	bool Next() {
+		return position++ >= start;
+	}
+};
+
 bool
 db_selection_print(Client &client, const DatabaseSelection &selection,
-		   bool full, bool base, Error &error)
+		   bool full, bool base,
+		   unsigned window_start, unsigned window_end,
+		   Error &error)
 {
 	const Database *db = client.GetDatabase(error);
 	if (db == nullptr)
 		return false;
 
 	using namespace std::placeholders;
-	const auto d = selection.filter == nullptr
+	VisitDirectory d = selection.filter == nullptr
 		? std::bind(full ? PrintDirectoryFull : PrintDirectoryBrief,
 			    std::ref(client), base, _1)
 		: VisitDirectory();
-	const auto s = std::bind(full ? PrintSongFull : PrintSongBrief,
-				 std::ref(client), base, _1);
-	const auto p = selection.filter == nullptr
+	VisitSong s = std::bind(full ? PrintSongFull : PrintSongBrief,
+				std::ref(client), base, _1);
+	VisitPlaylist p = selection.filter == nullptr
 		? std::bind(full ? PrintPlaylistFull : PrintPlaylistBrief,
 			    std::ref(client), base, _1, _2)
 		: VisitPlaylist();
 
-	return db->Visit(selection, d, s, p, error);
+	if (window_start == 0 &&
+	    window_end == std::numeric_limits<unsigned>::max())
+		return db->Visit(selection, d, s, p, error);
+
+	/* returning false without an error stops the visit after
+	   the last entry of the window */
+
+	PrintWindow window(window_start, window_end);
+
+	if (d)
+		d = [&window, d](const LightDirectory &directory,
+				 Error &error2){
+			if (directory.IsRoot())
+				/* not printed, not counted */
+				return d(directory, error2);
+
+			return !window.IsDone() &&
+				(!window.Next() || d(directory, error2));
+		};
+
+	s = [&window, s](const LightSong &song, Error &error2){
+		return !window.IsDone() &&
+			(!window.Next() || s(song, error2));
+	};
+
+	if (p)
+		p = [&window, p](const PlaylistInfo &playlist,
+				 const LightDirectory &directory,
+				 Error &error2){
+			return !window.IsDone() &&
+				(!window.Next() ||
+				 p(playlist, directory, error2));
+		};
+
+	return db->Visit(selection, d, s, p, error) ||
+		(window.IsDone() && !error.IsDefined());
 }
 
 static bool
@@ -22,6 +22,8 @@
 
 #include "Compiler.h"
 
+#include <limits>
+
 #include <stdint.h>
 
 class SongFilter;
@@ -32,10 +34,24 @@ class Error;
 /**
  * @param full print attributes/tags
  * @param base print only base name of songs/directories?
+ * @param window_start the number of entries to skip
+ * @param window_end stop after this entry (exclusive), e.g.
+ * std::numeric_limits<unsigned>::max() for no limit
  */
 bool
 db_selection_print(Client &client, const DatabaseSelection &selection,
-		   bool full, bool base, Error &error);
+		   bool full, bool base,
+		   unsigned window_start, unsigned window_end,
+		   Error &error);
+
+static inline bool
+db_selection_print(Client &client, const DatabaseSelection &selection,
+		   bool full, bool base, Error &error)
+{
+	return db_selection_print(client, selection, full, base,
+				  0, std::numeric_limits<unsigned>::max(),
+				  error);
+}
 
 bool
 PrintUniqueTags(Client &client, unsigned type, uint32_t group_mask,
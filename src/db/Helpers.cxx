@@ -37,12 +37,8 @@ struct StringLess {
 typedef std::set<const char *, StringLess> StringSet;
 
 static void
-StatsVisitTag(DatabaseStats &stats, StringSet &artists, StringSet &albums,
-	      const Tag &tag)
+StatsVisitTag(StringSet &artists, StringSet &albums, const Tag &tag)
 {
-	if (tag.time > 0)
-		stats.total_duration += tag.time;
-
 	for (const auto &item : tag) {
 		switch (item.type) {
 		case TAG_ARTIST:
@@ -72,8 +68,9 @@ StatsVisitSong(DatabaseStats &stats, StringSet &artists, StringSet &albums,
 	       const LightSong &song)
 {
 	++stats.song_count;
+	stats.total_duration += song.GetDuration();
 
-	StatsVisitTag(stats, artists, albums, *song.tag);
+	StatsVisitTag(artists, albums, *song.tag);
 
 	return true;
 }
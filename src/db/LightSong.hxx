@@ -27,6 +27,8 @@
 #include <time.h>
 
 struct Tag;
+struct ReplayGainInfo;
+class MixRampInfo;
 
 /**
  * A reference to a song file.  Unlike the other "Song" classes in the
@@ -61,6 +63,18 @@ struct LightSong {
 	 */
 	const Tag *tag;
 
+	/**
+	 * Replay gain values computed by the database (see
+	 * "replaygain_analysis"), or nullptr if there are none.
+	 */
+	const ReplayGainInfo *replay_gain;
+
+	/**
+	 * MixRamp envelopes computed by the database, or nullptr if
+	 * there are none.
+	 */
+	const MixRampInfo *mix_ramp;
+
 	time_t mtime;
 
 	/**
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "QueryCache.hxx"
+#include "SongFilter.hxx"
+
+#ifdef ENABLE_SQLITE
+#include "sticker/StickerCache.hxx"
+#endif
+
+#include <algorithm>
+#include <vector>
+
+#include <assert.h>
+#include <stdio.h>
+
+bool
+QueryCache::Get(const std::string &key, time_t stamp, std::string &response)
+{
+	const ScopeLock protect(mutex);
+
+	auto i = map.find(key);
+	if (i == map.end())
+		return false;
+
+	const List::iterator entry = i->second;
+	if (entry->stamp != stamp) {
+		/* stale */
+		size -= entry->response.length();
+		map.erase(i);
+		lru.erase(entry);
+		return false;
+	}
+
+	lru.splice(lru.begin(), lru, entry);
+	response = entry->response;
+	return true;
+}
+
+void
+QueryCache::Put(std::string &&key, time_t stamp, std::string &&response)
+{
+	if (response.length() > GetMaxResponseSize())
+		return;
+
+	const ScopeLock protect(mutex);
+
+	auto i = map.find(key);
+	if (i != map.end()) {
+		size -= i->second->response.length();
+		lru.erase(i->second);
+		map.erase(i);
+	}
+
+	/* evict the least recently used entries */
+	while (!lru.empty() && size + response.length() > max_size) {
+		Entry &last = lru.back();
+		size -= last.response.length();
+		map.erase(last.key);
+		lru.pop_back();
+	}
+
+	size += response.length();
+	lru.emplace_front(std::move(key), stamp, std::move(response));
+	map.insert(std::make_pair(lru.front().key, lru.begin()));
+}
+
+void
+QueryCache::Clear()
+{
+	const ScopeLock protect(mutex);
+
+	map.clear();
+	lru.clear();
+	size = 0;
+}
+
+std::string
+QueryCacheKey(const char *command, const std::string &parameters,
+	      const SongFilter *filter)
+{
+	std::string key(command);
+	key.push_back('\0');
+	key.append(parameters);
+	key.push_back('\0');
+
+	if (filter != nullptr) {
+		std::vector<std::string> items;
+		for (const auto &item : filter->GetItems()) {
+			char buffer[64];
+			snprintf(buffer, sizeof(buffer), "%u:%d:%lu:",
+				 item.GetTag(), item.GetFoldCase(),
+				 (unsigned long)item.GetTime());
+
+			items.emplace_back(buffer);
+			items.back().append(item.GetValue());
+
+#ifdef ENABLE_SQLITE
+			if (item.GetTag() == LOCATE_TAG_STICKER) {
+				/* the response depends on the sticker
+				   values; discard it when one is
+				   modified */
+				snprintf(buffer, sizeof(buffer), ":%u:",
+					 sticker_cache_generation());
+				items.back().append(buffer);
+				items.back().append(item.GetStickerName());
+			}
+#endif
+		}
+
+		std::sort(items.begin(), items.end());
+
+		for (const auto &item : items) {
+			key.append(item);
+			key.push_back('\0');
+		}
+	}
+
+	return key;
+}
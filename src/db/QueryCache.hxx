@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_DB_QUERY_CACHE_HXX
+#define MPD_DB_QUERY_CACHE_HXX
+
+#include "check.h"
+#include "thread/Mutex.hxx"
+#include "Compiler.h"
+
+#include <string>
+#include <list>
+#include <unordered_map>
+
+#include <stddef.h>
+#include <time.h>
+
+class SongFilter;
+
+/**
+ * A bounded LRU cache of complete responses to database commands
+ * such as "find", "list" and "count", so identical requests don't
+ * run the whole query again.  Each entry remembers the database
+ * update stamp it was generated with; all entries are discarded
+ * when the database is modified.
+ *
+ * This class is thread-safe, because commands may be executed in
+ * client worker threads.
+ */
+class QueryCache {
+	struct Entry {
+		std::string key;
+
+		time_t stamp;
+
+		std::string response;
+
+		Entry(std::string &&_key, time_t _stamp,
+		      std::string &&_response)
+			:key(std::move(_key)), stamp(_stamp),
+			 response(std::move(_response)) {}
+	};
+
+	typedef std::list<Entry> List;
+
+	/**
+	 * Protects all attributes except #max_size.
+	 */
+	Mutex mutex;
+
+	/**
+	 * All entries, the most recently used one first.
+	 */
+	List lru;
+
+	std::unordered_map<std::string, List::iterator> map;
+
+	/**
+	 * The maximum total size of all responses [bytes].
+	 */
+	const size_t max_size;
+
+	/**
+	 * The current total size of all responses [bytes].
+	 */
+	size_t size;
+
+public:
+	explicit QueryCache(size_t _max_size)
+		:max_size(_max_size), size(0) {}
+
+	QueryCache(const QueryCache &) = delete;
+	QueryCache &operator=(const QueryCache &) = delete;
+
+	/**
+	 * The maximum size of one response; larger ones would evict
+	 * too much, and are not cached.
+	 */
+	gcc_pure
+	size_t GetMaxResponseSize() const {
+		return max_size / 8;
+	}
+
+	/**
+	 * Look up a response and mark it as recently used.
+	 *
+	 * @param stamp the current Database::GetUpdateStamp(); an
+	 * entry generated with a different one is discarded
+	 * @param response receives a copy of the response
+	 * @return false if there is no such response
+	 */
+	bool Get(const std::string &key, time_t stamp, std::string &response);
+
+	void Put(std::string &&key, time_t stamp, std::string &&response);
+
+	void Clear();
+};
+
+/**
+ * Generate a #QueryCache key for a database command.  The filter
+ * items are sorted, so the order of the arguments doesn't matter.
+ *
+ * @param command the command name
+ * @param parameters other parsed parameters which influence the
+ * response
+ * @param filter an optional filter
+ */
+gcc_pure
+std::string
+QueryCacheKey(const char *command, const std::string &parameters,
+	      const SongFilter *filter);
+
+#endif
@@ -51,9 +51,7 @@ VisitUniqueTags(const Database &db, const DatabaseSelection &selection,
 	if (!db.Visit(selection, f, error))
 		return false;
 
-	for (const auto &value : set)
-		if (!visit_tag(value, error))
-			return false;
-
-	return true;
+	return set.VisitSorted([&visit_tag, &error](const Tag &tag){
+			return visit_tag(tag, error);
+		});
 }
@@ -28,6 +28,11 @@
 #include "db/LightDirectory.hxx"
 #include "db/LightSong.hxx"
 #include "db/Stats.hxx"
+#include "db/Helpers.hxx"
+#include "db/UniqueTags.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
 #include "SongFilter.hxx"
 #include "Compiler.h"
 #include "config/ConfigData.hxx"
@@ -46,6 +51,9 @@
 #include <cassert>
 #include <string>
 #include <list>
+#include <vector>
+
+#include <string.h>
 
 class ProxySong : public LightSong {
 	Tag tag2;
@@ -66,6 +74,97 @@ public:
 	}
 };
 
+/**
+ * The songs of the directories which were listed most recently by
+ * ProxyDatabase::GetSong().  Songs of a playlist or of the queue
+ * are usually grouped by directory, so listing the whole directory
+ * once saves one round trip for each of its songs.
+ */
+class SongReadAhead {
+	static constexpr unsigned MAX_DIRECTORIES = 16;
+
+	struct ListedDirectory {
+		std::string path;
+
+		std::vector<mpd_song *> songs;
+
+		explicit ListedDirectory(const std::string &_path)
+			:path(_path) {}
+
+		ListedDirectory(const ListedDirectory &) = delete;
+		ListedDirectory &operator=(const ListedDirectory &) = delete;
+
+		~ListedDirectory() {
+			for (auto song : songs)
+				mpd_song_free(song);
+		}
+	};
+
+	/**
+	 * Most recently used first.
+	 */
+	std::list<ListedDirectory> directories;
+
+public:
+	void Clear() {
+		directories.clear();
+	}
+
+	/**
+	 * Look up a song in the listed directory @a parent.
+	 *
+	 * @param listed_r is set to true if the directory has been
+	 * listed, even if it does not contain the song
+	 */
+	const mpd_song *Find(const std::string &parent, const char *uri,
+			     bool &listed_r) {
+		for (auto i = directories.begin(), end = directories.end();
+		     i != end; ++i) {
+			if (i->path != parent)
+				continue;
+
+			directories.splice(directories.begin(),
+					   directories, i);
+			listed_r = true;
+
+			for (const auto song : i->songs)
+				if (strcmp(mpd_song_get_uri(song), uri) == 0)
+					return song;
+
+			return nullptr;
+		}
+
+		listed_r = false;
+		return nullptr;
+	}
+
+	/**
+	 * Receive the response to "lsinfo" of the given directory.
+	 */
+	bool Receive(struct mpd_connection *connection,
+		     const std::string &path) {
+		directories.emplace_front(path);
+		if (directories.size() > MAX_DIRECTORIES)
+			directories.pop_back();
+
+		auto &songs = directories.front().songs;
+
+		struct mpd_entity *entity;
+		while ((entity = mpd_recv_entity(connection)) != nullptr) {
+			if (mpd_entity_get_type(entity) == MPD_ENTITY_TYPE_SONG)
+				songs.push_back(mpd_song_dup(mpd_entity_get_song(entity)));
+			mpd_entity_free(entity);
+		}
+
+		if (!mpd_response_finish(connection)) {
+			directories.pop_front();
+			return false;
+		}
+
+		return true;
+	}
+};
+
 class ProxyDatabase final : public Database, SocketMonitor, IdleMonitor {
 	DatabaseListener &listener;
 
@@ -89,11 +188,38 @@ class ProxyDatabase final : public Database, SocketMonitor, IdleMonitor {
 	 */
 	bool is_idle;
 
+	/**
+	 * Keep a copy of the other MPD's database in memory, instead
+	 * of sending each request to it?
+	 */
+	bool cache_enabled;
+
+	/**
+	 * The root of the local copy (if #cache_enabled).  It is
+	 * loaded on demand and discarded as soon as the other MPD
+	 * reports a database modification.
+	 *
+	 * Protected by #db_mutex.
+	 */
+	mutable Directory *cache;
+
+	/**
+	 * A buffer for GetSong() from the #cache.
+	 */
+	mutable LightSong cache_song;
+
+	/**
+	 * Directories listed by GetSong() (unless #cache_enabled).
+	 * Cleared when the other MPD reports a database
+	 * modification.
+	 */
+	mutable SongReadAhead read_ahead;
+
 public:
 	ProxyDatabase(EventLoop &_loop, DatabaseListener &_listener)
 		:Database(proxy_db_plugin),
 		 SocketMonitor(_loop), IdleMonitor(_loop),
-		 listener(_listener) {}
+		 listener(_listener), cache(nullptr) {}
 
 	static Database *Create(EventLoop &loop, DatabaseListener &listener,
 				const config_param &param,
@@ -136,6 +262,40 @@ private:
 
 	void Disconnect();
 
+	/**
+	 * Does the next request need the connection to the other
+	 * MPD, i.e. is the #cache disabled or not loaded yet?
+	 */
+	gcc_pure
+	bool NeedConnection() const {
+		return !cache_enabled || cache == nullptr;
+	}
+
+	/**
+	 * Return the #cache, and load it first if necessary.  The
+	 * caller must have called EnsureConnected() if
+	 * NeedConnection() returned true.
+	 */
+	const Directory *GetCache(Error &error) const;
+
+	bool LoadCache(Error &error) const;
+	void ClearCache();
+
+	/**
+	 * Look up the song in the #read_ahead buffer, and list its
+	 * directory if that has not been done yet.
+	 *
+	 * @return the song (to be freed by the caller), or nullptr if
+	 * it must be requested individually
+	 */
+	mpd_song *ReadAhead(const char *uri) const;
+
+	bool VisitCache(const DatabaseSelection &selection,
+			VisitDirectory visit_directory,
+			VisitSong visit_song,
+			VisitPlaylist visit_playlist,
+			Error &error) const;
+
 	/* virtual methods from SocketMonitor */
 	virtual bool OnSocketReady(unsigned flags) override;
 
@@ -183,12 +343,23 @@ Copy(TagBuilder &tag, TagType d_tag,
 	}
 }
 
+static void
+Copy(TagBuilder &tag, const struct mpd_song *song)
+{
+	tag.SetTime(mpd_song_get_duration(song));
+
+	for (const auto *i = &tag_table[0]; i->d != TAG_NUM_OF_ITEM_TYPES; ++i)
+		Copy(tag, i->d, song, i->s);
+}
+
 ProxySong::ProxySong(const mpd_song *song)
 {
 	directory = nullptr;
 	uri = mpd_song_get_uri(song);
 	real_uri = nullptr;
 	tag = &tag2;
+	replay_gain = nullptr;
+	mix_ramp = nullptr;
 	mtime = mpd_song_get_last_modified(song);
 
 #if LIBMPDCLIENT_CHECK_VERSION(2,3,0)
@@ -199,11 +370,7 @@ ProxySong::ProxySong(const mpd_song *song)
 #endif
 
 	TagBuilder tag_builder;
-	tag_builder.SetTime(mpd_song_get_duration(song));
-
-	for (const auto *i = &tag_table[0]; i->d != TAG_NUM_OF_ITEM_TYPES; ++i)
-		Copy(tag_builder, i->d, song, i->s);
-
+	Copy(tag_builder, song);
 	tag_builder.Commit(tag2);
 }
 
@@ -329,6 +496,7 @@ ProxyDatabase::Configure(const config_param &param, gcc_unused Error &error)
 {
 	host = param.GetBlockValue("host", "");
 	port = param.GetBlockValue("port", 0u);
+	cache_enabled = param.GetBlockValue("cache", false);
 
 	return true;
 }
@@ -347,6 +515,9 @@ ProxyDatabase::Open(Error &error)
 void
 ProxyDatabase::Close()
 {
+	ClearCache();
+	read_ahead.Clear();
+
 	if (connection != nullptr)
 		Disconnect();
 }
@@ -458,8 +629,11 @@ ProxyDatabase::OnIdle()
 
 	/* handle previous idle events */
 
-	if (idle_received & MPD_IDLE_DATABASE)
+	if (idle_received & MPD_IDLE_DATABASE) {
+		ClearCache();
+		read_ahead.Clear();
 		listener.OnDatabaseModified();
+	}
 
 	idle_received = 0;
 
@@ -484,19 +658,246 @@ ProxyDatabase::OnIdle()
 	SocketMonitor::ScheduleRead();
 }
 
+/**
+ * Create all missing directories of the given path.
+ */
+static Directory &
+MakeDirectory(Directory &root, const char *path)
+{
+	Directory *directory = &root;
+
+	const char *slash;
+	while ((slash = strchr(path, '/')) != nullptr) {
+		const std::string name(path, slash);
+		directory = directory->MakeChild(name.c_str());
+		path = slash + 1;
+	}
+
+	return *directory->MakeChild(path);
+}
+
+/**
+ * Find or create the parent directory of an entity received from the
+ * other MPD.  Entities arrive grouped by directory, so the previous
+ * one (@a current) is usually right.
+ *
+ * @param name_r receives the base name of the entity
+ */
+static Directory &
+MakeParent(Directory &root, Directory *&current,
+	   const char *uri, const char *&name_r)
+{
+	const char *slash = strrchr(uri, '/');
+	if (slash == nullptr) {
+		name_r = uri;
+		return root;
+	}
+
+	name_r = slash + 1;
+
+	const size_t length = slash - uri;
+	const char *current_path = current->GetPath();
+	if (strlen(current_path) != length ||
+	    memcmp(current_path, uri, length) != 0)
+		current = &MakeDirectory(root, std::string(uri, slash).c_str());
+
+	return *current;
+}
+
+static void
+CacheEntity(Directory &root, Directory *&current,
+	    const struct mpd_entity *entity)
+{
+	const char *name;
+
+	switch (mpd_entity_get_type(entity)) {
+	case MPD_ENTITY_TYPE_UNKNOWN:
+		break;
+
+	case MPD_ENTITY_TYPE_DIRECTORY: {
+		const auto *directory = mpd_entity_get_directory(entity);
+		Directory &parent = MakeParent(root, current,
+					       mpd_directory_get_path(directory),
+					       name);
+		current = parent.MakeChild(name);
+#if LIBMPDCLIENT_CHECK_VERSION(2,9,0)
+		current->mtime = mpd_directory_get_last_modified(directory);
+#endif
+		break;
+	}
+
+	case MPD_ENTITY_TYPE_SONG: {
+		const auto *song = mpd_entity_get_song(entity);
+		Directory &parent = MakeParent(root, current,
+					       mpd_song_get_uri(song), name);
+
+		Song *song2 = Song::NewFile(name, parent);
+		song2->mtime = mpd_song_get_last_modified(song);
+#if LIBMPDCLIENT_CHECK_VERSION(2,3,0)
+		song2->start_ms = mpd_song_get_start(song) * 1000;
+		song2->end_ms = mpd_song_get_end(song) * 1000;
+#endif
+
+		TagBuilder tag_builder;
+		Copy(tag_builder, song);
+		tag_builder.Commit(song2->tag);
+
+		parent.AddSong(song2);
+		break;
+	}
+
+	case MPD_ENTITY_TYPE_PLAYLIST: {
+		const auto *playlist = mpd_entity_get_playlist(entity);
+		Directory &parent = MakeParent(root, current,
+					       mpd_playlist_get_path(playlist),
+					       name);
+		parent.playlists.UpdateOrInsert(PlaylistInfo(name,
+							     mpd_playlist_get_last_modified(playlist)));
+		break;
+	}
+	}
+}
+
+bool
+ProxyDatabase::LoadCache(Error &error) const
+{
+	assert(cache_enabled);
+	assert(cache == nullptr);
+	assert(connection != nullptr);
+
+	/* if the other database gets modified during the transfer,
+	   the "idle" event will discard this copy */
+
+	struct mpd_stats *stats = mpd_run_stats(connection);
+	if (stats == nullptr)
+		return CheckError(connection, error);
+
+	update_stamp = (time_t)mpd_stats_get_db_update_time(stats);
+	mpd_stats_free(stats);
+
+	if (!mpd_send_list_all_meta(connection, ""))
+		return CheckError(connection, error);
+
+	FormatDebug(libmpdclient_domain, "loading the database of %s",
+		    host.empty() ? "localhost" : host.c_str());
+
+	const ScopeDatabaseLock protect;
+
+	Directory *root = Directory::NewRoot();
+	Directory *current = root;
+
+	struct mpd_entity *entity;
+	while ((entity = mpd_recv_entity(connection)) != nullptr) {
+		CacheEntity(*root, current, entity);
+		mpd_entity_free(entity);
+	}
+
+	if (!mpd_response_finish(connection) &&
+	    !CheckError(connection, error)) {
+		delete root;
+		return false;
+	}
+
+	cache = root;
+	return true;
+}
+
+void
+ProxyDatabase::ClearCache()
+{
+	if (cache == nullptr)
+		return;
+
+	const ScopeDatabaseLock protect;
+	delete cache;
+	cache = nullptr;
+}
+
+const Directory *
+ProxyDatabase::GetCache(Error &error) const
+{
+	assert(cache_enabled);
+
+	if (cache == nullptr && !LoadCache(error))
+		return nullptr;
+
+	return cache;
+}
+
+mpd_song *
+ProxyDatabase::ReadAhead(const char *uri) const
+{
+	const char *slash = strrchr(uri, '/');
+	const std::string parent = slash != nullptr
+		? std::string(uri, slash)
+		: std::string();
+
+	bool listed;
+	const mpd_song *song = read_ahead.Find(parent, uri, listed);
+	if (!listed) {
+		if (!mpd_send_list_meta(connection, parent.c_str())) {
+			Error error;
+			CheckError(connection, error);
+			return nullptr;
+		}
+
+		if (!read_ahead.Receive(connection, parent)) {
+			/* maybe not a directory (e.g. a CUE track);
+			   let the caller try the song itself */
+			Error error;
+			CheckError(connection, error);
+			return nullptr;
+		}
+
+		song = read_ahead.Find(parent, uri, listed);
+	}
+
+	/* if the song was not found in the listing, the caller
+	   requests it individually, because virtual songs (e.g. in
+	   an archive) may not be listed */
+	return song != nullptr
+		? mpd_song_dup(song)
+		: nullptr;
+}
+
 const LightSong *
 ProxyDatabase::GetSong(const char *uri, Error &error) const
 {
 	// TODO: eliminate the const_cast
-	if (!const_cast<ProxyDatabase *>(this)->EnsureConnected(error))
+	if (NeedConnection() &&
+	    !const_cast<ProxyDatabase *>(this)->EnsureConnected(error))
 		return nullptr;
 
+	if (cache_enabled) {
+		if (GetCache(error) == nullptr)
+			return nullptr;
+
+		const ScopeDatabaseSharedLock protect;
+		auto r = cache->LookupDirectory(uri);
+		const Song *song = r.uri != nullptr &&
+			strchr(r.uri, '/') == nullptr
+			? r.directory->FindSong(r.uri)
+			: nullptr;
+		if (song == nullptr) {
+			error.Format(db_domain, DB_NOT_FOUND,
+				     "No such song: %s", uri);
+			return nullptr;
+		}
+
+		cache_song = song->Export();
+		return &cache_song;
+	}
+
+	struct mpd_song *song = ReadAhead(uri);
+	if (song != nullptr)
+		return new AllocatedProxySong(song);
+
 	if (!mpd_send_list_meta(connection, uri)) {
 		CheckError(connection, error);
 		return nullptr;
 	}
 
-	struct mpd_song *song = mpd_recv_song(connection);
+	song = mpd_recv_song(connection);
 	if (!mpd_response_finish(connection) &&
 	    !CheckError(connection, error)) {
 		if (song != nullptr)
@@ -517,6 +918,9 @@ ProxyDatabase::ReturnSong(const LightSong *_song) const
 {
 	assert(_song != nullptr);
 
+	if (_song == &cache_song)
+		return;
+
 	AllocatedProxySong *song = (AllocatedProxySong *)
 		const_cast<LightSong *>(_song);
 	delete song;
@@ -715,6 +1119,45 @@ ServerSupportsSearchBase(const struct mpd_connection *connection)
 #endif
 }
 
+inline bool
+ProxyDatabase::VisitCache(const DatabaseSelection &selection,
+			  VisitDirectory visit_directory,
+			  VisitSong visit_song,
+			  VisitPlaylist visit_playlist,
+			  Error &error) const
+{
+	if (GetCache(error) == nullptr)
+		return false;
+
+	const ScopeDatabaseSharedLock protect;
+
+	auto r = cache->LookupDirectory(selection.uri.c_str());
+	if (r.uri == nullptr) {
+		/* it's a directory */
+
+		if (selection.recursive && visit_directory &&
+		    !visit_directory(r.directory->Export(), error))
+			return false;
+
+		return r.directory->Walk(selection.recursive, selection.filter,
+					 visit_directory, visit_song,
+					 visit_playlist,
+					 error);
+	}
+
+	if (strchr(r.uri, '/') == nullptr && visit_song) {
+		const Song *song = r.directory->FindSong(r.uri);
+		if (song != nullptr) {
+			const LightSong song2 = song->Export();
+			return !selection.Match(song2) ||
+				visit_song(song2, error);
+		}
+	}
+
+	error.Set(db_domain, DB_NOT_FOUND, "No such directory");
+	return false;
+}
+
 bool
 ProxyDatabase::Visit(const DatabaseSelection &selection,
 		     VisitDirectory visit_directory,
@@ -723,9 +1166,14 @@ ProxyDatabase::Visit(const DatabaseSelection &selection,
 		     Error &error) const
 {
 	// TODO: eliminate the const_cast
-	if (!const_cast<ProxyDatabase *>(this)->EnsureConnected(error))
+	if (NeedConnection() &&
+	    !const_cast<ProxyDatabase *>(this)->EnsureConnected(error))
 		return nullptr;
 
+	if (cache_enabled)
+		return VisitCache(selection, visit_directory, visit_song,
+				  visit_playlist, error);
+
 	if (!visit_directory && !visit_playlist && selection.recursive &&
 	    (ServerSupportsSearchBase(connection)
 	     ? !selection.IsEmpty()
@@ -744,10 +1192,14 @@ ProxyDatabase::Visit(const DatabaseSelection &selection,
 bool
 ProxyDatabase::VisitUniqueTags(const DatabaseSelection &selection,
 			       TagType tag_type,
-			       gcc_unused uint32_t group_mask,
+			       uint32_t group_mask,
 			       VisitTag visit_tag,
 			       Error &error) const
 {
+	if (cache_enabled)
+		return ::VisitUniqueTags(*this, selection, tag_type,
+					 group_mask, visit_tag, error);
+
 	// TODO: eliminate the const_cast
 	if (!const_cast<ProxyDatabase *>(this)->EnsureConnected(error))
 		return nullptr;
@@ -789,6 +1241,9 @@ bool
 ProxyDatabase::GetStats(const DatabaseSelection &selection,
 			DatabaseStats &stats, Error &error) const
 {
+	if (cache_enabled)
+		return ::GetStats(*this, selection, stats, error);
+
 	// TODO: match
 	(void)selection;
 
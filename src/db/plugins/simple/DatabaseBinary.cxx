@@ -0,0 +1,821 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "DatabaseBinary.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/DatabaseError.hxx"
+#include "db/PlaylistVector.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "MixRampInfo.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "fs/Path.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/Charset.hxx"
+#include "tag/Tag.hxx"
+#include "tag/TagItem.hxx"
+#include "tag/TagPool.hxx"
+#include "tag/TagSettings.h"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+
+/*
+ * The file layout:
+ *
+ * - #BinaryHeader
+ * - the string table: one uint32_t offset per string, followed by
+ *   the null-terminated strings (padded to 8 bytes)
+ * - the tag item table (#BinaryTagItem)
+ * - the root #BinaryDirectory, followed by its songs (each
+ *   #BinarySong followed by its tag item numbers and its MixRamp
+ *   points, each padded to 8 bytes), its playlists (#BinaryPlaylist) and then its child
+ *   directories, recursively
+ *
+ * All integers are stored in host byte order; a file written by a
+ * machine with a different byte order is discarded (just like a
+ * text database with an unknown format).
+ */
+
+static constexpr char DB_BINARY_MAGIC[8] = {
+	'M', 'P', 'D', 'B', 'I', 'N', 'D', 'B',
+};
+
+static constexpr uint32_t DB_BINARY_BYTE_ORDER = 0x01020304;
+
+static constexpr uint32_t DB_BINARY_VERSION = 2;
+
+static_assert(TAG_NUM_OF_ITEM_TYPES <= 32, "Too many tag types");
+
+struct BinaryHeader {
+	char magic[sizeof(DB_BINARY_MAGIC)];
+	uint32_t byte_order;
+	uint32_t version;
+
+	/**
+	 * A bit mask of the tag types which were enabled while
+	 * writing this file.
+	 */
+	uint32_t tag_mask;
+
+	/**
+	 * The string number of the filesystem charset.
+	 */
+	uint32_t charset;
+
+	uint32_t n_strings, n_items;
+
+	/**
+	 * File offsets of the sections.
+	 */
+	uint64_t strings, string_data, items, root;
+
+	/**
+	 * The total size of the file; used to detect truncated
+	 * files.
+	 */
+	uint64_t size;
+};
+
+struct BinaryTagItem {
+	uint32_t type;
+	uint32_t value;
+};
+
+struct BinaryDirectory {
+	uint32_t name;
+	uint32_t device;
+	int64_t mtime;
+	uint32_t n_songs, n_playlists, n_children;
+	uint32_t fingerprint;
+};
+
+struct BinarySong {
+	uint32_t uri;
+	uint32_t start_ms, end_ms;
+	int32_t time;
+	int64_t mtime;
+	float track_gain, track_peak, album_gain, album_peak;
+	uint32_t has_playlist;
+	uint32_t n_items;
+
+	/**
+	 * The number of MixRamp points following the tag item
+	 * numbers, first the "start" envelope, then the "end"
+	 * envelope.
+	 */
+	uint16_t n_mixramp_start, n_mixramp_end;
+
+	uint32_t reserved;
+};
+
+struct BinaryPlaylist {
+	uint32_t name;
+	uint32_t reserved;
+	int64_t mtime;
+};
+
+static_assert(sizeof(BinaryHeader) % 8 == 0, "Wrong struct size");
+static_assert(sizeof(BinaryDirectory) % 8 == 0, "Wrong struct size");
+static_assert(sizeof(BinarySong) % 8 == 0, "Wrong struct size");
+static_assert(sizeof(BinaryPlaylist) % 8 == 0, "Wrong struct size");
+
+static constexpr uint64_t
+AlignBinary(uint64_t size)
+{
+	return (size + 7) & ~uint64_t(7);
+}
+
+/**
+ * The size of the tag item number list following a #BinarySong.
+ */
+static constexpr uint64_t
+BinarySongItemsSize(unsigned n_items)
+{
+	return AlignBinary(n_items * sizeof(uint32_t));
+}
+
+/**
+ * The size of the MixRamp point list following the tag item
+ * numbers.
+ */
+static constexpr uint64_t
+BinarySongMixRampSize(unsigned n_points)
+{
+	return AlignBinary(n_points * sizeof(MixRampEnvelope::Point));
+}
+
+static uint32_t
+GetTagMask()
+{
+	uint32_t mask = 0;
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+		if (!ignore_tag_items[i])
+			mask |= 1u << i;
+	return mask;
+}
+
+static bool
+IsDeviceSpecial(unsigned device)
+{
+	return device == DEVICE_INARCHIVE || device == DEVICE_CONTAINER;
+}
+
+class BinaryDatabaseWriter {
+	BufferedOutputStream &os;
+
+	std::unordered_map<std::string, uint32_t> string_ids;
+
+	/**
+	 * All strings in the order of their numbers; they point to
+	 * the keys of #string_ids.
+	 */
+	std::vector<const char *> strings;
+
+	uint64_t string_size;
+
+	std::unordered_map<uint64_t, uint32_t> item_ids;
+	std::vector<BinaryTagItem> items;
+
+	/**
+	 * The total size of all directory, song and playlist
+	 * records.
+	 */
+	uint64_t records_size;
+
+	std::vector<uint32_t> song_items;
+
+public:
+	explicit BinaryDatabaseWriter(BufferedOutputStream &_os)
+		:os(_os), string_size(0), records_size(0) {
+		/* string 0 is the empty string, used as the name of
+		   the root directory */
+		AddString("");
+	}
+
+	bool Save(const Directory &root, Error &error);
+
+private:
+	uint32_t AddString(const char *s) {
+		auto r = string_ids.emplace(s, strings.size());
+		if (r.second) {
+			strings.push_back(r.first->first.c_str());
+			string_size += r.first->first.length() + 1;
+		}
+
+		return r.first->second;
+	}
+
+	gcc_pure
+	uint32_t GetString(const char *s) const {
+		auto i = string_ids.find(s);
+		assert(i != string_ids.end());
+		return i->second;
+	}
+
+	static constexpr uint64_t MakeItemKey(TagType type, uint32_t value) {
+		return (uint64_t(value) << 8) | unsigned(type);
+	}
+
+	void AddItem(const TagItem &item) {
+		const uint32_t value = AddString(item.value);
+		auto r = item_ids.emplace(MakeItemKey(item.type, value),
+					  items.size());
+		if (r.second)
+			items.push_back({uint32_t(item.type), value});
+	}
+
+	gcc_pure
+	uint32_t GetItem(const TagItem &item) const {
+		auto i = item_ids.find(MakeItemKey(item.type,
+						   GetString(item.value)));
+		assert(i != item_ids.end());
+		return i->second;
+	}
+
+	/**
+	 * The first pass: collect all strings and tag items, and
+	 * calculate the size of the records.
+	 */
+	void Collect(const Directory &directory);
+
+	void WriteDirectory(const Directory &directory);
+	void WriteSong(const Song &song);
+
+	void WritePadding(size_t size) {
+		static constexpr uint8_t zero[8] = {};
+		assert(size < sizeof(zero));
+		os.Write(zero, size);
+	}
+};
+
+void
+BinaryDatabaseWriter::Collect(const Directory &directory)
+{
+	if (!directory.IsRoot())
+		AddString(directory.GetName());
+
+	records_size += sizeof(BinaryDirectory);
+
+	for (const auto &song : directory.songs) {
+		AddString(song.uri);
+		for (const auto &item : song.tag)
+			AddItem(item);
+
+		records_size += sizeof(BinarySong) +
+			BinarySongItemsSize(song.tag.num_items);
+		if (song.mix_ramp != nullptr)
+			records_size +=
+				BinarySongMixRampSize(song.mix_ramp->GetStart().GetSize() +
+						      song.mix_ramp->GetEnd().GetSize());
+	}
+
+	for (const auto &pi : directory.playlists) {
+		AddString(pi.name.c_str());
+		records_size += sizeof(BinaryPlaylist);
+	}
+
+	for (const auto &child : directory.children)
+		if (!child.IsMount())
+			Collect(child);
+}
+
+void
+BinaryDatabaseWriter::WriteSong(const Song &song)
+{
+	const auto &track = song.replay_gain.tuples[REPLAY_GAIN_TRACK];
+	const auto &album = song.replay_gain.tuples[REPLAY_GAIN_ALBUM];
+
+	BinarySong s;
+	s.uri = GetString(song.uri);
+	s.start_ms = song.start_ms;
+	s.end_ms = song.end_ms;
+	s.time = song.tag.time;
+	s.mtime = song.mtime;
+	s.track_gain = track.gain;
+	s.track_peak = track.peak;
+	s.album_gain = album.gain;
+	s.album_peak = album.peak;
+	s.has_playlist = song.tag.has_playlist;
+	s.n_items = song.tag.num_items;
+	s.n_mixramp_start = s.n_mixramp_end = 0;
+	if (song.mix_ramp != nullptr) {
+		s.n_mixramp_start = song.mix_ramp->GetStart().GetSize();
+		s.n_mixramp_end = song.mix_ramp->GetEnd().GetSize();
+	}
+	s.reserved = 0;
+	os.Write(&s, sizeof(s));
+
+	song_items.clear();
+	for (const auto &item : song.tag)
+		song_items.push_back(GetItem(item));
+	song_items.resize(BinarySongItemsSize(s.n_items) / sizeof(uint32_t));
+	os.Write(song_items.data(), song_items.size() * sizeof(uint32_t));
+
+	if (song.mix_ramp != nullptr) {
+		const auto &start = song.mix_ramp->GetStart();
+		const auto &end = song.mix_ramp->GetEnd();
+		os.Write(start.GetPoints(),
+			 start.GetSize() * sizeof(MixRampEnvelope::Point));
+		os.Write(end.GetPoints(),
+			 end.GetSize() * sizeof(MixRampEnvelope::Point));
+
+		const size_t size = (start.GetSize() + end.GetSize()) *
+			sizeof(MixRampEnvelope::Point);
+		WritePadding(BinarySongMixRampSize(start.GetSize() +
+						   end.GetSize()) - size);
+	}
+}
+
+void
+BinaryDatabaseWriter::WriteDirectory(const Directory &directory)
+{
+	BinaryDirectory d;
+	d.name = directory.IsRoot() ? 0 : GetString(directory.GetName());
+	d.device = IsDeviceSpecial(directory.device) ? directory.device : 0;
+	d.mtime = directory.mtime;
+	d.n_songs = 0;
+	for (gcc_unused const auto &song : directory.songs)
+		++d.n_songs;
+	d.n_playlists = 0;
+	for (gcc_unused const auto &pi : directory.playlists)
+		++d.n_playlists;
+	d.n_children = 0;
+	for (const auto &child : directory.children)
+		if (!child.IsMount())
+			++d.n_children;
+	d.fingerprint = directory.fingerprint;
+	os.Write(&d, sizeof(d));
+
+	for (const auto &song : directory.songs)
+		WriteSong(song);
+
+	for (const auto &pi : directory.playlists) {
+		const BinaryPlaylist p = {
+			GetString(pi.name.c_str()), 0, int64_t(pi.mtime),
+		};
+		os.Write(&p, sizeof(p));
+	}
+
+	for (const auto &child : directory.children)
+		if (!child.IsMount())
+			WriteDirectory(child);
+}
+
+bool
+BinaryDatabaseWriter::Save(const Directory &root, Error &error)
+{
+	const uint32_t charset = AddString(GetFSCharset());
+	Collect(root);
+
+	if (string_size > UINT32_MAX) {
+		error.Set(db_domain,
+			  "Database too large for the binary format");
+		return false;
+	}
+
+	BinaryHeader header;
+	memcpy(header.magic, DB_BINARY_MAGIC, sizeof(header.magic));
+	header.byte_order = DB_BINARY_BYTE_ORDER;
+	header.version = DB_BINARY_VERSION;
+	header.tag_mask = GetTagMask();
+	header.charset = charset;
+	header.n_strings = strings.size();
+	header.n_items = items.size();
+	header.strings = sizeof(header);
+	header.string_data = header.strings +
+		strings.size() * sizeof(uint32_t);
+	header.items = AlignBinary(header.string_data + string_size);
+	header.root = header.items + items.size() * sizeof(BinaryTagItem);
+	header.size = header.root + records_size;
+	os.Write(&header, sizeof(header));
+
+	uint32_t offset = 0;
+	for (const char *s : strings) {
+		os.Write(&offset, sizeof(offset));
+		offset += strlen(s) + 1;
+	}
+
+	for (const char *s : strings)
+		os.Write(s, strlen(s) + 1);
+	WritePadding(header.items - (header.string_data + string_size));
+
+	os.Write(items.data(), items.size() * sizeof(items.front()));
+
+	WriteDirectory(root);
+	return true;
+}
+
+bool
+db_save_binary(BufferedOutputStream &os, const Directory &root,
+	       Error &error)
+{
+	BinaryDatabaseWriter writer(os);
+	return writer.Save(root, error);
+}
+
+bool
+db_binary_check(Path path)
+{
+	const int fd = OpenFile(path, O_RDONLY, 0);
+	if (fd < 0)
+		return false;
+
+	char magic[sizeof(DB_BINARY_MAGIC)];
+	const bool result = read(fd, magic, sizeof(magic)) == sizeof(magic) &&
+		memcmp(magic, DB_BINARY_MAGIC, sizeof(magic)) == 0;
+	close(fd);
+	return result;
+}
+
+class BinaryDatabaseReader {
+	const uint8_t *const data;
+	const size_t size;
+
+	size_t position;
+
+	const uint32_t *string_offsets;
+	const char *string_data;
+	size_t n_strings, string_data_size;
+
+	const BinaryTagItem *items;
+	size_t n_items;
+
+	/**
+	 * The #TagPool references of all tag items which have been
+	 * used already; each #Tag needs one more reference.
+	 */
+	std::vector<TagItem *> item_cache;
+
+	/**
+	 * The songs are allocated from here.
+	 */
+	Arena &arena;
+
+public:
+	BinaryDatabaseReader(const void *_data, size_t _size, Arena &_arena)
+		:data((const uint8_t *)_data), size(_size), arena(_arena) {}
+
+	~BinaryDatabaseReader();
+
+	bool Load(Directory &root, Error &error);
+
+private:
+	template<typename T>
+	const T *Read(size_t n=1) {
+		if (n > (size - position) / sizeof(T))
+			return nullptr;
+
+		const T *p = (const T *)(data + position);
+		position += n * sizeof(T);
+		return p;
+	}
+
+	gcc_pure
+	const char *GetString(uint32_t id) const {
+		return id < n_strings && string_offsets[id] < string_data_size
+			? string_data + string_offsets[id]
+			: nullptr;
+	}
+
+	/**
+	 * Returns an item from the #TagPool.  The caller must hold
+	 * #tag_pool_lock and obtain its own reference.
+	 */
+	TagItem *GetItem(uint32_t id);
+
+	bool LoadHeader(Error &error);
+	bool LoadSong(Directory &directory, Error &error);
+	bool LoadContents(Directory &directory, const BinaryDirectory &d,
+			  Error &error);
+};
+
+BinaryDatabaseReader::~BinaryDatabaseReader()
+{
+	const ScopeLock protect(tag_pool_lock);
+	for (auto item : item_cache)
+		if (item != nullptr)
+			tag_pool_put_item(item);
+}
+
+TagItem *
+BinaryDatabaseReader::GetItem(uint32_t id)
+{
+	if (id >= n_items)
+		return nullptr;
+
+	TagItem *&item = item_cache[id];
+	if (item == nullptr) {
+		const BinaryTagItem &b = items[id];
+		const char *value = GetString(b.value);
+		if (b.type >= TAG_NUM_OF_ITEM_TYPES || value == nullptr)
+			return nullptr;
+
+		item = tag_pool_get_item(TagType(b.type), value,
+					 strlen(value));
+	}
+
+	return item;
+}
+
+bool
+BinaryDatabaseReader::LoadHeader(Error &error)
+{
+	position = 0;
+	const BinaryHeader *header = Read<BinaryHeader>();
+	if (header == nullptr ||
+	    memcmp(header->magic, DB_BINARY_MAGIC,
+		   sizeof(header->magic)) != 0) {
+		error.Set(db_domain, "Database corrupted");
+		return false;
+	}
+
+	if (header->byte_order != DB_BINARY_BYTE_ORDER ||
+	    header->version != DB_BINARY_VERSION) {
+		error.Set(db_domain,
+			  "Database format mismatch, "
+			  "discarding database file");
+		return false;
+	}
+
+	if (header->size != size ||
+	    header->strings != sizeof(*header) ||
+	    header->n_strings == 0 ||
+	    header->string_data !=
+	    header->strings + uint64_t(header->n_strings) * sizeof(uint32_t) ||
+	    header->items < header->string_data + 1 ||
+	    header->items % 8 != 0 ||
+	    header->root != header->items +
+	    uint64_t(header->n_items) * sizeof(BinaryTagItem) ||
+	    header->root > size) {
+		error.Set(db_domain, "Database corrupted");
+		return false;
+	}
+
+	string_offsets = (const uint32_t *)(data + header->strings);
+	n_strings = header->n_strings;
+	string_data = (const char *)(data + header->string_data);
+	string_data_size = header->items - header->string_data;
+
+	if (string_data[string_data_size - 1] != 0) {
+		/* the last string is not terminated */
+		error.Set(db_domain, "Database corrupted");
+		return false;
+	}
+
+	items = (const BinaryTagItem *)(data + header->items);
+	n_items = header->n_items;
+	item_cache.assign(n_items, nullptr);
+
+	const char *new_charset = GetString(header->charset);
+	const char *const old_charset = GetFSCharset();
+	if (new_charset == nullptr) {
+		error.Set(db_domain, "Database corrupted");
+		return false;
+	}
+
+	if (*old_charset != 0 && strcmp(new_charset, old_charset) != 0) {
+		error.Format(db_domain,
+			     "Existing database has charset "
+			     "\"%s\" instead of \"%s\"; "
+			     "discarding database file",
+			     new_charset, old_charset);
+		return false;
+	}
+
+	if (header->tag_mask != GetTagMask()) {
+		error.Set(db_domain,
+			  "Tag list mismatch, "
+			  "discarding database file");
+		return false;
+	}
+
+	position = header->root;
+	return true;
+}
+
+bool
+BinaryDatabaseReader::LoadSong(Directory &directory, Error &error)
+{
+	const BinarySong *s = Read<BinarySong>();
+	const uint32_t *ids = s != nullptr
+		? Read<uint32_t>(BinarySongItemsSize(s->n_items) /
+				 sizeof(uint32_t))
+		: nullptr;
+	const unsigned n_mixramp = s != nullptr
+		? s->n_mixramp_start + s->n_mixramp_end
+		: 0;
+	const MixRampEnvelope::Point *mixramp = ids != nullptr
+		? Read<MixRampEnvelope::Point>(BinarySongMixRampSize(n_mixramp) /
+					       sizeof(MixRampEnvelope::Point))
+		: nullptr;
+	const char *uri = s != nullptr ? GetString(s->uri) : nullptr;
+	if (mixramp == nullptr || uri == nullptr || *uri == 0) {
+		error.Set(db_domain, "Database corrupted");
+		return false;
+	}
+
+	Song *song = Song::NewFile(uri, directory, arena);
+	song->start_ms = s->start_ms;
+	song->end_ms = s->end_ms;
+	song->mtime = s->mtime;
+	song->replay_gain.tuples[REPLAY_GAIN_TRACK].gain = s->track_gain;
+	song->replay_gain.tuples[REPLAY_GAIN_TRACK].peak = s->track_peak;
+	song->replay_gain.tuples[REPLAY_GAIN_ALBUM].gain = s->album_gain;
+	song->replay_gain.tuples[REPLAY_GAIN_ALBUM].peak = s->album_peak;
+
+	if (n_mixramp > 0) {
+		MixRampInfo mix_ramp;
+		mix_ramp.GetStart().Assign(mixramp, s->n_mixramp_start);
+		mix_ramp.GetEnd().Assign(mixramp + s->n_mixramp_start,
+					 s->n_mixramp_end);
+		song->SetMixRamp(mix_ramp);
+	}
+
+	Tag &tag = song->tag;
+	tag.time = s->time;
+	tag.has_playlist = s->has_playlist != 0;
+
+	if (s->n_items > 0) {
+		const ScopeLock protect(tag_pool_lock);
+		TagItem **items = tag_pool_alloc_items(s->n_items);
+
+		for (unsigned i = 0; i < s->n_items; ++i) {
+			TagItem *item = GetItem(ids[i]);
+			if (item == nullptr) {
+				/* the song is not in the tree yet; its
+				   tag is still empty */
+				for (unsigned j = 0; j < i; ++j)
+					tag_pool_put_item(items[j]);
+				tag_pool_free_items(items, s->n_items);
+
+				song->Free();
+				error.Set(db_domain, "Database corrupted");
+				return false;
+			}
+
+			items[i] = tag_pool_dup_item(item);
+		}
+
+		tag.items = items;
+		tag.num_items = s->n_items;
+		tag.UpdateNumbers();
+	}
+
+	/* add it after the tag is complete, because AddSong() may
+	   share its items with the previous song */
+	directory.AddSong(song);
+	return true;
+}
+
+bool
+BinaryDatabaseReader::LoadContents(Directory &directory,
+				   const BinaryDirectory &d, Error &error)
+{
+	for (unsigned i = 0; i < d.n_songs; ++i)
+		if (!LoadSong(directory, error))
+			return false;
+
+	for (unsigned i = 0; i < d.n_playlists; ++i) {
+		const BinaryPlaylist *p = Read<BinaryPlaylist>();
+		const char *name = p != nullptr ? GetString(p->name) : nullptr;
+		if (name == nullptr) {
+			error.Set(db_domain, "Database corrupted");
+			return false;
+		}
+
+		directory.playlists.push_back(PlaylistInfo(name,
+							   time_t(p->mtime)));
+	}
+
+	for (unsigned i = 0; i < d.n_children; ++i) {
+		const BinaryDirectory *c = Read<BinaryDirectory>();
+		const char *name = c != nullptr ? GetString(c->name) : nullptr;
+		if (name == nullptr || *name == 0 ||
+		    strchr(name, '/') != nullptr) {
+			error.Set(db_domain, "Database corrupted");
+			return false;
+		}
+
+		Directory *child = directory.CreateChild(name);
+		child->device = c->device;
+		child->mtime = c->mtime;
+		child->fingerprint = c->fingerprint;
+		if (!LoadContents(*child, *c, error))
+			return false;
+	}
+
+	return true;
+}
+
+bool
+BinaryDatabaseReader::Load(Directory &root, Error &error)
+{
+	if (!LoadHeader(error))
+		return false;
+
+	const BinaryDirectory *d = Read<BinaryDirectory>();
+	if (d == nullptr) {
+		error.Set(db_domain, "Database corrupted");
+		return false;
+	}
+
+	LogDebug(db_domain, "reading DB");
+
+	root.mtime = d->mtime;
+	root.fingerprint = d->fingerprint;
+
+	const ScopeDatabaseLock protect;
+	if (!LoadContents(root, *d, error))
+		return false;
+
+	if (position != size) {
+		error.Set(db_domain, "Database corrupted");
+		return false;
+	}
+
+	return true;
+}
+
+bool
+db_load_binary(Path path, Directory &root, Arena &arena, Error &error)
+{
+#ifdef WIN32
+	(void)path;
+	(void)root;
+	(void)arena;
+
+	error.Set(db_domain,
+		  "The binary database format is not supported on this platform");
+	return false;
+#else
+	const int fd = OpenFile(path, O_RDONLY, 0);
+	if (fd < 0) {
+		const std::string path_utf8 = path.ToUTF8();
+		error.FormatErrno("Failed to open %s", path_utf8.c_str());
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		error.SetErrno("Failed to stat database file");
+		close(fd);
+		return false;
+	}
+
+	const size_t size = st.st_size;
+	if (size < sizeof(BinaryHeader)) {
+		close(fd);
+		error.Set(db_domain, "Database corrupted");
+		return false;
+	}
+
+	void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		error.SetErrno("Failed to map database file");
+		return false;
+	}
+
+	madvise(p, size, MADV_WILLNEED);
+
+	bool success;
+	{
+		BinaryDatabaseReader reader(p, size, arena);
+		success = reader.Load(root, error);
+	}
+
+	munmap(p, size);
+	return success;
+#endif
+}
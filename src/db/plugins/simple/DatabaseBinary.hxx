@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_DATABASE_BINARY_HXX
+#define MPD_DATABASE_BINARY_HXX
+
+#include "Compiler.h"
+
+struct Directory;
+class Path;
+class BufferedOutputStream;
+class Error;
+class Arena;
+
+/**
+ * Does the file start with the signature of the binary database
+ * format?  Returns false if the file cannot be read.
+ */
+gcc_pure
+bool
+db_binary_check(Path path);
+
+/**
+ * Write the database in the binary format: all strings are
+ * collected in one table, and directories, songs and playlists are
+ * stored as fixed-size records which refer to it.  The file is
+ * written uncompressed, so db_load_binary() can map it into memory.
+ */
+bool
+db_save_binary(BufferedOutputStream &os, const Directory &root,
+	       Error &error);
+
+/**
+ * Load a file written by db_save_binary() by mapping it into
+ * memory.
+ */
+bool
+db_load_binary(Path path, Directory &root, Arena &arena, Error &error);
+
+#endif
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "DatabaseIndex.hxx"
+#include "fs/io/TextFile.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "util/StringUtil.hxx"
+#include "util/NumberParser.hxx"
+#include "util/Error.hxx"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define INDEX_FORMAT "index_format: "
+#define INDEX_BASE "base: "
+#define INDEX_DIRECTORY "directory: "
+#define INDEX_END "end: "
+
+static constexpr unsigned INDEX_FORMAT_VERSION = 1;
+
+bool
+DatabaseIndex::Save(Path path_fs, const struct stat &base,
+		    Error &error) const
+{
+	FileOutputStream fos(path_fs, error);
+	if (!fos.IsDefined())
+		return false;
+
+	BufferedOutputStream bos(fos);
+	bos.Format(INDEX_FORMAT "%u\n", INDEX_FORMAT_VERSION);
+	bos.Format(INDEX_BASE "%llu %llu\n",
+		   (unsigned long long)base.st_mtime,
+		   (unsigned long long)base.st_size);
+
+	for (const auto offset : offsets)
+		bos.Format(INDEX_DIRECTORY "%llu\n",
+			   (unsigned long long)offset);
+
+	bos.Format(INDEX_END "%llu\n", (unsigned long long)end);
+
+	return bos.Flush(error) && fos.Commit(error);
+}
+
+bool
+DatabaseIndex::Load(Path path_fs, const struct stat &base)
+{
+	Clear();
+
+	Error error;
+	TextFile file(path_fs, error);
+	if (file.HasFailed())
+		return false;
+
+	const char *line = file.ReadLine();
+	if (line == nullptr || !StringStartsWith(line, INDEX_FORMAT) ||
+	    ParseUnsigned(line + sizeof(INDEX_FORMAT) - 1) !=
+	    INDEX_FORMAT_VERSION)
+		return false;
+
+	line = file.ReadLine();
+	if (line == nullptr || !StringStartsWith(line, INDEX_BASE))
+		return false;
+
+	char *endptr;
+	const uint64_t mtime = strtoull(line + sizeof(INDEX_BASE) - 1,
+					&endptr, 10);
+	const uint64_t size = strtoull(endptr, &endptr, 10);
+	if (*endptr != 0 || mtime != uint64_t(base.st_mtime) ||
+	    size != uint64_t(base.st_size))
+		return false;
+
+	uint64_t previous = 0;
+	while ((line = file.ReadLine()) != nullptr &&
+	       StringStartsWith(line, INDEX_DIRECTORY)) {
+		const uint64_t offset =
+			ParseUint64(line + sizeof(INDEX_DIRECTORY) - 1);
+		if (offset <= previous)
+			return false;
+
+		offsets.push_back(offset);
+		previous = offset;
+	}
+
+	if (line == nullptr || !StringStartsWith(line, INDEX_END))
+		return false;
+
+	end = ParseUint64(line + sizeof(INDEX_END) - 1);
+	return end >= previous && end <= size;
+}
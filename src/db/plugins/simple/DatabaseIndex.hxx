@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_DATABASE_INDEX_HXX
+#define MPD_DATABASE_INDEX_HXX
+
+#include "check.h"
+
+#include <vector>
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+class Path;
+class Error;
+
+/**
+ * The positions of the top-level "directory" blocks within an
+ * uncompressed text database file.  With it, the blocks can be
+ * parsed by several threads at the same time (see
+ * db_load_internal()).
+ *
+ * The index is stored in a separate file next to the database file,
+ * and it is only valid for a database file with the recorded
+ * modification time and size.
+ */
+struct DatabaseIndex {
+	/**
+	 * The start offset of each top-level directory block.
+	 */
+	std::vector<uint64_t> offsets;
+
+	/**
+	 * The end offset of the last directory block.  The songs
+	 * and playlists of the root directory follow here.
+	 */
+	uint64_t end;
+
+	DatabaseIndex():end(0) {}
+
+	void Clear() {
+		offsets.clear();
+		end = 0;
+	}
+
+	/**
+	 * Write the index file.
+	 *
+	 * @param base the status of the database file which was just
+	 * written
+	 */
+	bool Save(Path path_fs, const struct stat &base, Error &error) const;
+
+	/**
+	 * Read the index file.
+	 *
+	 * @return false if there is no usable index for the given
+	 * database file
+	 */
+	bool Load(Path path_fs, const struct stat &base);
+};
+
+#endif
@@ -0,0 +1,444 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "DatabaseJournal.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "SongSave.hxx"
+#include "DetachedSong.hxx"
+#include "PlaylistDatabase.hxx"
+#include "db/PlaylistVector.hxx"
+#include "db/DatabaseLock.hxx"
+#include "fs/io/TextFile.hxx"
+#include "fs/io/StringOutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "fs/FileSystem.hxx"
+#include "util/StringUtil.hxx"
+#include "util/NumberParser.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <list>
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define JOURNAL_FORMAT "journal_format: "
+#define JOURNAL_BASE "base: "
+#define JOURNAL_UPDATE "dir_update:"
+#define JOURNAL_DELETE "dir_delete:"
+#define JOURNAL_MTIME "mtime: "
+#define JOURNAL_DEVICE "device: "
+#define JOURNAL_FINGERPRINT "fingerprint: "
+#define JOURNAL_END "dir_end"
+
+static constexpr unsigned JOURNAL_FORMAT_VERSION = 1;
+
+static constexpr Domain journal_domain("db_journal");
+
+static void
+journal_save_directory(BufferedOutputStream &os, const Directory &directory)
+{
+	os.Format(JOURNAL_UPDATE " %s\n", directory.GetPath());
+
+	if (directory.mtime != 0)
+		os.Format(JOURNAL_MTIME "%lu\n",
+			  (unsigned long)directory.mtime);
+
+	if (directory.fingerprint != 0)
+		os.Format(JOURNAL_FINGERPRINT "%08x\n",
+			  directory.fingerprint);
+
+	if (directory.device == DEVICE_INARCHIVE ||
+	    directory.device == DEVICE_CONTAINER)
+		os.Format(JOURNAL_DEVICE "%u\n", directory.device);
+
+	for (const auto &song : directory.songs)
+		song_save(os, song);
+
+	playlist_vector_save(os, directory.playlists);
+
+	os.Format(JOURNAL_END "\n");
+}
+
+/**
+ * Generates the record of each directory, calculates its hash, and
+ * (optionally) writes the records whose hash differs from the
+ * previous one to the journal.
+ */
+class JournalWalker {
+	typedef std::unordered_map<std::string, size_t> Map;
+
+	const Map &old_fingerprints;
+	Map new_fingerprints;
+
+	StringOutputStream record;
+	BufferedOutputStream record_os;
+
+	/**
+	 * The journal file, or nullptr if the records shall not be
+	 * written.
+	 */
+	BufferedOutputStream *const journal;
+
+public:
+	JournalWalker(const Map &_old_fingerprints,
+		      BufferedOutputStream *_journal)
+		:old_fingerprints(_old_fingerprints),
+		 record_os(record), journal(_journal) {}
+
+	void Walk(const Directory &directory);
+
+	/**
+	 * Write a deletion record for each directory which has
+	 * disappeared since the previous walk.
+	 */
+	void WriteDeleted();
+
+	Map &GetFingerprints() {
+		return new_fingerprints;
+	}
+};
+
+void
+JournalWalker::Walk(const Directory &directory)
+{
+	record.value.clear();
+	journal_save_directory(record_os, directory);
+	record_os.Flush();
+
+	const size_t hash = std::hash<std::string>()(record.value);
+
+	std::string path(directory.GetPath());
+	if (journal != nullptr) {
+		auto i = old_fingerprints.find(path);
+		if (i == old_fingerprints.end() || i->second != hash)
+			journal->Write(record.value.data(),
+				       record.value.size());
+	}
+
+	new_fingerprints.emplace(std::move(path), hash);
+
+	for (const auto &child : directory.children)
+		if (!child.IsMount())
+			Walk(child);
+}
+
+void
+JournalWalker::WriteDeleted()
+{
+	assert(journal != nullptr);
+
+	for (const auto &i : old_fingerprints)
+		if (new_fingerprints.find(i.first) == new_fingerprints.end())
+			journal->Format(JOURNAL_DELETE " %s\n"
+					JOURNAL_END "\n",
+					i.first.c_str());
+}
+
+bool
+DatabaseJournal::Stat(struct stat &st) const
+{
+	return StatFile(path, st);
+}
+
+/**
+ * Look up a directory by its path, and create it (and its parents)
+ * if it does not exist.
+ *
+ * Caller must lock the #db_mutex.
+ */
+static Directory *
+journal_make_directory(Directory &root, const char *path)
+{
+	Directory *directory = &root;
+
+	while (*path != 0) {
+		const char *slash = strchr(path, '/');
+		const std::string name = slash != nullptr
+			? std::string(path, slash)
+			: std::string(path);
+		if (name.empty() || directory->IsMount())
+			return nullptr;
+
+		directory = directory->MakeChild(name.c_str());
+
+		if (slash == nullptr)
+			break;
+
+		path = slash + 1;
+	}
+
+	return directory;
+}
+
+/**
+ * Parse a #JOURNAL_UPDATE record and apply it.
+ *
+ * @return false if the record is malformed or incomplete; nothing
+ * has been applied then
+ */
+static bool
+journal_replay_update(TextFile &file, Directory &root, const char *path,
+		      Error &error)
+{
+	time_t mtime = 0;
+	unsigned device = 0;
+	uint32_t fingerprint = 0;
+	std::list<DetachedSong> songs;
+	PlaylistVector playlists;
+
+	const char *line;
+	while (true) {
+		line = file.ReadLine();
+		if (line == nullptr) {
+			error.Set(journal_domain, "Incomplete record");
+			return false;
+		}
+
+		if (strcmp(line, JOURNAL_END) == 0)
+			break;
+
+		if (StringStartsWith(line, JOURNAL_MTIME)) {
+			mtime = ParseUint64(line + sizeof(JOURNAL_MTIME) - 1);
+		} else if (StringStartsWith(line, JOURNAL_DEVICE)) {
+			device = ParseUnsigned(line + sizeof(JOURNAL_DEVICE) - 1);
+		} else if (StringStartsWith(line, JOURNAL_FINGERPRINT)) {
+			fingerprint = ParseUnsigned(line + sizeof(JOURNAL_FINGERPRINT) - 1,
+						    nullptr, 16);
+		} else if (StringStartsWith(line, SONG_BEGIN)) {
+			const char *name = line + sizeof(SONG_BEGIN) - 1;
+			DetachedSong *song = song_load(file, name, error);
+			if (song == nullptr)
+				return false;
+
+			songs.emplace_back(std::move(*song));
+			delete song;
+		} else if (StringStartsWith(line, PLAYLIST_META_BEGIN)) {
+			const char *name = line + sizeof(PLAYLIST_META_BEGIN) - 1;
+			if (!playlist_metadata_load(file, playlists, name,
+						    error))
+				return false;
+		} else {
+			error.Format(journal_domain,
+				     "Malformed line: %s", line);
+			return false;
+		}
+	}
+
+	Directory *directory = journal_make_directory(root, path);
+	if (directory == nullptr) {
+		error.Format(journal_domain, "Invalid path: %s", path);
+		return false;
+	}
+
+	/* the record replaces the songs and playlists, but not the
+	   child directories */
+	directory->mtime = mtime;
+	directory->device = device;
+	directory->fingerprint = fingerprint;
+
+	directory->ClearSongs();
+	for (auto &song : songs)
+		directory->AddSong(Song::NewFrom(std::move(song), *directory));
+
+	directory->playlists = std::move(playlists);
+	return true;
+}
+
+static bool
+journal_replay_delete(TextFile &file, Directory &root, const char *path,
+		      Error &error)
+{
+	const char *line = file.ReadLine();
+	if (line == nullptr || strcmp(line, JOURNAL_END) != 0) {
+		error.Set(journal_domain, "Incomplete record");
+		return false;
+	}
+
+	auto r = root.LookupDirectory(path);
+	if (r.uri == nullptr && !r.directory->IsRoot() &&
+	    !r.directory->IsMount())
+		r.directory->Delete();
+
+	return true;
+}
+
+/**
+ * Check the journal header.  Returns false if the journal does not
+ * belong to the given database file.
+ */
+static bool
+journal_check_header(TextFile &file, const struct stat &base)
+{
+	const char *line = file.ReadLine();
+	if (line == nullptr || !StringStartsWith(line, JOURNAL_FORMAT) ||
+	    ParseUnsigned(line + sizeof(JOURNAL_FORMAT) - 1) !=
+	    JOURNAL_FORMAT_VERSION)
+		return false;
+
+	line = file.ReadLine();
+	if (line == nullptr || !StringStartsWith(line, JOURNAL_BASE))
+		return false;
+
+	char *endptr;
+	const uint64_t mtime = strtoull(line + sizeof(JOURNAL_BASE) - 1,
+					&endptr, 10);
+	const uint64_t size = strtoull(endptr, &endptr, 10);
+	return *endptr == 0 &&
+		mtime == uint64_t(base.st_mtime) &&
+		size == uint64_t(base.st_size);
+}
+
+bool
+DatabaseJournal::Load(Directory &root, const struct stat &base,
+		      Error &error)
+{
+	active = false;
+
+	if (path.IsNull() || !FileExists(path))
+		return true;
+
+	TextFile file(path, error);
+	if (file.HasFailed())
+		return false;
+
+	if (!journal_check_header(file, base)) {
+		/* probably a leftover from before the database file
+		   was rewritten */
+		LogInfo(journal_domain, "Discarding stale journal");
+		return true;
+	}
+
+	const ScopeDatabaseLock protect;
+
+	unsigned n_records = 0;
+	Error replay_error;
+	const char *line;
+	while ((line = file.ReadLine()) != nullptr) {
+		bool success;
+		if (StringStartsWith(line, JOURNAL_UPDATE))
+			success = journal_replay_update(file, root,
+							StripLeft(line + sizeof(JOURNAL_UPDATE) - 1),
+							replay_error);
+		else if (StringStartsWith(line, JOURNAL_DELETE))
+			success = journal_replay_delete(file, root,
+							StripLeft(line + sizeof(JOURNAL_DELETE) - 1),
+							replay_error);
+		else {
+			replay_error.Format(journal_domain,
+					    "Malformed line: %s", line);
+			success = false;
+		}
+
+		if (!success) {
+			/* most likely, MPD was interrupted while
+			   writing this record; keep what we have, and
+			   let the next Save() rewrite the database
+			   file */
+			FormatWarning(journal_domain,
+				      "Ignoring the rest of the journal after %u records: %s",
+				      n_records, replay_error.GetMessage());
+			return file.Check(error);
+		}
+
+		++n_records;
+	}
+
+	if (!file.Check(error))
+		return false;
+
+	FormatDebug(journal_domain, "Replayed %u journal records", n_records);
+	active = true;
+	return true;
+}
+
+bool
+DatabaseJournal::Create(const Directory &root, const struct stat &base,
+			Error &error)
+{
+	assert(!path.IsNull());
+
+	active = false;
+
+	FileOutputStream fos(path, error);
+	if (!fos.IsDefined())
+		return false;
+
+	BufferedOutputStream bos(fos);
+	bos.Format(JOURNAL_FORMAT "%u\n", JOURNAL_FORMAT_VERSION);
+	bos.Format(JOURNAL_BASE "%llu %llu\n",
+		   (unsigned long long)base.st_mtime,
+		   (unsigned long long)base.st_size);
+
+	if (!bos.Flush(error) || !fos.Commit(error))
+		return false;
+
+	Reset(root);
+	active = true;
+	return true;
+}
+
+void
+DatabaseJournal::Remove()
+{
+	active = false;
+	fingerprints.clear();
+
+	if (!path.IsNull() && FileExists(path))
+		RemoveFile(path);
+}
+
+void
+DatabaseJournal::Reset(const Directory &root)
+{
+	JournalWalker walker(fingerprints, nullptr);
+	walker.Walk(root);
+	fingerprints = std::move(walker.GetFingerprints());
+}
+
+bool
+DatabaseJournal::Append(const Directory &root, Error &error)
+{
+	assert(active);
+
+	FileOutputStream fos(path, error, FileOutputStream::Mode::APPEND);
+	if (!fos.IsDefined())
+		return false;
+
+	BufferedOutputStream bos(fos);
+
+	JournalWalker walker(fingerprints, &bos);
+	walker.Walk(root);
+	walker.WriteDeleted();
+
+	/* on error, the FileOutputStream destructor truncates the
+	   file back to the last complete record */
+	if (!bos.Flush(error) || !fos.Commit(error))
+		return false;
+
+	fingerprints = std::move(walker.GetFingerprints());
+	return true;
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_DATABASE_JOURNAL_HXX
+#define MPD_DATABASE_JOURNAL_HXX
+
+#include "check.h"
+#include "fs/AllocatedPath.hxx"
+#include "Compiler.h"
+
+#include <string>
+#include <unordered_map>
+
+#include <sys/stat.h>
+
+struct Directory;
+class Error;
+
+/**
+ * An append-only log of directory changes which is written instead
+ * of rewriting the whole database file after each update.  Each
+ * record contains the full contents (songs, playlists) of one
+ * changed directory, or the deletion of a directory.  On startup,
+ * it is replayed on top of the database file; a record which was
+ * not written completely (e.g. after a crash) is ignored.
+ *
+ * To find out which directories have changed, a hash of each
+ * directory's record is remembered after loading and saving.
+ */
+class DatabaseJournal {
+	AllocatedPath path;
+
+	/**
+	 * The hash of each directory's record, indexed by the
+	 * directory path.
+	 */
+	std::unordered_map<std::string, size_t> fingerprints;
+
+	/**
+	 * Does the journal file belong to the current database file,
+	 * i.e. may Append() add records to it?
+	 */
+	bool active;
+
+public:
+	DatabaseJournal()
+		:path(AllocatedPath::Null()), active(false) {}
+
+	void SetPath(AllocatedPath &&_path) {
+		path = std::move(_path);
+	}
+
+	bool IsActive() const {
+		return active;
+	}
+
+	/**
+	 * Obtain the status of the journal file.
+	 */
+	bool Stat(struct stat &st) const;
+
+	/**
+	 * Replay the journal on top of a freshly loaded database.
+	 * A journal which was written for a different database file
+	 * is ignored.
+	 *
+	 * @param base the status of the database file
+	 */
+	bool Load(Directory &root, const struct stat &base, Error &error);
+
+	/**
+	 * Start a new (empty) journal for the database file which
+	 * was just written.
+	 */
+	bool Create(const Directory &root, const struct stat &base,
+		    Error &error);
+
+	/**
+	 * Delete the journal file.
+	 */
+	void Remove();
+
+	/**
+	 * Remember the current state of all directories; changes
+	 * after this call will be written by the next Append() call.
+	 */
+	void Reset(const Directory &root);
+
+	/**
+	 * Append all changes since the last Reset() or Append()
+	 * call to the journal file.
+	 */
+	bool Append(const Directory &root, Error &error);
+};
+
+#endif
@@ -23,15 +23,22 @@
 #include "db/DatabaseError.hxx"
 #include "Directory.hxx"
 #include "DirectorySave.hxx"
+#include "DatabaseIndex.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
 #include "fs/io/TextFile.hxx"
+#include "fs/Path.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
 #include "tag/Tag.hxx"
 #include "tag/TagSettings.h"
 #include "fs/Charset.hxx"
 #include "util/StringUtil.hxx"
 #include "util/Error.hxx"
+#include "util/Arena.hxx"
 #include "Log.hxx"
 
+#include <list>
+
 #include <string.h>
 #include <stdlib.h>
 
@@ -42,7 +49,7 @@
 #define DIRECTORY_FS_CHARSET "fs_charset: "
 #define DB_TAG_PREFIX "tag: "
 
-static constexpr unsigned DB_FORMAT = 2;
+static constexpr unsigned DB_FORMAT = 5;
 
 /**
  * The oldest database format understood by this MPD version.
@@ -50,7 +57,8 @@ static constexpr unsigned DB_FORMAT = 2;
 static constexpr unsigned OLDEST_DB_FORMAT = 1;
 
 void
-db_save_internal(BufferedOutputStream &os, const Directory &music_root)
+db_save_internal(BufferedOutputStream &os, const Directory &music_root,
+		 DatabaseIndex *index)
 {
 	os.Format("%s\n", DIRECTORY_INFO_BEGIN);
 	os.Format(DB_FORMAT_PREFIX "%u\n", DB_FORMAT);
@@ -63,16 +71,35 @@ db_save_internal(BufferedOutputStream &os, const Directory &music_root)
 
 	os.Format("%s\n", DIRECTORY_INFO_END);
 
-	directory_save(os, music_root);
+	if (index == nullptr) {
+		directory_save(os, music_root);
+		return;
+	}
+
+	/* this is what directory_save() does for the root directory,
+	   plus recording the position of each subdirectory */
+
+	index->Clear();
+
+	for (const auto &child : music_root.children) {
+		index->offsets.push_back(os.GetPosition());
+		directory_save_child(os, child);
+
+		if (!os.Check())
+			return;
+	}
+
+	index->end = os.GetPosition();
+
+	directory_save_files(os, music_root);
 }
 
-bool
-db_load_internal(TextFile &file, Directory &music_root, Error &error)
+static bool
+db_load_header(TextFile &file, Error &error)
 {
 	char *line;
 	unsigned format = 0;
 	bool found_charset = false, found_version = false;
-	bool success;
 	bool tags[TAG_NUM_OF_ITEM_TYPES];
 
 	/* get initial info */
@@ -150,11 +177,173 @@ db_load_internal(TextFile &file, Directory &music_root, Error &error)
 		}
 	}
 
+	return true;
+}
+
+bool
+db_load_internal(TextFile &file, Directory &music_root, Arena &arena,
+		 Error &error)
+{
+	bool success;
+
+	if (!db_load_header(file, error))
+		return false;
+
 	LogDebug(db_domain, "reading DB");
 
 	db_lock();
-	success = directory_load(file, music_root, error);
+	success = directory_load(file, music_root, arena, error);
 	db_unlock();
 
 	return success;
 }
+
+/**
+ * A range of consecutive top-level directory blocks which is parsed
+ * by one thread into a private root directory.
+ */
+struct DatabaseLoadJob {
+	Path path_fs;
+	bool map;
+
+	uint64_t offset;
+	unsigned n_directories;
+
+	/**
+	 * The songs of this job; moved to the database's arena by
+	 * db_load_internal() if the job was successful.  It is
+	 * declared before #root, so it outlives the songs.
+	 */
+	Arena arena;
+
+	Directory *const root;
+
+	bool success;
+	Error error;
+
+	Thread thread;
+
+	DatabaseLoadJob(Path _path_fs, bool _map, uint64_t _offset)
+		:path_fs(_path_fs), map(_map),
+		 offset(_offset), n_directories(0),
+		 arena(MemoryCategory::DATABASE),
+		 root(Directory::NewRoot()), success(false) {}
+
+	~DatabaseLoadJob() {
+		delete root;
+	}
+
+	void Run();
+
+	static void Run(void *ctx) {
+		SetThreadName("db_load");
+
+		DatabaseLoadJob &job = *(DatabaseLoadJob *)ctx;
+		job.Run();
+	}
+};
+
+void
+DatabaseLoadJob::Run()
+{
+#ifndef NDEBUG
+	db_mutex_delegate = true;
+#endif
+
+	TextFile file(path_fs, error, false, map);
+	success = !file.HasFailed() && file.Seek(offset, error);
+
+	for (unsigned i = 0; success && i < n_directories; ++i)
+		success = directory_load_child(file, *root, arena,
+					       error) != nullptr;
+
+	success = success && file.Check(error);
+
+#ifndef NDEBUG
+	db_mutex_delegate = false;
+#endif
+}
+
+/**
+ * Load the songs and playlists of the root directory, which follow
+ * the last top-level directory block.
+ */
+static bool
+db_load_root_files(Path path_fs, bool map, uint64_t offset,
+		   Directory &music_root, Arena &arena, Error &error)
+{
+	TextFile file(path_fs, error, false, map);
+	return !file.HasFailed() && file.Seek(offset, error) &&
+		directory_load(file, music_root, arena, error) &&
+		file.Check(error);
+}
+
+bool
+db_load_internal(TextFile &file, Path path_fs, const DatabaseIndex &index,
+		 unsigned n_threads, bool map, Directory &music_root,
+		 Arena &arena, Error &error)
+{
+	assert(n_threads > 0);
+
+	if (!db_load_header(file, error))
+		return false;
+
+	const ScopeDatabaseLock protect;
+
+	/* split the directory blocks into ranges of roughly the same
+	   size */
+
+	std::list<DatabaseLoadJob> jobs;
+	if (!index.offsets.empty()) {
+		const uint64_t total = index.end - index.offsets.front();
+		const uint64_t job_size = total / n_threads + 1;
+
+		for (const auto offset : index.offsets) {
+			if (jobs.empty() ||
+			    offset - jobs.back().offset >= job_size)
+				jobs.emplace_back(path_fs, map, offset);
+
+			++jobs.back().n_directories;
+		}
+	}
+
+	FormatDebug(db_domain, "reading DB in %u parts",
+		    unsigned(jobs.size()));
+
+	for (auto &job : jobs) {
+		if (!job.thread.Start(DatabaseLoadJob::Run, &job, job.error)) {
+			LogError(job.error);
+			job.error.Clear();
+
+			/* do it in this thread, then */
+			job.Run();
+		}
+	}
+
+	/* meanwhile, this thread loads the root directory */
+	bool success = db_load_root_files(path_fs, map, index.end,
+					  music_root, arena, error);
+
+	for (auto &job : jobs)
+		if (job.thread.IsDefined())
+			job.thread.Join();
+
+	/* splice the subtrees into the real root directory, in the
+	   original order */
+
+	for (auto &job : jobs) {
+		if (!success)
+			break;
+
+		if (!job.success) {
+			error = std::move(job.error);
+			success = false;
+			break;
+		}
+
+		music_root.SpliceChildren(*job.root);
+		arena.Splice(job.arena);
+	}
+
+	return success;
+}
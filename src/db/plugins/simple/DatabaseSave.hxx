@@ -21,14 +21,45 @@
 #define MPD_DATABASE_SAVE_HXX
 
 struct Directory;
+struct DatabaseIndex;
 class BufferedOutputStream;
 class TextFile;
+class Path;
 class Error;
+class Arena;
 
+/**
+ * @param index if not nullptr, then the positions of the top-level
+ * directories are stored here; this is only useful if the stream is
+ * not compressed
+ */
 void
-db_save_internal(BufferedOutputStream &os, const Directory &root);
+db_save_internal(BufferedOutputStream &os, const Directory &root,
+		 DatabaseIndex *index=nullptr);
+
+/**
+ * @param arena the songs are allocated from here; it must outlive
+ * them
+ */
+bool
+db_load_internal(TextFile &file, Directory &root, Arena &arena,
+		 Error &error);
 
+/**
+ * Load the database with the help of an index which was written by
+ * db_save_internal().  The top-level directories are split into
+ * ranges which are parsed by separate threads, and which are finally
+ * moved into the given root directory.
+ *
+ * @param path_fs the path of the (uncompressed) database file, which
+ * gets opened once for each thread
+ * @param n_threads the number of worker threads
+ * @param map map the file into memory in each thread (see
+ * #TextFile)
+ */
 bool
-db_load_internal(TextFile &file, Directory &root, Error &error);
+db_load_internal(TextFile &file, Path path_fs, const DatabaseIndex &index,
+		 unsigned n_threads, bool map, Directory &root, Arena &arena,
+		 Error &error);
 
 #endif
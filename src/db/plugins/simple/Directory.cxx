@@ -31,8 +31,12 @@
 #include "lib/icu/Collate.hxx"
 #include "fs/Traits.hxx"
 #include "util/Alloc.hxx"
+#include "util/MemoryStats.hxx"
 #include "util/Error.hxx"
 
+#include <algorithm>
+#include <vector>
+
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
@@ -41,13 +45,20 @@ Directory::Directory(std::string &&_path_utf8, Directory *_parent)
 	:parent(_parent),
 	 mtime(0),
 	 inode(0), device(0),
+	 fingerprint(0),
+	 sorted(true),
 	 path(std::move(_path_utf8)),
 	 mounted_database(nullptr)
 {
+	MemoryStatsAdd(MemoryCategory::DATABASE,
+		       sizeof(*this) + path.length() + 1);
 }
 
 Directory::~Directory()
 {
+	MemoryStatsSub(MemoryCategory::DATABASE,
+		       sizeof(*this) + path.length() + 1);
+
 	delete mounted_database;
 
 	songs.clear_and_dispose(Song::Disposer());
@@ -57,13 +68,24 @@ Directory::~Directory()
 void
 Directory::Delete()
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 	assert(parent != nullptr);
 
+	parent->child_index.Remove(GetName(), *this);
 	parent->children.erase_and_dispose(parent->children.iterator_to(*this),
 					   Disposer());
 }
 
+void
+Directory::Detach()
+{
+	assert(holding_db_write_lock());
+	assert(parent != nullptr);
+
+	parent->child_index.Remove(GetName(), *this);
+	parent->children.erase(parent->children.iterator_to(*this));
+}
+
 const char *
 Directory::GetName() const
 {
@@ -72,10 +94,43 @@ Directory::GetName() const
 	return PathTraitsUTF8::GetBase(path.c_str());
 }
 
+/**
+ * Does the list have at least @a n entries?  This stops counting
+ * there, because the intrusive lists don't know their size.
+ */
+template<typename L>
+gcc_pure
+static bool
+HasAtLeast(const L &list, unsigned n)
+{
+	auto i = list.begin();
+	for (const auto end = list.end(); n > 0; --n, ++i)
+		if (i == end)
+			return false;
+
+	return true;
+}
+
+inline void
+Directory::IndexChildren()
+{
+	if (HasAtLeast(children, child_index.THRESHOLD))
+		for (auto &child : children)
+			child_index.Add(child.GetName(), child);
+}
+
+inline void
+Directory::IndexSongs()
+{
+	if (HasAtLeast(songs, song_index.THRESHOLD))
+		for (auto &song : songs)
+			song_index.Add(song.uri, song);
+}
+
 Directory *
 Directory::CreateChild(const char *name_utf8)
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 	assert(name_utf8 != nullptr);
 	assert(*name_utf8 != 0);
 
@@ -85,14 +140,45 @@ Directory::CreateChild(const char *name_utf8)
 
 	Directory *child = new Directory(std::move(path_utf8), this);
 	children.push_back(*child);
+	sorted = false;
+	if (child_index.IsActive())
+		child_index.Add(child->GetName(), *child);
+	else
+		IndexChildren();
 	return child;
 }
 
+void
+Directory::SpliceChildren(Directory &other)
+{
+	assert(holding_db_write_lock());
+	assert(&other != this);
+
+	other.child_index.Clear();
+
+	while (!other.children.empty()) {
+		Directory &child = other.children.front();
+		other.children.pop_front();
+
+		child.parent = this;
+		children.push_back(child);
+		sorted = false;
+		if (child_index.IsActive())
+			child_index.Add(child.GetName(), child);
+	}
+
+	if (!child_index.IsActive())
+		IndexChildren();
+}
+
 const Directory *
 Directory::FindChild(const char *name) const
 {
 	assert(holding_db_lock());
 
+	if (child_index.IsActive())
+		return child_index.Find(name);
+
 	for (const auto &child : children)
 		if (strcmp(child.GetName(), name) == 0)
 			return &child;
@@ -103,15 +189,16 @@ Directory::FindChild(const char *name) const
 void
 Directory::PruneEmpty()
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 
 	for (auto child = children.begin(), end = children.end();
 	     child != end;) {
 		child->PruneEmpty();
 
-		if (child->IsEmpty())
+		if (child->IsEmpty()) {
+			child_index.Remove(child->GetName(), *child);
 			child = children.erase_and_dispose(child, Disposer());
-		else
+		} else
 			++child;
 	}
 }
@@ -164,29 +251,53 @@ Directory::LookupDirectory(const char *uri)
 void
 Directory::AddSong(Song *song)
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 	assert(song != nullptr);
 	assert(song->parent == this);
 
+	/* songs of one directory usually belong to the same album;
+	   ShareWith() modifies only the new song, because the
+	   previous one may be in use by another thread */
+	if (!songs.empty())
+		song->tag.ShareWith(songs.back().tag);
+
 	songs.push_back(*song);
+	sorted = false;
+	if (song_index.IsActive())
+		song_index.Add(song->uri, *song);
+	else
+		IndexSongs();
 }
 
 void
 Directory::RemoveSong(Song *song)
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 	assert(song != nullptr);
 	assert(song->parent == this);
 
+	song_index.Remove(song->uri, *song);
 	songs.erase(songs.iterator_to(*song));
 }
 
+void
+Directory::ClearSongs()
+{
+	assert(holding_db_write_lock());
+
+	song_index.Clear();
+	songs.clear_and_dispose(Song::Disposer());
+}
+
 const Song *
 Directory::FindSong(const char *name_utf8) const
 {
 	assert(holding_db_lock());
 	assert(name_utf8 != nullptr);
 
+	if (song_index.IsActive())
+		return song_index.Find(name_utf8);
+
 	for (auto &song : songs) {
 		assert(song.parent == this);
 
@@ -197,20 +308,40 @@ Directory::FindSong(const char *name_utf8) const
 	return nullptr;
 }
 
-gcc_pure
-static bool
-directory_cmp(const Directory &a, const Directory &b)
+static void
+directory_list_sort(Directory::List &children)
 {
-	return IcuCollate(a.path.c_str(), b.path.c_str()) < 0;
+	if (children.empty() ||
+	    std::next(children.begin()) == children.end())
+		/* nothing to sort */
+		return;
+
+	/* generate the collation key of each path only once */
+	std::vector<std::pair<std::string, Directory *>> keys;
+	for (auto &child : children)
+		keys.emplace_back(IcuCollateKey(child.GetPath()), &child);
+
+	std::stable_sort(keys.begin(), keys.end(),
+			 [](const std::pair<std::string, Directory *> &a,
+			    const std::pair<std::string, Directory *> &b){
+				 return a.first < b.first;
+			 });
+
+	children.clear();
+	for (const auto &key : keys)
+		children.push_back(*key.second);
 }
 
 void
 Directory::Sort()
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 
-	children.sort(directory_cmp);
-	song_list_sort(songs);
+	if (!sorted) {
+		directory_list_sort(children);
+		song_list_sort(songs);
+		sorted = true;
+	}
 
 	for (auto &child : children)
 		child.Sort();
@@ -230,13 +361,13 @@ Directory::Walk(bool recursive, const SongFilter *filter,
 		/* TODO: eliminate this unlock/lock; it is necessary
 		   because the child's SimpleDatabasePlugin::Visit()
 		   call will lock it again */
-		db_unlock();
+		db_unlock_shared();
 		bool result = WalkMount(GetPath(), *mounted_database,
 					recursive, filter,
 					visit_directory, visit_song,
 					visit_playlist,
 					error);
-		db_lock();
+		db_lock_shared();
 		return result;
 	}
 
@@ -25,6 +25,7 @@
 #include "db/Visitor.hxx"
 #include "db/PlaylistVector.hxx"
 #include "Song.hxx"
+#include "NameIndex.hxx"
 
 #include <boost/intrusive/list.hpp>
 
@@ -90,12 +91,39 @@ struct Directory {
 	 */
 	SongList songs;
 
+	/**
+	 * Hash indexes of #children and #songs by name.  They are
+	 * built when a list becomes long enough, and are then updated
+	 * by all methods which add or remove entries.  Lookups never
+	 * modify them, because they may run under a shared lock.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 */
+	NameIndex<Directory> child_index;
+	NameIndex<Song> song_index;
+
 	PlaylistVector playlists;
 
 	Directory *parent;
 	time_t mtime;
 	unsigned inode, device;
 
+	/**
+	 * A hash of the names, types, sizes and modification times
+	 * of all entries seen by the last complete update of this
+	 * directory, or 0 if unknown.  It allows the update thread to
+	 * skip the per-file checks when nothing has changed (see
+	 * UpdateWalk::UpdateDirectory()).
+	 */
+	uint32_t fingerprint;
+
+	/**
+	 * Are #children and #songs sorted?  This is cleared when an
+	 * entry is added or a song's tag is modified, and Sort()
+	 * skips directories where it is set.
+	 */
+	bool sorted;
+
 	std::string path;
 
 	/**
@@ -124,14 +152,23 @@ public:
 	 * Remove this #Directory object from its parent and free it.  This
 	 * must not be called with the root Directory.
 	 *
-	 * Caller must lock the #db_mutex.
+	 * Caller must lock the #db_mutex exclusively.
 	 */
 	void Delete();
 
+	/**
+	 * Remove this #Directory object from its parent, but don't
+	 * free it; the caller is responsible for deleting it.  This
+	 * must not be called with the root Directory.
+	 *
+	 * Caller must lock the #db_mutex exclusively.
+	 */
+	void Detach();
+
 	/**
 	 * Create a new #Directory object as a child of the given one.
 	 *
-	 * Caller must lock the #db_mutex.
+	 * Caller must lock the #db_mutex exclusively.
 	 *
 	 * @param name_utf8 the UTF-8 encoded name of the new sub directory
 	 */
@@ -154,7 +191,7 @@ public:
 	 * Look up a sub directory, and create the object if it does not
 	 * exist.
 	 *
-	 * Caller must lock the #db_mutex.
+	 * Caller must lock the #db_mutex exclusively.
 	 */
 	Directory *MakeChild(const char *name_utf8) {
 		Directory *child = FindChild(name_utf8);
@@ -163,6 +200,14 @@ public:
 		return child;
 	}
 
+	/**
+	 * Move all child directories of the given #Directory to the
+	 * end of this one's list.
+	 *
+	 * Caller must lock the #db_mutex exclusively.
+	 */
+	void SpliceChildren(Directory &other);
+
 	struct LookupResult {
 		/**
 		 * The last directory that was found.  If the given
@@ -247,7 +292,8 @@ public:
 
 	/**
 	 * Add a song object to this directory.  Its "parent" attribute must
-	 * be set already.
+	 * be set already.  Tag items which are equal to the ones of
+	 * the previous song are moved to a shared #TagGroup.
 	 */
 	void AddSong(Song *song);
 
@@ -259,14 +305,22 @@ public:
 	void RemoveSong(Song *song);
 
 	/**
-	 * Caller must lock the #db_mutex.
+	 * Remove and free all songs of this directory.
+	 *
+	 * Caller must lock the #db_mutex exclusively.
+	 */
+	void ClearSongs();
+
+	/**
+	 * Caller must lock the #db_mutex exclusively.
 	 */
 	void PruneEmpty();
 
 	/**
-	 * Sort all directory entries recursively.
+	 * Sort all directory entries recursively.  Directories which
+	 * have not been modified since the last call are skipped.
 	 *
-	 * Caller must lock the #db_mutex.
+	 * Caller must lock the #db_mutex exclusively.
 	 */
 	void Sort();
 
@@ -280,6 +334,17 @@ public:
 
 	gcc_pure
 	LightDirectory Export() const;
+
+private:
+	/**
+	 * Build the #child_index if #children has become long enough.
+	 */
+	void IndexChildren();
+
+	/**
+	 * Build the #song_index if #songs has become long enough.
+	 */
+	void IndexSongs();
 };
 
 #endif
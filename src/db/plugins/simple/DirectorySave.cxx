@@ -37,6 +37,7 @@
 #define DIRECTORY_DIR "directory: "
 #define DIRECTORY_TYPE "type: "
 #define DIRECTORY_MTIME "mtime: "
+#define DIRECTORY_FINGERPRINT "fingerprint: "
 #define DIRECTORY_BEGIN "begin: "
 #define DIRECTORY_END "end: "
 
@@ -70,6 +71,24 @@ ParseTypeString(const char *type)
 		return 0;
 }
 
+void
+directory_save_child(BufferedOutputStream &os, const Directory &child)
+{
+	os.Format(DIRECTORY_DIR "%s\n", child.GetName());
+
+	if (!child.IsMount())
+		directory_save(os, child);
+}
+
+void
+directory_save_files(BufferedOutputStream &os, const Directory &directory)
+{
+	for (const auto &song : directory.songs)
+		song_save(os, song);
+
+	playlist_vector_save(os, directory.playlists);
+}
+
 void
 directory_save(BufferedOutputStream &os, const Directory &directory)
 {
@@ -82,23 +101,21 @@ directory_save(BufferedOutputStream &os, const Directory &directory)
 			os.Format(DIRECTORY_MTIME "%lu\n",
 				  (unsigned long)directory.mtime);
 
+		if (directory.fingerprint != 0)
+			os.Format(DIRECTORY_FINGERPRINT "%08x\n",
+				  directory.fingerprint);
+
 		os.Format("%s%s\n", DIRECTORY_BEGIN, directory.GetPath());
 	}
 
 	for (const auto &child : directory.children) {
-		os.Format(DIRECTORY_DIR "%s\n", child.GetName());
-
-		if (!child.IsMount())
-			directory_save(os, child);
+		directory_save_child(os, child);
 
 		if (!os.Check())
 			return;
 	}
 
-	for (const auto &song : directory.songs)
-		song_save(os, song);
-
-	playlist_vector_save(os, directory.playlists);
+	directory_save_files(os, directory);
 
 	if (!directory.IsRoot())
 		os.Format(DIRECTORY_END "%s\n", directory.GetPath());
@@ -110,6 +127,10 @@ ParseLine(Directory &directory, const char *line)
 	if (StringStartsWith(line, DIRECTORY_MTIME)) {
 		directory.mtime =
 			ParseUint64(line + sizeof(DIRECTORY_MTIME) - 1);
+	} else if (StringStartsWith(line, DIRECTORY_FINGERPRINT)) {
+		directory.fingerprint =
+			ParseUnsigned(line + sizeof(DIRECTORY_FINGERPRINT) - 1,
+				      nullptr, 16);
 	} else if (StringStartsWith(line, DIRECTORY_TYPE)) {
 		directory.device =
 			ParseTypeString(line + sizeof(DIRECTORY_TYPE) - 1);
@@ -121,7 +142,7 @@ ParseLine(Directory &directory, const char *line)
 
 static Directory *
 directory_load_subdir(TextFile &file, Directory &parent, const char *name,
-		      Error &error)
+		      Arena &arena, Error &error)
 {
 	bool success;
 
@@ -152,7 +173,7 @@ directory_load_subdir(TextFile &file, Directory &parent, const char *name,
 		}
 	}
 
-	success = directory_load(file, *directory, error);
+	success = directory_load(file, *directory, arena, error);
 	if (!success) {
 		directory->Delete();
 		return nullptr;
@@ -161,8 +182,24 @@ directory_load_subdir(TextFile &file, Directory &parent, const char *name,
 	return directory;
 }
 
+Directory *
+directory_load_child(TextFile &file, Directory &parent, Arena &arena,
+		     Error &error)
+{
+	const char *line = file.ReadLine();
+	if (line == nullptr || !StringStartsWith(line, DIRECTORY_DIR)) {
+		error.Set(directory_domain, "Subdirectory expected");
+		return nullptr;
+	}
+
+	return directory_load_subdir(file, parent,
+				     line + sizeof(DIRECTORY_DIR) - 1,
+				     arena, error);
+}
+
 bool
-directory_load(TextFile &file, Directory &directory, Error &error)
+directory_load(TextFile &file, Directory &directory, Arena &arena,
+	       Error &error)
 {
 	const char *line;
 
@@ -172,7 +209,7 @@ directory_load(TextFile &file, Directory &directory, Error &error)
 			Directory *subdir =
 				directory_load_subdir(file, directory,
 						      line + sizeof(DIRECTORY_DIR) - 1,
-						      error);
+						      arena, error);
 			if (subdir == nullptr)
 				return false;
 		} else if (StringStartsWith(line, SONG_BEGIN)) {
@@ -189,7 +226,7 @@ directory_load(TextFile &file, Directory &directory, Error &error)
 				return false;
 
 			directory.AddSong(Song::NewFrom(std::move(*song),
-							directory));
+							directory, arena));
 			delete song;
 		} else if (StringStartsWith(line, PLAYLIST_META_BEGIN)) {
 			const char *name = line + sizeof(PLAYLIST_META_BEGIN) - 1;
@@ -24,11 +24,40 @@ struct Directory;
 class TextFile;
 class BufferedOutputStream;
 class Error;
+class Arena;
 
 void
 directory_save(BufferedOutputStream &os, const Directory &directory);
 
+/**
+ * Write the "directory" line of a subdirectory, followed by its
+ * contents.
+ */
+void
+directory_save_child(BufferedOutputStream &os, const Directory &child);
+
+/**
+ * Write the songs and playlists of a directory, but not its
+ * subdirectories.
+ */
+void
+directory_save_files(BufferedOutputStream &os, const Directory &directory);
+
+/**
+ * @param arena the songs are allocated from here
+ */
 bool
-directory_load(TextFile &file, Directory &directory, Error &error);
+directory_load(TextFile &file, Directory &directory, Arena &arena,
+	       Error &error);
+
+/**
+ * Load exactly one subdirectory (written by directory_save_child())
+ * into a new child of the given directory.
+ *
+ * @return the new child, or nullptr on error
+ */
+Directory *
+directory_load_child(TextFile &file, Directory &parent, Arena &arena,
+		     Error &error);
 
 #endif
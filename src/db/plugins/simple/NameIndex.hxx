@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_NAME_INDEX_HXX
+#define MPD_NAME_INDEX_HXX
+
+#include "Compiler.h"
+
+#include <unordered_map>
+
+#include <string.h>
+
+/**
+ * A hash table which maps names to objects owned by somebody else.
+ * It does not copy the names; the pointers passed to Add() must
+ * remain valid until the entry is removed.
+ *
+ * #Directory uses it to avoid scanning long lists of child
+ * directories and songs.  It is only populated after a list has
+ * grown beyond #THRESHOLD entries; an empty index means "not
+ * indexed", and the caller falls back to a linear search.
+ */
+template<typename T>
+class NameIndex {
+	struct Hash {
+		gcc_pure
+		size_t operator()(const char *p) const {
+			/* FNV-1a */
+			size_t h = 2166136261u;
+			while (*p != 0)
+				h = (h ^ (unsigned char)*p++) * 16777619u;
+			return h;
+		}
+	};
+
+	struct Equal {
+		gcc_pure
+		bool operator()(const char *a, const char *b) const {
+			return strcmp(a, b) == 0;
+		}
+	};
+
+	typedef std::unordered_map<const char *, T *, Hash, Equal> Map;
+
+	Map map;
+
+public:
+	/**
+	 * Lists with at least this number of entries get an index.
+	 */
+	static constexpr unsigned THRESHOLD = 32;
+
+	bool IsActive() const {
+		return !map.empty();
+	}
+
+	void Clear() {
+		Map().swap(map);
+	}
+
+	void Add(const char *name, T &value) {
+		map.emplace(name, &value);
+	}
+
+	/**
+	 * Remove the entry for this object, if it exists.  Only the
+	 * entry which points to the given object is removed.
+	 */
+	void Remove(const char *name, const T &value) {
+		auto i = map.find(name);
+		if (i != map.end() && i->second == &value)
+			map.erase(i);
+	}
+
+	gcc_pure
+	T *Find(const char *name) const {
+		auto i = map.find(name);
+		return i != map.end()
+			? i->second
+			: nullptr;
+	}
+};
+
+#endif
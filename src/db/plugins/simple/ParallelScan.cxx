@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "ParallelScan.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/LightSong.hxx"
+#include "SongFilter.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <list>
+#include <vector>
+#include <iterator>
+
+#include <assert.h>
+
+/**
+ * Below this number of songs, the scan is done in the calling
+ * thread; starting threads would cost more than it saves.
+ */
+static constexpr size_t MIN_PARALLEL_SONGS = 4096;
+
+/**
+ * Collect the directory and all of its descendants in the order in
+ * which Directory::Walk() visits their songs.
+ *
+ * @return the total number of songs
+ */
+static size_t
+CollectDirectories(const Directory &directory,
+		   std::vector<const Directory *> &list)
+{
+	assert(!directory.IsMount());
+
+	list.push_back(&directory);
+
+	size_t n = std::distance(directory.songs.begin(),
+				 directory.songs.end());
+	for (const auto &child : directory.children)
+		n += CollectDirectories(child, list);
+
+	return n;
+}
+
+/**
+ * A range of consecutive directories which is matched by one
+ * thread.
+ */
+struct ParallelScanJob {
+	const SongFilter &filter;
+
+	const Directory *const *begin, *const *end;
+
+	std::vector<const Song *> matches;
+
+	Thread thread;
+
+	ParallelScanJob(const SongFilter &_filter,
+			const Directory *const *_begin)
+		:filter(_filter), begin(_begin), end(_begin) {}
+
+	void Run();
+
+	static void Run(void *ctx) {
+		SetThreadName("db_scan");
+
+		ParallelScanJob &job = *(ParallelScanJob *)ctx;
+		job.Run();
+	}
+};
+
+void
+ParallelScanJob::Run()
+{
+#ifndef NDEBUG
+	/* the caller holds the lock in shared mode on our behalf
+	   until we're done */
+	db_mutex_reader = true;
+#endif
+
+	for (auto i = begin; i != end; ++i)
+		for (const auto &song : (*i)->songs)
+			if (filter.Match(song.Export()))
+				matches.push_back(&song);
+
+#ifndef NDEBUG
+	db_mutex_reader = false;
+#endif
+}
+
+bool
+ParallelScan(const Directory &directory, const SongFilter &filter,
+	     unsigned n_threads, VisitSong visit_song, Error &error)
+{
+	assert(holding_db_lock());
+	assert(n_threads > 0);
+
+	std::vector<const Directory *> directories;
+	const size_t n_songs = CollectDirectories(directory, directories);
+
+	if (n_threads == 1 || n_songs < MIN_PARALLEL_SONGS) {
+		for (const Directory *d : directories) {
+			for (const auto &song : d->songs) {
+				const LightSong song2 = song.Export();
+				if (filter.Match(song2) &&
+				    !visit_song(song2, error))
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	/* split the directories into ranges with roughly the same
+	   number of songs */
+
+	const size_t job_size = n_songs / n_threads + 1;
+
+	std::list<ParallelScanJob> jobs;
+	size_t job_songs = 0;
+	for (const auto &d : directories) {
+		if (jobs.empty() || job_songs >= job_size) {
+			jobs.emplace_back(filter, &d);
+			job_songs = 0;
+		}
+
+		++jobs.back().end;
+		job_songs += std::distance(d->songs.begin(), d->songs.end());
+	}
+
+	for (auto &job : jobs) {
+		Error start_error;
+		if (!job.thread.Start(ParallelScanJob::Run, &job,
+				      start_error)) {
+			LogError(start_error);
+
+			/* do it in this thread, then */
+			job.Run();
+		}
+	}
+
+	for (auto &job : jobs)
+		if (job.thread.IsDefined())
+			job.thread.Join();
+
+	/* pass the results to the visitor in the original order */
+
+	for (const auto &job : jobs)
+		for (const Song *song : job.matches)
+			if (!visit_song(song->Export(), error))
+				return false;
+
+	return true;
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PARALLEL_SCAN_HXX
+#define MPD_PARALLEL_SCAN_HXX
+
+#include "db/Visitor.hxx"
+
+struct Directory;
+class SongFilter;
+class Error;
+
+/**
+ * Match all songs below the given directory (recursively) against
+ * the filter, split into ranges of directories which are scanned by
+ * up to @a n_threads threads.  The matching songs are passed to the
+ * visitor in the same order as Directory::Walk() would.
+ *
+ * Caller must lock the #db_mutex (shared mode is enough).  The tree
+ * must not contain mounted databases.
+ */
+bool
+ParallelScan(const Directory &directory, const SongFilter &filter,
+	     unsigned n_threads, VisitSong visit_song, Error &error);
+
+#endif
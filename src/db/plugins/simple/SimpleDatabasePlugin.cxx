@@ -29,20 +29,32 @@
 #include "Song.hxx"
 #include "SongFilter.hxx"
 #include "DatabaseSave.hxx"
+#include "ParallelScan.hxx"
+#include "DatabaseBinary.hxx"
+#include "DatabaseIndex.hxx"
 #include "db/DatabaseLock.hxx"
 #include "db/DatabaseError.hxx"
 #include "fs/io/TextFile.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
 #include "fs/io/FileOutputStream.hxx"
 #include "fs/io/GzipOutputStream.hxx"
+#include "fs/io/ParallelGzipOutputStream.hxx"
 #include "config/ConfigData.hxx"
 #include "fs/FileSystem.hxx"
+#include "event/TimeoutMonitor.hxx"
+#include "system/Clock.hxx"
+#include "tag/TagBuilder.hxx"
 #include "util/CharUtil.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+#include <set>
+#include <string>
+
 #include <errno.h>
+#include <string.h>
 
 static constexpr Domain simple_db_domain("simple_db");
 
@@ -52,30 +64,74 @@ inline SimpleDatabase::SimpleDatabase()
 #ifdef HAVE_ZLIB
 	 compress(true),
 #endif
+	 binary(false),
+	 journal_enabled(false),
+	 load_threads(1), map_file(false),
+	 index_path(AllocatedPath::Null()), compress_threads(1),
+	 scan_threads(1),
+	 tag_index_enabled(false), search_index_enabled(false),
+	 updating(false), cache_serial(0), n_mounts(0),
 	 cache_path(AllocatedPath::Null()),
+	 mount_idle_timeout(0), lazy(false), loaded(true), dirty(false),
+	 loop(nullptr), expire_timer(nullptr),
+	 arena(MemoryCategory::DATABASE),
+	 query_owner(ThreadId::Null()), query_depth(0),
 	 prefixed_light_song(nullptr) {}
 
 inline SimpleDatabase::SimpleDatabase(AllocatedPath &&_path,
 #ifndef HAVE_ZLIB
 				      gcc_unused
 #endif
-				      bool _compress)
+				      bool _compress, bool _binary)
 	:Database(simple_db_plugin),
 	 path(std::move(_path)),
 	 path_utf8(path.ToUTF8()),
 #ifdef HAVE_ZLIB
 	 compress(_compress),
 #endif
+	 binary(_binary),
+	 journal_enabled(false),
+	 load_threads(1), map_file(false),
+	 index_path(AllocatedPath::Null()), compress_threads(1),
+	 scan_threads(1),
+	 tag_index_enabled(false), search_index_enabled(false),
+	 updating(false), cache_serial(0), n_mounts(0),
 	 cache_path(AllocatedPath::Null()),
+	 mount_idle_timeout(0), lazy(false), loaded(true), dirty(false),
+	 loop(nullptr), expire_timer(nullptr),
+	 arena(MemoryCategory::DATABASE),
+	 query_owner(ThreadId::Null()), query_depth(0),
 	 prefixed_light_song(nullptr) {
 }
 
+class SimpleDatabase::ExpireTimer final : TimeoutMonitor {
+	SimpleDatabase &db;
+
+public:
+	ExpireTimer(EventLoop &_loop, SimpleDatabase &_db)
+		:TimeoutMonitor(_loop), db(_db) {}
+
+	void Schedule(unsigned timeout) {
+		if (!IsActive())
+			/* check a few times per timeout period */
+			ScheduleSeconds(std::max(timeout / 4, 1u));
+	}
+
+	using TimeoutMonitor::Cancel;
+
+private:
+	virtual void OnTimeout() override {
+		db.UnloadIdleMounts();
+	}
+};
+
 Database *
-SimpleDatabase::Create(gcc_unused EventLoop &loop,
+SimpleDatabase::Create(EventLoop &loop,
 		       gcc_unused DatabaseListener &listener,
 		       const config_param &param, Error &error)
 {
 	SimpleDatabase *db = new SimpleDatabase();
+	db->loop = &loop;
 	if (!db->Configure(param, error)) {
 		delete db;
 		db = nullptr;
@@ -97,14 +153,62 @@ SimpleDatabase::Configure(const config_param &param, Error &error)
 
 	path_utf8 = path.ToUTF8();
 
+	journal.SetPath(AllocatedPath::FromFS((std::string(path.c_str()) +
+					       ".journal").c_str()));
+	journal_enabled = param.GetBlockValue("journal", false);
+
+	load_threads = param.GetBlockValue("load_threads", 1u);
+	if (load_threads < 1 || load_threads > 64) {
+		error.Set(simple_db_domain, "Invalid \"load_threads\" value");
+		return false;
+	}
+
+	map_file = param.GetBlockValue("mmap", false);
+
+	compress_threads = param.GetBlockValue("compress_threads", 1u);
+	if (compress_threads < 1 || compress_threads > 64) {
+		error.Set(simple_db_domain,
+			  "Invalid \"compress_threads\" value");
+		return false;
+	}
+
+	scan_threads = param.GetBlockValue("scan_threads", 1u);
+	if (scan_threads < 1 || scan_threads > 64) {
+		error.Set(simple_db_domain, "Invalid \"scan_threads\" value");
+		return false;
+	}
+
+	tag_index_enabled = param.GetBlockValue("tag_index", false);
+	search_index_enabled = param.GetBlockValue("search_index", false);
+
+	index_path = AllocatedPath::FromFS((std::string(path.c_str()) +
+					    ".index").c_str());
+
 	cache_path = param.GetBlockPath("cache_directory", error);
 	if (path.IsNull() && error.IsDefined())
 		return false;
 
+	mount_idle_timeout = param.GetBlockValue("mount_idle_timeout", 300u);
+
 #ifdef HAVE_ZLIB
 	compress = param.GetBlockValue("compress", compress);
 #endif
 
+	const char *format = param.GetBlockValue("format", "text");
+	if (strcmp(format, "binary") == 0) {
+#ifdef WIN32
+		error.Set(simple_db_domain,
+			  "The binary database format is not supported on this platform");
+		return false;
+#else
+		binary = true;
+#endif
+	} else if (strcmp(format, "text") != 0) {
+		error.Format(simple_db_domain,
+			     "Unrecognized database format: %s", format);
+		return false;
+	}
+
 	return true;
 }
 
@@ -183,20 +287,63 @@ SimpleDatabase::Load(Error &error)
 	assert(!path.IsNull());
 	assert(root != nullptr);
 
-	TextFile file(path, error);
-	if (file.HasFailed())
-		return false;
+	if (db_binary_check(path)) {
+		if (!db_load_binary(path, *root, arena, error))
+			return false;
+	} else {
+#ifdef HAVE_ZLIB
+		/* inflate a compressed file in a separate thread while
+		   parsing it */
+		const bool background = compress;
+#else
+		constexpr bool background = false;
+#endif
 
-	if (!db_load_internal(file, *root, error) || !file.Check(error))
-		return false;
+		TextFile file(path, error, background, map_file);
+		if (file.HasFailed())
+			return false;
+
+		DatabaseIndex index;
+		struct stat st;
+		bool success = load_threads > 1 && !index_path.IsNull() &&
+			StatFile(path, st) && index.Load(index_path, st)
+			? db_load_internal(file, path, index, load_threads,
+					   map_file, *root, arena, error)
+			: db_load_internal(file, *root, arena, error);
+		if (!success || !file.Check(error))
+			return false;
+	}
 
 	struct stat st;
-	if (StatFile(path, st))
+	if (StatFile(path, st)) {
 		mtime = st.st_mtime;
 
+		/* a journal is replayed even if it has been disabled
+		   meanwhile; the next Save() will then remove it */
+		if (!journal.Load(*root, st, error))
+			return false;
+
+		struct stat journal_st;
+		if (journal.IsActive() && journal.Stat(journal_st))
+			mtime = journal_st.st_mtime;
+
+		if (journal_enabled)
+			journal.Reset(*root);
+	}
+
 	return true;
 }
 
+void
+SimpleDatabase::DeleteRoot()
+{
+	delete root;
+	root = nullptr;
+
+	/* all songs in the arena have been destructed by now */
+	arena.Clear();
+}
+
 bool
 SimpleDatabase::Open(Error &error)
 {
@@ -204,13 +351,31 @@ SimpleDatabase::Open(Error &error)
 
 	root = Directory::NewRoot();
 	mtime = 0;
+	dirty = false;
 
 #ifndef NDEBUG
 	borrowed_song_count = 0;
 #endif
 
+	if (lazy) {
+		/* EnsureLoaded() will load the file on the first
+		   access */
+		if (!Check(error)) {
+			DeleteRoot();
+			return false;
+		}
+
+		struct stat st;
+		if (StatFile(path, st))
+			mtime = st.st_mtime;
+
+		loaded = !FileExists();
+		last_access = MonotonicClockS();
+		return true;
+	}
+
 	if (!Load(error)) {
-		delete root;
+		DeleteRoot();
 
 		LogError(error);
 		error.Clear();
@@ -231,37 +396,182 @@ SimpleDatabase::Close()
 	assert(prefixed_light_song == nullptr);
 	assert(borrowed_song_count == 0);
 
-	delete root;
+	delete expire_timer;
+	expire_timer = nullptr;
+	lazy_mounts.clear();
+
+	db_lock();
+	InvalidateCaches();
+	db_unlock();
+
+	DeleteRoot();
+}
+
+void
+SimpleDatabase::EnsureLoaded() const
+{
+	if (!lazy)
+		return;
+
+	{
+		const ScopeDatabaseSharedLock protect;
+		last_access = MonotonicClockS();
+		if (loaded)
+			return;
+	}
+
+	const ScopeLock protect(load_mutex);
+	if (loaded)
+		return;
+
+	FormatDebug(simple_db_domain, "loading %s", path_utf8.c_str());
+
+	/* loading the file doesn't change the logical state of this
+	   object */
+	SimpleDatabase &db = const_cast<SimpleDatabase &>(*this);
+
+	Error error;
+	if (!db.Load(error)) {
+		LogError(error);
+
+		db_lock();
+		db.DeleteRoot();
+		db.root = Directory::NewRoot();
+		db_unlock();
+	}
+
+	const ScopeDatabaseLock protect2;
+	loaded = true;
+	db.dirty = false;
+	last_access = MonotonicClockS();
+}
+
+bool
+SimpleDatabase::UnloadIfIdle(unsigned now, unsigned timeout)
+{
+	assert(lazy);
+
+	const ScopeLock protect(load_mutex);
+	const ScopeDatabaseLock protect2;
+
+	if (!loaded || updating || dirty || n_mounts > 0 ||
+	    now - last_access < timeout)
+		return false;
+
+	assert(prefixed_light_song == nullptr);
+	assert(borrowed_song_count == 0);
+
+	DeleteRoot();
+	root = Directory::NewRoot();
+	InvalidateCaches();
+	loaded = false;
+	return true;
+}
+
+void
+SimpleDatabase::UnloadIdleMounts()
+{
+	const unsigned now = MonotonicClockS();
+
+	for (SimpleDatabase *db : lazy_mounts)
+		if (db->UnloadIfIdle(now, mount_idle_timeout))
+			FormatDebug(simple_db_domain, "unloaded idle %s",
+				    db->path_utf8.c_str());
+
+	if (!lazy_mounts.empty())
+		expire_timer->Schedule(mount_idle_timeout);
+}
+
+class SimpleDatabase::ScopeQueryLock {
+	const SimpleDatabase &db;
+
+public:
+	explicit ScopeQueryLock(const SimpleDatabase &_db):db(_db) {
+		db.LockQuery();
+	}
+
+	~ScopeQueryLock() {
+		db.UnlockQuery();
+	}
+
+	ScopeQueryLock(const ScopeQueryLock &) = delete;
+	ScopeQueryLock &operator=(const ScopeQueryLock &) = delete;
+};
+
+void
+SimpleDatabase::LockQuery() const
+{
+	if (query_owner.IsInside()) {
+		/* recursive call */
+		assert(query_depth > 0);
+		++query_depth;
+		return;
+	}
+
+	query_mutex.lock();
+	assert(query_depth == 0);
+	query_owner = ThreadId::GetCurrent();
+	query_depth = 1;
+}
+
+void
+SimpleDatabase::UnlockQuery() const
+{
+	assert(query_owner.IsInside());
+	assert(query_depth > 0);
+
+	if (--query_depth == 0) {
+		query_owner = ThreadId::Null();
+		query_mutex.unlock();
+	}
 }
 
 const LightSong *
 SimpleDatabase::GetSong(const char *uri, Error &error) const
+{
+	LockQuery();
+
+	const LightSong *song = GetSongLocked(uri, error);
+	if (song == nullptr)
+		UnlockQuery();
+
+	return song;
+}
+
+const LightSong *
+SimpleDatabase::GetSongLocked(const char *uri, Error &error) const
 {
 	assert(root != nullptr);
 	assert(prefixed_light_song == nullptr);
 	assert(borrowed_song_count == 0);
 
-	db_lock();
+	EnsureLoaded();
+
+	db_lock_shared();
 
 	auto r = root->LookupDirectory(uri);
 
 	if (r.directory->IsMount()) {
 		/* pass the request to the mounted database */
-		db_unlock();
+		db_unlock_shared();
 
-		const LightSong *song =
-			r.directory->mounted_database->GetSong(r.uri, error);
+		const Database &mounted = *r.directory->mounted_database;
+		const LightSong *song = mounted.GetSong(r.uri, error);
 		if (song == nullptr)
 			return nullptr;
 
+		/* the copy refers only to the mounted database's tree,
+		   not to its GetSong() buffer, so the song can be
+		   returned right away */
 		prefixed_light_song =
 			new PrefixedLightSong(*song, r.directory->GetPath());
+		mounted.ReturnSong(song);
 		return prefixed_light_song;
 	}
 
 	if (r.uri == nullptr) {
 		/* it's a directory */
-		db_unlock();
+		db_unlock_shared();
 		error.Format(db_domain, DB_NOT_FOUND,
 			     "No such song: %s", uri);
 		return nullptr;
@@ -269,14 +579,14 @@ SimpleDatabase::GetSong(const char *uri, Error &error) const
 
 	if (strchr(r.uri, '/') != nullptr) {
 		/* refers to a URI "below" the actual song */
-		db_unlock();
+		db_unlock_shared();
 		error.Format(db_domain, DB_NOT_FOUND,
 			     "No such song: %s", uri);
 		return nullptr;
 	}
 
 	const Song *song = r.directory->FindSong(r.uri);
-	db_unlock();
+	db_unlock_shared();
 	if (song == nullptr) {
 		error.Format(db_domain, DB_NOT_FOUND,
 			     "No such song: %s", uri);
@@ -307,6 +617,8 @@ SimpleDatabase::ReturnSong(gcc_unused const LightSong *song) const
 		--borrowed_song_count;
 	}
 #endif
+
+	UnlockQuery();
 }
 
 bool
@@ -316,7 +628,27 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 		      VisitPlaylist visit_playlist,
 		      Error &error) const
 {
-	ScopeDatabaseLock protect;
+	const ScopeQueryLock query_lock(*this);
+
+	EnsureLoaded();
+
+	ScopeDatabaseSharedLock protect;
+
+	if (visit_song && !visit_directory && !visit_playlist &&
+	    selection.filter != nullptr && selection.recursive &&
+	    selection.uri.empty() && PrepareTagIndex()) {
+		const auto *songs = tag_index.Lookup(*selection.filter);
+		if (songs != nullptr) {
+			for (const Song *song : *songs) {
+				const LightSong song2 = song->Export();
+				if (selection.Match(song2) &&
+				    !visit_song(song2, error))
+					return false;
+			}
+
+			return true;
+		}
+	}
 
 	auto r = root->LookupDirectory(selection.uri.c_str());
 	if (r.uri == nullptr) {
@@ -326,6 +658,12 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 		    !visit_directory(r.directory->Export(), error))
 			return false;
 
+		if (scan_threads > 1 && n_mounts == 0 &&
+		    selection.recursive && selection.filter != nullptr &&
+		    visit_song && !visit_directory && !visit_playlist)
+			return ParallelScan(*r.directory, *selection.filter,
+					    scan_threads, visit_song, error);
+
 		return r.directory->Walk(selection.recursive, selection.filter,
 					 visit_directory, visit_song,
 					 visit_playlist,
@@ -353,6 +691,42 @@ SimpleDatabase::VisitUniqueTags(const DatabaseSelection &selection,
 				VisitTag visit_tag,
 				Error &error) const
 {
+	const ScopeQueryLock query_lock(*this);
+
+	EnsureLoaded();
+
+	if (group_mask == 0 && tag_type != TAG_ALBUM_ARTIST &&
+	    selection.recursive && selection.IsEmpty()) {
+		/* all values of this tag are keys in the index */
+		std::set<std::string> values;
+		bool indexed;
+
+		db_lock_shared();
+		indexed = PrepareTagIndex();
+		if (indexed)
+			tag_index.ForEachValue(tag_type,
+					       [&values](const char *value){
+						       values.emplace(value);
+					       });
+		db_unlock_shared();
+
+		if (indexed) {
+			for (const auto &value : values) {
+				TagBuilder builder;
+				if (value.empty())
+					builder.AddEmptyItem(tag_type);
+				else
+					builder.AddItem(tag_type,
+							value.c_str());
+
+				if (!visit_tag(builder.Commit(), error))
+					return false;
+			}
+
+			return true;
+		}
+	}
+
 	return ::VisitUniqueTags(*this, selection, tag_type, group_mask,
 				 visit_tag,
 				 error);
@@ -362,11 +736,120 @@ bool
 SimpleDatabase::GetStats(const DatabaseSelection &selection,
 			 DatabaseStats &stats, Error &error) const
 {
-	return ::GetStats(*this, selection, stats, error);
+	const ScopeQueryLock query_lock(*this);
+
+	EnsureLoaded();
+
+	if (!selection.recursive || selection.HasOtherThanBase())
+		return ::GetStats(*this, selection, stats, error);
+
+	/* a "base" filter item selects a directory, too */
+	std::string uri = selection.uri;
+	if (selection.filter != nullptr && !selection.filter->IsEmpty()) {
+		if (!uri.empty())
+			return ::GetStats(*this, selection, stats, error);
+
+		uri = selection.filter->GetBase();
+	}
+
+	const Directory *directory = nullptr;
+	unsigned serial = 0;
+
+	db_lock_shared();
+	if (!updating && n_mounts == 0) {
+		const auto r = root->LookupDirectory(uri.c_str());
+		if (r.uri == nullptr) {
+			directory = r.directory;
+			serial = cache_serial;
+
+			const auto i = stats_cache.find(directory);
+			if (i != stats_cache.end()) {
+				stats = i->second;
+				db_unlock_shared();
+				return true;
+			}
+		}
+	}
+	db_unlock_shared();
+
+	if (!::GetStats(*this, selection, stats, error))
+		return false;
+
+	if (directory != nullptr) {
+		/* it was unlocked meanwhile; store the result only if
+		   nothing has been modified */
+		const ScopeDatabaseSharedLock protect;
+		if (!updating && serial == cache_serial)
+			stats_cache[directory] = stats;
+	}
+
+	return true;
+}
+
+bool
+SimpleDatabase::PrepareTagIndex() const
+{
+	assert(holding_db_lock());
+
+	if ((!tag_index_enabled && !search_index_enabled) || updating)
+		return false;
+
+	if (!tag_index.IsValid()) {
+		LogDebug(simple_db_domain, "building tag index");
+		tag_index.Build(*root, search_index_enabled);
+	}
+
+	return tag_index.IsComplete();
+}
+
+void
+SimpleDatabase::InvalidateCaches()
+{
+	tag_index.Clear();
+	stats_cache.clear();
+	++cache_serial;
+}
+
+void
+SimpleDatabase::BeginUpdate()
+{
+	EnsureLoaded();
+
+	const ScopeDatabaseLock protect;
+	updating = true;
+	InvalidateCaches();
+}
+
+void
+SimpleDatabase::EndUpdate(bool modified)
+{
+	const ScopeDatabaseLock protect;
+	updating = false;
+	dirty |= modified;
+	last_access = MonotonicClockS();
 }
 
 bool
 SimpleDatabase::Save(Error &error)
+{
+	/* UnloadIfIdle() must not discard the tree meanwhile */
+	const ScopeLock protect(load_mutex);
+
+	if (!loaded)
+		/* the file has not been loaded, so there's nothing
+		   new to save */
+		return true;
+
+	if (!SaveTree(error))
+		return false;
+
+	const ScopeDatabaseLock protect2;
+	dirty = false;
+	return true;
+}
+
+inline bool
+SimpleDatabase::SaveTree(Error &error)
 {
 	db_lock();
 
@@ -376,10 +859,61 @@ SimpleDatabase::Save(Error &error)
 	LogDebug(simple_db_domain, "sorting DB");
 	root->Sort();
 
+	/* the order of the songs has changed */
+	InvalidateCaches();
+
 	db_unlock();
 
+	if (journal_enabled && journal.IsActive()) {
+		/* rewrite the database file only when the journal
+		   has grown to half of its size */
+		struct stat st, journal_st;
+		if (StatFile(path, st) && journal.Stat(journal_st) &&
+		    journal_st.st_size < st.st_size / 2) {
+			LogDebug(simple_db_domain, "appending to journal");
+			if (!journal.Append(*root, error))
+				return false;
+
+			if (journal.Stat(journal_st))
+				mtime = journal_st.st_mtime;
+			return true;
+		}
+	}
+
+	if (!SaveFile(error))
+		return false;
+
+	struct stat st;
+	if (!StatFile(path, st))
+		return true;
+
+	mtime = st.st_mtime;
+
+	if (journal_enabled)
+		return journal.Create(*root, st, error);
+
+	journal.Remove();
+	return true;
+}
+
+bool
+SimpleDatabase::SaveFile(Error &error)
+{
 	LogDebug(simple_db_domain, "writing DB");
 
+	/* an index can only be used to seek in an uncompressed text
+	   file */
+	const bool with_index = load_threads > 1 && !index_path.IsNull() &&
+#ifdef HAVE_ZLIB
+		!compress &&
+#endif
+		!binary;
+
+	/* never leave an index behind which may not match the new
+	   file */
+	if (!index_path.IsNull() && ::FileExists(index_path))
+		RemoveFile(index_path);
+
 	FileOutputStream fos(path, error);
 	if (!fos.IsDefined())
 		return false;
@@ -388,7 +922,20 @@ SimpleDatabase::Save(Error &error)
 
 #ifdef HAVE_ZLIB
 	GzipOutputStream *gzip = nullptr;
-	if (compress) {
+	ParallelGzipOutputStream *parallel_gzip = nullptr;
+	/* the binary format is never compressed, because it gets
+	   mapped into memory */
+	if (compress && !binary && compress_threads > 1) {
+		parallel_gzip = new ParallelGzipOutputStream(*os,
+							     compress_threads,
+							     error);
+		if (!parallel_gzip->IsDefined()) {
+			delete parallel_gzip;
+			return false;
+		}
+
+		os = parallel_gzip;
+	} else if (compress && !binary) {
 		gzip = new GzipOutputStream(*os, error);
 		if (!gzip->IsDefined()) {
 			delete gzip;
@@ -401,30 +948,51 @@ SimpleDatabase::Save(Error &error)
 
 	BufferedOutputStream bos(*os);
 
-	db_save_internal(bos, *root);
+	DatabaseIndex index;
 
-	if (!bos.Flush(error)) {
+	bool success = true;
+	if (binary)
+		success = db_save_binary(bos, *root, error);
+	else
+		db_save_internal(bos, *root, with_index ? &index : nullptr);
+
+	if (!success || !bos.Flush(error)) {
 #ifdef HAVE_ZLIB
 		delete gzip;
+		delete parallel_gzip;
 #endif
 		return false;
 	}
 
 #ifdef HAVE_ZLIB
 	if (gzip != nullptr) {
-		bool success = gzip->Flush(error);
+		success = gzip->Flush(error);
 		delete gzip;
 		if (!success)
 			return false;
 	}
+
+	if (parallel_gzip != nullptr) {
+		success = parallel_gzip->Flush(error);
+		delete parallel_gzip;
+		if (!success)
+			return false;
+	}
 #endif
 
 	if (!fos.Commit(error))
 		return false;
 
-	struct stat st;
-	if (StatFile(path, st))
-		mtime = st.st_mtime;
+	if (with_index) {
+		/* without the index, the next startup will just be
+		   slower */
+		Error index_error;
+		struct stat st;
+		if (!StatFile(path, st))
+			LogErrno(simple_db_domain, "Failed to stat database");
+		else if (!index.Save(index_path, st, index_error))
+			LogError(index_error);
+	}
 
 	return true;
 }
@@ -453,6 +1021,8 @@ SimpleDatabase::Mount(const char *uri, Database *db, Error &error)
 
 	Directory *mnt = r.directory->CreateChild(r.uri);
 	mnt->mounted_database = db;
+	++n_mounts;
+	InvalidateCaches();
 	return true;
 }
 
@@ -483,10 +1053,18 @@ SimpleDatabase::Mount(const char *local_uri, const char *storage_uri,
 
 #ifndef HAVE_ZLIB
 	constexpr bool compress = false;
+#endif
+#ifdef WIN32
+	const bool cache_binary = binary;
+#else
+	/* the binary format is mapped into memory, which makes
+	   reloading an unloaded database cheap */
+	constexpr bool cache_binary = true;
 #endif
 	auto db = new SimpleDatabase(AllocatedPath::Build(cache_path,
 							  name.c_str()),
-				     compress);
+				     compress, cache_binary);
+	db->lazy = mount_idle_timeout > 0 && loop != nullptr;
 	if (!db->Open(error)) {
 		delete db;
 		return false;
@@ -500,6 +1078,14 @@ SimpleDatabase::Mount(const char *local_uri, const char *storage_uri,
 		return false;
 	}
 
+	if (db->lazy) {
+		lazy_mounts.push_back(db);
+
+		if (expire_timer == nullptr)
+			expire_timer = new ExpireTimer(*loop, *this);
+		expire_timer->Schedule(mount_idle_timeout);
+	}
+
 	return true;
 }
 
@@ -515,6 +1101,8 @@ SimpleDatabase::LockUmountSteal(const char *uri)
 	Database *db = r.directory->mounted_database;
 	r.directory->mounted_database = nullptr;
 	r.directory->Delete();
+	--n_mounts;
+	InvalidateCaches();
 
 	return db;
 }
@@ -526,6 +1114,12 @@ SimpleDatabase::Unmount(const char *uri)
 	if (db == nullptr)
 		return false;
 
+	lazy_mounts.remove_if([db](const SimpleDatabase *i){
+			return i == db;
+		});
+	if (lazy_mounts.empty() && expire_timer != nullptr)
+		expire_timer->Cancel();
+
 	db->Close();
 	delete db;
 	return true;
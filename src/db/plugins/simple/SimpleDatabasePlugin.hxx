@@ -21,11 +21,20 @@
 #define MPD_SIMPLE_DATABASE_PLUGIN_HXX
 
 #include "check.h"
+#include "DatabaseJournal.hxx"
+#include "TagIndex.hxx"
 #include "db/Interface.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "db/LightSong.hxx"
+#include "db/Stats.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Id.hxx"
+#include "util/Arena.hxx"
 #include "Compiler.h"
 
+#include <unordered_map>
+#include <list>
+
 #include <cassert>
 
 struct config_param;
@@ -43,15 +52,193 @@ class SimpleDatabase : public Database {
 	bool compress;
 #endif
 
+	/**
+	 * Save the database in the binary format (see
+	 * DatabaseBinary.hxx)?  Loading detects the format
+	 * automatically.
+	 */
+	bool binary;
+
+	/**
+	 * Append changes to the #journal instead of rewriting the
+	 * database file after each update?
+	 */
+	bool journal_enabled;
+
+	DatabaseJournal journal;
+
+	/**
+	 * The number of threads which parse the database file.  If
+	 * this is more than one, a #DatabaseIndex is saved next to
+	 * an uncompressed text database file, at #index_path.
+	 */
+	unsigned load_threads;
+
+	/**
+	 * Map the uncompressed text database file into memory while
+	 * loading it?
+	 */
+	bool map_file;
+
+	AllocatedPath index_path;
+
+	/**
+	 * The number of threads which compress the database file.  If
+	 * this is more than one, #ParallelGzipOutputStream is used.
+	 */
+	unsigned compress_threads;
+
+	/**
+	 * The number of threads which evaluate the filter of a
+	 * recursive song search which cannot be answered from the
+	 * #tag_index.
+	 */
+	unsigned scan_threads;
+
+	/**
+	 * Answer "find" and "list" requests from the #tag_index?
+	 */
+	bool tag_index_enabled;
+
+	/**
+	 * Add a trigram index for "search" requests to the
+	 * #tag_index?
+	 */
+	bool search_index_enabled;
+
+	/**
+	 * Is the update thread modifying the directory tree right
+	 * now?  The #tag_index is not used meanwhile.
+	 *
+	 * Protected by #db_mutex.
+	 */
+	bool updating;
+
+	/**
+	 * Built on demand, and cleared whenever the directory tree
+	 * gets modified.
+	 *
+	 * Protected by #db_mutex.  Holding it in shared mode is
+	 * enough for building the index, because the update thread
+	 * never uses it, and all other callers hold the
+	 * #query_mutex.
+	 */
+	mutable TagIndex tag_index;
+
+	/**
+	 * GetStats() results for whole directories (recursive and
+	 * without a filter), cleared together with the #tag_index.
+	 *
+	 * Protected by #db_mutex, just like the #tag_index.
+	 */
+	mutable std::unordered_map<const Directory *,
+				   DatabaseStats> stats_cache;
+
+	/**
+	 * Incremented by InvalidateCaches(), so GetStats() can tell
+	 * whether the tree was modified while it was unlocked.
+	 *
+	 * Protected by #db_mutex.
+	 */
+	unsigned cache_serial;
+
+	/**
+	 * The number of databases mounted into this one.  Results
+	 * which include them are not cached, because they are
+	 * updated independently.
+	 */
+	unsigned n_mounts;
+
 	/**
 	 * The path where cache files for Mount() are located.
 	 */
 	AllocatedPath cache_path;
 
+	/**
+	 * Databases mounted via Mount(const char *, const char *)
+	 * are unloaded after they have not been used for this number
+	 * of seconds.  0 keeps them in memory all the time.
+	 */
+	unsigned mount_idle_timeout;
+
+	/**
+	 * Is this a mounted database whose file is loaded only on
+	 * demand (see EnsureLoaded())?
+	 */
+	bool lazy;
+
+	/**
+	 * Has the database file been loaded into #root?  Always true
+	 * unless #lazy is set.
+	 *
+	 * Protected by #db_mutex, and modified only while holding
+	 * #load_mutex, too.
+	 */
+	mutable bool loaded;
+
+	/**
+	 * Has the tree been modified since it was loaded or saved?
+	 * Then it must not be unloaded.
+	 *
+	 * Protected by #db_mutex.
+	 */
+	bool dirty;
+
+	/**
+	 * The MonotonicClockS() value of the last access to a #lazy
+	 * database.
+	 *
+	 * Protected by #db_mutex; it is modified while holding the
+	 * lock in shared mode only by callers which also hold the
+	 * #query_mutex.
+	 */
+	mutable unsigned last_access;
+
+	/**
+	 * Serializes EnsureLoaded() and UnloadIfIdle().
+	 */
+	mutable Mutex load_mutex;
+
+	/**
+	 * The #lazy databases mounted into this one.
+	 */
+	std::list<SimpleDatabase *> lazy_mounts;
+
+	EventLoop *loop;
+
+	class ExpireTimer;
+
+	/**
+	 * Calls UnloadIdleMounts() periodically while there are
+	 * #lazy_mounts.
+	 */
+	ExpireTimer *expire_timer;
+
+	/**
+	 * The songs loaded from the database file are allocated from
+	 * here; it is cleared together with the #root.
+	 */
+	Arena arena;
+
 	Directory *root;
 
 	time_t mtime;
 
+	/**
+	 * Serializes queries (GetSong(), Visit(), VisitUniqueTags()
+	 * and GetStats()): the #tag_index, the #stats_cache and the
+	 * GetSong() buffers support only one caller at a time, but
+	 * client commands may be executed in worker threads (see
+	 * client/ClientWorker.hxx).  It is recursive (#query_owner,
+	 * #query_depth), because GetStats() calls Visit().  A
+	 * successful GetSong() keeps it locked until ReturnSong().
+	 */
+	mutable Mutex query_mutex;
+	mutable ThreadId query_owner;
+	mutable unsigned query_depth;
+
+	class ScopeQueryLock;
+
 	/**
 	 * A buffer for GetSong() when prefixing the #LightSong
 	 * instance from a mounted #Database.
@@ -69,7 +256,7 @@ class SimpleDatabase : public Database {
 
 	SimpleDatabase();
 
-	SimpleDatabase(AllocatedPath &&_path, bool _compress);
+	SimpleDatabase(AllocatedPath &&_path, bool _compress, bool _binary);
 
 public:
 	static Database *Create(EventLoop &loop, DatabaseListener &listener,
@@ -85,6 +272,21 @@ public:
 
 	bool Save(Error &error);
 
+	/**
+	 * The caller (the update thread) is going to modify the
+	 * directory tree.  Must be followed by EndUpdate().
+	 *
+	 * Caller must NOT lock the #db_mutex.
+	 */
+	void BeginUpdate();
+
+	/**
+	 * Caller must NOT lock the #db_mutex.
+	 *
+	 * @param modified has the directory tree been modified?
+	 */
+	void EndUpdate(bool modified);
+
 	/**
 	 * Returns true if there is a valid database file on the disk.
 	 */
@@ -141,6 +343,66 @@ private:
 
 	bool Load(Error &error);
 
+	/**
+	 * Delete the #root tree and release the #arena.
+	 */
+	void DeleteRoot();
+
+	/**
+	 * Load the database file of a #lazy database if that has not
+	 * been done yet.  Errors are logged, and leave an empty
+	 * tree, just like Open() does.
+	 *
+	 * Caller must NOT lock the #db_mutex.
+	 */
+	void EnsureLoaded() const;
+
+	/**
+	 * Unload the #lazy database if it has been loaded and not
+	 * been used for the given number of seconds, and if it has
+	 * no unsaved modifications.
+	 *
+	 * Caller must NOT lock the #db_mutex.
+	 *
+	 * @return true if the database was unloaded
+	 */
+	bool UnloadIfIdle(unsigned now, unsigned timeout);
+
+	void UnloadIdleMounts();
+
+	void LockQuery() const;
+	void UnlockQuery() const;
+
+	const LightSong *GetSongLocked(const char *uri_utf8,
+				       Error &error) const;
+
+	/**
+	 * Build the #tag_index if necessary.
+	 *
+	 * Caller must lock the #db_mutex.
+	 *
+	 * @return false if it cannot be used right now
+	 */
+	bool PrepareTagIndex() const;
+
+	/**
+	 * The directory tree has been modified: clear the
+	 * #tag_index and the #stats_cache.
+	 *
+	 * Caller must lock the #db_mutex.
+	 */
+	void InvalidateCaches();
+
+	/**
+	 * Write the tree to the journal or the database file.
+	 */
+	bool SaveTree(Error &error);
+
+	/**
+	 * Rewrite the whole database file.
+	 */
+	bool SaveFile(Error &error);
+
 	Database *LockUmountSteal(const char *uri);
 };
 
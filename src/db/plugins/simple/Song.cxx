@@ -22,7 +22,10 @@
 #include "Directory.hxx"
 #include "tag/Tag.hxx"
 #include "util/VarSize.hxx"
+#include "util/Arena.hxx"
+#include "util/MemoryStats.hxx"
 #include "DetachedSong.hxx"
+#include "MixRampInfo.hxx"
 #include "db/LightSong.hxx"
 
 #include <assert.h>
@@ -30,13 +33,25 @@
 #include <stdlib.h>
 
 inline Song::Song(const char *_uri, size_t uri_length, Directory &_parent)
-	:parent(&_parent), mtime(0), start_ms(0), end_ms(0)
+	:replay_gain(ReplayGainInfo::Undefined()), mix_ramp(nullptr),
+	 parent(&_parent), mtime(0), start_ms(0), end_ms(0),
+	 in_arena(false)
 {
 	memcpy(uri, _uri, uri_length + 1);
 }
 
 inline Song::~Song()
 {
+	delete mix_ramp;
+}
+
+/**
+ * The size of a #Song allocated on the heap, for #MemoryStats.
+ */
+static constexpr size_t
+song_alloc_size(size_t uri_length)
+{
+	return sizeof(Song) - sizeof(Song::uri) + uri_length + 1;
 }
 
 static Song *
@@ -48,32 +63,94 @@ song_alloc(const char *uri, Directory &parent)
 	uri_length = strlen(uri);
 	assert(uri_length);
 
+	MemoryStatsAdd(MemoryCategory::DATABASE, song_alloc_size(uri_length));
+
 	return NewVarSize<Song>(sizeof(Song::uri),
 				uri_length + 1,
 				uri, uri_length, parent);
 }
 
-Song *
-Song::NewFrom(DetachedSong &&other, Directory &parent)
+static Song *
+song_alloc(const char *uri, Directory &parent, Arena &arena)
+{
+	size_t uri_length;
+
+	assert(uri);
+	uri_length = strlen(uri);
+	assert(uri_length);
+
+	void *p = arena.Allocate(sizeof(Song) - sizeof(Song::uri) +
+				 uri_length + 1);
+	Song *song = new(p) Song(uri, uri_length, parent);
+	song->in_arena = true;
+	return song;
+}
+
+static Song *
+song_init(Song *song, DetachedSong &&other)
 {
-	Song *song = song_alloc(other.GetURI(), parent);
 	song->tag = std::move(other.WritableTag());
+	song->replay_gain = other.GetReplayGain();
+	if (other.GetMixRamp().IsDefined())
+		song->SetMixRamp(other.GetMixRamp());
 	song->mtime = other.GetLastModified();
 	song->start_ms = other.GetStartMS();
 	song->end_ms = other.GetEndMS();
 	return song;
 }
 
+Song *
+Song::NewFrom(DetachedSong &&other, Directory &parent)
+{
+	return song_init(song_alloc(other.GetURI(), parent),
+			 std::move(other));
+}
+
+Song *
+Song::NewFrom(DetachedSong &&other, Directory &parent, Arena &arena)
+{
+	return song_init(song_alloc(other.GetURI(), parent, arena),
+			 std::move(other));
+}
+
 Song *
 Song::NewFile(const char *path, Directory &parent)
 {
 	return song_alloc(path, parent);
 }
 
+Song *
+Song::NewFile(const char *path, Directory &parent, Arena &arena)
+{
+	return song_alloc(path, parent, arena);
+}
+
 void
 Song::Free()
 {
-	DeleteVarSize(this);
+	if (in_arena)
+		this->Song::~Song();
+	else {
+		MemoryStatsSub(MemoryCategory::DATABASE,
+			       song_alloc_size(strlen(uri)));
+		DeleteVarSize(this);
+	}
+}
+
+void
+Song::SetMixRamp(const MixRampInfo &value)
+{
+	if (mix_ramp == nullptr)
+		mix_ramp = new MixRampInfo(value);
+	else
+		*mix_ramp = value;
+}
+
+void
+Song::ClearMixRamp()
+{
+	delete mix_ramp;
+	mix_ramp = nullptr;
 }
 
 std::string
@@ -104,6 +181,8 @@ Song::Export() const
 	dest.uri = uri;
 	dest.real_uri = nullptr;
 	dest.tag = &tag;
+	dest.replay_gain = replay_gain.IsDefined() ? &replay_gain : nullptr;
+	dest.mix_ramp = mix_ramp;
 	dest.mtime = mtime;
 	dest.start_ms = start_ms;
 	dest.end_ms = end_ms;
@@ -21,6 +21,7 @@
 #define MPD_SONG_HXX
 
 #include "tag/Tag.hxx"
+#include "ReplayGainInfo.hxx"
 #include "Compiler.h"
 
 #include <boost/intrusive/list.hpp>
@@ -34,6 +35,8 @@ struct LightSong;
 struct Directory;
 class DetachedSong;
 class Storage;
+class Arena;
+class MixRampInfo;
 
 /**
  * A song file inside the configured music directory.  Internal
@@ -62,6 +65,21 @@ struct Song {
 
 	Tag tag;
 
+	/**
+	 * Replay gain values computed by ReplayGainAnalyzer.  They
+	 * are only used for files without replay gain tags.
+	 */
+	ReplayGainInfo replay_gain;
+
+	/**
+	 * MixRamp envelopes computed by ReplayGainAnalyzer, or
+	 * nullptr if there are none.  They are only used for files
+	 * without MixRamp tags.  This object is allocated on the heap
+	 * only when needed, because most songs in a database without
+	 * analysis do not have one.
+	 */
+	MixRampInfo *mix_ramp;
+
 	/**
 	 * The #Directory that contains this song.  Must be
 	 * non-nullptr.  directory this way.
@@ -82,9 +100,17 @@ struct Song {
 	unsigned end_ms;
 
 	/**
-	 * The file name.
+	 * Was this object allocated from an #Arena?  Then Free() only
+	 * calls the destructor, and the memory is released together
+	 * with the arena.
+	 */
+	bool in_arena;
+
+	/**
+	 * The file name.  Its declared size only fills the padding
+	 * after #in_arena.
 	 */
-	char uri[sizeof(int)];
+	char uri[sizeof(int) - sizeof(bool)];
 
 	Song(const char *_uri, size_t uri_length, Directory &parent);
 	~Song();
@@ -92,10 +118,26 @@ struct Song {
 	gcc_malloc
 	static Song *NewFrom(DetachedSong &&other, Directory &parent);
 
+	/**
+	 * Like NewFrom(), but allocate the object from the given
+	 * #Arena, which must outlive it.
+	 */
+	gcc_malloc
+	static Song *NewFrom(DetachedSong &&other, Directory &parent,
+			     Arena &arena);
+
 	/** allocate a new song with a local file name */
 	gcc_malloc
 	static Song *NewFile(const char *path_utf8, Directory &parent);
 
+	/**
+	 * Like NewFile(), but allocate the object from the given
+	 * #Arena, which must outlive it.
+	 */
+	gcc_malloc
+	static Song *NewFile(const char *path_utf8, Directory &parent,
+			     Arena &arena);
+
 	/**
 	 * allocate a new song structure with a local file name and attempt to
 	 * load its metadata.  If all decoder plugin fail to read its meta
@@ -107,6 +149,9 @@ struct Song {
 
 	void Free();
 
+	void SetMixRamp(const MixRampInfo &value);
+	void ClearMixRamp();
+
 	bool UpdateFile(Storage &storage);
 	bool UpdateFileInArchive(const Storage &storage);
 
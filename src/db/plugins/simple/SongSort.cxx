@@ -23,86 +23,91 @@
 #include "tag/Tag.hxx"
 #include "lib/icu/Collate.hxx"
 
-#include <stdlib.h>
+#include <algorithm>
+#include <string>
+#include <vector>
 
-static int
-compare_utf8_string(const char *a, const char *b)
-{
-	if (a == nullptr)
-		return b == nullptr ? 0 : -1;
-
-	if (b == nullptr)
-		return 1;
-
-	return IcuCollate(a, b);
-}
+#include <string.h>
 
 /**
- * Compare two string tag values, ignoring case.  Either one may be
- * nullptr.
+ * The attributes of a #Song which determine its position, prepared
+ * for cheap comparisons.
  */
-static int
-compare_string_tag_item(const Tag &a, const Tag &b,
-			TagType type)
-{
-	return compare_utf8_string(a.GetValue(type),
-				   b.GetValue(type));
-}
+struct SongSortKey {
+	/**
+	 * An index into the collation keys of album names.  Zero
+	 * means the song has no album tag.
+	 */
+	unsigned album;
 
-/**
- * Compare two tag values which should contain an integer value
- * (e.g. disc or track number).  Either one may be nullptr.
- */
-static int
-compare_number_string(const char *a, const char *b)
-{
-	long ai = a == nullptr ? 0 : strtol(a, nullptr, 10);
-	long bi = b == nullptr ? 0 : strtol(b, nullptr, 10);
+	/**
+	 * The disc and track numbers; zero if missing or invalid.
+	 */
+	unsigned disc, track;
 
-	if (ai <= 0)
-		return bi <= 0 ? 0 : -1;
-
-	if (bi <= 0)
-		return 1;
-
-	return ai - bi;
-}
-
-static int
-compare_tag_item(const Tag &a, const Tag &b, TagType type)
-{
-	return compare_number_string(a.GetValue(type),
-				     b.GetValue(type));
-}
+	Song *song;
+};
 
 /* Only used for sorting/searchin a songvec, not general purpose compares */
-gcc_pure
-static bool
-song_cmp(const Song &a, const Song &b)
-{
-	int ret;
-
-	/* first sort by album */
-	ret = compare_string_tag_item(a.tag, b.tag, TAG_ALBUM);
-	if (ret != 0)
-		return ret < 0;
-
-	/* then sort by disc */
-	ret = compare_tag_item(a.tag, b.tag, TAG_DISC);
-	if (ret != 0)
-		return ret < 0;
-
-	/* then by track number */
-	ret = compare_tag_item(a.tag, b.tag, TAG_TRACK);
-	if (ret != 0)
-		return ret < 0;
-
-	/* still no difference?  compare file name */
-	return IcuCollate(a.uri, b.uri) < 0;
-}
+struct SongSortCompare {
+	const std::vector<std::string> &albums;
+
+	gcc_pure
+	bool operator()(const SongSortKey &a, const SongSortKey &b) const {
+		/* first sort by album */
+		if (a.album != b.album) {
+			int ret = albums[a.album].compare(albums[b.album]);
+			if (ret != 0)
+				return ret < 0;
+		}
+
+		/* then sort by disc */
+		if (a.disc != b.disc)
+			return a.disc < b.disc;
+
+		/* then by track number */
+		if (a.track != b.track)
+			return a.track < b.track;
+
+		/* still no difference?  compare file name */
+		return IcuCollate(a.song->uri, b.song->uri) < 0;
+	}
+};
 
 void
 song_list_sort(SongList &songs)
 {
-	songs.sort(song_cmp);
+	if (songs.empty() || std::next(songs.begin()) == songs.end())
+		/* nothing to sort */
+		return;
+
+	/* generate the (expensive) collation keys only once per
+	   album name, not for each comparison; consecutive songs
+	   usually belong to the same album */
+	std::vector<std::string> albums;
+	albums.emplace_back();
+	const char *previous_album = nullptr;
+
+	std::vector<SongSortKey> keys;
+	for (auto &song : songs) {
+		const char *album = song.tag.GetValue(TAG_ALBUM);
+		if (album != nullptr &&
+		    (previous_album == nullptr ||
+		     strcmp(album, previous_album) != 0))
+			albums.emplace_back(IcuCollateKey(album));
+		previous_album = album;
+
+		keys.push_back({
+			album != nullptr ? unsigned(albums.size() - 1) : 0u,
+			song.tag.GetNumber(TAG_DISC),
+			song.tag.GetNumber(TAG_TRACK),
+			&song,
+		});
+	}
+
+	std::stable_sort(keys.begin(), keys.end(), SongSortCompare{albums});
+
+	songs.clear();
+	for (const auto &key : keys)
+		songs.push_back(*key.song);
 }
@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "TagIndex.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "SongFilter.hxx"
+#include "db/DatabaseLock.hxx"
+#include "tag/TagPool.hxx"
+#include "tag/TagSettings.h"
+#include "lib/icu/Collate.hxx"
+
+#include <algorithm>
+#include <iterator>
+
+#include <assert.h>
+#include <string.h>
+
+void
+TagIndex::Clear()
+{
+	for (auto &map : maps)
+		map.clear();
+
+	songs.clear();
+	trigrams.clear();
+	candidates.clear();
+
+	valid = false;
+}
+
+/**
+ * The trigrams of tag values and of URIs are kept apart, because
+ * only "file" filters look at the URI.
+ */
+enum class TrigramField : uint32_t {
+	TAG,
+	URI,
+};
+
+static constexpr uint32_t
+TrigramKey(TrigramField field, const char *p)
+{
+	return (uint32_t(field) << 24) |
+		(uint32_t((unsigned char)p[0]) << 16) |
+		(uint32_t((unsigned char)p[1]) << 8) |
+		uint32_t((unsigned char)p[2]);
+}
+
+static void
+CollectTrigrams(std::vector<uint32_t> &keys, TrigramField field,
+		const char *s, size_t length)
+{
+	for (size_t i = 0; i + 3 <= length; ++i)
+		keys.push_back(TrigramKey(field, s + i));
+}
+
+void
+TagIndex::AddTrigrams(uint32_t position, const Song &song)
+{
+	std::vector<uint32_t> keys;
+
+	for (const auto &item : song.tag) {
+		const char *folded = tag_pool_get_folded(&item, IcuCaseFold);
+		CollectTrigrams(keys, TrigramField::TAG,
+				folded, strlen(folded));
+	}
+
+	const std::string uri = IcuCaseFold(song.GetURI().c_str());
+	CollectTrigrams(keys, TrigramField::URI, uri.data(), uri.length());
+
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+	for (const auto key : keys)
+		trigrams[key].push_back(position);
+}
+
+void
+TagIndex::Add(const Directory &directory)
+{
+	if (directory.IsMount()) {
+		has_mounts = true;
+		return;
+	}
+
+	for (const auto &song : directory.songs) {
+		++n_songs;
+
+		if (with_trigrams) {
+			AddTrigrams(songs.size(), song);
+			songs.push_back(&song);
+		}
+
+		bool seen[TAG_NUM_OF_ITEM_TYPES];
+		std::fill_n(seen, size_t(TAG_NUM_OF_ITEM_TYPES), false);
+
+		for (const auto &item : song.tag) {
+			if (ignore_tag_items[item.type])
+				continue;
+
+			if (!seen[item.type]) {
+				seen[item.type] = true;
+				++n_tagged[item.type];
+			}
+
+			auto &v = maps[item.type][item.value];
+
+			/* a song may have the same value twice */
+			if (v.empty() || v.back() != &song)
+				v.push_back(&song);
+		}
+	}
+
+	for (const auto &child : directory.children)
+		Add(child);
+}
+
+void
+TagIndex::Build(const Directory &root, bool _with_trigrams)
+{
+	assert(holding_db_lock());
+
+	Clear();
+
+	with_trigrams = _with_trigrams;
+
+	std::fill_n(n_tagged, size_t(TAG_NUM_OF_ITEM_TYPES), 0u);
+	n_songs = 0;
+	has_mounts = false;
+
+	Add(root);
+
+	valid = true;
+}
+
+const TagIndex::SongVector *
+TagIndex::Lookup(const SongFilter &filter) const
+{
+	assert(holding_db_lock());
+	assert(valid);
+
+	const SongVector *result = nullptr;
+
+	for (const auto &item : filter.GetItems()) {
+		const unsigned tag = item.GetTag();
+
+		/* an empty value matches songs without this tag, and
+		   "AlbumArtist" falls back to "Artist"; these are not
+		   in the index */
+		if (tag >= TAG_NUM_OF_ITEM_TYPES || item.GetFoldCase() ||
+		    item.GetValue().empty() || tag == TAG_ALBUM_ARTIST ||
+		    ignore_tag_items[tag])
+			continue;
+
+		const auto i = maps[tag].find(item.GetValue());
+		if (i == maps[tag].end())
+			return &none;
+
+		/* all items must match; the rarest value eliminates
+		   the most songs */
+		if (result == nullptr || i->second.size() < result->size())
+			result = &i->second;
+	}
+
+	if (result == nullptr && with_trigrams)
+		result = LookupTrigrams(filter);
+
+	return result;
+}
+
+const TagIndex::SongVector *
+TagIndex::LookupTrigrams(const SongFilter &filter) const
+{
+	std::vector<const PostingList *> lists;
+
+	for (const auto &item : filter.GetItems()) {
+		const unsigned tag = item.GetTag();
+
+		TrigramField field;
+		if (tag < TAG_NUM_OF_ITEM_TYPES || tag == LOCATE_TAG_ANY_TYPE)
+			field = TrigramField::TAG;
+		else if (tag == LOCATE_TAG_FILE_TYPE)
+			field = TrigramField::URI;
+		else
+			continue;
+
+		/* the value of a case folded item is folded already;
+		   a value shorter than a trigram cannot be looked
+		   up */
+		const std::string &value = item.GetValue();
+		if (!item.GetFoldCase() || value.length() < 3)
+			continue;
+
+		std::vector<uint32_t> keys;
+		CollectTrigrams(keys, field, value.data(), value.length());
+		std::sort(keys.begin(), keys.end());
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+		for (const auto key : keys) {
+			const auto i = trigrams.find(key);
+			if (i == trigrams.end())
+				return &none;
+
+			lists.push_back(&i->second);
+		}
+	}
+
+	if (lists.empty())
+		return nullptr;
+
+	/* intersect, beginning with the shortest list */
+
+	std::sort(lists.begin(), lists.end(),
+		  [](const PostingList *a, const PostingList *b){
+			  return a->size() < b->size();
+		  });
+
+	PostingList result(*lists.front()), tmp;
+	for (auto i = std::next(lists.begin());
+	     i != lists.end() && !result.empty(); ++i) {
+		tmp.clear();
+		std::set_intersection(result.begin(), result.end(),
+				      (*i)->begin(), (*i)->end(),
+				      std::back_inserter(tmp));
+		result.swap(tmp);
+	}
+
+	candidates.clear();
+	for (const auto position : result)
+		candidates.push_back(songs[position]);
+
+	return &candidates;
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_TAG_INDEX_HXX
+#define MPD_TAG_INDEX_HXX
+
+#include "check.h"
+#include "tag/TagType.h"
+#include "Compiler.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <stdint.h>
+
+struct Directory;
+struct Song;
+class SongFilter;
+
+/**
+ * An inverted index which maps tag values to the songs which have
+ * them.  It allows answering "find" and "list" requests without
+ * testing each song in the database.
+ *
+ * It is built from a #Directory tree, and the songs of each value
+ * are in the order which Directory::Walk() visits them, so results
+ * come in the same order as with a full scan.  The index does not
+ * follow mount points.
+ *
+ * Optionally, it also contains a trigram index over the case-folded
+ * tag values and song URIs, which finds candidates for "search"
+ * (substring) filters.
+ *
+ * It is not updated when the tree is modified; it must be cleared
+ * instead, and the owner builds it again when it is needed.  All
+ * methods require the caller to lock the #db_mutex.
+ */
+class TagIndex {
+	typedef std::vector<const Song *> SongVector;
+
+	typedef std::unordered_map<std::string, SongVector> Map;
+
+	Map maps[TAG_NUM_OF_ITEM_TYPES];
+
+	/**
+	 * All songs, in Walk() order.  The trigram index refers to
+	 * songs by their position in this vector.
+	 */
+	SongVector songs;
+
+	/**
+	 * A sorted list of positions in #songs.
+	 */
+	typedef std::vector<uint32_t> PostingList;
+
+	/**
+	 * Maps a trigram (see TrigramKey()) to the songs which
+	 * contain it.  Empty unless Build() was asked for it.
+	 */
+	std::unordered_map<uint32_t, PostingList> trigrams;
+
+	bool with_trigrams;
+
+	/**
+	 * The result of the last trigram Lookup().
+	 */
+	mutable SongVector candidates;
+
+	/**
+	 * The number of songs which have at least one item of each
+	 * tag type.
+	 */
+	unsigned n_tagged[TAG_NUM_OF_ITEM_TYPES];
+
+	unsigned n_songs;
+
+	bool valid;
+
+	/**
+	 * Was a mount point found while building the index?  Its
+	 * songs are missing from the index.
+	 */
+	bool has_mounts;
+
+	/**
+	 * Returned by Lookup() when no song has the value.
+	 */
+	const SongVector none;
+
+public:
+	TagIndex():with_trigrams(false), valid(false) {}
+
+	TagIndex(const TagIndex &) = delete;
+
+	bool IsValid() const {
+		return valid;
+	}
+
+	/**
+	 * Can this index replace a full scan?
+	 */
+	bool IsComplete() const {
+		return valid && !has_mounts;
+	}
+
+	void Clear();
+
+	/**
+	 * @param _with_trigrams build the trigram index, too?
+	 */
+	void Build(const Directory &root, bool _with_trigrams);
+
+	/**
+	 * Find the songs which may match the given filter: those
+	 * which have the value of one of its exact (i.e. not case
+	 * folded) tag items, or else those which contain all
+	 * trigrams of its case folded items.  They must still be
+	 * checked with SongFilter::Match().
+	 *
+	 * The returned vector is valid until the next call.
+	 *
+	 * @return nullptr if there is no usable item in the filter
+	 */
+	gcc_pure
+	const SongVector *Lookup(const SongFilter &filter) const;
+
+	/**
+	 * Invoke a function for each distinct value of the given tag
+	 * type (in no particular order).  An empty string stands for
+	 * the songs which don't have this tag.
+	 */
+	template<typename F>
+	void ForEachValue(TagType type, F &&f) const {
+		for (const auto &i : maps[type])
+			f(i.first.c_str());
+
+		if (n_tagged[type] < n_songs)
+			f("");
+	}
+
+private:
+	void Add(const Directory &directory);
+
+	void AddTrigrams(uint32_t position, const Song &song);
+
+	const SongVector *LookupTrigrams(const SongFilter &filter) const;
+};
+
+#endif
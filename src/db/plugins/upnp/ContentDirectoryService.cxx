@@ -25,6 +25,9 @@
 #include "Directory.hxx"
 #include "util/NumberParser.hxx"
 #include "util/Error.hxx"
+#include "thread/Thread.hxx"
+
+#include <algorithm>
 
 #include <stdio.h>
 
@@ -88,6 +91,62 @@ ContentDirectoryService::readDirSlice(UpnpClient_Handle hdl,
 	return success;
 }
 
+/**
+ * The maximum number of threads which browse one large container
+ * concurrently.
+ */
+static constexpr unsigned READ_DIR_THREADS = 4;
+
+/**
+ * Browses a range of entries of a container in a separate thread.
+ */
+struct ContainerSliceReader {
+	const ContentDirectoryService *service;
+	UpnpClient_Handle handle;
+	const char *object_id;
+	unsigned slice_size;
+
+	/**
+	 * The range of entries to be read: [start, end).
+	 */
+	unsigned start, end;
+
+	UPnPDirContent content;
+
+	Error error;
+	bool success;
+
+	Thread thread;
+
+	void Run();
+
+	static void Run(void *ctx) {
+		ContainerSliceReader &reader = *(ContainerSliceReader *)ctx;
+		reader.Run();
+	}
+};
+
+void
+ContainerSliceReader::Run()
+{
+	success = false;
+
+	unsigned offset = start, total, count;
+	while (offset < end) {
+		if (!service->readDirSlice(handle, object_id, offset,
+					   std::min(slice_size, end - offset),
+					   content, count, total, error))
+			return;
+
+		if (count == 0)
+			break;
+
+		offset += count;
+	}
+
+	success = true;
+}
+
 bool
 ContentDirectoryService::readDir(UpnpClient_Handle handle,
 				 const char *objectId,
@@ -96,15 +155,75 @@ ContentDirectoryService::readDir(UpnpClient_Handle handle,
 {
 	unsigned offset = 0, total = -1, count;
 
-	do {
-		if (!readDirSlice(handle, objectId, offset, m_rdreqcnt, dirbuf,
-				  count, total, error))
-			return false;
+	/* the first slice tells us the size of the container */
+	if (!readDirSlice(handle, objectId, offset, m_rdreqcnt, dirbuf,
+			  count, total, error))
+		return false;
 
-		offset += count;
-	} while (count > 0 && offset < total);
+	offset += count;
+	if (count == 0 || offset >= total)
+		return true;
 
-	return true;
+	const unsigned remaining = total - offset;
+	const unsigned n_threads = m_rdreqcnt > 0
+		? std::min(READ_DIR_THREADS,
+			   (remaining + m_rdreqcnt - 1) / m_rdreqcnt)
+		: 1;
+
+	if (n_threads <= 1) {
+		do {
+			if (!readDirSlice(handle, objectId, offset, m_rdreqcnt,
+					  dirbuf, count, total, error))
+				return false;
+
+			offset += count;
+		} while (count > 0 && offset < total);
+
+		return true;
+	}
+
+	/* split the rest of the container into contiguous ranges
+	   and request them in parallel; the results are
+	   concatenated in order afterwards */
+	ContainerSliceReader readers[READ_DIR_THREADS];
+	const unsigned per_thread = (remaining + n_threads - 1) / n_threads;
+
+	for (unsigned i = 0; i < n_threads; ++i) {
+		ContainerSliceReader &r = readers[i];
+		r.service = this;
+		r.handle = handle;
+		r.object_id = objectId;
+		r.slice_size = m_rdreqcnt;
+		r.start = offset + i * per_thread;
+		r.end = std::min(r.start + per_thread, total);
+
+		Error start_error;
+		if (!r.thread.Start(ContainerSliceReader::Run, &r,
+				    start_error))
+			/* no thread available: do it synchronously */
+			r.Run();
+	}
+
+	bool success = true;
+	for (unsigned i = 0; i < n_threads; ++i) {
+		ContainerSliceReader &r = readers[i];
+		if (r.thread.IsDefined())
+			r.thread.Join();
+
+		if (!success)
+			continue;
+
+		if (!r.success) {
+			error = std::move(r.error);
+			success = false;
+			continue;
+		}
+
+		for (auto &object : r.content.objects)
+			dirbuf.objects.emplace_back(std::move(object));
+	}
+
+	return success;
 }
 
 bool
@@ -39,18 +39,27 @@
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "fs/Traits.hxx"
+#include "system/Clock.hxx"
 #include "Log.hxx"
 #include "SongFilter.hxx"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <set>
+#include <map>
+#include <memory>
 
 #include <assert.h>
 #include <string.h>
 
 static const char *const rootid = "0";
 
+/**
+ * The maximum number of containers in UpnpDatabase::container_cache.
+ */
+static constexpr size_t MAX_CACHED_CONTAINERS = 256;
+
 class UpnpSong : public LightSong {
 	std::string uri2, real_uri2;
 
@@ -65,6 +74,8 @@ public:
 		uri = uri2.c_str();
 		real_uri = real_uri2.c_str();
 		tag = &tag2;
+		replay_gain = nullptr;
+		mix_ramp = nullptr;
 		mtime = 0;
 		start_ms = end_ms = 0;
 	}
@@ -74,6 +85,35 @@ class UpnpDatabase : public Database {
 	UpnpClient_Handle handle;
 	UPnPDeviceDirectory *discovery;
 
+	/**
+	 * How long (in seconds) are browsed containers kept in the
+	 * #container_cache?  0 disables the cache.
+	 */
+	unsigned cache_ttl;
+
+	struct CachedContainer {
+		std::shared_ptr<const UPnPDirContent> content;
+
+		/**
+		 * The MonotonicClockS() value when this entry becomes
+		 * stale.
+		 */
+		unsigned expires;
+	};
+
+	/**
+	 * Recently browsed containers, so path lookups (Namei())
+	 * don't need to read each parent container again.  The key
+	 * is the service URI followed by the object id.
+	 */
+	mutable std::map<std::string, CachedContainer> container_cache;
+
+	/**
+	 * The search capabilities of each server (by service URI);
+	 * they don't change while the server is running.
+	 */
+	mutable std::map<std::string, std::list<std::string>> search_caps;
+
 public:
 	UpnpDatabase():Database(upnp_db_plugin) {}
 
@@ -136,6 +176,30 @@ private:
 		   UPnPDirObject &dirent,
 		   Error &error) const;
 
+	/**
+	 * Browse the children of a container, using the
+	 * #container_cache if possible.
+	 *
+	 * @return the container contents or nullptr on error
+	 */
+	std::shared_ptr<const UPnPDirContent>
+	ReadDir(const ContentDirectoryService &server, const char *objid,
+		Error &error) const;
+
+	/**
+	 * Remove stale entries from the #container_cache, and clear
+	 * it completely if it is still too large.
+	 */
+	void ExpireContainerCache(unsigned now) const;
+
+	/**
+	 * Obtain the server's search capabilities, using the
+	 * #search_caps cache if possible.
+	 */
+	const std::list<std::string> *
+	GetSearchCapabilities(const ContentDirectoryService &server,
+			      Error &error) const;
+
 	/**
 	 * Take server and objid, return metadata.
 	 */
@@ -171,8 +235,9 @@ UpnpDatabase::Create(gcc_unused EventLoop &loop,
 }
 
 inline bool
-UpnpDatabase::Configure(const config_param &, Error &)
+UpnpDatabase::Configure(const config_param &param, Error &)
 {
+	cache_ttl = param.GetBlockValue("cache_ttl", 60u);
 	return true;
 }
 
@@ -195,6 +260,9 @@ UpnpDatabase::Open(Error &error)
 void
 UpnpDatabase::Close()
 {
+	container_cache.clear();
+	search_caps.clear();
+
 	delete discovery;
 	UpnpClientGlobalFinish();
 }
@@ -273,13 +341,31 @@ UpnpDatabase::SearchSongs(const ContentDirectoryService &server,
 	if (selection.filter == nullptr)
 		return true;
 
-	std::list<std::string> searchcaps;
-	if (!server.getSearchCapabilities(handle, searchcaps, error))
+	const std::list<std::string> *searchcaps_p =
+		GetSearchCapabilities(server, error);
+	if (searchcaps_p == nullptr)
 		return false;
 
+	const std::list<std::string> &searchcaps = *searchcaps_p;
 	if (searchcaps.empty())
 		return true;
 
+	/* "*" means the server can search all properties; don't send
+	   it literally for LOCATE_TAG_ANY_TYPE, but expand it to the
+	   properties we know */
+	const bool search_all =
+		std::find(searchcaps.begin(), searchcaps.end(), "*") !=
+		searchcaps.end();
+
+	std::list<std::string> all_props;
+	if (search_all)
+		for (auto i = upnp_tags; i->name != nullptr; ++i)
+			all_props.emplace_back(i->name);
+
+	const std::list<std::string> &any_props = search_all
+		? all_props
+		: searchcaps;
+
 	std::string cond;
 	for (const auto &item : filter->GetItems()) {
 		switch (auto tag = item.GetTag()) {
@@ -290,7 +376,7 @@ UpnpDatabase::SearchSongs(const ContentDirectoryService &server,
 				}
 				cond += '(';
 				bool first(true);
-				for (const auto& cap : searchcaps) {
+				for (const auto& cap : any_props) {
 					if (first)
 						first = false;
 					else
@@ -322,6 +408,14 @@ UpnpDatabase::SearchSongs(const ContentDirectoryService &server,
 			if (name == nullptr)
 				continue;
 
+			/* properties which the server cannot search
+			   are left out; visitSong() applies the
+			   whole filter to the results anyway */
+			if (!search_all &&
+			    std::find(searchcaps.begin(), searchcaps.end(),
+				      name) == searchcaps.end())
+				continue;
+
 			if (!cond.empty()) {
 				cond += " and ";
 			}
@@ -341,6 +435,11 @@ UpnpDatabase::SearchSongs(const ContentDirectoryService &server,
 		}
 	}
 
+	if (cond.empty())
+		/* none of the conditions can be evaluated by the
+		   server: let it return everything */
+		cond = "*";
+
 	return server.search(handle,
 			     objid, cond.c_str(), dirbuf,
 			     error);
@@ -359,6 +458,8 @@ visitSong(const UPnPDirObject &meta, const char *path,
 	song.uri = path;
 	song.real_uri = meta.url.c_str();
 	song.tag = &meta.tag;
+	song.replay_gain = nullptr;
+	song.mix_ramp = nullptr;
 	song.mtime = 0;
 	song.start_ms = song.end_ms = 0;
 
@@ -486,12 +587,12 @@ UpnpDatabase::Namei(const ContentDirectoryService &server,
 
 	// Walk the path elements, read each directory and try to find the next one
 	for (auto i = vpath.begin(), last = std::prev(vpath.end());; ++i) {
-		UPnPDirContent dirbuf;
-		if (!server.readDir(handle, objid.c_str(), dirbuf, error))
+		const auto dirbuf = ReadDir(server, objid.c_str(), error);
+		if (dirbuf == nullptr)
 			return false;
 
 		// Look for the name in the sub-container list
-		UPnPDirObject *child = dirbuf.FindObject(i->c_str());
+		const UPnPDirObject *child = dirbuf->FindObject(i->c_str());
 		if (child == nullptr) {
 			error.Format(db_domain, DB_NOT_FOUND,
 				     "No such object");
@@ -499,7 +600,7 @@ UpnpDatabase::Namei(const ContentDirectoryService &server,
 		}
 
 		if (i == last) {
-			odirent = std::move(*child);
+			odirent = UPnPDirObject(*child);
 			return true;
 		}
 
@@ -509,10 +610,76 @@ UpnpDatabase::Namei(const ContentDirectoryService &server,
 			return false;
 		}
 
-		objid = std::move(child->m_id);
+		objid = child->m_id;
 	}
 }
 
+std::shared_ptr<const UPnPDirContent>
+UpnpDatabase::ReadDir(const ContentDirectoryService &server,
+		      const char *objid, Error &error) const
+{
+	const unsigned now = MonotonicClockS();
+
+	std::string key = server.GetURI();
+	key.push_back('/');
+	key.append(objid);
+
+	auto i = container_cache.find(key);
+	if (i != container_cache.end()) {
+		if (now < i->second.expires)
+			return i->second.content;
+
+		container_cache.erase(i);
+	}
+
+	auto content = std::make_shared<UPnPDirContent>();
+	if (!server.readDir(handle, objid, *content, error))
+		return nullptr;
+
+	if (cache_ttl > 0) {
+		if (container_cache.size() >= MAX_CACHED_CONTAINERS)
+			ExpireContainerCache(now);
+
+		CachedContainer &c = container_cache[std::move(key)];
+		c.content = content;
+		c.expires = now + cache_ttl;
+	}
+
+	return content;
+}
+
+void
+UpnpDatabase::ExpireContainerCache(unsigned now) const
+{
+	for (auto i = container_cache.begin(); i != container_cache.end();) {
+		if (now >= i->second.expires)
+			i = container_cache.erase(i);
+		else
+			++i;
+	}
+
+	if (container_cache.size() >= MAX_CACHED_CONTAINERS)
+		container_cache.clear();
+}
+
+const std::list<std::string> *
+UpnpDatabase::GetSearchCapabilities(const ContentDirectoryService &server,
+				    Error &error) const
+{
+	const std::string uri = server.GetURI();
+	auto i = search_caps.find(uri);
+	if (i != search_caps.end())
+		return &i->second;
+
+	std::list<std::string> caps;
+	if (!server.getSearchCapabilities(handle, caps, error))
+		return nullptr;
+
+	auto &result = search_caps[uri];
+	result = std::move(caps);
+	return &result;
+}
+
 static bool
 VisitItem(const UPnPDirObject &object, const char *uri,
 	  const DatabaseSelection &selection,
@@ -657,12 +824,11 @@ UpnpDatabase::VisitServer(const ContentDirectoryService &server,
 	/* Target was a a container. Visit it. We could read slices
 	   and loop here, but it's not useful as mpd will only return
 	   data to the client when we're done anyway. */
-	UPnPDirContent dirbuf;
-	if (!server.readDir(handle, tdirent.m_id.c_str(), dirbuf,
-			    error))
+	const auto dirbuf = ReadDir(server, tdirent.m_id.c_str(), error);
+	if (dirbuf == nullptr)
 		return false;
 
-	for (auto &dirent : dirbuf.objects) {
+	for (const auto &dirent : dirbuf->objects) {
 		const std::string uri = PathTraitsUTF8::Build(base_uri,
 							      dirent.name.c_str());
 		if (!VisitObject(dirent, uri.c_str(),
@@ -19,6 +19,7 @@
 
 #include "config.h" /* must be first for large file support */
 #include "Walk.hxx"
+#include "ScanPool.hxx"
 #include "UpdateDomain.hxx"
 #include "db/DatabaseLock.hxx"
 #include "db/plugins/simple/Directory.hxx"
@@ -61,11 +62,23 @@ UpdateWalk::UpdateArchiveTree(Directory &directory, const char *name)
 		}
 
 		//add file
-		db_lock();
+		db_lock_shared();
 		Song *song = directory.FindSong(name);
-		db_unlock();
-		if (song == nullptr) {
+		db_unlock_shared();
+		if (song == nullptr && scan_pool != nullptr) {
+			/* decode the entries of the archive in parallel;
+			   CommitScanResults() adds the song; the
+			   uncompressed size is not known here */
+			stats.CountSong(0);
+			scan_pool->Push(directory,
+					Song::NewFile(name, directory),
+					nullptr);
+			CommitScanResults(false);
+		} else if (song == nullptr) {
+			stats.CountSong(0);
+			const uint64_t start = MonotonicClockUS();
 			song = Song::LoadFile(storage, name, directory);
+			stats.CountScan(start);
 			if (song != nullptr) {
 				db_lock();
 				directory.AddSong(song);
@@ -107,9 +120,9 @@ UpdateWalk::UpdateArchiveFile(Directory &parent, const char *name,
 			      const FileInfo &info,
 			      const ArchivePlugin &plugin)
 {
-	db_lock();
+	db_lock_shared();
 	Directory *directory = parent.FindChild(name);
-	db_unlock();
+	db_unlock_shared();
 
 	if (directory != nullptr && directory->mtime == info.mtime &&
 	    !walk_discard)
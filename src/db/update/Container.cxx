@@ -27,9 +27,8 @@
 #include "decoder/DecoderPlugin.hxx"
 #include "decoder/DecoderList.hxx"
 #include "fs/AllocatedPath.hxx"
+#include "DetachedSong.hxx"
 #include "storage/FileInfo.hxx"
-#include "tag/TagHandler.hxx"
-#include "tag/TagBuilder.hxx"
 #include "Log.hxx"
 
 #include <sys/stat.h>
@@ -59,21 +58,20 @@ UpdateWalk::MakeDirectoryIfModified(Directory &parent, const char *name,
 	return directory;
 }
 
-static bool
-SupportsContainerSuffix(const DecoderPlugin &plugin, const char *suffix)
-{
-	return plugin.container_scan != nullptr &&
-		plugin.SupportsSuffix(suffix);
-}
-
 bool
 UpdateWalk::UpdateContainerFile(Directory &directory,
 				const char *name, const char *suffix,
 				const FileInfo &info)
 {
-	const DecoderPlugin *_plugin = decoder_plugins_find([suffix](const DecoderPlugin &plugin){
-			return SupportsContainerSuffix(plugin, suffix);
-		});
+	const DecoderPlugin *_plugin = nullptr;
+	decoder_plugins_try_candidates(nullptr, suffix, nullptr,
+				       [&_plugin](const DecoderPlugin &plugin){
+					       if (plugin.container_scan == nullptr)
+						       return false;
+
+					       _plugin = &plugin;
+					       return true;
+				       });
 	if (_plugin == nullptr)
 		return false;
 	const DecoderPlugin &plugin = *_plugin;
@@ -97,36 +95,28 @@ UpdateWalk::UpdateContainerFile(Directory &directory,
 		return false;
 	}
 
-	char *vtrack;
-	unsigned int tnum = 0;
-	TagBuilder tag_builder;
-	while ((vtrack = plugin.container_scan(pathname, ++tnum)) != nullptr) {
-		Song *song = Song::NewFile(vtrack, *contdir);
+	/* one call enumerates all tracks and reads their tags */
+	stats.CountSong(info.size);
+	const uint64_t start = MonotonicClockUS();
+	auto tracks = plugin.container_scan(pathname);
+	stats.CountScan(start);
+	if (tracks.empty()) {
+		editor.LockDeleteDirectory(contdir);
+		return false;
+	}
+
+	for (auto &vtrack : tracks) {
+		Song *song = Song::NewFrom(std::move(vtrack), *contdir);
 
 		// shouldn't be necessary but it's there..
 		song->mtime = info.mtime;
 
-		const auto child_path_fs = AllocatedPath::Build(pathname,
-								vtrack);
-		plugin.ScanFile(child_path_fs,
-				add_tag_handler, &tag_builder);
-
-		tag_builder.Commit(song->tag);
-
-		db_lock();
-		contdir->AddSong(song);
-		db_unlock();
+		FormatDefault(update_domain, "added %s/%s",
+			      directory.GetPath(), song->uri);
 
+		added_songs.push_back(song);
 		modified = true;
-
-		FormatDefault(update_domain, "added %s/%s",
-			      directory.GetPath(), vtrack);
-		delete[] vtrack;
 	}
 
-	if (tnum == 1) {
-		editor.LockDeleteDirectory(contdir);
-		return false;
-	} else
-		return true;
+	return true;
 }
@@ -33,18 +33,10 @@ DatabaseEditor::DeleteSong(Directory &dir, Song *del)
 {
 	assert(del->parent == &dir);
 
-	/* first, prevent traversers in main task from getting this */
+	/* first, prevent traversers in main task from getting this;
+	   Commit() will take it out of the playlist and free it */
 	dir.RemoveSong(del);
-
-	db_unlock(); /* temporary unlock, because update_remove_song() blocks */
-
-	/* now take it out of the playlist (in the main_task) */
-	remove.Remove(del);
-
-	/* finally, all possible references gone, free it */
-	del->Free();
-
-	db_lock();
+	removed_songs.push_back(del);
 }
 
 void
@@ -65,7 +57,7 @@ inline void
 DatabaseEditor::ClearDirectory(Directory &directory)
 {
 	directory.ForEachChildSafe([this](Directory &child){
-			DeleteDirectory(&child);
+			PurgeDirectory(&child);
 		});
 
 	directory.ForEachSongSafe([this, &directory](Song &song){
@@ -74,14 +66,41 @@ DatabaseEditor::ClearDirectory(Directory &directory)
 		});
 }
 
-void
-DatabaseEditor::DeleteDirectory(Directory *directory)
+inline void
+DatabaseEditor::PurgeDirectory(Directory *directory)
 {
 	assert(directory->parent != nullptr);
 
 	ClearDirectory(*directory);
 
-	directory->Delete();
+	/* the songs in #removed_songs still point to it */
+	directory->Detach();
+	removed_directories.push_back(directory);
+}
+
+void
+DatabaseEditor::IndexVanished(Directory &directory)
+{
+	/* 0 means the listing was never completed; only directories
+	   with songs are worth looking up */
+	if (directory.fingerprint != 0 && !directory.songs.empty())
+		vanished_index.emplace(directory.fingerprint, &directory);
+
+	for (Directory &child : directory.children)
+		IndexVanished(child);
+}
+
+void
+DatabaseEditor::DeleteDirectory(Directory *directory)
+{
+	assert(directory->parent != nullptr);
+
+	/* detach it, so the main thread can't see it anymore, but
+	   keep its contents until Finish(); a new directory found
+	   later in this update may be the same one, renamed */
+	directory->Detach();
+	vanished_directories.push_back(directory);
+	IndexVanished(*directory);
 }
 
 void
@@ -117,3 +136,61 @@ DatabaseEditor::DeleteNameIn(Directory &parent, const char *name)
 
 	return modified;
 }
+
+Directory *
+DatabaseEditor::FindVanished(uint32_t fingerprint)
+{
+	const auto i = vanished_index.find(fingerprint);
+	return i != vanished_index.end()
+		? i->second
+		: nullptr;
+}
+
+void
+DatabaseEditor::SongMoved(const Song &from, const Song &to)
+{
+	moved_songs.emplace_back(from.GetURI(), to.GetURI());
+}
+
+void
+DatabaseEditor::Commit()
+{
+	/* migrate the stickers before the old songs are removed
+	   (by Finish()), which would delete them */
+	remove.Move(moved_songs);
+	moved_songs.clear();
+
+	/* take them out of the playlist (in the main_task) */
+	remove.Remove(removed_songs);
+
+	/* finally, all possible references gone, free them */
+	for (Song *song : removed_songs)
+		song->Free();
+	removed_songs.clear();
+
+	for (Directory *directory : removed_directories)
+		delete directory;
+	removed_directories.clear();
+}
+
+void
+DatabaseEditor::Finish()
+{
+	vanished_index.clear();
+
+	if (!vanished_directories.empty()) {
+		/* the vanished directories have been detached
+		   already, but their contents still need to be
+		   removed from the playlist */
+		db_lock();
+		for (Directory *directory : vanished_directories) {
+			ClearDirectory(*directory);
+			removed_directories.push_back(directory);
+		}
+		db_unlock();
+
+		vanished_directories.clear();
+	}
+
+	Commit();
+}
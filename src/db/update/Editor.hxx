@@ -22,6 +22,15 @@
 
 #include "check.h"
 #include "Remove.hxx"
+#include "Compiler.h"
+
+#include <vector>
+#include <unordered_map>
+#include <string>
+#include <utility>
+
+#include <assert.h>
+#include <stdint.h>
 
 struct Directory;
 struct Song;
@@ -30,11 +39,53 @@ class UpdateRemoveService;
 class DatabaseEditor final {
 	UpdateRemoveService remove;
 
+	/**
+	 * Songs which have been removed from the tree, but not yet
+	 * from the playlist; see Commit().
+	 */
+	std::vector<Song *> removed_songs;
+
+	/**
+	 * Directories which have been detached from the tree; they
+	 * are freed by Commit() after the #removed_songs, which may
+	 * still refer to them.
+	 */
+	std::vector<Directory *> removed_directories;
+
+	/**
+	 * Directories which have been detached from the tree by
+	 * DeleteDirectory().  Their contents are kept until Finish(),
+	 * so songs which have only been moved can be found with
+	 * FindVanished() and relinked without scanning them again.
+	 */
+	std::vector<Directory *> vanished_directories;
+
+	/**
+	 * All non-empty directories below #vanished_directories,
+	 * indexed by their Directory::fingerprint.
+	 */
+	std::unordered_multimap<uint32_t, Directory *> vanished_index;
+
+	/**
+	 * Songs which have been relinked to a new location since the
+	 * last Commit(): pairs of old and new URI.
+	 */
+	UpdateRemoveService::MovedList moved_songs;
+
 public:
 	DatabaseEditor(EventLoop &_loop, DatabaseListener &_listener)
 		:remove(_loop, _listener) {}
 
+	~DatabaseEditor() {
+		assert(removed_songs.empty());
+		assert(removed_directories.empty());
+		assert(vanished_directories.empty());
+	}
+
 	/**
+	 * Remove the song from the tree.  It is freed by the next
+	 * Commit() call.
+	 *
 	 * Caller must lock the #db_mutex.
 	 */
 	void DeleteSong(Directory &parent, Song *song);
@@ -45,7 +96,9 @@ public:
 	void LockDeleteSong(Directory &parent, Song *song);
 
 	/**
-	 * Recursively free a directory and all its contents.
+	 * Recursively remove a directory and all its contents from
+	 * the tree.  They stay available to FindVanished() and are
+	 * freed by Finish().
 	 *
 	 * Caller must lock the #db_mutex.
 	 */
@@ -63,8 +116,47 @@ public:
 	 */
 	bool DeleteNameIn(Directory &parent, const char *name);
 
+	/**
+	 * Look up a directory deleted during this update whose
+	 * listing had the given fingerprint, i.e. which has probably
+	 * been renamed or moved.
+	 *
+	 * Caller must NOT lock the #db_mutex.
+	 *
+	 * @return the detached directory (owned by this object), or
+	 * nullptr if there is none
+	 */
+	gcc_pure
+	Directory *FindVanished(uint32_t fingerprint);
+
+	/**
+	 * Remember that a song from a vanished directory was moved to
+	 * a new URI.  Its stickers will be migrated by the next
+	 * Commit() call.
+	 */
+	void SongMoved(const Song &from, const Song &to);
+
+	/**
+	 * Remove all songs deleted since the last call from the
+	 * playlist (in one round trip to the main thread), and free
+	 * them together with the deleted directories.
+	 *
+	 * Caller must NOT lock the #db_mutex.
+	 */
+	void Commit();
+
+	/**
+	 * Remove the contents of all vanished directories, and
+	 * Commit().  Call this at the end of the update.
+	 *
+	 * Caller must NOT lock the #db_mutex.
+	 */
+	void Finish();
+
 private:
 	void ClearDirectory(Directory &directory);
+	void PurgeDirectory(Directory *directory);
+	void IndexVanished(Directory &directory);
 };
 
 #endif
@@ -30,12 +30,84 @@
 #include "util/Domain.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+
 #include <assert.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/stat.h>
 
 static constexpr Domain exclude_list_domain("exclude_list");
 
+#ifdef HAVE_GLIB
+
+void
+ExcludeList::AffixSet::Add(std::string &&value)
+{
+	const size_t length = value.length();
+	if (std::find(lengths.begin(), lengths.end(), length) == lengths.end())
+		lengths.push_back(length);
+
+	set.emplace(std::move(value));
+}
+
+bool
+ExcludeList::AffixSet::CheckPrefix(const char *name, size_t length) const
+{
+	for (size_t i : lengths)
+		if (i <= length && set.find(std::string(name, i)) != set.end())
+			return true;
+
+	return false;
+}
+
+bool
+ExcludeList::AffixSet::CheckSuffix(const char *name, size_t length) const
+{
+	for (size_t i : lengths)
+		if (i <= length &&
+		    set.find(std::string(name + length - i, i)) != set.end())
+			return true;
+
+	return false;
+}
+
+gcc_pure
+static bool
+HasWildcard(const char *p)
+{
+	return strpbrk(p, "*?") != nullptr;
+}
+
+inline void
+ExcludeList::Add(const char *p)
+{
+	const size_t length = strlen(p);
+
+	if (!HasWildcard(p))
+		literals.emplace(p);
+	else if (p[0] == '*' && !HasWildcard(p + 1))
+		suffixes.Add(std::string(p + 1));
+	else if (p[length - 1] == '*' &&
+		 !HasWildcard(std::string(p, length - 1).c_str()))
+		prefixes.Add(std::string(p, length - 1));
+	else
+		patterns.emplace_front(p);
+}
+
+#endif
+
+void
+ExcludeList::Clear()
+{
+#ifdef HAVE_GLIB
+	literals.clear();
+	prefixes.Clear();
+	suffixes.Clear();
+	patterns.clear();
+#endif
+}
+
 bool
 ExcludeList::LoadFile(Path path_fs)
 {
@@ -61,7 +133,7 @@ ExcludeList::LoadFile(Path path_fs)
 
 		p = Strip(line);
 		if (*p != 0)
-			patterns.emplace_front(p);
+			Add(p);
 	}
 
 	fclose(file);
@@ -81,8 +153,16 @@ ExcludeList::Check(Path name_fs) const
 	/* XXX include full path name in check */
 
 #ifdef HAVE_GLIB
+	const char *name = name_fs.c_str();
+	const size_t length = strlen(name);
+
+	if (literals.find(name) != literals.end() ||
+	    suffixes.CheckSuffix(name, length) ||
+	    prefixes.CheckPrefix(name, length))
+		return true;
+
 	for (const auto &i : patterns)
-		if (i.Check(name_fs.c_str()))
+		if (i.Check(name))
 			return true;
 #else
 	// TODO: implement
@@ -91,3 +171,23 @@ ExcludeList::Check(Path name_fs) const
 
 	return false;
 }
+
+const ExcludeList *
+ExcludeListCache::Get(Path path_fs)
+{
+	struct stat st;
+	if (!StatFile(path_fs, st) || !S_ISREG(st.st_mode)) {
+		map.erase(path_fs.c_str());
+		return nullptr;
+	}
+
+	Entry &entry = map[path_fs.c_str()];
+	if (entry.mtime != st.st_mtime || entry.size != st.st_size) {
+		entry.list.Clear();
+		entry.list.LoadFile(path_fs);
+		entry.mtime = st.st_mtime;
+		entry.size = st.st_size;
+	}
+
+	return &entry.list;
+}
@@ -29,6 +29,13 @@
 #include "Compiler.h"
 
 #include <forward_list>
+#include <unordered_set>
+#include <unordered_map>
+#include <string>
+#include <vector>
+
+#include <time.h>
+#include <sys/types.h>
 
 #ifdef HAVE_GLIB
 #include <glib.h>
@@ -60,6 +67,56 @@ class ExcludeList {
 		}
 	};
 
+	/**
+	 * A set of literal strings which are compared with the
+	 * beginning or the end of a file name: one hash lookup per
+	 * distinct length instead of one glob match per pattern.
+	 */
+	class AffixSet {
+		std::unordered_set<std::string> set;
+
+		/**
+		 * The distinct lengths of the strings in #set.
+		 */
+		std::vector<size_t> lengths;
+
+	public:
+		bool IsEmpty() const {
+			return set.empty();
+		}
+
+		void Clear() {
+			set.clear();
+			lengths.clear();
+		}
+
+		void Add(std::string &&value);
+
+		gcc_pure
+		bool CheckPrefix(const char *name, size_t length) const;
+
+		gcc_pure
+		bool CheckSuffix(const char *name, size_t length) const;
+	};
+
+	/**
+	 * Patterns without wildcards.
+	 */
+	std::unordered_set<std::string> literals;
+
+	/**
+	 * Patterns like "foo*" (without the asterisk).
+	 */
+	AffixSet prefixes;
+
+	/**
+	 * Patterns like "*.foo" (without the asterisk).
+	 */
+	AffixSet suffixes;
+
+	/**
+	 * All other patterns, which need a glob match.
+	 */
 	std::forward_list<Pattern> patterns;
 #else
 	// TODO: implement
@@ -69,13 +126,16 @@ public:
 	gcc_pure
 	bool IsEmpty() const {
 #ifdef HAVE_GLIB
-		return patterns.empty();
+		return literals.empty() && prefixes.IsEmpty() &&
+			suffixes.IsEmpty() && patterns.empty();
 #else
 		// TODO: implement
 		return true;
 #endif
 	}
 
+	void Clear();
+
 	/**
 	 * Loads and parses a .mpdignore file.
 	 */
@@ -85,8 +145,38 @@ public:
 	 * Checks whether one of the patterns in the .mpdignore file matches
 	 * the specified file name.
 	 */
+	gcc_pure
 	bool Check(Path name_fs) const;
+
+private:
+	void Add(const char *pattern);
 };
 
+/**
+ * Remembers the parsed .mpdignore files, so that each one is only
+ * parsed again after it has been modified.  Only directories which
+ * have such a file occupy an entry.
+ */
+class ExcludeListCache {
+	struct Entry {
+		time_t mtime;
+		off_t size;
+
+		ExcludeList list;
+
+		/* -1 means "not loaded yet" */
+		Entry():mtime(0), size(-1) {}
+	};
+
+	std::unordered_map<std::string, Entry> map;
+
+public:
+	/**
+	 * Returns the patterns of the given .mpdignore file, or
+	 * nullptr if there is no such file.  The pointer is valid
+	 * until the next call with the same path.
+	 */
+	const ExcludeList *Get(Path path_fs);
+};
 
 #endif
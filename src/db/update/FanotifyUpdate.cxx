@@ -0,0 +1,332 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "FanotifyUpdate.hxx"
+#include "InotifyQueue.hxx"
+#include "InotifyDomain.hxx"
+#include "storage/StorageInterface.hxx"
+#include "event/SocketMonitor.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/Charset.hxx"
+#include "system/FatalError.hxx"
+#include "Log.hxx"
+
+#include <string>
+
+#include <sys/fanotify.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <limits.h>
+
+/**
+ * With #FAN_REPORT_FID, directory entry events (create, delete,
+ * move) identify the parent directory, and #FAN_CLOSE_WRITE
+ * identifies the file.  #FAN_CREATE is only interesting for
+ * directories; new files are handled on #FAN_CLOSE_WRITE.
+ */
+static constexpr uint64_t FAN_MASK =
+	FAN_CLOSE_WRITE|FAN_CREATE|FAN_DELETE|FAN_MOVED_FROM|FAN_MOVED_TO|
+	FAN_ONDIR;
+
+class FanotifyMonitor final : SocketMonitor {
+	/**
+	 * The music directory, opened for open_by_handle_at().
+	 */
+	const int mount_fd;
+
+	/**
+	 * The canonical path of the music directory.  Events for
+	 * other parts of the file system are ignored.
+	 */
+	const std::string root;
+
+	const unsigned max_depth;
+
+	InotifyQueue queue;
+
+public:
+	FanotifyMonitor(EventLoop &_loop, int _fd, int _mount_fd,
+			std::string &&_root,
+			UpdateService &update, unsigned _max_depth)
+		:SocketMonitor(_fd, _loop),
+		 mount_fd(_mount_fd), root(std::move(_root)),
+		 max_depth(_max_depth),
+		 queue(_loop, update) {
+		ScheduleRead();
+	}
+
+	~FanotifyMonitor() {
+		Close();
+		close(mount_fd);
+	}
+
+private:
+	/**
+	 * Convert a file handle to a path relative to the music
+	 * directory.
+	 *
+	 * @return false if the object does not exist anymore, or if
+	 * it is outside of the music directory
+	 */
+	bool Resolve(const struct file_handle &handle,
+		     std::string &uri_fs) const;
+
+	void OnEvent(const struct fanotify_event_metadata &event);
+
+	virtual bool OnSocketReady(unsigned flags) override;
+};
+
+bool
+FanotifyMonitor::Resolve(const struct file_handle &handle,
+			 std::string &uri_fs) const
+{
+	auto &h = const_cast<struct file_handle &>(handle);
+	const int object_fd = open_by_handle_at(mount_fd, &h,
+						O_PATH|O_CLOEXEC);
+	if (object_fd < 0) {
+		if (errno != ESTALE)
+			LogErrno(inotify_domain,
+				 "open_by_handle_at() has failed");
+		return false;
+	}
+
+	char proc_path[32], buffer[PATH_MAX];
+	snprintf(proc_path, sizeof(proc_path), "/proc/self/fd/%d",
+		 object_fd);
+	const ssize_t length = readlink(proc_path, buffer, sizeof(buffer));
+	close(object_fd);
+
+	if (length < 0 || size_t(length) >= sizeof(buffer) ||
+	    size_t(length) < root.length() ||
+	    memcmp(buffer, root.data(), root.length()) != 0)
+		return false;
+
+	const char *p = buffer + root.length();
+	const char *const end = buffer + length;
+	if (p == end) {
+		uri_fs.clear();
+		return true;
+	}
+
+	if (*p != '/')
+		return false;
+
+	uri_fs.assign(p + 1, end);
+	return true;
+}
+
+gcc_pure
+static unsigned
+GetDepth(const std::string &uri)
+{
+	if (uri.empty())
+		return 0;
+
+	unsigned depth = 1;
+	for (char ch : uri)
+		if (ch == '/')
+			++depth;
+	return depth;
+}
+
+inline void
+FanotifyMonitor::OnEvent(const struct fanotify_event_metadata &event)
+{
+	if ((event.mask & FAN_Q_OVERFLOW) != 0) {
+		LogWarning(inotify_domain,
+			   "fanotify queue overflow, updating everything");
+		queue.Enqueue("");
+		return;
+	}
+
+	if ((event.mask & (FAN_CLOSE_WRITE|FAN_DELETE|
+			   FAN_MOVED_FROM|FAN_MOVED_TO)) == 0 &&
+	    (event.mask & (FAN_CREATE|FAN_ONDIR)) != (FAN_CREATE|FAN_ONDIR))
+		return;
+
+	if (event.event_len <
+	    event.metadata_len + sizeof(struct fanotify_event_info_fid))
+		return;
+
+	const auto &fid = *(const struct fanotify_event_info_fid *)
+		((const char *)&event + event.metadata_len);
+	if (fid.hdr.info_type != FAN_EVENT_INFO_TYPE_FID)
+		return;
+
+	std::string uri_fs;
+	if (!Resolve(*(const struct file_handle *)fid.handle, uri_fs))
+		return;
+
+	if ((event.mask & FAN_CLOSE_WRITE) != 0) {
+		/* update the directory containing the file, just like
+		   the inotify code does */
+		const auto slash = uri_fs.rfind('/');
+		if (slash == uri_fs.npos)
+			uri_fs.clear();
+		else
+			uri_fs.erase(slash);
+	}
+
+	if (GetDepth(uri_fs) > max_depth)
+		/* inotify would not watch this directory */
+		return;
+
+	if (uri_fs.empty()) {
+		queue.Enqueue("");
+		return;
+	}
+
+	const std::string uri_utf8 = PathToUTF8(uri_fs.c_str());
+	if (!uri_utf8.empty())
+		queue.Enqueue(uri_utf8.c_str());
+}
+
+bool
+FanotifyMonitor::OnSocketReady(gcc_unused unsigned flags)
+{
+	/* the buffer must be aligned for fanotify_event_metadata */
+	uint64_t buffer[8192 / sizeof(uint64_t)];
+
+	ssize_t nbytes = read(Get(), buffer, sizeof(buffer));
+	if (nbytes < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return true;
+
+		FatalSystemError("Failed to read from fanotify");
+	}
+
+	const struct fanotify_event_metadata *event =
+		(const struct fanotify_event_metadata *)buffer;
+	for (; FAN_EVENT_OK(event, nbytes);
+	     event = FAN_EVENT_NEXT(event, nbytes)) {
+		if (event->vers != FANOTIFY_METADATA_VERSION)
+			FatalError("Wrong fanotify metadata version");
+
+		if (event->fd >= 0)
+			/* not expected with FAN_REPORT_FID */
+			close(event->fd);
+
+		OnEvent(*event);
+	}
+
+	return true;
+}
+
+/**
+ * Check whether open_by_handle_at() works with the given directory;
+ * it requires CAP_DAC_READ_SEARCH.
+ */
+static bool
+CanOpenByHandle(const char *path, int mount_fd)
+{
+	union {
+		struct file_handle handle;
+		char buffer[sizeof(struct file_handle) + MAX_HANDLE_SZ];
+	} u;
+
+	u.handle.handle_bytes = MAX_HANDLE_SZ;
+
+	int mount_id;
+	if (name_to_handle_at(AT_FDCWD, path, &u.handle, &mount_id, 0) < 0)
+		return false;
+
+	const int fd = open_by_handle_at(mount_fd, &u.handle,
+					 O_PATH|O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	close(fd);
+	return true;
+}
+
+static FanotifyMonitor *fanotify_monitor;
+
+bool
+mpd_fanotify_init(EventLoop &loop, Storage &storage, UpdateService &update,
+		  unsigned max_depth)
+{
+	LogDebug(inotify_domain, "initializing fanotify");
+
+	const auto path = storage.MapFS("");
+	if (path.IsNull()) {
+		LogDebug(inotify_domain, "no music directory configured");
+		return false;
+	}
+
+	char *real_path = realpath(path.c_str(), nullptr);
+	if (real_path == nullptr) {
+		FormatErrno(inotify_domain, "Failed to resolve %s",
+			    path.c_str());
+		return false;
+	}
+
+	std::string root(real_path);
+	free(real_path);
+
+	const int fd = fanotify_init(FAN_CLASS_NOTIF|FAN_CLOEXEC|
+				     FAN_NONBLOCK|FAN_REPORT_FID,
+				     O_RDONLY|O_CLOEXEC);
+	if (fd < 0) {
+		LogErrno(inotify_domain, "fanotify_init() has failed");
+		return false;
+	}
+
+	if (fanotify_mark(fd, FAN_MARK_ADD|FAN_MARK_FILESYSTEM, FAN_MASK,
+			  AT_FDCWD, root.c_str()) < 0) {
+		LogErrno(inotify_domain, "fanotify_mark() has failed");
+		close(fd);
+		return false;
+	}
+
+	const int mount_fd = open(root.c_str(),
+				  O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+	if (mount_fd < 0) {
+		FormatErrno(inotify_domain, "Failed to open %s",
+			    root.c_str());
+		close(fd);
+		return false;
+	}
+
+	if (!CanOpenByHandle(root.c_str(), mount_fd)) {
+		LogErrno(inotify_domain, "open_by_handle_at() has failed");
+		close(mount_fd);
+		close(fd);
+		return false;
+	}
+
+	fanotify_monitor = new FanotifyMonitor(loop, fd, mount_fd,
+					       std::move(root),
+					       update, max_depth);
+
+	LogDebug(inotify_domain, "watching music directory with fanotify");
+	return true;
+}
+
+void
+mpd_fanotify_finish()
+{
+	delete fanotify_monitor;
+	fanotify_monitor = nullptr;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_FANOTIFY_UPDATE_HXX
+#define MPD_FANOTIFY_UPDATE_HXX
+
+#include "check.h"
+
+class EventLoop;
+class Storage;
+class UpdateService;
+
+/**
+ * Watch the whole file system containing the music directory with
+ * one fanotify descriptor, instead of one inotify watch per
+ * directory.  This requires Linux 5.1 and the capabilities
+ * CAP_SYS_ADMIN and CAP_DAC_READ_SEARCH.
+ *
+ * @return false if fanotify is not available; the caller should
+ * fall back to mpd_inotify_init() then
+ */
+bool
+mpd_fanotify_init(EventLoop &loop, Storage &storage, UpdateService &update,
+		  unsigned max_depth);
+
+void
+mpd_fanotify_finish();
+
+#endif
@@ -40,7 +40,7 @@ InotifyQueue::OnTimeout()
 	while (!queue.empty()) {
 		const char *uri_utf8 = queue.front().c_str();
 
-		id = update.Enqueue(uri_utf8, false);
+		id = update.Enqueue(uri_utf8, false, true);
 		if (id == 0) {
 			/* retry later */
 			ScheduleSeconds(INOTIFY_UPDATE_DELAY_S);
@@ -59,7 +59,7 @@ path_in(const char *path, const char *possible_parent)
 {
 	size_t length = strlen(possible_parent);
 
-	return path[0] == 0 ||
+	return possible_parent[0] == 0 ||
 		(memcmp(possible_parent, path, length) == 0 &&
 		 (path[length] == 0 || path[length] == '/'));
 }
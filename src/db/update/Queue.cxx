@@ -20,15 +20,73 @@
 #include "config.h"
 #include "Queue.hxx"
 
+#include <algorithm>
+
+/**
+ * Is #path equal to #parent or inside it?
+ */
+gcc_pure
+static bool
+PathIn(const std::string &path, const std::string &parent)
+{
+	return parent.empty() ||
+		(path.compare(0, parent.length(), parent) == 0 &&
+		 (path.length() == parent.length() ||
+		  path[parent.length()] == '/'));
+}
+
 bool
+UpdateQueueItem::Covers(const UpdateQueueItem &other) const
+{
+	return db == other.db && storage == other.storage &&
+		(discard || !other.discard) &&
+		PathIn(other.path_utf8, path_utf8);
+}
+
+unsigned
 UpdateQueue::Push(SimpleDatabase &db, Storage &storage,
-		  const char *path, bool discard, unsigned id)
+		  const char *path, bool discard, bool background,
+		  unsigned id)
 {
+	UpdateQueueItem item(db, storage, path, discard, background, id);
+
+	for (auto i = update_queue.begin(), end = update_queue.end();
+	     i != end;) {
+		if (i->Covers(item)) {
+			if (background || !i->background)
+				return i->id;
+
+			/* a client is waiting for this job now: move
+			   it before the background jobs */
+			item = std::move(*i);
+			item.background = false;
+			update_queue.erase(i);
+			break;
+		}
+
+		if (item.Covers(*i)) {
+			/* the new job does all the work of this one,
+			   which becomes obsolete */
+			item.background &= i->background;
+			i = update_queue.erase(i);
+		} else
+			++i;
+	}
+
 	if (update_queue.size() >= MAX_UPDATE_QUEUE_SIZE)
-		return false;
+		return 0;
+
+	auto position = update_queue.end();
+	if (!item.background)
+		position = std::find_if(update_queue.begin(),
+					update_queue.end(),
+					[](const UpdateQueueItem &i){
+						return i.background;
+					});
 
-	update_queue.emplace_back(db, storage, path, discard, id);
-	return true;
+	id = item.id;
+	update_queue.insert(position, std::move(item));
+	return id;
 }
 
 UpdateQueueItem
@@ -37,18 +37,30 @@ struct UpdateQueueItem {
 	unsigned id;
 	bool discard;
 
+	/**
+	 * Was this job submitted by a background source (inotify),
+	 * and not by a client?  Client requests are run first.
+	 */
+	bool background;
+
 	UpdateQueueItem():id(0) {}
 
 	UpdateQueueItem(SimpleDatabase &_db,
 			Storage &_storage,
-			const char *_path, bool _discard,
+			const char *_path, bool _discard, bool _background,
 			unsigned _id)
 		:db(&_db), storage(&_storage), path_utf8(_path),
-		 id(_id), discard(_discard) {}
+		 id(_id), discard(_discard), background(_background) {}
 
 	bool IsDefined() const {
 		return id != 0;
 	}
+
+	/**
+	 * Does this job update everything the other one would?
+	 */
+	gcc_pure
+	bool Covers(const UpdateQueueItem &other) const;
 };
 
 class UpdateQueue {
@@ -57,12 +69,31 @@ class UpdateQueue {
 	std::list<UpdateQueueItem> update_queue;
 
 public:
+	/**
+	 * Add a job to the queue.  If a queued job covers it
+	 * already, no new job is added; queued jobs which are covered
+	 * by the new one are removed.  Jobs which are not submitted
+	 * in the background are moved before all background jobs.
+	 *
+	 * @param id the id for a new job
+	 * @return the id of the job which will do the update (either
+	 * #id or the id of an existing job), or 0 if the queue is full
+	 */
 	gcc_nonnull_all
-	bool Push(SimpleDatabase &db, Storage &storage,
-		  const char *path, bool discard, unsigned id);
+	unsigned Push(SimpleDatabase &db, Storage &storage,
+		      const char *path, bool discard, bool background,
+		      unsigned id);
 
 	UpdateQueueItem Pop();
 
+	/**
+	 * Returns the number of jobs waiting in the queue.
+	 */
+	gcc_pure
+	unsigned GetSize() const {
+		return update_queue.size();
+	}
+
 	void Clear() {
 		update_queue.clear();
 	}
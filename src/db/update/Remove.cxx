@@ -34,35 +34,71 @@
 void
 UpdateRemoveService::RunDeferred()
 {
-	assert(removed_song != nullptr);
+	assert(removed_songs != nullptr || moved_songs != nullptr);
 
-	{
-		const auto uri = removed_song->GetURI();
-		FormatDefault(update_domain, "removing %s", uri.c_str());
+	if (moved_songs != nullptr) {
+		for (const auto &i : *moved_songs) {
+			FormatDefault(update_domain, "moved %s to %s",
+				      i.first.c_str(), i.second.c_str());
+
+			listener.OnDatabaseSongMoved(i.first.c_str(),
+						     i.second.c_str());
+		}
 	}
 
-	listener.OnDatabaseSongRemoved(removed_song->Export());
+	if (removed_songs != nullptr) {
+		for (const Song *song : *removed_songs) {
+			{
+				const auto uri = song->GetURI();
+				FormatDefault(update_domain, "removing %s",
+					      uri.c_str());
+			}
+
+			listener.OnDatabaseSongRemoved(song->Export());
+		}
+	}
 
-	/* clear "removed_song" and send signal to update thread */
+	/* clear "removed_songs" and send signal to update thread */
 	remove_mutex.lock();
-	removed_song = nullptr;
+	removed_songs = nullptr;
+	moved_songs = nullptr;
 	remove_cond.signal();
 	remove_mutex.unlock();
 }
 
-void
-UpdateRemoveService::Remove(const Song *song)
+inline void
+UpdateRemoveService::Wait()
 {
-	assert(removed_song == nullptr);
-
-	removed_song = song;
-
 	DeferredMonitor::Schedule();
 
 	remove_mutex.lock();
 
-	while (removed_song != nullptr)
+	while (removed_songs != nullptr || moved_songs != nullptr)
 		remove_cond.wait(remove_mutex);
 
 	remove_mutex.unlock();
 }
+
+void
+UpdateRemoveService::Remove(const std::vector<Song *> &songs)
+{
+	assert(removed_songs == nullptr);
+
+	if (songs.empty())
+		return;
+
+	removed_songs = &songs;
+	Wait();
+}
+
+void
+UpdateRemoveService::Move(const MovedList &songs)
+{
+	assert(moved_songs == nullptr);
+
+	if (songs.empty())
+		return;
+
+	moved_songs = &songs;
+	Wait();
+}
@@ -25,6 +25,10 @@
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
 
+#include <vector>
+#include <string>
+#include <utility>
+
 struct Song;
 class DatabaseListener;
 
@@ -33,27 +37,45 @@ class DatabaseListener;
  * thread to ensure that all references to the #Song are gone.
  */
 class UpdateRemoveService final : DeferredMonitor {
+public:
+	/**
+	 * Pairs of old and new song URIs.
+	 */
+	typedef std::vector<std::pair<std::string, std::string>> MovedList;
+
+private:
 	DatabaseListener &listener;
 
 	Mutex remove_mutex;
 	Cond remove_cond;
 
-	const Song *removed_song;
+	const std::vector<Song *> *removed_songs;
+
+	const MovedList *moved_songs;
 
 public:
 	UpdateRemoveService(EventLoop &_loop, DatabaseListener &_listener)
 		:DeferredMonitor(_loop), listener(_listener),
-		 removed_song(nullptr){}
+		 removed_songs(nullptr), moved_songs(nullptr) {}
 
 	/**
 	 * Sends a signal to the main thread which will in turn remove
-	 * the song: from the sticker database and from the playlist.
+	 * the songs: from the sticker database and from the playlist.
 	 * This serialized access is implemented to avoid excessive
-	 * locking.
+	 * locking.  Returns after the main thread has handled all of
+	 * them.
 	 */
-	void Remove(const Song *song);
+	void Remove(const std::vector<Song *> &songs);
+
+	/**
+	 * Like Remove(), but announces songs which have been moved to
+	 * a new URI, so their stickers can be migrated.
+	 */
+	void Move(const MovedList &songs);
 
 private:
+	void Wait();
+
 	/* virtual methods from class DeferredMonitor */
 	virtual void RunDeferred() override;
 };
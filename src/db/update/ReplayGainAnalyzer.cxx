@@ -0,0 +1,273 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h" /* must be first for large file support */
+#include "ReplayGainAnalyzer.hxx"
+#include "UpdateDomain.hxx"
+#include "decoder/DecoderThread.hxx"
+#include "DecoderPipe.hxx"
+#include "DetachedSong.hxx"
+#include "MusicChunk.hxx"
+#include "ReplayGainInfo.hxx"
+#include "MixRampInfo.hxx"
+#include "AudioFormat.hxx"
+#include "pcm/PcmConvert.hxx"
+#include "pcm/Loudness.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <vector>
+
+#include <math.h>
+
+/**
+ * Measures the RMS level of consecutive blocks of a song, and
+ * derives MixRamp envelopes from them: the time at which the song
+ * first reaches a certain level, and the time before its end at
+ * which it last had that level.
+ */
+class MixRampMeter {
+	/**
+	 * The duration of one block in seconds.
+	 */
+	static constexpr float BLOCK_DURATION = 0.1;
+
+	/**
+	 * The levels [dBFS] at which envelope points are generated.
+	 */
+	static constexpr float levels[] = {
+		-90, -60, -50, -40, -30, -25, -20, -15, -10, -6, -3, 0,
+	};
+
+	unsigned channels, block_frames, frames;
+
+	double sum;
+
+	/**
+	 * The RMS level [dBFS] of each block.
+	 */
+	std::vector<float> blocks;
+
+public:
+	void Open(unsigned sample_rate, unsigned _channels) {
+		channels = _channels;
+		block_frames = sample_rate * BLOCK_DURATION;
+		frames = 0;
+		sum = 0;
+		blocks.clear();
+	}
+
+	void Feed(const float *data, unsigned n_frames) {
+		for (unsigned i = 0; i < n_frames; ++i) {
+			for (unsigned c = 0; c < channels; ++c, ++data)
+				sum += *data * *data;
+
+			if (++frames == block_frames)
+				FinishBlock();
+		}
+	}
+
+	void Finish(MixRampInfo &info) {
+		if (frames > 0)
+			FinishBlock();
+
+		const size_t n = blocks.size();
+		if (n == 0)
+			return;
+
+		MixRampEnvelope &start = info.GetStart();
+		for (float level : levels) {
+			size_t i = 0;
+			while (i < n && blocks[i] < level)
+				++i;
+
+			if (i == n)
+				break;
+
+			start.Append(level, i * BLOCK_DURATION);
+		}
+
+		MixRampEnvelope &end = info.GetEnd();
+		for (float level : levels) {
+			size_t i = n;
+			while (i > 0 && blocks[i - 1] < level)
+				--i;
+
+			if (i == 0)
+				break;
+
+			end.Append(level, (n - i) * BLOCK_DURATION);
+		}
+	}
+
+private:
+	void FinishBlock() {
+		const double mean = sum / (frames * channels);
+		blocks.push_back(mean > 0 ? 10 * log10(mean) : -200);
+		frames = 0;
+		sum = 0;
+	}
+};
+
+constexpr float MixRampMeter::levels[];
+
+ReplayGainAnalyzer::ReplayGainAnalyzer()
+	:dc(mutex, cond), buffer(BUFFER_CHUNKS, CHUNK_SIZE)
+{
+	decoder_thread_start(dc);
+}
+
+ReplayGainAnalyzer::~ReplayGainAnalyzer()
+{
+	dc.Quit();
+}
+
+bool
+ReplayGainAnalyzer::Analyze(const char *uri, ReplayGainTuple &result,
+			    MixRampInfo &mix_ramp,
+			    const volatile bool &cancel)
+{
+	result.Clear();
+	mix_ramp.Clear();
+
+	DecoderPipe pipe(buffer.GetSize());
+	dc.Start(new DetachedSong(uri), 0, 0, buffer, pipe);
+
+	PcmConvert convert;
+	LoudnessMeter meter;
+	MixRampMeter ramp_meter;
+	AudioFormat format = AudioFormat::Undefined();
+	bool success = true;
+
+	/* these flags are cleared when the decoder finds tags which
+	   make the respective analysis obsolete */
+	bool want_gain = true, want_ramp = true;
+
+	dc.Lock();
+
+	while (true) {
+		if (want_ramp && (dc.GetMixRampStart().IsDefined() ||
+				  dc.GetMixRampEnd().IsDefined()))
+			want_ramp = false;
+
+		if (pipe.IsEmpty()) {
+			if (dc.IsIdle())
+				break;
+
+			/* wake up the decoder in case it waits for
+			   free chunks; the timeout recovers from a
+			   wakeup which it sent before we started
+			   waiting */
+			dc.Signal();
+			dc.WaitForDecoder(100);
+			continue;
+		}
+
+		if (!format.IsDefined()) {
+			format = dc.out_audio_format;
+
+			const AudioFormat float_format(format.sample_rate,
+						       SampleFormat::FLOAT,
+						       format.channels);
+			Error error;
+			if (!convert.Open(format, float_format, error)) {
+				LogError(error);
+				format.Clear();
+				success = false;
+				break;
+			}
+
+			meter.Open(format.sample_rate, format.channels);
+			ramp_meter.Open(format.sample_rate, format.channels);
+		}
+
+		dc.Unlock();
+
+		MusicChunk *chunk;
+		while (success && (chunk = pipe.Shift()) != nullptr) {
+			if (chunk->replay_gain_serial != 0)
+				want_gain = false;
+
+			if (cancel || (!want_gain && !want_ramp)) {
+				/* cancelled, or the file has tags
+				   which make the analysis obsolete */
+				success = false;
+			} else if (!chunk->IsEmpty()) {
+				Error error;
+				auto src = convert.Convert({chunk->data,
+							   chunk->length},
+							  error);
+				if (src.IsNull()) {
+					LogError(error);
+					success = false;
+				} else {
+					const auto f =
+						ConstBuffer<float>::FromVoid(src);
+					const unsigned n_frames =
+						f.size / format.channels;
+					if (want_gain)
+						meter.Feed(f.data, n_frames);
+					if (want_ramp)
+						ramp_meter.Feed(f.data,
+								n_frames);
+				}
+			}
+
+			buffer.Return(chunk);
+		}
+
+		dc.Lock();
+
+		if (!success)
+			break;
+	}
+
+	if (success && dc.HasFailed()) {
+		FormatDebug(update_domain, "failed to analyze %s: %s",
+			    uri, dc.error.GetMessage());
+		success = false;
+	}
+
+	dc.Unlock();
+
+	if (!success) {
+		dc.Stop();
+		pipe.Clear(buffer);
+	}
+
+	dc.pipe = nullptr;
+
+	if (format.IsDefined())
+		convert.Close();
+
+	if (!success)
+		return false;
+
+	if (want_gain && meter.IsDefined()) {
+		result.gain = REFERENCE_LOUDNESS -
+			meter.GetIntegratedLoudness();
+		result.peak = meter.GetTruePeak();
+	}
+
+	if (want_ramp)
+		ramp_meter.Finish(mix_ramp);
+
+	return result.IsDefined() || mix_ramp.IsDefined();
+}
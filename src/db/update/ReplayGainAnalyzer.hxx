@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_UPDATE_REPLAY_GAIN_ANALYZER_HXX
+#define MPD_UPDATE_REPLAY_GAIN_ANALYZER_HXX
+
+#include "check.h"
+#include "decoder/DecoderControl.hxx"
+#include "MusicBuffer.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+
+struct ReplayGainTuple;
+class MixRampInfo;
+
+/**
+ * Decodes song files in the update thread and measures their
+ * loudness, to provide replay gain values and MixRamp envelopes for
+ * files which have no such tags.  This uses a private decoder thread, and
+ * consumes its output like the player thread does.
+ */
+class ReplayGainAnalyzer {
+	/**
+	 * The loudness reference of ReplayGain 2.0 in LUFS.
+	 */
+	static constexpr double REFERENCE_LOUDNESS = -18;
+
+	/**
+	 * The number of chunks in the private #MusicBuffer.
+	 */
+	static constexpr unsigned BUFFER_CHUNKS = 64;
+
+	Mutex mutex;
+	Cond cond;
+
+	DecoderControl dc;
+
+	MusicBuffer buffer;
+
+public:
+	ReplayGainAnalyzer();
+	~ReplayGainAnalyzer();
+
+	ReplayGainAnalyzer(const ReplayGainAnalyzer &) = delete;
+	ReplayGainAnalyzer &operator=(const ReplayGainAnalyzer &) = delete;
+
+	/**
+	 * Decode the specified file and calculate its track gain,
+	 * true peak and MixRamp envelopes.
+	 *
+	 * @param uri the "real" URI of the file, suitable for the
+	 * decoder thread (see Storage::MapUTF8())
+	 * @param result receives the track gain; it remains undefined
+	 * if the file has replay gain tags
+	 * @param mix_ramp receives the MixRamp envelopes; they remain
+	 * undefined if the file has MixRamp tags
+	 * @param cancel a flag which makes this method return early
+	 * @return false if the file has both kinds of tags already,
+	 * could not be decoded or is too short to be measured, or if
+	 * the operation was cancelled
+	 */
+	bool Analyze(const char *uri, ReplayGainTuple &result,
+		     MixRampInfo &mix_ramp,
+		     const volatile bool &cancel);
+};
+
+#endif
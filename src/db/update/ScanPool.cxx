@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h" /* must be first for large file support */
+#include "ScanPool.hxx"
+#include "UpdateDomain.hxx"
+#include "UpdateStats.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "thread/Name.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <assert.h>
+
+UpdateScanPool::UpdateScanPool(Storage &_storage,
+			       const volatile bool &_cancel,
+			       UpdateStats &_stats,
+			       unsigned n_threads)
+	:storage(_storage), cancel(_cancel), stats(_stats),
+	 n_busy(0), max_queue(n_threads * MAX_QUEUE_PER_THREAD),
+	 quit(false)
+{
+	assert(n_threads > 0);
+
+	for (unsigned i = 0; i < n_threads; ++i) {
+		threads.emplace_back();
+
+		Error error;
+		if (!threads.back().Start(Run, this, error)) {
+			LogError(error);
+			threads.pop_back();
+			break;
+		}
+	}
+}
+
+UpdateScanPool::~UpdateScanPool()
+{
+	mutex.lock();
+	assert(queue.empty());
+	assert(done.empty());
+	assert(n_busy == 0);
+	quit = true;
+	cond.broadcast();
+	mutex.unlock();
+
+	for (auto &thread : threads)
+		thread.Join();
+}
+
+void
+UpdateScanPool::Push(Directory &directory, Song *song, Song *existing)
+{
+	assert(IsDefined());
+	assert(song != nullptr);
+
+	const ScopeLock protect(mutex);
+
+	while (queue.size() >= max_queue)
+		done_cond.wait(mutex);
+
+	queue.push_back({&directory, song, existing, false});
+	cond.signal();
+}
+
+void
+UpdateScanPool::Collect(std::list<Job> &dest, bool wait)
+{
+	const ScopeLock protect(mutex);
+
+	if (wait)
+		while (!queue.empty() || n_busy > 0)
+			done_cond.wait(mutex);
+
+	dest.splice(dest.end(), done);
+}
+
+inline void
+UpdateScanPool::Run()
+{
+	const ScopeLock protect(mutex);
+
+	while (true) {
+		if (queue.empty()) {
+			if (quit)
+				break;
+
+			cond.wait(mutex);
+			continue;
+		}
+
+		Job job = queue.front();
+		queue.pop_front();
+		++n_busy;
+
+		mutex.unlock();
+
+		/* once the update is canceled, the results are
+		   discarded anyway */
+		const uint64_t start = MonotonicClockUS();
+		job.success = !cancel &&
+			(job.directory->device == DEVICE_INARCHIVE
+			 ? job.song->UpdateFileInArchive(storage)
+			 : job.song->UpdateFile(storage));
+		stats.CountScan(start);
+
+		mutex.lock();
+
+		--n_busy;
+		done.push_back(job);
+		done_cond.broadcast();
+	}
+}
+
+void
+UpdateScanPool::Run(void *ctx)
+{
+	SetThreadName("update_scan");
+
+	UpdateScanPool &pool = *(UpdateScanPool *)ctx;
+	pool.Run();
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_UPDATE_SCAN_POOL_HXX
+#define MPD_UPDATE_SCAN_POOL_HXX
+
+#include "check.h"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+
+#include <list>
+
+struct Directory;
+struct Song;
+class Storage;
+struct UpdateStats;
+
+/**
+ * Worker threads which load the tags of song files (including
+ * songs inside archives) for #UpdateWalk.  The directory walk remains in the update thread; it
+ * submits new and modified song files with Push(), and commits the
+ * results returned by Collect() in batches.  On a file server, this
+ * hides the latency of opening each file.
+ */
+class UpdateScanPool {
+public:
+	struct Job {
+		Directory *directory;
+
+		/**
+		 * A new #Song object which is not yet in the
+		 * #directory; the worker loads its tags.
+		 */
+		Song *song;
+
+		/**
+		 * The song in the #directory which shall be replaced
+		 * with #song, or nullptr if the file is new.
+		 */
+		Song *existing;
+
+		/**
+		 * Was the file loaded successfully?
+		 */
+		bool success;
+	};
+
+private:
+	/**
+	 * The maximum number of queued jobs per thread.  Push()
+	 * blocks when this is exceeded.
+	 */
+	static constexpr unsigned MAX_QUEUE_PER_THREAD = 8;
+
+	Storage &storage;
+
+	/**
+	 * Shared with #UpdateWalk: workers skip the remaining jobs
+	 * when it is set.
+	 */
+	const volatile bool &cancel;
+
+	UpdateStats &stats;
+
+	Mutex mutex;
+
+	/**
+	 * Signalled when a job is added to the #queue, and on
+	 * #quit.
+	 */
+	Cond cond;
+
+	/**
+	 * Signalled when a job is finished.
+	 */
+	Cond done_cond;
+
+	std::list<Job> queue, done;
+
+	/**
+	 * The number of jobs which are being loaded right now.
+	 */
+	unsigned n_busy;
+
+	unsigned max_queue;
+
+	bool quit;
+
+	std::list<Thread> threads;
+
+public:
+	UpdateScanPool(Storage &_storage, const volatile bool &_cancel,
+		       UpdateStats &_stats, unsigned n_threads);
+
+	/**
+	 * Stops all threads.  All jobs must have been collected.
+	 */
+	~UpdateScanPool();
+
+	UpdateScanPool(const UpdateScanPool &) = delete;
+	UpdateScanPool &operator=(const UpdateScanPool &) = delete;
+
+	/**
+	 * Have any threads been started?  If not, this object must
+	 * not be used.
+	 */
+	bool IsDefined() const {
+		return !threads.empty();
+	}
+
+	/**
+	 * Submit a song file.  Blocks while the queue is full.
+	 */
+	void Push(Directory &directory, Song *song, Song *existing);
+
+	/**
+	 * Move all finished jobs to the end of the given list.
+	 *
+	 * @param wait wait until all submitted jobs are finished?
+	 */
+	void Collect(std::list<Job> &dest, bool wait);
+
+private:
+	void Run();
+	static void Run(void *ctx);
+};
+
+#endif
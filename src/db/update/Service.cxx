@@ -31,9 +31,11 @@
 #include "Log.hxx"
 #include "Instance.hxx"
 #include "system/FatalError.hxx"
+#include "system/Clock.hxx"
 #include "thread/Id.hxx"
 #include "thread/Thread.hxx"
 #include "thread/Util.hxx"
+#include "thread/Scheduling.hxx"
 
 #ifndef NDEBUG
 #include "event/Loop.hxx"
@@ -49,6 +51,7 @@ UpdateService::UpdateService(EventLoop &_loop, SimpleDatabase &_db,
 	 listener(_listener),
 	 progress(UPDATE_PROGRESS_IDLE),
 	 update_task_id(0),
+	 start_time(0), finish_time(0),
 	 walk(nullptr)
 {
 }
@@ -80,9 +83,9 @@ UpdateService::CancelMount(const char *uri)
 	/* determine which (mounted) database will be updated and what
 	   storage will be scanned */
 
-	db_lock();
+	db_lock_shared();
 	const auto lr = db.GetRoot().LookupDirectory(uri);
-	db_unlock();
+	db_unlock_shared();
 
 	if (!lr.directory->IsMount())
 		return;
@@ -122,9 +125,12 @@ UpdateService::Task()
 		LogDebug(update_domain, "starting");
 
 	SetThreadIdlePriority();
+	thread_scheduling_apply("update");
 
+	next.db->BeginUpdate();
 	modified = walk->Walk(next.db->GetRoot(), next.path_utf8.c_str(),
 			      next.discard);
+	next.db->EndUpdate(modified);
 
 	if (modified || !next.db->FileExists()) {
 		Error error;
@@ -159,7 +165,10 @@ UpdateService::StartThread(UpdateQueueItem &&i)
 	modified = false;
 
 	next = std::move(i);
-	walk = new UpdateWalk(GetEventLoop(), listener, *next.storage);
+	start_time = MonotonicClockMS();
+	stats.Reset();
+	walk = new UpdateWalk(GetEventLoop(), listener, *next.storage,
+			      exclude_cache, stats);
 
 	Error error;
 	if (!update_thread.Start(Task, this, error))
@@ -179,7 +188,31 @@ UpdateService::GenerateId()
 }
 
 unsigned
-UpdateService::Enqueue(const char *path, bool discard)
+UpdateService::GetEta() const
+{
+	if (walk == nullptr || progress != UPDATE_PROGRESS_RUNNING)
+		return 0;
+
+	const unsigned visited = walk->GetVisitedDirectories();
+	const unsigned known = walk->GetKnownDirectories();
+	if (visited == 0 || visited >= known)
+		/* nothing to extrapolate from, or the job has found
+		   more directories than the database knew */
+		return 0;
+
+	const unsigned elapsed = (MonotonicClockMS() - start_time) / 1000;
+	return uint64_t(elapsed) * (known - visited) / visited;
+}
+
+unsigned
+UpdateService::GetStatsDuration() const
+{
+	return (progress == UPDATE_PROGRESS_IDLE ? finish_time
+		: MonotonicClockMS()) - start_time;
+}
+
+unsigned
+UpdateService::Enqueue(const char *path, bool discard, bool background)
 {
 	assert(GetEventLoop().IsInsideOrNull());
 
@@ -188,9 +221,9 @@ UpdateService::Enqueue(const char *path, bool discard)
 	SimpleDatabase *db2;
 	Storage *storage2;
 
-	db_lock();
+	db_lock_shared();
 	const auto lr = db.GetRoot().LookupDirectory(path);
-	db_unlock();
+	db_unlock_shared();
 	if (lr.directory->IsMount()) {
 		/* follow the mountpoint, update the mounted
 		   database */
@@ -228,15 +261,16 @@ UpdateService::Enqueue(const char *path, bool discard)
 
 	if (progress != UPDATE_PROGRESS_IDLE) {
 		const unsigned id = GenerateId();
-		if (!queue.Push(*db2, *storage2, path, discard, id))
-			return 0;
-
-		update_task_id = id;
-		return id;
+		const unsigned result = queue.Push(*db2, *storage2, path,
+						   discard, background, id);
+		if (result == id)
+			update_task_id = id;
+		return result;
 	}
 
 	const unsigned id = update_task_id = GenerateId();
-	StartThread(UpdateQueueItem(*db2, *storage2, path, discard, id));
+	StartThread(UpdateQueueItem(*db2, *storage2, path, discard,
+				    background, id));
 
 	idle_add(IDLE_UPDATE);
 
@@ -261,6 +295,8 @@ UpdateService::RunDeferred()
 	delete walk;
 	walk = nullptr;
 
+	finish_time = MonotonicClockMS();
+
 	next = UpdateQueueItem();
 
 	idle_add(IDLE_UPDATE);
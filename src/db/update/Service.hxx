@@ -22,6 +22,8 @@
 
 #include "check.h"
 #include "Queue.hxx"
+#include "ExcludeList.hxx"
+#include "UpdateStats.hxx"
 #include "event/DeferredMonitor.hxx"
 #include "thread/Thread.hxx"
 
@@ -59,8 +61,25 @@ class UpdateService final : DeferredMonitor {
 
 	UpdateQueueItem next;
 
+	/**
+	 * The time when the current (or the last) job was started,
+	 * and when the last job was finished [MonotonicClockMS()].
+	 */
+	unsigned start_time, finish_time;
+
+	/**
+	 * Progress counters of the current (or the last) job.
+	 */
+	UpdateStats stats;
+
 	UpdateWalk *walk;
 
+	/**
+	 * The .mpdignore files parsed by previous updates.  Only
+	 * the update thread uses it.
+	 */
+	ExcludeListCache exclude_cache;
+
 public:
 	UpdateService(EventLoop &_loop, SimpleDatabase &_db,
 		      CompositeStorage &_storage,
@@ -76,15 +95,51 @@ public:
 		return next.id;
 	}
 
+	/**
+	 * Returns the number of jobs waiting for the current one to
+	 * finish.
+	 */
+	gcc_pure
+	unsigned GetQueueSize() const {
+		return queue.GetSize();
+	}
+
+	/**
+	 * Estimate the number of seconds until the current job is
+	 * finished, from the number of directories it has visited so
+	 * far.  Returns 0 if no estimate is available.
+	 */
+	gcc_pure
+	unsigned GetEta() const;
+
+	/**
+	 * Returns the counters of the current job, or of the last
+	 * one if no update is running.
+	 */
+	const UpdateStats &GetStats() const {
+		return stats;
+	}
+
+	/**
+	 * Returns the number of milliseconds the job described by
+	 * GetStats() has been running (or has taken).
+	 */
+	gcc_pure
+	unsigned GetStatsDuration() const;
+
 	/**
 	 * Add this path to the database update queue.
 	 *
 	 * @param path a path to update; if an empty string,
 	 * the whole music directory is updated
-	 * @return the job id, or 0 on error
+	 * @param background true if no client has requested this
+	 * update (e.g. inotify); client requests are run first
+	 * @return the job id, or 0 on error; if a queued job covers
+	 * this path already, its id is returned
 	 */
 	gcc_nonnull_all
-	unsigned Enqueue(const char *path, bool discard);
+	unsigned Enqueue(const char *path, bool discard,
+			 bool background=false);
 
 	/**
 	 * Clear the queue and cancel the current update.  Does not
@@ -23,7 +23,6 @@
 #include "db/plugins/simple/Directory.hxx"
 #include "storage/FileInfo.hxx"
 #include "storage/StorageInterface.hxx"
-#include "fs/Traits.hxx"
 #include "fs/FileSystem.hxx"
 #include "util/Error.hxx"
 #include "Log.hxx"
@@ -51,38 +50,6 @@ GetInfo(StorageDirectoryReader &reader, FileInfo &info)
 	return success;
 }
 
-bool
-DirectoryExists(Storage &storage, const Directory &directory)
-{
-	FileInfo info;
-	if (!storage.GetInfo(directory.GetPath(), true, info, IgnoreError()))
-		return false;
-
-	return directory.device == DEVICE_INARCHIVE ||
-		directory.device == DEVICE_CONTAINER
-		? info.IsRegular()
-		: info.IsDirectory();
-}
-
-static bool
-GetDirectoryChildInfo(Storage &storage, const Directory &directory,
-		      const char *name_utf8, FileInfo &info, Error &error)
-{
-	const auto uri_utf8 = PathTraitsUTF8::Build(directory.GetPath(),
-						    name_utf8);
-	return storage.GetInfo(uri_utf8.c_str(), true, info, error);
-}
-
-bool
-directory_child_is_regular(Storage &storage, const Directory &directory,
-			   const char *name_utf8)
-{
-	FileInfo info;
-	return GetDirectoryChildInfo(storage, directory, name_utf8, info,
-				     IgnoreError()) &&
-		info.IsRegular();
-}
-
 bool
 directory_child_access(Storage &storage, const Directory &directory,
 		       const char *name, int mode)
@@ -42,15 +42,6 @@ GetInfo(Storage &storage, const char *uri_utf8, FileInfo &info);
 bool
 GetInfo(StorageDirectoryReader &reader, FileInfo &info);
 
-gcc_pure
-bool
-DirectoryExists(Storage &storage, const Directory &directory);
-
-gcc_pure
-bool
-directory_child_is_regular(Storage &storage, const Directory &directory,
-			   const char *name_utf8);
-
 /**
  * Checks if the given permissions on the mapped file are given.
  */
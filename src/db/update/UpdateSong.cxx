@@ -21,23 +21,174 @@
 #include "Walk.hxx"
 #include "UpdateIO.hxx"
 #include "UpdateDomain.hxx"
+#include "ReplayGainAnalyzer.hxx"
+#include "ScanPool.hxx"
 #include "db/DatabaseLock.hxx"
 #include "db/plugins/simple/Directory.hxx"
 #include "db/plugins/simple/Song.hxx"
 #include "decoder/DecoderList.hxx"
+#include "storage/StorageInterface.hxx"
 #include "storage/FileInfo.hxx"
+#include "ReplayGainInfo.hxx"
+#include "MixRampInfo.hxx"
 #include "Log.hxx"
 
+#include <vector>
+
+#include <assert.h>
 #include <unistd.h>
 
+void
+UpdateWalk::AnalyzeSong(Song &song)
+{
+	assert(analyzer != nullptr);
+
+	const auto uri = song.GetURI();
+	const auto real_uri = storage.MapUTF8(uri.c_str());
+
+	ReplayGainTuple track;
+	MixRampInfo mix_ramp;
+	if (!analyzer->Analyze(real_uri.c_str(), track, mix_ramp, cancel))
+		return;
+
+	if (track.IsDefined())
+		FormatDebug(update_domain, "analyzed %s: %.2f dB, peak %f",
+			    uri.c_str(), track.gain, track.peak);
+
+	db_lock();
+	song.replay_gain.Clear();
+	song.replay_gain.tuples[REPLAY_GAIN_TRACK] = track;
+	if (mix_ramp.IsDefined())
+		song.SetMixRamp(mix_ramp);
+	else
+		song.ClearMixRamp();
+	db_unlock();
+}
+
+void
+UpdateWalk::Commit()
+{
+	if (!added_songs.empty()) {
+		db_lock();
+		for (Song *song : added_songs)
+			song->parent->AddSong(song);
+		db_unlock();
+
+		added_songs.clear();
+	}
+
+	editor.Commit();
+}
+
+void
+UpdateWalk::CommitScanResults(bool wait)
+{
+	assert(scan_pool != nullptr);
+
+	std::list<UpdateScanPool::Job> jobs;
+	scan_pool->Collect(jobs, wait);
+	if (jobs.empty())
+		return;
+
+	if (cancel) {
+		for (const auto &job : jobs)
+			job.song->Free();
+		return;
+	}
+
+	for (const auto &job : jobs)
+		if (!job.success)
+			FormatDebug(update_domain, job.existing == nullptr
+				    ? "ignoring unrecognized file %s/%s"
+				    : "deleting unrecognized file %s/%s",
+				    job.directory->GetPath(),
+				    job.song->uri);
+
+	std::vector<Song *> analyze;
+
+	db_lock();
+
+	for (const auto &job : jobs) {
+		Directory &directory = *job.directory;
+
+		if (!job.success) {
+			if (job.existing != nullptr) {
+				editor.DeleteSong(directory, job.existing);
+				modified = true;
+			}
+
+			job.song->Free();
+		} else if (job.existing == nullptr) {
+			directory.AddSong(job.song);
+			modified = true;
+			analyze.push_back(job.song);
+		} else {
+			Song &song = *job.existing;
+			song.tag = std::move(job.song->tag);
+			song.mtime = job.song->mtime;
+			song.replay_gain.Clear();
+			song.ClearMixRamp();
+			job.song->Free();
+
+			/* the new tag may change the song's position */
+			directory.sorted = false;
+			modified = true;
+			analyze.push_back(&song);
+		}
+	}
+
+	db_unlock();
+
+	for (const auto &job : jobs)
+		if (job.success && job.existing == nullptr)
+			FormatDefault(update_domain, "added %s/%s",
+				      job.directory->GetPath(),
+				      job.song->uri);
+
+	if (analyzer != nullptr)
+		for (Song *song : analyze)
+			AnalyzeSong(*song);
+}
+
+bool
+UpdateWalk::RelinkMovedSong(Directory &directory, Directory &from,
+			    const char *name, const FileInfo &info)
+{
+	if (walk_discard)
+		return false;
+
+	db_lock_shared();
+	Song *old = from.FindSong(name);
+	const bool exists = directory.FindSong(name) != nullptr;
+	db_unlock_shared();
+
+	if (old == nullptr || exists || old->mtime != info.mtime)
+		return false;
+
+	/* "from" is detached, nobody else can see "old" anymore, and
+	   it is removed by DatabaseEditor::Finish(); steal its tag */
+	Song *song = Song::NewFile(name, directory);
+	song->tag = std::move(old->tag);
+	song->replay_gain = old->replay_gain;
+	std::swap(song->mix_ramp, old->mix_ramp);
+	song->mtime = old->mtime;
+	song->start_ms = old->start_ms;
+	song->end_ms = old->end_ms;
+
+	editor.SongMoved(*old, *song);
+	added_songs.push_back(song);
+	modified = true;
+	return true;
+}
+
 inline void
 UpdateWalk::UpdateSongFile2(Directory &directory,
 			    const char *name, const char *suffix,
 			    const FileInfo &info)
 {
-	db_lock();
+	db_lock_shared();
 	Song *song = directory.FindSong(name);
-	db_unlock();
+	db_unlock_shared();
 
 	if (!directory_child_access(storage, directory, name, R_OK)) {
 		FormatError(update_domain,
@@ -58,10 +209,31 @@ UpdateWalk::UpdateSongFile2(Directory &directory,
 		return;
 	}
 
+	if (scan_pool != nullptr &&
+	    (song == nullptr || info.mtime != song->mtime || walk_discard)) {
+		if (song == nullptr)
+			FormatDebug(update_domain, "reading %s/%s",
+				    directory.GetPath(), name);
+		else
+			FormatDefault(update_domain, "updating %s/%s",
+				      directory.GetPath(), name);
+
+		/* load into a new Song object; CommitScanResults()
+		   moves its tag to the existing one */
+		stats.CountSong(info.size);
+		scan_pool->Push(directory, Song::NewFile(name, directory),
+				song);
+		CommitScanResults(false);
+		return;
+	}
+
 	if (song == nullptr) {
 		FormatDebug(update_domain, "reading %s/%s",
 			    directory.GetPath(), name);
+		stats.CountSong(info.size);
+		const uint64_t start = MonotonicClockUS();
 		song = Song::LoadFile(storage, name, directory);
+		stats.CountScan(start);
 		if (song == nullptr) {
 			FormatDebug(update_domain,
 				    "ignoring unrecognized file %s/%s",
@@ -69,21 +241,31 @@ UpdateWalk::UpdateSongFile2(Directory &directory,
 			return;
 		}
 
-		db_lock();
-		directory.AddSong(song);
-		db_unlock();
-
+		added_songs.push_back(song);
 		modified = true;
 		FormatDefault(update_domain, "added %s/%s",
 			      directory.GetPath(), name);
+
+		if (analyzer != nullptr)
+			AnalyzeSong(*song);
 	} else if (info.mtime != song->mtime || walk_discard) {
 		FormatDefault(update_domain, "updating %s/%s",
 			      directory.GetPath(), name);
-		if (!song->UpdateFile(storage)) {
+		stats.CountSong(info.size);
+		const uint64_t start = MonotonicClockUS();
+		const bool success = song->UpdateFile(storage);
+		stats.CountScan(start);
+		if (!success) {
 			FormatDebug(update_domain,
 				    "deleting unrecognized file %s/%s",
 				    directory.GetPath(), name);
 			editor.LockDeleteSong(directory, song);
+		} else {
+			/* the new tag may change the song's position */
+			directory.sorted = false;
+
+			if (analyzer != nullptr)
+				AnalyzeSong(*song);
 		}
 
 		modified = true;
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_UPDATE_STATS_HXX
+#define MPD_UPDATE_STATS_HXX
+
+#include "check.h"
+#include "system/Clock.hxx"
+
+#include <atomic>
+
+#include <stdint.h>
+
+/**
+ * Counters about the current (or the last) database update.  They
+ * are written by the update thread and the scan threads, and read by
+ * the main thread for the "updatestats" command.
+ */
+struct UpdateStats {
+	/**
+	 * The number of directories visited so far.
+	 */
+	std::atomic_uint directories;
+
+	/**
+	 * The number of directory entries whose attributes were read.
+	 */
+	std::atomic_uint files;
+
+	/**
+	 * The number of song files whose tags were read, and their
+	 * total size in bytes.
+	 */
+	std::atomic_uint songs;
+	std::atomic<uint64_t> song_bytes;
+
+	/**
+	 * Microseconds spent listing directories and reading file
+	 * attributes from the #Storage.
+	 */
+	std::atomic<uint64_t> storage_us;
+
+	/**
+	 * Microseconds spent reading tags, summed over all scan
+	 * threads.
+	 */
+	std::atomic<uint64_t> scan_us;
+
+	UpdateStats() {
+		Reset();
+	}
+
+	void Reset() {
+		directories = 0;
+		files = 0;
+		songs = 0;
+		song_bytes = 0;
+		storage_us = 0;
+		scan_us = 0;
+	}
+
+	/**
+	 * Account the time of a tag scan which was started at the
+	 * given MonotonicClockUS() value.
+	 */
+	void CountScan(uint64_t start_us) {
+		scan_us += MonotonicClockUS() - start_us;
+	}
+
+	/**
+	 * Account one song file of the given size which is going to
+	 * be scanned.
+	 */
+	void CountSong(uint64_t size) {
+		++songs;
+		song_bytes += size;
+	}
+};
+
+#endif
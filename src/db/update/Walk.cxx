@@ -30,6 +30,8 @@
 #include "storage/StorageInterface.hxx"
 #include "playlist/PlaylistRegistry.hxx"
 #include "ExcludeList.hxx"
+#include "ReplayGainAnalyzer.hxx"
+#include "ScanPool.hxx"
 #include "config/ConfigGlobal.hxx"
 #include "config/ConfigOption.hxx"
 #include "fs/AllocatedPath.hxx"
@@ -50,11 +52,22 @@
 #include <memory>
 
 UpdateWalk::UpdateWalk(EventLoop &_loop, DatabaseListener &_listener,
-		       Storage &_storage)
-	:cancel(false),
+		       Storage &_storage, ExcludeListCache &_exclude_cache,
+		       UpdateStats &_stats)
+	:analyzer(nullptr), scan_pool(nullptr),
+	 cancel(false),
+	 n_known_directories(0), stats(_stats),
 	 storage(_storage),
+	 exclude_cache(_exclude_cache),
 	 editor(_loop, _listener)
 {
+	analyze_replay_gain = config_get_bool(CONF_REPLAYGAIN_ANALYSIS,
+					      false);
+
+	n_scan_threads = config_get_positive(CONF_UPDATE_THREADS, 1);
+
+	trust_mtime = config_get_bool(CONF_UPDATE_TRUST_MTIME, false);
+
 #ifndef WIN32
 	follow_inside_symlinks =
 		config_get_bool(CONF_FOLLOW_INSIDE_SYMLINKS,
@@ -73,6 +86,32 @@ directory_set_stat(Directory &dir, const FileInfo &info)
 	dir.device = info.device;
 }
 
+/**
+ * Calculate the (FNV-1a) hash of one directory entry.  The sum of
+ * all entries becomes Directory::fingerprint, which therefore does
+ * not depend on the order of the listing.
+ */
+gcc_pure
+static uint32_t
+FingerprintEntry(const char *name, const FileInfo &info)
+{
+	uint32_t h = 2166136261u;
+	while (*name != 0)
+		h = (h ^ (unsigned char)*name++) * 16777619u;
+
+	const uint64_t values[] = {
+		uint64_t(info.type),
+		info.IsRegular() ? info.size : 0,
+		uint64_t(info.mtime),
+	};
+
+	for (uint64_t v : values)
+		for (unsigned i = 0; i < sizeof(v); ++i, v >>= 8)
+			h = (h ^ (v & 0xff)) * 16777619u;
+
+	return h;
+}
+
 inline void
 UpdateWalk::RemoveExcludedFromDirectory(Directory &directory,
 					const ExcludeList &exclude_list)
@@ -102,38 +141,65 @@ UpdateWalk::RemoveExcludedFromDirectory(Directory &directory,
 	db_unlock();
 }
 
-inline void
-UpdateWalk::PurgeDeletedFromDirectory(Directory &directory)
+/**
+ * Does the given listing contain a regular file with this name?
+ */
+gcc_pure
+static bool
+ListingHasRegular(const UpdateWalk::Listing &listing, const char *name)
 {
-	directory.ForEachChildSafe([&](Directory &child){
-			if (DirectoryExists(storage, child))
-				return;
+	const auto i = listing.find(name);
+	return i != listing.end() && i->second.IsRegular();
+}
 
-			editor.LockDeleteDirectory(&child);
+inline void
+UpdateWalk::PurgeDeletedFromDirectory(Directory &directory,
+				      const Listing &listing)
+{
+	/* only this thread modifies the tree, so it can be inspected
+	   without the lock; all deletions are applied with one lock */
 
-			modified = true;
+	std::vector<Directory *> children;
+	directory.ForEachChildSafe([&](Directory &child){
+			const auto i = listing.find(child.GetName());
+			const bool exists = i != listing.end() &&
+				(child.device == DEVICE_INARCHIVE ||
+				 child.device == DEVICE_CONTAINER
+				 ? i->second.IsRegular()
+				 : i->second.IsDirectory());
+			if (!exists)
+				children.push_back(&child);
 		});
 
+	std::vector<Song *> songs;
 	directory.ForEachSongSafe([&](Song &song){
-			if (!directory_child_is_regular(storage, directory,
-							song.uri)) {
-				editor.LockDeleteSong(directory, &song);
-
-				modified = true;
-			}
+			if (!ListingHasRegular(listing, song.uri))
+				songs.push_back(&song);
 		});
 
-	for (auto i = directory.playlists.begin(),
-		     end = directory.playlists.end();
-	     i != end;) {
-		if (!directory_child_is_regular(storage, directory,
-						i->name.c_str())) {
-			db_lock();
-			i = directory.playlists.erase(i);
-			db_unlock();
-		} else
-			++i;
-	}
+	std::vector<std::string> playlists;
+	for (const auto &playlist : directory.playlists)
+		if (!ListingHasRegular(listing, playlist.name.c_str()))
+			playlists.push_back(playlist.name);
+
+	if (children.empty() && songs.empty() && playlists.empty())
+		return;
+
+	db_lock();
+
+	for (Directory *child : children)
+		editor.DeleteDirectory(child);
+
+	for (Song *song : songs)
+		editor.DeleteSong(directory, song);
+
+	for (const auto &name : playlists)
+		directory.playlists.erase(name.c_str());
+
+	db_unlock();
+
+	if (!children.empty() || !songs.empty())
+		modified = true;
 }
 
 #ifndef WIN32
@@ -230,9 +296,15 @@ UpdateWalk::UpdateDirectoryChild(Directory &directory,
 					info.inode, info.device))
 			return;
 
-		db_lock();
-		Directory *subdir = directory.MakeChild(name);
-		db_unlock();
+		db_lock_shared();
+		Directory *subdir = directory.FindChild(name);
+		db_unlock_shared();
+
+		if (subdir == nullptr) {
+			db_lock();
+			subdir = directory.MakeChild(name);
+			db_unlock();
+		}
 
 		assert(&directory == subdir->parent);
 
@@ -326,13 +398,58 @@ UpdateWalk::SkipSymlink(const Directory *directory,
 #endif
 }
 
+inline void
+UpdateWalk::UpdateChildDirectories(Directory &directory)
+{
+	/* only this thread modifies the tree, so it can be inspected
+	   without the lock */
+
+	std::vector<Directory *> children;
+	for (auto &child : directory.children)
+		if (!child.IsMount() &&
+		    child.device != DEVICE_INARCHIVE &&
+		    child.device != DEVICE_CONTAINER)
+			children.push_back(&child);
+
+	for (Directory *child : children) {
+		if (cancel)
+			break;
+
+		FileInfo info;
+		if (!GetInfo(storage, child->GetPath(), info) ||
+		    !info.IsDirectory() ||
+		    !UpdateDirectory(*child, info)) {
+			editor.LockDeleteDirectory(child);
+			modified = true;
+		}
+	}
+}
+
 bool
 UpdateWalk::UpdateDirectory(Directory &directory, const FileInfo &info)
 {
 	assert(info.IsDirectory());
 
+	++stats.directories;
+
 	directory_set_stat(directory, info);
 
+	/* a directory's mtime changes when entries are added, removed
+	   or renamed, but not when a file is modified; the
+	   fingerprint is only set after a complete scan */
+	const bool unchanged = !walk_discard &&
+		directory.fingerprint != 0 &&
+		directory.mtime == info.mtime;
+
+	if (unchanged && trust_mtime) {
+		/* don't look at the files at all, only descend into
+		   the known subdirectories */
+		UpdateChildDirectories(directory);
+		return true;
+	}
+
+	const uint64_t storage_start = MonotonicClockUS();
+
 	Error error;
 	const std::auto_ptr<StorageDirectoryReader> reader(storage.OpenDirectory(directory.GetPath(), error));
 	if (reader.get() == nullptr) {
@@ -340,19 +457,23 @@ UpdateWalk::UpdateDirectory(Directory &directory, const FileInfo &info)
 		return false;
 	}
 
-	ExcludeList exclude_list;
+	const ExcludeList *exclude_list = nullptr;
 
 	{
 		const auto exclude_path_fs =
 			storage.MapChildFS(directory.GetPath(), ".mpdignore");
 		if (!exclude_path_fs.IsNull())
-			exclude_list.LoadFile(exclude_path_fs);
+			exclude_list = exclude_cache.Get(exclude_path_fs);
 	}
 
-	if (!exclude_list.IsEmpty())
-		RemoveExcludedFromDirectory(directory, exclude_list);
+	if (exclude_list != nullptr && !exclude_list->IsEmpty())
+		RemoveExcludedFromDirectory(directory, *exclude_list);
 
-	PurgeDeletedFromDirectory(directory);
+	/* read the whole listing first: remote storages deliver the
+	   attributes together with the names, and the purge below can
+	   then look up each known entry without asking the storage
+	   again */
+	Listing listing;
 
 	const char *name_utf8;
 	while (!cancel && (name_utf8 = reader->Read()) != nullptr) {
@@ -361,7 +482,9 @@ UpdateWalk::UpdateDirectory(Directory &directory, const FileInfo &info)
 
 		{
 			const auto name_fs = AllocatedPath::FromUTF8(name_utf8);
-			if (name_fs.IsNull() || exclude_list.Check(name_fs))
+			if (name_fs.IsNull() ||
+			    (exclude_list != nullptr &&
+			     exclude_list->Check(name_fs)))
 				continue;
 		}
 
@@ -376,11 +499,50 @@ UpdateWalk::UpdateDirectory(Directory &directory, const FileInfo &info)
 			continue;
 		}
 
-		UpdateDirectoryChild(directory, name_utf8, info2);
+		listing.emplace(name_utf8, info2);
+	}
+
+	stats.files += listing.size();
+	stats.storage_us += MonotonicClockUS() - storage_start;
+
+	if (!cancel)
+		/* an incomplete listing would delete too much */
+		PurgeDeletedFromDirectory(directory, listing);
+
+	uint32_t fingerprint = 0;
+	for (const auto &i : listing)
+		fingerprint += FingerprintEntry(i.first.c_str(), i.second);
+
+	/* 0 means "unknown" */
+	if (fingerprint == 0)
+		fingerprint = 1;
+
+	/* a new directory with the same listing as one which was
+	   deleted earlier in this update has probably been renamed
+	   or moved: take over its songs instead of scanning them */
+	Directory *moved_from = directory.fingerprint == 0 && !cancel
+		? editor.FindVanished(fingerprint)
+		: nullptr;
+
+	for (const auto &i : listing) {
+		if (cancel)
+			break;
+
+		if (moved_from != nullptr && i.second.IsRegular() &&
+		    RelinkMovedSong(directory, *moved_from,
+				    i.first.c_str(), i.second))
+			continue;
+
+		UpdateDirectoryChild(directory, i.first.c_str(), i.second);
 	}
 
 	directory.mtime = info.mtime;
 
+	/* an incomplete scan must not be trusted next time */
+	directory.fingerprint = cancel ? 0 : fingerprint;
+
+	Commit();
+
 	return true;
 }
 
@@ -389,9 +551,9 @@ UpdateWalk::DirectoryMakeChildChecked(Directory &parent,
 				      const char *uri_utf8,
 				      const char *name_utf8)
 {
-	db_lock();
+	db_lock_shared();
 	Directory *directory = parent.FindChild(name_utf8);
-	db_unlock();
+	db_unlock_shared();
 
 	if (directory != nullptr) {
 		if (directory->IsMount())
@@ -471,21 +633,67 @@ UpdateWalk::UpdateUri(Directory &root, const char *uri)
 	UpdateDirectoryChild(*parent, name, info);
 }
 
+/**
+ * Count the given directory and all of its real subdirectories,
+ * i.e. those which UpdateWalk::UpdateDirectory() will visit.
+ */
+gcc_pure
+static unsigned
+CountDirectories(const Directory &directory)
+{
+	unsigned n = 1;
+	for (const auto &child : directory.children)
+		if (!child.IsMount() &&
+		    child.device != DEVICE_INARCHIVE &&
+		    child.device != DEVICE_CONTAINER)
+			n += CountDirectories(child);
+	return n;
+}
+
 bool
 UpdateWalk::Walk(Directory &root, const char *path, bool discard)
 {
 	walk_discard = discard;
 	modified = false;
 
+	db_lock_shared();
+	const auto lr = root.LookupDirectory(path != nullptr ? path : "");
+	n_known_directories = lr.uri == nullptr
+		? CountDirectories(*lr.directory)
+		: 1;
+	db_unlock_shared();
+
+	if (analyze_replay_gain)
+		analyzer = new ReplayGainAnalyzer();
+
+	if (n_scan_threads > 1) {
+		scan_pool = new UpdateScanPool(storage, cancel, stats,
+					       n_scan_threads);
+		if (!scan_pool->IsDefined()) {
+			delete scan_pool;
+			scan_pool = nullptr;
+		}
+	}
+
 	if (path != nullptr && !isRootDirectory(path)) {
 		UpdateUri(root, path);
 	} else {
 		FileInfo info;
-		if (!GetInfo(storage, "", info))
-			return false;
+		if (GetInfo(storage, "", info))
+			UpdateDirectory(root, info);
+	}
 
-		UpdateDirectory(root, info);
+	if (scan_pool != nullptr) {
+		CommitScanResults(true);
+		delete scan_pool;
+		scan_pool = nullptr;
 	}
 
+	Commit();
+	editor.Finish();
+
+	delete analyzer;
+	analyzer = nullptr;
+
 	return modified;
 }
@@ -22,15 +22,25 @@
 
 #include "check.h"
 #include "Editor.hxx"
+#include "UpdateStats.hxx"
+
+#include <vector>
+#include <unordered_map>
+#include <string>
+#include <atomic>
 
 #include <sys/stat.h>
 
 struct stat;
 struct FileInfo;
 struct Directory;
+struct Song;
 struct ArchivePlugin;
 class Storage;
 class ExcludeList;
+class ExcludeListCache;
+class ReplayGainAnalyzer;
+class UpdateScanPool;
 
 class UpdateWalk final {
 #ifdef ENABLE_ARCHIVE
@@ -48,6 +58,36 @@ class UpdateWalk final {
 	bool walk_discard;
 	bool modified;
 
+	/**
+	 * Measure the loudness of new and modified songs?
+	 * Configured with "replaygain_analysis".
+	 */
+	bool analyze_replay_gain;
+
+	/**
+	 * Only valid during Walk() if #analyze_replay_gain is set.
+	 */
+	ReplayGainAnalyzer *analyzer;
+
+	/**
+	 * The number of threads which load tags of song files.
+	 * Configured with "update_threads".
+	 */
+	unsigned n_scan_threads;
+
+	/**
+	 * Only valid during Walk() if #n_scan_threads is more than
+	 * one.
+	 */
+	UpdateScanPool *scan_pool;
+
+	/**
+	 * Skip directories whose mtime has not changed since the
+	 * last complete scan, without looking at their files.
+	 * Configured with "update_trust_mtime".
+	 */
+	bool trust_mtime;
+
 	/**
 	 * Set to true by the main thread when the update thread shall
 	 * cancel as quickly as possible.  Access to this flag is
@@ -55,13 +95,44 @@ class UpdateWalk final {
 	 */
 	volatile bool cancel;
 
+	/**
+	 * The number of directories which were in the database below
+	 * the given path when Walk() started.  It is written by the
+	 * update thread and read by the main thread to estimate the
+	 * remaining time.
+	 */
+	std::atomic_uint n_known_directories;
+
+	/**
+	 * Progress counters, owned by the #UpdateService.
+	 */
+	UpdateStats &stats;
+
 	Storage &storage;
 
+	/**
+	 * The parsed .mpdignore files, owned by the #UpdateService
+	 * so they survive this object.
+	 */
+	ExcludeListCache &exclude_cache;
+
 	DatabaseEditor editor;
 
+	/**
+	 * New songs which will be added to their parent directories
+	 * by the next Commit() call.
+	 */
+	std::vector<Song *> added_songs;
+
 public:
+	/**
+	 * The entries of one directory, mapped to their attributes.
+	 */
+	typedef std::unordered_map<std::string, FileInfo> Listing;
+
 	UpdateWalk(EventLoop &_loop, DatabaseListener &_listener,
-		   Storage &_storage);
+		   Storage &_storage, ExcludeListCache &_exclude_cache,
+		   UpdateStats &_stats);
 
 	/**
 	 * Cancel the current update and quit the Walk() method as
@@ -71,6 +142,14 @@ public:
 		cancel = true;
 	}
 
+	unsigned GetVisitedDirectories() const {
+		return stats.directories;
+	}
+
+	unsigned GetKnownDirectories() const {
+		return n_known_directories;
+	}
+
 	/**
 	 * Returns true if the database was modified.
 	 */
@@ -84,7 +163,39 @@ private:
 	void RemoveExcludedFromDirectory(Directory &directory,
 					 const ExcludeList &exclude_list);
 
-	void PurgeDeletedFromDirectory(Directory &directory);
+	/**
+	 * Delete all children, songs and playlists of the given
+	 * directory which are missing from the complete listing.
+	 */
+	void PurgeDeletedFromDirectory(Directory &directory,
+				       const Listing &listing);
+
+	void AnalyzeSong(Song &song);
+
+	/**
+	 * Apply the pending changes to the database: add the
+	 * #added_songs with one lock, and let the #editor finish
+	 * deleting songs and directories.  This is done after each
+	 * directory, to avoid locking the database for each song.
+	 */
+	void Commit();
+
+	/**
+	 * Apply the finished jobs of the #scan_pool to the database.
+	 *
+	 * @param wait wait until all submitted jobs are finished?
+	 */
+	void CommitScanResults(bool wait);
+
+	/**
+	 * Take over the song with the given name from a vanished
+	 * directory (see DatabaseEditor::FindVanished()) if the file
+	 * has not been modified, instead of scanning it again.
+	 *
+	 * @return true if the song has been relinked
+	 */
+	bool RelinkMovedSong(Directory &directory, Directory &from,
+			     const char *name, const FileInfo &info);
 
 	void UpdateSongFile2(Directory &directory,
 			     const char *name, const char *suffix,
@@ -130,6 +241,13 @@ private:
 	void UpdateDirectoryChild(Directory &directory,
 				  const char *name, const FileInfo &info);
 
+	/**
+	 * Update only the known subdirectories of the given
+	 * directory; its files and the list of entries are assumed to
+	 * be unchanged.
+	 */
+	void UpdateChildDirectories(Directory &directory);
+
 	bool UpdateDirectory(Directory &directory, const FileInfo &info);
 
 	/**
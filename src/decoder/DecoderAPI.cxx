@@ -25,7 +25,7 @@
 #include "ReplayGainConfig.hxx"
 #include "MusicChunk.hxx"
 #include "MusicBuffer.hxx"
-#include "MusicPipe.hxx"
+#include "DecoderPipe.hxx"
 #include "DecoderControl.hxx"
 #include "DecoderInternal.hxx"
 #include "DetachedSong.hxx"
@@ -190,7 +190,7 @@ decoder_command_finished(Decoder &decoder)
 		/* delete frames from the old song position */
 
 		if (decoder.chunk != nullptr) {
-			dc.buffer->Return(decoder.chunk);
+			decoder.chunk_cache.Return(decoder.chunk);
 			decoder.chunk = nullptr;
 		}
 
@@ -392,6 +392,48 @@ decoder_read_full(Decoder *decoder, InputStream &is,
 	return true;
 }
 
+ConstBuffer<void>
+decoder_read_view(Decoder *decoder, InputStream &is, size_t length)
+{
+	assert(decoder == nullptr ||
+	       decoder->dc.state == DecoderState::START ||
+	       decoder->dc.state == DecoderState::DECODE);
+
+	const ScopeLock protect(is.mutex);
+
+	const auto view = is.Map();
+	if (view.IsNull())
+		return nullptr;
+
+	if (decoder_check_cancel_read(decoder))
+		return { view.data, 0 };
+
+	const offset_type offset = is.GetOffset();
+	if (offset >= view.size)
+		return { view.data, 0 };
+
+	const size_t nbytes = std::min<offset_type>(length,
+						    view.size - offset);
+	is.AddOffset(nbytes);
+
+	return { (const uint8_t *)view.data + offset, nbytes };
+}
+
+const void *
+decoder_read_full_view(Decoder *decoder, InputStream &is,
+		       void *buffer, size_t size)
+{
+	const auto view = decoder_read_view(decoder, is, size);
+	if (view.IsNull())
+		return decoder_read_full(decoder, is, buffer, size)
+			? buffer
+			: nullptr;
+
+	/* the view covers the whole file, so a short read means end
+	   of file or a command */
+	return view.size == size ? view.data : nullptr;
+}
+
 bool
 decoder_skip(Decoder *decoder, InputStream &is, size_t size)
 {
@@ -466,6 +508,109 @@ update_stream_tag(Decoder &decoder, InputStream *is)
 	return true;
 }
 
+/**
+ * Check for a pending command before submitting data, and open the
+ * prefetched stream of the next song if the player has asked for it.
+ */
+static DecoderCommand
+decoder_data_command(Decoder &decoder)
+{
+	DecoderControl &dc = decoder.dc;
+
+	assert(dc.state == DecoderState::DECODE);
+	assert(dc.pipe != nullptr);
+
+	dc.Lock();
+	const DecoderCommand cmd = decoder_get_virtual_command(decoder);
+
+	if (gcc_unlikely(dc.IsPrefetchPending()) &&
+	    cmd == DecoderCommand::NONE)
+		/* the player has queued the next song; open its
+		   stream while this one is still being decoded */
+		dc.UpdatePrefetch();
+
+	dc.Unlock();
+
+	return cmd;
+}
+
+/**
+ * Send the stream tag (merged with the decoder tag) if it has
+ * changed.
+ */
+static DecoderCommand
+decoder_data_stream_tag(Decoder &decoder, InputStream *is)
+{
+	if (!update_stream_tag(decoder, is))
+		return DecoderCommand::NONE;
+
+	if (decoder.decoder_tag != nullptr) {
+		/* merge with tag from decoder plugin */
+		Tag *tag = Tag::Merge(*decoder.decoder_tag,
+				      *decoder.stream_tag);
+		DecoderCommand cmd = do_send_tag(decoder, *tag);
+		delete tag;
+		return cmd;
+	} else
+		/* send only the stream tag */
+		return do_send_tag(decoder, *decoder.stream_tag);
+}
+
+/**
+ * Account for #nbytes which were written to the current chunk:
+ * expand it, flush it if it is full, and advance the time stamp.
+ *
+ * @return false if the end of the song range has been reached
+ */
+static bool
+decoder_data_expand(Decoder &decoder, MusicChunk &chunk, size_t nbytes)
+{
+	const DecoderControl &dc = decoder.dc;
+
+	if (chunk.Expand(dc.out_audio_format, nbytes))
+		/* the chunk is full, flush it */
+		decoder.FlushChunk();
+
+	decoder.timestamp += (double)nbytes /
+		dc.out_audio_format.GetTimeToSize();
+
+	/* stop decoding when the end of this range has been
+	   reached */
+	return dc.end_ms == 0 || decoder.timestamp < dc.end_ms / 1000.0;
+}
+
+/**
+ * The end of the song range has been reached.  If the player has
+ * chained the next range of the same file, switch to it and keep on
+ * decoding.
+ *
+ * @return false if decoding shall stop
+ */
+static bool
+decoder_data_chain(Decoder &decoder)
+{
+	DecoderControl &dc = decoder.dc;
+
+	dc.Lock();
+	bool pending = dc.chain_song != nullptr &&
+		dc.command == DecoderCommand::NONE;
+	dc.Unlock();
+
+	if (!pending)
+		return false;
+
+	/* the rest of this chunk goes to the old song (it overlaps
+	   the border by less than one chunk) */
+	if (decoder.chunk != nullptr)
+		decoder.FlushChunk();
+
+	dc.Lock();
+	pending = dc.command == DecoderCommand::NONE && dc.SwitchChain();
+	dc.Unlock();
+
+	return pending;
+}
+
 DecoderCommand
 decoder_data(Decoder &decoder,
 	     InputStream *is,
@@ -473,36 +618,19 @@ decoder_data(Decoder &decoder,
 	     uint16_t kbit_rate)
 {
 	DecoderControl &dc = decoder.dc;
-	DecoderCommand cmd;
 
-	assert(dc.state == DecoderState::DECODE);
-	assert(dc.pipe != nullptr);
 	assert(length % dc.in_audio_format.GetFrameSize() == 0);
 
-	dc.Lock();
-	cmd = decoder_get_virtual_command(decoder);
-	dc.Unlock();
-
+	DecoderCommand cmd = decoder_data_command(decoder);
 	if (cmd == DecoderCommand::STOP || cmd == DecoderCommand::SEEK ||
 	    length == 0)
 		return cmd;
 
 	/* send stream tags */
 
-	if (update_stream_tag(decoder, is)) {
-		if (decoder.decoder_tag != nullptr) {
-			/* merge with tag from decoder plugin */
-			Tag *tag = Tag::Merge(*decoder.decoder_tag,
-					      *decoder.stream_tag);
-			cmd = do_send_tag(decoder, *tag);
-			delete tag;
-		} else
-			/* send only the stream tag */
-			cmd = do_send_tag(decoder, *decoder.stream_tag);
-
-		if (cmd != DecoderCommand::NONE)
-			return cmd;
-	}
+	cmd = decoder_data_stream_tag(decoder, is);
+	if (cmd != DecoderCommand::NONE)
+		return cmd;
 
 	if (decoder.convert != nullptr) {
 		assert(dc.in_audio_format != dc.out_audio_format);
@@ -526,7 +654,6 @@ decoder_data(Decoder &decoder,
 
 	while (length > 0) {
 		MusicChunk *chunk;
-		bool full;
 
 		chunk = decoder.GetChunk();
 		if (chunk == nullptr) {
@@ -555,30 +682,72 @@ decoder_data(Decoder &decoder,
 
 		memcpy(dest.data, data, nbytes);
 
-		/* expand the music pipe chunk */
-
-		full = chunk->Expand(dc.out_audio_format, nbytes);
-		if (full) {
-			/* the chunk is full, flush it */
-			decoder.FlushChunk();
-		}
-
 		data = (const uint8_t *)data + nbytes;
 		length -= nbytes;
 
-		decoder.timestamp += (double)nbytes /
-			dc.out_audio_format.GetTimeToSize();
-
-		if (dc.end_ms > 0 &&
-		    decoder.timestamp >= dc.end_ms / 1000.0)
-			/* the end of this range has been reached:
-			   stop decoding */
+		if (!decoder_data_expand(decoder, *chunk, nbytes) &&
+		    !decoder_data_chain(decoder))
 			return DecoderCommand::STOP;
 	}
 
 	return DecoderCommand::NONE;
 }
 
+WritableBuffer<void>
+decoder_data_begin(Decoder &decoder, InputStream *is, uint16_t kbit_rate)
+{
+	const DecoderControl &dc = decoder.dc;
+
+	if (decoder.convert != nullptr)
+		/* the data must be converted, which needs a separate
+		   source buffer */
+		return nullptr;
+
+	assert(dc.in_audio_format == dc.out_audio_format);
+
+	DecoderCommand cmd = decoder_data_command(decoder);
+	if (cmd == DecoderCommand::STOP || cmd == DecoderCommand::SEEK)
+		return nullptr;
+
+	cmd = decoder_data_stream_tag(decoder, is);
+	if (cmd != DecoderCommand::NONE)
+		return nullptr;
+
+	while (true) {
+		MusicChunk *chunk = decoder.GetChunk();
+		if (chunk == nullptr) {
+			assert(dc.command != DecoderCommand::NONE);
+			return nullptr;
+		}
+
+		const auto dest =
+			chunk->Write(dc.out_audio_format,
+				     decoder.timestamp -
+				     dc.song->GetStartMS() / 1000.0,
+				     kbit_rate);
+		if (!dest.IsNull())
+			return dest;
+
+		/* the chunk is full, flush it */
+		decoder.FlushChunk();
+	}
+}
+
+DecoderCommand
+decoder_data_commit(Decoder &decoder, size_t length)
+{
+	assert(decoder.chunk != nullptr);
+	assert(length % decoder.dc.out_audio_format.GetFrameSize() == 0);
+
+	if (length == 0)
+		return DecoderCommand::NONE;
+
+	return decoder_data_expand(decoder, *decoder.chunk, length) ||
+		decoder_data_chain(decoder)
+		? DecoderCommand::NONE
+		: DecoderCommand::STOP;
+}
+
 DecoderCommand
 decoder_tag(Decoder &decoder, InputStream *is,
 	    Tag &&tag)
@@ -663,5 +832,10 @@ decoder_mixramp(Decoder &decoder, MixRampInfo &&mix_ramp)
 {
 	DecoderControl &dc = decoder.dc;
 
+	if (!mix_ramp.IsDefined())
+		/* no tags: keep the envelopes computed by the
+		   database */
+		return;
+
 	dc.SetMixRamp(std::move(mix_ramp));
 }
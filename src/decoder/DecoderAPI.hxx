@@ -37,6 +37,8 @@
 #include "AudioFormat.hxx"
 #include "MixRampInfo.hxx"
 #include "config/ConfigData.hxx"
+#include "util/WritableBuffer.hxx"
+#include "util/ConstBuffer.hxx"
 
 // IWYU pragma: end_exports
 
@@ -159,6 +161,29 @@ bool
 decoder_read_full(Decoder *decoder, InputStream &is,
 		  void *buffer, size_t size);
 
+/**
+ * Like decoder_read(), but returns a pointer into the stream's
+ * memory mapping (InputStream::Map()) instead of copying.  The data
+ * remains valid until the stream is closed.
+ *
+ * @return the data (empty on end of file or command), or nullptr if
+ * the stream cannot be mapped; use decoder_read() instead then
+ */
+ConstBuffer<void>
+decoder_read_view(Decoder *decoder, InputStream &is, size_t length);
+
+/**
+ * Like decoder_read_full(), but avoids copying if the stream can be
+ * mapped into memory.
+ *
+ * @param buffer the buffer used if the stream cannot be mapped
+ * @return a pointer to the data (either into the mapping or to
+ * #buffer), or nullptr on error or command or not enough data
+ */
+const void *
+decoder_read_full_view(Decoder *decoder, InputStream &is,
+		       void *buffer, size_t size);
+
 /**
  * Skip data on the #InputStream.
  *
@@ -201,6 +226,47 @@ decoder_data(Decoder &decoder, InputStream &is,
 	return decoder_data(decoder, &is, data, length, kbit_rate);
 }
 
+/**
+ * Obtain a buffer inside the current music chunk, where the decoder
+ * plugin can write PCM data (in the format passed to
+ * decoder_initialized()) and then submit it with
+ * decoder_data_commit().  This saves the copy which decoder_data()
+ * does, but it is only possible if MPD does not need to convert the
+ * data.
+ *
+ * Like decoder_data(), this sends updated stream tags first.
+ *
+ * @param decoder the decoder object
+ * @param is an input stream which is buffering while we are waiting
+ * for the player
+ * @param kbit_rate the current bit rate
+ * @return a buffer whose size is a multiple of the frame size, or
+ * nullptr if no buffer is available (because the data needs to be
+ * converted or a command is pending); the plugin shall then fall back
+ * to decoder_data(), which handles both cases
+ */
+WritableBuffer<void>
+decoder_data_begin(Decoder &decoder, InputStream *is, uint16_t kbit_rate);
+
+static inline WritableBuffer<void>
+decoder_data_begin(Decoder &decoder, InputStream &is, uint16_t kbit_rate)
+{
+	return decoder_data_begin(decoder, &is, kbit_rate);
+}
+
+/**
+ * Submit data which was written to the buffer returned by
+ * decoder_data_begin().
+ *
+ * @param decoder the decoder object
+ * @param length the number of bytes written; must be a multiple of
+ * the frame size and not larger than the buffer
+ * @return DecoderCommand::STOP if the end of the song range has been
+ * reached, DecoderCommand::NONE otherwise
+ */
+DecoderCommand
+decoder_data_commit(Decoder &decoder, size_t length);
+
 /**
  * This function is called by the decoder plugin when it has
  * successfully decoded a tag.
@@ -233,11 +299,11 @@ decoder_replay_gain(Decoder &decoder,
 		    const ReplayGainInfo *replay_gain_info);
 
 /**
- * Store MixRamp tags.
+ * Store MixRamp tags.  They replace the envelopes computed by the
+ * database; an undefined object is ignored.
  *
  * @param decoder the decoder object
- * @param mixramp_start the mixramp_start tag; may be nullptr to invalidate
- * @param mixramp_end the mixramp_end tag; may be nullptr to invalidate
+ * @param mix_ramp the parsed mixramp_start and mixramp_end tags
  */
 void
 decoder_mixramp(Decoder &decoder, MixRampInfo &&mix_ramp);
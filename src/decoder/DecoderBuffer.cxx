@@ -20,6 +20,7 @@
 #include "config.h"
 #include "DecoderBuffer.hxx"
 #include "DecoderAPI.hxx"
+#include "input/InputStream.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/VarSize.hxx"
 
@@ -41,13 +42,24 @@ struct DecoderBuffer {
 	    buffer */
 	size_t consumed;
 
+	/**
+	 * If the stream is memory-mapped (InputStream::Map()), then
+	 * the buffer is a window into the mapping which begins here,
+	 * and #data is not used.  Otherwise nullptr.
+	 */
+	const unsigned char *view;
+
 	/** the actual buffer (dynamic size) */
 	unsigned char data[sizeof(size_t)];
 
 	DecoderBuffer(Decoder *_decoder, InputStream &_is,
-		      size_t _size)
+		      size_t _size, const unsigned char *_view)
 		:decoder(_decoder), is(&_is),
-		 size(_size), length(0), consumed(0) {}
+		 size(_size), length(0), consumed(0), view(_view) {}
+
+	const unsigned char *GetBegin() const {
+		return view != nullptr ? view : data;
+	}
 };
 
 DecoderBuffer *
@@ -56,9 +68,20 @@ decoder_buffer_new(Decoder *decoder, InputStream &is,
 {
 	assert(size > 0);
 
+	const unsigned char *view = nullptr;
+	is.Lock();
+	const auto map = is.Map();
+	if (!map.IsNull())
+		view = (const unsigned char *)map.data + is.GetOffset();
+	is.Unlock();
+
+	/* with a memory-mapped stream, the buffer is never copied,
+	   and the tail need not be allocated */
 	return NewVarSize<DecoderBuffer>(sizeof(DecoderBuffer::data),
-					 size,
-					 decoder, is, size);
+					 view != nullptr
+					 ? sizeof(DecoderBuffer::data)
+					 : size,
+					 decoder, is, size, view);
 }
 
 void
@@ -87,7 +110,11 @@ decoder_buffer_shift(DecoderBuffer *buffer)
 	assert(buffer->consumed > 0);
 
 	buffer->length -= buffer->consumed;
-	memmove(buffer->data, buffer->data + buffer->consumed, buffer->length);
+	if (buffer->view != nullptr)
+		buffer->view += buffer->consumed;
+	else
+		memmove(buffer->data, buffer->data + buffer->consumed,
+			buffer->length);
 	buffer->consumed = 0;
 }
 
@@ -103,6 +130,26 @@ decoder_buffer_fill(DecoderBuffer *buffer)
 		/* buffer is full */
 		return false;
 
+	if (buffer->view != nullptr) {
+		/* extend the window into the mapping */
+		const auto src = decoder_read_view(buffer->decoder,
+						   *buffer->is,
+						   buffer->size - buffer->length);
+		assert(!src.IsNull());
+		if (src.size == 0)
+			return false;
+
+		if (buffer->length == 0)
+			/* the stream may have been seeked after
+			   decoder_buffer_clear() */
+			buffer->view = (const unsigned char *)src.data;
+
+		assert(src.data == buffer->view + buffer->length);
+
+		buffer->length += src.size;
+		return true;
+	}
+
 	nbytes = decoder_read(buffer->decoder, *buffer->is,
 			      buffer->data + buffer->length,
 			      buffer->size - buffer->length);
@@ -120,7 +167,7 @@ decoder_buffer_fill(DecoderBuffer *buffer)
 static const void *
 decoder_buffer_head(const DecoderBuffer *buffer)
 {
-	return buffer->data + buffer->consumed;
+	return buffer->GetBegin() + buffer->consumed;
 }
 
 size_t
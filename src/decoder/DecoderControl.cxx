@@ -19,10 +19,15 @@
 
 #include "config.h"
 #include "DecoderControl.hxx"
-#include "MusicPipe.hxx"
+#include "DecoderPipe.hxx"
 #include "DetachedSong.hxx"
+#include "input/InputStream.hxx"
+#include "util/UriUtil.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
 
 #include <assert.h>
+#include <string.h>
 
 DecoderControl::DecoderControl(Mutex &_mutex, Cond &_client_cond)
 	:mutex(_mutex), client_cond(_client_cond),
@@ -30,13 +35,17 @@ DecoderControl::DecoderControl(Mutex &_mutex, Cond &_client_cond)
 	 command(DecoderCommand::NONE),
 	 client_is_waiting(false),
 	 song(nullptr),
-	 replay_gain_db(0), replay_gain_prev_db(0) {}
+	 replay_gain_db(0), replay_gain_prev_db(0),
+	 prefetch_enabled(false), prefetch_stream(nullptr),
+	 chain_song(nullptr), chain_pipe(nullptr) {}
 
 DecoderControl::~DecoderControl()
 {
 	ClearError();
 
 	delete song;
+	delete prefetch_stream;
+	delete chain_song;
 }
 
 void
@@ -51,6 +60,18 @@ DecoderControl::WaitForDecoder()
 	client_is_waiting = false;
 }
 
+void
+DecoderControl::WaitForDecoder(unsigned timeout_ms)
+{
+	assert(!client_is_waiting);
+	client_is_waiting = true;
+
+	client_cond.timed_wait(mutex, timeout_ms);
+
+	assert(client_is_waiting);
+	client_is_waiting = false;
+}
+
 bool
 DecoderControl::IsCurrentSong(const DetachedSong &_song) const
 {
@@ -71,10 +92,11 @@ DecoderControl::IsCurrentSong(const DetachedSong &_song) const
 void
 DecoderControl::Start(DetachedSong *_song,
 		      unsigned _start_ms, unsigned _end_ms,
-		      MusicBuffer &_buffer, MusicPipe &_pipe)
+		      MusicBuffer &_buffer, DecoderPipe &_pipe)
 {
 	assert(_song != nullptr);
 	assert(_pipe.IsEmpty());
+	assert(chain_song == nullptr);
 
 	delete song;
 	song = _song;
@@ -138,3 +160,134 @@ DecoderControl::CycleMixRamp()
 	previous_mix_ramp = std::move(mix_ramp);
 	mix_ramp.Clear();
 }
+
+void
+DecoderControl::Prefetch(const DetachedSong &_song)
+{
+	if (!prefetch_enabled)
+		return;
+
+	const char *uri = _song.GetRealURI();
+	if (!uri_has_scheme(uri) || _song.GetStartMS() > 0) {
+		/* local files don't need to be prefetched; CUE
+		   tracks are skipped, because the seek to the start
+		   position would discard the prefetched data
+		   anyway */
+		prefetch_uri.clear();
+		return;
+	}
+
+	/* the decoder thread will notice the new request in its
+	   next decoder_data() call */
+	prefetch_uri = uri;
+}
+
+void
+DecoderControl::UpdatePrefetch()
+{
+	assert(IsPrefetchPending());
+
+	InputStream *old_stream = prefetch_stream;
+	prefetch_stream = nullptr;
+	prefetch_stream_uri = prefetch_uri;
+	const std::string uri = prefetch_uri;
+
+	Unlock();
+
+	delete old_stream;
+
+	InputStream *is = nullptr;
+	if (!uri.empty()) {
+		/* don't wait for the stream to become ready; it will
+		   fill its buffer in the background */
+		Error open_error;
+		is = InputStream::Open(uri.c_str(), mutex, cond,
+				       open_error);
+		if (is == nullptr && open_error.IsDefined())
+			LogError(open_error);
+	}
+
+	Lock();
+
+	assert(prefetch_stream == nullptr);
+	prefetch_stream = is;
+}
+
+InputStream *
+DecoderControl::TakePrefetch(const char *uri)
+{
+	InputStream *is = nullptr;
+	if (prefetch_stream != nullptr && prefetch_stream_uri == uri) {
+		is = prefetch_stream;
+		prefetch_stream = nullptr;
+		prefetch_stream_uri.clear();
+	}
+
+	/* this request is being fulfilled now, prefetching it
+	   (again) would be pointless */
+	if (prefetch_uri == uri)
+		prefetch_uri.clear();
+
+	return is;
+}
+
+bool
+DecoderControl::CanChain(const DetachedSong &next_song) const
+{
+	return state == DecoderState::DECODE &&
+		command == DecoderCommand::NONE &&
+		chain_song == nullptr &&
+		end_ms > 0 && next_song.GetStartMS() == end_ms &&
+		strcmp(next_song.GetRealURI(), song->GetRealURI()) == 0;
+}
+
+void
+DecoderControl::Chain(DetachedSong *_song, unsigned _end_ms,
+		      DecoderPipe &_pipe)
+{
+	assert(_song != nullptr);
+	assert(_pipe.IsEmpty());
+	assert(CanChain(*_song));
+
+	chain_song = _song;
+	chain_end_ms = _end_ms;
+	chain_pipe = &_pipe;
+}
+
+DecoderPipe *
+DecoderControl::CancelChain()
+{
+	DecoderPipe *result = chain_pipe;
+
+	delete chain_song;
+	chain_song = nullptr;
+	chain_pipe = nullptr;
+
+	return result;
+}
+
+bool
+DecoderControl::SwitchChain()
+{
+	if (chain_song == nullptr)
+		return false;
+
+	assert(chain_pipe != nullptr);
+
+	delete song;
+	song = chain_song;
+	chain_song = nullptr;
+
+	start_ms = end_ms;
+	end_ms = chain_end_ms;
+
+	pipe = chain_pipe;
+	chain_pipe = nullptr;
+
+	/* the same file continues, so its replay gain stays
+	   valid */
+	replay_gain_prev_db = replay_gain_db;
+
+	client_cond.signal();
+	return true;
+}
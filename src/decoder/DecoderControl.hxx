@@ -28,6 +28,8 @@
 #include "thread/Thread.hxx"
 #include "util/Error.hxx"
 
+#include <string>
+
 #include <assert.h>
 #include <stdint.h>
 
@@ -38,7 +40,8 @@
 
 class DetachedSong;
 class MusicBuffer;
-class MusicPipe;
+class DecoderPipe;
+class InputStream;
 
 enum class DecoderState : uint8_t {
 	STOP = 0,
@@ -151,13 +154,60 @@ struct DecoderControl {
 	 * The destination pipe for decoded chunks.  The caller thread
 	 * owns this object, and is responsible for freeing it.
 	 */
-	MusicPipe *pipe;
+	DecoderPipe *pipe;
 
 	float replay_gain_db;
 	float replay_gain_prev_db;
 
 	MixRampInfo mix_ramp, previous_mix_ramp;
 
+	/**
+	 * Open the #InputStream of the next song while the current
+	 * one is still being decoded?  Configured with
+	 * "decoder_prefetch".
+	 */
+	bool prefetch_enabled;
+
+	/**
+	 * The URI of the song which the player thread expects to be
+	 * decoded next, or an empty string.  The decoder thread opens
+	 * it in the background, see UpdatePrefetch().
+	 */
+	std::string prefetch_uri;
+
+	/**
+	 * The URI which #prefetch_stream was opened for.  If this
+	 * differs from #prefetch_uri, the decoder thread has not yet
+	 * seen the current request.
+	 */
+	std::string prefetch_stream_uri;
+
+	/**
+	 * The prefetched stream, or nullptr if none was opened (or if
+	 * the attempt has failed).  It is not necessarily "ready"
+	 * yet.
+	 */
+	InputStream *prefetch_stream;
+
+	/**
+	 * The song which the decoder thread will continue with when
+	 * it reaches #end_ms, without stopping and restarting the
+	 * decoder plugin (see Chain()).  This is used for consecutive
+	 * CUE tracks of the same file.  It is owned by this object.
+	 */
+	DetachedSong *chain_song;
+
+	/**
+	 * The #end_ms value of #chain_song.
+	 */
+	unsigned chain_end_ms;
+
+	/**
+	 * The pipe which receives the chunks of #chain_song.  Like
+	 * #pipe, it is owned by the caller.
+	 */
+	DecoderPipe *chain_pipe;
+
 	/**
 	 * @param _mutex see #mutex
 	 * @param _client_cond see #client_cond
@@ -183,9 +233,13 @@ struct DecoderControl {
 	 * Signals the object.  This function is only valid in the
 	 * player thread.  The object should be locked prior to
 	 * calling this function.
+	 *
+	 * This wakes up all waiters, because a decoder plugin's
+	 * helper thread may be waiting for the #InputStream (which
+	 * shares this #Cond) at the same time.
 	 */
 	void Signal() {
-		cond.signal();
+		cond.broadcast();
 	}
 
 	/**
@@ -206,6 +260,13 @@ struct DecoderControl {
 	 */
 	void WaitForDecoder();
 
+	/**
+	 * Like WaitForDecoder(), but give up after the specified
+	 * number of milliseconds.  This is useful for clients which
+	 * have no other source of wakeups than the decoder thread.
+	 */
+	void WaitForDecoder(unsigned timeout_ms);
+
 	bool IsIdle() const {
 		return state == DecoderState::STOP ||
 			state == DecoderState::ERROR;
@@ -361,7 +422,7 @@ public:
 	 * the caller)
 	 */
 	void Start(DetachedSong *song, unsigned start_ms, unsigned end_ms,
-		   MusicBuffer &buffer, MusicPipe &pipe);
+		   MusicBuffer &buffer, DecoderPipe &pipe);
 
 	void Stop();
 
@@ -369,15 +430,15 @@ public:
 
 	void Quit();
 
-	const char *GetMixRampStart() const {
+	const MixRampEnvelope &GetMixRampStart() const {
 		return mix_ramp.GetStart();
 	}
 
-	const char *GetMixRampEnd() const {
+	const MixRampEnvelope &GetMixRampEnd() const {
 		return mix_ramp.GetEnd();
 	}
 
-	const char *GetMixRampPreviousEnd() const {
+	const MixRampEnvelope &GetMixRampPreviousEnd() const {
 		return previous_mix_ramp.GetEnd();
 	}
 
@@ -390,6 +451,99 @@ public:
 	 * mixramp_start/mixramp_end.
 	 */
 	void CycleMixRamp();
+
+	/**
+	 * Ask the decoder thread to open the #InputStream of the
+	 * specified song in the background, because it will probably
+	 * be decoded next.  Only remote songs are prefetched, local
+	 * files can be opened quickly at any time.
+	 *
+	 * To be called from the client thread.  Caller must lock the
+	 * object.
+	 */
+	void Prefetch(const DetachedSong &_song);
+
+	/**
+	 * Discard the request submitted with Prefetch().
+	 *
+	 * To be called from the client thread.  Caller must lock the
+	 * object.
+	 */
+	void CancelPrefetch() {
+		prefetch_uri.clear();
+	}
+
+	bool IsPrefetchPending() const {
+		return prefetch_uri != prefetch_stream_uri;
+	}
+
+	/**
+	 * Handle a new request submitted with Prefetch() or
+	 * CancelPrefetch(): close the old stream and open the new
+	 * one.  This method unlocks the object temporarily.
+	 *
+	 * To be called from the decoder thread.  Caller must lock the
+	 * object.
+	 */
+	void UpdatePrefetch();
+
+	/**
+	 * Obtain the prefetched stream for the specified URI.
+	 *
+	 * To be called from the decoder thread.  Caller must lock the
+	 * object.
+	 *
+	 * @return the stream (to be freed by the caller) or nullptr
+	 * if no such stream was prefetched
+	 */
+	InputStream *TakePrefetch(const char *uri);
+
+	/**
+	 * Can the decoder continue with the specified song when it
+	 * reaches #end_ms?  This is true if the song picks up exactly
+	 * where the current one ends in the same file.
+	 *
+	 * Caller must lock the object.
+	 */
+	gcc_pure
+	bool CanChain(const DetachedSong &next_song) const;
+
+	/**
+	 * Let the decoder continue with the specified song when it
+	 * reaches #end_ms.  Check CanChain() first.  Once the decoder
+	 * has switched, #pipe points to the given pipe.
+	 *
+	 * To be called from the client thread.  Caller must lock the
+	 * object.
+	 *
+	 * @param song the song to be decoded; the given instance will be
+	 * owned and freed by the decoder
+	 * @param pipe the pipe which receives the decoded chunks (owned by
+	 * the caller)
+	 */
+	void Chain(DetachedSong *song, unsigned end_ms, DecoderPipe &pipe);
+
+	/**
+	 * Discard the request submitted with Chain(), unless the
+	 * decoder has already switched to that song.
+	 *
+	 * To be called from the client thread.  Caller must lock the
+	 * object.
+	 *
+	 * @return the pipe which was passed to Chain() (to be freed by
+	 * the caller) or nullptr if there was no request
+	 */
+	DecoderPipe *CancelChain();
+
+	/**
+	 * Make the song submitted with Chain() the current one.
+	 *
+	 * To be called from the decoder thread.  Caller must lock the
+	 * object.
+	 *
+	 * @return false if there was no such request
+	 */
+	bool SwitchChain();
 };
 
 #endif
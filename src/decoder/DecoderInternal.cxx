@@ -21,13 +21,29 @@
 #include "DecoderInternal.hxx"
 #include "DecoderControl.hxx"
 #include "pcm/PcmConvert.hxx"
-#include "MusicPipe.hxx"
+#include "DecoderPipe.hxx"
 #include "MusicBuffer.hxx"
 #include "MusicChunk.hxx"
+#include "PipelineStats.hxx"
 #include "tag/Tag.hxx"
+#include "system/Clock.hxx"
 
 #include <assert.h>
 
+Decoder::Decoder(DecoderControl &_dc, bool _initial_seek_pending, Tag *_tag)
+	:dc(_dc),
+	 convert(nullptr),
+	 timestamp(0),
+	 initial_seek_pending(_initial_seek_pending),
+	 initial_seek_running(false),
+	 seeking(false),
+	 song_tag(_tag), stream_tag(nullptr), decoder_tag(nullptr),
+	 chunk(nullptr), chunk_start_us(0),
+	 chunk_cache(*_dc.buffer),
+	 replay_gain_serial(0)
+{
+}
+
 Decoder::~Decoder()
 {
 	/* caller must flush the chunk */
@@ -65,8 +81,9 @@ Decoder::GetChunk()
 		return chunk;
 
 	do {
-		chunk = dc.buffer->Allocate();
+		chunk = chunk_cache.Allocate();
 		if (chunk != nullptr) {
+			chunk_start_us = MonotonicClockUS();
 			chunk->replay_gain_serial = replay_gain_serial;
 			if (replay_gain_serial != 0)
 				chunk->replay_gain_info = replay_gain_info;
@@ -88,9 +105,14 @@ Decoder::FlushChunk()
 	assert(chunk != nullptr);
 
 	if (chunk->IsEmpty())
-		dc.buffer->Return(chunk);
-	else
+		chunk_cache.Return(chunk);
+	else {
+		const uint64_t now = MonotonicClockUS();
+		chunk->push_us = now;
+		pipeline_stats.decoder_chunk.Add(now - chunk_start_us);
+
 		dc.pipe->Push(chunk);
+	}
 
 	chunk = nullptr;
 
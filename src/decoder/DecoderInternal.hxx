@@ -21,8 +21,11 @@
 #define MPD_DECODER_INTERNAL_HXX
 
 #include "ReplayGainInfo.hxx"
+#include "MusicBuffer.hxx"
 #include "util/Error.hxx"
 
+#include <stdint.h>
+
 class PcmConvert;
 struct MusicChunk;
 struct DecoderControl;
@@ -79,6 +82,17 @@ struct Decoder {
 	/** the chunk currently being written to */
 	MusicChunk *chunk;
 
+	/**
+	 * When #chunk was allocated (MonotonicClockUS()), for
+	 * #PipelineStats.
+	 */
+	uint64_t chunk_start_us;
+
+	/**
+	 * This thread's cache in front of DecoderControl::buffer.
+	 */
+	MusicBuffer::Cache chunk_cache;
+
 	ReplayGainInfo replay_gain_info;
 
 	/**
@@ -93,17 +107,7 @@ struct Decoder {
 	 */
 	Error error;
 
-	Decoder(DecoderControl &_dc, bool _initial_seek_pending, Tag *_tag)
-		:dc(_dc),
-		 convert(nullptr),
-		 timestamp(0),
-		 initial_seek_pending(_initial_seek_pending),
-		 initial_seek_running(false),
-		 seeking(false),
-		 song_tag(_tag), stream_tag(nullptr), decoder_tag(nullptr),
-		 chunk(nullptr),
-		 replay_gain_serial(0) {
-	}
+	Decoder(DecoderControl &_dc, bool _initial_seek_pending, Tag *_tag);
 
 	~Decoder();
 
@@ -44,8 +44,15 @@
 #include "plugins/MpcdecDecoderPlugin.hxx"
 #include "plugins/FluidsynthDecoderPlugin.hxx"
 #include "plugins/SidplayDecoderPlugin.hxx"
+#include "thread/Mutex.hxx"
+#include "util/CharUtil.hxx"
 #include "util/Macros.hxx"
 
+#include <string>
+#include <unordered_map>
+#include <atomic>
+
+#include <assert.h>
 #include <string.h>
 
 const struct DecoderPlugin *const decoder_plugins[] = {
@@ -118,9 +125,92 @@ const struct DecoderPlugin *const decoder_plugins[] = {
 static constexpr unsigned num_decoder_plugins =
 	ARRAY_SIZE(decoder_plugins) - 1;
 
-/** which plugins have been initialized successfully? */
+/** which plugins are enabled (and have not failed to initialize)? */
 bool decoder_plugins_enabled[num_decoder_plugins];
 
+/**
+ * The configuration block of each enabled plugin, to be passed to
+ * DecoderPlugin::Init() on first use.
+ */
+static const config_param *decoder_plugin_params[num_decoder_plugins];
+
+/** which plugins have been initialized successfully? */
+static std::atomic_bool decoder_plugins_ready[num_decoder_plugins];
+
+/**
+ * Serializes the DecoderPlugin::Init() calls in
+ * decoder_plugin_prepare().
+ */
+static Mutex decoder_init_mutex;
+
+static_assert(num_decoder_plugins <= sizeof(DecoderPluginMask) * 8,
+	      "too many decoder plugins for DecoderPluginMask");
+
+/**
+ * Tag scan counters, see decoder_plugin_count_scan().
+ */
+static std::atomic_uint decoder_scan_success[num_decoder_plugins],
+	decoder_scan_failure[num_decoder_plugins];
+static std::atomic<uint64_t> decoder_scan_us[num_decoder_plugins];
+
+typedef std::unordered_map<std::string, DecoderPluginMask> DecoderIndex;
+
+/**
+ * Maps lower-case file name suffixes and MIME types to the enabled
+ * plugins which support them.  Built by decoder_plugin_init_all().
+ */
+static DecoderIndex decoder_suffix_index, decoder_mime_index;
+
+/**
+ * The maximum number of entries in #decoder_memory.  When this limit
+ * is reached, the whole table is flushed.
+ */
+static constexpr size_t MAX_DECODER_MEMORY = 16384;
+
+/**
+ * Protects #decoder_memory, which is used by the decoder thread and
+ * the update thread.
+ */
+static Mutex decoder_memory_mutex;
+
+/**
+ * Maps file names and URIs to the index of the plugin which has last
+ * been used successfully.
+ */
+static std::unordered_map<std::string, unsigned> decoder_memory;
+
+static std::string
+decoder_index_key(const char *p)
+{
+	std::string key(p);
+	for (auto &ch : key)
+		ch = ToLowerASCII(ch);
+	return key;
+}
+
+static void
+decoder_index_add(DecoderIndex &index, const char *const*keys,
+		  unsigned plugin_index)
+{
+	if (keys == nullptr)
+		return;
+
+	for (; *keys != nullptr; ++keys)
+		index[decoder_index_key(*keys)] |=
+			DecoderPluginMask(1) << plugin_index;
+}
+
+gcc_pure
+static DecoderPluginMask
+decoder_index_find(const DecoderIndex &index, const char *key)
+{
+	if (key == nullptr)
+		return 0;
+
+	auto i = index.find(decoder_index_key(key));
+	return i != index.end() ? i->second : 0;
+}
+
 const struct DecoderPlugin *
 decoder_plugin_from_name(const char *name)
 {
@@ -131,7 +221,7 @@ decoder_plugin_from_name(const char *name)
 
 void decoder_plugin_init_all(void)
 {
-	struct config_param empty;
+	static const config_param empty;
 
 	for (unsigned i = 0; decoder_plugins[i] != nullptr; ++i) {
 		const DecoderPlugin &plugin = *decoder_plugins[i];
@@ -143,23 +233,143 @@ void decoder_plugin_init_all(void)
 		else if (!param->GetBlockValue("enabled", true))
 			/* the plugin is disabled in mpd.conf */
 			continue;
+		else
+			/* the other options are evaluated by
+			   DecoderPlugin::Init(), which is postponed
+			   until the plugin is needed */
+			config_defer_block(*param);
 
-		if (plugin.Init(*param))
-			decoder_plugins_enabled[i] = true;
+		decoder_plugin_params[i] = param;
+		decoder_plugins_enabled[i] = true;
+		decoder_index_add(decoder_suffix_index, plugin.suffixes, i);
+		decoder_index_add(decoder_mime_index, plugin.mime_types, i);
 	}
 }
 
+bool
+decoder_plugin_prepare(unsigned i)
+{
+	assert(i < num_decoder_plugins);
+
+	if (decoder_plugins_ready[i].load(std::memory_order_acquire))
+		return true;
+
+	const ScopeLock protect(decoder_init_mutex);
+
+	if (!decoder_plugins_enabled[i])
+		return false;
+
+	if (decoder_plugins_ready[i].load(std::memory_order_relaxed))
+		/* another thread was faster */
+		return true;
+
+	const DecoderPlugin &plugin = *decoder_plugins[i];
+	const config_param &param = *decoder_plugin_params[i];
+
+	const bool success = plugin.Init(param);
+	if (!param.IsNull())
+		config_check_block(param);
+
+	if (!success) {
+		decoder_plugins_enabled[i] = false;
+		return false;
+	}
+
+	decoder_plugins_ready[i].store(true, std::memory_order_release);
+	return true;
+}
+
 void decoder_plugin_deinit_all(void)
 {
-	decoder_plugins_for_each_enabled([=](const DecoderPlugin &plugin){
-			plugin.Finish();
-		});
+	for (unsigned i = 0; decoder_plugins[i] != nullptr; ++i) {
+		if (decoder_plugins_ready[i])
+			decoder_plugins[i]->Finish();
+
+		decoder_plugins_ready[i] = false;
+		decoder_plugins_enabled[i] = false;
+	}
+
+	decoder_suffix_index.clear();
+	decoder_mime_index.clear();
+
+	const ScopeLock protect(decoder_memory_mutex);
+	decoder_memory.clear();
+}
+
+DecoderPluginMask
+decoder_plugins_candidates(const char *suffix, const char *mime_type)
+{
+	return decoder_index_find(decoder_suffix_index, suffix) |
+		decoder_index_find(decoder_mime_index, mime_type);
+}
+
+const DecoderPlugin *
+decoder_plugin_recall(const char *key)
+{
+	unsigned plugin_index;
+
+	{
+		const ScopeLock protect(decoder_memory_mutex);
+
+		auto i = decoder_memory.find(key);
+		if (i == decoder_memory.end())
+			return nullptr;
+
+		plugin_index = i->second;
+	}
+
+	return decoder_plugin_prepare(plugin_index)
+		? decoder_plugins[plugin_index]
+		: nullptr;
+}
+
+void
+decoder_plugin_remember(const char *key, const DecoderPlugin &plugin)
+{
+	for (unsigned i = 0; decoder_plugins[i] != nullptr; ++i) {
+		if (decoder_plugins[i] == &plugin) {
+			const ScopeLock protect(decoder_memory_mutex);
+
+			if (decoder_memory.size() >= MAX_DECODER_MEMORY)
+				decoder_memory.clear();
+
+			decoder_memory[key] = i;
+			return;
+		}
+	}
 }
 
 bool
 decoder_plugins_supports_suffix(const char *suffix)
 {
-	return decoder_plugins_try([suffix](const DecoderPlugin &plugin){
-			return plugin.SupportsSuffix(suffix);
-		});
+	return decoder_index_find(decoder_suffix_index, suffix) != 0;
+}
+
+void
+decoder_plugin_count_scan(const DecoderPlugin &plugin, bool success,
+			  uint64_t duration_us)
+{
+	for (unsigned i = 0; decoder_plugins[i] != nullptr; ++i) {
+		if (decoder_plugins[i] == &plugin) {
+			if (success)
+				++decoder_scan_success[i];
+			else
+				++decoder_scan_failure[i];
+
+			decoder_scan_us[i] += duration_us;
+			return;
+		}
+	}
+}
+
+DecoderScanStats
+decoder_plugin_get_scan_stats(unsigned i)
+{
+	assert(i < num_decoder_plugins);
+
+	return {
+		decoder_scan_success[i],
+		decoder_scan_failure[i],
+		decoder_scan_us[i],
+	};
 }
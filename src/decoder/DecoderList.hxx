@@ -22,6 +22,8 @@
 
 #include "Compiler.h"
 
+#include <stdint.h>
+
 struct DecoderPlugin;
 
 extern const struct DecoderPlugin *const decoder_plugins[];
@@ -33,9 +35,24 @@ gcc_pure
 const struct DecoderPlugin *
 decoder_plugin_from_name(const char *name);
 
-/* this is where we "load" all the "plugins" ;-) */
+/**
+ * Determine which plugins are enabled and build the suffix/MIME type
+ * index.  The plugins themselves are initialized on first use, see
+ * decoder_plugin_prepare().
+ */
 void decoder_plugin_init_all(void);
 
+/**
+ * Initialize the plugin with the specified index into
+ * #decoder_plugins, unless that has been done already.  This
+ * function is thread-safe.
+ *
+ * @return true if the plugin is ready to be used, false if it is
+ * disabled or its initialization has failed
+ */
+bool
+decoder_plugin_prepare(unsigned i);
+
 /* this is where we "unload" all the "plugins" */
 void decoder_plugin_deinit_all(void);
 
@@ -44,7 +61,7 @@ static inline const DecoderPlugin *
 decoder_plugins_find(F f)
 {
 	for (unsigned i = 0; decoder_plugins[i] != nullptr; ++i)
-		if (decoder_plugins_enabled[i] && f(*decoder_plugins[i]))
+		if (decoder_plugin_prepare(i) && f(*decoder_plugins[i]))
 			return decoder_plugins[i];
 
 	return nullptr;
@@ -55,7 +72,7 @@ static inline bool
 decoder_plugins_try(F f)
 {
 	for (unsigned i = 0; decoder_plugins[i] != nullptr; ++i)
-		if (decoder_plugins_enabled[i] && f(*decoder_plugins[i]))
+		if (decoder_plugin_prepare(i) && f(*decoder_plugins[i]))
 			return true;
 
 	return false;
@@ -78,6 +95,107 @@ decoder_plugins_for_each_enabled(F f)
 			f(*decoder_plugins[i]);
 }
 
+/**
+ * A bit mask of indexes into #decoder_plugins.
+ */
+typedef uint32_t DecoderPluginMask;
+
+/**
+ * Look up the enabled plugins which support the specified file name
+ * suffix or MIME type.  This uses the index built by
+ * decoder_plugin_init_all(), and does not iterate over the plugin
+ * list.
+ *
+ * @param suffix the file name suffix; may be nullptr
+ * @param mime_type the MIME type; may be nullptr
+ */
+gcc_pure
+DecoderPluginMask
+decoder_plugins_candidates(const char *suffix, const char *mime_type);
+
+/**
+ * Which plugin has last been used successfully for the specified
+ * file name or URI?  Returns nullptr if there is no such record.
+ */
+gcc_pure gcc_nonnull_all
+const DecoderPlugin *
+decoder_plugin_recall(const char *key);
+
+/**
+ * Remember which plugin has been used successfully for the specified
+ * file name or URI, see decoder_plugin_recall().
+ */
+gcc_nonnull_all
+void
+decoder_plugin_remember(const char *key, const DecoderPlugin &plugin);
+
+/**
+ * Try the plugins which support the specified suffix or MIME type,
+ * in the order of #decoder_plugins, until f() returns true.  If a
+ * plugin has been remembered for the key, it is tried first, and
+ * the successful plugin is remembered for the next call.
+ *
+ * @param key the file name or URI; may be nullptr to disable the
+ * memory
+ */
+template<typename F>
+static inline bool
+decoder_plugins_try_candidates(const char *key, const char *suffix,
+			       const char *mime_type, F f)
+{
+	const DecoderPlugin *hint = key != nullptr
+		? decoder_plugin_recall(key)
+		: nullptr;
+	if (hint != nullptr && f(*hint))
+		return true;
+
+	const DecoderPluginMask mask =
+		decoder_plugins_candidates(suffix, mime_type);
+	for (unsigned i = 0; decoder_plugins[i] != nullptr; ++i) {
+		if ((mask & (DecoderPluginMask(1) << i)) == 0 ||
+		    decoder_plugins[i] == hint ||
+		    !decoder_plugin_prepare(i))
+			continue;
+
+		if (f(*decoder_plugins[i])) {
+			if (key != nullptr)
+				decoder_plugin_remember(key,
+							*decoder_plugins[i]);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+struct DecoderScanStats {
+	/**
+	 * The number of successful and failed tag scans.
+	 */
+	unsigned n_success, n_failure;
+
+	/**
+	 * The total time spent in these scans.
+	 */
+	uint64_t duration_us;
+};
+
+/**
+ * Record one tag scan by the given plugin.  This function is
+ * thread-safe.
+ */
+void
+decoder_plugin_count_scan(const DecoderPlugin &plugin, bool success,
+			  uint64_t duration_us);
+
+/**
+ * Returns the tag scan counters (since startup) of the plugin with
+ * the given index into #decoder_plugins.
+ */
+gcc_pure
+DecoderScanStats
+decoder_plugin_get_scan_stats(unsigned i);
+
 /**
  * Is there at least once #DecoderPlugin that supports the specified
  * file name suffix?
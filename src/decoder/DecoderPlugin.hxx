@@ -22,10 +22,13 @@
 
 #include "Compiler.h"
 
+#include <forward_list>
+
 struct config_param;
 class InputStream;
 struct tag_handler;
 class Path;
+class DetachedSong;
 
 /**
  * Opaque handle which the decoder plugin passes to the functions in
@@ -71,6 +74,12 @@ struct DecoderPlugin {
 	/**
 	 * Scan metadata of a file.
 	 *
+	 * If tag_handler_accepts_estimate() returns true, the plugin
+	 * should not parse the whole file just to determine the exact
+	 * duration; it may submit an estimate with
+	 * tag_handler_invoke_estimated_duration() instead.  The
+	 * player fixes the duration when the song is played.
+	 *
 	 * @return false if the operation has failed
 	 */
 	bool (*scan_file)(Path path_fs,
@@ -78,7 +87,8 @@ struct DecoderPlugin {
 			  void *handler_ctx);
 
 	/**
-	 * Scan metadata of a file.
+	 * Scan metadata of a stream.  See scan_file() for estimated
+	 * durations.
 	 *
 	 * @return false if the operation has failed
 	 */
@@ -87,18 +97,15 @@ struct DecoderPlugin {
 			    void *handler_ctx);
 
 	/**
-	 * @brief Return a "virtual" filename for subtracks in
-	 * container formats like flac
-	 * @param const char* pathname full pathname for the file on fs
-	 * @param const unsigned int tnum track number
+	 * Enumerate the "virtual" tracks of a container file (e.g. the
+	 * subtunes of a SID file) and read their tags, in one pass
+	 * which opens the file only once.
 	 *
-	 * @return nullptr if there are no multiple files
-	 * a filename for every single track according to tnum (param 2)
-	 * do not include full pathname here, just the "virtual" file
-	 *
-	 * Free the return value with delete[].
+	 * @return a list of songs whose URIs are the "virtual" file
+	 * names relative to the container (not the full path), or an
+	 * empty list if this is not a container
 	 */
-	char* (*container_scan)(Path path_fs, const unsigned int tnum);
+	std::forward_list<DetachedSong> (*container_scan)(Path path_fs);
 
 	/* last element in these arrays must always be a nullptr: */
 	const char *const*suffixes;
@@ -162,14 +169,6 @@ struct DecoderPlugin {
 			: false;
 	}
 
-	/**
-	 * return "virtual" tracks in a container
-	 */
-	template<typename P>
-	char *ContainerScan(P path, const unsigned int tnum) const {
-		return container_scan(path, tnum);
-	}
-
 	/**
 	 * Does the plugin announce the specified file name suffix?
 	 */
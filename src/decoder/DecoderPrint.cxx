@@ -53,3 +53,25 @@ decoder_list_print(Client &client)
 	const auto f = std::bind(decoder_plugin_print, std::ref(client), _1);
 	decoder_plugins_for_each_enabled(f);
 }
+
+void
+decoder_scan_stats_print(Client &client)
+{
+	for (unsigned i = 0; decoder_plugins[i] != nullptr; ++i) {
+		if (!decoder_plugins_enabled[i])
+			continue;
+
+		const auto stats = decoder_plugin_get_scan_stats(i);
+		if (stats.n_success == 0 && stats.n_failure == 0)
+			continue;
+
+		client_printf(client,
+			      "plugin: %s\n"
+			      "scan_success: %u\n"
+			      "scan_failure: %u\n"
+			      "scan_time: %.3f\n",
+			      decoder_plugins[i]->name,
+			      stats.n_success, stats.n_failure,
+			      stats.duration_us / 1000000.);
+	}
+}
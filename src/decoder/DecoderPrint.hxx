@@ -25,4 +25,10 @@ class Client;
 void
 decoder_list_print(Client &client);
 
+/**
+ * Print the tag scan counters of all enabled decoder plugins.
+ */
+void
+decoder_scan_stats_print(Client &client);
+
 #endif
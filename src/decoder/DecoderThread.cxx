@@ -24,6 +24,8 @@
 #include "DecoderError.hxx"
 #include "DecoderPlugin.hxx"
 #include "DetachedSong.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
 #include "system/FatalError.hxx"
 #include "fs/Traits.hxx"
 #include "fs/AllocatedPath.hxx"
@@ -34,6 +36,7 @@
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "thread/Name.hxx"
+#include "thread/Scheduling.hxx"
 #include "tag/ApeReplayGain.hxx"
 #include "Log.hxx"
 
@@ -58,7 +61,8 @@ decoder_command_finished_locked(DecoderControl &dc)
 }
 
 /**
- * Opens the input stream with input_stream::Open(), and waits until
+ * Opens the input stream with input_stream::Open() (or obtains the
+ * one prefetched by DecoderControl::UpdatePrefetch()), and waits until
  * the stream gets ready.  If a decoder STOP command is received
  * during that, it cancels the operation (but does not close the
  * stream).
@@ -73,7 +77,16 @@ decoder_input_stream_open(DecoderControl &dc, const char *uri)
 {
 	Error error;
 
-	InputStream *is = InputStream::Open(uri, dc.mutex, dc.cond, error);
+	dc.Lock();
+	InputStream *is = dc.TakePrefetch(uri);
+	dc.Unlock();
+
+	if (is != nullptr)
+		FormatDebug(decoder_thread_domain,
+			    "using prefetched stream %s", uri);
+	else
+		is = InputStream::Open(uri, dc.mutex, dc.cond, error);
+
 	if (is == nullptr) {
 		if (error.IsDefined())
 			LogError(error);
@@ -173,42 +186,12 @@ decoder_file_decode(const DecoderPlugin &plugin,
 	return decoder.dc.state != DecoderState::START;
 }
 
-gcc_pure
-static bool
-decoder_check_plugin_mime(const DecoderPlugin &plugin, const InputStream &is)
-{
-	assert(plugin.stream_decode != nullptr);
-
-	const char *mime_type = is.GetMimeType();
-	return mime_type != nullptr && plugin.SupportsMimeType(mime_type);
-}
-
-gcc_pure
-static bool
-decoder_check_plugin_suffix(const DecoderPlugin &plugin, const char *suffix)
-{
-	assert(plugin.stream_decode != nullptr);
-
-	return suffix != nullptr && plugin.SupportsSuffix(suffix);
-}
-
-gcc_pure
-static bool
-decoder_check_plugin(const DecoderPlugin &plugin, const InputStream &is,
-		     const char *suffix)
-{
-	return plugin.stream_decode != nullptr &&
-		(decoder_check_plugin_mime(plugin, is) ||
-		 decoder_check_plugin_suffix(plugin, suffix));
-}
-
 static bool
 decoder_run_stream_plugin(Decoder &decoder, InputStream &is,
-			  const char *suffix,
 			  const DecoderPlugin &plugin,
 			  bool &tried_r)
 {
-	if (!decoder_check_plugin(plugin, is, suffix))
+	if (plugin.stream_decode == nullptr)
 		return false;
 
 	tried_r = true;
@@ -223,9 +206,10 @@ decoder_run_stream_locked(Decoder &decoder, InputStream &is,
 
 	using namespace std::placeholders;
 	const auto f = std::bind(decoder_run_stream_plugin,
-				 std::ref(decoder), std::ref(is), suffix,
+				 std::ref(decoder), std::ref(is),
 				 _1, std::ref(tried_r));
-	return decoder_plugins_try(f);
+	return decoder_plugins_try_candidates(uri, suffix, is.GetMimeType(),
+					      f);
 }
 
 /**
@@ -290,12 +274,8 @@ decoder_load_replay_gain(Decoder &decoder, Path path_fs)
 }
 
 static bool
-TryDecoderFile(Decoder &decoder, Path path_fs, const char *suffix,
-	       const DecoderPlugin &plugin)
+TryDecoderFile(Decoder &decoder, Path path_fs, const DecoderPlugin &plugin)
 {
-	if (!plugin.SupportsSuffix(suffix))
-		return false;
-
 	DecoderControl &dc = decoder.dc;
 
 	if (plugin.file_decode != nullptr) {
@@ -344,12 +324,12 @@ decoder_run_file(Decoder &decoder, const char *uri_utf8, Path path_fs)
 
 	decoder_load_replay_gain(decoder, path_fs);
 
-	if (decoder_plugins_try([&decoder, path_fs,
-				 suffix](const DecoderPlugin &plugin){
-				return TryDecoderFile(decoder,
-						      path_fs, suffix,
-						      plugin);
-			}))
+	if (decoder_plugins_try_candidates(path_fs.c_str(), suffix, nullptr,
+					   [&decoder, path_fs](const DecoderPlugin &plugin){
+						   return TryDecoderFile(decoder,
+									 path_fs,
+									 plugin);
+					   }))
 		return true;
 
 	dc.Lock();
@@ -364,6 +344,17 @@ decoder_run_song(DecoderControl &dc,
 			new Tag(song.GetTag()));
 	int ret;
 
+	if (song.GetReplayGain().IsDefined())
+		/* values computed by the database; replay gain tags
+		   found by the decoder plugin override them */
+		decoder_replay_gain(decoder, &song.GetReplayGain());
+
+	if (song.GetMixRamp().IsDefined()) {
+		/* same for MixRamp */
+		MixRampInfo mix_ramp = song.GetMixRamp();
+		decoder_mixramp(decoder, std::move(mix_ramp));
+	}
+
 	dc.state = DecoderState::START;
 
 	decoder_command_finished_locked(dc);
@@ -379,6 +370,10 @@ decoder_run_song(DecoderControl &dc,
 	if (decoder.chunk != nullptr)
 		decoder.FlushChunk();
 
+	/* give all unused chunks back to the player */
+
+	decoder.chunk_cache.Flush();
+
 	dc.Lock();
 
 	if (decoder.error.IsDefined()) {
@@ -436,6 +431,7 @@ decoder_task(void *arg)
 	DecoderControl &dc = *(DecoderControl *)arg;
 
 	SetThreadName("decoder");
+	thread_scheduling_apply("decoder");
 
 	dc.Lock();
 
@@ -456,6 +452,11 @@ decoder_task(void *arg)
 			break;
 
 		case DecoderCommand::STOP:
+			/* the prefetched stream is obsolete now */
+			dc.CancelPrefetch();
+			if (dc.IsPrefetchPending())
+				dc.UpdatePrefetch();
+
 			decoder_command_finished_locked(dc);
 			break;
 
@@ -474,6 +475,7 @@ decoder_thread_start(DecoderControl &dc)
 	assert(!dc.thread.IsDefined());
 
 	dc.quit = false;
+	dc.prefetch_enabled = config_get_bool(CONF_DECODER_PREFETCH, true);
 
 	Error error;
 	if (!dc.thread.Start(decoder_task, &dc, error))
@@ -0,0 +1,294 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#define __STDC_FORMAT_MACROS /* for PRIu64 */
+
+#include "config.h"
+#include "SeekIndex.hxx"
+#include "thread/Mutex.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/io/TextFile.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "util/StringUtil.hxx"
+#include "util/NumberParser.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <list>
+#include <string>
+#include <algorithm>
+
+#include <assert.h>
+#include <string.h>
+#include <inttypes.h> /* for PRIu64 */
+
+#define SEEK_INDEX_SONG_BEGIN "song_begin: "
+#define SEEK_INDEX_SONG_END "song_end"
+#define SEEK_INDEX_SIZE "size: "
+#define SEEK_INDEX_COVERED "covered: "
+#define SEEK_INDEX_POINT "point: "
+
+static constexpr Domain seek_index_domain("seek_index");
+
+/**
+ * The seek points of one song.
+ */
+struct SeekTable {
+	std::string uri;
+
+	offset_type size;
+
+	unsigned covered_ms;
+
+	std::vector<SeekPoint> points;
+
+	SeekTable(const char *_uri, offset_type _size)
+		:uri(_uri), size(_size), covered_ms(0) {}
+};
+
+/**
+ * The maximum number of songs in the index.  With one point per
+ * second, this is roughly 16 MB for songs of average length.
+ */
+static constexpr size_t MAX_SEEK_TABLES = 4096;
+
+static Mutex seek_index_mutex;
+
+/**
+ * All known seek tables; the most recently used one is at the
+ * front.  Protected by #seek_index_mutex.
+ */
+static std::list<SeekTable> seek_index;
+
+static AllocatedPath seek_index_path = AllocatedPath::Null();
+
+/**
+ * Has the index been modified since it was loaded?
+ */
+static bool seek_index_modified;
+
+/**
+ * Find the last point before the given time.
+ */
+static bool
+FindSeekPoint(const std::vector<SeekPoint> &points, unsigned covered_ms,
+	      unsigned time_ms, SeekPoint &point_r)
+{
+	if (points.empty() || time_ms > covered_ms ||
+	    time_ms < points.front().time_ms)
+		return false;
+
+	auto p = std::upper_bound(points.begin(), points.end(), time_ms,
+				  [](unsigned t, const SeekPoint &sp){
+					  return t < sp.time_ms;
+				  });
+	assert(p != points.begin());
+
+	point_r = *--p;
+	return true;
+}
+
+static std::list<SeekTable>::iterator
+seek_index_find(const char *uri)
+{
+	return std::find_if(seek_index.begin(), seek_index.end(),
+			    [uri](const SeekTable &t){
+				    return t.uri == uri;
+			    });
+}
+
+static bool
+seek_index_load_table(TextFile &file, const char *uri)
+{
+	SeekTable table(uri, 0);
+
+	const char *line;
+	while ((line = file.ReadLine()) != nullptr &&
+	       strcmp(line, SEEK_INDEX_SONG_END) != 0) {
+		char *endptr;
+
+		if (StringStartsWith(line, SEEK_INDEX_SIZE)) {
+			table.size = ParseUint64(line + strlen(SEEK_INDEX_SIZE));
+		} else if (StringStartsWith(line, SEEK_INDEX_COVERED)) {
+			table.covered_ms =
+				ParseUnsigned(line + strlen(SEEK_INDEX_COVERED));
+		} else if (StringStartsWith(line, SEEK_INDEX_POINT)) {
+			SeekPoint point;
+			point.time_ms =
+				ParseUnsigned(line + strlen(SEEK_INDEX_POINT),
+					      &endptr);
+			if (*endptr != ' ')
+				return false;
+
+			point.offset = ParseUint64(endptr + 1, &endptr);
+			if (*endptr != 0 ||
+			    (!table.points.empty() &&
+			     point.time_ms <= table.points.back().time_ms))
+				return false;
+
+			table.points.push_back(point);
+		} else
+			return false;
+	}
+
+	if (line == nullptr || table.points.empty())
+		return false;
+
+	seek_index.emplace_back(std::move(table));
+	return true;
+}
+
+static void
+seek_index_load(Path path)
+{
+	Error error;
+	TextFile file(path, error);
+	if (file.HasFailed()) {
+		/* the file will be created on shutdown */
+		LogDebug(seek_index_domain, error.GetMessage());
+		return;
+	}
+
+	const char *line;
+	while ((line = file.ReadLine()) != nullptr &&
+	       seek_index.size() < MAX_SEEK_TABLES) {
+		if (!StringStartsWith(line, SEEK_INDEX_SONG_BEGIN) ||
+		    !seek_index_load_table(file,
+					   line + strlen(SEEK_INDEX_SONG_BEGIN))) {
+			FormatError(seek_index_domain,
+				    "Malformed seek index file: %s", line);
+			break;
+		}
+	}
+}
+
+static void
+seek_index_save(BufferedOutputStream &os)
+{
+	for (const auto &table : seek_index) {
+		os.Format(SEEK_INDEX_SONG_BEGIN "%s\n", table.uri.c_str());
+		os.Format(SEEK_INDEX_SIZE "%" PRIu64 "\n", table.size);
+		os.Format(SEEK_INDEX_COVERED "%u\n", table.covered_ms);
+
+		for (const auto &point : table.points)
+			os.Format(SEEK_INDEX_POINT "%u %" PRIu64 "\n",
+				  point.time_ms, point.offset);
+
+		os.Write(SEEK_INDEX_SONG_END "\n");
+	}
+}
+
+static void
+seek_index_save(Path path)
+{
+	Error error;
+	FileOutputStream fos(path, error);
+	if (!fos.IsDefined()) {
+		LogError(error);
+		return;
+	}
+
+	BufferedOutputStream bos(fos);
+	seek_index_save(bos);
+	if (!bos.Flush(error) || !fos.Commit(error))
+		LogError(error);
+}
+
+void
+seek_index_global_init(AllocatedPath &&path)
+{
+	assert(seek_index_path.IsNull());
+
+	seek_index_path = std::move(path);
+	seek_index_load(seek_index_path);
+	seek_index_modified = false;
+}
+
+void
+seek_index_global_finish()
+{
+	const ScopeLock protect(seek_index_mutex);
+
+	if (!seek_index_path.IsNull() && seek_index_modified)
+		seek_index_save(seek_index_path);
+
+	seek_index.clear();
+	seek_index_path = AllocatedPath::Null();
+}
+
+bool
+seek_index_lookup(const char *uri, offset_type size, unsigned time_ms,
+		  SeekPoint &point_r)
+{
+	assert(uri != nullptr);
+
+	const ScopeLock protect(seek_index_mutex);
+
+	auto i = seek_index_find(uri);
+	if (i == seek_index.end())
+		return false;
+
+	if (i->size != size) {
+		/* the file has been modified */
+		seek_index.erase(i);
+		seek_index_modified = true;
+		return false;
+	}
+
+	/* move to the front; this song is being played */
+	seek_index.splice(seek_index.begin(), seek_index, i);
+
+	return FindSeekPoint(i->points, i->covered_ms, time_ms, point_r);
+}
+
+bool
+SeekIndexBuilder::Lookup(unsigned time_ms, SeekPoint &point_r) const
+{
+	return FindSeekPoint(points, covered_ms, time_ms, point_r);
+}
+
+void
+SeekIndexBuilder::Commit(const char *uri, offset_type size)
+{
+	assert(uri != nullptr);
+
+	if (points.empty())
+		return;
+
+	const ScopeLock protect(seek_index_mutex);
+
+	auto i = seek_index_find(uri);
+	if (i != seek_index.end()) {
+		if (i->size == size && i->covered_ms >= covered_ms)
+			/* we already know more */
+			return;
+
+		seek_index.erase(i);
+	}
+
+	seek_index.emplace_front(uri, size);
+	SeekTable &table = seek_index.front();
+	table.covered_ms = covered_ms;
+	table.points = std::move(points);
+	seek_index_modified = true;
+
+	if (seek_index.size() > MAX_SEEK_TABLES)
+		seek_index.pop_back();
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef MPD_SEEK_INDEX_HXX
+#define MPD_SEEK_INDEX_HXX
+
+#include "check.h"
+#include "input/Offset.hxx"
+
+#include <vector>
+
+class AllocatedPath;
+
+/**
+ * A position in a song which a decoder plugin can seek to without
+ * having to scan the stream.
+ */
+struct SeekPoint {
+	/**
+	 * The song time at this point in milliseconds.
+	 */
+	unsigned time_ms;
+
+	/**
+	 * The stream offset where decoding can be resumed to get
+	 * samples from #time_ms on.
+	 */
+	offset_type offset;
+};
+
+/**
+ * Collects #SeekPoint objects while a song is being decoded; this is
+ * how the seek index is built, lazily, the first time a song is
+ * played.  The caller must ensure that the points it adds are
+ * contiguous, i.e. there is no gap caused by a seek.
+ */
+class SeekIndexBuilder {
+	std::vector<SeekPoint> points;
+
+	/**
+	 * The end of the song range described by the points.
+	 */
+	unsigned covered_ms;
+
+public:
+	/**
+	 * The minimum distance between two points.
+	 */
+	static constexpr unsigned GRANULARITY_MS = 1000;
+
+	SeekIndexBuilder():covered_ms(0) {}
+
+	/**
+	 * Add a point.  It is ignored if it is too close to the
+	 * previous one, or before it (after seeking back).
+	 */
+	void Add(unsigned time_ms, offset_type offset) {
+		if (points.empty() ||
+		    time_ms >= points.back().time_ms + GRANULARITY_MS)
+			points.push_back({time_ms, offset});
+
+		Cover(time_ms);
+	}
+
+	/**
+	 * Declare that the song has been decoded up to the given
+	 * time.
+	 */
+	void Cover(unsigned time_ms) {
+		if (time_ms > covered_ms)
+			covered_ms = time_ms;
+	}
+
+	unsigned GetCovered() const {
+		return covered_ms;
+	}
+
+	/**
+	 * Look up the last point before the specified time among the
+	 * points collected so far.
+	 *
+	 * @return false if the points do not cover the given time
+	 */
+	bool Lookup(unsigned time_ms, SeekPoint &point_r) const;
+
+	/**
+	 * Submit the points to the seek index.  Nothing happens if
+	 * the index already knows a larger part of the song.
+	 *
+	 * @param uri the URI of the #InputStream
+	 * @param size the size of the #InputStream; if it changes,
+	 * the index is stale
+	 */
+	void Commit(const char *uri, offset_type size);
+};
+
+/**
+ * Load the seek index from the specified file, and save it there in
+ * seek_index_global_finish().  Without this call, the seek index
+ * is only kept in memory.
+ */
+void
+seek_index_global_init(AllocatedPath &&path);
+
+void
+seek_index_global_finish();
+
+/**
+ * Look up the last #SeekPoint before the specified time.
+ *
+ * @param uri the URI of the #InputStream
+ * @param size the size of the #InputStream
+ * @return false if the index does not cover the given time
+ */
+bool
+seek_index_lookup(const char *uri, offset_type size, unsigned time_ms,
+		  SeekPoint &point_r);
+
+#endif
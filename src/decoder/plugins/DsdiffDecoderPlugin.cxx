@@ -38,6 +38,10 @@
 #include "DsdLib.hxx"
 #include "Log.hxx"
 
+#include <memory>
+
+#include <string.h>
+
 struct DsdiffHeader {
 	DsdId id;
 	DffDsdUint64 size;
@@ -343,13 +347,6 @@ dsdiff_read_metadata(Decoder *decoder, InputStream &is,
 	}
 }
 
-static void
-bit_reverse_buffer(uint8_t *p, uint8_t *end)
-{
-	for (; p < end; ++p)
-		*p = bit_reverse(*p);
-}
-
 static offset_type
 TimeToFrame(double t, unsigned sample_rate)
 {
@@ -372,13 +369,17 @@ dsdiff_decode_chunk(Decoder &decoder, InputStream &is,
 {
 	const offset_type start_offset = is.GetOffset();
 
-	uint8_t buffer[8192];
+	/* read large blocks; this reduces the overhead per byte,
+	   which matters at high DSD rates */
+	static constexpr size_t max_buffer_size = 65536;
 
-	const size_t sample_size = sizeof(buffer[0]);
+	const size_t sample_size = sizeof(uint8_t);
 	const size_t frame_size = channels * sample_size;
-	const unsigned buffer_frames = sizeof(buffer) / frame_size;
+	const unsigned buffer_frames = max_buffer_size / frame_size;
 	const size_t buffer_size = buffer_frames * frame_size;
 
+	const std::unique_ptr<uint8_t[]> buffer(new uint8_t[buffer_size]);
+
 	auto cmd = decoder_get_command(decoder);
 	for (offset_type remaining_bytes = total_bytes;
 	     remaining_bytes >= frame_size && cmd != DecoderCommand::STOP;) {
@@ -407,16 +408,23 @@ dsdiff_decode_chunk(Decoder &decoder, InputStream &is,
 			now_size = now_frames * frame_size;
 		}
 
-		if (!decoder_read_full(&decoder, is, buffer, now_size))
+		const uint8_t *src = (const uint8_t *)
+			decoder_read_full_view(&decoder, is,
+					       buffer.get(), now_size);
+		if (src == nullptr)
 			return false;
 
 		const size_t nbytes = now_size;
 		remaining_bytes -= nbytes;
 
-		if (lsbitfirst)
-			bit_reverse_buffer(buffer, buffer + nbytes);
+		if (lsbitfirst) {
+			/* the mapping is read-only; reverse into the
+			   local buffer */
+			bit_reverse_buffer(buffer.get(), src, nbytes);
+			src = buffer.get();
+		}
 
-		cmd = decoder_data(decoder, is, buffer, nbytes,
+		cmd = decoder_data(decoder, is, src, nbytes,
 				   sample_rate / 1000);
 	}
 
@@ -39,11 +39,26 @@
 #include "tag/TagHandler.hxx"
 #include "Log.hxx"
 
+#include <memory>
+
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <assert.h>
 #include <string.h>
 
 static constexpr unsigned DSF_BLOCK_SIZE = 4096;
 static constexpr unsigned DSF_BLOCK_BITS = DSF_BLOCK_SIZE * 8;
 
+/**
+ * The (approximate) number of bytes read at a time.  This is
+ * rounded down to whole block groups, but at least one.
+ */
+static constexpr size_t DSF_READ_SIZE = MAX_CHANNELS * DSF_BLOCK_SIZE * 4;
+
 struct DsfMetaData {
 	unsigned sample_rate, channels;
 	bool bitreverse;
@@ -183,13 +198,6 @@ dsf_read_metadata(Decoder *decoder, InputStream &is,
 	return true;
 }
 
-static void
-bit_reverse_buffer(uint8_t *p, uint8_t *end)
-{
-	for (; p < end; ++p)
-		*p = bit_reverse(*p);
-}
-
 static void
 InterleaveDsfBlockMono(uint8_t *gcc_restrict dest,
 		       const uint8_t *gcc_restrict src)
@@ -207,10 +215,28 @@ static void
 InterleaveDsfBlockStereo(uint8_t *gcc_restrict dest,
 			 const uint8_t *gcc_restrict src)
 {
+	const uint8_t *left = src, *right = src + DSF_BLOCK_SIZE;
+
+#ifdef __ARM_NEON__
+	for (size_t i = 0; i < DSF_BLOCK_SIZE; i += 16, dest += 32) {
+		const uint8x16x2_t x = { { vld1q_u8(left + i),
+					   vld1q_u8(right + i) } };
+		vst2q_u8(dest, x);
+	}
+#elif defined(__SSE2__)
+	for (size_t i = 0; i < DSF_BLOCK_SIZE; i += 16, dest += 32) {
+		const __m128i l = _mm_loadu_si128((const __m128i *)(left + i));
+		const __m128i r = _mm_loadu_si128((const __m128i *)(right + i));
+		_mm_storeu_si128((__m128i *)dest, _mm_unpacklo_epi8(l, r));
+		_mm_storeu_si128((__m128i *)(dest + 16),
+				 _mm_unpackhi_epi8(l, r));
+	}
+#else
 	for (size_t i = 0; i < DSF_BLOCK_SIZE; ++i) {
-		dest[2 * i] = src[i];
-		dest[2 * i + 1] = src[DSF_BLOCK_SIZE + i];
+		dest[2 * i] = left[i];
+		dest[2 * i + 1] = right[i];
 	}
+#endif
 }
 
 static void
@@ -243,6 +269,21 @@ InterleaveDsfBlock(uint8_t *gcc_restrict dest, const uint8_t *gcc_restrict src,
 		InterleaveDsfBlockGeneric(dest, src, channels);
 }
 
+/**
+ * Interleave several consecutive DSF blocks.
+ */
+static void
+InterleaveDsfBlocks(uint8_t *gcc_restrict dest,
+		    const uint8_t *gcc_restrict src,
+		    unsigned channels, size_t n_blocks)
+{
+	const size_t block_size = channels * DSF_BLOCK_SIZE;
+
+	for (size_t i = 0; i < n_blocks;
+	     ++i, dest += block_size, src += block_size)
+		InterleaveDsfBlock(dest, src, channels);
+}
+
 static offset_type
 TimeToBlock(double t, unsigned sample_rate)
 {
@@ -261,6 +302,15 @@ dsf_decode_chunk(Decoder &decoder, InputStream &is,
 	const size_t block_size = channels * DSF_BLOCK_SIZE;
 	const offset_type start_offset = is.GetOffset();
 
+	/* read several blocks at a time; this reduces the overhead
+	   per block, which matters at high DSD rates */
+	const size_t max_blocks = DSF_READ_SIZE / block_size;
+	assert(max_blocks > 0);
+
+	const std::unique_ptr<uint8_t[]>
+		buffer(new uint8_t[max_blocks * block_size]),
+		interleaved_buffer(new uint8_t[max_blocks * block_size]);
+
 	auto cmd = decoder_get_command(decoder);
 	for (offset_type i = 0; i < n_blocks && cmd != DecoderCommand::STOP;) {
 		if (cmd == DecoderCommand::SEEK) {
@@ -280,21 +330,31 @@ dsf_decode_chunk(Decoder &decoder, InputStream &is,
 				decoder_seek_error(decoder);
 		}
 
-		/* worst-case buffer size */
-		uint8_t buffer[MAX_CHANNELS * DSF_BLOCK_SIZE];
-		if (!decoder_read_full(&decoder, is, buffer, block_size))
+		size_t n = max_blocks;
+		if (n_blocks - i < (offset_type)n)
+			n = n_blocks - i;
+
+		const size_t size = n * block_size;
+		const uint8_t *src = (const uint8_t *)
+			decoder_read_full_view(&decoder, is,
+					       buffer.get(), size);
+		if (src == nullptr)
 			return false;
 
-		if (bitreverse)
-			bit_reverse_buffer(buffer, buffer + block_size);
+		if (bitreverse) {
+			/* the mapping is read-only; reverse into the
+			   local buffer */
+			bit_reverse_buffer(buffer.get(), src, size);
+			src = buffer.get();
+		}
 
-		uint8_t interleaved_buffer[MAX_CHANNELS * DSF_BLOCK_SIZE];
-		InterleaveDsfBlock(interleaved_buffer, buffer, channels);
+		InterleaveDsfBlocks(interleaved_buffer.get(), src,
+				    channels, n);
 
 		cmd = decoder_data(decoder, is,
-				   interleaved_buffer, block_size,
+				   interleaved_buffer.get(), size,
 				   sample_rate / 1000);
-		++i;
+		i += n;
 	}
 
 	return true;
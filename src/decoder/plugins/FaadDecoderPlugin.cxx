@@ -107,11 +107,16 @@ adts_find_frame(DecoderBuffer *buffer)
 	}
 }
 
+/**
+ * @param estimate extrapolate the duration from the first frames
+ * instead of reading the whole file; this is always done for remote
+ * files
+ */
 static float
-adts_song_duration(DecoderBuffer *buffer)
+adts_song_duration(DecoderBuffer *buffer, bool estimate)
 {
 	const InputStream &is = decoder_buffer_get_stream(buffer);
-	const bool estimate = !is.CheapSeeking();
+	estimate = estimate || !is.CheapSeeking();
 	if (estimate && !is.KnownSize())
 		return -1;
 
@@ -164,7 +169,8 @@ adts_song_duration(DecoderBuffer *buffer)
 }
 
 static float
-faad_song_duration(DecoderBuffer *buffer, InputStream &is)
+faad_song_duration(DecoderBuffer *buffer, InputStream &is,
+		   bool estimate=false)
 {
 	auto data = ConstBuffer<uint8_t>::FromVoid(decoder_buffer_need(buffer, 5));
 	if (data.IsNull())
@@ -193,7 +199,7 @@ faad_song_duration(DecoderBuffer *buffer, InputStream &is)
 		if (!is.IsSeekable())
 			return -1;
 
-		float song_length = adts_song_duration(buffer);
+		float song_length = adts_song_duration(buffer, estimate);
 
 		is.LockSeek(tagsize, IgnoreError());
 
@@ -306,12 +312,12 @@ faad_decoder_decode(NeAACDecHandle decoder, DecoderBuffer *buffer,
  * file is invalid.
  */
 static float
-faad_get_file_time_float(InputStream &is)
+faad_get_file_time_float(InputStream &is, bool estimate)
 {
 	DecoderBuffer *buffer =
 		decoder_buffer_new(nullptr, is,
 				   FAAD_MIN_STREAMSIZE * MAX_CHANNELS);
-	float length = faad_song_duration(buffer, is);
+	float length = faad_song_duration(buffer, is, estimate);
 
 	if (length < 0) {
 		NeAACDecHandle decoder = faad_decoder_new();
@@ -337,9 +343,9 @@ faad_get_file_time_float(InputStream &is)
  * file is invalid.
  */
 static int
-faad_get_file_time(InputStream &is)
+faad_get_file_time(InputStream &is, bool estimate)
 {
-	float length = faad_get_file_time_float(is);
+	float length = faad_get_file_time_float(is, estimate);
 	if (length < 0)
 		return -1;
 
@@ -449,11 +455,16 @@ static bool
 faad_scan_stream(InputStream &is,
 		 const struct tag_handler *handler, void *handler_ctx)
 {
-	int file_time = faad_get_file_time(is);
+	const bool estimate = tag_handler_accepts_estimate(handler);
+	int file_time = faad_get_file_time(is, estimate);
 	if (file_time < 0)
 		return false;
 
-	tag_handler_invoke_duration(handler, handler_ctx, file_time);
+	if (estimate)
+		tag_handler_invoke_estimated_duration(handler, handler_ctx,
+						      file_time);
+	else
+		tag_handler_invoke_duration(handler, handler_ctx, file_time);
 	return true;
 }
 
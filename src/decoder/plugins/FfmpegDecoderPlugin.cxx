@@ -28,6 +28,9 @@
 #include "tag/TagHandler.hxx"
 #include "input/InputStream.hxx"
 #include "CheckAudioFormat.hxx"
+#include "pcm/PcmBuffer.hxx"
+#include "thread/Mutex.hxx"
+#include "util/WritableBuffer.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "LogV.hxx"
@@ -45,6 +48,8 @@ extern "C" {
 #endif
 }
 
+#include <algorithm>
+
 #include <assert.h>
 #include <string.h>
 
@@ -86,20 +91,69 @@ mpd_ffmpeg_log_callback(gcc_unused void *ptr, int level,
 	}
 }
 
+/**
+ * The size of the AVIOContext buffer, i.e. the number of bytes
+ * libavformat requests from the #InputStream at a time.  Configured
+ * with the "buffer_size" setting.
+ */
+static size_t ffmpeg_io_buffer_size;
+
+static Mutex ffmpeg_buffer_mutex;
+
+/**
+ * An idle interleave buffer, left over from the previous song.  This
+ * avoids reallocating and faulting in a new one for each song in a
+ * gapless sequence.  Protected by #ffmpeg_buffer_mutex.
+ */
+static PcmBuffer *ffmpeg_idle_buffer;
+
+static PcmBuffer *
+ffmpeg_buffer_acquire()
+{
+	{
+		const ScopeLock protect(ffmpeg_buffer_mutex);
+
+		PcmBuffer *buffer = ffmpeg_idle_buffer;
+		if (buffer != nullptr) {
+			ffmpeg_idle_buffer = nullptr;
+			return buffer;
+		}
+	}
+
+	return new PcmBuffer();
+}
+
+static void
+ffmpeg_buffer_release(PcmBuffer *buffer)
+{
+	{
+		const ScopeLock protect(ffmpeg_buffer_mutex);
+
+		if (ffmpeg_idle_buffer == nullptr) {
+			ffmpeg_idle_buffer = buffer;
+			return;
+		}
+	}
+
+	delete buffer;
+}
+
 struct AvioStream {
 	Decoder *const decoder;
 	InputStream &input;
 
 	AVIOContext *io;
 
-	unsigned char buffer[8192];
-
 	AvioStream(Decoder *_decoder, InputStream &_input)
 		:decoder(_decoder), input(_input), io(nullptr) {}
 
 	~AvioStream() {
-		if (io != nullptr)
+		if (io != nullptr) {
+			/* libavformat may have replaced the buffer
+			   allocated by Open() */
+			av_free(io->buffer);
 			av_free(io);
+		}
 	}
 
 	bool Open();
@@ -153,12 +207,24 @@ mpd_ffmpeg_stream_seek(void *opaque, int64_t pos, int whence)
 bool
 AvioStream::Open()
 {
-	io = avio_alloc_context(buffer, sizeof(buffer),
+	/* libavformat requires a buffer allocated with av_malloc(),
+	   because it may free or reallocate it */
+	unsigned char *buffer =
+		(unsigned char *)av_malloc(ffmpeg_io_buffer_size);
+	if (buffer == nullptr)
+		return false;
+
+	io = avio_alloc_context(buffer, ffmpeg_io_buffer_size,
 				false, this,
 				mpd_ffmpeg_stream_read, nullptr,
 				input.IsSeekable()
 				? mpd_ffmpeg_stream_seek : nullptr);
-	return io != nullptr;
+	if (io == nullptr) {
+		av_free(buffer);
+		return false;
+	}
+
+	return true;
 }
 
 /**
@@ -181,14 +247,25 @@ mpd_ffmpeg_open_input(AVFormatContext **ic_ptr,
 }
 
 static bool
-ffmpeg_init(gcc_unused const config_param &param)
+ffmpeg_init(const config_param &param)
 {
+	ffmpeg_io_buffer_size = param.GetBlockValue("buffer_size", 32768u);
+	if (ffmpeg_io_buffer_size < 4096)
+		ffmpeg_io_buffer_size = 4096;
+
 	av_log_set_callback(mpd_ffmpeg_log_callback);
 
 	av_register_all();
 	return true;
 }
 
+static void
+ffmpeg_finish()
+{
+	delete ffmpeg_idle_buffer;
+	ffmpeg_idle_buffer = nullptr;
+}
+
 static int
 ffmpeg_find_audio_stream(const AVFormatContext *format_context)
 {
@@ -242,11 +319,11 @@ start_time_fallback(const AVStream &stream)
 }
 
 static void
-copy_interleave_frame2(uint8_t *dest, uint8_t **src,
-		       unsigned nframes, unsigned nchannels,
+copy_interleave_frame2(uint8_t *dest, uint8_t *const*src,
+		       unsigned start, unsigned end, unsigned nchannels,
 		       unsigned sample_size)
 {
-	for (unsigned frame = 0; frame < nframes; ++frame) {
+	for (unsigned frame = start; frame < end; ++frame) {
 		for (unsigned channel = 0; channel < nchannels; ++channel) {
 			memcpy(dest, src[channel] + frame * sample_size,
 			       sample_size);
@@ -256,45 +333,56 @@ copy_interleave_frame2(uint8_t *dest, uint8_t **src,
 }
 
 /**
- * Copy PCM data from a AVFrame to an interleaved buffer.
+ * Interleave the samples of a planar AVFrame and submit them to the
+ * decoder.  Whenever possible, the samples are interleaved right
+ * into the music chunk; the interleave buffer is only used as a
+ * fallback.
  */
-static int
-copy_interleave_frame(const AVCodecContext *codec_context,
-		      const AVFrame *frame,
-		      uint8_t **output_buffer,
-		      uint8_t **global_buffer, int *global_buffer_size)
+static DecoderCommand
+ffmpeg_send_planar(Decoder &decoder, InputStream &is,
+		   const AVCodecContext *codec_context,
+		   const AVFrame *frame,
+		   PcmBuffer &buffer)
 {
-	int plane_size;
-	const int data_size =
-		av_samples_get_buffer_size(&plane_size,
-					   codec_context->channels,
-					   frame->nb_samples,
-					   codec_context->sample_fmt, 1);
-	if (data_size <= 0)
-		return data_size;
-
-	if (av_sample_fmt_is_planar(codec_context->sample_fmt) &&
-	    codec_context->channels > 1) {
-		if(*global_buffer_size < data_size) {
-			av_freep(global_buffer);
-
-			*global_buffer = (uint8_t*)av_malloc(data_size);
-
-			if (!*global_buffer)
-				/* Not enough memory - shouldn't happen */
-				return AVERROR(ENOMEM);
-			*global_buffer_size = data_size;
+	const unsigned channels = codec_context->channels;
+	const unsigned sample_size =
+		av_get_bytes_per_sample(codec_context->sample_fmt);
+	const size_t frame_size = channels * sample_size;
+	const unsigned nframes = frame->nb_samples;
+	const uint16_t kbit_rate = codec_context->bit_rate / 1000;
+
+	DecoderCommand cmd = DecoderCommand::NONE;
+	unsigned position = 0;
+	while (position < nframes) {
+		auto dest = decoder_data_begin(decoder, is, kbit_rate);
+		if (dest.IsNull()) {
+			/* the decoder API can't give us a chunk;
+			   interleave into our own buffer and let
+			   decoder_data() deal with it */
+			const size_t size = (nframes - position) * frame_size;
+			uint8_t *p = (uint8_t *)buffer.Get(size);
+			copy_interleave_frame2(p, frame->extended_data,
+					       position, nframes,
+					       channels, sample_size);
+			cmd = decoder_data(decoder, is, p, size, kbit_rate);
+			break;
 		}
-		*output_buffer = *global_buffer;
-		copy_interleave_frame2(*output_buffer, frame->extended_data,
-				       frame->nb_samples,
-				       codec_context->channels,
-				       av_get_bytes_per_sample(codec_context->sample_fmt));
-	} else {
-		*output_buffer = frame->extended_data[0];
+
+		const unsigned n = std::min<unsigned>(dest.size / frame_size,
+						      nframes - position);
+		copy_interleave_frame2((uint8_t *)dest.data,
+				       frame->extended_data,
+				       position, position + n,
+				       channels, sample_size);
+
+		cmd = decoder_data_commit(decoder, n * frame_size);
+		if (cmd != DecoderCommand::NONE)
+			break;
+
+		position += n;
 	}
 
-	return data_size;
+	return cmd;
 }
 
 static DecoderCommand
@@ -303,7 +391,7 @@ ffmpeg_send_packet(Decoder &decoder, InputStream &is,
 		   AVCodecContext *codec_context,
 		   const AVStream *stream,
 		   AVFrame *frame,
-		   uint8_t **buffer, int *buffer_size)
+		   PcmBuffer &buffer)
 {
 	if (packet->pts >= 0 && packet->pts != (int64_t)AV_NOPTS_VALUE)
 		decoder_timestamp(decoder,
@@ -312,7 +400,8 @@ ffmpeg_send_packet(Decoder &decoder, InputStream &is,
 
 	AVPacket packet2 = *packet;
 
-	uint8_t *output_buffer;
+	const bool planar = av_sample_fmt_is_planar(codec_context->sample_fmt) &&
+		codec_context->channels > 1;
 
 	DecoderCommand cmd = DecoderCommand::NONE;
 	while (packet2.size > 0 && cmd == DecoderCommand::NONE) {
@@ -322,10 +411,11 @@ ffmpeg_send_packet(Decoder &decoder, InputStream &is,
 						frame, &got_frame,
 						&packet2);
 		if (len >= 0 && got_frame) {
-			audio_size = copy_interleave_frame(codec_context,
-							   frame,
-							   &output_buffer,
-							   buffer, buffer_size);
+			audio_size = av_samples_get_buffer_size(nullptr,
+								codec_context->channels,
+								frame->nb_samples,
+								codec_context->sample_fmt,
+								1);
 			if (audio_size < 0)
 				len = audio_size;
 		}
@@ -343,9 +433,13 @@ ffmpeg_send_packet(Decoder &decoder, InputStream &is,
 		if (audio_size <= 0)
 			continue;
 
-		cmd = decoder_data(decoder, is,
-				   output_buffer, audio_size,
-				   codec_context->bit_rate / 1000);
+		if (planar)
+			cmd = ffmpeg_send_planar(decoder, is, codec_context,
+						 frame, buffer);
+		else
+			cmd = decoder_data(decoder, is,
+					   frame->extended_data[0], audio_size,
+					   codec_context->bit_rate / 1000);
 	}
 	return cmd;
 }
@@ -524,8 +618,7 @@ ffmpeg_decode(Decoder &decoder, InputStream &input)
 		return;
 	}
 
-	uint8_t *interleaved_buffer = nullptr;
-	int interleaved_buffer_size = 0;
+	PcmBuffer *interleaved_buffer = ffmpeg_buffer_acquire();
 
 	DecoderCommand cmd;
 	do {
@@ -538,8 +631,7 @@ ffmpeg_decode(Decoder &decoder, InputStream &input)
 			cmd = ffmpeg_send_packet(decoder, input,
 						 &packet, codec_context,
 						 av_stream,
-						 frame,
-						 &interleaved_buffer, &interleaved_buffer_size);
+						 frame, *interleaved_buffer);
 		else
 			cmd = decoder_get_command(decoder);
 
@@ -568,12 +660,47 @@ ffmpeg_decode(Decoder &decoder, InputStream &input)
 #else
 	av_freep(&frame);
 #endif
-	av_freep(&interleaved_buffer);
+	ffmpeg_buffer_release(interleaved_buffer);
 
 	avcodec_close(codec_context);
 	avformat_close_input(&format_context);
 }
 
+/**
+ * Determine the duration from the container header, without
+ * avformat_find_stream_info().
+ *
+ * @return the duration in seconds, or -1 if it is not known yet
+ */
+static int
+ffmpeg_header_duration(const AVFormatContext &f)
+{
+	if (f.duration != (int64_t)AV_NOPTS_VALUE)
+		return f.duration / AV_TIME_BASE;
+
+	const int idx = ffmpeg_find_audio_stream(&f);
+	if (idx < 0)
+		return -1;
+
+	const AVStream &stream = *f.streams[idx];
+	if (stream.duration == (int64_t)AV_NOPTS_VALUE)
+		return -1;
+
+	return av_rescale_q(stream.duration, stream.time_base,
+			    (AVRational){1, 1});
+}
+
+static void
+ffmpeg_scan_metadata(const AVFormatContext &f,
+		     const struct tag_handler *handler, void *handler_ctx)
+{
+	ffmpeg_scan_dictionary(f.metadata, handler, handler_ctx);
+	int idx = ffmpeg_find_audio_stream(&f);
+	if (idx >= 0)
+		ffmpeg_scan_dictionary(f.streams[idx]->metadata,
+				       handler, handler_ctx);
+}
+
 //no tag reading in ffmpeg, check if playable
 static bool
 ffmpeg_scan_stream(InputStream &is,
@@ -592,6 +719,21 @@ ffmpeg_scan_stream(InputStream &is,
 				  input_format) != 0)
 		return false;
 
+	/* avformat_find_stream_info() decodes frames, which is
+	   expensive; if the handler is satisfied with an estimate,
+	   try the duration declared by the container first */
+	if (tag_handler_accepts_estimate(handler)) {
+		const int duration = ffmpeg_header_duration(*f);
+		if (duration >= 0) {
+			tag_handler_invoke_estimated_duration(handler,
+							      handler_ctx,
+							      duration);
+			ffmpeg_scan_metadata(*f, handler, handler_ctx);
+			avformat_close_input(&f);
+			return true;
+		}
+	}
+
 	const int find_result =
 		avformat_find_stream_info(f, nullptr);
 	if (find_result < 0) {
@@ -603,11 +745,7 @@ ffmpeg_scan_stream(InputStream &is,
 		tag_handler_invoke_duration(handler, handler_ctx,
 					    f->duration / AV_TIME_BASE);
 
-	ffmpeg_scan_dictionary(f->metadata, handler, handler_ctx);
-	int idx = ffmpeg_find_audio_stream(f);
-	if (idx >= 0)
-		ffmpeg_scan_dictionary(f->streams[idx]->metadata,
-				       handler, handler_ctx);
+	ffmpeg_scan_metadata(*f, handler, handler_ctx);
 
 	avformat_close_input(&f);
 	return true;
@@ -731,7 +869,7 @@ static const char *const ffmpeg_mime_types[] = {
 const struct DecoderPlugin ffmpeg_decoder_plugin = {
 	"ffmpeg",
 	ffmpeg_init,
-	nullptr,
+	ffmpeg_finish,
 	ffmpeg_decode,
 	nullptr,
 	nullptr,
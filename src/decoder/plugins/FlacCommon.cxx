@@ -29,11 +29,13 @@
 #include "util/Error.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+
 flac_data::flac_data(Decoder &_decoder,
 		     InputStream &_input_stream)
 	:FlacInput(_input_stream, &_decoder),
 	 initialized(false), unsupported(false),
-	 total_frames(0), first_frame(0), next_frame(0), position(0),
+	 total_frames(0), max_blocksize(0), first_frame(0), next_frame(0), position(0),
 	 decoder(_decoder), input_stream(_input_stream)
 {
 }
@@ -81,6 +83,8 @@ flac_got_stream_info(struct flac_data *data,
 	if (data->total_frames == 0)
 		data->total_frames = stream_info->total_samples;
 
+	data->max_blocksize = stream_info->max_blocksize;
+
 	data->initialized = true;
 }
 
@@ -151,29 +155,57 @@ flac_common_write(struct flac_data *data, const FLAC__Frame * frame,
 		  const FLAC__int32 *const buf[],
 		  FLAC__uint64 nbytes)
 {
-	void *buffer;
 	unsigned bit_rate;
 
 	if (!data->initialized && !flac_got_first_frame(data, &frame->header))
 		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
 
-	size_t buffer_size = frame->header.blocksize * data->frame_size;
-	buffer = data->buffer.Get(buffer_size);
-
-	flac_convert(buffer, frame->header.channels,
-		     data->audio_format.format, buf,
-		     0, frame->header.blocksize);
-
 	if (nbytes > 0)
 		bit_rate = nbytes * 8 * frame->header.sample_rate /
 			(1000 * frame->header.blocksize);
 	else
 		bit_rate = 0;
 
-	auto cmd = decoder_data(data->decoder, data->input_stream,
-				buffer, buffer_size,
-				bit_rate);
-	data->next_frame += frame->header.blocksize;
+	const unsigned blocksize = frame->header.blocksize;
+	DecoderCommand cmd = DecoderCommand::NONE;
+
+	/* interleave the samples straight into the music chunks */
+	for (unsigned position = 0; position < blocksize;) {
+		auto dest = decoder_data_begin(data->decoder,
+					       data->input_stream, bit_rate);
+		if (dest.IsNull()) {
+			/* no chunk available (the samples need to be
+			   converted, or there is a command): let
+			   decoder_data() handle the rest */
+			size_t buffer_size =
+				(blocksize - position) * data->frame_size;
+			void *buffer = data->buffer.Get(buffer_size);
+
+			flac_convert(buffer, frame->header.channels,
+				     data->audio_format.format, buf,
+				     position, blocksize);
+
+			cmd = decoder_data(data->decoder, data->input_stream,
+					   buffer, buffer_size,
+					   bit_rate);
+			break;
+		}
+
+		const unsigned n = std::min<unsigned>(dest.size / data->frame_size,
+						      blocksize - position);
+		flac_convert(dest.data, frame->header.channels,
+			     data->audio_format.format, buf,
+			     position, position + n);
+
+		cmd = decoder_data_commit(data->decoder,
+					  n * data->frame_size);
+		if (cmd != DecoderCommand::NONE)
+			break;
+
+		position += n;
+	}
+
+	data->next_frame += blocksize;
 	switch (cmd) {
 	case DecoderCommand::NONE:
 	case DecoderCommand::START:
@@ -61,6 +61,12 @@ struct flac_data : public FlacInput {
 	 */
 	FLAC__uint64 total_frames;
 
+	/**
+	 * The maximum block size from the STREAMINFO block; 0 if
+	 * unknown.
+	 */
+	unsigned max_blocksize;
+
 	/**
 	 * The number of the first frame in this song.  This is only
 	 * non-zero if playing sub songs from a CUE sheet.
@@ -22,6 +22,7 @@
 #include "FlacDomain.hxx"
 #include "FlacCommon.hxx"
 #include "FlacMetadata.hxx"
+#include "FlacParallel.hxx"
 #include "OggCodec.hxx"
 #include "fs/Path.hxx"
 #include "util/Error.hxx"
@@ -31,6 +32,12 @@
 #error libFLAC is too old
 #endif
 
+/**
+ * The number of threads for decoding local FLAC files; 1 disables
+ * parallel decoding.
+ */
+static unsigned flac_threads;
+
 static void flacPrintErroredState(FLAC__StreamDecoderState state)
 {
 	switch (state) {
@@ -274,12 +281,26 @@ flac_decode_internal(Decoder &decoder,
 		return;
 	}
 
-	flac_decoder_loop(&data, flac_dec, 0, 0);
+	if (is_ogg || flac_threads < 2 ||
+	    !flac_decode_parallel(data, flac_threads))
+		flac_decoder_loop(&data, flac_dec, 0, 0);
 
 	FLAC__stream_decoder_finish(flac_dec);
 	FLAC__stream_decoder_delete(flac_dec);
 }
 
+static bool
+flac_init(const config_param &param)
+{
+	flac_threads = param.GetBlockValue("threads", 1u);
+	if (flac_threads == 0)
+		flac_threads = 1;
+	else if (flac_threads > MAX_FLAC_THREADS)
+		flac_threads = MAX_FLAC_THREADS;
+
+	return true;
+}
+
 static void
 flac_decode(Decoder &decoder, InputStream &input_stream)
 {
@@ -371,7 +392,7 @@ static const char *const flac_mime_types[] = {
 
 const struct DecoderPlugin flac_decoder_plugin = {
 	"flac",
-	nullptr,
+	flac_init,
 	nullptr,
 	flac_decode,
 	nullptr,
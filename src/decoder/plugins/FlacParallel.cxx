@@ -0,0 +1,597 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h" /* must be first for large file support */
+#include "FlacParallel.hxx"
+#include "FlacCommon.hxx"
+#include "FlacDomain.hxx"
+#include "FlacPcm.hxx"
+#include "input/InputStream.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
+#include "fs/Traits.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <stdint.h>
+
+/**
+ * Each segment consists of this many frames of the maximum block
+ * size.
+ */
+static constexpr unsigned FLAC_SEGMENT_BLOCKS = 16;
+
+class FlacParallelDecoder;
+
+/**
+ * A range of samples which is decoded by one worker thread.
+ */
+struct FlacSegment {
+	enum class State {
+		/**
+		 * This slot is unused.
+		 */
+		EMPTY,
+
+		/**
+		 * Waiting for a worker thread.
+		 */
+		QUEUED,
+
+		/**
+		 * A worker thread is decoding this segment; only
+		 * that thread may access #buffer and #size.
+		 */
+		BUSY,
+
+		/**
+		 * The segment has been decoded and may be submitted.
+		 */
+		DONE,
+
+		FAILED,
+	};
+
+	State state;
+
+	FLAC__uint64 number;
+
+	PcmBuffer buffer;
+
+	/**
+	 * The decoded samples (allocated from #buffer).
+	 */
+	const uint8_t *data;
+
+	size_t size;
+
+	FlacSegment():state(State::EMPTY) {}
+};
+
+/**
+ * A worker thread with its own libFLAC decoder, which opens the file
+ * by itself.
+ */
+class FlacParallelWorker {
+	FlacParallelDecoder &parent;
+
+	FLAC__StreamDecoder *flac_dec;
+
+	Thread thread;
+
+	/**
+	 * The sample number following the last frame decoded by
+	 * #flac_dec.  If the next segment begins there, no seek is
+	 * necessary.
+	 */
+	FLAC__uint64 next_sample;
+
+	/**
+	 * The range of the segment currently being decoded.
+	 */
+	FLAC__uint64 start, end;
+
+	/**
+	 * The sample number up to which the segment has been
+	 * decoded.
+	 */
+	FLAC__uint64 position;
+
+	uint8_t *dest;
+
+public:
+	explicit FlacParallelWorker(FlacParallelDecoder &_parent)
+		:parent(_parent), flac_dec(nullptr) {}
+
+	~FlacParallelWorker() {
+		assert(!thread.IsDefined());
+
+		if (flac_dec != nullptr) {
+			FLAC__stream_decoder_finish(flac_dec);
+			FLAC__stream_decoder_delete(flac_dec);
+		}
+	}
+
+	FlacParallelWorker(const FlacParallelWorker &) = delete;
+	FlacParallelWorker &operator=(const FlacParallelWorker &) = delete;
+
+	bool Open(const char *path);
+
+	bool Start(Error &error) {
+		return thread.Start(ThreadFunc, this, error);
+	}
+
+	void Join() {
+		thread.Join();
+	}
+
+private:
+	bool Decode(FlacSegment &segment, FLAC__uint64 number);
+
+	void Run();
+
+	static void ThreadFunc(void *ctx) {
+		FlacParallelWorker &worker = *(FlacParallelWorker *)ctx;
+		worker.Run();
+	}
+
+	FLAC__StreamDecoderWriteStatus Write(const FLAC__Frame *frame,
+					     const FLAC__int32 *const buf[]);
+
+	static FLAC__StreamDecoderWriteStatus
+	WriteCallback(gcc_unused const FLAC__StreamDecoder *flac_dec,
+		      const FLAC__Frame *frame,
+		      const FLAC__int32 *const buf[], void *ctx) {
+		FlacParallelWorker &worker = *(FlacParallelWorker *)ctx;
+		return worker.Write(frame, buf);
+	}
+
+	static void
+	ErrorCallback(gcc_unused const FLAC__StreamDecoder *flac_dec,
+		      FLAC__StreamDecoderErrorStatus status,
+		      gcc_unused void *ctx) {
+		LogWarning(flac_domain,
+			   FLAC__StreamDecoderErrorStatusString[status]);
+	}
+};
+
+class FlacParallelDecoder {
+	friend class FlacParallelWorker;
+
+	flac_data &data;
+
+	const FLAC__uint64 total_frames;
+
+	/**
+	 * The number of frames in each segment.
+	 */
+	const unsigned segment_frames;
+
+	const FLAC__uint64 n_segments;
+
+	/**
+	 * Protects #segments, #next_queue and #quit.
+	 */
+	Mutex mutex;
+
+	/**
+	 * Broadcast whenever the state of a segment changes.
+	 */
+	Cond cond;
+
+	FlacSegment segments[2 * MAX_FLAC_THREADS];
+	unsigned n_slots;
+
+	/**
+	 * The number of the next segment to be queued.
+	 */
+	FLAC__uint64 next_queue;
+
+	bool quit;
+
+	FlacParallelWorker *workers[MAX_FLAC_THREADS];
+	unsigned n_workers;
+
+	/**
+	 * The number of workers whose thread has been started.
+	 */
+	unsigned n_running;
+
+public:
+	FlacParallelDecoder(flac_data &_data, unsigned _segment_frames)
+		:data(_data), total_frames(data.total_frames),
+		 segment_frames(_segment_frames),
+		 n_segments((total_frames + segment_frames - 1)
+			    / segment_frames),
+		 n_slots(0), next_queue(0), quit(false), n_workers(0), n_running(0) {}
+
+	~FlacParallelDecoder() {
+		for (unsigned i = 0; i < n_workers; ++i)
+			delete workers[i];
+	}
+
+	bool Start(const char *path, unsigned n_threads);
+	void Run();
+
+private:
+	void StopWorkers();
+
+	/**
+	 * Queue segments into all empty slots.  Caller must lock the
+	 * mutex.
+	 */
+	void FillSlots();
+
+	/**
+	 * Discard all queued and decoded segments, and continue at
+	 * the specified segment.
+	 */
+	void Restart(FLAC__uint64 first_segment);
+
+	/**
+	 * Caller must lock the mutex.
+	 */
+	FlacSegment *FindQueued();
+
+	/**
+	 * Wait until the specified segment has been decoded.  Caller
+	 * must lock the mutex.
+	 */
+	FlacSegment &WaitSegment(FLAC__uint64 number);
+};
+
+bool
+FlacParallelWorker::Open(const char *path)
+{
+	assert(flac_dec == nullptr);
+
+	flac_dec = FLAC__stream_decoder_new();
+	if (flac_dec == nullptr)
+		return false;
+
+	FLAC__StreamDecoderInitStatus status =
+		FLAC__stream_decoder_init_file(flac_dec, path,
+					       WriteCallback, nullptr,
+					       ErrorCallback, this);
+	if (status != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+		LogWarning(flac_domain,
+			   FLAC__StreamDecoderInitStatusString[status]);
+		return false;
+	}
+
+	if (!FLAC__stream_decoder_process_until_end_of_metadata(flac_dec))
+		return false;
+
+	next_sample = 0;
+	return true;
+}
+
+FLAC__StreamDecoderWriteStatus
+FlacParallelWorker::Write(const FLAC__Frame *frame,
+			  const FLAC__int32 *const buf[])
+{
+	assert(frame->header.number_type ==
+	       FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER);
+
+	const flac_data &data = parent.data;
+
+	const FLAC__uint64 frame_start = frame->header.number.sample_number;
+	const FLAC__uint64 frame_end = frame_start + frame->header.blocksize;
+	next_sample = frame_end;
+
+	if (frame->header.channels != data.audio_format.channels)
+		/* we don't support audio format changes */
+		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+
+	/* copy only the part of this frame which belongs to the
+	   segment */
+	const FLAC__uint64 from = std::max(frame_start, start);
+	const FLAC__uint64 to = std::min(frame_end, end);
+	if (from < to) {
+		flac_convert(dest + (from - start) * data.frame_size,
+			     frame->header.channels,
+			     data.audio_format.format, buf,
+			     from - frame_start, to - frame_start);
+		position = to;
+	}
+
+	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+bool
+FlacParallelWorker::Decode(FlacSegment &segment, FLAC__uint64 number)
+{
+	const flac_data &data = parent.data;
+
+	start = number * parent.segment_frames;
+	end = std::min(start + parent.segment_frames, parent.total_frames);
+	position = start;
+	dest = (uint8_t *)segment.buffer.Get((end - start) * data.frame_size);
+
+	if (next_sample != start &&
+	    !FLAC__stream_decoder_seek_absolute(flac_dec, start)) {
+		/* the decoder must be flushed after a seek error */
+		FLAC__stream_decoder_flush(flac_dec);
+		next_sample = ~FLAC__uint64(0);
+		return false;
+	}
+
+	while (position < end) {
+		if (!FLAC__stream_decoder_process_single(flac_dec)) {
+			FLAC__stream_decoder_flush(flac_dec);
+			next_sample = ~FLAC__uint64(0);
+			return false;
+		}
+
+		if (FLAC__stream_decoder_get_state(flac_dec) ==
+		    FLAC__STREAM_DECODER_END_OF_STREAM)
+			break;
+	}
+
+	segment.data = dest;
+	segment.size = (position - start) * data.frame_size;
+	return true;
+}
+
+void
+FlacParallelWorker::Run()
+{
+	SetThreadName("flac");
+
+	const ScopeLock protect(parent.mutex);
+
+	while (!parent.quit) {
+		FlacSegment *segment = parent.FindQueued();
+		if (segment == nullptr) {
+			parent.cond.wait(parent.mutex);
+			continue;
+		}
+
+		segment->state = FlacSegment::State::BUSY;
+		const FLAC__uint64 number = segment->number;
+
+		parent.mutex.unlock();
+		const bool success = Decode(*segment, number);
+		parent.mutex.lock();
+
+		segment->state = success
+			? FlacSegment::State::DONE
+			: FlacSegment::State::FAILED;
+		parent.cond.broadcast();
+	}
+}
+
+bool
+FlacParallelDecoder::Start(const char *path, unsigned n_threads)
+{
+	assert(n_workers == 0);
+
+	n_slots = 2 * n_threads;
+
+	for (unsigned i = 0; i < n_threads; ++i) {
+		FlacParallelWorker *worker = new FlacParallelWorker(*this);
+		if (!worker->Open(path)) {
+			delete worker;
+			return false;
+		}
+
+		workers[n_workers++] = worker;
+	}
+
+	mutex.lock();
+	FillSlots();
+	mutex.unlock();
+
+	for (unsigned i = 0; i < n_workers; ++i) {
+		Error error;
+		if (!workers[i]->Start(error)) {
+			LogError(error);
+			StopWorkers();
+			return false;
+		}
+
+		++n_running;
+	}
+
+	return true;
+}
+
+void
+FlacParallelDecoder::StopWorkers()
+{
+	mutex.lock();
+	quit = true;
+	cond.broadcast();
+	mutex.unlock();
+
+	for (unsigned i = 0; i < n_running; ++i)
+		workers[i]->Join();
+	n_running = 0;
+}
+
+void
+FlacParallelDecoder::FillSlots()
+{
+	for (unsigned i = 0; i < n_slots && next_queue < n_segments; ++i) {
+		FlacSegment &segment = segments[i];
+		if (segment.state == FlacSegment::State::EMPTY) {
+			segment.state = FlacSegment::State::QUEUED;
+			segment.number = next_queue++;
+		}
+	}
+
+	cond.broadcast();
+}
+
+FlacSegment *
+FlacParallelDecoder::FindQueued()
+{
+	FlacSegment *result = nullptr;
+
+	for (unsigned i = 0; i < n_slots; ++i) {
+		FlacSegment &segment = segments[i];
+		if (segment.state == FlacSegment::State::QUEUED &&
+		    (result == nullptr || segment.number < result->number))
+			result = &segment;
+	}
+
+	return result;
+}
+
+FlacSegment &
+FlacParallelDecoder::WaitSegment(FLAC__uint64 number)
+{
+	while (true) {
+		for (unsigned i = 0; i < n_slots; ++i) {
+			FlacSegment &segment = segments[i];
+			if (segment.number == number &&
+			    (segment.state == FlacSegment::State::DONE ||
+			     segment.state == FlacSegment::State::FAILED))
+				return segment;
+		}
+
+		cond.wait(mutex);
+	}
+}
+
+void
+FlacParallelDecoder::Restart(FLAC__uint64 first_segment)
+{
+	const ScopeLock protect(mutex);
+
+	for (unsigned i = 0; i < n_slots; ++i) {
+		FlacSegment &segment = segments[i];
+
+		/* segments being decoded right now cannot be
+		   aborted; wait for them */
+		while (segment.state == FlacSegment::State::BUSY)
+			cond.wait(mutex);
+
+		segment.state = FlacSegment::State::EMPTY;
+	}
+
+	next_queue = first_segment;
+	FillSlots();
+}
+
+void
+FlacParallelDecoder::Run()
+{
+	Decoder &decoder = data.decoder;
+	InputStream &is = data.input_stream;
+
+	unsigned kbit_rate = 0;
+	if (is.KnownSize())
+		kbit_rate = is.GetSize() * 8 * data.audio_format.sample_rate
+			/ (total_frames * 1000);
+
+	/* the segment which is going to be submitted next, and the
+	   number of bytes to be skipped after a seek */
+	FLAC__uint64 current = 0;
+	size_t skip = 0;
+
+	while (true) {
+		DecoderCommand cmd;
+		if (!data.tag.IsEmpty()) {
+			cmd = decoder_tag(decoder, is, std::move(data.tag));
+			data.tag.Clear();
+		} else
+			cmd = decoder_get_command(decoder);
+
+		if (cmd == DecoderCommand::SEEK) {
+			FLAC__uint64 seek_sample =
+				decoder_seek_where_frame(decoder);
+			if (seek_sample < total_frames) {
+				current = seek_sample / segment_frames;
+				skip = (seek_sample % segment_frames)
+					* data.frame_size;
+				Restart(current);
+				decoder_command_finished(decoder);
+			} else
+				decoder_seek_error(decoder);
+		} else if (cmd == DecoderCommand::STOP)
+			break;
+
+		if (current >= n_segments)
+			/* end of file */
+			break;
+
+		mutex.lock();
+		FlacSegment &segment = WaitSegment(current);
+		mutex.unlock();
+
+		if (segment.state == FlacSegment::State::FAILED) {
+			LogWarning(flac_domain, "failed to decode FLAC frame");
+			break;
+		}
+
+		/* the worker threads don't touch finished segments,
+		   so this doesn't need the lock */
+		if (skip < segment.size)
+			cmd = decoder_data(decoder, is,
+					   segment.data + skip,
+					   segment.size - skip,
+					   kbit_rate);
+		skip = 0;
+
+		mutex.lock();
+		segment.state = FlacSegment::State::EMPTY;
+		FillSlots();
+		mutex.unlock();
+
+		++current;
+
+		if (cmd == DecoderCommand::STOP)
+			break;
+	}
+
+	StopWorkers();
+}
+
+bool
+flac_decode_parallel(flac_data &data, unsigned n_threads)
+{
+	assert(n_threads > 1);
+	assert(n_threads <= MAX_FLAC_THREADS);
+	assert(data.initialized);
+
+	InputStream &is = data.input_stream;
+	const char *path = is.GetURI();
+
+	/* the worker threads need to open the file by themselves,
+	   and they need to know where each segment begins */
+	if (!is.IsSeekable() || !PathTraitsFS::IsAbsolute(path) ||
+	    data.total_frames == 0 || data.max_blocksize == 0)
+		return false;
+
+	FlacParallelDecoder pd(data, data.max_blocksize * FLAC_SEGMENT_BLOCKS);
+	if (!pd.Start(path, n_threads))
+		return false;
+
+	FormatDebug(flac_domain, "decoding %s with %u threads",
+		    path, n_threads);
+
+	pd.Run();
+	return true;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_FLAC_PARALLEL_HXX
+#define MPD_FLAC_PARALLEL_HXX
+
+struct flac_data;
+
+/**
+ * The maximum number of worker threads for flac_decode_parallel().
+ */
+static constexpr unsigned MAX_FLAC_THREADS = 16;
+
+/**
+ * Decode a local FLAC file with several threads.  The file is split
+ * into segments on frame boundaries; each worker thread decodes one
+ * segment at a time with its own libFLAC decoder, and the decoder
+ * thread submits the segments in order.
+ *
+ * @param data a #flac_data object which has already received the
+ * STREAMINFO block (i.e. decoder_initialized() has been called)
+ * @param n_threads the number of worker threads
+ * @return false if this file cannot be decoded in parallel (e.g. it
+ * is not a seekable local file); the caller shall then use the
+ * regular decoder loop
+ */
+bool
+flac_decode_parallel(flac_data &data, unsigned n_threads);
+
+#endif
@@ -22,6 +22,7 @@
 #include "../DecoderAPI.hxx"
 #include "CheckAudioFormat.hxx"
 #include "fs/Path.hxx"
+#include "thread/Mutex.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "util/Macros.hxx"
@@ -34,6 +35,40 @@ static constexpr Domain fluidsynth_domain("fluidsynth");
 static unsigned sample_rate;
 static const char *soundfont_path;
 
+/**
+ * A synthesizer with the sound font loaded.  Loading a large sound
+ * font takes several seconds, so the engine is reset and kept for
+ * the next song instead of being rebuilt.
+ */
+struct FluidsynthEngine {
+	fluid_settings_t *settings;
+	fluid_synth_t *synth;
+
+	FluidsynthEngine():settings(nullptr), synth(nullptr) {}
+
+	~FluidsynthEngine() {
+		if (synth != nullptr)
+			delete_fluid_synth(synth);
+		if (settings != nullptr)
+			delete_fluid_settings(settings);
+	}
+
+	FluidsynthEngine(const FluidsynthEngine &) = delete;
+	FluidsynthEngine &operator=(const FluidsynthEngine &) = delete;
+
+	bool Open();
+};
+
+/**
+ * Protects #fluidsynth_idle.
+ */
+static Mutex fluidsynth_mutex;
+
+/**
+ * An engine which is not being used by a decoder right now.
+ */
+static FluidsynthEngine *fluidsynth_idle;
+
 /**
  * Convert a fluidsynth log level to a GLib log level.
  */
@@ -93,23 +128,26 @@ fluidsynth_init(const config_param &param)
 }
 
 static void
-fluidsynth_file_decode(Decoder &decoder, Path path_fs)
+fluidsynth_finish()
+{
+	delete fluidsynth_idle;
+	fluidsynth_idle = nullptr;
+}
+
+bool
+FluidsynthEngine::Open()
 {
 	char setting_sample_rate[] = "synth.sample-rate";
 	/*
 	char setting_verbose[] = "synth.verbose";
 	char setting_yes[] = "yes";
 	*/
-	fluid_settings_t *settings;
-	fluid_synth_t *synth;
-	fluid_player_t *player;
-	int ret;
 
 	/* set up fluid settings */
 
 	settings = new_fluid_settings();
 	if (settings == nullptr)
-		return;
+		return false;
 
 	fluid_settings_setnum(settings, setting_sample_rate, sample_rate);
 
@@ -120,25 +158,81 @@ fluidsynth_file_decode(Decoder &decoder, Path path_fs)
 	/* create the fluid synth */
 
 	synth = new_fluid_synth(settings);
-	if (synth == nullptr) {
-		delete_fluid_settings(settings);
-		return;
-	}
+	if (synth == nullptr)
+		return false;
 
-	ret = fluid_synth_sfload(synth, soundfont_path, true);
+	int ret = fluid_synth_sfload(synth, soundfont_path, true);
 	if (ret < 0) {
 		LogWarning(fluidsynth_domain, "fluid_synth_sfload() failed");
-		delete_fluid_synth(synth);
-		delete_fluid_settings(settings);
-		return;
+		return false;
 	}
 
+	return true;
+}
+
+/**
+ * Obtain an engine, either the idle one or a new one.
+ *
+ * @return the engine or nullptr on error
+ */
+static FluidsynthEngine *
+fluidsynth_engine_acquire()
+{
+	{
+		const ScopeLock protect(fluidsynth_mutex);
+		FluidsynthEngine *engine = fluidsynth_idle;
+		fluidsynth_idle = nullptr;
+		if (engine != nullptr)
+			return engine;
+	}
+
+	FluidsynthEngine *engine = new FluidsynthEngine();
+	if (!engine->Open()) {
+		delete engine;
+		return nullptr;
+	}
+
+	return engine;
+}
+
+/**
+ * Reset the engine and keep it for the next song.
+ */
+static void
+fluidsynth_engine_release(FluidsynthEngine *engine)
+{
+	/* turn off all notes and restore the default programs and
+	   controllers, but keep the sound font */
+	fluid_synth_system_reset(engine->synth);
+
+	{
+		const ScopeLock protect(fluidsynth_mutex);
+		if (fluidsynth_idle == nullptr) {
+			fluidsynth_idle = engine;
+			return;
+		}
+	}
+
+	delete engine;
+}
+
+static void
+fluidsynth_file_decode(Decoder &decoder, Path path_fs)
+{
+	fluid_player_t *player;
+	int ret;
+
+	FluidsynthEngine *engine = fluidsynth_engine_acquire();
+	if (engine == nullptr)
+		return;
+
+	fluid_synth_t *const synth = engine->synth;
+
 	/* create the fluid player */
 
 	player = new_fluid_player(synth);
 	if (player == nullptr) {
-		delete_fluid_synth(synth);
-		delete_fluid_settings(settings);
+		fluidsynth_engine_release(engine);
 		return;
 	}
 
@@ -146,8 +240,7 @@ fluidsynth_file_decode(Decoder &decoder, Path path_fs)
 	if (ret != 0) {
 		LogWarning(fluidsynth_domain, "fluid_player_add() failed");
 		delete_fluid_player(player);
-		delete_fluid_synth(synth);
-		delete_fluid_settings(settings);
+		fluidsynth_engine_release(engine);
 		return;
 	}
 
@@ -157,8 +250,7 @@ fluidsynth_file_decode(Decoder &decoder, Path path_fs)
 	if (ret != 0) {
 		LogWarning(fluidsynth_domain, "fluid_player_play() failed");
 		delete_fluid_player(player);
-		delete_fluid_synth(synth);
-		delete_fluid_settings(settings);
+		fluidsynth_engine_release(engine);
 		return;
 	}
 
@@ -194,8 +286,7 @@ fluidsynth_file_decode(Decoder &decoder, Path path_fs)
 	fluid_player_join(player);
 
 	delete_fluid_player(player);
-	delete_fluid_synth(synth);
-	delete_fluid_settings(settings);
+	fluidsynth_engine_release(engine);
 }
 
 static bool
@@ -214,7 +305,7 @@ static const char *const fluidsynth_suffixes[] = {
 const struct DecoderPlugin fluidsynth_decoder_plugin = {
 	"fluidsynth",
 	fluidsynth_init,
-	nullptr,
+	fluidsynth_finish,
 	nullptr,
 	fluidsynth_file_decode,
 	fluidsynth_scan_file,
@@ -22,9 +22,10 @@
 #include "../DecoderAPI.hxx"
 #include "CheckAudioFormat.hxx"
 #include "tag/TagHandler.hxx"
+#include "tag/TagBuilder.hxx"
+#include "DetachedSong.hxx"
 #include "fs/Path.hxx"
 #include "util/Alloc.hxx"
-#include "util/FormatString.hxx"
 #include "util/UriUtil.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
@@ -108,31 +109,6 @@ get_song_num(Path path_fs)
 	}
 }
 
-static char *
-gme_container_scan(Path path_fs, const unsigned int tnum)
-{
-	Music_Emu *emu;
-	const char *gme_err = gme_open_file(path_fs.c_str(), &emu,
-					    GME_SAMPLE_RATE);
-	if (gme_err != nullptr) {
-		LogWarning(gme_domain, gme_err);
-		return nullptr;
-	}
-
-	const unsigned num_songs = gme_track_count(emu);
-	gme_delete(emu);
-	/* if it only contains a single tune, don't treat as container */
-	if (num_songs < 2)
-		return nullptr;
-
-	const char *subtune_suffix = uri_get_suffix(path_fs.c_str());
-	if (tnum <= num_songs){
-		return FormatNew(SUBTUNE_PREFIX "%03u.%s",
-				 tnum, subtune_suffix);
-	} else
-		return nullptr;
-}
-
 static void
 gme_file_decode(Decoder &decoder, Path path_fs)
 {
@@ -209,6 +185,46 @@ gme_file_decode(Decoder &decoder, Path path_fs)
 	gme_delete(emu);
 }
 
+static void
+ScanGmeInfo(const gme_info_t &info, int song_num, int track_count,
+	    const struct tag_handler *handler, void *handler_ctx)
+{
+	if (info.length > 0)
+		tag_handler_invoke_duration(handler, handler_ctx,
+					    info.length / 100);
+
+	if (info.song != nullptr) {
+		if (track_count > 1) {
+			/* start numbering subtunes from 1 */
+			char tag_title[1024];
+			snprintf(tag_title, sizeof(tag_title),
+				 "%s (%d/%d)",
+				 info.song, song_num + 1,
+				 track_count);
+			tag_handler_invoke_tag(handler, handler_ctx,
+					       TAG_TITLE, tag_title);
+		} else
+			tag_handler_invoke_tag(handler, handler_ctx,
+					       TAG_TITLE, info.song);
+	}
+
+	if (info.author != nullptr)
+		tag_handler_invoke_tag(handler, handler_ctx,
+				       TAG_ARTIST, info.author);
+
+	if (info.game != nullptr)
+		tag_handler_invoke_tag(handler, handler_ctx,
+				       TAG_ALBUM, info.game);
+
+	if (info.comment != nullptr)
+		tag_handler_invoke_tag(handler, handler_ctx,
+				       TAG_COMMENT, info.comment);
+
+	if (info.copyright != nullptr)
+		tag_handler_invoke_tag(handler, handler_ctx,
+				       TAG_DATE, info.copyright);
+}
+
 static bool
 gme_scan_file(Path path_fs,
 	      const struct tag_handler *handler, void *handler_ctx)
@@ -236,45 +252,59 @@ gme_scan_file(Path path_fs,
 
 	assert(ti != nullptr);
 
-	if (ti->length > 0)
-		tag_handler_invoke_duration(handler, handler_ctx,
-					    ti->length / 100);
+	ScanGmeInfo(*ti, song_num, gme_track_count(emu),
+		    handler, handler_ctx);
 
-	if (ti->song != nullptr) {
-		if (gme_track_count(emu) > 1) {
-			/* start numbering subtunes from 1 */
-			char tag_title[1024];
-			snprintf(tag_title, sizeof(tag_title),
-				 "%s (%d/%d)",
-				 ti->song, song_num + 1,
-				 gme_track_count(emu));
-			tag_handler_invoke_tag(handler, handler_ctx,
-					       TAG_TITLE, tag_title);
-		} else
-			tag_handler_invoke_tag(handler, handler_ctx,
-					       TAG_TITLE, ti->song);
+	gme_free_info(ti);
+	gme_delete(emu);
+
+	return true;
+}
+
+static std::forward_list<DetachedSong>
+gme_container_scan(Path path_fs)
+{
+	std::forward_list<DetachedSong> list;
+
+	Music_Emu *emu;
+	const char *gme_err = gme_open_file(path_fs.c_str(), &emu,
+					    GME_SAMPLE_RATE);
+	if (gme_err != nullptr) {
+		LogWarning(gme_domain, gme_err);
+		return list;
 	}
 
-	if (ti->author != nullptr)
-		tag_handler_invoke_tag(handler, handler_ctx,
-				       TAG_ARTIST, ti->author);
+	const unsigned num_songs = gme_track_count(emu);
+	/* if it only contains a single tune, don't treat as container */
+	if (num_songs < 2) {
+		gme_delete(emu);
+		return list;
+	}
 
-	if (ti->game != nullptr)
-		tag_handler_invoke_tag(handler, handler_ctx,
-				       TAG_ALBUM, ti->game);
+	const char *subtune_suffix = uri_get_suffix(path_fs.c_str());
 
-	if (ti->comment != nullptr)
-		tag_handler_invoke_tag(handler, handler_ctx,
-				       TAG_COMMENT, ti->comment);
+	TagBuilder tag_builder;
 
-	if (ti->copyright != nullptr)
-		tag_handler_invoke_tag(handler, handler_ctx,
-				       TAG_DATE, ti->copyright);
+	auto tail = list.before_begin();
+	for (unsigned i = 0; i < num_songs; ++i) {
+		gme_info_t *ti;
+		gme_err = gme_track_info(emu, &ti, i);
+		if (gme_err == nullptr) {
+			ScanGmeInfo(*ti, i, num_songs,
+				    &add_tag_handler, &tag_builder);
+			gme_free_info(ti);
+		} else
+			LogWarning(gme_domain, gme_err);
 
-	gme_free_info(ti);
-	gme_delete(emu);
+		char track_name[64];
+		snprintf(track_name, sizeof(track_name),
+			 SUBTUNE_PREFIX "%03u.%s", i + 1, subtune_suffix);
+		tail = list.emplace_after(tail, track_name,
+					  tag_builder.Commit());
+	}
 
-	return true;
+	gme_delete(emu);
+	return list;
 }
 
 static const char *const gme_suffixes[] = {
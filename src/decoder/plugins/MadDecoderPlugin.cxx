@@ -20,6 +20,7 @@
 #include "config.h"
 #include "MadDecoderPlugin.hxx"
 #include "../DecoderAPI.hxx"
+#include "../SeekIndex.hxx"
 #include "input/InputStream.hxx"
 #include "config/ConfigGlobal.hxx"
 #include "tag/TagId3.hxx"
@@ -38,6 +39,14 @@
 #include <id3tag.h>
 #endif
 
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -87,12 +96,94 @@ mad_fixed_to_24_sample(mad_fixed_t sample)
 	return sample >> (MAD_F_FRACBITS + 1 - bits);
 }
 
+#ifdef __ARM_NEON__
+
+/**
+ * Like mad_fixed_to_24_sample(), but converts four samples at a time.
+ */
+static inline int32x4_t
+mad_fixed_to_24_neon(const mad_fixed_t *src)
+{
+	int32x4_t v = vaddq_s32(vld1q_s32(src),
+				vdupq_n_s32(1L << (MAD_F_FRACBITS - 24)));
+	v = vminq_s32(vmaxq_s32(v, vdupq_n_s32(-MAD_F_ONE)),
+		      vdupq_n_s32(MAD_F_ONE - 1));
+	return vshrq_n_s32(v, MAD_F_FRACBITS + 1 - 24);
+}
+
+#elif defined(__SSE2__)
+
+/**
+ * Like mad_fixed_to_24_sample(), but converts four samples at a
+ * time.  SSE2 has no 32 bit minimum/maximum instructions, so
+ * clipping is done with comparison masks.
+ */
+static inline __m128i
+mad_fixed_to_24_sse2(const mad_fixed_t *src)
+{
+	const __m128i min = _mm_set1_epi32(-MAD_F_ONE);
+	const __m128i max = _mm_set1_epi32(MAD_F_ONE - 1);
+
+	__m128i v = _mm_add_epi32(_mm_loadu_si128((const __m128i *)src),
+				  _mm_set1_epi32(1L << (MAD_F_FRACBITS - 24)));
+
+	const __m128i above = _mm_cmpgt_epi32(v, max);
+	v = _mm_or_si128(_mm_and_si128(above, max),
+			 _mm_andnot_si128(above, v));
+
+	const __m128i below = _mm_cmplt_epi32(v, min);
+	v = _mm_or_si128(_mm_and_si128(below, min),
+			 _mm_andnot_si128(below, v));
+
+	return _mm_srai_epi32(v, MAD_F_FRACBITS + 1 - 24);
+}
+
+#endif
+
 static void
 mad_fixed_to_24_buffer(int32_t *dest, const struct mad_synth *synth,
 		       unsigned int start, unsigned int end,
 		       unsigned int num_channels)
 {
-	for (unsigned i = start; i < end; ++i)
+	unsigned i = start;
+
+	const mad_fixed_t *const left = synth->pcm.samples[0];
+	const mad_fixed_t *const right = synth->pcm.samples[1];
+
+#ifdef __ARM_NEON__
+	if (num_channels == 2) {
+		for (; i + 4 <= end; i += 4, dest += 8) {
+			int32x4x2_t v;
+			v.val[0] = mad_fixed_to_24_neon(left + i);
+			v.val[1] = mad_fixed_to_24_neon(right + i);
+			vst2q_s32(dest, v);
+		}
+	} else if (num_channels == 1) {
+		for (; i + 4 <= end; i += 4, dest += 4)
+			vst1q_s32(dest, mad_fixed_to_24_neon(left + i));
+	}
+#elif defined(__SSE2__)
+	if (num_channels == 2) {
+		/* interleave the two channels while storing */
+		for (; i + 4 <= end; i += 4, dest += 8) {
+			const __m128i l = mad_fixed_to_24_sse2(left + i);
+			const __m128i r = mad_fixed_to_24_sse2(right + i);
+			_mm_storeu_si128((__m128i *)dest,
+					 _mm_unpacklo_epi32(l, r));
+			_mm_storeu_si128((__m128i *)(dest + 4),
+					 _mm_unpackhi_epi32(l, r));
+		}
+	} else if (num_channels == 1) {
+		for (; i + 4 <= end; i += 4, dest += 4)
+			_mm_storeu_si128((__m128i *)dest,
+					 mad_fixed_to_24_sse2(left + i));
+	}
+#else
+	(void)right;
+#endif
+
+	/* the portable code converts the trailing samples */
+	for (; i < end; ++i)
 		for (unsigned c = 0; c < num_channels; ++c)
 			*dest++ = mad_fixed_to_24_sample(synth->pcm.samples[c][i]);
 }
@@ -107,7 +198,12 @@ mp3_plugin_init(gcc_unused const config_param &param)
 
 struct MadDecoder {
 	static constexpr size_t READ_BUFFER_SIZE = 40960;
-	static constexpr size_t MP3_DATA_OUTPUT_BUFFER_SIZE = 2048;
+
+	/**
+	 * The size of #output_buffer (in samples); it holds the PCM
+	 * data of four stereo MPEG frames.
+	 */
+	static constexpr size_t MP3_DATA_OUTPUT_BUFFER_SIZE = 4 * 1152 * 2;
 
 	struct mad_stream stream;
 	struct mad_frame frame;
@@ -115,6 +211,14 @@ struct MadDecoder {
 	mad_timer_t timer;
 	unsigned char input_buffer[READ_BUFFER_SIZE];
 	int32_t output_buffer[MP3_DATA_OUTPUT_BUFFER_SIZE];
+
+	/**
+	 * The number of PCM frames in #output_buffer which have not
+	 * yet been submitted to decoder_data().  It is only used if
+	 * the decoder API cannot provide a buffer inside the music
+	 * chunk (because the data needs to be converted).
+	 */
+	unsigned output_fill;
 	float total_time;
 	unsigned elapsed_time;
 	unsigned seek_where;
@@ -124,6 +228,15 @@ struct MadDecoder {
 	unsigned long highest_frame;
 	unsigned long max_frames;
 	unsigned long current_frame;
+
+	/**
+	 * Has the decoder jumped behind the end of #frame_offsets
+	 * with the help of the seek index?  Frames are not recorded
+	 * until it seeks back into the table; #current_frame is only
+	 * an estimate then.
+	 */
+	bool skipped_frames;
+
 	unsigned int drop_start_frames;
 	unsigned int drop_end_frames;
 	unsigned int drop_start_samples;
@@ -140,6 +253,20 @@ struct MadDecoder {
 	~MadDecoder();
 
 	bool Seek(long offset);
+
+	/**
+	 * Seek to a time behind the end of #frame_offsets: jump to a
+	 * point from the seek index (or back to the end of the
+	 * table), and then decode muted frames until that time is
+	 * reached.
+	 */
+	bool SeekBeyondTable(unsigned t);
+
+	/**
+	 * Submit the contents of #frame_offsets to the seek index.
+	 */
+	void CommitSeekIndex() const;
+
 	bool FillBuffer();
 	void ParseId3(size_t tagsize, Tag **mpd_tag);
 	enum mp3_action DecodeNextFrameHeader(Tag **tag);
@@ -164,10 +291,16 @@ struct MadDecoder {
 	void UpdateTimerNextFrame();
 
 	/**
-	 * Sends the synthesized current frame via decoder_data().
+	 * Sends the synthesized current frame, either directly into
+	 * the music chunk, or by appending it to #output_buffer.
 	 */
 	DecoderCommand SendPCM(unsigned i, unsigned pcm_length);
 
+	/**
+	 * Submit the contents of #output_buffer via decoder_data().
+	 */
+	DecoderCommand FlushPCM();
+
 	/**
 	 * Synthesize the current frame and send it via
 	 * decoder_data().
@@ -179,10 +312,12 @@ struct MadDecoder {
 
 MadDecoder::MadDecoder(Decoder *_decoder,
 		       InputStream &_input_stream)
-	:mute_frame(MUTEFRAME_NONE),
+	:output_fill(0),
+	 mute_frame(MUTEFRAME_NONE),
 	 frame_offsets(nullptr),
 	 times(nullptr),
 	 highest_frame(0), max_frames(0), current_frame(0),
+	 skipped_frames(false),
 	 drop_start_frames(0), drop_end_frames(0),
 	 drop_start_samples(0), drop_end_samples(0),
 	 found_replay_gain(false),
@@ -210,6 +345,66 @@ MadDecoder::Seek(long offset)
 	return true;
 }
 
+bool
+MadDecoder::SeekBeyondTable(unsigned t)
+{
+	SeekPoint point;
+	if (input_stream.KnownSize() &&
+	    seek_index_lookup(input_stream.GetURI(), input_stream.GetSize(),
+			      t, point) &&
+	    (point.time_ms > elapsed_time || t < elapsed_time)) {
+		if (!Seek(point.offset))
+			return false;
+
+		mad_timer_set(&timer, point.time_ms / 1000,
+			      point.time_ms % 1000, 1000);
+		elapsed_time = point.time_ms;
+		skipped_frames = true;
+
+		/* all frames have the same duration; keep counting
+		   them for the gapless code */
+		const uint64_t frame_samples = 32 * MAD_NSBSAMPLES(&frame.header);
+		current_frame = (uint64_t(point.time_ms) * frame.header.samplerate
+				 + 500 * frame_samples)
+			/ (1000 * frame_samples);
+	} else if (t < elapsed_time) {
+		/* we have jumped beyond the given time before; go
+		   back to the last frame we know */
+		assert(skipped_frames);
+		assert(highest_frame > 0);
+
+		if (!Seek(frame_offsets[highest_frame - 1]))
+			return false;
+
+		current_frame = highest_frame - 1;
+		skipped_frames = false;
+	}
+
+	seek_where = t;
+	mute_frame = MUTEFRAME_SEEK;
+	return true;
+}
+
+void
+MadDecoder::CommitSeekIndex() const
+{
+	if (!input_stream.IsSeekable() || !input_stream.KnownSize())
+		return;
+
+	/* the last slot is overwritten when the table is full */
+	const unsigned long n = std::min(highest_frame, max_frames - 1);
+
+	SeekIndexBuilder builder;
+	unsigned start_time = 0;
+	for (unsigned long i = 0; i < n; ++i) {
+		builder.Add(start_time, frame_offsets[i]);
+		start_time = mad_timer_count(times[i], MAD_UNITS_MILLISECONDS);
+	}
+
+	builder.Cover(start_time);
+	builder.Commit(input_stream.GetURI(), input_stream.GetSize());
+}
+
 inline bool
 MadDecoder::FillBuffer()
 {
@@ -820,8 +1015,12 @@ MadDecoder::DecodeFirstFrame(Tag **tag)
 		return false;
 	}
 
-	frame_offsets = new long[max_frames];
-	times = new mad_timer_t[max_frames];
+	if (decoder != nullptr) {
+		/* the frame table is only needed for decoding, not
+		   for mad_decoder_total_file_time() */
+		frame_offsets = new long[max_frames];
+		times = new mad_timer_t[max_frames];
+	}
 
 	return true;
 }
@@ -864,7 +1063,10 @@ MadDecoder::TimeToFrame(unsigned t) const
 void
 MadDecoder::UpdateTimerNextFrame()
 {
-	if (current_frame >= highest_frame) {
+	if (skipped_frames) {
+		bit_rate = frame.header.bitrate;
+		mad_timer_add(&timer, frame.header.duration);
+	} else if (current_frame >= highest_frame) {
 		/* record this frame's properties in frame_offsets
 		   (for seeking) and times */
 		bit_rate = frame.header.bitrate;
@@ -890,32 +1092,77 @@ MadDecoder::UpdateTimerNextFrame()
 DecoderCommand
 MadDecoder::SendPCM(unsigned i, unsigned pcm_length)
 {
-	unsigned max_samples = sizeof(output_buffer) /
-		sizeof(output_buffer[0]) /
-		MAD_NCHANNELS(&frame.header);
+	const unsigned channels = MAD_NCHANNELS(&frame.header);
+	const size_t frame_size = sizeof(output_buffer[0]) * channels;
+	const unsigned max_frames = sizeof(output_buffer) / frame_size;
 
 	while (i < pcm_length) {
-		unsigned int num_samples = pcm_length - i;
-		if (num_samples > max_samples)
-			num_samples = max_samples;
-
-		i += num_samples;
-
-		mad_fixed_to_24_buffer(output_buffer, &synth,
-				       i - num_samples, i,
-				       MAD_NCHANNELS(&frame.header));
-		num_samples *= MAD_NCHANNELS(&frame.header);
-
-		auto cmd = decoder_data(*decoder, input_stream, output_buffer,
-					sizeof(output_buffer[0]) * num_samples,
-					bit_rate / 1000);
-		if (cmd != DecoderCommand::NONE)
-			return cmd;
+		unsigned num_frames = pcm_length - i;
+		DecoderCommand cmd;
+
+		if (output_fill == 0) {
+			auto dest = decoder_data_begin(*decoder, input_stream,
+						       bit_rate / 1000);
+			if (!dest.IsNull()) {
+				/* convert straight into the music
+				   chunk */
+				num_frames = std::min<unsigned>(num_frames,
+								dest.size / frame_size);
+				mad_fixed_to_24_buffer((int32_t *)dest.data,
+						       &synth,
+						       i, i + num_frames,
+						       channels);
+				i += num_frames;
+
+				cmd = decoder_data_commit(*decoder,
+							  num_frames * frame_size);
+				if (cmd != DecoderCommand::NONE)
+					return cmd;
+
+				continue;
+			}
+
+			/* no buffer: either a command is pending, or
+			   the data needs to be converted */
+			cmd = decoder_get_command(*decoder);
+			if (cmd != DecoderCommand::NONE)
+				return cmd;
+		}
+
+		/* collect several MPEG frames in output_buffer, to
+		   submit (and convert) them with one decoder_data()
+		   call */
+		num_frames = std::min(num_frames, max_frames - output_fill);
+		mad_fixed_to_24_buffer(output_buffer + output_fill * channels,
+				       &synth, i, i + num_frames, channels);
+		i += num_frames;
+		output_fill += num_frames;
+
+		if (output_fill == max_frames) {
+			cmd = FlushPCM();
+			if (cmd != DecoderCommand::NONE)
+				return cmd;
+		}
 	}
 
 	return DecoderCommand::NONE;
 }
 
+DecoderCommand
+MadDecoder::FlushPCM()
+{
+	if (output_fill == 0)
+		return DecoderCommand::NONE;
+
+	const unsigned channels = MAD_NCHANNELS(&frame.header);
+	const size_t frame_size = sizeof(output_buffer[0]) * channels;
+	const size_t nbytes = output_fill * frame_size;
+	output_fill = 0;
+
+	return decoder_data(*decoder, input_stream, output_buffer, nbytes,
+			    bit_rate / 1000);
+}
+
 inline DecoderCommand
 MadDecoder::SyncAndSend()
 {
@@ -988,19 +1235,22 @@ MadDecoder::Read()
 		if (cmd == DecoderCommand::SEEK) {
 			assert(input_stream.IsSeekable());
 
-			unsigned long j =
-				TimeToFrame(decoder_seek_where_ms(*decoder));
+			/* discard PCM data from before the seek */
+			output_fill = 0;
+
+			const unsigned t = decoder_seek_where_ms(*decoder);
+			unsigned long j = TimeToFrame(t);
 			if (j < highest_frame) {
 				if (Seek(frame_offsets[j])) {
 					current_frame = j;
+					skipped_frames = false;
 					decoder_command_finished(*decoder);
 				} else
 					decoder_seek_error(*decoder);
-			} else {
-				seek_where = decoder_seek_where_ms(*decoder);
-				mute_frame = MUTEFRAME_SEEK;
+			} else if (SeekBeyondTable(t))
 				decoder_command_finished(*decoder);
-			}
+			else
+				decoder_seek_error(*decoder);
 		} else if (cmd != DecoderCommand::NONE)
 			return false;
 	}
@@ -1013,6 +1263,10 @@ MadDecoder::Read()
 			ret = DecodeNextFrameHeader(&tag);
 
 			if (tag != nullptr) {
+				/* the tag applies to the following
+				   PCM data */
+				FlushPCM();
+
 				decoder_tag(*decoder, input_stream,
 					    std::move(*tag));
 				delete tag;
@@ -1073,6 +1327,13 @@ mp3_decode(Decoder &decoder, InputStream &input_stream)
 	}
 
 	while (data.Read()) {}
+
+	/* submit the PCM data which is still in the buffer, unless
+	   the player has asked us to stop */
+	if (decoder_get_command(decoder) == DecoderCommand::NONE)
+		data.FlushPCM();
+
+	data.CommitSeekIndex();
 }
 
 static bool
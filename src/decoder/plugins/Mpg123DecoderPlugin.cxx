@@ -20,6 +20,7 @@
 #include "config.h" /* must be first for large file support */
 #include "Mpg123DecoderPlugin.hxx"
 #include "../DecoderAPI.hxx"
+#include "input/InputStream.hxx"
 #include "CheckAudioFormat.hxx"
 #include "tag/TagHandler.hxx"
 #include "fs/Path.hxx"
@@ -33,11 +34,47 @@
 
 static constexpr Domain mpg123_domain("mpg123");
 
+/**
+ * The output encodings we ask libmpg123 for, best first.  The
+ * floating point and 32 bit encodings preserve the precision of the
+ * decoder, which would otherwise be lost before the PCM conversion
+ * to the output format.
+ */
+static constexpr struct {
+	int encoding;
+	SampleFormat format;
+} mpg123_output_formats[] = {
+	{ MPG123_ENC_FLOAT_32, SampleFormat::FLOAT },
+	{ MPG123_ENC_SIGNED_32, SampleFormat::S32 },
+	{ MPG123_ENC_SIGNED_16, SampleFormat::S16 },
+};
+
+/**
+ * The best encoding (from #mpg123_output_formats) supported by this
+ * libmpg123 build.  Determined by mpd_mpg123_init().
+ */
+static int mpg123_output_encoding = MPG123_ENC_SIGNED_16;
+
 static bool
 mpd_mpg123_init(gcc_unused const config_param &param)
 {
 	mpg123_init();
 
+	const int *supported;
+	size_t n_supported;
+	mpg123_encodings(&supported, &n_supported);
+
+	for (const auto &i : mpg123_output_formats) {
+		bool found = false;
+		for (size_t j = 0; j < n_supported && !found; ++j)
+			found = supported[j] == i.encoding;
+
+		if (found) {
+			mpg123_output_encoding = i.encoding;
+			break;
+		}
+	}
+
 	return true;
 }
 
@@ -48,35 +85,51 @@ mpd_mpg123_finish(void)
 }
 
 /**
- * Opens a file with an existing #mpg123_handle.
+ * Creates a new #mpg123_handle which will decode to
+ * #mpg123_output_encoding.
+ *
+ * @return the new handle or nullptr on error
+ */
+static mpg123_handle *
+mpd_mpg123_new()
+{
+	int error;
+	mpg123_handle *handle = mpg123_new(nullptr, &error);
+	if (handle == nullptr) {
+		FormatError(mpg123_domain,
+			    "mpg123_new() failed: %s",
+			    mpg123_plain_strerror(error));
+		return nullptr;
+	}
+
+	/* the default would be 16 bit; allow only our preferred
+	   encoding, at all sample rates */
+	mpg123_format_none(handle);
+
+	const long *rates;
+	size_t n_rates;
+	mpg123_rates(&rates, &n_rates);
+	for (size_t i = 0; i < n_rates; ++i)
+		mpg123_format(handle, rates[i], MPG123_MONO|MPG123_STEREO,
+			      mpg123_output_encoding);
+
+	return handle;
+}
+
+/**
+ * Obtain the audio format of a stream which was just opened.
  *
- * @param handle a handle which was created before; on error, this
- * function will not free it
  * @param audio_format this parameter is filled after successful
  * return
  * @return true on success
  */
 static bool
-mpd_mpg123_open(mpg123_handle *handle, const char *path_fs,
-		AudioFormat &audio_format)
+mpd_mpg123_get_format(mpg123_handle *handle, AudioFormat &audio_format)
 {
 	int error;
 	int channels, encoding;
 	long rate;
 
-	/* mpg123_open() wants a writable string :-( */
-	char *const path2 = const_cast<char *>(path_fs);
-
-	error = mpg123_open(handle, path2);
-	if (error != MPG123_OK) {
-		FormatWarning(mpg123_domain,
-			      "libmpg123 failed to open %s: %s",
-			      path_fs, mpg123_plain_strerror(error));
-		return false;
-	}
-
-	/* obtain the audio format */
-
 	error = mpg123_getformat(handle, &rate, &channels, &encoding);
 	if (error != MPG123_OK) {
 		FormatWarning(mpg123_domain,
@@ -85,16 +138,19 @@ mpd_mpg123_open(mpg123_handle *handle, const char *path_fs,
 		return false;
 	}
 
-	if (encoding != MPG123_ENC_SIGNED_16) {
-		/* other formats not yet implemented */
+	SampleFormat format = SampleFormat::UNDEFINED;
+	for (const auto &i : mpg123_output_formats)
+		if (i.encoding == encoding)
+			format = i.format;
+
+	if (format == SampleFormat::UNDEFINED) {
 		FormatWarning(mpg123_domain,
-			      "expected MPG123_ENC_SIGNED_16, got %d",
-			      encoding);
+			      "unexpected encoding %d", encoding);
 		return false;
 	}
 
 	Error error2;
-	if (!audio_format_init_checked(audio_format, rate, SampleFormat::S16,
+	if (!audio_format_init_checked(audio_format, rate, format,
 				       channels, error2)) {
 		LogError(error2);
 		return false;
@@ -103,38 +159,133 @@ mpd_mpg123_open(mpg123_handle *handle, const char *path_fs,
 	return true;
 }
 
-static void
-mpd_mpg123_file_decode(Decoder &decoder, Path path_fs)
+/**
+ * Opens a file with an existing #mpg123_handle.
+ *
+ * @param handle a handle which was created before; on error, this
+ * function will not free it
+ * @param audio_format this parameter is filled after successful
+ * return
+ * @return true on success
+ */
+static bool
+mpd_mpg123_open(mpg123_handle *handle, const char *path_fs,
+		AudioFormat &audio_format)
 {
-	mpg123_handle *handle;
-	int error;
-	off_t num_samples;
-	struct mpg123_frameinfo info;
+	/* mpg123_open() wants a writable string :-( */
+	char *const path2 = const_cast<char *>(path_fs);
 
-	/* open the file */
+	int error = mpg123_open(handle, path2);
+	if (error != MPG123_OK) {
+		FormatWarning(mpg123_domain,
+			      "libmpg123 failed to open %s: %s",
+			      path_fs, mpg123_plain_strerror(error));
+		return false;
+	}
 
-	handle = mpg123_new(nullptr, &error);
-	if (handle == nullptr) {
-		FormatError(mpg123_domain,
-			    "mpg123_new() failed: %s",
-			    mpg123_plain_strerror(error));
-		return;
+	return mpd_mpg123_get_format(handle, audio_format);
+}
+
+/**
+ * The I/O handle which lets libmpg123 read from an #InputStream.
+ */
+struct Mpg123InputStream {
+	Decoder *const decoder;
+	InputStream &is;
+};
+
+static ssize_t
+mpd_mpg123_read(void *_handle, void *buffer, size_t size)
+{
+	Mpg123InputStream &mis = *(Mpg123InputStream *)_handle;
+
+	return decoder_read(mis.decoder, mis.is, buffer, size);
+}
+
+static off_t
+mpd_mpg123_lseek(void *_handle, off_t _offset, int whence)
+{
+	Mpg123InputStream &mis = *(Mpg123InputStream *)_handle;
+	InputStream &is = mis.is;
+
+	/* libmpg123 falls back to stream mode (no seeking, no
+	   ID3v1 lookup at the end) if this fails */
+	if (!is.IsSeekable())
+		return -1;
+
+	offset_type offset = _offset;
+	switch (whence) {
+	case SEEK_SET:
+		break;
+
+	case SEEK_CUR:
+		offset += is.GetOffset();
+		break;
+
+	case SEEK_END:
+		if (!is.KnownSize())
+			return -1;
+
+		offset += is.GetSize();
+		break;
+
+	default:
+		return -1;
 	}
 
-	AudioFormat audio_format;
-	if (!mpd_mpg123_open(handle, path_fs.c_str(), audio_format)) {
-		mpg123_delete(handle);
-		return;
+	Error error;
+	if (!is.LockSeek(offset, error)) {
+		LogError(error, "Seek failed");
+		return -1;
+	}
+
+	return is.GetOffset();
+}
+
+/**
+ * Opens an #InputStream with an existing #mpg123_handle.  The
+ * #Mpg123InputStream must remain valid until the handle is closed.
+ *
+ * @param audio_format this parameter is filled after successful
+ * return
+ * @return true on success
+ */
+static bool
+mpd_mpg123_open_stream(mpg123_handle *handle, Mpg123InputStream &mis,
+		       AudioFormat &audio_format)
+{
+	int error = mpg123_replace_reader_handle(handle, mpd_mpg123_read,
+						 mpd_mpg123_lseek, nullptr);
+	if (error == MPG123_OK)
+		error = mpg123_open_handle(handle, &mis);
+	if (error != MPG123_OK) {
+		FormatWarning(mpg123_domain,
+			      "libmpg123 failed to open %s: %s",
+			      mis.is.GetURI(), mpg123_plain_strerror(error));
+		return false;
 	}
 
-	num_samples = mpg123_length(handle);
+	return mpd_mpg123_get_format(handle, audio_format);
+}
+
+/**
+ * The decoder main loop, shared by file and stream decoding.
+ */
+static void
+mpd_mpg123_decode(Decoder &decoder, mpg123_handle *handle,
+		  const AudioFormat audio_format, bool seekable)
+{
+	const off_t num_samples = mpg123_length(handle);
 
 	/* tell MPD core we're ready */
 
-	decoder_initialized(decoder, audio_format, true,
-			    (float)num_samples /
-			    (float)audio_format.sample_rate);
+	decoder_initialized(decoder, audio_format, seekable,
+			    num_samples > 0
+			    ? (float)num_samples /
+			    (float)audio_format.sample_rate
+			    : -1);
 
+	struct mpg123_frameinfo info;
 	if (mpg123_info(handle, &info) != MPG123_OK) {
 		info.vbr = MPG123_CBR;
 		info.bitrate = 0;
@@ -159,26 +310,34 @@ mpd_mpg123_file_decode(Decoder &decoder, Path path_fs)
 
 		/* decode */
 
-		error = mpg123_read(handle, buffer, sizeof(buffer), &nbytes);
+		int error = mpg123_read(handle, buffer, sizeof(buffer),
+					&nbytes);
 		if (error != MPG123_OK) {
-			if (error != MPG123_DONE)
+			/* a pending command interrupts
+			   decoder_read(), which libmpg123 sees as
+			   the end of the stream */
+			cmd = decoder_get_command(decoder);
+			if (cmd == DecoderCommand::NONE &&
+			    error != MPG123_DONE)
 				FormatWarning(mpg123_domain,
 					      "mpg123_read() failed: %s",
 					      mpg123_plain_strerror(error));
-			break;
-		}
-
-		/* update bitrate for ABR/VBR */
-		if (info.vbr != MPG123_CBR) {
-			/* FIXME: maybe skip, as too expensive? */
-			/* FIXME: maybe, (info.vbr == MPG123_VBR) ? */
-			if (mpg123_info (handle, &info) != MPG123_OK)
-				info.bitrate = 0;
-		}
+			if (cmd != DecoderCommand::SEEK)
+				break;
+		} else {
+			/* update bitrate for ABR/VBR */
+			if (info.vbr != MPG123_CBR) {
+				/* FIXME: maybe skip, as too expensive? */
+				/* FIXME: maybe, (info.vbr == MPG123_VBR) ? */
+				if (mpg123_info (handle, &info) != MPG123_OK)
+					info.bitrate = 0;
+			}
 
-		/* send to MPD */
+			/* send to MPD */
 
-		cmd = decoder_data(decoder, nullptr, buffer, nbytes, info.bitrate);
+			cmd = decoder_data(decoder, nullptr, buffer, nbytes,
+					   info.bitrate);
+		}
 
 		if (cmd == DecoderCommand::SEEK) {
 			off_t c = decoder_seek_where_frame(decoder);
@@ -193,47 +352,93 @@ mpd_mpg123_file_decode(Decoder &decoder, Path path_fs)
 			cmd = DecoderCommand::NONE;
 		}
 	} while (cmd == DecoderCommand::NONE);
+}
+
+static void
+mpd_mpg123_file_decode(Decoder &decoder, Path path_fs)
+{
+	/* open the file */
+
+	mpg123_handle *const handle = mpd_mpg123_new();
+	if (handle == nullptr)
+		return;
+
+	AudioFormat audio_format;
+	if (mpd_mpg123_open(handle, path_fs.c_str(), audio_format))
+		mpd_mpg123_decode(decoder, handle, audio_format, true);
 
 	/* cleanup */
 
 	mpg123_delete(handle);
 }
 
+static void
+mpd_mpg123_stream_decode(Decoder &decoder, InputStream &is)
+{
+	mpg123_handle *const handle = mpd_mpg123_new();
+	if (handle == nullptr)
+		return;
+
+	Mpg123InputStream mis{&decoder, is};
+	AudioFormat audio_format;
+	if (mpd_mpg123_open_stream(handle, mis, audio_format))
+		mpd_mpg123_decode(decoder, handle, audio_format,
+				  is.IsSeekable());
+
+	mpg123_delete(handle);
+}
+
+/**
+ * Submit the duration of a file or stream which was just opened.
+ */
+static bool
+mpd_mpg123_scan(mpg123_handle *handle, const AudioFormat audio_format,
+		const struct tag_handler *handler, void *handler_ctx)
+{
+	const off_t num_samples = mpg123_length(handle);
+	if (num_samples <= 0)
+		return false;
+
+	/* ID3 tag support not yet implemented */
+
+	tag_handler_invoke_duration(handler, handler_ctx,
+				    num_samples / audio_format.sample_rate);
+	return true;
+}
+
 static bool
 mpd_mpg123_scan_file(Path path_fs,
 		     const struct tag_handler *handler, void *handler_ctx)
 {
-	mpg123_handle *handle;
-	int error;
-	off_t num_samples;
-
-	handle = mpg123_new(nullptr, &error);
-	if (handle == nullptr) {
-		FormatError(mpg123_domain,
-			    "mpg123_new() failed: %s",
-			    mpg123_plain_strerror(error));
+	mpg123_handle *const handle = mpd_mpg123_new();
+	if (handle == nullptr)
 		return false;
-	}
 
 	AudioFormat audio_format;
-	if (!mpd_mpg123_open(handle, path_fs.c_str(), audio_format)) {
-		mpg123_delete(handle);
-		return false;
-	}
+	const bool success =
+		mpd_mpg123_open(handle, path_fs.c_str(), audio_format) &&
+		mpd_mpg123_scan(handle, audio_format, handler, handler_ctx);
+
+	mpg123_delete(handle);
+	return success;
+}
 
-	num_samples = mpg123_length(handle);
-	if (num_samples <= 0) {
-		mpg123_delete(handle);
+static bool
+mpd_mpg123_scan_stream(InputStream &is,
+		       const struct tag_handler *handler, void *handler_ctx)
+{
+	mpg123_handle *const handle = mpd_mpg123_new();
+	if (handle == nullptr)
 		return false;
-	}
 
-	/* ID3 tag support not yet implemented */
+	Mpg123InputStream mis{nullptr, is};
+	AudioFormat audio_format;
+	const bool success =
+		mpd_mpg123_open_stream(handle, mis, audio_format) &&
+		mpd_mpg123_scan(handle, audio_format, handler, handler_ctx);
 
 	mpg123_delete(handle);
-
-	tag_handler_invoke_duration(handler, handler_ctx,
-				    num_samples / audio_format.sample_rate);
-	return true;
+	return success;
 }
 
 static const char *const mpg123_suffixes[] = {
@@ -241,16 +446,20 @@ static const char *const mpg123_suffixes[] = {
 	nullptr
 };
 
+static const char *const mpg123_mime_types[] = {
+	"audio/mpeg",
+	nullptr
+};
+
 const struct DecoderPlugin mpg123_decoder_plugin = {
 	"mpg123",
 	mpd_mpg123_init,
 	mpd_mpg123_finish,
-	/* streaming not yet implemented */
-	nullptr,
+	mpd_mpg123_stream_decode,
 	mpd_mpg123_file_decode,
 	mpd_mpg123_scan_file,
-	nullptr,
+	mpd_mpg123_scan_stream,
 	nullptr,
 	mpg123_suffixes,
-	nullptr,
+	mpg123_mime_types,
 };
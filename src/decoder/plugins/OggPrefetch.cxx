@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "OggPrefetch.hxx"
+#include "OggSyncState.hxx"
+#include "thread/Name.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <string.h>
+
+/**
+ * Stop reading ahead when this many bytes are queued.
+ */
+static constexpr size_t OGG_PREFETCH_BYTES = 256 * 1024;
+
+OggPrefetch::Page::Page(offset_type _offset, const ogg_page &page)
+	:offset(_offset), data(page.header_len + page.body_len),
+	 header_size(page.header_len)
+{
+	memcpy(&data[0], page.header, page.header_len);
+	memcpy(&data[header_size], page.body, page.body_len);
+}
+
+bool
+OggPrefetch::Start()
+{
+	assert(!IsStarted());
+	assert(queue.empty());
+
+	quit = false;
+	finished = false;
+
+	Error error;
+	if (!thread.Start(ThreadFunc, this, error)) {
+		finished = true;
+		LogError(error);
+		return false;
+	}
+
+	return true;
+}
+
+void
+OggPrefetch::Stop()
+{
+	if (!IsStarted())
+		return;
+
+	mutex.lock();
+	quit = true;
+	cond.broadcast();
+	mutex.unlock();
+
+	thread.Join();
+
+	queue.clear();
+	queued_bytes = 0;
+	current.clear();
+	current_position = 0;
+}
+
+inline bool
+OggPrefetch::PopCurrent()
+{
+	const ScopeLock protect(mutex);
+
+	while (queue.empty()) {
+		if (finished)
+			return false;
+
+		cond.wait(mutex);
+	}
+
+	Page &page = queue.front();
+	queued_bytes -= page.data.size();
+	current_offset = page.offset;
+	current_header_size = page.header_size;
+	current.swap(page.data);
+	current_position = 0;
+
+	queue.pop_front();
+	cond.broadcast();
+	return true;
+}
+
+bool
+OggPrefetch::Pop(ogg_page &page, offset_type &offset_r)
+{
+	if (!PopCurrent())
+		return false;
+
+	page.header = &current[0];
+	page.header_len = current_header_size;
+	page.body = &current[current_header_size];
+	page.body_len = current.size() - current_header_size;
+	offset_r = current_offset;
+	return true;
+}
+
+size_t
+OggPrefetch::Read(void *dest, size_t size)
+{
+	if (current_position >= current.size() && !PopCurrent())
+		return 0;
+
+	const size_t nbytes = std::min(size,
+				       current.size() - current_position);
+	memcpy(dest, &current[current_position], nbytes);
+	current_position += nbytes;
+	return nbytes;
+}
+
+void
+OggPrefetch::Run()
+{
+	SetThreadName("ogg");
+
+	mutex.lock();
+
+	while (!quit) {
+		if (queued_bytes >= OGG_PREFETCH_BYTES) {
+			cond.wait(mutex);
+			continue;
+		}
+
+		mutex.unlock();
+
+		const offset_type offset = oy.GetNextOffset();
+		ogg_page page;
+		const bool success = oy.ExpectPage(page);
+
+		mutex.lock();
+
+		if (!success)
+			break;
+
+		queue.emplace_back(offset, page);
+		queued_bytes += queue.back().data.size();
+		cond.broadcast();
+	}
+
+	finished = true;
+	cond.broadcast();
+	mutex.unlock();
+}
@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_OGG_PREFETCH_HXX
+#define MPD_OGG_PREFETCH_HXX
+
+#include "check.h"
+#include "input/Offset.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+
+#include <ogg/ogg.h>
+
+#include <list>
+#include <vector>
+
+#include <stddef.h>
+
+class OggSyncState;
+
+/**
+ * Reads Ogg pages from an #InputStream in a separate thread, so the
+ * decoder thread can decode one page while the following pages are
+ * being read and demultiplexed.
+ *
+ * While the thread is running, it owns the #OggSyncState and the
+ * #InputStream; the decoder thread must call Stop() before it seeks
+ * or reads by itself.  Stop() waits for the page being read; a
+ * blocking read is interrupted only by a decoder command.
+ */
+class OggPrefetch {
+	struct Page {
+		/**
+		 * The stream offset of this page.
+		 */
+		offset_type offset;
+
+		/**
+		 * The page header followed by the page body.
+		 */
+		std::vector<unsigned char> data;
+
+		size_t header_size;
+
+		Page(offset_type _offset, const ogg_page &page);
+	};
+
+	OggSyncState &oy;
+
+	/**
+	 * Protects #queue, #queued_bytes, #quit and #finished.
+	 */
+	Mutex mutex;
+
+	/**
+	 * Broadcast whenever a page has been queued or removed, and
+	 * when the thread finishes.
+	 */
+	Cond cond;
+
+	std::list<Page> queue;
+
+	/**
+	 * The total size of all pages in #queue.
+	 */
+	size_t queued_bytes;
+
+	bool quit;
+
+	/**
+	 * Has the thread stopped reading (end of stream, error or
+	 * decoder command)?
+	 */
+	bool finished;
+
+	/**
+	 * The page most recently returned to the decoder thread.
+	 */
+	std::vector<unsigned char> current;
+
+	/**
+	 * The stream offset of #current, the size of its header, and
+	 * the number of bytes consumed by Read().
+	 */
+	offset_type current_offset;
+	size_t current_header_size, current_position;
+
+	Thread thread;
+
+public:
+	explicit OggPrefetch(OggSyncState &_oy)
+		:oy(_oy), queued_bytes(0), quit(false), finished(true),
+		 current_offset(0), current_header_size(0),
+		 current_position(0) {}
+
+	~OggPrefetch() {
+		Stop();
+	}
+
+	OggPrefetch(const OggPrefetch &) = delete;
+	OggPrefetch &operator=(const OggPrefetch &) = delete;
+
+	bool IsStarted() const {
+		return thread.IsDefined();
+	}
+
+	/**
+	 * Start reading at the current position of the
+	 * #OggSyncState.  Logs an error on failure.
+	 */
+	bool Start();
+
+	/**
+	 * Stop the thread and discard all pages which have not been
+	 * consumed yet.  Does nothing if the thread is not running.
+	 */
+	void Stop();
+
+	/**
+	 * Return the next page.  Its buffers remain valid until the
+	 * next call.
+	 *
+	 * @param offset_r receives the stream offset of the page
+	 * @return false if there are no more pages, because the
+	 * thread has finished
+	 */
+	bool Pop(ogg_page &page, offset_type &offset_r);
+
+	/**
+	 * Copy raw page data, for a decoder library which
+	 * demultiplexes by itself.
+	 *
+	 * @return the number of bytes copied; 0 if the thread has
+	 * finished
+	 */
+	size_t Read(void *dest, size_t size);
+
+	/**
+	 * The stream offset of the next byte returned by Read().
+	 */
+	offset_type GetOffset() const {
+		return current_offset + current_position;
+	}
+
+private:
+	bool PopCurrent();
+
+	void Run();
+
+	static void ThreadFunc(void *ctx) {
+		OggPrefetch &prefetch = *(OggPrefetch *)ctx;
+		prefetch.Run();
+	}
+};
+
+#endif
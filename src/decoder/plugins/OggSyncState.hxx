@@ -22,6 +22,7 @@
 
 #include "check.h"
 #include "OggUtil.hxx"
+#include "input/InputStream.hxx"
 
 #include <ogg/ogg.h>
 
@@ -50,6 +51,16 @@ public:
 		ogg_sync_reset(&oy);
 	}
 
+	/**
+	 * Returns the stream offset of the data which has been
+	 * buffered, but not yet returned as a page.  This is where
+	 * the next page begins (unless the stream is out of sync).
+	 */
+	gcc_pure
+	offset_type GetNextOffset() const {
+		return is.GetOffset() - (oy.fill - oy.returned);
+	}
+
 	bool Feed(size_t size) {
 		return OggFeed(oy, decoder, is, size);
 	}
@@ -24,11 +24,14 @@
 #include "OpusTags.hxx"
 #include "OggFind.hxx"
 #include "OggSyncState.hxx"
+#include "OggPrefetch.hxx"
 #include "../DecoderAPI.hxx"
+#include "../SeekIndex.hxx"
 #include "OggCodec.hxx"
 #include "tag/TagHandler.hxx"
 #include "tag/TagBuilder.hxx"
 #include "input/InputStream.hxx"
+#include "config/ConfigData.hxx"
 #include "util/Error.hxx"
 #include "Log.hxx"
 
@@ -40,6 +43,11 @@
 
 static constexpr opus_int32 opus_sample_rate = 48000;
 
+/**
+ * Read the Ogg pages in a separate thread?
+ */
+static bool opus_prefetch;
+
 gcc_pure
 static bool
 IsOpusHead(const ogg_packet &packet)
@@ -55,10 +63,12 @@ IsOpusTags(const ogg_packet &packet)
 }
 
 static bool
-mpd_opus_init(gcc_unused const config_param &param)
+mpd_opus_init(const config_param &param)
 {
 	LogDebug(opus_domain, opus_get_version_string());
 
+	opus_prefetch = param.GetBlockValue("prefetch", false);
+
 	return true;
 }
 
@@ -79,19 +89,45 @@ class MPDOpusDecoder {
 
 	ogg_int64_t eos_granulepos;
 
+	/**
+	 * The granule position of the last page, i.e. the position
+	 * where the next page begins; -1 if unknown.
+	 */
+	ogg_int64_t page_granulepos;
+
 	size_t frame_size;
 
+	/**
+	 * Records the page offsets for the seek index.  It is
+	 * disabled after a seek leaves the range covered by it.
+	 */
+	SeekIndexBuilder seek_index;
+	bool seek_index_enabled;
+
 public:
 	MPDOpusDecoder(Decoder &_decoder,
 		       InputStream &_input_stream)
 		:decoder(_decoder), input_stream(_input_stream),
 		 opus_decoder(nullptr),
 		 output_buffer(nullptr), output_size(0),
-		 os_initialized(false), found_opus(false) {}
+		 os_initialized(false), found_opus(false),
+		 page_granulepos(-1),
+		 seek_index_enabled(input_stream.IsSeekable() &&
+				    input_stream.KnownSize()) {}
 	~MPDOpusDecoder();
 
+	/**
+	 * Has the OpusHead packet been parsed, i.e. is the decoder
+	 * ready for audio packets?
+	 */
+	bool IsOpen() const {
+		return opus_decoder != nullptr;
+	}
+
 	bool ReadFirstPage(OggSyncState &oy);
 	bool ReadNextPage(OggSyncState &oy);
+	bool ReadNextPage(OggPrefetch &prefetch);
+	void HandlePage(ogg_page &page, offset_type page_offset);
 
 	DecoderCommand HandlePackets();
 	DecoderCommand HandlePacket(const ogg_packet &packet);
@@ -100,8 +136,20 @@ public:
 	DecoderCommand HandleAudio(const ogg_packet &packet);
 
 	bool Seek(OggSyncState &oy, uint64_t where_frame);
+
+	void CommitSeekIndex() {
+		if (seek_index_enabled)
+			seek_index.Commit(input_stream.GetURI(),
+					  input_stream.GetSize());
+	}
 };
 
+static constexpr unsigned
+OpusGranuleToMS(ogg_int64_t granulepos)
+{
+	return granulepos * 1000 / opus_sample_rate;
+}
+
 MPDOpusDecoder::~MPDOpusDecoder()
 {
 	delete[] output_buffer;
@@ -125,20 +173,50 @@ MPDOpusDecoder::ReadFirstPage(OggSyncState &oy)
 	return true;
 }
 
+inline void
+MPDOpusDecoder::HandlePage(ogg_page &page, offset_type page_offset)
+{
+	assert(os_initialized);
+
+	const auto page_serialno = ogg_page_serialno(&page);
+	if (page_serialno != os.serialno)
+		ogg_stream_reset_serialno(&os, page_serialno);
+
+	if (seek_index_enabled && page_granulepos >= 0)
+		seek_index.Add(OpusGranuleToMS(page_granulepos), page_offset);
+
+	const ogg_int64_t granulepos = ogg_page_granulepos(&page);
+	if (granulepos >= 0) {
+		page_granulepos = granulepos;
+		if (seek_index_enabled)
+			seek_index.Cover(OpusGranuleToMS(granulepos));
+	}
+
+	ogg_stream_pagein(&os, &page);
+}
+
 inline bool
 MPDOpusDecoder::ReadNextPage(OggSyncState &oy)
 {
-	assert(os_initialized);
+	const offset_type page_offset = oy.GetNextOffset();
 
 	ogg_page page;
 	if (!oy.ExpectPage(page))
 		return false;
 
-	const auto page_serialno = ogg_page_serialno(&page);
-	if (page_serialno != os.serialno)
-		ogg_stream_reset_serialno(&os, page_serialno);
+	HandlePage(page, page_offset);
+	return true;
+}
 
-	ogg_stream_pagein(&os, &page);
+inline bool
+MPDOpusDecoder::ReadNextPage(OggPrefetch &prefetch)
+{
+	offset_type page_offset;
+	ogg_page page;
+	if (!prefetch.Pop(page, page_offset))
+		return false;
+
+	HandlePage(page, page_offset);
 	return true;
 }
 
@@ -335,12 +413,27 @@ MPDOpusDecoder::Seek(OggSyncState &oy, uint64_t where_frame)
 	assert(input_stream.KnownSize());
 
 	const ogg_int64_t where_granulepos(where_frame);
-
-	/* interpolate the file offset where we expect to find the
-	   given granule position */
-	/* TODO: implement binary search */
-	offset_type offset(where_granulepos * input_stream.GetSize()
-			   / eos_granulepos);
+	const unsigned where_ms = OpusGranuleToMS(where_granulepos);
+
+	/* the position of the next page is unknown after the
+	   seek */
+	page_granulepos = -1;
+
+	SeekPoint point;
+	offset_type offset;
+	if (seek_index.Lookup(where_ms, point) ||
+	    seek_index_lookup(input_stream.GetURI(), input_stream.GetSize(),
+			      where_ms, point))
+		offset = point.offset;
+	else
+		/* interpolate the file offset where we expect to
+		   find the given granule position */
+		offset = where_granulepos * input_stream.GetSize()
+			/ eos_granulepos;
+
+	if (where_ms > seek_index.GetCovered())
+		/* this would leave a gap in the seek index */
+		seek_index_enabled = false;
 
 	return OggSeekPageAtOffset(oy, os, input_stream, offset);
 }
@@ -362,9 +455,36 @@ mpd_opus_stream_decode(Decoder &decoder,
 	if (!d.ReadFirstPage(oy))
 		return;
 
+	OggPrefetch prefetch(oy);
+	bool use_prefetch = opus_prefetch;
+
 	while (true) {
 		auto cmd = d.HandlePackets();
+		if (cmd == DecoderCommand::NONE) {
+			/* start the prefetch thread after the OpusHead
+			   packet, because HandleBOS() reads the
+			   stream by itself */
+			if (use_prefetch && d.IsOpen() && !prefetch.IsStarted())
+				use_prefetch = prefetch.Start();
+
+			if (prefetch.IsStarted()
+			    ? d.ReadNextPage(prefetch)
+			    : d.ReadNextPage(oy))
+				continue;
+
+			if (!prefetch.IsStarted())
+				break;
+
+			/* the prefetch thread has stopped, either at
+			   the end of the stream or because a decoder
+			   command has interrupted it */
+			prefetch.Stop();
+			cmd = decoder_get_command(decoder);
+		}
+
 		if (cmd == DecoderCommand::SEEK) {
+			prefetch.Stop();
+
 			if (d.Seek(oy, decoder_seek_where_frame(decoder)))
 				decoder_command_finished(decoder);
 			else
@@ -373,12 +493,11 @@ mpd_opus_stream_decode(Decoder &decoder,
 			continue;
 		}
 
-		if (cmd != DecoderCommand::NONE)
-			break;
-
-		if (!d.ReadNextPage(oy))
-			break;
+		break;
 	}
+
+	prefetch.Stop();
+	d.CommitSeekIndex();
 }
 
 static bool
@@ -49,26 +49,45 @@ pcm_stream_decode(Decoder &decoder, InputStream &is)
 	decoder_initialized(decoder, audio_format,
 			    is.IsSeekable(), total_time);
 
+	const size_t frame_size = audio_format.GetFrameSize();
+
 	DecoderCommand cmd;
 	do {
 		char buffer[4096];
 
-		size_t nbytes = decoder_read(decoder, is,
-					     buffer, sizeof(buffer));
+		/* read straight into the music chunk if possible */
+		auto dest = decoder_data_begin(decoder, is, 0);
+		const bool direct = !dest.IsNull();
+		if (!direct)
+			dest = { buffer, sizeof(buffer) };
+
+		uint8_t *const p = (uint8_t *)dest.data;
+		size_t nbytes = decoder_read(decoder, is, p, dest.size);
 
 		if (nbytes == 0 && is.LockIsEOF())
 			break;
 
+		if (nbytes % frame_size != 0) {
+			/* complete the partial frame */
+			const size_t rest = frame_size - nbytes % frame_size;
+			if (decoder_read_full(&decoder, is, p + nbytes, rest))
+				nbytes += rest;
+			else
+				nbytes -= nbytes % frame_size;
+		}
+
 		if (reverse_endian)
 			/* make sure we deliver samples in host byte order */
-			reverse_bytes_16((uint16_t *)buffer,
-					 (uint16_t *)buffer,
-					 (uint16_t *)(buffer + nbytes));
-
-		cmd = nbytes > 0
-			? decoder_data(decoder, is,
-				       buffer, nbytes, 0)
-			: decoder_get_command(decoder);
+			reverse_bytes_16((uint16_t *)p,
+					 (uint16_t *)p,
+					 (uint16_t *)(p + nbytes));
+
+		if (nbytes == 0)
+			cmd = decoder_get_command(decoder);
+		else if (direct)
+			cmd = decoder_data_commit(decoder, nbytes);
+		else
+			cmd = decoder_data(decoder, is, buffer, nbytes, 0);
 		if (cmd == DecoderCommand::SEEK) {
 			offset_type offset(time_to_size *
 					   decoder_seek_where(decoder));
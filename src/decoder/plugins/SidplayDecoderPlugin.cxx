@@ -21,12 +21,14 @@
 #include "SidplayDecoderPlugin.hxx"
 #include "../DecoderAPI.hxx"
 #include "tag/TagHandler.hxx"
+#include "tag/TagBuilder.hxx"
+#include "DetachedSong.hxx"
 #include "fs/Path.hxx"
-#include "util/FormatString.hxx"
 #include "util/Domain.hxx"
 #include "system/ByteOrder.hxx"
 #include "Log.hxx"
 
+#include <assert.h>
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
@@ -158,25 +160,16 @@ get_song_num(const char *path_fs)
 		return 1;
 }
 
-/* get the song length in seconds */
+/**
+ * Look up the length of a subtune in the songlength database.
+ *
+ * @param md5sum the MD5 sum of the SID file
+ * @return the song length in seconds, or -1 if unknown
+ */
 static int
-get_song_length(Path path_fs)
+get_song_length(const char *md5sum, unsigned song_num)
 {
-	if (songlength_database == nullptr)
-		return -1;
-
-	char *sid_file = get_container_name(path_fs);
-	SidTuneMod tune(sid_file);
-	free(sid_file);
-	if(!tune) {
-		LogWarning(sidplay_domain,
-			   "failed to load file for calculating md5 sum");
-		return -1;
-	}
-	char md5sum[SIDTUNE_MD5_LENGTH+1];
-	tune.createMD5(md5sum);
-
-	const unsigned song_num = get_song_num(path_fs.c_str());
+	assert(songlength_database != nullptr);
 
 	gsize num_items;
 	gchar **values=g_key_file_get_string_list(songlength_database,
@@ -202,6 +195,27 @@ get_song_length(Path path_fs)
 	return (minutes*60)+seconds;
 }
 
+/* get the song length in seconds */
+static int
+get_song_length(Path path_fs)
+{
+	if (songlength_database == nullptr)
+		return -1;
+
+	char *sid_file = get_container_name(path_fs);
+	SidTuneMod tune(sid_file);
+	free(sid_file);
+	if(!tune) {
+		LogWarning(sidplay_domain,
+			   "failed to load file for calculating md5 sum");
+		return -1;
+	}
+	char md5sum[SIDTUNE_MD5_LENGTH+1];
+	tune.createMD5(md5sum);
+
+	return get_song_length(md5sum, get_song_num(path_fs.c_str()));
+}
+
 static void
 sidplay_file_decode(Decoder &decoder, Path path_fs)
 {
@@ -340,20 +354,10 @@ sidplay_file_decode(Decoder &decoder, Path path_fs)
 	} while (cmd != DecoderCommand::STOP);
 }
 
-static bool
-sidplay_scan_file(Path path_fs,
-		  const struct tag_handler *handler, void *handler_ctx)
+static void
+ScanSidTuneInfo(const SidTuneInfo &info, unsigned song_num, int song_len,
+		const struct tag_handler *handler, void *handler_ctx)
 {
-	const int song_num = get_song_num(path_fs.c_str());
-	char *path_container=get_container_name(path_fs);
-
-	SidTune tune(path_container, nullptr, true);
-	free(path_container);
-	if (!tune)
-		return false;
-
-	const SidTuneInfo &info = tune.getInfo();
-
 	/* title */
 	const char *title;
 	if (info.numberOfInfoStrings > 0 && info.infoString[0] != nullptr)
@@ -382,33 +386,68 @@ sidplay_scan_file(Path path_fs,
 	tag_handler_invoke_tag(handler, handler_ctx, TAG_TRACK, track);
 
 	/* time */
-	int song_len=get_song_length(path_fs);
 	if (song_len >= 0)
 		tag_handler_invoke_duration(handler, handler_ctx, song_len);
+}
 
+static bool
+sidplay_scan_file(Path path_fs,
+		  const struct tag_handler *handler, void *handler_ctx)
+{
+	const int song_num = get_song_num(path_fs.c_str());
+	char *path_container=get_container_name(path_fs);
+
+	SidTune tune(path_container, nullptr, true);
+	free(path_container);
+	if (!tune)
+		return false;
+
+	ScanSidTuneInfo(tune.getInfo(), song_num, get_song_length(path_fs),
+			handler, handler_ctx);
 	return true;
 }
 
-static char *
-sidplay_container_scan(Path path_fs, const unsigned int tnum)
+static std::forward_list<DetachedSong>
+sidplay_container_scan(Path path_fs)
 {
-	SidTune tune(path_fs.c_str(), nullptr, true);
+	std::forward_list<DetachedSong> list;
+
+	/* SidTuneMod can calculate the MD5 sum for the songlength
+	   database, so the file is loaded only once */
+	SidTuneMod tune(path_fs.c_str());
 	if (!tune)
-		return nullptr;
+		return list;
 
 	const SidTuneInfo &info=tune.getInfo();
 
 	/* Don't treat sids containing a single tune
 		as containers */
 	if(!all_files_are_containers && info.songs<2)
-		return nullptr;
+		return list;
 
-	/* Construct container/tune path names, eg.
-		Delta.sid/tune_001.sid */
-	if(tnum<=info.songs) {
-		return FormatNew(SUBTUNE_PREFIX "%03u.sid", tnum);
-	} else
-		return nullptr;
+	char md5sum[SIDTUNE_MD5_LENGTH+1];
+	if (songlength_database != nullptr)
+		tune.createMD5(md5sum);
+
+	TagBuilder tag_builder;
+
+	auto tail = list.before_begin();
+	for (unsigned i = 1; i <= info.songs; ++i) {
+		const int song_len = songlength_database != nullptr
+			? get_song_length(md5sum, i)
+			: -1;
+		ScanSidTuneInfo(info, i, song_len,
+				&add_tag_handler, &tag_builder);
+
+		/* Construct container/tune path names, eg.
+		   Delta.sid/tune_001.sid */
+		char track_name[32];
+		sprintf(track_name, SUBTUNE_PREFIX "%03u.sid", i);
+		tail = list.emplace_after(tail, track_name,
+					  tag_builder.Commit());
+	}
+
+	return list;
 }
 
 static const char *const sidplay_suffixes[] = {
@@ -24,6 +24,11 @@
 #include "../DecoderAPI.hxx"
 #include "input/InputStream.hxx"
 #include "OggCodec.hxx"
+#ifndef HAVE_TREMOR
+#include "OggSyncState.hxx"
+#include "OggPrefetch.hxx"
+#endif
+#include "config/ConfigData.hxx"
 #include "util/Error.hxx"
 #include "util/Macros.hxx"
 #include "CheckAudioFormat.hxx"
@@ -46,24 +51,80 @@
 #define ov_time_seek_page(VF, S) (ov_time_seek_page(VF, (S)*1000))
 #endif /* HAVE_TREMOR */
 
+#include <algorithm>
+
 #include <errno.h>
 
+#ifndef HAVE_TREMOR
+/**
+ * Read the Ogg pages in a separate thread?
+ */
+static bool vorbis_prefetch;
+#endif
+
 struct VorbisInputStream {
 	Decoder *const decoder;
 
 	InputStream &input_stream;
 	bool seekable;
 
+#ifndef HAVE_TREMOR
+	/**
+	 * If not nullptr, then the callbacks read through this
+	 * object, which starts its thread on demand.
+	 */
+	OggPrefetch *prefetch;
+	OggSyncState *oy;
+#endif
+
 	VorbisInputStream(Decoder *_decoder, InputStream &_is)
 		:decoder(_decoder), input_stream(_is),
-		 seekable(input_stream.CheapSeeking()) {}
+		 seekable(input_stream.CheapSeeking())
+#ifndef HAVE_TREMOR
+		, prefetch(nullptr), oy(nullptr)
+#endif
+	{}
+
+#ifndef HAVE_TREMOR
+	/**
+	 * Stop the prefetch thread before the stream is accessed
+	 * directly.
+	 */
+	void StopPrefetch() {
+		if (prefetch != nullptr && prefetch->IsStarted()) {
+			prefetch->Stop();
+			oy->Reset();
+		}
+	}
+
+	size_t Read(void *ptr, size_t size) {
+		if (prefetch == nullptr)
+			return decoder_read(decoder, input_stream, ptr, size);
+
+		if (!prefetch->IsStarted() &&
+		    (input_stream.IsEOF() || !prefetch->Start()))
+			return 0;
+
+		return prefetch->Read(ptr, size);
+	}
+
+	offset_type GetOffset() const {
+		return prefetch != nullptr && prefetch->IsStarted()
+			? prefetch->GetOffset()
+			: input_stream.GetOffset();
+	}
+#endif
 };
 
 static size_t ogg_read_cb(void *ptr, size_t size, size_t nmemb, void *data)
 {
 	VorbisInputStream *vis = (VorbisInputStream *)data;
+#ifdef HAVE_TREMOR
 	size_t ret = decoder_read(vis->decoder, vis->input_stream,
 				  ptr, size * nmemb);
+#else
+	size_t ret = vis->Read(ptr, size * nmemb);
+#endif
 
 	errno = 0;
 
@@ -86,7 +147,11 @@ static int ogg_seek_cb(void *data, ogg_int64_t _offset, int whence)
 		break;
 
 	case SEEK_CUR:
+#ifdef HAVE_TREMOR
 		offset += is.GetOffset();
+#else
+		offset += vis->GetOffset();
+#endif
 		break;
 
 	case SEEK_END:
@@ -100,6 +165,10 @@ static int ogg_seek_cb(void *data, ogg_int64_t _offset, int whence)
 		return -1;
 	}
 
+#ifndef HAVE_TREMOR
+	vis->StopPrefetch();
+#endif
+
 	return is.LockSeek(offset, IgnoreError())
 		? 0 : -1;
 }
@@ -114,7 +183,11 @@ static long ogg_tell_cb(void *data)
 {
 	VorbisInputStream *vis = (VorbisInputStream *)data;
 
+#ifdef HAVE_TREMOR
 	return (long)vis->input_stream.GetOffset();
+#else
+	return (long)vis->GetOffset();
+#endif
 }
 
 static const ov_callbacks vorbis_is_callbacks = {
@@ -179,16 +252,55 @@ vorbis_send_comments(Decoder &decoder, InputStream &is,
 #ifndef HAVE_TREMOR
 static void
 vorbis_interleave(float *dest, const float *const*src,
-		  unsigned nframes, unsigned channels)
+		  unsigned offset, unsigned nframes, unsigned channels)
 {
 	for (const float *const*src_end = src + channels;
 	     src != src_end; ++src, ++dest) {
 		float *gcc_restrict d = dest;
-		for (const float *gcc_restrict s = *src, *s_end = s + nframes;
+		for (const float *gcc_restrict s = *src + offset,
+			     *s_end = s + nframes;
 		     s != s_end; ++s, d += channels)
 			*d = *s;
 	}
 }
+
+/**
+ * Interleave the decoded samples straight into the music chunks.  If
+ * that is not possible, interleave into #buffer and submit it with
+ * decoder_data().
+ */
+static DecoderCommand
+vorbis_submit(Decoder &decoder, InputStream &is,
+	      const float *const*src, unsigned nframes, unsigned channels,
+	      uint16_t kbit_rate, float *buffer)
+{
+	const size_t frame_size = sizeof(*buffer) * channels;
+
+	for (unsigned position = 0; position < nframes;) {
+		auto dest = decoder_data_begin(decoder, is, kbit_rate);
+		if (dest.IsNull()) {
+			const unsigned n = nframes - position;
+			vorbis_interleave(buffer, src, position, n, channels);
+			return decoder_data(decoder, is,
+					    buffer, n * frame_size,
+					    kbit_rate);
+		}
+
+		const unsigned n = std::min<unsigned>(dest.size / frame_size,
+						      nframes - position);
+		vorbis_interleave((float *)dest.data, src, position, n,
+				  channels);
+
+		DecoderCommand cmd = decoder_data_commit(decoder,
+							 n * frame_size);
+		if (cmd != DecoderCommand::NONE)
+			return cmd;
+
+		position += n;
+	}
+
+	return DecoderCommand::NONE;
+}
 #endif
 
 /* public */
@@ -198,6 +310,8 @@ vorbis_init(gcc_unused const config_param &param)
 {
 #ifndef HAVE_TREMOR
 	LogDebug(vorbis_domain, vorbis_version_string());
+
+	vorbis_prefetch = param.GetBlockValue("prefetch", false);
 #endif
 	return true;
 }
@@ -255,14 +369,37 @@ vorbis_stream_decode(Decoder &decoder,
 	int prev_section = -1;
 	unsigned kbit_rate = 0;
 
+#ifndef HAVE_TREMOR
+	/* libvorbisfile demultiplexes by itself; the prefetch thread
+	   only reads and verifies the pages ahead of it */
+	OggSyncState oy(input_stream, &decoder);
+	OggPrefetch prefetch(oy);
+	if (vorbis_prefetch) {
+		vis.prefetch = &prefetch;
+		vis.oy = &oy;
+	}
+#endif
+
 	DecoderCommand cmd = decoder_get_command(decoder);
 	do {
 		if (cmd == DecoderCommand::SEEK) {
+#ifndef HAVE_TREMOR
+			/* bisect with direct reads, and restart the
+			   prefetch thread after the seek */
+			vis.StopPrefetch();
+			vis.prefetch = nullptr;
+#endif
+
 			auto seek_where = decoder_seek_where_frame(decoder);
 			if (0 == ov_pcm_seek_page(&vf, seek_where)) {
 				decoder_command_finished(decoder);
 			} else
 				decoder_seek_error(decoder);
+
+#ifndef HAVE_TREMOR
+			if (vorbis_prefetch)
+				vis.prefetch = &prefetch;
+#endif
 		}
 
 		int current_section;
@@ -277,12 +414,8 @@ vorbis_stream_decode(Decoder &decoder,
 					     frames_per_buffer,
 					     &current_section);
 		long nbytes = nframes;
-		if (nframes > 0) {
-			vorbis_interleave(buffer,
-					  (const float*const*)per_channel,
-					  nframes, audio_format.channels);
+		if (nframes > 0)
 			nbytes *= frame_size;
-		}
 #endif
 
 		if (nbytes == OV_HOLE) /* bad packet */
@@ -322,11 +455,26 @@ vorbis_stream_decode(Decoder &decoder,
 		if (test > 0)
 			kbit_rate = test / 1000;
 
+#ifdef HAVE_TREMOR
 		cmd = decoder_data(decoder, input_stream,
 				   buffer, nbytes,
 				   kbit_rate);
+#else
+		cmd = nbytes > 0
+			? vorbis_submit(decoder, input_stream,
+					(const float *const*)per_channel,
+					nframes, audio_format.channels,
+					kbit_rate, buffer)
+			: decoder_data(decoder, input_stream,
+				       buffer, 0, kbit_rate);
+#endif
 	} while (cmd != DecoderCommand::STOP);
 
+#ifndef HAVE_TREMOR
+	vis.StopPrefetch();
+	vis.prefetch = nullptr;
+#endif
+
 	ov_clear(&vf);
 }
 
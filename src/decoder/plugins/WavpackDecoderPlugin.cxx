@@ -27,12 +27,19 @@
 #include "fs/Path.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
-#include "util/Macros.hxx"
 #include "Log.hxx"
 
 #include <wavpack/wavpack.h>
 #include <glib.h>
 
+#include <memory>
+
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -41,69 +48,99 @@
 
 static constexpr Domain wavpack_domain("wavpack");
 
-/** A pointer type for format converter function. */
-typedef void (*format_samples_t)(
-	int bytes_per_sample,
-	void *buffer, uint32_t count
-);
+/**
+ * The number of frames unpacked by one WavpackUnpackSamples() call.
+ */
+static constexpr uint32_t WAVPACK_CHUNK_FRAMES = 4096;
 
-/*
- * This function has been borrowed from the tiny player found on
- * wavpack.com. Modifications were required because mpd only handles
- * max 24-bit samples.
+/**
+ * A pointer type for format converter function.  libwavpack returns
+ * all kinds of samples in 32 bit integers; the converter transforms
+ * them in place to MPD's sample format.
+ */
+typedef void (*format_samples_t)(void *buffer, size_t count);
+
+/**
+ * Pass through and align 8-bit samples.
  */
 static void
-format_samples_int(int bytes_per_sample, void *buffer, uint32_t count)
+format_samples_s8(void *buffer, size_t count)
 {
-	int32_t *src = (int32_t *)buffer;
+	const int32_t *src = (const int32_t *)buffer;
+	int8_t *dst = (int8_t *)buffer;
 
-	switch (bytes_per_sample) {
-	case 1: {
-		int8_t *dst = (int8_t *)buffer;
-		/*
-		 * The asserts like the following one are because we do the
-		 * formatting of samples within a single buffer. The size
-		 * of the output samples never can be greater than the size
-		 * of the input ones. Otherwise we would have an overflow.
-		 */
-		static_assert(sizeof(*dst) <= sizeof(*src), "Wrong size");
-
-		/* pass through and align 8-bit samples */
-		while (count--) {
-			*dst++ = *src++;
-		}
-		break;
-	}
-	case 2: {
-		uint16_t *dst = (uint16_t *)buffer;
-		static_assert(sizeof(*dst) <= sizeof(*src), "Wrong size");
+	while (count--)
+		*dst++ = *src++;
+}
 
-		/* pass through and align 16-bit samples */
-		while (count--) {
-			*dst++ = *src++;
-		}
-		break;
-	}
+/**
+ * Pass through and align 16-bit samples.  The values are already
+ * in range, so the saturation of the SIMD instructions does not
+ * change them.
+ */
+static void
+format_samples_s16(void *buffer, size_t count)
+{
+	const int32_t *src = (const int32_t *)buffer;
+	int16_t *dst = (int16_t *)buffer;
 
-	case 3:
-	case 4:
-		/* do nothing */
-		break;
+	/* the destination never overtakes the source, because each
+	   block is loaded before it is stored */
+
+#ifdef __ARM_NEON__
+	for (; count >= 8; count -= 8, src += 8, dst += 8) {
+		int16x4_t lo = vmovn_s32(vld1q_s32(src));
+		int16x4_t hi = vmovn_s32(vld1q_s32(src + 4));
+		vst1q_s16(dst, vcombine_s16(lo, hi));
+	}
+#elif defined(__SSE2__)
+	for (; count >= 8; count -= 8, src += 8, dst += 8) {
+		__m128i lo = _mm_loadu_si128((const __m128i *)src);
+		__m128i hi = _mm_loadu_si128((const __m128i *)(src + 4));
+		_mm_storeu_si128((__m128i *)dst, _mm_packs_epi32(lo, hi));
 	}
+#endif
+
+	while (count--)
+		*dst++ = *src++;
 }
 
 /*
  * This function converts floating point sample data to 24-bit integer.
  */
 static void
-format_samples_float(gcc_unused int bytes_per_sample, void *buffer,
-		     uint32_t count)
+format_samples_float(void *buffer, size_t count)
 {
 	float *p = (float *)buffer;
 
-	while (count--) {
-		*p /= (1 << 23);
-		++p;
+	/* multiplying with the reciprocal of a power of two is
+	   exact, and unlike the division, it gets vectorized */
+	constexpr float factor = 1.f / (1 << 23);
+	while (count--)
+		*p++ *= factor;
+}
+
+/**
+ * Choose the converter for libwavpack's sample format.  Returns
+ * nullptr if the samples can be passed to MPD as they are.
+ */
+static format_samples_t
+wavpack_format_samples(bool is_float, int bytes_per_sample)
+{
+	if (is_float)
+		return format_samples_float;
+
+	switch (bytes_per_sample) {
+	case 1:
+		return format_samples_s8;
+
+	case 2:
+		return format_samples_s16;
+
+	default:
+		/* 24 and 32 bit samples are already in MPD's
+		   S24_P32 and S32 format */
+		return nullptr;
 	}
 }
 
@@ -156,20 +193,18 @@ wavpack_decode(Decoder &decoder, WavpackContext *wpc, bool can_seek)
 		return;
 	}
 
-	const format_samples_t format_samples = is_float
-		? format_samples_float
-		: format_samples_int;
+	const format_samples_t format_samples =
+		wavpack_format_samples(is_float,
+				       WavpackGetBytesPerSample(wpc));
 
 	const float total_time = float(WavpackGetNumSamples(wpc))
 		/ audio_format.sample_rate;
 
-	const int bytes_per_sample = WavpackGetBytesPerSample(wpc);
 	const int output_sample_size = audio_format.GetFrameSize();
 
 	/* wavpack gives us all kind of samples in a 32-bit space */
-	int32_t chunk[1024];
-	const uint32_t samples_requested = ARRAY_SIZE(chunk) /
-		audio_format.channels;
+	const std::unique_ptr<int32_t[]>
+		chunk(new int32_t[WAVPACK_CHUNK_FRAMES * audio_format.channels]);
 
 	decoder_initialized(decoder, audio_format, can_seek, total_time);
 
@@ -189,17 +224,18 @@ wavpack_decode(Decoder &decoder, WavpackContext *wpc, bool can_seek)
 			}
 		}
 
-		uint32_t samples_got = WavpackUnpackSamples(wpc, chunk,
-							    samples_requested);
+		uint32_t samples_got = WavpackUnpackSamples(wpc, chunk.get(),
+							    WAVPACK_CHUNK_FRAMES);
 		if (samples_got == 0)
 			break;
 
 		int bitrate = (int)(WavpackGetInstantBitrate(wpc) / 1000 +
 				    0.5);
-		format_samples(bytes_per_sample, chunk,
-			       samples_got * audio_format.channels);
+		if (format_samples != nullptr)
+			format_samples(chunk.get(),
+				       samples_got * audio_format.channels);
 
-		cmd = decoder_data(decoder, nullptr, chunk,
+		cmd = decoder_data(decoder, nullptr, chunk.get(),
 				   samples_got * output_sample_size,
 				   bitrate);
 	}
@@ -20,6 +20,8 @@
 #ifndef MPD_ENCODER_PLUGIN_HXX
 #define MPD_ENCODER_PLUGIN_HXX
 
+#include "Compiler.h"
+
 #include <assert.h>
 #include <stdbool.h>
 #include <stddef.h>
@@ -75,6 +77,12 @@ struct EncoderPlugin {
 	size_t (*read)(Encoder *encoder, void *dest, size_t length);
 
 	const char *(*get_mime_type)(Encoder *encoder);
+
+	/**
+	 * Does write() pass the PCM data to read() unmodified?  See
+	 * encoder_is_passthrough().
+	 */
+	bool (*is_passthrough)(const Encoder *encoder);
 };
 
 /**
@@ -318,4 +326,24 @@ encoder_get_mime_type(Encoder *encoder)
 		: nullptr;
 }
 
+/**
+ * Does the encoder pass the PCM data to encoder_read() unmodified
+ * (after the header)?  In this case, the caller may skip
+ * encoder_write() and use the PCM data directly, which saves
+ * copying it through the encoder's buffer.  The header must still be
+ * obtained with encoder_read() after encoder_open().
+ *
+ * @param encoder the encoder
+ */
+gcc_pure
+static inline bool
+encoder_is_passthrough(const Encoder *encoder)
+{
+	assert(encoder->open);
+
+	/* this method is optional */
+	return encoder->plugin.is_passthrough != nullptr &&
+		encoder->plugin.is_passthrough(encoder);
+}
+
 #endif
@@ -0,0 +1,434 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "SharedEncoder.hxx"
+#include "EncoderAPI.hxx"
+#include "thread/Mutex.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <algorithm>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+static constexpr Domain shared_encoder_domain("shared_encoder");
+
+/**
+ * Encoded data which has been read by all members is removed from
+ * the buffer only when at least this many bytes can be removed, to
+ * avoid moving the rest of the buffer too often.
+ */
+static constexpr size_t SHARED_ENCODER_TRIM = 64 * 1024;
+
+/**
+ * A member which lags behind by more than this number of bytes
+ * (e.g. a "httpd" output without clients, which does not read from
+ * its encoder) skips the data it has missed.
+ */
+static constexpr size_t SHARED_ENCODER_MAX_BACKLOG = 4 * 1024 * 1024;
+
+struct SharedEncoderMember;
+
+struct SharedEncoderStream {
+	const std::string name;
+
+	/**
+	 * The real encoder.
+	 */
+	Encoder *const encoder;
+
+	/**
+	 * The number of #SharedEncoderMember objects referring to
+	 * this object.  Protected by the registry mutex.
+	 */
+	unsigned refs;
+
+	/**
+	 * This mutex protects all attributes below.
+	 */
+	Mutex mutex;
+
+	/**
+	 * The members which have opened the encoder, in the order
+	 * they did so.  The first one feeds the real encoder.
+	 */
+	std::list<SharedEncoderMember *> members;
+
+	/**
+	 * The audio format passed to encoder_open() by the first
+	 * member, and the one chosen by the real encoder.
+	 */
+	AudioFormat in_audio_format, out_audio_format;
+
+	/**
+	 * The encoder output right after it was opened; it is passed
+	 * to each member first.
+	 */
+	std::vector<uint8_t> header;
+
+	/**
+	 * Encoded data which has not yet been read by all members.
+	 */
+	std::vector<uint8_t> data;
+
+	/**
+	 * The position of data[0] within the encoded stream.
+	 */
+	uint64_t data_position;
+
+	SharedEncoderStream(const char *_name, Encoder *_encoder)
+		:name(_name), encoder(_encoder), refs(1) {}
+
+	~SharedEncoderStream() {
+		assert(members.empty());
+
+		encoder_finish(encoder);
+	}
+
+	gcc_pure
+	uint64_t GetEndPosition() const {
+		return data_position + data.size();
+	}
+
+	gcc_pure
+	bool IsFeeder(const SharedEncoderMember &member) const {
+		return !members.empty() && members.front() == &member;
+	}
+
+	/**
+	 * Move all pending output of the real encoder to the given
+	 * buffer.
+	 */
+	void Drain(std::vector<uint8_t> &dest);
+
+	/**
+	 * Free the data which has been read by all members.
+	 */
+	void Trim();
+
+	bool Open(SharedEncoderMember &member, AudioFormat &audio_format,
+		  Error &error);
+	void Close(SharedEncoderMember &member);
+	size_t Read(SharedEncoderMember &member, void *dest, size_t length);
+};
+
+struct SharedEncoderMember {
+	Encoder encoder;
+
+	SharedEncoderStream &stream;
+
+	/**
+	 * The number of #SharedEncoderStream::header bytes which
+	 * have already been read.
+	 */
+	size_t header_position;
+
+	/**
+	 * The position within the encoded stream of the next byte
+	 * to be read.
+	 */
+	uint64_t position;
+
+	explicit SharedEncoderMember(SharedEncoderStream &_stream)
+		:encoder(shared_encoder_plugin), stream(_stream) {}
+};
+
+static Mutex shared_encoder_mutex;
+static std::map<std::string, SharedEncoderStream *> shared_encoders;
+
+void
+SharedEncoderStream::Drain(std::vector<uint8_t> &dest)
+{
+	while (true) {
+		const size_t old_size = dest.size();
+		dest.resize(old_size + 4096);
+		size_t nbytes = encoder_read(encoder, &dest[old_size], 4096);
+		dest.resize(old_size + nbytes);
+		if (nbytes == 0)
+			break;
+	}
+}
+
+void
+SharedEncoderStream::Trim()
+{
+	const uint64_t end = GetEndPosition();
+
+	uint64_t min_position = end;
+	for (auto *member : members) {
+		if (end - member->position > SHARED_ENCODER_MAX_BACKLOG) {
+			member->position = end;
+			member->header_position = header.size();
+		}
+
+		min_position = std::min(min_position, member->position);
+	}
+
+	const size_t consumed = min_position - data_position;
+	if (consumed == data.size())
+		data.clear();
+	else if (consumed >= SHARED_ENCODER_TRIM)
+		data.erase(data.begin(), data.begin() + consumed);
+	else
+		return;
+
+	data_position = min_position;
+}
+
+inline bool
+SharedEncoderStream::Open(SharedEncoderMember &member,
+			  AudioFormat &audio_format, Error &error)
+{
+	if (members.empty()) {
+		AudioFormat encoder_audio_format = audio_format;
+		if (!encoder_open(encoder, encoder_audio_format, error))
+			return false;
+
+		in_audio_format = audio_format;
+		out_audio_format = encoder_audio_format;
+
+		header.clear();
+		data.clear();
+		data_position = 0;
+
+		Drain(header);
+	} else if (audio_format != in_audio_format) {
+		error.Format(shared_encoder_domain,
+			     "Shared encoder \"%s\" is already open with a different audio format",
+			     name.c_str());
+		return false;
+	}
+
+	audio_format = out_audio_format;
+
+	member.header_position = 0;
+	member.position = GetEndPosition();
+	members.push_back(&member);
+	return true;
+}
+
+inline void
+SharedEncoderStream::Close(SharedEncoderMember &member)
+{
+	members.remove(&member);
+
+	if (members.empty()) {
+		encoder_close(encoder);
+		header.clear();
+		data.clear();
+	} else
+		Trim();
+}
+
+inline size_t
+SharedEncoderStream::Read(SharedEncoderMember &member,
+			  void *_dest, size_t length)
+{
+	uint8_t *dest = (uint8_t *)_dest;
+	size_t nbytes = 0;
+
+	if (member.header_position < header.size()) {
+		nbytes = std::min(length,
+				  header.size() - member.header_position);
+		memcpy(dest, &header[member.header_position], nbytes);
+		member.header_position += nbytes;
+	}
+
+	assert(member.position >= data_position);
+	const size_t offset = member.position - data_position;
+	const size_t n = std::min(length - nbytes, data.size() - offset);
+	if (n > 0) {
+		memcpy(dest + nbytes, &data[offset], n);
+		member.position += n;
+		nbytes += n;
+		Trim();
+	}
+
+	return nbytes;
+}
+
+Encoder *
+shared_encoder_init(const char *name, const EncoderPlugin &plugin,
+		    const config_param &param, Error &error)
+{
+	const ScopeLock protect(shared_encoder_mutex);
+
+	SharedEncoderStream *stream;
+	auto i = shared_encoders.find(name);
+	if (i != shared_encoders.end()) {
+		stream = i->second;
+		if (&stream->encoder->plugin != &plugin) {
+			error.Format(shared_encoder_domain,
+				     "Shared encoder \"%s\" was configured with a different encoder plugin",
+				     name);
+			return nullptr;
+		}
+
+		++stream->refs;
+	} else {
+		Encoder *encoder = encoder_init(plugin, param, error);
+		if (encoder == nullptr)
+			return nullptr;
+
+		stream = new SharedEncoderStream(name, encoder);
+		shared_encoders.insert(std::make_pair(stream->name, stream));
+	}
+
+	SharedEncoderMember *member = new SharedEncoderMember(*stream);
+	return &member->encoder;
+}
+
+static void
+shared_encoder_finish(Encoder *_encoder)
+{
+	SharedEncoderMember *member = (SharedEncoderMember *)_encoder;
+	SharedEncoderStream &stream = member->stream;
+	delete member;
+
+	const ScopeLock protect(shared_encoder_mutex);
+
+	assert(stream.refs > 0);
+	if (--stream.refs > 0)
+		return;
+
+	shared_encoders.erase(stream.name);
+	delete &stream;
+}
+
+static bool
+shared_encoder_open(Encoder *_encoder, AudioFormat &audio_format,
+		    Error &error)
+{
+	SharedEncoderMember *member = (SharedEncoderMember *)_encoder;
+	SharedEncoderStream &stream = member->stream;
+
+	const ScopeLock protect(stream.mutex);
+	return stream.Open(*member, audio_format, error);
+}
+
+static void
+shared_encoder_close(Encoder *_encoder)
+{
+	SharedEncoderMember *member = (SharedEncoderMember *)_encoder;
+	SharedEncoderStream &stream = member->stream;
+
+	const ScopeLock protect(stream.mutex);
+	stream.Close(*member);
+}
+
+static bool
+shared_encoder_end(Encoder *_encoder, Error &error)
+{
+	SharedEncoderMember *member = (SharedEncoderMember *)_encoder;
+	SharedEncoderStream &stream = member->stream;
+
+	const ScopeLock protect(stream.mutex);
+
+	/* the stream ends only when its last member ends it; the
+	   others just stop reading */
+	if (stream.members.size() > 1)
+		return true;
+
+	if (!encoder_end(stream.encoder, error))
+		return false;
+
+	stream.Drain(stream.data);
+	return true;
+}
+
+static bool
+shared_encoder_flush(Encoder *_encoder, Error &error)
+{
+	SharedEncoderMember *member = (SharedEncoderMember *)_encoder;
+	SharedEncoderStream &stream = member->stream;
+
+	const ScopeLock protect(stream.mutex);
+
+	if (!stream.IsFeeder(*member))
+		return true;
+
+	if (!encoder_flush(stream.encoder, error))
+		return false;
+
+	stream.Drain(stream.data);
+	return true;
+}
+
+static bool
+shared_encoder_write(Encoder *_encoder, const void *data, size_t length,
+		     Error &error)
+{
+	SharedEncoderMember *member = (SharedEncoderMember *)_encoder;
+	SharedEncoderStream &stream = member->stream;
+
+	const ScopeLock protect(stream.mutex);
+
+	if (!stream.IsFeeder(*member))
+		/* another member has already encoded (or is going to
+		   encode) the same PCM data */
+		return true;
+
+	if (!encoder_write(stream.encoder, data, length, error))
+		return false;
+
+	stream.Drain(stream.data);
+	return true;
+}
+
+static size_t
+shared_encoder_read(Encoder *_encoder, void *dest, size_t length)
+{
+	SharedEncoderMember *member = (SharedEncoderMember *)_encoder;
+	SharedEncoderStream &stream = member->stream;
+
+	const ScopeLock protect(stream.mutex);
+	return stream.Read(*member, dest, length);
+}
+
+static const char *
+shared_encoder_get_mime_type(Encoder *_encoder)
+{
+	SharedEncoderMember *member = (SharedEncoderMember *)_encoder;
+
+	return encoder_get_mime_type(member->stream.encoder);
+}
+
+const EncoderPlugin shared_encoder_plugin = {
+	"shared",
+	/* objects are created by shared_encoder_init() */
+	nullptr,
+	shared_encoder_finish,
+	shared_encoder_open,
+	shared_encoder_close,
+	shared_encoder_end,
+	shared_encoder_flush,
+	nullptr,
+	nullptr,
+	shared_encoder_write,
+	shared_encoder_read,
+	shared_encoder_get_mime_type,
+	nullptr,
+};
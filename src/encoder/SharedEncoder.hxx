@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SHARED_ENCODER_HXX
+#define MPD_SHARED_ENCODER_HXX
+
+#include "EncoderPlugin.hxx"
+#include "Compiler.h"
+
+extern const EncoderPlugin shared_encoder_plugin;
+
+/**
+ * Creates an encoder object which shares one real encoder with all
+ * other objects created with the same name (the "shared_encoder"
+ * setting of several outputs).  The PCM data is encoded only once,
+ * and each object reads its own copy of the encoded stream.
+ *
+ * The first output which opens the shared encoder feeds it; the
+ * PCM data written to the other objects is discarded, because it
+ * is assumed to be the same.  All outputs must therefore use the
+ * same audio format.  In-stream tags are not supported; outputs
+ * fall back to their other means of sending metadata.
+ *
+ * @param name the name of the shared encoder
+ * @param plugin the real encoder plugin
+ * @param param the configuration of the real encoder; only the
+ * configuration of the first output with this name is used
+ * @return the encoder object or nullptr on error
+ */
+Encoder *
+shared_encoder_init(const char *name, const EncoderPlugin &plugin,
+		    const config_param &param, Error &error);
+
+/**
+ * Was this object created by shared_encoder_init()?
+ */
+gcc_pure
+static inline bool
+encoder_is_shared(const Encoder *encoder)
+{
+	return &encoder->plugin == &shared_encoder_plugin;
+}
+
+#endif
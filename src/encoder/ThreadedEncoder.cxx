@@ -0,0 +1,438 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "ThreadedEncoder.hxx"
+#include "EncoderAPI.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
+#include "util/Error.hxx"
+
+#include <vector>
+#include <algorithm>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * encoder_write() blocks while this many bytes of PCM data are
+ * waiting for the encoder thread.
+ */
+static constexpr size_t THREADED_ENCODER_QUEUE = 128 * 1024;
+
+struct ThreadedEncoder {
+	Encoder encoder;
+
+	/**
+	 * The real encoder.  While the thread is running, it is
+	 * accessed by the thread only, except when #input is empty
+	 * and #busy is false; see Sync().
+	 */
+	Encoder *const real;
+
+	Thread thread;
+
+	/**
+	 * This mutex protects all attributes below.
+	 */
+	Mutex mutex;
+
+	/**
+	 * Wakes up the thread.
+	 */
+	Cond cond;
+
+	/**
+	 * Wakes up the client after the thread has made progress.
+	 */
+	Cond client_cond;
+
+	/**
+	 * PCM data which has not yet been taken by the thread.
+	 */
+	std::vector<uint8_t> input;
+
+	/**
+	 * Encoded data which has not yet been read by the client,
+	 * starting at #output_position.
+	 */
+	std::vector<uint8_t> output;
+	size_t output_position;
+
+	/**
+	 * Is the thread currently encoding data it has taken from
+	 * #input?
+	 */
+	bool busy;
+
+	bool quit;
+
+	/**
+	 * The first error of the thread; it is reported by the next
+	 * method call.
+	 */
+	Error error;
+
+	/**
+	 * The plugin table depends on whether the real encoder
+	 * supports tags, because outputs check the "tag" method to
+	 * decide whether to send metadata out of band.
+	 */
+	explicit ThreadedEncoder(Encoder *_real)
+		:encoder(_real->plugin.tag != nullptr
+			 ? threaded_tag_encoder_plugin
+			 : threaded_encoder_plugin),
+		 real(_real) {}
+
+	~ThreadedEncoder() {
+		encoder_finish(real);
+	}
+
+	bool CheckError(Error &error_r) {
+		if (!error.IsDefined())
+			return true;
+
+		error_r.Set(error);
+		return false;
+	}
+
+	/**
+	 * Move all pending output of the real encoder to the given
+	 * buffer.
+	 */
+	void Drain(std::vector<uint8_t> &dest);
+
+	/**
+	 * Wait until the thread has encoded all queued data.
+	 * Afterwards, the caller may use #real while holding the
+	 * mutex.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	bool Sync(Error &error_r);
+
+	bool Open(AudioFormat &audio_format, Error &error_r);
+	void Close();
+	bool Write(const void *data, size_t length, Error &error_r);
+	size_t Read(void *dest, size_t length);
+
+	void Run();
+	static void Run(void *ctx);
+};
+
+void
+ThreadedEncoder::Drain(std::vector<uint8_t> &dest)
+{
+	while (true) {
+		const size_t old_size = dest.size();
+		dest.resize(old_size + 4096);
+		size_t nbytes = encoder_read(real, &dest[old_size], 4096);
+		dest.resize(old_size + nbytes);
+		if (nbytes == 0)
+			break;
+	}
+}
+
+bool
+ThreadedEncoder::Sync(Error &error_r)
+{
+	while ((!input.empty() || busy) && !error.IsDefined())
+		client_cond.wait(mutex);
+
+	return CheckError(error_r);
+}
+
+inline bool
+ThreadedEncoder::Open(AudioFormat &audio_format, Error &error_r)
+{
+	if (!encoder_open(real, audio_format, error_r))
+		return false;
+
+	input.clear();
+	output.clear();
+	output_position = 0;
+	busy = false;
+	quit = false;
+	error.Clear();
+
+	/* the header is available right after encoder_open() */
+	Drain(output);
+
+	if (!thread.Start(Run, this, error_r)) {
+		encoder_close(real);
+		return false;
+	}
+
+	return true;
+}
+
+inline void
+ThreadedEncoder::Close()
+{
+	mutex.lock();
+	quit = true;
+	cond.signal();
+	mutex.unlock();
+
+	thread.Join();
+
+	encoder_close(real);
+}
+
+inline bool
+ThreadedEncoder::Write(const void *data, size_t length, Error &error_r)
+{
+	const ScopeLock protect(mutex);
+
+	while (!input.empty() &&
+	       input.size() + length > THREADED_ENCODER_QUEUE &&
+	       !error.IsDefined())
+		/* the queue is full: wait for the thread to catch
+		   up */
+		client_cond.wait(mutex);
+
+	if (!CheckError(error_r))
+		return false;
+
+	if (input.empty())
+		cond.signal();
+
+	const uint8_t *p = (const uint8_t *)data;
+	input.insert(input.end(), p, p + length);
+	return true;
+}
+
+inline size_t
+ThreadedEncoder::Read(void *dest, size_t length)
+{
+	const ScopeLock protect(mutex);
+
+	const size_t nbytes = std::min(length,
+				       output.size() - output_position);
+	memcpy(dest, output.data() + output_position, nbytes);
+	output_position += nbytes;
+
+	if (output_position == output.size()) {
+		output.clear();
+		output_position = 0;
+	}
+
+	return nbytes;
+}
+
+inline void
+ThreadedEncoder::Run()
+{
+	SetThreadName("encoder");
+
+	/* the thread swaps this buffer with #input, so the client can
+	   continue appending while the thread encodes */
+	std::vector<uint8_t> pending, encoded;
+
+	mutex.lock();
+
+	while (!quit) {
+		if (input.empty() || error.IsDefined()) {
+			cond.wait(mutex);
+			continue;
+		}
+
+		pending.swap(input);
+		busy = true;
+		client_cond.signal();
+		mutex.unlock();
+
+		Error error2;
+		const bool success = encoder_write(real, pending.data(),
+						   pending.size(), error2);
+		if (success)
+			Drain(encoded);
+
+		pending.clear();
+
+		mutex.lock();
+		busy = false;
+
+		if (!success)
+			error = std::move(error2);
+
+		output.insert(output.end(), encoded.begin(), encoded.end());
+		encoded.clear();
+
+		client_cond.signal();
+	}
+
+	mutex.unlock();
+}
+
+void
+ThreadedEncoder::Run(void *ctx)
+{
+	ThreadedEncoder &e = *(ThreadedEncoder *)ctx;
+	e.Run();
+}
+
+Encoder *
+threaded_encoder_init(Encoder *real)
+{
+	ThreadedEncoder *encoder = new ThreadedEncoder(real);
+	return &encoder->encoder;
+}
+
+static void
+threaded_encoder_finish(Encoder *_encoder)
+{
+	ThreadedEncoder *encoder = (ThreadedEncoder *)_encoder;
+
+	delete encoder;
+}
+
+static bool
+threaded_encoder_open(Encoder *_encoder, AudioFormat &audio_format,
+		      Error &error)
+{
+	ThreadedEncoder *encoder = (ThreadedEncoder *)_encoder;
+
+	return encoder->Open(audio_format, error);
+}
+
+static void
+threaded_encoder_close(Encoder *_encoder)
+{
+	ThreadedEncoder *encoder = (ThreadedEncoder *)_encoder;
+
+	encoder->Close();
+}
+
+static bool
+threaded_encoder_end(Encoder *_encoder, Error &error)
+{
+	ThreadedEncoder *encoder = (ThreadedEncoder *)_encoder;
+
+	const ScopeLock protect(encoder->mutex);
+	if (!encoder->Sync(error) || !encoder_end(encoder->real, error))
+		return false;
+
+	encoder->Drain(encoder->output);
+	return true;
+}
+
+static bool
+threaded_encoder_flush(Encoder *_encoder, Error &error)
+{
+	ThreadedEncoder *encoder = (ThreadedEncoder *)_encoder;
+
+	const ScopeLock protect(encoder->mutex);
+	if (!encoder->Sync(error) || !encoder_flush(encoder->real, error))
+		return false;
+
+	encoder->Drain(encoder->output);
+	return true;
+}
+
+static bool
+threaded_encoder_pre_tag(Encoder *_encoder, Error &error)
+{
+	ThreadedEncoder *encoder = (ThreadedEncoder *)_encoder;
+
+	const ScopeLock protect(encoder->mutex);
+	if (!encoder->Sync(error) || !encoder_pre_tag(encoder->real, error))
+		return false;
+
+	/* this also completes the real encoder's pre_tag step, which
+	   ends with encoder_read() */
+	encoder->Drain(encoder->output);
+	return true;
+}
+
+static bool
+threaded_encoder_tag(Encoder *_encoder, const Tag *tag, Error &error)
+{
+	ThreadedEncoder *encoder = (ThreadedEncoder *)_encoder;
+
+	const ScopeLock protect(encoder->mutex);
+	if (!encoder->Sync(error) ||
+	    !encoder_tag(encoder->real, tag, error))
+		return false;
+
+	encoder->Drain(encoder->output);
+	return true;
+}
+
+static bool
+threaded_encoder_write(Encoder *_encoder, const void *data, size_t length,
+		       Error &error)
+{
+	ThreadedEncoder *encoder = (ThreadedEncoder *)_encoder;
+
+	return encoder->Write(data, length, error);
+}
+
+static size_t
+threaded_encoder_read(Encoder *_encoder, void *dest, size_t length)
+{
+	ThreadedEncoder *encoder = (ThreadedEncoder *)_encoder;
+
+	return encoder->Read(dest, length);
+}
+
+static const char *
+threaded_encoder_get_mime_type(Encoder *_encoder)
+{
+	ThreadedEncoder *encoder = (ThreadedEncoder *)_encoder;
+
+	return encoder_get_mime_type(encoder->real);
+}
+
+const EncoderPlugin threaded_encoder_plugin = {
+	"threaded",
+	/* objects are created by threaded_encoder_init() */
+	nullptr,
+	threaded_encoder_finish,
+	threaded_encoder_open,
+	threaded_encoder_close,
+	threaded_encoder_end,
+	threaded_encoder_flush,
+	nullptr,
+	nullptr,
+	threaded_encoder_write,
+	threaded_encoder_read,
+	threaded_encoder_get_mime_type,
+	nullptr,
+};
+
+const EncoderPlugin threaded_tag_encoder_plugin = {
+	"threaded",
+	nullptr,
+	threaded_encoder_finish,
+	threaded_encoder_open,
+	threaded_encoder_close,
+	threaded_encoder_end,
+	threaded_encoder_flush,
+	threaded_encoder_pre_tag,
+	threaded_encoder_tag,
+	threaded_encoder_write,
+	threaded_encoder_read,
+	threaded_encoder_get_mime_type,
+	nullptr,
+};
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_THREADED_ENCODER_HXX
+#define MPD_THREADED_ENCODER_HXX
+
+#include "EncoderPlugin.hxx"
+#include "Compiler.h"
+
+extern const EncoderPlugin threaded_encoder_plugin;
+
+/**
+ * Like #threaded_encoder_plugin, for real encoders which support
+ * tags.
+ */
+extern const EncoderPlugin threaded_tag_encoder_plugin;
+
+/**
+ * Creates an encoder object which runs the given encoder in a
+ * separate thread (one per object).  encoder_write() only copies the
+ * PCM data to a bounded queue, and encoder_read() returns whatever
+ * the thread has produced so far; this overlaps encoding with the
+ * output's own work, and lets the encoders of several outputs run
+ * on different CPU cores.
+ *
+ * The other methods (flush, end, tags) wait until the queue is
+ * empty, and then call the real encoder directly.  Errors of the
+ * thread are reported by the next method call.
+ *
+ * @param encoder the real encoder; it is owned by the new object
+ */
+Encoder *
+threaded_encoder_init(Encoder *encoder);
+
+/**
+ * Was this object created by threaded_encoder_init()?
+ */
+gcc_pure
+static inline bool
+encoder_is_threaded(const Encoder *encoder)
+{
+	return &encoder->plugin == &threaded_encoder_plugin ||
+		&encoder->plugin == &threaded_tag_encoder_plugin;
+}
+
+#endif
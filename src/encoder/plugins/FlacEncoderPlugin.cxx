@@ -27,6 +27,7 @@
 #include "util/DynamicFifoBuffer.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
+#include "Log.hxx"
 
 #include <FLAC/stream_encoder.h>
 
@@ -34,14 +35,38 @@
 #error libFLAC is too old
 #endif
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+
 struct flac_encoder {
 	Encoder encoder;
 
 	AudioFormat audio_format;
 	unsigned compression;
 
+	/**
+	 * The number of libFLAC threads encoding frames in parallel.
+	 */
+	unsigned threads;
+
 	FLAC__StreamEncoder *fse;
 
+	/**
+	 * The libFLAC block size; the input is passed to
+	 * FLAC__stream_encoder_process() in pieces of at most this
+	 * many frames.
+	 */
+	unsigned block_frames;
+
+	/**
+	 * The sign-extended samples of one block, one array per
+	 * channel (pointing into #expand_buffer).
+	 */
+	FLAC__int32 *channel_buffers[MAX_CHANNELS];
+
 	PcmBuffer expand_buffer;
 
 	/**
@@ -57,10 +82,22 @@ static constexpr Domain flac_encoder_domain("vorbis_encoder");
 
 static bool
 flac_encoder_configure(struct flac_encoder *encoder, const config_param &param,
-		       gcc_unused Error &error)
+		       Error &error)
 {
 	encoder->compression = param.GetBlockValue("compression", 5u);
 
+	encoder->threads = param.GetBlockValue("threads", 1u);
+	if (encoder->threads == 0) {
+		error.Set(config_domain, "Invalid number of threads");
+		return false;
+	}
+
+#if FLAC_API_VERSION_CURRENT < 14
+	if (encoder->threads > 1)
+		LogWarning(flac_encoder_domain,
+			   "This libFLAC version does not support threads");
+#endif
+
 	return true;
 }
 
@@ -122,6 +159,21 @@ flac_encoder_setup(struct flac_encoder *encoder, unsigned bits_per_sample,
 			     encoder->audio_format.sample_rate);
 		return false;
 	}
+
+#if FLAC_API_VERSION_CURRENT >= 14
+	if (encoder->threads > 1) {
+		/* libFLAC may have been built without threads; that
+		   is not fatal */
+		const FLAC__uint32 result =
+			FLAC__stream_encoder_set_num_threads(encoder->fse,
+							     encoder->threads);
+		if (result != FLAC__STREAM_ENCODER_SET_NUM_THREADS_OK)
+			FormatWarning(flac_encoder_domain,
+				      "failed to enable %u flac threads: %u",
+				      encoder->threads, unsigned(result));
+	}
+#endif
+
 	return true;
 }
 
@@ -210,6 +262,14 @@ flac_encoder_open(Encoder *_encoder, AudioFormat &audio_format, Error &error)
 		}
 	}
 
+	encoder->block_frames = FLAC__stream_encoder_get_blocksize(encoder->fse);
+
+	FLAC__int32 *p = encoder->expand_buffer.GetT<FLAC__int32>(encoder->block_frames *
+								  audio_format.channels);
+	for (unsigned i = 0; i < audio_format.channels;
+	     ++i, p += encoder->block_frames)
+		encoder->channel_buffers[i] = p;
+
 	return true;
 }
 
@@ -223,72 +283,101 @@ flac_encoder_flush(Encoder *_encoder, gcc_unused Error &error)
 	return true;
 }
 
-static inline void
-pcm8_to_flac(int32_t *out, const int8_t *in, unsigned num_samples)
+/**
+ * Sign-extend and deinterleave @n frames into one array per channel,
+ * which is what libFLAC works with internally;
+ * FLAC__stream_encoder_process_interleaved() would have to do the
+ * same sample by sample.
+ */
+template<typename T>
+static void
+flac_deinterleave(FLAC__int32 *const*dest, const T *src, unsigned n,
+		  unsigned channels)
 {
-	while (num_samples > 0) {
-		*out++ = *in++;
-		--num_samples;
-	}
+	for (unsigned i = 0; i < n; ++i)
+		for (unsigned c = 0; c < channels; ++c)
+			dest[c][i] = *src++;
 }
 
-static inline void
-pcm16_to_flac(int32_t *out, const int16_t *in, unsigned num_samples)
+static void
+flac_deinterleave_16(FLAC__int32 *const*dest, const int16_t *src,
+		     unsigned n, unsigned channels)
 {
-	while (num_samples > 0) {
-		*out++ = *in++;
-		--num_samples;
+#ifdef __SSE2__
+	if (channels == 2) {
+		FLAC__int32 *left = dest[0], *right = dest[1];
+
+		/* each 32 bit lane holds one frame: the left sample
+		   in its low half, the right one in its high half */
+		for (; n >= 4; n -= 4, src += 8, left += 4, right += 4) {
+			const __m128i x = _mm_loadu_si128((const __m128i *)src);
+			_mm_storeu_si128((__m128i *)left,
+					 _mm_srai_epi32(_mm_slli_epi32(x, 16), 16));
+			_mm_storeu_si128((__m128i *)right,
+					 _mm_srai_epi32(x, 16));
+		}
+
+		for (; n > 0; --n) {
+			*left++ = *src++;
+			*right++ = *src++;
+		}
+
+		return;
 	}
+#endif
+
+	flac_deinterleave(dest, src, n, channels);
 }
 
 static bool
 flac_encoder_write(Encoder *_encoder,
 		   const void *data, size_t length,
-		   gcc_unused Error &error)
+		   Error &error)
 {
 	struct flac_encoder *encoder = (struct flac_encoder *)_encoder;
-	unsigned num_frames, num_samples;
-	void *exbuffer;
-	const void *buffer = nullptr;
-
-	/* format conversion */
-
-	num_frames = length / encoder->audio_format.GetFrameSize();
-	num_samples = num_frames * encoder->audio_format.channels;
-
-	switch (encoder->audio_format.format) {
-	case SampleFormat::S8:
-		exbuffer = encoder->expand_buffer.Get(length * 4);
-		pcm8_to_flac((int32_t *)exbuffer, (const int8_t *)data,
-			     num_samples);
-		buffer = exbuffer;
-		break;
+	const unsigned channels = encoder->audio_format.channels;
+	const size_t frame_size = encoder->audio_format.GetFrameSize();
+	const uint8_t *src = (const uint8_t *)data;
+	unsigned num_frames = length / frame_size;
+
+	while (num_frames > 0) {
+		/* convert one block at a time into the same buffer,
+		   no matter how large the input is */
+		const unsigned n = std::min(num_frames, encoder->block_frames);
+
+		switch (encoder->audio_format.format) {
+		case SampleFormat::S8:
+			flac_deinterleave(encoder->channel_buffers,
+					  (const int8_t *)src, n, channels);
+			break;
+
+		case SampleFormat::S16:
+			flac_deinterleave_16(encoder->channel_buffers,
+					     (const int16_t *)src, n, channels);
+			break;
+
+		case SampleFormat::S24_P32:
+		case SampleFormat::S32:
+			flac_deinterleave(encoder->channel_buffers,
+					  (const int32_t *)src, n, channels);
+			break;
+
+		default:
+			gcc_unreachable();
+		}
 
-	case SampleFormat::S16:
-		exbuffer = encoder->expand_buffer.Get(length * 2);
-		pcm16_to_flac((int32_t *)exbuffer, (const int16_t *)data,
-			      num_samples);
-		buffer = exbuffer;
-		break;
+		/* feed samples to encoder */
 
-	case SampleFormat::S24_P32:
-	case SampleFormat::S32:
-		/* nothing need to be done; format is the same for
-		   both mpd and libFLAC */
-		buffer = data;
-		break;
-
-	default:
-		gcc_unreachable();
-	}
-
-	/* feed samples to encoder */
+		if (!FLAC__stream_encoder_process(encoder->fse,
+						  encoder->channel_buffers,
+						  n)) {
+			error.Set(flac_encoder_domain,
+				  "flac encoder process failed");
+			return false;
+		}
 
-	if (!FLAC__stream_encoder_process_interleaved(encoder->fse,
-						      (const FLAC__int32 *)buffer,
-						      num_frames)) {
-		error.Set(flac_encoder_domain, "flac encoder process failed");
-		return false;
+		src += n * frame_size;
+		num_frames -= n;
 	}
 
 	return true;
@@ -321,5 +410,6 @@ const EncoderPlugin flac_encoder_plugin = {
 	flac_encoder_write,
 	flac_encoder_read,
 	flac_encoder_get_mime_type,
+	nullptr,
 };
 
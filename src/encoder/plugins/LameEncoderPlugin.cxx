@@ -290,4 +290,5 @@ const EncoderPlugin lame_encoder_plugin = {
 	lame_encoder_write,
 	lame_encoder_read,
 	lame_encoder_get_mime_type,
+	nullptr,
 };
@@ -89,6 +89,12 @@ null_encoder_read(Encoder *_encoder, void *dest, size_t length)
 	return encoder->buffer->Read((uint8_t *)dest, length);
 }
 
+static bool
+null_encoder_is_passthrough(gcc_unused const Encoder *encoder)
+{
+	return true;
+}
+
 const EncoderPlugin null_encoder_plugin = {
 	"null",
 	null_encoder_init,
@@ -102,4 +108,5 @@ const EncoderPlugin null_encoder_plugin = {
 	null_encoder_write,
 	null_encoder_read,
 	nullptr,
+	null_encoder_is_passthrough,
 };
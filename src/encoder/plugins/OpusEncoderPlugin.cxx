@@ -27,9 +27,11 @@
 #include "util/Alloc.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
+#include "util/NumberParser.hxx"
 #include "system/ByteOrder.hxx"
 
 #include <opus.h>
+#include <opus_multistream.h>
 #include <ogg/ogg.h>
 
 #include <assert.h>
@@ -44,6 +46,18 @@ struct opus_encoder {
 	opus_int32 bitrate;
 	int complexity;
 	int signal;
+	int application;
+
+	/**
+	 * The duration of one Opus packet in samples (at 48 kHz).
+	 */
+	unsigned packet_frames;
+
+	/**
+	 * Flush the Ogg page after this number of packets.  0 lets
+	 * libogg decide (about 4 kB per page).
+	 */
+	unsigned packets_per_page;
 
 	/* runtime information */
 
@@ -54,9 +68,20 @@ struct opus_encoder {
 	size_t buffer_frames, buffer_size, buffer_position;
 	uint8_t *buffer;
 
-	OpusEncoder *enc;
+	OpusMSEncoder *enc;
+
+	int streams, coupled_streams;
+	unsigned char mapping[MAX_CHANNELS];
+
+	/**
+	 * Translates MPD's (WAVE) channel order to the Vorbis channel
+	 * order required by mapping family 1.  nullptr if the
+	 * channels can be passed as-is.
+	 */
+	const unsigned char *reorder;
 
-	unsigned char buffer2[1275 * 3 + 7];
+	size_t packet_size;
+	unsigned char *packet_buffer;
 
 	OggStream stream;
 
@@ -66,11 +91,43 @@ struct opus_encoder {
 
 	ogg_int64_t granulepos;
 
+	unsigned page_packets;
+
 	opus_encoder():encoder(opus_encoder_plugin) {}
 };
 
 static constexpr Domain opus_encoder_domain("opus_encoder");
 
+/**
+ * The maximum size of an Opus packet of up to 60 ms, per stream.
+ */
+static constexpr size_t OPUS_MAX_PACKET_SIZE = 1275 * 3 + 7;
+
+/**
+ * Maps the Vorbis channel position (index) to the MPD/WAVE channel
+ * (value), indexed by the number of channels.
+ */
+static constexpr unsigned char opus_reorder[MAX_CHANNELS + 1][MAX_CHANNELS] = {
+	{},
+	{},
+	{},
+	{ 0, 2, 1 },
+	{ 0, 1, 2, 3 },
+	{ 0, 2, 1, 3, 4 },
+	{ 0, 2, 1, 4, 5, 3 },
+	{ 0, 2, 1, 5, 6, 4, 3 },
+	{ 0, 2, 1, 6, 7, 4, 5, 3 },
+};
+
+gcc_const
+static bool
+opus_valid_packet_frames(unsigned frames)
+{
+	/* 2.5, 5, 10, 20, 40 or 60 ms */
+	return frames == 120 || frames == 240 || frames == 480 ||
+		frames == 960 || frames == 1920 || frames == 2880;
+}
+
 static bool
 opus_encoder_configure(struct opus_encoder *encoder,
 		       const config_param &param, Error &error)
@@ -108,6 +165,33 @@ opus_encoder_configure(struct opus_encoder *encoder,
 		return false;
 	}
 
+	value = param.GetBlockValue("application", "audio");
+	if (strcmp(value, "audio") == 0)
+		encoder->application = OPUS_APPLICATION_AUDIO;
+	else if (strcmp(value, "voip") == 0)
+		encoder->application = OPUS_APPLICATION_VOIP;
+	else if (strcmp(value, "lowdelay") == 0)
+		encoder->application = OPUS_APPLICATION_RESTRICTED_LOWDELAY;
+	else {
+		error.Format(config_domain, "Invalid application: %s", value);
+		return false;
+	}
+
+	value = param.GetBlockValue("frame_duration", "20");
+	char *endptr;
+	const double frame_duration = ParseDouble(value, &endptr);
+	encoder->packet_frames = unsigned(frame_duration * 48 + 0.5);
+	if (endptr == value || *endptr != 0 ||
+	    !opus_valid_packet_frames(encoder->packet_frames)) {
+		error.Format(config_domain,
+			     "Invalid frame duration: %s (must be one of 2.5, 5, 10, 20, 40, 60)",
+			     value);
+		return false;
+	}
+
+	encoder->packets_per_page =
+		param.GetBlockValue("packets_per_page", 0u);
+
 	return true;
 }
 
@@ -146,9 +230,6 @@ opus_encoder_open(Encoder *_encoder,
 	/* libopus supports only 48 kHz */
 	audio_format.sample_rate = 48000;
 
-	if (audio_format.channels > 2)
-		audio_format.channels = 1;
-
 	switch (audio_format.format) {
 	case SampleFormat::S16:
 	case SampleFormat::FLOAT:
@@ -166,31 +247,54 @@ opus_encoder_open(Encoder *_encoder,
 	encoder->audio_format = audio_format;
 	encoder->frame_size = audio_format.GetFrameSize();
 
+	/* mapping family 0 is mono/stereo in a single stream;
+	   family 1 splits up to 8 channels (Vorbis order) into
+	   multiple streams */
+	const int mapping_family = audio_format.channels > 2 ? 1 : 0;
+
 	int error_code;
-	encoder->enc = opus_encoder_create(audio_format.sample_rate,
-					   audio_format.channels,
-					   OPUS_APPLICATION_AUDIO,
-					   &error_code);
+	encoder->enc =
+		opus_multistream_surround_encoder_create(audio_format.sample_rate,
+							 audio_format.channels,
+							 mapping_family,
+							 &encoder->streams,
+							 &encoder->coupled_streams,
+							 encoder->mapping,
+							 encoder->application,
+							 &error_code);
 	if (encoder->enc == nullptr) {
 		error.Set(opus_encoder_domain, error_code,
 			  opus_strerror(error_code));
 		return false;
 	}
 
-	opus_encoder_ctl(encoder->enc, OPUS_SET_BITRATE(encoder->bitrate));
-	opus_encoder_ctl(encoder->enc,
-			 OPUS_SET_COMPLEXITY(encoder->complexity));
-	opus_encoder_ctl(encoder->enc, OPUS_SET_SIGNAL(encoder->signal));
+	encoder->reorder = mapping_family == 1
+		? opus_reorder[audio_format.channels]
+		: nullptr;
 
-	opus_encoder_ctl(encoder->enc, OPUS_GET_LOOKAHEAD(&encoder->lookahead));
+	opus_multistream_encoder_ctl(encoder->enc,
+				     OPUS_SET_BITRATE(encoder->bitrate));
+	opus_multistream_encoder_ctl(encoder->enc,
+				     OPUS_SET_COMPLEXITY(encoder->complexity));
+	opus_multistream_encoder_ctl(encoder->enc,
+				     OPUS_SET_SIGNAL(encoder->signal));
 
-	encoder->buffer_frames = audio_format.sample_rate / 50;
+	opus_multistream_encoder_ctl(encoder->enc,
+				     OPUS_GET_LOOKAHEAD(&encoder->lookahead));
+
+	encoder->buffer_frames = encoder->packet_frames;
 	encoder->buffer_size = encoder->frame_size * encoder->buffer_frames;
 	encoder->buffer_position = 0;
 	encoder->buffer = (unsigned char *)xalloc(encoder->buffer_size);
 
+	encoder->packet_size = OPUS_MAX_PACKET_SIZE * encoder->streams;
+	encoder->packet_buffer =
+		(unsigned char *)xalloc(encoder->packet_size);
+
 	encoder->stream.Initialize(GenerateOggSerial());
 	encoder->packetno = 0;
+	encoder->granulepos = 0;
+	encoder->page_packets = 0;
 
 	return true;
 }
@@ -201,28 +305,31 @@ opus_encoder_close(Encoder *_encoder)
 	struct opus_encoder *encoder = (struct opus_encoder *)_encoder;
 
 	encoder->stream.Deinitialize();
+	free(encoder->packet_buffer);
 	free(encoder->buffer);
-	opus_encoder_destroy(encoder->enc);
+	opus_multistream_encoder_destroy(encoder->enc);
 }
 
+/**
+ * Encode one packet of #buffer_frames frames from the specified
+ * buffer (which is either #buffer or the caller's input).
+ */
 static bool
-opus_encoder_do_encode(struct opus_encoder *encoder, bool eos,
-		       Error &error)
+opus_encoder_encode_packet(struct opus_encoder *encoder, const void *pcm,
+			   bool eos, Error &error)
 {
-	assert(encoder->buffer_position == encoder->buffer_size);
-
 	opus_int32 result =
 		encoder->audio_format.format == SampleFormat::S16
-		? opus_encode(encoder->enc,
-			      (const opus_int16 *)encoder->buffer,
-			      encoder->buffer_frames,
-			      encoder->buffer2,
-			      sizeof(encoder->buffer2))
-		: opus_encode_float(encoder->enc,
-				    (const float *)encoder->buffer,
-				    encoder->buffer_frames,
-				    encoder->buffer2,
-				    sizeof(encoder->buffer2));
+		? opus_multistream_encode(encoder->enc,
+					  (const opus_int16 *)pcm,
+					  encoder->buffer_frames,
+					  encoder->packet_buffer,
+					  encoder->packet_size)
+		: opus_multistream_encode_float(encoder->enc,
+						(const float *)pcm,
+						encoder->buffer_frames,
+						encoder->packet_buffer,
+						encoder->packet_size);
 	if (result < 0) {
 		error.Set(opus_encoder_domain, "Opus encoder error");
 		return false;
@@ -231,7 +338,7 @@ opus_encoder_do_encode(struct opus_encoder *encoder, bool eos,
 	encoder->granulepos += encoder->buffer_frames;
 
 	ogg_packet packet;
-	packet.packet = encoder->buffer2;
+	packet.packet = encoder->packet_buffer;
 	packet.bytes = result;
 	packet.b_o_s = false;
 	packet.e_o_s = eos;
@@ -239,11 +346,56 @@ opus_encoder_do_encode(struct opus_encoder *encoder, bool eos,
 	packet.packetno = encoder->packetno++;
 	encoder->stream.PacketIn(packet);
 
-	encoder->buffer_position = 0;
+	if (encoder->packets_per_page > 0 &&
+	    ++encoder->page_packets >= encoder->packets_per_page) {
+		encoder->stream.Flush();
+		encoder->page_packets = 0;
+	}
 
 	return true;
 }
 
+static bool
+opus_encoder_do_encode(struct opus_encoder *encoder, bool eos,
+		       Error &error)
+{
+	assert(encoder->buffer_position == encoder->buffer_size);
+
+	encoder->buffer_position = 0;
+	return opus_encoder_encode_packet(encoder, encoder->buffer, eos,
+					  error);
+}
+
+/**
+ * Copy frames into #buffer, translating the channel order if
+ * necessary.
+ */
+static void
+opus_encoder_copy(struct opus_encoder *encoder, const uint8_t *src,
+		  size_t nbytes)
+{
+	uint8_t *dest = encoder->buffer + encoder->buffer_position;
+	encoder->buffer_position += nbytes;
+
+	if (encoder->reorder == nullptr) {
+		memcpy(dest, src, nbytes);
+		return;
+	}
+
+	/* the buffer holds whole frames, and so does the input
+	   (MPD never splits a frame) */
+	assert(nbytes % encoder->frame_size == 0);
+
+	const unsigned channels = encoder->audio_format.channels;
+	const size_t sample_size = encoder->frame_size / channels;
+
+	for (const uint8_t *end = src + nbytes; src != end;
+	     src += encoder->frame_size)
+		for (unsigned i = 0; i < channels; ++i, dest += sample_size)
+			memcpy(dest, src + encoder->reorder[i] * sample_size,
+			       sample_size);
+}
+
 static bool
 opus_encoder_end(Encoder *_encoder, Error &error)
 {
@@ -314,16 +466,28 @@ opus_encoder_write(Encoder *_encoder,
 	}
 
 	while (length > 0) {
+		if (encoder->buffer_position == 0 &&
+		    encoder->reorder == nullptr &&
+		    length >= encoder->buffer_size) {
+			/* encode full packets straight from the
+			   caller's buffer */
+			if (!opus_encoder_encode_packet(encoder, data, false,
+							error))
+				return false;
+
+			data += encoder->buffer_size;
+			length -= encoder->buffer_size;
+			continue;
+		}
+
 		size_t nbytes =
 			encoder->buffer_size - encoder->buffer_position;
 		if (nbytes > length)
 			nbytes = length;
 
-		memcpy(encoder->buffer + encoder->buffer_position,
-		       data, nbytes);
+		opus_encoder_copy(encoder, data, nbytes);
 		data += nbytes;
 		length -= nbytes;
-		encoder->buffer_position += nbytes;
 
 		if (encoder->buffer_position == encoder->buffer_size &&
 		    !opus_encoder_do_encode(encoder, false, error))
@@ -336,20 +500,32 @@ opus_encoder_write(Encoder *_encoder,
 static void
 opus_encoder_generate_head(struct opus_encoder *encoder)
 {
-	unsigned char header[19];
+	const unsigned channels = encoder->audio_format.channels;
+
+	unsigned char header[21 + MAX_CHANNELS];
+	size_t header_size = 19;
 	memcpy(header, "OpusHead", 8);
 	header[8] = 1;
-	header[9] = encoder->audio_format.channels;
+	header[9] = channels;
 	*(uint16_t *)(header + 10) = ToLE16(encoder->lookahead);
 	*(uint32_t *)(header + 12) =
 		ToLE32(encoder->audio_format.sample_rate);
 	header[16] = 0;
 	header[17] = 0;
-	header[18] = 0;
+
+	if (channels > 2) {
+		/* channel mapping family 1 with the mapping table */
+		header[18] = 1;
+		header[19] = encoder->streams;
+		header[20] = encoder->coupled_streams;
+		memcpy(header + 21, encoder->mapping, channels);
+		header_size = 21 + channels;
+	} else
+		header[18] = 0;
 
 	ogg_packet packet;
 	packet.packet = header;
-	packet.bytes = 19;
+	packet.bytes = header_size;
 	packet.b_o_s = true;
 	packet.e_o_s = false;
 	packet.granulepos = 0;
@@ -416,4 +592,5 @@ const EncoderPlugin opus_encoder_plugin = {
 	opus_encoder_write,
 	opus_encoder_read,
 	opus_encoder_get_mime_type,
+	nullptr,
 };
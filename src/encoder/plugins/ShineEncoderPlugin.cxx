@@ -268,4 +268,5 @@ const EncoderPlugin shine_encoder_plugin = {
 	shine_encoder_write,
 	shine_encoder_read,
 	shine_encoder_get_mime_type,
+	nullptr,
 };
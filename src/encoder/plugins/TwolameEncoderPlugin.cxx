@@ -311,4 +311,5 @@ const EncoderPlugin twolame_encoder_plugin = {
 	twolame_encoder_write,
 	twolame_encoder_read,
 	twolame_encoder_get_mime_type,
+	nullptr,
 };
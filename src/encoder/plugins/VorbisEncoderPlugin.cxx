@@ -33,6 +33,12 @@
 
 #include <glib.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+
 struct vorbis_encoder {
 	/** the base class */
 	Encoder encoder;
@@ -42,10 +48,22 @@ struct vorbis_encoder {
 	float quality;
 	int bitrate;
 
+	/**
+	 * Collect this many frames before passing them to the
+	 * analysis with vorbis_analysis_wrote().
+	 */
+	unsigned analysis_frames;
+
 	/* runtime information */
 
 	AudioFormat audio_format;
 
+	/**
+	 * The number of frames which have been copied to
+	 * vorbis_analysis_buffer(), but not yet submitted.
+	 */
+	unsigned pending_frames;
+
 	vorbis_dsp_state vd;
 	vorbis_block vb;
 	vorbis_info vi;
@@ -103,6 +121,9 @@ vorbis_encoder_configure(struct vorbis_encoder *encoder,
 		}
 	}
 
+	encoder->analysis_frames = param.GetBlockValue("analysis_frames",
+						       1024u);
+
 	return true;
 }
 
@@ -165,6 +186,7 @@ vorbis_encoder_reinit(struct vorbis_encoder *encoder, Error &error)
 	vorbis_analysis_init(&encoder->vd, &encoder->vi);
 	vorbis_block_init(&encoder->vd, &encoder->vb);
 	encoder->stream.Initialize(GenerateOggSerial());
+	encoder->pending_frames = 0;
 
 	return true;
 }
@@ -241,11 +263,27 @@ vorbis_encoder_blockout(struct vorbis_encoder *encoder)
 	}
 }
 
+/**
+ * Submit the pending frames to the analysis.
+ */
+static void
+vorbis_encoder_commit(struct vorbis_encoder *encoder)
+{
+	/* 0 would mean "end of stream" */
+	if (encoder->pending_frames == 0)
+		return;
+
+	vorbis_analysis_wrote(&encoder->vd, encoder->pending_frames);
+	encoder->pending_frames = 0;
+	vorbis_encoder_blockout(encoder);
+}
+
 static bool
 vorbis_encoder_flush(Encoder *_encoder, gcc_unused Error &error)
 {
 	struct vorbis_encoder *encoder = (struct vorbis_encoder *)_encoder;
 
+	vorbis_encoder_commit(encoder);
 	encoder->stream.Flush();
 	return true;
 }
@@ -255,6 +293,7 @@ vorbis_encoder_pre_tag(Encoder *_encoder, gcc_unused Error &error)
 {
 	struct vorbis_encoder *encoder = (struct vorbis_encoder *)_encoder;
 
+	vorbis_encoder_commit(encoder);
 	vorbis_analysis_wrote(&encoder->vd, 0);
 	vorbis_encoder_blockout(encoder);
 
@@ -303,13 +342,47 @@ vorbis_encoder_tag(Encoder *_encoder, const Tag *tag,
 	return true;
 }
 
+/**
+ * Deinterleave into the buffers returned by
+ * vorbis_analysis_buffer(), starting at the given frame offset.
+ */
 static void
-interleaved_to_vorbis_buffer(float **dest, const float *src,
+interleaved_to_vorbis_buffer(float **dest, unsigned offset,
+			     const float *src,
 			     unsigned num_frames, unsigned num_channels)
 {
+	if (num_channels == 1) {
+		std::copy_n(src, num_frames, dest[0] + offset);
+		return;
+	}
+
+#ifdef __SSE2__
+	if (num_channels == 2) {
+		float *left = dest[0] + offset, *right = dest[1] + offset;
+
+		/* split four stereo frames at a time */
+		for (; num_frames >= 4; num_frames -= 4, src += 8,
+			     left += 4, right += 4) {
+			const __m128 a = _mm_loadu_ps(src);
+			const __m128 b = _mm_loadu_ps(src + 4);
+			_mm_storeu_ps(left,
+				      _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(right,
+				      _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+
+		for (; num_frames > 0; --num_frames) {
+			*left++ = *src++;
+			*right++ = *src++;
+		}
+
+		return;
+	}
+#endif
+
 	for (unsigned i = 0; i < num_frames; i++)
 		for (unsigned j = 0; j < num_channels; j++)
-			dest[j][i] = *src++;
+			dest[j][offset + i] = *src++;
 }
 
 static bool
@@ -321,16 +394,22 @@ vorbis_encoder_write(Encoder *_encoder,
 
 	unsigned num_frames = length / encoder->audio_format.GetFrameSize();
 
-	/* this is for only 16-bit audio */
+	/* append to the frames which are already in libvorbis's
+	   buffer; vorbis_analysis_buffer() preserves them, because
+	   it only grows the buffer beyond the submitted data */
 
-	interleaved_to_vorbis_buffer(vorbis_analysis_buffer(&encoder->vd,
-							    num_frames),
+	float **buffer =
+		vorbis_analysis_buffer(&encoder->vd,
+				       encoder->pending_frames + num_frames);
+	interleaved_to_vorbis_buffer(buffer, encoder->pending_frames,
 				     (const float *)data,
 				     num_frames,
 				     encoder->audio_format.channels);
+	encoder->pending_frames += num_frames;
+
+	if (encoder->pending_frames >= encoder->analysis_frames)
+		vorbis_encoder_commit(encoder);
 
-	vorbis_analysis_wrote(&encoder->vd, num_frames);
-	vorbis_encoder_blockout(encoder);
 	return true;
 }
 
@@ -361,4 +440,5 @@ const EncoderPlugin vorbis_encoder_plugin = {
 	vorbis_encoder_write,
 	vorbis_encoder_read,
 	vorbis_encoder_get_mime_type,
+	nullptr,
 };
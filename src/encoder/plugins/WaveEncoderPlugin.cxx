@@ -243,6 +243,15 @@ wave_encoder_read(Encoder *_encoder, void *dest, size_t length)
 	return encoder->buffer->Read((uint8_t *)dest, length);
 }
 
+static bool
+wave_encoder_is_passthrough(const Encoder *_encoder)
+{
+	const WaveEncoder *encoder = (const WaveEncoder *)_encoder;
+
+	/* see wave_encoder_write() */
+	return IsLittleEndian() && encoder->bits != 24;
+}
+
 static const char *
 wave_encoder_get_mime_type(gcc_unused Encoder *_encoder)
 {
@@ -262,4 +271,5 @@ const EncoderPlugin wave_encoder_plugin = {
 	wave_encoder_write,
 	wave_encoder_read,
 	wave_encoder_get_mime_type,
+	wave_encoder_is_passthrough,
 };
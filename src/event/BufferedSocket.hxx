@@ -39,6 +39,9 @@ class BufferedSocket : protected SocketMonitor {
 public:
 	BufferedSocket(int _fd, EventLoop &_loop)
 		:SocketMonitor(_fd, _loop) {
+		/* all I/O goes through SocketMonitor::Read() and
+		   SocketMonitor::Write() */
+		SetEdgeTriggered();
 		ScheduleRead();
 	}
 
@@ -21,6 +21,16 @@
 #include "DeferredMonitor.hxx"
 #include "Loop.hxx"
 
+DeferredMonitor::~DeferredMonitor()
+{
+	Cancel();
+
+	/* always ask the EventLoop (even if #queued appears to be
+	   clear), because HandleDeferred() may still be looking at
+	   this object */
+	loop.PurgeDeferred(*this);
+}
+
 void
 DeferredMonitor::Cancel()
 {
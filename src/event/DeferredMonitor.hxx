@@ -36,15 +36,32 @@ class DeferredMonitor {
 	EventLoop &loop;
 
 	friend class EventLoop;
-	bool pending;
+
+	/**
+	 * The next element in the EventLoop's deferred queue.  Only
+	 * valid while #queued is set.
+	 */
+	DeferredMonitor *next;
+
+	/**
+	 * Shall RunDeferred() be called?  Cleared by Cancel() and
+	 * right before RunDeferred() is invoked.
+	 */
+	std::atomic<bool> pending;
+
+	/**
+	 * Is this object linked into the EventLoop's deferred queue?
+	 * After Cancel(), it stays there (with #pending cleared)
+	 * until the EventLoop removes it, and Schedule() only sets
+	 * #pending again.
+	 */
+	std::atomic<bool> queued;
 
 public:
 	DeferredMonitor(EventLoop &_loop)
-		:loop(_loop), pending(false) {}
+		:loop(_loop), pending(false), queued(false) {}
 
-	~DeferredMonitor() {
-		Cancel();
-	}
+	~DeferredMonitor();
 
 	EventLoop &GetEventLoop() {
 		return loop;
@@ -31,12 +31,12 @@
 #ifndef WIN32
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #endif
 
 FullyBufferedSocket::ssize_t
-FullyBufferedSocket::DirectWrite(const void *data, size_t length)
+FullyBufferedSocket::HandleWriteResult(ssize_t nbytes)
 {
-	const auto nbytes = SocketMonitor::Write((const char *)data, length);
 	if (gcc_unlikely(nbytes < 0)) {
 		const auto code = GetSocketError();
 		if (IsSocketErrorAgain(code))
@@ -54,11 +54,19 @@ FullyBufferedSocket::DirectWrite(const void *data, size_t length)
 	return nbytes;
 }
 
+FullyBufferedSocket::ssize_t
+FullyBufferedSocket::DirectWrite(const void *data, size_t length)
+{
+	return HandleWriteResult(SocketMonitor::Write((const char *)data,
+						      length));
+}
+
 bool
 FullyBufferedSocket::Flush()
 {
 	assert(IsDefined());
 
+#ifdef WIN32
 	const auto data = output.Read();
 	if (data.IsEmpty()) {
 		IdleMonitor::Cancel();
@@ -67,6 +75,25 @@ FullyBufferedSocket::Flush()
 	}
 
 	auto nbytes = DirectWrite(data.data, data.size);
+#else
+	/* send the normal and the peak buffer with one system
+	   call */
+	ConstBuffer<void> buffers[2];
+	const unsigned n = output.ReadV(buffers);
+	if (n == 0) {
+		IdleMonitor::Cancel();
+		CancelWrite();
+		return true;
+	}
+
+	struct iovec iov[2];
+	for (unsigned i = 0; i < n; ++i) {
+		iov[i].iov_base = const_cast<void *>(buffers[i].data);
+		iov[i].iov_len = buffers[i].size;
+	}
+
+	auto nbytes = HandleWriteResult(SocketMonitor::Write(iov, n));
+#endif
 	if (gcc_unlikely(nbytes <= 0))
 		return nbytes == 0;
 
@@ -104,6 +131,70 @@ FullyBufferedSocket::Write(const void *data, size_t length)
 	return true;
 }
 
+bool
+FullyBufferedSocket::WriteV(const ConstBuffer<void> *buffers, unsigned n)
+{
+	assert(IsDefined());
+
+	size_t skip = 0;
+
+#ifndef WIN32
+	static constexpr unsigned MAX_IOV = 8;
+	assert(n <= MAX_IOV);
+
+	if (output.IsEmpty()) {
+		struct iovec iov[MAX_IOV];
+		size_t total = 0;
+		for (unsigned i = 0; i < n; ++i) {
+			iov[i].iov_base = const_cast<void *>(buffers[i].data);
+			iov[i].iov_len = buffers[i].size;
+			total += buffers[i].size;
+		}
+
+		if (total == 0)
+			return true;
+
+		const auto nbytes =
+			HandleWriteResult(SocketMonitor::Write(iov, n));
+		if (gcc_unlikely(nbytes < 0))
+			return false;
+
+		skip = nbytes;
+	}
+#endif
+
+	/* queue whatever the kernel did not accept */
+	for (unsigned i = 0; i < n; ++i) {
+		const auto &b = buffers[i];
+		if (skip >= b.size) {
+			skip -= b.size;
+			continue;
+		}
+
+		if (!Write((const char *)b.data + skip, b.size - skip))
+			return false;
+
+		skip = 0;
+	}
+
+	return true;
+}
+
+void
+FullyBufferedSocket::CommitWrite(size_t length)
+{
+	assert(IsDefined());
+
+	if (length == 0)
+		return;
+
+	const bool was_empty = output.IsEmpty();
+	output.Append(length);
+
+	if (was_empty)
+		IdleMonitor::Schedule();
+}
+
 bool
 FullyBufferedSocket::OnSocketReady(unsigned flags)
 {
@@ -24,6 +24,7 @@
 #include "BufferedSocket.hxx"
 #include "IdleMonitor.hxx"
 #include "util/PeakBuffer.hxx"
+#include "util/ConstBuffer.hxx"
 
 /**
  * A #BufferedSocket specialization that adds an output buffer.
@@ -32,10 +33,14 @@ class FullyBufferedSocket : protected BufferedSocket, private IdleMonitor {
 	PeakBuffer output;
 
 public:
+	/**
+	 * @param category the output buffer is accounted here
+	 */
 	FullyBufferedSocket(int _fd, EventLoop &_loop,
+			    MemoryCategory category,
 			    size_t normal_size, size_t peak_size=0)
 		:BufferedSocket(_fd, _loop), IdleMonitor(_loop),
-		 output(normal_size, peak_size) {
+		 output(normal_size, peak_size, category) {
 	}
 
 	using BufferedSocket::IsDefined;
@@ -46,6 +51,15 @@ public:
 	}
 
 private:
+	/**
+	 * Evaluate the return value of a send() call; on error, the
+	 * socket gets cancelled and the error handler is invoked.
+	 *
+	 * @return the number of bytes sent, 0 if the socket would
+	 * block, or -1 on error
+	 */
+	ssize_t HandleWriteResult(ssize_t nbytes);
+
 	ssize_t DirectWrite(const void *data, size_t length);
 
 protected:
@@ -61,6 +75,33 @@ protected:
 	 */
 	bool Write(const void *data, size_t length);
 
+	/**
+	 * Write several buffers at once.  If the output buffer is
+	 * empty, they are sent to the socket directly with one
+	 * system call, and only the portion the kernel did not
+	 * accept is copied to the output buffer.  This avoids a copy
+	 * of large payloads.
+	 *
+	 * @return false if the socket has been closed
+	 */
+	bool WriteV(const ConstBuffer<void> *buffers, unsigned n);
+
+	/**
+	 * Obtain free space at the end of the output buffer, to
+	 * generate data in place instead of copying it.  Call
+	 * CommitWrite() afterwards.  The returned buffer may be
+	 * empty or too small; in that case, use Write() instead.
+	 */
+	WritableBuffer<void> PrepareWrite() {
+		return output.Write();
+	}
+
+	/**
+	 * Commit data which was written to the buffer returned by
+	 * PrepareWrite().
+	 */
+	void CommitWrite(size_t length);
+
 	virtual bool OnSocketReady(unsigned flags) override;
 	virtual void OnIdle() override;
 };
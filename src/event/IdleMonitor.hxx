@@ -22,6 +22,8 @@
 
 #include "check.h"
 
+#include <boost/intrusive/list_hook.hpp>
+
 class EventLoop;
 
 /**
@@ -36,6 +38,15 @@ class EventLoop;
 class IdleMonitor {
 	friend class EventLoop;
 
+	typedef boost::intrusive::list_member_hook<boost::intrusive::link_mode<boost::intrusive::safe_link>> Hook;
+
+	/**
+	 * Links this object into EventLoop::idle while it is
+	 * active.
+	 */
+	Hook hook;
+
+
 	EventLoop &loop;
 
 	bool active;
@@ -26,11 +26,11 @@
 #include "IdleMonitor.hxx"
 #include "DeferredMonitor.hxx"
 
-#include <algorithm>
-
 EventLoop::EventLoop()
 	:SocketMonitor(*this),
-	 now_ms(::MonotonicClockMS()),
+	 now_ms(::MonotonicClockMS()), timers(now_ms),
+	 deferred_stack(nullptr),
+	 deferred_head(nullptr), deferred_tail(&deferred_head),
 	 quit(false), busy(true),
 #ifndef NDEBUG
 	 virgin(true),
@@ -44,7 +44,7 @@ EventLoop::EventLoop()
 EventLoop::~EventLoop()
 {
 	assert(idle.empty());
-	assert(timers.empty());
+	assert(timers.IsEmpty());
 
 	/* this is necessary to get a well-defined destruction
 	   order */
@@ -80,9 +80,9 @@ void
 EventLoop::AddIdle(IdleMonitor &i)
 {
 	assert(IsInsideOrVirgin());
-	assert(std::find(idle.begin(), idle.end(), &i) == idle.end());
+	assert(!i.hook.is_linked());
 
-	idle.push_back(&i);
+	idle.push_back(i);
 	again = true;
 }
 
@@ -90,11 +90,9 @@ void
 EventLoop::RemoveIdle(IdleMonitor &i)
 {
 	assert(IsInsideOrVirgin());
+	assert(i.hook.is_linked());
 
-	auto it = std::find(idle.begin(), idle.end(), &i);
-	assert(it != idle.end());
-
-	idle.erase(it);
+	idle.erase(idle.iterator_to(i));
 }
 
 void
@@ -104,7 +102,7 @@ EventLoop::AddTimer(TimeoutMonitor &t, unsigned ms)
 	   modifies the timeout during avahi_client_free() */
 	assert(IsInsideOrNull());
 
-	timers.insert(TimerRecord(t, now_ms + ms));
+	timers.Add(t, now_ms, ms);
 	again = true;
 }
 
@@ -113,12 +111,7 @@ EventLoop::CancelTimer(TimeoutMonitor &t)
 {
 	assert(IsInsideOrNull());
 
-	for (auto i = timers.begin(), end = timers.end(); i != end; ++i) {
-		if (&i->timer == &t) {
-			timers.erase(i);
-			return;
-		}
-	}
+	timers.Remove(t);
 }
 
 void
@@ -142,31 +135,23 @@ EventLoop::Run()
 
 		/* invoke timers */
 
-		int timeout_ms;
-		while (true) {
-			auto i = timers.begin();
-			if (i == timers.end()) {
-				timeout_ms = -1;
-				break;
-			}
-
-			timeout_ms = i->due_ms - now_ms;
-			if (timeout_ms > 0)
-				break;
-
-			TimeoutMonitor &m = i->timer;
-			timers.erase(i);
+		timers.Advance(now_ms);
 
+		TimerWheel::Timer *t;
+		while ((t = timers.PopReady()) != nullptr) {
+			TimeoutMonitor &m = static_cast<TimeoutMonitor &>(*t);
 			m.Run();
 
 			if (quit)
 				return;
 		}
 
+		int timeout_ms = timers.GetTimeout(now_ms);
+
 		/* invoke idle */
 
 		while (!idle.empty()) {
-			IdleMonitor &m = *idle.front();
+			IdleMonitor &m = idle.front();
 			idle.pop_front();
 			m.Run();
 
@@ -178,24 +163,32 @@ EventLoop::Run()
 		   overhead */
 		mutex.lock();
 		HandleDeferred();
-		busy = false;
 		mutex.unlock();
 
+		busy = false;
+		if (deferred_stack.load() != nullptr)
+			/* scheduled after HandleDeferred(), before
+			   AddDeferred() could see "busy" cleared */
+			again = true;
+
 		if (again)
 			/* re-evaluate timers because one of the
 			   IdleMonitors may have added a new
 			   timeout */
 			continue;
 
+		if (!ready_sockets.empty())
+			/* don't sleep while edge-triggered sockets
+			   have unconsumed events */
+			timeout_ms = 0;
+
 		/* wait for new event */
 
 		poll_group.ReadEvents(poll_result, timeout_ms);
 
 		now_ms = ::MonotonicClockMS();
 
-		mutex.lock();
 		busy = true;
-		mutex.unlock();
 
 		/* invoke sockets */
 		for (int i = 0; i < poll_result.GetSize(); ++i) {
@@ -211,6 +204,18 @@ EventLoop::Run()
 
 		poll_result.Reset();
 
+		/* invoke edge-triggered sockets which have not
+		   consumed all of their events; those which still
+		   aren't done will re-add themselves to the (now
+		   empty) list for the next iteration */
+		ReadySocketList ready;
+		ready.swap(ready_sockets);
+		while (!ready.empty() && !quit) {
+			SocketMonitor &m = ready.front();
+			ready.pop_front();
+			m.Dispatch(0);
+		}
+
 	} while (!quit);
 
 #ifndef NDEBUG
@@ -223,56 +228,105 @@ EventLoop::Run()
 void
 EventLoop::AddDeferred(DeferredMonitor &d)
 {
-	mutex.lock();
-	if (d.pending) {
-		mutex.unlock();
+	if (d.pending.exchange(true))
+		/* already pending */
 		return;
-	}
-
-	assert(std::find(deferred.begin(),
-			 deferred.end(), &d) == deferred.end());
 
-	/* we don't need to wake up the EventLoop if another
-	   DeferredMonitor has already done it */
-	const bool must_wake = !busy && deferred.empty();
+	if (d.queued.exchange(true))
+		/* still in the queue after Cancel(); HandleDeferred()
+		   will see the "pending" flag */
+		return;
 
-	d.pending = true;
-	deferred.push_back(&d);
-	again = true;
-	mutex.unlock();
+	DeferredMonitor *head = deferred_stack.load(std::memory_order_relaxed);
+	do {
+		d.next = head;
+	} while (!deferred_stack.compare_exchange_weak(head, &d));
 
-	if (must_wake)
+	/* we don't need to wake up the EventLoop if another
+	   DeferredMonitor has already done it, or if the EventLoop
+	   is busy and will look at the queue before going to
+	   sleep */
+	if (head == nullptr && !busy.load())
 		wake_fd.Write();
 }
 
 void
 EventLoop::RemoveDeferred(DeferredMonitor &d)
 {
-	const ScopeLock protect(mutex);
+	/* the object stays in the queue; HandleDeferred() or
+	   PurgeDeferred() will remove it */
+	d.pending = false;
+}
 
-	if (!d.pending) {
-		assert(std::find(deferred.begin(),
-				 deferred.end(), &d) == deferred.end());
+void
+EventLoop::TakeDeferredStack()
+{
+	DeferredMonitor *stack = deferred_stack.exchange(nullptr);
+	if (stack == nullptr)
 		return;
+
+	/* reverse the stack */
+	DeferredMonitor *list = nullptr, *last = stack;
+	while (stack != nullptr) {
+		DeferredMonitor *next = stack->next;
+		stack->next = list;
+		list = stack;
+		stack = next;
 	}
 
-	d.pending = false;
+	*deferred_tail = list;
+	deferred_tail = &last->next;
+}
 
-	auto i = std::find(deferred.begin(), deferred.end(), &d);
-	assert(i != deferred.end());
+void
+EventLoop::PurgeDeferred(DeferredMonitor &d)
+{
+	const ScopeLock protect(mutex);
+
+	if (!d.queued)
+		/* HandleDeferred() has removed it meanwhile */
+		return;
+
+	TakeDeferredStack();
+
+	for (DeferredMonitor **i = &deferred_head; *i != nullptr;
+	     i = &(*i)->next) {
+		if (*i == &d) {
+			*i = d.next;
+			if (deferred_tail == &d.next)
+				deferred_tail = i;
+
+			d.queued = false;
+			return;
+		}
+	}
 
-	deferred.erase(i);
+	assert(false);
+	gcc_unreachable();
 }
 
 void
 EventLoop::HandleDeferred()
 {
-	while (!deferred.empty() && !quit) {
-		DeferredMonitor &m = *deferred.front();
-		assert(m.pending);
+	while (!quit) {
+		if (deferred_head == nullptr) {
+			TakeDeferredStack();
+			if (deferred_head == nullptr)
+				break;
+		}
 
-		deferred.pop_front();
-		m.pending = false;
+		DeferredMonitor &m = *deferred_head;
+		deferred_head = m.next;
+		if (deferred_head == nullptr)
+			deferred_tail = &deferred_head;
+
+		/* clear "queued" before "pending", so a concurrent
+		   AddDeferred() either gets handled here or pushes
+		   the object again */
+		m.queued = false;
+		if (!m.pending.exchange(false))
+			/* cancelled */
+			continue;
 
 		mutex.unlock();
 		m.RunDeferred();
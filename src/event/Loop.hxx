@@ -28,12 +28,14 @@
 #include "thread/Mutex.hxx"
 #include "WakeFD.hxx"
 #include "SocketMonitor.hxx"
+#include "TimerWheel.hxx"
+#include "IdleMonitor.hxx"
 
-#include <list>
-#include <set>
+#include <boost/intrusive/list.hpp>
+
+#include <atomic>
 
 class TimeoutMonitor;
-class IdleMonitor;
 class DeferredMonitor;
 class SocketMonitor;
 
@@ -50,37 +52,54 @@ class SocketMonitor;
  */
 class EventLoop final : SocketMonitor
 {
-	struct TimerRecord {
-		/**
-		 * Projected monotonic_clock_ms() value when this
-		 * timer is due.
-		 */
-		const unsigned due_ms;
+	WakeFD wake_fd;
 
-		TimeoutMonitor &timer;
+	unsigned now_ms;
 
-		constexpr TimerRecord(TimeoutMonitor &_timer,
-				      unsigned _due_ms)
-			:due_ms(_due_ms), timer(_timer) {}
+	/**
+	 * All scheduled #TimeoutMonitor instances.  Adding and
+	 * cancelling a timer does not allocate memory.
+	 */
+	TimerWheel timers;
 
-		bool operator<(const TimerRecord &other) const {
-			return due_ms < other.due_ms;
-		}
+	boost::intrusive::list<IdleMonitor,
+			       boost::intrusive::member_hook<IdleMonitor,
+							     IdleMonitor::Hook,
+							     &IdleMonitor::hook>,
+			       boost::intrusive::constant_time_size<false>> idle;
 
-		bool IsDue(unsigned _now_ms) const {
-			return _now_ms >= due_ms;
-		}
-	};
+	typedef boost::intrusive::list<SocketMonitor,
+				       boost::intrusive::member_hook<SocketMonitor,
+								     SocketMonitor::ReadyHook,
+								     &SocketMonitor::ready_hook>,
+				       boost::intrusive::constant_time_size<false>> ReadySocketList;
 
-	WakeFD wake_fd;
+	/**
+	 * Edge-triggered #SocketMonitor instances which have
+	 * unconsumed events; they will be dispatched again without
+	 * waiting for the kernel.
+	 */
+	ReadySocketList ready_sockets;
 
-	std::multiset<TimerRecord> timers;
-	std::list<IdleMonitor *> idle;
+	/**
+	 * A lock-free stack (LIFO) of #DeferredMonitor instances
+	 * scheduled by AddDeferred().  Any thread may push to it;
+	 * only the #EventLoop takes it, as a whole.
+	 */
+	std::atomic<DeferredMonitor *> deferred_stack;
 
+	/**
+	 * Protects #deferred_head and #deferred_tail.  It is only
+	 * used by the #EventLoop thread and PurgeDeferred(), never
+	 * by AddDeferred().
+	 */
 	Mutex mutex;
-	std::list<DeferredMonitor *> deferred;
 
-	unsigned now_ms;
+	/**
+	 * A FIFO list of #DeferredMonitor instances taken from
+	 * #deferred_stack, waiting to be handled.
+	 */
+	DeferredMonitor *deferred_head, **deferred_tail;
 
 	bool quit;
 
@@ -92,11 +111,11 @@ class EventLoop final : SocketMonitor
 
 	/**
 	 * True when handling callbacks, false when waiting for I/O or
-	 * timeout.
-	 *
-	 * Protected with #mutex.
+	 * timeout.  AddDeferred() doesn't need to wake up a busy
+	 * #EventLoop, because it checks #deferred_stack again before
+	 * going to sleep.
 	 */
-	bool busy;
+	std::atomic<bool> busy;
 
 #ifndef NDEBUG
 	/**
@@ -155,6 +174,18 @@ public:
 
 	bool RemoveFD(int fd, SocketMonitor &m);
 
+	/**
+	 * Schedule another SocketMonitor::Dispatch() call for an
+	 * edge-triggered #SocketMonitor which still has unconsumed
+	 * events.
+	 */
+	void AddReadySocket(SocketMonitor &m) {
+		assert(IsInside());
+
+		if (!m.ready_hook.is_linked())
+			ready_sockets.push_back(m);
+	}
+
 	void AddIdle(IdleMonitor &i);
 	void RemoveIdle(IdleMonitor &i);
 
@@ -176,6 +207,15 @@ public:
 	 */
 	void RemoveDeferred(DeferredMonitor &d);
 
+	/**
+	 * Unlink a cancelled #DeferredMonitor from the queue before
+	 * it gets destroyed, and wait until HandleDeferred() has
+	 * finished looking at it.
+	 *
+	 * This method is thread-safe.
+	 */
+	void PurgeDeferred(DeferredMonitor &d);
+
 	/**
 	 * The main function of this class.  It will loop until
 	 * Break() gets called.  Can be called only once.
@@ -183,6 +223,14 @@ public:
 	void Run();
 
 private:
+	/**
+	 * Move all elements of #deferred_stack to the end of the
+	 * #deferred_head list, restoring their original order.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void TakeDeferredStack();
+
 	/**
 	 * Invoke all pending DeferredMonitors.
 	 *
@@ -25,17 +25,25 @@
 #include "Compiler.h"
 #include "system/EPollFD.hxx"
 
-#include <array>
+#include <vector>
 #include <algorithm>
 
 class PollResultEPoll
 {
 	friend class PollGroupEPoll;
 
-	std::array<epoll_event, 16> events;
+	/**
+	 * The initial number of events returned by one
+	 * epoll_wait() call.  The buffer grows up to #MAX_EVENTS
+	 * while it keeps getting filled completely.
+	 */
+	static constexpr size_t INITIAL_EVENTS = 64;
+	static constexpr size_t MAX_EVENTS = 1024;
+
+	std::vector<epoll_event> events;
 	int n_events;
 public:
-	PollResultEPoll() : n_events(0) { }
+	PollResultEPoll() : events(INITIAL_EVENTS), n_events(0) { }
 
 	int GetSize() const { return n_events; }
 	unsigned GetEvents(int i) const { return events[i].events; }
@@ -60,6 +68,7 @@ public:
 	static constexpr unsigned WRITE = EPOLLOUT;
 	static constexpr unsigned ERROR = EPOLLERR;
 	static constexpr unsigned HANGUP = EPOLLHUP;
+	static constexpr unsigned EDGE = EPOLLET;
 
 	PollGroupEPoll() = default;
 
@@ -67,6 +76,12 @@ public:
 		int ret = epoll.Wait(result.events.data(), result.events.size(),
 				     timeout_ms);
 		result.n_events = std::max(0, ret);
+
+		if (size_t(result.n_events) == result.events.size() &&
+		    result.events.size() < PollResultEPoll::MAX_EVENTS)
+			/* the buffer was full, more events may be
+			   pending: fetch more of them next time */
+			result.events.resize(result.events.size() * 2);
 	}
 
 	bool Add(int fd, unsigned events, void *obj) {
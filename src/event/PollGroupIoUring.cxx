@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+
+#ifdef USE_IO_URING
+
+#include "PollGroupIoUring.hxx"
+#include "system/FatalError.hxx"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+
+PollGroupIoUring::PollGroupIoUring()
+{
+	int result = io_uring_queue_init(256, &ring, 0);
+	if (result < 0) {
+		errno = -result;
+		FatalSystemError("io_uring_queue_init() failed");
+	}
+}
+
+PollGroupIoUring::~PollGroupIoUring()
+{
+	io_uring_queue_exit(&ring);
+
+	all_items.clear_and_dispose([](Item *item){ delete item; });
+}
+
+struct io_uring_sqe *
+PollGroupIoUring::GetSubmitEntry()
+{
+	struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+	if (sqe == nullptr) {
+		/* the submission queue is full: flush it now */
+		io_uring_submit(&ring);
+		sqe = io_uring_get_sqe(&ring);
+		assert(sqe != nullptr);
+	}
+
+	return sqe;
+}
+
+inline void
+PollGroupIoUring::Arm(Item &item)
+{
+	assert(item.active);
+	assert(!item.armed);
+
+	struct io_uring_sqe *sqe = GetSubmitEntry();
+	io_uring_prep_poll_add(sqe, item.fd, item.events);
+	io_uring_sqe_set_data(sqe, &item);
+	item.armed = true;
+}
+
+inline void
+PollGroupIoUring::Cancel(Item &item)
+{
+	assert(item.armed);
+
+	struct io_uring_sqe *sqe = GetSubmitEntry();
+	io_uring_prep_poll_remove(sqe, (uintptr_t)&item);
+	/* the completion of the POLL_REMOVE request itself is
+	   ignored */
+	io_uring_sqe_set_data(sqe, nullptr);
+}
+
+inline void
+PollGroupIoUring::Free(Item &item)
+{
+	assert(!item.active);
+	assert(!item.armed);
+
+	all_items.erase(all_items.iterator_to(item));
+	delete &item;
+}
+
+bool
+PollGroupIoUring::Add(int fd, unsigned events, void *obj)
+{
+	assert(items.find(fd) == items.end());
+
+	Item *item = new Item(fd, events, obj);
+	all_items.push_back(*item);
+	items[fd] = item;
+
+	Arm(*item);
+	return true;
+}
+
+bool
+PollGroupIoUring::Modify(int fd, unsigned events, void *obj)
+{
+	auto i = items.find(fd);
+	assert(i != items.end());
+	Item &item = *i->second;
+
+	item.obj = obj;
+
+	if (!item.armed) {
+		item.events = events;
+		Arm(item);
+	} else if (events != item.events) {
+		/* cancel the pending request; it will be re-armed
+		   with the new mask by HandleCompletion() */
+		item.events = events;
+		Cancel(item);
+	}
+
+	return true;
+}
+
+bool
+PollGroupIoUring::Remove(int fd)
+{
+	auto i = items.find(fd);
+	assert(i != items.end());
+	Item &item = *i->second;
+	items.erase(i);
+
+	item.active = false;
+
+	if (item.armed)
+		Cancel(item);
+	else
+		Free(item);
+
+	return true;
+}
+
+inline void
+PollGroupIoUring::HandleCompletion(PollResultGeneric &result, Item &item,
+				   int res)
+{
+	assert(item.armed);
+
+	item.armed = false;
+
+	if (!item.active) {
+		Free(item);
+		return;
+	}
+
+	if (res > 0)
+		result.Add(res, item.obj);
+	else if (res < 0 && res != -ECANCELED) {
+		/* don't re-arm; the next Modify() call will */
+		result.Add(ERROR, item.obj);
+		return;
+	}
+
+	/* re-arm right away; if the SocketMonitor doesn't consume
+	   the event, the new request completes immediately, just
+	   like level-triggered poll() */
+	Arm(item);
+}
+
+void
+PollGroupIoUring::ReadEvents(PollResultGeneric &result, int timeout_ms)
+{
+	struct __kernel_timespec ts, *tsp = nullptr;
+	if (timeout_ms >= 0) {
+		ts.tv_sec = timeout_ms / 1000;
+		ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+		tsp = &ts;
+	}
+
+	/* submit all queued requests and wait for completions with
+	   only one system call */
+	struct io_uring_cqe *cqe;
+	if (io_uring_submit_and_wait_timeout(&ring, &cqe, 1, tsp,
+					     nullptr) < 0)
+		/* timeout or signal */
+		return;
+
+	unsigned head, n = 0;
+	io_uring_for_each_cqe(&ring, head, cqe) {
+		++n;
+
+		Item *item = (Item *)io_uring_cqe_get_data(cqe);
+		if (item != nullptr)
+			HandleCompletion(result, *item, cqe->res);
+	}
+
+	io_uring_cq_advance(&ring, n);
+}
+
+#endif
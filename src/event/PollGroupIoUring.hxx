@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_EVENT_POLLGROUP_IO_URING_HXX
+#define MPD_EVENT_POLLGROUP_IO_URING_HXX
+
+#include "check.h"
+#include "PollResultGeneric.hxx"
+
+#include <boost/intrusive/list.hpp>
+
+#include <unordered_map>
+
+#include <liburing.h>
+#include <sys/poll.h>
+
+/**
+ * A #PollGroup implementation based on Linux io_uring.  Each file
+ * descriptor has a one-shot IORING_OP_POLL_ADD request, which gets
+ * re-armed after it has completed.  All requests queued during one
+ * #EventLoop iteration are submitted in one batch, with the same
+ * system call which waits for completions.
+ */
+class PollGroupIoUring
+{
+	struct Item : boost::intrusive::list_base_hook<> {
+		int fd;
+		unsigned events;
+		void *obj;
+
+		/**
+		 * Is an IORING_OP_POLL_ADD request for this item
+		 * pending in the kernel?
+		 */
+		bool armed;
+
+		/**
+		 * Cleared by Remove().  The object is freed when the
+		 * pending request completes.
+		 */
+		bool active;
+
+		Item(int _fd, unsigned _events, void *_obj)
+			:fd(_fd), events(_events), obj(_obj),
+			 armed(false), active(true) {}
+	};
+
+	struct io_uring ring;
+
+	std::unordered_map<int, Item *> items;
+
+	/**
+	 * All #Item instances, including removed ones whose request
+	 * has not completed yet.
+	 */
+	boost::intrusive::list<Item> all_items;
+
+	PollGroupIoUring(PollGroupIoUring &) = delete;
+	PollGroupIoUring &operator=(PollGroupIoUring &) = delete;
+public:
+	static constexpr unsigned READ = POLLIN;
+	static constexpr unsigned WRITE = POLLOUT;
+	static constexpr unsigned ERROR = POLLERR;
+	static constexpr unsigned HANGUP = POLLHUP;
+
+	/** edge-triggered mode is not supported */
+	static constexpr unsigned EDGE = 0;
+
+	PollGroupIoUring();
+	~PollGroupIoUring();
+
+	void ReadEvents(PollResultGeneric &result, int timeout_ms);
+	bool Add(int fd, unsigned events, void *obj);
+	bool Modify(int fd, unsigned events, void *obj);
+	bool Remove(int fd);
+
+	bool Abandon(int fd) {
+		/* unlike epoll, a pending poll request holds a
+		   reference to the file, so it must be cancelled even
+		   after the descriptor has been closed */
+		return Remove(fd);
+	}
+
+private:
+	struct io_uring_sqe *GetSubmitEntry();
+
+	void Arm(Item &item);
+	void Cancel(Item &item);
+	void Free(Item &item);
+
+	void HandleCompletion(PollResultGeneric &result, Item &item, int res);
+};
+
+#endif
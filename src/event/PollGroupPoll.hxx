@@ -48,6 +48,9 @@ public:
 	static constexpr unsigned ERROR = POLLERR;
 	static constexpr unsigned HANGUP = POLLHUP;
 
+	/** edge-triggered mode is not supported */
+	static constexpr unsigned EDGE = 0;
+
 	PollGroupPoll();
 	~PollGroupPoll();
 
@@ -98,6 +98,9 @@ public:
 	static constexpr unsigned ERROR = 0;
 	static constexpr unsigned HANGUP = 0;
 
+	/** edge-triggered mode is not supported */
+	static constexpr unsigned EDGE = 0;
+
 	PollGroupWinSelect();
 	~PollGroupWinSelect();
 
@@ -24,26 +24,59 @@
 #include "Compiler.h"
 
 #include <assert.h>
+#include <string.h>
 
 #ifdef WIN32
 #include <winsock2.h>
 #else
 #include <sys/socket.h>
+#include <sys/uio.h>
 #endif
 
 void
 SocketMonitor::Dispatch(unsigned flags)
 {
+	if (edge_triggered) {
+		/* this edge may not be consumed by this call, so
+		   remember it until Read() or Write() would block */
+		ready_flags |= flags;
+		flags = ready_flags;
+	}
+
 	flags &= GetScheduledFlags();
 
-	if (flags != 0 && !OnSocketReady(flags) && IsDefined())
-		Cancel();
+	if (flags != 0 && !OnSocketReady(flags)) {
+		if (IsDefined())
+			Cancel();
+		return;
+	}
+
+	if (edge_triggered && IsDefined() &&
+	    (ready_flags & GetScheduledFlags()) != 0)
+		/* there's more to do, but no new edge will be
+		   reported */
+		loop.AddReadySocket(*this);
 }
 
 SocketMonitor::~SocketMonitor()
 {
 	if (IsDefined())
-		Cancel();
+		Unregister();
+}
+
+void
+SocketMonitor::Unregister()
+{
+	assert(IsDefined());
+
+	if (registered_flags != 0) {
+		loop.RemoveFD(fd, *this);
+		registered_flags = 0;
+	}
+
+	scheduled_flags = 0;
+	ready_flags = 0;
+	ready_hook.unlink();
 }
 
 void
@@ -60,7 +93,7 @@ SocketMonitor::Steal()
 {
 	assert(IsDefined());
 
-	Cancel();
+	Unregister();
 
 	int result = fd;
 	fd = -1;
@@ -75,6 +108,8 @@ SocketMonitor::Abandon()
 
 	int old_fd = fd;
 	fd = -1;
+	registered_flags = scheduled_flags = ready_flags = 0;
+	ready_hook.unlink();
 	loop.Abandon(old_fd, *this);
 }
 
@@ -92,6 +127,23 @@ SocketMonitor::Schedule(unsigned flags)
 	if (flags == GetScheduledFlags())
 		return;
 
+	if (edge_triggered) {
+		/* register all events once; from now on, only
+		   #scheduled_flags decides which ones are
+		   dispatched */
+		if (registered_flags == 0 && flags != 0) {
+			registered_flags = READ|WRITE|ERROR|HANGUP;
+			loop.AddFD(fd, registered_flags|EDGE, *this);
+		}
+
+		scheduled_flags = flags;
+
+		if ((ready_flags & flags) != 0)
+			/* the edge has already been reported */
+			loop.AddReadySocket(*this);
+		return;
+	}
+
 	if (scheduled_flags == 0)
 		loop.AddFD(fd, flags, *this);
 	else if (flags == 0)
@@ -99,7 +151,18 @@ SocketMonitor::Schedule(unsigned flags)
 	else
 		loop.ModifyFD(fd, flags, *this);
 
-	scheduled_flags = flags;
+	scheduled_flags = registered_flags = flags;
+}
+
+inline void
+SocketMonitor::UpdateReady(unsigned flag, ssize_t nbytes, size_t length)
+{
+	/* a short transfer on a stream socket means the kernel
+	   buffer is empty (or full); the next edge will be reported
+	   when this changes */
+	if (edge_triggered && (nbytes < 0 || size_t(nbytes) < length) &&
+	    nbytes != 0)
+		ready_flags &= ~flag;
 }
 
 SocketMonitor::ssize_t
@@ -112,7 +175,9 @@ SocketMonitor::Read(void *data, size_t length)
 	flags |= MSG_DONTWAIT;
 #endif
 
-	return recv(Get(), (char *)data, length, flags);
+	const ssize_t nbytes = recv(Get(), (char *)data, length, flags);
+	UpdateReady(READ, nbytes, length);
+	return nbytes;
 }
 
 SocketMonitor::ssize_t
@@ -128,5 +193,43 @@ SocketMonitor::Write(const void *data, size_t length)
 	flags |= MSG_DONTWAIT;
 #endif
 
-	return send(Get(), (const char *)data, length, flags);
+	const ssize_t nbytes = send(Get(), (const char *)data, length,
+				    flags);
+	UpdateReady(WRITE, nbytes, length);
+	return nbytes;
 }
+
+#ifndef WIN32
+
+SocketMonitor::ssize_t
+SocketMonitor::Write(const struct iovec *iov, size_t n)
+{
+	assert(IsDefined());
+
+	int flags = 0;
+#ifdef MSG_NOSIGNAL
+	flags |= MSG_NOSIGNAL;
+#endif
+#ifdef MSG_DONTWAIT
+	flags |= MSG_DONTWAIT;
+#endif
+
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = const_cast<struct iovec *>(iov);
+	msg.msg_iovlen = n;
+
+	const ssize_t nbytes = sendmsg(Get(), &msg, flags);
+
+	if (edge_triggered) {
+		size_t length = 0;
+		for (size_t i = 0; i < n; ++i)
+			length += iov[i].iov_len;
+
+		UpdateReady(WRITE, nbytes, length);
+	}
+
+	return nbytes;
+}
+
+#endif
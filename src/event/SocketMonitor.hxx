@@ -23,6 +23,8 @@
 #include "check.h"
 #include "PollGroup.hxx"
 
+#include <boost/intrusive/list_hook.hpp>
+
 #include <type_traits>
 
 #include <assert.h>
@@ -38,6 +40,10 @@
 
 class EventLoop;
 
+#ifndef WIN32
+struct iovec;
+#endif
+
 /**
  * Monitor events on a socket.  Call Schedule() to announce events
  * you're interested in, or Cancel() to cancel your subscription.  The
@@ -47,11 +53,19 @@ class EventLoop;
  * This class does not feel responsible for closing the socket.  Call
  * Close() to do it manually.
  *
+ * In edge-triggered mode (see SetEdgeTriggered()), the socket is
+ * registered only once, and Schedule() just changes a bit mask
+ * without a system call.  Events which are not consumed by Read()
+ * or Write() are remembered, and OnSocketReady() is invoked again
+ * until the socket would block.
+ *
  * This class is not thread-safe, all methods must be called from the
  * thread that runs the #EventLoop, except where explicitly documented
  * as thread-safe.
  */
 class SocketMonitor {
+	friend class EventLoop;
+
 	int fd;
 	EventLoop &loop;
 
@@ -60,6 +74,30 @@ class SocketMonitor {
 	 */
 	unsigned scheduled_flags;
 
+	/**
+	 * A bit mask of events which is registered in the #PollGroup.
+	 * Equal to #scheduled_flags unless #edge_triggered is set.
+	 */
+	unsigned registered_flags;
+
+	/**
+	 * Edge-triggered mode only: events which were reported by
+	 * the kernel, and which have not been consumed yet (i.e. a
+	 * Read() or Write() did not block since then).
+	 */
+	unsigned ready_flags;
+
+	bool edge_triggered;
+
+	typedef boost::intrusive::list_member_hook<boost::intrusive::link_mode<boost::intrusive::auto_unlink>> ReadyHook;
+
+	/**
+	 * Links this object into EventLoop::ready_sockets while
+	 * OnSocketReady() needs to be called again without waiting
+	 * for a new event.
+	 */
+	ReadyHook ready_hook;
+
 public:
 	static constexpr unsigned READ = PollGroup::READ;
 	static constexpr unsigned WRITE = PollGroup::WRITE;
@@ -68,11 +106,15 @@ public:
 
 	typedef std::make_signed<size_t>::type ssize_t;
 
+	static constexpr unsigned EDGE = PollGroup::EDGE;
+
 	SocketMonitor(EventLoop &_loop)
-		:fd(-1), loop(_loop), scheduled_flags(0) {}
+		:fd(-1), loop(_loop), scheduled_flags(0), registered_flags(0),
+		 ready_flags(0), edge_triggered(false) {}
 
 	SocketMonitor(int _fd, EventLoop &_loop)
-		:fd(_fd), loop(_loop), scheduled_flags(0) {}
+		:fd(_fd), loop(_loop), scheduled_flags(0), registered_flags(0),
+		 ready_flags(0), edge_triggered(false) {}
 
 	~SocketMonitor();
 
@@ -105,6 +147,20 @@ public:
 
 	void Close();
 
+	/**
+	 * Switch to edge-triggered mode.  This must be called before
+	 * the first Schedule() call.  It is ignored if the
+	 * #PollGroup does not support it.
+	 *
+	 * Only use this if all I/O on the socket is done with Read()
+	 * and Write(), which keep track of the readiness.
+	 */
+	void SetEdgeTriggered() {
+		assert(registered_flags == 0);
+
+		edge_triggered = EDGE != 0;
+	}
+
 	unsigned GetScheduledFlags() const {
 		assert(IsDefined());
 
@@ -136,6 +192,13 @@ public:
 	ssize_t Read(void *data, size_t length);
 	ssize_t Write(const void *data, size_t length);
 
+#ifndef WIN32
+	/**
+	 * Write several buffers with one system call.
+	 */
+	ssize_t Write(const struct iovec *iov, size_t n);
+#endif
+
 protected:
 	/**
 	 * @return false if the socket has been closed
@@ -144,6 +207,18 @@ protected:
 
 public:
 	void Dispatch(unsigned flags);
+
+private:
+	/**
+	 * Remove the socket from the #PollGroup, even in
+	 * edge-triggered mode.
+	 */
+	void Unregister();
+
+	/**
+	 * Update #ready_flags after a Read() or Write() call.
+	 */
+	void UpdateReady(unsigned flag, ssize_t nbytes, size_t length);
 };
 
 #endif
@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "TimerWheel.hxx"
+
+#include <assert.h>
+
+static constexpr unsigned
+LevelShift(unsigned level)
+{
+	return level == 0
+		? 0
+		: 8 + (level - 1) * 6;
+}
+
+/**
+ * Find the next set bit in a circular bit array, beginning at the
+ * given position.
+ *
+ * @param size the number of bits; a power of two and a multiple
+ * of 64
+ * @return the distance from @start to the next set bit, or @size
+ * if no bit is set
+ */
+gcc_pure
+static unsigned
+FindNextBit(const uint64_t *words, unsigned size, unsigned start)
+{
+	assert((size & (size - 1)) == 0);
+	assert(size % 64 == 0);
+
+	for (unsigned d = 0; d < size;) {
+		const unsigned i = (start + d) & (size - 1);
+		const uint64_t w = words[i / 64] >> (i % 64);
+		if (w != 0)
+			return d + __builtin_ctzll(w);
+
+		d += 64 - i % 64;
+	}
+
+	return size;
+}
+
+void
+TimerWheel::Insert(Timer &t)
+{
+	const unsigned due_ms = t.due_ms;
+	const unsigned delta = due_ms - wheel_ms;
+
+	unsigned slot;
+	if (delta < LEVEL0_SIZE)
+		slot = due_ms & (LEVEL0_SIZE - 1);
+	else {
+		unsigned level = 1;
+		while (level < N_UPPER_LEVELS &&
+		       delta >= 1u << LevelShift(level + 1))
+			++level;
+
+		slot = LEVEL0_SIZE + (level - 1) * LEVEL_SIZE +
+			((due_ms >> LevelShift(level)) & (LEVEL_SIZE - 1));
+	}
+
+	t.slot = slot;
+	slots[slot].push_back(t);
+	SetBit(slot);
+	++count;
+}
+
+void
+TimerWheel::Add(Timer &t, unsigned now_ms, unsigned ms)
+{
+	assert(!t.is_linked());
+
+	if (IsEmpty())
+		/* nothing depends on the old position; catch up
+		   with the clock, so the delta below is small */
+		wheel_ms = now_ms + 1;
+
+	/* keep the delta within the range of the wheel */
+	if (ms > 0x7fffffff)
+		ms = 0x7fffffff;
+
+	t.due_ms = now_ms + ms;
+
+	/* #wheel_ms is never more than one tick ahead of the clock */
+	assert(int(wheel_ms - now_ms) <= 1);
+
+	if (t.due_ms + 1 == wheel_ms) {
+		/* due now, but this tick has already been processed */
+		t.slot = READY_SLOT;
+		ready.push_back(t);
+	} else
+		Insert(t);
+}
+
+void
+TimerWheel::Remove(Timer &t)
+{
+	assert(t.is_linked());
+
+	if (t.slot == READY_SLOT) {
+		ready.erase(ready.iterator_to(t));
+		return;
+	}
+
+	TimerList &list = slots[t.slot];
+	list.erase(list.iterator_to(t));
+	if (list.empty())
+		ClearBit(t.slot);
+
+	assert(count > 0);
+	--count;
+}
+
+template<typename F>
+inline void
+TimerWheel::TakeSlot(unsigned slot, F &&f)
+{
+	TimerList &list = slots[slot];
+	while (!list.empty()) {
+		Timer &t = list.front();
+		list.pop_front();
+		--count;
+		f(t);
+	}
+
+	ClearBit(slot);
+}
+
+void
+TimerWheel::Cascade(unsigned slot)
+{
+	/* the timers are inserted into lower levels only, so this
+	   does not modify the list being iterated */
+	TakeSlot(slot, [this](Timer &t){
+			Insert(t);
+		});
+}
+
+void
+TimerWheel::ProcessTick()
+{
+	const unsigned index = wheel_ms & (LEVEL0_SIZE - 1);
+	if (index == 0) {
+		/* the first level has wrapped around: pull down the
+		   next slot of each upper level whose lower levels
+		   have wrapped as well */
+		for (unsigned level = 1; level <= N_UPPER_LEVELS; ++level) {
+			const unsigned i = (wheel_ms >> LevelShift(level))
+				& (LEVEL_SIZE - 1);
+			Cascade(LEVEL0_SIZE + (level - 1) * LEVEL_SIZE + i);
+			if (i != 0)
+				break;
+		}
+	}
+
+	TakeSlot(index, [this](Timer &t){
+			t.slot = READY_SLOT;
+			ready.push_back(t);
+		});
+
+	++wheel_ms;
+}
+
+unsigned
+TimerWheel::GetNextEventTick() const
+{
+	assert(count > 0);
+
+	/* the distance from #wheel_ms; unsigned arithmetic because
+	   the upper levels may be more than 2^31 ahead */
+	unsigned best = ~0u;
+
+	const unsigned d0 = FindNextBit(bitmap, LEVEL0_SIZE,
+					wheel_ms & (LEVEL0_SIZE - 1));
+	if (d0 < LEVEL0_SIZE)
+		best = d0;
+
+	for (unsigned level = 1; level <= N_UPPER_LEVELS; ++level) {
+		const unsigned shift = LevelShift(level);
+		const unsigned mask = (1u << shift) - 1;
+
+		/* the first tick >= wheel_ms at which this level
+		   cascades */
+		const unsigned base = (wheel_ms + mask) & ~mask;
+		const unsigned i = (base >> shift) & (LEVEL_SIZE - 1);
+
+		const unsigned word = (LEVEL0_SIZE + (level - 1) * LEVEL_SIZE) / 64;
+		const unsigned d = FindNextBit(bitmap + word, LEVEL_SIZE, i);
+		if (d < LEVEL_SIZE) {
+			const unsigned distance = base + (d << shift) - wheel_ms;
+			if (distance < best)
+				best = distance;
+		}
+	}
+
+	assert(best != ~0u);
+	return wheel_ms + best;
+}
+
+void
+TimerWheel::Advance(unsigned now_ms)
+{
+	while (int(now_ms - wheel_ms) >= 0) {
+		if (count == 0) {
+			wheel_ms = now_ms + 1;
+			break;
+		}
+
+		/* skip the ticks which have nothing to do; compare
+		   distances because the next event may be more than
+		   2^31 ticks ahead */
+		const unsigned next = GetNextEventTick();
+		if (next - wheel_ms > now_ms - wheel_ms) {
+			wheel_ms = now_ms + 1;
+			break;
+		}
+
+		wheel_ms = next;
+		ProcessTick();
+	}
+}
+
+int
+TimerWheel::GetTimeout(unsigned now_ms) const
+{
+	if (!ready.empty())
+		return 0;
+
+	if (count == 0)
+		return -1;
+
+	const unsigned timeout = GetNextEventTick() - now_ms;
+	return timeout < 0x7fffffff ? int(timeout) : 0x7fffffff;
+}
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_EVENT_TIMER_WHEEL_HXX
+#define MPD_EVENT_TIMER_WHEEL_HXX
+
+#include "check.h"
+#include "Compiler.h"
+
+#include <boost/intrusive/list.hpp>
+
+#include <stdint.h>
+
+/**
+ * A hierarchical timer wheel with millisecond resolution.  Timers are
+ * intrusive list nodes, so adding and cancelling them does not
+ * allocate memory and costs O(1).
+ *
+ * The first level has 256 slots of one millisecond each; four more
+ * levels have 64 slots each and cover the remaining bits of the
+ * 32 bit monotonic clock.  When the wheel passes a slot boundary of
+ * an upper level, the timers of that slot are moved ("cascaded")
+ * down to the lower levels.
+ *
+ * This class is not thread-safe.
+ */
+class TimerWheel {
+	/* tagged, so classes which derive from #Timer can have other
+	   list hooks */
+	typedef boost::intrusive::list_base_hook<boost::intrusive::tag<TimerWheel>,
+						 boost::intrusive::link_mode<boost::intrusive::safe_link>> Hook;
+
+public:
+	class Timer : public Hook {
+		friend class TimerWheel;
+
+		/**
+		 * Projected monotonic_clock_ms() value when this
+		 * timer is due.
+		 */
+		unsigned due_ms;
+
+		/**
+		 * The slot this timer is linked into, or #READY_SLOT.
+		 */
+		uint16_t slot;
+	};
+
+private:
+	typedef boost::intrusive::list<Timer,
+				       boost::intrusive::base_hook<Hook>,
+				       boost::intrusive::constant_time_size<false>> TimerList;
+
+	static constexpr unsigned LEVEL0_BITS = 8;
+	static constexpr unsigned LEVEL_BITS = 6;
+	static constexpr unsigned N_UPPER_LEVELS = 4;
+
+	static constexpr unsigned LEVEL0_SIZE = 1 << LEVEL0_BITS;
+	static constexpr unsigned LEVEL_SIZE = 1 << LEVEL_BITS;
+
+	static constexpr unsigned N_SLOTS =
+		LEVEL0_SIZE + N_UPPER_LEVELS * LEVEL_SIZE;
+	static constexpr uint16_t READY_SLOT = N_SLOTS;
+
+	TimerList slots[N_SLOTS];
+
+	/**
+	 * One bit for each non-empty element of #slots.
+	 */
+	uint64_t bitmap[N_SLOTS / 64];
+
+	/**
+	 * Timers which are due, but have not yet been returned by
+	 * PopReady().
+	 */
+	TimerList ready;
+
+	/**
+	 * The number of timers in #slots.
+	 */
+	unsigned count;
+
+	/**
+	 * The next tick (monotonic clock millisecond) to be
+	 * processed by Advance().
+	 */
+	unsigned wheel_ms;
+
+public:
+	explicit TimerWheel(unsigned now_ms)
+		:bitmap(), count(0), wheel_ms(now_ms) {}
+
+#ifndef NDEBUG
+	~TimerWheel() {
+		assert(IsEmpty());
+	}
+#endif
+
+	TimerWheel(const TimerWheel &) = delete;
+	TimerWheel &operator=(const TimerWheel &) = delete;
+
+	bool IsEmpty() const {
+		return count == 0 && ready.empty();
+	}
+
+	/**
+	 * Schedule the timer to expire after the specified number of
+	 * milliseconds.  The timer must not be linked already.
+	 */
+	void Add(Timer &t, unsigned now_ms, unsigned ms);
+
+	/**
+	 * Cancel a timer which was previously passed to Add().
+	 */
+	void Remove(Timer &t);
+
+	/**
+	 * Move all timers which are due at @now_ms to the "ready"
+	 * list.
+	 */
+	void Advance(unsigned now_ms);
+
+	/**
+	 * Remove the first "ready" timer and return it.  Returns
+	 * nullptr if no timer is ready.
+	 */
+	Timer *PopReady() {
+		if (ready.empty())
+			return nullptr;
+
+		Timer &t = ready.front();
+		ready.pop_front();
+		return &t;
+	}
+
+	/**
+	 * Determine how many milliseconds to wait before Advance()
+	 * must be called again.  The result may be earlier than the
+	 * next timer expiry if the wheel needs to cascade.
+	 *
+	 * @param now_ms the value which was last passed to Advance()
+	 * @return the timeout in milliseconds or -1 if there are no
+	 * timers
+	 */
+	gcc_pure
+	int GetTimeout(unsigned now_ms) const;
+
+private:
+	/**
+	 * Link the timer into the slot which corresponds to its due
+	 * time, relative to #wheel_ms.
+	 */
+	void Insert(Timer &t);
+
+	/**
+	 * Unlink all timers from the slot and pass them to the
+	 * given function.
+	 */
+	template<typename F>
+	void TakeSlot(unsigned slot, F &&f);
+
+	/**
+	 * Move the timers of the specified upper level slot down to
+	 * the lower levels.
+	 */
+	void Cascade(unsigned slot);
+
+	/**
+	 * Process the tick #wheel_ms and increment it.
+	 */
+	void ProcessTick();
+
+	/**
+	 * Returns the next tick at which ProcessTick() has something
+	 * to do: run a non-empty first level slot or cascade a
+	 * non-empty upper level slot.  The wheel must not be empty.
+	 */
+	gcc_pure
+	unsigned GetNextEventTick() const;
+
+	void SetBit(unsigned slot) {
+		bitmap[slot / 64] |= uint64_t(1) << (slot % 64);
+	}
+
+	void ClearBit(unsigned slot) {
+		bitmap[slot / 64] &= ~(uint64_t(1) << (slot % 64));
+	}
+};
+
+#endif
@@ -66,6 +66,17 @@ public:
 	 * error
 	 */
 	virtual ConstBuffer<void> FilterPCM(ConstBuffer<void> src, Error &error) = 0;
+
+	/**
+	 * Would FilterPCM() currently return its input unmodified?
+	 * The answer depends on the current settings (e.g. the
+	 * volume level), so it must be asked again before each
+	 * FilterPCM() call.  May only be called while the filter is
+	 * open.
+	 */
+	virtual bool IsPassthrough() const {
+		return false;
+	}
 };
 
 #endif
@@ -51,6 +51,11 @@ public:
 	virtual void Close() override;
 	virtual ConstBuffer<void> FilterPCM(ConstBuffer<void> src,
 					    Error &error) override;
+
+	virtual bool IsPassthrough() const override {
+		return (convert == nullptr || convert->IsPassthrough()) &&
+			filter->IsPassthrough();
+	}
 };
 
 AudioFormat
@@ -114,7 +119,7 @@ AutoConvertFilter::Close()
 ConstBuffer<void>
 AutoConvertFilter::FilterPCM(ConstBuffer<void> src, Error &error)
 {
-	if (convert != nullptr) {
+	if (convert != nullptr && !convert->IsPassthrough()) {
 		src = convert->FilterPCM(src, error);
 		if (src.IsNull())
 			return nullptr;
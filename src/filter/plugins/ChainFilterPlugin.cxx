@@ -57,6 +57,7 @@ public:
 	virtual void Close();
 	virtual ConstBuffer<void> FilterPCM(ConstBuffer<void> src,
 					    Error &error);
+	virtual bool IsPassthrough() const override;
 
 private:
 	/**
@@ -148,6 +149,11 @@ ConstBuffer<void>
 ChainFilter::FilterPCM(ConstBuffer<void> src, Error &error)
 {
 	for (auto &child : children) {
+		if (child.filter->IsPassthrough())
+			/* this filter has nothing to do at its current
+			   settings; skip it */
+			continue;
+
 		/* feed the output of the previous filter as input
 		   into the current one */
 		src = child.filter->FilterPCM(src, error);
@@ -159,6 +165,16 @@ ChainFilter::FilterPCM(ConstBuffer<void> src, Error &error)
 	return src;
 }
 
+bool
+ChainFilter::IsPassthrough() const
+{
+	for (const auto &child : children)
+		if (!child.filter->IsPassthrough())
+			return false;
+
+	return true;
+}
+
 const struct filter_plugin chain_filter_plugin = {
 	"chain",
 	chain_filter_init,
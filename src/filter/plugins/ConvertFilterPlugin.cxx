@@ -23,12 +23,16 @@
 #include "filter/FilterInternal.hxx"
 #include "filter/FilterRegistry.hxx"
 #include "pcm/PcmConvert.hxx"
+#include "config/ConfigData.hxx"
+#include "config/ConfigError.hxx"
 #include "util/Manual.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/Error.hxx"
 #include "AudioFormat.hxx"
 #include "poison.h"
 
 #include <assert.h>
+#include <string.h>
 
 class ConvertFilter final : public Filter {
 	/**
@@ -49,20 +53,52 @@ class ConvertFilter final : public Filter {
 
 	Manual<PcmConvert> state;
 
+	const PcmDitherMode dither_mode;
+
 public:
+	explicit ConvertFilter(PcmDitherMode _dither_mode)
+		:dither_mode(_dither_mode) {}
+
 	bool Set(const AudioFormat &_out_audio_format, Error &error);
 
 	virtual AudioFormat Open(AudioFormat &af, Error &error) override;
 	virtual void Close() override;
 	virtual ConstBuffer<void> FilterPCM(ConstBuffer<void> src,
 					    Error &error) override;
+
+	virtual bool IsPassthrough() const override {
+		return !out_audio_format.IsValid();
+	}
 };
 
+static bool
+parse_dither_mode(const char *value, PcmDitherMode &mode_r)
+{
+	if (strcmp(value, "rectangular") == 0)
+		mode_r = PcmDitherMode::RECTANGULAR;
+	else if (strcmp(value, "tpdf") == 0)
+		mode_r = PcmDitherMode::TPDF;
+	else if (strcmp(value, "shaped") == 0)
+		mode_r = PcmDitherMode::SHAPED;
+	else
+		return false;
+
+	return true;
+}
+
 static Filter *
-convert_filter_init(gcc_unused const config_param &param,
-		    gcc_unused Error &error)
+convert_filter_init(const config_param &param, Error &error)
 {
-	return new ConvertFilter();
+	PcmDitherMode dither_mode = PcmDitherMode::SHAPED;
+
+	const char *value = param.GetBlockValue("dither");
+	if (value != nullptr && !parse_dither_mode(value, dither_mode)) {
+		error.Format(config_domain,
+			     "Invalid \"dither\" value: %s", value);
+		return nullptr;
+	}
+
+	return new ConvertFilter(dither_mode);
 }
 
 bool
@@ -100,6 +136,7 @@ ConvertFilter::Open(AudioFormat &audio_format, gcc_unused Error &error)
 	out_audio_format.Clear();
 
 	state.Construct();
+	state->SetDitherMode(dither_mode);
 
 	return in_audio_format;
 }
@@ -26,11 +26,14 @@
 #include "AudioCompress/compress.h"
 #include "util/ConstBuffer.hxx"
 
+#include <assert.h>
 #include <string.h>
 
 class NormalizeFilter final : public Filter {
 	struct Compressor *compressor;
 
+	SampleFormat format;
+
 	PcmBuffer buffer;
 
 public:
@@ -50,8 +53,20 @@ normalize_filter_init(gcc_unused const config_param &param,
 AudioFormat
 NormalizeFilter::Open(AudioFormat &audio_format, gcc_unused Error &error)
 {
-	audio_format.format = SampleFormat::S16;
+	switch (audio_format.format) {
+	case SampleFormat::S16:
+	case SampleFormat::S24_P32:
+	case SampleFormat::S32:
+	case SampleFormat::FLOAT:
+		/* these are processed natively */
+		break;
+
+	default:
+		audio_format.format = SampleFormat::FLOAT;
+		break;
+	}
 
+	format = audio_format.format;
 	compressor = Compressor_new(0);
 
 	return audio_format;
@@ -67,10 +82,35 @@ NormalizeFilter::Close()
 ConstBuffer<void>
 NormalizeFilter::FilterPCM(ConstBuffer<void> src, gcc_unused Error &error)
 {
-	int16_t *dest = (int16_t *)buffer.Get(src.size);
+	void *dest = buffer.Get(src.size);
 	memcpy(dest, src.data, src.size);
 
-	Compressor_Process_int16(compressor, dest, src.size / 2);
+	switch (format) {
+	case SampleFormat::S16:
+		Compressor_Process_int16(compressor, (int16_t *)dest,
+					 src.size / sizeof(int16_t));
+		break;
+
+	case SampleFormat::S24_P32:
+		Compressor_Process_int32(compressor, (int32_t *)dest,
+					 src.size / sizeof(int32_t), 24);
+		break;
+
+	case SampleFormat::S32:
+		Compressor_Process_int32(compressor, (int32_t *)dest,
+					 src.size / sizeof(int32_t), 32);
+		break;
+
+	case SampleFormat::FLOAT:
+		Compressor_Process_float(compressor, (float *)dest,
+					 src.size / sizeof(float));
+		break;
+
+	default:
+		assert(false);
+		gcc_unreachable();
+	}
+
 	return { (const void *)dest, src.size };
 }
 
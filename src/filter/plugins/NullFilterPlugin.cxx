@@ -45,6 +45,10 @@ public:
 					    gcc_unused Error &error) override {
 		return src;
 	}
+
+	virtual bool IsPassthrough() const override {
+		return true;
+	}
 };
 
 static Filter *
@@ -22,6 +22,7 @@
 #include "filter/FilterPlugin.hxx"
 #include "filter/FilterInternal.hxx"
 #include "filter/FilterRegistry.hxx"
+#include "filter/plugins/VolumeFilterPlugin.hxx"
 #include "AudioFormat.hxx"
 #include "ReplayGainInfo.hxx"
 #include "ReplayGainConfig.hxx"
@@ -69,12 +70,39 @@ class ReplayGainFilter final : public Filter {
 	 */
 	PcmVolume pv;
 
+	/**
+	 * The volume calculated by Update(), without #volume_filter.
+	 */
+	unsigned volume;
+
+	/**
+	 * If set, then the volume of this filter (the software mixer)
+	 * is applied together with the replay gain.
+	 */
+	const Filter *volume_filter;
+
 public:
 	ReplayGainFilter()
-		:mixer(nullptr), mode(REPLAY_GAIN_OFF) {
+		:mixer(nullptr), mode(REPLAY_GAIN_OFF),
+		 volume(PCM_VOLUME_1), volume_filter(nullptr) {
 		info.Clear();
 	}
 
+	void SetVolumeFilter(const Filter *_volume_filter) {
+		volume_filter = _volume_filter;
+	}
+
+	/**
+	 * Returns the volume which is applied to the signal,
+	 * including #volume_filter.
+	 */
+	unsigned GetVolume() const {
+		return volume_filter != nullptr
+			? (volume * volume_filter_get(volume_filter) +
+			   PCM_VOLUME_1 / 2) / PCM_VOLUME_1
+			: volume;
+	}
+
 	void SetMixer(Mixer *_mixer, unsigned _base) {
 		assert(_mixer == nullptr || (_base > 0 && _base <= 100));
 
@@ -116,12 +144,16 @@ public:
 	virtual void Close();
 	virtual ConstBuffer<void> FilterPCM(ConstBuffer<void> src,
 					    Error &error) override;
+
+	virtual bool IsPassthrough() const override {
+		return GetVolume() == PCM_VOLUME_1;
+	}
 };
 
 void
 ReplayGainFilter::Update()
 {
-	unsigned volume = PCM_VOLUME_1;
+	volume = PCM_VOLUME_1;
 	if (mode != REPLAY_GAIN_OFF) {
 		const auto &tuple = info.tuples[mode];
 		float scale = tuple.CalculateScale(replay_gain_preamp,
@@ -133,8 +165,6 @@ ReplayGainFilter::Update()
 		volume = pcm_float_to_volume(scale);
 	}
 
-	pv.SetVolume(volume);
-
 	if (mixer != nullptr) {
 		/* update the hardware mixer volume */
 
@@ -173,6 +203,7 @@ ReplayGainFilter::Close()
 ConstBuffer<void>
 ReplayGainFilter::FilterPCM(ConstBuffer<void> src, gcc_unused Error &error)
 {
+	pv.SetVolume(GetVolume());
 	return pv.Apply(src);
 }
 
@@ -205,3 +236,20 @@ replay_gain_filter_set_mode(Filter *_filter, ReplayGainMode mode)
 
 	filter->SetMode(mode);
 }
+
+void
+replay_gain_filter_set_volume_filter(Filter *_filter,
+				     const Filter *volume_filter)
+{
+	ReplayGainFilter *filter = (ReplayGainFilter *)_filter;
+
+	filter->SetVolumeFilter(volume_filter);
+}
+
+unsigned
+replay_gain_filter_get_volume(const Filter *_filter)
+{
+	const ReplayGainFilter *filter = (const ReplayGainFilter *)_filter;
+
+	return filter->GetVolume();
+}
@@ -49,4 +49,23 @@ replay_gain_filter_set_info(Filter *filter, const ReplayGainInfo *info);
 void
 replay_gain_filter_set_mode(Filter *filter, ReplayGainMode mode);
 
+/**
+ * Apply the volume of the specified volume_filter_plugin instance
+ * (the software mixer) together with the replay gain, which saves
+ * one pass over the signal.  That volume filter must not be
+ * installed in the filter chain then.
+ *
+ * @param volume_filter the volume filter, or nullptr to disable
+ */
+void
+replay_gain_filter_set_volume_filter(Filter *filter,
+				     const Filter *volume_filter);
+
+/**
+ * Returns the volume level (#PCM_VOLUME_1 is 100%) this filter
+ * currently applies, including the volume filter.
+ */
+unsigned
+replay_gain_filter_get_volume(const Filter *filter);
+
 #endif
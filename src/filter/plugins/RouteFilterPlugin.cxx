@@ -47,6 +47,7 @@
 #include "filter/FilterInternal.hxx"
 #include "filter/FilterRegistry.hxx"
 #include "pcm/PcmBuffer.hxx"
+#include "pcm/PcmChannels.hxx"
 #include "util/StringUtil.hxx"
 #include "util/Error.hxx"
 #include "util/ConstBuffer.hxx"
@@ -54,7 +55,6 @@
 #include <algorithm>
 
 #include <assert.h>
-#include <string.h>
 #include <stdint.h>
 #include <stdlib.h>
 
@@ -92,16 +92,16 @@ class RouteFilter final : public Filter {
 	AudioFormat output_format;
 
 	/**
-	 * The size, in bytes, of each multichannel frame in the
-	 * input buffer
+	 * The routing table for pcm_route_channels(), derived from
+	 * #sources for the actual number of input channels.
 	 */
-	size_t input_frame_size;
+	int8_t route_table[MAX_CHANNELS];
 
 	/**
-	 * The size, in bytes, of each multichannel frame in the
-	 * output buffer
+	 * True if the routing table copies all input channels
+	 * unmodified; the input is then passed through.
 	 */
-	size_t output_frame_size;
+	bool identity;
 
 	/**
 	 * The output buffer used last time around, can be reused if the size doesn't differ.
@@ -220,15 +220,23 @@ RouteFilter::Open(AudioFormat &audio_format, gcc_unused Error &error)
 {
 	// Copy the input format for later reference
 	input_format = audio_format;
-	input_frame_size = input_format.GetFrameSize();
 
 	// Decide on an output format which has enough channels,
 	// and is otherwise identical
 	output_format = audio_format;
 	output_format.channels = min_output_channels;
 
-	// Precalculate this simple value, to speed up allocation later
-	output_frame_size = output_format.GetFrameSize();
+	// Precalculate the routing table; sources which are not
+	// present in the input are replaced with silence
+	identity = output_format.channels == input_format.channels;
+	for (unsigned c = 0; c < min_output_channels; ++c) {
+		route_table[c] = (unsigned)sources[c] < input_format.channels
+			? sources[c]
+			: -1;
+
+		if (route_table[c] != int8_t(c))
+			identity = false;
+	}
 
 	return output_format;
 }
@@ -242,52 +250,13 @@ RouteFilter::Close()
 ConstBuffer<void>
 RouteFilter::FilterPCM(ConstBuffer<void> src, gcc_unused Error &error)
 {
-	size_t number_of_frames = src.size / input_frame_size;
-
-	const size_t bytes_per_frame_per_channel = input_format.GetSampleSize();
-
-	// A moving pointer that always refers to channel 0 in the input, at the currently handled frame
-	const uint8_t *base_source = (const uint8_t *)src.data;
-
-	// Grow our reusable buffer, if needed, and set the moving pointer
-	const size_t result_size = number_of_frames * output_frame_size;
-	void *const result = output_buffer.Get(result_size);
-
-	// A moving pointer that always refers to the currently filled channel of the currently handled frame, in the output
-	uint8_t *chan_destination = (uint8_t *)result;
-
-	// Perform our copy operations, with N input channels and M output channels
-	for (unsigned int s=0; s<number_of_frames; ++s) {
-
-		// Need to perform one copy per output channel
-		for (unsigned int c=0; c<min_output_channels; ++c) {
-			if (sources[c] == -1 ||
-			    (unsigned)sources[c] >= input_format.channels) {
-				// No source for this destination output,
-				// give it zeroes as input
-				memset(chan_destination,
-					0x00,
-					bytes_per_frame_per_channel);
-			} else {
-				// Get the data from channel sources[c]
-				// and copy it to the output
-				const uint8_t *data = base_source +
-					(sources[c] * bytes_per_frame_per_channel);
-				memcpy(chan_destination,
-					  data,
-					  bytes_per_frame_per_channel);
-			}
-			// Move on to the next output channel
-			chan_destination += bytes_per_frame_per_channel;
-		}
-
-
-		// Go on to the next N input samples
-		base_source += input_frame_size;
-	}
+	if (identity)
+		return src;
 
-	// Here it is, ladies and gentlemen! Rerouted data!
-	return { result, result_size };
+	return pcm_route_channels(output_buffer, input_format.format,
+				  output_format.channels,
+				  input_format.channels,
+				  route_table, src);
 }
 
 const struct filter_plugin route_filter_plugin = {
@@ -47,6 +47,10 @@ public:
 	virtual void Close();
 	virtual ConstBuffer<void> FilterPCM(ConstBuffer<void> src,
 					    Error &error) override;
+
+	virtual bool IsPassthrough() const override {
+		return pv.GetVolume() == PCM_VOLUME_1;
+	}
 };
 
 static constexpr Domain volume_domain("pcm_volume");
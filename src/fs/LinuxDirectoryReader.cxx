@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#ifdef __linux__
+#include "LinuxDirectoryReader.hxx"
+#include "system/fd_util.h"
+
+#include <sys/syscall.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+LinuxDirectoryReader::LinuxDirectoryReader(Path dir)
+	:fd(open_cloexec(dir.c_str(), O_RDONLY|O_DIRECTORY, 0)),
+	 buffer(fd >= 0 ? new uint64_t[BUFFER_SIZE / sizeof(uint64_t)]
+		: nullptr),
+	 fill(0), position(0), ent(nullptr)
+{
+}
+
+LinuxDirectoryReader::~LinuxDirectoryReader()
+{
+	if (!HasFailed()) {
+		delete[] buffer;
+		close(fd);
+	}
+}
+
+bool
+LinuxDirectoryReader::ReadEntry()
+{
+	assert(!HasFailed());
+
+	if (position >= fill) {
+		/* the glibc wrapper getdents64() is fairly new; use
+		   the system call */
+		long nbytes = syscall(SYS_getdents64, fd, buffer,
+				      BUFFER_SIZE);
+		if (nbytes <= 0) {
+			/* end of directory or error */
+			ent = nullptr;
+			return false;
+		}
+
+		fill = nbytes;
+		position = 0;
+	}
+
+	ent = (const struct dirent64 *)((const char *)buffer + position);
+	position += ent->d_reclen;
+	return true;
+}
+
+Path
+LinuxDirectoryReader::GetEntry() const
+{
+	assert(HasEntry());
+
+	return Path::FromFS(ent->d_name);
+}
+
+unsigned char
+LinuxDirectoryReader::GetType() const
+{
+	assert(HasEntry());
+
+	return ent->d_type;
+}
+
+#endif
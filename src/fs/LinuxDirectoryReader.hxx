@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_FS_LINUX_DIRECTORY_READER_HXX
+#define MPD_FS_LINUX_DIRECTORY_READER_HXX
+
+#include "check.h"
+#include "Path.hxx"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct dirent64;
+
+/**
+ * A directory reader which calls getdents64() directly with a large
+ * buffer, to fetch many entries per system call.  In addition to the
+ * name, it reports the entry type (d_type) and allows fstatat()
+ * relative to the directory file descriptor, so the caller does not
+ * need to resolve the full path again.
+ *
+ * Same interface as #DirectoryReader.  Linux only.
+ */
+class LinuxDirectoryReader {
+	static constexpr size_t BUFFER_SIZE = 64 * 1024;
+
+	const int fd;
+
+	/**
+	 * The getdents64() buffer.  uint64_t for the alignment of
+	 * struct dirent64.
+	 */
+	uint64_t *const buffer;
+
+	size_t fill, position;
+
+	const struct dirent64 *ent;
+
+public:
+	explicit LinuxDirectoryReader(Path dir);
+	~LinuxDirectoryReader();
+
+	LinuxDirectoryReader(const LinuxDirectoryReader &other) = delete;
+	LinuxDirectoryReader &operator=(const LinuxDirectoryReader &other) = delete;
+
+	bool HasFailed() const {
+		return fd < 0;
+	}
+
+	bool HasEntry() const {
+		assert(!HasFailed());
+		return ent != nullptr;
+	}
+
+	/**
+	 * The directory file descriptor, for use with fstatat().
+	 */
+	int GetFD() const {
+		assert(!HasFailed());
+		return fd;
+	}
+
+	bool ReadEntry();
+
+	gcc_pure
+	Path GetEntry() const;
+
+	/**
+	 * Returns the type of the current entry (DT_REG, DT_DIR,
+	 * ...), or DT_UNKNOWN if the file system does not provide it.
+	 */
+	gcc_pure
+	unsigned char GetType() const;
+};
+
+#endif
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "BackgroundWriter.hxx"
+#include "FileOutputStream.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <list>
+
+#include <assert.h>
+#include <string.h>
+
+static constexpr Domain background_writer_domain("background_writer");
+
+struct BackgroundWrite {
+	AllocatedPath path;
+	std::string data;
+
+	BackgroundWrite(AllocatedPath &&_path, std::string &&_data)
+		:path(std::move(_path)), data(std::move(_data)) {}
+};
+
+static struct {
+	Mutex mutex;
+	Cond cond;
+
+	Thread thread;
+
+	std::list<BackgroundWrite> queue;
+
+	/**
+	 * The number of failed writes.  Protected by #mutex.
+	 */
+	unsigned failures;
+
+	bool quit;
+} bw;
+
+static void
+WriteFile(const BackgroundWrite &w)
+{
+	Error error;
+	FileOutputStream fos(w.path, error);
+	if (!fos.IsDefined() ||
+	    !fos.Write(w.data.data(), w.data.size(), error) ||
+	    !fos.Commit(error)) {
+		LogError(error);
+
+		const ScopeLock protect(bw.mutex);
+		++bw.failures;
+		return;
+	}
+
+	FormatDebug(background_writer_domain, "Wrote %s (%lu bytes)",
+		    w.path.c_str(), (unsigned long)w.data.size());
+}
+
+static void
+background_writer_func(gcc_unused void *ctx)
+{
+	SetThreadName("writer");
+
+	bw.mutex.lock();
+
+	while (true) {
+		if (bw.queue.empty()) {
+			if (bw.quit)
+				break;
+
+			bw.cond.wait(bw.mutex);
+			continue;
+		}
+
+		BackgroundWrite w = std::move(bw.queue.front());
+		bw.queue.pop_front();
+
+		bw.mutex.unlock();
+		WriteFile(w);
+		bw.mutex.lock();
+	}
+
+	bw.mutex.unlock();
+}
+
+void
+background_writer_init()
+{
+	assert(!bw.thread.IsDefined());
+
+	bw.quit = false;
+
+	Error error;
+	if (!bw.thread.Start(background_writer_func, nullptr, error))
+		/* not fatal: background_writer_submit() falls back
+		   to synchronous writes */
+		LogError(error);
+}
+
+void
+background_writer_finish()
+{
+	if (!bw.thread.IsDefined())
+		return;
+
+	bw.mutex.lock();
+	bw.quit = true;
+	bw.cond.signal();
+	bw.mutex.unlock();
+
+	bw.thread.Join();
+
+	assert(bw.queue.empty());
+}
+
+void
+background_writer_submit(AllocatedPath &&path, std::string &&data)
+{
+	if (!bw.thread.IsDefined()) {
+		WriteFile(BackgroundWrite(std::move(path), std::move(data)));
+		return;
+	}
+
+	const ScopeLock protect(bw.mutex);
+
+	for (auto &w : bw.queue) {
+		if (strcmp(w.path.c_str(), path.c_str()) == 0) {
+			/* coalesce: only the newest version needs to
+			   be written */
+			w.data = std::move(data);
+			return;
+		}
+	}
+
+	bw.queue.emplace_back(std::move(path), std::move(data));
+	bw.cond.signal();
+}
+
+unsigned
+background_writer_get_failures()
+{
+	const ScopeLock protect(bw.mutex);
+	return bw.failures;
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_BACKGROUND_WRITER_HXX
+#define MPD_BACKGROUND_WRITER_HXX
+
+#include "check.h"
+
+#include <string>
+
+class AllocatedPath;
+
+/*
+ * A thread which writes small files (e.g. the state file) to disk,
+ * including the fdatasync() call, so the main thread does not block
+ * on a slow or sleeping storage device.
+ */
+
+void
+background_writer_init();
+
+/**
+ * Write all pending files and stop the thread.
+ */
+void
+background_writer_finish();
+
+/**
+ * Schedule replacing the file with the given contents.  If a write
+ * to the same file is still pending, it is replaced by the new one.
+ * Errors are logged and counted (see
+ * background_writer_get_failures()).
+ *
+ * If the thread is not running, the file is written synchronously.
+ */
+void
+background_writer_submit(AllocatedPath &&path, std::string &&data);
+
+/**
+ * Returns the number of writes which have failed so far.  A caller
+ * which compares it with an earlier value learns whether it needs
+ * to submit its files again.
+ */
+unsigned
+background_writer_get_failures();
+
+#endif
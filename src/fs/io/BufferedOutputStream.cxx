@@ -52,7 +52,11 @@ BufferedOutputStream::Write(const void *data, size_t size)
 	if (AppendToBuffer(data, size))
 		return true;
 
-	return os.Write(data, size, last_error);
+	if (!os.Write(data, size, last_error))
+		return false;
+
+	flushed += size;
+	return true;
 }
 
 bool
@@ -121,8 +125,10 @@ BufferedOutputStream::Flush()
 		return true;
 
 	bool success = os.Write(r.data, r.size, last_error);
-	if (gcc_likely(success))
+	if (gcc_likely(success)) {
+		flushed += r.size;
 		buffer.Consume(r.size);
+	}
 	return success;
 }
 
@@ -137,7 +143,9 @@ BufferedOutputStream::Flush(Error &error)
 		return true;
 
 	bool success = os.Write(r.data, r.size, error);
-	if (gcc_likely(success))
+	if (gcc_likely(success)) {
+		flushed += r.size;
 		buffer.Consume(r.size);
+	}
 	return success;
 }
@@ -26,6 +26,7 @@
 #include "util/Error.hxx"
 
 #include <stddef.h>
+#include <stdint.h>
 
 class OutputStream;
 class Error;
@@ -35,11 +36,16 @@ class BufferedOutputStream {
 
 	DynamicFifoBuffer<char> buffer;
 
+	/**
+	 * The number of bytes which were passed to #os so far.
+	 */
+	uint64_t flushed;
+
 	Error last_error;
 
 public:
 	BufferedOutputStream(OutputStream &_os)
-		:os(_os), buffer(32768) {}
+		:os(_os), buffer(32768), flushed(0) {}
 
 	bool Write(const void *data, size_t size);
 	bool Write(const char *p);
@@ -60,6 +66,15 @@ public:
 			return true;
 	}
 
+	/**
+	 * Returns the number of bytes written to this object so far,
+	 * including those which are still in the buffer.
+	 */
+	gcc_pure
+	uint64_t GetPosition() const {
+		return flushed + buffer.GetAvailable();
+	}
+
 	bool Flush();
 
 	bool Flush(Error &error);
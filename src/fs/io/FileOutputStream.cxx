@@ -25,15 +25,26 @@
 
 #ifdef WIN32
 
-FileOutputStream::FileOutputStream(Path _path, Error &error)
+FileOutputStream::FileOutputStream(Path _path, Error &error, Mode _mode)
 	:path(_path),
 	 handle(CreateFile(path.c_str(), GENERIC_WRITE, 0, nullptr,
-			   TRUNCATE_EXISTING,
+			   _mode == Mode::APPEND
+			   ? OPEN_ALWAYS
+			   : TRUNCATE_EXISTING,
 			   FILE_ATTRIBUTE_NORMAL|FILE_FLAG_WRITE_THROUGH,
-			   nullptr))
+			   nullptr)),
+	 mode(_mode)
 {
-	if (handle == INVALID_HANDLE_VALUE)
+	if (handle == INVALID_HANDLE_VALUE) {
 		error.FormatLastError("Failed to create %s", path.c_str());
+		return;
+	}
+
+	if (mode == Mode::APPEND) {
+		LARGE_INTEGER zero;
+		zero.QuadPart = 0;
+		SetFilePointerEx(handle, zero, &offset, FILE_END);
+	}
 }
 
 bool
@@ -56,6 +67,19 @@ FileOutputStream::Write(const void *data, size_t size, Error &error)
 	return true;
 }
 
+bool
+FileOutputStream::Sync(Error &error)
+{
+	assert(IsDefined());
+
+	if (!FlushFileBuffers(handle)) {
+		error.FormatLastError("Failed to sync %s", path.c_str());
+		return false;
+	}
+
+	return true;
+}
+
 bool
 FileOutputStream::Commit(gcc_unused Error &error)
 {
@@ -70,24 +94,80 @@ FileOutputStream::Cancel()
 {
 	assert(IsDefined());
 
+	if (mode == Mode::APPEND) {
+		SetFilePointerEx(handle, offset, nullptr, FILE_BEGIN);
+		SetEndOfFile(handle);
+		CloseHandle(handle);
+		return;
+	}
+
 	CloseHandle(handle);
 	RemoveFile(path);
 }
 
 #else
 
+#include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <string>
 
-FileOutputStream::FileOutputStream(Path _path, Error &error)
-	:path(_path),
-	 fd(open_cloexec(path.c_str(),
-			 O_WRONLY|O_CREAT|O_TRUNC,
-			 0666))
+/**
+ * Reserve disk space for the size of the previous version of the
+ * file, so the new one is less fragmented and a full disk is
+ * noticed early.  This grows the (empty) file to that size; the
+ * caller must truncate it to the size which was really written.
+ *
+ * @return true if space was reserved
+ */
+static bool
+Preallocate(int fd, Path path)
 {
-	if (fd < 0)
-		error.FormatErrno("Failed to create %s", path.c_str());
+#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+	struct stat st;
+	return StatFile(path, st) && S_ISREG(st.st_mode) && st.st_size > 0 &&
+		fallocate(fd, 0, 0, st.st_size) == 0;
+#else
+	(void)fd;
+	(void)path;
+	return false;
+#endif
+}
+
+FileOutputStream::FileOutputStream(Path _path, Error &error, Mode _mode)
+	:path(_path), tmp_path(AllocatedPath::Null()),
+	 preallocated(false), mode(_mode)
+{
+	if (mode == Mode::APPEND) {
+		fd = open_cloexec(path.c_str(), O_WRONLY|O_CREAT|O_APPEND,
+				  0666);
+		if (fd < 0) {
+			error.FormatErrno("Failed to create %s", path.c_str());
+			return;
+		}
+
+		offset = lseek(fd, 0, SEEK_END);
+		return;
+	}
+
+	if (mode == Mode::CREATE_VISIBLE) {
+		fd = open_cloexec(path.c_str(), O_WRONLY|O_CREAT|O_TRUNC,
+				  0666);
+		if (fd < 0)
+			error.FormatErrno("Failed to create %s", path.c_str());
+		return;
+	}
+
+	tmp_path = AllocatedPath::FromFS((std::string(path.c_str()) +
+					  ".tmp").c_str());
+	fd = open_cloexec(tmp_path.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0666);
+	if (fd < 0) {
+		error.FormatErrno("Failed to create %s", tmp_path.c_str());
+		return;
+	}
+
+	preallocated = Preallocate(fd, path);
 }
 
 bool
@@ -108,17 +188,66 @@ FileOutputStream::Write(const void *data, size_t size, Error &error)
 	return true;
 }
 
+bool
+FileOutputStream::Sync(Error &error)
+{
+	assert(IsDefined());
+
+#ifdef __linux__
+	const int result = fdatasync(fd);
+#else
+	const int result = fsync(fd);
+#endif
+	if (result < 0) {
+		error.FormatErrno("Failed to sync %s", path.c_str());
+		return false;
+	}
+
+	return true;
+}
+
 bool
 FileOutputStream::Commit(Error &error)
 {
 	assert(IsDefined());
 
+	if (mode == Mode::CREATE) {
+		if (preallocated) {
+			/* release the reserved space which was not
+			   overwritten */
+			const off_t size = lseek(fd, 0, SEEK_CUR);
+			if (size < 0 || ftruncate(fd, size) < 0) {
+				error.FormatErrno("Failed to truncate %s",
+						  tmp_path.c_str());
+				Cancel();
+				return false;
+			}
+		}
+
+		/* the data must be on the disk before the rename, or
+		   a crash may leave an empty or partial file behind */
+		if (!Sync(error)) {
+			Cancel();
+			return false;
+		}
+	}
+
 	bool success = close(fd) == 0;
 	fd = -1;
-	if (!success)
+	if (!success) {
 		error.FormatErrno("Failed to commit %s", path.c_str());
+		if (mode != Mode::APPEND)
+			RemoveFile(mode == Mode::CREATE ? tmp_path : path);
+		return false;
+	}
 
-	return success;
+	if (mode == Mode::CREATE && !RenameFile(tmp_path, path)) {
+		error.FormatErrno("Failed to rename %s", tmp_path.c_str());
+		RemoveFile(tmp_path);
+		return false;
+	}
+
+	return true;
 }
 
 void
@@ -126,10 +255,21 @@ FileOutputStream::Cancel()
 {
 	assert(IsDefined());
 
+	if (mode == Mode::APPEND) {
+		/* roll back */
+		if (offset >= 0 && ftruncate(fd, offset) < 0) {
+			/* ignore */
+		}
+
+		close(fd);
+		fd = -1;
+		return;
+	}
+
 	close(fd);
 	fd = -1;
 
-	RemoveFile(path);
+	RemoveFile(mode == Mode::CREATE ? tmp_path : path);
 }
 
 #endif
@@ -25,24 +25,69 @@
 #include "fs/AllocatedPath.hxx"
 
 #include <assert.h>
+#include <stdint.h>
 
 #ifdef WIN32
 #include <windows.h>
+#else
+#include <sys/types.h>
 #endif
 
 class Path;
 
 class FileOutputStream final : public OutputStream {
+public:
+	enum class Mode : uint8_t {
+		/**
+		 * Create a new file, or replace an existing one.  On
+		 * POSIX, the data is written to a temporary file which
+		 * is flushed to disk (see Sync()) and renamed by
+		 * Commit(), so neither readers nor a crash ever see a
+		 * partial file.  Cancel() deletes the temporary file.
+		 */
+		CREATE,
+
+		/**
+		 * Create a new file, or truncate an existing one, and
+		 * write it in place.  This is for callers which write
+		 * to a temporary name of their own and rename it
+		 * themselves.  Cancel() deletes the file.
+		 */
+		CREATE_VISIBLE,
+
+		/**
+		 * Append to an existing file, or create a new one.
+		 * Cancel() truncates it back to its previous size.
+		 */
+		APPEND,
+	};
+
+private:
 	AllocatedPath path;
 
 #ifdef WIN32
 	HANDLE handle;
+	LARGE_INTEGER offset;
 #else
 	int fd;
+	off_t offset;
+
+	/**
+	 * The temporary file for #Mode::CREATE.
+	 */
+	AllocatedPath tmp_path;
+
+	/**
+	 * Was disk space reserved for the temporary file?  Then
+	 * Commit() truncates the part which was not overwritten.
+	 */
+	bool preallocated;
 #endif
 
+	const Mode mode;
+
 public:
-	FileOutputStream(Path _path, Error &error);
+	FileOutputStream(Path _path, Error &error, Mode _mode=Mode::CREATE);
 
 	~FileOutputStream() {
 		if (IsDefined())
@@ -58,6 +103,13 @@ public:
 #endif
 	}
 
+	/**
+	 * Flush the data to the storage device (fdatasync()).  This
+	 * may take a long time.  Commit() calls it in #Mode::CREATE;
+	 * in the other modes, it is optional.
+	 */
+	bool Sync(Error &error);
+
 	bool Commit(Error &error);
 	void Cancel();
 
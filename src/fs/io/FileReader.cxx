@@ -48,6 +48,21 @@ FileReader::Read(void *data, size_t size, Error &error)
 	return nbytes;
 }
 
+bool
+FileReader::Seek(uint64_t offset, Error &error)
+{
+	assert(IsDefined());
+
+	LARGE_INTEGER distance;
+	distance.QuadPart = offset;
+	if (!SetFilePointerEx(handle, distance, nullptr, FILE_BEGIN)) {
+		error.FormatLastError("Failed to seek in %s", path.c_str());
+		return false;
+	}
+
+	return true;
+}
+
 void
 FileReader::Close()
 {
@@ -86,6 +101,19 @@ FileReader::Read(void *data, size_t size, Error &error)
 	return nbytes;
 }
 
+bool
+FileReader::Seek(uint64_t offset, Error &error)
+{
+	assert(IsDefined());
+
+	if (lseek(fd, (off_t)offset, SEEK_SET) < 0) {
+		error.FormatErrno("Failed to seek in %s", path.c_str());
+		return false;
+	}
+
+	return true;
+}
+
 void
 FileReader::Close()
 {
@@ -25,6 +25,7 @@
 #include "fs/AllocatedPath.hxx"
 
 #include <assert.h>
+#include <stdint.h>
 
 #ifdef WIN32
 #include <windows.h>
@@ -60,6 +61,11 @@ public:
 
 	void Close();
 
+	/**
+	 * Move the file pointer to the given absolute position.
+	 */
+	bool Seek(uint64_t offset, Error &error);
+
 	/* virtual methods from class Reader */
 	size_t Read(void *data, size_t size, Error &error) override;
 };
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "MappedLineReader.hxx"
+#include "fs/Path.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <string.h>
+
+#ifndef WIN32
+#include "system/fd_util.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Smaller files are read with read(); mapping them doesn't pay off.
+ */
+static constexpr size_t MIN_MAP_SIZE = 64 * 1024;
+
+MappedLineReader::~MappedLineReader()
+{
+#ifndef WIN32
+	munmap(const_cast<char *>(data), size);
+#endif
+}
+
+MappedLineReader *
+MappedLineReader::Open(Path path)
+{
+#ifdef WIN32
+	(void)path;
+	return nullptr;
+#else
+	int fd = open_cloexec(path.c_str(), O_RDONLY, 0);
+	if (fd < 0)
+		return nullptr;
+
+	struct stat st;
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+	    st.st_size < (off_t)MIN_MAP_SIZE ||
+	    (uint64_t)st.st_size > (uint64_t)SIZE_MAX) {
+		close(fd);
+		return nullptr;
+	}
+
+	const size_t size = st.st_size;
+	void *p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+		return nullptr;
+
+	const char *data = (const char *)p;
+	if ((uint8_t)data[0] == 0x1f && (uint8_t)data[1] == 0x8b) {
+		/* gzip: must be decompressed by AutoGunzipReader */
+		munmap(p, size);
+		return nullptr;
+	}
+
+	madvise(p, size, MADV_SEQUENTIAL);
+
+	return new MappedLineReader(data, size);
+#endif
+}
+
+ConstBuffer<char>
+MappedLineReader::ReadLine()
+{
+	if (position >= size)
+		return nullptr;
+
+	const char *const line = data + position;
+	const size_t rest = size - position;
+
+	const char *end = (const char *)memchr(line, '\n', rest);
+	if (end == nullptr) {
+		/* the last line has no newline character */
+		position = size;
+		end = line + rest;
+	} else {
+		position = end + 1 - data;
+
+		if (end > line && end[-1] == '\r')
+			--end;
+	}
+
+	return { line, size_t(end - line) };
+}
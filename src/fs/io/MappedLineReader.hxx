@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_MAPPED_LINE_READER_HXX
+#define MPD_MAPPED_LINE_READER_HXX
+
+#include "check.h"
+#include "Compiler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Path;
+template<typename T> struct ConstBuffer;
+
+/**
+ * Reads lines from a memory-mapped uncompressed file.  The mapping
+ * is read-only; lines are returned as pointer and length, and it is
+ * up to the caller to copy them if it needs a null-terminated
+ * string.
+ *
+ * The file must not be truncated while it is mapped, or else the
+ * process gets killed with SIGBUS; therefore, mapping is only used
+ * where the user enables it.
+ */
+class MappedLineReader {
+	const char *const data;
+	const size_t size;
+
+	size_t position;
+
+	MappedLineReader(const char *_data, size_t _size)
+		:data(_data), size(_size), position(0) {}
+
+public:
+	~MappedLineReader();
+
+	MappedLineReader(const MappedLineReader &) = delete;
+	MappedLineReader &operator=(const MappedLineReader &) = delete;
+
+	/**
+	 * Map the specified file.  Returns nullptr if that is not
+	 * possible or not worth it (error, small file, not a regular
+	 * file, gzip compressed, unsupported platform); the caller
+	 * shall fall back to reading it.
+	 */
+	gcc_malloc
+	static MappedLineReader *Open(Path path);
+
+	/**
+	 * Returns the next line (without the line terminator), or
+	 * ConstBuffer::Null() at the end of the file.  It points into
+	 * the mapping and is not null-terminated.
+	 */
+	ConstBuffer<char> ReadLine();
+
+	/**
+	 * Continue reading at the given position.
+	 */
+	void Seek(uint64_t offset) {
+		position = offset < size ? (size_t)offset : size;
+	}
+};
+
+#endif
@@ -0,0 +1,282 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "ParallelGzipOutputStream.hxx"
+#include "lib/zlib/Domain.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+
+void
+ParallelGzipOutputStream::Block::Compress()
+{
+	crc = crc32(crc32(0, Z_NULL, 0), input.data(), input.size());
+
+	z_stream z;
+	z.zalloc = Z_NULL;
+	z.zfree = Z_NULL;
+	z.opaque = Z_NULL;
+
+	/* negative windowBits: raw deflate data without header and
+	   trailer; ParallelGzipOutputStream writes them */
+	result = deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+			      -15, 8, Z_DEFAULT_STRATEGY);
+	if (result != Z_OK)
+		return;
+
+	if (!dictionary.empty()) {
+		result = deflateSetDictionary(&z, dictionary.data(),
+					      dictionary.size());
+		if (result != Z_OK) {
+			deflateEnd(&z);
+			return;
+		}
+	}
+
+	/* the sync flush adds at most 5 bytes plus the bits of
+	   the last block */
+	output.resize(deflateBound(&z, input.size()) + 16);
+
+	z.next_in = input.data();
+	z.avail_in = input.size();
+	z.next_out = output.data();
+	z.avail_out = output.size();
+
+	result = deflate(&z, Z_SYNC_FLUSH);
+	if (result == Z_OK && (z.avail_in > 0 || z.avail_out == 0))
+		/* the output buffer was too small */
+		result = Z_BUF_ERROR;
+
+	output.resize(output.size() - z.avail_out);
+	deflateEnd(&z);
+}
+
+ParallelGzipOutputStream::ParallelGzipOutputStream(OutputStream &_next,
+						   unsigned n_threads,
+						   Error &error)
+	:next(_next), quit(false), failed(false), header_written(false),
+	 current(new Block()),
+	 crc(crc32(0, Z_NULL, 0)), total_size(0)
+{
+	assert(n_threads > 0);
+
+	for (unsigned i = 0; i < n_threads; ++i) {
+		threads.emplace_back();
+		if (!threads.back().Start(Run, this, error)) {
+			threads.pop_back();
+			StopThreads();
+			failed = true;
+			return;
+		}
+	}
+}
+
+ParallelGzipOutputStream::~ParallelGzipOutputStream()
+{
+	StopThreads();
+
+	for (Block *block : queue)
+		delete block;
+
+	delete current;
+}
+
+void
+ParallelGzipOutputStream::StopThreads()
+{
+	mutex.lock();
+	quit = true;
+	cond.broadcast();
+	mutex.unlock();
+
+	for (auto &thread : threads)
+		thread.Join();
+	threads.clear();
+}
+
+void
+ParallelGzipOutputStream::Run()
+{
+	const ScopeLock protect(mutex);
+
+	while (!quit) {
+		Block *block = nullptr;
+		for (Block *i : queue) {
+			if (i->state == Block::State::PENDING) {
+				block = i;
+				break;
+			}
+		}
+
+		if (block == nullptr) {
+			cond.wait(mutex);
+			continue;
+		}
+
+		block->state = Block::State::RUNNING;
+
+		mutex.unlock();
+		block->Compress();
+		mutex.lock();
+
+		block->state = Block::State::DONE;
+		cond.broadcast();
+	}
+}
+
+void
+ParallelGzipOutputStream::Run(void *ctx)
+{
+	SetThreadName("gzip");
+
+	ParallelGzipOutputStream &gzip = *(ParallelGzipOutputStream *)ctx;
+	gzip.Run();
+}
+
+bool
+ParallelGzipOutputStream::WriteHeader(Error &error)
+{
+	static constexpr Bytef header[10] = {
+		0x1f, 0x8b, /* magic */
+		Z_DEFLATED, /* compression method */
+		0, /* flags */
+		0, 0, 0, 0, /* modification time */
+		0, /* extra flags */
+		3, /* operating system: Unix */
+	};
+
+	header_written = true;
+	return next.Write(header, sizeof(header), error);
+}
+
+bool
+ParallelGzipOutputStream::WriteFront(Error &error)
+{
+	mutex.lock();
+	assert(!queue.empty());
+
+	Block *block = queue.front();
+	while (block->state != Block::State::DONE)
+		cond.wait(mutex);
+
+	queue.pop_front();
+	mutex.unlock();
+
+	bool success;
+	if (block->result != Z_OK) {
+		error.Set(zlib_domain, block->result, zError(block->result));
+		success = false;
+	} else {
+		crc = crc32_combine(crc, block->crc, block->input.size());
+		total_size += block->input.size();
+
+		success = (header_written || WriteHeader(error)) &&
+			next.Write(block->output.data(), block->output.size(),
+				   error);
+	}
+
+	delete block;
+	return success;
+}
+
+bool
+ParallelGzipOutputStream::Submit(Error &error)
+{
+	Block *block = current;
+	current = new Block();
+
+	block->dictionary.swap(dictionary);
+
+	/* the next block uses the end of this one as its
+	   dictionary */
+	const size_t tail = std::min(block->input.size(), DICTIONARY_SIZE);
+	dictionary.assign(block->input.end() - tail, block->input.end());
+
+	mutex.lock();
+	queue.push_back(block);
+	cond.broadcast();
+	const size_t n = queue.size();
+	mutex.unlock();
+
+	/* limit the number of blocks in memory */
+	return n <= threads.size() * 2 || WriteFront(error);
+}
+
+bool
+ParallelGzipOutputStream::Write(const void *_data, size_t size,
+				Error &error)
+{
+	const Bytef *data = (const Bytef *)_data;
+
+	while (size > 0) {
+		auto &input = current->input;
+		if (input.empty())
+			input.reserve(BLOCK_SIZE);
+
+		const size_t nbytes = std::min(size, BLOCK_SIZE - input.size());
+		input.insert(input.end(), data, data + nbytes);
+		data += nbytes;
+		size -= nbytes;
+
+		if (input.size() == BLOCK_SIZE && !Submit(error))
+			return false;
+	}
+
+	return true;
+}
+
+bool
+ParallelGzipOutputStream::Flush(Error &error)
+{
+	if (!current->input.empty() && !Submit(error))
+		return false;
+
+	while (true) {
+		mutex.lock();
+		const bool empty = queue.empty();
+		mutex.unlock();
+
+		if (empty)
+			break;
+
+		if (!WriteFront(error))
+			return false;
+	}
+
+	if (!header_written && !WriteHeader(error))
+		return false;
+
+	/* an empty final block with fixed Huffman codes, followed by
+	   the trailer: CRC32 and size, little-endian */
+	const Bytef trailer[10] = {
+		0x03, 0x00,
+		Bytef(crc), Bytef(crc >> 8), Bytef(crc >> 16), Bytef(crc >> 24),
+		Bytef(total_size), Bytef(total_size >> 8),
+		Bytef(total_size >> 16), Bytef(total_size >> 24),
+	};
+
+	return next.Write(trailer, sizeof(trailer), error);
+}
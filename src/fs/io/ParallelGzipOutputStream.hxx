@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PARALLEL_GZIP_OUTPUT_STREAM_HXX
+#define MPD_PARALLEL_GZIP_OUTPUT_STREAM_HXX
+
+#include "check.h"
+#include "OutputStream.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+
+#include <deque>
+#include <list>
+#include <vector>
+
+#include <zlib.h>
+
+class Error;
+
+/**
+ * Like #GzipOutputStream, but compresses blocks of the input in
+ * several threads (like "pigz").  Each block is compressed into raw
+ * "deflate" data which ends with a sync flush, using the end of the
+ * previous block as dictionary.  The blocks are concatenated to one
+ * ordinary "gzip" member, which any gzip decoder can read.
+ *
+ * Don't forget to call Flush() before destructing this object.
+ */
+class ParallelGzipOutputStream final : public OutputStream {
+	static constexpr size_t BLOCK_SIZE = 128 * 1024;
+	static constexpr size_t DICTIONARY_SIZE = 32 * 1024;
+
+	struct Block {
+		enum class State {
+			PENDING, RUNNING, DONE,
+		} state;
+
+		/**
+		 * The zlib error code, or Z_OK.
+		 */
+		int result;
+
+		std::vector<Bytef> input, dictionary, output;
+
+		uLong crc;
+
+		Block():state(State::PENDING), result(Z_OK) {}
+
+		void Compress();
+	};
+
+	OutputStream &next;
+
+	Mutex mutex;
+	Cond cond;
+
+	std::list<Thread> threads;
+
+	/**
+	 * The blocks which have been submitted but not yet written,
+	 * in file order.  Protected by #mutex.
+	 */
+	std::deque<Block *> queue;
+
+	/**
+	 * Shall the threads exit?  Protected by #mutex.
+	 */
+	bool quit;
+
+	/**
+	 * Has the thread creation failed?
+	 */
+	bool failed;
+
+	bool header_written;
+
+	/**
+	 * The block being filled by Write().
+	 */
+	Block *current;
+
+	/**
+	 * The last #DICTIONARY_SIZE bytes of the previous block.
+	 */
+	std::vector<Bytef> dictionary;
+
+	uLong crc;
+	uLong total_size;
+
+public:
+	/**
+	 * Construct the filter.  Call IsDefined() to check whether
+	 * the constructor has succeeded.  If not, #error will hold
+	 * information about the failure.
+	 *
+	 * @param n_threads the number of compression threads
+	 */
+	ParallelGzipOutputStream(OutputStream &_next, unsigned n_threads,
+				 Error &error);
+	~ParallelGzipOutputStream();
+
+	/**
+	 * Check whether the constructor has succeeded.
+	 */
+	bool IsDefined() const {
+		return !failed;
+	}
+
+	/**
+	 * Finish the file and write all data which has not been
+	 * written yet.
+	 */
+	bool Flush(Error &error);
+
+	/* virtual methods from class OutputStream */
+	bool Write(const void *data, size_t size, Error &error) override;
+
+private:
+	void StopThreads();
+
+	/**
+	 * Pass #current to the threads and wait until the queue has
+	 * room for another block.
+	 */
+	bool Submit(Error &error);
+
+	/**
+	 * Wait for the first queued block and write it to #next.
+	 */
+	bool WriteFront(Error &error);
+
+	bool WriteHeader(Error &error);
+
+	void Run();
+	static void Run(void *ctx);
+};
+
+#endif
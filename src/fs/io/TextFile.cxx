@@ -19,28 +19,47 @@
 
 #include "config.h"
 #include "TextFile.hxx"
+#include "MappedLineReader.hxx"
 #include "FileReader.hxx"
 #include "AutoGunzipReader.hxx"
+#include "ThreadReader.hxx"
 #include "BufferedReader.hxx"
 #include "fs/Path.hxx"
+#include "util/ConstBuffer.hxx"
 
 #include <assert.h>
+#include <string.h>
 
-TextFile::TextFile(Path path_fs, Error &error)
-	:file_reader(new FileReader(path_fs, error)),
+TextFile::TextFile(Path path_fs, Error &error, bool background, bool map)
+	:mapped(map ? MappedLineReader::Open(path_fs) : nullptr),
+	 file_reader(mapped == nullptr
+		     ? new FileReader(path_fs, error)
+		     : nullptr),
 #ifdef HAVE_ZLIB
-	 gunzip_reader(file_reader->IsDefined()
+	 gunzip_reader(file_reader != nullptr && file_reader->IsDefined()
 		       ? new AutoGunzipReader(*file_reader)
 		       : nullptr),
 #endif
-	 buffered_reader(file_reader->IsDefined()
-			 ? new BufferedReader(*
+	 thread_reader(background &&
+		       file_reader != nullptr && file_reader->IsDefined()
+		       ? new ThreadReader(*
 #ifdef HAVE_ZLIB
-					      gunzip_reader
+					  gunzip_reader
 #else
-					      file_reader
+					  file_reader
 #endif
-					      )
+					  )
+		       : nullptr),
+	 buffered_reader(file_reader != nullptr && file_reader->IsDefined()
+			 ? (thread_reader != nullptr
+			    ? new BufferedReader(*thread_reader)
+			    : new BufferedReader(*
+#ifdef HAVE_ZLIB
+						 gunzip_reader
+#else
+						 file_reader
+#endif
+						 ))
 			 : nullptr)
 {
 }
@@ -48,23 +67,52 @@ TextFile::TextFile(Path path_fs, Error &error)
 TextFile::~TextFile()
 {
 	delete buffered_reader;
+	delete thread_reader;
 #ifdef HAVE_ZLIB
 	delete gunzip_reader;
 #endif
 	delete file_reader;
+	delete mapped;
 }
 
 char *
 TextFile::ReadLine()
 {
+	if (mapped != nullptr) {
+		const auto line = mapped->ReadLine();
+		if (line.IsNull())
+			return nullptr;
+
+		char *p = line_buffer.Get(line.size + 1);
+		memcpy(p, line.data, line.size);
+		p[line.size] = 0;
+		return p;
+	}
+
 	assert(buffered_reader != nullptr);
 
 	return buffered_reader->ReadLine();
 }
 
+bool
+TextFile::Seek(uint64_t offset, Error &error)
+{
+	if (mapped != nullptr) {
+		mapped->Seek(offset);
+		return true;
+	}
+
+	assert(buffered_reader != nullptr);
+
+	return file_reader->Seek(offset, error);
+}
+
 bool
 TextFile::Check(Error &error) const
 {
+	if (mapped != nullptr)
+		return true;
+
 	assert(buffered_reader != nullptr);
 
 	return buffered_reader->Check(error);
@@ -22,33 +22,62 @@
 
 #include "check.h"
 #include "Compiler.h"
+#include "util/ReusableArray.hxx"
 
 #include <stddef.h>
+#include <stdint.h>
 
 class Path;
 class Error;
+class MappedLineReader;
 class FileReader;
 class AutoGunzipReader;
+class ThreadReader;
 class BufferedReader;
 
 class TextFile {
+	/**
+	 * If mapping was requested and the file is uncompressed (and
+	 * large enough), it is memory-mapped, and the #Reader chain
+	 * is not used.
+	 */
+	MappedLineReader *const mapped;
+
+	/**
+	 * A null-terminated copy of the last line returned by
+	 * #mapped.
+	 */
+	ReusableArray<char, 256> line_buffer;
+
 	FileReader *const file_reader;
 
 #ifdef HAVE_ZLIB
 	AutoGunzipReader *const gunzip_reader;
 #endif
 
+	ThreadReader *const thread_reader;
+
 	BufferedReader *const buffered_reader;
 
 public:
-	TextFile(Path path_fs, Error &error);
+	/**
+	 * @param background read (and decompress) the file in a
+	 * separate thread, overlapping with the caller's parsing;
+	 * worth it only for large files
+	 * @param map map the file into memory if it is uncompressed
+	 * and large enough; the process gets killed with SIGBUS if
+	 * the file is truncated while it is being read
+	 */
+	TextFile(Path path_fs, Error &error, bool background=false,
+		 bool map=false);
 
 	TextFile(const TextFile &other) = delete;
 
 	~TextFile();
 
 	bool HasFailed() const {
-		return gcc_unlikely(buffered_reader == nullptr);
+		return gcc_unlikely(mapped == nullptr &&
+				    buffered_reader == nullptr);
 	}
 
 	/**
@@ -64,6 +93,12 @@ public:
 	 */
 	char *ReadLine();
 
+	/**
+	 * Start reading at the given position of an uncompressed
+	 * file.  This must be called before the first ReadLine().
+	 */
+	bool Seek(uint64_t offset, Error &error);
+
 	/**
 	 * Check whether a ReadLine() call has thrown an error.
 	 */
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "ThreadReader.hxx"
+#include "thread/Name.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <string.h>
+
+ThreadReader::ThreadReader(Reader &_next)
+	:next(_next), current(0), position(0),
+	 direct(false), eof(false), quit(false)
+{
+	buffers[0].full = buffers[1].full = false;
+}
+
+ThreadReader::~ThreadReader()
+{
+	if (!thread.IsDefined())
+		return;
+
+	mutex.lock();
+	quit = true;
+	cond.broadcast();
+	mutex.unlock();
+
+	thread.Join();
+}
+
+void
+ThreadReader::Run()
+{
+	unsigned i = 0;
+
+	mutex.lock();
+
+	while (!quit) {
+		Buffer &b = buffers[i];
+		if (b.full) {
+			/* wait for the consumer to release this
+			   buffer */
+			cond.wait(mutex);
+			continue;
+		}
+
+		mutex.unlock();
+
+		Error read_error;
+		size_t size = 0;
+		bool end = false;
+		while (size < BUFFER_SIZE) {
+			size_t nbytes = next.Read(b.data + size,
+						  BUFFER_SIZE - size,
+						  read_error);
+			if (nbytes == 0) {
+				end = true;
+				break;
+			}
+
+			size += nbytes;
+		}
+
+		mutex.lock();
+
+		b.size = size;
+		b.full = size > 0;
+
+		if (end) {
+			error = std::move(read_error);
+			eof = true;
+			cond.broadcast();
+			break;
+		}
+
+		cond.broadcast();
+		i ^= 1;
+	}
+
+	mutex.unlock();
+}
+
+void
+ThreadReader::Run(void *ctx)
+{
+	SetThreadName("reader");
+
+	ThreadReader &reader = *(ThreadReader *)ctx;
+	reader.Run();
+}
+
+size_t
+ThreadReader::Read(void *data, size_t size, Error &error_r)
+{
+	if (direct)
+		return next.Read(data, size, error_r);
+
+	if (!thread.IsDefined() && !eof) {
+		Error start_error;
+		if (!thread.Start(Run, this, start_error)) {
+			/* no thread: read directly from the next
+			   Reader */
+			direct = true;
+			return next.Read(data, size, error_r);
+		}
+	}
+
+	const ScopeLock protect(mutex);
+
+	while (true) {
+		Buffer &b = buffers[current];
+		if (b.full) {
+			size_t nbytes = std::min(size, b.size - position);
+			memcpy(data, b.data + position, nbytes);
+			position += nbytes;
+
+			if (position == b.size) {
+				/* hand the buffer back to the thread */
+				b.full = false;
+				position = 0;
+				current ^= 1;
+				cond.broadcast();
+			}
+
+			return nbytes;
+		}
+
+		if (eof) {
+			if (error.IsDefined())
+				error_r = std::move(error);
+			return 0;
+		}
+
+		cond.wait(mutex);
+	}
+}
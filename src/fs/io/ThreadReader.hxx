@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_THREAD_READER_HXX
+#define MPD_THREAD_READER_HXX
+
+#include "check.h"
+#include "Reader.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "util/Error.hxx"
+
+/**
+ * A filter which reads from the next #Reader in a separate thread,
+ * so reading (and decompressing) the next chunk overlaps with
+ * parsing the current one.  The data is passed through two buffers:
+ * while the caller consumes one, the thread fills the other.
+ *
+ * The thread is started by the first Read() call, so the next
+ * #Reader may be prepared (e.g. seeked) before that.
+ */
+class ThreadReader final : public Reader {
+	static constexpr size_t BUFFER_SIZE = 64 * 1024;
+
+	struct Buffer {
+		size_t size;
+
+		/**
+		 * Has the thread filled this buffer?  Protected by
+		 * #mutex.
+		 */
+		bool full;
+
+		char data[BUFFER_SIZE];
+	};
+
+	Reader &next;
+
+	Thread thread;
+
+	Mutex mutex;
+	Cond cond;
+
+	Buffer buffers[2];
+
+	/**
+	 * The buffer consumed by Read(), and the read position
+	 * within it.
+	 */
+	unsigned current;
+	size_t position;
+
+	/**
+	 * The thread could not be created; Read() reads directly
+	 * from the next #Reader.
+	 */
+	bool direct;
+
+	/**
+	 * Set by the thread after the last buffer has been
+	 * submitted.  Protected by #mutex.
+	 */
+	bool eof;
+
+	/**
+	 * Set by the destructor to stop the thread.  Protected by
+	 * #mutex.
+	 */
+	bool quit;
+
+	/**
+	 * The error reported by the next #Reader.  Protected by
+	 * #mutex.
+	 */
+	Error error;
+
+public:
+	explicit ThreadReader(Reader &_next);
+	~ThreadReader();
+
+	/* virtual methods from class Reader */
+	virtual size_t Read(void *data, size_t size, Error &error) override;
+
+private:
+	void Run();
+	static void Run(void *ctx);
+};
+
+#endif
@@ -19,33 +19,71 @@
 
 #include "config.h"
 #include "AsyncInputStream.hxx"
+#include "BlockCache.hxx"
 #include "tag/Tag.hxx"
 #include "event/Call.hxx"
 #include "thread/Cond.hxx"
 #include "IOThread.hxx"
+#include "system/Clock.hxx"
 #include "util/HugeAllocator.hxx"
+#include "util/MemoryStats.hxx"
 
 #include <assert.h>
 #include <string.h>
 
-AsyncInputStream::AsyncInputStream(const char *_url,
+/**
+ * The adaptive limit is halved after the stream has refilled the
+ * buffer this many times in a row at least #FAST_REFILL_RATIO times
+ * faster than the client has drained it.
+ */
+static constexpr unsigned FAST_REFILL_COUNT = 4;
+static constexpr unsigned FAST_REFILL_RATIO = 4;
+
+/**
+ * Don't shrink the adaptive limit within this number of milliseconds
+ * after it has grown, or a link which delivers in bursts would make
+ * it oscillate.
+ */
+static constexpr unsigned SHRINK_HOLDOFF_MS = 30000;
+
+AsyncInputStream::AsyncInputStream(EventLoop &event_loop, const char *_url,
 				   Mutex &_mutex, Cond &_cond,
 				   void *_buffer, size_t _buffer_size,
-				   size_t _resume_at)
-	:InputStream(_url, _mutex, _cond), DeferredMonitor(io_thread_get()),
-	 buffer((uint8_t *)_buffer, _buffer_size),
+				   bool _mirrored, size_t _resume_at)
+	:InputStream(_url, _mutex, _cond), DeferredMonitor(event_loop),
+	 buffer((uint8_t *)_buffer, _buffer_size, _mirrored),
 	 resume_at(_resume_at),
+	 limit(_buffer_size), min_limit(0),
 	 open(true),
 	 paused(false),
 	 seek_state(SeekState::NONE),
-	 tag(nullptr) {}
+	 tag(nullptr),
+	 buffer_offset(0),
+	 cache_size(0), cache(nullptr) {}
 
 AsyncInputStream::~AsyncInputStream()
 {
 	delete tag;
+	delete cache;
 
 	buffer.Clear();
-	HugeFree(buffer.Write().data, buffer.GetCapacity());
+	MemoryStatsSub(MemoryCategory::INPUT, buffer.GetCapacity());
+	if (buffer.IsMirrored())
+		HugeFreeMirrored(buffer.Write().data, buffer.GetCapacity());
+	else
+		HugeFree(buffer.Write().data, buffer.GetCapacity());
+}
+
+void *
+AsyncInputStream::AllocateBuffer(size_t size, bool &mirrored_r)
+{
+	void *p = HugeAllocateMirrored(size);
+	mirrored_r = p != nullptr;
+	if (p == nullptr)
+		p = HugeAllocate(size);
+	if (p != nullptr)
+		MemoryStatsAdd(MemoryCategory::INPUT, size);
+	return p;
 }
 
 void
@@ -55,12 +93,61 @@ AsyncInputStream::SetTag(Tag *_tag)
 	tag = _tag;
 }
 
+void
+AsyncInputStream::EnableAdaptiveLimit(size_t _min_limit)
+{
+	assert(_min_limit > 0);
+
+	min_limit = std::min(_min_limit, buffer.GetCapacity());
+	SetLimit(min_limit);
+	resume_time = MonotonicClockMS();
+	grow_time = resume_time - SHRINK_HOLDOFF_MS;
+	drain_ms = 0;
+	fast_refills = 0;
+}
+
 void
 AsyncInputStream::Pause()
 {
 	assert(io_thread_inside());
 
 	paused = true;
+
+	if (min_limit == 0)
+		return;
+
+	pause_time = MonotonicClockMS();
+
+	const unsigned refill_ms = pause_time - resume_time;
+	if (drain_ms > 0 && refill_ms * FAST_REFILL_RATIO < drain_ms) {
+		/* the bandwidth is much larger than the bit rate */
+		if (++fast_refills >= FAST_REFILL_COUNT &&
+		    limit > min_limit &&
+		    pause_time - grow_time >= SHRINK_HOLDOFF_MS) {
+			SetLimit(std::max(limit / 2, min_limit));
+			fast_refills = 0;
+		}
+	} else
+		fast_refills = 0;
+}
+
+void
+AsyncInputStream::OnUnderrun()
+{
+	fast_refills = 0;
+
+	/* only if the buffer has been full before, i.e. not while
+	   the stream is starting or after seeking */
+	if (drain_ms == 0)
+		return;
+
+	drain_ms = 0;
+
+	const size_t max_limit = buffer.GetCapacity();
+	if (limit < max_limit) {
+		SetLimit(std::min(limit * 2, max_limit));
+		grow_time = MonotonicClockMS();
+	}
 }
 
 void
@@ -80,6 +167,12 @@ AsyncInputStream::Resume()
 
 	if (paused) {
 		paused = false;
+
+		if (min_limit > 0) {
+			resume_time = MonotonicClockMS();
+			drain_ms = std::max(resume_time - pause_time, 1u);
+		}
+
 		DoResume();
 	}
 }
@@ -100,47 +193,79 @@ bool
 AsyncInputStream::IsEOF()
 {
 	return (KnownSize() && offset >= size) ||
-		(!open && buffer.IsEmpty());
+		(!open && buffer.IsEmpty() && offset == buffer_offset &&
+		 seek_state == SeekState::NONE);
 }
 
-bool
-AsyncInputStream::Seek(offset_type new_offset, Error &error)
+BlockCache *
+AsyncInputStream::GetCache()
 {
-	assert(IsReady());
-	assert(seek_state == SeekState::NONE);
+	if (cache == nullptr && cache_size > 0 && IsSeekable())
+		cache = new BlockCache(cache_size);
 
-	if (new_offset == offset)
-		/* no-op */
-		return true;
+	return cache;
+}
 
-	if (!IsSeekable())
-		return false;
+void
+AsyncInputStream::StashBuffer()
+{
+	if (cache == nullptr || seek_state != SeekState::NONE)
+		return;
 
-	/* check if we can fast-forward the buffer */
+	offset_type o = buffer_offset;
+	while (true) {
+		/* the ring buffer may consist of two segments */
+		auto r = buffer.Read();
+		if (r.IsEmpty())
+			break;
 
-	while (new_offset > offset) {
+		cache->Put(o, r.data, r.size);
+		o += r.size;
+		buffer.Consume(r.size);
+	}
+}
+
+void
+AsyncInputStream::SkipBuffer(offset_type new_offset)
+{
+	while (new_offset > buffer_offset) {
 		auto r = buffer.Read();
 		if (r.IsEmpty())
 			break;
 
 		const size_t nbytes =
-			new_offset - offset < (offset_type)r.size
-					       ? new_offset - offset
-					       : r.size;
+			new_offset - buffer_offset < (offset_type)r.size
+						     ? new_offset - buffer_offset
+						     : r.size;
+
+		if (cache != nullptr)
+			cache->Put(buffer_offset, r.data, nbytes);
 
 		buffer.Consume(nbytes);
-		offset += nbytes;
+		buffer_offset += nbytes;
 	}
+}
 
-	if (new_offset == offset)
-		return true;
+void
+AsyncInputStream::StartSeek(offset_type new_offset)
+{
+	assert(seek_state == SeekState::NONE);
 
-	/* no: ask the implementation to seek */
+	/* the buffer will be cleared in the I/O thread; keep its
+	   contents */
+	StashBuffer();
 
+	buffer_offset = new_offset;
 	seek_offset = new_offset;
 	seek_state = SeekState::SCHEDULED;
 
 	DeferredMonitor::Schedule();
+}
+
+bool
+AsyncInputStream::SeekStream(offset_type new_offset, Error &error)
+{
+	StartSeek(new_offset);
 
 	while (seek_state != SeekState::NONE)
 		cond.wait(mutex);
@@ -148,9 +273,64 @@ AsyncInputStream::Seek(offset_type new_offset, Error &error)
 	if (!Check(error))
 		return false;
 
+	offset = new_offset;
 	return true;
 }
 
+bool
+AsyncInputStream::Seek(offset_type new_offset, Error &error)
+{
+	assert(IsReady());
+
+	/* wait until a seek started in the background is finished */
+	while (seek_state != SeekState::NONE)
+		cond.wait(mutex);
+
+	if (!Check(error))
+		return false;
+
+	if (new_offset == offset)
+		/* no-op */
+		return true;
+
+	if (!IsSeekable())
+		return false;
+
+	BlockCache *const c = GetCache();
+	if (c != nullptr) {
+		const offset_type end = c->GetContiguousEnd(new_offset);
+		if (end > new_offset) {
+			/* serve Read() from the cache; meanwhile, let
+			   the stream continue where the cached data
+			   ends */
+			offset = new_offset;
+
+			if (end > buffer_offset)
+				SkipBuffer(end);
+
+			if (end != buffer_offset &&
+			    !(KnownSize() && end >= size))
+				StartSeek(end);
+
+			return true;
+		}
+	}
+
+	/* check if we can fast-forward the buffer */
+
+	if (offset == buffer_offset) {
+		SkipBuffer(new_offset);
+		offset = buffer_offset;
+
+		if (new_offset == offset)
+			return true;
+	}
+
+	/* no: ask the implementation to seek */
+
+	return SeekStream(new_offset, error);
+}
+
 void
 AsyncInputStream::SeekDone()
 {
@@ -172,9 +352,19 @@ AsyncInputStream::ReadTag()
 bool
 AsyncInputStream::IsAvailable()
 {
-	return postponed_error.IsDefined() ||
-		IsEOF() ||
-		!buffer.IsEmpty();
+	if (offset != buffer_offset)
+		/* Read() will use the cache or seek */
+		return true;
+
+	if (postponed_error.IsDefined() || IsEOF() ||
+	    (seek_state == SeekState::NONE && !buffer.IsEmpty()))
+		return true;
+
+	/* the client is going to wait for data */
+	if (min_limit > 0 && open && seek_state == SeekState::NONE)
+		OnUnderrun();
+
+	return false;
 }
 
 size_t
@@ -182,24 +372,53 @@ AsyncInputStream::Read(void *ptr, size_t read_size, Error &error)
 {
 	assert(!io_thread_inside());
 
+	if (offset != buffer_offset) {
+		/* after a seek into the cache */
+		assert(cache != nullptr);
+
+		size_t nbytes = cache->Read(offset, ptr, read_size);
+		if (nbytes > 0) {
+			offset += (offset_type)nbytes;
+			return nbytes;
+		}
+
+		/* not cached anymore: seek the stream */
+
+		while (seek_state != SeekState::NONE)
+			cond.wait(mutex);
+
+		if (!Check(error) || !SeekStream(offset, error))
+			return 0;
+	}
+
 	/* wait for data */
 	CircularBuffer<uint8_t>::Range r;
 	while (true) {
 		if (!Check(error))
 			return 0;
 
-		r = buffer.Read();
-		if (!r.IsEmpty() || IsEOF())
-			break;
+		if (seek_state == SeekState::NONE) {
+			r = buffer.Read();
+			if (!r.IsEmpty() || IsEOF())
+				break;
+		}
+
+		if (min_limit > 0 && open && seek_state == SeekState::NONE)
+			OnUnderrun();
 
 		cond.wait(mutex);
 	}
 
 	const size_t nbytes = std::min(read_size, r.size);
 	memcpy(ptr, r.data, nbytes);
+
+	if (GetCache() != nullptr)
+		cache->Put(offset, r.data, nbytes);
+
 	buffer.Consume(nbytes);
 
 	offset += (offset_type)nbytes;
+	buffer_offset = offset;
 
 	if (paused && buffer.GetSize() < resume_at)
 		DeferredMonitor::Schedule();
@@ -217,8 +436,11 @@ AsyncInputStream::AppendToBuffer(const void *data, size_t append_size)
 	memcpy(w.data, data, nbytes);
 	buffer.Append(nbytes);
 
+	/* a mirrored buffer is never split at the wrap point */
 	const size_t remaining = append_size - nbytes;
 	if (remaining > 0) {
+		assert(!buffer.IsMirrored());
+
 		w = buffer.Write();
 		assert(!w.IsEmpty());
 		assert(w.size >= remaining);
@@ -244,6 +466,11 @@ AsyncInputStream::RunDeferred()
 		seek_state = SeekState::PENDING;
 		buffer.Clear();
 		paused = false;
+		drain_ms = 0;
+
+		/* a new request is going to be made, even if the old
+		   one was finished */
+		open = true;
 		DoSeek(seek_offset);
 	}
 }
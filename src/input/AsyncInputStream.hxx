@@ -25,6 +25,10 @@
 #include "util/CircularBuffer.hxx"
 #include "util/Error.hxx"
 
+#include <algorithm>
+
+class BlockCache;
+
 /**
  * Helper class for moving asynchronous (non-blocking) InputStream
  * implementations to the I/O thread.  Data is being read into a ring
@@ -37,7 +41,43 @@ class AsyncInputStream : public InputStream, private DeferredMonitor {
 	};
 
 	CircularBuffer<uint8_t> buffer;
-	const size_t resume_at;
+	size_t resume_at;
+
+	/**
+	 * The buffer is considered full at this number of bytes.  It
+	 * is the capacity of #buffer unless the limit is adaptive, see
+	 * EnableAdaptiveLimit().
+	 */
+	size_t limit;
+
+	/**
+	 * The lowest value of #limit, or 0 if the limit is fixed.
+	 */
+	size_t min_limit;
+
+	/**
+	 * The time stamps (MonotonicClockMS()) of the last Pause()
+	 * and Resume() calls.  Only used if the limit is adaptive.
+	 */
+	unsigned pause_time, resume_time;
+
+	/**
+	 * The time stamp of the last time #limit has grown.
+	 */
+	unsigned grow_time;
+
+	/**
+	 * How long it took the client to drain the buffer from
+	 * #limit to #resume_at the last time, in milliseconds.  0
+	 * means this has not been measured yet.
+	 */
+	unsigned drain_ms;
+
+	/**
+	 * How many times in a row the stream has refilled the buffer
+	 * much faster than the client drained it.
+	 */
+	unsigned fast_refills;
 
 	bool open;
 
@@ -58,14 +98,48 @@ class AsyncInputStream : public InputStream, private DeferredMonitor {
 
 	offset_type seek_offset;
 
+	/**
+	 * The file offset of the first byte in #buffer (or where the
+	 * pending seek will continue).  It differs from
+	 * InputStream::offset while Read() is served from #cache.
+	 */
+	offset_type buffer_offset;
+
+	/**
+	 * The size of #cache, or 0 if caching is disabled.
+	 */
+	size_t cache_size;
+
+	/**
+	 * Keeps data which was already passed to the client, in case
+	 * it seeks back.  Allocated on demand if the stream is
+	 * seekable.
+	 */
+	BlockCache *cache;
+
 protected:
 	Error postponed_error;
 
 public:
-	AsyncInputStream(const char *_url,
+	/**
+	 * @param event_loop the I/O event loop which runs the
+	 * transfer (one of those returned by io_thread_get())
+	 * @param _buffer the buffer allocated with AllocateBuffer()
+	 * @param _mirrored the value returned by AllocateBuffer()
+	 */
+	AsyncInputStream(EventLoop &event_loop, const char *_url,
 			 Mutex &_mutex, Cond &_cond,
 			 void *_buffer, size_t _buffer_size,
-			 size_t _resume_at);
+			 bool _mirrored, size_t _resume_at);
+
+	/**
+	 * Allocate a buffer for the constructor, mirrored (see
+	 * HugeAllocateMirrored()) if possible.  It is freed by the
+	 * destructor.
+	 *
+	 * @return the buffer or nullptr if out of memory
+	 */
+	static void *AllocateBuffer(size_t size, bool &mirrored_r);
 
 	virtual ~AsyncInputStream();
 
@@ -85,6 +159,34 @@ protected:
 
 	void Pause();
 
+	/**
+	 * Let the buffer limit adapt to the observed bandwidth and
+	 * bit rate.  It starts at the specified value (which must be
+	 * large enough for the biggest block passed to
+	 * AppendToBuffer()).  It is doubled (up to the capacity)
+	 * when the client runs out of data after the buffer had been
+	 * full, and halved again when the stream has refilled the
+	 * buffer far faster than the client consumed it several
+	 * times in a row.
+	 *
+	 * Streams on fast links stay with a small buffer this way,
+	 * and the memory allocated with HugeAllocate() is only
+	 * touched up to the current limit.
+	 */
+	void EnableAdaptiveLimit(size_t _min_limit);
+
+	/**
+	 * Keep up to the specified number of bytes which were already
+	 * read in a #BlockCache, and serve seeks to those from
+	 * memory.  This is only used if the stream turns out to be
+	 * seekable.  While the client reads from the cache, the
+	 * stream reconnects in the background at the end of the
+	 * cached data.
+	 */
+	void EnableCache(size_t _cache_size) {
+		cache_size = _cache_size;
+	}
+
 	/**
 	 * Declare that the underlying stream was closed.  We will
 	 * continue feeding Read() calls from the buffer until it runs
@@ -104,7 +206,7 @@ protected:
 	}
 
 	bool IsBufferFull() const {
-		return buffer.IsFull();
+		return buffer.IsFull() || buffer.GetSize() >= limit;
 	}
 
 	/**
@@ -112,7 +214,11 @@ protected:
 	 */
 	gcc_pure
 	size_t GetBufferSpace() const {
-		return buffer.GetSpace();
+		const size_t buffered = buffer.GetSize();
+		if (buffered >= limit)
+			return 0;
+
+		return std::min(buffer.GetSpace(), limit - buffered);
 	}
 
 	/**
@@ -130,7 +236,8 @@ protected:
 	/**
 	 * The actual Seek() implementation.  This virtual method will
 	 * be called from within the I/O thread.  When the operation
-	 * is finished, call SeekDone() to notify the caller.
+	 * is finished, call SeekDone() to notify the caller.  It must
+	 * not modify InputStream::offset; this class updates it.
 	 */
 	virtual void DoSeek(offset_type new_offset) = 0;
 
@@ -145,6 +252,48 @@ protected:
 	void SeekDone();
 
 private:
+	void SetLimit(size_t _limit) {
+		limit = _limit;
+		resume_at = _limit / 4 * 3;
+	}
+
+	/**
+	 * The client has found the buffer empty; let the adaptive
+	 * limit grow.
+	 */
+	void OnUnderrun();
+
+	/**
+	 * Obtain #cache, allocate it if it is enabled and the stream
+	 * is seekable.
+	 */
+	BlockCache *GetCache();
+
+	/**
+	 * Copy the contents of #buffer to the cache (if any), because
+	 * the buffer is going to be discarded.
+	 */
+	void StashBuffer();
+
+	/**
+	 * Consume data from #buffer (copying it to the cache) until
+	 * #buffer_offset reaches the specified offset or the buffer
+	 * runs empty.
+	 */
+	void SkipBuffer(offset_type new_offset);
+
+	/**
+	 * Ask the implementation to continue the stream at the
+	 * specified offset, without waiting for it.
+	 */
+	void StartSeek(offset_type new_offset);
+
+	/**
+	 * Like StartSeek(), but wait for the seek to be finished and
+	 * update InputStream::offset.
+	 */
+	bool SeekStream(offset_type new_offset, Error &error);
+
 	void Resume();
 
 	/* virtual methods from DeferredMonitor */
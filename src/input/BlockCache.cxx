@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "BlockCache.hxx"
+#include "util/MemoryStats.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <string.h>
+
+static constexpr size_t
+CountBlocks(size_t size)
+{
+	return size > BlockCache::BLOCK_SIZE
+		? (size + BlockCache::BLOCK_SIZE - 1) / BlockCache::BLOCK_SIZE
+		: 1;
+}
+
+BlockCache::BlockCache(size_t size)
+	:memory(new uint8_t[CountBlocks(size) * BLOCK_SIZE])
+{
+	const size_t n = CountBlocks(size);
+	for (size_t i = 0; i < n; ++i) {
+		Block block;
+		block.offset = 0;
+		block.begin = block.end = 0;
+		block.data = memory + i * BLOCK_SIZE;
+		blocks.push_back(block);
+	}
+
+	MemoryStatsAdd(MemoryCategory::INPUT, n * BLOCK_SIZE);
+}
+
+BlockCache::~BlockCache()
+{
+	MemoryStatsSub(MemoryCategory::INPUT, blocks.size() * BLOCK_SIZE);
+	delete[] memory;
+}
+
+std::list<BlockCache::Block>::iterator
+BlockCache::Find(offset_type block_offset)
+{
+	return std::find_if(blocks.begin(), blocks.end(),
+			    [block_offset](const Block &b){
+				    return b.begin != b.end &&
+					    b.offset == block_offset;
+			    });
+}
+
+std::list<BlockCache::Block>::const_iterator
+BlockCache::Find(offset_type block_offset) const
+{
+	return std::find_if(blocks.begin(), blocks.end(),
+			    [block_offset](const Block &b){
+				    return b.begin != b.end &&
+					    b.offset == block_offset;
+			    });
+}
+
+void
+BlockCache::Put(offset_type offset, const void *_data, size_t size)
+{
+	const uint8_t *data = (const uint8_t *)_data;
+
+	while (size > 0) {
+		const offset_type block_offset = offset - offset % BLOCK_SIZE;
+		const size_t i = offset - block_offset;
+		const size_t nbytes = std::min(size, BLOCK_SIZE - i);
+
+		auto b = Find(block_offset);
+		if (b == blocks.end()) {
+			/* recycle the least recently used block */
+			b = std::prev(blocks.end());
+			b->offset = block_offset;
+			b->begin = b->end = i;
+		} else if (i < b->begin || i > b->end) {
+			/* not adjacent to the cached range; start
+			   over */
+			b->begin = b->end = i;
+		}
+
+		memcpy(b->data + i, data, nbytes);
+		b->end = std::max(b->end, i + nbytes);
+
+		blocks.splice(blocks.begin(), blocks, b);
+
+		offset += nbytes;
+		data += nbytes;
+		size -= nbytes;
+	}
+}
+
+size_t
+BlockCache::Read(offset_type offset, void *dest, size_t size)
+{
+	const offset_type block_offset = offset - offset % BLOCK_SIZE;
+	const size_t i = offset - block_offset;
+
+	auto b = Find(block_offset);
+	if (b == blocks.end() || !b->Contains(i))
+		return 0;
+
+	const size_t nbytes = std::min(size, b->end - i);
+	memcpy(dest, b->data + i, nbytes);
+
+	blocks.splice(blocks.begin(), blocks, b);
+	return nbytes;
+}
+
+BlockCache::offset_type
+BlockCache::GetContiguousEnd(offset_type offset) const
+{
+	while (true) {
+		const offset_type block_offset = offset - offset % BLOCK_SIZE;
+		const size_t i = offset - block_offset;
+
+		auto b = Find(block_offset);
+		if (b == blocks.end() || !b->Contains(i))
+			return offset;
+
+		offset = block_offset + b->end;
+		if (b->end < BLOCK_SIZE)
+			return offset;
+
+		assert(offset % BLOCK_SIZE == 0);
+	}
+}
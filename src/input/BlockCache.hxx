@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_INPUT_BLOCK_CACHE_HXX
+#define MPD_INPUT_BLOCK_CACHE_HXX
+
+#include "InputStream.hxx"
+#include "Compiler.h"
+
+#include <list>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A small LRU cache of aligned blocks of a seekable (remote) file.
+ * #AsyncInputStream copies all data it passes to the client into it,
+ * so backward and repeated seeks (e.g. decoders probing tags at the
+ * end of the file and then rewinding) can be served from memory
+ * instead of reconnecting.
+ *
+ * This class is not thread-safe; the caller is responsible for
+ * locking.
+ */
+class BlockCache {
+public:
+	typedef InputStream::offset_type offset_type;
+
+	static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+private:
+	struct Block {
+		/**
+		 * The file offset of this block, a multiple of
+		 * #BLOCK_SIZE.
+		 */
+		offset_type offset;
+
+		/**
+		 * The range of valid data in this block, relative to
+		 * #offset.  The block is unused if both are equal.
+		 */
+		size_t begin, end;
+
+		uint8_t *data;
+
+		bool Contains(size_t i) const {
+			return i >= begin && i < end;
+		}
+	};
+
+	uint8_t *const memory;
+
+	/**
+	 * All blocks, the most recently used first.
+	 */
+	std::list<Block> blocks;
+
+public:
+	/**
+	 * @param size the total size of all blocks; it is rounded up
+	 * to at least one block
+	 */
+	explicit BlockCache(size_t size);
+	~BlockCache();
+
+	BlockCache(const BlockCache &) = delete;
+	BlockCache &operator=(const BlockCache &) = delete;
+
+	/**
+	 * Copy data which was read from the file at the specified
+	 * offset into the cache, evicting the least recently used
+	 * blocks.
+	 */
+	void Put(offset_type offset, const void *data, size_t size);
+
+	/**
+	 * Copy cached data at the specified offset.
+	 *
+	 * @return the number of bytes copied; 0 if the offset is not
+	 * cached
+	 */
+	size_t Read(offset_type offset, void *dest, size_t size);
+
+	/**
+	 * Determine where the contiguous run of cached data starting
+	 * at the specified offset ends.
+	 *
+	 * @return the end offset; equals the given offset if it is
+	 * not cached
+	 */
+	gcc_pure
+	offset_type GetContiguousEnd(offset_type offset) const;
+
+private:
+	gcc_pure
+	std::list<Block>::iterator Find(offset_type block_offset);
+
+	gcc_pure
+	std::list<Block>::const_iterator Find(offset_type block_offset) const;
+};
+
+#endif
@@ -21,6 +21,11 @@
 #include "IcyInputStream.hxx"
 #include "tag/Tag.hxx"
 
+#include <algorithm>
+
+#include <assert.h>
+#include <stdint.h>
+
 IcyInputStream::IcyInputStream(InputStream *_input)
 	:ProxyInputStream(_input),
 	 input_tag(nullptr), icy_tag(nullptr),
@@ -85,15 +90,30 @@ IcyInputStream::Read(void *ptr, size_t read_size, Error &error)
 		return ProxyInputStream::Read(ptr, read_size, error);
 
 	while (true) {
-		size_t nbytes = ProxyInputStream::Read(ptr, read_size, error);
+		/* read normal data directly into the caller's
+		   buffer, but never across a metadata block, so it
+		   doesn't need to be moved around afterwards */
+		size_t length = parser.GetDataAvailable(read_size);
+		if (length > 0) {
+			size_t nbytes = ProxyInputStream::Read(ptr, length,
+							       error);
+			if (nbytes == 0)
+				return 0;
+
+			parser.Data(nbytes);
+			override_offset += nbytes;
+			offset = override_offset;
+			return nbytes;
+		}
+
+		/* only the metadata block is copied */
+		uint8_t meta[1 + 255 * 16];
+		length = std::min(parser.GetMetaRest(), sizeof(meta));
+		size_t nbytes = ProxyInputStream::Read(meta, length, error);
 		if (nbytes == 0)
 			return 0;
 
-		size_t result = parser.ParseInPlace(ptr, nbytes);
-		if (result > 0) {
-			override_offset += result;
-			offset = override_offset;
-			return result;
-		}
+		gcc_unused size_t consumed = parser.Meta(meta, nbytes);
+		assert(consumed == nbytes);
 	}
 }
@@ -21,6 +21,7 @@
 #include "Init.hxx"
 #include "Registry.hxx"
 #include "InputPlugin.hxx"
+#include "plugins/CacheInputPlugin.hxx"
 #include "util/Error.hxx"
 #include "config/ConfigGlobal.hxx"
 #include "config/ConfigOption.hxx"
@@ -76,11 +77,13 @@ input_stream_global_init(Error &error)
 		}
 	}
 
-	return true;
+	return input_cache_init(error);
 }
 
 void input_stream_global_finish(void)
 {
+	input_cache_finish();
+
 	input_plugins_for_each_enabled(plugin)
 		if (plugin->finish != nullptr)
 			plugin->finish();
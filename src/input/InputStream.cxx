@@ -129,6 +129,19 @@ InputStream::LockRead(void *ptr, size_t _size, Error &error)
 	return Read(ptr, _size, error);
 }
 
+ConstBuffer<void>
+InputStream::Map()
+{
+	return nullptr;
+}
+
+ConstBuffer<void>
+InputStream::LockMap()
+{
+	const ScopeLock protect(mutex);
+	return Map();
+}
+
 bool
 InputStream::LockIsEOF()
 {
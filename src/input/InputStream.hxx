@@ -23,6 +23,7 @@
 #include "check.h"
 #include "Offset.hxx"
 #include "thread/Mutex.hxx"
+#include "util/ConstBuffer.hxx"
 #include "Compiler.h"
 
 #include <string>
@@ -95,6 +96,13 @@ private:
 	 */
 	std::string mime;
 
+	/**
+	 * An opaque string which changes whenever the resource is
+	 * modified, e.g. the HTTP entity tag or the modification
+	 * time; empty if unknown.
+	 */
+	std::string version;
+
 public:
 	InputStream(const char *_uri, Mutex &_mutex, Cond &_cond)
 		:uri(_uri),
@@ -220,6 +228,33 @@ public:
 		mime = _mime;
 	}
 
+	gcc_pure
+	bool HasVersion() const {
+		assert(ready);
+
+		return !version.empty();
+	}
+
+	gcc_pure
+	const char *GetVersion() const {
+		assert(ready);
+
+		return version.c_str();
+	}
+
+	gcc_nonnull_all
+	void SetVersion(const char *_version) {
+		assert(!ready);
+
+		version = _version;
+	}
+
+	void SetVersion(std::string &&_version) {
+		assert(!ready);
+
+		version = std::move(_version);
+	}
+
 	gcc_pure
 	bool KnownSize() const {
 		assert(ready);
@@ -360,6 +395,26 @@ public:
 	 */
 	gcc_nonnull_all
 	size_t LockRead(void *ptr, size_t size, Error &error);
+
+	/**
+	 * Returns a read-only view of the whole stream in memory,
+	 * e.g. a memory-mapped local file.  It remains valid until
+	 * the stream is closed.  A caller which reads from the view
+	 * advances the stream with AddOffset(); see
+	 * decoder_read_view().
+	 *
+	 * The caller must lock the mutex.
+	 *
+	 * @return the view, or nullptr if this stream does not
+	 * support it
+	 */
+	virtual ConstBuffer<void> Map();
+
+	/**
+	 * Wrapper for Map() which locks and unlocks the mutex; the
+	 * caller must not be holding it already.
+	 */
+	ConstBuffer<void> LockMap();
 };
 
 #endif
@@ -22,6 +22,7 @@
 #include "Registry.hxx"
 #include "InputPlugin.hxx"
 #include "plugins/RewindInputPlugin.hxx"
+#include "plugins/CacheInputPlugin.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 
@@ -37,6 +38,7 @@ InputStream::Open(const char *url,
 
 		is = plugin->open(url, mutex, cond, error);
 		if (is != nullptr) {
+			is = input_cache_open(is);
 			is = input_rewind_open(is);
 
 			return is;
@@ -40,6 +40,9 @@ ProxyInputStream::CopyAttributes()
 			if (input.HasMimeType())
 				SetMimeType(input.GetMimeType());
 
+			if (input.HasVersion())
+				SetVersion(input.GetVersion());
+
 			size = input.KnownSize()
 				? input.GetSize()
 				: UNKNOWN_SIZE;
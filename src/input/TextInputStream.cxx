@@ -34,10 +34,16 @@ TextInputStream::ReadLine()
 		return line;
 
 	while (true) {
+		/* move the partial line to the front; Write() alone
+		   would only do that when the buffer is filled up to
+		   the last byte, which never happens because of the
+		   byte reserved below, and the line would be split */
+		buffer.Shift();
+
 		auto dest = buffer.Write();
 		if (dest.size < 2) {
-			/* end of file (or line too long): terminate
-			   the current line */
+			/* line too long: terminate the current
+			   line */
 
 			assert(!dest.IsEmpty());
 			dest[0] = 0;
@@ -64,7 +70,17 @@ TextInputStream::ReadLine()
 		if (line != nullptr)
 			return line;
 
-		if (nbytes == 0)
-			return nullptr;
+		if (nbytes == 0) {
+			/* end of file: the last line is not
+			   terminated by a newline character; use the
+			   reserved byte for the null terminator */
+			auto r = buffer.Read();
+			if (r.IsEmpty())
+				return nullptr;
+
+			buffer.Write()[0] = 0;
+			buffer.Clear();
+			return r.data;
+		}
 	}
 }
@@ -26,7 +26,13 @@ class InputStream;
 
 class TextInputStream {
 	InputStream &is;
-	StaticFifoBuffer<char, 4096> buffer;
+
+	/**
+	 * Large enough to read big playlists with few
+	 * InputStream::Read() calls; this is also the maximum line
+	 * length.
+	 */
+	StaticFifoBuffer<char, 65536> buffer;
 
 public:
 	/**
@@ -22,6 +22,7 @@
 #include "thread/Name.hxx"
 #include "util/CircularBuffer.hxx"
 #include "util/HugeAllocator.hxx"
+#include "util/MemoryStats.hxx"
 
 #include <assert.h>
 #include <string.h>
@@ -39,7 +40,11 @@ ThreadInputStream::~ThreadInputStream()
 
 	if (buffer != nullptr) {
 		buffer->Clear();
-		HugeFree(buffer->Write().data, buffer_size);
+		MemoryStatsSub(MemoryCategory::INPUT, buffer_size);
+		if (buffer->IsMirrored())
+			HugeFreeMirrored(buffer->Write().data, buffer_size);
+		else
+			HugeFree(buffer->Write().data, buffer_size);
 		delete buffer;
 	}
 }
@@ -49,13 +54,22 @@ ThreadInputStream::Start(Error &error)
 {
 	assert(buffer == nullptr);
 
-	void *p = HugeAllocate(buffer_size);
+	/* prefer a mirrored buffer, which lets the thread fill the
+	   whole free space with one call */
+	bool mirrored = true;
+	void *p = HugeAllocateMirrored(buffer_size);
 	if (p == nullptr) {
-		error.SetErrno();
-		return nullptr;
+		mirrored = false;
+		p = HugeAllocate(buffer_size);
+		if (p == nullptr) {
+			error.SetErrno();
+			return nullptr;
+		}
 	}
 
-	buffer = new CircularBuffer<uint8_t>((uint8_t *)p, buffer_size);
+	buffer = new CircularBuffer<uint8_t>((uint8_t *)p, buffer_size,
+					     mirrored);
+	MemoryStatsAdd(MemoryCategory::INPUT, buffer_size);
 
 	if (!thread.Start(ThreadFunc, this, error))
 		return nullptr;
@@ -83,23 +97,33 @@ ThreadInputStream::ThreadFunc()
 
 		auto w = buffer->Write();
 		if (w.IsEmpty()) {
-			wake_cond.wait(mutex);
+			/* the buffer is full: wait until a good part
+			   of it has been consumed */
+			do {
+				wake_cond.wait(mutex);
+			} while (!close &&
+				 buffer->GetSpace() < GetResumeSpace());
 		} else {
 			Unlock();
 
 			Error error;
-			size_t nbytes = Read(w.data, w.size, error);
+			size_t nbytes = ThreadRead(w.data, w.size, error);
 
 			Lock();
-			cond.broadcast();
 
 			if (nbytes == 0) {
 				eof = true;
 				postponed_error = std::move(error);
+				cond.broadcast();
 				break;
 			}
 
+			/* the client waits only while the buffer is
+			   empty; don't wake it up for every chunk */
+			const bool was_empty = buffer->IsEmpty();
 			buffer->Append(nbytes);
+			if (was_empty)
+				cond.broadcast();
 		}
 	}
 
@@ -145,8 +169,14 @@ ThreadInputStream::Read(void *ptr, size_t read_size, Error &error)
 		if (!r.IsEmpty()) {
 			size_t nbytes = std::min(read_size, r.size);
 			memcpy(ptr, r.data, nbytes);
+
+			const size_t old_space = buffer->GetSpace();
 			buffer->Consume(nbytes);
-			wake_cond.broadcast();
+			if (old_space < GetResumeSpace() &&
+			    buffer->GetSpace() >= GetResumeSpace())
+				/* enough room for the thread to resume */
+				wake_cond.signal();
+
 			offset += nbytes;
 			return nbytes;
 		}
@@ -45,9 +45,9 @@ class ThreadInputStream : public InputStream {
 	Thread thread;
 
 	/**
-	 * Signalled when the thread shall be woken up: when data from
-	 * the buffer has been consumed and when the stream shall be
-	 * closed.
+	 * Signalled when the thread shall be woken up: when enough
+	 * data from the full buffer has been consumed (see
+	 * GetResumeSpace()) and when the stream shall be closed.
 	 */
 	Cond wake_cond;
 
@@ -137,6 +137,17 @@ protected:
 	virtual void Cancel() {}
 
 private:
+	/**
+	 * After the buffer has become full, the thread sleeps until
+	 * this much space is free again.  This way, it is woken up
+	 * once for a large chunk instead of after every small Read()
+	 * call.
+	 */
+	gcc_pure
+	size_t GetResumeSpace() const {
+		return buffer_size / 4;
+	}
+
 	void ThreadFunc();
 	static void ThreadFunc(void *ctx);
 };
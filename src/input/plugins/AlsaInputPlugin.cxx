@@ -178,7 +178,7 @@ AlsaInputStream::Create(const char *uri, Mutex &mutex, Cond &cond,
 		return nullptr;
 
 	int frame_size = snd_pcm_format_width(format) / 8 * channels;
-	return new AlsaInputStream(io_thread_get(),
+	return new AlsaInputStream(io_thread_next(),
 				   uri, mutex, cond,
 				   handle, frame_size);
 }
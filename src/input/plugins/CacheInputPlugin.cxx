@@ -0,0 +1,468 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "CacheInputPlugin.hxx"
+#include "FileInputPlugin.hxx"
+#include "../InputPlugin.hxx"
+#include "../ProxyInputStream.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/DirectoryReader.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "thread/Mutex.hxx"
+#include "util/UriUtil.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <vector>
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <utime.h>
+
+static constexpr Domain cache_domain("input_cache");
+
+static constexpr unsigned DEFAULT_CACHE_SIZE = 256 * 1024;
+
+static AllocatedPath cache_path = AllocatedPath::Null();
+static uint64_t cache_size;
+
+/**
+ * Protects the cache directory while files are being renamed and
+ * evicted, and #cache_serial.
+ */
+static Mutex cache_mutex;
+
+/**
+ * Makes the names of temporary files unique, in case one file is
+ * opened more than once at a time.
+ */
+static unsigned cache_serial;
+
+static bool
+IsTemporaryName(const char *name)
+{
+	const size_t length = strlen(name);
+	return length > 4 && strcmp(name + length - 4, ".tmp") == 0;
+}
+
+/**
+ * Generate the file name of the copy of a specific version of a
+ * resource, using the FNV-1a hash.
+ */
+static std::string
+CacheName(const char *uri, const char *version)
+{
+	uint64_t hash = 14695981039346656037ull;
+	auto feed = [&hash](const char *p){
+		do {
+			hash ^= (uint8_t)*p;
+			hash *= 1099511628211ull;
+		} while (*p++ != 0);
+	};
+
+	feed(uri);
+	feed(version);
+
+	char buffer[17];
+	snprintf(buffer, sizeof(buffer), "%016llx",
+		 (unsigned long long)hash);
+	return buffer;
+}
+
+/**
+ * Delete the least recently used files until the cache fits into
+ * #cache_size again.  The caller must lock #cache_mutex.
+ *
+ * @param remove_temporary delete temporary files left over from a
+ * previous MPD process?
+ */
+static void
+input_cache_evict(bool remove_temporary)
+{
+	struct Entry {
+		AllocatedPath path;
+		uint64_t size;
+		time_t mtime;
+	};
+
+	std::vector<Entry> entries;
+	uint64_t total = 0;
+
+	DirectoryReader reader(cache_path);
+	if (reader.HasFailed())
+		return;
+
+	while (reader.ReadEntry()) {
+		const Path name = reader.GetEntry();
+		if (name.c_str()[0] == '.')
+			continue;
+
+		auto path = AllocatedPath::Build(cache_path, name);
+		if (IsTemporaryName(name.c_str())) {
+			if (remove_temporary)
+				RemoveFile(path);
+			continue;
+		}
+
+		struct stat st;
+		if (!StatFile(path, st, false) || !S_ISREG(st.st_mode))
+			continue;
+
+		total += st.st_size;
+		entries.push_back({std::move(path), uint64_t(st.st_size),
+				   st.st_mtime});
+	}
+
+	if (total <= cache_size)
+		return;
+
+	std::sort(entries.begin(), entries.end(),
+		  [](const Entry &a, const Entry &b){
+			  return a.mtime < b.mtime;
+		  });
+
+	for (const auto &i : entries) {
+		if (total <= cache_size)
+			break;
+
+		if (RemoveFile(i.path))
+			total -= i.size;
+	}
+}
+
+bool
+input_cache_init(Error &error)
+{
+	cache_path = config_get_path(CONF_INPUT_CACHE_DIR, error);
+	if (cache_path.IsNull())
+		return !error.IsDefined();
+
+	if (!DirectoryExists(cache_path)) {
+		error.Format(cache_domain, "Not a directory: %s",
+			     cache_path.c_str());
+		cache_path = AllocatedPath::Null();
+		return false;
+	}
+
+	cache_size = uint64_t(config_get_positive(CONF_INPUT_CACHE_SIZE,
+						  DEFAULT_CACHE_SIZE)) * 1024;
+
+	const ScopeLock protect(cache_mutex);
+	input_cache_evict(true);
+	return true;
+}
+
+void
+input_cache_finish()
+{
+	cache_path = AllocatedPath::Null();
+}
+
+class CacheInputStream final : public ProxyInputStream {
+	/**
+	 * The local copy which is being read instead of the remote
+	 * stream.  The remote stream stays open (and pauses when its
+	 * buffer is full), because #ProxyInputStream owns it.
+	 */
+	InputStream *local;
+
+	/**
+	 * The partial copy which is being written while the remote
+	 * stream is being read, or nullptr.
+	 */
+	FileOutputStream *output;
+
+	AllocatedPath path, tmp_path;
+
+	/**
+	 * The number of bytes already written to #output.  Only
+	 * contiguous data from the beginning is written; data read
+	 * after a seek is skipped until the client comes back to
+	 * this position.
+	 */
+	offset_type written;
+
+	/**
+	 * Has Lookup() been called already?
+	 */
+	bool checked;
+
+public:
+	CacheInputStream(InputStream *_input)
+		:ProxyInputStream(_input),
+		 local(nullptr), output(nullptr),
+		 path(AllocatedPath::Null()),
+		 tmp_path(AllocatedPath::Null()),
+		 checked(false) {}
+
+	~CacheInputStream() {
+		if (output != nullptr) {
+			const ScopeLock protect(mutex);
+			Drain();
+		}
+
+		delete local;
+		delete output;
+	}
+
+	/* virtual methods from InputStream */
+	bool Check(Error &error) override {
+		return local != nullptr
+			? local->Check(error)
+			: ProxyInputStream::Check(error);
+	}
+
+	void Update() override;
+	bool Seek(offset_type new_offset, Error &error) override;
+
+	bool IsEOF() override {
+		return local != nullptr
+			? local->IsEOF()
+			: ProxyInputStream::IsEOF();
+	}
+
+	bool IsAvailable() override {
+		return local != nullptr
+			? local->IsAvailable()
+			: ProxyInputStream::IsAvailable();
+	}
+
+	size_t Read(void *ptr, size_t read_size, Error &error) override;
+
+private:
+	/**
+	 * Called as soon as the remote stream is ready: use an
+	 * existing copy of it, or start writing one.
+	 */
+	void Lookup();
+
+	/**
+	 * Append data which was just read from the remote stream to
+	 * the copy.
+	 */
+	void Store(offset_type at, const void *data, size_t nbytes);
+
+	void Commit();
+
+	/**
+	 * Copy the rest of the file if the remote stream has already
+	 * received it, without blocking.  Decoders often don't read
+	 * trailing tags or padding.
+	 */
+	void Drain();
+
+	void Abandon() {
+		delete output;
+		output = nullptr;
+	}
+};
+
+void
+CacheInputStream::Lookup()
+{
+	assert(IsReady());
+	assert(!checked);
+
+	checked = true;
+
+	if (!KnownSize() || GetSize() == 0 || uint64_t(GetSize()) > cache_size ||
+	    !HasVersion() || GetOffset() != 0)
+		return;
+
+	const auto name = CacheName(GetURI(), GetVersion());
+	path = AllocatedPath::Build(cache_path, name.c_str());
+
+	struct stat st;
+	if (StatFile(path, st) && S_ISREG(st.st_mode) &&
+	    offset_type(st.st_size) == GetSize()) {
+		Error error;
+		local = input_plugin_file.open(path.c_str(), mutex, cond,
+					       error);
+		if (local != nullptr) {
+			FormatDebug(cache_domain, "Playing %s from %s",
+				    GetURI(), path.c_str());
+
+			/* mark as recently used */
+			utime(path.c_str(), nullptr);
+			return;
+		}
+
+		LogError(error);
+	}
+
+	unsigned serial;
+	{
+		const ScopeLock protect(cache_mutex);
+		serial = ++cache_serial;
+	}
+
+	char suffix[32];
+	snprintf(suffix, sizeof(suffix), ".%u.tmp", serial);
+	tmp_path = AllocatedPath::Build(cache_path,
+					(name + suffix).c_str());
+
+	Error error;
+	output = new FileOutputStream(tmp_path, error,
+				      FileOutputStream::Mode::CREATE_VISIBLE);
+	if (!output->IsDefined()) {
+		LogError(error);
+		Abandon();
+		return;
+	}
+
+	written = 0;
+}
+
+void
+CacheInputStream::Update()
+{
+	if (local != nullptr) {
+		local->Update();
+		return;
+	}
+
+	ProxyInputStream::Update();
+
+	if (!checked && IsReady())
+		Lookup();
+}
+
+bool
+CacheInputStream::Seek(offset_type new_offset, Error &error)
+{
+	if (!checked)
+		Lookup();
+
+	if (local != nullptr) {
+		bool success = local->Seek(new_offset, error);
+		offset = local->GetOffset();
+		return success;
+	}
+
+	return ProxyInputStream::Seek(new_offset, error);
+}
+
+size_t
+CacheInputStream::Read(void *ptr, size_t read_size, Error &error)
+{
+	if (!checked)
+		Lookup();
+
+	if (local != nullptr) {
+		size_t nbytes = local->Read(ptr, read_size, error);
+		offset = local->GetOffset();
+		return nbytes;
+	}
+
+	const offset_type at = GetOffset();
+	size_t nbytes = ProxyInputStream::Read(ptr, read_size, error);
+	if (output != nullptr && nbytes > 0)
+		Store(at, ptr, nbytes);
+
+	return nbytes;
+}
+
+void
+CacheInputStream::Store(offset_type at, const void *data, size_t nbytes)
+{
+	assert(output != nullptr);
+
+	if (at > written || at + offset_type(nbytes) <= written)
+		/* not contiguous */
+		return;
+
+	const size_t skip = written - at;
+	Error error;
+	if (!output->Write((const uint8_t *)data + skip, nbytes - skip,
+			   error)) {
+		LogError(error);
+		Abandon();
+		return;
+	}
+
+	written += nbytes - skip;
+	if (written >= GetSize())
+		Commit();
+}
+
+void
+CacheInputStream::Commit()
+{
+	Error error;
+	bool success = output->Commit(error);
+	delete output;
+	output = nullptr;
+
+	if (!success) {
+		LogError(error);
+		RemoveFile(tmp_path);
+		return;
+	}
+
+	const ScopeLock protect(cache_mutex);
+
+	if (!RenameFile(tmp_path, path)) {
+		FormatErrno(cache_domain, "Failed to rename %s",
+			    tmp_path.c_str());
+		RemoveFile(tmp_path);
+		return;
+	}
+
+	FormatDebug(cache_domain, "Stored %s in %s",
+		    GetURI(), path.c_str());
+
+	input_cache_evict(false);
+}
+
+void
+CacheInputStream::Drain()
+{
+	Error error;
+	while (output != nullptr && input.GetOffset() == written &&
+	       input.IsAvailable() && !input.IsEOF()) {
+		char buffer[16384];
+		const offset_type at = input.GetOffset();
+		size_t nbytes = input.Read(buffer, sizeof(buffer), error);
+		if (nbytes == 0)
+			break;
+
+		Store(at, buffer, nbytes);
+	}
+}
+
+InputStream *
+input_cache_open(InputStream *is)
+{
+	assert(is != nullptr);
+
+	if (cache_path.IsNull() || !uri_has_scheme(is->GetURI()))
+		/* disabled, or a local file */
+		return is;
+
+	return new CacheInputStream(is);
+}
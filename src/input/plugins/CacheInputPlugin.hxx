@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/** \file
+ *
+ * A wrapper for an #InputStream which mirrors remote files to a local
+ * directory.  When a file is played again and has not been modified
+ * (according to InputStream::GetVersion()), it is read from the
+ * local copy.
+ */
+
+#ifndef MPD_INPUT_CACHE_HXX
+#define MPD_INPUT_CACHE_HXX
+
+#include "check.h"
+
+class InputStream;
+class Error;
+
+/**
+ * Load the "input_cache_directory" and "input_cache_size" settings
+ * and evict files until the cache fits.  Without a directory, the
+ * cache is disabled.
+ */
+bool
+input_cache_init(Error &error);
+
+void
+input_cache_finish();
+
+InputStream *
+input_cache_open(InputStream *is);
+
+#endif
@@ -30,15 +30,17 @@
 #include "event/TimeoutMonitor.hxx"
 #include "event/Call.hxx"
 #include "IOThread.hxx"
+#include "thread/Mutex.hxx"
 #include "util/ASCII.hxx"
 #include "util/StringUtil.hxx"
 #include "util/NumberParser.hxx"
 #include "util/CircularBuffer.hxx"
-#include "util/HugeAllocator.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
 
+#include <vector>
+
 #include <assert.h>
 #include <string.h>
 
@@ -49,18 +51,26 @@
 #endif
 
 /**
- * Do not buffer more than this number of bytes.  It should be a
- * reasonable limit that doesn't make low-end machines suffer too
- * much, but doesn't cause stuttering on high-latency lines.
+ * Do not buffer more than this number of bytes by default.  It
+ * should be a reasonable limit that doesn't make low-end machines
+ * suffer too much, but doesn't cause stuttering on high-latency
+ * lines.
  */
-static const size_t CURL_MAX_BUFFERED = 512 * 1024;
+static constexpr size_t CURL_MAX_BUFFERED = 512 * 1024;
 
 /**
- * Resume the stream at this number of bytes after it has been paused.
+ * The smallest buffer; it must be large enough for a few blocks of
+ * CURL_MAX_WRITE_SIZE bytes.  This is also where the adaptive
+ * buffer starts.
  */
-static const size_t CURL_RESUME_AT = 384 * 1024;
+static constexpr size_t CURL_MIN_BUFFERED = 64 * 1024;
+
+class CurlMulti;
 
 struct CurlInputStream final : public AsyncInputStream {
+	/** the #CurlMulti (and I/O thread) running this stream */
+	CurlMulti &multi;
+
 	/* some buffers which were passed to libcurl, which we have
 	   too free */
 	char range[32];
@@ -75,13 +85,24 @@ struct CurlInputStream final : public AsyncInputStream {
 	/** parser for icy-metadata */
 	IcyInputStream *icy;
 
-	CurlInputStream(const char *_url, Mutex &_mutex, Cond &_cond,
-			void *_buffer)
-		:AsyncInputStream(_url, _mutex, _cond,
-				  _buffer, CURL_MAX_BUFFERED,
-				  CURL_RESUME_AT),
+	/**
+	 * The file offset at which the current request starts (see
+	 * DoSeek()).
+	 */
+	offset_type request_offset;
+
+	CurlInputStream(CurlMulti &_multi, EventLoop &_loop,
+			const char *_url, Mutex &_mutex, Cond &_cond,
+			void *_buffer, size_t _buffer_size, bool _mirrored)
+		:AsyncInputStream(_loop, _url, _mutex, _cond,
+				  _buffer, _buffer_size, _mirrored,
+				  /* resume the stream when the buffer
+				     is down to three quarters */
+				  _buffer_size / 4 * 3),
+		 multi(_multi),
 		 request_headers(nullptr),
-		 icy(new IcyInputStream(this)) {}
+		 icy(new IcyInputStream(this)),
+		 request_offset(0) {}
 
 	~CurlInputStream();
 
@@ -125,8 +146,6 @@ struct CurlInputStream final : public AsyncInputStream {
 	virtual void DoSeek(offset_type new_offset) override;
 };
 
-class CurlMulti;
-
 /**
  * Monitor for one socket created by CURL.
  */
@@ -185,7 +204,7 @@ private:
 };
 
 /**
- * Manager for the global CURLM object.
+ * Manager for a CURLM object.  There is one for each I/O thread.
  */
 class CurlMulti final : private TimeoutMonitor {
 	CURLM *const multi;
@@ -197,6 +216,8 @@ public:
 		curl_multi_cleanup(multi);
 	}
 
+	using TimeoutMonitor::GetEventLoop;
+
 	bool Add(CurlInputStream *c, Error &error);
 	void Remove(CurlInputStream *c);
 
@@ -247,7 +268,47 @@ static unsigned proxy_port;
 
 static bool verify_peer, verify_host;
 
-static CurlMulti *curl_multi;
+/**
+ * The size of each stream's buffer.  Configured with "buffer_size".
+ */
+static size_t curl_buffer_size;
+
+/**
+ * Let the buffer limit adapt to the bandwidth?  Configured with
+ * "buffer_adaptive".
+ */
+static bool curl_buffer_adaptive;
+
+/**
+ * The size of each seekable stream's #BlockCache.  Configured with
+ * "cache_size".
+ */
+static size_t curl_cache_size;
+
+/**
+ * Negotiate HTTP/2 and multiplex streams?  Configured with "http2".
+ */
+static bool http2;
+
+/**
+ * One #CurlMulti for each I/O thread, see io_thread_get().
+ */
+static std::vector<CurlMulti *> curl_multis;
+
+/**
+ * Shares the DNS cache and the TLS session cache among all easy
+ * handles, so a new stream from the same server can skip the full
+ * TLS handshake.  The connection cache is owned by the #CurlMulti
+ * object, which all easy handles are added to.
+ */
+static CURLSH *curl_share;
+
+/**
+ * One lock for each kind of data in #curl_share.  The easy handles
+ * are configured in the client thread, but all transfers run in the
+ * I/O thread.
+ */
+static Mutex curl_share_mutex[CURL_LOCK_DATA_LAST];
 
 static constexpr Domain http_domain("http");
 static constexpr Domain curl_domain("curl");
@@ -262,6 +323,14 @@ CurlMulti::CurlMulti(EventLoop &_loop, CURLM *_multi)
 
 	curl_multi_setopt(multi, CURLMOPT_TIMERFUNCTION, TimerFunction);
 	curl_multi_setopt(multi, CURLMOPT_TIMERDATA, this);
+
+#if LIBCURL_VERSION_NUM >= 0x072b00
+	if (http2)
+		/* run several streams from the same HTTP/2 server
+		   over one connection */
+		curl_multi_setopt(multi, CURLMOPT_PIPELINING,
+				  CURLPIPE_MULTIPLEX);
+#endif
 }
 
 /**
@@ -296,9 +365,9 @@ CurlInputStream::DoResume()
 		/* libcurl older than 7.32.0 does not update
 		   its sockets after curl_easy_pause(); force
 		   libcurl to do it now */
-		curl_multi->ResumeSockets();
+		multi.ResumeSockets();
 
-	curl_multi->InvalidateSockets();
+	multi.InvalidateSockets();
 
 	mutex.lock();
 }
@@ -318,7 +387,7 @@ CurlSocket::SocketFunction(gcc_unused CURL *easy,
 	}
 
 	if (cs == nullptr) {
-		cs = new CurlSocket(multi, io_thread_get(), s);
+		cs = new CurlSocket(multi, multi.GetEventLoop(), s);
 		multi.Assign(s, *cs);
 	} else {
 #ifdef USE_EPOLL
@@ -382,8 +451,8 @@ input_curl_easy_add_indirect(CurlInputStream *c, Error &error)
 	assert(c->easy != nullptr);
 
 	bool result;
-	BlockingCall(io_thread_get(), [c, &error, &result](){
-			result = curl_multi->Add(c, error);
+	BlockingCall(c->multi.GetEventLoop(), [c, &error, &result](){
+			result = c->multi.Add(c, error);
 		});
 	return result;
 }
@@ -402,7 +471,7 @@ CurlInputStream::FreeEasy()
 	if (easy == nullptr)
 		return;
 
-	curl_multi->Remove(this);
+	multi.Remove(this);
 
 	curl_easy_cleanup(easy);
 	easy = nullptr;
@@ -414,9 +483,9 @@ CurlInputStream::FreeEasy()
 void
 CurlInputStream::FreeEasyIndirect()
 {
-	BlockingCall(io_thread_get(), [this](){
+	BlockingCall(multi.GetEventLoop(), [this](){
 			FreeEasy();
-			curl_multi->InvalidateSockets();
+			multi.InvalidateSockets();
 		});
 
 	assert(easy == nullptr);
@@ -522,6 +591,43 @@ CurlMulti::OnTimeout()
 	SocketAction(CURL_SOCKET_TIMEOUT, 0);
 }
 
+static void
+input_curl_share_lock(gcc_unused CURL *handle, curl_lock_data data,
+		      gcc_unused curl_lock_access access,
+		      gcc_unused void *userptr)
+{
+	curl_share_mutex[data].lock();
+}
+
+static void
+input_curl_share_unlock(gcc_unused CURL *handle, curl_lock_data data,
+			gcc_unused void *userptr)
+{
+	curl_share_mutex[data].unlock();
+}
+
+/**
+ * Create #curl_share.  Failure is not fatal, the easy handles just
+ * don't share their caches then.
+ */
+static void
+input_curl_share_init()
+{
+	curl_share = curl_share_init();
+	if (curl_share == nullptr) {
+		LogWarning(curl_domain, "curl_share_init() failed");
+		return;
+	}
+
+	curl_share_setopt(curl_share, CURLSHOPT_LOCKFUNC,
+			  input_curl_share_lock);
+	curl_share_setopt(curl_share, CURLSHOPT_UNLOCKFUNC,
+			  input_curl_share_unlock);
+	curl_share_setopt(curl_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+	curl_share_setopt(curl_share, CURLSHOPT_SHARE,
+			  CURL_LOCK_DATA_SSL_SESSION);
+}
+
 /*
  * InputPlugin methods
  *
@@ -566,25 +672,58 @@ input_curl_init(const config_param &param, Error &error)
 
 	verify_peer = param.GetBlockValue("verify_peer", true);
 	verify_host = param.GetBlockValue("verify_host", true);
+	http2 = param.GetBlockValue("http2", true);
 
-	CURLM *multi = curl_multi_init();
-	if (multi == nullptr) {
-		curl_slist_free_all(http_200_aliases);
-		curl_global_cleanup();
-		error.Set(curl_domain, 0, "curl_multi_init() failed");
-		return InputPlugin::InitResult::UNAVAILABLE;
+	curl_buffer_size = param.GetBlockValue("buffer_size",
+					       unsigned(CURL_MAX_BUFFERED));
+	if (curl_buffer_size < CURL_MIN_BUFFERED)
+		curl_buffer_size = CURL_MIN_BUFFERED;
+
+	curl_buffer_adaptive = param.GetBlockValue("buffer_adaptive", false);
+	curl_cache_size = param.GetBlockValue("cache_size", 1024u * 1024u);
+
+#ifdef CURL_VERSION_HTTP2
+	if (http2 && (version_info == nullptr ||
+		      (version_info->features & CURL_VERSION_HTTP2) == 0)) {
+		LogDebug(curl_domain, "no HTTP/2 support in libcurl");
+		http2 = false;
 	}
+#else
+	http2 = false;
+#endif
+
+	const unsigned n_multis = io_thread_count();
+	for (unsigned i = 0; i < n_multis; ++i) {
+		CURLM *multi = curl_multi_init();
+		if (multi == nullptr) {
+			for (auto *m : curl_multis)
+				delete m;
+			curl_multis.clear();
+
+			curl_slist_free_all(http_200_aliases);
+			curl_global_cleanup();
+			error.Set(curl_domain, 0, "curl_multi_init() failed");
+			return InputPlugin::InitResult::UNAVAILABLE;
+		}
 
-	curl_multi = new CurlMulti(io_thread_get(), multi);
+		curl_multis.push_back(new CurlMulti(io_thread_get(i), multi));
+	}
+
+	input_curl_share_init();
 	return InputPlugin::InitResult::SUCCESS;
 }
 
 static void
 input_curl_finish(void)
 {
-	BlockingCall(io_thread_get(), [](){
-			delete curl_multi;
-		});
+	for (auto *m : curl_multis)
+		BlockingCall(m->GetEventLoop(), [m](){
+				delete m;
+			});
+	curl_multis.clear();
+
+	if (curl_share != nullptr)
+		curl_share_cleanup(curl_share);
 
 	curl_slist_free_all(http_200_aliases);
 
@@ -608,9 +747,15 @@ CurlInputStream::HeaderReceived(const char *name, std::string &&value)
 		if (!icy->IsEnabled())
 			seekable = true;
 	} else if (StringEqualsCaseASCII(name, "content-length")) {
-		size = offset + ParseUint64(value.c_str());
+		size = request_offset + ParseUint64(value.c_str());
 	} else if (StringEqualsCaseASCII(name, "content-type")) {
 		SetMimeType(std::move(value));
+	} else if (StringEqualsCaseASCII(name, "etag") ||
+		   StringEqualsCaseASCII(name, "last-modified")) {
+		/* servers send their headers in a stable order, so
+		   whichever of both comes last identifies the
+		   version */
+		SetVersion(std::move(value));
 	} else if (StringEqualsCaseASCII(name, "icy-name") ||
 		   StringEqualsCaseASCII(name, "ice-name") ||
 		   StringEqualsCaseASCII(name, "x-audiocast-name")) {
@@ -728,6 +873,26 @@ CurlInputStream::InitEasy(Error &error)
 	curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1l);
 	curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT, 10l);
 
+	if (curl_share != nullptr)
+		curl_easy_setopt(easy, CURLOPT_SHARE, curl_share);
+
+#if LIBCURL_VERSION_NUM >= 0x071900
+	/* keep idle connections in the cache alive for the next
+	   song */
+	curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1l);
+#endif
+
+#if LIBCURL_VERSION_NUM >= 0x072f00
+	if (http2) {
+		curl_easy_setopt(easy, CURLOPT_HTTP_VERSION,
+				 (long)CURL_HTTP_VERSION_2TLS);
+
+		/* prefer waiting for a connection which can be
+		   multiplexed over opening a new one */
+		curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1l);
+	}
+#endif
+
 	if (proxy != nullptr)
 		curl_easy_setopt(easy, CURLOPT_PROXY, proxy);
 
@@ -772,8 +937,8 @@ CurlInputStream::DoSeek(offset_type new_offset)
 
 	FreeEasyIndirect();
 
-	offset = new_offset;
-	if (offset == size) {
+	request_offset = new_offset;
+	if (new_offset == size) {
 		/* seek to EOF: simulate empty result; avoid
 		   triggering a "416 Requested Range Not Satisfiable"
 		   response */
@@ -791,8 +956,8 @@ CurlInputStream::DoSeek(offset_type new_offset)
 
 	/* send the "Range" header */
 
-	if (offset > 0) {
-		sprintf(range, "%lld-", (long long)offset);
+	if (new_offset > 0) {
+		sprintf(range, "%lld-", (long long)new_offset);
 		curl_easy_setopt(easy, CURLOPT_RANGE, range);
 	}
 
@@ -803,20 +968,49 @@ CurlInputStream::DoSeek(offset_type new_offset)
 	}
 
 	mutex.lock();
-	offset = new_offset;
+}
+
+/**
+ * Choose the #CurlMulti for a new stream.  All streams from one
+ * server go to the same I/O thread, which lets them share
+ * connections (and HTTP/2 multiplexing); different servers are
+ * spread over all I/O threads.
+ */
+static CurlMulti &
+input_curl_select_multi(const char *url)
+{
+	assert(!curl_multis.empty());
+
+	const char *host = strstr(url, "://");
+	host = host != nullptr ? host + 3 : url;
+
+	unsigned hash = 5381;
+	for (const char *p = host; *p != 0 && *p != '/'; ++p)
+		hash = (hash << 5) + hash + (unsigned char)*p;
+
+	return *curl_multis[hash % curl_multis.size()];
 }
 
 inline InputStream *
 CurlInputStream::Open(const char *url, Mutex &mutex, Cond &cond,
 		      Error &error)
 {
-	void *buffer = HugeAllocate(CURL_MAX_BUFFERED);
+	bool mirrored;
+	void *buffer = AllocateBuffer(curl_buffer_size, mirrored);
 	if (buffer == nullptr) {
 		error.Set(curl_domain, "Out of memory");
 		return nullptr;
 	}
 
-	CurlInputStream *c = new CurlInputStream(url, mutex, cond, buffer);
+	CurlMulti &multi = input_curl_select_multi(url);
+	CurlInputStream *c = new CurlInputStream(multi, multi.GetEventLoop(),
+						 url, mutex, cond,
+						 buffer, curl_buffer_size,
+						 mirrored);
+	if (curl_buffer_adaptive)
+		c->EnableAdaptiveLimit(CURL_MIN_BUFFERED);
+	if (curl_cache_size > 0)
+		c->EnableCache(curl_cache_size);
 
 	if (!c->InitEasy(error) || !input_curl_easy_add_indirect(c, error)) {
 		delete c;
@@ -21,31 +21,93 @@
 #include "FileInputPlugin.hxx"
 #include "../InputStream.hxx"
 #include "../InputPlugin.hxx"
+#include "config/ConfigData.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "fs/Traits.hxx"
 #include "system/fd_util.h"
 #include "open.h"
 
+#include <algorithm>
+
 #include <sys/stat.h>
 #include <unistd.h>
 #include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
 
 static constexpr Domain file_domain("file");
 
+/**
+ * Allow memory-mapping files with InputStream::Map()?
+ */
+static bool file_mmap;
+
+/**
+ * Ask the kernel to read this number of bytes ahead of the current
+ * position.  Configured with "readahead"; 0 leaves it to the kernel.
+ */
+static size_t file_readahead;
+
+/**
+ * Drop the pages behind the current position from the page cache?
+ */
+static bool file_drop_behind;
+
+/**
+ * Pass ranges of at least this size to posix_fadvise().  No read-ahead
+ * is done before the stream has read this much, because scanning tags
+ * usually reads just the beginning of a file.
+ */
+static constexpr InputStream::offset_type FILE_ADVISE_CHUNK = 256 * 1024;
+
 struct FileInputStream final : public InputStream {
 	int fd;
 
+	/**
+	 * The memory mapping created by Map(); nullptr if the file
+	 * has not been mapped.  While the file is mapped, Read()
+	 * copies from it and Seek() does not need a system call.
+	 */
+	const uint8_t *map;
+
+	/**
+	 * Has Map() failed?  It will not try again.
+	 */
+	bool map_failed;
+
+	/**
+	 * The end of the range which has been passed to
+	 * POSIX_FADV_WILLNEED.
+	 */
+	offset_type advised_end;
+
+	/**
+	 * The start of the range which has not been passed to
+	 * POSIX_FADV_DONTNEED yet.
+	 */
+	offset_type dropped_end;
+
 	FileInputStream(const char *path, int _fd, off_t _size,
 			Mutex &_mutex, Cond &_cond)
 		:InputStream(path, _mutex, _cond),
-		 fd(_fd) {
+		 fd(_fd), map(nullptr), map_failed(!file_mmap),
+		 advised_end(0), dropped_end(0) {
 		size = _size;
 		seekable = true;
 		SetReady();
 	}
 
 	~FileInputStream() {
+#ifndef WIN32
+		if (map != nullptr)
+			munmap(const_cast<uint8_t *>(map), size);
+#endif
+
 		close(fd);
 	}
 
@@ -57,8 +119,25 @@ struct FileInputStream final : public InputStream {
 
 	size_t Read(void *ptr, size_t size, Error &error) override;
 	bool Seek(offset_type offset, Error &error) override;
+	ConstBuffer<void> Map() override;
+
+private:
+	/**
+	 * Pass hints about the current position to the kernel: read
+	 * ahead of it, drop the pages behind it.
+	 */
+	void Advise();
 };
 
+static InputPlugin::InitResult
+input_file_init(const config_param &param, gcc_unused Error &error)
+{
+	file_mmap = param.GetBlockValue("mmap", false);
+	file_readahead = param.GetBlockValue("readahead", 0u);
+	file_drop_behind = param.GetBlockValue("drop_behind", false);
+	return InputPlugin::InitResult::SUCCESS;
+}
+
 static InputStream *
 input_file_open(const char *filename,
 		Mutex &mutex, Cond &cond,
@@ -98,22 +177,71 @@ input_file_open(const char *filename,
 	return new FileInputStream(filename, fd, st.st_size, mutex, cond);
 }
 
+void
+FileInputStream::Advise()
+{
+#ifdef POSIX_FADV_WILLNEED
+	if (file_readahead > 0 && offset >= FILE_ADVISE_CHUNK) {
+		const offset_type start = std::max(advised_end, offset);
+		const offset_type end =
+			std::min<offset_type>(offset + file_readahead, size);
+		if (end > start &&
+		    (end - start >= FILE_ADVISE_CHUNK || end == size)) {
+			posix_fadvise(fd, (off_t)start, (off_t)(end - start),
+				      POSIX_FADV_WILLNEED);
+			advised_end = end;
+		}
+	}
+#endif
+
+#ifdef POSIX_FADV_DONTNEED
+	if (file_drop_behind && offset >= dropped_end + FILE_ADVISE_CHUNK) {
+		posix_fadvise(fd, (off_t)dropped_end,
+			      (off_t)(offset - dropped_end),
+			      POSIX_FADV_DONTNEED);
+		dropped_end = offset;
+	}
+#endif
+}
+
 bool
 FileInputStream::Seek(offset_type new_offset, Error &error)
 {
-	auto result = lseek(fd, (off_t)new_offset, SEEK_SET);
-	if (result < 0) {
-		error.SetErrno("Failed to seek");
-		return false;
+	if (map != nullptr) {
+		if (new_offset > size) {
+			error.Set(file_domain, "Seek beyond end of file");
+			return false;
+		}
+
+		offset = new_offset;
+	} else {
+		auto result = lseek(fd, (off_t)new_offset, SEEK_SET);
+		if (result < 0) {
+			error.SetErrno("Failed to seek");
+			return false;
+		}
+
+		offset = (offset_type)result;
 	}
 
-	offset = (offset_type)result;
+	/* start over at the new position */
+	advised_end = dropped_end = offset;
 	return true;
 }
 
 size_t
 FileInputStream::Read(void *ptr, size_t read_size, Error &error)
 {
+	if (map != nullptr) {
+		if (offset_type(read_size) > GetRest())
+			read_size = GetRest();
+
+		memcpy(ptr, map + offset, read_size);
+		offset += read_size;
+		Advise();
+		return read_size;
+	}
+
 	ssize_t nbytes = read(fd, ptr, read_size);
 	if (nbytes < 0) {
 		error.SetErrno("Failed to read");
@@ -121,12 +249,48 @@ FileInputStream::Read(void *ptr, size_t read_size, Error &error)
 	}
 
 	offset += nbytes;
+	Advise();
 	return (size_t)nbytes;
 }
 
+ConstBuffer<void>
+FileInputStream::Map()
+{
+#ifdef WIN32
+	return nullptr;
+#else
+	if (map == nullptr && !map_failed) {
+		if (size == 0 || uint64_t(size) > SIZE_MAX) {
+			map_failed = true;
+			return nullptr;
+		}
+
+		void *p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+		if (p == MAP_FAILED) {
+			map_failed = true;
+			return nullptr;
+		}
+
+#ifdef MADV_SEQUENTIAL
+		madvise(p, size, MADV_SEQUENTIAL);
+#endif
+
+		map = (const uint8_t *)p;
+	}
+
+	if (map == nullptr)
+		return nullptr;
+
+	/* the caller is going to read from the current position */
+	Advise();
+
+	return { map, size_t(size) };
+#endif
+}
+
 const InputPlugin input_plugin_file = {
 	"file",
-	nullptr,
+	input_file_init,
 	nullptr,
 	input_file_open,
 };
@@ -24,7 +24,8 @@
 #include "lib/nfs/Domain.hxx"
 #include "lib/nfs/Glue.hxx"
 #include "lib/nfs/FileReader.hxx"
-#include "util/HugeAllocator.hxx"
+#include "config/ConfigData.hxx"
+#include "IOThread.hxx"
 #include "util/StringUtil.hxx"
 #include "util/Error.hxx"
 
@@ -32,6 +33,8 @@ extern "C" {
 #include <nfsc/libnfs.h>
 }
 
+#include <algorithm>
+
 #include <string.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -48,15 +51,36 @@ static const size_t NFS_MAX_BUFFERED = 512 * 1024;
  */
 static const size_t NFS_RESUME_AT = 384 * 1024;
 
+/**
+ * The maximum number of read requests in flight.  Configured with
+ * "read_window".
+ */
+static unsigned nfs_read_window;
+
+/**
+ * The size of each read request.  Configured with "read_size".
+ */
+static size_t nfs_read_size;
+
 class NfsInputStream final : public AsyncInputStream, NfsFileReader {
+	/**
+	 * The offset of the next read request.
+	 */
 	uint64_t next_offset;
 
+	/**
+	 * The offset following the data which has been received.
+	 * The difference to #next_offset is the amount of data in
+	 * flight.
+	 */
+	uint64_t read_offset;
+
 public:
 	NfsInputStream(const char *_uri,
 		       Mutex &_mutex, Cond &_cond,
-		       void *_buffer)
-		:AsyncInputStream(_uri, _mutex, _cond,
-				  _buffer, NFS_MAX_BUFFERED,
+		       void *_buffer, bool _mirrored)
+		:AsyncInputStream(io_thread_get(), _uri, _mutex, _cond,
+				  _buffer, NFS_MAX_BUFFERED, _mirrored,
 				  NFS_RESUME_AT) {}
 
 	virtual ~NfsInputStream() {
@@ -70,6 +94,10 @@ public:
 	}
 
 private:
+	/**
+	 * Send read requests until the window or the buffer is
+	 * full.
+	 */
 	bool DoRead();
 
 protected:
@@ -79,7 +107,7 @@ protected:
 
 private:
 	/* virtual methods from NfsFileReader */
-	void OnNfsFileOpen(uint64_t size) override;
+	void OnNfsFileOpen(uint64_t size, time_t mtime) override;
 	void OnNfsFileRead(const void *data, size_t size) override;
 	void OnNfsFileError(Error &&error) override;
 };
@@ -87,29 +115,39 @@ private:
 bool
 NfsInputStream::DoRead()
 {
-	assert(NfsFileReader::IsIdle());
-
-	int64_t remaining = size - next_offset;
-	if (remaining <= 0)
-		return true;
-
-	const size_t buffer_space = GetBufferSpace();
-	if (buffer_space == 0) {
-		Pause();
-		return true;
-	}
-
-	size_t nbytes = std::min<size_t>(std::min<uint64_t>(remaining, 32768),
-					 buffer_space);
-
-	mutex.unlock();
-	Error error;
-	bool success = NfsFileReader::Read(next_offset, nbytes, error);
-	mutex.lock();
-
-	if (!success) {
-		PostponeError(std::move(error));
-		return false;
+	while (GetPendingReads() < nfs_read_window) {
+		if (GetPendingReads() == 0)
+			/* nothing in flight (anymore, e.g. after a short
+			   read): continue where the data ends */
+			next_offset = read_offset;
+
+		int64_t remaining = size - next_offset;
+		if (remaining <= 0)
+			break;
+
+		const size_t in_flight = next_offset - read_offset;
+		const size_t buffer_space = GetBufferSpace();
+		if (buffer_space <= in_flight) {
+			if (in_flight == 0)
+				Pause();
+			break;
+		}
+
+		size_t nbytes = std::min<size_t>(std::min<uint64_t>(remaining,
+								    nfs_read_size),
+						 buffer_space - in_flight);
+
+		mutex.unlock();
+		Error error;
+		bool success = NfsFileReader::Read(next_offset, nbytes, error);
+		mutex.lock();
+
+		if (!success) {
+			PostponeError(std::move(error));
+			return false;
+		}
+
+		next_offset += nbytes;
 	}
 
 	return true;
@@ -130,19 +168,20 @@ NfsInputStream::DoSeek(offset_type new_offset)
 	NfsFileReader::CancelRead();
 	mutex.lock();
 
-	next_offset = offset = new_offset;
+	next_offset = read_offset = new_offset;
 	SeekDone();
 	DoRead();
 }
 
 void
-NfsInputStream::OnNfsFileOpen(uint64_t _size)
+NfsInputStream::OnNfsFileOpen(uint64_t _size, time_t mtime)
 {
 	const ScopeLock protect(mutex);
 
+	SetVersion(std::to_string(mtime));
 	size = _size;
 	seekable = true;
-	next_offset = 0;
+	next_offset = read_offset = 0;
 	SetReady();
 	DoRead();
 }
@@ -155,7 +194,7 @@ NfsInputStream::OnNfsFileRead(const void *data, size_t data_size)
 	assert(IsBufferFull() == (GetBufferSpace() == 0));
 	AppendToBuffer(data, data_size);
 
-	next_offset += data_size;
+	read_offset += data_size;
 
 	DoRead();
 }
@@ -178,8 +217,12 @@ NfsInputStream::OnNfsFileError(Error &&error)
  */
 
 static InputPlugin::InitResult
-input_nfs_init(const config_param &, Error &)
+input_nfs_init(const config_param &param, Error &)
 {
+	nfs_read_window = std::max(param.GetBlockValue("read_window", 4u), 1u);
+	nfs_read_size = std::max(param.GetBlockValue("read_size", 32768u),
+				 4096u);
+
 	nfs_init();
 	return InputPlugin::InitResult::SUCCESS;
 }
@@ -198,13 +241,16 @@ input_nfs_open(const char *uri,
 	if (!StringStartsWith(uri, "nfs://"))
 		return nullptr;
 
-	void *buffer = HugeAllocate(NFS_MAX_BUFFERED);
+	bool mirrored;
+	void *buffer = AsyncInputStream::AllocateBuffer(NFS_MAX_BUFFERED,
+							mirrored);
 	if (buffer == nullptr) {
 		error.Set(nfs_domain, "Out of memory");
 		return nullptr;
 	}
 
-	NfsInputStream *is = new NfsInputStream(uri, mutex, cond, buffer);
+	NfsInputStream *is = new NfsInputStream(uri, mutex, cond, buffer,
+						mirrored);
 	if (!is->Open(error)) {
 		delete is;
 		return nullptr;
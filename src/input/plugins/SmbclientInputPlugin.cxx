@@ -20,34 +20,39 @@
 #include "config.h"
 #include "SmbclientInputPlugin.hxx"
 #include "lib/smbclient/Init.hxx"
-#include "lib/smbclient/Mutex.hxx"
+#include "lib/smbclient/Context.hxx"
 #include "../InputStream.hxx"
 #include "../InputPlugin.hxx"
+#include "thread/Mutex.hxx"
 #include "util/StringUtil.hxx"
 #include "util/Error.hxx"
 
-#include <libsmbclient.h>
+#include <errno.h>
 
 class SmbclientInputStream final : public InputStream {
-	SMBCCTX *ctx;
-	int fd;
+	/**
+	 * This stream's own context; it is only used by the client
+	 * thread, so streams don't block each other.
+	 */
+	SmbclientContext ctx;
+
+	SMBCFILE *const handle;
 
 public:
 	SmbclientInputStream(const char *_uri,
 			     Mutex &_mutex, Cond &_cond,
-			     SMBCCTX *_ctx, int _fd, const struct stat &st)
+			     SmbclientContext &&_ctx, SMBCFILE *_handle,
+			     const struct stat &st)
 		:InputStream(_uri, _mutex, _cond),
-		 ctx(_ctx), fd(_fd) {
+		 ctx(std::move(_ctx)), handle(_handle) {
 		seekable = true;
 		size = st.st_size;
+		SetVersion(std::to_string(st.st_mtime));
 		SetReady();
 	}
 
 	~SmbclientInputStream() {
-		smbclient_mutex.lock();
-		smbc_close(fd);
-		smbc_free_context(ctx, 1);
-		smbclient_mutex.unlock();
+		ctx.Close(handle);
 	}
 
 	/* virtual methods from InputStream */
@@ -71,8 +76,6 @@ input_smbclient_init(gcc_unused const config_param &param, Error &error)
 	if (!SmbclientInit(error))
 		return InputPlugin::InitResult::UNAVAILABLE;
 
-	// TODO: create one global SMBCCTX here?
-
 	// TODO: evaluate config_param, call smbc_setOption*()
 
 	return InputPlugin::InitResult::SUCCESS;
@@ -86,63 +89,56 @@ input_smbclient_open(const char *uri,
 	if (!StringStartsWith(uri, "smb://"))
 		return nullptr;
 
-	const ScopeLock protect(smbclient_mutex);
-
-	SMBCCTX *ctx = smbc_new_context();
-	if (ctx == nullptr) {
-		error.SetErrno("smbc_new_context() failed");
-		return nullptr;
-	}
-
-	SMBCCTX *ctx2 = smbc_init_context(ctx);
-	if (ctx2 == nullptr) {
-		error.SetErrno("smbc_init_context() failed");
-		smbc_free_context(ctx, 1);
+	SmbclientContext ctx = SmbclientContext::New(error);
+	if (!ctx.IsDefined())
 		return nullptr;
-	}
-
-	ctx = ctx2;
 
-	int fd = smbc_open(uri, O_RDONLY, 0);
-	if (fd < 0) {
+	SMBCFILE *handle = ctx.Open(uri, O_RDONLY, 0);
+	if (handle == nullptr) {
 		error.SetErrno("smbc_open() failed");
-		smbc_free_context(ctx, 1);
 		return nullptr;
 	}
 
 	struct stat st;
-	if (smbc_fstat(fd, &st) < 0) {
+	if (ctx.Stat(handle, st) < 0) {
 		error.SetErrno("smbc_fstat() failed");
-		smbc_close(fd);
-		smbc_free_context(ctx, 1);
+		ctx.Close(handle);
 		return nullptr;
 	}
 
-	return new SmbclientInputStream(uri, mutex, cond, ctx, fd, st);
+	return new SmbclientInputStream(uri, mutex, cond,
+					std::move(ctx), handle, st);
 }
 
 size_t
 SmbclientInputStream::Read(void *ptr, size_t read_size, Error &error)
 {
-	smbclient_mutex.lock();
-	ssize_t nbytes = smbc_read(fd, ptr, read_size);
-	smbclient_mutex.unlock();
+	/* release the lock during the network round trip, because
+	   other threads (e.g. the player) may be waiting for it */
+	mutex.unlock();
+	ssize_t nbytes = ctx.Read(handle, ptr, read_size);
+	const int e = errno;
+	mutex.lock();
+
 	if (nbytes < 0) {
-		error.SetErrno("smbc_read() failed");
-		nbytes = 0;
+		error.SetErrno(e, "smbc_read() failed");
+		return 0;
 	}
 
+	offset += nbytes;
 	return nbytes;
 }
 
 bool
 SmbclientInputStream::Seek(offset_type new_offset, Error &error)
 {
-	smbclient_mutex.lock();
-	off_t result = smbc_lseek(fd, new_offset, SEEK_SET);
-	smbclient_mutex.unlock();
+	mutex.unlock();
+	off_t result = ctx.Seek(handle, new_offset, SEEK_SET);
+	const int e = errno;
+	mutex.lock();
+
 	if (result < 0) {
-		error.SetErrno("smbc_lseek() failed");
+		error.SetErrno(e, "smbc_lseek() failed");
 		return false;
 	}
 
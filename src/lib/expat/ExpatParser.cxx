@@ -48,25 +48,31 @@ ExpatParser::Parse(const char *data, size_t length, bool is_final,
 	return success;
 }
 
-bool
-ExpatParser::Parse(InputStream &is, Error &error)
+size_t
+ExpatParser::ParseSome(InputStream &is, Error &error)
 {
 	assert(is.IsReady());
 
-	while (true) {
-		char buffer[4096];
-		size_t nbytes = is.LockRead(buffer, sizeof(buffer), error);
-		if (nbytes == 0)
-			break;
-
-		if (!Parse(buffer, nbytes, false, error))
-			return false;
+	char buffer[4096];
+	size_t nbytes = is.LockRead(buffer, sizeof(buffer), error);
+	if (nbytes == 0) {
+		if (!error.IsDefined())
+			Parse("", 0, true, error);
+		return 0;
 	}
 
-	if (error.IsDefined())
-		return false;
+	if (!Parse(buffer, nbytes, false, error))
+		return 0;
+
+	return nbytes;
+}
+
+bool
+ExpatParser::Parse(InputStream &is, Error &error)
+{
+	while (ParseSome(is, error) > 0) {}
 
-	return Parse("", 0, true, error);
+	return !error.IsDefined();
 }
 
 const char *
@@ -55,6 +55,15 @@ public:
 
 	bool Parse(InputStream &is, Error &error);
 
+	/**
+	 * Read one chunk from the #InputStream and parse it.  At the
+	 * end of the stream, the parser is finalized.
+	 *
+	 * @return the number of bytes parsed; 0 at the end of the
+	 * stream or on error (check Error::IsDefined())
+	 */
+	size_t ParseSome(InputStream &is, Error &error);
+
 	gcc_pure
 	static const char *GetAttribute(const XML_Char **atts,
 					const char *name);
@@ -154,6 +154,54 @@ IcuCollate(const char *a, const char *b)
 #endif
 }
 
+std::string
+IcuCollateKey(const char *src)
+{
+	assert(src != nullptr);
+
+#ifdef HAVE_ICU
+	assert(collator != nullptr);
+
+	const auto u = UCharFromUTF8(src);
+	if (u.IsNull())
+		return std::string(src);
+
+	uint8_t buffer[256];
+	int32_t length = ucol_getSortKey(collator, u.data, u.size,
+					 buffer, sizeof(buffer));
+	if (length <= 0) {
+		delete[] u.data;
+		return std::string(src);
+	}
+
+	/* the key does not include the trailing null byte */
+	--length;
+
+	if (size_t(length) < sizeof(buffer)) {
+		delete[] u.data;
+		return std::string((const char *)buffer, length);
+	}
+
+	uint8_t *key = new uint8_t[length + 1];
+	ucol_getSortKey(collator, u.data, u.size, key, length + 1);
+	delete[] u.data;
+
+	std::string result((const char *)key, length);
+	delete[] key;
+	return result;
+#elif defined(HAVE_GLIB)
+	char *tmp = g_utf8_collate_key(src, -1);
+	std::string result(tmp);
+	g_free(tmp);
+	return result;
+#else
+	/* same as strcasecmp() */
+	std::string result(src);
+	std::transform(result.begin(), result.end(), result.begin(), tolower);
+	return result;
+#endif
+}
+
 std::string
 IcuCaseFold(const char *src)
 {
@@ -55,6 +55,8 @@ NfsFileReader::Close()
 		return;
 	}
 
+	CancelRead();
+
 	connection->RemoveLease(*this);
 
 	if (state > State::MOUNT && state != State::IDLE)
@@ -112,20 +114,23 @@ NfsFileReader::Read(uint64_t offset, size_t size, Error &error)
 {
 	assert(state == State::IDLE);
 
-	if (!connection->Read(fh, offset, size, *this, error))
+	reads.emplace_back(*this, size);
+	if (!connection->Read(fh, offset, size, reads.back(), error)) {
+		reads.pop_back();
 		return false;
+	}
 
-	state = State::READ;
 	return true;
 }
 
 void
 NfsFileReader::CancelRead()
 {
-	if (state == State::READ) {
-		connection->Cancel(*this);
-		state = State::IDLE;
-	}
+	for (auto &i : reads)
+		if (!i.done)
+			connection->Cancel(i);
+
+	reads.clear();
 }
 
 void
@@ -197,11 +202,79 @@ NfsFileReader::StatCallback(const struct stat *st)
 
 	state = State::IDLE;
 
-	OnNfsFileOpen(st->st_size);
+	OnNfsFileOpen(st->st_size, st->st_mtime);
+}
+
+inline void
+NfsFileReader::ReadCallback(ReadRequest &request, unsigned nbytes,
+			    const void *data)
+{
+	assert(state == State::IDLE);
+	assert(!reads.empty());
+
+	if (&request != &reads.front()) {
+		/* an earlier response is still missing; keep a copy
+		   of this one until it arrives */
+		request.data = new uint8_t[nbytes];
+		memcpy(request.data, data, nbytes);
+		request.length = nbytes;
+		return;
+	}
+
+	const bool short_read = nbytes < request.size;
+	reads.pop_front();
+
+	if (short_read)
+		/* the following requests don't continue where this
+		   one ended */
+		CancelRead();
+
+	OnNfsFileRead(data, nbytes);
+	FlushReads();
 }
 
 void
-NfsFileReader::OnNfsCallback(unsigned status, void *data)
+NfsFileReader::FlushReads()
+{
+	while (!reads.empty() && reads.front().data != nullptr) {
+		ReadRequest &request = reads.front();
+		uint8_t *data = request.data;
+		request.data = nullptr;
+		const size_t nbytes = request.length;
+		const bool short_read = nbytes < request.size;
+		reads.pop_front();
+
+		if (short_read)
+			CancelRead();
+
+		OnNfsFileRead(data, nbytes);
+		delete[] data;
+	}
+}
+
+inline void
+NfsFileReader::ReadError(Error &&error)
+{
+	CancelRead();
+	OnNfsFileError(std::move(error));
+}
+
+void
+NfsFileReader::ReadRequest::OnNfsCallback(unsigned status, void *_data)
+{
+	done = true;
+	reader.ReadCallback(*this, status, _data);
+}
+
+void
+NfsFileReader::ReadRequest::OnNfsError(Error &&error)
+{
+	done = true;
+	reader.ReadError(std::move(error));
+}
+
+void
+NfsFileReader::OnNfsCallback(gcc_unused unsigned status, void *data)
 {
 	switch (state) {
 	case State::INITIAL:
@@ -218,11 +291,6 @@ NfsFileReader::OnNfsCallback(unsigned status, void *data)
 	case State::STAT:
 		StatCallback((const struct stat *)data);
 		break;
-
-	case State::READ:
-		state = State::IDLE;
-		OnNfsFileRead(data, status);
-		break;
 	}
 }
 
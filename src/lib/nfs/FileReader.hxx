@@ -26,6 +26,7 @@
 #include "event/DeferredMonitor.hxx"
 
 #include <string>
+#include <list>
 
 #include <stdint.h>
 #include <stddef.h>
@@ -34,6 +35,11 @@
 struct nfsfh;
 class NfsConnection;
 
+/**
+ * Reads a file from a NFS server.  Several read requests may be in
+ * flight at a time; their responses are passed to OnNfsFileRead() in
+ * the order of the requests.
+ */
 class NfsFileReader : NfsLease, NfsCallback, DeferredMonitor {
 	enum class State {
 		INITIAL,
@@ -41,12 +47,47 @@ class NfsFileReader : NfsLease, NfsCallback, DeferredMonitor {
 		MOUNT,
 		OPEN,
 		STAT,
-		READ,
 		IDLE,
 	};
 
 	State state;
 
+	class ReadRequest final : public NfsCallback {
+		NfsFileReader &reader;
+
+	public:
+		const size_t size;
+
+		/**
+		 * A copy of the response, if it has arrived before
+		 * the responses of earlier requests.
+		 */
+		uint8_t *data;
+		size_t length;
+
+		bool done;
+
+		ReadRequest(NfsFileReader &_reader, size_t _size)
+			:reader(_reader), size(_size),
+			 data(nullptr), done(false) {}
+
+		~ReadRequest() {
+			delete[] data;
+		}
+
+		ReadRequest(const ReadRequest &) = delete;
+		ReadRequest &operator=(const ReadRequest &) = delete;
+
+		/* virtual methods from NfsCallback */
+		void OnNfsCallback(unsigned status, void *data) override;
+		void OnNfsError(Error &&error) override;
+	};
+
+	/**
+	 * The read requests in flight, ordered by offset.
+	 */
+	std::list<ReadRequest> reads;
+
 	std::string server, export_name;
 	const char *path;
 
@@ -62,21 +103,50 @@ public:
 	void DeferClose();
 
 	bool Open(const char *uri, Error &error);
+
+	/**
+	 * Send a read request.  This may be called while earlier
+	 * requests are still in flight; the new one must follow them
+	 * in the file.
+	 */
 	bool Read(uint64_t offset, size_t size, Error &error);
+
+	/**
+	 * Cancel all read requests.
+	 */
 	void CancelRead();
 
 	bool IsIdle() const {
-		return state == State::IDLE;
+		return state == State::IDLE && reads.empty();
+	}
+
+	/**
+	 * Returns the number of read requests in flight.  If it is
+	 * zero, all data requested so far has been passed to
+	 * OnNfsFileRead(); a short read cancels all requests after
+	 * it.
+	 */
+	unsigned GetPendingReads() const {
+		return reads.size();
 	}
 
 protected:
-	virtual void OnNfsFileOpen(uint64_t size) = 0;
+	virtual void OnNfsFileOpen(uint64_t size, time_t mtime) = 0;
 	virtual void OnNfsFileRead(const void *data, size_t size) = 0;
 	virtual void OnNfsFileError(Error &&error) = 0;
 
 private:
 	void OpenCallback(nfsfh *_fh);
 	void StatCallback(const struct stat *st);
+	void ReadCallback(ReadRequest &request, unsigned nbytes,
+			  const void *data);
+	void ReadError(Error &&error);
+
+	/**
+	 * Pass consecutive responses which have been buffered to
+	 * OnNfsFileRead().
+	 */
+	void FlushReads();
 
 	/* virtual methods from NfsLease */
 	void OnNfsConnectionReady() final;
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SMBCLIENT_CONTEXT_HXX
+#define MPD_SMBCLIENT_CONTEXT_HXX
+
+#include "check.h"
+
+#include <libsmbclient.h>
+
+#include <utility>
+
+class Error;
+
+/**
+ * Wrapper for a libsmbclient context.  Each context has its own
+ * connections, and different contexts may be used by different
+ * threads concurrently; only creating and freeing a context needs
+ * #smbclient_mutex.  One context must not be used by more than one
+ * thread at a time.
+ */
+class SmbclientContext {
+	SMBCCTX *ctx;
+
+	explicit SmbclientContext(SMBCCTX *_ctx):ctx(_ctx) {}
+
+public:
+	SmbclientContext():ctx(nullptr) {}
+
+	SmbclientContext(SmbclientContext &&other):ctx(other.ctx) {
+		other.ctx = nullptr;
+	}
+
+	~SmbclientContext();
+
+	SmbclientContext &operator=(SmbclientContext &&other) {
+		std::swap(ctx, other.ctx);
+		return *this;
+	}
+
+	/**
+	 * Create and initialize a new context.  Check IsDefined() on
+	 * the result.
+	 */
+	static SmbclientContext New(Error &error);
+
+	bool IsDefined() const {
+		return ctx != nullptr;
+	}
+
+	SMBCFILE *Open(const char *fname, int flags, mode_t mode) {
+		return smbc_getFunctionOpen(ctx)(ctx, fname, flags, mode);
+	}
+
+	ssize_t Read(SMBCFILE *file, void *buf, size_t count) {
+		return smbc_getFunctionRead(ctx)(ctx, file, buf, count);
+	}
+
+	off_t Seek(SMBCFILE *file, off_t offset, int whence) {
+		return smbc_getFunctionLseek(ctx)(ctx, file, offset, whence);
+	}
+
+	int Stat(const char *fname, struct stat &st) {
+		return smbc_getFunctionStat(ctx)(ctx, fname, &st);
+	}
+
+	int Stat(SMBCFILE *file, struct stat &st) {
+		return smbc_getFunctionFstat(ctx)(ctx, file, &st);
+	}
+
+	void Close(SMBCFILE *file) {
+		smbc_getFunctionClose(ctx)(ctx, file);
+	}
+
+	SMBCFILE *OpenDirectory(const char *fname) {
+		return smbc_getFunctionOpendir(ctx)(ctx, fname);
+	}
+
+	struct smbc_dirent *ReadDirectory(SMBCFILE *dir) {
+		return smbc_getFunctionReaddir(ctx)(ctx, dir);
+	}
+
+#ifdef HAVE_SMBC_GETFUNCTIONREADDIRPLUS2
+	/**
+	 * Read the next directory entry together with its
+	 * attributes, which saves one Stat() round trip per entry.
+	 */
+	const struct libsmb_file_info *ReadDirectoryPlus(SMBCFILE *dir,
+							 struct stat &st) {
+		return smbc_getFunctionReaddirPlus2(ctx)(ctx, dir, &st);
+	}
+#endif
+
+	void CloseDirectory(SMBCFILE *dir) {
+		smbc_getFunctionClosedir(ctx)(ctx, dir);
+	}
+};
+
+#endif
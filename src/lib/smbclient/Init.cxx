@@ -27,12 +27,12 @@
 
 #include <string.h>
 
-static void
-mpd_smbc_get_auth_data(gcc_unused const char *srv,
-		       gcc_unused const char *shr,
-		       char *wg, gcc_unused int wglen,
-		       char *un, gcc_unused int unlen,
-		       char *pw, gcc_unused int pwlen)
+void
+SmbclientGetAuthData(gcc_unused const char *srv,
+		     gcc_unused const char *shr,
+		     char *wg, gcc_unused int wglen,
+		     char *un, gcc_unused int unlen,
+		     char *pw, gcc_unused int pwlen)
 {
 	// TODO: implement
 	strcpy(wg, "WORKGROUP");
@@ -45,8 +45,11 @@ SmbclientInit(Error &error)
 {
 	const ScopeLock protect(smbclient_mutex);
 
+	/* allow using different contexts in different threads */
+	smbc_thread_posix();
+
 	constexpr int debug = 0;
-	if (smbc_init(mpd_smbc_get_auth_data, debug) < 0) {
+	if (smbc_init(SmbclientGetAuthData, debug) < 0) {
 		error.SetErrno("smbc_init() failed");
 		return false;
 	}
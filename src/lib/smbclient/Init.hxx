@@ -24,6 +24,15 @@
 
 class Error;
 
+/**
+ * The authentication callback for libsmbclient.
+ */
+void
+SmbclientGetAuthData(const char *srv, const char *shr,
+		     char *wg, int wglen,
+		     char *un, int unlen,
+		     char *pw, int pwlen);
+
 /**
  * Initialize libsmbclient.
  */
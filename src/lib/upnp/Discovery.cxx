@@ -53,12 +53,12 @@ isMSDevice(const char *st)
 }
 
 static void
-AnnounceFoundUPnP(UPnPDiscoveryListener &listener, const UPnPDevice &device)
+CollectContentDirectories(std::vector<ContentDirectoryService> &dest,
+			  const UPnPDevice &device)
 {
 	for (const auto &service : device.services)
 		if (isCDService(service.serviceType.c_str()))
-			listener.FoundUPnP(ContentDirectoryService(device,
-								   service));
+			dest.emplace_back(device, service);
 }
 
 static void
@@ -73,36 +73,52 @@ AnnounceLostUPnP(UPnPDiscoveryListener &listener, const UPnPDevice &device)
 inline void
 UPnPDeviceDirectory::LockAdd(ContentDirectoryDescriptor &&d)
 {
-	const ScopeLock protect(mutex);
+	std::vector<ContentDirectoryService> found;
 
-	for (auto &i : directories) {
-		if (i.id == d.id) {
-			i = std::move(d);
-			return;
+	{
+		const ScopeLock protect(mutex);
+
+		for (auto &i : directories) {
+			if (i.id == d.id) {
+				i = std::move(d);
+				return;
+			}
 		}
-	}
 
-	directories.emplace_back(std::move(d));
+		directories.emplace_back(std::move(d));
 
-	if (listener != nullptr)
-		AnnounceFoundUPnP(*listener, directories.back().device);
+		if (listener == nullptr)
+			return;
+
+		CollectContentDirectories(found, directories.back().device);
+	}
+
+	/* invoke the listener without holding the lock, which would
+	   block lookups by the database plugin meanwhile */
+	for (const auto &i : found)
+		listener->FoundUPnP(i);
 }
 
 inline void
 UPnPDeviceDirectory::LockRemove(const std::string &id)
 {
-	const ScopeLock protect(mutex);
+	std::list<ContentDirectoryDescriptor> lost;
 
-	for (auto i = directories.begin(), end = directories.end();
-	     i != end; ++i) {
-		if (i->id == id) {
-			if (listener != nullptr)
-				AnnounceLostUPnP(*listener, i->device);
+	{
+		const ScopeLock protect(mutex);
 
-			directories.erase(i);
-			break;
+		for (auto i = directories.begin(), end = directories.end();
+		     i != end; ++i) {
+			if (i->id == id) {
+				lost.splice(lost.end(), directories, i);
+				break;
+			}
 		}
 	}
+
+	if (listener != nullptr)
+		for (const auto &i : lost)
+			AnnounceLostUPnP(*listener, i.device);
 }
 
 inline void
@@ -211,20 +227,25 @@ UPnPDeviceDirectory::Invoke(Upnp_EventType et, void *evp)
 bool
 UPnPDeviceDirectory::expireDevices(Error &error)
 {
-	const ScopeLock protect(mutex);
 	const unsigned now = MonotonicClockS();
 	bool didsomething = false;
 
-	for (auto it = directories.begin();
-	     it != directories.end();) {
-		if (now > it->expires) {
-			it = directories.erase(it);
-			didsomething = true;
-		} else {
-			it++;
+	{
+		const ScopeLock protect(mutex);
+
+		for (auto it = directories.begin();
+		     it != directories.end();) {
+			if (now > it->expires) {
+				it = directories.erase(it);
+				didsomething = true;
+			} else {
+				it++;
+			}
 		}
 	}
 
+	/* search() sends network packets; don't hold the lock
+	   meanwhile */
 	if (didsomething)
 		return search(error);
 
@@ -260,9 +281,13 @@ bool
 UPnPDeviceDirectory::search(Error &error)
 {
 	const unsigned now = MonotonicClockS();
-	if (now - m_lastSearch < 10)
-		return true;
-	m_lastSearch = now;
+
+	{
+		const ScopeLock protect(mutex);
+		if (now - m_lastSearch < 10)
+			return true;
+		m_lastSearch = now;
+	}
 
 	// We search both for device and service just in case.
 	int code = UpnpSearchAsync(handle, m_searchTimeout,
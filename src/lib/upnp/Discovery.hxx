@@ -107,6 +107,7 @@ class UPnPDeviceDirectory final : UpnpCallback {
 
 	/**
 	 * The MonotonicClockS() time stamp of the last search.
+	 * Protected by #mutex.
 	 */
 	unsigned m_lastSearch;
 
@@ -21,7 +21,7 @@
 #include "output/MultipleOutputs.hxx"
 #include "MixerControl.hxx"
 #include "MixerInternal.hxx"
-#include "MixerList.hxx"
+#include "plugins/SoftwareMixerPlugin.hxx"
 #include "output/Internal.hxx"
 #include "pcm/Volume.hxx"
 #include "util/Error.hxx"
@@ -114,7 +114,7 @@ output_mixer_get_software_volume(const AudioOutput &ao)
 		return -1;
 
 	Mixer *mixer = ao.mixer;
-	if (mixer == nullptr || !mixer->IsPlugin(software_mixer_plugin))
+	if (!software_mixer_is_software(mixer))
 		return -1;
 
 	return mixer_get_volume(mixer, IgnoreError());
@@ -148,8 +148,7 @@ MultipleOutputs::SetSoftwareVolume(unsigned volume)
 	for (auto ao : outputs) {
 		const auto mixer = ao->mixer;
 
-		if (mixer != nullptr &&
-		    &mixer->plugin == &software_mixer_plugin)
+		if (software_mixer_is_software(mixer))
 			mixer_set_volume(mixer, volume, IgnoreError());
 	}
 }
@@ -28,6 +28,7 @@
 struct MixerPlugin;
 
 extern const MixerPlugin software_mixer_plugin;
+extern const MixerPlugin global_software_mixer_plugin;
 extern const MixerPlugin alsa_mixer_plugin;
 extern const MixerPlugin oss_mixer_plugin;
 extern const MixerPlugin roar_mixer_plugin;
@@ -34,6 +34,8 @@ mixer_type_parse(const char *input)
 		return MIXER_TYPE_HARDWARE;
 	else if (strcmp(input, "software") == 0)
 		return MIXER_TYPE_SOFTWARE;
+	else if (strcmp(input, "global") == 0)
+		return MIXER_TYPE_GLOBAL;
 	else
 		return MIXER_TYPE_UNKNOWN;
 }
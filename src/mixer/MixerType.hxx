@@ -32,6 +32,12 @@ enum mixer_type {
 
 	/** hardware mixer (output's plugin) */
 	MIXER_TYPE_HARDWARE,
+
+	/**
+	 * software mixer with one volume for all outputs of this
+	 * type, applied together with replay gain
+	 */
+	MIXER_TYPE_GLOBAL,
 };
 
 /**
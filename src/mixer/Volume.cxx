@@ -38,6 +38,8 @@ static unsigned volume_software_set = 100;
 
 /** the cached hardware mixer value; invalid if negative */
 static int last_hardware_volume = -1;
+/** the #MultipleOutputs instance #last_hardware_volume belongs to */
+static const MultipleOutputs *last_hardware_volume_outputs;
 /** the age of #last_hardware_volume */
 static PeriodClock hardware_volume_clock;
 
@@ -52,10 +54,12 @@ int
 volume_level_get(const MultipleOutputs &outputs)
 {
 	if (last_hardware_volume >= 0 &&
+	    last_hardware_volume_outputs == &outputs &&
 	    !hardware_volume_clock.CheckUpdate(1000))
 		/* throttle access to hardware mixers */
 		return last_hardware_volume;
 
+	last_hardware_volume_outputs = &outputs;
 	last_hardware_volume = outputs.GetVolume();
 	return last_hardware_volume;
 }
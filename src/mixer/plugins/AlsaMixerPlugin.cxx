@@ -73,6 +73,13 @@ class AlsaMixer final : public Mixer {
 	long volume_max;
 	int volume_set;
 
+	/**
+	 * The current volume, updated by Setup(), SetVolume() and the
+	 * element callback.  GetVolume() returns it without asking
+	 * the kernel.  Negative if unknown.
+	 */
+	int volume_cached;
+
 	AlsaMixerMonitor *monitor;
 
 public:
@@ -85,6 +92,17 @@ public:
 	void Configure(const config_param &param);
 	bool Setup(Error &error);
 
+	/**
+	 * Read the volume from libasound's copy of the element, which
+	 * snd_mixer_handle_events() keeps up to date, and store it in
+	 * #volume_cached.
+	 */
+	bool UpdateVolume(Error &error);
+
+	int GetCachedVolume() const {
+		return volume_cached;
+	}
+
 	/* virtual methods from class Mixer */
 	virtual bool Open(Error &error) override;
 	virtual void Close() override;
@@ -149,8 +167,12 @@ alsa_mixer_elem_callback(snd_mixer_elem_t *elem, unsigned mask)
 		snd_mixer_elem_get_callback_private(elem);
 
 	if (mask & SND_CTL_EVENT_MASK_VALUE) {
-		int volume = mixer.GetVolume(IgnoreError());
-		mixer.listener.OnMixerVolumeChanged(mixer, volume);
+		Error error;
+		if (!mixer.UpdateVolume(error))
+			LogError(error);
+
+		mixer.listener.OnMixerVolumeChanged(mixer,
+						    mixer.GetCachedVolume());
 	}
 
 	return 0;
@@ -243,6 +265,9 @@ AlsaMixer::Setup(Error &error)
 	snd_mixer_selem_get_playback_volume_range(elem, &volume_min,
 						  &volume_max);
 
+	if (!UpdateVolume(error))
+		return false;
+
 	snd_mixer_elem_set_callback_private(elem, this);
 	snd_mixer_elem_set_callback(elem, alsa_mixer_elem_callback);
 
@@ -257,6 +282,7 @@ AlsaMixer::Open(Error &error)
 	int err;
 
 	volume_set = -1;
+	volume_cached = -1;
 
 	err = snd_mixer_open(&handle, 0);
 	if (err < 0) {
@@ -284,8 +310,8 @@ AlsaMixer::Close()
 	snd_mixer_close(handle);
 }
 
-inline int
-AlsaMixer::GetVolume(Error &error)
+bool
+AlsaMixer::UpdateVolume(Error &error)
 {
 	int err;
 	int ret;
@@ -293,14 +319,6 @@ AlsaMixer::GetVolume(Error &error)
 
 	assert(handle != nullptr);
 
-	err = snd_mixer_handle_events(handle);
-	if (err < 0) {
-		error.Format(alsa_mixer_domain, err,
-			     "snd_mixer_handle_events() failed: %s",
-			     snd_strerror(err));
-		return false;
-	}
-
 	err = snd_mixer_selem_get_playback_volume(elem,
 						  SND_MIXER_SCHN_FRONT_LEFT,
 						  &level);
@@ -320,7 +338,18 @@ AlsaMixer::GetVolume(Error &error)
 				   (volume_max - volume_min)) + 0.5);
 	}
 
-	return ret;
+	volume_cached = ret;
+	return true;
+}
+
+inline int
+AlsaMixer::GetVolume(gcc_unused Error &error)
+{
+	assert(handle != nullptr);
+
+	/* changes by other programs arrive through
+	   AlsaMixerMonitor and alsa_mixer_elem_callback() */
+	return volume_cached;
 }
 
 inline bool
@@ -348,6 +377,7 @@ AlsaMixer::SetVolume(unsigned volume, Error &error)
 		return false;
 	}
 
+	volume_cached = volume_set;
 	return true;
 }
 
@@ -71,6 +71,12 @@ public:
 
 	Filter *GetFilter();
 
+	const Filter *PeekFilter() const {
+		assert(owns_filter);
+
+		return filter;
+	}
+
 	/* virtual methods from class Mixer */
 	virtual bool Open(gcc_unused Error &error) override {
 		return true;
@@ -126,6 +132,70 @@ const MixerPlugin software_mixer_plugin = {
 	true,
 };
 
+/**
+ * The volume of all #GlobalSoftwareMixer instances.  This filter is
+ * never opened; it only holds the level for the replay gain filters
+ * which apply it, see replay_gain_filter_set_volume_filter().
+ */
+static Filter *global_volume_filter;
+
+/**
+ * The global volume in percent (0..100).
+ */
+static unsigned global_volume = 100;
+
+/**
+ * A software mixer which shares its volume with all other instances.
+ * Since all outputs using it produce the same data from a chunk,
+ * they can share their filter stage (see #SharedFilter), and the
+ * volume is applied once, not once per output.
+ */
+class GlobalSoftwareMixer final : public Mixer {
+public:
+	GlobalSoftwareMixer(MixerListener &_listener)
+		:Mixer(global_software_mixer_plugin, _listener) {
+		if (global_volume_filter == nullptr)
+			global_volume_filter = CreateVolumeFilter();
+	}
+
+	/* virtual methods from class Mixer */
+	virtual bool Open(gcc_unused Error &error) override {
+		return true;
+	}
+
+	virtual void Close() override {
+	}
+
+	virtual int GetVolume(gcc_unused Error &error) override {
+		return global_volume;
+	}
+
+	virtual bool SetVolume(unsigned new_volume,
+			       gcc_unused Error &error) override {
+		assert(new_volume <= 100);
+
+		global_volume = new_volume;
+		volume_filter_set(global_volume_filter,
+				  PercentVolumeToSoftwareVolume(new_volume));
+		return true;
+	}
+};
+
+static Mixer *
+global_software_mixer_init(gcc_unused EventLoop &event_loop,
+			   gcc_unused AudioOutput &ao,
+			   MixerListener &listener,
+			   gcc_unused const config_param &param,
+			   gcc_unused Error &error)
+{
+	return new GlobalSoftwareMixer(listener);
+}
+
+const MixerPlugin global_software_mixer_plugin = {
+	global_software_mixer_init,
+	true,
+};
+
 inline Filter *
 SoftwareMixer::GetFilter()
 {
@@ -142,3 +212,24 @@ software_mixer_get_filter(Mixer *mixer)
 	assert(sm->IsPlugin(software_mixer_plugin));
 	return sm->GetFilter();
 }
+
+const Filter *
+software_mixer_peek_filter(const Mixer *mixer)
+{
+	if (mixer->IsPlugin(global_software_mixer_plugin)) {
+		assert(global_volume_filter != nullptr);
+		return global_volume_filter;
+	}
+
+	const SoftwareMixer *sm = (const SoftwareMixer *)mixer;
+	assert(sm->IsPlugin(software_mixer_plugin));
+	return sm->PeekFilter();
+}
+
+bool
+software_mixer_is_software(const Mixer *mixer)
+{
+	return mixer != nullptr &&
+		(mixer->IsPlugin(software_mixer_plugin) ||
+		 mixer->IsPlugin(global_software_mixer_plugin));
+}
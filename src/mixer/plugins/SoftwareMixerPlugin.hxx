@@ -20,6 +20,8 @@
 #ifndef MPD_SOFTWARE_MIXER_PLUGIN_HXX
 #define MPD_SOFTWARE_MIXER_PLUGIN_HXX
 
+#include "Compiler.h"
+
 class Mixer;
 class Filter;
 
@@ -30,4 +32,24 @@ class Filter;
 Filter *
 software_mixer_get_filter(Mixer *mixer);
 
+/**
+ * Returns the (volume) filter associated with this mixer, without
+ * transferring ownership.  This is for users which do not install
+ * the filter, but apply its volume elsewhere, see
+ * replay_gain_filter_set_volume_filter().
+ *
+ * For #global_software_mixer_plugin, this is the one filter shared
+ * by all of its instances.
+ */
+const Filter *
+software_mixer_peek_filter(const Mixer *mixer);
+
+/**
+ * Is this a #software_mixer_plugin or #global_software_mixer_plugin
+ * instance?
+ */
+gcc_pure
+bool
+software_mixer_is_software(const Mixer *mixer);
+
 #endif
@@ -20,8 +20,8 @@
 #include "config.h"
 #include "SmbclientNeighborPlugin.hxx"
 #include "lib/smbclient/Init.hxx"
+#include "lib/smbclient/Context.hxx"
 #include "lib/smbclient/Domain.hxx"
-#include "lib/smbclient/Mutex.hxx"
 #include "neighbor/NeighborPlugin.hxx"
 #include "neighbor/Explorer.hxx"
 #include "neighbor/Listener.hxx"
@@ -64,9 +64,20 @@ class SmbclientNeighborExplorer final : public NeighborExplorer {
 
 	Thread thread;
 
+	/**
+	 * A private libsmbclient context for this thread.  Discovery
+	 * may take several seconds, and holding the global
+	 * #smbclient_mutex for that long would stall SMB playback.
+	 */
+	SmbclientContext ctx;
+
 	mutable Mutex mutex;
 	Cond cond;
 
+	/**
+	 * The result of the last scan.  GetList() returns a copy of
+	 * it and never waits for a scan.
+	 */
 	List list;
 
 	bool quit;
@@ -89,6 +100,10 @@ private:
 bool
 SmbclientNeighborExplorer::Open(Error &error)
 {
+	ctx = SmbclientContext::New(error);
+	if (!ctx.IsDefined())
+		return false;
+
 	quit = false;
 	return thread.Start(ThreadFunc, this, error);
 }
@@ -102,17 +117,14 @@ SmbclientNeighborExplorer::Close()
 	mutex.unlock();
 
 	thread.Join();
+
+	ctx = SmbclientContext();
 }
 
 NeighborExplorer::List
 SmbclientNeighborExplorer::GetList() const
 {
 	const ScopeLock protect(mutex);
-	/*
-	List list;
-	for (const auto &i : servers)
-		list.emplace_front(i.Export());
-	*/
 	return list;
 }
 
@@ -126,21 +138,24 @@ ReadServer(NeighborExplorer::List &list, const smbc_dirent &e)
 }
 
 static void
-ReadServers(NeighborExplorer::List &list, const char *uri);
+ReadServers(SmbclientContext &ctx, NeighborExplorer::List &list,
+	    const char *uri);
 
 static void
-ReadWorkgroup(NeighborExplorer::List &list, const std::string &name)
+ReadWorkgroup(SmbclientContext &ctx, NeighborExplorer::List &list,
+	      const std::string &name)
 {
 	std::string uri = "smb://" + name;
-	ReadServers(list, uri.c_str());
+	ReadServers(ctx, list, uri.c_str());
 }
 
 static void
-ReadEntry(NeighborExplorer::List &list, const smbc_dirent &e)
+ReadEntry(SmbclientContext &ctx, NeighborExplorer::List &list,
+	  const smbc_dirent &e)
 {
 	switch (e.smbc_type) {
 	case SMBC_WORKGROUP:
-		ReadWorkgroup(list, std::string(e.name, e.namelen));
+		ReadWorkgroup(ctx, list, std::string(e.name, e.namelen));
 		break;
 
 	case SMBC_SERVER:
@@ -150,34 +165,32 @@ ReadEntry(NeighborExplorer::List &list, const smbc_dirent &e)
 }
 
 static void
-ReadServers(NeighborExplorer::List &list, int fd)
+ReadServers(SmbclientContext &ctx, NeighborExplorer::List &list,
+	    SMBCFILE *dir)
 {
 	smbc_dirent *e;
-	while ((e = smbc_readdir(fd)) != nullptr)
-		ReadEntry(list, *e);
-
-	smbc_closedir(fd);
+	while ((e = ctx.ReadDirectory(dir)) != nullptr)
+		ReadEntry(ctx, list, *e);
 }
 
 static void
-ReadServers(NeighborExplorer::List &list, const char *uri)
+ReadServers(SmbclientContext &ctx, NeighborExplorer::List &list,
+	    const char *uri)
 {
-	int fd = smbc_opendir(uri);
-	if (fd >= 0) {
-		ReadServers(list, fd);
-		smbc_closedir(fd);
+	SMBCFILE *dir = ctx.OpenDirectory(uri);
+	if (dir != nullptr) {
+		ReadServers(ctx, list, dir);
+		ctx.CloseDirectory(dir);
 	} else
 		FormatErrno(smbclient_domain, "smbc_opendir('%s') failed",
 			    uri);
 }
 
-gcc_pure
 static NeighborExplorer::List
-DetectServers()
+DetectServers(SmbclientContext &ctx)
 {
 	NeighborExplorer::List list;
-	const ScopeLock protect(smbclient_mutex);
-	ReadServers(list, "smb://");
+	ReadServers(ctx, list, "smb://");
 	return list;
 }
 
@@ -197,7 +210,9 @@ FindBeforeServerByURI(NeighborExplorer::List::const_iterator prev,
 inline void
 SmbclientNeighborExplorer::Run()
 {
-	List found = DetectServers(), lost;
+	/* scan without holding our mutex, so GetList() is never
+	   blocked by the network */
+	List found = DetectServers(ctx), lost;
 
 	mutex.lock();
 
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "ClockSync.hxx"
+
+#include <algorithm>
+
+#include <math.h>
+
+/**
+ * The weight of a new measurement in the low-pass filter.  The
+ * latency reported by most devices has a granularity of one period,
+ * and this smoothes it out over about 50 play() calls.
+ */
+static constexpr double SMOOTHING = 0.02;
+
+/**
+ * The time [s] in which a deviation shall be compensated.  Longer
+ * times make the rate changes less audible, but increase the
+ * residual deviation caused by a constant clock drift.  With a
+ * drift of 100 ppm, it is 1 ms.
+ */
+static constexpr double RESPONSE_TIME = 10;
+
+/**
+ * The maximum rate correction.  This is much larger than the drift
+ * of any sound card, but small enough to be inaudible.
+ */
+static constexpr double MAX_CORRECTION = 0.001;
+
+/**
+ * A larger deviation [s] is not drift, but a discontinuity (e.g. a
+ * buffer underrun); start over with a new reference point.
+ */
+static constexpr double MAX_ERROR = 0.5;
+
+double
+ClockSync::Update(double duration, double latency, uint64_t now_us)
+{
+	submitted += duration;
+
+	const double now = now_us / 1000000.;
+	const double presented = submitted - latency;
+
+	if (!anchored) {
+		/* wait until the device has actually started
+		   playing */
+		if (presented > 0.001) {
+			anchor = now - presented;
+			anchored = true;
+		}
+
+		return ratio;
+	}
+
+	const double deviation = presented - (now - anchor);
+	if (fabs(deviation) > MAX_ERROR) {
+		anchor = now - presented;
+		error = 0;
+		ratio = 1;
+		return ratio;
+	}
+
+	error += (deviation - error) * SMOOTHING;
+	ratio = 1 + std::max(std::min(error / RESPONSE_TIME,
+				      MAX_CORRECTION),
+			     -MAX_CORRECTION);
+	return ratio;
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_OUTPUT_CLOCK_SYNC_HXX
+#define MPD_OUTPUT_CLOCK_SYNC_HXX
+
+#include <stdint.h>
+
+/**
+ * Locks the playback rate of an audio output to the system's
+ * monotonic clock.  It compares the amount of content which has
+ * been presented by the device with the time which has passed, and
+ * calculates a resampling ratio which compensates the difference
+ * between the sound card's clock and the system clock.
+ *
+ * If the system clocks of several machines are synchronized (e.g. by
+ * NTP), several MPD instances playing the same (timer-paced) "httpd"
+ * stream do not drift apart.
+ */
+class ClockSync {
+	/**
+	 * Has the reference point been established?
+	 */
+	bool anchored;
+
+	/**
+	 * The monotonic clock time [s] which corresponds to the
+	 * content position zero.
+	 */
+	double anchor;
+
+	/**
+	 * The duration of the content [s] which has been submitted
+	 * to the device since Reset().
+	 */
+	double submitted;
+
+	/**
+	 * The low-pass filtered deviation [s] of the presented
+	 * content from the system clock.
+	 */
+	double error;
+
+	double ratio;
+
+public:
+	ClockSync() {
+		Reset();
+	}
+
+	/**
+	 * Forget the reference point, e.g. after the device has
+	 * been opened, paused or cleared.
+	 */
+	void Reset() {
+		anchored = false;
+		submitted = 0;
+		error = 0;
+		ratio = 1;
+	}
+
+	/**
+	 * Returns the current resampling ratio; above 1.0 means the
+	 * device runs too fast, and playback must be slowed down.
+	 */
+	double GetRatio() const {
+		return ratio;
+	}
+
+	/**
+	 * Account for new content which has been submitted to the
+	 * device, and recalculate the ratio.
+	 *
+	 * @param duration the duration of the content [s]
+	 * @param latency the device's latency after submitting it [s]
+	 * @param now_us the current monotonic clock time [us]
+	 * @return the new ratio
+	 */
+	double Update(double duration, double latency, uint64_t now_us);
+};
+
+#endif
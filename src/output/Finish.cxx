@@ -31,6 +31,9 @@ AudioOutput::~AudioOutput()
 	assert(!fail_timer.IsDefined());
 	assert(!thread.IsDefined());
 
+	if (stats.is_linked())
+		pipeline_stats_remove_output(stats);
+
 	if (mixer != nullptr)
 		mixer_free(mixer);
 
@@ -48,6 +48,7 @@
 
 AudioOutput::AudioOutput(const AudioOutputPlugin &_plugin)
 	:plugin(_plugin),
+	 rate_adjust_open(false),
 	 enabled(true), really_enabled(false),
 	 open(false),
 	 pause(false),
@@ -57,12 +58,19 @@ AudioOutput::AudioOutput(const AudioOutputPlugin &_plugin)
 	 filter(nullptr),
 	 replay_gain_filter(nullptr),
 	 other_replay_gain_filter(nullptr),
-	 command(AO_COMMAND_NONE)
+	 shared_filter(nullptr), shared_filter_joined(false),
+	 command(AO_COMMAND_NONE),
+	 mutex("AudioOutput"), cond("AudioOutput::cond"),
+	 consumed_serial(~uint64_t(0)),
+	 elapsed_time(-1)
 {
 	assert(plugin.finish != nullptr);
 	assert(plugin.open != nullptr);
 	assert(plugin.close != nullptr);
 	assert(plugin.play != nullptr);
+
+	pending_level.Clear(0);
+	level.Clear(0);
 }
 
 static const AudioOutputPlugin *
@@ -111,6 +119,23 @@ audio_output_mixer_type(const config_param &param)
 						  "hardware"));
 }
 
+/**
+ * Can the software volume be applied by the replay gain filter
+ * (see replay_gain_filter_set_volume_filter())?  This requires that
+ * no other (possibly non-linear) filter runs in between.
+ */
+gcc_pure
+static bool
+audio_output_can_fuse_volume(const AudioOutput &ao,
+			     const config_param &param)
+{
+	return ao.replay_gain_filter != nullptr &&
+		strcmp(param.GetBlockValue("replay_gain_handler", "software"),
+		       "software") == 0 &&
+		*param.GetBlockValue(AUDIO_FILTERS, "") == 0 &&
+		!config_get_bool(CONF_VOLUME_NORMALIZATION, false);
+}
+
 static Mixer *
 audio_output_load_mixer(EventLoop &event_loop, AudioOutput &ao,
 			const config_param &param,
@@ -140,8 +165,43 @@ audio_output_load_mixer(EventLoop &event_loop, AudioOutput &ao,
 				  IgnoreError());
 		assert(mixer != nullptr);
 
-		filter_chain_append(filter_chain, "software_mixer",
-				    software_mixer_get_filter(mixer));
+		if (audio_output_can_fuse_volume(ao, param)) {
+			/* apply the software volume together with
+			   replay gain, in one pass */
+			const Filter *volume_filter =
+				software_mixer_peek_filter(mixer);
+			replay_gain_filter_set_volume_filter(ao.replay_gain_filter,
+							     volume_filter);
+			replay_gain_filter_set_volume_filter(ao.other_replay_gain_filter,
+							     volume_filter);
+		} else
+			filter_chain_append(filter_chain, "software_mixer",
+					    software_mixer_get_filter(mixer));
+		return mixer;
+
+	case MIXER_TYPE_GLOBAL:
+		if (ao.replay_gain_filter == nullptr ||
+		    strcmp(param.GetBlockValue("replay_gain_handler",
+					       "software"),
+			   "software") != 0) {
+			error.Set(config_domain,
+				  "mixer_type \"global\" requires "
+				  "replay_gain_handler \"software\"");
+			return nullptr;
+		}
+
+		mixer = mixer_new(event_loop, global_software_mixer_plugin,
+				  ao, listener,
+				  config_param(),
+				  IgnoreError());
+		assert(mixer != nullptr);
+
+		/* the global volume is always applied by the replay
+		   gain filter, i.e. before all other filters */
+		replay_gain_filter_set_volume_filter(ao.replay_gain_filter,
+						     software_mixer_peek_filter(mixer));
+		replay_gain_filter_set_volume_filter(ao.other_replay_gain_filter,
+						     software_mixer_peek_filter(mixer));
 		return mixer;
 	}
 
@@ -177,11 +237,29 @@ AudioOutput::Configure(const config_param &param, Error &error)
 
 	tags = param.GetBlockValue("tags", true);
 	always_on = param.GetBlockValue("always_on", false);
+	clock_sync = param.GetBlockValue("clock_sync", false);
 	enabled = param.GetBlockValue("enabled", true);
 
+	if (!scheduling.Configure(param, error))
+		return false;
+
 	/* set up the filter chain */
 
-	filter = filter_chain_new();
+	filter = audio_output_filter_chain_new(param.GetBlockValue(AUDIO_FILTERS,
+								   ""),
+					       name);
+
+	pipeline_stats_add_output(stats, name);
+
+	/* done */
+
+	return true;
+}
+
+Filter *
+audio_output_filter_chain_new(const char *filters, const char *name)
+{
+	Filter *filter = filter_chain_new();
 	assert(filter != nullptr);
 
 	/* create the normalization filter (if configured) */
@@ -197,9 +275,7 @@ AudioOutput::Configure(const config_param &param, Error &error)
 	}
 
 	Error filter_error;
-	filter_chain_parse(*filter,
-			   param.GetBlockValue(AUDIO_FILTERS, ""),
-			   filter_error);
+	filter_chain_parse(*filter, filters, filter_error);
 
 	// It's not really fatal - Part of the filter chain has been set up already
 	// and even an empty one will work (if only with unexpected behaviour)
@@ -208,9 +284,7 @@ AudioOutput::Configure(const config_param &param, Error &error)
 			    "Failed to initialize filter chain for '%s'",
 			    name);
 
-	/* done */
-
-	return true;
+	return filter;
 }
 
 static bool
@@ -274,9 +348,9 @@ audio_output_setup(EventLoop &event_loop, AudioOutput &ao,
 
 	/* the "convert" filter must be the last one in the chain */
 
-	ao.convert_filter = filter_new(&convert_filter_plugin, config_param(),
-					IgnoreError());
-	assert(ao.convert_filter != nullptr);
+	ao.convert_filter = filter_new(&convert_filter_plugin, param, error);
+	if (ao.convert_filter == nullptr)
+		return false;
 
 	filter_chain_append(*ao.filter, "convert", ao.convert_filter);
 
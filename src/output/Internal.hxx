@@ -23,11 +23,20 @@
 #include "AudioFormat.hxx"
 #include "pcm/PcmBuffer.hxx"
 #include "pcm/PcmDither.hxx"
+#include "pcm/PcmLevel.hxx"
+#include "pcm/PcmRateAdjust.hxx"
+#include "ClockSync.hxx"
 #include "ReplayGainInfo.hxx"
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
 #include "thread/Thread.hxx"
+#include "thread/Scheduling.hxx"
 #include "system/PeriodClock.hxx"
+#include "PipelineStats.hxx"
+
+#include <atomic>
+
+#include <stdint.h>
 
 class Error;
 class Filter;
@@ -35,7 +44,9 @@ class MusicPipe;
 class EventLoop;
 class Mixer;
 class MixerListener;
+template<typename T> struct ConstBuffer;
 struct MusicChunk;
+struct SharedFilter;
 struct config_param;
 struct PlayerControl;
 struct AudioOutputPlugin;
@@ -96,6 +107,18 @@ struct AudioOutput {
 	 */
 	bool always_on;
 
+	/**
+	 * Shall the playback rate be locked to the system clock
+	 * (configuration option "clock_sync")?
+	 */
+	bool clock_sync;
+
+	/**
+	 * Is #rate_adjust open?  This is false if #clock_sync is
+	 * disabled or if the audio format cannot be resampled.
+	 */
+	bool rate_adjust_open;
+
 	/**
 	 * Has the user enabled this device?
 	 */
@@ -183,6 +206,12 @@ struct AudioOutput {
 	 */
 	PcmDither cross_fade_dither;
 
+	/**
+	 * The levels of the chunks played since #level was last
+	 * published.  Only used by the output thread.
+	 */
+	PcmLevel pending_level;
+
 	/**
 	 * The filter object of this audio output.  This is an
 	 * instance of chain_filter_plugin.
@@ -222,12 +251,32 @@ struct AudioOutput {
 	 */
 	Filter *convert_filter;
 
+	/**
+	 * The #SharedFilter of the group this output belongs to, or
+	 * nullptr if its filter configuration is unique.  Owned by
+	 * #MultipleOutputs.
+	 */
+	SharedFilter *shared_filter;
+
+	/**
+	 * Has this output joined #shared_filter?  If yes, the filters
+	 * above are not used for playback.
+	 */
+	bool shared_filter_joined;
+
 	/**
 	 * The thread handle, or nullptr if the output thread isn't
 	 * running.
 	 */
 	Thread thread;
 
+	/**
+	 * The configured scheduling settings of the output thread.
+	 * Without a "scheduling_policy", the thread runs at
+	 * "real-time" priority.
+	 */
+	ThreadScheduling scheduling;
+
 	/**
 	 * The next command to be performed by the output thread.
 	 */
@@ -239,8 +288,8 @@ struct AudioOutput {
 	const MusicPipe *pipe;
 
 	/**
-	 * This mutex protects #open, #fail_timer, #current_chunk and
-	 * #current_chunk_finished.
+	 * This mutex protects #open, #fail_timer, #current_chunk,
+	 * #current_chunk_finished, #level and #elapsed_time.
 	 */
 	Mutex mutex;
 
@@ -269,6 +318,46 @@ struct AudioOutput {
 	 */
 	bool current_chunk_finished;
 
+	/**
+	 * All chunks with a MusicChunk::output_serial lower than this
+	 * value have been consumed by this output and may be returned
+	 * to the #MusicBuffer.  It is ~0 while the output is closed
+	 * and 0 after the output has lost its position in the pipe.
+	 *
+	 * Written by the output thread, read by
+	 * MultipleOutputs::Check() without locking #mutex.
+	 */
+	std::atomic<uint64_t> consumed_serial;
+
+	/**
+	 * The peak and RMS levels of the last 100 ms played by this
+	 * output.  It is empty while the device is closed.
+	 */
+	PcmLevel level;
+
+	/**
+	 * Latency and underrun telemetry, registered with
+	 * pipeline_stats_add_output() by Configure().
+	 */
+	OutputStats stats;
+
+	/**
+	 * Implements #clock_sync: resamples the filtered data by the
+	 * ratio calculated by #clock.
+	 */
+	PcmRateAdjust rate_adjust;
+
+	ClockSync clock;
+
+	/**
+	 * The stream position (in seconds) which is currently being
+	 * presented by the device, i.e. the end of the data submitted
+	 * to the plugin minus its reported latency.  It is negative if
+	 * unknown, or if the plugin does not implement the "latency"
+	 * method.
+	 */
+	float elapsed_time;
+
 	AudioOutput(const AudioOutputPlugin &_plugin);
 	~AudioOutput();
 
@@ -386,6 +475,21 @@ private:
 	void CloseFilter();
 	void ReopenFilter();
 
+	/**
+	 * Attempt to join #shared_filter after the device has been
+	 * opened.  On failure, this output continues to use its own
+	 * filters.
+	 */
+	void JoinSharedFilter();
+	void LeaveSharedFilter();
+
+	/**
+	 * Open #rate_adjust for #out_audio_format if #clock_sync is
+	 * enabled.  On failure, the clock is not synchronized.
+	 */
+	void OpenRateAdjust();
+	void CloseRateAdjust();
+
 	/**
 	 * Wait until the output's delay reaches zero.
 	 *
@@ -399,6 +503,28 @@ private:
 
 	bool PlayChunk(const MusicChunk *chunk);
 
+	/**
+	 * Add the specified (filtered) data to #pending_level, and
+	 * publish it as #level every 100 ms.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void UpdateLevel(ConstBuffer<void> data);
+
+	/**
+	 * Update #elapsed_time after a play() call.
+	 *
+	 * Caller must lock the mutex.
+	 *
+	 * @param played the number of bytes of the filtered chunk
+	 * which have been submitted so far
+	 * @param total the size of the filtered chunk
+	 * @param latency the plugin's latency in frames
+	 */
+	void UpdateElapsedTime(const MusicChunk *chunk,
+			       size_t played, size_t total,
+			       unsigned latency);
+
 	/**
 	 * Plays all remaining chunks, until the tail of the pipe has
 	 * been reached (and no more chunks are queued), or until a
@@ -433,4 +559,16 @@ audio_output_new(EventLoop &event_loop, const config_param &param,
 void
 audio_output_free(AudioOutput *ao);
 
+/**
+ * Create the filter chain of an audio output: the normalization
+ * filter (if configured) followed by the filters specified in the
+ * "filters" setting.  The caller is responsible for appending the
+ * "convert" filter.
+ *
+ * @param filters the value of the "filters" setting
+ * @param name the name of the audio output, for error messages
+ */
+Filter *
+audio_output_filter_chain_new(const char *filters, const char *name);
+
 #endif
@@ -21,6 +21,7 @@
 #include "MultipleOutputs.hxx"
 #include "PlayerControl.hxx"
 #include "Internal.hxx"
+#include "SharedFilter.hxx"
 #include "Domain.hxx"
 #include "MusicBuffer.hxx"
 #include "MusicPipe.hxx"
@@ -30,7 +31,13 @@
 #include "config/ConfigData.hxx"
 #include "config/ConfigGlobal.hxx"
 #include "config/ConfigOption.hxx"
+#include "mixer/MixerInternal.hxx"
+#include "mixer/MixerList.hxx"
+#include "mixer/plugins/SoftwareMixerPlugin.hxx"
 #include "notify.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
 
 #include <assert.h>
 #include <string.h>
@@ -38,8 +45,10 @@
 MultipleOutputs::MultipleOutputs(MixerListener &_mixer_listener)
 	:mixer_listener(_mixer_listener),
 	 input_audio_format(AudioFormat::Undefined()),
-	 buffer(nullptr), pipe(nullptr),
-	 elapsed_time(-1)
+	 buffer(nullptr), return_cache(nullptr), pipe(nullptr),
+	 chunk_serial(0),
+	 elapsed_time(-1),
+	 history_time(0), history_limit(0)
 {
 }
 
@@ -49,6 +58,9 @@ MultipleOutputs::~MultipleOutputs()
 		i->LockDisableWait();
 		i->Finish();
 	}
+
+	for (auto i : shared_filters)
+		delete i;
 }
 
 static AudioOutput *
@@ -72,10 +84,16 @@ LoadOutput(EventLoop &event_loop, MixerListener &mixer_listener,
 }
 
 void
-MultipleOutputs::Configure(EventLoop &event_loop, PlayerControl &pc)
+MultipleOutputs::Configure(EventLoop &event_loop, PlayerControl &pc,
+			   const char *partition_name)
 {
-	for (const config_param *param = config_get_param(CONF_AUDIO_OUTPUT);
+	const config_param *first = config_get_param(CONF_AUDIO_OUTPUT);
+	for (const config_param *param = first;
 	     param != nullptr; param = param->next) {
+		if (strcmp(param->GetBlockValue("partition", "default"),
+			   partition_name) != 0)
+			continue;
+
 		auto output = LoadOutput(event_loop, mixer_listener,
 					 pc, *param);
 		if (FindByName(output->name) != nullptr)
@@ -85,13 +103,107 @@ MultipleOutputs::Configure(EventLoop &event_loop, PlayerControl &pc)
 		outputs.push_back(output);
 	}
 
-	if (outputs.empty()) {
+	if (first == nullptr && strcmp(partition_name, "default") == 0) {
 		/* auto-detect device */
 		const config_param empty;
 		auto output = LoadOutput(event_loop, mixer_listener,
 					 pc, empty);
 		outputs.push_back(output);
 	}
+
+	CreateSharedFilters();
+
+	history_time = config_get_unsigned(CONF_SEEK_BUFFER_TIME, 0);
+}
+
+/**
+ * Determine the string which identifies the filter configuration of
+ * the specified output.  Outputs with equal keys produce identical
+ * data from a chunk, so they can share the filter stage.
+ *
+ * @return an empty string if the output cannot share its filters
+ */
+static std::string
+GetSharedFilterKey(const AudioOutput &ao, const config_param &param)
+{
+	if (ao.mixer != nullptr && ao.mixer->IsPlugin(software_mixer_plugin))
+		/* the software mixer is part of the filter chain,
+		   and each output has its own volume */
+		return std::string();
+
+	const bool global_volume = ao.mixer != nullptr &&
+		ao.mixer->IsPlugin(global_software_mixer_plugin);
+
+	const char *replay_gain_handler =
+		param.GetBlockValue("replay_gain_handler", "software");
+	if (strcmp(replay_gain_handler, "software") != 0 &&
+	    strcmp(replay_gain_handler, "none") != 0)
+		/* the "mixer" handler applies replay gain to the
+		   output's own mixer */
+		return std::string();
+
+	std::string key(replay_gain_handler);
+	if (global_volume)
+		/* all outputs with the global software mixer share
+		   one volume */
+		key.append("+global");
+	key.push_back('\n');
+	key.append(param.GetBlockValue("format", ""));
+	key.push_back('\n');
+	key.append(param.GetBlockValue("filters", ""));
+	key.push_back('\n');
+	key.append(param.GetBlockValue("dither", ""));
+	return key;
+}
+
+void
+MultipleOutputs::CreateSharedFilters()
+{
+	const config_param *param = config_get_param(CONF_AUDIO_OUTPUT);
+
+	std::vector<std::string> keys;
+	std::vector<const config_param *> params;
+	for (auto ao : outputs) {
+		if (param == nullptr) {
+			/* auto-detected device */
+			assert(outputs.size() == 1);
+			return;
+		}
+
+		keys.emplace_back(GetSharedFilterKey(*ao, *param));
+		params.push_back(param);
+
+		param = param->next;
+	}
+
+	for (unsigned i = 0, n = outputs.size(); i != n; ++i) {
+		if (keys[i].empty() || outputs[i]->shared_filter != nullptr)
+			continue;
+
+		SharedFilter *sf = nullptr;
+		for (unsigned j = i + 1; j != n; ++j) {
+			if (keys[j] != keys[i])
+				continue;
+
+			if (sf == nullptr) {
+				const Mixer *mixer = outputs[i]->mixer;
+				sf = new SharedFilter(std::string(keys[i]),
+						      *params[i],
+						      outputs[i]->replay_gain_filter != nullptr,
+						      mixer != nullptr &&
+						      mixer->IsPlugin(global_software_mixer_plugin)
+						      ? software_mixer_peek_filter(mixer)
+						      : nullptr);
+				shared_filters.push_back(sf);
+				outputs[i]->shared_filter = sf;
+			}
+
+			outputs[j]->shared_filter = sf;
+			FormatDebug(output_domain,
+				    "output \"%s\" shares the filters of \"%s\"",
+				    outputs[j]->name, outputs[i]->name);
+		}
+	}
 }
 
 AudioOutput *
@@ -184,6 +296,9 @@ MultipleOutputs::SetReplayGainMode(ReplayGainMode mode)
 {
 	for (auto ao : outputs)
 		ao->SetReplayGainMode(mode);
+
+	for (auto sf : shared_filters)
+		sf->SetReplayGainMode(mode);
 }
 
 bool
@@ -200,6 +315,7 @@ MultipleOutputs::Play(MusicChunk *chunk, Error &error)
 		return false;
 	}
 
+	chunk->output_serial = ++chunk_serial;
 	pipe->Push(chunk);
 
 	for (auto ao : outputs)
@@ -220,6 +336,9 @@ MultipleOutputs::Open(const AudioFormat audio_format,
 
 	buffer = &_buffer;
 
+	if (return_cache == nullptr)
+		return_cache = new MusicBuffer::Cache(_buffer);
+
 	/* the audio format must be the same as existing chunks in the
 	   pipe */
 	assert(pipe == nullptr || pipe->CheckFormat(audio_format));
@@ -231,8 +350,18 @@ MultipleOutputs::Open(const AudioFormat audio_format,
 		   format must not have changed */
 		assert(pipe->IsEmpty() || audio_format == input_audio_format);
 
+	if (audio_format != input_audio_format)
+		ClearHistory();
+
 	input_audio_format = audio_format;
 
+	/* keep at most a quarter of the buffer, or the decoder would
+	   starve */
+	history_limit = std::min<double>(history_time *
+					 audio_format.GetTimeToSize() /
+					 _buffer.GetChunkSize(),
+					 _buffer.GetSize() / 4);
+
 	ResetReopen();
 	EnableDisable();
 	Update();
@@ -258,42 +387,19 @@ MultipleOutputs::Open(const AudioFormat audio_format,
 	return ret;
 }
 
-/**
- * Has the specified audio output already consumed this chunk?
- */
-gcc_pure
-static bool
-chunk_is_consumed_in(const AudioOutput *ao,
-		     gcc_unused const MusicPipe *pipe,
-		     const MusicChunk *chunk)
+uint64_t
+MultipleOutputs::GetConsumedSerial() const
 {
-	if (!ao->open)
-		return true;
+	uint64_t result = ~uint64_t(0);
 
-	if (ao->current_chunk == nullptr)
-		return false;
-
-	assert(chunk == ao->current_chunk ||
-	       pipe->Contains(ao->current_chunk));
-
-	if (chunk != ao->current_chunk) {
-		assert(chunk->next != nullptr);
-		return true;
-	}
-
-	return ao->current_chunk_finished && chunk->next == nullptr;
-}
-
-bool
-MultipleOutputs::IsChunkConsumed(const MusicChunk *chunk) const
-{
 	for (auto ao : outputs) {
-		const ScopeLock protect(ao->mutex);
-		if (!chunk_is_consumed_in(ao, pipe, chunk))
-			return false;
+		const uint64_t consumed =
+			ao->consumed_serial.load(std::memory_order_acquire);
+		if (consumed < result)
+			result = consumed;
 	}
 
-	return true;
+	return result;
 }
 
 inline void
@@ -333,10 +439,14 @@ MultipleOutputs::Check()
 	assert(buffer != nullptr);
 	assert(pipe != nullptr);
 
+	/* determine once how far the outputs are; chunks consumed
+	   after this point will be returned by the next call */
+	const uint64_t consumed = GetConsumedSerial();
+
 	while ((chunk = pipe->Peek()) != nullptr) {
 		assert(!pipe->IsEmpty());
 
-		if (!IsChunkConsumed(chunk))
+		if (chunk->output_serial >= consumed)
 			/* at least one output is not finished playing
 			   this chunk */
 			return pipe->GetSize();
@@ -363,13 +473,52 @@ MultipleOutputs::Check()
 				if (locked[i])
 					outputs[i]->mutex.unlock();
 
-		/* return the chunk to the buffer */
-		buffer->Return(shifted);
+		/* free the shared filter results of this chunk
+		   before it gets reused */
+		for (auto sf : shared_filters)
+			sf->Release(shifted);
+
+		AppendHistory(shifted);
 	}
 
 	return 0;
 }
 
+void
+MultipleOutputs::AppendHistory(MusicChunk *chunk)
+{
+	if (chunk->length == 0 || chunk->times < 0) {
+		/* a tag without music data, or silence which was
+		   inserted by the player; not part of the song */
+		return_cache->Return(chunk);
+		return;
+	}
+
+	if (history_limit == 0 || chunk->other != nullptr) {
+		/* a cross-faded chunk cannot be played again; the
+		   history ends here */
+		ClearHistory();
+		return_cache->Return(chunk);
+		return;
+	}
+
+	history.push_back(chunk);
+
+	if (history.size() > history_limit) {
+		return_cache->Return(history.front());
+		history.pop_front();
+	}
+}
+
+void
+MultipleOutputs::ClearHistory()
+{
+	for (MusicChunk *chunk : history)
+		buffer->Return(chunk);
+
+	history.clear();
+}
+
 bool
 MultipleOutputs::Wait(PlayerControl &pc, unsigned threshold)
 {
@@ -406,6 +555,13 @@ MultipleOutputs::Drain()
 	WaitAll();
 }
 
+inline void
+MultipleOutputs::ClearSharedFilters()
+{
+	for (auto sf : shared_filters)
+		sf->Clear();
+}
+
 void
 MultipleOutputs::Cancel()
 {
@@ -421,6 +577,13 @@ MultipleOutputs::Cancel()
 	if (pipe != nullptr)
 		pipe->Clear(*buffer);
 
+	ClearHistory();
+
+	ClearSharedFilters();
+
+	if (return_cache != nullptr)
+		return_cache->Flush();
+
 	/* the audio outputs are now waiting for a signal, to
 	   synchronize the cleared music pipe */
 
@@ -431,6 +594,66 @@ MultipleOutputs::Cancel()
 	elapsed_time = -1.0;
 }
 
+bool
+MultipleOutputs::Rewind(float where, std::vector<MusicChunk *> &chunks)
+{
+	assert(chunks.empty());
+
+	for (auto ao : outputs)
+		ao->LockCancelAsync();
+
+	WaitAll();
+
+	bool found = false;
+
+	if (pipe != nullptr && history_limit > 0) {
+		/* the chunks which have not been played yet continue
+		   the history */
+		MusicChunk *chunk;
+		while ((chunk = pipe->Shift()) != nullptr) {
+			for (auto sf : shared_filters)
+				sf->Release(chunk);
+
+			AppendHistory(chunk);
+		}
+
+		if (!history.empty() && history.front()->times <= where) {
+			const MusicChunk &last = *history.back();
+			const double last_end = last.times + last.length /
+				input_audio_format.GetTimeToSize();
+
+			found = where < last_end;
+		}
+	}
+
+	if (found) {
+		/* skip the chunks before the position */
+		while (history.size() > 1 && history[1]->times <= where) {
+			return_cache->Return(history.front());
+			history.pop_front();
+		}
+
+		chunks.assign(history.begin(), history.end());
+		history.clear();
+	} else {
+		if (pipe != nullptr)
+			pipe->Clear(*buffer);
+
+		ClearHistory();
+	}
+
+	ClearSharedFilters();
+
+	if (return_cache != nullptr)
+		return_cache->Flush();
+
+	AllowPlay();
+
+	elapsed_time = -1.0;
+
+	return found;
+}
+
 void
 MultipleOutputs::Close()
 {
@@ -445,6 +668,13 @@ MultipleOutputs::Close()
 		pipe = nullptr;
 	}
 
+	ClearHistory();
+
+	ClearSharedFilters();
+
+	delete return_cache;
+	return_cache = nullptr;
+
 	buffer = nullptr;
 
 	input_audio_format.Clear();
@@ -466,6 +696,13 @@ MultipleOutputs::Release()
 		pipe = nullptr;
 	}
 
+	ClearHistory();
+
+	ClearSharedFilters();
+
+	delete return_cache;
+	return_cache = nullptr;
+
 	buffer = nullptr;
 
 	input_audio_format.Clear();
@@ -479,4 +716,34 @@ MultipleOutputs::SongBorder()
 	/* clear the elapsed_time pointer at the beginning of a new
 	   song */
 	elapsed_time = 0.0;
+
+	/* the previous song cannot be rewound into */
+	ClearHistory();
+
+	/* the outputs may still report a position within the previous
+	   song; discard it until they have played a chunk of the new
+	   one */
+	for (auto ao : outputs) {
+		const ScopeLock protect(ao->mutex);
+		ao->elapsed_time = -1;
+	}
+}
+
+float
+MultipleOutputs::GetElapsedTime() const
+{
+	if (elapsed_time < 0.0)
+		return elapsed_time;
+
+	float result = -1;
+
+	for (auto ao : outputs) {
+		const ScopeLock protect(ao->mutex);
+
+		if (ao->open && ao->elapsed_time >= 0 &&
+		    (result < 0 || ao->elapsed_time < result))
+			result = ao->elapsed_time;
+	}
+
+	return result >= 0 ? result : elapsed_time;
 }
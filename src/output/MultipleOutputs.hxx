@@ -28,20 +28,22 @@
 
 #include "AudioFormat.hxx"
 #include "ReplayGainInfo.hxx"
+#include "MusicBuffer.hxx"
 #include "Compiler.h"
 
 #include <vector>
+#include <deque>
 
 #include <assert.h>
 
 struct AudioFormat;
-class MusicBuffer;
 class MusicPipe;
 class EventLoop;
 class MixerListener;
 struct MusicChunk;
 struct PlayerControl;
 struct AudioOutput;
+struct SharedFilter;
 class Error;
 
 class MultipleOutputs {
@@ -49,6 +51,12 @@ class MultipleOutputs {
 
 	std::vector<AudioOutput *> outputs;
 
+	/**
+	 * The filter stages shared by groups of outputs with an
+	 * identical filter configuration.  See #SharedFilter.
+	 */
+	std::vector<SharedFilter *> shared_filters;
+
 	AudioFormat input_audio_format;
 
 	/**
@@ -56,18 +64,52 @@ class MultipleOutputs {
 	 */
 	MusicBuffer *buffer;
 
+	/**
+	 * A cache in front of #buffer for chunks returned by
+	 * CheckPipe().  All methods which return chunks are called
+	 * by the player thread, so it is owned by that thread.
+	 */
+	MusicBuffer::Cache *return_cache;
+
 	/**
 	 * The #MusicPipe object which feeds all audio outputs.  It is
 	 * filled by audio_output_all_play().
 	 */
 	MusicPipe *pipe;
 
+	/**
+	 * The MusicChunk::output_serial of the most recently pushed
+	 * chunk.  It is never reset, so a serial identifies a chunk
+	 * even across a "cancel" or a new pipe.
+	 */
+	uint64_t chunk_serial;
+
 	/**
 	 * The "elapsed_time" stamp of the most recently finished
 	 * chunk.
 	 */
 	float elapsed_time;
 
+	/**
+	 * The configured duration of #history in seconds
+	 * ("seek_buffer_time").  0 disables the history.
+	 */
+	unsigned history_time;
+
+	/**
+	 * The maximum number of chunks in #history.  It is
+	 * calculated by Open() from #history_time.
+	 */
+	unsigned history_limit;
+
+	/**
+	 * Chunks of the current song which have been played by all
+	 * outputs, oldest first.  Instead of returning them to the
+	 * #MusicBuffer right away, they are kept for a while, so
+	 * Rewind() can play them again.
+	 */
+	std::deque<MusicChunk *> history;
+
 public:
 	/**
 	 * Load audio outputs from the configuration file and
@@ -76,7 +118,14 @@ public:
 	MultipleOutputs(MixerListener &_mixer_listener);
 	~MultipleOutputs();
 
-	void Configure(EventLoop &event_loop, PlayerControl &pc);
+	/**
+	 * Load all audio outputs which are assigned to the specified
+	 * partition (setting "partition", defaults to "default").  If
+	 * no audio output is configured at all, the "default"
+	 * partition gets an auto-detected one.
+	 */
+	void Configure(EventLoop &event_loop, PlayerControl &pc,
+		       const char *partition_name);
 
 	/**
 	 * Returns the total number of audio output devices, including
@@ -183,20 +232,37 @@ public:
 	 */
 	void Cancel();
 
+	/**
+	 * Like Cancel(), but if the specified position is inside the
+	 * chunks which have been played recently (see
+	 * "seek_buffer_time") or which are still in the output pipe,
+	 * return those chunks to the caller instead of to the
+	 * #MusicBuffer, so they can be played again.
+	 *
+	 * @param where the position within the song [s]
+	 * @param chunks receives the chunks beginning at the
+	 * specified position, in playback order
+	 * @return true on success, false if the position is not
+	 * available (the chunks have been returned to the
+	 * #MusicBuffer then)
+	 */
+	bool Rewind(float where, std::vector<MusicChunk *> &chunks);
+
 	/**
 	 * Indicate that a new song will begin now.
 	 */
 	void SongBorder();
 
 	/**
-	 * Returns the "elapsed_time" stamp of the most recently finished
-	 * chunk.  A negative value is returned when no chunk has been
-	 * finished yet.
+	 * Returns the stream position which is currently being
+	 * presented.  If an output reports its latency, this is the
+	 * (sample-accurate) position of the most delayed such output;
+	 * otherwise it is the "elapsed_time" stamp of the most recently
+	 * finished chunk.  A negative value is returned when no chunk
+	 * has been finished yet.
 	 */
 	gcc_pure
-	float GetElapsedTime() const {
-		return elapsed_time;
-	}
+	float GetElapsedTime() const;
 
 	/**
 	 * Returns the average volume of all available mixers (range
@@ -260,9 +326,14 @@ private:
 	bool Update();
 
 	/**
-	 * Has this chunk been consumed by all audio outputs?
+	 * Determine how far all audio outputs have consumed the pipe.
+	 * This does not lock the outputs.
+	 *
+	 * @return all chunks with a MusicChunk::output_serial lower
+	 * than this value have been consumed by all outputs
 	 */
-	bool IsChunkConsumed(const MusicChunk *chunk) const;
+	gcc_pure
+	uint64_t GetConsumedSerial() const;
 
 	/**
 	 * There's only one chunk left in the pipe (#pipe), and all
@@ -270,6 +341,30 @@ private:
 	 * reference.
 	 */
 	void ClearTailChunk(const MusicChunk *chunk, bool *locked);
+
+	/**
+	 * Group the outputs with an identical filter configuration
+	 * and create a #SharedFilter for each group.
+	 */
+	void CreateSharedFilters();
+
+	/**
+	 * The #MusicPipe has been cleared; discard all shared filter
+	 * results.
+	 */
+	void ClearSharedFilters();
+
+	/**
+	 * Append a chunk which has been consumed to #history, or
+	 * return it to the #MusicBuffer if it cannot be played
+	 * again.
+	 */
+	void AppendHistory(MusicChunk *chunk);
+
+	/**
+	 * Return all chunks in #history to the #MusicBuffer.
+	 */
+	void ClearHistory();
 };
 
 #endif
@@ -125,6 +125,7 @@ AudioOutput::Open(const AudioFormat audio_format, const MusicPipe &mp)
 
 		if (pause) {
 			current_chunk = nullptr;
+			consumed_serial = 0;
 			pipe = &mp;
 
 			/* unpause with the CANCEL command; this is a
@@ -142,6 +143,9 @@ AudioOutput::Open(const AudioFormat audio_format, const MusicPipe &mp)
 
 	in_audio_format = audio_format;
 	current_chunk = nullptr;
+	if (open)
+		/* the output restarts at the head of the pipe */
+		consumed_serial = 0;
 
 	pipe = &mp;
 
@@ -74,6 +74,14 @@ ao_plugin_delay(AudioOutput *ao)
 		: 0;
 }
 
+unsigned
+ao_plugin_latency(AudioOutput *ao)
+{
+	return ao->plugin.latency != nullptr
+		? ao->plugin.latency(ao)
+		: 0;
+}
+
 void
 ao_plugin_send_tag(AudioOutput *ao, const Tag *tag)
 {
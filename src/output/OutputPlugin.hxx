@@ -103,6 +103,19 @@ struct AudioOutputPlugin {
 	 */
 	unsigned (*delay)(AudioOutput *data);
 
+	/**
+	 * Returns the number of frames which have been passed to
+	 * play(), but have not been presented yet (i.e. are still in
+	 * the device's buffers).  MPD uses this to correct the
+	 * elapsed time reported to clients.
+	 *
+	 * This method is optional.
+	 *
+	 * @return the latency in frames (of the negotiated audio
+	 * format)
+	 */
+	unsigned (*latency)(AudioOutput *data);
+
 	/**
 	 * Display metadata for the next chunk.  Optional method,
 	 * because not all devices can display metadata.
@@ -185,6 +198,9 @@ gcc_pure
 unsigned
 ao_plugin_delay(AudioOutput *ao);
 
+unsigned
+ao_plugin_latency(AudioOutput *ao);
+
 void
 ao_plugin_send_tag(AudioOutput *ao, const Tag *tag);
 
@@ -41,3 +41,39 @@ printAudioDevices(Client &client, const MultipleOutputs &outputs)
 			      i, ao.name, ao.enabled);
 	}
 }
+
+static void
+print_levels(Client &client, const char *name, const float *values,
+	     unsigned n)
+{
+	client_printf(client, "%s:", name);
+	for (unsigned c = 0; c < n; ++c)
+		client_printf(client, " %.4f", values[c]);
+	client_puts(client, "\n");
+}
+
+void
+printAudioLevels(Client &client, MultipleOutputs &outputs)
+{
+	for (unsigned i = 0, n = outputs.Size(); i != n; ++i) {
+		AudioOutput &ao = outputs.Get(i);
+
+		ao.mutex.lock();
+		const PcmLevel level = ao.level;
+		ao.mutex.unlock();
+
+		if (level.IsEmpty())
+			continue;
+
+		float rms[MAX_CHANNELS];
+		for (unsigned c = 0; c < level.channels; ++c)
+			rms[c] = level.GetRms(c);
+
+		client_printf(client,
+			      "outputid: %i\n"
+			      "outputname: %s\n",
+			      i, ao.name);
+		print_levels(client, "peak", level.peak, level.channels);
+		print_levels(client, "rms", rms, level.channels);
+	}
+}
@@ -31,4 +31,10 @@ class MultipleOutputs;
 void
 printAudioDevices(Client &client, const MultipleOutputs &outputs);
 
+/**
+ * Print the most recent peak and RMS levels of all open outputs.
+ */
+void
+printAudioLevels(Client &client, MultipleOutputs &outputs);
+
 #endif
@@ -19,10 +19,12 @@
 
 #include "config.h"
 #include "Internal.hxx"
+#include "SharedFilter.hxx"
 #include "OutputAPI.hxx"
 #include "Domain.hxx"
 #include "pcm/PcmMix.hxx"
 #include "notify.hxx"
+#include "Idle.hxx"
 #include "filter/FilterInternal.hxx"
 #include "filter/plugins/ConvertFilterPlugin.hxx"
 #include "filter/plugins/ReplayGainFilterPlugin.hxx"
@@ -33,6 +35,7 @@
 #include "thread/Slack.hxx"
 #include "thread/Name.hxx"
 #include "system/FatalError.hxx"
+#include "system/Clock.hxx"
 #include "util/Error.hxx"
 #include "util/ConstBuffer.hxx"
 #include "Log.hxx"
@@ -127,6 +130,34 @@ AudioOutput::CloseFilter()
 	filter->Close();
 }
 
+void
+AudioOutput::JoinSharedFilter()
+{
+	assert(!shared_filter_joined);
+
+	if (shared_filter == nullptr)
+		return;
+
+	Error error;
+	const ScopeLock protect(shared_filter->mutex);
+	if (shared_filter->Join(in_audio_format, out_audio_format, error))
+		shared_filter_joined = true;
+	else if (error.IsDefined())
+		FormatError(error, "Failed to open shared filter for \"%s\" [%s]",
+			    name, plugin.name);
+}
+
+void
+AudioOutput::LeaveSharedFilter()
+{
+	if (!shared_filter_joined)
+		return;
+
+	const ScopeLock protect(shared_filter->mutex);
+	shared_filter->Leave();
+	shared_filter_joined = false;
+}
+
 inline void
 AudioOutput::Open()
 {
@@ -189,8 +220,12 @@ AudioOutput::Open()
 		return;
 	}
 
+	consumed_serial = 0;
 	open = true;
 
+	JoinSharedFilter();
+	OpenRateAdjust();
+
 	FormatDebug(output_domain,
 		    "opened plugin=%s name=\"%s\" audio_format=%s",
 		    plugin.name, name,
@@ -210,7 +245,16 @@ AudioOutput::Close(bool drain)
 	pipe = nullptr;
 
 	current_chunk = nullptr;
+	consumed_serial = ~uint64_t(0);
 	open = false;
+	elapsed_time = -1;
+	CloseRateAdjust();
+
+	if (!level.IsEmpty()) {
+		pending_level.Clear(0);
+		level.Clear(0);
+		idle_add(IDLE_LEVEL);
+	}
 
 	mutex.unlock();
 
@@ -220,6 +264,7 @@ AudioOutput::Close(bool drain)
 		ao_plugin_cancel(this);
 
 	ao_plugin_close(this);
+	LeaveSharedFilter();
 	CloseFilter();
 
 	mutex.lock();
@@ -233,6 +278,7 @@ AudioOutput::ReopenFilter()
 {
 	Error error;
 
+	LeaveSharedFilter();
 	CloseFilter();
 	const AudioFormat filter_audio_format =
 		OpenFilter(in_audio_format, error);
@@ -250,7 +296,10 @@ AudioOutput::ReopenFilter()
 		pipe = nullptr;
 
 		current_chunk = nullptr;
+		consumed_serial = ~uint64_t(0);
 		open = false;
+		elapsed_time = -1;
+		CloseRateAdjust();
 		fail_timer.Update();
 
 		mutex.unlock();
@@ -259,6 +308,35 @@ AudioOutput::ReopenFilter()
 
 		return;
 	}
+
+	JoinSharedFilter();
+}
+
+void
+AudioOutput::OpenRateAdjust()
+{
+	assert(!rate_adjust_open);
+
+	if (!clock_sync)
+		return;
+
+	Error error;
+	rate_adjust_open = rate_adjust.Open(out_audio_format, error);
+	if (!rate_adjust_open)
+		FormatError(error,
+			    "Clock synchronization disabled for \"%s\" [%s]",
+			    name, plugin.name);
+
+	clock.Reset();
+}
+
+void
+AudioOutput::CloseRateAdjust()
+{
+	if (rate_adjust_open) {
+		rate_adjust.Close();
+		rate_adjust_open = false;
+	}
 }
 
 void
@@ -307,8 +385,29 @@ AudioOutput::WaitForDelay()
 	}
 }
 
+/**
+ * Pass the chunk's replay gain info to the filter if it has changed.
+ */
+static void
+ao_update_replay_gain(Filter *replay_gain_filter, const MusicChunk *chunk,
+		      unsigned *replay_gain_serial_p)
+{
+	if (chunk->replay_gain_serial != *replay_gain_serial_p) {
+		replay_gain_filter_set_info(replay_gain_filter,
+					    chunk->replay_gain_serial != 0
+					    ? &chunk->replay_gain_info
+					    : nullptr);
+		*replay_gain_serial_p = chunk->replay_gain_serial;
+	}
+}
+
+/**
+ * @param f the owner of the filters and buffers: either the
+ * #AudioOutput itself or its #SharedFilter
+ */
+template<typename F>
 static ConstBuffer<void>
-ao_chunk_data(AudioOutput *ao, const MusicChunk *chunk,
+ao_chunk_data(AudioOutput *ao, F &f, const MusicChunk *chunk,
 	      Filter *replay_gain_filter,
 	      unsigned *replay_gain_serial_p)
 {
@@ -318,18 +417,13 @@ ao_chunk_data(AudioOutput *ao, const MusicChunk *chunk,
 
 	ConstBuffer<void> data(chunk->data, chunk->length);
 
-	(void)ao;
+	(void)f;
 
 	assert(data.size % ao->in_audio_format.GetFrameSize() == 0);
 
 	if (!data.IsEmpty() && replay_gain_filter != nullptr) {
-		if (chunk->replay_gain_serial != *replay_gain_serial_p) {
-			replay_gain_filter_set_info(replay_gain_filter,
-						    chunk->replay_gain_serial != 0
-						    ? &chunk->replay_gain_info
-						    : nullptr);
-			*replay_gain_serial_p = chunk->replay_gain_serial;
-		}
+		ao_update_replay_gain(replay_gain_filter, chunk,
+				      replay_gain_serial_p);
 
 		Error error;
 		data = replay_gain_filter->FilterPCM(data, error);
@@ -341,22 +435,91 @@ ao_chunk_data(AudioOutput *ao, const MusicChunk *chunk,
 	return data;
 }
 
+/**
+ * Cross-fade the chunk with its "other" chunk, applying the volume
+ * of both replay gain filters in the same pass instead of running
+ * them on both chunks first.
+ */
+template<typename F>
+static ConstBuffer<void>
+ao_cross_fade_replay_gain(AudioOutput *ao, F &f, const MusicChunk *chunk)
+{
+	const MusicChunk *other = chunk->other;
+	assert(other != nullptr);
+	assert(other->CheckFormat(ao->in_audio_format));
+
+	ConstBuffer<void> data(chunk->data, chunk->length);
+	ConstBuffer<void> other_data(other->data, other->length);
+	if (other_data.IsEmpty())
+		return ao_chunk_data(ao, f, chunk, f.replay_gain_filter,
+				     &f.replay_gain_serial);
+
+	ao_update_replay_gain(f.replay_gain_filter, chunk,
+			      &f.replay_gain_serial);
+	ao_update_replay_gain(f.other_replay_gain_filter, other,
+			      &f.other_replay_gain_serial);
+
+	/* see ao_filter_chunk() */
+	if (data.size > other_data.size)
+		data.size = other_data.size;
+
+	void *dest = f.cross_fade_buffer.Get(other_data.size);
+	memcpy(dest, other_data.data, data.size);
+
+	if (other_data.size > data.size) {
+		/* the trailer of the "other" chunk is not mixed, but
+		   it still needs its replay gain */
+		Error error;
+		ConstBuffer<void> trailer(other_data.data,
+					  other_data.size);
+		trailer.data = (const uint8_t *)trailer.data + data.size;
+		trailer.size -= data.size;
+		trailer = f.other_replay_gain_filter->FilterPCM(trailer, error);
+		if (trailer.IsNull()) {
+			FormatError(error, "\"%s\" [%s] failed to filter",
+				    ao->name, ao->plugin.name);
+			return nullptr;
+		}
+
+		memcpy((uint8_t *)dest + data.size, trailer.data,
+		       trailer.size);
+	}
+
+	if (!pcm_mix(f.cross_fade_dither, dest, data.data, data.size,
+		     ao->in_audio_format.format,
+		     1.0 - chunk->mix_ratio,
+		     replay_gain_filter_get_volume(f.other_replay_gain_filter),
+		     replay_gain_filter_get_volume(f.replay_gain_filter))) {
+		FormatError(output_domain,
+			    "Cannot cross-fade format %s",
+			    sample_format_to_string(ao->in_audio_format.format));
+		return nullptr;
+	}
+
+	return { dest, other_data.size };
+}
+
+template<typename F>
 static ConstBuffer<void>
-ao_filter_chunk(AudioOutput *ao, const MusicChunk *chunk)
+ao_filter_chunk(AudioOutput *ao, F &f, const MusicChunk *chunk)
 {
-	ConstBuffer<void> data =
-		ao_chunk_data(ao, chunk, ao->replay_gain_filter,
-			      &ao->replay_gain_serial);
+	const bool fused_cross_fade = chunk->other != nullptr &&
+		f.replay_gain_filter != nullptr;
+
+	ConstBuffer<void> data = fused_cross_fade
+		? ao_cross_fade_replay_gain(ao, f, chunk)
+		: ao_chunk_data(ao, f, chunk, f.replay_gain_filter,
+				&f.replay_gain_serial);
 	if (data.IsEmpty())
 		return data;
 
-	/* cross-fade */
+	/* cross-fade without replay gain */
 
-	if (chunk->other != nullptr) {
+	if (chunk->other != nullptr && !fused_cross_fade) {
 		ConstBuffer<void> other_data =
-			ao_chunk_data(ao, chunk->other,
-				      ao->other_replay_gain_filter,
-				      &ao->other_replay_gain_serial);
+			ao_chunk_data(ao, f, chunk->other,
+				      f.other_replay_gain_filter,
+				      &f.other_replay_gain_serial);
 		if (other_data.IsNull())
 			return nullptr;
 
@@ -371,9 +534,9 @@ ao_filter_chunk(AudioOutput *ao, const MusicChunk *chunk)
 		if (data.size > other_data.size)
 			data.size = other_data.size;
 
-		void *dest = ao->cross_fade_buffer.Get(other_data.size);
+		void *dest = f.cross_fade_buffer.Get(other_data.size);
 		memcpy(dest, other_data.data, other_data.size);
-		if (!pcm_mix(ao->cross_fade_dither, dest, data.data, data.size,
+		if (!pcm_mix(f.cross_fade_dither, dest, data.data, data.size,
 			     ao->in_audio_format.format,
 			     1.0 - chunk->mix_ratio)) {
 			FormatError(output_domain,
@@ -389,7 +552,7 @@ ao_filter_chunk(AudioOutput *ao, const MusicChunk *chunk)
 	/* apply filter chain */
 
 	Error error;
-	data = ao->filter->FilterPCM(data, error);
+	data = f.filter->FilterPCM(data, error);
 	if (data.IsNull()) {
 		FormatError(error, "\"%s\" [%s] failed to filter",
 			    ao->name, ao->plugin.name);
@@ -399,18 +562,46 @@ ao_filter_chunk(AudioOutput *ao, const MusicChunk *chunk)
 	return data;
 }
 
+/**
+ * Filter the chunk with the #SharedFilter, or look up the result of
+ * another output of the group which has already done so.
+ */
+static ConstBuffer<void>
+ao_shared_filter_chunk(AudioOutput *ao, const MusicChunk *chunk)
+{
+	SharedFilter &sf = *ao->shared_filter;
+	const ScopeLock protect(sf.mutex);
+
+	ConstBuffer<void> data = sf.Find(chunk);
+	if (!data.IsNull())
+		return data;
+
+	data = ao_filter_chunk(ao, sf, chunk);
+	if (data.IsEmpty())
+		return data;
+
+	return sf.Add(chunk, data);
+}
+
 inline bool
 AudioOutput::PlayChunk(const MusicChunk *chunk)
 {
 	assert(filter != nullptr);
 
+	if (chunk->push_us != 0)
+		stats.chunk_wait.Add(MonotonicClockUS() - chunk->push_us);
+
 	if (tags && gcc_unlikely(chunk->tag != nullptr)) {
 		mutex.unlock();
 		ao_plugin_send_tag(this, chunk->tag);
 		mutex.lock();
 	}
 
-	auto data = ConstBuffer<char>::FromVoid(ao_filter_chunk(this, chunk));
+	auto data = ConstBuffer<char>::FromVoid(shared_filter_joined
+						? ao_shared_filter_chunk(this,
+									 chunk)
+						: ao_filter_chunk(this, *this,
+								  chunk));
 	if (data.IsNull()) {
 		Close(false);
 
@@ -420,6 +611,25 @@ AudioOutput::PlayChunk(const MusicChunk *chunk)
 		return false;
 	}
 
+	UpdateLevel(data.ToVoid());
+
+	if (rate_adjust_open) {
+		Error error;
+		data = ConstBuffer<char>::FromVoid(rate_adjust.Apply(data.ToVoid(),
+								     error));
+		if (data.IsNull()) {
+			FormatError(error, "\"%s\" [%s] failed to adjust the rate",
+				    name, plugin.name);
+			Close(false);
+			fail_timer.Update();
+			return false;
+		}
+	}
+
+	const size_t total_size = data.size;
+	const double chunk_time =
+		chunk->length / in_audio_format.GetTimeToSize();
+
 	Error error;
 
 	while (!data.IsEmpty() && command == AO_COMMAND_NONE) {
@@ -427,8 +637,13 @@ AudioOutput::PlayChunk(const MusicChunk *chunk)
 			break;
 
 		mutex.unlock();
+		const uint64_t play_start = MonotonicClockUS();
 		size_t nbytes = ao_plugin_play(this, data.data, data.size,
 					       error);
+		stats.play.Add(MonotonicClockUS() - play_start);
+		const unsigned latency = nbytes > 0
+			? ao_plugin_latency(this)
+			: 0;
 		mutex.lock();
 		if (nbytes == 0) {
 			/* play()==0 means failure */
@@ -450,11 +665,57 @@ AudioOutput::PlayChunk(const MusicChunk *chunk)
 
 		data.data += nbytes;
 		data.size -= nbytes;
+
+		UpdateElapsedTime(chunk, total_size - data.size, total_size,
+				  latency);
+
+		if (rate_adjust_open)
+			rate_adjust.SetRatio(clock.Update(chunk_time * nbytes
+							  / total_size,
+							  double(latency)
+							  / out_audio_format.sample_rate,
+							  MonotonicClockUS()));
 	}
 
 	return true;
 }
 
+inline void
+AudioOutput::UpdateElapsedTime(const MusicChunk *chunk,
+			       size_t played, size_t total,
+			       unsigned latency)
+{
+	if (plugin.latency == nullptr || chunk->times < 0.0) {
+		elapsed_time = -1;
+		return;
+	}
+
+	/* interpolate the stream position of the end of the data
+	   which was just submitted, and subtract the time it takes
+	   the device to present it */
+	const double chunk_time =
+		chunk->length / in_audio_format.GetTimeToSize();
+	const double position = chunk->times + chunk_time * played / total
+		- double(latency) / out_audio_format.sample_rate;
+
+	elapsed_time = position > 0 ? position : 0;
+}
+
+inline void
+AudioOutput::UpdateLevel(ConstBuffer<void> data)
+{
+	if (pending_level.channels != out_audio_format.channels)
+		pending_level.Clear(out_audio_format.channels);
+
+	pending_level.Update(out_audio_format.format, data);
+
+	if (pending_level.n_frames >= out_audio_format.sample_rate / 10) {
+		level = pending_level;
+		pending_level.Clear(out_audio_format.channels);
+		idle_add(IDLE_LEVEL);
+	}
+}
+
 inline const MusicChunk *
 AudioOutput::GetNextChunk() const
 {
@@ -491,6 +752,8 @@ AudioOutput::Play()
 		}
 
 		assert(current_chunk == chunk);
+		consumed_serial.store(chunk->output_serial + 1,
+				      std::memory_order_release);
 		chunk = chunk->next;
 	}
 
@@ -513,6 +776,10 @@ AudioOutput::Pause()
 	ao_plugin_cancel(this);
 	mutex.lock();
 
+	/* the device's buffer has been cleared; the clock needs a
+	   new reference point when playback resumes */
+	clock.Reset();
+
 	pause = true;
 	CommandFinished();
 
@@ -538,7 +805,9 @@ AudioOutput::Task()
 {
 	FormatThreadName("output:%s", name);
 
-	SetThreadRealtime();
+	if (!scheduling.HasPolicy())
+		SetThreadRealtime();
+	scheduling.Apply(name);
 	SetThreadTimerSlackUS(100);
 
 	mutex.lock();
@@ -608,6 +877,14 @@ AudioOutput::Task()
 
 		case AO_COMMAND_CANCEL:
 			current_chunk = nullptr;
+			if (open)
+				consumed_serial = 0;
+			elapsed_time = -1;
+
+			if (rate_adjust_open) {
+				rate_adjust.Reset();
+				clock.Reset();
+			}
 
 			if (open) {
 				mutex.unlock();
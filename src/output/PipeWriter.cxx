@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "PipeWriter.hxx"
+#include "config/ConfigData.hxx"
+#include "config/ConfigError.hxx"
+#include "util/Alloc.hxx"
+#include "util/Error.hxx"
+#include "Compiler.h"
+
+#ifdef __linux__
+#include "util/HugeAllocator.hxx"
+
+#include <sys/uio.h>
+#endif
+
+#include <algorithm>
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+void
+PipeWriter::Open(int _fd, size_t _batch_size, bool _zero_copy)
+{
+	assert(_fd >= 0);
+	assert(fd < 0);
+	assert(!_zero_copy || _batch_size > 0);
+
+	fd = _fd;
+	batch_size = _batch_size;
+	zero_copy = CanZeroCopy() && _zero_copy;
+
+	const int flags = fcntl(fd, F_GETFL);
+	non_blocking = flags >= 0 && (flags & O_NONBLOCK) != 0;
+
+	fill = sent = 0;
+	current_spliced = false;
+	current = nullptr;
+}
+
+static void
+FreeSegment(uint8_t *p, size_t size, bool zero_copy)
+{
+#ifdef __linux__
+	if (zero_copy) {
+		HugeFree(p, size);
+		return;
+	}
+#else
+	(void)size;
+	(void)zero_copy;
+#endif
+
+	free(p);
+}
+
+void
+PipeWriter::Close()
+{
+	if (fd < 0)
+		return;
+
+	if (current != nullptr)
+		FreeSegment(current, batch_size, zero_copy);
+
+	current = nullptr;
+	fd = -1;
+}
+
+uint8_t *
+PipeWriter::AllocateSegment()
+{
+#ifdef __linux__
+	if (zero_copy)
+		/* page aligned, so the pipe references whole pages */
+		return (uint8_t *)HugeAllocate(batch_size);
+#endif
+
+	return (uint8_t *)xalloc(batch_size);
+}
+
+/**
+ * #current has been spliced partially or completely.  The pipe
+ * holds its own references to these pages, possibly long after the
+ * reader has drained it (e.g. if it splices them onward), and
+ * vmsplice() does not tell when they are released; therefore they
+ * must never be modified again.  Unmapping them is safe; the next
+ * Write() allocates fresh pages.
+ */
+void
+PipeWriter::Retire()
+{
+	assert(current_spliced);
+
+	FreeSegment(current, batch_size, zero_copy);
+	current = nullptr;
+	current_spliced = false;
+}
+
+bool
+PipeWriter::FlushCurrent(gcc_unused bool splice)
+{
+	while (sent < fill) {
+		ssize_t nbytes;
+
+#ifdef __linux__
+		if (splice) {
+			struct iovec iov;
+			iov.iov_base = current + sent;
+			iov.iov_len = fill - sent;
+			nbytes = vmsplice(fd, &iov, 1,
+					  SPLICE_F_GIFT |
+					  (non_blocking
+					   ? SPLICE_F_NONBLOCK : 0));
+			if (nbytes > 0)
+				current_spliced = true;
+		} else
+#endif
+			nbytes = write(fd, current + sent, fill - sent);
+
+		if (nbytes < 0) {
+			if (errno == EINTR)
+				continue;
+
+			return false;
+		}
+
+		sent += nbytes;
+	}
+
+	if (current_spliced)
+		Retire();
+
+	fill = sent = 0;
+	return true;
+}
+
+ssize_t
+PipeWriter::Write(const void *data, size_t size)
+{
+	assert(fd >= 0);
+
+	if (batch_size == 0)
+		return write(fd, data, size);
+
+	/* pass the previous batch first if it is still pending */
+	if (fill == batch_size && !FlushCurrent(zero_copy))
+		return -1;
+
+	if (current == nullptr) {
+		current = AllocateSegment();
+		if (current == nullptr) {
+			errno = ENOMEM;
+			return -1;
+		}
+	}
+
+	const size_t nbytes = std::min(size, batch_size - fill);
+	memcpy(current + fill, data, nbytes);
+	fill += nbytes;
+
+	if (fill == batch_size && !FlushCurrent(zero_copy) &&
+	    errno != EAGAIN)
+		return -1;
+
+	return nbytes;
+}
+
+bool
+PipeWriter::Flush()
+{
+	assert(fd >= 0);
+
+	/* an incomplete batch is copied, because its segment would
+	   have to be retired afterwards */
+	return batch_size == 0 || FlushCurrent(zero_copy && fill == batch_size);
+}
+
+void
+PipeWriter::Cancel()
+{
+	if (current_spliced)
+		Retire();
+
+	fill = sent = 0;
+}
+
+bool
+pipe_writer_configure(const config_param &param,
+		      size_t &batch_size, bool &zero_copy,
+		      Error &error)
+{
+	batch_size = param.GetBlockValue("batch_size", 0u);
+	zero_copy = param.GetBlockValue("zero_copy", false);
+
+	if (!zero_copy)
+		return true;
+
+	if (!PipeWriter::CanZeroCopy()) {
+		error.Set(config_domain,
+			  "\"zero_copy\" is not supported on this platform");
+		return false;
+	}
+
+	if (batch_size == 0)
+		batch_size = 65536;
+
+	/* vmsplice() works best with whole pages */
+	const size_t page_size = sysconf(_SC_PAGESIZE);
+	batch_size = (batch_size + page_size - 1) / page_size * page_size;
+	return true;
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PIPE_WRITER_HXX
+#define MPD_PIPE_WRITER_HXX
+
+#include "check.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+struct config_param;
+class Error;
+
+/**
+ * Collects the data written by an output plugin into large batches
+ * and passes each batch to a pipe with one system call.  On Linux,
+ * full batches can be spliced into the pipe with vmsplice() instead
+ * of being copied; spliced pages are never written again, but
+ * unmapped and replaced with freshly allocated ones.
+ *
+ * Errors are reported like write() does: a negative return value,
+ * with the error code in errno.
+ */
+class PipeWriter {
+	int fd;
+
+	/**
+	 * The size of each batch.  0 means each Write() is passed
+	 * through right away.
+	 */
+	size_t batch_size;
+
+	/**
+	 * Use vmsplice() for full batches?
+	 */
+	bool zero_copy;
+
+	/**
+	 * Is the pipe in non-blocking mode?
+	 */
+	bool non_blocking;
+
+	/**
+	 * The segment being filled.  It is allocated by Write() when
+	 * needed.
+	 */
+	uint8_t *current;
+
+	/**
+	 * The number of bytes in #current.
+	 */
+	size_t fill;
+
+	/**
+	 * The number of bytes of #current already passed to the
+	 * pipe.
+	 */
+	size_t sent;
+
+	/**
+	 * Has a part of #current been spliced?  Then it must not be
+	 * modified anymore.
+	 */
+	bool current_spliced;
+
+public:
+	PipeWriter():fd(-1), current(nullptr) {}
+	~PipeWriter() {
+		Close();
+	}
+
+	PipeWriter(const PipeWriter &) = delete;
+	PipeWriter &operator=(const PipeWriter &) = delete;
+
+	/**
+	 * Does this platform support #zero_copy?
+	 */
+	static constexpr bool CanZeroCopy() {
+#ifdef __linux__
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	/**
+	 * Attach to a pipe.  The file descriptor remains owned by the
+	 * caller.
+	 *
+	 * @param _batch_size the size of a batch in bytes, or 0 to
+	 * disable batching; must be a multiple of the page size if
+	 * _zero_copy is set
+	 */
+	void Open(int _fd, size_t _batch_size, bool _zero_copy);
+
+	/**
+	 * Free all buffers.  Pending data is discarded; call Flush()
+	 * before.
+	 */
+	void Close();
+
+	/**
+	 * Queue data for the pipe.
+	 *
+	 * @return the number of bytes consumed (may be less than
+	 * size), or -1 on error (including EAGAIN if the pipe is
+	 * non-blocking and full, and ENOMEM if no buffer could be
+	 * allocated)
+	 */
+	ssize_t Write(const void *data, size_t size);
+
+	/**
+	 * Pass all pending data to the pipe.
+	 *
+	 * @return false on error (see errno)
+	 */
+	bool Flush();
+
+	/**
+	 * Discard all pending data.
+	 */
+	void Cancel();
+
+private:
+	uint8_t *AllocateSegment();
+	void Retire();
+	bool FlushCurrent(bool splice);
+};
+
+/**
+ * Parse the settings "batch_size" and "zero_copy" for
+ * PipeWriter::Open().
+ */
+bool
+pipe_writer_configure(const config_param &param,
+		      size_t &batch_size, bool &zero_copy,
+		      Error &error);
+
+#endif
@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "SharedFilter.hxx"
+#include "Internal.hxx"
+#include "filter/FilterPlugin.hxx"
+#include "filter/FilterRegistry.hxx"
+#include "filter/FilterInternal.hxx"
+#include "filter/plugins/ChainFilterPlugin.hxx"
+#include "filter/plugins/ConvertFilterPlugin.hxx"
+#include "filter/plugins/ReplayGainFilterPlugin.hxx"
+#include "config/ConfigData.hxx"
+#include "util/Error.hxx"
+
+#include <iterator>
+
+#include <assert.h>
+#include <string.h>
+
+SharedFilter::SharedFilter(std::string &&_key, const config_param &param,
+			   bool replay_gain, const Filter *volume_filter)
+	:key(std::move(_key)),
+	 filter(audio_output_filter_chain_new(param.GetBlockValue("filters",
+								  ""),
+					      "shared filter")),
+	 replay_gain_filter(nullptr), replay_gain_serial(0),
+	 other_replay_gain_filter(nullptr), other_replay_gain_serial(0),
+	 n_joined(0)
+{
+	if (replay_gain) {
+		replay_gain_filter = filter_new(&replay_gain_filter_plugin,
+						config_param(), IgnoreError());
+		assert(replay_gain_filter != nullptr);
+
+		other_replay_gain_filter =
+			filter_new(&replay_gain_filter_plugin,
+				   config_param(), IgnoreError());
+		assert(other_replay_gain_filter != nullptr);
+
+		replay_gain_filter_set_volume_filter(replay_gain_filter,
+						     volume_filter);
+		replay_gain_filter_set_volume_filter(other_replay_gain_filter,
+						     volume_filter);
+	} else
+		assert(volume_filter == nullptr);
+
+	/* the "convert" filter must be the last one in the chain */
+
+	/* the "dither" setting has been validated already by
+	   audio_output_setup() */
+	convert_filter = filter_new(&convert_filter_plugin, param,
+				    IgnoreError());
+	assert(convert_filter != nullptr);
+
+	filter_chain_append(*filter, "convert", convert_filter);
+}
+
+SharedFilter::~SharedFilter()
+{
+	assert(n_joined == 0);
+	assert(results.empty());
+
+	delete replay_gain_filter;
+	delete other_replay_gain_filter;
+	delete filter;
+}
+
+bool
+SharedFilter::Join(AudioFormat in, AudioFormat out, Error &error)
+{
+	assert(in.IsValid());
+	assert(out.IsValid());
+
+	if (n_joined > 0) {
+		if (in != in_audio_format || out != out_audio_format)
+			return false;
+
+		++n_joined;
+		return true;
+	}
+
+	assert(results.empty());
+
+	/* the replay_gain filter cannot fail here */
+	if (replay_gain_filter != nullptr &&
+	    !replay_gain_filter->Open(in, error).IsDefined())
+		return false;
+
+	if (other_replay_gain_filter != nullptr &&
+	    !other_replay_gain_filter->Open(in, error).IsDefined()) {
+		if (replay_gain_filter != nullptr)
+			replay_gain_filter->Close();
+		return false;
+	}
+
+	if (!filter->Open(in, error).IsDefined() ||
+	    !convert_filter_set(convert_filter, out, error)) {
+		if (replay_gain_filter != nullptr)
+			replay_gain_filter->Close();
+		if (other_replay_gain_filter != nullptr)
+			other_replay_gain_filter->Close();
+		return false;
+	}
+
+	in_audio_format = in;
+	out_audio_format = out;
+	replay_gain_serial = other_replay_gain_serial = 0;
+	n_joined = 1;
+	return true;
+}
+
+void
+SharedFilter::Leave()
+{
+	assert(n_joined > 0);
+
+	if (--n_joined > 0)
+		return;
+
+	/* the last member has left: no output needs the results
+	   anymore */
+	spare.splice(spare.begin(), results);
+
+	if (replay_gain_filter != nullptr)
+		replay_gain_filter->Close();
+	if (other_replay_gain_filter != nullptr)
+		other_replay_gain_filter->Close();
+
+	filter->Close();
+}
+
+void
+SharedFilter::SetReplayGainMode(ReplayGainMode mode)
+{
+	const ScopeLock protect(mutex);
+
+	if (replay_gain_filter != nullptr)
+		replay_gain_filter_set_mode(replay_gain_filter, mode);
+	if (other_replay_gain_filter != nullptr)
+		replay_gain_filter_set_mode(other_replay_gain_filter, mode);
+}
+
+ConstBuffer<void>
+SharedFilter::Find(const MusicChunk *chunk) const
+{
+	for (const auto &i : results)
+		if (i.chunk == chunk)
+			return i.data;
+
+	return nullptr;
+}
+
+ConstBuffer<void>
+SharedFilter::Add(const MusicChunk *chunk, ConstBuffer<void> data)
+{
+	assert(n_joined > 0);
+	assert(Find(chunk).IsNull());
+
+	if (spare.empty())
+		spare.emplace_front();
+
+	results.splice(results.end(), spare, spare.begin());
+
+	Result &r = results.back();
+	r.chunk = chunk;
+
+	void *dest = r.buffer.Get(data.size);
+	memcpy(dest, data.data, data.size);
+	r.data = { dest, data.size };
+	return r.data;
+}
+
+void
+SharedFilter::Release(const MusicChunk *chunk)
+{
+	const ScopeLock protect(mutex);
+
+	/* chunks are released in the order of the MusicPipe, so any
+	   result before this chunk is obsolete as well */
+	for (auto i = results.begin(); i != results.end(); ++i) {
+		if (i->chunk == chunk) {
+			spare.splice(spare.begin(), results,
+				     results.begin(), std::next(i));
+			break;
+		}
+	}
+}
+
+void
+SharedFilter::Clear()
+{
+	const ScopeLock protect(mutex);
+
+	spare.splice(spare.begin(), results);
+}
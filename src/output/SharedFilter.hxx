@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_OUTPUT_SHARED_FILTER_HXX
+#define MPD_OUTPUT_SHARED_FILTER_HXX
+
+#include "AudioFormat.hxx"
+#include "ReplayGainInfo.hxx"
+#include "pcm/PcmBuffer.hxx"
+#include "pcm/PcmDither.hxx"
+#include "thread/Mutex.hxx"
+#include "util/ConstBuffer.hxx"
+#include "Compiler.h"
+
+#include <string>
+#include <list>
+
+class Error;
+class Filter;
+struct MusicChunk;
+struct config_param;
+
+/**
+ * The filter stage of several #AudioOutput objects with an identical
+ * filter configuration (replay gain, "filters", "dither", no software
+ * mixer or the global one).
+ * The first output which reaches a #MusicChunk runs it through this
+ * object's filters, and the result is kept until the chunk is
+ * returned to the #MusicBuffer, so all other outputs of the group
+ * can use it without filtering again.
+ *
+ * Only outputs which agree on both the input and the output audio
+ * format can join; all others use their own filters.
+ *
+ * The filter attribute names match those of #AudioOutput, because
+ * both are used by the same filter code in OutputThread.cxx.
+ */
+struct SharedFilter {
+	/**
+	 * A string describing the configuration of all members.
+	 */
+	const std::string key;
+
+	/**
+	 * This mutex protects all attributes below.  Lock it after
+	 * AudioOutput::mutex, never before.
+	 */
+	Mutex mutex;
+
+	PcmBuffer cross_fade_buffer;
+	PcmDither cross_fade_dither;
+
+	Filter *filter;
+
+	Filter *replay_gain_filter;
+	unsigned replay_gain_serial;
+
+	Filter *other_replay_gain_filter;
+	unsigned other_replay_gain_serial;
+
+	Filter *convert_filter;
+
+	AudioFormat in_audio_format, out_audio_format;
+
+	/**
+	 * The number of outputs which have currently joined.  The
+	 * filters are open while this is non-zero.
+	 */
+	unsigned n_joined;
+
+	struct Result {
+		const MusicChunk *chunk;
+
+		ConstBuffer<void> data;
+
+		PcmBuffer buffer;
+	};
+
+	/**
+	 * Filtered chunks, in the order of the #MusicPipe.
+	 */
+	std::list<Result> results;
+
+	/**
+	 * Unused #Result objects, kept here to reuse their buffers.
+	 */
+	std::list<Result> spare;
+
+	/**
+	 * @param param the configuration of the first output of the
+	 * group; "filters" and "dither" are read from it
+	 * @param volume_filter the global software volume to be
+	 * applied by the replay gain filters (see
+	 * replay_gain_filter_set_volume_filter()), or nullptr
+	 */
+	SharedFilter(std::string &&_key, const config_param &param,
+		     bool replay_gain, const Filter *volume_filter);
+	~SharedFilter();
+
+	SharedFilter(const SharedFilter &) = delete;
+	SharedFilter &operator=(const SharedFilter &) = delete;
+
+	/**
+	 * Attempt to use this object for an output.  Caller must
+	 * hold the mutex.
+	 *
+	 * @return false if the object is already used with
+	 * different audio formats, or if the filters could not be
+	 * opened
+	 */
+	bool Join(AudioFormat in, AudioFormat out, Error &error);
+
+	/**
+	 * Undo a successful Join().  Caller must hold the mutex.
+	 */
+	void Leave();
+
+	/**
+	 * Like AudioOutput::SetReplayGainMode().  Locks the mutex.
+	 */
+	void SetReplayGainMode(ReplayGainMode mode);
+
+	/**
+	 * Look up the filtered data of a chunk.  Caller must hold
+	 * the mutex.
+	 *
+	 * @return the filtered data or nullptr if the chunk has not
+	 * been filtered yet
+	 */
+	gcc_pure
+	ConstBuffer<void> Find(const MusicChunk *chunk) const;
+
+	/**
+	 * Store a copy of the filtered data of a chunk.  Caller must
+	 * hold the mutex.
+	 *
+	 * @return the copy, which remains valid until Release() is
+	 * called for this chunk
+	 */
+	ConstBuffer<void> Add(const MusicChunk *chunk,
+			      ConstBuffer<void> data);
+
+	/**
+	 * The chunk is about to be returned to the #MusicBuffer;
+	 * free its result.  Locks the mutex.
+	 */
+	void Release(const MusicChunk *chunk);
+
+	/**
+	 * The #MusicPipe was cleared; free all results.  Locks the
+	 * mutex.
+	 */
+	void Clear();
+};
+
+#endif
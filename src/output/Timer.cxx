@@ -27,39 +27,50 @@
 #include <assert.h>
 
 Timer::Timer(const AudioFormat af)
-	: time(0),
-	  started(false),
+	:start_time(0), position(0),
+	 started(false),
 	 rate(af.sample_rate * af.GetFrameSize())
 {
 }
 
 void Timer::Start()
 {
-	time = MonotonicClockUS();
+	start_time = MonotonicClockUS();
+	position = 0;
 	started = true;
 }
 
 void Timer::Reset()
 {
-	time = 0;
+	start_time = 0;
+	position = 0;
 	started = false;
 }
 
 void Timer::Add(int size)
 {
 	assert(started);
+	assert(size >= 0);
 
-	// (size samples) / (rate samples per second) = duration seconds
-	// duration seconds * 1000000 = duration us
-	time += ((uint64_t)size * 1000000) / rate;
+	position += size;
+}
+
+uint64_t Timer::GetDeadline() const
+{
+	/* split into whole seconds and the remainder, so the
+	   multiplication cannot overflow on long streams */
+	return start_time + (position / rate) * 1000000 +
+		(position % rate) * 1000000 / rate;
 }
 
 unsigned Timer::GetDelay() const
 {
-	int64_t delay = (int64_t)(time - MonotonicClockUS()) / 1000;
-	if (delay < 0)
+	int64_t delay = (int64_t)(GetDeadline() - MonotonicClockUS());
+	if (delay <= 0)
 		return 0;
 
+	delay = (delay + 999) / 1000;
+
 	if (delay > std::numeric_limits<int>::max())
 		delay = std::numeric_limits<int>::max();
 
@@ -20,14 +20,30 @@
 #ifndef MPD_TIMER_HXX
 #define MPD_TIMER_HXX
 
+#include "Compiler.h"
+
 #include <stdint.h>
 
 struct AudioFormat;
 
+/**
+ * Paces an output without a hardware clock in real time.  The
+ * deadline of each chunk is calculated from the start time and the
+ * total amount of data, so rounding errors do not add up.
+ */
 class Timer {
-	uint64_t time;
+	/**
+	 * The MonotonicClockUS() value when the timer was started.
+	 */
+	uint64_t start_time;
+
+	/**
+	 * The number of bytes added since the timer was started.
+	 */
+	uint64_t position;
+
 	bool started;
-	const int rate;
+	const unsigned rate;
 public:
 	explicit Timer(AudioFormat af);
 
@@ -39,9 +55,20 @@ public:
 	void Add(int size);
 
 	/**
-	 * Returns the number of milliseconds to sleep to get back to sync.
+	 * Returns the number of milliseconds to sleep to get back to
+	 * sync.  This is rounded up, so playback never runs ahead of
+	 * the clock.
 	 */
+	gcc_pure
 	unsigned GetDelay() const;
+
+private:
+	/**
+	 * Returns the MonotonicClockUS() value when all data added so
+	 * far will have been played.
+	 */
+	gcc_pure
+	uint64_t GetDeadline() const;
 };
 
 #endif
@@ -28,20 +28,34 @@
 #include "util/Domain.hxx"
 #include "util/ConstBuffer.hxx"
 #include "Log.hxx"
+#include "system/ByteOrder.hxx"
 
 #include <alsa/asoundlib.h>
 
 #include <string>
+#include <algorithm>
 
 #if SND_LIB_VERSION >= 0x1001c
 /* alsa-lib supports DSD since version 1.0.27.1 */
 #define HAVE_ALSA_DSD
 #endif
 
+#if SND_LIB_VERSION >= 0x1001d
+/* alsa-lib supports DSD_U32 since version 1.0.29 */
+#define HAVE_ALSA_DSD_U32
+#endif
+
 static const char default_device[] = "default";
 
 static constexpr unsigned MPD_ALSA_BUFFER_TIME_US = 500000;
 
+/**
+ * The default buffer_time and period_time settings of the
+ * "low_latency" profile.
+ */
+static constexpr unsigned MPD_ALSA_LOW_LATENCY_BUFFER_TIME_US = 8000;
+static constexpr unsigned MPD_ALSA_LOW_LATENCY_PERIOD_TIME_US = 2000;
+
 static constexpr unsigned MPD_ALSA_RETRY_NR = 5;
 
 typedef snd_pcm_sframes_t alsa_writei_t(snd_pcm_t * pcm, const void *buffer,
@@ -58,9 +72,19 @@ struct AlsaOutput {
 	 */
 	std::string device;
 
-	/** use memory mapped I/O? */
+	/**
+	 * use memory mapped I/O?  If enabled, method play() exports
+	 * the PCM data directly into the device's ring buffer.
+	 */
 	bool use_mmap;
 
+	/**
+	 * Negotiate small periods and start playback as soon as the
+	 * first period has been written?  This changes the defaults
+	 * of #buffer_time and #period_time.
+	 */
+	bool low_latency;
+
 	/**
 	 * Enable DSD over USB according to the dCS suggested
 	 * standard?
@@ -98,6 +122,18 @@ struct AlsaOutput {
 	 */
 	size_t out_frame_size;
 
+	/**
+	 * The size of the hardware buffer, in number of frames.
+	 */
+	snd_pcm_uframes_t buffer_frames;
+
+	/**
+	 * The configured start threshold, in number of frames.  In
+	 * mmap mode, playback is started manually when the buffer
+	 * contains at least this many frames.
+	 */
+	snd_pcm_uframes_t start_threshold;
+
 	/**
 	 * The size of one period, in number of frames.
 	 */
@@ -155,9 +191,16 @@ AlsaOutput::Configure(const config_param &param, Error &error)
 
 	dsd_usb = param.GetBlockValue("dsd_usb", false);
 
+	low_latency = param.GetBlockValue("low_latency", false);
+
 	buffer_time = param.GetBlockValue("buffer_time",
-					      MPD_ALSA_BUFFER_TIME_US);
-	period_time = param.GetBlockValue("period_time", 0u);
+					  low_latency
+					  ? MPD_ALSA_LOW_LATENCY_BUFFER_TIME_US
+					  : MPD_ALSA_BUFFER_TIME_US);
+	period_time = param.GetBlockValue("period_time",
+					  low_latency
+					  ? MPD_ALSA_LOW_LATENCY_PERIOD_TIME_US
+					  : 0u);
 
 #ifdef SND_PCM_NO_AUTO_RESAMPLE
 	if (!param.GetBlockValue("auto_resample", true))
@@ -296,6 +339,15 @@ byteswap_bitformat(snd_pcm_format_t fmt)
 		return SND_PCM_FORMAT_S24_3BE;
 
 	case SND_PCM_FORMAT_S32_BE: return SND_PCM_FORMAT_S32_LE;
+
+#ifdef HAVE_ALSA_DSD_U32
+	case SND_PCM_FORMAT_DSD_U32_LE:
+		return SND_PCM_FORMAT_DSD_U32_BE;
+
+	case SND_PCM_FORMAT_DSD_U32_BE:
+		return SND_PCM_FORMAT_DSD_U32_LE;
+#endif
+
 	default: return SND_PCM_FORMAT_UNKNOWN;
 	}
 }
@@ -346,18 +398,14 @@ alsa_try_format_or_packed(snd_pcm_t *pcm, snd_pcm_hw_params_t *hwparams,
 }
 
 /**
- * Attempts to configure the specified sample format, and tries the
+ * Attempts to configure the specified ALSA format, and tries the
  * reversed host byte order if was not supported.
  */
 static int
-alsa_output_try_format(snd_pcm_t *pcm, snd_pcm_hw_params_t *hwparams,
-		       SampleFormat sample_format,
-		       bool *packed_r, bool *reverse_endian_r)
+alsa_output_try_alsa_format(snd_pcm_t *pcm, snd_pcm_hw_params_t *hwparams,
+			    snd_pcm_format_t alsa_format,
+			    bool *packed_r, bool *reverse_endian_r)
 {
-	snd_pcm_format_t alsa_format = get_bitformat(sample_format);
-	if (alsa_format == SND_PCM_FORMAT_UNKNOWN)
-		return -EINVAL;
-
 	int err = alsa_try_format_or_packed(pcm, hwparams, alsa_format,
 					    packed_r);
 	if (err == 0)
@@ -377,19 +425,58 @@ alsa_output_try_format(snd_pcm_t *pcm, snd_pcm_hw_params_t *hwparams,
 	return err;
 }
 
+/**
+ * Attempts to configure the specified sample format, and tries the
+ * reversed host byte order if was not supported.  DSD falls back to
+ * DSD_U32 if DSD_U8 is not supported.
+ */
+static int
+alsa_output_try_format(snd_pcm_t *pcm, snd_pcm_hw_params_t *hwparams,
+		       SampleFormat sample_format,
+		       bool *packed_r, bool *reverse_endian_r,
+		       bool *dsd_u32_r)
+{
+	*dsd_u32_r = false;
+
+	snd_pcm_format_t alsa_format = get_bitformat(sample_format);
+	if (alsa_format == SND_PCM_FORMAT_UNKNOWN)
+		return -EINVAL;
+
+	int err = alsa_output_try_alsa_format(pcm, hwparams, alsa_format,
+					      packed_r, reverse_endian_r);
+
+#ifdef HAVE_ALSA_DSD_U32
+	if (err == -EINVAL && sample_format == SampleFormat::DSD) {
+		/* many native DSD USB DACs support only
+		   DSD_U32 */
+		err = alsa_output_try_alsa_format(pcm, hwparams,
+						  IsLittleEndian()
+						  ? SND_PCM_FORMAT_DSD_U32_LE
+						  : SND_PCM_FORMAT_DSD_U32_BE,
+						  packed_r, reverse_endian_r);
+		if (err == 0)
+			*dsd_u32_r = true;
+	}
+#endif
+
+	return err;
+}
+
 /**
  * Configure a sample format, and probe other formats if that fails.
  */
 static int
 alsa_output_setup_format(snd_pcm_t *pcm, snd_pcm_hw_params_t *hwparams,
 			 AudioFormat &audio_format,
-			 bool *packed_r, bool *reverse_endian_r)
+			 bool *packed_r, bool *reverse_endian_r,
+			 bool *dsd_u32_r)
 {
 	/* try the input format first */
 
 	int err = alsa_output_try_format(pcm, hwparams,
 					 audio_format.format,
-					 packed_r, reverse_endian_r);
+					 packed_r, reverse_endian_r,
+					 dsd_u32_r);
 
 	/* if unsupported by the hardware, try other formats */
 
@@ -409,7 +496,8 @@ alsa_output_setup_format(snd_pcm_t *pcm, snd_pcm_hw_params_t *hwparams,
 			continue;
 
 		err = alsa_output_try_format(pcm, hwparams, mpd_format,
-					     packed_r, reverse_endian_r);
+					     packed_r, reverse_endian_r,
+					     dsd_u32_r);
 		if (err == 0)
 			audio_format.format = mpd_format;
 	}
@@ -423,7 +511,8 @@ alsa_output_setup_format(snd_pcm_t *pcm, snd_pcm_hw_params_t *hwparams,
  */
 static bool
 alsa_setup(AlsaOutput *ad, AudioFormat &audio_format,
-	   bool *packed_r, bool *reverse_endian_r, Error &error)
+	   bool *packed_r, bool *reverse_endian_r, bool *dsd_u32_r,
+	   Error &error)
 {
 	unsigned int sample_rate = audio_format.sample_rate;
 	unsigned int channels = audio_format.channels;
@@ -467,7 +556,8 @@ configure_hw:
 	}
 
 	err = alsa_output_setup_format(ad->pcm, hwparams, audio_format,
-				       packed_r, reverse_endian_r);
+				       packed_r, reverse_endian_r,
+				       dsd_u32_r);
 	if (err < 0) {
 		error.Format(alsa_output_domain, err,
 			     "ALSA device \"%s\" does not support format %s: %s",
@@ -494,6 +584,11 @@ configure_hw:
 	}
 	audio_format.channels = (int8_t)channels;
 
+	if (*dsd_u32_r)
+		/* each DSD_U32 frame contains 4 DSD bytes per
+		   channel */
+		sample_rate /= 4;
+
 	err = snd_pcm_hw_params_set_rate_near(ad->pcm, hwparams,
 					      &sample_rate, nullptr);
 	if (err < 0 || sample_rate == 0) {
@@ -502,7 +597,9 @@ configure_hw:
 			     alsa_device(ad), audio_format.sample_rate);
 		return false;
 	}
-	audio_format.sample_rate = sample_rate;
+	audio_format.sample_rate = *dsd_u32_r
+		? sample_rate * 4
+		: sample_rate;
 
 	snd_pcm_uframes_t buffer_size_min, buffer_size_max;
 	snd_pcm_hw_params_get_buffer_size_min(hwparams, &buffer_size_min);
@@ -588,13 +685,20 @@ configure_hw:
 	if (err < 0)
 		goto error;
 
+	/* in low latency mode, start playing as soon as the first
+	   period is there; otherwise, fill the whole buffer except for
+	   one period */
+	ad->start_threshold = ad->low_latency
+		? alsa_period_size
+		: alsa_buffer_size - alsa_period_size;
+
 	cmd = "snd_pcm_sw_params_set_start_threshold";
 	err = snd_pcm_sw_params_set_start_threshold(ad->pcm, swparams,
-						    alsa_buffer_size -
-						    alsa_period_size);
+						    ad->start_threshold);
 	if (err < 0)
 		goto error;
 
+	/* wake up once per period */
 	cmd = "snd_pcm_sw_params_set_avail_min";
 	err = snd_pcm_sw_params_set_avail_min(ad->pcm, swparams,
 					      alsa_period_size);
@@ -617,6 +721,7 @@ configure_hw:
 		   happen again. */
 		alsa_period_size = 1;
 
+	ad->buffer_frames = alsa_buffer_size;
 	ad->period_frames = alsa_period_size;
 	ad->period_position = 0;
 
@@ -650,7 +755,9 @@ alsa_setup_dsd(AlsaOutput *ad, const AudioFormat audio_format,
 
 	const AudioFormat check = usb_format;
 
-	if (!alsa_setup(ad, usb_format, packed_r, reverse_endian_r, error))
+	bool dsd_u32;
+	if (!alsa_setup(ad, usb_format, packed_r, reverse_endian_r, &dsd_u32,
+			error))
 		return false;
 
 	/* if the device allows only 32 bit, shift all DSD-over-USB
@@ -679,7 +786,7 @@ static bool
 alsa_setup_or_dsd(AlsaOutput *ad, AudioFormat &audio_format,
 		  Error &error)
 {
-	bool shift8 = false, packed, reverse_endian;
+	bool shift8 = false, packed, reverse_endian, dsd_u32 = false;
 
 	const bool dsd_usb = ad->dsd_usb &&
 		audio_format.format == SampleFormat::DSD;
@@ -688,13 +795,13 @@ alsa_setup_or_dsd(AlsaOutput *ad, AudioFormat &audio_format,
 				 &shift8, &packed, &reverse_endian,
 				 error)
 		: alsa_setup(ad, audio_format, &packed, &reverse_endian,
-			     error);
+			     &dsd_u32, error);
 	if (!success)
 		return false;
 
 	ad->pcm_export->Open(audio_format.format,
 			     audio_format.channels,
-			     dsd_usb, shift8, packed, reverse_endian);
+			     dsd_usb, dsd_u32, shift8, packed, reverse_endian);
 	return true;
 }
 
@@ -742,6 +849,8 @@ static int
 alsa_recover(AlsaOutput *ad, int err)
 {
 	if (err == -EPIPE) {
+		ad->base.stats.underruns.fetch_add(1,
+						   std::memory_order_relaxed);
 		FormatDebug(alsa_output_domain,
 			    "Underrun on ALSA device \"%s\"", alsa_device(ad));
 	} else if (err == -ESTRPIPE) {
@@ -806,10 +915,30 @@ alsa_cancel(AudioOutput *ao)
 
 	ad->period_position = 0;
 	ad->must_prepare = true;
+	ad->pcm_export->Reset();
 
 	snd_pcm_drop(ad->pcm);
 }
 
+static unsigned
+alsa_latency(AudioOutput *ao)
+{
+	AlsaOutput *ad = (AlsaOutput *)ao;
+
+	if (ad->must_prepare)
+		/* the buffer has been dropped by alsa_cancel() */
+		return 0;
+
+	snd_pcm_sframes_t delay;
+	if (snd_pcm_delay(ad->pcm, &delay) < 0 || delay <= 0)
+		return 0;
+
+	/* convert device frames to frames of MPD's audio format
+	   (they may differ, e.g. with DSD over USB) */
+	return ad->pcm_export->CalcSourceSize(delay * ad->out_frame_size)
+		/ ad->in_frame_size;
+}
+
 static void
 alsa_close(AudioOutput *ao)
 {
@@ -819,6 +948,106 @@ alsa_close(AudioOutput *ao)
 	delete[] ad->silence;
 }
 
+/**
+ * The mmap variant of alsa_play(): export the PCM data directly into
+ * the ring buffer of the ALSA device, without an intermediate
+ * buffer.
+ */
+static size_t
+alsa_play_mmap(AlsaOutput *ad, const void *chunk, size_t size,
+	       Error &error)
+{
+	/* the number of source bytes for one device frame */
+	const size_t src_frame_size =
+		ad->pcm_export->CalcSourceSize(ad->out_frame_size);
+
+	const snd_pcm_uframes_t frames = size / src_frame_size;
+	if (frames == 0) {
+		/* an incomplete device frame: DSD_U32 export keeps
+		   it for the next call, others (e.g. an odd number of
+		   DSD-over-USB frames) discard it */
+		gcc_unused const auto e =
+			ad->pcm_export->Export({chunk, size});
+		assert(e.size == 0);
+		return size;
+	}
+
+	while (true) {
+		snd_pcm_sframes_t avail = snd_pcm_avail_update(ad->pcm);
+		if (avail == 0) {
+			if (snd_pcm_state(ad->pcm) == SND_PCM_STATE_PREPARED)
+				/* the buffer is full, but playback
+				   has not been started yet */
+				avail = snd_pcm_start(ad->pcm);
+			else
+				avail = snd_pcm_wait(ad->pcm, -1);
+
+			if (avail >= 0)
+				continue;
+		}
+
+		if (avail < 0) {
+			if (avail != -EAGAIN && avail != -EINTR &&
+			    alsa_recover(ad, avail) < 0) {
+				error.Set(alsa_output_domain, avail,
+					  snd_strerror(-avail));
+				return 0;
+			}
+
+			continue;
+		}
+
+		const snd_pcm_channel_area_t *areas;
+		snd_pcm_uframes_t offset;
+		snd_pcm_uframes_t n = std::min(frames,
+					       snd_pcm_uframes_t(avail));
+		int err = snd_pcm_mmap_begin(ad->pcm, &areas, &offset, &n);
+		if (err < 0) {
+			if (alsa_recover(ad, err) < 0) {
+				error.Set(alsa_output_domain, err,
+					  snd_strerror(-err));
+				return 0;
+			}
+
+			continue;
+		}
+
+		/* the access mode is interleaved, so the first area
+		   describes all channels */
+		uint8_t *dest = (uint8_t *)areas[0].addr +
+			(areas[0].first + offset * areas[0].step) / 8;
+		ad->pcm_export->ExportTo(dest,
+					 {chunk, n * src_frame_size});
+
+		snd_pcm_sframes_t ret =
+			snd_pcm_mmap_commit(ad->pcm, offset, n);
+		if (ret < 0) {
+			if (alsa_recover(ad, ret) < 0) {
+				error.Set(alsa_output_domain, ret,
+					  snd_strerror(-ret));
+				return 0;
+			}
+
+			continue;
+		}
+
+		ad->period_position = (ad->period_position + ret)
+			% ad->period_frames;
+
+		/* unlike snd_pcm_writei(), snd_pcm_mmap_commit()
+		   does not start playback */
+		if (snd_pcm_state(ad->pcm) == SND_PCM_STATE_PREPARED &&
+		    ad->buffer_frames - (avail - ret) >= ad->start_threshold)
+			snd_pcm_start(ad->pcm);
+
+		if (snd_pcm_uframes_t(ret) < n)
+			return ad->pcm_export
+				->CalcPartialSourceSize(ret * ad->out_frame_size);
+
+		return ret * src_frame_size;
+	}
+}
+
 static size_t
 alsa_play(AudioOutput *ao, const void *chunk, size_t size,
 	  Error &error)
@@ -837,7 +1066,16 @@ alsa_play(AudioOutput *ao, const void *chunk, size_t size,
 		}
 	}
 
+	if (ad->use_mmap)
+		return alsa_play_mmap(ad, chunk, size, error);
+
+	const size_t src_size = size;
 	const auto e = ad->pcm_export->Export({chunk, size});
+	if (e.size == 0)
+		/* not enough data for one device frame; PcmExport
+		   keeps it for the next call */
+		return src_size;
+
 	chunk = e.data;
 	size = e.size;
 
@@ -851,8 +1089,14 @@ alsa_play(AudioOutput *ao, const void *chunk, size_t size,
 			ad->period_position = (ad->period_position + ret)
 				% ad->period_frames;
 
+			if (size_t(ret) == size)
+				/* this includes the bytes PcmExport
+				   keeps for the next call */
+				return src_size;
+
 			size_t bytes_written = ret * ad->out_frame_size;
-			return ad->pcm_export->CalcSourceSize(bytes_written);
+			return ad->pcm_export
+				->CalcPartialSourceSize(bytes_written);
 		}
 
 		if (ret < 0 && ret != -EAGAIN && ret != -EINTR &&
@@ -873,6 +1117,7 @@ const struct AudioOutputPlugin alsa_output_plugin = {
 	alsa_open,
 	alsa_close,
 	nullptr,
+	alsa_latency,
 	nullptr,
 	alsa_play,
 	alsa_drain,
@@ -274,6 +274,7 @@ const struct AudioOutputPlugin ao_output_plugin = {
 	ao_output_close,
 	nullptr,
 	nullptr,
+	nullptr,
 	ao_output_play,
 	nullptr,
 	nullptr,
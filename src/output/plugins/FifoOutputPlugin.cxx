@@ -22,6 +22,7 @@
 #include "config/ConfigError.hxx"
 #include "../OutputAPI.hxx"
 #include "../Timer.hxx"
+#include "../PipeWriter.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "fs/FileSystem.hxx"
 #include "util/Error.hxx"
@@ -46,6 +47,10 @@ struct FifoOutput {
 	bool created;
 	Timer *timer;
 
+	size_t batch_size;
+	bool zero_copy;
+	PipeWriter writer;
+
 	FifoOutput()
 		:base(fifo_output_plugin),
 		 path(AllocatedPath::Null()), input(-1), output(-1),
@@ -185,7 +190,9 @@ fifo_output_init(const config_param &param, Error &error)
 
 	fd->path_utf8 = fd->path.ToUTF8();
 
-	if (!fd->Initialize(param, error)) {
+	if (!fd->Initialize(param, error) ||
+	    !pipe_writer_configure(param, fd->batch_size, fd->zero_copy,
+				   error)) {
 		delete fd;
 		return nullptr;
 	}
@@ -214,6 +221,7 @@ fifo_output_open(AudioOutput *ao, AudioFormat &audio_format,
 	FifoOutput *fd = (FifoOutput *)ao;
 
 	fd->timer = new Timer(audio_format);
+	fd->writer.Open(fd->output, fd->batch_size, fd->zero_copy);
 
 	return true;
 }
@@ -223,6 +231,10 @@ fifo_output_close(AudioOutput *ao)
 {
 	FifoOutput *fd = (FifoOutput *)ao;
 
+	/* the FIFO is non-blocking; whatever doesn't fit is lost */
+	fd->writer.Flush();
+	fd->writer.Close();
+
 	delete fd->timer;
 }
 
@@ -234,6 +246,7 @@ fifo_output_cancel(AudioOutput *ao)
 	int bytes = 1;
 
 	fd->timer->Reset();
+	fd->writer.Cancel();
 
 	while (bytes > 0 && errno != EINTR)
 		bytes = read(fd->input, buf, FIFO_BUFFER_SIZE);
@@ -267,7 +280,7 @@ fifo_output_play(AudioOutput *ao, const void *chunk, size_t size,
 	fd->timer->Add(size);
 
 	while (true) {
-		bytes = write(fd->output, chunk, size);
+		bytes = fd->writer.Write(chunk, size);
 		if (bytes > 0)
 			return (size_t)bytes;
 
@@ -299,6 +312,7 @@ const struct AudioOutputPlugin fifo_output_plugin = {
 	fifo_output_close,
 	fifo_output_delay,
 	nullptr,
+	nullptr,
 	fifo_output_play,
 	nullptr,
 	fifo_output_cancel,
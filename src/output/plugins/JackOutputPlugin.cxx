@@ -32,6 +32,12 @@
 #include <jack/types.h>
 #include <jack/ringbuffer.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+
 #include <stdlib.h>
 #include <string.h>
 
@@ -200,9 +206,9 @@ set_audioformat(JackOutput *jd, AudioFormat &audio_format)
 	else if (audio_format.channels > jd->num_source_ports)
 		audio_format.channels = 2;
 
-	if (audio_format.format != SampleFormat::S16 &&
-	    audio_format.format != SampleFormat::S24_P32)
-		audio_format.format = SampleFormat::S24_P32;
+	/* JACK's native format; MPD's PCM conversion (which has SIMD
+	   code paths) converts directly to it */
+	audio_format.format = SampleFormat::FLOAT;
 }
 
 static void
@@ -618,70 +624,86 @@ mpd_jack_delay(AudioOutput *ao)
 		: 0;
 }
 
-static inline jack_default_audio_sample_t
-sample_16_to_jack(int16_t sample)
+static unsigned
+mpd_jack_latency(AudioOutput *ao)
 {
-	return sample / (jack_default_audio_sample_t)(1 << (16 - 1));
-}
+	JackOutput *jd = (JackOutput *)ao;
 
-static void
-mpd_jack_write_samples_16(JackOutput *jd, const int16_t *src,
-			  unsigned num_samples)
-{
-	jack_default_audio_sample_t sample;
-	unsigned i;
-
-	while (num_samples-- > 0) {
-		for (i = 0; i < jd->audio_format.channels; ++i) {
-			sample = sample_16_to_jack(*src++);
-			jack_ringbuffer_write(jd->ringbuffer[i],
-					      (const char *)&sample,
-					      sizeof(sample));
-		}
-	}
-}
+	if (jd->shutdown || jd->client == nullptr)
+		return 0;
 
-static inline jack_default_audio_sample_t
-sample_24_to_jack(int32_t sample)
-{
-	return sample / (jack_default_audio_sample_t)(1 << (24 - 1));
+	/* the frames waiting in the ring buffers plus the period
+	   which is being played by the JACK server */
+	return mpd_jack_available(jd) + jack_get_buffer_size(jd->client);
 }
 
+/**
+ * Copy one channel of interleaved samples into a contiguous
+ * (planar) buffer.
+ */
 static void
-mpd_jack_write_samples_24(JackOutput *jd, const int32_t *src,
-			  unsigned num_samples)
+mpd_jack_deinterleave(jack_default_audio_sample_t *dest,
+		      const jack_default_audio_sample_t *src,
+		      unsigned channels, unsigned channel, unsigned n)
 {
-	jack_default_audio_sample_t sample;
-	unsigned i;
-
-	while (num_samples-- > 0) {
-		for (i = 0; i < jd->audio_format.channels; ++i) {
-			sample = sample_24_to_jack(*src++);
-			jack_ringbuffer_write(jd->ringbuffer[i],
-					      (const char *)&sample,
-					      sizeof(sample));
+	src += channel;
+
+	if (channels == 1) {
+		std::copy_n(src, n, dest);
+		return;
+	}
+
+#ifdef __SSE2__
+	if (channels == 2) {
+		/* split four stereo frames at a time; the shuffle
+		   selector must be a constant */
+		for (; n >= 4; n -= 4, src += 8, dest += 4) {
+			const __m128 a = _mm_loadu_ps(src - channel);
+			const __m128 b = _mm_loadu_ps(src - channel + 4);
+			_mm_storeu_ps(dest, channel == 0
+				      ? _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))
+				      : _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
 		}
 	}
+#endif
+
+	for (unsigned i = 0; i < n; ++i, src += channels)
+		dest[i] = *src;
 }
 
+/**
+ * Deinterleave the samples directly into the ring buffers, without
+ * an intermediate copy.  The caller must ensure that all ring
+ * buffers have enough room.
+ */
 static void
-mpd_jack_write_samples(JackOutput *jd, const void *src,
-		       unsigned num_samples)
+mpd_jack_write_samples(JackOutput *jd,
+		       const jack_default_audio_sample_t *src,
+		       unsigned n_frames)
 {
-	switch (jd->audio_format.format) {
-	case SampleFormat::S16:
-		mpd_jack_write_samples_16(jd, (const int16_t*)src,
-					  num_samples);
-		break;
-
-	case SampleFormat::S24_P32:
-		mpd_jack_write_samples_24(jd, (const int32_t*)src,
-					  num_samples);
-		break;
-
-	default:
-		assert(false);
-		gcc_unreachable();
+	const unsigned channels = jd->audio_format.channels;
+
+	for (unsigned c = 0; c < channels; ++c) {
+		jack_ringbuffer_t *rb = jd->ringbuffer[c];
+
+		jack_ringbuffer_data_t vec[2];
+		jack_ringbuffer_get_write_vector(rb, vec);
+
+		/* the free space may wrap around the end of the ring
+		   buffer */
+		const unsigned n0 = std::min<size_t>(n_frames,
+						     vec[0].len / jack_sample_size);
+		const unsigned n1 = n_frames - n0;
+		assert(n1 <= vec[1].len / jack_sample_size);
+
+		mpd_jack_deinterleave((jack_default_audio_sample_t *)vec[0].buf,
+				      src, channels, c, n0);
+		if (n1 > 0)
+			mpd_jack_deinterleave((jack_default_audio_sample_t *)vec[1].buf,
+					      src + n0 * channels,
+					      channels, c, n1);
+
+		jack_ringbuffer_write_advance(rb, n_frames * jack_sample_size);
 	}
 }
 
@@ -726,7 +748,9 @@ mpd_jack_play(AudioOutput *ao, const void *chunk, size_t size,
 	if (space < size)
 		size = space;
 
-	mpd_jack_write_samples(jd, chunk, size);
+	mpd_jack_write_samples(jd,
+			       (const jack_default_audio_sample_t *)chunk,
+			       size);
 	return size * frame_size;
 }
 
@@ -753,6 +777,7 @@ const struct AudioOutputPlugin jack_output_plugin = {
 	mpd_jack_open,
 	mpd_jack_close,
 	mpd_jack_delay,
+	mpd_jack_latency,
 	nullptr,
 	mpd_jack_play,
 	nullptr,
@@ -21,14 +21,226 @@
 #include "NullOutputPlugin.hxx"
 #include "../OutputAPI.hxx"
 #include "../Timer.hxx"
+#include "AudioFormat.hxx"
+#include "system/Clock.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <map>
+#include <string>
+
+#include <stdint.h>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#endif
+
+static constexpr Domain null_output_domain("null_output");
+
+/**
+ * Statistics collected by the "benchmark" mode.
+ */
+struct NullBenchmark {
+	struct ThreadTime {
+		std::string name;
+		uint64_t ticks;
+	};
+
+	typedef std::map<unsigned long, ThreadTime> ThreadMap;
+
+	size_t frame_size;
+	unsigned sample_rate;
+
+	uint64_t frames;
+	unsigned n_chunks;
+
+	uint64_t start_us, last_us;
+	uint64_t min_interval_us, max_interval_us;
+
+	/**
+	 * CPU time of all MPD threads when the device was opened.
+	 */
+	ThreadMap threads;
+
+	/**
+	 * The most recently sampled CPU time of all threads.  It is
+	 * sampled once per second, because the decoder thread may
+	 * have exited already when the device gets closed.
+	 */
+	ThreadMap latest;
+
+	uint64_t next_sample_us;
+
+	void Start(const AudioFormat &audio_format);
+	void Add(size_t size);
+	void Report();
+
+	static ThreadMap ReadThreads();
+
+private:
+	void Sample();
+};
+
+NullBenchmark::ThreadMap
+NullBenchmark::ReadThreads()
+{
+	ThreadMap result;
+
+#ifdef __linux__
+	DIR *dir = opendir("/proc/self/task");
+	if (dir == nullptr)
+		return result;
+
+	const struct dirent *ent;
+	while ((ent = readdir(dir)) != nullptr) {
+		if (ent->d_name[0] == '.')
+			continue;
+
+		char path[320], buffer[512];
+		snprintf(path, sizeof(path), "/proc/self/task/%s/stat",
+			 ent->d_name);
+		FILE *file = fopen(path, "r");
+		if (file == nullptr)
+			continue;
+
+		size_t length = fread(buffer, 1, sizeof(buffer) - 1, file);
+		fclose(file);
+		buffer[length] = 0;
+
+		/* the thread name is enclosed in parentheses and may
+		   contain spaces; parse the fields after it */
+		const char *open = strchr(buffer, '(');
+		const char *close = strrchr(buffer, ')');
+		if (open == nullptr || close == nullptr || close < open)
+			continue;
+
+		unsigned long utime, stime;
+		if (sscanf(close + 1,
+			   " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u"
+			   " %lu %lu", &utime, &stime) != 2)
+			continue;
+
+		ThreadTime &t = result[strtoul(ent->d_name, nullptr, 10)];
+		t.name.assign(open + 1, close);
+		t.ticks = uint64_t(utime) + stime;
+	}
+
+	closedir(dir);
+#endif
+
+	return result;
+}
+
+void
+NullBenchmark::Start(const AudioFormat &audio_format)
+{
+	frame_size = audio_format.GetFrameSize();
+	sample_rate = audio_format.sample_rate;
+	frames = 0;
+	n_chunks = 0;
+	min_interval_us = max_interval_us = 0;
+	threads = latest = ReadThreads();
+	start_us = last_us = MonotonicClockUS();
+	next_sample_us = start_us + 1000000;
+}
+
+void
+NullBenchmark::Sample()
+{
+	for (auto &i : ReadThreads())
+		latest[i.first] = std::move(i.second);
+}
+
+inline void
+NullBenchmark::Add(size_t size)
+{
+	const uint64_t now = MonotonicClockUS();
+
+	if (n_chunks > 0) {
+		const uint64_t interval = now - last_us;
+		if (n_chunks == 1 || interval < min_interval_us)
+			min_interval_us = interval;
+		if (interval > max_interval_us)
+			max_interval_us = interval;
+	}
+
+	last_us = now;
+	++n_chunks;
+
+	if (now >= next_sample_us) {
+		Sample();
+		next_sample_us = now + 1000000;
+	}
+	frames += size / frame_size;
+}
+
+void
+NullBenchmark::Report()
+{
+	const double wall = (last_us - start_us) / 1000000.;
+	const double duration = double(frames) / sample_rate;
+
+	FormatDefault(null_output_domain,
+		      "benchmark: %llu frames in %.3f s: %.0f frames/s, "
+		      "%.1fx real time",
+		      (unsigned long long)frames, wall,
+		      wall > 0 ? frames / wall : 0.,
+		      wall > 0 ? duration / wall : 0.);
+
+	if (n_chunks > 1)
+		FormatDefault(null_output_domain,
+			      "benchmark: %u chunks, interval "
+			      "min=%.3f avg=%.3f max=%.3f ms",
+			      n_chunks, min_interval_us / 1000.,
+			      (last_us - start_us) / 1000. / (n_chunks - 1),
+			      max_interval_us / 1000.);
+
+#ifdef __linux__
+	const long ticks_per_second = sysconf(_SC_CLK_TCK);
+	if (ticks_per_second <= 0)
+		return;
+
+	Sample();
+
+	for (const auto &i : latest) {
+		uint64_t ticks = i.second.ticks;
+		const auto old = threads.find(i.first);
+		if (old != threads.end())
+			ticks -= std::min(ticks, old->second.ticks);
+
+		if (ticks == 0)
+			continue;
+
+		const double cpu = double(ticks) / ticks_per_second;
+		FormatDefault(null_output_domain,
+			      "benchmark: thread %s: %.2f s CPU (%.1f%%)",
+			      i.second.name.c_str(), cpu,
+			      wall > 0 ? cpu * 100 / wall : 0.);
+	}
+#endif
+}
+
 
 struct NullOutput {
 	AudioOutput base;
 
 	bool sync;
 
+	/**
+	 * Accept data as fast as possible and log throughput
+	 * statistics when the device is closed?
+	 */
+	bool benchmark;
+
 	Timer *timer;
 
+	NullBenchmark stats;
+
 	NullOutput()
 		:base(null_output_plugin) {}
 
@@ -47,7 +259,8 @@ null_init(const config_param &param, Error &error)
 		return nullptr;
 	}
 
-	nd->sync = param.GetBlockValue("sync", true);
+	nd->benchmark = param.GetBlockValue("benchmark", false);
+	nd->sync = !nd->benchmark && param.GetBlockValue("sync", true);
 
 	return &nd->base;
 }
@@ -69,6 +282,9 @@ null_open(AudioOutput *ao, AudioFormat &audio_format,
 	if (nd->sync)
 		nd->timer = new Timer(audio_format);
 
+	if (nd->benchmark)
+		nd->stats.Start(audio_format);
+
 	return true;
 }
 
@@ -79,6 +295,9 @@ null_close(AudioOutput *ao)
 
 	if (nd->sync)
 		delete nd->timer;
+
+	if (nd->benchmark)
+		nd->stats.Report();
 }
 
 static unsigned
@@ -98,6 +317,9 @@ null_play(AudioOutput *ao, gcc_unused const void *chunk, size_t size,
 	NullOutput *nd = (NullOutput *)ao;
 	Timer *timer = nd->timer;
 
+	if (nd->benchmark)
+		nd->stats.Add(size);
+
 	if (!nd->sync)
 		return size;
 
@@ -130,6 +352,7 @@ const struct AudioOutputPlugin null_output_plugin = {
 	null_close,
 	null_delay,
 	nullptr,
+	nullptr,
 	null_play,
 	nullptr,
 	null_cancel,
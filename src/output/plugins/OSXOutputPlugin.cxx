@@ -423,6 +423,7 @@ const struct AudioOutputPlugin osx_output_plugin = {
 	osx_output_close,
 	nullptr,
 	nullptr,
+	nullptr,
 	osx_output_play,
 	nullptr,
 	osx_output_cancel,
@@ -525,7 +525,7 @@ oss_probe_sample_format(int fd, SampleFormat sample_format,
 	*oss_format_r = oss_format;
 
 #ifdef AFMT_S24_PACKED
-	pcm_export.Open(sample_format, 0, false, false,
+	pcm_export.Open(sample_format, 0, false, false, false,
 			oss_format == AFMT_S24_PACKED,
 			oss_format == AFMT_S24_PACKED &&
 			!IsLittleEndian());
@@ -766,6 +766,7 @@ const struct AudioOutputPlugin oss_output_plugin = {
 	oss_output_close,
 	nullptr,
 	nullptr,
+	nullptr,
 	oss_output_play,
 	nullptr,
 	oss_output_cancel,
@@ -20,6 +20,7 @@
 #include "config.h"
 #include "PipeOutputPlugin.hxx"
 #include "../OutputAPI.hxx"
+#include "../PipeWriter.hxx"
 #include "config/ConfigError.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
@@ -27,6 +28,8 @@
 #include <string>
 
 #include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
 
 struct PipeOutput {
 	AudioOutput base;
@@ -34,6 +37,15 @@ struct PipeOutput {
 	std::string cmd;
 	FILE *fh;
 
+	size_t batch_size;
+	bool zero_copy;
+
+	/**
+	 * Writes to the file descriptor of #fh, bypassing stdio's
+	 * buffer.
+	 */
+	PipeWriter writer;
+
 	PipeOutput()
 		:base(pipe_output_plugin) {}
 
@@ -56,7 +68,7 @@ PipeOutput::Configure(const config_param &param, Error &error)
 		return false;
 	}
 
-	return true;
+	return pipe_writer_configure(param, batch_size, zero_copy, error);
 }
 
 static AudioOutput *
@@ -99,6 +111,7 @@ pipe_output_open(AudioOutput *ao,
 		return false;
 	}
 
+	pd->writer.Open(fileno(pd->fh), pd->batch_size, pd->zero_copy);
 	return true;
 }
 
@@ -107,6 +120,9 @@ pipe_output_close(AudioOutput *ao)
 {
 	PipeOutput *pd = (PipeOutput *)ao;
 
+	pd->writer.Flush();
+	pd->writer.Close();
+
 	pclose(pd->fh);
 }
 
@@ -115,13 +131,18 @@ pipe_output_play(AudioOutput *ao, const void *chunk, size_t size,
 		 Error &error)
 {
 	PipeOutput *pd = (PipeOutput *)ao;
-	size_t ret;
 
-	ret = fwrite(chunk, 1, size, pd->fh);
-	if (ret == 0)
-		error.SetErrno("Write error on pipe");
+	while (true) {
+		ssize_t nbytes = pd->writer.Write(chunk, size);
+		if (nbytes > 0)
+			return nbytes;
 
-	return ret;
+		if (nbytes < 0 && errno == EINTR)
+			continue;
+
+		error.SetErrno("Write error on pipe");
+		return 0;
+	}
 }
 
 const struct AudioOutputPlugin pipe_output_plugin = {
@@ -135,6 +156,7 @@ const struct AudioOutputPlugin pipe_output_plugin = {
 	pipe_output_close,
 	nullptr,
 	nullptr,
+	nullptr,
 	pipe_output_play,
 	nullptr,
 	nullptr,
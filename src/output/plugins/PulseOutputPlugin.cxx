@@ -34,9 +34,13 @@
 #include <pulse/error.h>
 #include <pulse/version.h>
 
+#include <algorithm>
+
 #include <assert.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define MPD_PULSE_NAME "Music Player Daemon"
 
@@ -55,6 +59,21 @@ struct PulseOutput {
 
 	size_t writable;
 
+	/**
+	 * The requested size of the server's buffer ("buffer_time"
+	 * setting) [us].  Zero means the server's default.
+	 */
+	unsigned buffer_time;
+
+	/**
+	 * A buffer obtained from pa_stream_begin_write(), which is
+	 * filled by several pulse_output_play() calls and committed
+	 * when it is full.  This saves a copy inside libpulse and
+	 * reduces the number of writes.
+	 */
+	void *write_buffer;
+	size_t write_size, write_position;
+
 	PulseOutput()
 		:base(pulse_output_plugin) {}
 };
@@ -267,6 +286,9 @@ pulse_output_delete_stream(PulseOutput *po)
 	pa_stream_disconnect(po->stream);
 	pa_stream_unref(po->stream);
 	po->stream = nullptr;
+
+	/* the pending buffer was owned by the stream */
+	po->write_buffer = nullptr;
 }
 
 /**
@@ -338,11 +360,13 @@ pulse_output_init(const config_param &param, Error &error)
 	po->name = param.GetBlockValue("name", "mpd_pulse");
 	po->server = param.GetBlockValue("server");
 	po->sink = param.GetBlockValue("sink");
+	po->buffer_time = param.GetBlockValue("buffer_time", 0u);
 
 	po->mixer = nullptr;
 	po->mainloop = nullptr;
 	po->context = nullptr;
 	po->stream = nullptr;
+	po->write_buffer = nullptr;
 
 	return &po->base;
 }
@@ -508,7 +532,11 @@ pulse_output_stream_write_cb(gcc_unused pa_stream *stream, size_t nbytes,
 
 	assert(po->mainloop != nullptr);
 
-	po->writable = nbytes;
+	/* the server doesn't know about the data which is still in
+	   our pending buffer */
+	po->writable = po->write_buffer != nullptr
+		? nbytes - std::min(nbytes, po->write_position)
+		: nbytes;
 	pa_threaded_mainloop_signal(po->mainloop, 0);
 }
 
@@ -595,8 +623,27 @@ pulse_output_open(AudioOutput *ao, AudioFormat &audio_format,
 
 	/* .. and connect it (asynchronously) */
 
+	/* let libpulse maintain timing information, which is needed
+	   by pulse_output_latency() */
+	int flags = PA_STREAM_INTERPOLATE_TIMING|PA_STREAM_AUTO_TIMING_UPDATE;
+
+	pa_buffer_attr attr;
+	if (po->buffer_time > 0) {
+		/* let the server size its buffer for the configured
+		   latency; the other values are chosen by the
+		   server */
+		attr.maxlength = (uint32_t)-1;
+		attr.tlength = pa_usec_to_bytes(po->buffer_time, &ss);
+		attr.prebuf = (uint32_t)-1;
+		attr.minreq = (uint32_t)-1;
+		attr.fragsize = (uint32_t)-1;
+
+		flags |= PA_STREAM_ADJUST_LATENCY;
+	}
+
 	if (pa_stream_connect_playback(po->stream, po->sink,
-				       nullptr, pa_stream_flags_t(0),
+				       po->buffer_time > 0 ? &attr : nullptr,
+				       pa_stream_flags_t(flags),
 				       nullptr, nullptr) < 0) {
 		pulse_output_delete_stream(po);
 
@@ -611,6 +658,48 @@ pulse_output_open(AudioOutput *ao, AudioFormat &audio_format,
 	return true;
 }
 
+/**
+ * Submit the pending buffer to the server.  The mainloop must be
+ * locked before calling this function.
+ *
+ * @return true on success, false on error
+ */
+static bool
+pulse_output_commit(PulseOutput *po, Error &error)
+{
+	if (po->write_buffer == nullptr)
+		return true;
+
+	void *data = po->write_buffer;
+	po->write_buffer = nullptr;
+
+	if (po->write_position == 0) {
+		pa_stream_cancel_write(po->stream);
+		return true;
+	}
+
+	if (pa_stream_write(po->stream, data, po->write_position, nullptr,
+			    0, PA_SEEK_RELATIVE) < 0) {
+		SetError(error, po->context, "pa_stream_write() failed");
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Discard the pending buffer.  The mainloop must be locked before
+ * calling this function.
+ */
+static void
+pulse_output_cancel_write(PulseOutput *po)
+{
+	if (po->write_buffer != nullptr) {
+		pa_stream_cancel_write(po->stream);
+		po->write_buffer = nullptr;
+	}
+}
+
 static void
 pulse_output_close(AudioOutput *ao)
 {
@@ -622,6 +711,10 @@ pulse_output_close(AudioOutput *ao)
 	pa_threaded_mainloop_lock(po->mainloop);
 
 	if (pa_stream_get_state(po->stream) == PA_STREAM_READY) {
+		Error error;
+		if (!pulse_output_commit(po, error))
+			LogError(error);
+
 		o = pa_stream_drain(po->stream,
 				    pulse_output_stream_success_cb, po);
 		if (o == nullptr) {
@@ -715,6 +808,33 @@ pulse_output_delay(AudioOutput *ao)
 	return result;
 }
 
+static unsigned
+pulse_output_latency(AudioOutput *ao)
+{
+	PulseOutput *po = (PulseOutput *)ao;
+	unsigned result = 0;
+
+	pa_threaded_mainloop_lock(po->mainloop);
+
+	pa_usec_t usec;
+	int negative;
+	if (po->stream != nullptr &&
+	    pa_stream_get_state(po->stream) == PA_STREAM_READY &&
+	    pa_stream_get_latency(po->stream, &usec, &negative) == 0 &&
+	    !negative) {
+		const pa_sample_spec *ss =
+			pa_stream_get_sample_spec(po->stream);
+		result = usec * ss->rate / PA_USEC_PER_SEC;
+
+		if (po->write_buffer != nullptr)
+			result += po->write_position / pa_frame_size(ss);
+	}
+
+	pa_threaded_mainloop_unlock(po->mainloop);
+
+	return result;
+}
+
 static size_t
 pulse_output_play(AudioOutput *ao, const void *chunk, size_t size,
 		  Error &error)
@@ -746,6 +866,12 @@ pulse_output_play(AudioOutput *ao, const void *chunk, size_t size,
 	/* wait until the server allows us to write */
 
 	while (po->writable == 0) {
+		/* the server may be waiting for the pending buffer */
+		if (!pulse_output_commit(po, error)) {
+			pa_threaded_mainloop_unlock(po->mainloop);
+			return 0;
+		}
+
 		if (pa_stream_is_suspended(po->stream)) {
 			pa_threaded_mainloop_unlock(po->mainloop);
 			error.Set(pulse_output_domain, "suspended");
@@ -761,22 +887,57 @@ pulse_output_play(AudioOutput *ao, const void *chunk, size_t size,
 		}
 	}
 
-	/* now write */
+	/* obtain a buffer from libpulse, large enough for what the
+	   server has requested, but not more than 100 ms, to avoid
+	   holding back data while the server's buffer runs low */
 
+	if (po->write_buffer == nullptr) {
+		const pa_sample_spec *ss =
+			pa_stream_get_sample_spec(po->stream);
+		const size_t frame_size = pa_frame_size(ss);
+
+		size_t nbytes = std::min(po->writable,
+					 pa_usec_to_bytes(100000, ss));
+		if (pa_stream_begin_write(po->stream, &po->write_buffer,
+					  &nbytes) < 0) {
+			po->write_buffer = nullptr;
+			pa_threaded_mainloop_unlock(po->mainloop);
+			SetError(error, po->context,
+				 "pa_stream_begin_write() failed");
+			return 0;
+		}
+
+		po->write_size = nbytes - nbytes % frame_size;
+		po->write_position = 0;
+
+		if (po->write_size == 0) {
+			pulse_output_cancel_write(po);
+			pa_threaded_mainloop_unlock(po->mainloop);
+			error.Set(pulse_output_domain,
+				  "pa_stream_begin_write() returned no buffer");
+			return 0;
+		}
+	}
+
+	/* now copy into the buffer, and submit it when it's full */
+
+	size = std::min(size, po->write_size - po->write_position);
 	if (size > po->writable)
 		/* don't send more than possible */
 		size = po->writable;
 
+	memcpy((uint8_t *)po->write_buffer + po->write_position,
+	       chunk, size);
+	po->write_position += size;
 	po->writable -= size;
 
-	int result = pa_stream_write(po->stream, chunk, size, nullptr,
-				     0, PA_SEEK_RELATIVE);
-	pa_threaded_mainloop_unlock(po->mainloop);
-	if (result < 0) {
-		SetError(error, po->context, "pa_stream_write() failed");
+	if (po->write_position == po->write_size &&
+	    !pulse_output_commit(po, error)) {
+		pa_threaded_mainloop_unlock(po->mainloop);
 		return 0;
 	}
 
+	pa_threaded_mainloop_unlock(po->mainloop);
 	return size;
 }
 
@@ -791,6 +952,8 @@ pulse_output_cancel(AudioOutput *ao)
 
 	pa_threaded_mainloop_lock(po->mainloop);
 
+	pulse_output_cancel_write(po);
+
 	if (pa_stream_get_state(po->stream) != PA_STREAM_READY) {
 		/* no need to flush when the stream isn't connected
 		   yet */
@@ -875,6 +1038,7 @@ const struct AudioOutputPlugin pulse_output_plugin = {
 	pulse_output_open,
 	pulse_output_close,
 	pulse_output_delay,
+	pulse_output_latency,
 	nullptr,
 	pulse_output_play,
 	nullptr,
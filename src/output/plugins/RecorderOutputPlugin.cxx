@@ -19,16 +19,22 @@
 
 #include "config.h"
 #include "RecorderOutputPlugin.hxx"
+#include "RecorderWriter.hxx"
 #include "../OutputAPI.hxx"
 #include "encoder/EncoderPlugin.hxx"
 #include "encoder/EncoderList.hxx"
+#include "encoder/SharedEncoder.hxx"
+#include "encoder/ThreadedEncoder.hxx"
 #include "config/ConfigError.hxx"
 #include "util/Error.hxx"
-#include "util/Domain.hxx"
 #include "system/fd_util.h"
 #include "open.h"
 
+#include <string>
+
 #include <assert.h>
+#include <string.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -43,14 +49,63 @@ struct RecorderOutput {
 	Encoder *encoder;
 
 	/**
-	 * The destination file name.
+	 * The destination file name.  If rotation is enabled, this
+	 * is a strftime() template.
 	 */
 	const char *path;
 
 	/**
-	 * The destination file descriptor.
+	 * Start a new file when the system clock passes a multiple
+	 * of this number of seconds since the epoch.  0 disables
+	 * time based rotation.
+	 */
+	unsigned rotate_time;
+
+	/**
+	 * Start a new file after this number of bytes have been
+	 * written to the current one.  0 disables size based
+	 * rotation.
+	 */
+	uint64_t rotate_size;
+
+	/**
+	 * The maximum number of bytes queued for the writer thread.
+	 */
+	size_t queue_size;
+
+	/**
+	 * The writer thread which owns the destination file.
+	 */
+	RecorderWriter writer;
+
+	/**
+	 * The audio format passed to encoder_open(); needed to
+	 * reopen the encoder for a new file.
+	 */
+	AudioFormat audio_format;
+
+	/**
+	 * Is the encoder open?  It is closed when Rotate() fails to
+	 * reopen it.
+	 */
+	bool encoder_opened;
+
+	/**
+	 * The name of the current file, i.e. #path expanded by
+	 * strftime().
+	 */
+	std::string current_path;
+
+	/**
+	 * The value of time()/#rotate_time when the current file was
+	 * created.
+	 */
+	time_t segment;
+
+	/**
+	 * The number of bytes written to the current file.
 	 */
-	int fd;
+	uint64_t segment_size;
 
 	/**
 	 * The buffer for encoder_read().
@@ -66,7 +121,26 @@ struct RecorderOutput {
 
 	bool Configure(const config_param &param, Error &error);
 
-	bool WriteToFile(const void *data, size_t length, Error &error);
+	bool IsRotating() const {
+		return rotate_time > 0 || rotate_size > 0;
+	}
+
+	/**
+	 * Expand #path for a file created at the specified time.
+	 */
+	std::string MakePath(time_t t) const;
+
+	/**
+	 * Is it time to start a new file?
+	 */
+	gcc_pure
+	bool NeedRotate(time_t now) const;
+
+	/**
+	 * Finish the current file and start a new one with a fresh
+	 * encoder stream.
+	 */
+	bool Rotate(time_t now, Error &error);
 
 	/**
 	 * Writes pending data from the encoder to the output file.
@@ -74,8 +148,6 @@ struct RecorderOutput {
 	bool EncoderToFile(Error &error);
 };
 
-static constexpr Domain recorder_output_domain("recorder_output");
-
 inline bool
 RecorderOutput::Configure(const config_param &param, Error &error)
 {
@@ -96,12 +168,54 @@ RecorderOutput::Configure(const config_param &param, Error &error)
 		return false;
 	}
 
+	rotate_time = param.GetBlockValue("rotate_time", 0u);
+	rotate_size = uint64_t(param.GetBlockValue("rotate_size", 0u))
+		* 1024;
+
+	if (IsRotating() && strchr(path, '%') == nullptr) {
+		error.Set(config_domain,
+			  "'path' must be a strftime() template "
+			  "when rotation is enabled");
+		return false;
+	}
+
+	queue_size = param.GetBlockValue("queue_size", 4096u) * size_t(1024);
+	if (queue_size == 0) {
+		error.Set(config_domain, "'queue_size' must not be 0");
+		return false;
+	}
+
 	/* initialize encoder */
 
-	encoder = encoder_init(*encoder_plugin, param, error);
+	const char *shared_encoder = param.GetBlockValue("shared_encoder");
+	if (shared_encoder != nullptr && IsRotating()) {
+		/* rotating restarts the encoder stream, which would
+		   affect all other users of the shared encoder */
+		error.Set(config_domain,
+			  "'shared_encoder' cannot be combined with "
+			  "rotation");
+		return false;
+	}
+
+	const bool encoder_thread =
+		param.GetBlockValue("encoder_thread", false);
+	if (encoder_thread && shared_encoder != nullptr) {
+		error.Set(config_domain,
+			  "'encoder_thread' cannot be combined with "
+			  "'shared_encoder'");
+		return false;
+	}
+
+	encoder = shared_encoder != nullptr
+		? shared_encoder_init(shared_encoder, *encoder_plugin,
+				      param, error)
+		: encoder_init(*encoder_plugin, param, error);
 	if (encoder == nullptr)
 		return false;
 
+	if (encoder_thread)
+		encoder = threaded_encoder_init(encoder);
+
 	return true;
 }
 
@@ -133,47 +247,81 @@ recorder_output_finish(AudioOutput *ao)
 }
 
 inline bool
-RecorderOutput::WriteToFile(const void *_data, size_t length, Error &error)
+RecorderOutput::EncoderToFile(Error &error)
 {
-	assert(length > 0);
+	while (true) {
+		/* read from the encoder */
+
+		size_t size = encoder_read(encoder, buffer, sizeof(buffer));
+		if (size == 0)
+			return true;
 
-	const uint8_t *data = (const uint8_t *)_data, *end = data + length;
+		/* hand everything to the writer thread */
 
-	while (true) {
-		ssize_t nbytes = write(fd, data, end - data);
-		if (nbytes > 0) {
-			data += nbytes;
-			if (data == end)
-				return true;
-		} else if (nbytes == 0) {
-			/* shouldn't happen for files */
-			error.Set(recorder_output_domain,
-				  "write() returned 0");
+		if (!writer.Write(buffer, size, error))
 			return false;
-		} else if (errno != EINTR) {
-			error.FormatErrno("Failed to write to '%s'", path);
-			return false;
-		}
+
+		segment_size += size;
 	}
 }
 
+std::string
+RecorderOutput::MakePath(time_t t) const
+{
+	if (!IsRotating())
+		return path;
+
+	struct tm tm;
+	char name[4096];
+	if (localtime_r(&t, &tm) == nullptr ||
+	    strftime(name, sizeof(name), path, &tm) == 0)
+		return path;
+
+	return name;
+}
+
 inline bool
-RecorderOutput::EncoderToFile(Error &error)
+RecorderOutput::NeedRotate(time_t now) const
 {
-	assert(fd >= 0);
+	return (rotate_time > 0 && now / rotate_time != segment) ||
+		(rotate_size > 0 && segment_size >= rotate_size);
+}
 
-	while (true) {
-		/* read from the encoder */
+inline bool
+RecorderOutput::Rotate(time_t now, Error &error)
+{
+	if (rotate_time > 0)
+		segment = now / rotate_time;
 
-		size_t size = encoder_read(encoder, buffer, sizeof(buffer));
-		if (size == 0)
-			return true;
+	std::string new_path = MakePath(now);
+	if (new_path == current_path)
+		/* the template does not yield a new name yet; keep
+		   writing to the current file instead of truncating
+		   it */
+		return true;
 
-		/* write everything into the file */
+	/* finish the current stream */
 
-		if (!WriteToFile(buffer, size, error))
-			return false;
-	}
+	if (!encoder_end(encoder, error) || !EncoderToFile(error))
+		return false;
+
+	encoder_close(encoder);
+	encoder_opened = false;
+
+	/* start a new file with a new stream */
+
+	if (!encoder_open(encoder, audio_format, error))
+		return false;
+
+	encoder_opened = true;
+
+	if (!writer.Rotate(new_path.c_str(), error))
+		return false;
+
+	current_path = std::move(new_path);
+	segment_size = 0;
+
+	return EncoderToFile(error);
 }
 
 static bool
@@ -183,28 +331,45 @@ recorder_output_open(AudioOutput *ao,
 {
 	RecorderOutput *recorder = (RecorderOutput *)ao;
 
+	const time_t now = time(nullptr);
+	recorder->current_path = recorder->MakePath(now);
+	recorder->segment = recorder->rotate_time > 0
+		? now / recorder->rotate_time
+		: 0;
+	recorder->segment_size = 0;
+
 	/* create the output file */
 
-	recorder->fd = open_cloexec(recorder->path,
-				    O_CREAT|O_WRONLY|O_TRUNC|O_BINARY,
-				    0666);
-	if (recorder->fd < 0) {
-		error.FormatErrno("Failed to create '%s'", recorder->path);
+	const char *path = recorder->current_path.c_str();
+	int fd = open_cloexec(path, O_CREAT|O_WRONLY|O_TRUNC|O_BINARY,
+			      0666);
+	if (fd < 0) {
+		error.FormatErrno("Failed to create '%s'", path);
 		return false;
 	}
 
 	/* open the encoder */
 
 	if (!encoder_open(recorder->encoder, audio_format, error)) {
-		close(recorder->fd);
-		unlink(recorder->path);
+		close(fd);
+		unlink(path);
+		return false;
+	}
+
+	recorder->audio_format = audio_format;
+	recorder->encoder_opened = true;
+
+	if (!recorder->writer.Start(fd, path, recorder->queue_size,
+				    error)) {
+		encoder_close(recorder->encoder);
+		unlink(path);
 		return false;
 	}
 
 	if (!recorder->EncoderToFile(error)) {
 		encoder_close(recorder->encoder);
-		close(recorder->fd);
-		unlink(recorder->path);
+		recorder->writer.Stop();
+		unlink(path);
 		return false;
 	}
 
@@ -216,16 +381,18 @@ recorder_output_close(AudioOutput *ao)
 {
 	RecorderOutput *recorder = (RecorderOutput *)ao;
 
-	/* flush the encoder and write the rest to the file */
+	if (recorder->encoder_opened) {
+		/* flush the encoder and write the rest to the file */
 
-	if (encoder_end(recorder->encoder, IgnoreError()))
-		recorder->EncoderToFile(IgnoreError());
+		if (encoder_end(recorder->encoder, IgnoreError()))
+			recorder->EncoderToFile(IgnoreError());
 
-	/* now really close everything */
+		/* now really close everything */
 
-	encoder_close(recorder->encoder);
+		encoder_close(recorder->encoder);
+	}
 
-	close(recorder->fd);
+	recorder->writer.Stop();
 }
 
 static size_t
@@ -234,6 +401,13 @@ recorder_output_play(AudioOutput *ao, const void *chunk, size_t size,
 {
 	RecorderOutput *recorder = (RecorderOutput *)ao;
 
+	if (recorder->IsRotating()) {
+		const time_t now = time(nullptr);
+		if (recorder->NeedRotate(now) &&
+		    !recorder->Rotate(now, error))
+			return 0;
+	}
+
 	return encoder_write(recorder->encoder, chunk, size, error) &&
 		recorder->EncoderToFile(error)
 		? size : 0;
@@ -250,6 +424,7 @@ const struct AudioOutputPlugin recorder_output_plugin = {
 	recorder_output_close,
 	nullptr,
 	nullptr,
+	nullptr,
 	recorder_output_play,
 	nullptr,
 	nullptr,
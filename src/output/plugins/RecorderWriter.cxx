@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "RecorderWriter.hxx"
+#include "thread/Name.hxx"
+#include "util/Domain.hxx"
+#include "system/fd_util.h"
+#include "open.h"
+
+#include <assert.h>
+#include <unistd.h>
+#include <errno.h>
+
+static constexpr Domain recorder_writer_domain("recorder_writer");
+
+bool
+RecorderWriter::Start(int _fd, const char *_path, size_t _max_size,
+		      Error &error_r)
+{
+	assert(_fd >= 0);
+	assert(fd < 0);
+	assert(_max_size > 0);
+
+	fd = _fd;
+	path = _path;
+	max_size = _max_size;
+	queued = 0;
+	quit = false;
+	error.Clear();
+
+	if (!thread.Start(Run, this, error_r)) {
+		close(fd);
+		fd = -1;
+		return false;
+	}
+
+	return true;
+}
+
+void
+RecorderWriter::Stop()
+{
+	mutex.lock();
+	quit = true;
+	cond.signal();
+	mutex.unlock();
+
+	thread.Join();
+
+	assert(queue.empty());
+
+	if (fd >= 0) {
+		close(fd);
+		fd = -1;
+	}
+}
+
+bool
+RecorderWriter::CheckError(Error &error_r)
+{
+	if (!error.IsDefined())
+		return true;
+
+	error_r.Set(error);
+	return false;
+}
+
+bool
+RecorderWriter::Write(const void *data, size_t size, Error &error_r)
+{
+	assert(size > 0);
+
+	const ScopeLock protect(mutex);
+
+	while (queued > 0 && queued + size > max_size) {
+		if (!CheckError(error_r))
+			return false;
+
+		/* the queue is full: wait for the thread to catch
+		   up */
+		client_cond.wait(mutex);
+	}
+
+	if (!CheckError(error_r))
+		return false;
+
+	if (queue.empty()) {
+		queue.emplace();
+		cond.signal();
+	}
+
+	/* append to the last block, which is not yet being written
+	   by the thread */
+	std::vector<uint8_t> &dest = queue.back().data;
+	const uint8_t *p = (const uint8_t *)data;
+	dest.insert(dest.end(), p, p + size);
+	queued += size;
+
+	return true;
+}
+
+bool
+RecorderWriter::Rotate(const char *new_path, Error &error_r)
+{
+	assert(new_path != nullptr);
+	assert(*new_path != 0);
+
+	const ScopeLock protect(mutex);
+
+	if (!CheckError(error_r))
+		return false;
+
+	queue.emplace();
+	queue.back().path = new_path;
+	cond.signal();
+	return true;
+}
+
+inline void
+RecorderWriter::OpenFile(const std::string &new_path)
+{
+	if (fd >= 0)
+		close(fd);
+
+	path = new_path;
+	fd = open_cloexec(path.c_str(),
+			  O_CREAT|O_WRONLY|O_TRUNC|O_BINARY,
+			  0666);
+	if (fd < 0) {
+		const ScopeLock protect(mutex);
+		if (!error.IsDefined())
+			error.FormatErrno("Failed to create '%s'",
+					  path.c_str());
+	}
+}
+
+inline void
+RecorderWriter::WriteFile(const uint8_t *data, size_t size)
+{
+	const uint8_t *end = data + size;
+
+	while (data != end) {
+		ssize_t nbytes = write(fd, data, end - data);
+		if (nbytes > 0) {
+			data += nbytes;
+			continue;
+		}
+
+		if (nbytes < 0 && errno == EINTR)
+			continue;
+
+		const ScopeLock protect(mutex);
+		if (error.IsDefined())
+			/* already failed before */
+			;
+		else if (nbytes == 0)
+			/* shouldn't happen for files */
+			error.Set(recorder_writer_domain,
+				  "write() returned 0");
+		else
+			error.FormatErrno("Failed to write to '%s'",
+					  path.c_str());
+
+		/* discard the rest of this file */
+		close(fd);
+		fd = -1;
+		return;
+	}
+}
+
+inline void
+RecorderWriter::Run()
+{
+	SetThreadName("recorder");
+
+	mutex.lock();
+
+	while (true) {
+		if (queue.empty()) {
+			if (quit)
+				break;
+
+			cond.wait(mutex);
+			continue;
+		}
+
+		Block block(std::move(queue.front()));
+		queue.pop();
+		mutex.unlock();
+
+		if (!block.path.empty())
+			OpenFile(block.path);
+
+		if (fd >= 0 && !block.data.empty())
+			WriteFile(block.data.data(), block.data.size());
+
+		mutex.lock();
+		queued -= block.data.size();
+		client_cond.signal();
+	}
+
+	mutex.unlock();
+}
+
+void
+RecorderWriter::Run(void *ctx)
+{
+	RecorderWriter &w = *(RecorderWriter *)ctx;
+	w.Run();
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_RECORDER_WRITER_HXX
+#define MPD_RECORDER_WRITER_HXX
+
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "util/Error.hxx"
+
+#include <string>
+#include <vector>
+#include <queue>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Writes the output of the "recorder" plugin to disk in a separate
+ * thread, so a slow disk does not stall the output thread.  The data
+ * is queued in memory; only when the queue is full, Write() blocks
+ * until the thread has caught up.
+ */
+class RecorderWriter {
+	struct Block {
+		/**
+		 * If not empty, then the current file is closed and
+		 * this file is created before #data is written.
+		 */
+		std::string path;
+
+		std::vector<uint8_t> data;
+	};
+
+	/**
+	 * The maximum number of bytes in the queue.
+	 */
+	size_t max_size;
+
+	Thread thread;
+
+	/**
+	 * This mutex protects #queue, #queued, #quit and #error.
+	 */
+	Mutex mutex;
+
+	/**
+	 * Wakes up the writer thread.
+	 */
+	Cond cond;
+
+	/**
+	 * Wakes up Write() after the writer thread has made room in
+	 * the queue.
+	 */
+	Cond client_cond;
+
+	std::queue<Block> queue;
+
+	/**
+	 * The number of data bytes in #queue plus the size of the
+	 * block being written by the thread.
+	 */
+	size_t queued;
+
+	bool quit;
+
+	/**
+	 * The first error of the writer thread; it is reported by the
+	 * next Write() or Rotate() call.
+	 */
+	Error error;
+
+	/**
+	 * The file descriptor written by the thread.
+	 */
+	int fd;
+
+	/**
+	 * The name of the file #fd refers to.  Only used by the
+	 * thread, for error messages.
+	 */
+	std::string path;
+
+public:
+	RecorderWriter():fd(-1) {}
+
+	RecorderWriter(const RecorderWriter &) = delete;
+
+	/**
+	 * Start the thread.
+	 *
+	 * @param _fd a file descriptor which is owned by this object
+	 * from now on, even if this method fails
+	 * @param _path the name of this file
+	 * @param _max_size the maximum number of bytes to queue
+	 */
+	bool Start(int _fd, const char *_path, size_t _max_size,
+		   Error &error);
+
+	/**
+	 * Wait until all queued data has been written, then close the
+	 * file and stop the thread.
+	 */
+	void Stop();
+
+	/**
+	 * Queue data for the current file.
+	 *
+	 * @return false if the writer thread has failed
+	 */
+	bool Write(const void *data, size_t size, Error &error);
+
+	/**
+	 * Close the current file after all data queued so far, and
+	 * continue in a new file.  The file is created by the writer
+	 * thread; errors are reported by the following calls.
+	 */
+	bool Rotate(const char *new_path, Error &error);
+
+private:
+	bool CheckError(Error &error_r);
+
+	void OpenFile(const std::string &new_path);
+	void WriteFile(const uint8_t *data, size_t size);
+
+	void Run();
+	static void Run(void *ctx);
+};
+
+#endif
@@ -416,6 +416,7 @@ const struct AudioOutputPlugin roar_output_plugin = {
 	roar_open,
 	roar_close,
 	nullptr,
+	nullptr,
 	roar_send_tag,
 	roar_play,
 	nullptr,
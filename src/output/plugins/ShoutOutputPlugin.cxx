@@ -19,9 +19,13 @@
 
 #include "config.h"
 #include "ShoutOutputPlugin.hxx"
+#include "ShoutThread.hxx"
 #include "../OutputAPI.hxx"
+#include "../Timer.hxx"
 #include "encoder/EncoderPlugin.hxx"
 #include "encoder/EncoderList.hxx"
+#include "encoder/SharedEncoder.hxx"
+#include "encoder/ThreadedEncoder.hxx"
 #include "config/ConfigError.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
@@ -37,6 +41,11 @@
 
 static constexpr unsigned DEFAULT_CONN_TIMEOUT = 2;
 
+/**
+ * The default size of the backlog [kB].
+ */
+static constexpr unsigned DEFAULT_BACKLOG = 256;
+
 struct ShoutOutput final {
 	AudioOutput base;
 
@@ -48,7 +57,37 @@ struct ShoutOutput final {
 	float quality;
 	int bitrate;
 
-	int timeout;
+	unsigned timeout;
+
+	/**
+	 * The maximum amount of encoded data to be queued for the
+	 * server [bytes].
+	 */
+	size_t backlog_size;
+
+	/**
+	 * The thread which owns the connection while the device is
+	 * open.
+	 */
+	ShoutThread *thread;
+
+	/**
+	 * Paces the encoder, because the connection does not block
+	 * anymore.
+	 */
+	Timer *timer;
+
+	/**
+	 * The audio format passed to encoder_open(); needed to begin
+	 * a new stream.
+	 */
+	AudioFormat encoder_audio_format;
+
+	/**
+	 * Is the encoder open?  It is closed when RestartStream()
+	 * fails to reopen it.
+	 */
+	bool encoder_opened;
 
 	uint8_t buffer[32768];
 
@@ -58,7 +97,9 @@ struct ShoutOutput final {
 		shout_meta(shout_metadata_new()),
 		quality(-2.0),
 		bitrate(-1),
-		timeout(DEFAULT_CONN_TIMEOUT) {}
+		timeout(DEFAULT_CONN_TIMEOUT),
+		backlog_size(DEFAULT_BACKLOG * 1024),
+		thread(nullptr), timer(nullptr) {}
 
 	~ShoutOutput() {
 		if (shout_meta != nullptr)
@@ -109,7 +150,7 @@ ShoutOutput::Configure(const config_param &param, Error &error)
 	if (!audio_format.IsFullyDefined()) {
 		error.Set(config_domain,
 			  "Need full audio format specification");
-		return nullptr;
+		return false;
 	}
 
 	const char *host = require_block_string(param, "host");
@@ -173,10 +214,26 @@ ShoutOutput::Configure(const config_param &param, Error &error)
 		return false;
 	}
 
-	encoder = encoder_init(*encoder_plugin, param, error);
+	const char *shared_encoder = param.GetBlockValue("shared_encoder");
+	const bool encoder_thread =
+		param.GetBlockValue("encoder_thread", false);
+	if (encoder_thread && shared_encoder != nullptr) {
+		error.Set(config_domain,
+			  "'encoder_thread' cannot be combined with "
+			  "'shared_encoder'");
+		return false;
+	}
+
+	encoder = shared_encoder != nullptr
+		? shared_encoder_init(shared_encoder, *encoder_plugin,
+				      param, error)
+		: encoder_init(*encoder_plugin, param, error);
 	if (encoder == nullptr)
 		return false;
 
+	if (encoder_thread)
+		encoder = threaded_encoder_init(encoder);
+
 	unsigned shout_format;
 	if (strcmp(encoding, "mp3") == 0 || strcmp(encoding, "lame") == 0)
 		shout_format = SHOUT_FORMAT_MP3;
@@ -219,7 +276,8 @@ ShoutOutput::Configure(const config_param &param, Error &error)
 	    shout_set_format(shout_conn, shout_format)
 	    != SHOUTERR_SUCCESS ||
 	    shout_set_protocol(shout_conn, protocol) != SHOUTERR_SUCCESS ||
-	    shout_set_agent(shout_conn, "MPD") != SHOUTERR_SUCCESS) {
+	    shout_set_agent(shout_conn, "MPD") != SHOUTERR_SUCCESS ||
+	    shout_set_nonblocking(shout_conn, 1) != SHOUTERR_SUCCESS) {
 		error.Set(shout_output_domain, shout_get_error(shout_conn));
 		return false;
 	}
@@ -227,6 +285,13 @@ ShoutOutput::Configure(const config_param &param, Error &error)
 	/* optional paramters */
 	timeout = param.GetBlockValue("timeout", DEFAULT_CONN_TIMEOUT);
 
+	backlog_size = param.GetBlockValue("backlog", DEFAULT_BACKLOG)
+		* size_t(1024);
+	if (backlog_size == 0) {
+		error.Set(config_domain, "'backlog' must not be 0");
+		return false;
+	}
+
 	value = param.GetBlockValue("genre");
 	if (value != nullptr && shout_set_genre(shout_conn, value)) {
 		error.Set(shout_output_domain, shout_get_error(shout_conn));
@@ -292,68 +357,68 @@ my_shout_init_driver(const config_param &param, Error &error)
 	return &sd->base;
 }
 
-static bool
-handle_shout_error(ShoutOutput *sd, int err, Error &error)
-{
-	switch (err) {
-	case SHOUTERR_SUCCESS:
-		break;
-
-	case SHOUTERR_UNCONNECTED:
-	case SHOUTERR_SOCKET:
-		error.Format(shout_output_domain, err,
-			     "Lost shout connection to %s:%i: %s",
-			     shout_get_host(sd->shout_conn),
-			     shout_get_port(sd->shout_conn),
-			     shout_get_error(sd->shout_conn));
-		return false;
-
-	default:
-		error.Format(shout_output_domain, err,
-			     "connection to %s:%i error: %s",
-			     shout_get_host(sd->shout_conn),
-			     shout_get_port(sd->shout_conn),
-			     shout_get_error(sd->shout_conn));
-		return false;
-	}
-
-	return true;
-}
-
-static bool
-write_page(ShoutOutput *sd, Error &error)
+/**
+ * Pass all pending data from the encoder to the #ShoutThread.
+ */
+static void
+write_page(ShoutOutput *sd)
 {
 	assert(sd->encoder != nullptr);
+	assert(sd->thread != nullptr);
 
 	while (true) {
 		size_t nbytes = encoder_read(sd->encoder,
 					     sd->buffer, sizeof(sd->buffer));
 		if (nbytes == 0)
-			return true;
+			return;
 
-		int err = shout_send(sd->shout_conn, sd->buffer, nbytes);
-		if (!handle_shout_error(sd, err, error))
-			return false;
+		sd->thread->Write(sd->buffer, nbytes);
 	}
+}
+
+/**
+ * Begin a new encoder stream, because the #ShoutThread has
+ * reconnected or discarded its backlog.
+ */
+static bool
+restart_stream(ShoutOutput *sd, Error &error)
+{
+	if (encoder_is_shared(sd->encoder))
+		/* the stream of a shared encoder cannot be
+		   restarted; continue where the other outputs are */
+		return true;
 
+	/* the end of the old stream is not needed anymore */
+	if (encoder_end(sd->encoder, IgnoreError()))
+		while (encoder_read(sd->encoder, sd->buffer,
+				    sizeof(sd->buffer)) > 0) {}
+
+	encoder_close(sd->encoder);
+	sd->encoder_opened = false;
+
+	if (!encoder_open(sd->encoder, sd->encoder_audio_format, error))
+		return false;
+
+	sd->encoder_opened = true;
+	write_page(sd);
 	return true;
 }
 
 static void close_shout_conn(ShoutOutput * sd)
 {
-	if (sd->encoder != nullptr) {
+	if (sd->encoder_opened) {
 		if (encoder_end(sd->encoder, IgnoreError()))
-			write_page(sd, IgnoreError());
+			write_page(sd);
 
 		encoder_close(sd->encoder);
 	}
 
-	if (shout_get_connected(sd->shout_conn) != SHOUTERR_UNCONNECTED &&
-	    shout_close(sd->shout_conn) != SHOUTERR_SUCCESS) {
-		FormatWarning(shout_output_domain,
-			      "problem closing connection to shout server: %s",
-			      shout_get_error(sd->shout_conn));
-	}
+	sd->thread->Stop();
+	delete sd->thread;
+	sd->thread = nullptr;
+
+	delete sd->timer;
+	sd->timer = nullptr;
 }
 
 static void
@@ -374,10 +439,11 @@ my_shout_finish_driver(AudioOutput *ao)
 static void
 my_shout_drop_buffered_audio(AudioOutput *ao)
 {
-	gcc_unused
 	ShoutOutput *sd = (ShoutOutput *)ao;
 
-	/* needs to be implemented for shout */
+	/* the encoded data may already be on its way to the server;
+	   only reset the clock */
+	sd->timer->Reset();
 }
 
 static void
@@ -388,44 +454,33 @@ my_shout_close_device(AudioOutput *ao)
 	close_shout_conn(sd);
 }
 
-static bool
-shout_connect(ShoutOutput *sd, Error &error)
-{
-	switch (shout_open(sd->shout_conn)) {
-	case SHOUTERR_SUCCESS:
-	case SHOUTERR_CONNECTED:
-		return true;
-
-	default:
-		error.Format(shout_output_domain,
-			     "problem opening connection to shout server %s:%i: %s",
-			     shout_get_host(sd->shout_conn),
-			     shout_get_port(sd->shout_conn),
-			     shout_get_error(sd->shout_conn));
-		return false;
-	}
-}
-
 static bool
 my_shout_open_device(AudioOutput *ao, AudioFormat &audio_format,
 		     Error &error)
 {
 	ShoutOutput *sd = (ShoutOutput *)ao;
 
-	if (!shout_connect(sd, error))
-		return false;
-
-	if (!encoder_open(sd->encoder, audio_format, error)) {
-		shout_close(sd->shout_conn);
+	if (!encoder_open(sd->encoder, audio_format, error))
 		return false;
-	}
 
-	if (!write_page(sd, error)) {
+	sd->encoder_audio_format = audio_format;
+	sd->encoder_opened = true;
+
+	/* the connection is established asynchronously by the
+	   thread; meanwhile, the stream headers and the first
+	   pages wait in the backlog */
+	sd->thread = new ShoutThread(sd->shout_conn, sd->shout_meta,
+				     sd->timeout, sd->backlog_size);
+	if (!sd->thread->Start(error)) {
+		delete sd->thread;
+		sd->thread = nullptr;
 		encoder_close(sd->encoder);
-		shout_close(sd->shout_conn);
 		return false;
 	}
 
+	write_page(sd);
+
+	sd->timer = new Timer(audio_format);
 	return true;
 }
 
@@ -434,11 +489,9 @@ my_shout_delay(AudioOutput *ao)
 {
 	ShoutOutput *sd = (ShoutOutput *)ao;
 
-	int delay = shout_delay(sd->shout_conn);
-	if (delay < 0)
-		delay = 0;
-
-	return delay;
+	return sd->timer->IsStarted()
+		? sd->timer->GetDelay()
+		: 0;
 }
 
 static size_t
@@ -447,10 +500,19 @@ my_shout_play(AudioOutput *ao, const void *chunk, size_t size,
 {
 	ShoutOutput *sd = (ShoutOutput *)ao;
 
-	return encoder_write(sd->encoder, chunk, size, error) &&
-		write_page(sd, error)
-		? size
-		: 0;
+	if (sd->thread->CheckRestart() && !restart_stream(sd, error))
+		return 0;
+
+	if (!encoder_write(sd->encoder, chunk, size, error))
+		return 0;
+
+	write_page(sd);
+
+	if (!sd->timer->IsStarted())
+		sd->timer->Start();
+	sd->timer->Add(size);
+
+	return size;
 }
 
 static bool
@@ -496,26 +558,27 @@ static void my_shout_set_tag(AudioOutput *ao,
 		/* encoder plugin supports stream tags */
 
 		Error error;
-		if (!encoder_pre_tag(sd->encoder, error) ||
-		    !write_page(sd, error) ||
-		    !encoder_tag(sd->encoder, tag, error)) {
+		if (!encoder_pre_tag(sd->encoder, error)) {
+			LogError(error);
+			return;
+		}
+
+		write_page(sd);
+
+		if (!encoder_tag(sd->encoder, tag, error)) {
 			LogError(error);
 			return;
 		}
 	} else {
-		/* no stream tag support: fall back to icy-metadata */
+		/* no stream tag support: fall back to icy-metadata,
+		   which is sent by the thread */
 		char song[1024];
 		shout_tag_to_metadata(tag, song, sizeof(song));
 
-		shout_metadata_add(sd->shout_meta, "song", song);
-		if (SHOUTERR_SUCCESS != shout_set_metadata(sd->shout_conn,
-							   sd->shout_meta)) {
-			LogWarning(shout_output_domain,
-				   "error setting shout metadata");
-		}
+		sd->thread->SetMetadata(song);
 	}
 
-	write_page(sd, IgnoreError());
+	write_page(sd);
 }
 
 const struct AudioOutputPlugin shout_output_plugin = {
@@ -528,6 +591,7 @@ const struct AudioOutputPlugin shout_output_plugin = {
 	my_shout_open_device,
 	my_shout_close_device,
 	my_shout_delay,
+	nullptr,
 	my_shout_set_tag,
 	my_shout_play,
 	nullptr,
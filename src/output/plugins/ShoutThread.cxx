@@ -0,0 +1,367 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "ShoutThread.hxx"
+#include "thread/Name.hxx"
+#include "system/Clock.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <string.h>
+
+static constexpr Domain shout_thread_domain("shout_output");
+
+/**
+ * Poll libshout in this interval (in milliseconds) while it is busy
+ * connecting or sending.  libshout does not reveal its socket, so we
+ * cannot wait for it to become ready.
+ */
+static constexpr unsigned SHOUT_POLL_MS = 20;
+
+/**
+ * Wait this number of seconds before reconnecting.
+ */
+static constexpr unsigned SHOUT_RECONNECT_S = 5;
+
+bool
+ShoutThread::Start(Error &error)
+{
+	backlog.Clear();
+	stream_start = true;
+	restart = false;
+	connected = false;
+	metadata.clear();
+	quit = false;
+
+	state = State::DISCONNECTED;
+	deadline = 0;
+
+	if (!thread.Start(Run, this, error))
+		return false;
+
+	DeferredMonitor::Schedule();
+	return true;
+}
+
+void
+ShoutThread::Stop()
+{
+	mutex.lock();
+	quit = true;
+	mutex.unlock();
+
+	DeferredMonitor::Schedule();
+	thread.Join();
+}
+
+void
+ShoutThread::Write(const void *data, size_t size)
+{
+	const ScopeLock protect(mutex);
+
+	if (backlog.GetAvailable() + size > backlog.GetCapacity()) {
+		/* the server doesn't keep up: drop everything and
+		   begin a new stream, instead of blocking the
+		   output */
+		if (connected && !restart)
+			FormatWarning(shout_thread_domain,
+				      "Backlog overflow, restarting the "
+				      "stream to %s:%i",
+				      shout_get_host(conn),
+				      shout_get_port(conn));
+
+		backlog.Clear();
+		stream_start = false;
+		restart = true;
+
+		if (size > backlog.GetCapacity())
+			return;
+	}
+
+	backlog.Append((const uint8_t *)data, size);
+	DeferredMonitor::Schedule();
+}
+
+bool
+ShoutThread::CheckRestart()
+{
+	const ScopeLock protect(mutex);
+
+	if (!restart)
+		return false;
+
+	restart = false;
+	backlog.Clear();
+	stream_start = true;
+	return true;
+}
+
+void
+ShoutThread::SetMetadata(const char *song)
+{
+	const ScopeLock protect(mutex);
+
+	metadata = song;
+	DeferredMonitor::Schedule();
+}
+
+inline void
+ShoutThread::OnConnected()
+{
+	state = State::CONNECTED;
+
+	FormatInfo(shout_thread_domain, "Connected to %s:%i",
+		   shout_get_host(conn), shout_get_port(conn));
+
+	const ScopeLock protect(mutex);
+	connected = true;
+
+	if (!stream_start) {
+		/* the new connection needs the stream headers */
+		backlog.Clear();
+		restart = true;
+	}
+}
+
+inline bool
+ShoutThread::Connect()
+{
+	switch (shout_open(conn)) {
+	case SHOUTERR_SUCCESS:
+	case SHOUTERR_CONNECTED:
+		OnConnected();
+		return true;
+
+	case SHOUTERR_BUSY:
+		state = State::CONNECTING;
+		deadline = MonotonicClockS() + connect_timeout;
+		return true;
+
+	default:
+		FormatWarning(shout_thread_domain,
+			      "problem opening connection to shout server %s:%i: %s",
+			      shout_get_host(conn), shout_get_port(conn),
+			      shout_get_error(conn));
+		state = State::DISCONNECTED;
+		deadline = MonotonicClockS() + SHOUT_RECONNECT_S;
+		return false;
+	}
+}
+
+void
+ShoutThread::Disconnect()
+{
+	if (state != State::DISCONNECTED)
+		/* ignore errors, the connection may be broken
+		   already */
+		shout_close(conn);
+
+	state = State::DISCONNECTED;
+	deadline = MonotonicClockS() + SHOUT_RECONNECT_S;
+
+	const ScopeLock protect(mutex);
+	connected = false;
+}
+
+inline void
+ShoutThread::SendMetadata()
+{
+	std::string song;
+
+	mutex.lock();
+	song.swap(metadata);
+	mutex.unlock();
+
+	if (song.empty())
+		return;
+
+	shout_metadata_add(meta, "song", song.c_str());
+	if (shout_set_metadata(conn, meta) != SHOUTERR_SUCCESS)
+		LogWarning(shout_thread_domain,
+			   "error setting shout metadata");
+}
+
+inline void
+ShoutThread::Send()
+{
+	assert(state == State::CONNECTED);
+
+	while (true) {
+		int err;
+
+		if (shout_queuelen(conn) > 0) {
+			/* flush the data libshout has queued
+			   internally before handing over more */
+			err = shout_send(conn, nullptr, 0);
+		} else {
+			uint8_t buffer[4096];
+			size_t nbytes;
+
+			{
+				const ScopeLock protect(mutex);
+				if (restart)
+					/* wait for the new stream */
+					return;
+
+				auto r = backlog.Read();
+				nbytes = std::min(r.size, sizeof(buffer));
+				memcpy(buffer, r.data, nbytes);
+				backlog.Consume(nbytes);
+
+				if (nbytes > 0)
+					stream_start = false;
+			}
+
+			if (nbytes == 0)
+				return;
+
+			err = shout_send(conn, buffer, nbytes);
+		}
+
+		switch (err) {
+		case SHOUTERR_SUCCESS:
+			break;
+
+		case SHOUTERR_BUSY:
+			/* the socket is full; try again later */
+			TimeoutMonitor::Schedule(SHOUT_POLL_MS);
+			return;
+
+		default:
+			FormatWarning(shout_thread_domain,
+				      "Lost shout connection to %s:%i: %s",
+				      shout_get_host(conn),
+				      shout_get_port(conn),
+				      shout_get_error(conn));
+			Disconnect();
+			TimeoutMonitor::ScheduleSeconds(SHOUT_RECONNECT_S);
+			return;
+		}
+	}
+}
+
+void
+ShoutThread::Pump()
+{
+	const unsigned now = MonotonicClockS();
+
+	switch (state) {
+	case State::DISCONNECTED:
+		if (now < deadline) {
+			TimeoutMonitor::ScheduleSeconds(deadline - now);
+			return;
+		}
+
+		if (!Connect()) {
+			TimeoutMonitor::ScheduleSeconds(SHOUT_RECONNECT_S);
+			return;
+		}
+
+		if (state == State::CONNECTING) {
+			TimeoutMonitor::Schedule(SHOUT_POLL_MS);
+			return;
+		}
+
+		break;
+
+	case State::CONNECTING:
+		switch (shout_get_connected(conn)) {
+		case SHOUTERR_CONNECTED:
+			OnConnected();
+			break;
+
+		case SHOUTERR_BUSY:
+			if (now >= deadline) {
+				FormatWarning(shout_thread_domain,
+					      "Timeout connecting to %s:%i",
+					      shout_get_host(conn),
+					      shout_get_port(conn));
+				Disconnect();
+				TimeoutMonitor::ScheduleSeconds(SHOUT_RECONNECT_S);
+			} else
+				TimeoutMonitor::Schedule(SHOUT_POLL_MS);
+			return;
+
+		default:
+			FormatWarning(shout_thread_domain,
+				      "problem opening connection to shout server %s:%i: %s",
+				      shout_get_host(conn),
+				      shout_get_port(conn),
+				      shout_get_error(conn));
+			Disconnect();
+			TimeoutMonitor::ScheduleSeconds(SHOUT_RECONNECT_S);
+			return;
+		}
+
+		break;
+
+	case State::CONNECTED:
+		break;
+	}
+
+	SendMetadata();
+	Send();
+}
+
+void
+ShoutThread::RunDeferred()
+{
+	mutex.lock();
+	const bool _quit = quit;
+	mutex.unlock();
+
+	if (!_quit) {
+		Pump();
+		return;
+	}
+
+	/* shutting down: send what can be sent without blocking */
+	if (state == State::CONNECTED)
+		Send();
+
+	TimeoutMonitor::Cancel();
+	Disconnect();
+	event_loop.Break();
+}
+
+void
+ShoutThread::OnTimeout()
+{
+	Pump();
+}
+
+inline void
+ShoutThread::Run()
+{
+	SetThreadName("shout");
+
+	event_loop.Run();
+}
+
+void
+ShoutThread::Run(void *ctx)
+{
+	ShoutThread &t = *(ShoutThread *)ctx;
+	t.Run();
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_OUTPUT_SHOUT_THREAD_HXX
+#define MPD_OUTPUT_SHOUT_THREAD_HXX
+
+#include "check.h"
+#include "event/Loop.hxx"
+#include "event/DeferredMonitor.hxx"
+#include "event/TimeoutMonitor.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Thread.hxx"
+#include "util/DynamicFifoBuffer.hxx"
+
+#include <shout/shout.h>
+
+#include <string>
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Error;
+
+/**
+ * Holds the #EventLoop of a #ShoutThread.  This is a separate base
+ * class, because the loop must be constructed before the monitors
+ * which refer to it.
+ */
+struct ShoutThreadLoop {
+	EventLoop event_loop;
+};
+
+/**
+ * A dedicated thread which owns the libshout connection of a
+ * "shout" output.  The connection is operated in non-blocking mode
+ * and driven by an #EventLoop; the output thread only appends
+ * encoded data to a bounded backlog, so a slow or unreachable
+ * server never blocks playback.  Lost connections are
+ * re-established automatically.
+ */
+class ShoutThread final
+	: ShoutThreadLoop, DeferredMonitor, TimeoutMonitor {
+
+	enum class State {
+		DISCONNECTED,
+		CONNECTING,
+		CONNECTED,
+	};
+
+	shout_t *const conn;
+	shout_metadata_t *const meta;
+
+	/**
+	 * Give up connecting after this number of seconds.
+	 */
+	const unsigned connect_timeout;
+
+	Thread thread;
+
+	/**
+	 * This mutex protects #backlog, #stream_start, #restart,
+	 * #connected, #metadata and #quit.
+	 */
+	Mutex mutex;
+
+	/**
+	 * Encoded data which has not yet been passed to libshout.
+	 * Its capacity is the configured limit; it never grows.
+	 */
+	DynamicFifoBuffer<uint8_t> backlog;
+
+	/**
+	 * Does #backlog begin at the start of an encoder stream?
+	 * Only then it can be sent to a new connection.
+	 */
+	bool stream_start;
+
+	/**
+	 * Shall the output thread begin a new encoder stream?  Set
+	 * after a reconnect or when the backlog has overflowed; while
+	 * it is set, nothing is sent.
+	 */
+	bool restart;
+
+	/**
+	 * Is the connection established?  A copy of #state for the
+	 * output thread.
+	 */
+	bool connected;
+
+	/**
+	 * A "song" value to be sent as icy-metadata; empty if there
+	 * is none pending.
+	 */
+	std::string metadata;
+
+	bool quit;
+
+	/* the following fields are only used inside the thread */
+
+	State state;
+
+	/**
+	 * The MonotonicClockS() value when the current connection
+	 * attempt shall be given up (#State::CONNECTING) or the next
+	 * one shall be made (#State::DISCONNECTED).
+	 */
+	unsigned deadline;
+
+public:
+	ShoutThread(shout_t *_conn, shout_metadata_t *_meta,
+		    unsigned _connect_timeout, size_t backlog_size)
+		:DeferredMonitor(event_loop), TimeoutMonitor(event_loop),
+		 conn(_conn), meta(_meta),
+		 connect_timeout(_connect_timeout),
+		 backlog(backlog_size) {}
+
+	ShoutThread(const ShoutThread &) = delete;
+	ShoutThread &operator=(const ShoutThread &) = delete;
+
+	/**
+	 * Start the thread, which begins to connect to the server.
+	 * The backlog must contain the beginning of the stream
+	 * before the connection is established, i.e. the caller
+	 * shall write the stream headers right after this call.
+	 */
+	bool Start(Error &error);
+
+	/**
+	 * Send the remaining backlog if possible without blocking,
+	 * close the connection and stop the thread.
+	 */
+	void Stop();
+
+	/**
+	 * Append encoded data to the backlog.  This method never
+	 * blocks; if the backlog is full, it is discarded and a
+	 * restart is requested.
+	 */
+	void Write(const void *data, size_t size);
+
+	/**
+	 * Check whether a new encoder stream shall be started.  If
+	 * yes, the backlog is cleared, and the caller must write
+	 * the new stream headers next.
+	 */
+	bool CheckRestart();
+
+	/**
+	 * Schedule an icy-metadata update.
+	 */
+	void SetMetadata(const char *song);
+
+private:
+	bool Connect();
+	void OnConnected();
+	void Disconnect();
+	void SendMetadata();
+	void Send();
+	void Pump();
+
+	void Run();
+	static void Run(void *ctx);
+
+	virtual void RunDeferred() override;
+	virtual void OnTimeout() override;
+};
+
+#endif
@@ -190,6 +190,7 @@ const struct AudioOutputPlugin solaris_output_plugin = {
 	solaris_output_close,
 	nullptr,
 	nullptr,
+	nullptr,
 	solaris_output_play,
 	nullptr,
 	solaris_output_cancel,
@@ -23,6 +23,7 @@
 #include "util/ASCII.hxx"
 #include "Page.hxx"
 #include "IcyMetaDataServer.hxx"
+#include "PipelineStats.hxx"
 #include "system/SocketError.hxx"
 #include "Log.hxx"
 
@@ -30,6 +31,10 @@
 #include <string.h>
 #include <stdio.h>
 
+#ifndef WIN32
+#include <sys/uio.h>
+#endif
+
 HttpdClient::~HttpdClient()
 {
 	if (state == RESPONSE) {
@@ -67,7 +72,7 @@ HttpdClient::BeginResponse()
 	state = RESPONSE;
 	current_page = nullptr;
 
-	if (!head_method)
+	if (!head_method && !metrics_requested)
 		httpd.SendHeader(*this);
 }
 
@@ -85,6 +90,10 @@ HttpdClient::HandleLine(const char *line)
 			head_method = true;
 		} else if (memcmp(line, "GET /", 5) == 0) {
 			line += 5;
+
+			if (httpd.metrics && memcmp(line, "metrics", 7) == 0 &&
+			    (line[7] == ' ' || line[7] == 0))
+				metrics_requested = true;
 		} else {
 			/* only GET is supported */
 			LogWarning(httpd_output_domain,
@@ -96,7 +105,7 @@ HttpdClient::HandleLine(const char *line)
 		if (line == nullptr || memcmp(line + 1, "HTTP/", 5) != 0) {
 			/* HTTP/0.9 without request headers */
 
-			if (head_method)
+			if (head_method || metrics_requested)
 				return false;
 
 			BeginResponse();
@@ -146,7 +155,21 @@ HttpdClient::SendResponse()
 
 	assert(state == RESPONSE);
 
-	if (dlna_streaming_requested) {
+	std::string metrics_body;
+
+	if (metrics_requested) {
+		metrics_body = pipeline_stats_format_prometheus();
+		snprintf(buffer, sizeof(buffer),
+			 "HTTP/1.1 200 OK\r\n"
+			 "Content-Type: text/plain; version=0.0.4\r\n"
+			 "Content-Length: %lu\r\n"
+			 "Connection: close\r\n"
+			 "\r\n",
+			 (unsigned long)metrics_body.length());
+		metrics_body.insert(0, buffer);
+		response = metrics_body.c_str();
+
+	} else if (dlna_streaming_requested) {
 		snprintf(buffer, sizeof(buffer),
 			 "HTTP/1.1 206 OK\r\n"
 			 "Content-Type: %s\r\n"
@@ -198,8 +221,8 @@ HttpdClient::HttpdClient(HttpdOutput &_httpd, int _fd, EventLoop &_loop,
 	:BufferedSocket(_fd, _loop),
 	 httpd(_httpd),
 	 state(REQUEST),
-	 queue_size(0),
-	 head_method(false),
+	 queue_size(0), max_queue_size(256 * 1024),
+	 head_method(false), metrics_requested(false),
 	 dlna_streaming_requested(false),
 	 metadata_supported(_metadata_supported),
 	 metadata_requested(false), metadata_sent(true),
@@ -216,12 +239,10 @@ HttpdClient::ClearQueue()
 
 	while (!pages.empty()) {
 		Page *page = pages.front();
-		pages.pop();
+		pages.pop_front();
 
-#ifndef NDEBUG
 		assert(queue_size >= page->size);
 		queue_size -= page->size;
-#endif
 
 		page->Unref();
 	}
@@ -250,11 +271,81 @@ HttpdClient::TryWritePage(const Page &page, size_t position)
 }
 
 ssize_t
-HttpdClient::TryWritePageN(const Page &page, size_t position, ssize_t n)
+HttpdClient::TryWritePages(ssize_t limit)
 {
-	return n >= 0
-		? Write(page.data + position, n)
-		: TryWritePage(page, position);
+	assert(current_page != nullptr);
+	assert(current_position < current_page->size);
+	assert(limit != 0);
+
+#ifdef WIN32
+	size_t length = current_page->size - current_position;
+	if (limit >= 0 && length > size_t(limit))
+		length = limit;
+
+	return Write(current_page->data + current_position, length);
+#else
+	/* the maximum number of pages per system call */
+	static constexpr size_t MAX_IOV = 16;
+
+	struct iovec iov[MAX_IOV];
+	size_t n = 0, total = 0;
+
+	const Page *page = current_page;
+	size_t position = current_position;
+	auto i = pages.begin();
+
+	while (true) {
+		size_t length = page->size - position;
+		if (limit >= 0 && total + length > size_t(limit))
+			length = limit - total;
+
+		iov[n].iov_base = const_cast<unsigned char *>(page->data
+							      + position);
+		iov[n].iov_len = length;
+		++n;
+		total += length;
+
+		if (n == MAX_IOV || i == pages.end() ||
+		    (limit >= 0 && total == size_t(limit)))
+			break;
+
+		page = *i++;
+		position = 0;
+	}
+
+	return Write(iov, n);
+#endif
+}
+
+void
+HttpdClient::ConsumePages(size_t nbytes)
+{
+	while (true) {
+		assert(current_page != nullptr);
+
+		const size_t rest = current_page->size - current_position;
+		if (nbytes < rest) {
+			current_position += nbytes;
+			break;
+		}
+
+		nbytes -= rest;
+		current_page->Unref();
+		current_page = nullptr;
+
+		if (nbytes == 0)
+			break;
+
+		/* the write has reached into the next queued
+		   page */
+		assert(!pages.empty());
+		current_page = pages.front();
+		pages.pop_front();
+		current_position = 0;
+
+		assert(queue_size >= current_page->size);
+		queue_size -= current_page->size;
+	}
 }
 
 ssize_t
@@ -284,7 +375,7 @@ HttpdClient::TryWrite()
 		}
 
 		current_page = pages.front();
-		pages.pop();
+		pages.pop_front();
 		current_position = 0;
 
 		assert(queue_size >= current_page->size);
@@ -343,9 +434,12 @@ HttpdClient::TryWrite()
 			metadata_current_position = 0;
 		}
 	} else {
-		ssize_t nbytes =
-			TryWritePageN(*current_page, current_position,
-				      bytes_to_write);
+		/* don't write across the next metadata block */
+		const ssize_t limit = metadata_requested
+			? ssize_t(metaint - metadata_fill)
+			: -1;
+
+		ssize_t nbytes = TryWritePages(limit);
 		if (nbytes < 0) {
 			auto e = GetSocketError();
 			if (IsSocketErrorAgain(e))
@@ -362,21 +456,15 @@ HttpdClient::TryWrite()
 			return false;
 		}
 
-		current_position += nbytes;
-		assert(current_position <= current_page->size);
-
 		if (metadata_requested)
 			metadata_fill += nbytes;
 
-		if (current_position >= current_page->size) {
-			current_page->Unref();
-			current_page = nullptr;
+		ConsumePages(nbytes);
 
-			if (pages.empty())
-				/* all pages are sent: remove the
-				   event source */
-				CancelWrite();
-		}
+		if (current_page == nullptr && pages.empty())
+			/* all pages are sent: remove the event
+			   source */
+			CancelWrite();
 	}
 
 	return true;
@@ -389,14 +477,14 @@ HttpdClient::PushPage(Page *page)
 		/* the client is still writing the HTTP request */
 		return;
 
-	if (queue_size > 256 * 1024) {
+	if (queue_size > max_queue_size) {
 		FormatDebug(httpd_output_domain,
 			    "client is too slow, flushing its queue");
 		ClearQueue();
 	}
 
 	page->Ref();
-	pages.push(page);
+	pages.push_back(page);
 	queue_size += page->size;
 
 	ScheduleWrite();
@@ -462,7 +550,7 @@ HttpdClient::OnSocketInput(void *data, size_t length)
 		if (!SendResponse())
 			return InputResult::CLOSED;
 
-		if (head_method) {
+		if (head_method || metrics_requested) {
 			LockClose();
 			return InputResult::CLOSED;
 		}
@@ -23,8 +23,7 @@
 #include "event/BufferedSocket.hxx"
 #include "Compiler.h"
 
-#include <queue>
-#include <list>
+#include <deque>
 
 #include <stddef.h>
 
@@ -54,13 +53,19 @@ class HttpdClient final : BufferedSocket {
 	/**
 	 * A queue of #Page objects to be sent to the client.
 	 */
-	std::queue<Page *, std::list<Page *>> pages;
+	std::deque<Page *> pages;
 
 	/**
 	 * The sum of all page sizes in #pages.
 	 */
 	size_t queue_size;
 
+	/**
+	 * If #queue_size grows beyond this, the client is considered
+	 * too slow, and its queue is flushed.
+	 */
+	size_t max_queue_size;
+
 	/**
 	 * The #page which is currently being sent to the client.
 	 */
@@ -77,6 +82,13 @@ class HttpdClient final : BufferedSocket {
 	 */
 	bool head_method;
 
+	/**
+	 * Is this a request for "/metrics"?  The response is the
+	 * pipeline telemetry instead of the stream, and the
+	 * connection is closed afterwards.
+	 */
+	bool metrics_requested;
+
 	/**
          * If DLNA streaming was an option.
          */
@@ -135,6 +147,8 @@ public:
 	 */
 	~HttpdClient();
 
+	using BufferedSocket::GetEventLoop;
+
 	/**
 	 * Frees the client and removes it from the server's client list.
 	 */
@@ -166,7 +180,21 @@ public:
 	ssize_t GetBytesTillMetaData() const;
 
 	ssize_t TryWritePage(const Page &page, size_t position);
-	ssize_t TryWritePageN(const Page &page, size_t position, ssize_t n);
+
+	/**
+	 * Write the rest of #current_page and as many queued pages
+	 * as possible with one system call.
+	 *
+	 * @param limit write at most this number of bytes; -1 means
+	 * no limit
+	 */
+	ssize_t TryWritePages(ssize_t limit);
+
+	/**
+	 * Mark the specified number of bytes as sent, starting at
+	 * #current_page, and release all pages which are done.
+	 */
+	void ConsumePages(size_t nbytes);
 
 	bool TryWrite();
 
@@ -175,6 +203,14 @@ public:
 	 */
 	void PushPage(Page *page);
 
+	/**
+	 * Allow the queue to grow by the specified number of bytes,
+	 * e.g. to hold the burst sent on connect.
+	 */
+	void GrowQueueLimit(size_t size) {
+		max_queue_size += size;
+	}
+
 	/**
 	 * Sends the passed metadata.
 	 */
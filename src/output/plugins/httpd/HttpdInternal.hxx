@@ -31,6 +31,7 @@
 #include "event/ServerSocket.hxx"
 #include "event/DeferredMonitor.hxx"
 #include "util/Cast.hxx"
+#include "HttpdThread.hxx"
 
 #ifdef _LIBCPP_VERSION
 /* can't use incomplete template arguments with libc++ */
@@ -39,8 +40,11 @@
 
 #include <forward_list>
 #include <queue>
+#include <deque>
 #include <list>
 
+#include <stdint.h>
+
 struct config_param;
 class Error;
 class EventLoop;
@@ -115,6 +119,50 @@ private:
 	 */
 	std::queue<Page *, std::list<Page *>> pages;
 
+	/**
+	 * The configured "burst" duration in seconds.
+	 */
+	unsigned burst_seconds;
+
+	/**
+	 * The amount of PCM data (in bytes) covered by #backlog.  0
+	 * disables the burst.  Calculated from #burst_seconds when
+	 * the output is opened.
+	 */
+	uint64_t burst_size;
+
+	/**
+	 * Finds the first frame boundary in the specified buffer;
+	 * returns the buffer size if there is none.  This depends on
+	 * the encoder's stream format.  nullptr if the format is not
+	 * supported, which disables the burst.
+	 */
+	size_t (*find_sync)(const uint8_t *data, size_t size);
+
+	/**
+	 * The number of PCM bytes which were passed to the encoder
+	 * since the output was opened.
+	 */
+	uint64_t input_position;
+
+	struct BacklogPage {
+		Page *page;
+
+		/**
+		 * The #input_position when this page was read from
+		 * the encoder.
+		 */
+		uint64_t position;
+	};
+
+	/**
+	 * The most recent pages which were broadcast to all
+	 * clients, covering #burst_size bytes of PCM data.  They
+	 * are sent to new clients right after the #header, so
+	 * playback starts instantly.  Protected by #mutex.
+	 */
+	std::deque<BacklogPage> backlog;
+
  public:
 	/**
 	 * The configured name.
@@ -129,6 +177,12 @@ private:
 	 */
 	char const *website;
 
+	/**
+	 * Serve pipeline telemetry in the Prometheus text format at
+	 * "/metrics"?
+	 */
+	bool metrics;
+
 private:
 	/**
 	 * A linked list containing all clients which are currently
@@ -136,6 +190,23 @@ private:
 	 */
 	std::forward_list<HttpdClient> clients;
 
+	/**
+	 * The configured number of dedicated client threads.  0
+	 * means all clients are served by the #IOThread.
+	 */
+	unsigned n_threads;
+
+	/**
+	 * The dedicated client threads, running while the output is
+	 * enabled.  New clients are assigned to them in turn.
+	 */
+	std::forward_list<HttpdThread> threads;
+
+	/**
+	 * The thread which gets the next client.
+	 */
+	std::forward_list<HttpdThread>::iterator next_thread;
+
 	/**
 	 * A temporary buffer for the httpd_output_read_page()
 	 * function.
@@ -213,7 +284,14 @@ public:
 		return HasClients();
 	}
 
-	void AddClient(int fd);
+	/**
+	 * Creates a new #HttpdClient object served by the specified
+	 * #EventLoop, which must be the current thread's loop.  The
+	 * socket is closed if the output is not open.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void AddClient(int fd, EventLoop &loop);
 
 	/**
 	 * Removes a client from the httpd_output.clients linked list.
@@ -221,10 +299,19 @@ public:
 	void RemoveClient(HttpdClient &client);
 
 	/**
-	 * Sends the encoder header to the client.  This is called
-	 * right after the response headers have been sent.
+	 * Appends a page to the queue of all clients served by the
+	 * specified #EventLoop.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void PushPage(Page *page, const EventLoop &loop);
+
+	/**
+	 * Sends the encoder header and the #backlog to the client.
+	 * This is called right after the response headers have been
+	 * sent.
 	 */
-	void SendHeader(HttpdClient &client) const;
+	void SendHeader(HttpdClient &client);
 
 	gcc_pure
 	unsigned Delay() const;
@@ -244,8 +331,11 @@ public:
 
 	/**
 	 * Broadcasts data from the encoder to all clients.
+	 *
+	 * @param extra an optional page which is queued after the
+	 * encoder's data
 	 */
-	void BroadcastFromEncoder();
+	void BroadcastFromEncoder(Page *extra=nullptr);
 
 	bool EncodeAndPlay(const void *chunk, size_t size, Error &error);
 
@@ -255,7 +345,68 @@ public:
 
 	void CancelAllClients();
 
+	/**
+	 * Cancel the clients of all threads; see CancelAllClients().
+	 */
+	void Cancel();
+
 private:
+	bool StartThreads(Error &error);
+	void StopThreads();
+
+	/**
+	 * Queues the page for all clients.  A new reference is
+	 * added.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void QueuePage(Page *page);
+
+	/**
+	 * Are pages still waiting to be passed to the clients?
+	 *
+	 * Caller must lock the mutex.
+	 */
+	gcc_pure
+	bool HasQueuedPages() const;
+
+	/**
+	 * Returns the number of pages which have been queued, but
+	 * not yet passed to the clients served by the specified
+	 * #EventLoop.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	gcc_pure
+	size_t CountQueuedPages(EventLoop &loop);
+
+	/**
+	 * Appends a page to the #backlog and removes the pages which
+	 * are too old.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void AppendBacklog(Page *page);
+
+	/**
+	 * Caller must lock the mutex.
+	 */
+	void ClearBacklog();
+
+	/**
+	 * Sends the #backlog to a new client, starting at the first
+	 * frame boundary.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void SendBacklog(HttpdClient &client);
+
+	/**
+	 * Frees all clients served by the specified #EventLoop.
+	 * Must be called inside that loop's thread.
+	 */
+	void ClearClients(const EventLoop &loop);
+
 	virtual void RunDeferred() override;
 
 	virtual void OnAccept(int fd, const sockaddr &address,
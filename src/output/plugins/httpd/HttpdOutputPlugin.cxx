@@ -24,6 +24,8 @@
 #include "output/OutputAPI.hxx"
 #include "encoder/EncoderPlugin.hxx"
 #include "encoder/EncoderList.hxx"
+#include "encoder/SharedEncoder.hxx"
+#include "encoder/ThreadedEncoder.hxx"
 #include "system/Resolver.hxx"
 #include "Page.hxx"
 #include "IcyMetaDataServer.hxx"
@@ -53,7 +55,8 @@ HttpdOutput::HttpdOutput(EventLoop &_loop)
 	:ServerSocket(_loop), DeferredMonitor(_loop),
 	 base(httpd_output_plugin),
 	 encoder(nullptr), unflushed_input(0),
-	 metadata(nullptr)
+	 metadata(nullptr),
+	 burst_size(0), find_sync(nullptr)
 {
 }
 
@@ -72,10 +75,17 @@ HttpdOutput::Bind(Error &error)
 {
 	open = false;
 
+	if (!StartThreads(error))
+		return false;
+
 	bool result = false;
 	BlockingCall(GetEventLoop(), [this, &error, &result](){
 			result = ServerSocket::Open(error);
 		});
+
+	if (!result)
+		StopThreads();
+
 	return result;
 }
 
@@ -87,6 +97,80 @@ HttpdOutput::Unbind()
 	BlockingCall(GetEventLoop(), [this](){
 			ServerSocket::Close();
 		});
+
+	StopThreads();
+}
+
+bool
+HttpdOutput::StartThreads(Error &error)
+{
+	assert(threads.empty());
+
+	for (unsigned i = 0; i < n_threads; ++i) {
+		threads.emplace_front(*this);
+		if (!threads.front().Start(error)) {
+			threads.pop_front();
+			StopThreads();
+			return false;
+		}
+	}
+
+	next_thread = threads.begin();
+	return true;
+}
+
+void
+HttpdOutput::StopThreads()
+{
+	for (auto &thread : threads)
+		thread.Stop();
+
+	threads.clear();
+}
+
+/**
+ * Find the capture pattern of an Ogg page.
+ */
+static size_t
+ogg_find_sync(const uint8_t *data, size_t size)
+{
+	for (size_t i = 0; i + 4 <= size; ++i)
+		if (memcmp(data + i, "OggS", 4) == 0)
+			return i;
+
+	return size;
+}
+
+/**
+ * Find the header of a MPEG audio frame.
+ */
+static size_t
+mpeg_find_sync(const uint8_t *data, size_t size)
+{
+	for (size_t i = 0; i + 4 <= size; ++i)
+		if (data[i] == 0xff && (data[i + 1] & 0xe0) == 0xe0 &&
+		    /* layer */
+		    (data[i + 1] & 0x06) != 0 &&
+		    /* bit rate */
+		    (data[i + 2] & 0xf0) != 0xf0 &&
+		    /* sample rate */
+		    (data[i + 2] & 0x0c) != 0x0c)
+			return i;
+
+	return size;
+}
+
+/**
+ * Find the header of a FLAC frame.
+ */
+static size_t
+flac_find_sync(const uint8_t *data, size_t size)
+{
+	for (size_t i = 0; i + 2 <= size; ++i)
+		if (data[i] == 0xff && (data[i + 1] & 0xfe) == 0xf8)
+			return i;
+
+	return size;
 }
 
 inline bool
@@ -110,6 +194,12 @@ HttpdOutput::Configure(const config_param &param, Error &error)
 
 	clients_max = param.GetBlockValue("max_clients", 0u);
 
+	n_threads = param.GetBlockValue("threads", 0u);
+
+	metrics = param.GetBlockValue("metrics", false);
+
+	burst_seconds = param.GetBlockValue("burst", 0u);
+
 	/* set up bind_to_address */
 
 	const char *bind_to_address = param.GetBlockValue("bind_to_address");
@@ -122,15 +212,46 @@ HttpdOutput::Configure(const config_param &param, Error &error)
 
 	/* initialize encoder */
 
-	encoder = encoder_init(*encoder_plugin, param, error);
+	const char *shared_encoder = param.GetBlockValue("shared_encoder");
+	const bool encoder_thread =
+		param.GetBlockValue("encoder_thread", false);
+	if (encoder_thread && shared_encoder != nullptr) {
+		/* the shared encoder has its own way of feeding other
+		   outputs, which must not be hidden by the wrapper */
+		error.Set(httpd_output_domain,
+			  "'encoder_thread' cannot be combined with "
+			  "'shared_encoder'");
+		return false;
+	}
+
+	encoder = shared_encoder != nullptr
+		? shared_encoder_init(shared_encoder, *encoder_plugin,
+				      param, error)
+		: encoder_init(*encoder_plugin, param, error);
 	if (encoder == nullptr)
 		return false;
 
+	if (encoder_thread)
+		encoder = threaded_encoder_init(encoder);
+
 	/* determine content type */
 	content_type = encoder_get_mime_type(encoder);
 	if (content_type == nullptr)
 		content_type = "application/octet-stream";
 
+	if (strcmp(content_type, "audio/ogg") == 0)
+		find_sync = ogg_find_sync;
+	else if (strcmp(content_type, "audio/mpeg") == 0)
+		find_sync = mpeg_find_sync;
+	else if (strcmp(content_type, "audio/flac") == 0)
+		find_sync = flac_find_sync;
+	else if (burst_seconds > 0) {
+		FormatWarning(httpd_output_domain,
+			      "Burst is not supported for %s, disabling it",
+			      content_type);
+		burst_seconds = 0;
+	}
+
 	return true;
 }
 
@@ -143,7 +264,7 @@ HttpdOutput::Init(const config_param &param, Error &error)
 static AudioOutput *
 httpd_output_init(const config_param &param, Error &error)
 {
-	HttpdOutput *httpd = new HttpdOutput(io_thread_get());
+	HttpdOutput *httpd = new HttpdOutput(io_thread_next());
 
 	AudioOutput *result = httpd->InitAndConfigure(param, error);
 	if (result == nullptr)
@@ -164,18 +285,40 @@ httpd_output_finish(AudioOutput *ao)
  * Creates a new #HttpdClient object and adds it into the
  * HttpdOutput.clients linked list.
  */
-inline void
-HttpdOutput::AddClient(int fd)
+void
+HttpdOutput::AddClient(int fd, EventLoop &loop)
 {
-	clients.emplace_front(*this, fd, GetEventLoop(),
+	if (!open) {
+		/* the output has been closed while the connection
+		   was being passed to a client thread */
+		close_socket(fd);
+		return;
+	}
+
+	clients.emplace_front(*this, fd, loop,
 			      encoder->plugin.tag == nullptr);
-	++clients_cnt;
 
 	/* pass metadata to client */
 	if (metadata != nullptr)
 		clients.front().PushMetaData(metadata);
 }
 
+void
+HttpdOutput::PushPage(Page *page, const EventLoop &loop)
+{
+	for (auto &client : clients)
+		if (&client.GetEventLoop() == &loop)
+			client.PushPage(page);
+}
+
+void
+HttpdOutput::ClearClients(const EventLoop &loop)
+{
+	clients.remove_if([&loop](HttpdClient &client){
+			return &client.GetEventLoop() == &loop;
+		});
+}
+
 void
 HttpdOutput::RunDeferred()
 {
@@ -236,9 +379,19 @@ HttpdOutput::OnAccept(int fd, const sockaddr &address,
 
 	if (fd >= 0) {
 		/* can we allow additional client */
-		if (open && (clients_max == 0 ||  clients_cnt < clients_max))
-			AddClient(fd);
-		else
+		if (open && (clients_max == 0 ||  clients_cnt < clients_max)) {
+			++clients_cnt;
+
+			if (threads.empty())
+				AddClient(fd, GetEventLoop());
+			else {
+				/* hand the connection over to the next
+				   client thread */
+				next_thread->AddClient(fd);
+				if (++next_thread == threads.end())
+					next_thread = threads.begin();
+			}
+		} else
 			close_socket(fd);
 	} else if (fd < 0 && errno != EINTR) {
 		LogErrno(httpd_output_domain, "accept() failed");
@@ -323,6 +476,9 @@ HttpdOutput::Open(AudioFormat &audio_format, Error &error)
 	clients_cnt = 0;
 	timer = new Timer(audio_format);
 
+	burst_size = uint64_t(burst_seconds) * audio_format.GetTimeToSize();
+	input_position = 0;
+
 	open = true;
 
 	return true;
@@ -343,16 +499,37 @@ HttpdOutput::Close()
 {
 	assert(open);
 
-	open = false;
+	{
+		const ScopeLock protect(mutex);
+		open = false;
+	}
 
 	delete timer;
 
-	BlockingCall(GetEventLoop(), [this](){
-			clients.clear();
-		});
-
-	if (header != nullptr)
-		header->Unref();
+	/* the mutex must not be locked while waiting for a client
+	   thread, because that thread may be waiting for it */
+
+	if (threads.empty())
+		BlockingCall(GetEventLoop(), [this](){
+				const ScopeLock protect(mutex);
+				clients.clear();
+			});
+
+	for (auto &thread : threads)
+		BlockingCall(thread.GetEventLoop(), [this, &thread](){
+				const ScopeLock protect(mutex);
+				thread.CloseNewClients();
+				thread.ClearQueue();
+				ClearClients(thread.GetEventLoop());
+			});
+
+	{
+		const ScopeLock protect(mutex);
+		ClearBacklog();
+
+		if (header != nullptr)
+			header->Unref();
+	}
 
 	encoder_close(encoder);
 }
@@ -362,7 +539,6 @@ httpd_output_close(AudioOutput *ao)
 {
 	HttpdOutput *httpd = HttpdOutput::Cast(ao);
 
-	const ScopeLock protect(httpd->mutex);
 	httpd->Close();
 }
 
@@ -383,10 +559,83 @@ HttpdOutput::RemoveClient(HttpdClient &client)
 }
 
 void
-HttpdOutput::SendHeader(HttpdClient &client) const
+HttpdOutput::SendHeader(HttpdClient &client)
 {
+	const ScopeLock protect(mutex);
+
 	if (header != nullptr)
 		client.PushPage(header);
+
+	SendBacklog(client);
+}
+
+void
+HttpdOutput::AppendBacklog(Page *page)
+{
+	if (burst_size == 0)
+		return;
+
+	page->Ref();
+	backlog.push_back({page, input_position});
+
+	while (backlog.size() > 1 &&
+	       backlog.front().position + burst_size < input_position) {
+		backlog.front().page->Unref();
+		backlog.pop_front();
+	}
+}
+
+void
+HttpdOutput::ClearBacklog()
+{
+	for (auto &i : backlog)
+		i.page->Unref();
+
+	backlog.clear();
+}
+
+void
+HttpdOutput::SendBacklog(HttpdClient &client)
+{
+	/* the most recent pages may still be queued for this
+	   client's thread; they will arrive the normal way and must
+	   not be sent twice */
+	const size_t queued = std::min(CountQueuedPages(client.GetEventLoop()),
+				       backlog.size());
+	const auto end = backlog.end() - queued;
+
+	/* skip to the first frame boundary; the client cannot decode
+	   a partial frame */
+
+	auto i = backlog.begin();
+	size_t offset = 0;
+	for (; i != end; ++i) {
+		const Page &page = *i->page;
+		offset = find_sync(page.data, page.size);
+		if (offset < page.size)
+			break;
+	}
+
+	if (i == end)
+		return;
+
+	size_t size = 0;
+	for (auto j = i; j != end; ++j)
+		size += j->page->size;
+
+	client.GrowQueueLimit(size);
+
+	if (offset > 0) {
+		const Page &page = *i->page;
+		Page *partial = Page::Copy(page.data + offset,
+					   page.size - offset);
+		client.PushPage(partial);
+		partial->Unref();
+		++i;
+	}
+
+	for (; i != end; ++i)
+		client.PushPage(i->page);
 }
 
 inline unsigned
@@ -424,33 +673,88 @@ HttpdOutput::BroadcastPage(Page *page)
 	assert(page != nullptr);
 
 	mutex.lock();
-	pages.push(page);
-	page->Ref();
+	QueuePage(page);
 	mutex.unlock();
+}
+
+void
+HttpdOutput::QueuePage(Page *page)
+{
+	if (threads.empty()) {
+		page->Ref();
+		pages.push(page);
+
+		DeferredMonitor::Schedule();
+	} else {
+		for (auto &thread : threads)
+			thread.PushPage(page);
+	}
+}
+
+bool
+HttpdOutput::HasQueuedPages() const
+{
+	if (!pages.empty())
+		return true;
+
+	for (const auto &thread : threads)
+		if (thread.HasPages())
+			return true;
+
+	return false;
+}
+
+size_t
+HttpdOutput::CountQueuedPages(EventLoop &loop)
+{
+	if (threads.empty())
+		return pages.size();
 
-	DeferredMonitor::Schedule();
+	for (auto &thread : threads)
+		if (&thread.GetEventLoop() == &loop)
+			return thread.GetPageCount();
+
+	return 0;
 }
 
 void
-HttpdOutput::BroadcastFromEncoder()
+HttpdOutput::BroadcastFromEncoder(Page *extra)
 {
-	/* synchronize with the IOThread */
+	/* synchronize with the IOThread and the client threads */
 	mutex.lock();
-	while (!pages.empty())
+	while (HasQueuedPages())
 		cond.wait(mutex);
 
 	Page *page;
-	while ((page = ReadPage()) != nullptr)
-		pages.push(page);
+	while ((page = ReadPage()) != nullptr) {
+		QueuePage(page);
+		AppendBacklog(page);
+		page->Unref();
+	}
 
-	mutex.unlock();
+	if (extra != nullptr) {
+		QueuePage(extra);
+		AppendBacklog(extra);
+	}
 
-	DeferredMonitor::Schedule();
+	mutex.unlock();
 }
 
 inline bool
 HttpdOutput::EncodeAndPlay(const void *chunk, size_t size, Error &error)
 {
+	input_position += size;
+
+	if (encoder_is_passthrough(encoder)) {
+		/* the PCM data is the stream: copy it into a page
+		   right away, instead of through the encoder's
+		   buffer and ReadPage() */
+		Page *page = Page::Copy(chunk, size);
+		BroadcastFromEncoder(page);
+		page->Unref();
+		return true;
+	}
+
 	if (!encoder_write(encoder, chunk, size, error))
 		return false;
 
@@ -463,7 +767,11 @@ HttpdOutput::EncodeAndPlay(const void *chunk, size_t size, Error &error)
 inline size_t
 HttpdOutput::Play(const void *chunk, size_t size, Error &error)
 {
-	if (LockHasClients()) {
+	/* a shared encoder may be fed by this output for others,
+	   even if it has no clients of its own; and the backlog must
+	   be filled for the next client */
+	if (LockHasClients() || encoder_is_shared(encoder) ||
+	    burst_size > 0) {
 		if (!EncodeAndPlay(chunk, size, error))
 			return 0;
 	}
@@ -522,9 +830,18 @@ HttpdOutput::SendTag(const Tag *tag)
 
 		Page *page = ReadPage();
 		if (page != nullptr) {
+			mutex.lock();
+
+			/* the backlog belongs to the previous
+			   stream */
+			ClearBacklog();
+
 			if (header != nullptr)
 				header->Unref();
 			header = page;
+
+			mutex.unlock();
+
 			BroadcastPage(page);
 		}
 	} else {
@@ -572,14 +889,37 @@ HttpdOutput::CancelAllClients()
 	cond.broadcast();
 }
 
+inline void
+HttpdOutput::Cancel()
+{
+	if (threads.empty()) {
+		BlockingCall(GetEventLoop(), [this](){
+				CancelAllClients();
+			});
+		return;
+	}
+
+	for (auto &thread : threads)
+		BlockingCall(thread.GetEventLoop(), [this, &thread](){
+				const ScopeLock protect(mutex);
+
+				thread.ClearQueue();
+
+				EventLoop &loop = thread.GetEventLoop();
+				for (auto &client : clients)
+					if (&client.GetEventLoop() == &loop)
+						client.CancelQueue();
+
+				cond.broadcast();
+			});
+}
+
 static void
 httpd_output_cancel(AudioOutput *ao)
 {
 	HttpdOutput *httpd = HttpdOutput::Cast(ao);
 
-	BlockingCall(io_thread_get(), [httpd](){
-			httpd->CancelAllClients();
-		});
+	httpd->Cancel();
 }
 
 const struct AudioOutputPlugin httpd_output_plugin = {
@@ -592,6 +932,7 @@ const struct AudioOutputPlugin httpd_output_plugin = {
 	httpd_output_open,
 	httpd_output_close,
 	httpd_output_delay,
+	nullptr,
 	httpd_output_tag,
 	httpd_output_play,
 	nullptr,
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "HttpdThread.hxx"
+#include "HttpdInternal.hxx"
+#include "Page.hxx"
+#include "thread/Name.hxx"
+#include "system/fd_util.h"
+
+#include <assert.h>
+
+HttpdThread::~HttpdThread()
+{
+	assert(new_fds.empty());
+
+	ClearQueue();
+}
+
+bool
+HttpdThread::Start(Error &error)
+{
+	return thread.Start(Run, this, error);
+}
+
+void
+HttpdThread::Stop()
+{
+	event_loop.Break();
+	thread.Join();
+}
+
+inline void
+HttpdThread::Run()
+{
+	SetThreadName("httpd");
+
+	event_loop.Run();
+}
+
+void
+HttpdThread::Run(void *ctx)
+{
+	HttpdThread &t = *(HttpdThread *)ctx;
+	t.Run();
+}
+
+void
+HttpdThread::PushPage(Page *page)
+{
+	page->Ref();
+	pages.push(page);
+
+	Schedule();
+}
+
+void
+HttpdThread::ClearQueue()
+{
+	while (!pages.empty()) {
+		pages.front()->Unref();
+		pages.pop();
+	}
+}
+
+void
+HttpdThread::CloseNewClients()
+{
+	for (int fd : new_fds)
+		close_socket(fd);
+
+	new_fds.clear();
+}
+
+void
+HttpdThread::RunDeferred()
+{
+	const ScopeLock protect(httpd.mutex);
+
+	while (!new_fds.empty()) {
+		const int fd = new_fds.front();
+		new_fds.pop_front();
+
+		httpd.AddClient(fd, event_loop);
+	}
+
+	while (!pages.empty()) {
+		Page *page = pages.front();
+		pages.pop();
+
+		httpd.PushPage(page, event_loop);
+		page->Unref();
+	}
+
+	/* wake up the client that may be waiting for the queue to be
+	   flushed */
+	httpd.cond.broadcast();
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_OUTPUT_HTTPD_THREAD_HXX
+#define MPD_OUTPUT_HTTPD_THREAD_HXX
+
+#include "check.h"
+#include "event/Loop.hxx"
+#include "event/DeferredMonitor.hxx"
+#include "thread/Thread.hxx"
+
+#include <forward_list>
+#include <queue>
+
+class HttpdOutput;
+class Page;
+class Error;
+
+/**
+ * Holds the #EventLoop of a #HttpdThread.  This is a separate base
+ * class, because the loop must be constructed before the
+ * #DeferredMonitor which refers to it.
+ */
+struct HttpdThreadLoop {
+	EventLoop event_loop;
+};
+
+/**
+ * A dedicated thread which serves a share of the httpd output's
+ * clients with its own #EventLoop, so connecting and streaming
+ * clients don't load the #IOThread.
+ */
+class HttpdThread final : HttpdThreadLoop, DeferredMonitor {
+	HttpdOutput &httpd;
+
+	Thread thread;
+
+	/**
+	 * Sockets of newly accepted connections, which are going to
+	 * become #HttpdClient objects inside this thread.  Protected
+	 * by HttpdOutput::mutex.
+	 */
+	std::forward_list<int> new_fds;
+
+	/**
+	 * Pages to be pushed to the clients of this thread.
+	 * Protected by HttpdOutput::mutex, and removing signals
+	 * HttpdOutput::cond.
+	 */
+	std::queue<Page *> pages;
+
+public:
+	explicit HttpdThread(HttpdOutput &_httpd)
+		:DeferredMonitor(event_loop), httpd(_httpd) {}
+
+	~HttpdThread();
+
+	HttpdThread(const HttpdThread &) = delete;
+	HttpdThread &operator=(const HttpdThread &) = delete;
+
+	using DeferredMonitor::GetEventLoop;
+
+	bool Start(Error &error);
+
+	/**
+	 * Stop the thread and wait for it to finish.  The clients of
+	 * this thread must have been removed already.
+	 */
+	void Stop();
+
+	/**
+	 * Pass a newly accepted connection to this thread.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void AddClient(int fd) {
+		new_fds.push_front(fd);
+		Schedule();
+	}
+
+	/**
+	 * Queue a page for all clients of this thread.  A new
+	 * reference is added.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void PushPage(Page *page);
+
+	/**
+	 * Caller must lock the mutex.
+	 */
+	bool HasPages() const {
+		return !pages.empty();
+	}
+
+	/**
+	 * Caller must lock the mutex.
+	 */
+	size_t GetPageCount() const {
+		return pages.size();
+	}
+
+	/**
+	 * Remove all pages from the queue.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void ClearQueue();
+
+	/**
+	 * Close all connections which have not been turned into
+	 * #HttpdClient objects yet.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void CloseNewClients();
+
+private:
+	void Run();
+	static void Run(void *ctx);
+
+	virtual void RunDeferred() override;
+};
+
+#endif
@@ -47,12 +47,32 @@ PcmChannelsConverter::Open(SampleFormat _format,
 		return false;
 	}
 
-	format = _format;
+	src_format = format = _format;
 	src_channels = _src_channels;
 	dest_channels = _dest_channels;
 	return true;
 }
 
+void
+PcmChannelsConverter::Open(SampleFormat _src_format,
+			   SampleFormat _dest_format,
+			   unsigned _src_channels, unsigned _dest_channels)
+{
+	assert(CanConvertFormat(_src_format, _dest_format));
+
+	src_format = _src_format;
+	format = _dest_format;
+	src_channels = _src_channels;
+	dest_channels = _dest_channels;
+}
+
+bool
+PcmChannelsConverter::CanConvertFormat(SampleFormat _src_format,
+				       SampleFormat _dest_format)
+{
+	return pcm_convert_channels_supported(_dest_format, _src_format);
+}
+
 void
 PcmChannelsConverter::Close()
 {
@@ -64,6 +84,10 @@ PcmChannelsConverter::Close()
 ConstBuffer<void>
 PcmChannelsConverter::Convert(ConstBuffer<void> src, gcc_unused Error &error)
 {
+	if (src_format != format)
+		return pcm_convert_channels(buffer, format, dest_channels,
+					    src_format, src_channels, src);
+
 	switch (format) {
 	case SampleFormat::UNDEFINED:
 	case SampleFormat::S8:
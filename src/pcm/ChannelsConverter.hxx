@@ -35,6 +35,15 @@ template<typename T> struct ConstBuffer;
  * A class that converts samples from one format to another.
  */
 class PcmChannelsConverter {
+	/**
+	 * The sample format of incoming data; differs from #format
+	 * if the sample format is converted in the same pass.
+	 */
+	SampleFormat src_format;
+
+	/**
+	 * The sample format of outgoing data.
+	 */
 	SampleFormat format;
 	unsigned src_channels, dest_channels;
 
@@ -63,6 +72,28 @@ public:
 		  unsigned src_channels, unsigned dest_channels,
 		  Error &error);
 
+	/**
+	 * Opens the object for converting the sample format and the
+	 * number of channels in one pass.  The caller must check
+	 * CanConvertFormat() first.
+	 *
+	 * @param src_format the sample format of incoming data
+	 * @param dest_format the sample format of outgoing data
+	 * @param src_channels the number of source channels
+	 * @param dest_channels the number of destination channels
+	 */
+	void Open(SampleFormat src_format, SampleFormat dest_format,
+		  unsigned src_channels, unsigned dest_channels);
+
+	/**
+	 * Can the sample format be converted together with the
+	 * channels?  This is not possible for conversions which need
+	 * dithering.
+	 */
+	gcc_const
+	static bool CanConvertFormat(SampleFormat src_format,
+				     SampleFormat dest_format);
+
 	/**
 	 * Closes the object.  After that, you may call Open() again.
 	 */
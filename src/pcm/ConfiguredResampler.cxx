@@ -19,10 +19,13 @@
 
 #include "config.h"
 #include "ConfiguredResampler.hxx"
+#include "AudioFormat.hxx"
 #include "FallbackResampler.hxx"
+#include "PolyphaseResampler.hxx"
 #include "config/ConfigGlobal.hxx"
 #include "config/ConfigOption.hxx"
 #include "config/ConfigError.hxx"
+#include "thread/Mutex.hxx"
 #include "util/Error.hxx"
 
 #ifdef HAVE_LIBSAMPLERATE
@@ -33,11 +36,16 @@
 #include "SoxrResampler.hxx"
 #endif
 
+#include <list>
+
+#include <assert.h>
 #include <string.h>
 
 enum class SelectedResampler {
 	FALLBACK,
 
+	POLYPHASE,
+
 #ifdef HAVE_LIBSAMPLERATE
 	LIBSAMPLERATE,
 #endif
@@ -58,6 +66,11 @@ pcm_resampler_global_init(Error &error)
 	if (strcmp(converter, "internal") == 0)
 		return true;
 
+	if (strncmp(converter, "polyphase", 9) == 0) {
+		selected_resampler = SelectedResampler::POLYPHASE;
+		return pcm_resample_polyphase_global_init(converter, error);
+	}
+
 #ifdef HAVE_SOXR
 	if (memcmp(converter, "soxr", 4) == 0) {
 		selected_resampler = SelectedResampler::SOXR;
@@ -86,6 +99,9 @@ pcm_resampler_create()
 	case SelectedResampler::FALLBACK:
 		return new FallbackPcmResampler();
 
+	case SelectedResampler::POLYPHASE:
+		return new PolyphasePcmResampler();
+
 #ifdef HAVE_LIBSAMPLERATE
 	case SelectedResampler::LIBSAMPLERATE:
 		return new LibsampleratePcmResampler();
@@ -99,3 +115,109 @@ pcm_resampler_create()
 
 	gcc_unreachable();
 }
+
+/**
+ * An idle resampler which is kept open for reuse.  The quality
+ * setting is global, so the formats are the only key.
+ */
+struct CachedResampler {
+	AudioFormat src_format;
+	unsigned new_sample_rate;
+
+	AudioFormat requested_format, dest_format;
+
+	PcmResampler *resampler;
+};
+
+/**
+ * The maximum number of idle resamplers.  This is enough for a few
+ * outputs and playlists mixing two or three sample rates.
+ */
+static constexpr size_t MAX_CACHED_RESAMPLERS = 4;
+
+static Mutex resampler_cache_mutex;
+
+/**
+ * The idle resamplers; the most recently released one is at the
+ * front.
+ */
+static std::list<CachedResampler> resampler_cache;
+
+static void
+pcm_resampler_delete(PcmResampler *resampler)
+{
+	resampler->Close();
+	delete resampler;
+}
+
+void
+pcm_resampler_global_finish()
+{
+	const ScopeLock protect(resampler_cache_mutex);
+
+	for (const auto &i : resampler_cache)
+		pcm_resampler_delete(i.resampler);
+	resampler_cache.clear();
+}
+
+PcmResampler *
+pcm_resampler_open(AudioFormat &af, unsigned new_sample_rate,
+		   AudioFormat &dest_format_r, Error &error)
+{
+	assert(af.IsValid());
+	assert(audio_valid_sample_rate(new_sample_rate));
+
+	{
+		const ScopeLock protect(resampler_cache_mutex);
+
+		for (auto i = resampler_cache.begin();
+		     i != resampler_cache.end(); ++i) {
+			if (i->src_format == af &&
+			    i->new_sample_rate == new_sample_rate) {
+				PcmResampler *resampler = i->resampler;
+				af = i->requested_format;
+				dest_format_r = i->dest_format;
+				resampler_cache.erase(i);
+
+				resampler->Reset();
+				return resampler;
+			}
+		}
+	}
+
+	PcmResampler *resampler = pcm_resampler_create();
+	dest_format_r = resampler->Open(af, new_sample_rate, error);
+	if (!dest_format_r.IsValid()) {
+		delete resampler;
+		return nullptr;
+	}
+
+	return resampler;
+}
+
+void
+pcm_resampler_release(PcmResampler *resampler,
+		      AudioFormat src_format, unsigned new_sample_rate,
+		      AudioFormat requested_format, AudioFormat dest_format)
+{
+	assert(resampler != nullptr);
+
+	PcmResampler *evicted = nullptr;
+
+	{
+		const ScopeLock protect(resampler_cache_mutex);
+
+		resampler_cache.push_front({src_format, new_sample_rate,
+					   requested_format, dest_format,
+					   resampler});
+
+		if (resampler_cache.size() > MAX_CACHED_RESAMPLERS) {
+			evicted = resampler_cache.back().resampler;
+			resampler_cache.pop_back();
+		}
+	}
+
+	/* free the least recently used one outside of the lock */
+	if (evicted != nullptr)
+		pcm_resampler_delete(evicted);
+}
@@ -22,12 +22,19 @@
 
 #include "check.h"
 
+struct AudioFormat;
 class Error;
 class PcmResampler;
 
 bool
 pcm_resampler_global_init(Error &error);
 
+/**
+ * Free the resamplers which are kept open by pcm_resampler_release().
+ */
+void
+pcm_resampler_global_finish();
+
 /**
  * Create a #PcmResampler instance from the implementation class
  * configured in mpd.conf.
@@ -35,4 +42,33 @@ pcm_resampler_global_init(Error &error);
 PcmResampler *
 pcm_resampler_create();
 
+/**
+ * Obtain an opened #PcmResampler.  If a matching one was released
+ * recently, it is reset and reused; this avoids building the filter
+ * again when switching between songs of the same formats.
+ *
+ * @param af the audio format of incoming data; this may be modified
+ * just like PcmResampler::Open() does
+ * @param new_sample_rate the requested output sample rate
+ * @param dest_format_r the format of outgoing data is returned here
+ * @return the resampler (to be passed to pcm_resampler_release()) or
+ * nullptr on error
+ */
+PcmResampler *
+pcm_resampler_open(AudioFormat &af, unsigned new_sample_rate,
+		   AudioFormat &dest_format_r, Error &error);
+
+/**
+ * Give back a resampler obtained from pcm_resampler_open().  It may
+ * be kept open for a future pcm_resampler_open() call with the same
+ * parameters, or it may be closed and freed.
+ *
+ * @param src_format the source format which was passed to
+ * pcm_resampler_open() (before it was modified)
+ */
+void
+pcm_resampler_release(PcmResampler *resampler,
+		      AudioFormat src_format, unsigned new_sample_rate,
+		      AudioFormat requested_format, AudioFormat dest_format);
+
 #endif
@@ -62,6 +62,11 @@ FallbackPcmResampler::Close()
 {
 }
 
+void
+FallbackPcmResampler::Reset()
+{
+}
+
 template<typename T>
 static ConstBuffer<T>
 pcm_resample_fallback(PcmBuffer &buffer,
@@ -34,11 +34,18 @@ struct FloatToIntegerSampleConvert {
 	typedef typename SrcTraits::long_type SL;
 	typedef typename DstTraits::value_type DV;
 
-	static constexpr SV factor = 1 << (DstTraits::BITS - 1);
+	static constexpr SV factor = 1u << (DstTraits::BITS - 1);
 
 	gcc_const
 	static DV Convert(SV src) {
-		return PcmClamp<F, Traits>(SL(src * factor));
+		/* clip before the conversion to integer, because that
+		   is undefined for values which are out of range */
+		const SL x = src * factor;
+		if (x >= SL(DstTraits::MAX))
+			return DstTraits::MAX;
+		if (x <= SL(DstTraits::MIN))
+			return DstTraits::MIN;
+		return DV(x);
 	}
 };
 
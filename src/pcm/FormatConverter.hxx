@@ -53,6 +53,14 @@ public:
 	}
 #endif
 
+	/**
+	 * Select the kind of dither noise for conversions which
+	 * reduce the sample resolution.
+	 */
+	void SetDitherMode(PcmDitherMode mode) {
+		dither.SetMode(mode);
+	}
+
 	/**
 	 * Opens the object, prepare for Convert().
 	 *
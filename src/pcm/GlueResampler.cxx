@@ -25,25 +25,26 @@
 #include <assert.h>
 
 GluePcmResampler::GluePcmResampler()
-	:resampler(pcm_resampler_create()) {}
+	:resampler(nullptr) {}
 
 GluePcmResampler::~GluePcmResampler()
 {
-	delete resampler;
+	assert(resampler == nullptr);
 }
 
 bool
-GluePcmResampler::Open(AudioFormat src_format, unsigned new_sample_rate,
+GluePcmResampler::Open(AudioFormat _src_format, unsigned new_sample_rate,
 		       Error &error)
 {
-	assert(src_format.IsValid());
+	assert(resampler == nullptr);
+	assert(_src_format.IsValid());
 	assert(audio_valid_sample_rate(new_sample_rate));
 
-	AudioFormat requested_format = src_format;
-	AudioFormat dest_format = resampler->Open(requested_format,
-						  new_sample_rate,
-						  error);
-	if (!dest_format.IsValid())
+	src_format = _src_format;
+	requested_format = src_format;
+	resampler = pcm_resampler_open(requested_format, new_sample_rate,
+				       dest_format, error);
+	if (resampler == nullptr)
 		return false;
 
 	assert(requested_format.channels == src_format.channels);
@@ -52,22 +53,28 @@ GluePcmResampler::Open(AudioFormat src_format, unsigned new_sample_rate,
 
 	if (requested_format.format != src_format.format &&
 	    !format_converter.Open(src_format.format, requested_format.format,
-				   error))
+				   error)) {
+		pcm_resampler_release(resampler, src_format, new_sample_rate,
+				      requested_format, dest_format);
+		resampler = nullptr;
 		return false;
+	}
 
-	src_sample_format = src_format.format;
-	requested_sample_format = requested_format.format;
-	output_sample_format = dest_format.format;
 	return true;
 }
 
 void
 GluePcmResampler::Close()
 {
-	if (requested_sample_format != src_sample_format)
+	assert(resampler != nullptr);
+
+	if (requested_format.format != src_format.format)
 		format_converter.Close();
 
-	resampler->Close();
+	pcm_resampler_release(resampler,
+			      src_format, dest_format.sample_rate,
+			      requested_format, dest_format);
+	resampler = nullptr;
 }
 
 ConstBuffer<void>
@@ -75,7 +82,7 @@ GluePcmResampler::Resample(ConstBuffer<void> src, Error &error)
 {
 	assert(!src.IsNull());
 
-	if (requested_sample_format != src_sample_format) {
+	if (requested_format.format != src_format.format) {
 		src = format_converter.Convert(src, error);
 		if (src.IsNull())
 			return nullptr;
@@ -34,10 +34,13 @@ template<typename T> struct ConstBuffer;
  * #PcmResampler instance.
  */
 class GluePcmResampler {
-	PcmResampler *const resampler;
+	/**
+	 * The resampler obtained from pcm_resampler_open(); nullptr
+	 * while this object is closed.
+	 */
+	PcmResampler *resampler;
 
-	SampleFormat src_sample_format, requested_sample_format;
-	SampleFormat output_sample_format;
+	AudioFormat src_format, requested_format, dest_format;
 
 	/**
 	 * This object converts input data to the sample format
@@ -54,7 +57,7 @@ public:
 	void Close();
 
 	SampleFormat GetOutputSampleFormat() const {
-		return output_sample_format;
+		return dest_format.format;
 	}
 
 	ConstBuffer<void> Resample(ConstBuffer<void> src, Error &error);
@@ -0,0 +1,364 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Loudness.hxx"
+
+#ifdef __SSE2__
+#define PCM_LOUDNESS_SSE2
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+
+#include <assert.h>
+#include <math.h>
+
+/**
+ * Calculate the K-weighting high shelf for the given sample rate
+ * (BS.1770 stage 1; the standard only lists coefficients for 48 kHz).
+ */
+static void
+k_weighting_shelf(double sample_rate, double &b0, double &b1, double &b2,
+		  double &a1, double &a2)
+{
+	static constexpr double f0 = 1681.974450955533;
+	static constexpr double gain_db = 3.999843853973347;
+	static constexpr double q = 0.7071752369554196;
+
+	const double k = tan(M_PI * f0 / sample_rate);
+	const double vh = pow(10.0, gain_db / 20.0);
+	const double vb = pow(vh, 0.4996667741545416);
+	const double a0 = 1.0 + k / q + k * k;
+
+	b0 = (vh + vb * k / q + k * k) / a0;
+	b1 = 2.0 * (k * k - vh) / a0;
+	b2 = (vh - vb * k / q + k * k) / a0;
+	a1 = 2.0 * (k * k - 1.0) / a0;
+	a2 = (1.0 - k / q + k * k) / a0;
+}
+
+/**
+ * Calculate the K-weighting high-pass filter (BS.1770 stage 2, the
+ * "RLB" curve).
+ */
+static void
+k_weighting_highpass(double sample_rate, double &b0, double &b1, double &b2,
+		     double &a1, double &a2)
+{
+	static constexpr double f0 = 38.13547087602444;
+	static constexpr double q = 0.5003270373238773;
+
+	const double k = tan(M_PI * f0 / sample_rate);
+	const double a0 = 1.0 + k / q + k * k;
+
+	b0 = 1.0;
+	b1 = -2.0;
+	b2 = 1.0;
+	a1 = 2.0 * (k * k - 1.0) / a0;
+	a2 = (1.0 - k / q + k * k) / a0;
+}
+
+/**
+ * The BS.1770 weight of the given channel.  The surround channels
+ * are boosted by 1.5 dB, and the LFE channel is ignored.
+ */
+gcc_const
+static double
+channel_weight(unsigned channels, unsigned i)
+{
+	switch (channels) {
+	case 5:
+		/* FL FR FC RL RR */
+		return i >= 3 ? 1.41 : 1.0;
+
+	case 6:
+	case 7:
+	case 8:
+		/* FL FR FC LFE RL RR ... */
+		if (i == 3)
+			return 0;
+
+		return i >= 4 ? 1.41 : 1.0;
+
+	default:
+		return 1.0;
+	}
+}
+
+gcc_const
+static double
+energy_to_loudness(double energy)
+{
+	return -0.691 + 10.0 * log10(energy);
+}
+
+void
+LoudnessMeter::Open(unsigned sample_rate, unsigned _channels)
+{
+	assert(audio_valid_sample_rate(sample_rate));
+	assert(audio_valid_channel_count(_channels));
+
+	channels = _channels;
+
+	k_weighting_shelf(sample_rate, shelf.b0, shelf.b1, shelf.b2,
+			  shelf.a1, shelf.a2);
+	k_weighting_highpass(sample_rate, highpass.b0, highpass.b1,
+			     highpass.b2, highpass.a1, highpass.a2);
+
+	step_frames = std::max(sample_rate / 10, 1u);
+	step_position = 0;
+	n_steps = 0;
+
+	for (unsigned i = 0; i < MAX_CHANNELS; ++i) {
+		for (unsigned j = 0; j < 4; ++j)
+			z[j][i] = 0;
+
+		energy[i] = 0;
+		weight[i] = i < channels ? channel_weight(channels, i) : 0;
+
+		std::fill_n(tp_history[i], 2 * TP_TAPS, 0.f);
+	}
+
+	std::fill_n(step_energy, 4, 0.);
+	std::fill_n(histogram_energy, HISTOGRAM_SIZE, 0.);
+	std::fill_n(histogram_count, HISTOGRAM_SIZE, 0u);
+
+	/* a Hann-windowed sinc for 4x oversampling; phase p
+	   interpolates at p/4 between the frames TP_TAPS/2-1 and
+	   TP_TAPS/2 of the history */
+	static constexpr double half = TP_TAPS / 2;
+	for (unsigned p = 0; p < 4; ++p) {
+		const double offset = half - 1 + p / 4.;
+
+		double sum = 0;
+		for (unsigned k = 0; k < TP_TAPS; ++k) {
+			const double t = offset - k;
+			const double window = 0.5 * (1 + cos(M_PI * t / half));
+			const double sinc = t == 0
+				? 1.
+				: sin(M_PI * t) / (M_PI * t);
+
+			const double c = sinc * window;
+			tp_coefficients[k][p] = c;
+			sum += c;
+		}
+
+		for (unsigned k = 0; k < TP_TAPS; ++k)
+			tp_coefficients[k][p] /= sum;
+	}
+
+	tp_position = 0;
+	std::fill_n(tp_peak, 4, 0.f);
+}
+
+inline void
+LoudnessMeter::FinishStep()
+{
+	double e = 0;
+	for (unsigned i = 0; i < channels; ++i) {
+		e += weight[i] * energy[i];
+		energy[i] = 0;
+	}
+
+	step_energy[n_steps++ & 3] = e;
+	if (n_steps < 4)
+		return;
+
+	/* a 400 ms block with 75% overlap is complete */
+
+	const double block = (step_energy[0] + step_energy[1] +
+			      step_energy[2] + step_energy[3])
+		/ (4. * step_frames);
+	if (block <= 0)
+		return;
+
+	const double loudness = energy_to_loudness(block);
+	if (loudness < -70)
+		/* absolute gate */
+		return;
+
+	unsigned bin = std::min(unsigned((loudness + 70) * 10),
+				HISTOGRAM_SIZE - 1);
+	histogram_energy[bin] += block;
+	++histogram_count[bin];
+}
+
+inline void
+LoudnessMeter::FeedPeak(const float *frame)
+{
+	tp_position = (tp_position + 1) % TP_TAPS;
+
+#ifdef PCM_LOUDNESS_SSE2
+	const __m128 sign = _mm_set1_ps(-0.f);
+	__m128 peak = _mm_load_ps(tp_peak);
+#endif
+
+	for (unsigned c = 0; c < channels; ++c) {
+		float *const history = tp_history[c];
+		history[tp_position] = history[tp_position + TP_TAPS]
+			= frame[c];
+
+		/* the oldest frame first */
+		const float *x = history + tp_position + 1;
+
+#ifdef PCM_LOUDNESS_SSE2
+		__m128 sum = _mm_setzero_ps();
+		for (unsigned k = 0; k < TP_TAPS; ++k)
+			sum = _mm_add_ps(sum,
+					 _mm_mul_ps(_mm_load_ps(tp_coefficients[k]),
+						    _mm_set1_ps(x[k])));
+
+		peak = _mm_max_ps(peak, _mm_andnot_ps(sign, sum));
+#else
+		for (unsigned p = 0; p < 4; ++p) {
+			float sum = 0;
+			for (unsigned k = 0; k < TP_TAPS; ++k)
+				sum += tp_coefficients[k][p] * x[k];
+
+			tp_peak[p] = std::max(tp_peak[p], fabsf(sum));
+		}
+#endif
+	}
+
+#ifdef PCM_LOUDNESS_SSE2
+	_mm_store_ps(tp_peak, peak);
+#endif
+}
+
+void
+LoudnessMeter::Feed(const float *src, size_t n_frames)
+{
+#ifdef PCM_LOUDNESS_SSE2
+	const __m128d s_b0 = _mm_set1_pd(shelf.b0);
+	const __m128d s_b1 = _mm_set1_pd(shelf.b1);
+	const __m128d s_b2 = _mm_set1_pd(shelf.b2);
+	const __m128d s_a1 = _mm_set1_pd(shelf.a1);
+	const __m128d s_a2 = _mm_set1_pd(shelf.a2);
+	const __m128d h_a1 = _mm_set1_pd(highpass.a1);
+	const __m128d h_a2 = _mm_set1_pd(highpass.a2);
+	const __m128d two = _mm_set1_pd(2.0);
+#endif
+
+	/* zero-padded to an even number of channels, so the SIMD
+	   code can process channel pairs */
+	alignas(16) double x[MAX_CHANNELS] = {};
+
+	for (; n_frames > 0; --n_frames, src += channels) {
+		FeedPeak(src);
+
+		for (unsigned c = 0; c < channels; ++c)
+			x[c] = src[c];
+
+#ifdef PCM_LOUDNESS_SSE2
+		/* K-weighting of two channels at a time */
+		for (unsigned c = 0; c < channels; c += 2) {
+			const __m128d in = _mm_load_pd(x + c);
+			__m128d z0 = _mm_load_pd(z[0] + c);
+			__m128d z1 = _mm_load_pd(z[1] + c);
+			__m128d z2 = _mm_load_pd(z[2] + c);
+			__m128d z3 = _mm_load_pd(z[3] + c);
+
+			const __m128d y1 =
+				_mm_add_pd(_mm_mul_pd(s_b0, in), z0);
+			z0 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(s_b1, in),
+						   _mm_mul_pd(s_a1, y1)),
+					z1);
+			z1 = _mm_sub_pd(_mm_mul_pd(s_b2, in),
+					_mm_mul_pd(s_a2, y1));
+
+			/* the high-pass has b0=b2=1, b1=-2 */
+			const __m128d y2 = _mm_add_pd(y1, z2);
+			z2 = _mm_sub_pd(_mm_sub_pd(z3, _mm_mul_pd(two, y1)),
+					_mm_mul_pd(h_a1, y2));
+			z3 = _mm_sub_pd(y1, _mm_mul_pd(h_a2, y2));
+
+			_mm_store_pd(z[0] + c, z0);
+			_mm_store_pd(z[1] + c, z1);
+			_mm_store_pd(z[2] + c, z2);
+			_mm_store_pd(z[3] + c, z3);
+
+			_mm_store_pd(energy + c,
+				     _mm_add_pd(_mm_load_pd(energy + c),
+						_mm_mul_pd(y2, y2)));
+		}
+#else
+		for (unsigned c = 0; c < channels; ++c) {
+			const double in = x[c];
+
+			const double y1 = shelf.b0 * in + z[0][c];
+			z[0][c] = shelf.b1 * in - shelf.a1 * y1 + z[1][c];
+			z[1][c] = shelf.b2 * in - shelf.a2 * y1;
+
+			const double y2 = y1 + z[2][c];
+			z[2][c] = -2 * y1 - highpass.a1 * y2 + z[3][c];
+			z[3][c] = y1 - highpass.a2 * y2;
+
+			energy[c] += y2 * y2;
+		}
+#endif
+
+		if (++step_position == step_frames) {
+			step_position = 0;
+			FinishStep();
+		}
+	}
+}
+
+bool
+LoudnessMeter::IsDefined() const
+{
+	return std::any_of(histogram_count, histogram_count + HISTOGRAM_SIZE,
+			   [](unsigned count){ return count > 0; });
+}
+
+double
+LoudnessMeter::GetIntegratedLoudness() const
+{
+	assert(IsDefined());
+
+	double sum = 0;
+	unsigned count = 0;
+	for (unsigned i = 0; i < HISTOGRAM_SIZE; ++i) {
+		sum += histogram_energy[i];
+		count += histogram_count[i];
+	}
+
+	/* relative gate: 10 LU below the loudness of all blocks
+	   which passed the absolute gate */
+	const double threshold = energy_to_loudness(sum / count) - 10;
+	const unsigned start = threshold > -70
+		? std::min(unsigned((threshold + 70) * 10), HISTOGRAM_SIZE - 1)
+		: 0;
+
+	sum = 0;
+	count = 0;
+	for (unsigned i = start; i < HISTOGRAM_SIZE; ++i) {
+		sum += histogram_energy[i];
+		count += histogram_count[i];
+	}
+
+	return energy_to_loudness(sum / count);
+}
+
+float
+LoudnessMeter::GetTruePeak() const
+{
+	return *std::max_element(tp_peak, tp_peak + 4);
+}
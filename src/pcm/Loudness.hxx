@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_LOUDNESS_HXX
+#define MPD_PCM_LOUDNESS_HXX
+
+#include "AudioFormat.hxx"
+#include "Compiler.h"
+
+#include <stddef.h>
+
+/**
+ * Measures the integrated loudness and the true peak of a PCM stream
+ * according to ITU-R BS.1770 / EBU R128.  Feed it with all samples
+ * of a song, and then query the results.
+ */
+class LoudnessMeter {
+	/**
+	 * The number of taps per phase of the 4x oversampling filter
+	 * used for true peak detection.
+	 */
+	static constexpr unsigned TP_TAPS = 12;
+
+	/**
+	 * The gating histogram has bins of 0.1 LU from -70 LUFS (the
+	 * absolute gate) to +10 LUFS.
+	 */
+	static constexpr unsigned HISTOGRAM_SIZE = 800;
+
+	struct Biquad {
+		double b0, b1, b2, a1, a2;
+	};
+
+	/**
+	 * The two stages of the K-weighting filter: a high shelf
+	 * modelling the acoustic effect of the head, followed by a
+	 * high-pass filter.
+	 */
+	Biquad shelf, highpass;
+
+	unsigned channels;
+
+	/**
+	 * The number of frames in each 100 ms step; four steps make
+	 * one gating block.
+	 */
+	unsigned step_frames;
+
+	/**
+	 * The number of frames accumulated in the current step.
+	 */
+	unsigned step_position;
+
+	/**
+	 * The number of finished steps.
+	 */
+	unsigned n_steps;
+
+	/**
+	 * The K-weighting filter state (transposed direct form II),
+	 * one array per delay element, indexed by channel.
+	 */
+	alignas(16) double z[4][MAX_CHANNELS];
+
+	/**
+	 * The per-channel sum of squared filtered samples in the
+	 * current step.
+	 */
+	alignas(16) double energy[MAX_CHANNELS];
+
+	/**
+	 * The BS.1770 channel weights; zero for unused lanes and the
+	 * LFE channel.
+	 */
+	double weight[MAX_CHANNELS];
+
+	/**
+	 * The weighted energy of the last four steps (ring buffer).
+	 */
+	double step_energy[4];
+
+	double histogram_energy[HISTOGRAM_SIZE];
+	unsigned histogram_count[HISTOGRAM_SIZE];
+
+	/**
+	 * The 4x oversampling filter, arranged as four phases per
+	 * tap.
+	 */
+	alignas(16) float tp_coefficients[TP_TAPS][4];
+
+	/**
+	 * The most recent input samples of each channel, stored twice
+	 * so the filter can read #TP_TAPS consecutive values without
+	 * wrapping.
+	 */
+	float tp_history[MAX_CHANNELS][2 * TP_TAPS];
+	unsigned tp_position;
+
+	/**
+	 * The highest absolute value of each oversampling phase.
+	 */
+	alignas(16) float tp_peak[4];
+
+public:
+	/**
+	 * Prepare the meter for a new stream and reset all state.
+	 */
+	void Open(unsigned sample_rate, unsigned channels);
+
+	/**
+	 * Analyze interleaved floating point samples.
+	 *
+	 * @param n_frames the number of frames (not samples)
+	 */
+	void Feed(const float *src, size_t n_frames);
+
+	/**
+	 * Has at least one block passed the absolute gate?  Otherwise
+	 * (e.g. silence), the loudness is undefined.
+	 */
+	gcc_pure
+	bool IsDefined() const;
+
+	/**
+	 * Returns the gated integrated loudness in LUFS.  Must not be
+	 * called unless IsDefined() returns true.
+	 */
+	gcc_pure
+	double GetIntegratedLoudness() const;
+
+	/**
+	 * Returns the highest (oversampled) absolute sample value; 1.0
+	 * means full scale.
+	 */
+	gcc_pure
+	float GetTruePeak() const;
+
+private:
+	void FinishStep();
+	void FeedPeak(const float *frame);
+};
+
+#endif
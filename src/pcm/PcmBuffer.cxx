@@ -19,6 +19,14 @@
 
 #include "config.h"
 #include "PcmBuffer.hxx"
+#include "util/MemoryStats.hxx"
+
+void
+PcmBuffer::Clear()
+{
+	MemoryStatsResize(MemoryCategory::PCM, buffer.GetCapacity(), 0);
+	buffer.Clear();
+}
 
 void *
 PcmBuffer::Get(size_t new_size)
@@ -28,5 +36,11 @@ PcmBuffer::Get(size_t new_size)
 		   assumed to be an error condition */
 		new_size = 1;
 
-	return buffer.Get(new_size);
+	const size_t old_capacity = buffer.GetCapacity();
+	void *p = buffer.Get(new_size);
+	if (gcc_unlikely(buffer.GetCapacity() != old_capacity))
+		MemoryStatsResize(MemoryCategory::PCM,
+				  old_capacity, buffer.GetCapacity());
+
+	return p;
 }
@@ -29,15 +29,19 @@
  * Manager for a temporary buffer which grows as needed.  We could
  * allocate a new buffer every time pcm_convert() is called, but that
  * would put too much stress on the allocator.
+ *
+ * The memory is accounted in #MemoryCategory::PCM.
  */
 class PcmBuffer {
 	ReusableArray<uint8_t, 8192> buffer;
 
 public:
-	void Clear() {
-		buffer.Clear();
+	~PcmBuffer() {
+		Clear();
 	}
 
+	void Clear();
+
 	/**
 	 * Get the buffer, and guarantee a minimum size.  This buffer becomes
 	 * invalid with the next pcm_buffer_get() call.
@@ -21,25 +21,53 @@
 #include "PcmChannels.hxx"
 #include "PcmBuffer.hxx"
 #include "Traits.hxx"
+#include "ShiftConvert.hxx"
+#include "FloatConvert.hxx"
 #include "AudioFormat.hxx"
 #include "util/ConstBuffer.hxx"
 
 #include <assert.h>
 
-template<typename D, typename S>
-static void
-MonoToStereo(D dest, S src, S end)
+/**
+ * A sample "conversion" which does nothing; used when only the
+ * number of channels changes.
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>>
+struct IdentitySampleConvert {
+	typedef Traits SrcTraits;
+	typedef Traits DstTraits;
+
+	typedef typename Traits::value_type V;
+
+	constexpr static V Convert(V src) {
+		return src;
+	}
+};
+
+/*
+ * The following functions take a sample converter class (see
+ * ShiftConvert.hxx and FloatConvert.hxx) which is applied to each
+ * source sample before the channels are mixed.  This allows changing
+ * the sample format and the number of channels in one pass.
+ */
+
+template<typename C>
+static typename C::DstTraits::pointer_type
+MonoToStereo(typename C::DstTraits::pointer_type dest,
+	     typename C::SrcTraits::const_pointer_type src,
+	     typename C::SrcTraits::const_pointer_type end)
 {
 	while (src != end) {
-		const auto value = *src++;
+		const auto value = C::Convert(*src++);
 
 		*dest++ = value;
 		*dest++ = value;
 	}
 
+	return dest;
 }
 
-template<SampleFormat F, class Traits=SampleTraits<F>>
+template<class Traits>
 static typename Traits::value_type
 StereoToMono(typename Traits::value_type _a,
 	     typename Traits::value_type _b)
@@ -50,35 +78,39 @@ StereoToMono(typename Traits::value_type _a,
 	return typename Traits::value_type((a + b) / 2);
 }
 
-template<SampleFormat F, class Traits=SampleTraits<F>>
-static typename Traits::pointer_type
-StereoToMono(typename Traits::pointer_type dest,
-	     typename Traits::const_pointer_type src,
-	     typename Traits::const_pointer_type end)
+template<typename C>
+static typename C::DstTraits::pointer_type
+StereoToMono(typename C::DstTraits::pointer_type dest,
+	     typename C::SrcTraits::const_pointer_type src,
+	     typename C::SrcTraits::const_pointer_type end)
 {
+	typedef typename C::DstTraits Traits;
+
 	while (src != end) {
-		const auto a = *src++;
-		const auto b = *src++;
+		const auto a = C::Convert(*src++);
+		const auto b = C::Convert(*src++);
 
-		*dest++ = StereoToMono<F, Traits>(a, b);
+		*dest++ = StereoToMono<Traits>(a, b);
 	}
 
 	return dest;
 }
 
-template<SampleFormat F, class Traits=SampleTraits<F>>
-static typename Traits::pointer_type
-NToStereo(typename Traits::pointer_type dest,
+template<typename C>
+static typename C::DstTraits::pointer_type
+NToStereo(typename C::DstTraits::pointer_type dest,
 	  unsigned src_channels,
-	  typename Traits::const_pointer_type src,
-	  typename Traits::const_pointer_type end)
+	  typename C::SrcTraits::const_pointer_type src,
+	  typename C::SrcTraits::const_pointer_type end)
 {
+	typedef typename C::DstTraits Traits;
+
 	assert((end - src) % src_channels == 0);
 
 	while (src != end) {
-		typename Traits::sum_type sum = *src++;
+		typename Traits::sum_type sum = C::Convert(*src++);
 		for (unsigned c = 1; c < src_channels; ++c)
-			sum += *src++;
+			sum += C::Convert(*src++);
 
 		typename Traits::value_type value(sum / int(src_channels));
 
@@ -90,20 +122,22 @@ NToStereo(typename Traits::pointer_type dest,
 	return dest;
 }
 
-template<SampleFormat F, class Traits=SampleTraits<F>>
-static typename Traits::pointer_type
-NToM(typename Traits::pointer_type dest,
+template<typename C>
+static typename C::DstTraits::pointer_type
+NToM(typename C::DstTraits::pointer_type dest,
      unsigned dest_channels,
      unsigned src_channels,
-     typename Traits::const_pointer_type src,
-     typename Traits::const_pointer_type end)
+     typename C::SrcTraits::const_pointer_type src,
+     typename C::SrcTraits::const_pointer_type end)
 {
+	typedef typename C::DstTraits Traits;
+
 	assert((end - src) % src_channels == 0);
 
 	while (src != end) {
-		typename Traits::sum_type sum = *src++;
+		typename Traits::sum_type sum = C::Convert(*src++);
 		for (unsigned c = 1; c < src_channels; ++c)
-			sum += *src++;
+			sum += C::Convert(*src++);
 
 		typename Traits::value_type value(sum / int(src_channels));
 
@@ -115,31 +149,43 @@ NToM(typename Traits::pointer_type dest,
 	return dest;
 }
 
-template<SampleFormat F, class Traits=SampleTraits<F>>
-static ConstBuffer<typename Traits::value_type>
+template<typename C>
+static ConstBuffer<typename C::DstTraits::value_type>
 ConvertChannels(PcmBuffer &buffer,
 		unsigned dest_channels,
 		unsigned src_channels,
-		ConstBuffer<typename Traits::value_type> src)
+		ConstBuffer<typename C::SrcTraits::value_type> src)
 {
 	assert(src.size % src_channels == 0);
 
 	const size_t dest_size = src.size / src_channels * dest_channels;
-	auto dest = buffer.GetT<typename Traits::value_type>(dest_size);
+	auto dest = buffer.GetT<typename C::DstTraits::value_type>(dest_size);
 
 	if (src_channels == 1 && dest_channels == 2)
-		MonoToStereo(dest, src.begin(), src.end());
+		MonoToStereo<C>(dest, src.begin(), src.end());
 	else if (src_channels == 2 && dest_channels == 1)
-		StereoToMono<F>(dest, src.begin(), src.end());
+		StereoToMono<C>(dest, src.begin(), src.end());
 	else if (dest_channels == 2)
-		NToStereo<F>(dest, src_channels, src.begin(), src.end());
+		NToStereo<C>(dest, src_channels, src.begin(), src.end());
 	else
-		NToM<F>(dest, dest_channels,
+		NToM<C>(dest, dest_channels,
 			src_channels, src.begin(), src.end());
 
 	return { dest, dest_size };
 }
 
+template<SampleFormat F>
+static ConstBuffer<typename SampleTraits<F>::value_type>
+ConvertChannels(PcmBuffer &buffer,
+		unsigned dest_channels,
+		unsigned src_channels,
+		ConstBuffer<typename SampleTraits<F>::value_type> src)
+{
+	return ConvertChannels<IdentitySampleConvert<F>>(buffer,
+							 dest_channels,
+							 src_channels, src);
+}
+
 ConstBuffer<int16_t>
 pcm_convert_channels_16(PcmBuffer &buffer,
 			unsigned dest_channels,
@@ -179,3 +225,316 @@ pcm_convert_channels_float(PcmBuffer &buffer,
 	return ConvertChannels<SampleFormat::FLOAT>(buffer, dest_channels,
 						    src_channels, src);
 }
+
+bool
+pcm_convert_channels_supported(SampleFormat dest_format,
+			       SampleFormat src_format)
+{
+	switch (dest_format) {
+	case SampleFormat::UNDEFINED:
+	case SampleFormat::S8:
+	case SampleFormat::DSD:
+		return false;
+
+	case SampleFormat::S16:
+		/* reducing the resolution requires dithering, which
+		   is left to PcmFormatConverter */
+		return src_format == SampleFormat::S8 ||
+			src_format == SampleFormat::S16 ||
+			src_format == SampleFormat::FLOAT;
+
+	case SampleFormat::S24_P32:
+	case SampleFormat::S32:
+	case SampleFormat::FLOAT:
+		return src_format != SampleFormat::UNDEFINED &&
+			src_format != SampleFormat::DSD;
+	}
+
+	assert(false);
+	gcc_unreachable();
+}
+
+/**
+ * Helper for pcm_convert_channels() which stores the parameters
+ * passed to ConvertChannels().
+ */
+struct ConvertChannelsCall {
+	PcmBuffer &buffer;
+	unsigned dest_channels, src_channels;
+	ConstBuffer<void> src;
+
+	template<typename C>
+	ConstBuffer<void> Run() const {
+		typedef typename C::SrcTraits::value_type SV;
+		return ConvertChannels<C>(buffer, dest_channels, src_channels,
+					  ConstBuffer<SV>::FromVoid(src))
+			.ToVoid();
+	}
+};
+
+ConstBuffer<void>
+pcm_convert_channels(PcmBuffer &buffer,
+		     SampleFormat dest_format, unsigned dest_channels,
+		     SampleFormat src_format, unsigned src_channels,
+		     ConstBuffer<void> src)
+{
+	assert(pcm_convert_channels_supported(dest_format, src_format));
+
+	constexpr auto S8 = SampleFormat::S8;
+	constexpr auto S16 = SampleFormat::S16;
+	constexpr auto S24_P32 = SampleFormat::S24_P32;
+	constexpr auto S32 = SampleFormat::S32;
+	constexpr auto FLOAT = SampleFormat::FLOAT;
+
+	const ConvertChannelsCall call{buffer, dest_channels, src_channels, src};
+
+	switch (dest_format) {
+	case SampleFormat::UNDEFINED:
+	case SampleFormat::S8:
+	case SampleFormat::DSD:
+		break;
+
+	case SampleFormat::S16:
+		switch (src_format) {
+		case S8:
+			return call.Run<LeftShiftSampleConvert<S8, S16>>();
+		case S16:
+			return call.Run<IdentitySampleConvert<S16>>();
+		case FLOAT:
+			return call.Run<FloatToIntegerSampleConvert<S16>>();
+		default:
+			break;
+		}
+
+		break;
+
+	case SampleFormat::S24_P32:
+		switch (src_format) {
+		case S8:
+			return call.Run<LeftShiftSampleConvert<S8, S24_P32>>();
+		case S16:
+			return call.Run<LeftShiftSampleConvert<S16, S24_P32>>();
+		case S24_P32:
+			return call.Run<IdentitySampleConvert<S24_P32>>();
+		case S32:
+			return call.Run<RightShiftSampleConvert<S32, S24_P32>>();
+		case FLOAT:
+			return call.Run<FloatToIntegerSampleConvert<S24_P32>>();
+		default:
+			break;
+		}
+
+		break;
+
+	case SampleFormat::S32:
+		switch (src_format) {
+		case S8:
+			return call.Run<LeftShiftSampleConvert<S8, S32>>();
+		case S16:
+			return call.Run<LeftShiftSampleConvert<S16, S32>>();
+		case S24_P32:
+			return call.Run<LeftShiftSampleConvert<S24_P32, S32>>();
+		case S32:
+			return call.Run<IdentitySampleConvert<S32>>();
+		case FLOAT:
+			return call.Run<FloatToIntegerSampleConvert<S32>>();
+		default:
+			break;
+		}
+
+		break;
+
+	case SampleFormat::FLOAT:
+		switch (src_format) {
+		case S8:
+			return call.Run<IntegerToFloatSampleConvert<S8>>();
+		case S16:
+			return call.Run<IntegerToFloatSampleConvert<S16>>();
+		case S24_P32:
+			return call.Run<IntegerToFloatSampleConvert<S24_P32>>();
+		case S32:
+			return call.Run<IntegerToFloatSampleConvert<S32>>();
+		case FLOAT:
+			return call.Run<IdentitySampleConvert<FLOAT>>();
+		default:
+			break;
+		}
+
+		break;
+	}
+
+	assert(false);
+	gcc_unreachable();
+}
+
+/**
+ * A routing table compiled into source indices and masks, so copying
+ * a sample has no branches: silent channels read channel 0 and mask
+ * it out.
+ */
+template<typename T>
+struct RoutePlan {
+	unsigned index[MAX_CHANNELS];
+	T mask[MAX_CHANNELS];
+
+	RoutePlan(const int8_t *sources, unsigned dest_channels) {
+		for (unsigned c = 0; c != dest_channels; ++c) {
+			index[c] = sources[c] >= 0 ? sources[c] : 0;
+			mask[c] = sources[c] >= 0 ? T(~T(0)) : T(0);
+		}
+	}
+
+	T Get(const T *src, unsigned c) const {
+		return src[index[c]] & mask[c];
+	}
+};
+
+/**
+ * Copies channel #C and all following channels of one frame.  This
+ * is a recursive template, because gcc -O2 doesn't unroll the
+ * equivalent loop, even with a constant channel count.
+ */
+template<typename T, unsigned DEST, unsigned C=0>
+struct RouteFrame {
+	static void Copy(T *dest, const T *src, const RoutePlan<T> &plan) {
+		dest[C] = plan.Get(src, C);
+		RouteFrame<T, DEST, C + 1>::Copy(dest, src, plan);
+	}
+};
+
+template<typename T, unsigned DEST>
+struct RouteFrame<T, DEST, DEST> {
+	static void Copy(T *, const T *, const RoutePlan<T> &) {}
+};
+
+/**
+ * Copy samples between channels, specialized for a layout with
+ * constant channel counts.
+ */
+template<typename T, unsigned SRC, unsigned DEST>
+static void
+RouteChannels(T *gcc_restrict dest, const T *gcc_restrict src,
+	      size_t n_frames, const int8_t *sources)
+{
+	const RoutePlan<T> plan(sources, DEST);
+
+	for (size_t i = 0; i != n_frames; ++i) {
+		RouteFrame<T, DEST>::Copy(dest, src, plan);
+		src += SRC;
+		dest += DEST;
+	}
+}
+
+template<typename T>
+static void
+RouteChannels(T *gcc_restrict dest, const T *gcc_restrict src,
+	      size_t n_frames,
+	      unsigned dest_channels, unsigned src_channels,
+	      const int8_t *sources)
+{
+	const RoutePlan<T> plan(sources, dest_channels);
+
+	for (size_t i = 0; i != n_frames; ++i) {
+		for (unsigned c = 0; c != dest_channels; ++c)
+			dest[c] = plan.Get(src, c);
+
+		src += src_channels;
+		dest += dest_channels;
+	}
+}
+
+static constexpr unsigned
+RouteLayout(unsigned src_channels, unsigned dest_channels)
+{
+	return (src_channels << 8) | dest_channels;
+}
+
+template<typename T>
+static void
+RouteChannelsVoid(void *dest, const void *src, size_t n_frames,
+		  unsigned dest_channels, unsigned src_channels,
+		  const int8_t *sources)
+{
+	T *d = (T *)dest;
+	const T *s = (const T *)src;
+
+	switch (RouteLayout(src_channels, dest_channels)) {
+	case RouteLayout(1, 2):
+		RouteChannels<T, 1, 2>(d, s, n_frames, sources);
+		break;
+
+	case RouteLayout(2, 2):
+		/* channel swap */
+		RouteChannels<T, 2, 2>(d, s, n_frames, sources);
+		break;
+
+	case RouteLayout(2, 4):
+		RouteChannels<T, 2, 4>(d, s, n_frames, sources);
+		break;
+
+	case RouteLayout(2, 6):
+		/* stereo to 5.1 */
+		RouteChannels<T, 2, 6>(d, s, n_frames, sources);
+		break;
+
+	case RouteLayout(6, 2):
+		/* 5.1 to stereo */
+		RouteChannels<T, 6, 2>(d, s, n_frames, sources);
+		break;
+
+	case RouteLayout(6, 6):
+		RouteChannels<T, 6, 6>(d, s, n_frames, sources);
+		break;
+
+	case RouteLayout(8, 8):
+		RouteChannels<T, 8, 8>(d, s, n_frames, sources);
+		break;
+
+	default:
+		RouteChannels<T>(d, s, n_frames,
+				 dest_channels, src_channels, sources);
+		break;
+	}
+}
+
+ConstBuffer<void>
+pcm_route_channels(PcmBuffer &buffer,
+		   SampleFormat format,
+		   unsigned dest_channels, unsigned src_channels,
+		   const int8_t *sources,
+		   ConstBuffer<void> src)
+{
+	assert(audio_valid_channel_count(dest_channels));
+	assert(audio_valid_channel_count(src_channels));
+
+	const size_t sample_size = sample_format_size(format);
+	const size_t n_frames = src.size / (sample_size * src_channels);
+	const size_t dest_size = n_frames * dest_channels * sample_size;
+	void *dest = buffer.Get(dest_size);
+
+	switch (sample_size) {
+	case 1:
+		RouteChannelsVoid<uint8_t>(dest, src.data, n_frames,
+					   dest_channels, src_channels,
+					   sources);
+		break;
+
+	case 2:
+		RouteChannelsVoid<uint16_t>(dest, src.data, n_frames,
+					    dest_channels, src_channels,
+					    sources);
+		break;
+
+	case 4:
+		RouteChannelsVoid<uint32_t>(dest, src.data, n_frames,
+					    dest_channels, src_channels,
+					    sources);
+		break;
+
+	default:
+		assert(false);
+		gcc_unreachable();
+	}
+
+	return { dest, dest_size };
+}
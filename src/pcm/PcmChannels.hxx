@@ -20,9 +20,12 @@
 #ifndef MPD_PCM_CHANNELS_HXX
 #define MPD_PCM_CHANNELS_HXX
 
+#include "Compiler.h"
+
 #include <stdint.h>
 #include <stddef.h>
 
+enum class SampleFormat : uint8_t;
 class PcmBuffer;
 template<typename T> struct ConstBuffer;
 
@@ -87,4 +90,55 @@ pcm_convert_channels_float(PcmBuffer &buffer,
 			   unsigned src_channels,
 			   ConstBuffer<float> src);
 
+/**
+ * Can pcm_convert_channels() convert between these two sample
+ * formats?
+ */
+gcc_const
+bool
+pcm_convert_channels_supported(SampleFormat dest_format,
+			       SampleFormat src_format);
+
+/**
+ * Changes the number of channels and the sample format in one pass.
+ * This is cheaper than converting the sample format first, because
+ * the intermediate buffer is omitted.  Only conversions which do not
+ * need dithering are implemented; check with
+ * pcm_convert_channels_supported().
+ *
+ * @param buffer the destination pcm_buffer object
+ * @param dest_format the sample format requested
+ * @param dest_channels the number of channels requested
+ * @param src_format the sample format of the source buffer
+ * @param src_channels the number of channels in the source buffer
+ * @param src the source PCM buffer
+ * @return the destination buffer
+ */
+ConstBuffer<void>
+pcm_convert_channels(PcmBuffer &buffer,
+		     SampleFormat dest_format, unsigned dest_channels,
+		     SampleFormat src_format, unsigned src_channels,
+		     ConstBuffer<void> src);
+
+/**
+ * Copies samples between channels according to a routing table.  No
+ * samples are mixed, so this works with all sample formats.
+ *
+ * @param buffer the destination pcm_buffer object
+ * @param format the sample format
+ * @param dest_channels the number of channels requested
+ * @param src_channels the number of channels in the source buffer
+ * @param sources the source channel for each of the #dest_channels
+ * destination channels; -1 means silence (zero samples); all other
+ * values must be smaller than #src_channels
+ * @param src the source PCM buffer
+ * @return the destination buffer
+ */
+ConstBuffer<void>
+pcm_route_channels(PcmBuffer &buffer,
+		   SampleFormat format,
+		   unsigned dest_channels, unsigned src_channels,
+		   const int8_t *sources,
+		   ConstBuffer<void> src);
+
 #endif
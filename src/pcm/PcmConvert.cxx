@@ -36,6 +36,12 @@ pcm_convert_global_init(Error &error)
 	return pcm_resampler_global_init(error);
 }
 
+void
+pcm_convert_global_finish()
+{
+	pcm_resampler_global_finish();
+}
+
 PcmConvert::PcmConvert()
 {
 #ifndef NDEBUG
@@ -76,6 +82,29 @@ PcmConvert::Open(AudioFormat _src_format, AudioFormat _dest_format,
 	}
 
 	enable_format = format.format != dest_format.format;
+	enable_channels = format.channels != dest_format.channels;
+
+	/* when removing channels, do that first, so the sample
+	   format conversion has less to do */
+	channels_first = enable_format && enable_channels &&
+		dest_format.channels < format.channels &&
+		format.format != SampleFormat::S8;
+
+	/* floating point samples are better mixed before they are
+	   converted to integer; all others are converted while
+	   mixing the channels, without an intermediate buffer (if no
+	   dithering is needed) */
+	if (enable_format && enable_channels &&
+	    !(channels_first && format.format == SampleFormat::FLOAT) &&
+	    PcmChannelsConverter::CanConvertFormat(format.format,
+						   dest_format.format)) {
+		enable_format = false;
+		channels_first = false;
+		channels_converter.Open(format.format, dest_format.format,
+					format.channels, dest_format.channels);
+		return true;
+	}
+
 	if (enable_format &&
 	    !format_converter.Open(format.format, dest_format.format, error)) {
 		if (enable_resampler)
@@ -83,9 +112,9 @@ PcmConvert::Open(AudioFormat _src_format, AudioFormat _dest_format,
 		return false;
 	}
 
-	format.format = dest_format.format;
+	if (!channels_first)
+		format.format = dest_format.format;
 
-	enable_channels = format.channels != dest_format.channels;
 	if (enable_channels &&
 	    !channels_converter.Open(format.format, format.channels,
 				     dest_format.channels, error)) {
@@ -144,6 +173,14 @@ PcmConvert::Convert(ConstBuffer<void> buffer, Error &error)
 		format.sample_rate = dest_format.sample_rate;
 	}
 
+	if (channels_first) {
+		buffer = channels_converter.Convert(buffer, error);
+		if (buffer.IsNull())
+			return nullptr;
+
+		format.channels = dest_format.channels;
+	}
+
 	if (enable_format) {
 		buffer = format_converter.Convert(buffer, error);
 		if (buffer.IsNull())
@@ -152,7 +189,7 @@ PcmConvert::Convert(ConstBuffer<void> buffer, Error &error)
 		format.format = dest_format.format;
 	}
 
-	if (enable_channels) {
+	if (enable_channels && !channels_first) {
 		buffer = channels_converter.Convert(buffer, error);
 		if (buffer.IsNull())
 			return nullptr;
@@ -49,10 +49,24 @@ class PcmConvert {
 
 	bool enable_resampler, enable_format, enable_channels;
 
+	/**
+	 * Shall the #channels_converter run before the
+	 * #format_converter?  This is done when removing channels.
+	 */
+	bool channels_first;
+
 public:
 	PcmConvert();
 	~PcmConvert();
 
+	/**
+	 * Select the kind of dither noise for conversions to 16 bit.
+	 * The setting is kept across Close() and Open().
+	 */
+	void SetDitherMode(PcmDitherMode mode) {
+		format_converter.SetDitherMode(mode);
+	}
+
 	/**
 	 * Prepare the object.  Call Close() when done.
 	 */
@@ -81,4 +95,7 @@ public:
 bool
 pcm_convert_global_init(Error &error);
 
+void
+pcm_convert_global_finish();
+
 #endif
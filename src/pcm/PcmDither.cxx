@@ -88,14 +88,101 @@ PcmDither::DitherConvert(typename ST::value_type sample)
 		      scale_bits>(sample);
 }
 
+template<typename ST, typename DT, PcmDitherMode MODE>
+inline void
+PcmDither::DitherBlock(typename DT::pointer_type dest,
+		       typename ST::const_pointer_type src, size_t n,
+		       const uint32_t *rnd)
+{
+	static_assert(ST::BITS > DT::BITS,
+		      "Sample formats cannot be dithered");
+	static_assert(MODE != PcmDitherMode::SHAPED,
+		      "Noise shaping is not implemented block-wise");
+
+	typedef typename ST::sum_type T;
+	constexpr unsigned scale_bits = ST::BITS - DT::BITS;
+	constexpr T round = T(1) << (scale_bits - 1);
+
+	/* the upper bits of a linear congruential generator are
+	   much more random than the lower ones */
+	constexpr unsigned rnd_shift = 32 - scale_bits;
+
+	for (size_t i = 0; i != n; ++i) {
+		const T noise = T(rnd[i + 1] >> rnd_shift);
+		T output;
+
+		if (MODE == PcmDitherMode::RECTANGULAR) {
+			/* add noise between 0 and 1 LSB, and
+			   truncate */
+			output = src[i] + noise;
+			if (output > ST::MAX)
+				output = ST::MAX;
+		} else {
+			/* the difference of two consecutive random
+			   numbers is noise with a triangular
+			   probability density */
+			output = src[i] + round + noise
+				- T(rnd[i] >> rnd_shift);
+			if (output > ST::MAX)
+				output = ST::MAX;
+			else if (output < ST::MIN)
+				output = ST::MIN;
+		}
+
+		dest[i] = output >> scale_bits;
+	}
+}
+
+template<typename ST, typename DT, PcmDitherMode MODE>
+inline void
+PcmDither::DitherConvert(typename DT::pointer_type dest,
+			 typename ST::const_pointer_type src,
+			 typename ST::const_pointer_type src_end)
+{
+	/* one extra element for the last random number of the
+	   previous block, and padding for pcm_prng_fill() */
+	uint32_t rnd[1 + BLOCK_SIZE + 3];
+
+	while (src < src_end) {
+		size_t n = src_end - src;
+		if (n > BLOCK_SIZE)
+			n = BLOCK_SIZE;
+
+		rnd[0] = block_random;
+		pcm_prng_fill(block_prng, rnd + 1, (n + 3) & ~size_t(3));
+		block_random = rnd[n];
+
+		DitherBlock<ST, DT, MODE>(dest, src, n, rnd);
+
+		dest += n;
+		src += n;
+	}
+}
+
 template<typename ST, typename DT>
 inline void
 PcmDither::DitherConvert(typename DT::pointer_type dest,
 			 typename ST::const_pointer_type src,
 			 typename ST::const_pointer_type src_end)
 {
-	while (src < src_end)
-		*dest++ = DitherConvert<ST, DT>(*src++);
+	switch (mode) {
+	case PcmDitherMode::RECTANGULAR:
+		DitherConvert<ST, DT, PcmDitherMode::RECTANGULAR>(dest, src,
+								  src_end);
+		break;
+
+	case PcmDitherMode::TPDF:
+		DitherConvert<ST, DT, PcmDitherMode::TPDF>(dest, src, src_end);
+		break;
+
+	case PcmDitherMode::SHAPED:
+		/* the error feedback is a dependency from one sample
+		   to the next; generating the random numbers in
+		   blocks doesn't help here */
+		while (src < src_end)
+			*dest++ = DitherConvert<ST, DT>(*src++);
+		break;
+	}
 }
 
 inline void
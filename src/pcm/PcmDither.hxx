@@ -20,17 +20,77 @@
 #ifndef MPD_PCM_DITHER_HXX
 #define MPD_PCM_DITHER_HXX
 
+#include "PcmPrng.hxx"
+
+#include <stddef.h>
 #include <stdint.h>
 
 enum class SampleFormat : uint8_t;
 
+/**
+ * The kind of dither noise applied when reducing the sample
+ * resolution.
+ */
+enum class PcmDitherMode : uint8_t {
+	/**
+	 * Rectangular probability density: the cheapest mode,
+	 * suitable for sinks which don't benefit from better dither.
+	 */
+	RECTANGULAR,
+
+	/**
+	 * Triangular probability density, no noise shaping.
+	 */
+	TPDF,
+
+	/**
+	 * Triangular probability density plus error feedback which
+	 * moves the quantization noise to higher frequencies.  This
+	 * is the default.
+	 */
+	SHAPED,
+};
+
 class PcmDither {
+	/**
+	 * The number of samples processed by Dither24To16() and
+	 * Dither32To16() in one block.
+	 */
+	static constexpr size_t BLOCK_SIZE = 256;
+
 	int32_t error[3];
 	int32_t random;
 
+	/**
+	 * Four interleaved PRNG states for the block code, see
+	 * pcm_prng_fill().
+	 */
+	uint32_t block_prng[4];
+
+	/**
+	 * The last random number of the previous block.
+	 */
+	uint32_t block_random;
+
+	PcmDitherMode mode;
+
 public:
-	constexpr PcmDither()
-		:error{0, 0, 0}, random(0) {}
+	constexpr PcmDither(PcmDitherMode _mode=PcmDitherMode::SHAPED)
+		:error{0, 0, 0}, random(0),
+		 block_prng{0, uint32_t(pcm_prng(0)),
+			    uint32_t(pcm_prng(pcm_prng(0))),
+			    uint32_t(pcm_prng(pcm_prng(pcm_prng(0))))},
+		 block_random(0),
+		 mode(_mode) {}
+
+	/**
+	 * Select the kind of dither noise for Dither24To16() and
+	 * Dither32To16().  DitherShift() always uses
+	 * #PcmDitherMode::SHAPED.
+	 */
+	void SetMode(PcmDitherMode _mode) {
+		mode = _mode;
+	}
 
 	/**
 	 * Shift the given sample by #SBITS-#DBITS to the right, and
@@ -75,6 +135,27 @@ private:
 	template<typename ST, typename DT>
 	typename DT::value_type DitherConvert(typename ST::value_type sample);
 
+	/**
+	 * Convert one block of at most #BLOCK_SIZE samples from one
+	 * sample format to another, discarding bits.
+	 *
+	 * @param ST the input #SampleTraits class
+	 * @param DT the output #SampleTraits class
+	 * @param MODE the kind of dither noise (not
+	 * #PcmDitherMode::SHAPED)
+	 * @param rnd n+1 random numbers; the first one is the last
+	 * one of the previous block
+	 */
+	template<typename ST, typename DT, PcmDitherMode MODE>
+	void DitherBlock(typename DT::pointer_type dest,
+			 typename ST::const_pointer_type src, size_t n,
+			 const uint32_t *rnd);
+
+	template<typename ST, typename DT, PcmDitherMode MODE>
+	void DitherConvert(typename DT::pointer_type dest,
+			   typename ST::const_pointer_type src,
+			   typename ST::const_pointer_type src_end);
+
 	template<typename ST, typename DT>
 	void DitherConvert(typename DT::pointer_type dest,
 			   typename ST::const_pointer_type src,
@@ -20,40 +20,79 @@
 #include "config.h"
 #include "PcmDsd.hxx"
 #include "dsd2pcm/dsd2pcm.h"
+#include "util/bit_reverse.h"
 #include "util/Macros.hxx"
 #include "util/ConstBuffer.hxx"
 
-#include <algorithm>
-
 #include <assert.h>
+#include <string.h>
 
-PcmDsd::PcmDsd()
-{
-	std::fill_n(dsd2pcm, ARRAY_SIZE(dsd2pcm), nullptr);
-}
+static constexpr unsigned CTABLES = DSD2PCM_CTABLES;
+
+/**
+ * The dsd2pcm lookup tables, rearranged for PcmDsd: #old is indexed
+ * with the byte as it appears in the stream, which saves the
+ * bit-reversal of older bytes.
+ */
+struct DsdTables {
+	float fresh[CTABLES][256];
+	float old[CTABLES][256];
+
+	DsdTables() {
+		const float *ctables = dsd2pcm_get_ctables();
+
+		for (unsigned i = 0; i < CTABLES; ++i) {
+			for (unsigned e = 0; e < 256; ++e) {
+				fresh[i][e] = ctables[i * 256 + e];
+				old[i][e] = ctables[i * 256 + bit_reverse(e)];
+			}
+		}
+	}
+};
+
+/* initialized at startup, because dsd2pcm_get_ctables() is not
+   thread-safe */
+static const DsdTables dsd_tables;
 
-PcmDsd::~PcmDsd()
+/**
+ * Apply the FIR filter to the bytes of one channel.
+ *
+ * @param src the source bytes; the #HISTORY bytes before are the
+ * previous bytes of this channel
+ */
+static void
+dsd_to_float(float *dest, size_t dest_stride,
+	     const uint8_t *src, size_t n)
 {
-	for (unsigned i = 0; i < ARRAY_SIZE(dsd2pcm); ++i)
-		if (dsd2pcm[i] != nullptr)
-			dsd2pcm_destroy(dsd2pcm[i]);
+	const DsdTables &t = dsd_tables;
+
+	for (size_t j = 0; j != n; ++j, ++src, dest += dest_stride) {
+		float acc = 0;
+		for (unsigned i = 0; i < CTABLES; ++i)
+			acc += t.fresh[i][src[-int(i)]] +
+				t.old[i][src[int(i) - int(CTABLES * 2 - 1)]];
+
+		*dest = acc;
+	}
 }
 
 void
 PcmDsd::Reset()
 {
-	for (unsigned i = 0; i < ARRAY_SIZE(dsd2pcm); ++i)
-		if (dsd2pcm[i] != nullptr)
-			dsd2pcm_reset(dsd2pcm[i]);
+	/* the dsd2pcm silence pattern,
+	   see dsd2pcm_reset() */
+	memset(history, 0x69, sizeof(history));
 }
 
 ConstBuffer<float>
 PcmDsd::ToFloat(unsigned channels, ConstBuffer<uint8_t> src)
 {
+	static_assert(HISTORY == CTABLES * 2 - 1, "Wrong HISTORY size");
+
 	assert(!src.IsNull());
 	assert(!src.IsEmpty());
 	assert(src.size % channels == 0);
-	assert(channels <= ARRAY_SIZE(dsd2pcm));
+	assert(channels <= ARRAY_SIZE(history));
 
 	const unsigned num_samples = src.size;
 	const unsigned num_frames = src.size / channels;
@@ -62,16 +101,20 @@ PcmDsd::ToFloat(unsigned channels, ConstBuffer<uint8_t> src)
 	const size_t dest_size = num_samples * sizeof(*dest);
 	dest = (float *)buffer.Get(dest_size);
 
+	uint8_t *channel = (uint8_t *)
+		channel_buffer.Get(HISTORY + num_frames);
+
 	for (unsigned c = 0; c < channels; ++c) {
-		if (dsd2pcm[c] == nullptr) {
-			dsd2pcm[c] = dsd2pcm_init();
-			if (dsd2pcm[c] == nullptr)
-				return nullptr;
-		}
+		/* de-interleave this channel, after its history */
+		memcpy(channel, history[c], HISTORY);
+		const uint8_t *s = src.data + c;
+		for (unsigned i = 0; i < num_frames; ++i, s += channels)
+			channel[HISTORY + i] = *s;
+
+		dsd_to_float(dest + c, channels,
+			     channel + HISTORY, num_frames);
 
-		dsd2pcm_translate(dsd2pcm[c], num_frames,
-				  src.data + c, channels,
-				  false, dest + c, channels);
+		memcpy(history[c], channel + num_frames, HISTORY);
 	}
 
 	return { dest, num_samples };
@@ -28,16 +28,38 @@
 template<typename T> struct ConstBuffer;
 
 /**
- * Wrapper for the dsd2pcm library.
+ * Convert DSD to PCM (without decimation, i.e. one float for each
+ * DSD byte), using the lookup tables of the dsd2pcm library.
+ *
+ * Unlike dsd2pcm_translate(), which runs one context per channel
+ * over the interleaved source, this de-interleaves each channel into
+ * a contiguous buffer preceded by the channel's history, so the FIR
+ * loop does not need a ring buffer and bit-reverses nothing at
+ * runtime.
  */
 class PcmDsd {
+	static constexpr unsigned MAX_CHANNELS = 32;
+
+	/**
+	 * The number of past bytes of each channel which are needed
+	 * to calculate the next sample.
+	 */
+	static constexpr unsigned HISTORY = 11;
+
 	PcmBuffer buffer;
 
-	struct dsd2pcm_ctx_s *dsd2pcm[32];
+	/**
+	 * The de-interleaved source bytes of one channel, including
+	 * its history.
+	 */
+	PcmBuffer channel_buffer;
+
+	uint8_t history[MAX_CHANNELS][HISTORY];
 
 public:
-	PcmDsd();
-	~PcmDsd();
+	PcmDsd() {
+		Reset();
+	}
 
 	void Reset();
 
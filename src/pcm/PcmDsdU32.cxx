@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "PcmDsdU32.hxx"
+#include "AudioFormat.hxx"
+#include "system/ByteOrder.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <assert.h>
+
+constexpr
+static inline uint32_t
+pcm_four_dsd_to_u32(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+{
+	return (uint32_t(a) << 24) | (uint32_t(b) << 16) |
+		(uint32_t(c) << 8) | uint32_t(d);
+}
+
+template<bool reverse_endian>
+static uint32_t *
+pcm_dsd_to_u32(uint32_t *dest, unsigned channels, const uint8_t *src,
+	       unsigned num_dest_frames)
+{
+	for (unsigned i = num_dest_frames; i > 0; --i) {
+		for (unsigned c = channels; c > 0; --c) {
+			uint32_t x = pcm_four_dsd_to_u32(src[0],
+							 src[channels],
+							 src[2 * channels],
+							 src[3 * channels]);
+			if (reverse_endian)
+				x = ByteSwap32(x);
+
+			*dest++ = x;
+
+			/* seek the source pointer to the next
+			   channel */
+			++src;
+		}
+
+		/* skip the three other bytes of each channel, because
+		   we have already copied them */
+		src += 3 * channels;
+	}
+
+	return dest;
+}
+
+size_t
+pcm_dsd_to_u32(void *_dest, unsigned channels, ConstBuffer<uint8_t> src,
+	       bool reverse_endian)
+{
+	assert(audio_valid_channel_count(channels));
+	assert(!src.IsNull());
+	assert(src.size > 0);
+	assert(src.size % (channels * 4) == 0);
+
+	const unsigned num_dest_frames = src.size / channels / 4;
+
+	uint32_t *const dest0 = (uint32_t *)_dest;
+	uint32_t *const dest = reverse_endian
+		? pcm_dsd_to_u32<true>(dest0, channels, src.data,
+				       num_dest_frames)
+		: pcm_dsd_to_u32<false>(dest0, channels, src.data,
+					num_dest_frames);
+
+	return (dest - dest0) * sizeof(*dest);
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_DSD_U32_HXX
+#define MPD_PCM_DSD_U32_HXX
+
+#include "check.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+template<typename T> struct ConstBuffer;
+
+/**
+ * Pack four consecutive DSD bytes of each channel into one 32 bit
+ * integer, for devices which support native DSD only in the
+ * "DSD_U32" format.  The oldest byte is the most significant one.
+ *
+ * @param src the DSD source buffer; its size must be a multiple of
+ * four frames
+ * @param dest the destination buffer; it must have room for
+ * #src.size bytes
+ * @param reverse_endian store the integers in the non-host byte
+ * order
+ * @return the number of bytes written to #dest
+ */
+size_t
+pcm_dsd_to_u32(void *dest, unsigned channels, ConstBuffer<uint8_t> src,
+	       bool reverse_endian);
+
+#endif
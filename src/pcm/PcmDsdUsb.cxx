@@ -19,11 +19,12 @@
 
 #include "config.h"
 #include "PcmDsdUsb.hxx"
-#include "PcmBuffer.hxx"
 #include "AudioFormat.hxx"
+#include "system/ByteOrder.hxx"
 #include "util/ConstBuffer.hxx"
 
 #include <assert.h>
+#include <string.h>
 
 constexpr
 static inline uint32_t
@@ -39,33 +40,53 @@ pcm_two_dsd_to_usb_marker2(uint8_t a, uint8_t b)
 	return 0xfffa0000 | (a << 8) | b;
 }
 
-ConstBuffer<uint32_t>
-pcm_dsd_to_usb(PcmBuffer &buffer, unsigned channels,
-	       ConstBuffer<uint8_t> _src)
+/**
+ * Store one DSD-over-USB sample in its final binary representation.
+ */
+template<bool shift8, bool pack24, bool reverse_endian>
+static inline uint8_t *
+pcm_dsd_usb_store(uint8_t *dest, uint32_t sample)
 {
-	assert(audio_valid_channel_count(channels));
-	assert(!_src.IsNull());
-	assert(_src.size > 0);
-	assert(_src.size % channels == 0);
+	static_assert(!shift8 || !pack24, "cannot shift and pack");
+
+	if (shift8)
+		sample <<= 8;
+
+	if (pack24) {
+		if (IsLittleEndian() != reverse_endian) {
+			dest[0] = sample;
+			dest[1] = sample >> 8;
+			dest[2] = sample >> 16;
+		} else {
+			dest[0] = sample >> 16;
+			dest[1] = sample >> 8;
+			dest[2] = sample;
+		}
 
-	const unsigned num_src_samples = _src.size;
-	const unsigned num_src_frames = num_src_samples / channels;
+		return dest + 3;
+	}
 
-	/* this rounds down and discards the last odd frame; not
-	   elegant, but good enough for now */
-	const unsigned num_frames = num_src_frames / 2;
-	const unsigned num_samples = num_frames * channels;
+	if (reverse_endian)
+		sample = ByteSwap32(sample);
 
-	uint32_t *const dest0 = (uint32_t *)buffer.GetT<uint32_t>(num_samples),
-		*dest = dest0;
+	memcpy(dest, &sample, sizeof(sample));
+	return dest + sizeof(sample);
+}
 
-	auto src = _src.data;
-	for (unsigned i = num_frames / 2; i > 0; --i) {
+template<bool shift8, bool pack24, bool reverse_endian>
+static uint8_t *
+pcm_dsd_to_usb(uint8_t *dest, unsigned channels, const uint8_t *src,
+	       unsigned num_frame_pairs)
+{
+	for (unsigned i = num_frame_pairs; i > 0; --i) {
 		for (unsigned c = channels; c > 0; --c) {
 			/* each 24 bit sample has 16 DSD sample bits
 			   plus the magic 0x05 marker */
 
-			*dest++ = pcm_two_dsd_to_usb_marker1(src[0], src[channels]);
+			dest = pcm_dsd_usb_store<shift8, pack24,
+						 reverse_endian>
+				(dest, pcm_two_dsd_to_usb_marker1(src[0],
+								  src[channels]));
 
 			/* seek the source pointer to the next
 			   channel */
@@ -80,7 +101,10 @@ pcm_dsd_to_usb(PcmBuffer &buffer, unsigned channels,
 			/* each 24 bit sample has 16 DSD sample bits
 			   plus the magic 0xfa marker */
 
-			*dest++ = pcm_two_dsd_to_usb_marker2(src[0], src[channels]);
+			dest = pcm_dsd_usb_store<shift8, pack24,
+						 reverse_endian>
+				(dest, pcm_two_dsd_to_usb_marker2(src[0],
+								  src[channels]));
 
 			/* seek the source pointer to the next
 			   channel */
@@ -92,5 +116,53 @@ pcm_dsd_to_usb(PcmBuffer &buffer, unsigned channels,
 		src += channels;
 	}
 
-	return { dest0, num_samples };
+	return dest;
+}
+
+size_t
+pcm_dsd_to_usb(void *_dest, unsigned channels, ConstBuffer<uint8_t> src,
+	       bool shift8, bool pack24, bool reverse_endian)
+{
+	assert(audio_valid_channel_count(channels));
+	assert(!src.IsNull());
+	assert(src.size > 0);
+	assert(src.size % channels == 0);
+	assert(!shift8 || !pack24);
+
+	const unsigned num_src_frames = src.size / channels;
+
+	/* the markers alternate, so this converts pairs of frames;
+	   this rounds down and discards the trailing frames; not
+	   elegant, but good enough for now */
+	const unsigned num_frame_pairs = num_src_frames / 4;
+
+	uint8_t *const dest0 = (uint8_t *)_dest;
+	uint8_t *dest;
+
+	if (pack24)
+		dest = reverse_endian
+			? pcm_dsd_to_usb<false, true, true>(dest0, channels,
+							    src.data,
+							    num_frame_pairs)
+			: pcm_dsd_to_usb<false, true, false>(dest0, channels,
+							     src.data,
+							     num_frame_pairs);
+	else if (shift8)
+		dest = reverse_endian
+			? pcm_dsd_to_usb<true, false, true>(dest0, channels,
+							    src.data,
+							    num_frame_pairs)
+			: pcm_dsd_to_usb<true, false, false>(dest0, channels,
+							     src.data,
+							     num_frame_pairs);
+	else
+		dest = reverse_endian
+			? pcm_dsd_to_usb<false, false, true>(dest0, channels,
+							     src.data,
+							     num_frame_pairs)
+			: pcm_dsd_to_usb<false, false, false>(dest0, channels,
+							      src.data,
+							      num_frame_pairs);
+
+	return dest - dest0;
 }
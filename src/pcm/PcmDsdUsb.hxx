@@ -25,7 +25,6 @@
 #include <stdint.h>
 #include <stddef.h>
 
-class PcmBuffer;
 template<typename T> struct ConstBuffer;
 
 /**
@@ -33,9 +32,20 @@ template<typename T> struct ConstBuffer;
  * playback over USB, according to the proposed standard by 
  * dCS and others:
  * http://www.sonore.us/DoP_openStandard_1v1.pdf
+ *
+ * The final binary representation is generated in the same pass, so
+ * the result can be passed to the device directly.
+ *
+ * @param dest the destination buffer; it must have room for
+ * (src.size / 2) samples
+ * @param shift8 shift each sample left by 8 bits (for devices
+ * which support only 32 bit)
+ * @param pack24 store only 3 bytes per sample
+ * @param reverse_endian store the samples in the non-host byte order
+ * @return the number of bytes written to #dest
  */
-ConstBuffer<uint32_t>
-pcm_dsd_to_usb(PcmBuffer &buffer, unsigned channels,
-	       ConstBuffer<uint8_t> src);
+size_t
+pcm_dsd_to_usb(void *dest, unsigned channels, ConstBuffer<uint8_t> src,
+	       bool shift8, bool pack24, bool reverse_endian);
 
 #endif
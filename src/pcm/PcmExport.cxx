@@ -20,18 +20,25 @@
 #include "config.h"
 #include "PcmExport.hxx"
 #include "PcmDsdUsb.hxx"
+#include "PcmDsdU32.hxx"
 #include "PcmPack.hxx"
 #include "util/ByteReverse.hxx"
 #include "util/ConstBuffer.hxx"
 
+#include <algorithm>
 #include <iterator>
 
+#include <string.h>
+
 void
 PcmExport::Open(SampleFormat sample_format, unsigned _channels,
-		bool _dsd_usb, bool _shift8, bool _pack, bool _reverse_endian)
+		bool _dsd_usb, bool _dsd_u32,
+		bool _shift8, bool _pack, bool _reverse_endian)
 {
 	assert(audio_valid_sample_format(sample_format));
 	assert(!_dsd_usb || audio_valid_channel_count(_channels));
+	assert(!_dsd_u32 || audio_valid_channel_count(_channels));
+	assert(!_dsd_usb || !_dsd_u32);
 
 	channels = _channels;
 	dsd_usb = _dsd_usb && sample_format == SampleFormat::DSD;
@@ -40,6 +47,9 @@ PcmExport::Open(SampleFormat sample_format, unsigned _channels,
 		   samples are stuffed inside fake 24 bit samples */
 		sample_format = SampleFormat::S24_P32;
 
+	dsd_u32 = _dsd_u32 && sample_format == SampleFormat::DSD;
+	dsd_rest_size = dsd_rest_prepended = 0;
+
 	shift8 = _shift8 && sample_format == SampleFormat::S24_P32;
 	pack24 = _pack && sample_format == SampleFormat::S24_P32;
 
@@ -49,7 +59,9 @@ PcmExport::Open(SampleFormat sample_format, unsigned _channels,
 	if (_reverse_endian) {
 		size_t sample_size = pack24
 			? 3
-			: sample_format_size(sample_format);
+			: (dsd_u32
+			   ? 4
+			   : sample_format_size(sample_format));
 		assert(sample_size <= 0xff);
 
 		if (sample_size > 1)
@@ -71,36 +83,44 @@ PcmExport::GetFrameSize(const AudioFormat &audio_format) const
 		   bytes per sample) */
 		return channels * 4;
 
+	if (dsd_u32)
+		/* four DSD bytes of each channel in one 32 bit
+		   integer */
+		return channels * 4;
+
 	return audio_format.GetFrameSize();
 }
 
 ConstBuffer<void>
 PcmExport::Export(ConstBuffer<void> data)
 {
-	if (dsd_usb)
-		data = pcm_dsd_to_usb(dsd_buffer, channels,
-				      ConstBuffer<uint8_t>::FromVoid(data))
-			.ToVoid();
-
-	if (pack24) {
-		const auto src = ConstBuffer<int32_t>::FromVoid(data);
-		const size_t num_samples = src.size;
-		const size_t dest_size = num_samples * 3;
-		uint8_t *dest = (uint8_t *)pack_buffer.Get(dest_size);
-		assert(dest != nullptr);
+	if (dsd_usb) {
+		/* this generates the final representation in one
+		   pass, including packing, shifting and byte
+		   swapping */
+		const auto src = ConstBuffer<uint8_t>::FromVoid(data);
+		const size_t sample_size = pack24 ? 3 : 4;
+		void *dest = dsd_buffer.Get(src.size / 2 * sample_size);
+		const size_t dest_size =
+			pcm_dsd_to_usb(dest, channels, src,
+				       shift8, pack24, reverse_endian > 0);
+		return { dest, dest_size };
+	}
 
-		pcm_pack_24(dest, src.begin(), src.end());
+	if (dsd_u32) {
+		const auto src = ConstBuffer<uint8_t>::FromVoid(data);
+		void *dest = dsd_buffer.Get(dsd_rest_size + src.size);
+		return { dest, ExportDsdU32(dest, src) };
+	}
 
-		data.data = dest;
-		data.size = dest_size;
-	} else if (shift8) {
-		const auto src = ConstBuffer<int32_t>::FromVoid(data);
+	if (pack24 || shift8) {
+		void *dest = pack_buffer.Get(pack24
+					     ? data.size / 4 * 3
+					     : data.size);
+		assert(dest != nullptr);
 
-		uint32_t *dest = (uint32_t *)pack_buffer.Get(data.size);
+		data.size = Export24(dest, data);
 		data.data = dest;
-
-		for (auto i : src)
-			*dest++ = i << 8;
 	}
 
 	if (reverse_endian > 0) {
@@ -118,6 +138,102 @@ PcmExport::Export(ConstBuffer<void> data)
 	return data;
 }
 
+size_t
+PcmExport::ExportDsdU32(void *_dest, ConstBuffer<uint8_t> src)
+{
+	assert(dsd_u32);
+	assert(src.size % channels == 0);
+
+	const size_t frame_size = channels * 4;
+	uint8_t *dest = (uint8_t *)_dest;
+	size_t dest_size = 0;
+
+	dsd_rest_prepended = dsd_rest_size;
+
+	if (dsd_rest_size > 0) {
+		/* complete the frame left over by the previous
+		   call */
+		const size_t n = std::min(frame_size - dsd_rest_size,
+					  src.size);
+		memcpy(dsd_rest + dsd_rest_size, src.data, n);
+		dsd_rest_size += n;
+		src.data += n;
+		src.size -= n;
+
+		if (dsd_rest_size < frame_size)
+			return 0;
+
+		dest_size = pcm_dsd_to_u32(dest, channels,
+					   {dsd_rest, frame_size},
+					   reverse_endian > 0);
+		dsd_rest_size = 0;
+	}
+
+	const size_t tail = src.size % frame_size;
+	if (src.size > tail)
+		dest_size += pcm_dsd_to_u32(dest + dest_size, channels,
+					    {src.data, src.size - tail},
+					    reverse_endian > 0);
+
+	memcpy(dsd_rest, src.end() - tail, tail);
+	dsd_rest_size = tail;
+	return dest_size;
+}
+
+size_t
+PcmExport::Export24(void *_dest, ConstBuffer<void> data) const
+{
+	assert(pack24 || shift8);
+
+	const auto src = ConstBuffer<int32_t>::FromVoid(data);
+
+	if (pack24) {
+		pcm_pack_24((uint8_t *)_dest, src.begin(), src.end());
+		return src.size * 3;
+	}
+
+	uint32_t *dest = (uint32_t *)_dest;
+	for (auto i : src)
+		*dest++ = i << 8;
+
+	return data.size;
+}
+
+size_t
+PcmExport::ExportTo(void *dest, ConstBuffer<void> data)
+{
+	if (dsd_usb)
+		return pcm_dsd_to_usb(dest, channels,
+				      ConstBuffer<uint8_t>::FromVoid(data),
+				      shift8, pack24, reverse_endian > 0);
+
+	if (dsd_u32)
+		return ExportDsdU32(dest,
+				    ConstBuffer<uint8_t>::FromVoid(data));
+
+	if (pack24 || shift8) {
+		if (reverse_endian == 0)
+			return Export24(dest, data);
+
+		/* byte swapping is the last step; pack/shift into
+		   the temporary buffer first */
+		void *tmp = pack_buffer.Get(pack24
+					    ? data.size / 4 * 3
+					    : data.size);
+		data.size = Export24(tmp, data);
+		data.data = tmp;
+	}
+
+	if (reverse_endian > 0) {
+		const auto src = ConstBuffer<uint8_t>::FromVoid(data);
+		reverse_bytes((uint8_t *)dest, src.begin(), src.end(),
+			      reverse_endian);
+	} else
+		memcpy(dest, data.data, data.size);
+
+	return data.size;
+}
+
 size_t
 PcmExport::CalcSourceSize(size_t size) const
 {
@@ -131,3 +247,19 @@ PcmExport::CalcSourceSize(size_t size) const
 
 	return size;
 }
+
+size_t
+PcmExport::CalcPartialSourceSize(size_t dest_size)
+{
+	size_t size = CalcSourceSize(dest_size);
+
+	if (dsd_u32) {
+		/* the prepended rest was already reported as consumed
+		   by the previous call */
+		assert(dest_size == 0 || size >= dsd_rest_prepended);
+		size -= std::min(size, dsd_rest_prepended);
+		dsd_rest_size = dsd_rest_prepended = 0;
+	}
+
+	return size;
+}
@@ -35,9 +35,9 @@ template<typename T> struct ConstBuffer;
 struct PcmExport {
 	/**
 	 * The buffer is used to convert DSD samples to the
-	 * DSD-over-USB format.
+	 * DSD-over-USB or the DSD_U32 format.
 	 *
-	 * @see #dsd_usb
+	 * @see #dsd_usb, #dsd_u32
 	 */
 	PcmBuffer dsd_buffer;
 
@@ -55,6 +55,26 @@ struct PcmExport {
 	 */
 	PcmBuffer reverse_buffer;
 
+	/**
+	 * DSD frames which did not fill a whole DSD_U32 frame (four
+	 * DSD frames) in the previous call; they are prepended to the
+	 * next one.
+	 *
+	 * @see #dsd_u32
+	 */
+	uint8_t dsd_rest[4 * MAX_CHANNELS];
+
+	/**
+	 * The number of bytes in #dsd_rest.
+	 */
+	size_t dsd_rest_size;
+
+	/**
+	 * The number of #dsd_rest bytes which were prepended in the
+	 * last Export() call.  CalcPartialSourceSize() needs it.
+	 */
+	size_t dsd_rest_prepended;
+
 	/**
 	 * The number of channels.
 	 */
@@ -67,6 +87,13 @@ struct PcmExport {
 	 */
 	bool dsd_usb;
 
+	/**
+	 * Pack four DSD bytes of each channel into a 32 bit integer
+	 * (the "DSD_U32" format)?  Input format must be
+	 * SampleFormat::DSD.
+	 */
+	bool dsd_u32;
+
 	/**
 	 * Convert (padded) 24 bit samples to 32 bit by shifting 8
 	 * bits to the left?
@@ -93,10 +120,20 @@ struct PcmExport {
 	 *
 	 * This function cannot fail.
 	 *
-	 * @param channels the number of channels; ignored unless dsd_usb is set
+	 * @param channels the number of channels; ignored unless dsd_usb
+	 * or dsd_u32 is set
 	 */
 	void Open(SampleFormat sample_format, unsigned channels,
-		  bool dsd_usb, bool shift8, bool pack, bool reverse_endian);
+		  bool dsd_usb, bool dsd_u32,
+		  bool shift8, bool pack, bool reverse_endian);
+
+	/**
+	 * Discard the frames kept for the next call, e.g. after the
+	 * device buffer has been dropped.
+	 */
+	void Reset() {
+		dsd_rest_size = dsd_rest_prepended = 0;
+	}
 
 	/**
 	 * Calculate the size of one output frame.
@@ -112,6 +149,21 @@ struct PcmExport {
 	 */
 	ConstBuffer<void> Export(ConstBuffer<void> src);
 
+	/**
+	 * Like Export(), but write the result to the given buffer,
+	 * e.g. directly into a memory mapped device buffer.  The last
+	 * conversion step writes to the buffer; only the
+	 * combination of packing/shifting with byte swapping
+	 * requires an intermediate buffer.
+	 *
+	 * @param dest the destination buffer; it must be large enough
+	 * for the exported data (see GetFrameSize()), including
+	 * frames left over by the previous call
+	 * @return the number of bytes written to the destination
+	 * buffer
+	 */
+	size_t ExportTo(void *dest, ConstBuffer<void> src);
+
 	/**
 	 * Converts the number of consumed bytes from the pcm_export()
 	 * destination buffer to the according number of bytes from the
@@ -119,6 +171,36 @@ struct PcmExport {
 	 */
 	gcc_pure
 	size_t CalcSourceSize(size_t dest_size) const;
+
+	/**
+	 * Like CalcSourceSize(), but for a partial write of the
+	 * buffer returned by the last Export() call: returns the
+	 * number of bytes of the Export() source buffer which were
+	 * consumed.  Frames buffered in #dsd_rest are discarded,
+	 * because the caller will submit the remaining source bytes
+	 * again.
+	 */
+	size_t CalcPartialSourceSize(size_t dest_size);
+
+private:
+	/**
+	 * Convert DSD to DSD_U32 (#dsd_u32), prepending #dsd_rest
+	 * and keeping the frames which do not fill a whole DSD_U32
+	 * frame in #dsd_rest.
+	 *
+	 * @param dest the destination buffer; it must have room for
+	 * #dsd_rest_size + #src.size bytes
+	 * @return the number of bytes written
+	 */
+	size_t ExportDsdU32(void *dest, ConstBuffer<uint8_t> src);
+
+	/**
+	 * Pack or shift 24 bit samples (#pack24 or #shift8) into the
+	 * given buffer.
+	 *
+	 * @return the number of bytes written
+	 */
+	size_t Export24(void *dest, ConstBuffer<void> src) const;
 };
 
 #endif
@@ -45,10 +45,47 @@ struct PerSampleConvert : C {
 	}
 };
 
-struct Convert8To16
+/**
+ * A template class that attempts to use the "optimized" algorithm for
+ * large portions of the buffer, and calls the "portable" algorithm"
+ * for the rest when the last block is not full.
+ */
+template<typename Optimized, typename Portable>
+class GlueOptimizedConvert : Optimized, Portable {
+public:
+	typedef typename Portable::SrcTraits SrcTraits;
+	typedef typename Portable::DstTraits DstTraits;
+
+	void Convert(typename DstTraits::pointer_type out,
+		     typename SrcTraits::const_pointer_type in,
+		     size_t n) const {
+		Optimized::Convert(out, in, n);
+
+		/* use the "portable" algorithm for the trailing
+		   samples */
+		size_t remaining = n % Optimized::BLOCK_SIZE;
+		size_t done = n - remaining;
+		Portable::Convert(out + done, in + done, remaining);
+	}
+};
+
+#ifdef __ARM_NEON__
+#include "Neon.hxx"
+#elif defined(__SSE2__)
+#include "Sse2.hxx"
+#endif
+
+struct PortableConvert8To16
 	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S8,
 						  SampleFormat::S16>> {};
 
+#ifdef __SSE2__
+struct Convert8To16
+	: GlueOptimizedConvert<Sse2Convert8To16, PortableConvert8To16> {};
+#else
+struct Convert8To16 : PortableConvert8To16 {};
+#endif
+
 struct Convert24To16 {
 	typedef SampleTraits<SampleFormat::S24_P32> SrcTraits;
 	typedef SampleTraits<SampleFormat::S16> DstTraits;
@@ -82,38 +119,31 @@ struct PortableFloatToInteger
 template<SampleFormat F, class Traits=SampleTraits<F>>
 struct FloatToInteger : PortableFloatToInteger<F, Traits> {};
 
-/**
- * A template class that attempts to use the "optimized" algorithm for
- * large portions of the buffer, and calls the "portable" algorithm"
- * for the rest when the last block is not full.
- */
-template<typename Optimized, typename Portable>
-class GlueOptimizedConvert : Optimized, Portable {
-public:
-	typedef typename Portable::SrcTraits SrcTraits;
-	typedef typename Portable::DstTraits DstTraits;
-
-	void Convert(typename DstTraits::pointer_type out,
-		     typename SrcTraits::const_pointer_type in,
-		     size_t n) const {
-		Optimized::Convert(out, in, n);
-
-		/* use the "portable" algorithm for the trailing
-		   samples */
-		size_t remaining = n % Optimized::BLOCK_SIZE;
-		size_t done = n - remaining;
-		Portable::Convert(out + done, in + done, remaining);
-	}
-};
-
 #ifdef __ARM_NEON__
-#include "Neon.hxx"
 
 template<>
 struct FloatToInteger<SampleFormat::S16, SampleTraits<SampleFormat::S16>>
 	: GlueOptimizedConvert<NeonFloatTo16,
 			       PortableFloatToInteger<SampleFormat::S16>> {};
 
+#elif defined(__SSE2__)
+
+template<>
+struct FloatToInteger<SampleFormat::S16, SampleTraits<SampleFormat::S16>>
+	: GlueOptimizedConvert<Sse2FloatTo16,
+			       PortableFloatToInteger<SampleFormat::S16>> {};
+
+template<>
+struct FloatToInteger<SampleFormat::S24_P32,
+		      SampleTraits<SampleFormat::S24_P32>>
+	: GlueOptimizedConvert<Sse2FloatTo32<SampleFormat::S24_P32>,
+			       PortableFloatToInteger<SampleFormat::S24_P32>> {};
+
+template<>
+struct FloatToInteger<SampleFormat::S32, SampleTraits<SampleFormat::S32>>
+	: GlueOptimizedConvert<Sse2FloatTo32<SampleFormat::S32>,
+			       PortableFloatToInteger<SampleFormat::S32>> {};
+
 #endif
 
 template<class C>
@@ -195,10 +225,18 @@ struct Convert8To24
 	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S8,
 						  SampleFormat::S24_P32>> {};
 
-struct Convert16To24
+struct PortableConvert16To24
 	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S16,
 						  SampleFormat::S24_P32>> {};
 
+#ifdef __SSE2__
+struct Convert16To24
+	: GlueOptimizedConvert<Sse2Convert16To32<SampleFormat::S24_P32>,
+			       PortableConvert16To24> {};
+#else
+struct Convert16To24 : PortableConvert16To24 {};
+#endif
+
 static ConstBuffer<int32_t>
 pcm_allocate_8_to_24(PcmBuffer &buffer, ConstBuffer<int8_t> src)
 {
@@ -211,10 +249,17 @@ pcm_allocate_16_to_24(PcmBuffer &buffer, ConstBuffer<int16_t> src)
 	return AllocateConvert(buffer, Convert16To24(), src);
 }
 
-struct Convert32To24
+struct PortableConvert32To24
 	: PerSampleConvert<RightShiftSampleConvert<SampleFormat::S32,
 						   SampleFormat::S24_P32>> {};
 
+#ifdef __SSE2__
+struct Convert32To24
+	: GlueOptimizedConvert<Sse2Convert32To24, PortableConvert32To24> {};
+#else
+struct Convert32To24 : PortableConvert32To24 {};
+#endif
+
 static ConstBuffer<int32_t>
 pcm_allocate_32_to_24(PcmBuffer &buffer, ConstBuffer<int32_t> src)
 {
@@ -263,14 +308,29 @@ struct Convert8To32
 	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S8,
 						  SampleFormat::S32>> {};
 
-struct Convert16To32
+struct PortableConvert16To32
 	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S16,
 						  SampleFormat::S32>> {};
 
-struct Convert24To32
+#ifdef __SSE2__
+struct Convert16To32
+	: GlueOptimizedConvert<Sse2Convert16To32<SampleFormat::S32>,
+			       PortableConvert16To32> {};
+#else
+struct Convert16To32 : PortableConvert16To32 {};
+#endif
+
+struct PortableConvert24To32
 	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S24_P32,
 						  SampleFormat::S32>> {};
 
+#ifdef __SSE2__
+struct Convert24To32
+	: GlueOptimizedConvert<Sse2Convert24To32, PortableConvert24To32> {};
+#else
+struct Convert24To32 : PortableConvert24To32 {};
+#endif
+
 static ConstBuffer<int32_t>
 pcm_allocate_8_to_32(PcmBuffer &buffer, ConstBuffer<int8_t> src)
 {
@@ -330,15 +390,38 @@ pcm_convert_to_32(PcmBuffer &buffer,
 struct Convert8ToFloat
 	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S8>> {};
 
-struct Convert16ToFloat
+struct PortableConvert16ToFloat
 	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S16>> {};
 
-struct Convert24ToFloat
+#ifdef __SSE2__
+struct Convert16ToFloat
+	: GlueOptimizedConvert<Sse2Convert16ToFloat, PortableConvert16ToFloat> {};
+#else
+struct Convert16ToFloat : PortableConvert16ToFloat {};
+#endif
+
+struct PortableConvert24ToFloat
 	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S24_P32>> {};
 
-struct Convert32ToFloat
+#ifdef __SSE2__
+struct Convert24ToFloat
+	: GlueOptimizedConvert<Sse2Convert32ToFloat<SampleFormat::S24_P32>,
+			       PortableConvert24ToFloat> {};
+#else
+struct Convert24ToFloat : PortableConvert24ToFloat {};
+#endif
+
+struct PortableConvert32ToFloat
 	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S32>> {};
 
+#ifdef __SSE2__
+struct Convert32ToFloat
+	: GlueOptimizedConvert<Sse2Convert32ToFloat<SampleFormat::S32>,
+			       PortableConvert32ToFloat> {};
+#else
+struct Convert32ToFloat : PortableConvert32ToFloat {};
+#endif
+
 static ConstBuffer<float>
 pcm_allocate_8_to_float(PcmBuffer &buffer, ConstBuffer<int8_t> src)
 {
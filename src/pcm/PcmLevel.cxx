@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "PcmLevel.hxx"
+#include "Traits.hxx"
+#include "util/ConstBuffer.hxx"
+
+#ifdef __SSE2__
+#define PCM_LEVEL_SSE2
+#include "Sse2.hxx"
+#endif
+
+#include <algorithm>
+
+/**
+ * The factor which normalizes a sample to the range [-1,1].
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>>
+struct PcmLevelFactor {
+	static constexpr float value =
+		1.0f / (uint_least64_t(1) << (Traits::BITS - 1));
+};
+
+template<>
+struct PcmLevelFactor<SampleFormat::FLOAT> {
+	static constexpr float value = 1;
+};
+
+template<SampleFormat F, class Traits=SampleTraits<F>>
+static void
+pcm_level_generic(PcmLevel &level, const typename Traits::value_type *src,
+		  size_t n_frames)
+{
+	const float factor = PcmLevelFactor<F>::value;
+
+	for (size_t i = 0; i < n_frames; ++i) {
+		for (unsigned c = 0; c < level.channels; ++c) {
+			const float x = float(*src++) * factor;
+			level.peak[c] = std::max(level.peak[c], fabsf(x));
+			level.sum_squares[c] += x * x;
+		}
+	}
+}
+
+#ifdef PCM_LEVEL_SSE2
+
+static inline void
+sse2_level_load(const float *src, gcc_unused __m128 factor,
+		__m128 &lo, __m128 &hi)
+{
+	lo = _mm_loadu_ps(src);
+	hi = _mm_loadu_ps(src + 4);
+}
+
+static inline void
+sse2_level_load(const int16_t *src, __m128 factor, __m128 &lo, __m128 &hi)
+{
+	const __m128i x = _mm_loadu_si128((const __m128i *)src);
+	lo = _mm_mul_ps(_mm_cvtepi32_ps(sse2_unpacklo_epi16_to_epi32(x)),
+			factor);
+	hi = _mm_mul_ps(_mm_cvtepi32_ps(sse2_unpackhi_epi16_to_epi32(x)),
+			factor);
+}
+
+static inline void
+sse2_level_load(const int32_t *src, __m128 factor, __m128 &lo, __m128 &hi)
+{
+	lo = _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)src)),
+			factor);
+	hi = _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(src + 4))),
+			factor);
+}
+
+/**
+ * Accumulate the levels of eight samples per iteration.  Each lane
+ * belongs to exactly one channel if the number of channels divides
+ * eight; other layouts use the generic code.
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>>
+static size_t
+pcm_level_sse2(PcmLevel &level, const typename Traits::value_type *src,
+	       size_t n_samples)
+{
+	static constexpr size_t BLOCK_SIZE = 8;
+
+	if (BLOCK_SIZE % level.channels != 0)
+		return 0;
+
+	const __m128 factor = _mm_set1_ps(PcmLevelFactor<F>::value);
+	const __m128 sign = _mm_set1_ps(-0.0f);
+
+	__m128 peak_lo = _mm_setzero_ps(), peak_hi = _mm_setzero_ps();
+	__m128 sum_lo = _mm_setzero_ps(), sum_hi = _mm_setzero_ps();
+
+	const size_t n = n_samples / BLOCK_SIZE;
+	for (size_t i = 0; i < n; ++i, src += BLOCK_SIZE) {
+		__m128 lo, hi;
+		sse2_level_load(src, factor, lo, hi);
+
+		peak_lo = _mm_max_ps(peak_lo, _mm_andnot_ps(sign, lo));
+		peak_hi = _mm_max_ps(peak_hi, _mm_andnot_ps(sign, hi));
+		sum_lo = _mm_add_ps(sum_lo, _mm_mul_ps(lo, lo));
+		sum_hi = _mm_add_ps(sum_hi, _mm_mul_ps(hi, hi));
+	}
+
+	alignas(16) float peak[BLOCK_SIZE], sum[BLOCK_SIZE];
+	_mm_store_ps(peak, peak_lo);
+	_mm_store_ps(peak + 4, peak_hi);
+	_mm_store_ps(sum, sum_lo);
+	_mm_store_ps(sum + 4, sum_hi);
+
+	for (unsigned i = 0; i < BLOCK_SIZE; ++i) {
+		const unsigned c = i % level.channels;
+		level.peak[c] = std::max(level.peak[c], peak[i]);
+		level.sum_squares[c] += sum[i];
+	}
+
+	return n * BLOCK_SIZE;
+}
+
+#endif
+
+template<SampleFormat F, class Traits=SampleTraits<F>>
+static void
+pcm_level(PcmLevel &level, ConstBuffer<void> _src)
+{
+	const auto src =
+		ConstBuffer<typename Traits::value_type>::FromVoid(_src);
+	const typename Traits::value_type *p = src.data;
+	size_t n_samples = src.size;
+
+#ifdef PCM_LEVEL_SSE2
+	const size_t n = pcm_level_sse2<F>(level, p, n_samples);
+	p += n;
+	n_samples -= n;
+#endif
+
+	pcm_level_generic<F>(level, p, n_samples / level.channels);
+}
+
+void
+PcmLevel::Update(SampleFormat format, ConstBuffer<void> src)
+{
+	assert(channels > 0);
+	assert(src.size % (sample_format_size(format) * channels) == 0);
+
+	switch (format) {
+	case SampleFormat::UNDEFINED:
+	case SampleFormat::DSD:
+		return;
+
+	case SampleFormat::S8:
+		pcm_level_generic<SampleFormat::S8>(*this,
+						    (const int8_t *)src.data,
+						    src.size / channels);
+		break;
+
+	case SampleFormat::S16:
+		pcm_level<SampleFormat::S16>(*this, src);
+		break;
+
+	case SampleFormat::S24_P32:
+		pcm_level<SampleFormat::S24_P32>(*this, src);
+		break;
+
+	case SampleFormat::S32:
+		pcm_level<SampleFormat::S32>(*this, src);
+		break;
+
+	case SampleFormat::FLOAT:
+		pcm_level<SampleFormat::FLOAT>(*this, src);
+		break;
+	}
+
+	n_frames += src.size / (sample_format_size(format) * channels);
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_LEVEL_HXX
+#define MPD_PCM_LEVEL_HXX
+
+#include "AudioFormat.hxx"
+#include "Compiler.h"
+
+#include <assert.h>
+#include <math.h>
+
+template<typename T> struct ConstBuffer;
+
+/**
+ * Accumulates the peak and RMS levels of a PCM stream, separately for
+ * each channel.  All values are linear and normalized, i.e. a full
+ * scale sample has the level 1.0.
+ */
+struct PcmLevel {
+	unsigned channels;
+
+	/**
+	 * The number of frames accumulated since the last Clear().
+	 */
+	unsigned n_frames;
+
+	float peak[MAX_CHANNELS];
+
+	/**
+	 * The sum of the squares of all samples, indexed by channel.
+	 */
+	double sum_squares[MAX_CHANNELS];
+
+	void Clear(unsigned _channels) {
+		assert(_channels <= MAX_CHANNELS);
+
+		channels = _channels;
+		n_frames = 0;
+
+		for (unsigned i = 0; i < channels; ++i) {
+			peak[i] = 0;
+			sum_squares[i] = 0;
+		}
+	}
+
+	bool IsEmpty() const {
+		return n_frames == 0;
+	}
+
+	gcc_pure
+	float GetRms(unsigned channel) const {
+		assert(channel < channels);
+		assert(!IsEmpty());
+
+		return sqrt(sum_squares[channel] / n_frames);
+	}
+
+	/**
+	 * Add the specified samples to the levels.  DSD is not
+	 * supported and ignored.
+	 *
+	 * @param format the sample format of #src
+	 * @param src interleaved samples with #channels channels
+	 */
+	void Update(SampleFormat format, ConstBuffer<void> src);
+};
+
+#endif
@@ -27,7 +27,16 @@
 
 #include "PcmDither.cxx" // including the .cxx file to get inlined templates
 
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define PCM_MIX_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#define PCM_MIX_SSE2
+#include "Sse2.hxx"
+#endif
+
 #include <assert.h>
+#include <stdint.h>
 #include <math.h>
 
 template<SampleFormat F, class Traits=SampleTraits<F>>
@@ -75,6 +84,23 @@ static void
 pcm_add_vol_float(float *buffer1, const float *buffer2,
 		  unsigned num_samples, float volume1, float volume2)
 {
+#if defined(PCM_MIX_NEON)
+	for (; num_samples >= 4; num_samples -= 4,
+		     buffer1 += 4, buffer2 += 4) {
+		float32x4_t a = vmulq_n_f32(vld1q_f32(buffer1), volume1);
+		a = vmlaq_n_f32(a, vld1q_f32(buffer2), volume2);
+		vst1q_f32(buffer1, a);
+	}
+#elif defined(PCM_MIX_SSE2)
+	const __m128 v1 = _mm_set1_ps(volume1), v2 = _mm_set1_ps(volume2);
+	for (; num_samples >= 4; num_samples -= 4,
+		     buffer1 += 4, buffer2 += 4) {
+		__m128 a = _mm_mul_ps(_mm_loadu_ps(buffer1), v1);
+		__m128 b = _mm_mul_ps(_mm_loadu_ps(buffer2), v2);
+		_mm_storeu_ps(buffer1, _mm_add_ps(a, b));
+	}
+#endif
+
 	while (num_samples > 0) {
 		float sample1 = *buffer1;
 		float sample2 = *buffer2++;
@@ -163,9 +189,98 @@ PcmAddVoid(void *a, const void *b, size_t size)
 			  size / sample_size);
 }
 
+/**
+ * Saturating addition of 16 bit samples.  The SIMD code produces the
+ * same result as the generic PcmAdd() template.
+ */
+static void
+pcm_add_16(int16_t *a, const int16_t *b, size_t n)
+{
+#if defined(PCM_MIX_NEON)
+	for (; n >= 8; n -= 8, a += 8, b += 8)
+		vst1q_s16(a, vqaddq_s16(vld1q_s16(a), vld1q_s16(b)));
+#elif defined(PCM_MIX_SSE2)
+	for (; n >= 8; n -= 8, a += 8, b += 8) {
+		__m128i x = _mm_loadu_si128((const __m128i *)a);
+		__m128i y = _mm_loadu_si128((const __m128i *)b);
+		_mm_storeu_si128((__m128i *)a, _mm_adds_epi16(x, y));
+	}
+#endif
+
+	PcmAdd<SampleFormat::S16>(a, b, n);
+}
+
+static void
+pcm_add_24(int32_t *a, const int32_t *b, size_t n)
+{
+	typedef SampleTraits<SampleFormat::S24_P32> Traits;
+
+#if defined(PCM_MIX_NEON)
+	const int32x4_t min = vdupq_n_s32(Traits::MIN);
+	const int32x4_t max = vdupq_n_s32(Traits::MAX);
+	for (; n >= 4; n -= 4, a += 4, b += 4) {
+		/* the sum of two 24 bit samples cannot overflow 32 bit */
+		int32x4_t c = vaddq_s32(vld1q_s32(a), vld1q_s32(b));
+		vst1q_s32(a, vminq_s32(vmaxq_s32(c, min), max));
+	}
+#elif defined(PCM_MIX_SSE2)
+	const __m128i min = _mm_set1_epi32(Traits::MIN);
+	const __m128i max = _mm_set1_epi32(Traits::MAX);
+	for (; n >= 4; n -= 4, a += 4, b += 4) {
+		__m128i c = _mm_add_epi32(_mm_loadu_si128((const __m128i *)a),
+					  _mm_loadu_si128((const __m128i *)b));
+		_mm_storeu_si128((__m128i *)a, sse2_clamp_epi32(c, min, max));
+	}
+#endif
+
+	PcmAdd<SampleFormat::S24_P32, Traits>(a, b, n);
+}
+
+static void
+pcm_add_32(int32_t *a, const int32_t *b, size_t n)
+{
+#if defined(PCM_MIX_NEON)
+	for (; n >= 4; n -= 4, a += 4, b += 4)
+		vst1q_s32(a, vqaddq_s32(vld1q_s32(a), vld1q_s32(b)));
+#elif defined(PCM_MIX_SSE2)
+	/* SSE2 has no saturating 32 bit addition: detect signed
+	   overflow (both operands have a different sign than the
+	   sum) and replace those sums with INT32_MAX or INT32_MIN,
+	   depending on the sign of the operands */
+	const __m128i max = _mm_set1_epi32(INT32_MAX);
+	for (; n >= 4; n -= 4, a += 4, b += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i *)a);
+		__m128i y = _mm_loadu_si128((const __m128i *)b);
+		__m128i c = _mm_add_epi32(x, y);
+		__m128i overflow =
+			_mm_srai_epi32(_mm_and_si128(_mm_xor_si128(x, c),
+						     _mm_xor_si128(y, c)),
+				       31);
+		__m128i saturated = _mm_xor_si128(_mm_srai_epi32(x, 31), max);
+		_mm_storeu_si128((__m128i *)a,
+				 sse2_select(overflow, saturated, c));
+	}
+#endif
+
+	PcmAdd<SampleFormat::S32>(a, b, n);
+}
+
 static void
 pcm_add_float(float *buffer1, const float *buffer2, unsigned num_samples)
 {
+#if defined(PCM_MIX_NEON)
+	for (; num_samples >= 4; num_samples -= 4,
+		     buffer1 += 4, buffer2 += 4)
+		vst1q_f32(buffer1,
+			  vaddq_f32(vld1q_f32(buffer1), vld1q_f32(buffer2)));
+#elif defined(PCM_MIX_SSE2)
+	for (; num_samples >= 4; num_samples -= 4,
+		     buffer1 += 4, buffer2 += 4)
+		_mm_storeu_ps(buffer1,
+			      _mm_add_ps(_mm_loadu_ps(buffer1),
+					 _mm_loadu_ps(buffer2)));
+#endif
+
 	while (num_samples > 0) {
 		float sample1 = *buffer1;
 		float sample2 = *buffer2++;
@@ -189,15 +304,18 @@ pcm_add(void *buffer1, const void *buffer2, size_t size,
 		return true;
 
 	case SampleFormat::S16:
-		PcmAddVoid<SampleFormat::S16>(buffer1, buffer2, size);
+		pcm_add_16((int16_t *)buffer1, (const int16_t *)buffer2,
+			   size / 2);
 		return true;
 
 	case SampleFormat::S24_P32:
-		PcmAddVoid<SampleFormat::S24_P32>(buffer1, buffer2, size);
+		pcm_add_24((int32_t *)buffer1, (const int32_t *)buffer2,
+			   size / 4);
 		return true;
 
 	case SampleFormat::S32:
-		PcmAddVoid<SampleFormat::S32>(buffer1, buffer2, size);
+		pcm_add_32((int32_t *)buffer1, (const int32_t *)buffer2,
+			   size / 4);
 		return true;
 
 	case SampleFormat::FLOAT:
@@ -230,3 +348,25 @@ pcm_mix(PcmDither &dither, void *buffer1, const void *buffer2, size_t size,
 	return pcm_add_vol(dither, buffer1, buffer2, size,
 			   vol1, PCM_VOLUME_1S - vol1, format);
 }
+
+bool
+pcm_mix(PcmDither &dither, void *buffer1, const void *buffer2, size_t size,
+	SampleFormat format, float portion1,
+	unsigned volume1, unsigned volume2)
+{
+	if (volume1 == PCM_VOLUME_1 && volume2 == PCM_VOLUME_1)
+		return pcm_mix(dither, buffer1, buffer2, size, format,
+			       portion1);
+
+	float s = 1, t = 1;
+	if (portion1 >= 0) {
+		s = sin(M_PI_2 * portion1);
+		s *= s;
+		t = 1 - s;
+	}
+
+	const int vol1 = s * volume1 + 0.5;
+	const int vol2 = t * volume2 + 0.5;
+	return pcm_add_vol(dither, buffer1, buffer2, size,
+			   vol1, vol2, format);
+}
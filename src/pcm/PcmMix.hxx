@@ -49,4 +49,15 @@ bool
 pcm_mix(PcmDither &dither, void *buffer1, const void *buffer2, size_t size,
 	SampleFormat format, float portion1);
 
+/**
+ * Like pcm_mix(), but each buffer is additionally scaled by a
+ * volume level (#PCM_VOLUME_1 is 100%) in the same pass.  This is
+ * used to apply replay gain and software volume while cross-fading.
+ */
+gcc_warn_unused_result
+bool
+pcm_mix(PcmDither &dither, void *buffer1, const void *buffer2, size_t size,
+	SampleFormat format, float portion1,
+	unsigned volume1, unsigned volume2);
+
 #endif
@@ -20,6 +20,16 @@
 #include "PcmPack.hxx"
 #include "system/ByteOrder.hxx"
 
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define PCM_PACK_NEON
+#include <arm_neon.h>
+#elif defined(__SSSE3__)
+#define PCM_PACK_SSSE3
+#include <tmmintrin.h>
+#endif
+
+#include <string.h>
+
 static void
 pack_sample(uint8_t *dest, const int32_t *src0)
 {
@@ -36,6 +46,37 @@ pack_sample(uint8_t *dest, const int32_t *src0)
 void
 pcm_pack_24(uint8_t *dest, const int32_t *src, const int32_t *src_end)
 {
+#if defined(PCM_PACK_NEON)
+	if (IsLittleEndian()) {
+		/* de-interleave 16 samples into 4 planes of bytes,
+		   and store only the lower 3 of them */
+		for (; src_end - src >= 16; src += 16, dest += 48) {
+			const uint8x16x4_t x = vld4q_u8((const uint8_t *)src);
+			uint8x16x3_t y;
+			y.val[0] = x.val[0];
+			y.val[1] = x.val[1];
+			y.val[2] = x.val[2];
+			vst3q_u8(dest, y);
+		}
+	}
+#elif defined(PCM_PACK_SSSE3)
+	if (IsLittleEndian()) {
+		/* drop the most significant byte of 4 samples,
+		   and store the remaining 12 bytes */
+		const __m128i shuffle =
+			_mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14,
+				      -1, -1, -1, -1);
+		for (; src_end - src >= 4; src += 4, dest += 12) {
+			__m128i x = _mm_loadu_si128((const __m128i *)src);
+			x = _mm_shuffle_epi8(x, shuffle);
+			_mm_storel_epi64((__m128i *)dest, x);
+			const uint32_t tail =
+				_mm_cvtsi128_si32(_mm_srli_si128(x, 8));
+			memcpy(dest + 8, &tail, sizeof(tail));
+		}
+	}
+#endif
+
 	/* duplicate loop to help the compiler's optimizer (constant
 	   parameter to the pack_sample() inline function) */
 
@@ -66,6 +107,39 @@ unpack_sample(int32_t *dest0, const uint8_t *src)
 void
 pcm_unpack_24(int32_t *dest, const uint8_t *src, const uint8_t *src_end)
 {
+#if defined(PCM_PACK_NEON)
+	if (IsLittleEndian()) {
+		/* de-interleave 16 samples into 3 planes of bytes,
+		   and add the sign extension as the 4th plane */
+		for (; src_end - src >= 48; src += 48, dest += 16) {
+			const uint8x16x3_t x = vld3q_u8(src);
+			uint8x16x4_t y;
+			y.val[0] = x.val[0];
+			y.val[1] = x.val[1];
+			y.val[2] = x.val[2];
+			const int8x16_t msb =
+				vreinterpretq_s8_u8(x.val[2]);
+			y.val[3] = vreinterpretq_u8_s8(vshrq_n_s8(msb, 7));
+			vst4q_u8((uint8_t *)dest, y);
+		}
+	}
+#elif defined(PCM_PACK_SSSE3)
+	if (IsLittleEndian()) {
+		/* move the 3 bytes of each sample to the upper part
+		   of a 32 bit integer, and shift it back to extend
+		   the sign bit; this reads 16 bytes at a time, but
+		   consumes only 12 */
+		const __m128i shuffle =
+			_mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5,
+				      -1, 6, 7, 8, -1, 9, 10, 11);
+		for (; src_end - src >= 16; src += 12, dest += 4) {
+			__m128i x = _mm_loadu_si128((const __m128i *)src);
+			x = _mm_srai_epi32(_mm_shuffle_epi8(x, shuffle), 8);
+			_mm_storeu_si128((__m128i *)dest, x);
+		}
+	}
+#endif
+
 	/* duplicate loop to help the compiler's optimizer (constant
 	   parameter to the unpack_sample() inline function) */
 
@@ -20,6 +20,9 @@
 #ifndef MPD_PCM_PRNG_HXX
 #define MPD_PCM_PRNG_HXX
 
+#include <stddef.h>
+#include <stdint.h>
+
 /**
  * A very simple linear congruential PRNG.  It's good enough for PCM
  * dithering.
@@ -30,4 +33,37 @@ pcm_prng(unsigned long state)
 	return (state * 0x0019660dL + 0x3c6ef35fL) & 0xffffffffL;
 }
 
+static constexpr uint32_t PCM_PRNG_A = 0x0019660d, PCM_PRNG_C = 0x3c6ef35f;
+static constexpr uint32_t PCM_PRNG_A2 = PCM_PRNG_A * PCM_PRNG_A;
+static constexpr uint32_t PCM_PRNG_C2 = PCM_PRNG_C * (PCM_PRNG_A + 1);
+
+/**
+ * Returns the fourth successor of the given pcm_prng() state.
+ */
+constexpr static inline uint32_t
+pcm_prng4(uint32_t state)
+{
+	return state * (PCM_PRNG_A2 * PCM_PRNG_A2)
+		+ PCM_PRNG_C2 * (PCM_PRNG_A2 + 1);
+}
+
+/**
+ * Fill a buffer with the pcm_prng() sequence.  Four interleaved
+ * generators skipping three numbers each produce the same sequence
+ * as one pcm_prng() chain, but without the dependency between
+ * neighbouring numbers, which allows the compiler to vectorize this
+ * loop.
+ *
+ * @param state four consecutive pcm_prng() states; they are
+ * advanced by this function
+ * @param n the number of values, must be a multiple of 4
+ */
+static inline void
+pcm_prng_fill(uint32_t state[4], uint32_t *dest, size_t n)
+{
+	for (size_t i = 0; i < n; i += 4)
+		for (unsigned j = 0; j < 4; ++j)
+			dest[i + j] = state[j] = pcm_prng4(state[j]);
+}
+
 #endif
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "PcmRateAdjust.hxx"
+#include "Domain.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Error.hxx"
+
+#include <assert.h>
+
+bool
+PcmRateAdjust::Open(const AudioFormat af, Error &error)
+{
+	assert(af.IsValid());
+
+	if (af.format == SampleFormat::DSD ||
+	    af.format == SampleFormat::S8) {
+		error.Format(pcm_domain,
+			     "Cannot adjust the rate of %s samples",
+			     sample_format_to_string(af.format));
+		return false;
+	}
+
+	format = af.format;
+
+	AudioFormat float_format = af;
+	if (!resampler.Open(float_format, af.sample_rate, error)
+	    .IsDefined())
+		return false;
+
+	assert(float_format.format == SampleFormat::FLOAT);
+
+	if (!to_float.Open(format, SampleFormat::FLOAT, error)) {
+		resampler.Close();
+		return false;
+	}
+
+	if (!from_float.Open(SampleFormat::FLOAT, format, error)) {
+		to_float.Close();
+		resampler.Close();
+		return false;
+	}
+
+	return true;
+}
+
+void
+PcmRateAdjust::Close()
+{
+	from_float.Close();
+	to_float.Close();
+	resampler.Close();
+}
+
+void
+PcmRateAdjust::Reset()
+{
+	resampler.Reset();
+	resampler.SetRatio(1.0);
+}
+
+ConstBuffer<void>
+PcmRateAdjust::Apply(ConstBuffer<void> src, Error &error)
+{
+	if (format != SampleFormat::FLOAT) {
+		src = to_float.Convert(src, error);
+		if (src.IsNull())
+			return nullptr;
+	}
+
+	src = resampler.Resample(src, error);
+	if (src.IsNull() || format == SampleFormat::FLOAT)
+		return src;
+
+	return from_float.Convert(src, error);
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PCM_RATE_ADJUST_HXX
+#define MPD_PCM_RATE_ADJUST_HXX
+
+#include "check.h"
+#include "PolyphaseResampler.hxx"
+#include "FormatConverter.hxx"
+#include "AudioFormat.hxx"
+
+class Error;
+template<typename T> struct ConstBuffer;
+
+/**
+ * Adjusts the playback rate of a PCM stream by a tiny amount without
+ * changing its audio format, to keep it synchronized with an
+ * external clock.  It uses the built-in polyphase resampler in
+ * variable ratio mode.
+ */
+class PcmRateAdjust {
+	SampleFormat format;
+
+	PolyphasePcmResampler resampler;
+
+	PcmFormatConverter to_float, from_float;
+
+public:
+	PcmRateAdjust()
+		:resampler(true) {}
+
+	/**
+	 * Opens the object, prepare for Apply().
+	 *
+	 * @param af the audio format of the stream; DSD and 8 bit
+	 * samples are not supported
+	 * @param error location to store the error
+	 * @return true on success
+	 */
+	bool Open(const AudioFormat af, Error &error);
+
+	/**
+	 * Closes the object.  After that, you may call Open() again.
+	 */
+	void Close();
+
+	/**
+	 * Discard the resampler state, e.g. after the device's buffer
+	 * has been cleared.  This also resets the ratio.
+	 */
+	void Reset();
+
+	/**
+	 * @param ratio the correction factor for the number of
+	 * frames; above 1.0 makes playback slower
+	 */
+	void SetRatio(double ratio) {
+		resampler.SetRatio(ratio);
+	}
+
+	/**
+	 * Resample a block of PCM data.
+	 *
+	 * @return the destination buffer on success,
+	 * ConstBuffer::Null() on error
+	 */
+	ConstBuffer<void> Apply(ConstBuffer<void> src, Error &error);
+};
+
+#endif
@@ -0,0 +1,372 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "PolyphaseResampler.hxx"
+#include "AudioFormat.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define PCM_POLYPHASE_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#define PCM_POLYPHASE_SSE2
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+static constexpr Domain polyphase_domain("polyphase");
+
+struct PolyphaseQuality {
+	const char *name;
+
+	/**
+	 * The number of filter taps per phase when upsampling.
+	 * Downsampling needs proportionally more.
+	 */
+	unsigned n_taps;
+
+	/**
+	 * The shape parameter of the Kaiser window; this determines
+	 * the stopband attenuation.
+	 */
+	double beta;
+
+	/**
+	 * The passband width relative to the Nyquist frequency.
+	 */
+	double cutoff;
+};
+
+static constexpr PolyphaseQuality polyphase_qualities[] = {
+	{ "best", 64, 10.0, 0.95 },
+	{ "medium", 32, 8.6, 0.91 },
+	{ "fast", 16, 6.0, 0.85 },
+};
+
+static const PolyphaseQuality *polyphase_quality = &polyphase_qualities[1];
+
+/**
+ * Ratios with a larger numerator (e.g. 44100 to 44101 Hz) use the
+ * nearest one of this many phases.
+ */
+static constexpr unsigned MAX_PHASES = 1024;
+
+static constexpr unsigned MAX_TAPS = 256;
+
+static bool
+polyphase_parse_converter(const char *converter)
+{
+	assert(converter != nullptr);
+
+	assert(memcmp(converter, "polyphase", 9) == 0);
+	if (converter[9] == '\0')
+		return true;
+	if (converter[9] != ' ')
+		return false;
+
+	const char *quality = converter + 10;
+	for (const auto &i : polyphase_qualities) {
+		if (strcmp(quality, i.name) == 0) {
+			polyphase_quality = &i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool
+pcm_resample_polyphase_global_init(const char *converter, Error &error)
+{
+	if (!polyphase_parse_converter(converter)) {
+		error.Format(polyphase_domain,
+			     "unknown samplerate converter '%s'", converter);
+		return false;
+	}
+
+	return true;
+}
+
+gcc_const
+static unsigned
+gcd(unsigned a, unsigned b)
+{
+	while (b != 0) {
+		const unsigned t = a % b;
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+
+/**
+ * The zeroth order modified Bessel function of the first kind.
+ */
+gcc_const
+static double
+bessel_i0(double x)
+{
+	const double x2 = x * x / 4;
+	double sum = 1, term = 1;
+	for (unsigned k = 1; term > sum * 1e-12; ++k) {
+		term *= x2 / (k * k);
+		sum += term;
+	}
+
+	return sum;
+}
+
+/**
+ * Calculate the coefficients of a Kaiser-windowed sinc low-pass
+ * filter, split into the given number of phases.
+ *
+ * Phase p interpolates at p/n_phases between the input frames
+ * n_taps/2-1 and n_taps/2 of the filter window.
+ *
+ * @param cutoff the cutoff frequency relative to the Nyquist
+ * frequency of the input
+ */
+static void
+polyphase_design(float *dest, unsigned n_phases, unsigned n_taps,
+		 double cutoff, double beta)
+{
+	const double half = n_taps / 2;
+	const double i0_beta = bessel_i0(beta);
+
+	for (unsigned p = 0; p < n_phases; ++p, dest += n_taps) {
+		const double offset = half - 1 + double(p) / n_phases;
+
+		double sum = 0;
+		for (unsigned k = 0; k < n_taps; ++k) {
+			const double t = offset - k;
+			const double x = t / half;
+			const double window =
+				bessel_i0(beta * sqrt(std::max(1 - x * x, 0.)))
+				/ i0_beta;
+			const double sinc = t == 0
+				? cutoff
+				: sin(M_PI * cutoff * t) / (M_PI * t);
+
+			const double c = sinc * window;
+			dest[k] = c;
+			sum += c;
+		}
+
+		/* normalize each phase to unity gain, to avoid
+		   modulating the DC level */
+		for (unsigned k = 0; k < n_taps; ++k)
+			dest[k] /= sum;
+	}
+}
+
+/**
+ * Multiply the filter coefficients with the source frames and
+ * return the sum.
+ */
+gcc_pure
+static float
+polyphase_dot(const float *filter, const float *src, unsigned n)
+{
+	assert(n % 4 == 0);
+
+#if defined(PCM_POLYPHASE_NEON)
+	float32x4_t sum = vdupq_n_f32(0);
+	for (; n > 0; n -= 4, filter += 4, src += 4)
+		sum = vmlaq_f32(sum, vld1q_f32(filter), vld1q_f32(src));
+
+	float32x2_t sum2 = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+	return vget_lane_f32(vpadd_f32(sum2, sum2), 0);
+#elif defined(PCM_POLYPHASE_SSE2)
+	__m128 sum = _mm_setzero_ps();
+	for (; n > 0; n -= 4, filter += 4, src += 4)
+		sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(filter),
+						 _mm_loadu_ps(src)));
+
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+	return _mm_cvtss_f32(sum);
+#else
+	float sum = 0;
+	for (unsigned i = 0; i < n; ++i)
+		sum += filter[i] * src[i];
+	return sum;
+#endif
+}
+
+AudioFormat
+PolyphasePcmResampler::Open(AudioFormat &af, unsigned new_sample_rate,
+			    gcc_unused Error &error)
+{
+	assert(af.IsValid());
+	assert(audio_valid_sample_rate(new_sample_rate));
+
+	const unsigned divisor = gcd(af.sample_rate, new_sample_rate);
+	factor_up = new_sample_rate / divisor;
+	factor_down = af.sample_rate / divisor;
+	n_phases = variable ? MAX_PHASES : std::min(factor_up, MAX_PHASES);
+	step = (uint64_t(factor_down) << 32) / factor_up;
+
+	const PolyphaseQuality &quality = *polyphase_quality;
+	double cutoff = quality.cutoff;
+	unsigned taps = quality.n_taps;
+	if (factor_down > factor_up) {
+		/* downsampling: move the cutoff frequency below the
+		   new Nyquist frequency, and widen the filter window
+		   to keep the transition band steep */
+		cutoff = cutoff * factor_up / factor_down;
+		taps = (unsigned)ceil(double(taps) * factor_down / factor_up);
+	}
+
+	n_taps = (std::min(taps, MAX_TAPS) + 3) & ~3u;
+
+	filter = new float[n_phases * n_taps];
+	polyphase_design(filter, n_phases, n_taps, cutoff, quality.beta);
+
+	channels = af.channels;
+	history = new float[channels * n_taps];
+	Reset();
+
+	/* the filter works with floating point samples */
+	af.format = SampleFormat::FLOAT;
+
+	AudioFormat result = af;
+	result.sample_rate = new_sample_rate;
+	return result;
+}
+
+void
+PolyphasePcmResampler::SetRatio(double ratio)
+{
+	assert(variable);
+	assert(ratio > 0);
+
+	step = (uint64_t)llround(4294967296. * factor_down
+				 / factor_up / ratio);
+}
+
+void
+PolyphasePcmResampler::Close()
+{
+	delete[] filter;
+	delete[] history;
+}
+
+void
+PolyphasePcmResampler::Reset()
+{
+	/* prefill with silence, so the first output frame is
+	   aligned with the first input frame */
+	n_history = n_taps / 2 - 1;
+	std::fill_n(history, channels * n_taps, 0.f);
+	position = phase = 0;
+}
+
+ConstBuffer<void>
+PolyphasePcmResampler::Resample(ConstBuffer<void> _src,
+				gcc_unused Error &error)
+{
+	const auto src = ConstBuffer<float>::FromVoid(_src);
+	assert(src.size % channels == 0);
+
+	const unsigned n_frames = src.size / channels;
+	const unsigned n_work = n_history + n_frames;
+
+	/* deinterleave the input, each channel after its
+	   history */
+	float *const w = work.GetT<float>(channels * n_work);
+	for (unsigned c = 0; c < channels; ++c) {
+		float *wc = std::copy_n(history + c * n_taps, n_history,
+					w + c * n_work);
+		for (unsigned i = 0; i < n_frames; ++i)
+			wc[i] = src.data[i * channels + c];
+	}
+
+	const unsigned max_frames = variable
+		? (uint64_t(n_work) << 32) / step + 1
+		: uint64_t(n_work) * factor_up / factor_down + 1;
+	float *const dest = buffer.GetT<float>(max_frames * channels);
+
+	unsigned n_dest_frames = 0, p = position, ph = phase;
+	for (unsigned c = 0; c < channels; ++c) {
+		const float *wc = w + c * n_work;
+		float *d = dest + c;
+
+		n_dest_frames = 0;
+		p = position;
+		ph = phase;
+
+		if (variable) {
+			while (p + n_taps <= n_work) {
+				const unsigned i =
+					(uint64_t(ph) * n_phases) >> 32;
+
+				*d = polyphase_dot(filter + i * n_taps,
+						   wc + p, n_taps);
+				d += channels;
+				++n_dest_frames;
+
+				const uint64_t next = ph + step;
+				p += next >> 32;
+				ph = uint32_t(next);
+			}
+
+			continue;
+		}
+
+		while (p + n_taps <= n_work) {
+			const unsigned i = n_phases == factor_up
+				? ph
+				: uint64_t(ph) * n_phases / factor_up;
+
+			*d = polyphase_dot(filter + i * n_taps, wc + p, n_taps);
+			d += channels;
+			++n_dest_frames;
+
+			ph += factor_down;
+			p += ph / factor_up;
+			ph %= factor_up;
+		}
+	}
+
+	assert(n_dest_frames <= max_frames);
+
+	/* save the frames which are still needed by the next
+	   call */
+	const unsigned consumed = std::min(p, n_work);
+	n_history = n_work - consumed;
+	assert(n_history < n_taps);
+
+	for (unsigned c = 0; c < channels; ++c)
+		std::copy_n(w + c * n_work + consumed, n_history,
+			    history + c * n_taps);
+
+	position = p - consumed;
+	phase = ph;
+
+	return { dest, n_dest_frames * channels * sizeof(*dest) };
+}
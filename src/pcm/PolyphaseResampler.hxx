@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_POLYPHASE_RESAMPLER_HXX
+#define MPD_PCM_POLYPHASE_RESAMPLER_HXX
+
+#include "Resampler.hxx"
+#include "PcmBuffer.hxx"
+
+#include <stdint.h>
+
+struct AudioFormat;
+
+/**
+ * A built-in resampler using a windowed-sinc polyphase FIR filter
+ * bank.  The filter bank is computed in Open() for the exact ratio
+ * between the two sample rates; this gives good quality without an
+ * external library.
+ */
+class PolyphasePcmResampler final : public PcmResampler {
+	unsigned channels;
+
+	/**
+	 * The reduced conversion ratio: for each #factor_down input
+	 * frames, #factor_up output frames are generated.
+	 */
+	unsigned factor_up, factor_down;
+
+	/**
+	 * The number of phases in #filter.  This equals #factor_up
+	 * unless that is too large; in that case, the nearest phase
+	 * is used.
+	 */
+	unsigned n_phases;
+
+	/**
+	 * The number of filter taps per phase (a multiple of 4).
+	 */
+	unsigned n_taps;
+
+	/**
+	 * The integer source position of the next output frame
+	 * within the #work buffer, and its fractional part in units
+	 * of 1/#factor_up (or 2^-32 in variable ratio mode).
+	 */
+	unsigned position, phase;
+
+	/**
+	 * Is the conversion ratio variable (see SetRatio())?  In that
+	 * case, the source position advances by #step (32.32 fixed
+	 * point) per output frame instead of an exact fraction, and
+	 * the filter bank always has the maximum number of phases.
+	 */
+	const bool variable;
+
+	uint64_t step;
+
+	/**
+	 * The number of frames per channel in #history.
+	 */
+	unsigned n_history;
+
+	/**
+	 * The filter coefficients, #n_taps per phase.
+	 */
+	float *filter;
+
+	/**
+	 * The last input frames of each channel which are still
+	 * needed by the next Resample() call.  Each channel occupies
+	 * #n_taps floats.
+	 */
+	float *history;
+
+	/**
+	 * The input of one Resample() call, deinterleaved, prefixed
+	 * by #history.
+	 */
+	PcmBuffer work;
+
+	PcmBuffer buffer;
+
+public:
+	explicit PolyphasePcmResampler(bool _variable=false)
+		:variable(_variable) {}
+
+	/**
+	 * Fine-tune the conversion ratio, e.g. to follow a clock
+	 * which runs slightly faster or slower than the nominal
+	 * sample rate.  This is only allowed in variable ratio mode,
+	 * after Open().
+	 *
+	 * @param ratio the correction factor for the number of
+	 * output frames; above 1.0 means more output frames
+	 */
+	void SetRatio(double ratio);
+
+	virtual AudioFormat Open(AudioFormat &af, unsigned new_sample_rate,
+				 Error &error) override;
+	virtual void Close() override;
+	virtual void Reset() override;
+	virtual ConstBuffer<void> Resample(ConstBuffer<void> src,
+					   Error &error) override;
+};
+
+bool
+pcm_resample_polyphase_global_init(const char *converter, Error &error);
+
+#endif
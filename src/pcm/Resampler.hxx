@@ -54,6 +54,14 @@ public:
 	 */
 	virtual void Close() = 0;
 
+	/**
+	 * Discard the filter state, as if the resampler had just been
+	 * opened.  This allows reusing an opened resampler for a new
+	 * stream with the same audio format, without building the
+	 * filter again.
+	 */
+	virtual void Reset() = 0;
+
 	/**
 	 * Resamples a block of PCM data.
 	 *
@@ -66,7 +74,6 @@ public:
 	 * invalidated by filter_close() or filter_filter()), nullptr on
 	 * error
 	 */
-	gcc_pure
 	virtual ConstBuffer<void> Resample(ConstBuffer<void> src,
 					   Error &error) = 0;
 };
@@ -139,6 +139,12 @@ SoxrPcmResampler::Close()
 	soxr_delete(soxr);
 }
 
+void
+SoxrPcmResampler::Reset()
+{
+	soxr_clear(soxr);
+}
+
 ConstBuffer<void>
 SoxrPcmResampler::Resample(ConstBuffer<void> src, Error &error)
 {
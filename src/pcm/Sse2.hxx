@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_SSE2_HXX
+#define MPD_PCM_SSE2_HXX
+
+#include "Traits.hxx"
+
+#include <emmintrin.h>
+
+/**
+ * Select #x where #mask is all ones, else #y.
+ */
+static inline __m128i
+sse2_select(__m128i mask, __m128i x, __m128i y)
+{
+	return _mm_or_si128(_mm_and_si128(mask, x),
+			    _mm_andnot_si128(mask, y));
+}
+
+/**
+ * Clamp signed 32 bit integers to the range [min,max].  SSE2 has no
+ * _mm_min_epi32()/_mm_max_epi32().
+ */
+static inline __m128i
+sse2_clamp_epi32(__m128i x, __m128i min, __m128i max)
+{
+	x = sse2_select(_mm_cmpgt_epi32(x, max), max, x);
+	return sse2_select(_mm_cmplt_epi32(x, min), min, x);
+}
+
+/**
+ * Sign-extend the low/high four 16 bit integers to 32 bit.
+ */
+static inline __m128i
+sse2_unpacklo_epi16_to_epi32(__m128i x)
+{
+	return _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+}
+
+static inline __m128i
+sse2_unpackhi_epi16_to_epi32(__m128i x)
+{
+	return _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+}
+
+/**
+ * Convert 8 bit to 16 bit signed integer using SSE2.
+ */
+struct Sse2Convert8To16 {
+	static constexpr size_t BLOCK_SIZE = 16;
+
+	void Convert(int16_t *dst, const int8_t *src, const size_t n) const {
+		const __m128i zero = _mm_setzero_si128();
+
+		for (unsigned i = 0; i < n / BLOCK_SIZE;
+		     ++i, src += BLOCK_SIZE, dst += BLOCK_SIZE) {
+			__m128i x = _mm_loadu_si128((const __m128i *)src);
+
+			/* interleaving with zero bytes is the same
+			   as shifting left by 8 bits */
+			_mm_storeu_si128((__m128i *)dst,
+					 _mm_unpacklo_epi8(zero, x));
+			_mm_storeu_si128((__m128i *)(dst + 8),
+					 _mm_unpackhi_epi8(zero, x));
+		}
+	}
+};
+
+/**
+ * Convert 16 bit to 24 bit (padded to 32 bit) or 32 bit signed
+ * integer using SSE2.
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>>
+struct Sse2Convert16To32 {
+	static constexpr size_t BLOCK_SIZE = 8;
+
+	void Convert(int32_t *dst, const int16_t *src, const size_t n) const {
+		const __m128i zero = _mm_setzero_si128();
+
+		for (unsigned i = 0; i < n / BLOCK_SIZE;
+		     ++i, src += BLOCK_SIZE, dst += BLOCK_SIZE) {
+			__m128i x = _mm_loadu_si128((const __m128i *)src);
+
+			/* interleaving with zero words is the same
+			   as shifting left by 16 bits */
+			__m128i lo = _mm_unpacklo_epi16(zero, x);
+			__m128i hi = _mm_unpackhi_epi16(zero, x);
+
+			if (Traits::BITS < 32) {
+				lo = _mm_srai_epi32(lo, 32 - Traits::BITS);
+				hi = _mm_srai_epi32(hi, 32 - Traits::BITS);
+			}
+
+			_mm_storeu_si128((__m128i *)dst, lo);
+			_mm_storeu_si128((__m128i *)(dst + 4), hi);
+		}
+	}
+};
+
+/**
+ * Convert 24 bit (padded to 32 bit) to 32 bit signed integer using
+ * SSE2.
+ */
+struct Sse2Convert24To32 {
+	static constexpr size_t BLOCK_SIZE = 4;
+
+	void Convert(int32_t *dst, const int32_t *src, const size_t n) const {
+		for (unsigned i = 0; i < n / BLOCK_SIZE;
+		     ++i, src += BLOCK_SIZE, dst += BLOCK_SIZE) {
+			__m128i x = _mm_loadu_si128((const __m128i *)src);
+			_mm_storeu_si128((__m128i *)dst, _mm_slli_epi32(x, 8));
+		}
+	}
+};
+
+/**
+ * Convert 32 bit to 24 bit (padded to 32 bit) signed integer using
+ * SSE2.
+ */
+struct Sse2Convert32To24 {
+	static constexpr size_t BLOCK_SIZE = 4;
+
+	void Convert(int32_t *dst, const int32_t *src, const size_t n) const {
+		for (unsigned i = 0; i < n / BLOCK_SIZE;
+		     ++i, src += BLOCK_SIZE, dst += BLOCK_SIZE) {
+			__m128i x = _mm_loadu_si128((const __m128i *)src);
+			_mm_storeu_si128((__m128i *)dst, _mm_srai_epi32(x, 8));
+		}
+	}
+};
+
+/**
+ * Convert 16 bit signed integer to floating point using SSE2.
+ */
+struct Sse2Convert16ToFloat {
+	typedef SampleTraits<SampleFormat::S16> SrcTraits;
+
+	static constexpr size_t BLOCK_SIZE = 8;
+
+	void Convert(float *dst, const int16_t *src, const size_t n) const {
+		const __m128 factor =
+			_mm_set1_ps(0.5 / (1 << (SrcTraits::BITS - 2)));
+
+		for (unsigned i = 0; i < n / BLOCK_SIZE;
+		     ++i, src += BLOCK_SIZE, dst += BLOCK_SIZE) {
+			__m128i x = _mm_loadu_si128((const __m128i *)src);
+
+			__m128 lo = _mm_cvtepi32_ps(sse2_unpacklo_epi16_to_epi32(x));
+			__m128 hi = _mm_cvtepi32_ps(sse2_unpackhi_epi16_to_epi32(x));
+
+			_mm_storeu_ps(dst, _mm_mul_ps(lo, factor));
+			_mm_storeu_ps(dst + 4, _mm_mul_ps(hi, factor));
+		}
+	}
+};
+
+/**
+ * Convert 24 bit (padded to 32 bit) or 32 bit signed integer to
+ * floating point using SSE2.
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>>
+struct Sse2Convert32ToFloat {
+	static constexpr size_t BLOCK_SIZE = 4;
+
+	void Convert(float *dst, const int32_t *src, const size_t n) const {
+		const __m128 factor =
+			_mm_set1_ps(0.5 / (1 << (Traits::BITS - 2)));
+
+		for (unsigned i = 0; i < n / BLOCK_SIZE;
+		     ++i, src += BLOCK_SIZE, dst += BLOCK_SIZE) {
+			__m128i x = _mm_loadu_si128((const __m128i *)src);
+			_mm_storeu_ps(dst, _mm_mul_ps(_mm_cvtepi32_ps(x),
+						      factor));
+		}
+	}
+};
+
+/**
+ * Convert scaled floating point samples to 32 bit integer, truncating
+ * towards zero.  _mm_cvttps_epi32() returns INT32_MIN for all values
+ * which are out of range; this fixes up the positive ones to
+ * INT32_MAX, so they clip like FloatToIntegerSampleConvert.
+ */
+static inline __m128i
+sse2_cvttps_epi32_saturate(__m128 f)
+{
+	const __m128 limit = _mm_set1_ps(2147483648.f);
+
+	return sse2_select(_mm_castps_si128(_mm_cmpge_ps(f, limit)),
+			   _mm_set1_epi32(0x7fffffff),
+			   _mm_cvttps_epi32(f));
+}
+
+/**
+ * Convert floating point samples to 16 bit signed integer using
+ * SSE2.  Like FloatToIntegerSampleConvert, this truncates towards
+ * zero and clips.
+ */
+struct Sse2FloatTo16 {
+	typedef SampleTraits<SampleFormat::S16> DstTraits;
+
+	static constexpr size_t BLOCK_SIZE = 8;
+
+	void Convert(int16_t *dst, const float *src, const size_t n) const {
+		const __m128 factor = _mm_set1_ps(1 << (DstTraits::BITS - 1));
+
+		for (unsigned i = 0; i < n / BLOCK_SIZE;
+		     ++i, src += BLOCK_SIZE, dst += BLOCK_SIZE) {
+			__m128 lo = _mm_mul_ps(_mm_loadu_ps(src), factor);
+			__m128 hi = _mm_mul_ps(_mm_loadu_ps(src + 4), factor);
+
+			/* convert to 16 bit integer with saturation */
+			_mm_storeu_si128((__m128i *)dst,
+					 _mm_packs_epi32(sse2_cvttps_epi32_saturate(lo),
+							 sse2_cvttps_epi32_saturate(hi)));
+		}
+	}
+};
+
+/**
+ * Convert floating point samples to 24 bit (padded to 32 bit) or 32
+ * bit signed integer using SSE2.  Like FloatToIntegerSampleConvert,
+ * this truncates towards zero and clips.
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>>
+struct Sse2FloatTo32 {
+	static constexpr size_t BLOCK_SIZE = 4;
+
+	void Convert(int32_t *dst, const float *src, const size_t n) const {
+		const __m128 factor = _mm_set1_ps(1u << (Traits::BITS - 1));
+		const __m128i min = _mm_set1_epi32(Traits::MIN);
+		const __m128i max = _mm_set1_epi32(Traits::MAX);
+
+		for (unsigned i = 0; i < n / BLOCK_SIZE;
+		     ++i, src += BLOCK_SIZE, dst += BLOCK_SIZE) {
+			__m128 f = _mm_mul_ps(_mm_loadu_ps(src), factor);
+			__m128i x = sse2_cvttps_epi32_saturate(f);
+
+			if (Traits::BITS < 32)
+				x = sse2_clamp_epi32(x, min, max);
+
+			_mm_storeu_si128((__m128i *)dst, x);
+		}
+	}
+};
+
+#endif
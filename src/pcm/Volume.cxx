@@ -27,6 +27,15 @@
 
 #include "PcmDither.cxx" // including the .cxx file to get inlined templates
 
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define PCM_VOLUME_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#define PCM_VOLUME_SSE2
+#include <emmintrin.h>
+#endif
+
+#include <assert.h>
 #include <stdint.h>
 #include <string.h>
 
@@ -92,10 +101,152 @@ static void
 pcm_volume_change_float(float *dest, const float *src, size_t n,
 			float volume)
 {
+#if defined(PCM_VOLUME_NEON)
+	for (; n >= 4; n -= 4, src += 4, dest += 4)
+		vst1q_f32(dest, vmulq_n_f32(vld1q_f32(src), volume));
+#elif defined(PCM_VOLUME_SSE2)
+	const __m128 v = _mm_set1_ps(volume);
+	for (; n >= 4; n -= 4, src += 4, dest += 4)
+		_mm_storeu_ps(dest, _mm_mul_ps(_mm_loadu_ps(src), v));
+#endif
+
 	for (size_t i = 0; i != n; ++i)
 		dest[i] = src[i] * volume;
 }
 
+/**
+ * Check if the volume is a power of two, which can be applied with a
+ * bit shift instead of a multiplication.  Such a shift does not need
+ * dithering: amplification is exact (with clipping), and attenuation
+ * is rounded to the nearest value.
+ *
+ * @param shift_r receives the number of bits to shift left (negative
+ * to shift right)
+ */
+static bool
+pcm_volume_to_shift(unsigned volume, int &shift_r)
+{
+	/* amplification by more than 16x is nonsense, and a bigger
+	   shift would overflow long_type */
+	if (volume == 0 || volume > PCM_VOLUME_1 * 16 ||
+	    (volume & (volume - 1)) != 0)
+		return false;
+
+	int shift = 0;
+	while ((1u << shift) < volume)
+		++shift;
+
+	shift_r = shift - int(PCM_VOLUME_BITS);
+	return true;
+}
+
+/**
+ * The portable implementation of the dither-free power-of-two
+ * volume; it is also used for the remainder which does not fill a
+ * whole SIMD vector.
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>>
+static void
+pcm_volume_shift(typename Traits::pointer_type dest,
+		 typename Traits::const_pointer_type src,
+		 size_t n, int shift)
+{
+	typedef typename Traits::long_type long_type;
+
+	if (shift > 0) {
+		const long_type factor = long_type(1) << shift;
+		for (size_t i = 0; i != n; ++i)
+			dest[i] = PcmClamp<F, Traits>(long_type(src[i]) * factor);
+	} else {
+		assert(shift < 0);
+
+		const unsigned rshift = -shift;
+		const long_type round = long_type(1) << (rshift - 1);
+		for (size_t i = 0; i != n; ++i)
+			dest[i] = (long_type(src[i]) + round) >> rshift;
+	}
+}
+
+static void
+pcm_volume_shift_16(int16_t *dest, const int16_t *src, size_t n, int shift)
+{
+#if defined(PCM_VOLUME_NEON)
+	/* VQRSHL rounds when shifting right and saturates when
+	   shifting left */
+	const int16x8_t s = vdupq_n_s16(shift);
+	for (; n >= 8; n -= 8, src += 8, dest += 8)
+		vst1q_s16(dest, vqrshlq_s16(vld1q_s16(src), s));
+#elif defined(PCM_VOLUME_SSE2)
+	if (shift > 0) {
+		/* saturating doubling */
+		for (; n >= 8; n -= 8, src += 8, dest += 8) {
+			__m128i x = _mm_loadu_si128((const __m128i *)src);
+			for (int i = 0; i < shift; ++i)
+				x = _mm_adds_epi16(x, x);
+			_mm_storeu_si128((__m128i *)dest, x);
+		}
+	} else {
+		/* (x + 2^(r-1)) >> r, calculated without overflow as
+		   (x >> r) + ((x >> (r-1)) & 1) */
+		const __m128i r = _mm_cvtsi32_si128(-shift);
+		const __m128i r1 = _mm_cvtsi32_si128(-shift - 1);
+		const __m128i one = _mm_set1_epi16(1);
+		for (; n >= 8; n -= 8, src += 8, dest += 8) {
+			const __m128i x =
+				_mm_loadu_si128((const __m128i *)src);
+			const __m128i y =
+				_mm_add_epi16(_mm_sra_epi16(x, r),
+					      _mm_and_si128(_mm_sra_epi16(x, r1),
+							    one));
+			_mm_storeu_si128((__m128i *)dest, y);
+		}
+	}
+#endif
+
+	pcm_volume_shift<SampleFormat::S16>(dest, src, n, shift);
+}
+
+template<SampleFormat F, class Traits=SampleTraits<F>>
+static void
+pcm_volume_shift_32(int32_t *dest, const int32_t *src, size_t n, int shift)
+{
+#if defined(PCM_VOLUME_NEON)
+	const int32x4_t s = vdupq_n_s32(shift);
+	if (Traits::BITS < 32 && shift > 0) {
+		/* clip to the (smaller) bit depth */
+		const int32x4_t min = vdupq_n_s32(Traits::MIN);
+		const int32x4_t max = vdupq_n_s32(Traits::MAX);
+		for (; n >= 4; n -= 4, src += 4, dest += 4) {
+			int32x4_t x = vqrshlq_s32(vld1q_s32(src), s);
+			x = vmaxq_s32(vminq_s32(x, max), min);
+			vst1q_s32(dest, x);
+		}
+	} else {
+		for (; n >= 4; n -= 4, src += 4, dest += 4)
+			vst1q_s32(dest, vqrshlq_s32(vld1q_s32(src), s));
+	}
+#elif defined(PCM_VOLUME_SSE2)
+	/* SSE2 has neither saturating 32 bit arithmetic nor 32 bit
+	   min/max, so only attenuation is vectorized */
+	if (shift < 0) {
+		const __m128i r = _mm_cvtsi32_si128(-shift);
+		const __m128i r1 = _mm_cvtsi32_si128(-shift - 1);
+		const __m128i one = _mm_set1_epi32(1);
+		for (; n >= 4; n -= 4, src += 4, dest += 4) {
+			const __m128i x =
+				_mm_loadu_si128((const __m128i *)src);
+			const __m128i y =
+				_mm_add_epi32(_mm_sra_epi32(x, r),
+					      _mm_and_si128(_mm_sra_epi32(x, r1),
+							    one));
+			_mm_storeu_si128((__m128i *)dest, y);
+		}
+	}
+#endif
+
+	pcm_volume_shift<F, Traits>(dest, src, n, shift);
+}
+
 bool
 PcmVolume::Open(SampleFormat _format, Error &error)
 {
@@ -140,6 +291,11 @@ PcmVolume::Apply(ConstBuffer<void> src)
 		return { data, src.size };
 	}
 
+	int shift;
+	if (format != SampleFormat::FLOAT && format != SampleFormat::DSD &&
+	    pcm_volume_to_shift(volume, shift))
+		return ApplyShift(src, data, shift);
+
 	switch (format) {
 	case SampleFormat::UNDEFINED:
 		assert(false);
@@ -187,3 +343,45 @@ PcmVolume::Apply(ConstBuffer<void> src)
 
 	return { data, src.size };
 }
+
+inline ConstBuffer<void>
+PcmVolume::ApplyShift(ConstBuffer<void> src, void *data, int shift)
+{
+	switch (format) {
+	case SampleFormat::UNDEFINED:
+	case SampleFormat::FLOAT:
+	case SampleFormat::DSD:
+		assert(false);
+		gcc_unreachable();
+
+	case SampleFormat::S8:
+		pcm_volume_shift<SampleFormat::S8>((int8_t *)data,
+						   (const int8_t *)src.data,
+						   src.size / sizeof(int8_t),
+						   shift);
+		break;
+
+	case SampleFormat::S16:
+		pcm_volume_shift_16((int16_t *)data,
+				    (const int16_t *)src.data,
+				    src.size / sizeof(int16_t),
+				    shift);
+		break;
+
+	case SampleFormat::S24_P32:
+		pcm_volume_shift_32<SampleFormat::S24_P32>((int32_t *)data,
+							   (const int32_t *)src.data,
+							   src.size / sizeof(int32_t),
+							   shift);
+		break;
+
+	case SampleFormat::S32:
+		pcm_volume_shift_32<SampleFormat::S32>((int32_t *)data,
+						       (const int32_t *)src.data,
+						       src.size / sizeof(int32_t),
+						       shift);
+		break;
+	}
+
+	return { data, src.size };
+}
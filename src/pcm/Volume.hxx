@@ -123,8 +123,16 @@ public:
 	/**
 	 * Apply the volume level.
 	 */
-	gcc_pure
 	ConstBuffer<void> Apply(ConstBuffer<void> src);
+
+private:
+	/**
+	 * The fast path of Apply() for integer samples if the volume
+	 * is a power of two: a (vectorized) bit shift without
+	 * dithering.
+	 */
+	ConstBuffer<void> ApplyShift(ConstBuffer<void> src, void *data,
+				     int shift);
 };
 
 #endif
@@ -44,6 +44,10 @@ or implied, of Sebastian Gesemann.
 #error "FIFOSIZE too small"
 #endif
 
+#if CTABLES != DSD2PCM_CTABLES
+#error "DSD2PCM_CTABLES is wrong"
+#endif
+
 /*
  * Properties of this 96-tap lowpass filter when applied on a signal
  * with sampling rate of 44100*64 Hz:
@@ -137,6 +141,12 @@ static void precalc(void)
 	precalculated = 1;
 }
 
+extern const float *dsd2pcm_get_ctables(void)
+{
+	if (!precalculated) precalc();
+	return &ctables[0][0];
+}
+
 struct dsd2pcm_ctx_s
 {
 	unsigned char fifo[FIFOSIZE];
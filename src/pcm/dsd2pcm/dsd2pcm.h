@@ -40,6 +40,11 @@ extern "C" {
 
 struct dsd2pcm_ctx_s;
 
+/**
+ * the number of "8 MACs" lookup tables
+ */
+#define DSD2PCM_CTABLES 6
+
 typedef struct dsd2pcm_ctx_s dsd2pcm_ctx;
 
 /**
@@ -86,6 +91,15 @@ extern void dsd2pcm_translate(dsd2pcm_ctx *ctx,
 	int lsbitfirst,
 	float *dst, ptrdiff_t dst_stride);
 
+/**
+ * returns the precomputed lookup tables (DSD2PCM_CTABLES arrays of
+ * 256 floats); table i is applied to the octet which is i positions
+ * old and (bit-reversed) to the one which is 2*DSD2PCM_CTABLES-1-i
+ * positions old
+ * (same thread-safety as dsd2pcm_init())
+ */
+extern const float *dsd2pcm_get_ctables(void);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_EXPAT_SONG_ENUMERATOR_HXX
+#define MPD_EXPAT_SONG_ENUMERATOR_HXX
+
+#include "SongEnumerator.hxx"
+#include "DetachedSong.hxx"
+#include "lib/expat/ExpatParser.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+class InputStream;
+
+/**
+ * A #SongEnumerator which parses an XML playlist incrementally:
+ * each song is returned as soon as it has been parsed, without
+ * waiting for the rest of the stream.
+ *
+ * @param P the parser state, which is passed to the expat callbacks
+ * as "user_data"; it must have an attribute "songs" (a
+ * std::list<DetachedSong>) where the callbacks append parsed songs
+ */
+template<typename P>
+class ExpatSongEnumerator final : public SongEnumerator {
+	InputStream &is;
+
+	P state;
+
+	ExpatParser expat;
+
+	/**
+	 * Has the whole stream been parsed (or has an error
+	 * occurred)?
+	 */
+	bool finished;
+
+public:
+	ExpatSongEnumerator(InputStream &_is,
+			    XML_StartElementHandler start,
+			    XML_EndElementHandler end,
+			    XML_CharacterDataHandler char_data)
+		:is(_is), expat(&state), finished(false) {
+		expat.SetElementHandler(start, end);
+		expat.SetCharacterDataHandler(char_data);
+	}
+
+	/**
+	 * Parse until the first song is available.
+	 *
+	 * @return false if the stream is not a valid XML document
+	 * (before the first song), so another plugin may try it
+	 */
+	bool Prime() {
+		return Fill();
+	}
+
+	virtual DetachedSong *NextSong() override {
+		Fill();
+
+		if (state.songs.empty())
+			return nullptr;
+
+		DetachedSong *song =
+			new DetachedSong(std::move(state.songs.front()));
+		state.songs.pop_front();
+		return song;
+	}
+
+private:
+	/**
+	 * Parse more data until there is at least one song.
+	 *
+	 * @return false on error
+	 */
+	bool Fill() {
+		Error error;
+		while (state.songs.empty() && !finished) {
+			if (expat.ParseSome(is, error) == 0) {
+				finished = true;
+
+				if (error.IsDefined()) {
+					LogError(error);
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+};
+
+#endif
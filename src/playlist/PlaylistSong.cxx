@@ -31,9 +31,14 @@
 #include <string.h>
 
 static void
-merge_song_metadata(DetachedSong &add, const DetachedSong &base)
+merge_song_metadata(DetachedSong &add, DetachedSong &&base)
 {
-	if (base.GetTag().IsDefined()) {
+	if (!add.GetTag().IsDefined())
+		/* the playlist has no metadata for this song (the
+		   usual case); take over the database tag, which
+		   shares its storage instead of building a copy */
+		add.MoveTagFrom(std::move(base));
+	else if (base.GetTag().IsDefined()) {
 		TagBuilder builder(add.GetTag());
 		builder.Complement(base.GetTag());
 		add.SetTag(builder.Commit());
@@ -53,7 +58,7 @@ playlist_check_load_song(DetachedSong &song, const SongLoader &loader)
 	if (!song.HasRealURI() && tmp->HasRealURI())
 		song.SetRealURI(tmp->GetRealURI());
 
-	merge_song_metadata(song, *tmp);
+	merge_song_metadata(song, std::move(*tmp));
 	delete tmp;
 	return true;
 }
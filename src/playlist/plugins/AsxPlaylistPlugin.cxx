@@ -20,22 +20,24 @@
 #include "config.h"
 #include "AsxPlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
-#include "../MemorySongEnumerator.hxx"
+#include "../ExpatSongEnumerator.hxx"
 #include "tag/TagBuilder.hxx"
 #include "util/ASCII.hxx"
 #include "util/Error.hxx"
 #include "lib/expat/ExpatParser.hxx"
 #include "Log.hxx"
 
+#include <list>
+
 /**
  * This is the state object for the GLib XML parser.
  */
 struct AsxParser {
 	/**
-	 * The list of songs (in reverse order because that's faster
-	 * while adding).
+	 * The songs which have been parsed, but not yet been
+	 * returned by the #ExpatSongEnumerator.
 	 */
-	std::forward_list<DetachedSong> songs;
+	std::list<DetachedSong> songs;
 
 	/**
 	 * The current position in the XML file.
@@ -108,8 +110,8 @@ asx_end_element(void *user_data, const XML_Char *element_name)
 	case AsxParser::ENTRY:
 		if (StringEqualsCaseASCII(element_name, "entry")) {
 			if (!parser->location.empty())
-				parser->songs.emplace_front(std::move(parser->location),
-							    parser->tag_builder.Commit());
+				parser->songs.emplace_back(std::move(parser->location),
+							   parser->tag_builder.Commit());
 
 			parser->state = AsxParser::ROOT;
 		} else
@@ -144,22 +146,15 @@ asx_char_data(void *user_data, const XML_Char *s, int len)
 static SongEnumerator *
 asx_open_stream(InputStream &is)
 {
-	AsxParser parser;
-
-	{
-		ExpatParser expat(&parser);
-		expat.SetElementHandler(asx_start_element, asx_end_element);
-		expat.SetCharacterDataHandler(asx_char_data);
-
-		Error error;
-		if (!expat.Parse(is, error)) {
-			LogError(error);
-			return nullptr;
-		}
+	auto *e = new ExpatSongEnumerator<AsxParser>(is, asx_start_element,
+						asx_end_element,
+						asx_char_data);
+	if (!e->Prime()) {
+		delete e;
+		return nullptr;
 	}
 
-	parser.songs.reverse();
-	return new MemorySongEnumerator(std::move(parser.songs));
+	return e;
 }
 
 static const char *const asx_suffixes[] = {
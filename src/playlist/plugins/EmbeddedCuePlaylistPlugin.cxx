@@ -31,11 +31,13 @@
 #include "tag/TagHandler.hxx"
 #include "tag/TagId3.hxx"
 #include "tag/ApeTag.hxx"
+#include "tag/TagFileReader.hxx"
 #include "DetachedSong.hxx"
 #include "TagFile.hxx"
 #include "fs/Traits.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "util/ASCII.hxx"
+#include "util/Error.hxx"
 
 #include <string.h>
 
@@ -86,6 +88,7 @@ static const struct tag_handler embcue_tag_handler = {
 	nullptr,
 	nullptr,
 	embcue_tag_pair,
+	nullptr,
 };
 
 static SongEnumerator *
@@ -105,9 +108,13 @@ embcue_playlist_open_uri(const char *uri,
 
 	tag_file_scan(path_fs, embcue_tag_handler, playlist);
 	if (playlist->cuesheet.empty()) {
-		tag_ape_scan2(path_fs, &embcue_tag_handler, playlist);
-		if (playlist->cuesheet.empty())
-			tag_id3_scan(path_fs, &embcue_tag_handler, playlist);
+		TagFileReader reader;
+		if (reader.Open(path_fs, IgnoreError())) {
+			tag_ape_scan2(reader, &embcue_tag_handler, playlist);
+			if (playlist->cuesheet.empty())
+				tag_id3_scan(reader, &embcue_tag_handler,
+					     playlist);
+		}
 	}
 
 	if (playlist->cuesheet.empty()) {
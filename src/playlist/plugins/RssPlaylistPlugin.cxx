@@ -20,22 +20,24 @@
 #include "config.h"
 #include "RssPlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
-#include "../MemorySongEnumerator.hxx"
+#include "../ExpatSongEnumerator.hxx"
 #include "tag/TagBuilder.hxx"
 #include "util/ASCII.hxx"
 #include "util/Error.hxx"
 #include "lib/expat/ExpatParser.hxx"
 #include "Log.hxx"
 
+#include <list>
+
 /**
  * This is the state object for the GLib XML parser.
  */
 struct RssParser {
 	/**
-	 * The list of songs (in reverse order because that's faster
-	 * while adding).
+	 * The songs which have been parsed, but not yet been
+	 * returned by the #ExpatSongEnumerator.
 	 */
-	std::forward_list<DetachedSong> songs;
+	std::list<DetachedSong> songs;
 
 	/**
 	 * The current position in the XML file.
@@ -106,8 +108,8 @@ rss_end_element(void *user_data, const XML_Char *element_name)
 	case RssParser::ITEM:
 		if (StringEqualsCaseASCII(element_name, "item")) {
 			if (!parser->location.empty())
-				parser->songs.emplace_front(std::move(parser->location),
-							    parser->tag_builder.Commit());
+				parser->songs.emplace_back(std::move(parser->location),
+							   parser->tag_builder.Commit());
 
 			parser->state = RssParser::ROOT;
 		} else
@@ -142,22 +144,15 @@ rss_char_data(void *user_data, const XML_Char *s, int len)
 static SongEnumerator *
 rss_open_stream(InputStream &is)
 {
-	RssParser parser;
-
-	{
-		ExpatParser expat(&parser);
-		expat.SetElementHandler(rss_start_element, rss_end_element);
-		expat.SetCharacterDataHandler(rss_char_data);
-
-		Error error;
-		if (!expat.Parse(is, error)) {
-			LogError(error);
-			return nullptr;
-		}
+	auto *e = new ExpatSongEnumerator<RssParser>(is, rss_start_element,
+						rss_end_element,
+						rss_char_data);
+	if (!e->Prime()) {
+		delete e;
+		return nullptr;
 	}
 
-	parser.songs.reverse();
-	return new MemorySongEnumerator(std::move(parser.songs));
+	return e;
 }
 
 static const char *const rss_suffixes[] = {
@@ -20,7 +20,7 @@
 #include "config.h"
 #include "XspfPlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
-#include "../MemorySongEnumerator.hxx"
+#include "../ExpatSongEnumerator.hxx"
 #include "DetachedSong.hxx"
 #include "input/InputStream.hxx"
 #include "tag/TagBuilder.hxx"
@@ -29,6 +29,8 @@
 #include "lib/expat/ExpatParser.hxx"
 #include "Log.hxx"
 
+#include <list>
+
 #include <string.h>
 
 static constexpr Domain xspf_domain("xspf");
@@ -38,10 +40,10 @@ static constexpr Domain xspf_domain("xspf");
  */
 struct XspfParser {
 	/**
-	 * The list of songs (in reverse order because that's faster
-	 * while adding).
+	 * The songs which have been parsed, but not yet been
+	 * returned by the #ExpatSongEnumerator.
 	 */
-	std::forward_list<DetachedSong> songs;
+	std::list<DetachedSong> songs;
 
 	/**
 	 * The current position in the XML file.
@@ -144,8 +146,8 @@ xspf_end_element(void *user_data, const XML_Char *element_name)
 	case XspfParser::TRACK:
 		if (strcmp(element_name, "track") == 0) {
 			if (!parser->location.empty())
-				parser->songs.emplace_front(std::move(parser->location),
-							    parser->tag_builder.Commit());
+				parser->songs.emplace_back(std::move(parser->location),
+							   parser->tag_builder.Commit());
 
 			parser->state = XspfParser::TRACKLIST;
 		} else
@@ -192,22 +194,15 @@ xspf_char_data(void *user_data, const XML_Char *s, int len)
 static SongEnumerator *
 xspf_open_stream(InputStream &is)
 {
-	XspfParser parser;
-
-	{
-		ExpatParser expat(&parser);
-		expat.SetElementHandler(xspf_start_element, xspf_end_element);
-		expat.SetCharacterDataHandler(xspf_char_data);
-
-		Error error;
-		if (!expat.Parse(is, error)) {
-			LogError(error);
-			return nullptr;
-		}
+	auto *e = new ExpatSongEnumerator<XspfParser>(is, xspf_start_element,
+						xspf_end_element,
+						xspf_char_data);
+	if (!e->Prime()) {
+		delete e;
+		return nullptr;
 	}
 
-	parser.songs.reverse();
-	return new MemorySongEnumerator(std::move(parser.songs));
+	return e;
 }
 
 static const char *const xspf_suffixes[] = {
@@ -28,8 +28,10 @@
 
 class Client;
 
-extern const char *current_command;
-extern int command_list_num;
+/* thread-local, because commands may be executed in client
+   worker threads */
+extern __thread const char *current_command;
+extern __thread int command_list_num;
 
 void
 command_success(Client &client);
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "IdTable.hxx"
+
+void
+IdTable::Resize(unsigned new_capacity)
+{
+	assert(new_capacity >= MIN_CAPACITY);
+	assert(count < new_capacity / 2);
+
+	Slot *const old_slots = slots;
+	const unsigned old_capacity = capacity;
+
+	slots = new Slot[new_capacity];
+	capacity = new_capacity;
+	for (unsigned i = 0; i < capacity; ++i)
+		slots[i].id = 0;
+
+	for (unsigned i = 0; i < old_capacity; ++i) {
+		const Slot &old = old_slots[i];
+		if (old.id == 0)
+			continue;
+
+		unsigned j = HomeSlot(old.id);
+		while (slots[j].id != 0)
+			j = (j + 1) & (capacity - 1);
+
+		slots[j] = old;
+	}
+
+	delete[] old_slots;
+}
+
+unsigned
+IdTable::Insert(unsigned position)
+{
+	/* keep the load factor below 1/2 */
+	if ((count + 1) * 2 > capacity)
+		Resize(capacity > 0 ? capacity * 2 : MIN_CAPACITY);
+
+	const unsigned id = GenerateId();
+
+	unsigned i = HomeSlot(id);
+	while (slots[i].id != 0)
+		i = (i + 1) & (capacity - 1);
+
+	slots[i].id = id;
+	slots[i].position = position;
+	++count;
+	return id;
+}
+
+void
+IdTable::Erase(unsigned id)
+{
+	Slot *slot = Find(id);
+	assert(slot != nullptr);
+
+	/* backward shift deletion: move following entries of the
+	   probe sequence into the gap, so lookups never need
+	   tombstones */
+
+	const unsigned mask = capacity - 1;
+	unsigned i = slot - slots;
+	for (unsigned j = (i + 1) & mask; slots[j].id != 0;
+	     j = (j + 1) & mask) {
+		const unsigned home = HomeSlot(slots[j].id);
+
+		/* may the entry at "j" move to "i"?  Only if its home
+		   slot is not within (i, j] (cyclically) */
+		const bool in_range = i <= j
+			? home > i && home <= j
+			: home > i || home <= j;
+		if (!in_range) {
+			slots[i] = slots[j];
+			i = j;
+		}
+	}
+
+	slots[i].id = 0;
+	--count;
+
+	/* shrink when the table is mostly empty; the hysteresis
+	   to the growth threshold avoids resizing back and forth */
+	if (capacity > MIN_CAPACITY && count * 8 < capacity)
+		Resize(capacity / 2);
+}
@@ -22,38 +22,69 @@
 
 #include "Compiler.h"
 
-#include <algorithm>
-
 #include <assert.h>
 
 /**
  * A table that maps id numbers to position numbers.
+ *
+ * It is a hash table with open addressing (linear probing) which
+ * grows and shrinks with the number of ids in use, so its size
+ * follows the queue length, not the configured maximum.
  */
 class IdTable {
+	struct Slot {
+		/** the id; 0 means this slot is empty */
+		unsigned id;
+
+		int position;
+	};
+
+	static constexpr unsigned MIN_CAPACITY = 16;
+
+	/**
+	 * The id space is [1, size).
+	 */
 	unsigned size;
 
 	unsigned next;
 
-	int *data;
+	/**
+	 * The number of ids in use.
+	 */
+	unsigned count;
+
+	/**
+	 * The number of slots; a power of two, or zero if nothing
+	 * has been allocated yet.
+	 */
+	unsigned capacity;
+
+	Slot *slots;
 
 public:
-	IdTable(unsigned _size):size(_size), next(1), data(new int[size]) {
-		std::fill_n(data, size, -1);
-	}
+	IdTable(unsigned _size)
+		:size(_size), next(1), count(0),
+		 capacity(0), slots(nullptr) {}
 
 	~IdTable() {
-		delete[] data;
+		delete[] slots;
 	}
 
+	IdTable(const IdTable &) = delete;
+	IdTable &operator=(const IdTable &) = delete;
+
+	gcc_pure
 	int IdToPosition(unsigned id) const {
-		return id < size
-			? data[id]
+		const Slot *slot = Find(id);
+		return slot != nullptr
+			? slot->position
 			: -1;
 	}
 
 	unsigned GenerateId() {
 		assert(next > 0);
 		assert(next < size);
+		assert(count < size - 1);
 
 		while (true) {
 			unsigned id = next;
@@ -62,30 +93,63 @@ public:
 			if (next == size)
 				next = 1;
 
-			if (data[id] < 0)
+			if (Find(id) == nullptr)
 				return id;
 		}
 	}
 
-	unsigned Insert(unsigned position) {
-		unsigned id = GenerateId();
-		data[id] = position;
-		return id;
-	}
+	unsigned Insert(unsigned position);
 
 	void Move(unsigned id, unsigned position) {
-		assert(id < size);
-		assert(data[id] >= 0);
+		Slot *slot = Find(id);
+		assert(slot != nullptr);
 
-		data[id] = position;
+		slot->position = position;
 	}
 
-	void Erase(unsigned id) {
-		assert(id < size);
-		assert(data[id] >= 0);
+	void Erase(unsigned id);
 
-		data[id] = -1;
+	/**
+	 * Free the table if it is empty.
+	 */
+	void Compact() {
+		if (count == 0) {
+			delete[] slots;
+			slots = nullptr;
+			capacity = 0;
+		}
 	}
+
+private:
+	gcc_const
+	static unsigned Hash(unsigned id) {
+		/* ids are mostly sequential; multiplying with an odd
+		   constant scatters them, so they don't form long
+		   clusters */
+		return id * 2654435769u;
+	}
+
+	gcc_pure
+	unsigned HomeSlot(unsigned id) const {
+		return Hash(id) & (capacity - 1);
+	}
+
+	gcc_pure
+	Slot *Find(unsigned id) const {
+		if (capacity == 0)
+			return nullptr;
+
+		for (unsigned i = HomeSlot(id);; i = (i + 1) & (capacity - 1)) {
+			Slot &slot = slots[i];
+			if (slot.id == 0)
+				return nullptr;
+
+			if (slot.id == id)
+				return &slot;
+		}
+	}
+
+	void Resize(unsigned new_capacity);
 };
 
 #endif
@@ -144,6 +144,10 @@ protected:
 	void UpdateQueuedSong(PlayerControl &pc, const DetachedSong *prev);
 
 public:
+	bool IsBulkEdit() const {
+		return bulk_edit;
+	}
+
 	void BeginBulk();
 	void CommitBulk(PlayerControl &pc);
 
@@ -75,18 +75,19 @@ playlist::CommitBulk(PlayerControl &pc)
 	assert(bulk_edit);
 
 	bulk_edit = false;
-	if (!bulk_modified)
-		return;
 
 	if (queued < 0)
 		/* if no song was queued, UpdateQueuedSong() is being
 		   ignored in "bulk" edit mode; now that we have
 		   shuffled all new songs, we can pick a random one
 		   (instead of always picking the first one that was
-		   added) */
+		   added); this is also necessary if playback was
+		   started during the bulk edit, e.g. by "play" in a
+		   command list */
 		UpdateQueuedSong(pc, nullptr);
 
-	OnModified();
+	if (bulk_modified)
+		OnModified();
 }
 
 unsigned
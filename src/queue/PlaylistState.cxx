@@ -96,11 +96,31 @@ playlist_state_save(BufferedOutputStream &os, const struct playlist &playlist,
 	os.Format(PLAYLIST_STATE_FILE_MIXRAMPDB "%f\n", pc.GetMixRampDb());
 	os.Format(PLAYLIST_STATE_FILE_MIXRAMPDELAY "%f\n",
 		  pc.GetMixRampDelay());
-	os.Write(PLAYLIST_STATE_FILE_PLAYLIST_BEGIN "\n");
+}
+
+void
+playlist_state_save_queue(BufferedOutputStream &os,
+			  const struct playlist &playlist)
+{
 	queue_save(os, playlist.queue);
-	os.Write(PLAYLIST_STATE_FILE_PLAYLIST_END "\n");
 }
 
+void
+playlist_state_load_queue(TextFile &file, const SongLoader &song_loader,
+			  struct playlist &playlist)
+{
+	const char *line;
+	while ((line = file.ReadLine()) != nullptr)
+		queue_load_song(file, song_loader, line, playlist.queue);
+
+	playlist.queue.IncrementVersion();
+}
+
+/**
+ * Load the queue embedded in the state file; this is the format
+ * written by older MPD versions, before the queue was moved to a
+ * separate file.
+ */
 static void
 playlist_state_load(TextFile &file, const SongLoader &song_loader,
 		    struct playlist &playlist)
@@ -111,8 +131,14 @@ playlist_state_load(TextFile &file, const SongLoader &song_loader,
 		return;
 	}
 
+	/* if the queue file has been loaded already, it is the
+	   authoritative copy; skip the embedded one */
+	const bool skip = !playlist.queue.IsEmpty();
+
 	while (!StringStartsWith(line, PLAYLIST_STATE_FILE_PLAYLIST_END)) {
-		queue_load_song(file, song_loader, line, playlist.queue);
+		if (!skip)
+			queue_load_song(file, song_loader, line,
+					playlist.queue);
 
 		line = file.ReadLine();
 		if (line == nullptr) {
@@ -227,8 +253,7 @@ playlist_state_get_hash(const playlist &playlist,
 {
 	const auto player_status = pc.GetStatus();
 
-	return playlist.queue.version ^
-		(player_status.state != PlayerState::STOP
+	return (player_status.state != PlayerState::STOP
 		 ? ((int)player_status.elapsed_time << 8)
 		 : 0) ^
 		(playlist.current >= 0
@@ -31,10 +31,31 @@ class TextFile;
 class BufferedOutputStream;
 class SongLoader;
 
+/**
+ * Save the playback state and options, but not the queue.
+ */
 void
 playlist_state_save(BufferedOutputStream &os, const playlist &playlist,
 		    PlayerControl &pc);
 
+/**
+ * Save the queue (in the format understood by
+ * playlist_state_load_queue()).  It is kept in a separate file, so
+ * a large queue is only rewritten when it was modified.
+ */
+void
+playlist_state_save_queue(BufferedOutputStream &os,
+			  const playlist &playlist);
+
+/**
+ * Load the queue saved by playlist_state_save_queue().  This must
+ * be called before playlist_state_restore(), because the latter
+ * needs the queue to restore the current song.
+ */
+void
+playlist_state_load_queue(TextFile &file, const SongLoader &song_loader,
+			  playlist &playlist);
+
 bool
 playlist_state_restore(const char *line, TextFile &file,
 		       const SongLoader &song_loader,
@@ -44,7 +65,8 @@ playlist_state_restore(const char *line, TextFile &file,
  * Generates a hash number for the current state of the playlist and
  * the playback options.  This is used by timer_save_state_file() to
  * determine whether the state has changed and the state file should
- * be saved.
+ * be saved.  It does not cover the contents of the queue; compare
+ * Queue::version for that.
  */
 unsigned
 playlist_state_get_hash(const playlist &playlist,
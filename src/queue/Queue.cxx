@@ -20,12 +20,25 @@
 #include "config.h"
 #include "Queue.hxx"
 #include "DetachedSong.hxx"
+#include "util/MemoryStats.hxx"
+
+#include <vector>
+
+/**
+ * The size of the #Queue arrays for the given capacity, for
+ * #MemoryStats.
+ */
+static constexpr size_t
+QueueArraysSize(unsigned capacity)
+{
+	return capacity * (sizeof(Queue::Item) + 2 * sizeof(unsigned));
+}
 
 Queue::Queue(unsigned _max_length)
-	:max_length(_max_length), length(0),
+	:max_length(_max_length), length(0), capacity(0),
 	 version(1),
-	 items(new Item[max_length]),
-	 order(new unsigned[max_length]),
+	 items(nullptr),
+	 order(nullptr), position_order(nullptr),
 	 id_table(max_length * HASH_MULT),
 	 repeat(false),
 	 single(false),
@@ -37,9 +50,6 @@ Queue::Queue(unsigned _max_length)
 Queue::~Queue()
 {
 	Clear();
-
-	delete[] items;
-	delete[] order;
 }
 
 int
@@ -71,6 +81,11 @@ Queue::IncrementVersion()
 			items[i].version = 0;
 
 		version = 1;
+
+		/* all songs are "new" now; the log cannot express
+		   that, so plchanges must scan the whole queue until
+		   it is cleared */
+		changes.Invalidate();
 	}
 }
 
@@ -83,21 +98,57 @@ Queue::ModifyAtOrder(unsigned _order)
 	ModifyAtPosition(position);
 }
 
+void
+Queue::Grow(unsigned min_capacity)
+{
+	assert(min_capacity > capacity);
+	assert(min_capacity <= max_length);
+
+	unsigned new_capacity = std::max(capacity * 2, MIN_CAPACITY);
+	new_capacity = std::max(new_capacity, min_capacity);
+	new_capacity = std::min(new_capacity, max_length);
+
+	Item *new_items = new Item[new_capacity];
+	std::copy_n(items, length, new_items);
+	delete[] items;
+	items = new_items;
+
+	unsigned *new_order = new unsigned[new_capacity];
+	std::copy_n(order, length, new_order);
+	delete[] order;
+	order = new_order;
+
+	unsigned *new_position_order = new unsigned[new_capacity];
+	std::copy_n(position_order, length, new_position_order);
+	delete[] position_order;
+	position_order = new_position_order;
+
+	MemoryStatsResize(MemoryCategory::QUEUE,
+			  QueueArraysSize(capacity),
+			  QueueArraysSize(new_capacity));
+	capacity = new_capacity;
+}
+
 unsigned
 Queue::Append(DetachedSong &&song, uint8_t priority)
 {
 	assert(!IsFull());
 
+	if (length == capacity)
+		Grow(length + 1);
+
 	const unsigned position = length++;
 	const unsigned id = id_table.Insert(position);
 
 	auto &item = items[position];
 	item.song = new DetachedSong(std::move(song));
+	MemoryStatsAdd(MemoryCategory::QUEUE, sizeof(DetachedSong));
 	item.id = id;
-	item.version = version;
 	item.priority = priority;
+	Stamp(position);
 
 	order[position] = position;
+	position_order[position] = position;
 
 	return id;
 }
@@ -110,8 +161,8 @@ Queue::SwapPositions(unsigned position1, unsigned position2)
 
 	std::swap(items[position1], items[position2]);
 
-	items[position1].version = version;
-	items[position2].version = version;
+	Stamp(position1);
+	Stamp(position2);
 
 	id_table.Move(id1, position2);
 	id_table.Move(id2, position1);
@@ -136,7 +187,7 @@ Queue::MovePostion(unsigned from, unsigned to)
 
 	id_table.Move(tmp.id, to);
 	items[to] = tmp;
-	items[to].version = version;
+	Stamp(to);
 
 	/* now deal with order */
 
@@ -150,6 +201,8 @@ Queue::MovePostion(unsigned from, unsigned to)
 			else if (from == order[i])
 				order[i] = to;
 		}
+
+		UpdatePositionOrder(0, length);
 	}
 }
 
@@ -176,7 +229,7 @@ Queue::MoveRange(unsigned start, unsigned end, unsigned to)
 	{
 		id_table.Move(tmp[i - start].id, to + i - start);
 		items[to + i - start] = tmp[i-start];
-		items[to + i - start].version = version;
+		Stamp(to + i - start);
 	}
 
 	if (random) {
@@ -192,6 +245,8 @@ Queue::MoveRange(unsigned start, unsigned end, unsigned to)
 			else if (start <= order[i] && order[i] < end)
 				order[i] += to - start;
 		}
+
+		UpdatePositionOrder(0, length);
 	}
 }
 
@@ -212,6 +267,9 @@ Queue::MoveOrder(unsigned from_order, unsigned to_order)
 	}
 
 	order[to_order] = from_position;
+
+	UpdatePositionOrder(std::min(from_order, to_order),
+			    std::max(from_order, to_order) + 1);
 }
 
 void
@@ -220,6 +278,7 @@ Queue::DeletePosition(unsigned position)
 	assert(position < length);
 
 	delete items[position].song;
+	MemoryStatsSub(MemoryCategory::QUEUE, sizeof(DetachedSong));
 
 	const unsigned id = PositionToId(position);
 	const unsigned _order = PositionToOrder(position);
@@ -245,6 +304,8 @@ Queue::DeletePosition(unsigned position)
 	for (unsigned i = 0; i < length; i++)
 		if (order[i] > position)
 			--order[i];
+
+	UpdatePositionOrder(0, length);
 }
 
 void
@@ -254,11 +315,28 @@ Queue::Clear()
 		Item *item = &items[i];
 
 		delete item->song;
+		MemoryStatsSub(MemoryCategory::QUEUE, sizeof(DetachedSong));
 
 		id_table.Erase(item->id);
 	}
 
 	length = 0;
+
+	/* no song is left which was modified before, so the log
+	   starts over */
+	changes.Reset();
+
+	/* release the memory; the next Append() starts small
+	   again */
+	delete[] items;
+	items = nullptr;
+	delete[] order;
+	order = nullptr;
+	delete[] position_order;
+	position_order = nullptr;
+	MemoryStatsResize(MemoryCategory::QUEUE, QueueArraysSize(capacity), 0);
+	capacity = 0;
+	id_table.Compact();
 }
 
 static void
@@ -269,14 +347,22 @@ queue_sort_order_by_priority(Queue *queue, unsigned start, unsigned end)
 	assert(start <= end);
 	assert(end <= queue->length);
 
-	auto cmp = [queue](unsigned a_pos, unsigned b_pos){
-		const Queue::Item &a = queue->items[a_pos];
-		const Queue::Item &b = queue->items[b_pos];
+	/* there are only 256 possible priorities, so a counting sort
+	   does this in linear time */
+
+	unsigned offsets[256 + 1] = { 0 };
+	for (unsigned i = start; i < end; ++i)
+		++offsets[255 - queue->GetOrderPriority(i) + 1];
+
+	for (unsigned i = 1; i <= 256; ++i)
+		offsets[i] += offsets[i - 1];
 
-		return a.priority > b.priority;
-	};
+	std::vector<unsigned> sorted(end - start);
+	for (unsigned i = start; i < end; ++i)
+		sorted[offsets[255 - queue->GetOrderPriority(i)]++] =
+			queue->order[i];
 
-	std::stable_sort(queue->order + start, queue->order + end, cmp);
+	std::copy(sorted.begin(), sorted.end(), queue->order + start);
 }
 
 void
@@ -288,6 +374,7 @@ Queue::ShuffleOrderRange(unsigned start, unsigned end)
 
 	rand.AutoCreate();
 	std::shuffle(order + start, order + end, rand);
+	UpdatePositionOrder(start, end);
 }
 
 /**
@@ -324,7 +411,9 @@ Queue::ShuffleOrderRangeWithPriority(unsigned start, unsigned end)
 		}
 	}
 
-	/* shuffle the last group */
+	/* shuffle the last group; the groups cover the whole range,
+	   so ShuffleOrderRange() has updated all of
+	   #position_order */
 	ShuffleOrderRange(group_start, end);
 }
 
@@ -411,8 +500,8 @@ Queue::SetPriority(unsigned position, uint8_t priority, int after_order)
 	if (old_priority == priority)
 		return false;
 
-	item->version = version;
 	item->priority = priority;
+	Stamp(position);
 
 	if (!random)
 		/* don't reorder if not in random mode */
@@ -466,6 +555,10 @@ Queue::SetPriorityRange(unsigned start_position, unsigned end_position,
 	assert(start_position <= end_position);
 	assert(end_position <= length);
 
+	if (random && end_position - start_position > 1)
+		return SetPriorityRangeRandom(start_position, end_position,
+					      priority, after_order);
+
 	bool modified = false;
 	int after_position = after_order >= 0
 		? (int)OrderToPosition(after_order)
@@ -480,3 +573,117 @@ Queue::SetPriorityRange(unsigned start_position, unsigned end_position,
 
 	return modified;
 }
+
+bool
+Queue::SetPriorityRangeRandom(unsigned start_position, unsigned end_position,
+			      uint8_t priority, int after_order)
+{
+	assert(random);
+	assert(start_position <= end_position);
+	assert(end_position <= length);
+	assert(after_order < (int)length);
+
+	/* apply the same rules as SetPriority(), but collect the
+	   songs to be moved instead of moving them one by one, which
+	   would be O(n) per song */
+
+	const int after_position = after_order >= 0
+		? (int)OrderToPosition(after_order)
+		: -1;
+
+	std::vector<bool> move(length, false);
+	unsigned n_move = 0, n_played = 0;
+	bool modified = false;
+
+	for (unsigned i = start_position; i < end_position; ++i) {
+		Item &item = items[i];
+		const uint8_t old_priority = item.priority;
+		if (old_priority == priority)
+			continue;
+
+		item.priority = priority;
+		Stamp(i);
+		modified = true;
+
+		const unsigned _order = PositionToOrder(i);
+		if (after_order >= 0) {
+			if (_order == (unsigned)after_order)
+				/* don't reorder the current song */
+				continue;
+
+			if (_order < (unsigned)after_order) {
+				/* the song has been played already -
+				   enqueue it only if its priority has
+				   just become bigger than the current
+				   one's */
+				const uint8_t after_priority =
+					items[after_position].priority;
+				if (old_priority > after_priority ||
+				    priority <= after_priority)
+					continue;
+
+				++n_played;
+			}
+		}
+
+		move[i] = true;
+		++n_move;
+	}
+
+	if (n_move == 0)
+		return modified;
+
+	/* rebuild the order list: the played songs which stay where
+	   they are, the current song, then the upcoming songs with
+	   the moved ones inserted at the beginning of their priority
+	   group */
+
+	std::vector<unsigned> new_order;
+	new_order.reserve(length);
+
+	const unsigned tail_start = after_order + 1;
+	for (unsigned i = 0; i < tail_start; ++i)
+		if (!move[order[i]])
+			new_order.push_back(order[i]);
+
+	assert(new_order.size() == tail_start - n_played);
+
+	bool inserted = false;
+	unsigned group_start = 0;
+	for (unsigned i = tail_start; i < length; ++i) {
+		const unsigned position = order[i];
+		if (move[position])
+			continue;
+
+		if (!inserted && items[position].priority <= priority) {
+			group_start = new_order.size();
+			for (unsigned j = start_position; j < end_position; ++j)
+				if (move[j])
+					new_order.push_back(j);
+			inserted = true;
+		}
+
+		new_order.push_back(position);
+	}
+
+	if (!inserted) {
+		group_start = new_order.size();
+		for (unsigned j = start_position; j < end_position; ++j)
+			if (move[j])
+				new_order.push_back(j);
+	}
+
+	assert(new_order.size() == length);
+
+	std::copy(new_order.begin(), new_order.end(), order);
+	UpdatePositionOrder(0, length);
+
+	/* shuffle the moved songs within their priority group */
+
+	const unsigned priority_count =
+		CountSamePriority(group_start, priority);
+	assert(priority_count >= n_move);
+	ShuffleOrderRange(group_start, group_start + priority_count);
+
+	return modified;
+}
@@ -22,6 +22,7 @@
 
 #include "Compiler.h"
 #include "IdTable.hxx"
+#include "QueueChangeLog.hxx"
 #include "util/LazyRandomEngine.hxx"
 
 #include <algorithm>
@@ -48,6 +49,11 @@ struct Queue {
 	 */
 	static constexpr unsigned HASH_MULT = 4;
 
+	/**
+	 * The initial number of items allocated by Append().
+	 */
+	static constexpr unsigned MIN_CAPACITY = 64;
+
 	/**
 	 * One element of the queue: basically a song plus some queue specific
 	 * information attached.
@@ -75,6 +81,10 @@ struct Queue {
 	/** number of songs in the queue */
 	unsigned length;
 
+	/** the allocated size of #items and #order; they are
+	    enlarged on demand, up to #max_length */
+	unsigned capacity;
+
 	/** the current version number */
 	uint32_t version;
 
@@ -84,9 +94,16 @@ struct Queue {
 	/** map order numbers to positions */
 	unsigned *order;
 
+	/** map positions to order numbers (the inverse of
+	    #order) */
+	unsigned *position_order;
+
 	/** map song ids to positions */
 	IdTable id_table;
 
+	/** which positions were modified in which version? */
+	QueueChangeLog changes;
+
 	/** repeat playback when the end of the queue has been
 	    reached? */
 	bool repeat;
@@ -172,12 +189,9 @@ struct Queue {
 	unsigned PositionToOrder(unsigned position) const {
 		assert(position < length);
 
-		for (unsigned i = 0;; ++i) {
-			assert(i < length);
+		assert(order[position_order[position]] == position);
 
-			if (order[i] == position)
-				return i;
-		}
+		return position_order[position];
 	}
 
 	gcc_pure
@@ -225,6 +239,39 @@ struct Queue {
 			items[position].version == 0;
 	}
 
+	/**
+	 * Invoke a function for each position which is newer than
+	 * the specified version (see IsNewerAtPosition()), in
+	 * ascending order.  This consults the #changes log, and
+	 * scans the whole queue only if the log is not complete.
+	 */
+	template<typename F>
+	void VisitChangesSince(uint32_t _version, F &&f) const {
+		if (_version > version || !changes.IsComplete(_version)) {
+			for (unsigned i = 0; i < length; ++i)
+				if (IsNewerAtPosition(i, _version))
+					f(i);
+			return;
+		}
+
+		QueueChangeLog::Range ranges[QueueChangeLog::CAPACITY];
+		const unsigned n = changes.GetRangesSince(_version, ranges);
+
+		/* the ranges are sorted by their start, but they may
+		   overlap; "next" skips positions which have already
+		   been visited */
+		unsigned next = 0;
+		for (unsigned r = 0; r < n; ++r) {
+			const unsigned end = std::min(ranges[r].end, length);
+			for (unsigned i = std::max(ranges[r].start, next);
+			     i < end; ++i)
+				if (IsNewerAtPosition(i, _version))
+					f(i);
+
+			next = std::max(next, end);
+		}
+	}
+
 	/**
 	 * Returns the order number following the specified one.  This takes
 	 * end of queue and "repeat" mode into account.
@@ -248,7 +295,7 @@ struct Queue {
 	void ModifyAtPosition(unsigned position) {
 		assert(position < length);
 
-		items[position].version = version;
+		Stamp(position);
 	}
 
 	/**
@@ -280,6 +327,8 @@ struct Queue {
 	 */
 	void SwapOrders(unsigned order1, unsigned order2) {
 		std::swap(order[order1], order[order2]);
+		position_order[order[order1]] = order1;
+		position_order[order[order2]] = order2;
 	}
 
 	/**
@@ -307,7 +356,7 @@ struct Queue {
 	 */
 	void RestoreOrder() {
 		for (unsigned i = 0; i < length; ++i)
-			order[i] = i;
+			order[i] = position_order[i] = i;
 	}
 
 	/**
@@ -349,6 +398,30 @@ struct Queue {
 			      uint8_t priority, int after_order);
 
 private:
+	/**
+	 * Enlarge #items and #order so they can hold at least the
+	 * specified number of songs.
+	 */
+	void Grow(unsigned min_capacity);
+
+	/**
+	 * Mark the item at the specified position as modified in the
+	 * current version.
+	 */
+	void Stamp(unsigned position) {
+		items[position].version = version;
+		changes.Add(version, position);
+	}
+
+	/**
+	 * Update #position_order after the given range of #order
+	 * has been modified.
+	 */
+	void UpdatePositionOrder(unsigned start, unsigned end) {
+		for (unsigned i = start; i < end; ++i)
+			position_order[order[i]] = i;
+	}
+
 	/**
 	 * Moves a song to a new position in the "order" list.
 	 */
@@ -358,10 +431,20 @@ private:
 		unsigned from_id = items[from].id;
 
 		items[to] = items[from];
-		items[to].version = version;
+		Stamp(to);
 		id_table.Move(from_id, to);
 	}
 
+	/**
+	 * The random mode implementation of SetPriorityRange().  All
+	 * songs which need to be moved are collected first and
+	 * inserted into the "order" list in one pass, which makes
+	 * this O(n) for the whole range instead of O(n) per song.
+	 */
+	bool SetPriorityRangeRandom(unsigned start_position,
+				    unsigned end_position,
+				    uint8_t priority, int after_order);
+
 	/**
 	 * Find the first item that has this specified priority or
 	 * higher.
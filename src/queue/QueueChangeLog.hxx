@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_QUEUE_CHANGE_LOG_HXX
+#define MPD_QUEUE_CHANGE_LOG_HXX
+
+#include "Compiler.h"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <stdint.h>
+
+/**
+ * A bounded ring buffer which remembers which ranges of queue
+ * positions were modified at which version.  It allows "plchanges"
+ * to look only at the modified positions instead of comparing the
+ * version of every song in the queue.
+ */
+class QueueChangeLog {
+public:
+	struct Range {
+		unsigned start, end;
+
+		bool operator<(const Range &other) const {
+			return start < other.start;
+		}
+	};
+
+	static constexpr unsigned CAPACITY = 256;
+
+private:
+	struct Entry {
+		uint32_t version;
+		Range range;
+	};
+
+	Entry entries[CAPACITY];
+
+	/**
+	 * The number of valid entries; the newest one is at
+	 * (#head + #n - 1) % #CAPACITY.
+	 */
+	unsigned head, n;
+
+	/**
+	 * The log is complete for all versions equal to or greater
+	 * than this value.  Entries older than that have been
+	 * evicted.
+	 */
+	uint32_t floor;
+
+public:
+	QueueChangeLog():head(0), n(0), floor(0) {}
+
+	/**
+	 * Forget everything and never answer queries again, until
+	 * Reset() is called.
+	 */
+	void Invalidate() {
+		head = n = 0;
+		floor = UINT32_MAX;
+	}
+
+	/**
+	 * Start over; the log is complete for all versions from now
+	 * on.
+	 */
+	void Reset() {
+		head = n = 0;
+		floor = 0;
+	}
+
+	/**
+	 * Record that the specified position was modified at the
+	 * specified version.  Consecutive positions with the same
+	 * version are merged into one entry.
+	 */
+	void Add(uint32_t version, unsigned position) {
+		if (n > 0) {
+			Entry &last = entries[(head + n - 1) % CAPACITY];
+			assert(version >= last.version);
+
+			if (last.version == version &&
+			    position + 1 >= last.range.start &&
+			    position <= last.range.end) {
+				last.range.start = std::min(last.range.start,
+							    position);
+				last.range.end = std::max(last.range.end,
+							  position + 1);
+				return;
+			}
+		}
+
+		if (n == CAPACITY) {
+			/* evict the oldest entry */
+			const Entry &oldest = entries[head];
+			if (floor <= oldest.version)
+				floor = oldest.version + 1;
+
+			head = (head + 1) % CAPACITY;
+			--n;
+		}
+
+		Entry &e = entries[(head + n) % CAPACITY];
+		e.version = version;
+		e.range.start = position;
+		e.range.end = position + 1;
+		++n;
+	}
+
+	/**
+	 * Can this object answer the question which positions have
+	 * changed since the specified version?
+	 */
+	gcc_pure
+	bool IsComplete(uint32_t version) const {
+		return version >= floor;
+	}
+
+	/**
+	 * Copy the ranges modified at the specified version or later
+	 * to the given buffer (which must have room for #CAPACITY
+	 * elements), sorted by their start position.  The ranges may
+	 * overlap.
+	 *
+	 * @return the number of ranges
+	 */
+	unsigned GetRangesSince(uint32_t version, Range *dest) const {
+		assert(IsComplete(version));
+
+		unsigned count = 0;
+
+		/* walk backwards, the newest entries are at the
+		   end */
+		for (unsigned i = n; i > 0; --i) {
+			const Entry &e = entries[(head + i - 1) % CAPACITY];
+			if (e.version < version)
+				break;
+
+			dest[count++] = e.range;
+		}
+
+		std::sort(dest, dest + count);
+		return count;
+	}
+};
+
+#endif
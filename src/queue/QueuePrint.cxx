@@ -37,12 +37,12 @@ queue_print_song_info(Client &client, const Queue &queue,
 		      unsigned position)
 {
 	song_print_info(client, queue.Get(position));
-	client_printf(client, "Pos: %u\nId: %u\n",
-		      position, queue.PositionToId(position));
+	client_write_pair(client, "Pos: ", position);
+	client_write_pair(client, "Id: ", queue.PositionToId(position));
 
 	uint8_t priority = queue.GetPriorityAtPosition(position);
 	if (priority != 0)
-		client_printf(client, "Prio: %u\n", priority);
+		client_write_pair(client, "Prio: ", priority);
 }
 
 void
@@ -73,20 +73,19 @@ void
 queue_print_changes_info(Client &client, const Queue &queue,
 			 uint32_t version)
 {
-	for (unsigned i = 0; i < queue.GetLength(); i++) {
-		if (queue.IsNewerAtPosition(i, version))
+	queue.VisitChangesSince(version, [&client, &queue](unsigned i){
 			queue_print_song_info(client, queue, i);
-	}
+		});
 }
 
 void
 queue_print_changes_position(Client &client, const Queue &queue,
 			     uint32_t version)
 {
-	for (unsigned i = 0; i < queue.GetLength(); i++)
-		if (queue.IsNewerAtPosition(i, version))
+	queue.VisitChangesSince(version, [&client, &queue](unsigned i){
 			client_printf(client, "cpos: %i\nId: %i\n",
 				      i, queue.PositionToId(i));
+		});
 }
 
 void
@@ -51,6 +51,12 @@ sticker_song_delete(const LightSong &song)
 	return sticker_delete("song", uri.c_str());
 }
 
+bool
+sticker_song_move(const char *old_uri, const char *new_uri)
+{
+	return sticker_move("song", old_uri, new_uri);
+}
+
 bool
 sticker_song_delete_value(const LightSong &song, const char *name)
 {
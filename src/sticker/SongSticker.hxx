@@ -50,6 +50,12 @@ sticker_song_set_value(const LightSong &song,
 bool
 sticker_song_delete(const LightSong &song);
 
+/**
+ * Moves the sticker of a song which was renamed.
+ */
+bool
+sticker_song_move(const char *old_uri, const char *new_uri);
+
 /**
  * Deletes a sticker value.  Does nothing if the sticker did not
  * exist.
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "StickerCache.hxx"
+#include "thread/SharedMutex.hxx"
+
+#include <unordered_map>
+#include <atomic>
+
+/**
+ * Song URI to sticker value.
+ */
+typedef std::unordered_map<std::string, std::string> StickerValueMap;
+
+/**
+ * Sticker name to #StickerValueMap.
+ */
+static std::unordered_map<std::string, StickerValueMap> sticker_cache;
+
+static SharedMutex sticker_cache_mutex;
+
+static std::atomic_uint sticker_cache_stamp(0);
+
+void
+sticker_cache_clear()
+{
+	sticker_cache_mutex.lock();
+	sticker_cache.clear();
+	++sticker_cache_stamp;
+	sticker_cache_mutex.unlock();
+}
+
+void
+sticker_cache_set(const char *uri, const char *name, const char *value)
+{
+	sticker_cache_mutex.lock();
+	sticker_cache[name][uri] = value;
+	++sticker_cache_stamp;
+	sticker_cache_mutex.unlock();
+}
+
+void
+sticker_cache_delete(const char *uri)
+{
+	const std::string key(uri);
+
+	sticker_cache_mutex.lock();
+	for (auto &i : sticker_cache)
+		i.second.erase(key);
+	++sticker_cache_stamp;
+	sticker_cache_mutex.unlock();
+}
+
+void
+sticker_cache_delete_value(const char *uri, const char *name)
+{
+	sticker_cache_mutex.lock();
+
+	auto i = sticker_cache.find(name);
+	if (i != sticker_cache.end())
+		i->second.erase(uri);
+
+	++sticker_cache_stamp;
+	sticker_cache_mutex.unlock();
+}
+
+void
+sticker_cache_move(const char *old_uri, const char *new_uri)
+{
+	const std::string old_key(old_uri), new_key(new_uri);
+
+	sticker_cache_mutex.lock();
+
+	for (auto &i : sticker_cache) {
+		auto &values = i.second;
+		auto j = values.find(old_key);
+		if (j == values.end())
+			continue;
+
+		std::string value = std::move(j->second);
+		values.erase(j);
+		values[new_key] = std::move(value);
+	}
+
+	++sticker_cache_stamp;
+	sticker_cache_mutex.unlock();
+}
+
+bool
+sticker_cache_get(const char *uri, const char *name, std::string &value_r)
+{
+	bool found = false;
+
+	sticker_cache_mutex.lock_shared();
+
+	auto i = sticker_cache.find(name);
+	if (i != sticker_cache.end()) {
+		auto j = i->second.find(uri);
+		if (j != i->second.end()) {
+			value_r = j->second;
+			found = true;
+		}
+	}
+
+	sticker_cache_mutex.unlock_shared();
+	return found;
+}
+
+unsigned
+sticker_cache_generation()
+{
+	return sticker_cache_stamp.load(std::memory_order_relaxed);
+}
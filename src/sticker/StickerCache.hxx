@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_STICKER_CACHE_HXX
+#define MPD_STICKER_CACHE_HXX
+
+#include "Compiler.h"
+
+#include <string>
+
+/*
+ * An in-memory copy of all "song" stickers, keyed by sticker name and
+ * song URI.  It is loaded when the sticker database is opened and
+ * updated by each write, so song filters (see #LOCATE_TAG_STICKER)
+ * can look up sticker values without querying SQLite for each song.
+ *
+ * All functions are thread-safe.
+ */
+
+void
+sticker_cache_clear();
+
+void
+sticker_cache_set(const char *uri, const char *name, const char *value);
+
+/**
+ * Remove all sticker values of a song.
+ */
+void
+sticker_cache_delete(const char *uri);
+
+void
+sticker_cache_delete_value(const char *uri, const char *name);
+
+/**
+ * Move all sticker values of a song to a new URI, replacing the
+ * values which exist there already.
+ */
+void
+sticker_cache_move(const char *old_uri, const char *new_uri);
+
+/**
+ * Look up a sticker value.
+ *
+ * @return false if the song has no such sticker
+ */
+bool
+sticker_cache_get(const char *uri, const char *name, std::string &value_r);
+
+/**
+ * Returns a number which changes whenever a sticker value is
+ * modified.  It is used to invalidate cached query results.
+ */
+gcc_pure
+unsigned
+sticker_cache_generation();
+
+#endif
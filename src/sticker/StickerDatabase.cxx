@@ -19,8 +19,10 @@
 
 #include "config.h"
 #include "StickerDatabase.hxx"
+#include "StickerCache.hxx"
 #include "fs/Path.hxx"
 #include "Idle.hxx"
+#include "event/TimeoutMonitor.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "util/Macros.hxx"
@@ -31,6 +33,7 @@
 
 #include <sqlite3.h>
 #include <assert.h>
+#include <string.h>
 
 #if SQLITE_VERSION_NUMBER < 3003009
 #define sqlite3_prepare_v2 sqlite3_prepare
@@ -48,6 +51,7 @@ enum sticker_sql {
 	STICKER_SQL_DELETE,
 	STICKER_SQL_DELETE_VALUE,
 	STICKER_SQL_FIND,
+	STICKER_SQL_MOVE,
 };
 
 static const char *const sticker_sql[] = {
@@ -65,8 +69,13 @@ static const char *const sticker_sql[] = {
 	"DELETE FROM sticker WHERE type=? AND uri=? AND name=?",
 	//[STICKER_SQL_FIND] =
 	"SELECT uri,value FROM sticker WHERE type=? AND uri LIKE (? || '%') AND name=?",
+	//[STICKER_SQL_MOVE] =
+	"UPDATE OR REPLACE sticker SET uri=? WHERE type=? AND uri=?",
 };
 
+static const char sticker_sql_load_songs[] =
+	"SELECT uri,name,value FROM sticker WHERE type='song'";
+
 static const char sticker_sql_create[] =
 	"CREATE TABLE IF NOT EXISTS sticker("
 	"  type VARCHAR NOT NULL, "
@@ -78,9 +87,35 @@ static const char sticker_sql_create[] =
 	" sticker_value ON sticker(type, uri, name);"
 	"";
 
+/**
+ * WAL mode lets readers proceed while a transaction is open, and with
+ * synchronous=NORMAL, a commit does not wait for fsync() (the
+ * database is still consistent after a power failure, but may lose
+ * the last transactions).
+ */
+static const char sticker_sql_pragma[] =
+	"PRAGMA journal_mode=WAL;"
+	"PRAGMA synchronous=NORMAL;";
+
+/**
+ * Writes outside of a batch are committed this many milliseconds
+ * after the first one.
+ */
+static constexpr unsigned STICKER_COMMIT_DELAY_MS = 1000;
+
 static sqlite3 *sticker_db;
 static sqlite3_stmt *sticker_stmt[ARRAY_SIZE(sticker_sql)];
 
+/**
+ * The nesting level of sticker_begin_batch().
+ */
+static unsigned sticker_batch_depth;
+
+/**
+ * Is a transaction open, i.e. are there uncommitted writes?
+ */
+static bool sticker_in_transaction;
+
 static constexpr Domain sticker_domain("sticker");
 
 static void
@@ -89,6 +124,58 @@ LogError(sqlite3 *db, const char *msg)
 	FormatError(sticker_domain, "%s: %s", msg, sqlite3_errmsg(db));
 }
 
+/**
+ * Execute a statement which doesn't return rows, retrying while the
+ * database is locked by another process.
+ */
+static bool
+sticker_exec(const char *sql)
+{
+	int ret;
+
+	do {
+		ret = sqlite3_exec(sticker_db, sql, nullptr, nullptr, nullptr);
+	} while (ret == SQLITE_BUSY);
+
+	return ret == SQLITE_OK;
+}
+
+class StickerCommitTimer final : public TimeoutMonitor {
+public:
+	StickerCommitTimer(EventLoop &_loop)
+		:TimeoutMonitor(_loop) {}
+
+protected:
+	virtual void OnTimeout() override {
+		if (sticker_batch_depth == 0)
+			sticker_flush();
+	}
+};
+
+static StickerCommitTimer *sticker_commit_timer;
+
+/**
+ * Make sure a transaction is open before modifying the database.
+ */
+static void
+sticker_begin_write()
+{
+	if (sticker_in_transaction)
+		return;
+
+	if (!sticker_exec("BEGIN")) {
+		/* fall back to one implicit transaction per
+		   statement */
+		LogError(sticker_db, "BEGIN failed");
+		return;
+	}
+
+	sticker_in_transaction = true;
+
+	if (sticker_batch_depth == 0)
+		sticker_commit_timer->Schedule(STICKER_COMMIT_DELAY_MS);
+}
+
 static sqlite3_stmt *
 sticker_prepare(const char *sql, Error &error)
 {
@@ -106,8 +193,52 @@ sticker_prepare(const char *sql, Error &error)
 	return stmt;
 }
 
+/**
+ * Copy all "song" stickers to the #StickerCache.
+ */
+static bool
+sticker_load_cache(Error &error)
+{
+	sqlite3_stmt *const stmt = sticker_prepare(sticker_sql_load_songs,
+						   error);
+	if (stmt == nullptr)
+		return false;
+
+	sticker_cache_clear();
+
+	int ret;
+	do {
+		ret = sqlite3_step(stmt);
+		if (ret == SQLITE_ROW)
+			sticker_cache_set((const char*)sqlite3_column_text(stmt, 0),
+					  (const char*)sqlite3_column_text(stmt, 1),
+					  (const char*)sqlite3_column_text(stmt, 2));
+	} while (ret == SQLITE_ROW || ret == SQLITE_BUSY);
+
+	if (ret != SQLITE_DONE) {
+		error.Format(sticker_domain, ret,
+			     "Failed to load stickers: %s",
+			     sqlite3_errmsg(sticker_db));
+		sqlite3_finalize(stmt);
+		return false;
+	}
+
+	sqlite3_finalize(stmt);
+	return true;
+}
+
+/**
+ * Is this the sticker type mirrored by the #StickerCache?
+ */
+gcc_pure
+static bool
+sticker_is_cached(const char *type)
+{
+	return strcmp(type, "song") == 0;
+}
+
 bool
-sticker_global_init(Path path, Error &error)
+sticker_global_init(EventLoop &loop, Path path, Error &error)
 {
 	assert(!path.IsNull());
 
@@ -124,6 +255,9 @@ sticker_global_init(Path path, Error &error)
 		return false;
 	}
 
+	if (!sticker_exec(sticker_sql_pragma))
+		LogError(sticker_db, "Failed to enable WAL mode");
+
 	/* create the table and index */
 
 	ret = sqlite3_exec(sticker_db, sticker_sql_create,
@@ -145,6 +279,10 @@ sticker_global_init(Path path, Error &error)
 			return false;
 	}
 
+	if (!sticker_load_cache(error))
+		return false;
+
+	sticker_commit_timer = new StickerCommitTimer(loop);
 	return true;
 }
 
@@ -155,6 +293,11 @@ sticker_global_finish(void)
 		/* not configured */
 		return;
 
+	assert(sticker_batch_depth == 0);
+
+	sticker_flush();
+	delete sticker_commit_timer;
+
 	for (unsigned i = 0; i < ARRAY_SIZE(sticker_stmt); ++i) {
 		assert(sticker_stmt[i] != nullptr);
 
@@ -162,6 +305,8 @@ sticker_global_finish(void)
 	}
 
 	sqlite3_close(sticker_db);
+
+	sticker_cache_clear();
 }
 
 bool
@@ -170,6 +315,45 @@ sticker_enabled(void)
 	return sticker_db != nullptr;
 }
 
+void
+sticker_begin_batch()
+{
+	if (sticker_db == nullptr)
+		return;
+
+	++sticker_batch_depth;
+}
+
+void
+sticker_end_batch()
+{
+	if (sticker_db == nullptr)
+		return;
+
+	assert(sticker_batch_depth > 0);
+
+	if (--sticker_batch_depth == 0)
+		sticker_flush();
+}
+
+void
+sticker_flush()
+{
+	assert(sticker_enabled());
+
+	sticker_commit_timer->Cancel();
+
+	if (!sticker_in_transaction)
+		return;
+
+	sticker_in_transaction = false;
+
+	if (!sticker_exec("COMMIT")) {
+		LogError(sticker_db, "COMMIT failed");
+		sticker_exec("ROLLBACK");
+	}
+}
+
 std::string
 sticker_load_value(const char *type, const char *uri, const char *name)
 {
@@ -293,6 +477,8 @@ sticker_update_value(const char *type, const char *uri,
 
 	assert(sticker_enabled());
 
+	sticker_begin_write();
+
 	sqlite3_reset(stmt);
 
 	ret = sqlite3_bind_text(stmt, 1, value, -1, nullptr);
@@ -352,6 +538,8 @@ sticker_insert_value(const char *type, const char *uri,
 
 	assert(sticker_enabled());
 
+	sticker_begin_write();
+
 	sqlite3_reset(stmt);
 
 	ret = sqlite3_bind_text(stmt, 1, type, -1, nullptr);
@@ -408,8 +596,13 @@ sticker_store_value(const char *type, const char *uri,
 	if (*name == 0)
 		return false;
 
-	return sticker_update_value(type, uri, name, value) ||
-		sticker_insert_value(type, uri, name, value);
+	if (!sticker_update_value(type, uri, name, value) &&
+	    !sticker_insert_value(type, uri, name, value))
+		return false;
+
+	if (sticker_is_cached(type))
+		sticker_cache_set(uri, name, value);
+	return true;
 }
 
 bool
@@ -422,6 +615,8 @@ sticker_delete(const char *type, const char *uri)
 	assert(type != nullptr);
 	assert(uri != nullptr);
 
+	sticker_begin_write();
+
 	sqlite3_reset(stmt);
 
 	ret = sqlite3_bind_text(stmt, 1, type, -1, nullptr);
@@ -448,10 +643,69 @@ sticker_delete(const char *type, const char *uri)
 	sqlite3_reset(stmt);
 	sqlite3_clear_bindings(stmt);
 
+	if (sticker_is_cached(type))
+		sticker_cache_delete(uri);
+
 	idle_add(IDLE_STICKER);
 	return true;
 }
 
+bool
+sticker_move(const char *type, const char *old_uri, const char *new_uri)
+{
+	sqlite3_stmt *const stmt = sticker_stmt[STICKER_SQL_MOVE];
+	int ret;
+
+	assert(sticker_enabled());
+	assert(type != nullptr);
+	assert(old_uri != nullptr);
+	assert(new_uri != nullptr);
+
+	sticker_begin_write();
+
+	sqlite3_reset(stmt);
+
+	ret = sqlite3_bind_text(stmt, 1, new_uri, -1, nullptr);
+	if (ret != SQLITE_OK) {
+		LogError(sticker_db, "sqlite3_bind_text() failed");
+		return false;
+	}
+
+	ret = sqlite3_bind_text(stmt, 2, type, -1, nullptr);
+	if (ret != SQLITE_OK) {
+		LogError(sticker_db, "sqlite3_bind_text() failed");
+		return false;
+	}
+
+	ret = sqlite3_bind_text(stmt, 3, old_uri, -1, nullptr);
+	if (ret != SQLITE_OK) {
+		LogError(sticker_db, "sqlite3_bind_text() failed");
+		return false;
+	}
+
+	do {
+		ret = sqlite3_step(stmt);
+	} while (ret == SQLITE_BUSY);
+
+	if (ret != SQLITE_DONE) {
+		LogError(sticker_db, "sqlite3_step() failed");
+		return false;
+	}
+
+	const bool modified = sqlite3_changes(sticker_db) > 0;
+
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+
+	if (modified) {
+		if (sticker_is_cached(type))
+			sticker_cache_move(old_uri, new_uri);
+
+		idle_add(IDLE_STICKER);
+	}
+	return true;
+}
+
 bool
 sticker_delete_value(const char *type, const char *uri, const char *name)
 {
@@ -462,6 +716,8 @@ sticker_delete_value(const char *type, const char *uri, const char *name)
 	assert(type != nullptr);
 	assert(uri != nullptr);
 
+	sticker_begin_write();
+
 	sqlite3_reset(stmt);
 
 	ret = sqlite3_bind_text(stmt, 1, type, -1, nullptr);
@@ -496,6 +752,9 @@ sticker_delete_value(const char *type, const char *uri, const char *name)
 	sqlite3_reset(stmt);
 	sqlite3_clear_bindings(stmt);
 
+	if (ret > 0 && sticker_is_cached(type))
+		sticker_cache_delete_value(uri, name);
+
 	idle_add(IDLE_STICKER);
 	return ret > 0;
 }
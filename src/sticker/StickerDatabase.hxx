@@ -48,15 +48,22 @@
 
 class Error;
 class Path;
+class EventLoop;
 struct sticker;
 
 /**
  * Opens the sticker database.
  *
+ * Writes are not committed one by one: they are collected in a
+ * transaction which is committed when the outermost batch (see
+ * sticker_begin_batch()) ends, or shortly after the first write if
+ * there is no batch.
+ *
+ * @param loop the #EventLoop which commits pending writes
  * @return true on success, false on error
  */
 bool
-sticker_global_init(Path path, Error &error);
+sticker_global_init(EventLoop &loop, Path path, Error &error);
 
 /**
  * Close the sticker database.
@@ -71,6 +78,44 @@ gcc_const
 bool
 sticker_enabled(void);
 
+/**
+ * Begin a batch of writes, e.g. for a command list.  All writes until
+ * the matching sticker_end_batch() call are committed in one
+ * transaction.  Batches may be nested; only the outermost one
+ * commits.  Does nothing if the sticker database is disabled.
+ */
+void
+sticker_begin_batch();
+
+/**
+ * Finish a batch started with sticker_begin_batch().
+ */
+void
+sticker_end_batch();
+
+/**
+ * Commit all pending writes now.
+ */
+void
+sticker_flush();
+
+/**
+ * Begin a batch and end it automatically.
+ */
+class ScopeStickerBatch {
+public:
+	ScopeStickerBatch() {
+		sticker_begin_batch();
+	}
+
+	~ScopeStickerBatch() {
+		sticker_end_batch();
+	}
+
+	ScopeStickerBatch(const ScopeStickerBatch &) = delete;
+	ScopeStickerBatch &operator=(const ScopeStickerBatch &) = delete;
+};
+
 /**
  * Returns one value from an object's sticker record.  Returns an
  * empty string if the value doesn't exist.
@@ -93,6 +138,13 @@ sticker_store_value(const char *type, const char *uri,
 bool
 sticker_delete(const char *type, const char *uri);
 
+/**
+ * Moves all sticker values of an object to a new URI, replacing the
+ * values which exist there already.
+ */
+bool
+sticker_move(const char *type, const char *old_uri, const char *new_uri);
+
 /**
  * Deletes a sticker value.  Fails if no sticker with this name
  * exists.
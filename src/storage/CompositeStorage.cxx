@@ -232,6 +232,8 @@ CompositeStorage::Mount(const char *uri, Storage *storage)
 	if (directory.storage != nullptr)
 		delete directory.storage;
 	directory.storage = storage;
+
+	prefix_cache.clear();
 }
 
 bool
@@ -239,25 +241,73 @@ CompositeStorage::Unmount(const char *uri)
 {
 	const ScopeLock protect(mutex);
 
+	prefix_cache.clear();
 	return root.Unmount(uri);
 }
 
-CompositeStorage::FindResult
-CompositeStorage::FindStorage(const char *uri) const
+CompositeStorage::PrefixCacheItem
+CompositeStorage::FindPrefix(const std::string &prefix) const
 {
-	FindResult result{&root, uri};
+	PrefixCacheItem item{&root, 0, &root};
 
-	const Directory *directory = &root;
-	while (*uri != 0) {
-		const std::string name = NextSegment(uri);
+	if (prefix.empty())
+		return item;
 
-		auto i = directory->children.find(name);
-		if (i == directory->children.end())
+	const char *const start = prefix.c_str();
+	const char *uri = start;
+	while (true) {
+		const char *slash = strchr(uri, '/');
+		const char *end = slash != nullptr ? slash : uri + strlen(uri);
+
+		auto i = item.walk->children.find(std::string(uri, end));
+		if (i == item.walk->children.end()) {
+			item.walk = nullptr;
 			break;
+		}
 
-		directory = &i->second;
-		if (directory->storage != nullptr)
-			result = FindResult{directory, uri};
+		item.walk = &i->second;
+		if (item.walk->storage != nullptr) {
+			item.directory = item.walk;
+			/* in the full URI, each segment of the prefix
+			   is followed by a slash */
+			item.offset = end + 1 - start;
+		}
+
+		if (slash == nullptr)
+			break;
+
+		uri = slash + 1;
+	}
+
+	return item;
+}
+
+CompositeStorage::FindResult
+CompositeStorage::FindStorage(const char *uri) const
+{
+	const char *slash = strrchr(uri, '/');
+	const char *name = slash != nullptr ? slash + 1 : uri;
+	std::string prefix(uri, name - uri - (slash != nullptr));
+
+	auto i = prefix_cache.find(prefix);
+	if (i == prefix_cache.end()) {
+		if (prefix_cache.size() >= MAX_PREFIX_CACHE)
+			prefix_cache.clear();
+
+		const auto item = FindPrefix(prefix);
+		i = prefix_cache.insert(std::make_pair(std::move(prefix),
+						       item)).first;
+	}
+
+	const PrefixCacheItem &item = i->second;
+	FindResult result{item.directory, uri + item.offset};
+
+	if (item.walk != nullptr && *name != 0) {
+		/* is the last segment a mount point? */
+		auto j = item.walk->children.find(name);
+		if (j != item.walk->children.end() &&
+		    j->second.storage != nullptr)
+			result = FindResult{&j->second, name + strlen(name)};
 	}
 
 	return result;
@@ -27,6 +27,7 @@
 
 #include <string>
 #include <map>
+#include <unordered_map>
 
 class Error;
 class Storage;
@@ -80,6 +81,36 @@ class CompositeStorage final : public Storage {
 		const char *uri;
 	};
 
+	/**
+	 * A cached FindStorage() result for the directory part of a
+	 * URI (everything before the last slash).
+	 */
+	struct PrefixCacheItem {
+		/**
+		 * The #Directory with the innermost mount point.
+		 */
+		const Directory *directory;
+
+		/**
+		 * The number of URI bytes consumed by the mount
+		 * point; the rest is passed to its #Storage.
+		 */
+		size_t offset;
+
+		/**
+		 * The virtual #Directory matching the whole prefix,
+		 * or nullptr if the prefix leaves the virtual tree.
+		 * Used to check the last segment for a mount point.
+		 */
+		const Directory *walk;
+	};
+
+	/**
+	 * The upper limit for #prefix_cache.  When it is reached, the
+	 * cache is cleared.
+	 */
+	static constexpr size_t MAX_PREFIX_CACHE = 4096;
+
 	/**
 	 * Protects the virtual #Directory tree.
 	 *
@@ -89,6 +120,14 @@ class CompositeStorage final : public Storage {
 
 	Directory root;
 
+	/**
+	 * Caches FindStorage() results by URI directory, because
+	 * most lookups (song files during update and playback) share
+	 * their directory with the previous ones.  Cleared by
+	 * Mount() and Unmount().  Protected by #mutex.
+	 */
+	mutable std::unordered_map<std::string, PrefixCacheItem> prefix_cache;
+
 	mutable std::string relative_buffer;
 
 public:
@@ -155,7 +194,8 @@ private:
 		}
 	}
 
-	gcc_pure
+	PrefixCacheItem FindPrefix(const std::string &prefix) const;
+
 	FindResult FindStorage(const char *uri) const;
 	FindResult FindStorage(const char *uri, Error &error) const;
 
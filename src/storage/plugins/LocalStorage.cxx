@@ -27,12 +27,26 @@
 #include "fs/AllocatedPath.hxx"
 #include "fs/DirectoryReader.hxx"
 
+#ifdef __linux__
+#include "fs/LinuxDirectoryReader.hxx"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <dirent.h>
+#include <fcntl.h>
+#endif
+
 #include <string>
 
 class LocalDirectoryReader final : public StorageDirectoryReader {
 	AllocatedPath base_fs;
 
+#ifdef __linux__
+	LinuxDirectoryReader reader;
+#else
 	DirectoryReader reader;
+#endif
 
 	std::string name_utf8;
 
@@ -104,6 +118,75 @@ Stat(Path path, bool follow, FileInfo &info, Error &error)
 	return true;
 }
 
+#ifdef __linux__
+
+/**
+ * Like Stat(), but relative to a directory file descriptor, which
+ * saves the kernel from walking the whole path again.  With statx(),
+ * only the attributes needed by #FileInfo are requested, and
+ * network file systems are not forced to revalidate.
+ *
+ * @return false on error, with errno set
+ */
+static bool
+StatAt(int dir_fd, const char *name_fs, bool follow, FileInfo &info)
+{
+	const int flags = follow ? 0 : AT_SYMLINK_NOFOLLOW;
+
+#ifdef HAVE_STATX
+	struct statx stx;
+	if (statx(dir_fd, name_fs, flags|AT_NO_AUTOMOUNT|AT_STATX_DONT_SYNC,
+		  STATX_TYPE|STATX_SIZE|STATX_MTIME|STATX_INO,
+		  &stx) < 0)
+		return false;
+
+	if (S_ISREG(stx.stx_mode))
+		info.type = FileInfo::Type::REGULAR;
+	else if (S_ISDIR(stx.stx_mode))
+		info.type = FileInfo::Type::DIRECTORY;
+	else
+		info.type = FileInfo::Type::OTHER;
+
+	info.size = stx.stx_size;
+	info.mtime = stx.stx_mtime.tv_sec;
+	info.device = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+	info.inode = stx.stx_ino;
+#else
+	struct stat st;
+	if (fstatat(dir_fd, name_fs, &st, flags) < 0)
+		return false;
+
+	if (S_ISREG(st.st_mode))
+		info.type = FileInfo::Type::REGULAR;
+	else if (S_ISDIR(st.st_mode))
+		info.type = FileInfo::Type::DIRECTORY;
+	else
+		info.type = FileInfo::Type::OTHER;
+
+	info.size = st.st_size;
+	info.mtime = st.st_mtime;
+	info.device = st.st_dev;
+	info.inode = st.st_ino;
+#endif
+
+	return true;
+}
+
+/**
+ * Does the d_type value describe a file which is neither a regular
+ * file, a directory nor a symlink?  Those are never scanned, so
+ * there is no need to stat() them.
+ */
+gcc_const
+static bool
+IsSpecialType(unsigned char type)
+{
+	return type == DT_FIFO || type == DT_CHR || type == DT_BLK ||
+		type == DT_SOCK;
+}
+
+#endif
+
 std::string
 LocalStorage::MapUTF8(const char *uri_utf8) const
 {
@@ -201,9 +284,30 @@ LocalDirectoryReader::Read()
 bool
 LocalDirectoryReader::GetInfo(bool follow, FileInfo &info, Error &error)
 {
+#ifdef __linux__
+	if (IsSpecialType(reader.GetType())) {
+		info.type = FileInfo::Type::OTHER;
+		info.size = 0;
+		info.mtime = 0;
+		info.device = info.inode = 0;
+		return true;
+	}
+
+	if (StatAt(reader.GetFD(), reader.GetEntry().c_str(), follow, info))
+		return true;
+
+	error.SetErrno();
+
+	const AllocatedPath path_fs =
+		AllocatedPath::Build(base_fs, reader.GetEntry());
+	const auto path_utf8 = path_fs.ToUTF8();
+	error.FormatPrefix("Failed to stat %s: ", path_utf8.c_str());
+	return false;
+#else
 	const AllocatedPath path_fs =
 		AllocatedPath::Build(base_fs, reader.GetEntry());
 	return Stat(path_fs, follow, info, error);
+#endif
 }
 
 Storage *
@@ -23,21 +23,32 @@
 #include "storage/StorageInterface.hxx"
 #include "storage/FileInfo.hxx"
 #include "lib/smbclient/Init.hxx"
-#include "lib/smbclient/Mutex.hxx"
+#include "lib/smbclient/Context.hxx"
 #include "util/Error.hxx"
 #include "thread/Mutex.hxx"
 
-#include <libsmbclient.h>
+class SmbclientStorage;
 
 class SmbclientDirectoryReader final : public StorageDirectoryReader {
+	SmbclientStorage &storage;
+
 	const std::string base;
-	const unsigned handle;
+	SMBCFILE *const handle;
 
 	const char *name;
 
+#ifdef HAVE_SMBC_GETFUNCTIONREADDIRPLUS2
+	/**
+	 * The attributes of #name, returned by readdirplus2.
+	 */
+	struct stat st;
+#endif
+
 public:
-	SmbclientDirectoryReader(std::string &&_base, unsigned _handle)
-		:base(std::move(_base)), handle(_handle) {}
+	SmbclientDirectoryReader(SmbclientStorage &_storage,
+				 std::string &&_base, SMBCFILE *_handle)
+		:storage(_storage),
+		 base(std::move(_base)), handle(_handle) {}
 
 	virtual ~SmbclientDirectoryReader();
 
@@ -48,19 +59,22 @@ public:
 };
 
 class SmbclientStorage final : public Storage {
+	friend class SmbclientDirectoryReader;
+
 	const std::string base;
 
-	SMBCCTX *const ctx;
+	/**
+	 * Protects #ctx, which may be used by the update thread and
+	 * by client commands concurrently.  Other storages and input
+	 * streams have their own contexts and are not blocked.
+	 */
+	Mutex mutex;
 
-public:
-	SmbclientStorage(const char *_base, SMBCCTX *_ctx)
-		:base(_base), ctx(_ctx) {}
+	SmbclientContext ctx;
 
-	virtual ~SmbclientStorage() {
-		smbclient_mutex.lock();
-		smbc_free_context(ctx, 1);
-		smbclient_mutex.unlock();
-	}
+public:
+	SmbclientStorage(const char *_base, SmbclientContext &&_ctx)
+		:base(_base), ctx(std::move(_ctx)) {}
 
 	/* virtual methods from class Storage */
 	virtual bool GetInfo(const char *uri_utf8, bool follow, FileInfo &info,
@@ -72,6 +86,9 @@ public:
 	virtual std::string MapUTF8(const char *uri_utf8) const override;
 
 	virtual const char *MapToRelativeUTF8(const char *uri_utf8) const override;
+
+private:
+	bool GetInfo(const char *path, FileInfo &info, Error &error);
 };
 
 std::string
@@ -91,18 +108,9 @@ SmbclientStorage::MapToRelativeUTF8(const char *uri_utf8) const
 	return PathTraitsUTF8::Relative(base.c_str(), uri_utf8);
 }
 
-static bool
-GetInfo(const char *path, FileInfo &info, Error &error)
+static void
+StatToFileInfo(const struct stat &st, FileInfo &info)
 {
-	struct stat st;
-	smbclient_mutex.lock();
-	bool success = smbc_stat(path, &st) == 0;
-	smbclient_mutex.unlock();
-	if (!success) {
-		error.SetErrno();
-		return false;
-	}
-
 	if (S_ISREG(st.st_mode))
 		info.type = FileInfo::Type::REGULAR;
 	else if (S_ISDIR(st.st_mode))
@@ -114,6 +122,21 @@ GetInfo(const char *path, FileInfo &info, Error &error)
 	info.mtime = st.st_mtime;
 	info.device = st.st_dev;
 	info.inode = st.st_ino;
+}
+
+bool
+SmbclientStorage::GetInfo(const char *path, FileInfo &info, Error &error)
+{
+	struct stat st;
+	mutex.lock();
+	bool success = ctx.Stat(path, st) == 0;
+	mutex.unlock();
+	if (!success) {
+		error.SetErrno();
+		return false;
+	}
+
+	StatToFileInfo(st, info);
 	return true;
 }
 
@@ -122,22 +145,23 @@ SmbclientStorage::GetInfo(const char *uri_utf8, gcc_unused bool follow,
 			  FileInfo &info, Error &error)
 {
 	const std::string mapped = MapUTF8(uri_utf8);
-	return ::GetInfo(mapped.c_str(), info, error);
+	return GetInfo(mapped.c_str(), info, error);
 }
 
 StorageDirectoryReader *
 SmbclientStorage::OpenDirectory(const char *uri_utf8, Error &error)
 {
 	std::string mapped = MapUTF8(uri_utf8);
-	smbclient_mutex.lock();
-	int handle = smbc_opendir(mapped.c_str());
-	smbclient_mutex.unlock();
-	if (handle < 0) {
+	mutex.lock();
+	SMBCFILE *handle = ctx.OpenDirectory(mapped.c_str());
+	mutex.unlock();
+	if (handle == nullptr) {
 		error.SetErrno();
 		return nullptr;
 	}
 
-	return new SmbclientDirectoryReader(std::move(mapped.c_str()), handle);
+	return new SmbclientDirectoryReader(*this, std::move(mapped),
+					    handle);
 }
 
 gcc_pure
@@ -151,18 +175,22 @@ SkipNameFS(const char *name)
 
 SmbclientDirectoryReader::~SmbclientDirectoryReader()
 {
-	smbclient_mutex.lock();
-	smbc_close(handle);
-	smbclient_mutex.unlock();
+	const ScopeLock protect(storage.mutex);
+	storage.ctx.CloseDirectory(handle);
 }
 
 const char *
 SmbclientDirectoryReader::Read()
 {
-	const ScopeLock protect(smbclient_mutex);
+	const ScopeLock protect(storage.mutex);
 
+#ifdef HAVE_SMBC_GETFUNCTIONREADDIRPLUS2
+	const struct libsmb_file_info *e;
+	while ((e = storage.ctx.ReadDirectoryPlus(handle, st)) != nullptr) {
+#else
 	struct smbc_dirent *e;
-	while ((e = smbc_readdir(handle)) != nullptr) {
+	while ((e = storage.ctx.ReadDirectory(handle)) != nullptr) {
+#endif
 		name = e->name;
 		if (!SkipNameFS(name))
 			return name;
@@ -173,10 +201,15 @@ SmbclientDirectoryReader::Read()
 
 bool
 SmbclientDirectoryReader::GetInfo(gcc_unused bool follow, FileInfo &info,
-				  Error &error)
+				  gcc_unused Error &error)
 {
+#ifdef HAVE_SMBC_GETFUNCTIONREADDIRPLUS2
+	StatToFileInfo(st, info);
+	return true;
+#else
 	const std::string path = PathTraitsUTF8::Build(base.c_str(), name);
-	return ::GetInfo(path.c_str(), info, error);
+	return storage.GetInfo(path.c_str(), info, error);
+#endif
 }
 
 static Storage *
@@ -188,21 +221,11 @@ CreateSmbclientStorageURI(const char *base, Error &error)
 	if (!SmbclientInit(error))
 		return nullptr;
 
-	const ScopeLock protect(smbclient_mutex);
-	SMBCCTX *ctx = smbc_new_context();
-	if (ctx == nullptr) {
-		error.SetErrno("smbc_new_context() failed");
+	SmbclientContext ctx = SmbclientContext::New(error);
+	if (!ctx.IsDefined())
 		return nullptr;
-	}
-
-	SMBCCTX *ctx2 = smbc_init_context(ctx);
-	if (ctx2 == nullptr) {
-		error.SetErrno("smbc_init_context() failed");
-		smbc_free_context(ctx, 1);
-		return nullptr;
-	}
 
-	return new SmbclientStorage(base, ctx2);
+	return new SmbclientStorage(base, std::move(ctx));
 }
 
 const StoragePlugin smbclient_storage_plugin = {
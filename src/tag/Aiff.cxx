@@ -19,18 +19,14 @@
 
 #include "config.h" /* must be first for large file support */
 #include "Aiff.hxx"
-#include "util/Domain.hxx"
+#include "TagFileReader.hxx"
 #include "system/ByteOrder.hxx"
-#include "Log.hxx"
 
 #include <limits>
 
 #include <stdint.h>
-#include <sys/stat.h>
 #include <string.h>
 
-static constexpr Domain aiff_domain("aiff");
-
 struct aiff_header {
 	char id[4];
 	uint32_t size;
@@ -43,43 +39,31 @@ struct aiff_chunk_header {
 };
 
 size_t
-aiff_seek_id3(FILE *file)
+aiff_find_id3(TagFileReader &reader, uint64_t &offset_r)
 {
-	/* determine the file size */
-
-	struct stat st;
-	if (fstat(fileno(file), &st) < 0) {
-		LogErrno(aiff_domain, "Failed to stat file descriptor");
-		return 0;
-	}
-
-	/* seek to the beginning and read the AIFF header */
-
-	if (fseek(file, 0, SEEK_SET) != 0) {
-		LogErrno(aiff_domain, "Failed to seek");
-		return 0;
-	}
+	/* read the AIFF header */
 
 	aiff_header header;
-	size_t size = fread(&header, sizeof(header), 1, file);
-	if (size != 1 ||
+	if (!reader.ReadFullAt(&header, sizeof(header), 0) ||
 	    memcmp(header.id, "FORM", 4) != 0 ||
-	    FromBE32(header.size) > (uint32_t)st.st_size ||
+	    FromBE32(header.size) > reader.GetSize() ||
 	    (memcmp(header.format, "AIFF", 4) != 0 &&
 	     memcmp(header.format, "AIFC", 4) != 0))
 		/* not a AIFF file */
 		return 0;
 
+	uint64_t offset = sizeof(header);
 	while (true) {
 		/* read the chunk header */
 
 		aiff_chunk_header chunk;
-		size = fread(&chunk, sizeof(chunk), 1, file);
-		if (size != 1)
+		if (!reader.ReadFullAt(&chunk, sizeof(chunk), offset))
 			return 0;
 
-		size = FromBE32(chunk.size);
-		if (size > unsigned(std::numeric_limits<int>::max()))
+		offset += sizeof(chunk);
+
+		size_t size = FromBE32(chunk.size);
+		if (size > size_t(std::numeric_limits<int>::max()))
 			/* too dangerous, bail out: possible integer
 			   underflow when casting to off_t */
 			return 0;
@@ -88,11 +72,12 @@ aiff_seek_id3(FILE *file)
 			/* pad byte */
 			++size;
 
-		if (memcmp(chunk.id, "ID3 ", 4) == 0)
+		if (memcmp(chunk.id, "ID3 ", 4) == 0) {
 			/* found it! */
+			offset_r = offset;
 			return size;
+		}
 
-		if (fseek(file, size, SEEK_CUR) != 0)
-			return 0;
+		offset += size;
 	}
 }
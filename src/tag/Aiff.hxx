@@ -26,15 +26,19 @@
 #define MPD_AIFF_HXX
 
 #include <stddef.h>
-#include <stdio.h>
+#include <stdint.h>
+
+class TagFileReader;
 
 /**
- * Seeks the AIFF file to the ID3 chunk.
+ * Finds the ID3 chunk in the AIFF file.
  *
+ * @param offset_r on success, receives the file offset of the ID3
+ * chunk
  * @return the size of the ID3 chunk on success, or 0 if this is not a
  * AIFF file or no ID3 chunk was found
  */
 size_t
-aiff_seek_id3(FILE *file);
+aiff_find_id3(TagFileReader &reader, uint64_t &offset_r);
 
 #endif
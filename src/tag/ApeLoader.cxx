@@ -19,12 +19,13 @@
 
 #include "config.h"
 #include "ApeLoader.hxx"
+#include "TagFileReader.hxx"
 #include "system/ByteOrder.hxx"
-#include "fs/FileSystem.hxx"
+#include "fs/Path.hxx"
+#include "util/Error.hxx"
 
 #include <stdint.h>
 #include <assert.h>
-#include <stdio.h>
 #include <string.h>
 
 struct ape_footer {
@@ -36,13 +37,15 @@ struct ape_footer {
 	unsigned char reserved[8];
 };
 
-static bool
-ape_scan_internal(FILE *fp, ApeTagCallback callback)
+bool
+tag_ape_scan(TagFileReader &reader, ApeTagCallback callback)
 {
 	/* determine if file has an apeV2 tag */
+	const uint64_t size = reader.GetSize();
 	struct ape_footer footer;
-	if (fseek(fp, -(long)sizeof(footer), SEEK_END) ||
-	    fread(&footer, 1, sizeof(footer), fp) != sizeof(footer) ||
+	if (size < sizeof(footer) ||
+	    !reader.ReadFullAt(&footer, sizeof(footer),
+			       size - sizeof(footer)) ||
 	    memcmp(footer.id, "APETAGEX", sizeof(footer.id)) != 0 ||
 	    FromLE32(footer.version) != 2000)
 		return false;
@@ -52,15 +55,17 @@ ape_scan_internal(FILE *fp, ApeTagCallback callback)
 	if (remaining <= sizeof(footer) + 10 ||
 	    /* refuse to load more than one megabyte of tag data */
 	    remaining > 1024 * 1024 ||
-	    fseek(fp, -(long)remaining, SEEK_END))
+	    remaining > size)
 		return false;
 
+	const uint64_t offset = size - remaining;
+
 	/* read tag into buffer */
 	remaining -= sizeof(footer);
 	assert(remaining > 10);
 
 	char *buffer = new char[remaining];
-	if (fread(buffer, 1, remaining, fp) != remaining) {
+	if (!reader.ReadFullAt(buffer, remaining, offset)) {
 		delete[] buffer;
 		return false;
 	}
@@ -103,11 +108,7 @@ ape_scan_internal(FILE *fp, ApeTagCallback callback)
 bool
 tag_ape_scan(Path path_fs, ApeTagCallback callback)
 {
-	FILE *fp = FOpen(path_fs, "rb");
-	if (fp == nullptr)
-		return false;
-
-	bool success = ape_scan_internal(fp, callback);
-	fclose(fp);
-	return success;
+	TagFileReader reader;
+	return reader.Open(path_fs, IgnoreError()) &&
+		tag_ape_scan(reader, callback);
 }
@@ -27,6 +27,7 @@
 #include <stddef.h>
 
 class Path;
+class TagFileReader;
 
 typedef std::function<bool(unsigned long flags, const char *key,
 			   const char *value,
@@ -42,4 +43,10 @@ typedef std::function<bool(unsigned long flags, const char *key,
 bool
 tag_ape_scan(Path path_fs, ApeTagCallback callback);
 
+/**
+ * Scans the APE tag values from a file which was already opened.
+ */
+bool
+tag_ape_scan(TagFileReader &reader, ApeTagCallback callback);
+
 #endif
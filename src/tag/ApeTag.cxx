@@ -23,7 +23,9 @@
 #include "Tag.hxx"
 #include "TagTable.hxx"
 #include "TagHandler.hxx"
+#include "TagFileReader.hxx"
 #include "fs/Path.hxx"
+#include "util/Error.hxx"
 
 #include <string>
 
@@ -105,7 +107,7 @@ tag_ape_import_item(unsigned long flags,
 }
 
 bool
-tag_ape_scan2(Path path_fs,
+tag_ape_scan2(TagFileReader &reader,
 	      const struct tag_handler *handler, void *handler_ctx)
 {
 	bool recognized = false;
@@ -120,5 +122,14 @@ tag_ape_scan2(Path path_fs,
 		return true;
 	};
 
-	return tag_ape_scan(path_fs, callback) && recognized;
+	return tag_ape_scan(reader, callback) && recognized;
+}
+
+bool
+tag_ape_scan2(Path path_fs,
+	      const struct tag_handler *handler, void *handler_ctx)
+{
+	TagFileReader reader;
+	return reader.Open(path_fs, IgnoreError()) &&
+		tag_ape_scan2(reader, handler, handler_ctx);
 }
@@ -0,0 +1,692 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Id3Scan.hxx"
+#include "TagFileReader.hxx"
+#include "TagHandler.hxx"
+#include "TagTable.hxx"
+#include "util/StringUtil.hxx"
+#include "Compiler.h"
+
+#include <id3tag.h>
+
+#include <memory>
+
+#include <assert.h>
+#include <string.h>
+
+/**
+ * The maximum number of recognized frames per tag; frames beyond
+ * that are ignored.
+ */
+static constexpr unsigned MAX_FRAMES = 64;
+
+/**
+ * Frame bodies up to this size are parsed in a stack buffer.
+ */
+static constexpr size_t STACK_BODY_SIZE = 4096;
+
+/**
+ * Larger frames are ignored.
+ */
+static constexpr size_t MAX_BODY_SIZE = 1024 * 1024;
+
+/**
+ * Larger pictures are ignored.
+ */
+static constexpr size_t MAX_PICTURE_SIZE = 16 * 1024 * 1024;
+
+enum class Id3FrameKind : uint8_t {
+	TEXT,
+	COMMENT,
+	TXXX,
+	UFID,
+	PICTURE,
+};
+
+struct Id3FrameType {
+	/** the ID3v2.3/2.4 frame id and the ID3v2.2 frame id */
+	const char *id, *id22;
+
+	Id3FrameKind kind;
+
+	TagType type;
+};
+
+/**
+ * The frames which are imported, in the order in which they are
+ * passed to the #tag_handler (the same order the libid3tag based
+ * scan_id3_tag() uses).
+ */
+static constexpr Id3FrameType id3_frame_types[] = {
+	{ "TPE1", "TP1", Id3FrameKind::TEXT, TAG_ARTIST },
+	{ "TPE2", "TP2", Id3FrameKind::TEXT, TAG_ALBUM_ARTIST },
+	{ "TSOP", "TSP", Id3FrameKind::TEXT, TAG_ARTIST_SORT },
+	{ "XSOP", nullptr, Id3FrameKind::TEXT, TAG_ARTIST_SORT },
+	{ "TSO2", "TS2", Id3FrameKind::TEXT, TAG_ALBUM_ARTIST_SORT },
+	{ "TIT2", "TT2", Id3FrameKind::TEXT, TAG_TITLE },
+	{ "TALB", "TAL", Id3FrameKind::TEXT, TAG_ALBUM },
+	{ "TRCK", "TRK", Id3FrameKind::TEXT, TAG_TRACK },
+	{ "TDRC", nullptr, Id3FrameKind::TEXT, TAG_DATE },
+	{ "TYER", "TYE", Id3FrameKind::TEXT, TAG_DATE },
+	{ "TCON", "TCO", Id3FrameKind::TEXT, TAG_GENRE },
+	{ "TCOM", "TCM", Id3FrameKind::TEXT, TAG_COMPOSER },
+	{ "TPE3", "TP3", Id3FrameKind::TEXT, TAG_PERFORMER },
+	{ "TPE4", "TP4", Id3FrameKind::TEXT, TAG_PERFORMER },
+	{ "COMM", "COM", Id3FrameKind::COMMENT, TAG_COMMENT },
+	{ "TPOS", "TPA", Id3FrameKind::TEXT, TAG_DISC },
+	{ "TXXX", "TXX", Id3FrameKind::TXXX, TAG_NUM_OF_ITEM_TYPES },
+	{ "UFID", "UFI", Id3FrameKind::UFID, TAG_MUSICBRAINZ_TRACKID },
+};
+
+static constexpr unsigned N_FRAME_TYPES =
+	sizeof(id3_frame_types) / sizeof(id3_frame_types[0]);
+
+/**
+ * The location of a recognized frame body.
+ */
+struct Id3FrameLocation {
+	uint64_t offset;
+	uint32_t size;
+
+	/** an index into the frame type table */
+	uint8_t type;
+
+	/** the ID3v2 major version of the tag */
+	uint8_t major;
+};
+
+static constexpr uint32_t
+ReadBE24(const uint8_t *p)
+{
+	return (uint32_t(p[0]) << 16) | (uint32_t(p[1]) << 8) | p[2];
+}
+
+static constexpr uint32_t
+ReadBE32(const uint8_t *p)
+{
+	return (uint32_t(p[0]) << 24) | ReadBE24(p + 1);
+}
+
+static constexpr uint32_t
+ReadSyncSafe32(const uint8_t *p)
+{
+	return (uint32_t(p[0] & 0x7f) << 21) | (uint32_t(p[1] & 0x7f) << 14) |
+		(uint32_t(p[2] & 0x7f) << 7) | (p[3] & 0x7f);
+}
+
+static int
+FindFrameType(const Id3FrameType *types, unsigned n_types,
+	      const uint8_t *id, unsigned major)
+{
+	for (unsigned i = 0; i < n_types; ++i) {
+		const auto &t = types[i];
+		if (major == 2
+		    ? t.id22 != nullptr && memcmp(id, t.id22, 3) == 0
+		    : memcmp(id, t.id, 4) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+static char *
+AppendUTF8(char *dest, unsigned ch)
+{
+	if (ch < 0x80) {
+		*dest++ = ch;
+	} else if (ch < 0x800) {
+		*dest++ = 0xc0 | (ch >> 6);
+		*dest++ = 0x80 | (ch & 0x3f);
+	} else if (ch < 0x10000) {
+		*dest++ = 0xe0 | (ch >> 12);
+		*dest++ = 0x80 | ((ch >> 6) & 0x3f);
+		*dest++ = 0x80 | (ch & 0x3f);
+	} else {
+		*dest++ = 0xf0 | (ch >> 18);
+		*dest++ = 0x80 | ((ch >> 12) & 0x3f);
+		*dest++ = 0x80 | ((ch >> 6) & 0x3f);
+		*dest++ = 0x80 | (ch & 0x3f);
+	}
+
+	return dest;
+}
+
+/**
+ * Cursor over the strings of a frame body.
+ */
+class Id3StringReader {
+	const uint8_t *p;
+	const uint8_t *const end;
+
+	/** the ID3 text encoding byte */
+	const uint8_t encoding;
+
+public:
+	Id3StringReader(const uint8_t *_p, const uint8_t *_end,
+			uint8_t _encoding)
+		:p(_p), end(_end), encoding(_encoding) {}
+
+	bool IsEmpty() const {
+		return p >= end;
+	}
+
+	void Skip(size_t n) {
+		p = size_t(end - p) > n ? p + n : end;
+	}
+
+	/**
+	 * Decode the next null-terminated string to UTF-8.
+	 *
+	 * @param dest a buffer which must be large enough for the
+	 * rest of the body (twice its size plus one)
+	 * @return the null-terminated UTF-8 string (in #dest)
+	 */
+	char *Next(char *dest);
+
+private:
+	char *NextUTF16(char *dest, bool big_endian);
+};
+
+char *
+Id3StringReader::NextUTF16(char *out, bool big_endian)
+{
+	char *const dest = out;
+	unsigned high_surrogate = 0;
+
+	while (end - p >= 2) {
+		unsigned ch = big_endian
+			? (unsigned(p[0]) << 8) | p[1]
+			: (unsigned(p[1]) << 8) | p[0];
+		p += 2;
+
+		if (ch == 0)
+			break;
+
+		if (ch == 0xfeff) {
+			/* a BOM inside a string list */
+			continue;
+		} else if (ch == 0xfffe) {
+			big_endian = !big_endian;
+			continue;
+		}
+
+		if (ch >= 0xd800 && ch < 0xdc00) {
+			high_surrogate = ch;
+			continue;
+		}
+
+		if (ch >= 0xdc00 && ch < 0xe000) {
+			if (high_surrogate == 0)
+				continue;
+
+			ch = 0x10000 + ((high_surrogate - 0xd800) << 10) +
+				(ch - 0xdc00);
+		}
+
+		high_surrogate = 0;
+		out = AppendUTF8(out, ch);
+	}
+
+	*out = 0;
+	return dest;
+}
+
+char *
+Id3StringReader::Next(char *dest)
+{
+	switch (encoding) {
+	case 0: /* ISO-8859-1 */
+		{
+			char *out = dest;
+			while (p < end && *p != 0)
+				out = AppendUTF8(out, *p++);
+			if (p < end)
+				++p;
+			*out = 0;
+		}
+
+		return dest;
+
+	case 1: /* UTF-16 with BOM */
+		return NextUTF16(dest, false);
+
+	case 2: /* UTF-16BE */
+		return NextUTF16(dest, true);
+
+	default: /* UTF-8 */
+		{
+			const uint8_t *n = (const uint8_t *)
+				memchr(p, 0, end - p);
+			const size_t length = (n != nullptr ? n : end) - p;
+			memcpy(dest, p, length);
+			dest[length] = 0;
+			p += length;
+			if (p < end)
+				++p;
+		}
+
+		return dest;
+	}
+}
+
+/**
+ * Resolve ID3v1 genre references such as "(17)" or "17".
+ *
+ * @param buffer a buffer for the genre name
+ */
+static const char *
+ResolveGenre(const char *value, char *buffer, size_t buffer_size)
+{
+	const char *p = value;
+	bool parenthesis = *p == '(';
+	if (parenthesis)
+		++p;
+
+	if (*p < '0' || *p > '9')
+		return value;
+
+	unsigned n = 0;
+	for (; *p >= '0' && *p <= '9'; ++p)
+		n = n * 10 + unsigned(*p - '0');
+
+	if (parenthesis ? *p != ')' : *p != 0)
+		return value;
+
+	if (parenthesis && p[1] != 0)
+		/* "(17)Rock": the refinement wins */
+		return p + 1;
+
+	const id3_ucs4_t *name = n < 256 ? id3_genre_index(n) : nullptr;
+	if (name == nullptr)
+		return value;
+
+	char *out = buffer, *const out_end = buffer + buffer_size - 5;
+	for (; *name != 0 && out < out_end; ++name)
+		out = AppendUTF8(out, *name);
+	*out = 0;
+	return buffer;
+}
+
+static void
+ImportText(Id3StringReader &r, char *buffer, TagType type,
+	   const tag_handler *handler, void *handler_ctx)
+{
+	while (!r.IsEmpty()) {
+		char *value = Strip(r.Next(buffer));
+		if (*value == 0)
+			continue;
+
+		char genre_buffer[64];
+		const char *v = type == TAG_GENRE
+			? ResolveGenre(value, genre_buffer,
+				       sizeof(genre_buffer))
+			: value;
+
+		tag_handler_invoke_tag(handler, handler_ctx, type, v);
+	}
+}
+
+/**
+ * Parse a TXXX name, and convert it to a TagType enum value.
+ * Returns TAG_NUM_OF_ITEM_TYPES if the TXXX name is not understood.
+ */
+static TagType
+ParseTxxxName(const char *name)
+{
+	static const struct tag_table txxx_tags[] = {
+		{ "ALBUMARTISTSORT", TAG_ALBUM_ARTIST_SORT },
+		{ "MusicBrainz Artist Id", TAG_MUSICBRAINZ_ARTISTID },
+		{ "MusicBrainz Album Id", TAG_MUSICBRAINZ_ALBUMID },
+		{ "MusicBrainz Album Artist Id",
+		  TAG_MUSICBRAINZ_ALBUMARTISTID },
+		{ "MusicBrainz Track Id", TAG_MUSICBRAINZ_TRACKID },
+		{ nullptr, TAG_NUM_OF_ITEM_TYPES }
+	};
+
+	return tag_table_lookup(txxx_tags, name);
+}
+
+static void
+ImportFrame(const Id3FrameType &t, const uint8_t *body, size_t size,
+	    char *buffer,
+	    const tag_handler *handler, void *handler_ctx)
+{
+	if (t.kind == Id3FrameKind::UFID) {
+		const uint8_t *n = (const uint8_t *)memchr(body, 0, size);
+		static constexpr char owner[] = "http://musicbrainz.org";
+		if (n == nullptr || size_t(n - body) != sizeof(owner) - 1 ||
+		    memcmp(body, owner, sizeof(owner) - 1) != 0 ||
+		    n + 1 == body + size)
+			return;
+
+		++n;
+		const size_t length = body + size - n;
+		memcpy(buffer, n, length);
+		buffer[length] = 0;
+		tag_handler_invoke_tag(handler, handler_ctx,
+				       TAG_MUSICBRAINZ_TRACKID, buffer);
+		return;
+	}
+
+	if (size < 1)
+		return;
+
+	Id3StringReader r(body + 1, body + size, body[0]);
+
+	switch (t.kind) {
+	case Id3FrameKind::TEXT:
+		ImportText(r, buffer, t.type, handler, handler_ctx);
+		break;
+
+	case Id3FrameKind::COMMENT:
+		{
+			/* skip the language and the short description,
+			   and import the full text */
+			r.Skip(3);
+			r.Next(buffer);
+			if (r.IsEmpty())
+				break;
+
+			char *value = Strip(r.Next(buffer));
+			if (*value != 0)
+				tag_handler_invoke_tag(handler, handler_ctx,
+						       t.type, value);
+		}
+
+		break;
+
+	case Id3FrameKind::TXXX:
+		{
+			/* the value is decoded right after the
+			   name */
+			const char *name = r.Next(buffer);
+			char *value = r.Next(buffer + strlen(name) + 1);
+
+			tag_handler_invoke_pair(handler, handler_ctx,
+						name, value);
+
+			TagType type = ParseTxxxName(name);
+			if (type != TAG_NUM_OF_ITEM_TYPES)
+				tag_handler_invoke_tag(handler, handler_ctx,
+						       type, value);
+		}
+
+		break;
+
+	case Id3FrameKind::UFID:
+	case Id3FrameKind::PICTURE:
+		assert(false);
+		gcc_unreachable();
+	}
+}
+
+/**
+ * Walk the frame headers of the ID3v2 tag at the given offset and
+ * remember where the frames of the given types are.
+ */
+static Id3ScanResult
+CollectFrames(TagFileReader &reader, uint64_t offset,
+	      const Id3FrameType *types, unsigned n_types,
+	      size_t max_body_size,
+	      Id3FrameLocation *frames, unsigned &n_frames)
+{
+	n_frames = 0;
+
+	uint8_t header[10];
+	if (!reader.ReadFullAt(header, sizeof(header), offset) ||
+	    memcmp(header, "ID3", 3) != 0 ||
+	    header[3] < 2 || header[3] > 4 || header[4] == 0xff ||
+	    (header[6] | header[7] | header[8] | header[9]) & 0x80)
+		return Id3ScanResult::NOT_FOUND;
+
+	const unsigned major = header[3];
+	const unsigned flags = header[5];
+
+	if (flags & 0x80)
+		/* whole-tag unsynchronisation */
+		return Id3ScanResult::UNSUPPORTED;
+
+	if (major == 2 && (flags & 0x40))
+		/* ID3v2.2 compression */
+		return Id3ScanResult::UNSUPPORTED;
+
+	uint64_t position = offset + sizeof(header);
+	const uint64_t end = position + ReadSyncSafe32(header + 6);
+
+	if (major > 2 && (flags & 0x40)) {
+		/* skip the extended header */
+		uint8_t ext[4];
+		if (!reader.ReadFullAt(ext, sizeof(ext), position))
+			return Id3ScanResult::UNSUPPORTED;
+
+		position += major == 3
+			? sizeof(ext) + ReadBE32(ext)
+			: ReadSyncSafe32(ext);
+	}
+
+	const size_t frame_header_size = major == 2 ? 6 : 10;
+	while (position + frame_header_size <= end) {
+		uint8_t fh[10];
+		if (!reader.ReadFullAt(fh, frame_header_size, position))
+			break;
+
+		if (fh[0] == 0)
+			/* padding */
+			break;
+
+		uint32_t size;
+		unsigned frame_flags = 0;
+		if (major == 2) {
+			size = ReadBE24(fh + 3);
+		} else {
+			size = major == 4
+				? ReadSyncSafe32(fh + 4)
+				: ReadBE32(fh + 4);
+			frame_flags = (fh[8] << 8) | fh[9];
+		}
+
+		position += frame_header_size;
+		if (size > end - position)
+			break;
+
+		if (major > 2 && memcmp(fh, "SEEK", 4) == 0)
+			return Id3ScanResult::UNSUPPORTED;
+
+		const int type = FindFrameType(types, n_types, fh, major);
+		if (type >= 0 && n_frames < MAX_FRAMES) {
+			uint64_t body = position;
+			uint32_t body_size = size;
+
+			/* v2.3: compression 0x80, encryption 0x40,
+			   grouping 0x20; v2.4: grouping 0x40,
+			   compression 0x08, encryption 0x04,
+			   unsynchronisation 0x02, data length 0x01 */
+			if (major == 3 && (frame_flags & 0xc0))
+				return Id3ScanResult::UNSUPPORTED;
+			if (major == 4 && (frame_flags & 0x0e))
+				return Id3ScanResult::UNSUPPORTED;
+
+			const unsigned extra =
+				(major == 3 && (frame_flags & 0x20)) ||
+				(major == 4 && (frame_flags & 0x40))
+				? 1 : 0;
+			const unsigned dli =
+				major == 4 && (frame_flags & 0x01) ? 4 : 0;
+			if (body_size < extra + dli)
+				break;
+
+			body += extra + dli;
+			body_size -= extra + dli;
+
+			if (body_size > 0 && body_size <= max_body_size)
+				frames[n_frames++] = {
+					body, body_size, uint8_t(type),
+					uint8_t(major),
+				};
+		}
+
+		position += size;
+	}
+
+	return Id3ScanResult::OK;
+}
+
+Id3ScanResult
+id3v2_scan(TagFileReader &reader, uint64_t offset,
+	   const tag_handler *handler, void *handler_ctx)
+{
+	/* pass 1: walk the frame headers and remember where the
+	   recognized frames are */
+
+	Id3FrameLocation frames[MAX_FRAMES];
+	unsigned n_frames;
+	const Id3ScanResult result =
+		CollectFrames(reader, offset,
+			      id3_frame_types, N_FRAME_TYPES, MAX_BODY_SIZE,
+			      frames, n_frames);
+	if (result != Id3ScanResult::OK)
+		return result;
+
+	/* pass 2: read and import the recognized frames in the
+	   order of id3_frame_types */
+
+	uint8_t stack_body[STACK_BODY_SIZE];
+	char stack_buffer[STACK_BODY_SIZE * 2 + 2];
+	std::unique_ptr<uint8_t[]> heap_body;
+	std::unique_ptr<char[]> heap_buffer;
+
+	for (unsigned t = 0; t < N_FRAME_TYPES; ++t) {
+		for (unsigned i = 0; i < n_frames; ++i) {
+			const auto &f = frames[i];
+			if (f.type != t)
+				continue;
+
+			uint8_t *body = stack_body;
+			char *buffer = stack_buffer;
+			if (f.size > STACK_BODY_SIZE) {
+				heap_body.reset(new uint8_t[f.size]);
+				heap_buffer.reset(new char[f.size * 2 + 2]);
+				body = heap_body.get();
+				buffer = heap_buffer.get();
+			}
+
+			if (!reader.ReadFullAt(body, f.size, f.offset))
+				continue;
+
+			ImportFrame(id3_frame_types[t], body, f.size, buffer,
+				    handler, handler_ctx);
+		}
+	}
+
+	return Id3ScanResult::OK;
+}
+
+/**
+ * Skip a null-terminated string in the given ID3 text encoding.
+ *
+ * @return the position after the terminator, or nullptr if there is
+ * none
+ */
+static const uint8_t *
+SkipId3String(const uint8_t *p, const uint8_t *end, uint8_t encoding)
+{
+	if (encoding == 1 || encoding == 2) {
+		for (; end - p >= 2; p += 2)
+			if (p[0] == 0 && p[1] == 0)
+				return p + 2;
+
+		return nullptr;
+	}
+
+	p = (const uint8_t *)memchr(p, 0, end - p);
+	return p != nullptr ? p + 1 : nullptr;
+}
+
+bool
+id3v2_find_picture(TagFileReader &reader, uint64_t offset,
+		   std::string &mime_type, std::string &data)
+{
+	static constexpr Id3FrameType picture_types[] = {
+		{ "APIC", "PIC", Id3FrameKind::PICTURE,
+		  TAG_NUM_OF_ITEM_TYPES },
+	};
+
+	Id3FrameLocation frames[MAX_FRAMES];
+	unsigned n_frames;
+	CollectFrames(reader, offset, picture_types, 1, MAX_PICTURE_SIZE,
+		      frames, n_frames);
+
+	bool found = false;
+	for (unsigned i = 0; i < n_frames; ++i) {
+		const auto &f = frames[i];
+
+		std::unique_ptr<uint8_t[]> body(new uint8_t[f.size]);
+		if (!reader.ReadFullAt(body.get(), f.size, f.offset))
+			continue;
+
+		const uint8_t *p = body.get(), *const end = p + f.size;
+		const uint8_t encoding = *p++;
+
+		/* the MIME type; ID3v2.2 has a three letter image
+		   format instead */
+		std::string mime;
+		if (f.major == 2) {
+			if (end - p < 3)
+				continue;
+
+			mime = memcmp(p, "PNG", 3) == 0
+				? "image/png"
+				: "image/jpeg";
+			p += 3;
+		} else {
+			const uint8_t *n = SkipId3String(p, end, 0);
+			if (n == nullptr)
+				continue;
+
+			mime.assign((const char *)p, n - 1 - p);
+			p = n;
+		}
+
+		if (p >= end)
+			continue;
+
+		const uint8_t picture_type = *p++;
+
+		p = SkipId3String(p, end, encoding);
+		if (p == nullptr)
+			continue;
+
+		if (found && picture_type != 3)
+			/* we already have one, and this one is not a
+			   front cover */
+			continue;
+
+		mime_type = std::move(mime);
+		data.assign((const char *)p, end - p);
+		found = true;
+
+		if (picture_type == 3)
+			/* front cover: this is the best one */
+			break;
+	}
+
+	return found;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/** \file
+ *
+ * A light-weight ID3v2.2 to ID3v2.4 parser which extracts only the
+ * frames MPD understands, without building a libid3tag object tree.
+ */
+
+#ifndef MPD_ID3_SCAN_HXX
+#define MPD_ID3_SCAN_HXX
+
+#include "check.h"
+
+#include <string>
+
+#include <stdint.h>
+
+class TagFileReader;
+struct tag_handler;
+
+enum class Id3ScanResult {
+	/**
+	 * There is no ID3v2 tag at the given offset.
+	 */
+	NOT_FOUND,
+
+	/**
+	 * The tag was scanned successfully.
+	 */
+	OK,
+
+	/**
+	 * The tag uses features this parser does not implement
+	 * (unsynchronisation, compression, encryption, SEEK frames);
+	 * no handler method has been invoked, and the caller should
+	 * use libid3tag.
+	 */
+	UNSUPPORTED,
+};
+
+/**
+ * Scan the ID3v2 tag at the given offset.  Frame headers are read
+ * first, and only the bodies of recognized frames are read;
+ * pictures and other large frames are skipped.
+ */
+Id3ScanResult
+id3v2_scan(TagFileReader &reader, uint64_t offset,
+	   const tag_handler *handler, void *handler_ctx);
+
+/**
+ * Find an attached picture (APIC frame) in the ID3v2 tag at the
+ * given offset.  The front cover is preferred, otherwise the first
+ * picture is used.
+ *
+ * @return false if there is no (supported) picture
+ */
+bool
+id3v2_find_picture(TagFileReader &reader, uint64_t offset,
+		   std::string &mime_type, std::string &data);
+
+#endif
@@ -19,18 +19,14 @@
 
 #include "config.h" /* must be first for large file support */
 #include "Riff.hxx"
-#include "util/Domain.hxx"
+#include "TagFileReader.hxx"
 #include "system/ByteOrder.hxx"
-#include "Log.hxx"
 
 #include <limits>
 
 #include <stdint.h>
-#include <sys/stat.h>
 #include <string.h>
 
-static constexpr Domain riff_domain("riff");
-
 struct riff_header {
 	char id[4];
 	uint32_t size;
@@ -43,40 +39,28 @@ struct riff_chunk_header {
 };
 
 size_t
-riff_seek_id3(FILE *file)
+riff_find_id3(TagFileReader &reader, uint64_t &offset_r)
 {
-	/* determine the file size */
-
-	struct stat st;
-	if (fstat(fileno(file), &st) < 0) {
-		LogErrno(riff_domain, "Failed to stat file descriptor");
-		return 0;
-	}
-
-	/* seek to the beginning and read the RIFF header */
-
-	if (fseek(file, 0, SEEK_SET) != 0) {
-		LogErrno(riff_domain, "Failed to seek");
-		return 0;
-	}
+	/* read the RIFF header */
 
 	riff_header header;
-	size_t size = fread(&header, sizeof(header), 1, file);
-	if (size != 1 ||
+	if (!reader.ReadFullAt(&header, sizeof(header), 0) ||
 	    memcmp(header.id, "RIFF", 4) != 0 ||
-	    FromLE32(header.size) > (uint32_t)st.st_size)
+	    FromLE32(header.size) > reader.GetSize())
 		/* not a RIFF file */
 		return 0;
 
+	uint64_t offset = sizeof(header);
 	while (true) {
 		/* read the chunk header */
 
 		riff_chunk_header chunk;
-		size = fread(&chunk, sizeof(chunk), 1, file);
-		if (size != 1)
+		if (!reader.ReadFullAt(&chunk, sizeof(chunk), offset))
 			return 0;
 
-		size = FromLE32(chunk.size);
+		offset += sizeof(chunk);
+
+		size_t size = FromLE32(chunk.size);
 		if (size > size_t(std::numeric_limits<int>::max()))
 			/* too dangerous, bail out: possible integer
 			   underflow when casting to off_t */
@@ -87,11 +71,12 @@ riff_seek_id3(FILE *file)
 			++size;
 
 		if (memcmp(chunk.id, "id3 ", 4) == 0 ||
-		    memcmp(chunk.id, "ID3 ", 4) == 0)
+		    memcmp(chunk.id, "ID3 ", 4) == 0) {
 			/* found it! */
+			offset_r = offset;
 			return size;
+		}
 
-		if (fseek(file, size, SEEK_CUR) != 0)
-			return 0;
+		offset += size;
 	}
 }
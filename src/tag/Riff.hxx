@@ -26,15 +26,19 @@
 #define MPD_RIFF_HXX
 
 #include <stddef.h>
-#include <stdio.h>
+#include <stdint.h>
+
+class TagFileReader;
 
 /**
- * Seeks the RIFF file to the ID3 chunk.
+ * Finds the ID3 chunk in the RIFF file.
  *
+ * @param offset_r on success, receives the file offset of the ID3
+ * chunk
  * @return the size of the ID3 chunk on success, or 0 if this is not a
  * RIFF file or no ID3 chunk was found
  */
 size_t
-riff_seek_id3(FILE *file);
+riff_find_id3(TagFileReader &reader, uint64_t &offset_r);
 
 #endif
@@ -18,22 +18,39 @@
  */
 
 #include "Set.hxx"
-#include "TagBuilder.hxx"
+#include "TagPool.hxx"
+#include "TagSettings.h"
+
+#include <algorithm>
 
 #include <assert.h>
+#include <string.h>
+
+/**
+ * Append a #TagSet::Key, applying the same rules as
+ * TagBuilder::AddItem().
+ */
+template<typename K>
+static void
+AddKey(std::vector<K> &v, TagType type, const char *value)
+{
+	if (*value != 0 && !ignore_tag_items[type])
+		v.push_back({type, value});
+}
 
 /**
- * Copy all tag items of the specified type.
+ * Collect all tag items of the specified type.
  */
+template<typename K>
 static bool
-CopyTagItem(TagBuilder &dest, TagType dest_type,
+CopyTagItem(std::vector<K> &dest, TagType dest_type,
 	    const Tag &src, TagType src_type)
 {
 	bool found = false;
 
 	for (const auto &item : src) {
 		if (item.type == src_type) {
-			dest.AddItem(dest_type, item.value);
+			AddKey(dest, dest_type, item.value);
 			found = true;
 		}
 	}
@@ -42,11 +59,12 @@ CopyTagItem(TagBuilder &dest, TagType dest_type,
 }
 
 /**
- * Copy all tag items of the specified type.  Fall back to "Artist" if
- * there is no "AlbumArtist".
+ * Collect all tag items of the specified type.  Fall back to
+ * "Artist" if there is no "AlbumArtist".
  */
+template<typename K>
 static void
-CopyTagItem(TagBuilder &dest, const Tag &src, TagType type)
+CopyTagItem(std::vector<K> &dest, const Tag &src, TagType type)
 {
 	if (!CopyTagItem(dest, type, src, type) &&
 	    type == TAG_ALBUM_ARTIST)
@@ -54,43 +72,125 @@ CopyTagItem(TagBuilder &dest, const Tag &src, TagType type)
 }
 
 /**
- * Copy all tag items of the types in the mask.
+ * Collect all tag items of the types in the mask.
  */
+template<typename K>
 static void
-CopyTagMask(TagBuilder &dest, const Tag &src, uint32_t mask)
+CopyTagMask(std::vector<K> &dest, const Tag &src, uint32_t mask)
 {
 	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
 		if ((mask & (1u << i)) != 0)
 			CopyTagItem(dest, src, TagType(i));
 }
 
+gcc_pure
+static unsigned
+HashItem(unsigned hash, TagType type, const char *value)
+{
+	hash = (hash << 5) + hash + unsigned(type);
+
+	while (*value != 0)
+		hash = (hash << 5) + hash + (unsigned char)*value++;
+
+	return hash;
+}
+
+TagSet::~TagSet()
+{
+	const ScopeLock protect(tag_pool_lock);
+	for (auto i : items)
+		if (i != nullptr)
+			tag_pool_put_item(i);
+}
+
+inline bool
+TagSet::Equals(const Entry &entry) const
+{
+	if (entry.length != key.size())
+		return false;
+
+	for (unsigned i = 0; i < entry.length; ++i) {
+		const TagItem &item = *items[entry.begin + i];
+		if (item.type != key[i].type ||
+		    strcmp(item.value, key[i].value) != 0)
+			return false;
+	}
+
+	return true;
+}
+
 void
-TagSet::InsertUnique(const Tag &src, TagType type, const char *value,
-		     uint32_t group_mask)
+TagSet::Grow()
 {
-	TagBuilder builder;
+	const size_t size = buckets.empty() ? 64 : buckets.size() * 2;
+	const size_t mask = size - 1;
+
+	buckets.assign(size, 0);
+	for (unsigned i = 0; i < entries.size(); ++i) {
+		size_t b = entries[i].hash & mask;
+		while (buckets[b] != 0)
+			b = (b + 1) & mask;
+		buckets[b] = i + 1;
+	}
+}
+
+void
+TagSet::InsertKey()
+{
+	unsigned hash = 5381;
+	for (const auto &k : key)
+		hash = HashItem(hash, k.type, k.value);
+
+	/* keep the load factor below 1/2 */
+	if ((entries.size() + 1) * 2 > buckets.size())
+		Grow();
+
+	const size_t mask = buckets.size() - 1;
+	size_t b = hash & mask;
+	for (; buckets[b] != 0; b = (b + 1) & mask) {
+		const Entry &entry = entries[buckets[b] - 1];
+		if (entry.hash == hash && Equals(entry))
+			return;
+	}
+
+	/* a new combination: reference the items in the #TagPool */
+
+	const Entry entry{unsigned(items.size()),
+			(unsigned short)key.size(), hash};
+
+	tag_pool_lock.lock();
+	for (const auto &k : key)
+		items.push_back(tag_pool_get_item(k.type, k.value,
+						  strlen(k.value)));
+	tag_pool_lock.unlock();
+
+	entries.push_back(entry);
+	buckets[b] = entries.size();
+}
+
+void
+TagSet::InsertUnique(TagType type, const char *value)
+{
+	key.clear();
 	if (value == nullptr)
-		builder.AddEmptyItem(type);
+		/* like TagBuilder::AddEmptyItem() */
+		key.push_back({type, ""});
 	else
-		builder.AddItem(type, value);
-	CopyTagMask(builder, src, group_mask);
-#if defined(__clang__) || GCC_CHECK_VERSION(4,8)
-	emplace(builder.Commit());
-#else
-	insert(builder.Commit());
-#endif
+		AddKey(key, type, value);
+	key.insert(key.end(), group.begin(), group.end());
+
+	InsertKey();
 }
 
 bool
 TagSet::CheckUnique(TagType dest_type,
-		    const Tag &tag, TagType src_type,
-		    uint32_t group_mask)
+		    const Tag &tag, TagType src_type)
 {
 	bool found = false;
 
 	for (const auto &item : tag) {
 		if (item.type == src_type) {
-			InsertUnique(tag, dest_type, item.value, group_mask);
+			InsertUnique(dest_type, item.value);
 			found = true;
 		}
 	}
@@ -107,9 +207,68 @@ TagSet::InsertUnique(const Tag &tag,
 
 	assert((group_mask & (1u << unsigned(type))) == 0);
 
-	if (!CheckUnique(type, tag, type, group_mask) &&
+	/* the group items are the same for all values of this
+	   song */
+	group.clear();
+	CopyTagMask(group, tag, group_mask);
+
+	if (!CheckUnique(type, tag, type) &&
 	    (type != TAG_ALBUM_ARTIST ||
 	     /* fall back to "Artist" if no "AlbumArtist" was found */
-	     !CheckUnique(type, tag, TAG_ARTIST, group_mask)))
-		InsertUnique(tag, type, nullptr, group_mask);
+	     !CheckUnique(type, tag, TAG_ARTIST)))
+		InsertUnique(type, nullptr);
+}
+
+inline bool
+TagSet::Less(const Entry &a, const Entry &b) const
+{
+	/* the same order as the std::set<Tag> which was used
+	   previously */
+
+	if (a.length != b.length)
+		return a.length < b.length;
+
+	for (unsigned i = 0; i < a.length; ++i) {
+		const TagItem &ai = *items[a.begin + i];
+		const TagItem &bi = *items[b.begin + i];
+		if (ai.type != bi.type)
+			return unsigned(ai.type) < unsigned(bi.type);
+
+		const int cmp = strcmp(ai.value, bi.value);
+		if (cmp != 0)
+			return cmp < 0;
+	}
+
+	return false;
+}
+
+void
+TagSet::Sort()
+{
+	/* the hash table refers to positions in #entries, which
+	   are about to change */
+	buckets.clear();
+
+	std::sort(entries.begin(), entries.end(),
+		  [this](const Entry &a, const Entry &b){
+			  return Less(a, b);
+		  });
+}
+
+void
+TagSet::Export(const Entry &entry, Tag &tag)
+{
+	assert(tag.IsEmpty());
+
+	/* move the references to the Tag, just like
+	   TagBuilder::Commit() */
+	tag.num_items = entry.length;
+	tag_pool_lock.lock();
+	tag.items = tag_pool_alloc_items(entry.length);
+	tag_pool_lock.unlock();
+
+	auto i = std::next(items.begin(), entry.begin);
+	std::copy_n(i, entry.length, tag.items);
+	std::fill_n(i, entry.length, nullptr);
+	tag.UpdateNumbers();
 }
@@ -23,51 +23,107 @@
 #include "Compiler.h"
 #include "Tag.hxx"
 
-#include <set>
+#include <vector>
 
-#include <string.h>
 #include <stdint.h>
 
 /**
- * Helper class for #TagSet which compares two #Tag objects.
+ * A set of distinct #Tag value combinations, collected by
+ * VisitUniqueTags().  Instead of a deep #Tag copy in a tree node per
+ * entry, it keeps references to #TagPool items in one flat array,
+ * detects duplicates with an open addressing hash table, and sorts
+ * only once, in VisitSorted().
  */
-struct TagLess {
-	gcc_pure
-	bool operator()(const Tag &a, const Tag &b) const {
-		if (a.num_items != b.num_items)
-			return a.num_items < b.num_items;
-
-		const unsigned n = a.num_items;
-		for (unsigned i = 0; i < n; ++i) {
-			const TagItem &ai = *a.items[i];
-			const TagItem &bi = *b.items[i];
-			if (ai.type != bi.type)
-				return unsigned(ai.type) < unsigned(bi.type);
-
-			const int cmp = strcmp(ai.value, bi.value);
-			if (cmp != 0)
-				return cmp < 0;
-		}
+class TagSet {
+	struct Key {
+		TagType type;
+		const char *value;
+	};
 
-		return false;
-	}
-};
+	struct Entry {
+		/**
+		 * The position of the first item in #items.
+		 */
+		unsigned begin;
+
+		unsigned short length;
+
+		unsigned hash;
+	};
+
+	/**
+	 * The items of all entries, one range per entry.  Each
+	 * pointer holds a #TagPool reference; it is moved to the
+	 * #Tag passed to the visitor, and replaced with nullptr.
+	 */
+	std::vector<TagItem *> items;
+
+	std::vector<Entry> entries;
+
+	/**
+	 * The hash table; each bucket is an index into #entries plus
+	 * one, or 0 if it is empty.  Its size is a power of two.
+	 */
+	std::vector<unsigned> buckets;
+
+	/**
+	 * Buffers for InsertUnique(), allocated only once.
+	 */
+	std::vector<Key> key, group;
 
-/**
- * A set of #Tag objects.
- */
-class TagSet : public std::set<Tag, TagLess> {
 public:
+	TagSet() = default;
+	TagSet(const TagSet &) = delete;
+	TagSet &operator=(const TagSet &) = delete;
+
+	~TagSet();
+
 	void InsertUnique(const Tag &tag,
 			  TagType type, uint32_t group_mask);
 
+	/**
+	 * Sort all entries and pass each one to the given function
+	 * as a #Tag.  This can be done only once, because the
+	 * #TagPool references are moved to the #Tag objects.
+	 *
+	 * @param f a function which returns false to stop
+	 */
+	template<typename F>
+	bool VisitSorted(F &&f) {
+		Sort();
+
+		for (const auto &entry : entries) {
+			Tag tag;
+			Export(entry, tag);
+			if (!f(tag))
+				return false;
+		}
+
+		return true;
+	}
+
 private:
-	void InsertUnique(const Tag &src, TagType type, const char *value,
-			  uint32_t group_mask);
+	void InsertUnique(TagType type, const char *value);
 
 	bool CheckUnique(TagType dest_type,
-			 const Tag &tag, TagType src_type,
-			 uint32_t group_mask);
+			 const Tag &tag, TagType src_type);
+
+	/**
+	 * Insert the combination in #key unless it exists already.
+	 */
+	void InsertKey();
+
+	gcc_pure
+	bool Equals(const Entry &entry) const;
+
+	gcc_pure
+	bool Less(const Entry &a, const Entry &b) const;
+
+	void Grow();
+
+	void Sort();
+
+	void Export(const Entry &entry, Tag &tag);
 };
 
 #endif
@@ -24,6 +24,7 @@
 #include "TagSettings.h"
 #include "TagBuilder.hxx"
 #include "util/ASCII.hxx"
+#include "util/VarSize.hxx"
 
 #include <assert.h>
 #include <string.h>
@@ -64,31 +65,200 @@ Tag::Clear()
 	time = -1;
 	has_playlist = false;
 
-	tag_pool_lock.lock();
-	for (unsigned i = 0; i < num_items; ++i)
-		tag_pool_put_item(items[i]);
-	tag_pool_lock.unlock();
+	if (grouped) {
+		if (shared->ref.Decrement()) {
+			const unsigned n_own =
+				num_items - shared->group->num_items;
+
+			tag_pool_lock.lock();
+			for (unsigned i = 0; i < n_own; ++i)
+				tag_pool_put_item(shared->items[i]);
+			tag_group_put(shared->group);
+			tag_pool_lock.unlock();
+
+			DeleteVarSize(shared);
+		}
+
+		grouped = false;
+	} else {
+		tag_pool_lock.lock();
+		for (unsigned i = 0; i < num_items; ++i)
+			tag_pool_put_item(items[i]);
+		tag_pool_free_items(items, num_items);
+		tag_pool_lock.unlock();
+	}
 
-	delete[] items;
 	items = nullptr;
 	num_items = 0;
+	track = disc = year = 0;
+}
+
+/**
+ * Parse the leading decimal number of a tag value, e.g. "3" of
+ * "3/12" or "1994" of "1994-05-01".
+ *
+ * @return the number (clamped to 65535), or 0 if the value does not
+ * begin with a digit
+ */
+gcc_pure
+static uint16_t
+ParseTagNumber(const char *p)
+{
+	while (*p == ' ')
+		++p;
+
+	unsigned n = 0;
+	for (; *p >= '0' && *p <= '9'; ++p) {
+		n = n * 10 + unsigned(*p - '0');
+		if (n > 0xffff)
+			return 0xffff;
+	}
+
+	return n;
+}
+
+void
+Tag::UpdateNumbers()
+{
+	track = disc = year = 0;
+
+	bool have_track = false, have_disc = false, have_date = false;
+	for (const auto &item : *this) {
+		switch (item.type) {
+		case TAG_TRACK:
+			if (!have_track) {
+				track = ParseTagNumber(item.value);
+				have_track = true;
+			}
+
+			break;
+
+		case TAG_DISC:
+			if (!have_disc) {
+				disc = ParseTagNumber(item.value);
+				have_disc = true;
+			}
+
+			break;
+
+		case TAG_DATE:
+			if (!have_date) {
+				year = ParseTagNumber(item.value);
+				have_date = true;
+			}
+
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
+static TagSharedItems *
+NewSharedItems(unsigned n_own)
+{
+	TagSharedItems *dummy;
+	return NewVarSize<TagSharedItems>(sizeof(dummy->items),
+					  n_own * sizeof(dummy->items[0]));
 }
 
 Tag::Tag(const Tag &other)
 	:time(other.time), has_playlist(other.has_playlist),
+	 grouped(other.grouped),
 	 num_items(other.num_items),
+	 track(other.track), disc(other.disc), year(other.year),
 	 items(nullptr)
 {
-	if (num_items > 0) {
-		items = new TagItem *[num_items];
-
+	if (grouped) {
+		/* the shared items are immutable; just add a
+		   reference */
+		shared = other.shared;
+		shared->ref.Increment();
+	} else if (num_items > 0) {
 		tag_pool_lock.lock();
+		items = tag_pool_alloc_items(num_items);
 		for (unsigned i = 0; i < num_items; i++)
 			items[i] = tag_pool_dup_item(other.items[i]);
 		tag_pool_lock.unlock();
 	}
 }
 
+/**
+ * Copy the items of an ungrouped #Tag which qualify for a #TagGroup
+ * to the given array, and set the corresponding bits in the mask.
+ *
+ * @return the number of items copied
+ */
+static unsigned
+tag_split_shared(const Tag &tag, TagItem **dest, uint32_t &mask)
+{
+	assert(!tag.grouped);
+	assert(tag.num_items <= 32);
+
+	unsigned n = 0;
+	mask = 0;
+
+	for (unsigned i = 0; i < tag.num_items; ++i) {
+		if (tag_group_type(tag.items[i]->type)) {
+			mask |= uint32_t(1) << i;
+			dest[n++] = tag.items[i];
+		}
+	}
+
+	return n;
+}
+
+void
+Tag::ShareWith(const Tag &other)
+{
+	if (grouped || num_items > 32)
+		return;
+
+	TagItem *group_items[32];
+	uint32_t mask;
+	const unsigned n_group = tag_split_shared(*this, group_items, mask);
+
+	/* a group with a single item would not save anything */
+	if (n_group < 2)
+		return;
+
+	if (other.grouped) {
+		const TagGroup &other_group = *other.shared->group;
+		if (other_group.mask != mask ||
+		    !tag_group_items_equal(group_items, other_group.items,
+					   n_group))
+			return;
+	} else {
+		if (other.num_items > 32)
+			return;
+
+		TagItem *other_items[32];
+		uint32_t other_mask;
+		if (tag_split_shared(other, other_items, other_mask) != n_group ||
+		    other_mask != mask ||
+		    !tag_group_items_equal(group_items, other_items, n_group))
+			return;
+	}
+
+	TagSharedItems *new_shared = NewSharedItems(num_items - n_group);
+	for (unsigned i = 0, n = 0; i < num_items; ++i)
+		if ((mask & (uint32_t(1) << i)) == 0)
+			new_shared->items[n++] = items[i];
+
+	tag_pool_lock.lock();
+	new_shared->group = other.grouped
+		? tag_group_dup(other.shared->group)
+		: tag_group_get(mask, group_items, n_group);
+	for (unsigned i = 0; i < n_group; ++i)
+		tag_pool_put_item(group_items[i]);
+	tag_pool_free_items(items, num_items);
+	tag_pool_lock.unlock();
+
+	shared = new_shared;
+	grouped = true;
+}
+
 Tag *
 Tag::Merge(const Tag &base, const Tag &add)
 {
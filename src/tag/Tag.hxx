@@ -22,12 +22,14 @@
 
 #include "TagType.h" // IWYU pragma: export
 #include "TagItem.hxx" // IWYU pragma: export
+#include "TagGroup.hxx"
 #include "Compiler.h"
 
 #include <algorithm>
 #include <iterator>
 
 #include <stddef.h>
+#include <stdint.h>
 
 /**
  * The meta information about a song file.  It is a MPD specific
@@ -48,25 +50,49 @@ struct Tag {
 	 */
 	bool has_playlist;
 
-	/** the total number of tag items in the #items array */
+	/**
+	 * Are some items in a #TagGroup (see ShareWith())?  Then
+	 * #shared is used instead of #items, and copies of this
+	 * object share it by reference count.
+	 */
+	bool grouped;
+
+	/** the total number of tag items, including the #TagGroup */
 	unsigned short num_items;
 
-	/** an array of tag items */
-	TagItem **items;
+	/**
+	 * The numeric values of the first #TAG_TRACK and #TAG_DISC
+	 * item and the year of the first #TAG_DATE item, parsed once
+	 * by UpdateNumbers() so sorting and range filters don't need
+	 * to parse strings.  Zero means missing or not a number.
+	 */
+	uint16_t track, disc, year;
+
+	union {
+		/** an array of tag items */
+		TagItem **items;
+
+		TagSharedItems *shared;
+	};
 
 	/**
 	 * Create an empty tag.
 	 */
-	Tag():time(-1), has_playlist(false),
-	      num_items(0), items(nullptr) {}
+	Tag():time(-1), has_playlist(false), grouped(false),
+	      num_items(0), track(0), disc(0), year(0), items(nullptr) {}
 
 	Tag(const Tag &other);
 
 	Tag(Tag &&other)
 		:time(other.time), has_playlist(other.has_playlist),
-		 num_items(other.num_items), items(other.items) {
+		 grouped(other.grouped),
+		 num_items(other.num_items),
+		 track(other.track), disc(other.disc), year(other.year),
+		 items(other.items) {
 		other.items = nullptr;
+		other.grouped = false;
 		other.num_items = 0;
+		other.track = other.disc = other.year = 0;
 	}
 
 	/**
@@ -82,7 +108,11 @@ struct Tag {
 		time = other.time;
 		has_playlist = other.has_playlist;
 		std::swap(items, other.items);
+		std::swap(grouped, other.grouped);
 		std::swap(num_items, other.num_items);
+		std::swap(track, other.track);
+		std::swap(disc, other.disc);
+		std::swap(year, other.year);
 		return *this;
 	}
 
@@ -106,6 +136,71 @@ struct Tag {
 	 */
 	void Clear();
 
+	/**
+	 * If this object and the given one have the same items which
+	 * are likely to be the same in many songs (see
+	 * tag_group_type()), move them to a #TagGroup shared by both.
+	 * Only this object is modified; if the other one is not in a
+	 * group yet, a new group is created for this one only, and
+	 * the next caller can join it.  This saves memory in large
+	 * databases.  It does not change the order of items.
+	 */
+	void ShareWith(const Tag &other);
+
+	/**
+	 * Parse the numeric tag items into #track, #disc and #year.
+	 * Must be called after the items have been modified.
+	 */
+	void UpdateNumbers();
+
+	/**
+	 * Does the given tag type have a numeric value (see
+	 * GetNumber())?
+	 */
+	gcc_const
+	static bool IsNumberType(TagType type) {
+		return type == TAG_TRACK || type == TAG_DISC ||
+			type == TAG_DATE;
+	}
+
+	/**
+	 * Returns the numeric value of the given tag type (the year
+	 * for #TAG_DATE), or zero if the tag is missing, is not a
+	 * number or is not a numeric type.
+	 */
+	gcc_pure
+	unsigned GetNumber(TagType type) const {
+		switch (type) {
+		case TAG_TRACK:
+			return track;
+
+		case TAG_DISC:
+			return disc;
+
+		case TAG_DATE:
+			return year;
+
+		default:
+			return 0;
+		}
+	}
+
+	/**
+	 * Returns the item at the given position (0 to #num_items-1).
+	 */
+	gcc_pure
+	const TagItem &GetItem(unsigned i) const {
+		if (!grouped)
+			return *items[i];
+
+		const TagGroup &group = *shared->group;
+		const uint32_t bit = uint32_t(1) << i;
+		const unsigned n = __builtin_popcount(group.mask & (bit - 1));
+		return (group.mask & bit) != 0
+			? *group.items[n]
+			: *shared->items[i - n];
+	}
+
 	/**
 	 * Merges the data from two tags.  If both tags share data for the
 	 * same TagType, only data from "add" is used.
@@ -140,55 +235,54 @@ struct Tag {
 
 	class const_iterator {
 		friend struct Tag;
-		const TagItem *const*cursor;
+		const Tag *tag;
+		unsigned i;
 
-		constexpr const_iterator(const TagItem *const*_cursor)
-			:cursor(_cursor) {}
+		constexpr const_iterator(const Tag *_tag, unsigned _i)
+			:tag(_tag), i(_i) {}
 
 	public:
-		constexpr const TagItem &operator*() const {
-			return **cursor;
+		const TagItem &operator*() const {
+			return tag->GetItem(i);
 		}
 
-		constexpr const TagItem *operator->() const {
-			return *cursor;
+		const TagItem *operator->() const {
+			return &tag->GetItem(i);
 		}
 
 		const_iterator &operator++() {
-			++cursor;
+			++i;
 			return *this;
 		}
 
 		const_iterator operator++(int) {
-			auto result = cursor++;
-			return const_iterator{result};
+			return const_iterator{tag, i++};
 		}
 
 		const_iterator &operator--() {
-			--cursor;
+			--i;
 			return *this;
 		}
 
 		const_iterator operator--(int) {
-			auto result = cursor--;
-			return const_iterator{result};
+			return const_iterator{tag, i--};
 		}
 
 		constexpr bool operator==(const_iterator other) const {
-			return cursor == other.cursor;
+			return i == other.i;
 		}
 
 		constexpr bool operator!=(const_iterator other) const {
-			return cursor != other.cursor;
+			return i != other.i;
 		}
 	};
 
 	const_iterator begin() const {
-		return const_iterator{items};
+		return const_iterator{this, 0};
 	}
 
 	const_iterator end() const {
-		return const_iterator{items + num_items};
+		return const_iterator{this, num_items};
 	}
 };
 
@@ -34,14 +34,21 @@ TagBuilder::TagBuilder(const Tag &other)
 	items.reserve(other.num_items);
 
 	tag_pool_lock.lock();
-	for (unsigned i = 0, n = other.num_items; i != n; ++i)
-		items.push_back(tag_pool_dup_item(other.items[i]));
+	for (const auto &i : other)
+		items.push_back(tag_pool_dup_item(const_cast<TagItem *>(&i)));
 	tag_pool_lock.unlock();
 }
 
 TagBuilder::TagBuilder(Tag &&other)
 	:time(other.time), has_playlist(other.has_playlist)
 {
+	if (other.grouped) {
+		/* the group is shared; copy its items */
+		*this = TagBuilder(const_cast<const Tag &>(other));
+		other.Clear();
+		return;
+	}
+
 	/* move all TagItem pointers from the Tag object; we don't
 	   need to contact the tag pool, because all we do is move
 	   references */
@@ -49,9 +56,12 @@ TagBuilder::TagBuilder(Tag &&other)
 	std::copy_n(other.items, other.num_items, std::back_inserter(items));
 
 	/* discard the pointers from the Tag object */
+	tag_pool_lock.lock();
+	tag_pool_free_items(other.items, other.num_items);
+	tag_pool_lock.unlock();
 	other.num_items = 0;
-	delete[] other.items;
 	other.items = nullptr;
+	other.UpdateNumbers();
 }
 
 TagBuilder &
@@ -84,6 +94,12 @@ TagBuilder::operator=(TagBuilder &&other)
 TagBuilder &
 TagBuilder::operator=(Tag &&other)
 {
+	if (other.grouped) {
+		/* the group is shared; copy its items */
+		*this = TagBuilder(std::move(other));
+		return *this;
+	}
+
 	time = other.time;
 	has_playlist = other.has_playlist;
 
@@ -95,9 +111,12 @@ TagBuilder::operator=(Tag &&other)
 	std::copy_n(other.items, other.num_items, std::back_inserter(items));
 
 	/* discard the pointers from the Tag object */
+	tag_pool_lock.lock();
+	tag_pool_free_items(other.items, other.num_items);
+	tag_pool_lock.unlock();
 	other.num_items = 0;
-	delete[] other.items;
 	other.items = nullptr;
+	other.UpdateNumbers();
 
 	return *this;
 }
@@ -124,9 +143,12 @@ TagBuilder::Commit(Tag &tag)
 	   object */
 	const unsigned n_items = items.size();
 	tag.num_items = n_items;
-	tag.items = new TagItem *[n_items];
+	tag_pool_lock.lock();
+	tag.items = tag_pool_alloc_items(n_items);
+	tag_pool_lock.unlock();
 	std::copy_n(items.begin(), n_items, tag.items);
 	items.clear();
+	tag.UpdateNumbers();
 
 	/* now ensure that this object is fresh (will not delete any
 	   items because we've already moved them out) */
@@ -170,10 +192,10 @@ TagBuilder::Complement(const Tag &other)
 	items.reserve(items.size() + other.num_items);
 
 	tag_pool_lock.lock();
-	for (unsigned i = 0, n = other.num_items; i != n; ++i) {
-		TagItem *item = other.items[i];
-		if (!HasType(item->type))
-			items.push_back(tag_pool_dup_item(item));
+	for (const auto &i : other) {
+		TagItem &item = const_cast<TagItem &>(i);
+		if (!HasType(item.type))
+			items.push_back(tag_pool_dup_item(&item));
 	}
 	tag_pool_lock.unlock();
 }
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h" /* must be first for large file support */
+#include "TagFileReader.hxx"
+#include "fs/Path.hxx"
+#include "fs/FileSystem.hxx"
+#include "util/Error.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <string.h>
+#include <sys/stat.h>
+
+bool
+TagFileReader::Open(Path path_fs, Error &error)
+{
+	assert(file == nullptr);
+
+	file = FOpen(path_fs, FOpenMode::ReadBinary);
+	if (file == nullptr) {
+		error.FormatErrno("Failed to open file %s", path_fs.c_str());
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fileno(file), &st) < 0) {
+		error.FormatErrno("Failed to stat %s", path_fs.c_str());
+		Close();
+		return false;
+	}
+
+	size = st.st_size;
+
+	head_length = fread(head, 1, std::min<uint64_t>(size, sizeof(head)),
+			    file);
+
+	/* the tail block may overlap with the head block; that's
+	   cheaper than special-casing small files */
+	tail_length = 0;
+	if (size > BLOCK_SIZE &&
+	    fseek(file, size - BLOCK_SIZE, SEEK_SET) == 0 &&
+	    fread(tail, 1, BLOCK_SIZE, file) == BLOCK_SIZE)
+		tail_length = BLOCK_SIZE;
+
+	return true;
+}
+
+void
+TagFileReader::Close()
+{
+	if (file != nullptr) {
+		fclose(file);
+		file = nullptr;
+	}
+}
+
+size_t
+TagFileReader::ReadAt(void *dest, size_t length, uint64_t offset)
+{
+	assert(file != nullptr);
+
+	if (offset >= size)
+		return 0;
+
+	if (length > size - offset)
+		length = size - offset;
+
+	if (offset + length <= head_length) {
+		memcpy(dest, head + offset, length);
+		return length;
+	}
+
+	const uint64_t tail_offset = size - tail_length;
+	if (tail_length > 0 && offset >= tail_offset) {
+		memcpy(dest, tail + (offset - tail_offset), length);
+		return length;
+	}
+
+	if (fseek(file, offset, SEEK_SET) != 0)
+		return 0;
+
+	return fread(dest, 1, length, file);
+}
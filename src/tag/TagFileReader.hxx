@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_TAG_FILE_READER_HXX
+#define MPD_TAG_FILE_READER_HXX
+
+#include "check.h"
+#include "Compiler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+class Path;
+class Error;
+
+/**
+ * Random access to a local file for the tag parsers (ID3, APE,
+ * RIFF, AIFF).  The first and the last block of the file, where tags
+ * are usually found, are read only once when the file is opened;
+ * all parsers share one file handle and these buffers.
+ */
+class TagFileReader {
+	static constexpr size_t BLOCK_SIZE = 8192;
+
+	FILE *file;
+
+	uint64_t size;
+
+	/**
+	 * The number of valid bytes in #head (from offset 0) and in
+	 * #tail (ending at the end of the file).
+	 */
+	size_t head_length, tail_length;
+
+	unsigned char head[BLOCK_SIZE], tail[BLOCK_SIZE];
+
+public:
+	TagFileReader():file(nullptr) {}
+
+	~TagFileReader() {
+		Close();
+	}
+
+	TagFileReader(const TagFileReader &) = delete;
+	TagFileReader &operator=(const TagFileReader &) = delete;
+
+	/**
+	 * Open the file and read its first and last block.
+	 */
+	bool Open(Path path_fs, Error &error);
+
+	void Close();
+
+	bool IsDefined() const {
+		return file != nullptr;
+	}
+
+	uint64_t GetSize() const {
+		return size;
+	}
+
+	/**
+	 * Read up to the given number of bytes at the given offset.
+	 * Only short at the end of the file (or on I/O error).
+	 *
+	 * @return the number of bytes read
+	 */
+	size_t ReadAt(void *dest, size_t length, uint64_t offset);
+
+	/**
+	 * Like ReadAt(), but fail if fewer than the given number of
+	 * bytes are available.
+	 */
+	bool ReadFullAt(void *dest, size_t length, uint64_t offset) {
+		return ReadAt(dest, length, offset) == length;
+	}
+};
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "TagGroup.hxx"
+#include "TagPool.hxx"
+#include "TagItem.hxx"
+#include "util/VarSize.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <string.h>
+
+static constexpr size_t NUM_GROUP_SLOTS = 4096;
+
+static TagGroup *group_slots[NUM_GROUP_SLOTS];
+
+inline
+TagGroup::TagGroup(TagGroup *_next, uint32_t _mask,
+		   TagItem *const*_items, unsigned n)
+	:next(_next), ref(1), mask(_mask), num_items(n)
+{
+	for (unsigned i = 0; i < n; ++i)
+		items[i] = tag_pool_dup_item(_items[i]);
+}
+
+bool
+tag_group_type(TagType type)
+{
+	switch (type) {
+	case TAG_TITLE:
+	case TAG_TRACK:
+	case TAG_NAME:
+	case TAG_COMMENT:
+	case TAG_MUSICBRAINZ_TRACKID:
+		return false;
+
+	default:
+		return true;
+	}
+}
+
+/*
+ * Items are hashed and compared by their contents, not by their
+ * addresses, because tag_pool_dup_item() may return a different
+ * #TagItem with the same value.
+ */
+
+static unsigned
+calc_group_hash(uint32_t mask, TagItem *const*items, unsigned n)
+{
+	unsigned hash = 5381 ^ mask;
+
+	for (unsigned i = 0; i < n; ++i) {
+		hash = (hash << 5) + hash + items[i]->type;
+		for (const char *p = items[i]->value; *p != 0; ++p)
+			hash = (hash << 5) + hash + *p;
+	}
+
+	return hash;
+}
+
+gcc_pure
+static bool
+tag_item_equals(const TagItem *a, const TagItem *b)
+{
+	return a == b ||
+		(a->type == b->type && strcmp(a->value, b->value) == 0);
+}
+
+bool
+tag_group_items_equal(TagItem *const*a, TagItem *const*b, unsigned n)
+{
+	return std::equal(a, a + n, b, tag_item_equals);
+}
+
+static TagGroup **
+tag_group_slot_p(uint32_t mask, TagItem *const*items, unsigned n)
+{
+	return &group_slots[calc_group_hash(mask, items, n) % NUM_GROUP_SLOTS];
+}
+
+TagGroup *
+tag_group_get(uint32_t mask, TagItem *const*items, unsigned n)
+{
+	assert(n > 0);
+
+	auto slot_p = tag_group_slot_p(mask, items, n);
+	for (auto group = *slot_p; group != nullptr; group = group->next) {
+		if (group->mask == mask && group->num_items == n &&
+		    tag_group_items_equal(items, group->items, n)) {
+			assert(group->ref > 0);
+			++group->ref;
+			return group;
+		}
+	}
+
+	TagGroup *dummy;
+	auto group = NewVarSize<TagGroup>(sizeof(dummy->items),
+					  n * sizeof(dummy->items[0]),
+					  *slot_p, mask, items, n);
+	*slot_p = group;
+	return group;
+}
+
+TagGroup *
+tag_group_dup(TagGroup *group)
+{
+	assert(group->ref > 0);
+
+	++group->ref;
+	return group;
+}
+
+void
+tag_group_put(TagGroup *group)
+{
+	assert(group->ref > 0);
+
+	if (--group->ref > 0)
+		return;
+
+	/* look up the group by its original item pointers, before
+	   the references are released */
+	TagGroup **slot_p = tag_group_slot_p(group->mask, group->items,
+					     group->num_items);
+	while (*slot_p != group) {
+		assert(*slot_p != nullptr);
+		slot_p = &(*slot_p)->next;
+	}
+
+	*slot_p = group->next;
+
+	for (unsigned i = 0; i < group->num_items; ++i)
+		tag_pool_put_item(group->items[i]);
+
+	DeleteVarSize(group);
+}
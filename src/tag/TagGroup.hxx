@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_TAG_GROUP_HXX
+#define MPD_TAG_GROUP_HXX
+
+#include "TagType.h"
+#include "util/RefCount.hxx"
+#include "Compiler.h"
+
+#include <stdint.h>
+
+struct TagItem;
+
+/**
+ * A list of #TagItem pointers which is shared by several #Tag
+ * objects, e.g. the artist, album and date of all songs of one
+ * album.  Groups are unique: there is at most one group with the
+ * same items at the same positions.
+ *
+ * All functions require the caller to lock #tag_pool_lock.
+ */
+struct TagGroup {
+	TagGroup *next;
+
+	unsigned ref;
+
+	/**
+	 * Bit i is set if the i-th item of a #Tag using this group is
+	 * taken from the group.
+	 */
+	uint32_t mask;
+
+	unsigned short num_items;
+
+	/**
+	 * The items of this group.  Each one holds a reference in
+	 * the #TagPool.
+	 */
+	TagItem *items[1];
+
+	TagGroup(TagGroup *_next, uint32_t _mask,
+		 TagItem *const*_items, unsigned n);
+};
+
+/**
+ * The items of a #Tag which uses a #TagGroup.  This object is
+ * immutable and may be shared by copies of that #Tag; it is freed
+ * when the last one releases it.
+ */
+struct TagSharedItems {
+	RefCount ref;
+
+	TagGroup *group;
+
+	/**
+	 * The items which are not in the group, in the order of
+	 * their appearance in the #Tag.
+	 */
+	TagItem *items[1];
+};
+
+/**
+ * Is the given tag type likely to be the same in many songs?  These
+ * attributes are moved to a #TagGroup by Tag::ShareWith().
+ */
+gcc_const
+bool
+tag_group_type(TagType type);
+
+/**
+ * Compare two arrays of items by their values.
+ */
+gcc_pure
+bool
+tag_group_items_equal(TagItem *const*a, TagItem *const*b, unsigned n);
+
+/**
+ * Look up a group with the given mask and items (or create a new
+ * one), and increment its reference counter.  The caller keeps its
+ * references to the given items.
+ */
+TagGroup *
+tag_group_get(uint32_t mask, TagItem *const*items, unsigned n);
+
+TagGroup *
+tag_group_dup(TagGroup *group);
+
+void
+tag_group_put(TagGroup *group);
+
+#endif
@@ -42,6 +42,7 @@ const struct tag_handler add_tag_handler = {
 	add_tag_duration,
 	add_tag_tag,
 	nullptr,
+	nullptr,
 };
 
 static void
@@ -57,5 +58,6 @@ const struct tag_handler full_tag_handler = {
 	add_tag_duration,
 	add_tag_tag,
 	full_tag_pair,
+	add_tag_duration,
 };
 
@@ -49,8 +49,30 @@ struct tag_handler {
 	 * representation of tags.
 	 */
 	void (*pair)(const char *key, const char *value, void *ctx);
+
+	/**
+	 * Declare an estimated duration of a song, in seconds.  By
+	 * implementing this optional method, the handler declares
+	 * that an estimate is good enough: the decoder plugin may
+	 * skip expensive work (e.g. parsing all frames) and call
+	 * this method instead of duration().  The exact value will
+	 * be determined when the song is played.
+	 */
+	void (*estimated_duration)(unsigned seconds, void *ctx);
 };
 
+/**
+ * Is the handler satisfied with an estimated duration?  See
+ * tag_handler::estimated_duration.
+ */
+static inline bool
+tag_handler_accepts_estimate(const struct tag_handler *handler)
+{
+	assert(handler != nullptr);
+
+	return handler->estimated_duration != nullptr;
+}
+
 static inline void
 tag_handler_invoke_duration(const struct tag_handler *handler, void *ctx,
 			  unsigned seconds)
@@ -61,6 +83,18 @@ tag_handler_invoke_duration(const struct tag_handler *handler, void *ctx,
 		handler->duration(seconds, ctx);
 }
 
+static inline void
+tag_handler_invoke_estimated_duration(const struct tag_handler *handler,
+				      void *ctx, unsigned seconds)
+{
+	assert(handler != nullptr);
+
+	if (handler->estimated_duration != nullptr)
+		handler->estimated_duration(seconds, ctx);
+	else
+		tag_handler_invoke_duration(handler, ctx, seconds);
+}
+
 static inline void
 tag_handler_invoke_tag(const struct tag_handler *handler, void *ctx,
 		       TagType type, const char *value)
@@ -94,7 +128,8 @@ extern const struct tag_handler add_tag_handler;
 /**
  * This #tag_handler implementation adds tag values to a #TagBuilder object
  * (casted from the context pointer), and supports the has_playlist
- * attribute.
+ * attribute.  It accepts estimated durations; this is what the
+ * database update uses.
  */
 extern const struct tag_handler full_tag_handler;
 
@@ -30,8 +30,9 @@
 #include "config/ConfigGlobal.hxx"
 #include "Riff.hxx"
 #include "Aiff.hxx"
+#include "TagFileReader.hxx"
+#include "Id3Scan.hxx"
 #include "fs/Path.hxx"
-#include "fs/FileSystem.hxx"
 
 #ifdef HAVE_GLIB
 #include <glib.h>
@@ -384,29 +385,25 @@ tag_id3_import(struct id3_tag *tag)
 		: tag_builder.CommitNew();
 }
 
-static size_t
-fill_buffer(void *buf, size_t size, FILE *stream, long offset, int whence)
-{
-	if (fseek(stream, offset, whence) != 0) return 0;
-	return fread(buf, 1, size, stream);
-}
-
 static long
-get_id3v2_footer_size(FILE *stream, long offset, int whence)
+get_id3v2_footer_size(TagFileReader &reader, uint64_t offset)
 {
 	id3_byte_t buf[ID3_TAG_QUERYSIZE];
-	size_t bufsize = fill_buffer(buf, ID3_TAG_QUERYSIZE, stream, offset, whence);
+	size_t bufsize = reader.ReadAt(buf, ID3_TAG_QUERYSIZE, offset);
 	if (bufsize == 0) return 0;
 	return id3_tag_query(buf, bufsize);
 }
 
+/**
+ * @param end_r on success, receives the file offset after the tag
+ */
 static struct id3_tag *
-tag_id3_read(FILE *stream, long offset, int whence)
+tag_id3_read(TagFileReader &reader, uint64_t offset, uint64_t &end_r)
 {
 	/* It's ok if we get less than we asked for */
 	id3_byte_t query_buffer[ID3_TAG_QUERYSIZE];
-	size_t query_buffer_size = fill_buffer(query_buffer, ID3_TAG_QUERYSIZE,
-					       stream, offset, whence);
+	size_t query_buffer_size = reader.ReadAt(query_buffer,
+						 ID3_TAG_QUERYSIZE, offset);
 	if (query_buffer_size <= 0)
 		return nullptr;
 
@@ -416,22 +413,23 @@ tag_id3_read(FILE *stream, long offset, int whence)
 
 	/* Found a tag.  Allocate a buffer and read it in. */
 	id3_byte_t *tag_buffer = new id3_byte_t[tag_size];
-	int tag_buffer_size = fill_buffer(tag_buffer, tag_size,
-					  stream, offset, whence);
-	if (tag_buffer_size < tag_size) {
+	if (!reader.ReadFullAt(tag_buffer, tag_size, offset)) {
 		delete[] tag_buffer;
 		return nullptr;
 	}
 
-	id3_tag *tag = id3_tag_parse(tag_buffer, tag_buffer_size);
+	end_r = offset + tag_size;
+
+	id3_tag *tag = id3_tag_parse(tag_buffer, tag_size);
 	delete[] tag_buffer;
 	return tag;
 }
 
 static struct id3_tag *
-tag_id3_find_from_beginning(FILE *stream)
+tag_id3_find_from_beginning(TagFileReader &reader)
 {
-	id3_tag *tag = tag_id3_read(stream, 0, SEEK_SET);
+	uint64_t end;
+	id3_tag *tag = tag_id3_read(reader, 0, end);
 	if (!tag) {
 		return nullptr;
 	} else if (tag_is_id3v1(tag)) {
@@ -449,7 +447,7 @@ tag_id3_find_from_beginning(FILE *stream)
 			break;
 
 		/* Get the tag specified by the SEEK frame */
-		id3_tag *seektag = tag_id3_read(stream, seek, SEEK_CUR);
+		id3_tag *seektag = tag_id3_read(reader, end + seek, end);
 		if (!seektag || tag_is_id3v1(seektag))
 			break;
 
@@ -462,18 +460,27 @@ tag_id3_find_from_beginning(FILE *stream)
 }
 
 static struct id3_tag *
-tag_id3_find_from_end(FILE *stream)
+tag_id3_find_from_end(TagFileReader &reader)
 {
+	const uint64_t size = reader.GetSize();
+
 	/* Get an id3v1 tag from the end of file for later use */
-	id3_tag *v1tag = tag_id3_read(stream, -128, SEEK_END);
+	uint64_t end;
+	id3_tag *v1tag = size >= 128
+		? tag_id3_read(reader, size - 128, end)
+		: nullptr;
 
 	/* Get the id3v2 tag size from the footer (located before v1tag) */
-	int tagsize = get_id3v2_footer_size(stream, (v1tag ? -128 : 0) - 10, SEEK_END);
-	if (tagsize >= 0)
+	const uint64_t footer_end = size - (v1tag ? 128 : 0);
+	if (footer_end < 10)
+		return v1tag;
+
+	int tagsize = get_id3v2_footer_size(reader, footer_end - 10);
+	if (tagsize >= 0 || uint64_t(-tagsize) > footer_end)
 		return v1tag;
 
 	/* Get the tag which the footer belongs to */
-	id3_tag *tag = tag_id3_read(stream, tagsize, SEEK_CUR);
+	id3_tag *tag = tag_id3_read(reader, footer_end + tagsize, end);
 	if (!tag)
 		return v1tag;
 
@@ -484,11 +491,12 @@ tag_id3_find_from_end(FILE *stream)
 }
 
 static struct id3_tag *
-tag_id3_riff_aiff_load(FILE *file)
+tag_id3_riff_aiff_load(TagFileReader &reader)
 {
-	size_t size = riff_seek_id3(file);
+	uint64_t offset;
+	size_t size = riff_find_id3(reader, offset);
 	if (size == 0)
-		size = aiff_seek_id3(file);
+		size = aiff_find_id3(reader, offset);
 	if (size == 0)
 		return nullptr;
 
@@ -497,8 +505,7 @@ tag_id3_riff_aiff_load(FILE *file)
 		return nullptr;
 
 	id3_byte_t *buffer = new id3_byte_t[size];
-	size_t ret = fread(buffer, size, 1, file);
-	if (ret != 1) {
+	if (!reader.ReadFullAt(buffer, size, offset)) {
 		LogWarning(id3_domain, "Failed to read RIFF chunk");
 		delete[] buffer;
 		return nullptr;
@@ -510,39 +517,92 @@ tag_id3_riff_aiff_load(FILE *file)
 }
 
 struct id3_tag *
-tag_id3_load(Path path_fs, Error &error)
+tag_id3_load(TagFileReader &reader)
 {
-	FILE *file = FOpen(path_fs, "rb");
-	if (file == nullptr) {
-		error.FormatErrno("Failed to open file %s", path_fs.c_str());
-		return nullptr;
-	}
-
-	struct id3_tag *tag = tag_id3_find_from_beginning(file);
+	struct id3_tag *tag = tag_id3_find_from_beginning(reader);
 	if (tag == nullptr) {
-		tag = tag_id3_riff_aiff_load(file);
+		tag = tag_id3_riff_aiff_load(reader);
 		if (tag == nullptr)
-			tag = tag_id3_find_from_end(file);
+			tag = tag_id3_find_from_end(reader);
 	}
 
-	fclose(file);
 	return tag;
 }
 
+struct id3_tag *
+tag_id3_load(Path path_fs, Error &error)
+{
+	TagFileReader reader;
+	if (!reader.Open(path_fs, error))
+		return nullptr;
+
+	return tag_id3_load(reader);
+}
+
+/**
+ * Try the light-weight parser on an ID3v2 tag at the beginning of the
+ * file or in a RIFF/AIFF chunk.
+ */
+static Id3ScanResult
+tag_id3_fast_scan(TagFileReader &reader,
+		  const struct tag_handler *handler, void *handler_ctx)
+{
+	Id3ScanResult result = id3v2_scan(reader, 0, handler, handler_ctx);
+	if (result != Id3ScanResult::NOT_FOUND)
+		return result;
+
+	uint64_t offset;
+	if (riff_find_id3(reader, offset) > 0 ||
+	    aiff_find_id3(reader, offset) > 0)
+		result = id3v2_scan(reader, offset, handler, handler_ctx);
+
+	return result;
+}
+
 bool
-tag_id3_scan(Path path_fs,
+tag_id3_scan(TagFileReader &reader,
 	     const struct tag_handler *handler, void *handler_ctx)
 {
-	Error error;
-	struct id3_tag *tag = tag_id3_load(path_fs, error);
-	if (tag == nullptr) {
-		if (error.IsDefined())
-			LogError(error);
+	switch (tag_id3_fast_scan(reader, handler, handler_ctx)) {
+	case Id3ScanResult::OK:
+		return true;
+
+	case Id3ScanResult::NOT_FOUND:
+		/* the tag may still be at the end of the file */
+		{
+			struct id3_tag *tag =
+				tag_id3_find_from_end(reader);
+			if (tag == nullptr)
+				return false;
+
+			scan_id3_tag(tag, handler, handler_ctx);
+			id3_tag_delete(tag);
+			return true;
+		}
 
-		return false;
+	case Id3ScanResult::UNSUPPORTED:
+		break;
 	}
 
+	struct id3_tag *tag = tag_id3_load(reader);
+	if (tag == nullptr)
+		return false;
+
 	scan_id3_tag(tag, handler, handler_ctx);
 	id3_tag_delete(tag);
 	return true;
 }
+
+bool
+tag_id3_scan(Path path_fs,
+	     const struct tag_handler *handler, void *handler_ctx)
+{
+	TagFileReader reader;
+	Error error;
+	if (!reader.Open(path_fs, error)) {
+		LogError(error);
+		return false;
+	}
+
+	return tag_id3_scan(reader, handler, handler_ctx);
+}
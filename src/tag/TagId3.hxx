@@ -28,6 +28,7 @@ struct tag_handler;
 struct Tag;
 struct id3_tag;
 class Error;
+class TagFileReader;
 
 #ifdef HAVE_ID3TAG
 
@@ -35,6 +36,13 @@ bool
 tag_id3_scan(Path path_fs,
 	     const tag_handler *handler, void *handler_ctx);
 
+/**
+ * Scan the ID3 tags of a file which was already opened.
+ */
+bool
+tag_id3_scan(TagFileReader &reader,
+	     const tag_handler *handler, void *handler_ctx);
+
 Tag *
 tag_id3_import(id3_tag *);
 
@@ -48,6 +56,12 @@ tag_id3_import(id3_tag *);
 struct id3_tag *
 tag_id3_load(Path path_fs, Error &error);
 
+/**
+ * Like tag_id3_load(), but use a file which was already opened.
+ */
+struct id3_tag *
+tag_id3_load(TagFileReader &reader);
+
 /**
  * Import all tags from the provided id3_tag *tag
  *
@@ -68,6 +82,14 @@ tag_id3_scan(gcc_unused Path path_fs,
 	return false;
 }
 
+static inline bool
+tag_id3_scan(gcc_unused TagFileReader &reader,
+	     gcc_unused const tag_handler *handler,
+	     gcc_unused void *handler_ctx)
+{
+	return false;
+}
+
 #endif
 
 #endif
@@ -22,69 +22,115 @@
 #include "TagItem.hxx"
 #include "util/Cast.hxx"
 #include "util/VarSize.hxx"
+#include "util/Alloc.hxx"
+#include "util/MemoryStats.hxx"
 
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 
-Mutex tag_pool_lock;
-
-static constexpr size_t NUM_SLOTS = 4096;
+Mutex tag_pool_lock("tag_pool");
 
 struct TagPoolSlot {
-	TagPoolSlot *next;
-	unsigned char ref;
+	/**
+	 * The case-folded value, see tag_pool_get_folded().  It is
+	 * nullptr until it is needed, and it points to item.value if
+	 * folding did not change anything.
+	 */
+	char *folded;
+
+	/**
+	 * The value of tag_pool_hash(); it is kept here so lookups
+	 * can skip most string comparisons, and the table can be
+	 * resized without hashing all strings again.
+	 */
+	uint32_t hash;
+
+	uint32_t ref;
+
 	TagItem item;
 
-	TagPoolSlot(TagPoolSlot *_next, TagType type,
+	TagPoolSlot(uint32_t _hash, TagType type,
 		    const char *value, size_t length)
-		:next(_next), ref(1) {
+		:folded(nullptr), hash(_hash), ref(1) {
 		item.type = type;
 		memcpy(item.value, value, length);
 		item.value[length] = 0;
 	}
 
-	static TagPoolSlot *Create(TagPoolSlot *_next, TagType type,
+	~TagPoolSlot() {
+		if (folded != item.value && folded != nullptr) {
+			MemoryStatsSub(MemoryCategory::TAG,
+				       strlen(folded) + 1);
+			delete[] folded;
+		}
+	}
+
+	/**
+	 * The allocation size of a slot, for #MemoryStats.
+	 */
+	static constexpr size_t GetAllocSize(size_t length) {
+		return sizeof(TagPoolSlot) - sizeof(item.value) + length + 1;
+	}
+
+	static TagPoolSlot *Create(uint32_t _hash, TagType type,
 				   const char *value, size_t length);
+
+	void Delete();
 } gcc_packed;
 
 TagPoolSlot *
-TagPoolSlot::Create(TagPoolSlot *_next, TagType type,
+TagPoolSlot::Create(uint32_t _hash, TagType type,
 		    const char *value, size_t length)
 {
+	MemoryStatsAdd(MemoryCategory::TAG, GetAllocSize(length));
+
 	TagPoolSlot *dummy;
 	return NewVarSize<TagPoolSlot>(sizeof(dummy->item.value),
 				       length + 1,
-				       _next, type,
+				       _hash, type,
 				       value, length);
 }
 
-static TagPoolSlot *slots[NUM_SLOTS];
-
-static inline unsigned
-calc_hash_n(TagType type, const char *p, size_t length)
+inline void
+TagPoolSlot::Delete()
 {
-	unsigned hash = 5381;
-
-	assert(p != nullptr);
+	MemoryStatsSub(MemoryCategory::TAG,
+		       GetAllocSize(strlen(item.value)));
+	DeleteVarSize(this);
+}
 
-	while (length-- > 0)
-		hash = (hash << 5) + hash + *p++;
+/**
+ * An open addressing hash table with linear probing.  Its capacity
+ * is always a power of two; it grows when it is 3/4 full and shrinks
+ * when it is less than 1/8 full.
+ */
+static constexpr size_t MIN_CAPACITY = 4096;
 
-	return hash ^ type;
-}
+static TagPoolSlot **table;
+static size_t table_mask, table_count;
 
-static inline unsigned
-calc_hash(TagType type, const char *p)
+/**
+ * FNV-1a over the type and the value, followed by the MurmurHash3
+ * finalizer, because linear probing needs good low bits.
+ */
+gcc_pure
+static uint32_t
+tag_pool_hash(TagType type, const char *p, size_t length)
 {
-	unsigned hash = 5381;
-
 	assert(p != nullptr);
 
-	while (*p != 0)
-		hash = (hash << 5) + hash + *p++;
+	uint32_t hash = (2166136261u ^ uint32_t(type)) * 16777619u;
+	while (length-- > 0)
+		hash = (hash ^ (unsigned char)*p++) * 16777619u;
 
-	return hash ^ type;
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bu;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35u;
+	hash ^= hash >> 16;
+	return hash;
 }
 
 #if defined(__clang__) || GCC_CHECK_VERSION(4,7)
@@ -96,35 +142,72 @@ tag_item_to_slot(TagItem *item)
 	return &ContainerCast(*item, &TagPoolSlot::item);
 }
 
-static inline TagPoolSlot **
-tag_value_slot_p(TagType type, const char *value, size_t length)
+#if defined(__clang__) || GCC_CHECK_VERSION(4,7)
+	constexpr
+#endif
+static inline const TagPoolSlot *
+tag_item_to_slot(const TagItem *item)
 {
-	return &slots[calc_hash_n(type, value, length) % NUM_SLOTS];
+	return &ContainerCast(*item, &TagPoolSlot::item);
 }
 
-static inline TagPoolSlot **
-tag_value_slot_p(TagType type, const char *value)
+static void
+tag_pool_resize(size_t capacity)
 {
-	return &slots[calc_hash(type, value) % NUM_SLOTS];
+	assert(capacity >= MIN_CAPACITY);
+	assert((capacity & (capacity - 1)) == 0);
+	assert(table_count < capacity);
+
+	TagPoolSlot **const old_table = table;
+	const size_t old_capacity = table != nullptr ? table_mask + 1 : 0;
+
+	table = new TagPoolSlot *[capacity]();
+	table_mask = capacity - 1;
+	MemoryStatsResize(MemoryCategory::TAG,
+			  old_capacity * sizeof(*table),
+			  capacity * sizeof(*table));
+
+	for (size_t i = 0; i < old_capacity; ++i) {
+		TagPoolSlot *slot = old_table[i];
+		if (slot == nullptr)
+			continue;
+
+		size_t j = slot->hash & table_mask;
+		while (table[j] != nullptr)
+			j = (j + 1) & table_mask;
+		table[j] = slot;
+	}
+
+	delete[] old_table;
 }
 
 TagItem *
 tag_pool_get_item(TagType type, const char *value, size_t length)
 {
-	auto slot_p = tag_value_slot_p(type, value, length);
-	for (auto slot = *slot_p; slot != nullptr; slot = slot->next) {
-		if (slot->item.type == type &&
+	if (table == nullptr)
+		tag_pool_resize(MIN_CAPACITY);
+
+	const uint32_t hash = tag_pool_hash(type, value, length);
+
+	size_t i = hash & table_mask;
+	for (TagPoolSlot *slot; (slot = table[i]) != nullptr;
+	     i = (i + 1) & table_mask) {
+		if (slot->hash == hash &&
+		    slot->item.type == type &&
 		    length == strlen(slot->item.value) &&
-		    memcmp(value, slot->item.value, length) == 0 &&
-		    slot->ref < 0xff) {
+		    memcmp(value, slot->item.value, length) == 0) {
 			assert(slot->ref > 0);
 			++slot->ref;
 			return &slot->item;
 		}
 	}
 
-	auto slot = TagPoolSlot::Create(*slot_p, type, value, length);
-	*slot_p = slot;
+	auto slot = TagPoolSlot::Create(hash, type, value, length);
+	table[i] = slot;
+
+	if (++table_count * 4 > (table_mask + 1) * 3)
+		tag_pool_resize((table_mask + 1) * 2);
+
 	return &slot->item;
 }
 
@@ -135,40 +218,137 @@ tag_pool_dup_item(TagItem *item)
 
 	assert(slot->ref > 0);
 
-	if (slot->ref < 0xff) {
-		++slot->ref;
-		return item;
-	} else {
-		/* the reference counter overflows above 0xff;
-		   duplicate the item, and start with 1 */
-		size_t length = strlen(item->value);
-		auto slot_p = tag_value_slot_p(item->type,
-					       item->value, length);
-		slot = TagPoolSlot::Create(*slot_p, item->type,
-					   item->value, strlen(item->value));
-		*slot_p = slot;
-		return &slot->item;
-	}
+	++slot->ref;
+	return item;
 }
 
 void
 tag_pool_put_item(TagItem *item)
 {
-	TagPoolSlot **slot_p, *slot;
-
-	slot = tag_item_to_slot(item);
+	TagPoolSlot *slot = tag_item_to_slot(item);
 	assert(slot->ref > 0);
 	--slot->ref;
 
 	if (slot->ref > 0)
 		return;
 
-	for (slot_p = tag_value_slot_p(item->type, item->value);
-	     *slot_p != slot;
-	     slot_p = &(*slot_p)->next) {
-		assert(*slot_p != nullptr);
+	size_t i = slot->hash & table_mask;
+	while (table[i] != slot) {
+		assert(table[i] != nullptr);
+		i = (i + 1) & table_mask;
+	}
+
+	/* backward shift deletion: move following entries of the
+	   same cluster into the gap unless that would place them
+	   before their home position; this avoids tombstones */
+	size_t gap = i;
+	for (size_t j = (i + 1) & table_mask; table[j] != nullptr;
+	     j = (j + 1) & table_mask) {
+		const size_t home = table[j]->hash & table_mask;
+		if (((j - home) & table_mask) >= ((j - gap) & table_mask)) {
+			table[gap] = table[j];
+			gap = j;
+		}
+	}
+
+	table[gap] = nullptr;
+	--table_count;
+
+	slot->Delete();
+
+	if (table_mask + 1 > MIN_CAPACITY &&
+	    table_count * 8 < table_mask + 1)
+		tag_pool_resize((table_mask + 1) / 2);
+}
+
+/**
+ * Item arrays up to this size are allocated from #items_block.
+ */
+static constexpr unsigned MAX_SMALL_ITEMS = 16;
+
+static constexpr size_t ITEMS_BLOCK_SIZE = 64 * 1024;
+
+/**
+ * Recycled arrays, one list per size.  The first element of each
+ * array points to the next one.
+ */
+static TagItem **free_items[MAX_SMALL_ITEMS + 1];
+
+/**
+ * The unused rest of the current block.  Blocks are never freed;
+ * their arrays are recycled through #free_items.
+ */
+static char *items_block;
+static size_t items_block_available;
+
+TagItem **
+tag_pool_alloc_items(unsigned n)
+{
+	if (n == 0)
+		return nullptr;
+
+	if (n > MAX_SMALL_ITEMS) {
+		MemoryStatsAdd(MemoryCategory::TAG, n * sizeof(TagItem *));
+		return new TagItem *[n];
+	}
+
+	TagItem **items = free_items[n];
+	if (items != nullptr) {
+		memcpy(&free_items[n], items, sizeof(free_items[n]));
+		return items;
+	}
+
+	const size_t size = n * sizeof(*items);
+	if (size > items_block_available) {
+		items_block = (char *)xalloc(ITEMS_BLOCK_SIZE);
+		items_block_available = ITEMS_BLOCK_SIZE;
+		MemoryStatsAdd(MemoryCategory::TAG, ITEMS_BLOCK_SIZE);
+	}
+
+	items = (TagItem **)items_block;
+	items_block += size;
+	items_block_available -= size;
+	return items;
+}
+
+void
+tag_pool_free_items(TagItem **items, unsigned n)
+{
+	assert((items == nullptr) == (n == 0));
+
+	if (n > MAX_SMALL_ITEMS) {
+		MemoryStatsSub(MemoryCategory::TAG, n * sizeof(*items));
+		delete[] items;
+		return;
+	}
+
+	if (n == 0)
+		return;
+
+	memcpy(items, &free_items[n], sizeof(free_items[n]));
+	free_items[n] = items;
+}
+
+const char *
+tag_pool_get_folded(const TagItem *item, TagFoldFunction fold)
+{
+	/* the slot is logically const; only the cache is filled */
+	TagPoolSlot *slot = const_cast<TagPoolSlot *>(tag_item_to_slot(item));
+
+	const ScopeLock protect(tag_pool_lock);
+
+	if (slot->folded == nullptr) {
+		const std::string folded = fold(item->value);
+		if (folded == item->value) {
+			slot->folded = slot->item.value;
+		} else {
+			slot->folded = new char[folded.length() + 1];
+			memcpy(slot->folded, folded.c_str(),
+			       folded.length() + 1);
+			MemoryStatsAdd(MemoryCategory::TAG,
+				       folded.length() + 1);
+		}
 	}
 
-	*slot_p = slot->next;
-	DeleteVarSize(slot);
+	return slot->folded;
 }
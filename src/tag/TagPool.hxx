@@ -23,6 +23,8 @@
 #include "TagType.h"
 #include "thread/Mutex.hxx"
 
+#include <string>
+
 extern Mutex tag_pool_lock;
 
 struct TagItem;
@@ -36,4 +38,38 @@ tag_pool_dup_item(TagItem *item);
 void
 tag_pool_put_item(TagItem *item);
 
+/**
+ * Allocate an array for #Tag::items.  Small arrays are carved from
+ * larger blocks and recycled, which avoids one heap allocation (and
+ * its overhead) for each #Tag.
+ *
+ * Caller must lock #tag_pool_lock.
+ *
+ * @return the array, or nullptr if n is 0
+ */
+TagItem **
+tag_pool_alloc_items(unsigned n);
+
+/**
+ * Free an array returned by tag_pool_alloc_items(); n must be the
+ * same.
+ *
+ * Caller must lock #tag_pool_lock.
+ */
+void
+tag_pool_free_items(TagItem **items, unsigned n);
+
+typedef std::string (*TagFoldFunction)(const char *value);
+
+/**
+ * Returns the case-folded value of the item.  It is computed by the
+ * given function when it is needed for the first time, and kept
+ * until the item is freed; this function must be the same for all
+ * calls.
+ *
+ * Caller must NOT lock #tag_pool_lock.
+ */
+const char *
+tag_pool_get_folded(const TagItem *item, TagFoldFunction fold);
+
 #endif
@@ -35,12 +35,81 @@
 /* mingw-w64 4.6.3 lacks a std::cond implementation */
 
 #include "WindowsCond.hxx"
-class Cond : public WindowsCond {};
+class Cond : public WindowsCond {
+public:
+	Cond() = default;
+
+	/**
+	 * @param name a name for "--enable-lock-stats" (ignored on
+	 * this platform)
+	 */
+	explicit Cond(const char *) {}
+};
+
+#elif defined(ENABLE_LOCK_STATS)
+
+#include "PosixCond.hxx"
+#include "Mutex.hxx"
+#include "LockStats.hxx"
+
+/**
+ * A #PosixCond which records how long wait() takes if it was
+ * constructed with a name.
+ */
+class Cond : public PosixCond {
+	LockStats *const stats;
+
+public:
+#ifndef __BIONIC__
+	constexpr
+#endif
+	Cond():stats(nullptr) {}
+
+	explicit Cond(const char *name)
+		:stats(&LockStats::Get(name)) {}
+
+	void wait(Mutex &mutex) {
+		if (stats == nullptr) {
+			PosixCond::wait(mutex);
+			return;
+		}
+
+		stats->Acquire();
+		const uint64_t start = LockStats::Now();
+		PosixCond::wait(mutex);
+		stats->AddWait(LockStats::Now() - start);
+	}
+
+	bool timed_wait(Mutex &mutex, unsigned timeout_ms) {
+		if (stats == nullptr)
+			return PosixCond::timed_wait(mutex, timeout_ms);
+
+		stats->Acquire();
+		const uint64_t start = LockStats::Now();
+		bool result = PosixCond::timed_wait(mutex, timeout_ms);
+		stats->AddWait(LockStats::Now() - start);
+		if (!result)
+			stats->Contend();
+		return result;
+	}
+};
 
 #else
 
 #include "PosixCond.hxx"
-class Cond : public PosixCond {};
+class Cond : public PosixCond {
+public:
+	Cond() = default;
+
+	/**
+	 * @param name a name for "--enable-lock-stats" (see
+	 * #LockStats); must be a string literal
+	 */
+#ifndef __BIONIC__
+	constexpr
+#endif
+	explicit Cond(const char *) {}
+};
 
 #endif
 
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+
+#ifdef ENABLE_LOCK_STATS
+
+#include "LockStats.hxx"
+#include "PosixMutex.hxx"
+
+#include <string.h>
+#include <time.h>
+
+/**
+ * Protects insertions into #lock_stats_head.  This is a raw
+ * #PosixMutex which is not instrumented itself.  Both variables are
+ * initialized at compile time, so they are usable during static
+ * initialization.
+ */
+static PosixMutex lock_stats_mutex;
+
+static std::atomic<LockStats *> lock_stats_head;
+
+LockStats::LockStats(const char *_name, LockStats *_next)
+	:name(_name), next(_next),
+	 acquisitions(0), contentions(0), wait_us(0)
+{
+	for (auto &i : histogram)
+		i = 0;
+}
+
+void
+LockStats::AddWait(uint64_t us)
+{
+	wait_us.fetch_add(us, std::memory_order_relaxed);
+
+	unsigned bucket = 0;
+	while (us > 0 && bucket < N_BUCKETS - 1) {
+		us >>= 1;
+		++bucket;
+	}
+
+	histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+LockStats &
+LockStats::Get(const char *name)
+{
+	lock_stats_mutex.lock();
+
+	LockStats *head = lock_stats_head.load(std::memory_order_relaxed);
+	LockStats *s = head;
+	while (s != nullptr && strcmp(s->name, name) != 0)
+		s = s->next;
+
+	if (s == nullptr) {
+		s = new LockStats(name, head);
+		lock_stats_head.store(s, std::memory_order_release);
+	}
+
+	lock_stats_mutex.unlock();
+	return *s;
+}
+
+const LockStats *
+LockStats::GetFirst()
+{
+	return lock_stats_head.load(std::memory_order_acquire);
+}
+
+uint64_t
+LockStats::Now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return uint64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_THREAD_LOCK_STATS_HXX
+#define MPD_THREAD_LOCK_STATS_HXX
+
+#include <atomic>
+
+#include <stdint.h>
+
+/**
+ * Contention statistics of all #Mutex, #SharedMutex or #Cond
+ * instances which were constructed with the same name.  Only
+ * available with "--enable-lock-stats".
+ *
+ * For a mutex, "acquisitions" counts lock() calls, "contentions"
+ * counts those which had to wait, and the histogram records how long
+ * they waited.  For a #Cond, "acquisitions" counts wait() calls,
+ * "contentions" counts timeouts, and the histogram records how long
+ * the wait() calls took.
+ */
+struct LockStats {
+	/**
+	 * Bucket 0 counts waits shorter than 1 microsecond; bucket
+	 * #i>0 counts waits of 2^(i-1) up to 2^i microseconds; the
+	 * last bucket counts everything above.
+	 */
+	static constexpr unsigned N_BUCKETS = 24;
+
+	const char *const name;
+
+	LockStats *const next;
+
+	std::atomic<uint64_t> acquisitions, contentions;
+
+	/**
+	 * The total wait time [microseconds].
+	 */
+	std::atomic<uint64_t> wait_us;
+
+	std::atomic<uint64_t> histogram[N_BUCKETS];
+
+	LockStats(const char *_name, LockStats *_next);
+
+	LockStats(const LockStats &) = delete;
+	LockStats &operator=(const LockStats &) = delete;
+
+	void Acquire() {
+		acquisitions.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void Contend() {
+		contentions.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void AddWait(uint64_t us);
+
+	/**
+	 * Returns the object with the given name; creates it if it
+	 * does not exist yet.  The object is never freed.  This
+	 * function is thread-safe and may be called during static
+	 * initialization.
+	 *
+	 * @param name a string literal
+	 */
+	static LockStats &Get(const char *name);
+
+	/**
+	 * Returns the most recently created object; follow #next to
+	 * iterate over all of them.
+	 */
+	static const LockStats *GetFirst();
+
+	/**
+	 * Returns a monotonic time stamp [microseconds].
+	 */
+	static uint64_t Now();
+};
+
+#endif
@@ -35,12 +35,71 @@
 /* mingw-w64 4.6.3 lacks a std::mutex implementation */
 
 #include "CriticalSection.hxx"
-class Mutex : public CriticalSection {};
+class Mutex : public CriticalSection {
+public:
+	Mutex() = default;
+
+	/**
+	 * @param name a name for "--enable-lock-stats" (ignored on
+	 * this platform)
+	 */
+	explicit Mutex(const char *) {}
+};
+
+#elif defined(ENABLE_LOCK_STATS)
+
+#include "PosixMutex.hxx"
+#include "LockStats.hxx"
+
+/**
+ * A #PosixMutex which records contention statistics if it was
+ * constructed with a name.
+ */
+class Mutex : public PosixMutex {
+	LockStats *const stats;
+
+public:
+#ifndef __BIONIC__
+	constexpr
+#endif
+	Mutex():stats(nullptr) {}
+
+	explicit Mutex(const char *name)
+		:stats(&LockStats::Get(name)) {}
+
+	void lock() {
+		if (stats == nullptr) {
+			PosixMutex::lock();
+			return;
+		}
+
+		stats->Acquire();
+		if (PosixMutex::try_lock())
+			return;
+
+		stats->Contend();
+		const uint64_t start = LockStats::Now();
+		PosixMutex::lock();
+		stats->AddWait(LockStats::Now() - start);
+	}
+};
 
 #else
 
 #include "PosixMutex.hxx"
-class Mutex : public PosixMutex {};
+class Mutex : public PosixMutex {
+public:
+	Mutex() = default;
+
+	/**
+	 * @param name a name for "--enable-lock-stats" (see
+	 * #LockStats); must be a string literal
+	 */
+#ifndef __BIONIC__
+	constexpr
+#endif
+	explicit Mutex(const char *) {}
+};
 
 #endif
 
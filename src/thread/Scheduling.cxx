@@ -0,0 +1,296 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Scheduling.hxx"
+#include "config/ConfigData.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "config/ConfigError.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <string>
+#include <map>
+
+#include <stdlib.h>
+#include <string.h>
+
+static constexpr Domain thread_domain("thread");
+
+/**
+ * The names which may be used in a "thread" block.  Output threads
+ * are configured in their "audio_output" block.
+ */
+static constexpr const char *thread_names[] = {
+	"io",
+	"player",
+	"decoder",
+	"update",
+	"zeroconf",
+	nullptr
+};
+
+static std::map<std::string, ThreadScheduling> thread_schedulings;
+
+#ifdef __linux__
+
+static bool
+ParsePolicy(const char *s, ThreadScheduling::Policy &policy_r)
+{
+	using Policy = ThreadScheduling::Policy;
+
+	static constexpr struct {
+		const char *name;
+		Policy policy;
+	} policies[] = {
+		{ "other", Policy::OTHER },
+		{ "batch", Policy::BATCH },
+		{ "idle", Policy::IDLE },
+		{ "fifo", Policy::FIFO },
+		{ "rr", Policy::RR },
+	};
+
+	for (const auto &i : policies) {
+		if (strcmp(s, i.name) == 0) {
+			policy_r = i.policy;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static int
+ToLinuxPolicy(ThreadScheduling::Policy policy)
+{
+	using Policy = ThreadScheduling::Policy;
+
+	switch (policy) {
+	case Policy::DEFAULT:
+	case Policy::OTHER:
+		break;
+
+	case Policy::BATCH:
+#ifdef SCHED_BATCH
+		return SCHED_BATCH;
+#else
+		break;
+#endif
+
+	case Policy::IDLE:
+#ifdef SCHED_IDLE
+		return SCHED_IDLE;
+#else
+		break;
+#endif
+
+	case Policy::FIFO:
+		return SCHED_FIFO;
+
+	case Policy::RR:
+		return SCHED_RR;
+	}
+
+	return SCHED_OTHER;
+}
+
+/**
+ * Parse a CPU list like "0,2-3".
+ */
+static bool
+ParseCpuList(const char *s, cpu_set_t &set, Error &error)
+{
+	CPU_ZERO(&set);
+
+	while (true) {
+		char *endptr;
+		unsigned long first = strtoul(s, &endptr, 10);
+		unsigned long last = first;
+		if (endptr == s)
+			break;
+
+		if (*endptr == '-') {
+			s = endptr + 1;
+			last = strtoul(s, &endptr, 10);
+			if (endptr == s || last < first)
+				break;
+		}
+
+		if (last >= CPU_SETSIZE) {
+			error.Format(config_domain,
+				     "CPU number %lu is too large", last);
+			return false;
+		}
+
+		for (unsigned long i = first; i <= last; ++i)
+			CPU_SET(i, &set);
+
+		if (*endptr == 0)
+			return true;
+
+		if (*endptr != ',')
+			break;
+
+		s = endptr + 1;
+	}
+
+	error.Format(config_domain, "Malformed CPU list: %s", s);
+	return false;
+}
+
+#endif
+
+bool
+ThreadScheduling::Configure(const config_param &param, Error &error)
+{
+	const char *policy_name = param.GetBlockValue("scheduling_policy");
+	const char *affinity_list = param.GetBlockValue("cpu_affinity");
+	const int _priority = param.GetBlockValue("scheduling_priority", 0);
+
+#ifdef __linux__
+	if (policy_name != nullptr &&
+	    !ParsePolicy(policy_name, policy)) {
+		error.Format(config_domain,
+			     "Unknown scheduling policy \"%s\", line %i",
+			     policy_name, param.line);
+		return false;
+	}
+
+	if (policy == Policy::FIFO || policy == Policy::RR) {
+		const int linux_policy = ToLinuxPolicy(policy);
+		const int min = sched_get_priority_min(linux_policy);
+		const int max = sched_get_priority_max(linux_policy);
+		priority = _priority != 0 ? _priority : (min + max) / 2;
+		if (priority < min || priority > max) {
+			error.Format(config_domain,
+				     "Scheduling priority must be between %d and %d, line %i",
+				     min, max, param.line);
+			return false;
+		}
+	} else if (_priority != 0) {
+		error.Format(config_domain,
+			     "\"scheduling_priority\" requires the policy \"fifo\" or \"rr\", line %i",
+			     param.line);
+		return false;
+	}
+
+	if (affinity_list != nullptr) {
+		if (!ParseCpuList(affinity_list, affinity, error))
+			return false;
+
+		have_affinity = true;
+	}
+
+	return true;
+#else
+	if (policy_name != nullptr || affinity_list != nullptr ||
+	    _priority != 0) {
+		error.Format(config_domain,
+			     "Thread scheduling settings are not supported on this platform, line %i",
+			     param.line);
+		return false;
+	}
+
+	return true;
+#endif
+}
+
+void
+ThreadScheduling::Apply(const char *name) const
+{
+#ifdef __linux__
+	if (policy != Policy::DEFAULT) {
+		struct sched_param sched_param;
+		sched_param.sched_priority = priority;
+
+		int linux_policy = ToLinuxPolicy(policy);
+#ifdef SCHED_RESET_ON_FORK
+		if (policy == Policy::FIFO || policy == Policy::RR)
+			linux_policy |= SCHED_RESET_ON_FORK;
+#endif
+
+		if (sched_setscheduler(0, linux_policy, &sched_param) < 0)
+			FormatErrno(thread_domain,
+				    "Failed to set the scheduling policy of thread \"%s\"",
+				    name);
+	}
+
+	if (have_affinity &&
+	    sched_setaffinity(0, sizeof(affinity), &affinity) < 0)
+		FormatErrno(thread_domain,
+			    "Failed to set the CPU affinity of thread \"%s\"",
+			    name);
+#else
+	(void)name;
+#endif
+}
+
+gcc_pure
+static bool
+IsValidThreadName(const char *name)
+{
+	for (unsigned i = 0; thread_names[i] != nullptr; ++i)
+		if (strcmp(thread_names[i], name) == 0)
+			return true;
+
+	return false;
+}
+
+bool
+thread_scheduling_global_init(Error &error)
+{
+	for (const config_param *param = config_get_param(CONF_THREAD);
+	     param != nullptr; param = param->next) {
+		const char *name = param->GetBlockValue("name");
+		if (name == nullptr) {
+			error.Format(config_domain,
+				     "Missing \"name\" in thread block, line %i",
+				     param->line);
+			return false;
+		}
+
+		if (!IsValidThreadName(name)) {
+			error.Format(config_domain,
+				     "Unknown thread name \"%s\", line %i",
+				     name, param->line);
+			return false;
+		}
+
+		ThreadScheduling scheduling;
+		if (!scheduling.Configure(*param, error))
+			return false;
+
+		thread_schedulings[name] = scheduling;
+	}
+
+	return true;
+}
+
+void
+thread_scheduling_apply(const char *name)
+{
+	/* the map is not modified after
+	   thread_scheduling_global_init(), so it may be accessed from
+	   any thread without locking */
+	auto i = thread_schedulings.find(name);
+	if (i != thread_schedulings.end())
+		i->second.Apply(name);
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_THREAD_SCHEDULING_HXX
+#define MPD_THREAD_SCHEDULING_HXX
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include <stdint.h>
+
+struct config_param;
+class Error;
+
+/**
+ * Configurable scheduling settings of a thread: the scheduling
+ * policy, its priority and the CPUs the thread may run on.
+ */
+class ThreadScheduling {
+public:
+	enum class Policy : uint8_t {
+		/**
+		 * Don't change the policy; use the thread's built-in
+		 * default.
+		 */
+		DEFAULT,
+
+		OTHER,
+		BATCH,
+		IDLE,
+		FIFO,
+		RR,
+	};
+
+private:
+	Policy policy;
+
+	/**
+	 * The real-time priority; only used with #Policy::FIFO and
+	 * #Policy::RR.
+	 */
+	int priority;
+
+#ifdef __linux__
+	bool have_affinity;
+	cpu_set_t affinity;
+#endif
+
+public:
+	ThreadScheduling()
+		:policy(Policy::DEFAULT), priority(0)
+#ifdef __linux__
+		, have_affinity(false)
+#endif
+	{}
+
+	/**
+	 * Was a scheduling policy configured?  If not, the thread
+	 * should apply its own default.
+	 */
+	bool HasPolicy() const {
+		return policy != Policy::DEFAULT;
+	}
+
+	/**
+	 * Read the settings "scheduling_policy",
+	 * "scheduling_priority" and "cpu_affinity" from a
+	 * configuration block.
+	 */
+	bool Configure(const config_param &param, Error &error);
+
+	/**
+	 * Apply the settings to the current thread.  Errors are only
+	 * logged, because the thread can run without them.
+	 *
+	 * @param name the name of the thread, for log messages
+	 */
+	void Apply(const char *name) const;
+};
+
+/**
+ * Load the "thread" blocks from the configuration file.
+ */
+bool
+thread_scheduling_global_init(Error &error);
+
+/**
+ * Apply the settings of the "thread" block with the given name (if
+ * any) to the current thread.
+ */
+void
+thread_scheduling_apply(const char *name);
+
+#endif
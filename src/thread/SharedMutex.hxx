@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2009-2014 Max Kellermann <max@duempel.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef THREAD_SHARED_MUTEX_HXX
+#define THREAD_SHARED_MUTEX_HXX
+
+#include "Compiler.h"
+
+#ifdef WIN32
+
+#include <windows.h>
+
+/**
+ * A reader/writer lock: any number of threads may hold it in
+ * "shared" mode, but only one in exclusive mode.  Neither mode is
+ * recursive.
+ */
+class SharedMutex {
+	SRWLOCK srwlock;
+
+public:
+	SharedMutex() {
+		::InitializeSRWLock(&srwlock);
+	}
+
+	/**
+	 * @param name a name for "--enable-lock-stats" (ignored on
+	 * this platform)
+	 */
+	explicit SharedMutex(const char *):SharedMutex() {}
+
+	SharedMutex(const SharedMutex &other) = delete;
+	SharedMutex &operator=(const SharedMutex &other) = delete;
+
+	void lock() {
+		::AcquireSRWLockExclusive(&srwlock);
+	}
+
+	void unlock() {
+		::ReleaseSRWLockExclusive(&srwlock);
+	}
+
+	void lock_shared() {
+		::AcquireSRWLockShared(&srwlock);
+	}
+
+	void unlock_shared() {
+		::ReleaseSRWLockShared(&srwlock);
+	}
+};
+
+#else
+
+#ifdef ENABLE_LOCK_STATS
+#include "LockStats.hxx"
+#endif
+
+#include <pthread.h>
+
+/**
+ * A reader/writer lock: any number of threads may hold it in
+ * "shared" mode, but only one in exclusive mode.  Neither mode is
+ * recursive.
+ *
+ * With glibc, a thread waiting for exclusive access blocks new
+ * readers, so a steady stream of readers cannot starve it.
+ */
+class SharedMutex {
+	pthread_rwlock_t rwlock;
+
+#ifdef ENABLE_LOCK_STATS
+	LockStats *const stats;
+#endif
+
+public:
+	SharedMutex()
+#ifdef ENABLE_LOCK_STATS
+		:stats(nullptr)
+#endif
+	{
+		Init();
+	}
+
+	/**
+	 * @param name a name for "--enable-lock-stats" (see
+	 * #LockStats); must be a string literal
+	 */
+	explicit SharedMutex(gcc_unused const char *name)
+#ifdef ENABLE_LOCK_STATS
+		:stats(&LockStats::Get(name))
+#endif
+	{
+		Init();
+	}
+
+	~SharedMutex() {
+		pthread_rwlock_destroy(&rwlock);
+	}
+
+	SharedMutex(const SharedMutex &other) = delete;
+	SharedMutex &operator=(const SharedMutex &other) = delete;
+
+#ifdef ENABLE_LOCK_STATS
+	void lock() {
+		if (stats == nullptr) {
+			pthread_rwlock_wrlock(&rwlock);
+			return;
+		}
+
+		stats->Acquire();
+		if (pthread_rwlock_trywrlock(&rwlock) == 0)
+			return;
+
+		stats->Contend();
+		const uint64_t start = LockStats::Now();
+		pthread_rwlock_wrlock(&rwlock);
+		stats->AddWait(LockStats::Now() - start);
+	}
+
+	void lock_shared() {
+		if (stats == nullptr) {
+			pthread_rwlock_rdlock(&rwlock);
+			return;
+		}
+
+		stats->Acquire();
+		if (pthread_rwlock_tryrdlock(&rwlock) == 0)
+			return;
+
+		stats->Contend();
+		const uint64_t start = LockStats::Now();
+		pthread_rwlock_rdlock(&rwlock);
+		stats->AddWait(LockStats::Now() - start);
+	}
+#else
+	void lock() {
+		pthread_rwlock_wrlock(&rwlock);
+	}
+
+	void lock_shared() {
+		pthread_rwlock_rdlock(&rwlock);
+	}
+#endif
+
+	void unlock() {
+		pthread_rwlock_unlock(&rwlock);
+	}
+
+	void unlock_shared() {
+		pthread_rwlock_unlock(&rwlock);
+	}
+
+private:
+	void Init() {
+#ifdef __GLIBC__
+		pthread_rwlockattr_t attr;
+		pthread_rwlockattr_init(&attr);
+		pthread_rwlockattr_setkind_np(&attr,
+					      PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+		pthread_rwlock_init(&rwlock, &attr);
+		pthread_rwlockattr_destroy(&attr);
+#else
+		pthread_rwlock_init(&rwlock, nullptr);
+#endif
+	}
+};
+
+#endif
+
+#endif
@@ -29,6 +29,12 @@
 #include "system/FatalError.hxx"
 #include "util/Domain.hxx"
 
+#ifdef ENABLE_LOCK_STATS
+#include "thread/LockStats.hxx"
+
+#include <stdio.h>
+#endif
+
 #include <signal.h>
 
 static constexpr Domain signal_handlers_domain("signal_handlers");
@@ -53,6 +59,40 @@ handle_reload_event(void)
 	cycle_log_files();
 }
 
+#ifdef ENABLE_LOCK_STATS
+
+/**
+ * Write all #LockStats to the log.
+ */
+static void
+handle_lock_stats_event(void)
+{
+	for (const LockStats *s = LockStats::GetFirst(); s != nullptr;
+	     s = s->next) {
+		/* only the non-empty part of the histogram */
+		unsigned n = LockStats::N_BUCKETS;
+		while (n > 0 && s->histogram[n - 1].load() == 0)
+			--n;
+
+		char buffer[LockStats::N_BUCKETS * 21], *p = buffer;
+		*p = 0;
+		for (unsigned i = 0; i < n; ++i)
+			p += sprintf(p, " %llu",
+				     (unsigned long long)s->histogram[i].load());
+
+		FormatDefault(signal_handlers_domain,
+			      "lock %s: acquisitions=%llu contentions=%llu"
+			      " wait_us=%llu histogram:%s",
+			      s->name,
+			      (unsigned long long)s->acquisitions.load(),
+			      (unsigned long long)s->contentions.load(),
+			      (unsigned long long)s->wait_us.load(),
+			      buffer);
+	}
+}
+
+#endif
+
 #endif
 
 void
@@ -72,6 +112,10 @@ SignalHandlersInit(EventLoop &loop)
 	SignalMonitorRegister(SIGTERM, HandleShutdownSignal);
 
 	SignalMonitorRegister(SIGHUP, handle_reload_event);
+
+#ifdef ENABLE_LOCK_STATS
+	SignalMonitorRegister(SIGUSR2, handle_lock_stats_event);
+#endif
 #endif
 }
 
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Arena.hxx"
+#include "Alloc.hxx"
+
+#include <assert.h>
+#include <stdlib.h>
+
+void *
+Arena::Allocate(size_t size)
+{
+	size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+	if (size > available) {
+		/* the chunk header occupies the first bytes; the rest
+		   of the current chunk is abandoned */
+		constexpr size_t header = (sizeof(Chunk) + ALIGNMENT - 1)
+			& ~(ALIGNMENT - 1);
+		const size_t chunk_size = size + header > CHUNK_SIZE
+			? size + header
+			: CHUNK_SIZE;
+
+		Chunk *chunk = (Chunk *)xalloc(chunk_size);
+		chunk->next = head;
+		chunk->size = chunk_size;
+		head = chunk;
+		MemoryStatsAdd(category, chunk_size);
+
+		position = (char *)chunk + header;
+		available = chunk_size - header;
+	}
+
+	void *p = position;
+	position += size;
+	available -= size;
+	return p;
+}
+
+void
+Arena::Clear()
+{
+	while (head != nullptr) {
+		Chunk *chunk = head;
+		head = chunk->next;
+		MemoryStatsSub(category, chunk->size);
+		free(chunk);
+	}
+
+	position = nullptr;
+	available = 0;
+}
+
+void
+Arena::Splice(Arena &other)
+{
+	assert(other.category == category);
+
+	if (other.head == nullptr)
+		return;
+
+	/* prepend the other list; new allocations continue in the
+	   other's current chunk, the rest of ours is abandoned */
+	Chunk *tail = other.head;
+	while (tail->next != nullptr)
+		tail = tail->next;
+
+	tail->next = head;
+	head = other.head;
+	position = other.position;
+	available = other.available;
+
+	other.head = nullptr;
+	other.position = nullptr;
+	other.available = 0;
+}
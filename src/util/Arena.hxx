@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_ARENA_HXX
+#define MPD_ARENA_HXX
+
+#include "MemoryStats.hxx"
+#include "Compiler.h"
+
+#include <stddef.h>
+
+/**
+ * A bump allocator: allocations are carved from large chunks, and
+ * there is no way to free them individually; all memory is released
+ * at once by Clear() or by the destructor.  This avoids the
+ * per-allocation overhead and fragmentation of the heap for many
+ * small objects with the same lifetime.
+ *
+ * The chunks are accounted in the #MemoryCategory passed to the
+ * constructor.
+ *
+ * This class is not thread-safe.
+ */
+class Arena {
+	struct Chunk {
+		Chunk *next;
+		size_t size;
+	};
+
+	static constexpr size_t CHUNK_SIZE = 256 * 1024;
+
+	/**
+	 * All allocations are aligned to this.
+	 */
+	static constexpr size_t ALIGNMENT = sizeof(void *) > 8
+		? sizeof(void *) : 8;
+
+	const MemoryCategory category;
+
+	Chunk *head;
+
+	char *position;
+	size_t available;
+
+public:
+	explicit Arena(MemoryCategory _category)
+		:category(_category),
+		 head(nullptr), position(nullptr), available(0) {}
+
+	~Arena() {
+		Clear();
+	}
+
+	Arena(const Arena &) = delete;
+	Arena &operator=(const Arena &) = delete;
+
+	/**
+	 * Allocate uninitialized memory.  It is never freed before
+	 * Clear().  This method never fails; in out-of-memory
+	 * situations, it aborts the process.
+	 */
+	gcc_malloc
+	void *Allocate(size_t size);
+
+	/**
+	 * Free all memory allocated by this object.
+	 */
+	void Clear();
+
+	/**
+	 * Take over all chunks of another arena.  The other arena
+	 * becomes empty, and the memory allocated by it lives until
+	 * this object is cleared.  Both must have the same
+	 * #MemoryCategory.
+	 */
+	void Splice(Arena &other);
+};
+
+#endif
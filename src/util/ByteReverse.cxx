@@ -21,8 +21,25 @@
 #include "system/ByteOrder.hxx"
 #include "Compiler.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include <assert.h>
 
+#ifdef __SSE2__
+
+/**
+ * Swap the two bytes of each 16 bit integer.
+ */
+static inline __m128i
+sse2_byte_swap_16(__m128i x)
+{
+	return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+
+#endif
+
 void
 reverse_bytes_16(uint16_t *gcc_restrict dest,
 		 const uint16_t *gcc_restrict src, const uint16_t *src_end)
@@ -31,6 +48,13 @@ reverse_bytes_16(uint16_t *gcc_restrict dest,
 	assert(src != nullptr);
 	assert(src_end >= src);
 
+#ifdef __SSE2__
+	for (; src_end - src >= 8; src += 8, dest += 8) {
+		__m128i x = _mm_loadu_si128((const __m128i *)src);
+		_mm_storeu_si128((__m128i *)dest, sse2_byte_swap_16(x));
+	}
+#endif
+
 	while (src < src_end) {
 		const uint16_t x = *src++;
 		*dest++ = ByteSwap16(x);
@@ -45,6 +69,17 @@ reverse_bytes_32(uint32_t *gcc_restrict dest,
 	assert(src != nullptr);
 	assert(src_end >= src);
 
+#ifdef __SSE2__
+	for (; src_end - src >= 4; src += 4, dest += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i *)src);
+
+		/* swap the 16 bit halves, then the bytes within */
+		x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+		x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+		_mm_storeu_si128((__m128i *)dest, sse2_byte_swap_16(x));
+	}
+#endif
+
 	while (src < src_end) {
 		const uint32_t x = *src++;
 		*dest++ = ByteSwap32(x);
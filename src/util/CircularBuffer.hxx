@@ -46,6 +46,11 @@
  * If both are equal, then the buffer is empty.  Due to this
  * implementation detail, the buffer is empty when #size-1 items are
  * stored; the last buffer cell cannot be used.
+ *
+ * If the memory is "mirrored" (see HugeAllocateMirrored()), i.e. the
+ * #capacity elements after #data are another mapping of the same
+ * memory, then Read() and Write() return all stored data and all
+ * free space as one range, even when it wraps around.
  */
 template<typename T>
 class CircularBuffer {
@@ -68,9 +73,17 @@ protected:
 	const size_type capacity;
 	const pointer_type data;
 
+	/**
+	 * Is the memory mapped a second time right after the end of
+	 * #data?
+	 */
+	const bool mirrored;
+
 public:
-	constexpr CircularBuffer(pointer_type _data, size_type _capacity)
-		:head(0), tail(0), capacity(_capacity), data(_data) {}
+	constexpr CircularBuffer(pointer_type _data, size_type _capacity,
+				 bool _mirrored=false)
+		:head(0), tail(0), capacity(_capacity), data(_data),
+		 mirrored(_mirrored) {}
 
 	CircularBuffer(const CircularBuffer &other) = delete;
 
@@ -90,6 +103,10 @@ public:
 		return capacity;
 	}
 
+	constexpr bool IsMirrored() const {
+		return mirrored;
+	}
+
 	constexpr bool IsEmpty() const {
 		return head == tail;
 	}
@@ -127,6 +144,9 @@ public:
 		assert(head < capacity);
 		assert(tail < capacity);
 
+		if (mirrored)
+			return Range(data + tail, GetSpace());
+
 		size_type end = tail < head
 			? head - 1
 			/* the "head==0" is there so we don't write
@@ -145,14 +165,14 @@ public:
 		assert(head < capacity);
 		assert(tail < capacity);
 		assert(n < capacity);
-		assert(tail + n <= capacity);
-		assert(head <= tail || tail + n < head);
+		assert(mirrored || tail + n <= capacity);
+		assert(n <= GetSpace());
 
 		tail += n;
 
-		if (tail == capacity) {
-			assert(head > 0);
-			tail = 0;
+		if (tail >= capacity) {
+			assert(mirrored || tail == capacity);
+			tail -= capacity;
 		}
 	}
 
@@ -164,6 +184,9 @@ public:
 		assert(head < capacity);
 		assert(tail < capacity);
 
+		if (mirrored)
+			return Range(data + head, GetSize());
+
 		return Range(data + head, (tail < head ? capacity : tail) - head);
 	}
 
@@ -174,12 +197,14 @@ public:
 		assert(head < capacity);
 		assert(tail < capacity);
 		assert(n < capacity);
-		assert(head + n <= capacity);
-		assert(tail < head || head + n <= tail);
+		assert(mirrored || head + n <= capacity);
+		assert(n <= GetSize());
 
 		head += n;
-		if (head == capacity)
-			head = 0;
+		if (head >= capacity) {
+			assert(mirrored || head == capacity);
+			head -= capacity;
+		}
 	}
 };
 
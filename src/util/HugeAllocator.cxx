@@ -31,7 +31,9 @@
 
 #ifdef __linux__
 #include <sys/mman.h>
+#include <sys/syscall.h>
 #include <unistd.h>
+#include <stdint.h>
 #else
 #include <stdlib.h>
 #endif
@@ -46,7 +48,7 @@ static size_t
 AlignToPageSize(size_t size)
 {
 	static const long page_size = sysconf(_SC_PAGESIZE);
-	if (page_size > 0)
+	if (page_size <= 0)
 		return size;
 
 	size_t ps(page_size);
@@ -94,4 +96,78 @@ HugeDiscard(void *p, size_t size)
 #endif
 }
 
+#ifdef SYS_memfd_create
+
+void *
+HugeAllocateMirrored(size_t size)
+{
+	if (size == 0 || AlignToPageSize(size) != size)
+		return nullptr;
+
+	/* an anonymous shared memory file provides the pages which
+	   are mapped twice */
+	constexpr unsigned mfd_cloexec = 0x1; /* MFD_CLOEXEC */
+	const int fd = syscall(SYS_memfd_create, "mpd-ring", mfd_cloexec);
+	if (fd < 0)
+		return nullptr;
+
+	if (ftruncate(fd, size) < 0) {
+		close(fd);
+		return nullptr;
+	}
+
+	/* reserve address space for both copies, then replace its
+	   two halves with the file */
+	uint8_t *p = (uint8_t *)mmap(nullptr, size * 2, PROT_NONE,
+				     MAP_ANONYMOUS|MAP_PRIVATE|MAP_NORESERVE,
+				     -1, 0);
+	if (p == (uint8_t *)-1) {
+		close(fd);
+		return nullptr;
+	}
+
+	constexpr int flags = MAP_SHARED|MAP_FIXED;
+	if (mmap(p, size, PROT_READ|PROT_WRITE, flags,
+		 fd, 0) == (void *)-1 ||
+	    mmap(p + size, size, PROT_READ|PROT_WRITE, flags,
+		 fd, 0) == (void *)-1) {
+		munmap(p, size * 2);
+		close(fd);
+		return nullptr;
+	}
+
+	/* the mappings keep the file alive */
+	close(fd);
+
+#ifdef MADV_HUGEPAGE
+	/* huge pages are used if the kernel enables them for shared
+	   memory ("shmem_enabled") */
+	madvise(p, size * 2, MADV_HUGEPAGE);
+#endif
+
+#ifdef MADV_DONTFORK
+	madvise(p, size * 2, MADV_DONTFORK);
+#endif
+
+	return p;
+}
+
+#else
+
+void *
+HugeAllocateMirrored(gcc_unused size_t size)
+{
+	/* no memfd_create(): the caller falls back to
+	   HugeAllocate() */
+	return nullptr;
+}
+
+#endif
+
+void
+HugeFreeMirrored(void *p, size_t size)
+{
+	munmap(p, size * 2);
+}
+
 #endif
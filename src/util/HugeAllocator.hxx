@@ -63,6 +63,28 @@ HugeFree(void *p, size_t size);
 void
 HugeDiscard(void *p, size_t size);
 
+/**
+ * Allocate memory for a ring buffer which is mapped twice: the
+ * pages at p+size are the same as the ones at p.  Data which wraps
+ * around the end of the buffer can therefore be accessed as one
+ * contiguous range.
+ *
+ * @param size the size of the buffer; must be a multiple of the
+ * page size
+ * @return the allocation, or nullptr on error or if the size is not
+ * suitable (the caller should fall back to HugeAllocate())
+ */
+void *
+HugeAllocateMirrored(size_t size);
+
+/**
+ * @param p an allocation returned by HugeAllocateMirrored()
+ * @param size the allocation's size as passed to
+ * HugeAllocateMirrored()
+ */
+void
+HugeFreeMirrored(void *p, size_t size);
+
 #elif defined(WIN32)
 #include <windows.h>
 
@@ -85,6 +107,17 @@ HugeDiscard(void *p, size_t size)
 	VirtualAlloc(p, size, MEM_RESET, PAGE_NOACCESS);
 }
 
+static inline void *
+HugeAllocateMirrored(size_t)
+{
+	return nullptr;
+}
+
+static inline void
+HugeFreeMirrored(void *, size_t)
+{
+}
+
 #else
 
 /* not Linux: fall back to standard C calls */
@@ -109,6 +142,17 @@ HugeDiscard(void *, size_t)
 {
 }
 
+static inline void *
+HugeAllocateMirrored(size_t)
+{
+	return nullptr;
+}
+
+static inline void
+HugeFreeMirrored(void *, size_t)
+{
+}
+
 #endif
 
 #endif
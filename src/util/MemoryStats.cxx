@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "MemoryStats.hxx"
+
+#include <assert.h>
+
+/* zero-initialized before any static constructor runs */
+MemoryCounter memory_counters[size_t(MemoryCategory::MAX)];
+
+static const char *const memory_category_names[] = {
+	"database",
+	"tag",
+	"queue",
+	"music_buffer",
+	"input",
+	"client",
+	"pcm",
+};
+
+static_assert(sizeof(memory_category_names) /
+	      sizeof(memory_category_names[0]) ==
+	      size_t(MemoryCategory::MAX),
+	      "Wrong number of memory category names");
+
+void
+MemoryStatsResize(MemoryCategory category, size_t old_size, size_t new_size)
+{
+	if (old_size > 0)
+		MemoryStatsSub(category, old_size);
+	if (new_size > 0)
+		MemoryStatsAdd(category, new_size);
+}
+
+size_t
+MemoryStatsGetTotal()
+{
+	size_t total = 0;
+	for (const auto &i : memory_counters)
+		total += i.bytes.load(std::memory_order_relaxed);
+	return total;
+}
+
+const char *
+MemoryCategoryName(MemoryCategory category)
+{
+	assert(category < MemoryCategory::MAX);
+
+	return memory_category_names[size_t(category)];
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_MEMORY_STATS_HXX
+#define MPD_MEMORY_STATS_HXX
+
+#include "Compiler.h"
+
+#include <atomic>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The subsystems whose memory usage is accounted.  The long-lived
+ * allocations of each one are reported to MemoryStatsAdd() and
+ * MemoryStatsSub(); the small temporary ones are not.
+ */
+enum class MemoryCategory : uint8_t {
+	/**
+	 * Songs and directories of the "simple" database.
+	 */
+	DATABASE,
+
+	/**
+	 * The tag pool: tag values, their hash table and the tag item
+	 * arrays.
+	 */
+	TAG,
+
+	/**
+	 * The queue and the #DetachedSong objects in it.
+	 */
+	QUEUE,
+
+	/**
+	 * The #MusicBuffer shared by the decoder and the player.
+	 */
+	MUSIC_BUFFER,
+
+	/**
+	 * Buffers of #InputStream implementations.
+	 */
+	INPUT,
+
+	/**
+	 * Output buffers of client connections.
+	 */
+	CLIENT,
+
+	/**
+	 * #PcmBuffer instances of the decoder, the filters and the
+	 * outputs.
+	 */
+	PCM,
+
+	MAX
+};
+
+/**
+ * The counters of one #MemoryCategory.  All methods are thread-safe
+ * and lock-free.
+ */
+struct MemoryCounter {
+	/**
+	 * The number of bytes currently allocated.
+	 */
+	std::atomic<size_t> bytes;
+
+	/**
+	 * The highest value #bytes has ever had.
+	 */
+	std::atomic<size_t> peak;
+
+	/**
+	 * The number of allocations which are currently alive.
+	 */
+	std::atomic<size_t> allocations;
+
+	void Add(size_t size) {
+		const size_t new_bytes =
+			bytes.fetch_add(size, std::memory_order_relaxed)
+			+ size;
+		allocations.fetch_add(1, std::memory_order_relaxed);
+
+		size_t old_peak = peak.load(std::memory_order_relaxed);
+		while (gcc_unlikely(new_bytes > old_peak) &&
+		       !peak.compare_exchange_weak(old_peak, new_bytes,
+						   std::memory_order_relaxed)) {}
+	}
+
+	void Sub(size_t size) {
+		bytes.fetch_sub(size, std::memory_order_relaxed);
+		allocations.fetch_sub(1, std::memory_order_relaxed);
+	}
+};
+
+extern MemoryCounter memory_counters[size_t(MemoryCategory::MAX)];
+
+/**
+ * Account an allocation.
+ */
+static inline void
+MemoryStatsAdd(MemoryCategory category, size_t size)
+{
+	memory_counters[size_t(category)].Add(size);
+}
+
+/**
+ * Account the release of an allocation which was passed to
+ * MemoryStatsAdd() before.
+ */
+static inline void
+MemoryStatsSub(MemoryCategory category, size_t size)
+{
+	memory_counters[size_t(category)].Sub(size);
+}
+
+/**
+ * Account a reallocation from #old_size to #new_size; zero means
+ * "not allocated".
+ */
+void
+MemoryStatsResize(MemoryCategory category, size_t old_size, size_t new_size);
+
+static inline const MemoryCounter &
+MemoryStatsGet(MemoryCategory category)
+{
+	return memory_counters[size_t(category)];
+}
+
+/**
+ * Returns the sum of the #MemoryCounter::bytes of all categories.
+ */
+gcc_pure
+size_t
+MemoryStatsGetTotal();
+
+/**
+ * Returns the name of the category, as used by the protocol.
+ */
+gcc_const
+const char *
+MemoryCategoryName(MemoryCategory category);
+
+#endif
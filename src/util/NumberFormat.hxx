@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2009-2013 Max Kellermann <max@duempel.org>
+ * http://www.musicpd.org
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef NUMBER_FORMAT_HXX
+#define NUMBER_FORMAT_HXX
+
+#include <stdint.h>
+
+/**
+ * Format an unsigned integer in decimal notation.  This is a lot
+ * cheaper than snprintf().  The result is not null-terminated.
+ *
+ * @param buffer a buffer with room for at least 20 characters
+ * @return a pointer to the end of the number within #buffer
+ */
+static inline char *
+FormatUint64(char *buffer, uint64_t value)
+{
+	char tmp[20];
+	char *p = tmp + sizeof(tmp);
+
+	do {
+		*--p = '0' + char(value % 10);
+		value /= 10;
+	} while (value > 0);
+
+	while (p < tmp + sizeof(tmp))
+		*buffer++ = *p++;
+
+	return buffer;
+}
+
+/**
+ * Format a two-digit number with a leading zero (for time stamps).
+ * The result is not null-terminated.
+ *
+ * @return a pointer to the end of the number within #buffer
+ */
+static inline char *
+FormatTwoDigits(char *buffer, unsigned value)
+{
+	*buffer++ = '0' + char(value / 10 % 10);
+	*buffer++ = '0' + char(value % 10);
+	return buffer;
+}
+
+#endif
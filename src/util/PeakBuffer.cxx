@@ -27,8 +27,25 @@
 
 PeakBuffer::~PeakBuffer()
 {
-	delete normal_buffer;
-	delete peak_buffer;
+	DeleteBuffer(normal_buffer);
+	DeleteBuffer(peak_buffer);
+}
+
+DynamicFifoBuffer<uint8_t> *
+PeakBuffer::NewBuffer(size_t size) const
+{
+	MemoryStatsAdd(category, size);
+	return new DynamicFifoBuffer<uint8_t>(size);
+}
+
+void
+PeakBuffer::DeleteBuffer(DynamicFifoBuffer<uint8_t> *buffer) const
+{
+	if (buffer == nullptr)
+		return;
+
+	MemoryStatsSub(category, buffer->GetCapacity());
+	delete buffer;
 }
 
 bool
@@ -56,18 +73,44 @@ PeakBuffer::Read() const
 	return nullptr;
 }
 
+unsigned
+PeakBuffer::ReadV(ConstBuffer<void> *dest) const
+{
+	unsigned n = 0;
+
+	if (normal_buffer != nullptr) {
+		const auto p = normal_buffer->Read();
+		if (!p.IsEmpty())
+			dest[n++] = { p.data, p.size };
+	}
+
+	if (peak_buffer != nullptr) {
+		const auto p = peak_buffer->Read();
+		if (!p.IsEmpty())
+			dest[n++] = { p.data, p.size };
+	}
+
+	return n;
+}
+
 void
 PeakBuffer::Consume(size_t length)
 {
 	if (normal_buffer != nullptr && !normal_buffer->IsEmpty()) {
-		normal_buffer->Consume(length);
-		return;
+		const size_t available = normal_buffer->Read().size;
+		if (length <= available) {
+			normal_buffer->Consume(length);
+			return;
+		}
+
+		normal_buffer->Consume(available);
+		length -= available;
 	}
 
 	if (peak_buffer != nullptr && !peak_buffer->IsEmpty()) {
 		peak_buffer->Consume(length);
 		if (peak_buffer->IsEmpty()) {
-			delete peak_buffer;
+			DeleteBuffer(peak_buffer);
 			peak_buffer = nullptr;
 		}
 
@@ -112,7 +155,7 @@ PeakBuffer::Append(const void *data, size_t length)
 	}
 
 	if (normal_buffer == nullptr)
-		normal_buffer = new DynamicFifoBuffer<uint8_t>(normal_size);
+		normal_buffer = NewBuffer(normal_size);
 
 	size_t nbytes = AppendTo(*normal_buffer, data, length);
 	if (nbytes > 0) {
@@ -124,7 +167,7 @@ PeakBuffer::Append(const void *data, size_t length)
 
 	if (peak_buffer == nullptr) {
 		if (peak_size > 0)
-			peak_buffer = new DynamicFifoBuffer<uint8_t>(peak_size);
+			peak_buffer = NewBuffer(peak_size);
 		if (peak_buffer == nullptr)
 			return false;
 	}
@@ -132,3 +175,32 @@ PeakBuffer::Append(const void *data, size_t length)
 	nbytes = AppendTo(*peak_buffer, data, length);
 	return nbytes == length;
 }
+
+WritableBuffer<void>
+PeakBuffer::Write()
+{
+	if (peak_buffer != nullptr && !peak_buffer->IsEmpty())
+		return peak_buffer->Write().ToVoid();
+
+	if (normal_buffer == nullptr)
+		normal_buffer = NewBuffer(normal_size);
+
+	const auto p = normal_buffer->Write();
+	if (!p.IsEmpty() || peak_size == 0)
+		return p.ToVoid();
+
+	if (peak_buffer == nullptr)
+		peak_buffer = NewBuffer(peak_size);
+
+	return peak_buffer->Write().ToVoid();
+}
+
+void
+PeakBuffer::Append(size_t length)
+{
+	if (peak_buffer != nullptr &&
+	    (!peak_buffer->IsEmpty() || normal_buffer->Write().IsEmpty()))
+		peak_buffer->Append(length);
+	else
+		normal_buffer->Append(length);
+}
@@ -21,6 +21,8 @@
 #define MPD_PEAK_BUFFER_HXX
 
 #include "WritableBuffer.hxx"
+#include "ConstBuffer.hxx"
+#include "MemoryStats.hxx"
 #include "Compiler.h"
 
 #include <stddef.h>
@@ -33,19 +35,27 @@ template<typename T> class DynamicFifoBuffer;
  * A FIFO-like buffer that will allocate more memory on demand to
  * allow large peaks.  This second buffer will be given back to the
  * kernel when it has been consumed.
+ *
+ * Both buffers are accounted in the #MemoryCategory passed to the
+ * constructor.
  */
 class PeakBuffer {
 	size_t normal_size, peak_size;
 
+	MemoryCategory category;
+
 	DynamicFifoBuffer<uint8_t> *normal_buffer, *peak_buffer;
 
 public:
-	PeakBuffer(size_t _normal_size, size_t _peak_size)
+	PeakBuffer(size_t _normal_size, size_t _peak_size,
+		   MemoryCategory _category)
 		:normal_size(_normal_size), peak_size(_peak_size),
+		 category(_category),
 		 normal_buffer(nullptr), peak_buffer(nullptr) {}
 
 	PeakBuffer(PeakBuffer &&other)
 		:normal_size(other.normal_size), peak_size(other.peak_size),
+		 category(other.category),
 		 normal_buffer(other.normal_buffer),
 		 peak_buffer(other.peak_buffer) {
 		other.normal_buffer = nullptr;
@@ -63,9 +73,40 @@ public:
 	gcc_pure
 	WritableBuffer<void> Read() const;
 
+	/**
+	 * Like Read(), but return both buffers, for vectored I/O.
+	 *
+	 * @param dest an array of at least two elements
+	 * @return the number of non-empty buffers stored in #dest
+	 */
+	unsigned ReadV(ConstBuffer<void> *dest) const;
+
+	/**
+	 * Mark data as consumed.  The length may span both buffers
+	 * (after ReadV()).
+	 */
 	void Consume(size_t length);
 
 	bool Append(const void *data, size_t length);
+
+	/**
+	 * Prepare writing in place, e.g. formatting a string
+	 * directly into the buffer.  Returns the free space at the
+	 * end of the buffer which currently receives data (which may
+	 * be empty if the buffer is full).  Call Append(size_t)
+	 * afterwards.
+	 */
+	WritableBuffer<void> Write();
+
+	/**
+	 * Commit data which was written to the buffer returned by
+	 * Write().
+	 */
+	void Append(size_t length);
+
+private:
+	DynamicFifoBuffer<uint8_t> *NewBuffer(size_t size) const;
+	void DeleteBuffer(DynamicFifoBuffer<uint8_t> *buffer) const;
 };
 
 #endif
@@ -67,6 +67,13 @@ public:
 		capacity = 0;
 	}
 
+	/**
+	 * Returns the number of elements currently allocated.
+	 */
+	size_t GetCapacity() const {
+		return capacity;
+	}
+
 	/**
 	 * Get the buffer, and guarantee a minimum size.  This buffer
 	 * becomes invalid with the next Get() call.
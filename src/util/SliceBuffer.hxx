@@ -99,6 +99,10 @@ public:
 		return n_max;
 	}
 
+	unsigned GetNumAllocated() const {
+		return n_allocated;
+	}
+
 	bool IsEmpty() const {
 		return n_allocated == 0;
 	}
@@ -107,6 +111,18 @@ public:
 		return n_allocated == n_max;
 	}
 
+	/**
+	 * Returns the index of the specified slice within this
+	 * buffer.  It must have been allocated by this object.
+	 */
+	gcc_pure
+	unsigned IndexOf(const T *value) const {
+		const Slice *slice = reinterpret_cast<const Slice *>(value);
+		assert(slice >= data && slice < data + n_max);
+
+		return slice - data;
+	}
+
 	template<typename... Args>
 	T *Allocate(Args&&... args) {
 		assert(n_initialized <= n_max);
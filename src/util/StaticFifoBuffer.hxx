@@ -59,7 +59,12 @@ public:
 	constexpr
 	StaticFifoBuffer():head(0), tail(0) {}
 
-protected:
+public:
+	/**
+	 * Move the data to the beginning of the buffer, to make all
+	 * free space available to Write().  This invalidates ranges
+	 * returned by Read().
+	 */
 	void Shift() {
 		if (head == 0)
 			return;
@@ -74,7 +79,6 @@ protected:
 		head = 0;
 	}
 
-public:
 	void Clear() {
 		head = tail = 0;
 	}
@@ -136,7 +136,7 @@ Tokenizer::NextUnquoted(Error &error)
 char *
 Tokenizer::NextString(Error &error)
 {
-	char *const word = input, *dest = input;
+	char *const word = input + 1, *dest;
 
 	if (*input == 0)
 		/* end of line */
@@ -151,7 +151,15 @@ Tokenizer::NextString(Error &error)
 
 	++input;
 
-	/* copy all characters */
+	/* fast path: as long as there is no backslash, the string
+	   can stay where it is */
+
+	while (*input != '"' && *input != '\\' && *input != 0)
+		++input;
+
+	dest = input;
+
+	/* copy all remaining characters */
 
 	while (*input != '"') {
 		if (*input == '\\')
@@ -19,6 +19,14 @@
 
 #include "bit_reverse.h"
 
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 /**
  * @see http://graphics.stanford.edu/~seander/bithacks.html#BitReverseTable
  */
@@ -29,3 +37,72 @@ const uint8_t bit_reverse_table[256] =
 #define R6(n) R4(n), R4(n + 2*4 ), R4(n + 1*4 ), R4(n + 3*4 )
     R6(0), R6(2), R6(1), R6(3)
 };
+
+#if defined(__ARM_NEON__) || defined(__SSSE3__)
+
+/**
+ * The bit-reversed values of all nibbles; used for reversing bytes
+ * with a table lookup instruction, one nibble at a time.
+ */
+static const uint8_t nibble_reverse_table[16] = {
+	0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe,
+	0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf,
+};
+
+#endif
+
+void
+bit_reverse_buffer(uint8_t *dest, const uint8_t *src, size_t size)
+{
+#if defined(__ARM_NEON__)
+	const uint8x8x2_t table = {
+		{ vld1_u8(nibble_reverse_table),
+		  vld1_u8(nibble_reverse_table + 8) }
+	};
+	const uint8x8_t low_mask = vdup_n_u8(0x0f);
+
+	for (; size >= 8; size -= 8, src += 8, dest += 8) {
+		const uint8x8_t x = vld1_u8(src);
+		const uint8x8_t lo = vtbl2_u8(table, vand_u8(x, low_mask));
+		const uint8x8_t hi = vtbl2_u8(table, vshr_n_u8(x, 4));
+		vst1_u8(dest, vorr_u8(vshl_n_u8(lo, 4), hi));
+	}
+#elif defined(__SSSE3__)
+	const __m128i table =
+		_mm_loadu_si128((const __m128i *)nibble_reverse_table);
+	const __m128i low_mask = _mm_set1_epi8(0x0f);
+
+	for (; size >= 16; size -= 16, src += 16, dest += 16) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)src);
+		const __m128i lo =
+			_mm_shuffle_epi8(table, _mm_and_si128(x, low_mask));
+		const __m128i hi =
+			_mm_shuffle_epi8(table,
+					 _mm_and_si128(_mm_srli_epi16(x, 4),
+						       low_mask));
+		_mm_storeu_si128((__m128i *)dest,
+				 _mm_or_si128(_mm_slli_epi16(lo, 4), hi));
+	}
+#elif defined(__SSE2__)
+	/* no byte shuffle in SSE2: swap adjacent bits, then bit
+	   pairs, then nibbles; the masks keep bits from crossing
+	   byte boundaries in the 16 bit shifts */
+	const __m128i m1 = _mm_set1_epi8(0x55);
+	const __m128i m2 = _mm_set1_epi8(0x33);
+	const __m128i m4 = _mm_set1_epi8(0x0f);
+
+	for (; size >= 16; size -= 16, src += 16, dest += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i *)src);
+		x = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(x, 1), m1),
+				 _mm_slli_epi16(_mm_and_si128(x, m1), 1));
+		x = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(x, 2), m2),
+				 _mm_slli_epi16(_mm_and_si128(x, m2), 2));
+		x = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(x, 4), m4),
+				 _mm_slli_epi16(_mm_and_si128(x, m4), 4));
+		_mm_storeu_si128((__m128i *)dest, x);
+	}
+#endif
+
+	for (; size > 0; --size)
+		*dest++ = bit_reverse(*src++);
+}
@@ -22,6 +22,7 @@
 
 #include "Compiler.h"
 
+#include <stddef.h>
 #include <stdint.h>
 
 extern const uint8_t bit_reverse_table[256];
@@ -33,4 +34,21 @@ bit_reverse(uint8_t x)
 	return bit_reverse_table[x];
 }
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Reverse the bits of each byte in the buffer, using SIMD
+ * instructions if available.
+ *
+ * @param dest the destination buffer; may be equal to #src
+ */
+void
+bit_reverse_buffer(uint8_t *dest, const uint8_t *src, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -24,7 +24,15 @@
 #include "config/ConfigGlobal.hxx"
 #include "config/ConfigOption.hxx"
 #include "Listen.hxx"
+#include "event/Loop.hxx"
+#include "event/Call.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
+#include "thread/Util.hxx"
+#include "thread/Scheduling.hxx"
+#include "system/FatalError.hxx"
 #include "util/Domain.hxx"
+#include "util/Error.hxx"
 #include "Log.hxx"
 #include "Compiler.h"
 
@@ -39,8 +47,26 @@ static constexpr Domain zeroconf_domain("zeroconf");
 
 static int zeroconfEnabled;
 
+/**
+ * The Avahi/Bonjour clients run in this event loop, in a thread of
+ * their own with idle priority, so mDNS traffic on busy networks
+ * does not delay the main thread.
+ */
+static EventLoop *zeroconf_loop;
+static Thread zeroconf_thread;
+
+static void
+zeroconf_thread_func(gcc_unused void *arg)
+{
+	SetThreadName("zeroconf");
+	SetThreadIdlePriority();
+	thread_scheduling_apply("zeroconf");
+
+	zeroconf_loop->Run();
+}
+
 void
-ZeroconfInit(gcc_unused EventLoop &loop)
+ZeroconfInit()
 {
 	const char *serviceName;
 
@@ -58,13 +84,22 @@ ZeroconfInit(gcc_unused EventLoop &loop)
 
 	serviceName = config_get_string(CONF_ZEROCONF_NAME, SERVICE_NAME);
 
+	zeroconf_loop = new EventLoop();
+
+	Error error;
+	if (!zeroconf_thread.Start(zeroconf_thread_func, nullptr, error))
+		FatalError(error);
+
+	EventLoop &loop = *zeroconf_loop;
+	BlockingCall(loop, [&loop, serviceName](){
 #ifdef HAVE_AVAHI
-	AvahiInit(loop, serviceName);
+			AvahiInit(loop, serviceName);
 #endif
 
 #ifdef HAVE_BONJOUR
-	BonjourInit(loop, serviceName);
+			BonjourInit(loop, serviceName);
 #endif
+		});
 }
 
 void
@@ -73,11 +108,19 @@ ZeroconfDeinit()
 	if (!zeroconfEnabled)
 		return;
 
+	BlockingCall(*zeroconf_loop, [](){
 #ifdef HAVE_AVAHI
-	AvahiDeinit();
+			AvahiDeinit();
 #endif /* HAVE_AVAHI */
 
 #ifdef HAVE_BONJOUR
-	BonjourDeinit();
+			BonjourDeinit();
 #endif
+		});
+
+	zeroconf_loop->Break();
+	zeroconf_thread.Join();
+
+	delete zeroconf_loop;
+	zeroconf_loop = nullptr;
 }
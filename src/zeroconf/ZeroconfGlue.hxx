@@ -22,12 +22,13 @@
 
 #include "check.h"
 
-class EventLoop;
-
 #ifdef HAVE_ZEROCONF
 
+/**
+ * Publish the service.  The clients run in a thread of their own.
+ */
 void
-ZeroconfInit(EventLoop &loop);
+ZeroconfInit();
 
 void
 ZeroconfDeinit();
@@ -35,7 +36,7 @@ ZeroconfDeinit();
 #else /* ! HAVE_ZEROCONF */
 
 static inline void
-ZeroconfInit(EventLoop &)
+ZeroconfInit()
 {}
 
 static inline void
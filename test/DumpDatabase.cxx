@@ -60,6 +60,11 @@ public:
 	virtual void OnDatabaseSongRemoved(const LightSong &song) override {
 		cout << "SongRemoved " << song.GetURI() << endl;
 	}
+
+	virtual void OnDatabaseSongMoved(const char *old_uri,
+					 const char *new_uri) override {
+		cout << "SongMoved " << old_uri << ' ' << new_uri << endl;
+	}
 };
 
 static bool
@@ -37,10 +37,12 @@ decoder_initialized(Decoder &decoder,
 	assert(!decoder.initialized);
 	assert(audio_format.IsValid());
 
-	fprintf(stderr, "audio_format=%s duration=%f\n",
-		audio_format_to_string(audio_format, &af_string),
-		duration);
+	if (decoder.verbose)
+		fprintf(stderr, "audio_format=%s duration=%f\n",
+			audio_format_to_string(audio_format, &af_string),
+			duration);
 
+	decoder.audio_format = audio_format;
 	decoder.initialized = true;
 }
 
@@ -85,11 +87,14 @@ decoder_open_uri(Decoder &decoder, const char *uri, Error &error)
 }
 
 size_t
-decoder_read(gcc_unused Decoder *decoder,
+decoder_read(Decoder *decoder,
 	     InputStream &is,
 	     void *buffer, size_t length)
 {
-	return is.LockRead(buffer, length, IgnoreError());
+	size_t nbytes = is.LockRead(buffer, length, IgnoreError());
+	if (decoder != nullptr)
+		decoder->input_bytes += nbytes;
+	return nbytes;
 }
 
 bool
@@ -110,6 +115,42 @@ decoder_read_full(Decoder *decoder, InputStream &is,
 	return true;
 }
 
+ConstBuffer<void>
+decoder_read_view(Decoder *decoder, InputStream &is, size_t length)
+{
+	const ScopeLock protect(is.mutex);
+
+	const auto view = is.Map();
+	if (view.IsNull())
+		return nullptr;
+
+	const offset_type offset = is.GetOffset();
+	if (offset >= view.size)
+		return { view.data, 0 };
+
+	const size_t nbytes = std::min<offset_type>(length,
+						    view.size - offset);
+	is.AddOffset(nbytes);
+
+	if (decoder != nullptr)
+		decoder->input_bytes += nbytes;
+
+	return { (const uint8_t *)view.data + offset, nbytes };
+}
+
+const void *
+decoder_read_full_view(Decoder *decoder, InputStream &is,
+		       void *buffer, size_t size)
+{
+	const auto view = decoder_read_view(decoder, is, size);
+	if (view.IsNull())
+		return decoder_read_full(decoder, is, buffer, size)
+			? buffer
+			: nullptr;
+
+	return view.size == size ? view.data : nullptr;
+}
+
 bool
 decoder_skip(Decoder *decoder, InputStream &is, size_t size)
 {
@@ -133,15 +174,37 @@ decoder_timestamp(gcc_unused Decoder &decoder,
 }
 
 DecoderCommand
-decoder_data(gcc_unused Decoder &decoder,
+decoder_data(Decoder &decoder,
 	     gcc_unused InputStream *is,
 	     const void *data, size_t datalen,
 	     gcc_unused uint16_t kbit_rate)
 {
-	gcc_unused ssize_t nbytes = write(1, data, datalen);
+	if (decoder.output_fd >= 0) {
+		gcc_unused ssize_t nbytes =
+			write(decoder.output_fd, data, datalen);
+	}
+
+	decoder.output_bytes += datalen;
 	return DecoderCommand::NONE;
 }
 
+WritableBuffer<void>
+decoder_data_begin(Decoder &decoder, gcc_unused InputStream *is,
+		   gcc_unused uint16_t kbit_rate)
+{
+	assert(decoder.initialized);
+
+	const size_t frame_size = decoder.audio_format.GetFrameSize();
+	const size_t size = sizeof(decoder.buffer) / frame_size * frame_size;
+	return { decoder.buffer, size };
+}
+
+DecoderCommand
+decoder_data_commit(Decoder &decoder, size_t length)
+{
+	return decoder_data(decoder, nullptr, decoder.buffer, length, 0);
+}
+
 DecoderCommand
 decoder_tag(gcc_unused Decoder &decoder,
 	    gcc_unused InputStream *is,
@@ -151,9 +214,12 @@ decoder_tag(gcc_unused Decoder &decoder,
 }
 
 void
-decoder_replay_gain(gcc_unused Decoder &decoder,
+decoder_replay_gain(Decoder &decoder,
 		    const ReplayGainInfo *rgi)
 {
+	if (!decoder.verbose || rgi == nullptr)
+		return;
+
 	const ReplayGainTuple *tuple = &rgi->tuples[REPLAY_GAIN_ALBUM];
 	if (tuple->IsDefined())
 		fprintf(stderr, "replay_gain[album]: gain=%f peak=%f\n",
@@ -166,8 +232,12 @@ decoder_replay_gain(gcc_unused Decoder &decoder,
 }
 
 void
-decoder_mixramp(gcc_unused Decoder &decoder, gcc_unused MixRampInfo &&mix_ramp)
+decoder_mixramp(Decoder &decoder, MixRampInfo &&mix_ramp)
 {
+	if (!decoder.verbose)
+		return;
+
 	fprintf(stderr, "MixRamp: start='%s' end='%s'\n",
-		mix_ramp.GetStart(), mix_ramp.GetEnd());
+		mix_ramp.GetStart().Format().c_str(),
+		mix_ramp.GetEnd().Format().c_str());
 }
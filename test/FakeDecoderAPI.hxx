@@ -21,17 +21,52 @@
 #define FAKE_DECODER_API_HXX
 
 #include "check.h"
+#include "AudioFormat.hxx"
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
 
+#include <stdint.h>
+
 struct Decoder {
 	Mutex mutex;
 	Cond cond;
 
 	bool initialized;
 
+	/**
+	 * Print the audio format, replay gain and MixRamp values to
+	 * stderr?
+	 */
+	bool verbose;
+
+	/**
+	 * Decoded PCM data is written to this file descriptor; -1
+	 * discards it.
+	 */
+	int output_fd;
+
+	AudioFormat audio_format;
+
+	/**
+	 * The number of bytes the plugin has consumed from an
+	 * #InputStream through the decoder API.
+	 */
+	uint64_t input_bytes;
+
+	/**
+	 * The number of PCM bytes submitted by the plugin.
+	 */
+	uint64_t output_bytes;
+
+	/**
+	 * The buffer returned by decoder_data_begin().
+	 */
+	uint8_t buffer[16384];
+
 	Decoder()
-		:initialized(false) {}
+		:initialized(false), verbose(true), output_fd(1),
+		 audio_format(AudioFormat::Undefined()),
+		 input_bytes(0), output_bytes(0) {}
 };
 
 #endif
@@ -4,6 +4,7 @@
 
 #include "config.h"
 #include "util/CircularBuffer.hxx"
+#include "util/HugeAllocator.hxx"
 
 #include <cppunit/TestFixture.h>
 #include <cppunit/extensions/TestFactoryRegistry.h>
@@ -12,10 +13,12 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 class TestCircularBuffer : public CppUnit::TestFixture {
 	CPPUNIT_TEST_SUITE(TestCircularBuffer);
 	CPPUNIT_TEST(TestIt);
+	CPPUNIT_TEST(TestMirrored);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -160,4 +163,50 @@ public:
 		CPPUNIT_ASSERT_EQUAL(&data[3], buffer.Write().data);
 		CPPUNIT_ASSERT_EQUAL(size_t(5), buffer.Write().size);
 	}
+
+	void TestMirrored() {
+		static constexpr size_t N = 65536;
+		uint8_t *data = (uint8_t *)HugeAllocateMirrored(N);
+		if (data == nullptr)
+			/* not supported on this system */
+			return;
+
+		/* both mappings refer to the same memory */
+		data[N + 1] = 0x42;
+		CPPUNIT_ASSERT_EQUAL(uint8_t(0x42), data[1]);
+
+		CircularBuffer<uint8_t> buffer(data, N, true);
+		CPPUNIT_ASSERT_EQUAL(true, buffer.IsMirrored());
+
+		/* move head and tail close to the end */
+		buffer.Append(N - 16);
+		buffer.Consume(N - 16);
+		CPPUNIT_ASSERT_EQUAL(true, buffer.IsEmpty());
+
+		/* free space wraps around, but is returned as one
+		   range */
+		auto w = buffer.Write();
+		CPPUNIT_ASSERT_EQUAL(&data[N - 16], w.data);
+		CPPUNIT_ASSERT_EQUAL(N - 1, w.size);
+
+		for (size_t i = 0; i < 100; ++i)
+			w.data[i] = uint8_t(i);
+		buffer.Append(100);
+		CPPUNIT_ASSERT_EQUAL(size_t(100), buffer.GetSize());
+		CPPUNIT_ASSERT_EQUAL(&data[84], buffer.Write().data);
+
+		/* so is the data */
+		auto r = buffer.Read();
+		CPPUNIT_ASSERT_EQUAL(&data[N - 16], r.data);
+		CPPUNIT_ASSERT_EQUAL(size_t(100), r.size);
+		CPPUNIT_ASSERT_EQUAL(uint8_t(20), data[4]);
+		for (size_t i = 0; i < 100; ++i)
+			CPPUNIT_ASSERT_EQUAL(uint8_t(i), r.data[i]);
+
+		buffer.Consume(100);
+		CPPUNIT_ASSERT_EQUAL(true, buffer.IsEmpty());
+		CPPUNIT_ASSERT_EQUAL(&data[84], buffer.Read().data);
+
+		HugeFreeMirrored(data, N);
+	}
 };
@@ -0,0 +1,449 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures the performance of the "simple" database
+ * plugin.  It either loads an existing database file, or synthesizes
+ * a library with the given number of songs (12 songs per album, 5
+ * albums per artist) and saves it to the file first.  Then it runs a
+ * fixed set of queries; each line of the output shows the duration
+ * of the first ("cold") run, the average of the following ("warm")
+ * runs, and the number of results.
+ *
+ * Settings of the "database" block (e.g. "format", "tag_index",
+ * "load_threads") can be passed with "--set NAME=VALUE".
+ *
+ */
+
+#include "config.h"
+#include "db/plugins/simple/SimpleDatabasePlugin.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "db/DatabasePlugin.hxx"
+#include "db/DatabaseListener.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/Selection.hxx"
+#include "db/LightSong.hxx"
+#include "db/Stats.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigData.hxx"
+#include "tag/TagBuilder.hxx"
+#include "tag/TagConfig.hxx"
+#include "SongFilter.hxx"
+#include "system/Clock.hxx"
+#include "event/Loop.hxx"
+#include "util/Error.hxx"
+#include "util/Macros.hxx"
+#include "Log.hxx"
+
+#ifdef HAVE_GLIB
+#include <glib.h>
+#endif
+
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * The number of "warm" runs of each query.
+ */
+static unsigned bench_iterations = 10;
+
+static constexpr unsigned SONGS_PER_ALBUM = 12;
+static constexpr unsigned ALBUMS_PER_ARTIST = 5;
+
+static const char *const genres[] = {
+	"Rock", "Pop", "Jazz", "Classical", "Electronic", "Folk",
+	"Hip-Hop", "Metal",
+};
+
+class NullDatabaseListener final : public DatabaseListener {
+public:
+	virtual void OnDatabaseModified() override {}
+	virtual void OnDatabaseSongRemoved(const LightSong &) override {}
+	virtual void OnDatabaseSongMoved(const char *,
+					 const char *) override {}
+};
+
+static void
+Report(const char *name, double cold_ms, double warm_ms, unsigned n)
+{
+	printf("%-24s %10.3f ms %10.3f ms %10u\n", name, cold_ms, warm_ms, n);
+}
+
+/**
+ * Run the function once ("cold") and then #bench_iterations times
+ * ("warm"), and print the durations.  The function returns the
+ * number of results, or -1 on error.
+ */
+template<typename F>
+static bool
+Measure(const char *name, F &&f)
+{
+	uint64_t start = MonotonicClockUS();
+	const int n = f();
+	const double cold_ms = (MonotonicClockUS() - start) / 1000.;
+	if (n < 0)
+		return false;
+
+	start = MonotonicClockUS();
+	for (unsigned i = 0; i < bench_iterations; ++i)
+		f();
+	const double warm_ms = bench_iterations > 0
+		? (MonotonicClockUS() - start) / 1000. / bench_iterations
+		: 0;
+
+	Report(name, cold_ms, warm_ms, n);
+	return true;
+}
+
+static void
+Synthesize(SimpleDatabase &db, unsigned n_songs)
+{
+	db.BeginUpdate();
+	db_lock();
+
+	Directory &root = db.GetRoot();
+	TagBuilder tag;
+	char artist[32], album[32], title[64], track[8], date[8], path[64];
+
+	for (unsigned i = 0; i < n_songs; ++i) {
+		const unsigned track_no = i % SONGS_PER_ALBUM + 1;
+		const unsigned album_no = i / SONGS_PER_ALBUM;
+		const unsigned artist_no = album_no / ALBUMS_PER_ARTIST;
+
+		snprintf(artist, sizeof(artist), "Artist %05u", artist_no);
+		snprintf(album, sizeof(album), "Album %06u", album_no);
+		snprintf(title, sizeof(title), "Title %u of %s",
+			 track_no, album);
+		snprintf(track, sizeof(track), "%u", track_no);
+		snprintf(date, sizeof(date), "%u", 1960 + album_no % 55);
+
+		Directory *artist_dir = root.MakeChild(artist);
+		Directory *album_dir = artist_dir->MakeChild(album);
+
+		tag.AddItem(TAG_ARTIST, artist);
+		tag.AddItem(TAG_ALBUM_ARTIST, artist);
+		tag.AddItem(TAG_ALBUM, album);
+		tag.AddItem(TAG_TITLE, title);
+		tag.AddItem(TAG_TRACK, track);
+		tag.AddItem(TAG_DATE, date);
+		tag.AddItem(TAG_GENRE,
+			    genres[artist_no % ARRAY_SIZE(genres)]);
+		tag.SetTime(120 + (i * 37) % 300);
+
+		snprintf(path, sizeof(path), "%02u %s.flac", track_no, title);
+		Song *song = Song::NewFile(path, *album_dir);
+		tag.Commit(song->tag);
+		song->mtime = 1400000000 + i;
+		album_dir->AddSong(song);
+	}
+
+	db_unlock();
+	db.EndUpdate(true);
+}
+
+static int
+CountSongs(const Database &db, const DatabaseSelection &selection)
+{
+	unsigned n = 0;
+	Error error;
+	if (!db.Visit(selection, [&n](const LightSong &, Error &){
+				++n;
+				return true;
+			}, error)) {
+		LogError(error);
+		return -1;
+	}
+
+	return n;
+}
+
+static bool
+RunQueries(const Database &db)
+{
+	printf("%-24s %13s %13s %10s\n", "query", "cold", "warm", "results");
+
+	/* collect some URIs for GetSong() */
+	std::vector<std::string> uris;
+	unsigned n_songs = 0;
+	Error error;
+	if (!db.Visit(DatabaseSelection("", true),
+		      [&](const LightSong &song, Error &){
+			      if (n_songs++ % 97 == 0 && uris.size() < 1000)
+				      uris.push_back(song.GetURI());
+			      return true;
+		      }, error)) {
+		LogError(error);
+		return false;
+	}
+
+	if (n_songs == 0) {
+		fprintf(stderr, "The database is empty\n");
+		return false;
+	}
+
+	const DatabaseSelection all("", true);
+
+	SongFilter find;
+	find.Parse("artist", "Artist 00007");
+	const DatabaseSelection find_selection("", true, &find);
+
+	SongFilter search;
+	search.Parse("title", "TITLE 3 OF ALBUM 0001", true);
+	const DatabaseSelection search_selection("", true, &search);
+
+	SongFilter base_filter;
+	base_filter.Parse("track", "5");
+	const DatabaseSelection base_selection("Artist 00003", true,
+					       &base_filter);
+
+	return Measure("visit", [&](){
+			return CountSongs(db, all);
+		}) &&
+		Measure("visit find", [&](){
+			return CountSongs(db, find_selection);
+		}) &&
+		Measure("visit search", [&](){
+			return CountSongs(db, search_selection);
+		}) &&
+		Measure("visit base+filter", [&](){
+			return CountSongs(db, base_selection);
+		}) &&
+		Measure("unique album by artist", [&](){
+			unsigned n = 0;
+			Error error2;
+			if (!db.VisitUniqueTags(all, TAG_ALBUM,
+						1u << TAG_ARTIST,
+						[&n](const Tag &, Error &){
+							++n;
+							return true;
+						}, error2)) {
+				LogError(error2);
+				return -1;
+			}
+
+			return int(n);
+		}) &&
+		Measure("stats", [&](){
+			DatabaseStats stats;
+			Error error2;
+			if (!db.GetStats(all, stats, error2)) {
+				LogError(error2);
+				return -1;
+			}
+
+			return int(stats.song_count);
+		}) &&
+		Measure("stats find", [&](){
+			DatabaseStats stats;
+			Error error2;
+			if (!db.GetStats(find_selection, stats, error2)) {
+				LogError(error2);
+				return -1;
+			}
+
+			return int(stats.song_count);
+		}) &&
+		Measure("get song", [&](){
+			unsigned n = 0;
+			for (const auto &uri : uris) {
+				Error error2;
+				const LightSong *song =
+					db.GetSong(uri.c_str(), error2);
+				if (song == nullptr) {
+					LogError(error2);
+					return -1;
+				}
+
+				db.ReturnSong(song);
+				++n;
+			}
+
+			return int(n);
+		});
+}
+
+static void
+Usage()
+{
+	fprintf(stderr,
+		"Usage: bench_db [--songs N] [--iterations N] [--save]\n"
+		"                [--set NAME=VALUE]... DB_FILE\n"
+		"\n"
+		"With --songs, a library is synthesized and DB_FILE is\n"
+		"overwritten.  Otherwise, DB_FILE is loaded, and it is only\n"
+		"rewritten with --save.\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned n_songs = 0;
+	bool save = false;
+	config_param param("database");
+
+	int i = 1;
+	for (; i < argc && argv[i][0] == '-'; ++i) {
+		if (strcmp(argv[i], "--songs") == 0 && i + 1 < argc) {
+			n_songs = strtoul(argv[++i], nullptr, 10);
+			save = true;
+		} else if (strcmp(argv[i], "--iterations") == 0 &&
+			   i + 1 < argc) {
+			bench_iterations = strtoul(argv[++i], nullptr, 10);
+		} else if (strcmp(argv[i], "--save") == 0) {
+			save = true;
+		} else if (strcmp(argv[i], "--set") == 0 && i + 1 < argc) {
+			std::string setting(argv[++i]);
+			const auto eq = setting.find('=');
+			if (eq == setting.npos) {
+				Usage();
+				return EXIT_FAILURE;
+			}
+
+			param.AddBlockParam(setting.substr(0, eq).c_str(),
+					    setting.c_str() + eq + 1);
+		} else {
+			Usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (i + 1 != argc) {
+		Usage();
+		return EXIT_FAILURE;
+	}
+
+	const char *const db_file = argv[i];
+	param.AddBlockParam("path", db_file);
+
+	/* initialize GLib */
+
+#ifdef HAVE_GLIB
+#if !GLIB_CHECK_VERSION(2,32,0)
+	g_thread_init(nullptr);
+#endif
+#endif
+
+	/* initialize MPD */
+
+	config_global_init();
+	TagLoadConfig();
+
+	EventLoop event_loop;
+	NullDatabaseListener listener;
+
+	Error error;
+	Database *db = simple_db_plugin.create(event_loop, listener,
+					       param, error);
+	if (db == nullptr) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+	SimpleDatabase &simple = *(SimpleDatabase *)db;
+
+	if (n_songs > 0) {
+		/* start with an empty database */
+		unlink(db_file);
+
+		if (!db->Open(error)) {
+			delete db;
+			LogError(error);
+			return EXIT_FAILURE;
+		}
+
+		const uint64_t start = MonotonicClockUS();
+		Synthesize(simple, n_songs);
+		Report("synthesize", (MonotonicClockUS() - start) / 1000.,
+		       0, n_songs);
+
+		/* write the file and load it again */
+		if (!Measure("save", [&](){
+					Error error2;
+					if (!simple.Save(error2)) {
+						LogError(error2);
+						return -1;
+					}
+
+					return 1;
+				})) {
+			db->Close();
+			delete db;
+			return EXIT_FAILURE;
+		}
+
+		db->Close();
+		save = false;
+	}
+
+	/* Open() loads the file; the warm runs close the database
+	   first, which is not measured */
+	uint64_t start = MonotonicClockUS();
+	if (!db->Open(error)) {
+		delete db;
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+	const double cold_ms = (MonotonicClockUS() - start) / 1000.;
+	uint64_t warm_us = 0;
+	for (unsigned j = 0; j < bench_iterations; ++j) {
+		db->Close();
+
+		start = MonotonicClockUS();
+		if (!db->Open(error)) {
+			delete db;
+			LogError(error);
+			return EXIT_FAILURE;
+		}
+
+		warm_us += MonotonicClockUS() - start;
+	}
+
+	Report("load", cold_ms,
+	       bench_iterations > 0 ? warm_us / 1000. / bench_iterations : 0,
+	       1);
+
+	bool success = RunQueries(*db);
+
+	if (success && save)
+		success = Measure("save", [&](){
+				Error error2;
+				if (!simple.Save(error2)) {
+					LogError(error2);
+					return -1;
+				}
+
+				return 1;
+			});
+
+	db->Close();
+	delete db;
+
+	/* deinitialize everything */
+
+	config_global_finish();
+
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,438 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures the performance of MPD's decoder plugins.
+ * It decodes each of the specified files (directories are searched
+ * recursively) with every enabled plugin which supports the file
+ * name suffix, and discards the PCM data.  The results are summed up
+ * per plugin and suffix:
+ *
+ * - the duration of the decoded audio
+ * - the "real-time factor", i.e. seconds of audio decoded per second
+ *   of wall-clock time (higher is faster)
+ * - the CPU time (user and system) consumed by the process
+ * - the number of bytes read from the input stream through the
+ *   decoder API (or the file size for plugins which read the file
+ *   themselves)
+ * - the number of heap allocations (only with glibc)
+ * - the largest peak RSS of a single file (only exact on Linux,
+ *   elsewhere it is the peak of the whole process)
+ *
+ */
+
+#include "config.h"
+#include "IOThread.hxx"
+#include "decoder/DecoderList.hxx"
+#include "decoder/DecoderPlugin.hxx"
+#include "FakeDecoderAPI.hxx"
+#include "input/Init.hxx"
+#include "input/InputStream.hxx"
+#include "fs/Path.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/DirectoryReader.hxx"
+#include "fs/FileSystem.hxx"
+#include "system/Clock.hxx"
+#include "util/UriUtil.hxx"
+#include "util/CharUtil.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#ifdef HAVE_GLIB
+#include <glib.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+static std::atomic<uint64_t> n_allocations;
+
+#ifdef __GLIBC__
+
+/* count heap allocations by interposing the allocator entry points
+   of the C library; operator new ends up here, too */
+
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *p, size_t size);
+
+void *
+malloc(size_t size) throw()
+{
+	++n_allocations;
+	return __libc_malloc(size);
+}
+
+void *
+calloc(size_t n, size_t size) throw()
+{
+	++n_allocations;
+	return __libc_calloc(n, size);
+}
+
+void *
+realloc(void *p, size_t size) throw()
+{
+	++n_allocations;
+	return __libc_realloc(p, size);
+}
+
+}
+
+#endif
+
+/**
+ * The measurements of one file decoded by one plugin.
+ */
+struct BenchSample {
+	double audio_s, wall_s, cpu_s;
+	uint64_t input_bytes, allocations;
+	long peak_rss_kb;
+};
+
+/**
+ * The sum of all samples of one plugin and suffix.
+ */
+struct BenchStats {
+	unsigned n_files, n_failures;
+	double audio_s, wall_s, cpu_s;
+	uint64_t input_bytes, allocations;
+	long peak_rss_kb;
+
+	BenchStats()
+		:n_files(0), n_failures(0),
+		 audio_s(0), wall_s(0), cpu_s(0),
+		 input_bytes(0), allocations(0),
+		 peak_rss_kb(0) {}
+
+	void Add(const BenchSample &s) {
+		++n_files;
+		audio_s += s.audio_s;
+		wall_s += s.wall_s;
+		cpu_s += s.cpu_s;
+		input_bytes += s.input_bytes;
+		allocations += s.allocations;
+		peak_rss_kb = std::max(peak_rss_kb, s.peak_rss_kb);
+	}
+
+	double GetRealtimeFactor() const {
+		return wall_s > 0 ? audio_s / wall_s : 0;
+	}
+};
+
+typedef std::map<std::pair<std::string, std::string>, BenchStats> BenchMap;
+
+static double
+GetCPUTime()
+{
+	struct rusage ru;
+	if (getrusage(RUSAGE_SELF, &ru) < 0)
+		return 0;
+
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+		(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000000.;
+}
+
+/**
+ * Reset the peak RSS of this process to the current RSS, so the next
+ * GetPeakRSS() call measures only what happened in between.  This is
+ * only implemented on Linux.
+ */
+static void
+ResetPeakRSS()
+{
+#ifdef __linux__
+	int fd = open("/proc/self/clear_refs", O_WRONLY|O_CLOEXEC);
+	if (fd >= 0) {
+		gcc_unused ssize_t nbytes = write(fd, "5", 1);
+		close(fd);
+	}
+#endif
+}
+
+/**
+ * @return the peak RSS [KiB]
+ */
+static long
+GetPeakRSS()
+{
+	struct rusage ru;
+	return getrusage(RUSAGE_SELF, &ru) == 0
+		? ru.ru_maxrss
+		: 0;
+}
+
+static bool
+BenchPlugin(const DecoderPlugin &plugin, Path path, BenchSample &sample)
+{
+	Decoder decoder;
+	decoder.verbose = false;
+	decoder.output_fd = -1;
+
+	ResetPeakRSS();
+	const uint64_t allocations = n_allocations;
+	const double cpu = GetCPUTime();
+	const uint64_t start = MonotonicClockUS();
+
+	if (plugin.file_decode != nullptr) {
+		plugin.FileDecode(decoder, path);
+
+		struct stat st;
+		if (StatFile(path, st))
+			decoder.input_bytes = st.st_size;
+	} else {
+		Error error;
+		InputStream *is =
+			InputStream::OpenReady(path.c_str(), decoder.mutex,
+					       decoder.cond, error);
+		if (is == nullptr) {
+			if (error.IsDefined())
+				LogError(error);
+			return false;
+		}
+
+		plugin.StreamDecode(decoder, *is);
+		delete is;
+	}
+
+	sample.wall_s = (MonotonicClockUS() - start) / 1000000.;
+	sample.cpu_s = GetCPUTime() - cpu;
+	sample.allocations = n_allocations - allocations;
+	sample.peak_rss_kb = GetPeakRSS();
+	sample.input_bytes = decoder.input_bytes;
+
+	if (!decoder.initialized || decoder.output_bytes == 0)
+		return false;
+
+	sample.audio_s = decoder.output_bytes /
+		(double)(decoder.audio_format.GetFrameSize() *
+			 decoder.audio_format.sample_rate);
+	return true;
+}
+
+static void
+BenchFile(Path path, const char *plugin_name, BenchMap &map)
+{
+	const char *suffix = uri_get_suffix(path.c_str());
+	if (suffix == nullptr)
+		return;
+
+	std::string suffix_key(suffix);
+	for (auto &ch : suffix_key)
+		ch = ToLowerASCII(ch);
+
+	const DecoderPluginMask mask =
+		decoder_plugins_candidates(suffix, nullptr);
+	for (unsigned i = 0; decoder_plugins[i] != nullptr; ++i) {
+		const DecoderPlugin &plugin = *decoder_plugins[i];
+		if ((mask & (DecoderPluginMask(1) << i)) == 0 ||
+		    (plugin_name != nullptr &&
+		     strcmp(plugin.name, plugin_name) != 0) ||
+		    !decoder_plugin_prepare(i))
+			continue;
+
+		BenchStats &stats = map[std::make_pair(std::string(plugin.name),
+						       suffix_key)];
+
+		BenchSample sample;
+		if (BenchPlugin(plugin, path, sample))
+			stats.Add(sample);
+		else
+			++stats.n_failures;
+	}
+}
+
+static void
+CollectFiles(Path path, std::vector<AllocatedPath> &files)
+{
+	if (!DirectoryExists(path)) {
+		files.emplace_back(path);
+		return;
+	}
+
+	DirectoryReader reader(path);
+	if (reader.HasFailed()) {
+		fprintf(stderr, "Failed to open directory %s\n", path.c_str());
+		return;
+	}
+
+	while (reader.ReadEntry()) {
+		const Path name = reader.GetEntry();
+		if (name.c_str()[0] == '.')
+			/* skip ".", ".." and hidden files */
+			continue;
+
+		CollectFiles(AllocatedPath::Build(path, name), files);
+	}
+}
+
+static void
+PrintText(const BenchMap &map)
+{
+	printf("%-12s %-6s %5s %5s %10s %10s %9s %12s %12s %10s\n",
+	       "plugin", "suffix", "files", "fail", "audio[s]", "realtime",
+	       "cpu[s]", "bytes", "allocations", "rss[KiB]");
+
+	for (const auto &i : map) {
+		const BenchStats &s = i.second;
+		printf("%-12s %-6s %5u %5u %10.2f %9.1fx %9.3f %12llu %12llu %10ld\n",
+		       i.first.first.c_str(), i.first.second.c_str(),
+		       s.n_files, s.n_failures, s.audio_s,
+		       s.GetRealtimeFactor(), s.cpu_s,
+		       (unsigned long long)s.input_bytes,
+		       (unsigned long long)s.allocations,
+		       s.peak_rss_kb);
+	}
+}
+
+static void
+PrintJSONString(const char *s)
+{
+	putchar('"');
+
+	for (; *s != 0; ++s) {
+		const unsigned char ch = *s;
+		if (ch == '"' || ch == '\\')
+			printf("\\%c", ch);
+		else if (ch < 0x20)
+			printf("\\u%04x", ch);
+		else
+			putchar(ch);
+	}
+
+	putchar('"');
+}
+
+static void
+PrintJSON(const BenchMap &map)
+{
+	printf("[");
+
+	bool first = true;
+	for (const auto &i : map) {
+		const BenchStats &s = i.second;
+
+		printf(first ? "\n" : ",\n");
+		first = false;
+
+		printf("  {\"plugin\": ");
+		PrintJSONString(i.first.first.c_str());
+		printf(", \"suffix\": ");
+		PrintJSONString(i.first.second.c_str());
+		printf(", \"files\": %u, \"failures\": %u"
+		       ", \"audio_seconds\": %.3f, \"wall_seconds\": %.6f"
+		       ", \"cpu_seconds\": %.6f, \"realtime_factor\": %.3f"
+		       ", \"bytes_read\": %llu, \"allocations\": %llu"
+		       ", \"peak_rss_kib\": %ld}",
+		       s.n_files, s.n_failures,
+		       s.audio_s, s.wall_s, s.cpu_s, s.GetRealtimeFactor(),
+		       (unsigned long long)s.input_bytes,
+		       (unsigned long long)s.allocations,
+		       s.peak_rss_kb);
+	}
+
+	printf("\n]\n");
+}
+
+int main(int argc, char **argv)
+{
+	bool json = false;
+	const char *plugin_name = nullptr;
+
+	int i = 1;
+	for (; i < argc && argv[i][0] == '-'; ++i) {
+		if (strcmp(argv[i], "--json") == 0)
+			json = true;
+		else if (strcmp(argv[i], "--plugin") == 0 && i + 1 < argc)
+			plugin_name = argv[++i];
+		else
+			break;
+	}
+
+	if (i >= argc) {
+		fprintf(stderr, "Usage: bench_decoder [--json] [--plugin NAME] PATH...\n");
+		return EXIT_FAILURE;
+	}
+
+#ifdef HAVE_GLIB
+#if !GLIB_CHECK_VERSION(2,32,0)
+	g_thread_init(NULL);
+#endif
+#endif
+
+	io_thread_init();
+	io_thread_start();
+
+	Error error;
+	if (!input_stream_global_init(error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+	decoder_plugin_init_all();
+
+	/* the "file" input plugin accepts only absolute paths */
+	char cwd[4096];
+	if (getcwd(cwd, sizeof(cwd)) == nullptr) {
+		perror("getcwd() failed");
+		return EXIT_FAILURE;
+	}
+
+	std::vector<AllocatedPath> files;
+	for (; i < argc; ++i) {
+		Path path = Path::FromFS(argv[i]);
+		if (path.IsAbsolute())
+			CollectFiles(path, files);
+		else
+			CollectFiles(AllocatedPath::Build(cwd, argv[i]),
+				     files);
+	}
+
+	std::sort(files.begin(), files.end(),
+		  [](const AllocatedPath &a, const AllocatedPath &b){
+			  return strcmp(a.c_str(), b.c_str()) < 0;
+		  });
+
+	BenchMap map;
+	for (const auto &path : files)
+		BenchFile(path, plugin_name, map);
+
+	if (json)
+		PrintJSON(map);
+	else
+		PrintText(map);
+
+	decoder_plugin_deinit_all();
+	input_stream_global_finish();
+	io_thread_deinit();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,447 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures the throughput of MPD's PCM library.  Each
+ * line of its output shows one kernel, the audio formats it was
+ * tested with, and the number of (source) samples it processes per
+ * second.
+ *
+ */
+
+#include "config.h"
+#include "AudioParser.hxx"
+#include "AudioFormat.hxx"
+#include "pcm/PcmConvert.hxx"
+#include "pcm/Volume.hxx"
+#include "pcm/PcmMix.hxx"
+#include "pcm/PcmChannels.hxx"
+#include "pcm/PcmDither.cxx" // including the .cxx file to get inlined templates
+#include "pcm/PcmPrng.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "system/Clock.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * The number of frames passed to the kernel in each call.
+ */
+static constexpr unsigned BENCH_FRAMES = 4096;
+
+/**
+ * The minimum duration of each benchmark [microseconds].
+ */
+static constexpr uint64_t BENCH_DURATION_US = 250000;
+
+static const char *samplerate_converter = "";
+
+const char *
+config_get_string(enum ConfigOption option, const char *default_value)
+{
+	return option == CONF_SAMPLERATE_CONVERTER
+		? samplerate_converter
+		: default_value;
+}
+
+/**
+ * Fill the buffer with random samples of the specified format.
+ */
+static void
+FillRandom(void *_p, size_t size, SampleFormat format)
+{
+	unsigned long state = 0;
+
+	switch (format) {
+	case SampleFormat::S24_P32:
+		for (int32_t *p = (int32_t *)_p, *end = p + size / 4;
+		     p != end; ++p) {
+			state = pcm_prng(state);
+			*p = int32_t(state << 8) >> 8;
+		}
+
+		break;
+
+	case SampleFormat::FLOAT:
+		for (float *p = (float *)_p, *end = p + size / 4;
+		     p != end; ++p) {
+			state = pcm_prng(state);
+			*p = int32_t(state) / 2147483648.;
+		}
+
+		break;
+
+	default:
+		for (uint8_t *p = (uint8_t *)_p, *end = p + size;
+		     p != end; ++p) {
+			state = pcm_prng(state);
+			*p = state >> 24;
+		}
+	}
+}
+
+/**
+ * Invoke the function repeatedly for at least #BENCH_DURATION_US.
+ *
+ * @return the number of invocations per second
+ */
+template<typename F>
+static double
+Measure(F &&f)
+{
+	/* warm up caches and lazily allocated buffers */
+	f();
+
+	unsigned n = 0;
+	const uint64_t start = MonotonicClockUS();
+	uint64_t elapsed;
+
+	do {
+		for (unsigned i = 0; i < 16; ++i)
+			f();
+		n += 16;
+
+		elapsed = MonotonicClockUS() - start;
+	} while (elapsed < BENCH_DURATION_US);
+
+	return n * 1000000. / elapsed;
+}
+
+static void
+Report(const char *kernel, const char *description,
+       double samples_per_second)
+{
+	printf("%-8s %-32s %9.2f Msamples/s\n",
+	       kernel, description, samples_per_second / 1000000.);
+}
+
+/**
+ * Measure the cost of switching between two source formats, like a
+ * playlist mixing two sample rates does.
+ */
+static bool
+BenchReopen(const char *a_string, const char *b_string,
+	    const char *dest_string)
+{
+	Error error;
+	AudioFormat a_format, b_format, dest_format;
+	if (!audio_format_parse(a_format, a_string, false, error) ||
+	    !audio_format_parse(b_format, b_string, false, error) ||
+	    !audio_format_parse(dest_format, dest_string, false, error)) {
+		LogError(error, "Failed to parse audio format");
+		return false;
+	}
+
+	PcmConvert convert;
+	bool success = true;
+	const double rate = Measure([&](){
+			for (const auto &src_format : {a_format, b_format}) {
+				if (!convert.Open(src_format, dest_format,
+						  error)) {
+					success = false;
+					continue;
+				}
+
+				convert.Close();
+			}
+		});
+
+	if (!success) {
+		LogError(error, "Failed to open PcmConvert");
+		return false;
+	}
+
+	char description[64];
+	snprintf(description, sizeof(description), "%s|%s -> %s",
+		 a_string, b_string, dest_string);
+	printf("%-8s %-32s %9.2f opens/s\n", "reopen", description, rate * 2);
+	return true;
+}
+
+static bool
+BenchConvert(const char *src_string, const char *dest_string)
+{
+	Error error;
+	AudioFormat src_format, dest_format;
+	if (!audio_format_parse(src_format, src_string, false, error) ||
+	    !audio_format_parse(dest_format, dest_string, false, error)) {
+		LogError(error, "Failed to parse audio format");
+		return false;
+	}
+
+	PcmConvert convert;
+	if (!convert.Open(src_format, dest_format, error)) {
+		LogError(error, "Failed to open PcmConvert");
+		return false;
+	}
+
+	const size_t size = BENCH_FRAMES * src_format.GetFrameSize();
+	void *src = malloc(size);
+	FillRandom(src, size, src_format.format);
+
+	bool success = true;
+	const double rate = Measure([&](){
+			if (convert.Convert({src, size}, error).IsNull())
+				success = false;
+		});
+
+	free(src);
+	convert.Close();
+
+	if (!success) {
+		LogError(error, "Failed to convert");
+		return false;
+	}
+
+	char description[64];
+	snprintf(description, sizeof(description), "%s -> %s",
+		 src_string, dest_string);
+	Report("convert", description,
+	       rate * BENCH_FRAMES * src_format.channels);
+	return true;
+}
+
+static bool
+BenchVolume(SampleFormat format, unsigned volume)
+{
+	Error error;
+	PcmVolume pv;
+	if (!pv.Open(format, error)) {
+		LogError(error, "Failed to open PcmVolume");
+		return false;
+	}
+
+	pv.SetVolume(volume);
+
+	const size_t n = BENCH_FRAMES * 2;
+	const size_t size = n * sample_format_size(format);
+	void *src = malloc(size);
+	FillRandom(src, size, format);
+
+	const double rate = Measure([&](){
+			pv.Apply({src, size});
+		});
+
+	free(src);
+	pv.Close();
+
+	char description[64];
+	snprintf(description, sizeof(description), "%s volume=%u%%",
+		 sample_format_to_string(format),
+		 volume * 100 / PCM_VOLUME_1);
+	Report("volume", description, rate * n);
+	return true;
+}
+
+static bool
+BenchMix(SampleFormat format, float portion1)
+{
+	const size_t n = BENCH_FRAMES * 2;
+	const size_t size = n * sample_format_size(format);
+	void *buffer1 = malloc(size), *buffer2 = malloc(size);
+	FillRandom(buffer1, size, format);
+	FillRandom(buffer2, size, format);
+
+	PcmDither dither;
+	bool success = true;
+	const double rate = Measure([&](){
+			if (!pcm_mix(dither, buffer1, buffer2, size,
+				     format, portion1))
+				success = false;
+		});
+
+	free(buffer1);
+	free(buffer2);
+
+	if (!success) {
+		fprintf(stderr, "Failed to mix\n");
+		return false;
+	}
+
+	char description[64];
+	snprintf(description, sizeof(description), "%s %s",
+		 sample_format_to_string(format),
+		 portion1 < 0 ? "MixRamp" : "cross-fade");
+	Report("mix", description, rate * n);
+	return true;
+}
+
+static bool
+BenchRoute(SampleFormat format, unsigned src_channels,
+	   unsigned dest_channels, const int8_t *sources)
+{
+	const size_t size = BENCH_FRAMES * src_channels
+		* sample_format_size(format);
+	void *src = malloc(size);
+	FillRandom(src, size, format);
+
+	PcmBuffer buffer;
+	const double rate = Measure([&](){
+			pcm_route_channels(buffer, format,
+					   dest_channels, src_channels,
+					   sources, {src, size});
+		});
+
+	free(src);
+
+	char description[64];
+	snprintf(description, sizeof(description), "%s:%u -> %s:%u",
+		 sample_format_to_string(format), src_channels,
+		 sample_format_to_string(format), dest_channels);
+	Report("route", description, rate * BENCH_FRAMES * src_channels);
+	return true;
+}
+
+static bool
+BenchDither(SampleFormat format, PcmDitherMode mode, const char *name)
+{
+	const size_t n = BENCH_FRAMES * 2;
+	int32_t *src = (int32_t *)malloc(n * sizeof(*src));
+	int16_t *dest = (int16_t *)malloc(n * sizeof(*dest));
+	FillRandom(src, n * sizeof(*src), format);
+
+	PcmDither dither(mode);
+	const double rate = Measure([&](){
+			if (format == SampleFormat::S24_P32)
+				dither.Dither24To16(dest, src, src + n);
+			else
+				dither.Dither32To16(dest, src, src + n);
+		});
+
+	free(src);
+	free(dest);
+
+	char description[64];
+	snprintf(description, sizeof(description), "%s -> 16 %s",
+		 sample_format_to_string(format), name);
+	Report("dither", description, rate * n);
+	return true;
+}
+
+static constexpr struct {
+	const char *src, *dest;
+} convert_cases[] = {
+	/* sample format */
+	{ "44100:16:2", "44100:24:2" },
+	{ "44100:16:2", "44100:32:2" },
+	{ "44100:16:2", "44100:f:2" },
+	{ "44100:24:2", "44100:16:2" },
+	{ "44100:24:2", "44100:32:2" },
+	{ "44100:24:2", "44100:f:2" },
+	{ "44100:32:2", "44100:16:2" },
+	{ "44100:32:2", "44100:24:2" },
+	{ "44100:f:2", "44100:16:2" },
+	{ "44100:f:2", "44100:24:2" },
+	{ "44100:f:2", "44100:32:2" },
+
+	/* channels */
+	{ "44100:16:1", "44100:16:2" },
+	{ "44100:16:2", "44100:16:1" },
+	{ "44100:16:6", "44100:16:2" },
+	{ "44100:24:6", "44100:24:2" },
+	{ "44100:f:6", "44100:f:2" },
+
+	/* sample format and channels */
+	{ "44100:16:2", "44100:f:1" },
+	{ "44100:16:1", "44100:f:2" },
+	{ "44100:24:2", "44100:32:6" },
+	{ "44100:24:6", "44100:16:2" },
+	{ "44100:f:6", "44100:16:2" },
+
+	/* sample rate */
+	{ "44100:16:2", "48000:16:2" },
+	{ "48000:16:2", "44100:16:2" },
+	{ "44100:24:2", "96000:24:2" },
+	{ "44100:f:2", "48000:f:2" },
+
+	/* DSD (DSD64 and DSD128) */
+	{ "352800:dsd:2", "352800:f:2" },
+	{ "705600:dsd:2", "705600:f:2" },
+	{ "352800:dsd:6", "352800:f:6" },
+};
+
+static constexpr SampleFormat sample_formats[] = {
+	SampleFormat::S16,
+	SampleFormat::S24_P32,
+	SampleFormat::S32,
+	SampleFormat::FLOAT,
+};
+
+int main(int argc, char **argv)
+{
+	if (argc > 2) {
+		fprintf(stderr,
+			"Usage: bench_pcm [SAMPLERATE_CONVERTER]\n");
+		return EXIT_FAILURE;
+	}
+
+	if (argc > 1)
+		samplerate_converter = argv[1];
+
+	Error error;
+	if (!pcm_convert_global_init(error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+	bool success = true;
+
+	for (const auto &i : convert_cases)
+		success = BenchConvert(i.src, i.dest) && success;
+
+	success = BenchReopen("44100:16:2", "48000:16:2", "96000:16:2") &&
+		success;
+
+	for (auto format : sample_formats) {
+		success = BenchVolume(format, PCM_VOLUME_1 / 2) && success;
+		success = BenchVolume(format, PCM_VOLUME_1 * 3 / 4) && success;
+	}
+
+	static constexpr int8_t stereo_to_51[] = { 0, 1, -1, -1, 0, 1 };
+	static constexpr int8_t front_of_51[] = { 0, 1 };
+	static constexpr int8_t swap_7[] = { 1, 0, 2, 3, 4, 5, 6 };
+	success = BenchRoute(SampleFormat::S16, 2, 6, stereo_to_51) &&
+		success;
+	success = BenchRoute(SampleFormat::S32, 6, 2, front_of_51) &&
+		success;
+	success = BenchRoute(SampleFormat::S16, 7, 7, swap_7) && success;
+
+	for (auto format : {SampleFormat::S24_P32, SampleFormat::S32}) {
+		success = BenchDither(format, PcmDitherMode::RECTANGULAR,
+				      "rectangular") && success;
+		success = BenchDither(format, PcmDitherMode::TPDF,
+				      "tpdf") && success;
+		success = BenchDither(format, PcmDitherMode::SHAPED,
+				      "shaped") && success;
+	}
+
+	for (auto format : sample_formats) {
+		success = BenchMix(format, 0.5) && success;
+		success = BenchMix(format, -1) && success;
+	}
+
+	pcm_convert_global_finish();
+
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
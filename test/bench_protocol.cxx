@@ -0,0 +1,720 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program generates load on a running MPD and measures the
+ * latency of its responses.  The address and the password are taken
+ * from the given MPD configuration file.
+ *
+ * Each "active" connection sends one command after another, chosen
+ * randomly from a weighted mix of "status", "playlistinfo",
+ * "search" and "addid" batches (each batch is followed by a
+ * "deleteid" batch on the same connection, so the queue size
+ * remains constant).  The "idle" connections only wait in "idle",
+ * and measure the time from the end of an "addid" batch to their
+ * wakeup.
+ *
+ * At the end, the throughput and the p50/p99/p99.9 latencies of each
+ * command are printed.
+ *
+ */
+
+#include "config.h"
+#include "event/Loop.hxx"
+#include "event/FullyBufferedSocket.hxx"
+#include "event/TimeoutMonitor.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigData.hxx"
+#include "config/ConfigOption.hxx"
+#include "fs/Path.hxx"
+#include "system/Resolver.hxx"
+#include "system/SocketError.hxx"
+#include "system/Clock.hxx"
+#include "system/fd_util.h"
+#include "util/Error.hxx"
+#include "util/Macros.hxx"
+#include "Log.hxx"
+
+#ifdef HAVE_GLIB
+#include <glib.h>
+#endif
+
+#include <algorithm>
+#include <list>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+enum class BenchCommand {
+	STATUS,
+	PLAYLISTINFO,
+	SEARCH,
+	ADDID,
+	DELETEID,
+	IDLE,
+	COUNT
+};
+
+static const char *const bench_command_names[] = {
+	"status",
+	"playlistinfo",
+	"search",
+	"addid",
+	"deleteid",
+	"idle wakeup",
+};
+
+static_assert(ARRAY_SIZE(bench_command_names) == unsigned(BenchCommand::COUNT),
+	      "wrong number of command names");
+
+/**
+ * The relative weight of each command in the mix; the "deleteid"
+ * and "idle" entries are not used.
+ */
+static unsigned bench_weights[unsigned(BenchCommand::COUNT)] = {
+	60, 15, 10, 15, 0, 0,
+};
+
+static unsigned bench_weight_sum;
+
+/**
+ * The number of "addid" commands per batch.
+ */
+static unsigned bench_batch_size = 10;
+
+static std::string bench_search = "the";
+
+static std::string bench_password;
+
+/**
+ * Song URIs for "addid", fetched with "listall" before the
+ * benchmark starts.
+ */
+static std::vector<std::string> bench_uris;
+
+/**
+ * The latencies of all responses [microseconds].
+ */
+static std::vector<uint32_t> bench_latencies[unsigned(BenchCommand::COUNT)];
+
+static unsigned bench_errors[unsigned(BenchCommand::COUNT)];
+
+static unsigned bench_n_connected, bench_n_failed;
+
+/**
+ * The MonotonicClockUS() value of the last "addid" batch response,
+ * used to measure the "idle" wakeup latency.
+ */
+static uint64_t bench_last_modification;
+
+static unsigned
+NextRandom(unsigned &state)
+{
+	state = state * 1103515245 + 12345;
+	return state >> 8;
+}
+
+class BenchConnection final : FullyBufferedSocket {
+	enum class State {
+		GREETING,
+		PASSWORD,
+		COMMAND,
+		IDLE,
+		CLOSED,
+	};
+
+	State state;
+
+	const bool idler;
+
+	BenchCommand command;
+
+	uint64_t start_us;
+
+	unsigned random_state;
+
+	bool failed;
+
+	/**
+	 * The song ids returned by the last "addid" batch, to be
+	 * deleted by the next command.
+	 */
+	std::vector<unsigned> ids;
+
+public:
+	BenchConnection(int _fd, EventLoop &_loop, unsigned index,
+			bool _idler)
+		:FullyBufferedSocket(_fd, _loop, MemoryCategory::CLIENT,
+				     4096, 65536),
+		 state(State::GREETING), idler(_idler),
+		 random_state(index), failed(false) {}
+
+	~BenchConnection() {
+		if (state != State::CLOSED)
+			Close();
+	}
+
+private:
+	void Close() {
+		state = State::CLOSED;
+		FullyBufferedSocket::Close();
+	}
+
+	bool SendString(const std::string &s) {
+		return Write(s.data(), s.length());
+	}
+
+	bool SendIdle() {
+		state = State::IDLE;
+		return SendString("idle playlist\n");
+	}
+
+	bool SendNext();
+
+	bool OnLine(const char *line);
+
+	virtual InputResult OnSocketInput(void *data, size_t length) override;
+	virtual void OnSocketError(Error &&error) override;
+	virtual void OnSocketClosed() override;
+};
+
+bool
+BenchConnection::SendNext()
+{
+	if (idler)
+		return SendIdle();
+
+	state = State::COMMAND;
+	failed = false;
+	start_us = MonotonicClockUS();
+
+	std::string request;
+	if (!ids.empty()) {
+		command = BenchCommand::DELETEID;
+		request = "command_list_begin\n";
+		for (auto id : ids)
+			request += "deleteid " + std::to_string(id) + "\n";
+		request += "command_list_end\n";
+		ids.clear();
+		return SendString(request);
+	}
+
+	unsigned r = NextRandom(random_state) % bench_weight_sum;
+	unsigned i = 0;
+	while (r >= bench_weights[i])
+		r -= bench_weights[i++];
+
+	command = BenchCommand(i);
+	switch (command) {
+	case BenchCommand::STATUS:
+		return SendString("status\n");
+
+	case BenchCommand::PLAYLISTINFO:
+		return SendString("playlistinfo\n");
+
+	case BenchCommand::SEARCH:
+		return SendString("search any \"" + bench_search + "\"\n");
+
+	case BenchCommand::ADDID:
+		request = "command_list_begin\n";
+		for (unsigned j = 0; j < bench_batch_size; ++j) {
+			const auto &uri = bench_uris[NextRandom(random_state) %
+						     bench_uris.size()];
+			request += "addid \"" + uri + "\"\n";
+		}
+		request += "command_list_end\n";
+		return SendString(request);
+
+	case BenchCommand::DELETEID:
+	case BenchCommand::IDLE:
+	case BenchCommand::COUNT:
+		break;
+	}
+
+	assert(false);
+	gcc_unreachable();
+}
+
+bool
+BenchConnection::OnLine(const char *line)
+{
+	switch (state) {
+	case State::GREETING:
+		if (memcmp(line, "OK MPD ", 7) != 0) {
+			fprintf(stderr, "Unexpected greeting: %s\n", line);
+			++bench_n_failed;
+			Close();
+			return false;
+		}
+
+		++bench_n_connected;
+
+		if (!bench_password.empty()) {
+			state = State::PASSWORD;
+			return SendString("password \"" + bench_password +
+					  "\"\n");
+		}
+
+		return SendNext();
+
+	case State::PASSWORD:
+		if (strcmp(line, "OK") != 0) {
+			fprintf(stderr, "Password rejected: %s\n", line);
+			Close();
+			return false;
+		}
+
+		return SendNext();
+
+	case State::COMMAND:
+		if (memcmp(line, "ACK ", 4) == 0) {
+			/* a command list stops at the first error */
+			failed = true;
+		} else if (strcmp(line, "OK") != 0) {
+			if (command == BenchCommand::ADDID &&
+			    memcmp(line, "Id: ", 4) == 0)
+				ids.push_back(strtoul(line + 4, nullptr, 10));
+			return true;
+		}
+
+		{
+			const uint64_t now = MonotonicClockUS();
+			if (failed)
+				++bench_errors[unsigned(command)];
+			else
+				bench_latencies[unsigned(command)]
+					.push_back(now - start_us);
+
+			if (command == BenchCommand::ADDID)
+				bench_last_modification = now;
+		}
+
+		return SendNext();
+
+	case State::IDLE:
+		if (strcmp(line, "OK") != 0)
+			return true;
+
+		if (bench_last_modification > 0)
+			bench_latencies[unsigned(BenchCommand::IDLE)]
+				.push_back(MonotonicClockUS() -
+					   bench_last_modification);
+
+		return SendIdle();
+
+	case State::CLOSED:
+		break;
+	}
+
+	return false;
+}
+
+BufferedSocket::InputResult
+BenchConnection::OnSocketInput(void *data, size_t length)
+{
+	char *p = (char *)data;
+	char *newline = (char *)memchr(p, '\n', length);
+	if (newline == nullptr)
+		return InputResult::MORE;
+
+	ConsumeInput(newline + 1 - p);
+	*newline = 0;
+
+	return OnLine(p)
+		? InputResult::AGAIN
+		: InputResult::CLOSED;
+}
+
+void
+BenchConnection::OnSocketError(Error &&error)
+{
+	if (state == State::GREETING)
+		++bench_n_failed;
+
+	LogError(error);
+	Close();
+}
+
+void
+BenchConnection::OnSocketClosed()
+{
+	if (state == State::GREETING)
+		++bench_n_failed;
+	else
+		fprintf(stderr, "Connection closed by MPD\n");
+
+	Close();
+}
+
+class BenchTimer final : public TimeoutMonitor {
+public:
+	explicit BenchTimer(EventLoop &_loop):TimeoutMonitor(_loop) {}
+
+protected:
+	virtual void OnTimeout() override {
+		GetEventLoop().Break();
+	}
+};
+
+/**
+ * The address of the MPD server.
+ */
+struct BenchAddress {
+	struct sockaddr_storage address;
+	socklen_t length;
+	int family;
+};
+
+static bool
+GetAddress(BenchAddress &a, Error &error)
+{
+	const char *host = config_get_string(CONF_BIND_TO_ADDRESS, "any");
+	if (host[0] == '/') {
+		struct sockaddr_un *sun = (struct sockaddr_un *)&a.address;
+		if (strlen(host) >= sizeof(sun->sun_path)) {
+			error.Format(resolver_domain,
+				     "Socket path is too long: %s", host);
+			return false;
+		}
+
+		sun->sun_family = AF_UNIX;
+		strcpy(sun->sun_path, host);
+		a.length = sizeof(*sun);
+		a.family = AF_UNIX;
+		return true;
+	}
+
+	if (strcmp(host, "any") == 0)
+		host = "localhost";
+
+	const unsigned port = config_get_positive(CONF_PORT, 6600);
+	struct addrinfo *ai = resolve_host_port(host, port, 0, SOCK_STREAM,
+						error);
+	if (ai == nullptr)
+		return false;
+
+	memcpy(&a.address, ai->ai_addr, ai->ai_addrlen);
+	a.length = ai->ai_addrlen;
+	a.family = ai->ai_family;
+	freeaddrinfo(ai);
+	return true;
+}
+
+static int
+Connect(const BenchAddress &a)
+{
+	int fd = socket_cloexec_nonblock(a.family, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+
+	if (connect(fd, (const struct sockaddr *)&a.address,
+		    a.length) < 0 &&
+	    errno != EINPROGRESS) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/**
+ * Read one line from a blocking socket.
+ */
+static bool
+ReadLine(int fd, std::string &buffer, std::string &line)
+{
+	while (true) {
+		const auto newline = buffer.find('\n');
+		if (newline != buffer.npos) {
+			line.assign(buffer, 0, newline);
+			buffer.erase(0, newline + 1);
+			return true;
+		}
+
+		char data[16384];
+		ssize_t nbytes = recv(fd, data, sizeof(data), 0);
+		if (nbytes <= 0)
+			return false;
+
+		buffer.append(data, nbytes);
+	}
+}
+
+static bool
+SendCommand(int fd, const std::string &command)
+{
+	return send(fd, command.data(), command.length(), 0) ==
+		(ssize_t)command.length();
+}
+
+/**
+ * Fetch song URIs for "addid" with a blocking connection.
+ */
+static bool
+FetchURIs(const BenchAddress &a)
+{
+	int fd = socket(a.family, SOCK_STREAM, 0);
+	if (fd < 0 ||
+	    connect(fd, (const struct sockaddr *)&a.address, a.length) < 0) {
+		perror("Failed to connect to MPD");
+		if (fd >= 0)
+			close(fd);
+		return false;
+	}
+
+	std::string buffer, line;
+	bool success = ReadLine(fd, buffer, line) &&
+		memcmp(line.c_str(), "OK MPD ", 7) == 0;
+
+	if (success && !bench_password.empty())
+		success = SendCommand(fd, "password \"" + bench_password +
+				      "\"\n") &&
+			ReadLine(fd, buffer, line) && line == "OK";
+
+	if (success)
+		success = SendCommand(fd, "listall\n");
+
+	while (success && ReadLine(fd, buffer, line)) {
+		if (line == "OK")
+			break;
+
+		if (line.compare(0, 4, "ACK ") == 0) {
+			fprintf(stderr, "listall failed: %s\n", line.c_str());
+			success = false;
+			break;
+		}
+
+		if (line.compare(0, 6, "file: ") == 0 &&
+		    bench_uris.size() < 10000)
+			bench_uris.push_back(line.substr(6));
+	}
+
+	close(fd);
+
+	if (!success)
+		fprintf(stderr, "Failed to fetch the song list\n");
+
+	return success;
+}
+
+static bool
+ParseMix(const char *s)
+{
+	std::fill_n(bench_weights, ARRAY_SIZE(bench_weights), 0);
+
+	while (*s != 0) {
+		const char *eq = strchr(s, '=');
+		if (eq == nullptr)
+			return false;
+
+		unsigned i = 0;
+		while (i < unsigned(BenchCommand::DELETEID) &&
+		       (strncmp(bench_command_names[i], s, eq - s) != 0 ||
+			bench_command_names[i][eq - s] != 0))
+			++i;
+
+		if (i == unsigned(BenchCommand::DELETEID))
+			return false;
+
+		char *endptr;
+		bench_weights[i] = strtoul(eq + 1, &endptr, 10);
+		if (*endptr == ',')
+			++endptr;
+		else if (*endptr != 0)
+			return false;
+
+		s = endptr;
+	}
+
+	return true;
+}
+
+static void
+PrintResults(double duration_s)
+{
+	printf("%-14s %9s %7s %10s %10s %10s %10s %10s\n",
+	       "command", "count", "errors", "per second",
+	       "p50 [ms]", "p99 [ms]", "p99.9 [ms]", "max [ms]");
+
+	unsigned total = 0;
+	for (unsigned i = 0; i < unsigned(BenchCommand::COUNT); ++i) {
+		auto &v = bench_latencies[i];
+		if (v.empty() && bench_errors[i] == 0)
+			continue;
+
+		std::sort(v.begin(), v.end());
+
+		const auto percentile = [&v](double p){
+			if (v.empty())
+				return 0.;
+
+			size_t n = std::min(v.size() - 1,
+					    size_t(p * v.size()));
+			return v[n] / 1000.;
+		};
+
+		printf("%-14s %9zu %7u %10.1f %10.3f %10.3f %10.3f %10.3f\n",
+		       bench_command_names[i], v.size(), bench_errors[i],
+		       v.size() / duration_s,
+		       percentile(0.5), percentile(0.99),
+		       percentile(0.999),
+		       v.empty() ? 0. : v.back() / 1000.);
+
+		if (i != unsigned(BenchCommand::IDLE))
+			total += v.size();
+	}
+
+	printf("\n%u connections, %u failed, %.1f commands per second\n",
+	       bench_n_connected, bench_n_failed, total / duration_s);
+}
+
+static void
+Usage()
+{
+	fprintf(stderr,
+		"Usage: bench_protocol [OPTIONS] CONFIG\n"
+		"\n"
+		"  --connections N   number of active connections (100)\n"
+		"  --idle N          number of connections waiting in \"idle\" (0)\n"
+		"  --duration S      duration of the benchmark (10)\n"
+		"  --mix LIST        command weights, e.g.\n"
+		"                    status=60,playlistinfo=15,search=10,addid=15\n"
+		"  --batch N         number of \"addid\" commands per batch (10)\n"
+		"  --search STRING   the \"search any\" string (\"the\")\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned n_connections = 100, n_idle = 0, duration_s = 10;
+
+	int i = 1;
+	for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+		const char *option = argv[i], *value = argv[i + 1];
+
+		if (strcmp(option, "--connections") == 0)
+			n_connections = strtoul(value, nullptr, 10);
+		else if (strcmp(option, "--idle") == 0)
+			n_idle = strtoul(value, nullptr, 10);
+		else if (strcmp(option, "--duration") == 0)
+			duration_s = strtoul(value, nullptr, 10);
+		else if (strcmp(option, "--batch") == 0)
+			bench_batch_size = strtoul(value, nullptr, 10);
+		else if (strcmp(option, "--search") == 0)
+			bench_search = value;
+		else if (strcmp(option, "--mix") != 0 || !ParseMix(value)) {
+			Usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (i + 1 != argc || duration_s == 0 || bench_batch_size == 0) {
+		Usage();
+		return EXIT_FAILURE;
+	}
+
+	/* initialize GLib */
+
+#ifdef HAVE_GLIB
+#if !GLIB_CHECK_VERSION(2,32,0)
+	g_thread_init(nullptr);
+#endif
+#endif
+
+	/* read the MPD configuration */
+
+	config_global_init();
+
+	Error error;
+	if (!ReadConfigFile(Path::FromFS(argv[i]), error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+	const struct config_param *password = config_get_param(CONF_PASSWORD);
+	if (password != nullptr)
+		/* the format is "PASSWORD@PERMISSIONS" */
+		bench_password = password->value.substr(0,
+							password->value.find('@'));
+
+	BenchAddress address;
+	if (!GetAddress(address, error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+	if (bench_weights[unsigned(BenchCommand::ADDID)] > 0) {
+		if (!FetchURIs(address))
+			return EXIT_FAILURE;
+
+		if (bench_uris.empty()) {
+			fprintf(stderr,
+				"The database is empty, disabling \"addid\"\n");
+			bench_weights[unsigned(BenchCommand::ADDID)] = 0;
+		}
+	}
+
+	for (auto w : bench_weights)
+		bench_weight_sum += w;
+
+	if (bench_weight_sum == 0) {
+		Usage();
+		return EXIT_FAILURE;
+	}
+
+	/* open all connections */
+
+	EventLoop loop;
+	std::list<BenchConnection> connections;
+
+	for (unsigned j = 0; j < n_connections + n_idle; ++j) {
+		int fd = Connect(address);
+		if (fd < 0) {
+			perror("Failed to connect to MPD");
+			++bench_n_failed;
+			continue;
+		}
+
+		connections.emplace_back(fd, loop, j, j >= n_connections);
+	}
+
+	/* run the benchmark */
+
+	BenchTimer timer(loop);
+	timer.ScheduleSeconds(duration_s);
+
+	const uint64_t start = MonotonicClockUS();
+	loop.Run();
+	const double elapsed_s = (MonotonicClockUS() - start) / 1000000.;
+
+	connections.clear();
+
+	PrintResults(elapsed_s);
+
+	config_global_finish();
+	return EXIT_SUCCESS;
+}
@@ -56,7 +56,9 @@ filter_plugin_by_name(gcc_unused const char *name)
 PlayerControl::PlayerControl(PlayerListener &_listener,
 			     MultipleOutputs &_outputs,
 			     gcc_unused unsigned _buffer_chunks,
-			     gcc_unused unsigned _buffered_before_play)
+			     gcc_unused size_t _buffer_chunk_size,
+			     gcc_unused unsigned _buffered_before_play,
+			     gcc_unused bool _buffer_adaptive)
 	:listener(_listener), outputs(_outputs) {}
 PlayerControl::~PlayerControl() {}
 
@@ -72,7 +74,7 @@ load_audio_output(EventLoop &event_loop, const char *name)
 
 	static struct PlayerControl dummy_player_control(*(PlayerListener *)nullptr,
 							 *(MultipleOutputs *)nullptr,
-							 32, 4);
+							 32, 4096, 4, false);
 
 	Error error;
 	AudioOutput *ao =
@@ -0,0 +1,812 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * A soak test for the playback pipeline.  It plays a number of
+ * synthetic songs through the real PlayerThread, DecoderThread and
+ * OutputThread, with a decoder plugin and an output plugin which are
+ * built into this program:
+ *
+ * - the "soak" decoder generates a pattern (the left channel counts
+ *   the frames of the song, the right channel is the song number) at
+ *   a configurable speed, optionally with random delays ("jitter")
+ *
+ * - the "soak" output consumes the data in real time like a sound
+ *   card with a small hardware buffer, optionally stalls once in a
+ *   while, and verifies the pattern
+ *
+ * At the end, it reports dropped and duplicated frames, silence
+ * inserted in the middle of a song, the gaps between songs (in
+ * samples), how often the device buffer ran dry ("late" chunks) and
+ * the depth of the #MusicPipe over time.  With "--strict", it fails
+ * if the audio was not played back exactly and gaplessly.
+ *
+ */
+
+#include "config.h"
+#include "PlayerControl.hxx"
+#include "PlayerThread.hxx"
+#include "PlayerListener.hxx"
+#include "PipelineStats.hxx"
+#include "DetachedSong.hxx"
+#include "Idle.hxx"
+#include "IOThread.hxx"
+#include "MusicChunk.hxx"
+#include "AudioFormat.hxx"
+#include "decoder/DecoderList.hxx"
+#include "decoder/DecoderPlugin.hxx"
+#include "decoder/DecoderAPI.hxx"
+#include "output/MultipleOutputs.hxx"
+#include "output/Internal.hxx"
+#include "output/OutputPlugin.hxx"
+#include "output/Registry.hxx"
+#include "mixer/Listener.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "pcm/PcmConvert.hxx"
+#include "event/Loop.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "fs/Path.hxx"
+#include "system/Clock.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#ifdef HAVE_GLIB
+#include <glib.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <string>
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static constexpr unsigned SOAK_SAMPLE_RATE = 44100;
+
+/**
+ * The number of frames the "soak" decoder submits at a time.
+ */
+static constexpr unsigned SOAK_BLOCK_FRAMES = 1024;
+
+/* command line options */
+
+static unsigned soak_songs = 8;
+static uint64_t soak_song_frames = 2 * SOAK_SAMPLE_RATE;
+static double soak_decode_speed = 0;
+static unsigned soak_jitter_ms = 0;
+static unsigned soak_buffer_ms = 100;
+static unsigned soak_stall_interval_ms = 0, soak_stall_ms = 0;
+static unsigned soak_seed = 1;
+
+/**
+ * Results collected by the "soak" output.  It is the only writer;
+ * the main thread reads the counters while the test runs.
+ */
+static struct {
+	/**
+	 * The number of frames which belong to a song.
+	 */
+	std::atomic<uint64_t> frames;
+
+	/**
+	 * Frames of a song which were skipped or played twice.
+	 */
+	std::atomic<uint64_t> dropped, duplicated;
+
+	/**
+	 * The number of times the pattern was broken.
+	 */
+	std::atomic<uint64_t> discontinuities;
+
+	/**
+	 * Frames of silence in the middle of a song.
+	 */
+	std::atomic<uint64_t> silence;
+
+	/**
+	 * The number of song transitions, the total number of silent
+	 * frames between two songs, and the largest gap.
+	 */
+	std::atomic<uint64_t> transitions, gap_frames, max_gap_frames;
+
+	/**
+	 * How often the device buffer ran dry before the next chunk
+	 * arrived, and by how much (the maximum).
+	 */
+	std::atomic<uint64_t> late, max_late_us;
+
+	/**
+	 * The number of stalls injected by the output.
+	 */
+	std::atomic<uint64_t> stalls;
+} soak_stats;
+
+static void
+soak_max(std::atomic<uint64_t> &a, uint64_t value)
+{
+	if (value > a.load(std::memory_order_relaxed))
+		a.store(value, std::memory_order_relaxed);
+}
+
+static void
+soak_add(std::atomic<uint64_t> &a, uint64_t value)
+{
+	a.fetch_add(value, std::memory_order_relaxed);
+}
+
+/*
+ * The "soak" decoder plugin.  The songs are called "/soak/N.soak"
+ * (N being the zero-based song number); they do not exist in the
+ * file system.
+ *
+ */
+
+static void
+soak_file_decode(Decoder &decoder, Path path_fs)
+{
+	const char *name = strrchr(path_fs.c_str(), '/');
+	const unsigned n = strtoul(name != nullptr ? name + 1 : path_fs.c_str(),
+				   nullptr, 10);
+
+	const AudioFormat audio_format(SOAK_SAMPLE_RATE, SampleFormat::S16, 2);
+	decoder_initialized(decoder, audio_format, false,
+			    double(soak_song_frames) / SOAK_SAMPLE_RATE);
+
+	std::minstd_rand random(soak_seed + n);
+	const int16_t song_id = int16_t(n + 1);
+	const uint64_t start_us = MonotonicClockUS();
+
+	int16_t buffer[SOAK_BLOCK_FRAMES * 2];
+	for (uint64_t position = 0; position < soak_song_frames;) {
+		const unsigned n_frames =
+			std::min<uint64_t>(SOAK_BLOCK_FRAMES,
+					   soak_song_frames - position);
+		for (unsigned i = 0; i < n_frames; ++i) {
+			buffer[i * 2] = int16_t((position + i) & 0x7fff);
+			buffer[i * 2 + 1] = song_id;
+		}
+
+		/* the jitter delays this block, but not the
+		   following ones */
+		uint64_t due_us = soak_decode_speed > 0
+			? start_us + uint64_t(position * 1000000. /
+					      (SOAK_SAMPLE_RATE *
+					       soak_decode_speed))
+			: MonotonicClockUS();
+		if (soak_jitter_ms > 0)
+			due_us += random() % (soak_jitter_ms * 1000);
+
+		const uint64_t now_us = MonotonicClockUS();
+		if (due_us > now_us)
+			usleep(due_us - now_us);
+
+		if (decoder_data(decoder, nullptr, buffer, n_frames * 4,
+				 1411) == DecoderCommand::STOP)
+			break;
+
+		position += n_frames;
+	}
+}
+
+static const char *const soak_suffixes[] = {
+	"soak",
+	nullptr
+};
+
+static const DecoderPlugin soak_decoder_plugin = {
+	"soak",
+	nullptr,
+	nullptr,
+	nullptr,
+	soak_file_decode,
+	nullptr,
+	nullptr,
+	nullptr,
+	soak_suffixes,
+	nullptr,
+};
+
+/*
+ * Replacement for DecoderList.cxx: this program knows only the
+ * "soak" decoder.
+ *
+ */
+
+const struct DecoderPlugin *const decoder_plugins[] = {
+	&soak_decoder_plugin,
+	nullptr
+};
+
+bool decoder_plugins_enabled[] = { true };
+
+const struct DecoderPlugin *
+decoder_plugin_from_name(const char *name)
+{
+	return strcmp(name, soak_decoder_plugin.name) == 0
+		? &soak_decoder_plugin
+		: nullptr;
+}
+
+bool
+decoder_plugin_prepare(gcc_unused unsigned i)
+{
+	return true;
+}
+
+DecoderPluginMask
+decoder_plugins_candidates(const char *suffix,
+			   gcc_unused const char *mime_type)
+{
+	return suffix != nullptr && strcmp(suffix, "soak") == 0
+		? 1
+		: 0;
+}
+
+const DecoderPlugin *
+decoder_plugin_recall(gcc_unused const char *key)
+{
+	return nullptr;
+}
+
+void
+decoder_plugin_remember(gcc_unused const char *key,
+			gcc_unused const DecoderPlugin &plugin)
+{
+}
+
+/*
+ * The "soak" output plugin.
+ *
+ */
+
+extern const struct AudioOutputPlugin soak_output_plugin;
+
+struct SoakOutput {
+	AudioOutput base;
+
+	/**
+	 * The simulated device clock: the time when the first frame
+	 * was played (0 if the device is idle), and the number of
+	 * frames written since then.
+	 */
+	uint64_t start_us, written;
+
+	/**
+	 * Inject the next stall after this many frames.
+	 */
+	uint64_t next_stall;
+
+	/**
+	 * The song number (right channel) which is being played, 0
+	 * before the first song.
+	 */
+	unsigned song;
+
+	/**
+	 * The frame number of the most recent frame of #song.
+	 */
+	uint64_t frame;
+
+	/**
+	 * The number of silent frames after the end of #song.
+	 */
+	uint64_t gap;
+
+	SoakOutput()
+		:base(soak_output_plugin), song(0), frame(0), gap(0) {}
+
+	bool Initialize(const config_param &param, Error &error) {
+		return base.Configure(param, error);
+	}
+
+	unsigned GetDelay() const;
+
+	void CheckClock(uint64_t now_us);
+	void CheckFrame(int16_t left, int16_t right);
+	void Stall();
+};
+
+static AudioOutput *
+soak_output_init(const config_param &param, Error &error)
+{
+	SoakOutput *so = new SoakOutput();
+
+	if (!so->Initialize(param, error)) {
+		delete so;
+		return nullptr;
+	}
+
+	return &so->base;
+}
+
+static void
+soak_output_finish(AudioOutput *ao)
+{
+	SoakOutput *so = (SoakOutput *)ao;
+
+	delete so;
+}
+
+static bool
+soak_output_test_default_device(void)
+{
+	return true;
+}
+
+static bool
+soak_output_open(AudioOutput *ao, AudioFormat &audio_format,
+		 gcc_unused Error &error)
+{
+	SoakOutput *so = (SoakOutput *)ao;
+
+	/* the pattern check needs exactly what the decoder
+	   generates */
+	audio_format = AudioFormat(SOAK_SAMPLE_RATE, SampleFormat::S16, 2);
+
+	so->start_us = 0;
+	so->written = 0;
+	so->next_stall = uint64_t(soak_stall_interval_ms) *
+		SOAK_SAMPLE_RATE / 1000;
+	return true;
+}
+
+static void
+soak_output_close(gcc_unused AudioOutput *ao)
+{
+}
+
+inline unsigned
+SoakOutput::GetDelay() const
+{
+	if (start_us == 0)
+		return 0;
+
+	const uint64_t consumed = (MonotonicClockUS() - start_us) *
+		SOAK_SAMPLE_RATE / 1000000;
+	if (written <= consumed)
+		return 0;
+
+	const unsigned queued_ms = (written - consumed) * 1000 /
+		SOAK_SAMPLE_RATE;
+	return queued_ms > soak_buffer_ms
+		? queued_ms - soak_buffer_ms
+		: 0;
+}
+
+static unsigned
+soak_output_delay(AudioOutput *ao)
+{
+	SoakOutput *so = (SoakOutput *)ao;
+
+	return so->GetDelay();
+}
+
+inline void
+SoakOutput::CheckClock(uint64_t now_us)
+{
+	if (start_us == 0) {
+		start_us = now_us;
+		return;
+	}
+
+	const uint64_t played_us = written * 1000000 / SOAK_SAMPLE_RATE;
+	if (now_us > start_us + played_us) {
+		/* the device buffer ran dry: count it and restart
+		   the clock */
+		const uint64_t late_us = now_us - start_us - played_us;
+		soak_add(soak_stats.late, 1);
+		soak_max(soak_stats.max_late_us, late_us);
+		start_us = now_us - played_us;
+	}
+}
+
+inline void
+SoakOutput::CheckFrame(int16_t left, int16_t right)
+{
+	if (left == 0 && right == 0) {
+		/* silence inserted by the player */
+		if (song == 0)
+			/* before the first song */
+			return;
+
+		if (frame + 1 >= soak_song_frames)
+			++gap;
+		else
+			soak_add(soak_stats.silence, 1);
+		return;
+	}
+
+	soak_add(soak_stats.frames, 1);
+
+	if (unsigned(right) == song &&
+	    left == int16_t((frame + 1) & 0x7fff)) {
+		++frame;
+		return;
+	}
+
+	if (unsigned(right) == song + 1 && left == 0) {
+		/* the next song begins */
+		if (song > 0) {
+			if (frame + 1 < soak_song_frames) {
+				soak_add(soak_stats.discontinuities, 1);
+				soak_add(soak_stats.dropped,
+					 soak_song_frames - frame - 1);
+			}
+
+			soak_add(soak_stats.transitions, 1);
+			soak_add(soak_stats.gap_frames, gap);
+			soak_max(soak_stats.max_gap_frames, gap);
+		}
+
+		song = right;
+		frame = 0;
+		gap = 0;
+		return;
+	}
+
+	soak_add(soak_stats.discontinuities, 1);
+
+	if (unsigned(right) == song) {
+		/* a jump inside the song; the left channel wraps
+		   around after 32768 frames */
+		const unsigned delta = (left - (frame + 1)) & 0x7fff;
+		if (delta < 0x4000) {
+			soak_add(soak_stats.dropped, delta);
+			frame += delta + 1;
+		} else {
+			soak_add(soak_stats.duplicated, 0x8000 - delta);
+			frame -= 0x7fff - delta;
+		}
+	} else {
+		/* a song was skipped or repeated */
+		song = right;
+		frame = left;
+		gap = 0;
+	}
+}
+
+inline void
+SoakOutput::Stall()
+{
+	soak_add(soak_stats.stalls, 1);
+	usleep(soak_stall_ms * 1000);
+	next_stall += uint64_t(soak_stall_interval_ms) *
+		SOAK_SAMPLE_RATE / 1000;
+}
+
+static size_t
+soak_output_play(AudioOutput *ao, const void *chunk, size_t size,
+		 gcc_unused Error &error)
+{
+	SoakOutput *so = (SoakOutput *)ao;
+
+	so->CheckClock(MonotonicClockUS());
+
+	const int16_t *p = (const int16_t *)chunk;
+	const size_t n_frames = size / 4;
+	for (size_t i = 0; i < n_frames; ++i, p += 2)
+		so->CheckFrame(p[0], p[1]);
+
+	so->written += n_frames;
+
+	if (soak_stall_interval_ms > 0 && so->written >= so->next_stall)
+		so->Stall();
+
+	return n_frames * 4;
+}
+
+static void
+soak_output_cancel(AudioOutput *ao)
+{
+	SoakOutput *so = (SoakOutput *)ao;
+
+	so->start_us = 0;
+	so->written = 0;
+}
+
+const struct AudioOutputPlugin soak_output_plugin = {
+	"soak",
+	soak_output_test_default_device,
+	soak_output_init,
+	soak_output_finish,
+	nullptr,
+	nullptr,
+	soak_output_open,
+	soak_output_close,
+	soak_output_delay,
+	nullptr,
+	nullptr,
+	soak_output_play,
+	nullptr,
+	soak_output_cancel,
+	nullptr,
+	nullptr,
+};
+
+/*
+ * Replacement for output/Registry.cxx.
+ *
+ */
+
+const AudioOutputPlugin *const audio_output_plugins[] = {
+	&soak_output_plugin,
+	nullptr
+};
+
+const AudioOutputPlugin *
+AudioOutputPlugin_get(const char *name)
+{
+	return strcmp(name, soak_output_plugin.name) == 0
+		? &soak_output_plugin
+		: nullptr;
+}
+
+/*
+ * There are no clients, and therefore nobody is interested in
+ * "idle" events.
+ *
+ */
+
+void
+idle_add(gcc_unused unsigned flags)
+{
+}
+
+/**
+ * Wakes up the main thread when the player wants the next song.
+ */
+class SoakListener final : public PlayerListener, public MixerListener {
+public:
+	Mutex mutex;
+	Cond cond;
+
+	virtual void OnPlayerSync() override {
+		mutex.lock();
+		cond.signal();
+		mutex.unlock();
+	}
+
+	virtual void OnPlayerTagModified() override {}
+
+	virtual void OnMixerVolumeChanged(gcc_unused Mixer &mixer,
+					  gcc_unused int volume) override {}
+};
+
+static std::string
+SoakSongURI(unsigned n)
+{
+	return "/soak/" + std::to_string(n) + ".soak";
+}
+
+static void
+PrintReport(double duration_s, unsigned pipe_max, double pipe_avg)
+{
+	printf("songs=%u transitions=%llu frames=%llu\n",
+	       soak_songs,
+	       (unsigned long long)soak_stats.transitions.load(),
+	       (unsigned long long)soak_stats.frames.load());
+	printf("dropped=%llu duplicated=%llu discontinuities=%llu silence=%llu\n",
+	       (unsigned long long)soak_stats.dropped.load(),
+	       (unsigned long long)soak_stats.duplicated.load(),
+	       (unsigned long long)soak_stats.discontinuities.load(),
+	       (unsigned long long)soak_stats.silence.load());
+	printf("gap_samples=%llu max_gap_samples=%llu\n",
+	       (unsigned long long)soak_stats.gap_frames.load(),
+	       (unsigned long long)soak_stats.max_gap_frames.load());
+	printf("late=%llu max_late_ms=%.1f stalls=%llu player_underruns=%llu\n",
+	       (unsigned long long)soak_stats.late.load(),
+	       soak_stats.max_late_us.load() / 1000.,
+	       (unsigned long long)soak_stats.stalls.load(),
+	       (unsigned long long)pipeline_stats.underruns.load());
+	printf("pipe_max=%u pipe_avg=%.1f duration=%.1fs\n",
+	       pipe_max, pipe_avg, duration_s);
+	fflush(stdout);
+}
+
+static bool
+ParseUnsigned(const char *s, unsigned &value_r)
+{
+	char *endptr;
+	unsigned long value = strtoul(s, &endptr, 10);
+	if (endptr == s || *endptr != 0)
+		return false;
+
+	value_r = value;
+	return true;
+}
+
+static bool
+ParseDouble(const char *s, double &value_r)
+{
+	char *endptr;
+	double value = strtod(s, &endptr);
+	if (endptr == s || *endptr != 0 || value < 0)
+		return false;
+
+	value_r = value;
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	double song_duration = 2;
+	unsigned buffer_chunks = 1024, buffered_before_play = 102;
+	unsigned interval_ms = 1000;
+	bool strict = false;
+
+	for (int i = 1; i < argc; ++i) {
+		const char *arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+		bool success = value != nullptr;
+
+		if (strcmp(arg, "--strict") == 0) {
+			strict = true;
+			continue;
+		} else if (value == nullptr)
+			success = false;
+		else if (strcmp(arg, "--songs") == 0)
+			success = ParseUnsigned(value, soak_songs) &&
+				soak_songs > 0;
+		else if (strcmp(arg, "--duration") == 0)
+			success = ParseDouble(value, song_duration) &&
+				song_duration > 0;
+		else if (strcmp(arg, "--speed") == 0)
+			success = ParseDouble(value, soak_decode_speed);
+		else if (strcmp(arg, "--jitter") == 0)
+			success = ParseUnsigned(value, soak_jitter_ms);
+		else if (strcmp(arg, "--device-buffer") == 0)
+			success = ParseUnsigned(value, soak_buffer_ms);
+		else if (strcmp(arg, "--stall-interval") == 0)
+			success = ParseUnsigned(value, soak_stall_interval_ms);
+		else if (strcmp(arg, "--stall") == 0)
+			success = ParseUnsigned(value, soak_stall_ms);
+		else if (strcmp(arg, "--buffer-chunks") == 0)
+			success = ParseUnsigned(value, buffer_chunks) &&
+				buffer_chunks > 0;
+		else if (strcmp(arg, "--before-play") == 0)
+			success = ParseUnsigned(value, buffered_before_play);
+		else if (strcmp(arg, "--interval") == 0)
+			success = ParseUnsigned(value, interval_ms);
+		else if (strcmp(arg, "--seed") == 0)
+			success = ParseUnsigned(value, soak_seed);
+		else
+			success = false;
+
+		if (!success) {
+			fprintf(stderr, "Usage: soak_player [--songs N] [--duration S]\n"
+				"\t[--speed X] [--jitter MS] [--device-buffer MS]\n"
+				"\t[--stall-interval MS] [--stall MS]\n"
+				"\t[--buffer-chunks N] [--before-play N]\n"
+				"\t[--interval MS] [--seed N] [--strict]\n");
+			return EXIT_FAILURE;
+		}
+
+		++i;
+	}
+
+	soak_song_frames = uint64_t(song_duration * SOAK_SAMPLE_RATE);
+	buffered_before_play = std::min(buffered_before_play, buffer_chunks);
+
+#ifdef HAVE_GLIB
+#if !GLIB_CHECK_VERSION(2,32,0)
+	g_thread_init(NULL);
+#endif
+#endif
+
+	config_global_init();
+
+	io_thread_init();
+	io_thread_start();
+
+	Error error;
+	if (!pcm_convert_global_init(error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+	EventLoop event_loop;
+	SoakListener listener;
+	MultipleOutputs outputs(listener);
+	PlayerControl pc(listener, outputs, buffer_chunks, CHUNK_SIZE,
+			 buffered_before_play, false);
+	outputs.Configure(event_loop, pc, "default");
+
+	StartPlayerThread(pc);
+
+	const uint64_t start_us = MonotonicClockUS();
+	uint64_t next_report_us = start_us + interval_ms * 1000;
+	unsigned pipe_max = 0;
+	uint64_t pipe_sum = 0, pipe_samples = 0;
+
+	pc.Play(new DetachedSong(SoakSongURI(0)));
+	unsigned next_song = 1;
+
+	while (true) {
+		listener.mutex.lock();
+		listener.cond.timed_wait(listener.mutex, 100);
+		listener.mutex.unlock();
+
+		pc.Lock();
+		const PlayerState state = pc.state;
+		const bool need_song = pc.next_song == nullptr;
+		pc.Unlock();
+
+		if (pc.GetErrorType() != PlayerError::NONE) {
+			LogError(pc.LockGetError());
+			break;
+		}
+
+		if (state == PlayerState::STOP)
+			break;
+
+		if (need_song && next_song < soak_songs)
+			pc.EnqueueSong(new DetachedSong(SoakSongURI(next_song++)));
+
+		const unsigned pipe =
+			pipeline_stats.pipe_chunks.load(std::memory_order_relaxed);
+		pipe_max = std::max(pipe_max, pipe);
+		pipe_sum += pipe;
+		++pipe_samples;
+
+		const uint64_t now_us = MonotonicClockUS();
+		if (interval_ms > 0 && now_us >= next_report_us) {
+			printf("%7.1fs pipe=%u frames=%llu late=%llu underruns=%llu\n",
+			       (now_us - start_us) / 1000000.,
+			       pipe,
+			       (unsigned long long)soak_stats.frames.load(),
+			       (unsigned long long)soak_stats.late.load(),
+			       (unsigned long long)pipeline_stats.underruns.load());
+			fflush(stdout);
+			next_report_us += interval_ms * 1000;
+		}
+	}
+
+	const bool failed = pc.GetErrorType() != PlayerError::NONE;
+
+	pc.Kill();
+
+	PrintReport((MonotonicClockUS() - start_us) / 1000000.,
+		    pipe_max,
+		    pipe_samples > 0 ? double(pipe_sum) / pipe_samples : 0.);
+
+	io_thread_deinit();
+	config_global_finish();
+
+	if (failed)
+		return EXIT_FAILURE;
+
+	if (strict &&
+	    (soak_stats.dropped.load() > 0 ||
+	     soak_stats.duplicated.load() > 0 ||
+	     soak_stats.discontinuities.load() > 0 ||
+	     soak_stats.silence.load() > 0 ||
+	     soak_stats.gap_frames.load() > 0 ||
+	     soak_stats.frames.load() != soak_songs * soak_song_frames)) {
+		fprintf(stderr, "soak test failed\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -8,3 +8,10 @@ mkdir -p test/tmp
 rm -f "$DST"
 bzip2 -c "$SRC" >"$DST"
 ./test/run_input "$DST/${SRC_BASE}" |diff "$SRC" -
+
+# concatenated streams, as written by pbzip2 and lbzip2
+rm -f "$DST"
+bzip2 -c "$SRC" >"$DST"
+bzip2 -c "$SRC" >>"$DST"
+cat "$SRC" "$SRC" >"${DST}.expected"
+./test/run_input "$DST/${SRC_BASE}" |diff "${DST}.expected" -
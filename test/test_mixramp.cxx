@@ -1,9 +1,9 @@
 /*
- * Unit tests for mixramp_interpolate()
+ * Unit tests for MixRampEnvelope::Interpolate()
  */
 
 #include "config.h"
-#include "CrossFade.cxx"
+#include "MixRampInfo.hxx"
 
 #include <cppunit/TestFixture.h>
 #include <cppunit/extensions/TestFactoryRegistry.h>
@@ -11,10 +11,20 @@
 #include <cppunit/extensions/HelperMacros.h>
 
 #include <string.h>
+#include <stdlib.h>
+
+static float
+mixramp_interpolate(const char *ramp_list, float required_db)
+{
+	MixRampEnvelope envelope;
+	envelope.Parse(ramp_list);
+	return envelope.Interpolate(required_db);
+}
 
 class MixRampTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST_SUITE(MixRampTest);
 	CPPUNIT_TEST(TestInterpolate);
+	CPPUNIT_TEST(TestFormat);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -73,6 +83,13 @@ public:
 					     0.05);
 		free(foo);
 	}
+
+	void TestFormat() {
+		MixRampEnvelope envelope;
+		envelope.Parse("1.0 0.00;3.0 0.10;6.0 2.50;garbage");
+		CPPUNIT_ASSERT_EQUAL(std::string("1.00 0.00;3.00 0.10;6.00 2.50;"),
+				     envelope.Format());
+	}
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(MixRampTest);
@@ -27,11 +27,13 @@ class PcmDitherTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST_SUITE(PcmDitherTest);
 	CPPUNIT_TEST(TestDither24);
 	CPPUNIT_TEST(TestDither32);
+	CPPUNIT_TEST(TestDitherMean);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
 	void TestDither24();
 	void TestDither32();
+	void TestDitherMean();
 };
 
 class PcmPackTest : public CppUnit::TestFixture {
@@ -49,11 +51,15 @@ class PcmChannelsTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST_SUITE(PcmChannelsTest);
 	CPPUNIT_TEST(TestChannels16);
 	CPPUNIT_TEST(TestChannels32);
+	CPPUNIT_TEST(TestChannelsFormat);
+	CPPUNIT_TEST(TestRoute);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
 	void TestChannels16();
 	void TestChannels32();
+	void TestChannelsFormat();
+	void TestRoute();
 };
 
 class PcmVolumeTest : public CppUnit::TestFixture {
@@ -79,6 +85,10 @@ class PcmFormatTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST(TestFormat16to24);
 	CPPUNIT_TEST(TestFormat16to32);
 	CPPUNIT_TEST(TestFormatFloat);
+	CPPUNIT_TEST(TestFormatShift);
+	CPPUNIT_TEST(TestFormatToFloat);
+	CPPUNIT_TEST(TestFormatFromFloat);
+	CPPUNIT_TEST(TestFormatFromFloatOverflow);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -86,6 +96,10 @@ public:
 	void TestFormat16to24();
 	void TestFormat16to32();
 	void TestFormatFloat();
+	void TestFormatShift();
+	void TestFormatToFloat();
+	void TestFormatFromFloat();
+	void TestFormatFromFloatOverflow();
 };
 
 class PcmMixTest : public CppUnit::TestFixture {
@@ -103,12 +117,24 @@ public:
 	void TestMix32();
 };
 
+class PcmDsdTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PcmDsdTest);
+	CPPUNIT_TEST(TestToFloat);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestToFloat();
+};
+
 class PcmExportTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST_SUITE(PcmExportTest);
 	CPPUNIT_TEST(TestShift8);
 	CPPUNIT_TEST(TestPack24);
 	CPPUNIT_TEST(TestReverseEndian);
 	CPPUNIT_TEST(TestDsdUsb);
+	CPPUNIT_TEST(TestDsdU32);
+	CPPUNIT_TEST(TestDsdU32Rest);
+	CPPUNIT_TEST(TestExportTo);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -116,6 +142,46 @@ public:
 	void TestPack24();
 	void TestReverseEndian();
 	void TestDsdUsb();
+	void TestDsdU32();
+	void TestDsdU32Rest();
+	void TestExportTo();
+};
+
+class PcmResamplerTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PcmResamplerTest);
+	CPPUNIT_TEST(TestPolyphase);
+	CPPUNIT_TEST(TestVariableRatio);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestPolyphase();
+	void TestVariableRatio();
+};
+
+class PcmLoudnessTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PcmLoudnessTest);
+	CPPUNIT_TEST(TestSine);
+	CPPUNIT_TEST(TestGate);
+	CPPUNIT_TEST(TestTruePeak);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestSine();
+	void TestGate();
+	void TestTruePeak();
+};
+
+class PcmLevelTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PcmLevelTest);
+	CPPUNIT_TEST(TestLevel16);
+	CPPUNIT_TEST(TestLevel32);
+	CPPUNIT_TEST(TestLevelFloat);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestLevel16();
+	void TestLevel32();
+	void TestLevelFloat();
 };
 
 #endif
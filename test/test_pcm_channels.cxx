@@ -21,7 +21,9 @@
 #include "test_pcm_all.hxx"
 #include "test_pcm_util.hxx"
 #include "pcm/PcmChannels.hxx"
+#include "pcm/PcmFormat.hxx"
 #include "pcm/PcmBuffer.hxx"
+#include "AudioFormat.hxx"
 #include "util/ConstBuffer.hxx"
 
 void
@@ -79,3 +81,87 @@ PcmChannelsTest::TestChannels32()
 		CPPUNIT_ASSERT_EQUAL(src[i], dest[i * 2 + 1]);
 	}
 }
+
+void
+PcmChannelsTest::TestChannelsFormat()
+{
+	constexpr size_t N = 509;
+	PcmBuffer buffer1, buffer2, buffer3;
+
+	/* 16 bit stereo to float mono must be the same as converting
+	   the sample format first */
+
+	const auto src16 = TestDataBuffer<int16_t, N * 2>();
+	auto f = pcm_convert_to_float(buffer1, SampleFormat::S16, src16);
+	f = pcm_convert_channels_float(buffer2, 1, 2, f);
+
+	CPPUNIT_ASSERT(pcm_convert_channels_supported(SampleFormat::FLOAT,
+						      SampleFormat::S16));
+	auto dest = pcm_convert_channels(buffer3, SampleFormat::FLOAT, 1,
+					 SampleFormat::S16, 2, src16);
+	auto dest_f = ConstBuffer<float>::FromVoid(dest);
+	CPPUNIT_ASSERT_EQUAL(N, dest_f.size);
+	for (unsigned i = 0; i < N; ++i)
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(f[i], dest_f[i], 1e-6);
+
+	/* 24 bit stereo to 32 bit 5.1 */
+
+	const auto src24 = TestDataBuffer<int32_t, N * 2>(RandomInt24());
+	auto i32 = pcm_convert_to_32(buffer1, SampleFormat::S24_P32, src24);
+	i32 = pcm_convert_channels_32(buffer2, 6, 2, i32);
+
+	CPPUNIT_ASSERT(pcm_convert_channels_supported(SampleFormat::S32,
+						      SampleFormat::S24_P32));
+	dest = pcm_convert_channels(buffer3, SampleFormat::S32, 6,
+				    SampleFormat::S24_P32, 2, src24);
+	auto dest_32 = ConstBuffer<int32_t>::FromVoid(dest);
+	CPPUNIT_ASSERT_EQUAL(N * 6, dest_32.size);
+	for (unsigned i = 0; i < N * 6; ++i)
+		CPPUNIT_ASSERT_EQUAL(i32[i], dest_32[i]);
+
+	/* reducing the resolution needs dithering, which is not
+	   implemented here */
+
+	CPPUNIT_ASSERT(!pcm_convert_channels_supported(SampleFormat::S16,
+						       SampleFormat::S24_P32));
+	CPPUNIT_ASSERT(!pcm_convert_channels_supported(SampleFormat::S16,
+						       SampleFormat::S32));
+}
+
+void
+PcmChannelsTest::TestRoute()
+{
+	constexpr size_t N = 509;
+	const auto src = TestDataBuffer<int16_t, N * 6>();
+
+	PcmBuffer buffer;
+
+	/* stereo to 5.1 with silent center/LFE (a specialized
+	   layout) */
+
+	static constexpr int8_t up[] = { 0, 1, -1, -1, 0, 1 };
+	auto dest = ConstBuffer<int16_t>::FromVoid(
+		pcm_route_channels(buffer, SampleFormat::S16, 6, 2, up,
+				   ConstBuffer<int16_t>(src, N * 2).ToVoid()));
+	CPPUNIT_ASSERT_EQUAL(N * 6, dest.size);
+	for (unsigned i = 0; i < N; ++i) {
+		for (unsigned c = 0; c < 6; ++c)
+			CPPUNIT_ASSERT_EQUAL(up[c] >= 0
+					     ? src[i * 2 + up[c]]
+					     : int16_t(0),
+					     dest[i * 6 + c]);
+	}
+
+	/* 5.1 to 3 channels with a swap (the generic code) */
+
+	static constexpr int8_t down[] = { 1, 0, 2 };
+	const auto src32 = TestDataBuffer<int32_t, N * 5>();
+	auto dest32 = ConstBuffer<int32_t>::FromVoid(
+		pcm_route_channels(buffer, SampleFormat::S32, 3, 5, down,
+				   ConstBuffer<int32_t>(src32, N * 5).ToVoid()));
+	CPPUNIT_ASSERT_EQUAL(N * 3, dest32.size);
+	for (unsigned i = 0; i < N; ++i)
+		for (unsigned c = 0; c < 3; ++c)
+			CPPUNIT_ASSERT_EQUAL(src32[i * 5 + down[c]],
+					     dest32[i * 3 + c]);
+}
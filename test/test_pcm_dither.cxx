@@ -21,19 +21,27 @@
 #include "test_pcm_util.hxx"
 #include "pcm/PcmDither.cxx"
 
+static constexpr PcmDitherMode dither_modes[] = {
+	PcmDitherMode::RECTANGULAR,
+	PcmDitherMode::TPDF,
+	PcmDitherMode::SHAPED,
+};
+
 void
 PcmDitherTest::TestDither24()
 {
 	constexpr unsigned N = 509;
 	const auto src = TestDataBuffer<int32_t, N>(RandomInt24());
 
-	int16_t dest[N];
-	PcmDither dither;
-	dither.Dither24To16(dest, src.begin(), src.end());
+	for (auto mode : dither_modes) {
+		int16_t dest[N];
+		PcmDither dither(mode);
+		dither.Dither24To16(dest, src.begin(), src.end());
 
-	for (unsigned i = 0; i < N; ++i) {
-		CPPUNIT_ASSERT(dest[i] >= (src[i] >> 8) - 8);
-		CPPUNIT_ASSERT(dest[i] < (src[i] >> 8) + 8);
+		for (unsigned i = 0; i < N; ++i) {
+			CPPUNIT_ASSERT(dest[i] >= (src[i] >> 8) - 8);
+			CPPUNIT_ASSERT(dest[i] < (src[i] >> 8) + 8);
+		}
 	}
 }
 
@@ -43,12 +51,38 @@ PcmDitherTest::TestDither32()
 	constexpr unsigned N = 509;
 	const auto src = TestDataBuffer<int32_t, N>();
 
-	int16_t dest[N];
-	PcmDither dither;
-	dither.Dither32To16(dest, src.begin(), src.end());
+	for (auto mode : dither_modes) {
+		int16_t dest[N];
+		PcmDither dither(mode);
+		dither.Dither32To16(dest, src.begin(), src.end());
+
+		for (unsigned i = 0; i < N; ++i) {
+			CPPUNIT_ASSERT(dest[i] >= (src[i] >> 16) - 8);
+			CPPUNIT_ASSERT(dest[i] < (src[i] >> 16) + 8);
+		}
+	}
+}
+
+void
+PcmDitherTest::TestDitherMean()
+{
+	/* a constant signal between two 16 bit values; dithering
+	   must preserve its average */
+	constexpr unsigned N = 4099;
+	int32_t src[N];
+	for (auto &i : src)
+		i = 0x1240;
+
+	for (auto mode : dither_modes) {
+		int16_t dest[N];
+		PcmDither dither(mode);
+		dither.Dither24To16(dest, src, src + N);
+
+		long sum = 0;
+		for (auto i : dest)
+			sum += i;
 
-	for (unsigned i = 0; i < N; ++i) {
-		CPPUNIT_ASSERT(dest[i] >= (src[i] >> 16) - 8);
-		CPPUNIT_ASSERT(dest[i] < (src[i] >> 16) + 8);
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(0x1240 / 256., double(sum) / N,
+					     0.02);
 	}
 }
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "test_pcm_all.hxx"
+#include "test_pcm_util.hxx"
+#include "pcm/PcmDsd.hxx"
+#include "pcm/dsd2pcm/dsd2pcm.h"
+#include "util/ConstBuffer.hxx"
+
+#include <algorithm>
+
+#include <math.h>
+
+void
+PcmDsdTest::TestToFloat()
+{
+	constexpr unsigned CHANNELS = 3;
+	constexpr unsigned N = 509;
+	const auto src = TestDataBuffer<uint8_t, N * CHANNELS>();
+
+	/* the reference implementation */
+	float expected[N * CHANNELS];
+	for (unsigned c = 0; c < CHANNELS; ++c) {
+		dsd2pcm_ctx *ctx = dsd2pcm_init();
+		dsd2pcm_translate(ctx, N, src.begin() + c, CHANNELS,
+				  false, expected + c, CHANNELS);
+		dsd2pcm_destroy(ctx);
+	}
+
+	/* convert in two portions, to verify that the filter state
+	   is preserved */
+	constexpr unsigned SPLIT = 200;
+
+	PcmDsd dsd;
+	float result[N * CHANNELS];
+	auto d = dsd.ToFloat(CHANNELS, {src.begin(), SPLIT * CHANNELS});
+	CPPUNIT_ASSERT_EQUAL(size_t(SPLIT * CHANNELS), d.size);
+	std::copy(d.begin(), d.end(), result);
+
+	d = dsd.ToFloat(CHANNELS, {src.begin() + SPLIT * CHANNELS,
+				   (N - SPLIT) * CHANNELS});
+	CPPUNIT_ASSERT_EQUAL(size_t((N - SPLIT) * CHANNELS), d.size);
+	std::copy(d.begin(), d.end(), result + SPLIT * CHANNELS);
+
+	/* the reference implementation initializes its history
+	   slightly differently; skip the first frames which depend
+	   on it */
+	for (unsigned i = 11 * CHANNELS; i < N * CHANNELS; ++i)
+		CPPUNIT_ASSERT(fabs(result[i] - expected[i]) < 1e-6);
+}
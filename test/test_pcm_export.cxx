@@ -20,8 +20,12 @@
 #include "config.h"
 #include "test_pcm_all.hxx"
 #include "pcm/PcmExport.hxx"
+#include "AudioFormat.hxx"
 #include "system/ByteOrder.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/Macros.hxx"
+
+#include <algorithm>
 
 #include <string.h>
 
@@ -32,7 +36,7 @@ PcmExportTest::TestShift8()
 	static constexpr uint32_t expected[] = { 0x0, 0x100, 0x10000, 0x1000000, 0xffffff00 };
 
 	PcmExport e;
-	e.Open(SampleFormat::S24_P32, 2, false, true, false, false);
+	e.Open(SampleFormat::S24_P32, 2, false, false, true, false, false);
 
 	auto dest = e.Export({src, sizeof(src)});
 	CPPUNIT_ASSERT_EQUAL(sizeof(expected), dest.size);
@@ -65,7 +69,7 @@ PcmExportTest::TestPack24()
 		? expected_be : expected_le;
 
 	PcmExport e;
-	e.Open(SampleFormat::S24_P32, 2, false, false, true, false);
+	e.Open(SampleFormat::S24_P32, 2, false, false, false, true, false);
 
 	auto dest = e.Export({src, sizeof(src)});
 	CPPUNIT_ASSERT_EQUAL(expected_size, dest.size);
@@ -88,21 +92,41 @@ PcmExportTest::TestReverseEndian()
 	};
 
 	PcmExport e;
-	e.Open(SampleFormat::S8, 2, false, false, false, true);
+	e.Open(SampleFormat::S8, 2, false, false, false, false, true);
 
 	auto dest = e.Export({src, sizeof(src)});
 	CPPUNIT_ASSERT_EQUAL(sizeof(src), dest.size);
 	CPPUNIT_ASSERT(memcmp(dest.data, src, dest.size) == 0);
 
-	e.Open(SampleFormat::S16, 2, false, false, false, true);
+	e.Open(SampleFormat::S16, 2, false, false, false, false, true);
 	dest = e.Export({src, sizeof(src)});
 	CPPUNIT_ASSERT_EQUAL(sizeof(expected2), dest.size);
 	CPPUNIT_ASSERT(memcmp(dest.data, expected2, dest.size) == 0);
 
-	e.Open(SampleFormat::S32, 2, false, false, false, true);
+	e.Open(SampleFormat::S32, 2, false, false, false, false, true);
 	dest = e.Export({src, sizeof(src)});
 	CPPUNIT_ASSERT_EQUAL(sizeof(expected4), dest.size);
 	CPPUNIT_ASSERT(memcmp(dest.data, expected4, dest.size) == 0);
+
+	/* a buffer large enough for the SIMD code */
+	uint32_t src_long[509];
+	for (unsigned i = 0; i < 509; ++i)
+		src_long[i] = i * 0x01020304;
+
+	e.Open(SampleFormat::S16, 2, false, false, false, false, true);
+	dest = e.Export({src_long, sizeof(src_long)});
+	CPPUNIT_ASSERT_EQUAL(sizeof(src_long), dest.size);
+	const uint16_t *src16 = (const uint16_t *)src_long;
+	const uint16_t *dest16 = (const uint16_t *)dest.data;
+	for (unsigned i = 0; i < 509 * 2; ++i)
+		CPPUNIT_ASSERT_EQUAL(ByteSwap16(src16[i]), dest16[i]);
+
+	e.Open(SampleFormat::S32, 1, false, false, false, false, true);
+	dest = e.Export({src_long, sizeof(src_long)});
+	CPPUNIT_ASSERT_EQUAL(sizeof(src_long), dest.size);
+	const uint32_t *dest32 = (const uint32_t *)dest.data;
+	for (unsigned i = 0; i < 509; ++i)
+		CPPUNIT_ASSERT_EQUAL(ByteSwap32(src_long[i]), dest32[i]);
 }
 
 void
@@ -121,9 +145,158 @@ PcmExportTest::TestDsdUsb()
 	};
 
 	PcmExport e;
-	e.Open(SampleFormat::DSD, 2, true, false, false, false);
+	e.Open(SampleFormat::DSD, 2, true, false, false, false, false);
+
+	auto dest = e.Export({src, sizeof(src)});
+	CPPUNIT_ASSERT_EQUAL(sizeof(expected), dest.size);
+	CPPUNIT_ASSERT(memcmp(dest.data, expected, dest.size) == 0);
+
+	/* the single-pass shift8 and reverse_endian variants */
+
+	e.Open(SampleFormat::DSD, 2, true, false, true, false, true);
+	dest = e.Export({src, sizeof(src)});
+	CPPUNIT_ASSERT_EQUAL(sizeof(expected), dest.size);
+	const uint32_t *dest32 = (const uint32_t *)dest.data;
+	for (unsigned i = 0; i < 4; ++i)
+		CPPUNIT_ASSERT_EQUAL(ByteSwap32(expected[i] << 8), dest32[i]);
+
+	/* packed 24 bit DSD-over-USB */
+
+	e.Open(SampleFormat::DSD, 2, true, false, false, true, false);
+	dest = e.Export({src, sizeof(src)});
+	CPPUNIT_ASSERT_EQUAL(sizeof(expected) / 4 * 3, dest.size);
+	const uint8_t *dest8 = (const uint8_t *)dest.data;
+	for (unsigned i = 0; i < 4; ++i) {
+		const uint32_t x = expected[i];
+		const uint8_t *p = dest8 + i * 3;
+		if (IsLittleEndian()) {
+			CPPUNIT_ASSERT_EQUAL(uint8_t(x), p[0]);
+			CPPUNIT_ASSERT_EQUAL(uint8_t(x >> 16), p[2]);
+		} else {
+			CPPUNIT_ASSERT_EQUAL(uint8_t(x >> 16), p[0]);
+			CPPUNIT_ASSERT_EQUAL(uint8_t(x), p[2]);
+		}
+
+		CPPUNIT_ASSERT_EQUAL(uint8_t(x >> 8), p[1]);
+	}
+}
+
+void
+PcmExportTest::TestDsdU32()
+{
+	static constexpr uint8_t src[] = {
+		0x01, 0x23, 0x45, 0x67,
+		0x89, 0xab, 0xcd, 0xef,
+		0x11, 0x22, 0x33, 0x44,
+		0x55, 0x66, 0x77, 0x88,
+	};
+
+	static constexpr uint32_t expected[] = {
+		0x014589cd,
+		0x2367abef,
+		0x11335577,
+		0x22446688,
+	};
+
+	PcmExport e;
+	e.Open(SampleFormat::DSD, 2, false, true, false, false, false);
+
+	AudioFormat af(44100 * 64 / 8, SampleFormat::DSD, 2);
+	CPPUNIT_ASSERT_EQUAL(size_t(8), e.GetFrameSize(af));
 
 	auto dest = e.Export({src, sizeof(src)});
 	CPPUNIT_ASSERT_EQUAL(sizeof(expected), dest.size);
 	CPPUNIT_ASSERT(memcmp(dest.data, expected, dest.size) == 0);
+
+	e.Open(SampleFormat::DSD, 2, false, true, false, false, true);
+	dest = e.Export({src, sizeof(src)});
+	CPPUNIT_ASSERT_EQUAL(sizeof(expected), dest.size);
+	const uint32_t *dest32 = (const uint32_t *)dest.data;
+	for (unsigned i = 0; i < 4; ++i)
+		CPPUNIT_ASSERT_EQUAL(ByteSwap32(expected[i]), dest32[i]);
+}
+
+void
+PcmExportTest::TestDsdU32Rest()
+{
+	/* 6 channels: a DSD_U32 frame is 24 bytes, and most of the
+	   chunk sizes below leave an incomplete one */
+	static constexpr unsigned channels = 6;
+	static constexpr size_t chunk_sizes[] = { 6, 12, 30, 18, 60, 42, 72 };
+
+	uint8_t src[240];
+	for (unsigned i = 0; i < sizeof(src); ++i)
+		src[i] = i * 7 + 3;
+
+	PcmExport e;
+	e.Open(SampleFormat::DSD, channels, false, true, false, false, false);
+	const auto expected = e.Export({src, sizeof(src)});
+	uint8_t expected_copy[sizeof(src)];
+	CPPUNIT_ASSERT_EQUAL(sizeof(expected_copy), expected.size);
+	memcpy(expected_copy, expected.data, expected.size);
+
+	/* Export() and ExportTo() must keep the remainder of each
+	   call and prepend it to the next one */
+	for (unsigned to = 0; to < 2; ++to) {
+		e.Open(SampleFormat::DSD, channels, false, true,
+		       false, false, false);
+
+		uint8_t dest[sizeof(src)];
+		size_t src_position = 0, dest_position = 0;
+		for (unsigned i = 0; src_position < sizeof(src); ++i) {
+			size_t size = chunk_sizes[i % ARRAY_SIZE(chunk_sizes)];
+			size = std::min(size, sizeof(src) - src_position);
+
+			const ConstBuffer<void> chunk(src + src_position, size);
+			if (to) {
+				dest_position += e.ExportTo(dest + dest_position,
+							    chunk);
+			} else {
+				const auto d = e.Export(chunk);
+				memcpy(dest + dest_position, d.data, d.size);
+				dest_position += d.size;
+			}
+
+			src_position += size;
+		}
+
+		CPPUNIT_ASSERT_EQUAL(sizeof(dest), dest_position);
+		CPPUNIT_ASSERT(memcmp(dest, expected_copy, sizeof(dest)) == 0);
+	}
+}
+
+void
+PcmExportTest::TestExportTo()
+{
+	uint32_t src[256];
+	for (unsigned i = 0; i < 256; ++i)
+		src[i] = (i * 0x01020304) & 0xffffff;
+
+	static constexpr struct {
+		SampleFormat format;
+		bool dsd_usb, dsd_u32, shift8, pack, reverse_endian;
+	} configs[] = {
+		{ SampleFormat::S16, false, false, false, false, false },
+		{ SampleFormat::S16, false, false, false, false, true },
+		{ SampleFormat::S24_P32, false, false, true, false, false },
+		{ SampleFormat::S24_P32, false, false, true, false, true },
+		{ SampleFormat::S24_P32, false, false, false, true, false },
+		{ SampleFormat::S24_P32, false, false, false, true, true },
+		{ SampleFormat::DSD, true, false, false, false, true },
+		{ SampleFormat::DSD, false, true, false, false, true },
+	};
+
+	for (const auto &c : configs) {
+		PcmExport e;
+		e.Open(c.format, 2, c.dsd_usb, c.dsd_u32,
+		       c.shift8, c.pack, c.reverse_endian);
+
+		/* ExportTo() must produce the same data as Export() */
+		uint8_t dest[sizeof(src) * 2];
+		const size_t size = e.ExportTo(dest, {src, sizeof(src)});
+
+		const auto expected = e.Export({src, sizeof(src)});
+		CPPUNIT_ASSERT_EQUAL(expected.size, size);
+		CPPUNIT_ASSERT(memcmp(dest, expected.data, size) == 0);
+	}
 }
@@ -24,7 +24,58 @@
 #include "pcm/PcmDither.hxx"
 #include "pcm/PcmUtils.hxx"
 #include "pcm/PcmBuffer.hxx"
+#include "pcm/ShiftConvert.hxx"
+#include "pcm/FloatConvert.hxx"
 #include "AudioFormat.hxx"
+#include "util/Macros.hxx"
+
+#include <limits>
+
+/**
+ * Verify the result of an (optimized) conversion, bit by bit,
+ * against the portable per-sample implementation.
+ */
+template<typename C>
+static void
+AssertConverted(ConstBuffer<typename C::SV> src, ConstBuffer<typename C::DV> d)
+{
+	CPPUNIT_ASSERT_EQUAL(src.size, d.size);
+
+	for (size_t i = 0; i < src.size; ++i)
+		CPPUNIT_ASSERT_EQUAL(C::Convert(src[i]), d[i]);
+}
+
+/**
+ * Generates floating point samples which exceed the nominal range,
+ * to check clipping.
+ */
+struct RandomLoudFloat : RandomFloat {
+	float operator()() {
+		return RandomFloat::operator()() * 2;
+	}
+};
+
+/**
+ * Generates floating point samples of both signs which are out of
+ * range even for a 32 bit integer after scaling.
+ */
+struct HugeFloat {
+	unsigned i;
+
+	HugeFloat():i(0) {}
+
+	float operator()() {
+		static constexpr float values[] = {
+			1.0, 1.5, 255.0, 256.0, 65536.0, 1e10, 3.4e38,
+			std::numeric_limits<float>::infinity(),
+		};
+
+		const float value = values[i % ARRAY_SIZE(values)];
+		const bool negative = (i / ARRAY_SIZE(values)) % 2 != 0;
+		++i;
+		return negative ? -value : value;
+	}
+};
 
 void
 PcmFormatTest::TestFormat8to16()
@@ -118,3 +169,108 @@ PcmFormatTest::TestFormatFloat()
 	for (size_t i = 4; i < N; ++i)
 		CPPUNIT_ASSERT_EQUAL(src[i], d[i]);
 }
+
+void
+PcmFormatTest::TestFormatShift()
+{
+	constexpr size_t N = 509;
+	const auto src8 = TestDataBuffer<int8_t, N>();
+	const auto src16 = TestDataBuffer<int16_t, N>();
+	const auto src24 = TestDataBuffer<int32_t, N>(RandomInt24());
+	const auto src32 = TestDataBuffer<int32_t, N>();
+
+	PcmBuffer buffer;
+	PcmDither dither;
+
+	AssertConverted<LeftShiftSampleConvert<SampleFormat::S8,
+					       SampleFormat::S16>>
+		(src8, pcm_convert_to_16(buffer, dither,
+					 SampleFormat::S8, src8));
+
+	AssertConverted<LeftShiftSampleConvert<SampleFormat::S16,
+					       SampleFormat::S24_P32>>
+		(src16, pcm_convert_to_24(buffer, SampleFormat::S16, src16));
+
+	AssertConverted<RightShiftSampleConvert<SampleFormat::S32,
+						SampleFormat::S24_P32>>
+		(src32, pcm_convert_to_24(buffer, SampleFormat::S32, src32));
+
+	AssertConverted<LeftShiftSampleConvert<SampleFormat::S16,
+					       SampleFormat::S32>>
+		(src16, pcm_convert_to_32(buffer, SampleFormat::S16, src16));
+
+	AssertConverted<LeftShiftSampleConvert<SampleFormat::S24_P32,
+					       SampleFormat::S32>>
+		(src24, pcm_convert_to_32(buffer, SampleFormat::S24_P32,
+					  src24));
+}
+
+void
+PcmFormatTest::TestFormatToFloat()
+{
+	constexpr size_t N = 509;
+	const auto src16 = TestDataBuffer<int16_t, N>();
+	const auto src24 = TestDataBuffer<int32_t, N>(RandomInt24());
+	const auto src32 = TestDataBuffer<int32_t, N>();
+
+	PcmBuffer buffer;
+
+	AssertConverted<IntegerToFloatSampleConvert<SampleFormat::S16>>
+		(src16, pcm_convert_to_float(buffer, SampleFormat::S16,
+					     src16));
+
+	AssertConverted<IntegerToFloatSampleConvert<SampleFormat::S24_P32>>
+		(src24, pcm_convert_to_float(buffer, SampleFormat::S24_P32,
+					     src24));
+
+	AssertConverted<IntegerToFloatSampleConvert<SampleFormat::S32>>
+		(src32, pcm_convert_to_float(buffer, SampleFormat::S32,
+					     src32));
+}
+
+void
+PcmFormatTest::TestFormatFromFloat()
+{
+	constexpr size_t N = 509;
+	auto src = TestDataBuffer<float, N>(RandomLoudFloat());
+
+	/* corner cases, in the first block */
+	float *writable = &src[0];
+	*writable++ = 1.0;
+	*writable++ = -1.0;
+	*writable++ = 0.99999994;
+	*writable++ = -0.99999994;
+
+	PcmBuffer buffer;
+	PcmDither dither;
+
+	AssertConverted<FloatToIntegerSampleConvert<SampleFormat::S16>>
+		(src, pcm_convert_to_16(buffer, dither,
+					SampleFormat::FLOAT, src));
+
+	AssertConverted<FloatToIntegerSampleConvert<SampleFormat::S24_P32>>
+		(src, pcm_convert_to_24(buffer, SampleFormat::FLOAT, src));
+
+	AssertConverted<FloatToIntegerSampleConvert<SampleFormat::S32>>
+		(src, pcm_convert_to_32(buffer, SampleFormat::FLOAT, src));
+}
+
+void
+PcmFormatTest::TestFormatFromFloatOverflow()
+{
+	constexpr size_t N = 64;
+	const auto src = TestDataBuffer<float, N>(HugeFloat());
+
+	PcmBuffer buffer;
+	PcmDither dither;
+
+	AssertConverted<FloatToIntegerSampleConvert<SampleFormat::S16>>
+		(src, pcm_convert_to_16(buffer, dither,
+					SampleFormat::FLOAT, src));
+
+	AssertConverted<FloatToIntegerSampleConvert<SampleFormat::S24_P32>>
+		(src, pcm_convert_to_24(buffer, SampleFormat::FLOAT, src));
+
+	AssertConverted<FloatToIntegerSampleConvert<SampleFormat::S32>>
+		(src, pcm_convert_to_32(buffer, SampleFormat::FLOAT, src));
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "test_pcm_all.hxx"
+#include "pcm/PcmLevel.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <stdint.h>
+#include <math.h>
+
+void
+PcmLevelTest::TestLevel16()
+{
+	/* an odd number of frames to cover the non-SIMD tail; a
+	   square wave on the left channel, a constant on the right
+	   one */
+	int16_t src[2 * 509];
+	for (unsigned i = 0; i < 509; ++i) {
+		src[i * 2] = i & 1 ? -16384 : 16384;
+		src[i * 2 + 1] = -8192;
+	}
+
+	src[100 * 2 + 1] = -32768;
+
+	PcmLevel level;
+	level.Clear(2);
+	level.Update(SampleFormat::S16, {src, sizeof(src)});
+
+	CPPUNIT_ASSERT_EQUAL(509u, level.n_frames);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.5, level.peak[0], 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0, level.peak[1], 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.5, level.GetRms(0), 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(sqrt((508 * 0.0625 + 1) / 509),
+				     level.GetRms(1), 1e-6);
+
+	/* a second update accumulates */
+	level.Update(SampleFormat::S16, {src, sizeof(src)});
+	CPPUNIT_ASSERT_EQUAL(2 * 509u, level.n_frames);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.5, level.GetRms(0), 1e-6);
+}
+
+void
+PcmLevelTest::TestLevel32()
+{
+	int32_t src[4 * 64];
+	for (unsigned i = 0; i < 64; ++i) {
+		src[i * 4] = 0x400000;
+		src[i * 4 + 1] = -0x200000;
+		src[i * 4 + 2] = 0;
+		src[i * 4 + 3] = i == 7 ? -0x800000 : 0;
+	}
+
+	PcmLevel level;
+	level.Clear(4);
+	level.Update(SampleFormat::S24_P32, {src, sizeof(src)});
+
+	CPPUNIT_ASSERT_EQUAL(64u, level.n_frames);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.5, level.peak[0], 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.25, level.peak[1], 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, level.peak[2], 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0, level.peak[3], 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.5, level.GetRms(0), 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.25, level.GetRms(1), 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.125, level.GetRms(3), 1e-6);
+
+	for (auto &i : src)
+		i <<= 8;
+
+	level.Clear(4);
+	level.Update(SampleFormat::S32, {src, sizeof(src)});
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.5, level.peak[0], 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0, level.peak[3], 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.25, level.GetRms(1), 1e-6);
+}
+
+void
+PcmLevelTest::TestLevelFloat()
+{
+	/* three channels don't fit into the SIMD lanes */
+	float src[3 * 100];
+	for (unsigned i = 0; i < 100; ++i) {
+		src[i * 3] = 0.5;
+		src[i * 3 + 1] = i & 1 ? -0.75 : 0.75;
+		src[i * 3 + 2] = i == 42 ? -1 : 0;
+	}
+
+	PcmLevel level;
+	level.Clear(3);
+	level.Update(SampleFormat::FLOAT, {src, sizeof(src)});
+
+	CPPUNIT_ASSERT_EQUAL(100u, level.n_frames);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.5, level.peak[0], 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.75, level.peak[1], 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0, level.peak[2], 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.5, level.GetRms(0), 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.75, level.GetRms(1), 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.1, level.GetRms(2), 1e-6);
+
+	/* stereo takes the SIMD path */
+	level.Clear(2);
+	level.Update(SampleFormat::FLOAT, {src, sizeof(src)});
+	CPPUNIT_ASSERT_EQUAL(150u, level.n_frames);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0, level.peak[0] > level.peak[1]
+				     ? level.peak[0] : level.peak[1], 1e-6);
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "test_pcm_all.hxx"
+#include "pcm/Loudness.hxx"
+
+#include <vector>
+
+#include <math.h>
+
+/**
+ * Generate a stereo sine wave with the given peak level in dBFS.
+ */
+static std::vector<float>
+GenerateSine(unsigned sample_rate, unsigned n_frames, double frequency,
+	     double level_db, double phase=0)
+{
+	const double amplitude = pow(10.0, level_db / 20.0);
+
+	std::vector<float> v(n_frames * 2);
+	for (unsigned i = 0; i < n_frames; ++i)
+		v[i * 2] = v[i * 2 + 1] =
+			amplitude * sin(2 * M_PI * frequency * i / sample_rate
+					+ phase);
+
+	return v;
+}
+
+void
+PcmLoudnessTest::TestSine()
+{
+	/* EBU Tech 3341 test case 1: a stereo 1 kHz sine at -23 dBFS
+	   measures -23 LUFS */
+
+	for (unsigned sample_rate : {44100u, 48000u, 96000u}) {
+		const auto v = GenerateSine(sample_rate, sample_rate * 20,
+					    1000, -23);
+
+		LoudnessMeter m;
+		m.Open(sample_rate, 2);
+		m.Feed(&v.front(), v.size() / 2);
+
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(-23.0,
+					     m.GetIntegratedLoudness(), 0.1);
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(pow(10.0, -23 / 20.),
+					     m.GetTruePeak(), 0.001);
+	}
+}
+
+void
+PcmLoudnessTest::TestGate()
+{
+	static constexpr unsigned sample_rate = 48000;
+
+	LoudnessMeter m;
+	m.Open(sample_rate, 2);
+
+	/* silence only: nothing passes the absolute gate */
+	std::vector<float> silence(sample_rate * 2 * 2);
+	m.Feed(&silence.front(), sample_rate * 2);
+	CPPUNIT_ASSERT(!m.IsDefined());
+
+	/* the silence does not lower the loudness, and neither does
+	   a quiet passage 30 dB below the tone (except for the few
+	   blocks which overlap the transition) */
+	auto v = GenerateSine(sample_rate, sample_rate * 30, 1000, -20);
+	m.Feed(&v.front(), v.size() / 2);
+	v = GenerateSine(sample_rate, sample_rate * 10, 1000, -50);
+	m.Feed(&v.front(), v.size() / 2);
+	m.Feed(&silence.front(), sample_rate * 2);
+
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(-20.0, m.GetIntegratedLoudness(), 0.1);
+}
+
+void
+PcmLoudnessTest::TestTruePeak()
+{
+	/* a sine at a quarter of the sample rate, shifted by 45 degrees:
+	   all samples are at 0.707, but the waveform reaches 1.0
+	   between them */
+
+	static constexpr unsigned sample_rate = 44100;
+
+	const auto v = GenerateSine(sample_rate, sample_rate,
+				    sample_rate / 4., 0, M_PI / 4);
+
+	LoudnessMeter m;
+	m.Open(sample_rate, 2);
+	m.Feed(&v.front(), v.size() / 2);
+
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0, m.GetTruePeak(), 0.02);
+}
@@ -31,7 +31,11 @@ CPPUNIT_TEST_SUITE_REGISTRATION(PcmChannelsTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(PcmVolumeTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(PcmFormatTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(PcmMixTest);
+CPPUNIT_TEST_SUITE_REGISTRATION(PcmDsdTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(PcmExportTest);
+CPPUNIT_TEST_SUITE_REGISTRATION(PcmResamplerTest);
+CPPUNIT_TEST_SUITE_REGISTRATION(PcmLoudnessTest);
+CPPUNIT_TEST_SUITE_REGISTRATION(PcmLevelTest);
 
 int
 main(gcc_unused int argc, gcc_unused char **argv)
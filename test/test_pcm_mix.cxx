@@ -22,6 +22,9 @@
 #include "test_pcm_util.hxx"
 #include "pcm/PcmMix.hxx"
 #include "pcm/PcmDither.hxx"
+#include "pcm/PcmUtils.hxx"
+#include "pcm/Volume.hxx"
+#include "pcm/Traits.hxx"
 
 template<typename T, SampleFormat format, typename G=RandomInt<T>>
 static void
@@ -59,6 +62,32 @@ TestPcmMix(G g=G())
 		expected[i] = (int64_t(src1[i]) + int64_t(src2[i])) / 2;
 
 	AssertEqualWithTolerance(result, expected, 3);
+
+	/* portion1=-1.0: clipped sum of both, this must be exact */
+	result = src1;
+	success = pcm_mix(dither, result.begin(), src2.begin(), sizeof(result),
+			  format, -1.0);
+	CPPUNIT_ASSERT(success);
+
+	typedef SampleTraits<format> Traits;
+	for (unsigned i = 0; i < N; ++i)
+		expected[i] = PcmClamp<format, Traits>(int64_t(src1[i]) +
+						       int64_t(src2[i]));
+
+	AssertEqualWithTolerance(result, expected, 0);
+
+	/* portion1=0.5 with volumes: 50% of src1 scaled to 50%
+	   plus 50% of src2 scaled to 150% */
+	result = src1;
+	success = pcm_mix(dither, result.begin(), src2.begin(), sizeof(result),
+			  format, 0.5, PCM_VOLUME_1 / 2, PCM_VOLUME_1 * 3 / 2);
+	CPPUNIT_ASSERT(success);
+
+	for (unsigned i = 0; i < N; ++i)
+		expected[i] = PcmClamp<format, Traits>((int64_t(src1[i]) +
+							int64_t(src2[i]) * 3) / 4);
+
+	AssertEqualWithTolerance(result, expected, 3);
 }
 
 void
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "test_pcm_all.hxx"
+#include "pcm/PolyphaseResampler.hxx"
+#include "AudioFormat.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Error.hxx"
+
+#include <algorithm>
+#include <vector>
+
+#include <math.h>
+
+/**
+ * Resample a stereo sine wave (different frequencies on the two
+ * channels) in portions of varying size and compare with the
+ * ideal result.
+ */
+static void
+CheckPolyphaseSine(unsigned src_rate, unsigned dest_rate)
+{
+	constexpr unsigned CHANNELS = 2;
+	constexpr unsigned N = 4096;
+	static constexpr double frequency[CHANNELS] = { 1000, 3100 };
+
+	float src[N * CHANNELS];
+	for (unsigned i = 0; i < N; ++i)
+		for (unsigned c = 0; c < CHANNELS; ++c)
+			src[i * CHANNELS + c] =
+				0.5 * sin(2 * M_PI * frequency[c] * i / src_rate);
+
+	PolyphasePcmResampler r;
+	AudioFormat af(src_rate, SampleFormat::FLOAT, CHANNELS);
+	Error error;
+	const AudioFormat out = r.Open(af, dest_rate, error);
+	CPPUNIT_ASSERT(out.IsValid());
+	CPPUNIT_ASSERT_EQUAL(dest_rate, out.sample_rate);
+	CPPUNIT_ASSERT(out.format == SampleFormat::FLOAT);
+
+	float dest[N * 3 * CHANNELS];
+	unsigned n_dest = 0;
+
+	for (unsigned i = 0, size = 1; i < N; i += size, size = size * 3 + 1) {
+		size = std::min(size, N - i);
+		const ConstBuffer<void> portion(src + i * CHANNELS,
+						size * CHANNELS * sizeof(float));
+		auto d = ConstBuffer<float>::FromVoid(r.Resample(portion,
+								 error));
+		CPPUNIT_ASSERT(!d.IsNull());
+		CPPUNIT_ASSERT(n_dest + d.size <= N * 3 * CHANNELS);
+		std::copy(d.begin(), d.end(), dest + n_dest);
+		n_dest += d.size;
+	}
+
+	r.Close();
+
+	/* the filter delays the output by half its length; all
+	   input frames except for that have been converted */
+	const unsigned n_dest_frames = n_dest / CHANNELS;
+	const unsigned expected_frames = uint64_t(N) * dest_rate / src_rate;
+	CPPUNIT_ASSERT(n_dest_frames <= expected_frames);
+	CPPUNIT_ASSERT(n_dest_frames >= expected_frames - 256);
+
+	/* skip the first frames, which are affected by the
+	   silence before the input */
+	for (unsigned i = 256; i < n_dest_frames; ++i) {
+		for (unsigned c = 0; c < CHANNELS; ++c) {
+			const double expected =
+				0.5 * sin(2 * M_PI * frequency[c] * i / dest_rate);
+			CPPUNIT_ASSERT_DOUBLES_EQUAL(expected,
+						     dest[i * CHANNELS + c],
+						     1e-3);
+		}
+	}
+}
+
+void
+PcmResamplerTest::TestPolyphase()
+{
+	CheckPolyphaseSine(44100, 48000);
+	CheckPolyphaseSine(48000, 44100);
+	CheckPolyphaseSine(44100, 96000);
+	CheckPolyphaseSine(96000, 44100);
+	CheckPolyphaseSine(22050, 44100);
+	CheckPolyphaseSine(44100, 44101);
+
+	/* after Reset(), the resampler must behave as if it had just
+	   been opened */
+
+	constexpr unsigned N = 300;
+	float src[N];
+	for (unsigned i = 0; i < N; ++i)
+		src[i] = sin(i * 0.1);
+
+	PolyphasePcmResampler r;
+	AudioFormat af(44100, SampleFormat::FLOAT, 1);
+	Error error;
+	CPPUNIT_ASSERT(r.Open(af, 48000, error).IsValid());
+
+	const ConstBuffer<void> input(src, sizeof(src));
+	auto d = ConstBuffer<float>::FromVoid(r.Resample(input, error));
+	const std::vector<float> expected(d.begin(), d.end());
+
+	r.Resample(input, error);
+	r.Reset();
+
+	d = ConstBuffer<float>::FromVoid(r.Resample(input, error));
+	CPPUNIT_ASSERT_EQUAL(expected.size(), d.size);
+	CPPUNIT_ASSERT(std::equal(d.begin(), d.end(), expected.begin()));
+
+	r.Close();
+}
+
+/**
+ * In variable ratio mode, the resampler stretches the signal by the
+ * given factor, even if both sample rates are equal.
+ */
+void
+PcmResamplerTest::TestVariableRatio()
+{
+	constexpr unsigned RATE = 44100;
+	constexpr unsigned N = 8192;
+	constexpr double frequency = 1000;
+	constexpr double ratio = 1.001;
+
+	float src[N];
+	for (unsigned i = 0; i < N; ++i)
+		src[i] = 0.5 * sin(2 * M_PI * frequency * i / RATE);
+
+	PolyphasePcmResampler r(true);
+	AudioFormat af(RATE, SampleFormat::FLOAT, 1);
+	Error error;
+	CPPUNIT_ASSERT(r.Open(af, RATE, error).IsValid());
+	r.SetRatio(ratio);
+
+	auto d = ConstBuffer<float>::FromVoid(r.Resample({src, sizeof(src)},
+							 error));
+	CPPUNIT_ASSERT(!d.IsNull());
+
+	const unsigned expected_frames = N * ratio;
+	CPPUNIT_ASSERT(d.size <= expected_frames);
+	CPPUNIT_ASSERT(d.size >= expected_frames - 256);
+
+	for (unsigned i = 256; i < d.size; ++i) {
+		const double expected =
+			0.5 * sin(2 * M_PI * frequency * i / ratio / RATE);
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(expected, d.data[i], 1e-3);
+	}
+
+	r.Close();
+}
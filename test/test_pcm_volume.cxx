@@ -21,6 +21,7 @@
 #include "test_pcm_all.hxx"
 #include "pcm/Volume.hxx"
 #include "pcm/Traits.hxx"
+#include "pcm/PcmUtils.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/Error.hxx"
 #include "test_pcm_util.hxx"
@@ -58,13 +59,38 @@ TestVolume(G g=G())
 	dest = pv.Apply(src);
 	CPPUNIT_ASSERT_EQUAL(src.size, dest.size);
 
-	const auto _dest = ConstBuffer<value_type>::FromVoid(dest);
+	auto _dest = ConstBuffer<value_type>::FromVoid(dest);
 	for (unsigned i = 0; i < N; ++i) {
 		const auto expected = (_src[i] + 1) / 2;
 		CPPUNIT_ASSERT(_dest[i] >= expected - 4);
 		CPPUNIT_ASSERT(_dest[i] <= expected + 4);
 	}
 
+	/* not a power of two: multiplication with dithering */
+	pv.SetVolume(PCM_VOLUME_1 * 3 / 4);
+	dest = pv.Apply(src);
+	CPPUNIT_ASSERT_EQUAL(src.size, dest.size);
+
+	_dest = ConstBuffer<value_type>::FromVoid(dest);
+	for (unsigned i = 0; i < N; ++i) {
+		const auto expected =
+			typename Traits::long_type(_src[i]) * 3 / 4;
+		CPPUNIT_ASSERT(_dest[i] >= expected - 4);
+		CPPUNIT_ASSERT(_dest[i] <= expected + 4);
+	}
+
+	/* amplification by a power of two is exact (with clipping) */
+	pv.SetVolume(PCM_VOLUME_1 * 2);
+	dest = pv.Apply(src);
+	CPPUNIT_ASSERT_EQUAL(src.size, dest.size);
+
+	_dest = ConstBuffer<value_type>::FromVoid(dest);
+	for (unsigned i = 0; i < N; ++i) {
+		const auto expected =
+			PcmClamp<F, Traits>(typename Traits::long_type(_src[i]) * 2);
+		CPPUNIT_ASSERT_EQUAL(expected, _dest[i]);
+	}
+
 	pv.Close();
 }
 
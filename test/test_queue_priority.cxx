@@ -8,6 +8,8 @@
 #include <cppunit/ui/text/TestRunner.h>
 #include <cppunit/extensions/HelperMacros.h>
 
+#include <stdio.h>
+
 Tag::Tag(const Tag &) {}
 void Tag::Clear() {}
 
@@ -30,10 +32,12 @@ check_descending_priority(const Queue *queue,
 class QueuePriorityTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST_SUITE(QueuePriorityTest);
 	CPPUNIT_TEST(TestPriority);
+	CPPUNIT_TEST(TestPriorityRange);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
 	void TestPriority();
+	void TestPriorityRange();
 };
 
 void
@@ -193,6 +197,88 @@ QueuePriorityTest::TestPriority()
 	CPPUNIT_ASSERT_EQUAL(6u, a_order);
 }
 
+void
+QueuePriorityTest::TestPriorityRange()
+{
+	static constexpr unsigned N = 16;
+
+	Queue queue(32);
+
+	for (unsigned i = 0; i < N; ++i) {
+		char uri[16];
+		snprintf(uri, sizeof(uri), "%u.ogg", i);
+		queue.Append(DetachedSong(uri), 0);
+	}
+
+	queue.random = true;
+	queue.ShuffleOrder();
+
+	/* the current song is in the middle of the order list, and
+	   outside of the range */
+
+	const unsigned current_position = 12;
+	unsigned current_order = queue.PositionToOrder(current_position);
+	if (current_order < 8) {
+		queue.SwapOrders(current_order, 8);
+		current_order = 8;
+	}
+
+	unsigned n_played = 0;
+	for (unsigned i = 0; i < 8; ++i)
+		if (queue.PositionToOrder(i) < current_order)
+			++n_played;
+
+	/* priority=40 for 8 items: all of them must be enqueued right
+	   after the current song, including those which have already
+	   been played */
+
+	CPPUNIT_ASSERT(queue.SetPriorityRange(0, 8, 40, current_order));
+
+	CPPUNIT_ASSERT_EQUAL(current_order - n_played,
+			     queue.PositionToOrder(current_position));
+	current_order = queue.PositionToOrder(current_position);
+	check_descending_priority(&queue, current_order + 1);
+
+	for (unsigned i = 0; i < 8; ++i) {
+		CPPUNIT_ASSERT_EQUAL(40u, unsigned(queue.items[i].priority));
+		CPPUNIT_ASSERT(queue.PositionToOrder(i) > current_order);
+		CPPUNIT_ASSERT(queue.PositionToOrder(i) <= current_order + 8);
+	}
+
+	for (unsigned i = 0; i < N; ++i)
+		CPPUNIT_ASSERT_EQUAL(i,
+				     queue.PositionToOrder(queue.OrderToPosition(i)));
+
+	/* priority=60 for 4 of them and 2 others: they must become
+	   the first group after the current song, ahead of the
+	   remaining priority=40 songs */
+
+	n_played = 0;
+	for (unsigned i = 4; i < 10; ++i)
+		if (queue.PositionToOrder(i) < current_order)
+			++n_played;
+
+	CPPUNIT_ASSERT(queue.SetPriorityRange(4, 10, 60, current_order));
+	CPPUNIT_ASSERT_EQUAL(current_order - n_played,
+			     queue.PositionToOrder(current_position));
+	current_order = queue.PositionToOrder(current_position);
+	check_descending_priority(&queue, current_order + 1);
+
+	for (unsigned i = 4; i < 10; ++i) {
+		CPPUNIT_ASSERT(queue.PositionToOrder(i) > current_order);
+		CPPUNIT_ASSERT(queue.PositionToOrder(i) <= current_order + 6);
+	}
+
+	for (unsigned i = 0; i < 4; ++i) {
+		CPPUNIT_ASSERT(queue.PositionToOrder(i) > current_order + 6);
+		CPPUNIT_ASSERT(queue.PositionToOrder(i) <= current_order + 10);
+	}
+
+	/* setting the same priority again doesn't modify anything */
+
+	CPPUNIT_ASSERT(!queue.SetPriorityRange(4, 10, 60, current_order));
+}
+
 CPPUNIT_TEST_SUITE_REGISTRATION(QueuePriorityTest);
 
 int
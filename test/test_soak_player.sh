@@ -0,0 +1,10 @@
+#!/bin/sh -e
+
+# play a few short songs with a jittery decoder and an output which
+# stalls for less than its buffer size; this checks for crashes and
+# deadlocks only, because the result depends on the machine load
+#
+# "make check-soak" passes "--strict", which additionally requires
+# gapless playback without any lost frame
+./test/soak_player --songs 4 --duration 1 --speed 4 --jitter 10 \
+	--stall-interval 500 --stall 50 --interval 0 "$@"
@@ -0,0 +1,125 @@
+/*
+ * Unit tests for class TextInputStream.
+ */
+
+#include "config.h"
+#include "input/TextInputStream.hxx"
+#include "input/InputStream.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "util/Error.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+class StringInputStream final : public InputStream {
+	const char *data;
+	size_t remaining;
+
+public:
+	StringInputStream(const char *_uri,
+			  Mutex &_mutex, Cond &_cond,
+			  const char *_data)
+		:InputStream(_uri, _mutex, _cond),
+		 data(_data), remaining(strlen(data)) {
+		SetReady();
+	}
+
+	/* virtual methods from InputStream */
+	bool IsEOF() override {
+		return remaining == 0;
+	}
+
+	size_t Read(void *ptr, size_t read_size,
+		    gcc_unused Error &error) override {
+		size_t nbytes = std::min(remaining, read_size);
+		memcpy(ptr, data, nbytes);
+		data += nbytes;
+		remaining -= nbytes;
+		offset += nbytes;
+		return nbytes;
+	}
+};
+
+class TextInputStreamTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TextInputStreamTest);
+	CPPUNIT_TEST(TestShort);
+	CPPUNIT_TEST(TestBufferBoundary);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestShort() {
+		Mutex mutex;
+		Cond cond;
+		StringInputStream sis("foo://", mutex, cond,
+				      "foo\r\n\nbar");
+		TextInputStream tis(sis);
+
+		const char *line = tis.ReadLine();
+		CPPUNIT_ASSERT(line != nullptr);
+		CPPUNIT_ASSERT_EQUAL(std::string("foo"), std::string(line));
+
+		line = tis.ReadLine();
+		CPPUNIT_ASSERT(line != nullptr);
+		CPPUNIT_ASSERT_EQUAL(std::string(""), std::string(line));
+
+		/* the last line is not terminated */
+		line = tis.ReadLine();
+		CPPUNIT_ASSERT(line != nullptr);
+		CPPUNIT_ASSERT_EQUAL(std::string("bar"), std::string(line));
+
+		CPPUNIT_ASSERT(tis.ReadLine() == nullptr);
+	}
+
+	/**
+	 * Lines which cross the end of the internal buffer must not
+	 * be split.
+	 */
+	void TestBufferBoundary() {
+		static constexpr unsigned N = 50000;
+
+		std::string text;
+		char buffer[64];
+		for (unsigned i = 0; i < N; ++i) {
+			snprintf(buffer, sizeof(buffer),
+				 "line number %u\n", i);
+			text += buffer;
+		}
+
+		Mutex mutex;
+		Cond cond;
+		StringInputStream sis("foo://", mutex, cond, text.c_str());
+		TextInputStream tis(sis);
+
+		for (unsigned i = 0; i < N; ++i) {
+			const char *line = tis.ReadLine();
+			CPPUNIT_ASSERT(line != nullptr);
+
+			snprintf(buffer, sizeof(buffer),
+				 "line number %u", i);
+			CPPUNIT_ASSERT_EQUAL(std::string(buffer),
+					     std::string(line));
+		}
+
+		CPPUNIT_ASSERT(tis.ReadLine() == nullptr);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TextInputStreamTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}